@@ -25,9 +25,67 @@ struct gr_api_response {
 
 #define GR_API_MAX_MSG_LEN (128 * 1024)
 
+// Response payload of bulk requests. Each entry of the request gets its own
+// errno value, zero on success. The response status is only set to an error
+// when the request itself is invalid.
+struct gr_api_bulk_resp {
+	uint32_t n_status;
+	uint32_t status[/* n_status */];
+};
+
 #define REQUEST_TYPE(module, id) (((uint32_t)(0xffff & module) << 16) | (0xffff & id))
 
+// Requests handled by grout itself, regardless of the loaded modules.
+#define GR_MAIN_MODULE 0xcafe
+
+// Group the following configuration requests of the same client. The changes
+// are applied immediately but the expensive dataplane updates (e.g. worker
+// graph reloads) are deferred until the transaction is committed. Open
+// transactions are committed when the client disconnects.
+#define GR_API_TRANSACTION_BEGIN REQUEST_TYPE(GR_MAIN_MODULE, 0x0001)
+
+// struct gr_api_transaction_begin_req { };
+// struct gr_api_transaction_begin_resp { };
+
+#define GR_API_TRANSACTION_COMMIT REQUEST_TYPE(GR_MAIN_MODULE, 0x0002)
+
+// struct gr_api_transaction_commit_req { };
+// struct gr_api_transaction_commit_resp { };
+
+// Receive events of the given type on this connection. The request may be sent
+// multiple times to subscribe to several event types. Events are not matched
+// with any request, the connection should only be used to receive them with
+// gr_api_client_event_recv() after subscribing.
+#define GR_API_EVENT_SUBSCRIBE REQUEST_TYPE(GR_MAIN_MODULE, 0x0003)
+
+#define GR_EVENT_ALL UINT32_MAX
+
+struct gr_api_event_subscribe_req {
+	uint32_t ev_type; // GR_EVENT_ALL or a module specific GR_*_EVENT_* value
+};
+
+// struct gr_api_event_subscribe_resp { };
+
+// Event types use the same namespace as request types.
+#define EVENT_TYPE(module, id) REQUEST_TYPE(module, 0x8000 | (id))
+
+// Events are sent with a gr_api_response header. for_id is set to this value.
+#define GR_API_EVENT_ID 0
+
+// Events of the same object that occur in a short time are coalesced, only the
+// last state is sent. Each subscribed connection numbers its events from 1.
+// A gap in the sequence means that events were dropped because the client did
+// not read them fast enough. The client must then reload the whole state with
+// the list requests.
+struct gr_api_event {
+	uint64_t seq;
+	uint32_t ev_type;
+	uint32_t obj_len;
+	uint8_t obj[/* obj_len */];
+};
+
 #define GR_DEFAULT_SOCK_PATH "/run/grout.sock"
+#define GR_DEFAULT_STATS_SHM "/grout-stats"
 
 struct gr_api_client;
 
@@ -43,4 +101,61 @@ int gr_api_client_send_recv(
 	void **rx_data
 );
 
+// Asynchronous API.
+//
+// Multiple requests can be submitted without waiting for their responses.
+// Responses are matched with their request by ID and the completion callback
+// is invoked from gr_api_client_poll() or gr_api_client_wait().
+//
+// The response payload is only valid during the callback. It must be copied
+// if needed afterwards. status is zero on success or an errno value.
+//
+// gr_api_client_send_recv() cannot be used while asynchronous requests are
+// still pending on the same client, it fails with EBUSY.
+typedef void (*gr_api_client_cb_t)(
+	void *cb_arg,
+	uint32_t status,
+	uint32_t rx_len,
+	const void *rx_data
+);
+
+// Send a request without waiting for its response. If the socket send buffer
+// is full, responses are processed while waiting for space. Returns the
+// request ID or a negative errno value.
+int64_t gr_api_client_submit(
+	struct gr_api_client *,
+	uint32_t req_type,
+	size_t tx_len,
+	const void *tx_data,
+	gr_api_client_cb_t cb,
+	void *cb_arg
+);
+
+// File descriptor to monitor for POLLIN in an external event loop.
+int gr_api_client_fd(const struct gr_api_client *);
+
+// Number of submitted requests that have not been completed yet.
+unsigned gr_api_client_pending(const struct gr_api_client *);
+
+// Process the responses received so far, waiting up to timeout_ms for at least
+// one of them (-1 to wait forever, 0 to return immediately). Returns the number
+// of completed requests or a negative errno value.
+int gr_api_client_poll(struct gr_api_client *, int timeout_ms);
+
+// Process responses until all pending requests are completed.
+// Returns 0 on success or a negative errno value.
+int gr_api_client_wait(struct gr_api_client *);
+
+// Pipeline mode. When cb is not NULL, gr_api_client_send_recv() calls that do
+// not expect a response payload are submitted with gr_api_client_submit() and
+// return immediately. cb is invoked with cb_arg when their response arrives.
+// Calls that expect a response payload wait for all pending requests first.
+// Setting cb to NULL disables the pipeline mode. Pending requests must then be
+// completed with gr_api_client_wait().
+void gr_api_client_pipeline(struct gr_api_client *, gr_api_client_cb_t cb, void *cb_arg);
+
+// Wait for the next event after GR_API_EVENT_SUBSCRIBE. The event must be
+// freed by the caller. Returns 0 on success or a negative errno value.
+int gr_api_client_event_recv(const struct gr_api_client *, struct gr_api_event **);
+
 #endif
@@ -11,18 +11,43 @@
 
 #include <errno.h>
 #include <getopt.h>
+#include <poll.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
 
+struct gr_api_pending {
+	uint32_t id;
+	bool done;
+	gr_api_client_cb_t cb;
+	void *cb_arg;
+};
+
 struct gr_api_client {
 	int sock_fd;
+	unsigned in_callback;
+	// in-flight asynchronous requests, in submission order
+	struct gr_api_pending *pending;
+	unsigned pending_head;
+	unsigned pending_count;
+	unsigned pending_size; // power of 2
+	// gr_api_client_pipeline() completion callback for gr_api_client_send_recv()
+	gr_api_client_cb_t pipeline_cb;
+	void *pipeline_cb_arg;
+	// received data, starts with the next response header
+	uint8_t *rx_buf;
+	size_t rx_len;
+	size_t rx_size;
 };
 
+static uint32_t gr_api_message_id;
+
 struct gr_api_client *gr_api_client_connect(const char *sock_path) {
 	union {
 		struct sockaddr_un un;
@@ -54,6 +79,14 @@ int gr_api_client_disconnect(struct gr_api_client *client) {
 	if (client == NULL)
 		return 0;
 	int ret = close(client->sock_fd);
+	for (unsigned i = 0; i < client->pending_count; i++) {
+		struct gr_api_pending *p;
+		p = &client->pending[(client->pending_head + i) & (client->pending_size - 1)];
+		if (!p->done && p->cb != NULL)
+			p->cb(p->cb_arg, ECANCELED, 0, NULL);
+	}
+	free(client->pending);
+	free(client->rx_buf);
 	free(client);
 	return ret;
 }
@@ -67,8 +100,7 @@ int gr_api_client_send_recv(
 ) {
 	struct gr_api_request *req = NULL;
 	struct gr_api_response resp;
-	static uint32_t message_id;
-	uint32_t id = ++message_id;
+	uint32_t id = ++gr_api_message_id;
 	void *payload = NULL;
 	ssize_t n;
 
@@ -76,6 +108,23 @@ int gr_api_client_send_recv(
 		errno = EINVAL;
 		goto err;
 	}
+	if (client->pipeline_cb != NULL) {
+		// The pending requests are owned by the client, not by the caller.
+		struct gr_api_client *c = (struct gr_api_client *)client;
+		gr_api_client_cb_t cb = c->pipeline_cb;
+		void *cb_arg = c->pipeline_cb_arg;
+		if (rx_data == NULL) {
+			if (gr_api_client_submit(c, req_type, tx_len, tx_data, cb, cb_arg) < 0)
+				goto err;
+			return 0;
+		}
+		if (gr_api_client_wait(c) < 0)
+			goto err;
+	}
+	if (client->pending_count > 0) {
+		errno = EBUSY;
+		goto err;
+	}
 	if ((req = malloc(sizeof(*req) + tx_len)) == NULL)
 		goto err;
 
@@ -99,8 +148,13 @@ int gr_api_client_send_recv(
 		// receive payload *before* checking response status to drain socket buffer
 		if ((payload = malloc(resp.payload_len)) == NULL)
 			goto err;
-		if ((n = recv(client->sock_fd, payload, resp.payload_len, 0)) < 0)
+		// large responses may not fit in the socket buffer, wait for all of it
+		if ((n = recv(client->sock_fd, payload, resp.payload_len, MSG_WAITALL)) < 0)
+			goto err;
+		if (n != resp.payload_len) {
+			errno = EBADMSG;
 			goto err;
+		}
 	}
 	if (resp.status != 0) {
 		errno = resp.status;
@@ -118,4 +172,284 @@ err:
 	return -errno;
 }
 
+static int gr_api_client_complete(
+	struct gr_api_client *client,
+	const struct gr_api_response *resp,
+	const void *payload
+) {
+	gr_api_client_cb_t cb;
+	struct gr_api_pending *p;
+	unsigned mask, i;
+	void *cb_arg;
+
+	// the server answers in order, the matching request is usually the first one
+	mask = client->pending_size - 1;
+	for (i = 0; i < client->pending_count; i++) {
+		p = &client->pending[(client->pending_head + i) & mask];
+		if (!p->done && p->id == resp->for_id)
+			break;
+	}
+	if (i == client->pending_count) {
+		errno = EBADMSG;
+		return -errno;
+	}
+
+	// the callback may submit new requests and reallocate the pending array
+	p->done = true;
+	cb = p->cb;
+	cb_arg = p->cb_arg;
+	if (cb != NULL) {
+		client->in_callback++;
+		cb(cb_arg, resp->status, resp->payload_len, resp->payload_len ? payload : NULL);
+		client->in_callback--;
+	}
+
+	mask = client->pending_size - 1;
+	while (client->pending_count > 0 && client->pending[client->pending_head].done) {
+		client->pending_head = (client->pending_head + 1) & mask;
+		client->pending_count--;
+	}
+
+	return 0;
+}
+
+// Read the available data without blocking and complete all fully received
+// responses. Returns the number of completed requests or a negative errno.
+static int gr_api_client_recv(struct gr_api_client *client) {
+	struct gr_api_response resp;
+	size_t size, off;
+	int completed;
+	ssize_t n;
+	void *buf;
+
+	// make room for at least one complete response
+	size = sizeof(resp) + GR_API_MAX_MSG_LEN;
+	if (client->rx_len >= sizeof(resp)) {
+		memcpy(&resp, client->rx_buf, sizeof(resp));
+		if (sizeof(resp) + resp.payload_len > size)
+			size = sizeof(resp) + resp.payload_len;
+	}
+	if (size > client->rx_size) {
+		if ((buf = realloc(client->rx_buf, size)) == NULL)
+			return -errno;
+		client->rx_buf = buf;
+		client->rx_size = size;
+	}
+
+	n = recv(client->sock_fd,
+		 client->rx_buf + client->rx_len,
+		 client->rx_size - client->rx_len,
+		 MSG_DONTWAIT);
+	if (n < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			return 0;
+		return -errno;
+	}
+	if (n == 0) {
+		errno = ECONNRESET;
+		return -errno;
+	}
+	client->rx_len += n;
+
+	off = 0;
+	completed = 0;
+	while (client->rx_len - off >= sizeof(resp)) {
+		memcpy(&resp, client->rx_buf + off, sizeof(resp));
+		if (client->rx_len - off < sizeof(resp) + resp.payload_len)
+			break;
+		if (gr_api_client_complete(client, &resp, client->rx_buf + off + sizeof(resp)) < 0)
+			return -errno;
+		off += sizeof(resp) + resp.payload_len;
+		completed++;
+	}
+
+	// keep the incomplete response at the start of the buffer
+	memmove(client->rx_buf, client->rx_buf + off, client->rx_len - off);
+	client->rx_len -= off;
+
+	return completed;
+}
+
+static int gr_api_client_sendv(struct gr_api_client *client, struct iovec *iov, int iovcnt) {
+	struct msghdr msg = {.msg_iov = iov, .msg_iovlen = iovcnt};
+	struct pollfd pfd;
+	ssize_t n;
+
+	while (msg.msg_iovlen > 0) {
+		n = sendmsg(client->sock_fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				return -errno;
+			// The server may stop reading until we consume its responses.
+			// Process them while waiting for room in the send buffer.
+			// Not from a completion callback: the receive buffer is in use.
+			pfd.fd = client->sock_fd;
+			pfd.events = POLLOUT;
+			if (client->in_callback == 0)
+				pfd.events |= POLLIN;
+			if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+				return -errno;
+			if (client->in_callback > 0)
+				continue;
+			if (!(pfd.revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+			if (gr_api_client_recv(client) < 0)
+				return -errno;
+			continue;
+		}
+		while (n > 0) {
+			if ((size_t)n < msg.msg_iov->iov_len) {
+				msg.msg_iov->iov_base = (uint8_t *)msg.msg_iov->iov_base + n;
+				msg.msg_iov->iov_len -= n;
+				break;
+			}
+			n -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+	}
+
+	return 0;
+}
+
+int64_t gr_api_client_submit(
+	struct gr_api_client *client,
+	uint32_t req_type,
+	size_t tx_len,
+	const void *tx_data,
+	gr_api_client_cb_t cb,
+	void *cb_arg
+) {
+	struct gr_api_pending *pending, *p;
+	struct gr_api_request req;
+	struct iovec iov[2];
+	unsigned size, i;
+
+	if (client == NULL || (tx_len > 0 && tx_data == NULL)) {
+		errno = EINVAL;
+		return -errno;
+	}
+
+	if (client->pending_count == client->pending_size) {
+		size = client->pending_size ? client->pending_size * 2 : 64;
+		if ((pending = calloc(size, sizeof(*pending))) == NULL)
+			return -errno;
+		for (i = 0; i < client->pending_count; i++) {
+			pending[i] = client->pending[(client->pending_head + i)
+						     & (client->pending_size - 1)];
+		}
+		free(client->pending);
+		client->pending = pending;
+		client->pending_head = 0;
+		client->pending_size = size;
+	}
+
+	req.id = ++gr_api_message_id;
+	req.type = req_type;
+	req.payload_len = tx_len;
+	iov[0].iov_base = &req;
+	iov[0].iov_len = sizeof(req);
+	iov[1].iov_base = (void *)tx_data;
+	iov[1].iov_len = tx_len;
+
+	// register the request first, its response may arrive while sending
+	p = &client->pending[(client->pending_head + client->pending_count)
+			     & (client->pending_size - 1)];
+	p->id = req.id;
+	p->done = false;
+	p->cb = cb;
+	p->cb_arg = cb_arg;
+	client->pending_count++;
+
+	if (gr_api_client_sendv(client, iov, tx_len > 0 ? 2 : 1) < 0)
+		return -errno;
+
+	return req.id;
+}
+
+int gr_api_client_fd(const struct gr_api_client *client) {
+	return client->sock_fd;
+}
+
+unsigned gr_api_client_pending(const struct gr_api_client *client) {
+	return client->pending_count;
+}
+
+int gr_api_client_poll(struct gr_api_client *client, int timeout_ms) {
+	struct pollfd pfd = {.fd = client->sock_fd, .events = POLLIN};
+	int ret;
+
+	if (client->in_callback) {
+		errno = EBUSY;
+		return -errno;
+	}
+	if (client->pending_count == 0)
+		return 0;
+
+	if ((ret = poll(&pfd, 1, timeout_ms)) < 0) {
+		if (errno == EINTR)
+			return 0;
+		return -errno;
+	}
+	if (ret == 0)
+		return 0;
+
+	return gr_api_client_recv(client);
+}
+
+int gr_api_client_wait(struct gr_api_client *client) {
+	int ret;
+
+	while (client->pending_count > 0) {
+		if ((ret = gr_api_client_poll(client, -1)) < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+void gr_api_client_pipeline(struct gr_api_client *client, gr_api_client_cb_t cb, void *cb_arg) {
+	client->pipeline_cb = cb;
+	client->pipeline_cb_arg = cb_arg;
+}
+
+int gr_api_client_event_recv(const struct gr_api_client *client, struct gr_api_event **event) {
+	struct gr_api_event *ev = NULL;
+	struct gr_api_response resp;
+	ssize_t n;
+
+	if (client == NULL || event == NULL) {
+		errno = EINVAL;
+		goto err;
+	}
+
+	if ((n = recv(client->sock_fd, &resp, sizeof(resp), MSG_WAITALL)) < 0)
+		goto err;
+	if (n == 0) {
+		errno = ECONNRESET;
+		goto err;
+	}
+	if (n != sizeof(resp) || resp.for_id != GR_API_EVENT_ID
+	    || resp.payload_len < sizeof(*ev)) {
+		errno = EBADMSG;
+		goto err;
+	}
+	if ((ev = malloc(resp.payload_len)) == NULL)
+		goto err;
+	if ((n = recv(client->sock_fd, ev, resp.payload_len, MSG_WAITALL)) < 0)
+		goto err;
+	if (n != resp.payload_len || sizeof(*ev) + ev->obj_len != resp.payload_len) {
+		errno = EBADMSG;
+		goto err;
+	}
+
+	*event = ev;
+	return 0;
+err:
+	free(ev);
+	return -errno;
+}
+
 #endif
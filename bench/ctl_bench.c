@@ -0,0 +1,860 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+// Control plane scale benchmark. Runs configuration churn scenarios against
+// a running grout and reports their rate along with the datapath packet rate
+// observed meanwhile.
+
+#include <gr_api.h>
+#include <gr_api_client_impl.h>
+#include <gr_errno.h>
+#include <gr_infra.h>
+#include <gr_ip4.h>
+#include <gr_ip6.h>
+#include <gr_ipip.h>
+#include <gr_net_types.h>
+
+#include <rte_common.h>
+#include <rte_ip.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// All addresses are taken from the 198.18.0.0/15 benchmarking range (RFC 2544)
+// except the route destinations which start at 16.0.0.0/24.
+#define ANCHOR_LOCAL RTE_IPV4(198, 18, 0, 1)
+#define ANCHOR_REMOTE RTE_IPV4(198, 18, 0, 2)
+#define NH_BASE RTE_IPV4(198, 18, 1, 0)
+#define NH_MAX (RTE_IPV4(198, 19, 0, 0) - NH_BASE)
+#define TUNNEL_REMOTE_BASE RTE_IPV4(198, 19, 0, 1)
+#define ROUTE_BASE RTE_IPV4(16, 0, 0, 0)
+#define ROUTE_MAX ((RTE_IPV4(224, 0, 0, 0) - ROUTE_BASE) >> 8)
+// IPv6 next hops are taken from the 2001:2::/48 benchmarking range (RFC 5180).
+#define NH6_PREFIX 0x20010002
+// Occupancy steps of the IPv6 next hop scenarios.
+#define NH6_STEPS 4
+#define BENCH_IFACE_NAME "grbench"
+#define BENCH_MAX_IFACES 1023 // MAX_IFACES minus the anchor interface
+
+// Please keep options/flags in alphabetical order.
+
+static void usage(const char *prog) {
+	printf("Usage: %s [-b N] [-h] [-i N] [-n N] [-r N] [-S N] [-s PATH] [-t SECS] [-v VRF]"
+	       " [-w N]\n",
+	       prog);
+}
+
+static void help(void) {
+	puts("");
+	printf("  Graph router control plane benchmark version %s.\n", GROUT_VERSION);
+	puts("");
+	puts("  A temporary ipip interface named " BENCH_IFACE_NAME " is created to");
+	puts("  anchor next hops and routes. It is removed when the benchmark ends.");
+	puts("  Send traffic through a port (or run \"grcli add bench\") to measure");
+	puts("  the impact of configuration churn on forwarding.");
+	puts("");
+	puts("options:");
+	puts("  -b N, --batch N            Entries per bulk request (default 1000).");
+	puts("  -h, --help                 Show this help message and exit.");
+	puts("  -i N, --ifaces N           Interfaces to create and destroy (default 1000).");
+	puts("  -n N, --nexthops N         IPv4 and IPv6 next hops to add and delete");
+	puts("                             (default 10000).");
+	puts("  -r N, --routes N           Routes to add, list and delete in bulk");
+	puts("                             (default 1000000).");
+	puts("  -S N, --single-routes N    Routes to add and delete with one request");
+	puts("                             each (default 10000).");
+	puts("  -s PATH, --socket PATH     Path to the control plane API socket.");
+	puts("                             Default: GROUT_SOCK_PATH from env or");
+	printf("                             %s).\n", GR_DEFAULT_SOCK_PATH);
+	puts("  -t SECS, --idle SECS       Seconds to measure the idle packet rate");
+	puts("                             (default 1).");
+	puts("  -v VRF, --vrf VRF          VRF used for all scenarios (default 0).");
+	puts("  -w N, --window N           Max requests in flight (default 32).");
+}
+
+struct bench_opts {
+	const char *sock_path;
+	unsigned batch;
+	unsigned ifaces;
+	unsigned nexthops;
+	unsigned routes;
+	unsigned single_routes;
+	unsigned idle_secs;
+	uint16_t vrf_id;
+	unsigned window;
+};
+
+static struct bench_opts opts = {
+	.batch = 1000,
+	.ifaces = 1000,
+	.nexthops = 10000,
+	.routes = 1000000,
+	.single_routes = 10000,
+	.idle_secs = 1,
+	.window = 32,
+};
+
+static int parse_uint(const char *arg, unsigned long max, unsigned *value) {
+	unsigned long v;
+	char *end;
+
+	errno = 0;
+	v = strtoul(arg, &end, 10);
+	if (errno != 0 || *end != '\0' || v > max)
+		return errno_set(ERANGE);
+	*value = v;
+
+	return 0;
+}
+
+static int parse_args(int argc, char **argv) {
+	size_t max_batch;
+	unsigned vrf_id;
+	int c;
+
+#define FLAGS ":b:hi:n:r:S:s:t:v:w:"
+	static struct option long_options[] = {
+		{"batch", required_argument, NULL, 'b'},
+		{"help", no_argument, NULL, 'h'},
+		{"ifaces", required_argument, NULL, 'i'},
+		{"nexthops", required_argument, NULL, 'n'},
+		{"routes", required_argument, NULL, 'r'},
+		{"single-routes", required_argument, NULL, 'S'},
+		{"socket", required_argument, NULL, 's'},
+		{"idle", required_argument, NULL, 't'},
+		{"vrf", required_argument, NULL, 'v'},
+		{"window", required_argument, NULL, 'w'},
+		{0},
+	};
+
+	opterr = 0; // disable getopt default error reporting
+
+	opts.sock_path = getenv("GROUT_SOCK_PATH");
+
+	// the largest bulk request entries are routes
+	max_batch = (GR_API_MAX_MSG_LEN - sizeof(struct gr_ip4_route_add_bulk_req))
+		/ sizeof(struct gr_ip4_route);
+
+	while ((c = getopt_long(argc, argv, FLAGS, long_options, NULL)) != -1) {
+		switch (c) {
+		case 'b':
+			if (parse_uint(optarg, max_batch, &opts.batch) < 0 || opts.batch == 0)
+				goto invalid;
+			break;
+		case 'h':
+			usage(argv[0]);
+			help();
+			exit(EXIT_SUCCESS);
+		case 'i':
+			if (parse_uint(optarg, BENCH_MAX_IFACES, &opts.ifaces) < 0)
+				goto invalid;
+			break;
+		case 'n':
+			if (parse_uint(optarg, NH_MAX, &opts.nexthops) < 0)
+				goto invalid;
+			break;
+		case 'r':
+			if (parse_uint(optarg, ROUTE_MAX, &opts.routes) < 0)
+				goto invalid;
+			break;
+		case 'S':
+			if (parse_uint(optarg, ROUTE_MAX, &opts.single_routes) < 0)
+				goto invalid;
+			break;
+		case 's':
+			opts.sock_path = optarg;
+			break;
+		case 't':
+			if (parse_uint(optarg, 3600, &opts.idle_secs) < 0)
+				goto invalid;
+			break;
+		case 'v':
+			if (parse_uint(optarg, UINT16_MAX, &vrf_id) < 0)
+				goto invalid;
+			opts.vrf_id = vrf_id;
+			break;
+		case 'w':
+			if (parse_uint(optarg, 4096, &opts.window) < 0 || opts.window == 0)
+				goto invalid;
+			break;
+		case ':':
+			usage(argv[0]);
+			fprintf(stderr, "error: -%c requires a value\n", optopt);
+			return errno_set(EINVAL);
+		case '?':
+			usage(argv[0]);
+			fprintf(stderr, "error: -%c unknown option\n", optopt);
+			return errno_set(EINVAL);
+		default:
+			goto invalid;
+		}
+	}
+
+	if (opts.sock_path == NULL)
+		opts.sock_path = GR_DEFAULT_SOCK_PATH;
+
+	return 0;
+invalid:
+	usage(argv[0]);
+	fprintf(stderr, "error: invalid arguments\n");
+	return errno_set(EINVAL);
+}
+
+// Scenario being measured. Responses are accounted from the completion
+// callback of asynchronous requests.
+struct bench_phase {
+	const char *name;
+	struct timespec start;
+	uint64_t fwd_start;
+	unsigned ops;
+	unsigned errors;
+	uint32_t first_error;
+	bool bulk; // responses are struct gr_api_bulk_resp
+	// responses are struct gr_ip4_route_lookup_bulk_resp, all resolved to gw
+	bool lookup;
+	ip4_addr_t gw;
+	// interface IDs returned by GR_INFRA_IFACE_ADD
+	uint16_t *ids;
+	unsigned n_ids;
+};
+
+static double elapsed(const struct timespec *start) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Packets received by ports and injected by the synthetic traffic source.
+static int fwd_packets(const struct gr_api_client *c, uint64_t *packets) {
+	struct gr_infra_stats_get_req req = {.flags = GR_INFRA_STAT_F_SW};
+	const struct gr_infra_stats_get_resp *resp;
+	void *resp_ptr = NULL;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_STATS_GET, sizeof(req), &req, &resp_ptr) < 0)
+		return -errno;
+
+	resp = resp_ptr;
+	*packets = 0;
+	for (uint16_t i = 0; i < resp->n_stats; i++) {
+		if (strcmp(resp->stats[i].name, "port_rx") == 0
+		    || strcmp(resp->stats[i].name, "bench_source") == 0)
+			*packets += resp->stats[i].objs;
+	}
+	free(resp_ptr);
+
+	return 0;
+}
+
+static void phase_error(struct bench_phase *p, uint32_t status) {
+	if (p->errors++ == 0)
+		p->first_error = status;
+}
+
+static void phase_cb(void *arg, uint32_t status, uint32_t rx_len, const void *rx_data) {
+	const struct gr_api_bulk_resp *bulk = rx_data;
+	const struct gr_ip4_route_lookup_bulk_resp *lookup = rx_data;
+	const struct gr_infra_iface_add_resp *iface = rx_data;
+	struct bench_phase *p = arg;
+
+	if (status != 0) {
+		phase_error(p, status);
+		return;
+	}
+	if (p->bulk && rx_len >= sizeof(*bulk)) {
+		for (uint32_t i = 0; i < bulk->n_status; i++) {
+			if (bulk->status[i] != 0)
+				phase_error(p, bulk->status[i]);
+		}
+	}
+	if (p->lookup && rx_len >= sizeof(*lookup)) {
+		for (uint16_t i = 0; i < lookup->n_results; i++) {
+			const struct gr_ip4_route_lookup_result *res = &lookup->results[i];
+			if (res->status != 0)
+				phase_error(p, res->status);
+			else if (res->nh != p->gw)
+				phase_error(p, EHOSTUNREACH);
+		}
+	}
+	if (p->ids != NULL && rx_len >= sizeof(*iface) && p->n_ids < opts.ifaces)
+		p->ids[p->n_ids++] = iface->iface_id;
+}
+
+static void print_header(void) {
+	printf("%-20s %10s %8s %10s %12s %10s\n",
+	       "SCENARIO",
+	       "OPS",
+	       "ERRORS",
+	       "SECONDS",
+	       "OPS/S",
+	       "FWD_MPPS");
+}
+
+static void
+print_row(const struct bench_phase *p, double secs, uint64_t fwd_start, uint64_t fwd_end) {
+	printf("%-20s %10u %8u %10.3f %12.0f %10.3f",
+	       p->name,
+	       p->ops,
+	       p->errors,
+	       secs,
+	       secs > 0 ? p->ops / secs : 0,
+	       secs > 0 ? (fwd_end - fwd_start) / secs / 1e6 : 0);
+	if (p->errors > 0)
+		printf("  (%s)", strerror(p->first_error));
+	printf("\n");
+}
+
+static int phase_start(const struct gr_api_client *c, struct bench_phase *p, const char *name) {
+	memset(p, 0, sizeof(*p));
+	p->name = name;
+	if (fwd_packets(c, &p->fwd_start) < 0)
+		return -errno;
+	clock_gettime(CLOCK_MONOTONIC, &p->start);
+
+	return 0;
+}
+
+static int phase_end(struct gr_api_client *c, struct bench_phase *p) {
+	uint64_t fwd_end;
+	double secs;
+
+	if (gr_api_client_wait(c) < 0)
+		return -errno;
+	secs = elapsed(&p->start);
+	if (fwd_packets(c, &fwd_end) < 0)
+		return -errno;
+	print_row(p, secs, p->fwd_start, fwd_end);
+
+	return 0;
+}
+
+// Keep at most opts.window requests in flight.
+static int phase_submit(
+	struct gr_api_client *c,
+	struct bench_phase *p,
+	uint32_t type,
+	size_t len,
+	const void *data,
+	unsigned ops
+) {
+	int ret;
+
+	while (gr_api_client_pending(c) >= opts.window) {
+		if ((ret = gr_api_client_poll(c, -1)) < 0)
+			return errno_set(-ret);
+	}
+	if (gr_api_client_submit(c, type, len, data, phase_cb, p) < 0)
+		return -errno;
+	p->ops += ops;
+
+	return 0;
+}
+
+static int bench_idle(const struct gr_api_client *c) {
+	struct bench_phase p;
+	uint64_t fwd_end;
+
+	if (phase_start(c, &p, "idle") < 0)
+		return -errno;
+	sleep(opts.idle_secs);
+	if (fwd_packets(c, &fwd_end) < 0)
+		return -errno;
+	print_row(&p, elapsed(&p.start), p.fwd_start, fwd_end);
+
+	return 0;
+}
+
+static void fill_nh(struct gr_ip4_nh *nh, uint16_t iface_id, uint32_t host) {
+	memset(nh, 0, sizeof(*nh));
+	nh->host = htonl(host);
+	nh->vrf_id = opts.vrf_id;
+	nh->iface_id = iface_id;
+	nh->mac = (struct rte_ether_addr) {{0x02, 0x00, 0x00, host >> 16, host >> 8, host}};
+}
+
+static int bench_nexthops(struct gr_api_client *c, uint16_t iface_id) {
+	struct gr_ip4_nh_add_bulk_req *add;
+	struct gr_ip4_nh_del_bulk_req *del;
+	struct bench_phase p;
+	unsigned batch, i, n;
+	int ret = -1;
+	size_t len;
+
+	// next hops are larger than routes, clamp to the max message size
+	batch = RTE_MIN(opts.batch, (GR_API_MAX_MSG_LEN - sizeof(*add)) / sizeof(*add->nhs));
+	add = calloc(1, sizeof(*add) + batch * sizeof(*add->nhs));
+	del = calloc(1, sizeof(*del) + batch * sizeof(*del->hosts));
+	if (add == NULL || del == NULL) {
+		errno = ENOMEM;
+		goto out;
+	}
+
+	if (phase_start(c, &p, "nexthop add bulk") < 0)
+		goto out;
+	p.bulk = true;
+	for (i = 0; i < opts.nexthops; i += n) {
+		n = RTE_MIN(batch, opts.nexthops - i);
+		for (unsigned j = 0; j < n; j++)
+			fill_nh(&add->nhs[j], iface_id, NH_BASE + i + j);
+		add->n_nhs = n;
+		len = sizeof(*add) + n * sizeof(*add->nhs);
+		if (phase_submit(c, &p, GR_IP4_NH_ADD_BULK, len, add, n) < 0)
+			goto out;
+	}
+	if (phase_end(c, &p) < 0)
+		goto out;
+
+	if (phase_start(c, &p, "nexthop del bulk") < 0)
+		goto out;
+	p.bulk = true;
+	del->vrf_id = opts.vrf_id;
+	for (i = 0; i < opts.nexthops; i += n) {
+		n = RTE_MIN(batch, opts.nexthops - i);
+		for (unsigned j = 0; j < n; j++)
+			del->hosts[j] = htonl(NH_BASE + i + j);
+		del->n_hosts = n;
+		len = sizeof(*del) + n * sizeof(*del->hosts);
+		if (phase_submit(c, &p, GR_IP4_NH_DEL_BULK, len, del, n) < 0)
+			goto out;
+	}
+	if (phase_end(c, &p) < 0)
+		goto out;
+
+	ret = 0;
+out:
+	free(add);
+	free(del);
+	return ret;
+}
+
+static void nh6_host(struct rte_ipv6_addr *ip, uint32_t host) {
+	uint32_t words[4] = {htonl(NH6_PREFIX), 0, 0, htonl(host)};
+	memcpy(ip, words, sizeof(*ip));
+}
+
+static void fill_nh6(struct gr_ip6_nh *nh, uint16_t iface_id, uint32_t host) {
+	memset(nh, 0, sizeof(*nh));
+	nh6_host(&nh->host, host);
+	nh->vrf_id = opts.vrf_id;
+	nh->iface_id = iface_id;
+	nh->mac = (struct rte_ether_addr) {{0x02, 0x00, 0x06, host >> 16, host >> 8, host}};
+}
+
+// Add IPv6 next hops in NH6_STEPS slices. After each slice, look up all the
+// next hops added so far by adding them again with exist_ok, which does not
+// modify anything. They are finally deleted in reverse order. The rates of the
+// successive steps show whether the cost depends on the table occupancy.
+static int bench_nexthops6(struct gr_api_client *c, uint16_t iface_id) {
+	struct gr_ip6_nh_add_bulk_req *add;
+	struct gr_ip6_nh_del_bulk_req *del;
+	unsigned batch, i, n, start, end;
+	struct bench_phase p;
+	char name[32];
+	int ret = -1;
+	size_t len;
+
+	batch = RTE_MIN(opts.batch, (GR_API_MAX_MSG_LEN - sizeof(*add)) / sizeof(*add->nhs));
+	add = calloc(1, sizeof(*add) + batch * sizeof(*add->nhs));
+	del = calloc(1, sizeof(*del) + batch * sizeof(*del->hosts));
+	if (add == NULL || del == NULL) {
+		errno = ENOMEM;
+		goto out;
+	}
+
+	for (unsigned step = 1; step <= NH6_STEPS; step++) {
+		start = opts.nexthops * (step - 1) / NH6_STEPS;
+		end = opts.nexthops * step / NH6_STEPS;
+
+		snprintf(name, sizeof(name), "nexthop6 add %u%%", 100 * step / NH6_STEPS);
+		if (phase_start(c, &p, name) < 0)
+			goto out;
+		p.bulk = true;
+		add->exist_ok = false;
+		for (i = start; i < end; i += n) {
+			n = RTE_MIN(batch, end - i);
+			for (unsigned j = 0; j < n; j++)
+				fill_nh6(&add->nhs[j], iface_id, 1 + i + j);
+			add->n_nhs = n;
+			len = sizeof(*add) + n * sizeof(*add->nhs);
+			if (phase_submit(c, &p, GR_IP6_NH_ADD_BULK, len, add, n) < 0)
+				goto out;
+		}
+		if (phase_end(c, &p) < 0)
+			goto out;
+
+		snprintf(name, sizeof(name), "nexthop6 lookup %u%%", 100 * step / NH6_STEPS);
+		if (phase_start(c, &p, name) < 0)
+			goto out;
+		p.bulk = true;
+		add->exist_ok = true;
+		for (i = 0; i < end; i += n) {
+			n = RTE_MIN(batch, end - i);
+			for (unsigned j = 0; j < n; j++)
+				fill_nh6(&add->nhs[j], iface_id, 1 + i + j);
+			add->n_nhs = n;
+			len = sizeof(*add) + n * sizeof(*add->nhs);
+			if (phase_submit(c, &p, GR_IP6_NH_ADD_BULK, len, add, n) < 0)
+				goto out;
+		}
+		if (phase_end(c, &p) < 0)
+			goto out;
+	}
+
+	del->vrf_id = opts.vrf_id;
+	for (unsigned step = NH6_STEPS; step > 0; step--) {
+		start = opts.nexthops * (step - 1) / NH6_STEPS;
+		end = opts.nexthops * step / NH6_STEPS;
+
+		snprintf(name, sizeof(name), "nexthop6 del %u%%", 100 * step / NH6_STEPS);
+		if (phase_start(c, &p, name) < 0)
+			goto out;
+		p.bulk = true;
+		for (i = start; i < end; i += n) {
+			n = RTE_MIN(batch, end - i);
+			for (unsigned j = 0; j < n; j++)
+				nh6_host(&del->hosts[j], 1 + i + j);
+			del->n_hosts = n;
+			len = sizeof(*del) + n * sizeof(*del->hosts);
+			if (phase_submit(c, &p, GR_IP6_NH_DEL_BULK, len, del, n) < 0)
+				goto out;
+		}
+		if (phase_end(c, &p) < 0)
+			goto out;
+	}
+
+	ret = 0;
+out:
+	free(add);
+	free(del);
+	return ret;
+}
+
+static struct ip4_net route_dest(unsigned i) {
+	return (struct ip4_net) {.ip = htonl(ROUTE_BASE + (i << 8)), .prefixlen = 24};
+}
+
+static int bench_routes_single(struct gr_api_client *c, ip4_addr_t gw) {
+	struct gr_ip4_route_add_req add = {.vrf_id = opts.vrf_id, .nh = gw};
+	struct gr_ip4_route_del_req del = {.vrf_id = opts.vrf_id};
+	struct bench_phase p;
+
+	if (phase_start(c, &p, "route add") < 0)
+		return -errno;
+	for (unsigned i = 0; i < opts.single_routes; i++) {
+		add.dest = route_dest(i);
+		if (phase_submit(c, &p, GR_IP4_ROUTE_ADD, sizeof(add), &add, 1) < 0)
+			return -errno;
+	}
+	if (phase_end(c, &p) < 0)
+		return -errno;
+
+	if (phase_start(c, &p, "route del") < 0)
+		return -errno;
+	for (unsigned i = 0; i < opts.single_routes; i++) {
+		del.dest = route_dest(i);
+		if (phase_submit(c, &p, GR_IP4_ROUTE_DEL, sizeof(del), &del, 1) < 0)
+			return -errno;
+	}
+	if (phase_end(c, &p) < 0)
+		return -errno;
+
+	return 0;
+}
+
+// Walk all pages of the route table. Reported ops are listed routes.
+static int bench_routes_list(const struct gr_api_client *c) {
+	struct gr_ip4_route_list_req req = {.vrf_id = opts.vrf_id};
+	const struct gr_ip4_route_list_resp *resp;
+	double first_page = 0;
+	struct bench_phase p;
+	uint64_t fwd_end;
+	unsigned pages = 0;
+	void *resp_ptr;
+
+	if (phase_start(c, &p, "route list") < 0)
+		return -errno;
+	do {
+		resp_ptr = NULL;
+		if (gr_api_client_send_recv(c, GR_IP4_ROUTE_LIST, sizeof(req), &req, &resp_ptr)
+		    < 0)
+			return -errno;
+		if (pages++ == 0)
+			first_page = elapsed(&p.start);
+		resp = resp_ptr;
+		p.ops += resp->n_routes;
+		req.cursor = resp->next_cursor;
+		req.last = resp->last;
+		free(resp_ptr);
+	} while (req.cursor != 0);
+	if (fwd_packets(c, &fwd_end) < 0)
+		return -errno;
+	print_row(&p, elapsed(&p.start), p.fwd_start, fwd_end);
+	printf("%-20s %u pages, first page after %.3fms\n", "", pages, first_page * 1000);
+
+	return 0;
+}
+
+// Check that all routes added in bulk resolve to gw. Errors are mismatches.
+static int bench_routes_lookup(struct gr_api_client *c, ip4_addr_t gw) {
+	struct gr_ip4_route_lookup_bulk_req *req;
+	struct bench_phase p;
+	unsigned batch, i, n;
+	int ret = -1;
+
+	batch = RTE_MIN(
+		opts.batch,
+		(GR_API_MAX_MSG_LEN - sizeof(struct gr_ip4_route_lookup_bulk_resp))
+			/ sizeof(struct gr_ip4_route_lookup_result)
+	);
+	if ((req = calloc(1, sizeof(*req) + batch * sizeof(*req->lookups))) == NULL)
+		return errno_set(ENOMEM);
+
+	if (phase_start(c, &p, "route lookup bulk") < 0)
+		goto out;
+	p.lookup = true;
+	p.gw = gw;
+	for (i = 0; i < opts.routes; i += n) {
+		n = RTE_MIN(batch, opts.routes - i);
+		for (unsigned j = 0; j < n; j++) {
+			req->lookups[j].vrf_id = opts.vrf_id;
+			req->lookups[j].dest = route_dest(i + j);
+		}
+		req->n_lookups = n;
+		if (phase_submit(
+			    c,
+			    &p,
+			    GR_IP4_ROUTE_LOOKUP_BULK,
+			    sizeof(*req) + n * sizeof(*req->lookups),
+			    req,
+			    n
+		    )
+		    < 0)
+			goto out;
+	}
+	if (phase_end(c, &p) < 0)
+		goto out;
+
+	ret = 0;
+out:
+	free(req);
+	return ret;
+}
+
+static int bench_routes_bulk(struct gr_api_client *c, ip4_addr_t gw) {
+	struct gr_ip4_route_add_bulk_req *add;
+	struct gr_ip4_route_del_bulk_req *del;
+	struct bench_phase p;
+	unsigned i, n;
+	int ret = -1;
+
+	add = calloc(1, sizeof(*add) + opts.batch * sizeof(*add->routes));
+	del = calloc(1, sizeof(*del) + opts.batch * sizeof(*del->dests));
+	if (add == NULL || del == NULL) {
+		errno = ENOMEM;
+		goto out;
+	}
+
+	if (phase_start(c, &p, "route add bulk") < 0)
+		goto out;
+	p.bulk = true;
+	add->vrf_id = opts.vrf_id;
+	for (i = 0; i < opts.routes; i += n) {
+		n = RTE_MIN(opts.batch, opts.routes - i);
+		for (unsigned j = 0; j < n; j++) {
+			add->routes[j].dest = route_dest(i + j);
+			add->routes[j].nh = gw;
+		}
+		add->n_routes = n;
+		if (phase_submit(
+			    c,
+			    &p,
+			    GR_IP4_ROUTE_ADD_BULK,
+			    sizeof(*add) + n * sizeof(*add->routes),
+			    add,
+			    n
+		    )
+		    < 0)
+			goto out;
+	}
+	if (phase_end(c, &p) < 0)
+		goto out;
+
+	if (bench_routes_list(c) < 0)
+		goto out;
+
+	if (bench_routes_lookup(c, gw) < 0)
+		goto out;
+
+	if (phase_start(c, &p, "route del bulk") < 0)
+		goto out;
+	p.bulk = true;
+	del->vrf_id = opts.vrf_id;
+	for (i = 0; i < opts.routes; i += n) {
+		n = RTE_MIN(opts.batch, opts.routes - i);
+		for (unsigned j = 0; j < n; j++)
+			del->dests[j] = route_dest(i + j);
+		del->n_dests = n;
+		if (phase_submit(
+			    c,
+			    &p,
+			    GR_IP4_ROUTE_DEL_BULK,
+			    sizeof(*del) + n * sizeof(*del->dests),
+			    del,
+			    n
+		    )
+		    < 0)
+			goto out;
+	}
+	if (phase_end(c, &p) < 0)
+		goto out;
+
+	ret = 0;
+out:
+	free(add);
+	free(del);
+	return ret;
+}
+
+static void fill_ipip(struct gr_iface *iface, const char *name, ip4_addr_t remote) {
+	struct gr_iface_info_ipip *info = (struct gr_iface_info_ipip *)iface->info;
+
+	memset(iface, 0, sizeof(*iface));
+	iface->type = GR_IFACE_TYPE_IPIP;
+	iface->flags = GR_IFACE_F_UP;
+	iface->vrf_id = opts.vrf_id;
+	snprintf(iface->name, sizeof(iface->name), "%s", name);
+	info->local = htonl(ANCHOR_LOCAL);
+	info->remote = remote;
+}
+
+static int bench_ifaces(struct gr_api_client *c) {
+	struct gr_infra_iface_add_req add;
+	struct gr_infra_iface_del_req del;
+	struct bench_phase p;
+	unsigned n_ids;
+	uint16_t *ids;
+	char name[32];
+	int ret = -1;
+
+	if ((ids = calloc(opts.ifaces, sizeof(*ids))) == NULL)
+		return errno_set(ENOMEM);
+
+	if (phase_start(c, &p, "iface add") < 0)
+		goto out;
+	p.ids = ids;
+	for (unsigned i = 0; i < opts.ifaces; i++) {
+		snprintf(name, sizeof(name), BENCH_IFACE_NAME "%u", i);
+		fill_ipip(&add.iface, name, htonl(TUNNEL_REMOTE_BASE + i));
+		if (phase_submit(c, &p, GR_INFRA_IFACE_ADD, sizeof(add), &add, 1) < 0)
+			goto out;
+	}
+	if (phase_end(c, &p) < 0)
+		goto out;
+
+	// only delete the interfaces that were created
+	n_ids = p.n_ids;
+	if (phase_start(c, &p, "iface del") < 0)
+		goto out;
+	for (unsigned i = 0; i < n_ids; i++) {
+		del.iface_id = ids[i];
+		if (phase_submit(c, &p, GR_INFRA_IFACE_DEL, sizeof(del), &del, 1) < 0)
+			goto out;
+	}
+	if (phase_end(c, &p) < 0)
+		goto out;
+
+	ret = 0;
+out:
+	free(ids);
+	return ret;
+}
+
+// Create the interface, address and gateway next hop used by all scenarios.
+static int anchor_create(const struct gr_api_client *c, uint16_t *iface_id) {
+	struct gr_ip4_addr_add_req addr = {.addr.addr = {htonl(ANCHOR_LOCAL), 16}};
+	const struct gr_infra_iface_add_resp *resp;
+	struct gr_infra_iface_add_req add;
+	struct gr_ip4_nh_add_req nh;
+	void *resp_ptr = NULL;
+
+	fill_ipip(&add.iface, BENCH_IFACE_NAME, htonl(ANCHOR_REMOTE));
+	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_ADD, sizeof(add), &add, &resp_ptr) < 0)
+		return -errno;
+	resp = resp_ptr;
+	*iface_id = resp->iface_id;
+	free(resp_ptr);
+
+	addr.addr.iface_id = *iface_id;
+	if (gr_api_client_send_recv(c, GR_IP4_ADDR_ADD, sizeof(addr), &addr, NULL) < 0)
+		return -errno;
+
+	memset(&nh, 0, sizeof(nh));
+	fill_nh(&nh.nh, *iface_id, ANCHOR_REMOTE);
+	if (gr_api_client_send_recv(c, GR_IP4_NH_ADD, sizeof(nh), &nh, NULL) < 0)
+		return -errno;
+
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	struct gr_api_client *client = NULL;
+	struct gr_infra_iface_del_req del;
+	uint16_t iface_id = 0;
+	int ret = EXIT_FAILURE;
+
+	if (parse_args(argc, argv) < 0)
+		goto end;
+
+	if ((client = gr_api_client_connect(opts.sock_path)) == NULL) {
+		fprintf(stderr, "error: gr_connect: %s\n", strerror(errno));
+		goto end;
+	}
+	if (anchor_create(client, &iface_id) < 0) {
+		fprintf(stderr, "error: setup: %s\n", strerror(errno));
+		goto end;
+	}
+
+	print_header();
+	if (bench_idle(client) < 0)
+		goto err;
+	if (opts.nexthops > 0 && bench_nexthops(client, iface_id) < 0)
+		goto err;
+	if (opts.nexthops > 0 && bench_nexthops6(client, iface_id) < 0)
+		goto err;
+	if (opts.single_routes > 0 && bench_routes_single(client, htonl(ANCHOR_REMOTE)) < 0)
+		goto err;
+	if (opts.routes > 0 && bench_routes_bulk(client, htonl(ANCHOR_REMOTE)) < 0)
+		goto err;
+	if (opts.ifaces > 0 && bench_ifaces(client) < 0)
+		goto err;
+
+	ret = EXIT_SUCCESS;
+err:
+	if (ret != EXIT_SUCCESS)
+		fprintf(stderr, "error: %s\n", strerror(errno));
+	if (gr_api_client_wait(client) < 0)
+		fprintf(stderr, "error: %s\n", strerror(errno));
+end:
+	if (iface_id != 0) {
+		// also flushes its address and next hops
+		del.iface_id = iface_id;
+		if (gr_api_client_send_recv(client, GR_INFRA_IFACE_DEL, sizeof(del), &del, NULL)
+		    < 0)
+			fprintf(stderr, "error: cleanup: %s\n", strerror(errno));
+	}
+	if (gr_api_client_disconnect(client) < 0) {
+		fprintf(stderr, "error: gr_disconnect: %s\n", strerror(errno));
+		ret = EXIT_FAILURE;
+	}
+
+	return ret;
+}
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_cli.h"
+
+#include <gr_api.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static STAILQ_HEAD(, cli_cache) caches = STAILQ_HEAD_INITIALIZER(caches);
+
+void register_cache(struct cli_cache *cache) {
+	STAILQ_INSERT_TAIL(&caches, cache, next);
+}
+
+// subscribed connection, NULL when caching is disabled
+static struct gr_api_client *sub;
+static uint64_t sub_seq;
+
+static void flush_all(void) {
+	struct cli_cache *cache;
+
+	STAILQ_FOREACH (cache, &caches, next)
+		cache->flush();
+}
+
+static void flush_type(uint32_t ev_type) {
+	struct cli_cache *cache;
+
+	STAILQ_FOREACH (cache, &caches, next) {
+		for (unsigned i = 0; i < cache->n_ev_types; i++) {
+			if (cache->ev_types[i] == ev_type) {
+				cache->flush();
+				break;
+			}
+		}
+	}
+}
+
+int cli_cache_enable(const struct gr_api_client *c) {
+	union {
+		struct sockaddr_un un;
+		struct sockaddr a;
+	} addr;
+	socklen_t addr_len = sizeof(addr);
+	const struct cli_cache *cache;
+	int err;
+
+	// The subscribed connection cannot be used for other requests. Open
+	// another one to the same socket path.
+	if (getpeername(gr_api_client_fd(c), &addr.a, &addr_len) < 0)
+		return -errno;
+	if ((sub = gr_api_client_connect(addr.un.sun_path)) == NULL)
+		return -errno;
+
+	// Subscribe to all event types before any event can be received.
+	// gr_api_client_send_recv() does not expect them.
+	STAILQ_FOREACH (cache, &caches, next) {
+		for (unsigned i = 0; i < cache->n_ev_types; i++) {
+			struct gr_api_event_subscribe_req req = {.ev_type = cache->ev_types[i]};
+			uint32_t t = GR_API_EVENT_SUBSCRIBE;
+			if (gr_api_client_send_recv(sub, t, sizeof(req), &req, NULL) < 0)
+				goto err;
+		}
+	}
+
+	return 0;
+err:
+	err = errno;
+	gr_api_client_disconnect(sub);
+	sub = NULL;
+	return errno_set(err);
+}
+
+void cli_cache_disable(void) {
+	gr_api_client_disconnect(sub);
+	sub = NULL;
+	sub_seq = 0;
+	flush_all();
+}
+
+bool cli_cache_sync(void) {
+	struct gr_api_event *ev;
+	struct pollfd pfd;
+
+	if (sub == NULL)
+		return false;
+
+	pfd.fd = gr_api_client_fd(sub);
+	pfd.events = POLLIN;
+
+	// process the events received since the last call without waiting
+	while (poll(&pfd, 1, 0) > 0) {
+		if (gr_api_client_event_recv(sub, &ev) < 0) {
+			// cannot know what changed anymore, stop caching
+			cli_cache_disable();
+			return false;
+		}
+		if (ev->seq != sub_seq + 1)
+			flush_all(); // events were lost
+		else
+			flush_type(ev->ev_type);
+		sub_seq = ev->seq;
+		free(ev);
+	}
+
+	return true;
+}
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_cli.h>
+
+#include <ecoli.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static STAILQ_HEAD(, cli_event_type) event_types = STAILQ_HEAD_INITIALIZER(event_types);
+
+void register_event_type(struct cli_event_type *type) {
+	STAILQ_INSERT_TAIL(&event_types, type, next);
+}
+
+static const struct cli_event_type *event_type_get(uint32_t ev_type) {
+	const struct cli_event_type *type;
+
+	STAILQ_FOREACH (type, &event_types, next) {
+		if (type->ev_type == ev_type)
+			return type;
+	}
+	return NULL;
+}
+
+static void event_print(const struct gr_api_client *c, const struct gr_api_event *ev) {
+	const struct cli_event_type *type = event_type_get(ev->ev_type);
+
+	printf("[%" PRIu64 "] ", ev->seq);
+	if (type != NULL) {
+		printf("%s ", type->name);
+		type->print(c, ev->obj);
+	} else {
+		printf("type=0x%08x len=%u", ev->ev_type, ev->obj_len);
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+static cmd_status_t events_show(const struct gr_api_client *c, const struct ec_pnode *) {
+	struct gr_api_event_subscribe_req req = {.ev_type = GR_EVENT_ALL};
+	union {
+		struct sockaddr_un un;
+		struct sockaddr a;
+	} addr;
+	socklen_t addr_len = sizeof(addr);
+	struct gr_api_event *ev = NULL;
+	struct gr_api_client *sub;
+	cmd_status_t ret = CMD_ERROR;
+	struct pollfd pfd;
+	uint64_t seq = 0;
+	int err;
+
+	// The subscribed connection cannot be used for other requests. Open
+	// another one to the same socket path.
+	if (getpeername(gr_api_client_fd(c), &addr.a, &addr_len) < 0)
+		return CMD_ERROR;
+	if ((sub = gr_api_client_connect(addr.un.sun_path)) == NULL)
+		return CMD_ERROR;
+	if (gr_api_client_send_recv(sub, GR_API_EVENT_SUBSCRIBE, sizeof(req), &req, NULL) < 0)
+		goto out;
+
+	pfd.fd = gr_api_client_fd(sub);
+	pfd.events = POLLIN;
+
+	for (;;) {
+		// poll() is always interrupted by signals, even with SA_RESTART
+		if (poll(&pfd, 1, -1) < 0) {
+			if (errno == EINTR)
+				ret = CMD_SUCCESS;
+			goto out;
+		}
+		if (gr_api_client_event_recv(sub, &ev) < 0)
+			goto out;
+		if (ev->seq != seq + 1)
+			printf("%" PRIu64 " events lost\n", ev->seq - seq - 1);
+		seq = ev->seq;
+		event_print(c, ev);
+		free(ev);
+		ev = NULL;
+	}
+out:
+	err = errno;
+	free(ev);
+	gr_api_client_disconnect(sub);
+	errno = err;
+	return ret;
+}
+
+static int ctx_init(struct ec_node *root) {
+	return CLI_COMMAND(
+		root, "events", events_show, "Print the state change events until interrupted."
+	);
+}
+
+static struct gr_cli_context ctx = {
+	.name = "events",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+}
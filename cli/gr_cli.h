@@ -25,6 +25,38 @@ void register_context(struct gr_cli_context *);
 
 void errorf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
 
+// Formatting of the events received with GR_API_EVENT_SUBSCRIBE.
+struct cli_event_type {
+	STAILQ_ENTRY(cli_event_type) next;
+	uint32_t ev_type;
+	const char *name;
+	// print the event object on the current line, without trailing new line
+	void (*print)(const struct gr_api_client *, const void *obj);
+};
+
+void register_event_type(struct cli_event_type *);
+
+// Data fetched from the API that is kept between commands in interactive mode,
+// for example completion candidates. The cached data is flushed as soon as one
+// of the ev_types events is received on a dedicated subscribed connection.
+struct cli_cache {
+	STAILQ_ENTRY(cli_cache) next;
+	const uint32_t *ev_types;
+	unsigned n_ev_types;
+	// free the cached data
+	void (*flush)(void);
+};
+
+void register_cache(struct cli_cache *);
+
+// Subscribe to the events of all registered caches.
+int cli_cache_enable(const struct gr_api_client *);
+// Close the subscribed connection and flush all caches.
+void cli_cache_disable(void);
+// Flush the caches of the events received so far. Returns true if the remaining
+// cached data can be used, always false when caching is not enabled.
+bool cli_cache_sync(void);
+
 typedef enum {
 	CMD_SUCCESS,
 	CMD_ERROR,
@@ -57,6 +89,14 @@ static inline int arg_u16(const struct ec_pnode *p, const char *id, uint16_t *va
 	return ret;
 }
 
+static inline int arg_u32(const struct ec_pnode *p, const char *id, uint32_t *val) {
+	uint64_t v;
+	int ret = arg_u64(p, id, &v);
+	if (ret == 0)
+		*val = v;
+	return ret;
+}
+
 #define CTX_END                                                                                    \
 	&(const struct ctx_arg) {                                                                  \
 		.name = NULL                                                                       \
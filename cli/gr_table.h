@@ -5,8 +5,31 @@
 #define _GR_TABLE
 
 struct libscols_line;
+struct libscols_table;
 
 int scols_line_sprintf(struct libscols_line *, int column, const char *fmt, ...)
 	__attribute__((format(printf, 3, 4)));
 
+// Output format of the tables, selected with grcli --output.
+typedef enum {
+	GR_TABLE_TEXT = 0, // aligned columns with headers
+	GR_TABLE_RAW, // one row per line, tab separated cells, no headers
+	GR_TABLE_JSON, // one JSON object per row and per line
+} gr_table_format_t;
+
+extern gr_table_format_t gr_table_format;
+
+// In the text format, lines are printed by chunks so that small tables are
+// aligned as a whole. The column widths of a chunk are the minimum widths of
+// the following ones.
+#define GR_TABLE_CHUNK_LINES 4096
+
+// Print and remove the lines of a table which is still being filled, for
+// example after each page of a paginated list. The raw and json formats print
+// all lines immediately and never compute column widths.
+int gr_table_flush(struct libscols_table *);
+
+// Print and remove all remaining lines of a table. Replaces scols_print_table().
+int gr_table_print(struct libscols_table *);
+
 #endif
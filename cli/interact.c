@@ -90,6 +90,10 @@ int interact(const struct gr_api_client *client, struct ec_node *cmdlist) {
 		goto end;
 	}
 
+	// Keep the completion candidates between key presses. Not fatal.
+	if (cli_cache_enable(client) < 0)
+		errorf("cli_cache_enable: %s", strerror(errno));
+
 	printf("Welcome to the graph router CLI version %s.\n", GROUT_VERSION);
 	printf("Use ? for help and <tab> for command completion.\n");
 
@@ -140,6 +144,7 @@ int interact(const struct gr_api_client *client, struct ec_node *cmdlist) {
 exit_ok:
 	ret = 0;
 end:
+	cli_cache_disable();
 	ec_free(line);
 	ec_node_free(shlex);
 	ec_editline_free(edit);
@@ -4,6 +4,7 @@
 #include "complete.h"
 #include "exec.h"
 #include "gr_cli.h"
+#include "gr_table.h"
 #include "interact.h"
 #include "log.h"
 
@@ -15,15 +16,17 @@
 #include <errno.h>
 #include <getopt.h>
 #include <locale.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/queue.h>
 #include <unistd.h>
 
 // Please keep options/flags in alphabetical order.
 
 static void usage(const char *prog) {
-	printf("Usage: %s [-e] [-f PATH] [-h] [-s PATH] [-V] [-x] ...\n", prog);
+	printf("Usage: %s [-e] [-f PATH] [-h] [-o FORMAT] [-s PATH] [-V] [-x] ...\n", prog);
 	printf("       %s -c|--bash-complete\n", prog);
 }
 
@@ -35,6 +38,9 @@ static void help(void) {
 	puts("  -e, --err-exit             Abort on first error.");
 	puts("  -f PATH, --file PATH       Read commands from file instead of stdin.");
 	puts("  -h, --help                 Show this help message and exit.");
+	puts("  -o FORMAT, --output FORMAT Output format of tables: text (default), raw");
+	puts("                             (tab separated, no headers) or json (one");
+	puts("                             object per line).");
 	puts("  -s PATH, --socket PATH     Path to the control plane API socket.");
 	puts("                             Default: GROUT_SOCK_PATH from env or");
 	printf("                             %s).\n", GR_DEFAULT_SOCK_PATH);
@@ -58,11 +64,12 @@ static struct gr_cli_opts opts;
 static int parse_args(int argc, char **argv) {
 	int c;
 
-#define FLAGS ":ef:hs:Vx"
+#define FLAGS ":ef:ho:s:Vx"
 	static struct option long_options[] = {
 		{"err-exit", no_argument, NULL, 'e'},
 		{"file", required_argument, NULL, 'f'},
 		{"help", no_argument, NULL, 'h'},
+		{"output", required_argument, NULL, 'o'},
 		{"socket", required_argument, NULL, 's'},
 		{"version", no_argument, NULL, 'V'},
 		{"trace-commands", no_argument, NULL, 'x'},
@@ -90,6 +97,18 @@ static int parse_args(int argc, char **argv) {
 			usage(argv[0]);
 			help();
 			return -1;
+		case 'o':
+			if (strcmp(optarg, "text") == 0) {
+				gr_table_format = GR_TABLE_TEXT;
+			} else if (strcmp(optarg, "raw") == 0) {
+				gr_table_format = GR_TABLE_RAW;
+			} else if (strcmp(optarg, "json") == 0) {
+				gr_table_format = GR_TABLE_JSON;
+			} else {
+				errorf("--output %s: invalid format", optarg);
+				return errno_set(EINVAL);
+			}
+			break;
 		case 's':
 			opts.sock_path = optarg;
 			break;
@@ -121,6 +140,15 @@ static int parse_args(int argc, char **argv) {
 	return optind;
 }
 
+static unsigned pipeline_errors;
+
+static void pipeline_cb(void *cb_arg, uint32_t status, uint32_t, const void *) {
+	if (status == 0)
+		return;
+	errorf("line %u: command failed: %s", (unsigned)(uintptr_t)cb_arg, strerror(status));
+	pipeline_errors++;
+}
+
 int main(int argc, char **argv) {
 	struct gr_api_client *client = NULL;
 	struct ec_node *cmdlist = NULL;
@@ -167,13 +195,27 @@ int main(int argc, char **argv) {
 			goto end;
 	} else {
 		char buf[BUFSIZ];
+		unsigned line = 0;
 		while (fgets(buf, sizeof(buf), opts.cmds_file)) {
+			line++;
 			if (opts.trace_commands)
 				trace_cmd(buf);
+			// Do not wait for the responses of the requests that do not
+			// return any data. Their errors are reported asynchronously.
+			gr_api_client_pipeline(client, pipeline_cb, (void *)(uintptr_t)line);
 			status = exec_line(client, cmdlist, buf);
 			if (print_cmd_status(status) < 0 && opts.err_exit)
 				goto end;
+			if (pipeline_errors > 0 && opts.err_exit)
+				goto end;
+		}
+		gr_api_client_pipeline(client, NULL, NULL);
+		if (gr_api_client_wait(client) < 0) {
+			errorf("gr_api_client_wait: %s", strerror(errno));
+			goto end;
 		}
+		if (pipeline_errors > 0 && opts.err_exit)
+			goto end;
 	}
 
 	ret = EXIT_SUCCESS;
@@ -5,7 +5,13 @@
 
 #include <libsmartcols.h>
 
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
 #include <stdarg.h>
+#include <stdio.h>
+
+gr_table_format_t gr_table_format;
 
 int scols_line_sprintf(struct libscols_line *line, int column, const char *fmt, ...) {
 	char buf[256];
@@ -21,3 +27,96 @@ int scols_line_sprintf(struct libscols_line *line, int column, const char *fmt,
 
 	return scols_line_set_data(line, column, buf);
 }
+
+static void json_string(const char *s, bool lower) {
+	putchar('"');
+	for (; *s != '\0'; s++) {
+		switch (*s) {
+		case '"':
+			fputs("\\\"", stdout);
+			break;
+		case '\\':
+			fputs("\\\\", stdout);
+			break;
+		default:
+			if ((unsigned char)*s < 0x20)
+				printf("\\u%04x", *s);
+			else
+				putchar(lower ? tolower(*s) : *s);
+		}
+	}
+	putchar('"');
+}
+
+static const char *cell_data(struct libscols_cell *cell) {
+	const char *data = cell != NULL ? scols_cell_get_data(cell) : NULL;
+	return data != NULL ? data : "";
+}
+
+static void print_line(struct libscols_table *table, struct libscols_line *line) {
+	size_t n_cols = scols_table_get_ncols(table);
+
+	for (size_t i = 0; i < n_cols; i++) {
+		const char *data = cell_data(scols_line_get_cell(line, i));
+		if (gr_table_format == GR_TABLE_JSON) {
+			struct libscols_column *col = scols_table_get_column(table, i);
+			putchar(i == 0 ? '{' : ',');
+			json_string(cell_data(scols_column_get_header(col)), true);
+			putchar(':');
+			json_string(data, false);
+		} else {
+			if (i > 0)
+				putchar('\t');
+			fputs(data, stdout);
+		}
+	}
+	if (gr_table_format == GR_TABLE_JSON)
+		putchar('}');
+	putchar('\n');
+}
+
+// Print lines one by one, without any column width computation.
+static int print_stream(struct libscols_table *table) {
+	struct libscols_iter *iter = scols_new_iter(SCOLS_ITER_FORWARD);
+	struct libscols_line *line;
+
+	if (iter == NULL)
+		return -ENOMEM;
+	while (scols_table_next_line(table, iter, &line) == 0)
+		print_line(table, line);
+	scols_free_iter(iter);
+	scols_table_remove_lines(table);
+
+	return 0;
+}
+
+static int print_text(struct libscols_table *table) {
+	int ret = scols_print_table(table);
+
+	// keep the next chunks aligned with this one
+	for (size_t i = 0; i < scols_table_get_ncols(table); i++) {
+		struct libscols_column *col = scols_table_get_column(table, i);
+		scols_column_set_whint(col, scols_column_get_width(col));
+	}
+	scols_table_enable_noheadings(table, 1);
+	scols_table_remove_lines(table);
+
+	return ret;
+}
+
+int gr_table_flush(struct libscols_table *table) {
+	if (gr_table_format != GR_TABLE_TEXT)
+		return print_stream(table);
+	if (scols_table_get_nlines(table) >= GR_TABLE_CHUNK_LINES)
+		return print_text(table);
+	return 0;
+}
+
+int gr_table_print(struct libscols_table *table) {
+	if (gr_table_format != GR_TABLE_TEXT)
+		return print_stream(table);
+	// print the headers of empty tables
+	if (scols_table_get_nlines(table) > 0 || !scols_table_is_noheadings(table))
+		return print_text(table);
+	return 0;
+}
@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_cli.h>
+
+static cmd_status_t transaction_begin(const struct gr_api_client *c, const struct ec_pnode *) {
+	if (gr_api_client_send_recv(c, GR_API_TRANSACTION_BEGIN, 0, NULL, NULL) < 0)
+		return CMD_ERROR;
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t transaction_commit(const struct gr_api_client *c, const struct ec_pnode *) {
+	if (gr_api_client_send_recv(c, GR_API_TRANSACTION_COMMIT, 0, NULL, NULL) < 0)
+		return CMD_ERROR;
+	return CMD_SUCCESS;
+}
+
+#define TRANSACTION_CTX(root) CLI_CONTEXT(root, CTX_ARG("transaction", "Group config changes."))
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		TRANSACTION_CTX(root),
+		"begin",
+		transaction_begin,
+		"Defer dataplane updates until the transaction is committed."
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		TRANSACTION_CTX(root),
+		"commit",
+		transaction_commit,
+		"Apply the deferred dataplane updates."
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "transaction",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+}
@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "api_pool.h"
+#include "control.h"
+
+#include <gr_log.h>
+#include <gr_tracepoint.h>
+
+#include <event2/event.h>
+#include <rte_cycles.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/queue.h>
+
+STAILQ_HEAD(api_jobs, api_job);
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+static struct api_jobs todo = STAILQ_HEAD_INITIALIZER(todo);
+static struct api_jobs done = STAILQ_HEAD_INITIALIZER(done);
+static bool stopping;
+
+static pthread_t *threads;
+static unsigned n_threads;
+static struct event *done_ev;
+static api_job_done_cb done_cb;
+
+static void *api_thread(void *) {
+	struct api_job *job;
+	uint64_t start;
+
+	pthread_mutex_lock(&pool_lock);
+	for (;;) {
+		while (!stopping && STAILQ_EMPTY(&todo))
+			pthread_cond_wait(&pool_cond, &pool_lock);
+		if (stopping)
+			break;
+		job = STAILQ_FIRST(&todo);
+		STAILQ_REMOVE_HEAD(&todo, next);
+		pthread_mutex_unlock(&pool_lock);
+
+		LOG(DEBUG,
+		    "request: id=%u type=0x%08x '%s' len=%u",
+		    job->req.id,
+		    job->req.type,
+		    job->handler->name,
+		    job->req.payload_len);
+
+		config_read_lock();
+		start = rte_rdtsc();
+		gr_trace_api_request_start(job->req.id, job->req.type);
+		job->ret = job->handler->callback(job->req_payload, &job->resp_payload);
+		gr_trace_api_request_end(
+			job->req.id, job->req.type, job->ret.status, rte_rdtsc() - start
+		);
+		config_unlock();
+
+		pthread_mutex_lock(&pool_lock);
+		STAILQ_INSERT_TAIL(&done, job, next);
+		event_active(done_ev, 0, 0);
+	}
+	pthread_mutex_unlock(&pool_lock);
+
+	return NULL;
+}
+
+static void api_pool_done(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	struct api_jobs jobs = STAILQ_HEAD_INITIALIZER(jobs);
+	struct api_job *job;
+
+	pthread_mutex_lock(&pool_lock);
+	STAILQ_CONCAT(&jobs, &done);
+	pthread_mutex_unlock(&pool_lock);
+
+	while ((job = STAILQ_FIRST(&jobs)) != NULL) {
+		STAILQ_REMOVE_HEAD(&jobs, next);
+		done_cb(job);
+	}
+}
+
+int api_pool_start(struct event_base *base, unsigned n, api_job_done_cb cb) {
+	char name[16];
+	int ret;
+
+	if (n == 0)
+		return 0;
+
+	done_cb = cb;
+	done_ev = event_new(base, -1, EV_FINALIZE, api_pool_done, NULL);
+	if (done_ev == NULL)
+		return errno_log(ENOMEM, "event_new");
+
+	if ((threads = calloc(n, sizeof(*threads))) == NULL)
+		return errno_log(ENOMEM, "calloc");
+
+	stopping = false;
+	for (n_threads = 0; n_threads < n; n_threads++) {
+		ret = pthread_create(&threads[n_threads], NULL, api_thread, NULL);
+		if (ret != 0) {
+			api_pool_stop();
+			return errno_log(ret, "pthread_create");
+		}
+		snprintf(name, sizeof(name), "grout:api-%u", n_threads);
+		pthread_setname_np(threads[n_threads], name);
+	}
+
+	LOG(INFO, "%u api threads started", n_threads);
+
+	return 0;
+}
+
+bool api_pool_running(void) {
+	return n_threads > 0 && !stopping;
+}
+
+void api_pool_submit(struct api_job *job) {
+	pthread_mutex_lock(&pool_lock);
+	STAILQ_INSERT_TAIL(&todo, job, next);
+	pthread_cond_signal(&pool_cond);
+	pthread_mutex_unlock(&pool_lock);
+}
+
+void api_pool_stop(void) {
+	struct api_job *job;
+
+	pthread_mutex_lock(&pool_lock);
+	stopping = true;
+	pthread_cond_broadcast(&pool_cond);
+	pthread_mutex_unlock(&pool_lock);
+
+	for (unsigned i = 0; i < n_threads; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+	threads = NULL;
+	n_threads = 0;
+
+	while ((job = STAILQ_FIRST(&todo)) != NULL) {
+		STAILQ_REMOVE_HEAD(&todo, next);
+		job->ret = api_out(ECANCELED, 0);
+		STAILQ_INSERT_TAIL(&done, job, next);
+	}
+	if (done_ev != NULL) {
+		api_pool_done(-1, 0, NULL);
+		event_free(done_ev);
+		done_ev = NULL;
+	}
+}
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_API_POOL
+#define _GR_API_POOL
+
+#include <gr_api.h>
+#include <gr_control.h>
+
+#include <event2/event.h>
+
+#include <stdbool.h>
+#include <sys/queue.h>
+
+// Read-only API requests processed outside of the event loop thread.
+struct api_job {
+	const struct gr_api_handler *handler;
+	struct gr_api_request req;
+	void *req_payload;
+	void *resp_payload;
+	struct api_out ret;
+	void *priv;
+	STAILQ_ENTRY(api_job) next;
+};
+
+// Invoked from the event loop thread for each completed job.
+typedef void (*api_job_done_cb)(struct api_job *);
+
+int api_pool_start(struct event_base *, unsigned n_threads, api_job_done_cb);
+
+bool api_pool_running(void);
+
+void api_pool_submit(struct api_job *);
+
+// Wait for the running jobs. The pending ones are completed with ECANCELED.
+void api_pool_stop(void);
+
+#endif
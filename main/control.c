@@ -9,36 +9,67 @@
 #include <gr_stb_ds.h>
 
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/queue.h>
 
-static STAILQ_HEAD(, gr_api_handler) handlers = STAILQ_HEAD_INITIALIZER(handlers);
+// Indexed by module and by request ID within the module, see REQUEST_TYPE().
+// The second level arrays are grown when handlers are registered.
+static const struct gr_api_handler **handlers[UINT16_MAX + 1];
 
 void gr_register_api_handler(struct gr_api_handler *handler) {
-	const struct gr_api_handler *h;
+	const struct gr_api_handler ***table;
+	uint16_t id;
 
 	assert(handler != NULL);
 	assert(handler->callback != NULL);
 	assert(handler->name != NULL);
-	STAILQ_FOREACH (h, &handlers, entries) {
-		if (h->request_type == handler->request_type)
-			ABORT("duplicate api handler type=0x%08x '%s'",
-			      handler->request_type,
-			      handler->name);
+
+	table = &handlers[handler->request_type >> 16];
+	id = handler->request_type & 0xffff;
+	if (id < arrlen(*table) && (*table)[id] != NULL)
+		ABORT("duplicate api handler type=0x%08x '%s'",
+		      handler->request_type,
+		      handler->name);
+	if (id >= arrlen(*table)) {
+		unsigned len = arrlen(*table);
+		arrsetlen(*table, id + 1); // NOLINT
+		memset(&(*table)[len], 0, (id + 1 - len) * sizeof(**table));
 	}
-	STAILQ_INSERT_TAIL(&handlers, handler, entries);
+	(*table)[id] = handler;
 }
 
 const struct gr_api_handler *lookup_api_handler(const struct gr_api_request *req) {
-	const struct gr_api_handler *handler;
+	const struct gr_api_handler **table = handlers[req->type >> 16];
+	uint16_t id = req->type & 0xffff;
+
+	if (id >= arrlen(table))
+		return NULL;
 
-	STAILQ_FOREACH (handler, &handlers, entries) {
-		if (handler->request_type == req->type)
-			return handler;
+	return table[id];
+}
+
+uint32_t api_request_check(const struct gr_api_handler *h, const void *payload, uint32_t len) {
+	if (h->check == NULL)
+		return 0;
+	return h->check(payload, len);
+}
+
+void api_iov_resp_free(struct api_iov_resp *resp) {
+	for (unsigned i = 0; i < resp->n_iov; i++) {
+		if (resp->iov[i].free != NULL)
+			resp->iov[i].free(resp->iov[i].base);
 	}
+	free(resp);
+}
 
-	return NULL;
+void api_response_free(const struct gr_api_handler *handler, void *response) {
+	if (response != NULL && handler != NULL && handler->flags & GR_API_F_IOV)
+		api_iov_resp_free(response);
+	else
+		free(response);
 }
 
 static STAILQ_HEAD(, gr_module) modules = STAILQ_HEAD_INITIALIZER(modules);
@@ -124,3 +155,80 @@ void gr_modules_dp_fini(void) {
 		}
 	}
 }
+
+void gr_modules_batch_begin(void) {
+	struct gr_module *mod;
+
+	STAILQ_FOREACH (mod, &modules, entries) {
+		if (mod->batch_begin != NULL)
+			mod->batch_begin();
+	}
+}
+
+void gr_modules_batch_end(void) {
+	struct gr_module *mod;
+
+	STAILQ_FOREACH (mod, &modules, entries) {
+		if (mod->batch_end != NULL)
+			mod->batch_end();
+	}
+}
+
+// Writers are preferred so that a steady stream of read-only requests cannot
+// delay configuration changes and event callbacks indefinitely.
+static pthread_rwlock_t config_lock = PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP;
+
+void config_read_lock(void) {
+	pthread_rwlock_rdlock(&config_lock);
+}
+
+void config_write_lock(void) {
+	pthread_rwlock_wrlock(&config_lock);
+}
+
+void config_unlock(void) {
+	pthread_rwlock_unlock(&config_lock);
+}
+
+struct locked_event {
+	event_callback_fn cb;
+	void *arg;
+};
+
+static void locked_event_cb(evutil_socket_t fd, short what, void *priv) {
+	const struct locked_event *e = priv;
+	event_callback_fn cb = e->cb;
+	void *arg = e->arg;
+
+	// The callback may free its own event.
+	config_write_lock();
+	cb(fd, what, arg);
+	config_unlock();
+}
+
+struct event *gr_event_new(
+	struct event_base *base,
+	evutil_socket_t fd,
+	short what,
+	event_callback_fn cb,
+	void *arg
+) {
+	struct locked_event *e;
+	struct event *ev;
+
+	if ((e = malloc(sizeof(*e))) == NULL)
+		return errno_set_null(ENOMEM);
+	e->cb = cb;
+	e->arg = arg;
+
+	if ((ev = event_new(base, fd, what, locked_event_cb, e)) == NULL)
+		free(e);
+
+	return ev;
+}
+
+void gr_event_free(struct event *ev) {
+	void *e = event_get_callback_arg(ev);
+	event_free(ev);
+	free(e);
+}
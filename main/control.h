@@ -11,8 +11,25 @@
 
 const struct gr_api_handler *lookup_api_handler(const struct gr_api_request *);
 
+// Run the check function of the handler, if any. Return 0 or an errno value.
+uint32_t api_request_check(const struct gr_api_handler *, const void *payload, uint32_t len);
+
+void api_iov_resp_free(struct api_iov_resp *);
+
+// Release a response returned by a handler.
+void api_response_free(const struct gr_api_handler *, void *response);
+
 void modules_init(struct event_base *);
 
 void modules_fini(struct event_base *);
 
+// Read-only API handlers run with the read lock held. Other handlers, module
+// batches and the callbacks of events created with gr_event_new() run with
+// the write lock held.
+void config_read_lock(void);
+
+void config_write_lock(void);
+
+void config_unlock(void);
+
 #endif
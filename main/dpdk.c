@@ -7,16 +7,25 @@
 #include <gr_api.h>
 #include <gr_errno.h>
 #include <gr_log.h>
+#include <gr_macro.h>
 #include <gr_stb_ds.h>
 
+#include <event2/event.h>
+#include <numa.h>
+#include <rte_cycles.h>
 #include <rte_eal.h>
 #include <rte_errno.h>
+#include <rte_lcore.h>
 #include <rte_log.h>
+#include <rte_malloc.h>
 #include <rte_mempool.h>
+#include <rte_ring.h>
 #include <rte_version.h>
 
+#include <inttypes.h>
 #include <pthread.h>
 #include <sched.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <syslog.h>
 
@@ -92,6 +101,178 @@ int dpdk_log_init(const struct gr_args *args) {
 	return 0;
 }
 
+#define LOG_RING_SIZE 512 // records per thread, must be a power of 2
+#define LOG_DRAIN_BURST 32
+#define LOG_DRAIN_PERIOD_US 100000
+
+struct log_record {
+	uint8_t level;
+	uint8_t reserved;
+	uint16_t len;
+	char msg[252]; // longer messages are truncated
+};
+
+static_assert(sizeof(struct log_record) % 4 == 0);
+
+struct gr_log_ring {
+	struct rte_ring *ring; // single producer, single consumer
+	// only written by the owner thread
+	uint64_t lost; // ring full
+	uint64_t suppressed; // rate limited
+	// only accessed by the control plane thread
+	uint64_t lost_reported;
+	uint64_t suppressed_reported;
+};
+
+__thread struct gr_log_ring *gr_log_ring;
+// Rings are kept when their thread stops and reused by the next thread which
+// gets the same lcore id.
+static struct gr_log_ring *log_rings[RTE_MAX_LCORE];
+static struct event *log_drain_ev;
+
+void gr_log_push(uint32_t level, struct gr_log_ratelimit *rl, const char *fmt, ...) {
+	struct gr_log_ring *r = gr_log_ring;
+	struct log_record rec;
+	uint64_t now;
+	va_list ap;
+	int n;
+
+	if (!rte_log_can_log(gr_rte_log_type, level))
+		return;
+
+	va_start(ap, fmt);
+	if (level <= RTE_LOG_CRIT) {
+		// the process is about to abort, do not defer the message
+		rte_vlog(level, gr_rte_log_type, fmt, ap);
+		va_end(ap);
+		return;
+	}
+
+	// Call sites are shared by all workers. A new window may be started
+	// concurrently by several of them, the limit is approximate.
+	now = rte_rdtsc();
+	if (now - __atomic_load_n(&rl->start, __ATOMIC_RELAXED) > rte_get_tsc_hz()) {
+		__atomic_store_n(&rl->start, now, __ATOMIC_RELAXED);
+		__atomic_store_n(&rl->count, 0, __ATOMIC_RELAXED);
+	}
+	if (__atomic_fetch_add(&rl->count, 1, __ATOMIC_RELAXED) >= GR_LOG_RATELIMIT_BURST) {
+		__atomic_store_n(&r->suppressed, r->suppressed + 1, __ATOMIC_RELAXED);
+		va_end(ap);
+		return;
+	}
+
+	n = vsnprintf(rec.msg, sizeof(rec.msg), fmt, ap);
+	va_end(ap);
+	if (n < 0)
+		return;
+	rec.level = level;
+	rec.reserved = 0;
+	rec.len = RTE_MIN((size_t)n, sizeof(rec.msg) - 1);
+	if ((size_t)n >= sizeof(rec.msg))
+		rec.msg[rec.len - 1] = '\n'; // truncated
+
+	if (rte_ring_sp_enqueue_elem(r->ring, &rec, sizeof(rec)) < 0)
+		__atomic_store_n(&r->lost, r->lost + 1, __ATOMIC_RELAXED);
+}
+
+int gr_log_async_start(void) {
+	unsigned lcore_id = rte_lcore_id();
+	char name[RTE_RING_NAMESIZE];
+	struct gr_log_ring *r;
+
+	if (lcore_id == LCORE_ID_ANY)
+		return errno_set(EINVAL);
+
+	if ((r = log_rings[lcore_id]) == NULL) {
+		r = rte_zmalloc_socket(__func__, sizeof(*r), RTE_CACHE_LINE_SIZE, rte_socket_id());
+		if (r == NULL)
+			return errno_set(ENOMEM);
+		snprintf(name, sizeof(name), "log_%u", lcore_id);
+		r->ring = rte_ring_create_elem(
+			name,
+			sizeof(struct log_record),
+			LOG_RING_SIZE,
+			rte_socket_id(),
+			RING_F_SP_ENQ | RING_F_SC_DEQ
+		);
+		if (r->ring == NULL) {
+			rte_free(r);
+			return errno_set(rte_errno);
+		}
+		__atomic_store_n(&log_rings[lcore_id], r, __ATOMIC_RELEASE);
+	}
+	gr_log_ring = r;
+
+	return 0;
+}
+
+void gr_log_async_stop(void) {
+	gr_log_ring = NULL;
+}
+
+static void log_drain(struct gr_log_ring *r, unsigned lcore_id) {
+	struct log_record records[LOG_DRAIN_BURST];
+	uint64_t lost, suppressed;
+	unsigned n;
+
+	do {
+		n = rte_ring_sc_dequeue_burst_elem(
+			r->ring, records, sizeof(records[0]), LOG_DRAIN_BURST, NULL
+		);
+		for (unsigned i = 0; i < n; i++) {
+			const struct log_record *rec = &records[i];
+			rte_log(rec->level, gr_rte_log_type, "%.*s", rec->len, rec->msg);
+		}
+	} while (n > 0);
+
+	lost = __atomic_load_n(&r->lost, __ATOMIC_RELAXED);
+	suppressed = __atomic_load_n(&r->suppressed, __ATOMIC_RELAXED);
+	if (lost != r->lost_reported || suppressed != r->suppressed_reported) {
+		LOG(WARNING,
+		    "lcore %u: %" PRIu64 " messages lost, %" PRIu64 " rate limited",
+		    lcore_id,
+		    lost - r->lost_reported,
+		    suppressed - r->suppressed_reported);
+		r->lost_reported = lost;
+		r->suppressed_reported = suppressed;
+	}
+}
+
+static void log_drain_cb(evutil_socket_t, short, void *) {
+	struct gr_log_ring *r;
+
+	for (unsigned i = 0; i < ARRAY_DIM(log_rings); i++) {
+		if ((r = __atomic_load_n(&log_rings[i], __ATOMIC_ACQUIRE)) != NULL)
+			log_drain(r, i);
+	}
+}
+
+int dpdk_log_drain_init(struct event_base *base) {
+	struct timeval tv = {.tv_usec = LOG_DRAIN_PERIOD_US};
+
+	log_drain_ev = event_new(base, -1, EV_PERSIST, log_drain_cb, NULL);
+	if (log_drain_ev == NULL || event_add(log_drain_ev, &tv) < 0)
+		return errno_log(ENOMEM, "event_new");
+
+	return 0;
+}
+
+void dpdk_log_drain_fini(void) {
+	if (log_drain_ev != NULL) {
+		event_free(log_drain_ev);
+		log_drain_ev = NULL;
+	}
+	// all workers are stopped, flush what they logged last
+	log_drain_cb(-1, 0, NULL);
+	for (unsigned i = 0; i < ARRAY_DIM(log_rings); i++) {
+		if (log_rings[i] != NULL) {
+			rte_ring_free(log_rings[i]->ring);
+			rte_free(log_rings[i]);
+			log_rings[i] = NULL;
+		}
+	}
+}
+
 // Returns human readable representation of a cpuset. The output format is
 // a list of CPUs with ranges (for example, "0,1,3-9").
 static int cpuset_format(char *buf, size_t len, cpu_set_t *set) {
@@ -129,6 +310,37 @@ static int cpuset_format(char *buf, size_t len, cpu_set_t *set) {
 	return 0;
 }
 
+// Restrict the CPU affinity of the calling thread to the housekeeping CPUs.
+// All threads created afterwards inherit it, including the EAL interrupt,
+// multi-process and telemetry threads.
+static int housekeeping_affinity(const char *list, cpu_set_t *cpus) {
+	struct bitmask *mask;
+	cpu_set_t allowed;
+	int ret;
+
+	if ((mask = numa_parse_cpustring_all(list)) == NULL) {
+		LOG(ERR, "invalid housekeeping CPU list: %s", list);
+		return errno_set(EINVAL);
+	}
+	allowed = *cpus;
+	CPU_ZERO(cpus);
+	for (unsigned cpu = 0; cpu < mask->size && cpu < CPU_SETSIZE; cpu++) {
+		if (numa_bitmask_isbitset(mask, cpu))
+			CPU_SET(cpu, cpus);
+	}
+	numa_bitmask_free(mask);
+
+	CPU_AND(cpus, cpus, &allowed);
+	if (CPU_COUNT(cpus) == 0) {
+		LOG(ERR, "no allowed CPU in housekeeping list: %s", list);
+		return errno_set(EINVAL);
+	}
+	if (!!(ret = pthread_setaffinity_np(pthread_self(), sizeof(*cpus), cpus)))
+		return errno_log(ret, "pthread_setaffinity_np");
+
+	return 0;
+}
+
 int dpdk_init(const struct gr_args *args) {
 	char affinity[BUFSIZ] = "";
 	char main_lcore[32] = "";
@@ -138,6 +350,11 @@ int dpdk_init(const struct gr_args *args) {
 
 	if (!!(ret = pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus)))
 		goto end;
+	if (args->housekeeping_cpus != NULL
+	    && housekeeping_affinity(args->housekeeping_cpus, &cpus) < 0) {
+		ret = errno;
+		goto end;
+	}
 	cpuset_format(affinity, sizeof(affinity), &cpus);
 
 	for (unsigned cpu = 0; cpu < CPU_SETSIZE; cpu++) {
@@ -6,7 +6,12 @@
 
 #include "gr.h"
 
+#include <event2/event.h>
+
 int dpdk_log_init(const struct gr_args *);
+// Drain the messages of the threads that log asynchronously, see gr_log_ring.
+int dpdk_log_drain_init(struct event_base *);
+void dpdk_log_drain_fini(void);
 int dpdk_init(const struct gr_args *);
 void dpdk_fini(void);
 
@@ -6,11 +6,29 @@
 
 #include <stdbool.h>
 
+#define GR_DEFAULT_STATS_INTERVAL 256
+#define GR_MAX_TX_FLUSH_DELAY 1000 // us
+#define GR_DEFAULT_API_THREADS 2
+#define GR_MAX_API_THREADS 64
+
 struct gr_args {
 	const char *api_sock_path;
+	const char *stats_shm_name;
+	const char *metrics_listen;
+	const char *snapshot_path;
+	const char *autoscale_cpus;
+	const char *housekeeping_cpus;
+	unsigned stats_interval;
+	unsigned tx_flush_us;
+	unsigned mempool_cache;
 	unsigned log_level;
+	unsigned api_threads;
 	bool test_mode;
 	bool poll_mode;
+	bool balance_rxqs;
+	bool flow_cache;
+	bool port_pools;
+	bool rx_interrupts;
 };
 
 const struct gr_args *gr_args(void);
@@ -6,6 +6,8 @@
 
 #include <event2/event.h>
 
+#include <errno.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <sys/queue.h>
 
@@ -21,15 +23,59 @@ static inline struct api_out api_out(uint32_t status, uint32_t len) {
 
 typedef struct api_out (*gr_api_handler_func)(const void *request, void **response);
 
+// The request changes the configuration, it is saved in the snapshot file.
+#define GR_API_F_CONFIG (1 << 0)
+// The request does not modify any state. It may be processed by an API thread,
+// concurrently with other read-only requests but never with configuration
+// changes or gr_event_new() callbacks. It must not call gr_event_push().
+#define GR_API_F_READ (1 << 1)
+// The response is a struct api_iov_resp, see below.
+#define GR_API_F_IOV (1 << 2)
+
+// Return 0 if a request of len bytes is complete, an errno value otherwise.
+typedef uint32_t (*gr_api_check_func)(const void *request, uint32_t len);
+
 struct gr_api_handler {
 	const char *name;
 	uint32_t request_type;
 	gr_api_handler_func callback;
-	STAILQ_ENTRY(gr_api_handler) entries;
+	// Optional, called before the callback. Required for requests that end
+	// with a flexible array, see GR_API_FLEX_CHECK().
+	gr_api_check_func check;
+	uint32_t flags; // GR_API_F_*
 };
 
+// Define a check function for requests made of a fixed size struct followed
+// by an array of count entries. The counter is only read if the fixed part of
+// the request was received.
+#define GR_API_FLEX_CHECK(func_name, req_type, count, array)                                      \
+	static uint32_t func_name(const void *request, uint32_t len) {                             \
+		const struct req_type *req = request;                                              \
+		if (len < sizeof(*req))                                                            \
+			return EINVAL;                                                             \
+		if (len != sizeof(*req) + (size_t)req->count * sizeof(req->array[0]))             \
+			return EINVAL;                                                             \
+		return 0;                                                                          \
+	}
+
 void gr_register_api_handler(struct gr_api_handler *);
 
+// Response made of several buffers, for handlers with GR_API_F_IOV. The
+// buffers are referenced by the socket output buffer and written with writev()
+// without being copied into a single allocation. Each buffer is released with
+// its free function (if not NULL) once the whole response has been sent. The
+// response length is the sum of all buffer lengths.
+struct api_iov {
+	void *base;
+	uint32_t len;
+	void (*free)(void *base);
+};
+
+struct api_iov_resp {
+	unsigned n_iov;
+	struct api_iov iov[/* n_iov */];
+};
+
 struct gr_module {
 	const char *name;
 	int init_prio;
@@ -38,6 +84,10 @@ struct gr_module {
 	void (*fini)(struct event_base *);
 	void (*init_dp)(void);
 	void (*fini_dp)(void);
+	// Called around a series of configuration requests. Expensive updates
+	// (e.g. worker graph reloads) may be deferred until the batch ends.
+	void (*batch_begin)(void);
+	void (*batch_end)(void);
 	STAILQ_ENTRY(gr_module) entries;
 };
 
@@ -47,4 +97,28 @@ void gr_modules_dp_init(void);
 
 void gr_modules_dp_fini(void);
 
+// Batches may be nested, only the outermost one has an effect.
+void gr_modules_batch_begin(void);
+
+void gr_modules_batch_end(void);
+
+// Same as event_new() but the callback never runs concurrently with read-only
+// API handlers. All events which access the configuration or datapath state
+// must be created with this function. They must be freed with gr_event_free().
+struct event *gr_event_new(
+	struct event_base *,
+	evutil_socket_t fd,
+	short what,
+	event_callback_fn cb,
+	void *arg
+);
+
+void gr_event_free(struct event *);
+
+// Notify the API clients subscribed to ev_type. The object is copied and sent
+// when the current event loop callback returns. If key is not NULL, a pending
+// event of the same type and key is replaced. Must be called from the main
+// lcore.
+void gr_event_push(uint32_t ev_type, const void *key, const void *obj, uint32_t len);
+
 #endif
@@ -6,18 +6,59 @@
 
 #include <gr_errno.h>
 
+#include <rte_branch_prediction.h>
 #include <rte_errno.h>
 #include <rte_log.h>
 
+#include <stdint.h>
+
 extern int gr_rte_log_type;
 #define RTE_LOGTYPE_GROUT gr_rte_log_type
 
+// Max number of messages logged per second from the same call site by threads
+// that log asynchronously.
+#define GR_LOG_RATELIMIT_BURST 10
+
+struct gr_log_ratelimit {
+	uint64_t start; // TSC of the current one second window
+	uint32_t count;
+};
+
+struct gr_log_ring;
+
+// Not NULL in datapath workers. Their messages are sent to a lock-free ring
+// drained by the control plane thread, a slow stderr or syslog never stalls
+// them. Messages are dropped when the ring is full or when the rate limit of
+// their call site is exceeded.
+extern __thread struct gr_log_ring *gr_log_ring;
+
+// Format and enqueue a message in the ring of the calling thread.
+void gr_log_push(uint32_t level, struct gr_log_ratelimit *, const char *fmt, ...)
+	__attribute__((format(printf, 3, 4)));
+
+// Log asynchronously from the calling thread. Must be called after
+// rte_thread_register().
+int gr_log_async_start(void);
+void gr_log_async_stop(void);
+
 #define LOG(level, fmt, ...)                                                                       \
 	do {                                                                                       \
 		static_assert(                                                                     \
 			!__builtin_strchr(fmt, '\n'), "This log format string contains a \\n"      \
 		);                                                                                 \
-		RTE_LOG(level, GROUT, "%s: " fmt "\n", __func__ __VA_OPT__(, ) __VA_ARGS__);       \
+		if (unlikely(gr_log_ring != NULL)) {                                               \
+			static struct gr_log_ratelimit __rl;                                       \
+			gr_log_push(                                                               \
+				RTE_LOG_##level,                                                   \
+				&__rl,                                                             \
+				"%s: " fmt "\n",                                                   \
+				__func__ __VA_OPT__(, ) __VA_ARGS__                                \
+			);                                                                         \
+		} else {                                                                           \
+			RTE_LOG(                                                                   \
+				level, GROUT, "%s: " fmt "\n", __func__ __VA_OPT__(, ) __VA_ARGS__ \
+			);                                                                         \
+		}                                                                                  \
 	} while (0)
 
 #define ABORT(fmt, ...)                                                                            \
@@ -27,14 +68,22 @@ extern int gr_rte_log_type;
 	} while (0)
 
 static inline int __errno_log(int errnum, const char *func, const char *what) {
-	RTE_LOG(ERR, GROUT, "%s: %s: %s\n", func, what, rte_strerror(errnum));
+	static struct gr_log_ratelimit rl;
+	if (unlikely(gr_log_ring != NULL))
+		gr_log_push(RTE_LOG_ERR, &rl, "%s: %s: %s\n", func, what, rte_strerror(errnum));
+	else
+		RTE_LOG(ERR, GROUT, "%s: %s: %s\n", func, what, rte_strerror(errnum));
 	return errno_set(errnum);
 }
 
 #define errno_log(err, what) __errno_log(err, __func__, what)
 
 static inline void *__errno_log_null(int errnum, const char *func, const char *what) {
-	RTE_LOG(ERR, GROUT, "%s: %s: %s\n", func, what, rte_strerror(errnum));
+	static struct gr_log_ratelimit rl;
+	if (unlikely(gr_log_ring != NULL))
+		gr_log_push(RTE_LOG_ERR, &rl, "%s: %s: %s\n", func, what, rte_strerror(errnum));
+	else
+		RTE_LOG(ERR, GROUT, "%s: %s: %s\n", func, what, rte_strerror(errnum));
 	return errno_set_null(errnum);
 }
 
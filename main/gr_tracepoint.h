@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_CORE_TRACEPOINT
+#define _GR_CORE_TRACEPOINT
+
+// DPDK tracepoints, named "grout.*". They are all disabled on startup and can
+// be enabled at runtime with rte_trace_pattern(). The trace buffers of all
+// threads are saved in the CTF format by rte_trace_save() into the EAL trace
+// directory ($HOME/dpdk-traces by default) and can be opened with Trace Compass
+// or babeltrace.
+//
+// These are not RTE_TRACE_POINT_FP which are compiled out unless DPDK is built
+// with enable_trace_fp. A disabled tracepoint costs a single branch.
+
+#include <rte_trace_point.h>
+
+#include <stdint.h>
+
+RTE_TRACE_POINT(
+	gr_trace_graph_reload,
+	RTE_TRACE_POINT_ARGS(unsigned lcore_id, unsigned cpu_id, unsigned config),
+	rte_trace_point_emit_u32(lcore_id);
+	rte_trace_point_emit_u32(cpu_id);
+	rte_trace_point_emit_u32(config);
+)
+
+// NH_NEIGH_F_* state flags of a neighbor before and after a transition.
+RTE_TRACE_POINT(
+	gr_trace_nh_state,
+	RTE_TRACE_POINT_ARGS(const void *neigh, uint16_t old_flags, uint16_t new_flags),
+	rte_trace_point_emit_ptr(neigh);
+	rte_trace_point_emit_u16(old_flags);
+	rte_trace_point_emit_u16(new_flags);
+)
+
+RTE_TRACE_POINT(
+	gr_trace_hold_queue_push,
+	RTE_TRACE_POINT_ARGS(const void *queue, int32_t len),
+	rte_trace_point_emit_ptr(queue);
+	rte_trace_point_emit_i32(len);
+)
+
+RTE_TRACE_POINT(
+	gr_trace_hold_queue_flush,
+	RTE_TRACE_POINT_ARGS(const void *queue, uint32_t count),
+	rte_trace_point_emit_ptr(queue);
+	rte_trace_point_emit_u32(count);
+)
+
+// ip is in network order. ret is zero or a negative errno.
+RTE_TRACE_POINT(
+	gr_trace_fib4_add,
+	RTE_TRACE_POINT_ARGS(
+		uint16_t vrf_id, uint32_t ip, uint8_t prefixlen, uint64_t nh_id, int ret
+	),
+	rte_trace_point_emit_u16(vrf_id);
+	rte_trace_point_emit_u32(ip);
+	rte_trace_point_emit_u8(prefixlen);
+	rte_trace_point_emit_u64(nh_id);
+	rte_trace_point_emit_int(ret);
+)
+
+RTE_TRACE_POINT(
+	gr_trace_fib4_del,
+	RTE_TRACE_POINT_ARGS(uint16_t vrf_id, uint32_t ip, uint8_t prefixlen, int ret),
+	rte_trace_point_emit_u16(vrf_id);
+	rte_trace_point_emit_u32(ip);
+	rte_trace_point_emit_u8(prefixlen);
+	rte_trace_point_emit_int(ret);
+)
+
+// ip points to the 16 bytes of an IPv6 address.
+RTE_TRACE_POINT(
+	gr_trace_fib6_add,
+	RTE_TRACE_POINT_ARGS(
+		uint16_t vrf_id, const void *ip, uint8_t prefixlen, uint64_t nh_id, int ret
+	),
+	rte_trace_point_emit_u16(vrf_id);
+	rte_trace_point_emit_blob(ip, 16);
+	rte_trace_point_emit_u8(prefixlen);
+	rte_trace_point_emit_u64(nh_id);
+	rte_trace_point_emit_int(ret);
+)
+
+RTE_TRACE_POINT(
+	gr_trace_fib6_del,
+	RTE_TRACE_POINT_ARGS(uint16_t vrf_id, const void *ip, uint8_t prefixlen, int ret),
+	rte_trace_point_emit_u16(vrf_id);
+	rte_trace_point_emit_blob(ip, 16);
+	rte_trace_point_emit_u8(prefixlen);
+	rte_trace_point_emit_int(ret);
+)
+
+RTE_TRACE_POINT(
+	gr_trace_api_request_start,
+	RTE_TRACE_POINT_ARGS(uint32_t id, uint32_t type),
+	rte_trace_point_emit_u32(id);
+	rte_trace_point_emit_u32(type);
+)
+
+// Duration of the request handler in TSC cycles.
+RTE_TRACE_POINT(
+	gr_trace_api_request_end,
+	RTE_TRACE_POINT_ARGS(uint32_t id, uint32_t type, uint32_t status, uint64_t cycles),
+	rte_trace_point_emit_u32(id);
+	rte_trace_point_emit_u32(type);
+	rte_trace_point_emit_u32(status);
+	rte_trace_point_emit_u64(cycles);
+)
+
+RTE_TRACE_POINT(
+	gr_trace_port_configure,
+	RTE_TRACE_POINT_ARGS(uint16_t port_id, uint16_t n_rxq, uint16_t n_txq, uint16_t mtu),
+	rte_trace_point_emit_u16(port_id);
+	rte_trace_point_emit_u16(n_rxq);
+	rte_trace_point_emit_u16(n_txq);
+	rte_trace_point_emit_u16(mtu);
+)
+
+// Names of all the tracepoints above.
+extern const char *const gr_tracepoint_names[];
+extern const unsigned gr_tracepoint_count;
+
+#endif
@@ -1,19 +1,26 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // Copyright (c) 2023 Robin Jarry
 
+#include "api_pool.h"
 #include "control.h"
 #include "dpdk.h"
 #include "gr.h"
 #include "sd_notify.h"
 #include "signals.h"
+#include "snapshot.h"
 
 #include <gr_api.h>
 #include <gr_control.h>
 #include <gr_log.h>
 #include <gr_macro.h>
+#include <gr_stb_ds.h>
+#include <gr_tracepoint.h>
 
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
 #include <event2/event.h>
 #include <event2/thread.h>
+#include <rte_cycles.h>
 #include <rte_eal.h>
 #include <rte_log.h>
 #include <rte_mempool.h>
@@ -24,10 +31,12 @@
 #include <locale.h>
 #include <sched.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/epoll.h>
+#include <sys/queue.h>
 #include <sys/signalfd.h>
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -36,16 +45,43 @@
 // Please keep options/flags in alphabetical order.
 
 static void usage(const char *prog) {
-	printf("Usage: %s [-h] [-p] [-s PATH] [-t] [-v] [-v] [-x]\n", prog);
+	printf("Usage: %s [-a CPUS] [-b] [-C SIZE] [-c] [-f US] [-H CPUS] [-h]", prog);
+	printf(" [-i LOOPS] [-M ADDR] [-m NAME] [-P] [-p] [-r] [-S PATH] [-s PATH] [-T N]");
+	puts(" [-t] [-v] [-v] [-x]");
 	puts("");
 	printf("  Graph router version %s.\n", GROUT_VERSION);
 	puts("");
 	puts("options:");
+	puts("  -a CPUS, --autoscale CPUS  Start and stop workers on CPUS (e.g. 2-5,8)");
+	puts("                             depending on the load.");
+	puts("  -b, --balance-rxqs         Move RX queues automatically between workers.");
+	puts("  -C SIZE, --mempool-cache SIZE");
+	puts("                             Per-lcore cache size of packet mempools.");
+	printf("                             Default: %u.\n", RTE_MEMPOOL_CACHE_MAX_SIZE);
+	puts("  -c, --flow-cache           Cache route lookup results in each worker.");
+	puts("  -f US, --tx-flush-delay US Max time packets are buffered before TX.");
+	puts("                             Default: 0 (flush after each graph walk).");
+	puts("  -H CPUS, --housekeeping CPUS");
+	puts("                             Pin the control plane, EAL threads and port IRQs");
+	puts("                             on CPUS (e.g. 0-1).");
 	puts("  -h, --help                 Display this help message and exit.");
+	puts("  -i LOOPS, --stats-interval LOOPS");
+	puts("                             Graph walks between worker stats updates.");
+	printf("                             Default: %u.\n", GR_DEFAULT_STATS_INTERVAL);
+	puts("  -M ADDR, --metrics ADDR    Serve OpenMetrics on ADDR (IP:PORT or [IP6]:PORT).");
+	puts("  -m NAME, --stats-shm NAME  Name of the shared memory statistics segment.");
+	puts("                             Default: GROUT_STATS_SHM from env or");
+	printf("                             %s).\n", GR_DEFAULT_STATS_SHM);
+	puts("  -P, --port-pools           Use a dedicated packet mempool for each port.");
 	puts("  -p, --poll-mode            Disable automatic micro-sleep.");
+	puts("  -r, --rx-interrupts        Block on RX interrupts when idle.");
+	puts("  -S PATH, --snapshot PATH   Save the configuration to PATH and restore it");
+	puts("                             at startup.");
 	puts("  -s PATH, --socket PATH     Path the control plane API socket.");
 	puts("                             Default: GROUT_SOCK_PATH from env or");
 	printf("                             %s).\n", GR_DEFAULT_SOCK_PATH);
+	puts("  -T N, --api-threads N      Threads processing read-only API requests.");
+	printf("                             Default: %u.\n", GR_DEFAULT_API_THREADS);
 	puts("  -t, --test-mode            Run in test mode (no hugepages).");
 	puts("  -V, --version              Print version and exit.");
 	puts("  -v, --verbose              Increase verbosity.");
@@ -60,13 +96,28 @@ const struct gr_args *gr_args(void) {
 }
 
 static int parse_args(int argc, char **argv) {
+	unsigned long val;
+	char *end;
 	int c;
 
-#define FLAGS ":hps:tVvx"
+#define FLAGS ":a:bC:cf:H:hi:M:m:PprS:s:T:tVvx"
 	static struct option long_options[] = {
+		{"autoscale", required_argument, NULL, 'a'},
+		{"balance-rxqs", no_argument, NULL, 'b'},
+		{"mempool-cache", required_argument, NULL, 'C'},
+		{"flow-cache", no_argument, NULL, 'c'},
+		{"tx-flush-delay", required_argument, NULL, 'f'},
+		{"housekeeping", required_argument, NULL, 'H'},
 		{"help", no_argument, NULL, 'h'},
+		{"stats-interval", required_argument, NULL, 'i'},
+		{"metrics", required_argument, NULL, 'M'},
+		{"stats-shm", required_argument, NULL, 'm'},
+		{"port-pools", no_argument, NULL, 'P'},
 		{"poll-mode", no_argument, NULL, 'p'},
+		{"rx-interrupts", no_argument, NULL, 'r'},
+		{"snapshot", required_argument, NULL, 'S'},
 		{"socket", required_argument, NULL, 's'},
+		{"api-threads", required_argument, NULL, 'T'},
 		{"test-mode", no_argument, NULL, 't'},
 		{"version", no_argument, NULL, 'V'},
 		{"verbose", no_argument, NULL, 'v'},
@@ -77,19 +128,90 @@ static int parse_args(int argc, char **argv) {
 	opterr = 0; // disable getopt default error reporting
 
 	args.api_sock_path = getenv("GROUT_SOCK_PATH");
+	args.stats_shm_name = getenv("GROUT_STATS_SHM");
 	args.log_level = RTE_LOG_NOTICE;
+	args.stats_interval = GR_DEFAULT_STATS_INTERVAL;
+	args.mempool_cache = RTE_MEMPOOL_CACHE_MAX_SIZE;
+	args.api_threads = GR_DEFAULT_API_THREADS;
 
 	while ((c = getopt_long(argc, argv, FLAGS, long_options, NULL)) != -1) {
 		switch (c) {
+		case 'a':
+			args.autoscale_cpus = optarg;
+			break;
+		case 'b':
+			args.balance_rxqs = true;
+			break;
+		case 'C':
+			errno = 0;
+			val = strtoul(optarg, &end, 10);
+			if (errno != 0 || *end != '\0' || val > RTE_MEMPOOL_CACHE_MAX_SIZE) {
+				usage(argv[0]);
+				fprintf(stderr, "error: -C invalid value: %s", optarg);
+				return errno_set(EINVAL);
+			}
+			args.mempool_cache = val;
+			break;
+		case 'c':
+			args.flow_cache = true;
+			break;
+		case 'f':
+			errno = 0;
+			val = strtoul(optarg, &end, 10);
+			if (errno != 0 || *end != '\0' || val > GR_MAX_TX_FLUSH_DELAY) {
+				usage(argv[0]);
+				fprintf(stderr, "error: -f invalid value: %s", optarg);
+				return errno_set(EINVAL);
+			}
+			args.tx_flush_us = val;
+			break;
+		case 'H':
+			args.housekeeping_cpus = optarg;
+			break;
 		case 'h':
 			usage(argv[0]);
 			return -1;
+		case 'i':
+			errno = 0;
+			val = strtoul(optarg, &end, 10);
+			if (errno != 0 || *end != '\0' || val == 0 || val > UINT16_MAX) {
+				usage(argv[0]);
+				fprintf(stderr, "error: -i invalid value: %s", optarg);
+				return errno_set(EINVAL);
+			}
+			args.stats_interval = val;
+			break;
+		case 'M':
+			args.metrics_listen = optarg;
+			break;
+		case 'm':
+			args.stats_shm_name = optarg;
+			break;
+		case 'P':
+			args.port_pools = true;
+			break;
 		case 'p':
 			args.poll_mode = true;
 			break;
+		case 'r':
+			args.rx_interrupts = true;
+			break;
+		case 'S':
+			args.snapshot_path = optarg;
+			break;
 		case 's':
 			args.api_sock_path = optarg;
 			break;
+		case 'T':
+			errno = 0;
+			val = strtoul(optarg, &end, 10);
+			if (errno != 0 || *end != '\0' || val > GR_MAX_API_THREADS) {
+				usage(argv[0]);
+				fprintf(stderr, "error: -T invalid value: %s", optarg);
+				return errno_set(EINVAL);
+			}
+			args.api_threads = val;
+			break;
 		case 't':
 			args.test_mode = true;
 			break;
@@ -123,6 +245,8 @@ end:
 
 	if (args.api_sock_path == NULL)
 		args.api_sock_path = GR_DEFAULT_SOCK_PATH;
+	if (args.stats_shm_name == NULL)
+		args.stats_shm_name = GR_DEFAULT_STATS_SHM;
 
 	return 0;
 }
@@ -131,144 +255,441 @@ static void finalize_close_fd(struct event *ev, void * /*priv*/) {
 	close(event_get_fd(ev));
 }
 
-static ssize_t send_response(evutil_socket_t sock, struct gr_api_response *resp) {
-	if (resp == NULL)
-		return errno_set(ENOMEM);
+static struct event_base *ev_base;
 
-	LOG(DEBUG,
-	    "for_id=%u len=%u status=%u %s",
-	    resp->for_id,
-	    resp->payload_len,
-	    resp->status,
-	    strerror(resp->status));
+// Stop processing requests from a client when that many response bytes are
+// waiting to be sent. Resume when the output buffer has been drained below
+// the low watermark.
+#define API_OUT_HIGH_WATERMARK (4 * (sizeof(struct gr_api_response) + GR_API_MAX_MSG_LEN))
+#define API_OUT_LOW_WATERMARK (sizeof(struct gr_api_response) + GR_API_MAX_MSG_LEN)
+// Stop reading from a client socket when that many request bytes are buffered.
+#define API_IN_HIGH_WATERMARK (4 * (sizeof(struct gr_api_request) + GR_API_MAX_MSG_LEN))
+
+// Do not queue more events between two flushes. The subscribers will see a gap
+// in the sequence numbers and must reload their state.
+#define EVENTS_MAX_PENDING 65536
+// Drop the events sent to a client when that many bytes are waiting to be sent.
+#define EVENTS_OUT_HIGH_WATERMARK (16 * API_OUT_HIGH_WATERMARK)
+
+struct api_conn {
+	struct bufferevent *bev;
+	bool transaction; // GR_API_TRANSACTION_BEGIN not committed yet
+	uint32_t *ev_types; // stb_ds array, GR_API_EVENT_SUBSCRIBE types
+	uint64_t ev_seq; // sequence number of the last event sent or dropped
+	struct api_job *job; // read-only request being processed by an API thread
+	LIST_ENTRY(api_conn) next;
+};
+
+static LIST_HEAD(, api_conn) api_conns = LIST_HEAD_INITIALIZER(api_conns);
+
+struct pending_event {
+	STAILQ_ENTRY(pending_event) next;
+	uint32_t ev_type;
+	const void *key;
+	uint32_t len;
+	uint8_t obj[];
+};
+
+static STAILQ_HEAD(, pending_event) pending_events = STAILQ_HEAD_INITIALIZER(pending_events);
+static unsigned n_pending_events;
+static unsigned n_dropped_events;
+static unsigned n_subscribers;
+static struct event *ev_flush;
+
+void gr_event_push(uint32_t ev_type, const void *key, const void *obj, uint32_t len) {
+	struct pending_event *e;
+
+	if (n_subscribers == 0)
+		return;
 
-	size_t len = sizeof(*resp) + resp->payload_len;
-	return send(sock, resp, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (key != NULL) {
+		// only the last state of the object is relevant
+		STAILQ_FOREACH (e, &pending_events, next) {
+			if (e->ev_type == ev_type && e->key == key) {
+				STAILQ_REMOVE(&pending_events, e, pending_event, next);
+				n_pending_events--;
+				free(e);
+				break;
+			}
+		}
+	}
+
+	if (n_pending_events >= EVENTS_MAX_PENDING || (e = malloc(sizeof(*e) + len)) == NULL) {
+		n_dropped_events++;
+		goto flush;
+	}
+	e->ev_type = ev_type;
+	e->key = key;
+	e->len = len;
+	memcpy(e->obj, obj, len);
+	STAILQ_INSERT_TAIL(&pending_events, e, next);
+	n_pending_events++;
+flush:
+	// all events pushed by the current callback are sent in one go
+	event_active(ev_flush, 0, 0);
 }
 
-static struct event_base *ev_base;
+static bool event_subscribed(const struct api_conn *conn, uint32_t ev_type) {
+	for (int i = 0; i < arrlen(conn->ev_types); i++) {
+		if (conn->ev_types[i] == GR_EVENT_ALL || conn->ev_types[i] == ev_type)
+			return true;
+	}
+	return false;
+}
 
-static void api_write_cb(evutil_socket_t sock, short /*what*/, void *priv) {
-	struct event *ev = event_base_get_running_event(ev_base);
-	struct gr_api_response *resp = priv;
+static void event_send(struct api_conn *conn, const struct pending_event *e) {
+	struct evbuffer *out = bufferevent_get_output(conn->bev);
+	struct gr_api_response resp = {.for_id = GR_API_EVENT_ID};
+	struct gr_api_event ev = {.ev_type = e->ev_type, .obj_len = e->len};
 
-	if (send_response(sock, resp) < 0) {
-		if (errno == EAGAIN || errno == EWOULDBLOCK)
-			goto retry;
-		LOG(ERR, "send_response: %s", strerror(errno));
+	ev.seq = ++conn->ev_seq;
+	resp.payload_len = sizeof(ev) + e->len;
+
+	// The client is not reading its events, it will notice the gap.
+	if (evbuffer_get_length(out) >= EVENTS_OUT_HIGH_WATERMARK)
+		return;
+	// Make sure that a message is never truncated.
+	if (evbuffer_expand(out, sizeof(resp) + resp.payload_len) < 0)
+		return;
+	evbuffer_add(out, &resp, sizeof(resp));
+	evbuffer_add(out, &ev, sizeof(ev));
+	evbuffer_add(out, e->obj, e->len);
+}
+
+static void events_flush_cb(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	struct pending_event *e;
+	struct api_conn *conn;
+
+	while ((e = STAILQ_FIRST(&pending_events)) != NULL) {
+		STAILQ_REMOVE_HEAD(&pending_events, next);
+		LIST_FOREACH (conn, &api_conns, next) {
+			if (event_subscribed(conn, e->ev_type))
+				event_send(conn, e);
+		}
+		free(e);
 	}
-	goto free;
+	n_pending_events = 0;
 
-retry:
-	if (ev == NULL || event_add(ev, NULL) < 0) {
-		LOG(ERR, "failed to add event to loop");
-		goto free;
+	if (n_dropped_events > 0) {
+		LOG(WARNING, "%u events dropped", n_dropped_events);
+		LIST_FOREACH (conn, &api_conns, next) {
+			if (arrlen(conn->ev_types) > 0)
+				conn->ev_seq += n_dropped_events;
+		}
+		n_dropped_events = 0;
 	}
-	return;
+}
+
+static void events_free(void) {
+	struct pending_event *e;
 
-free:
-	free(resp);
-	if (ev != NULL)
-		event_free(ev);
+	while ((e = STAILQ_FIRST(&pending_events)) != NULL) {
+		STAILQ_REMOVE_HEAD(&pending_events, next);
+		free(e);
+	}
+	n_pending_events = 0;
+	if (ev_flush != NULL)
+		event_free(ev_flush);
 }
 
-static void api_read_cb(evutil_socket_t sock, short what, void * /*ctx*/) {
-	struct event *ev = event_base_get_running_event(ev_base);
-	void *req_payload = NULL, *resp_payload = NULL;
-	struct gr_api_response *resp = NULL;
-	struct gr_api_request req;
-	struct event *write_ev;
-	struct api_out out;
-	ssize_t len;
+static struct api_out event_subscribe(struct api_conn *conn, const void *request, uint32_t len) {
+	const struct gr_api_event_subscribe_req *req = request;
 
-	if (what & EV_CLOSED)
-		goto close;
+	if (len < sizeof(*req))
+		return api_out(EINVAL, 0);
+	if (event_subscribed(conn, req->ev_type))
+		return api_out(0, 0);
+	if (arrlen(conn->ev_types) == 0)
+		n_subscribers++;
+	arrpush(conn->ev_types, req->ev_type); // NOLINT
 
-	if ((len = recv(sock, &req, sizeof(req), MSG_DONTWAIT)) < 0) {
-		if (errno == EAGAIN || errno == EWOULDBLOCK) {
-			return;
+	return api_out(0, 0);
+}
+
+static struct api_out transaction_begin(struct api_conn *conn) {
+	if (conn->transaction)
+		return api_out(EBUSY, 0);
+	conn->transaction = true;
+	config_write_lock();
+	gr_modules_batch_begin();
+	config_unlock();
+	return api_out(0, 0);
+}
+
+static struct api_out transaction_commit(struct api_conn *conn) {
+	if (!conn->transaction)
+		return api_out(ENOENT, 0);
+	conn->transaction = false;
+	config_write_lock();
+	gr_modules_batch_end();
+	config_unlock();
+	return api_out(0, 0);
+}
+
+static void api_conn_free(struct api_conn *conn) {
+	if (conn->transaction) {
+		LOG(NOTICE, "client disconnected, committing its transaction");
+		transaction_commit(conn);
+	}
+	if (arrlen(conn->ev_types) > 0)
+		n_subscribers--;
+	arrfree(conn->ev_types);
+	LIST_REMOVE(conn, next);
+	bufferevent_free(conn->bev);
+	conn->bev = NULL;
+	// freed when the API thread is done with it
+	if (conn->job == NULL)
+		free(conn);
+}
+
+static void free_payload(const void *payload, size_t, void *) {
+	free((void *)payload);
+}
+
+static void iov_resp_cleanup(const void *, size_t, void *resp) {
+	api_iov_resp_free(resp);
+}
+
+// Reference all buffers of a scatter-gather response. The response is released
+// when its last buffer is freed from the output buffer.
+static int iov_resp_add(struct evbuffer *out, struct api_iov_resp *resp) {
+	evbuffer_ref_cleanup_cb cleanup;
+	const struct api_iov *iov;
+	struct evbuffer *buf;
+	unsigned last = 0;
+	int ret;
+
+	for (unsigned i = 0; i < resp->n_iov; i++) {
+		if (resp->iov[i].len > 0)
+			last = i;
+	}
+
+	// Fill a temporary buffer first so that no dangling reference is left
+	// in the output buffer on error.
+	if ((buf = evbuffer_new()) == NULL)
+		goto err;
+	for (unsigned i = 0; i <= last; i++) {
+		iov = &resp->iov[i];
+		if (iov->len == 0)
+			continue;
+		cleanup = i == last ? iov_resp_cleanup : NULL;
+		if (evbuffer_add_reference(buf, iov->base, iov->len, cleanup, resp) < 0)
+			goto err;
+	}
+	// the response is now owned by buf
+	ret = evbuffer_add_buffer(out, buf);
+	evbuffer_free(buf);
+
+	return ret;
+err:
+	if (buf != NULL)
+		evbuffer_free(buf);
+	api_iov_resp_free(resp);
+	return -1;
+}
+
+static int api_respond(
+	struct evbuffer *out,
+	const struct gr_api_handler *handler,
+	uint32_t for_id,
+	struct api_out ret,
+	void *resp_payload
+) {
+	bool iov = handler != NULL && handler->flags & GR_API_F_IOV;
+	struct gr_api_response resp = {0};
+
+	resp.for_id = for_id;
+	resp.status = ret.status;
+	resp.payload_len = resp_payload != NULL ? ret.len : 0;
+
+	if (iov && resp_payload != NULL) {
+		const struct api_iov_resp *r = resp_payload;
+		resp.payload_len = 0;
+		for (unsigned i = 0; i < r->n_iov; i++)
+			resp.payload_len += r->iov[i].len;
+	}
+
+	LOG(DEBUG,
+	    "for_id=%u len=%u status=%u %s",
+	    resp.for_id,
+	    resp.payload_len,
+	    resp.status,
+	    strerror(resp.status));
+
+	// Responses are queued and sent in batches with writev() by libevent.
+	// The payload is referenced without copy and freed once sent.
+	if (evbuffer_add(out, &resp, sizeof(resp)) < 0)
+		goto err;
+	if (resp.payload_len == 0) {
+		api_response_free(handler, resp_payload);
+		return 0;
+	}
+	if (iov) {
+		if (iov_resp_add(out, resp_payload) < 0) {
+			resp_payload = NULL;
+			goto err;
 		}
-		LOG(ERR, "recv: %s", strerror(errno));
-		goto close;
-	} else if (len == 0) {
-		LOG(DEBUG, "client disconnected");
-		goto close;
+		return 0;
 	}
+	if (evbuffer_add_reference(out, resp_payload, resp.payload_len, free_payload, NULL) < 0)
+		goto err;
+
+	return 0;
+err:
+	LOG(ERR, "cannot queue %u bytes response", resp.payload_len);
+	api_response_free(handler, resp_payload);
+	return errno_set(ENOMEM);
+}
+
+static int api_job_submit(
+	struct api_conn *conn,
+	const struct gr_api_handler *handler,
+	const struct gr_api_request *req,
+	void *req_payload
+) {
+	struct api_job *job;
+
+	if ((job = calloc(1, sizeof(*job))) == NULL) {
+		free(req_payload);
+		LOG(ERR, "cannot allocate api job");
+		return errno_set(ENOMEM);
+	}
+	job->handler = handler;
+	job->req = *req;
+	job->req_payload = req_payload;
+	job->priv = conn;
+	conn->job = job;
+	api_pool_submit(job);
+
+	return 0;
+}
+
+static int process_request(struct api_conn *conn, struct evbuffer *in, struct evbuffer *out) {
+	const struct gr_api_handler *handler = NULL;
+	void *req_payload = NULL;
+	void *resp_payload = NULL;
+	struct gr_api_request req;
+	struct api_out ret;
+	uint64_t start;
+
+	evbuffer_remove(in, &req, sizeof(req));
 
 	if (req.payload_len > 0) {
 		req_payload = malloc(req.payload_len);
 		if (req_payload == NULL) {
 			LOG(ERR, "cannot allocate %u bytes for request payload", req.payload_len);
-			goto close;
-		}
-		if ((len = recv(sock, req_payload, req.payload_len, MSG_DONTWAIT)) < 0) {
-			LOG(ERR, "recv: %s", strerror(errno));
-			goto close;
-		} else if (len == 0) {
-			LOG(DEBUG, "client disconnected");
-			goto close;
+			return errno_set(ENOMEM);
 		}
+		evbuffer_remove(in, req_payload, req.payload_len);
 	}
 
-	const struct gr_api_handler *handler = lookup_api_handler(&req);
-	if (handler == NULL) {
-		out.status = ENOTSUP;
-		out.len = 0;
-		goto send;
+	if (req.type == GR_API_TRANSACTION_BEGIN) {
+		ret = transaction_begin(conn);
+	} else if (req.type == GR_API_TRANSACTION_COMMIT) {
+		ret = transaction_commit(conn);
+	} else if (req.type == GR_API_EVENT_SUBSCRIBE) {
+		ret = event_subscribe(conn, req_payload, req.payload_len);
+	} else if ((handler = lookup_api_handler(&req)) == NULL) {
+		ret.status = ENOTSUP;
+		ret.len = 0;
+	} else if ((ret.status = api_request_check(handler, req_payload, req.payload_len)) != 0) {
+		// truncated or inconsistent request, the callback must not see it
+		ret.len = 0;
+	} else if (handler->flags & GR_API_F_READ && api_pool_running()) {
+		// the next requests of this client are processed once it completes
+		return api_job_submit(conn, handler, &req, req_payload);
+	} else {
+		LOG(DEBUG,
+		    "request: id=%u type=0x%08x '%s' len=%u",
+		    req.id,
+		    req.type,
+		    handler->name,
+		    req.payload_len);
+		config_write_lock();
+		start = rte_rdtsc();
+		gr_trace_api_request_start(req.id, req.type);
+		ret = handler->callback(req_payload, &resp_payload);
+		gr_trace_api_request_end(req.id, req.type, ret.status, rte_rdtsc() - start);
+		if (ret.status == 0 && handler->flags & GR_API_F_CONFIG)
+			snapshot_append(&req, req_payload);
+		config_unlock();
 	}
+	free(req_payload);
 
-	LOG(DEBUG,
-	    "request: id=%u type=0x%08x '%s' len=%u",
-	    req.id,
-	    req.type,
-	    handler->name,
-	    req.payload_len);
-
-	out = handler->callback(req_payload, &resp_payload);
-
-send:
-	resp = malloc(sizeof(*resp) + out.len);
-	if (resp == NULL) {
-		LOG(ERR, "cannot allocate %zu bytes for response payload", sizeof(*resp) + out.len);
-		goto close;
-	}
-	resp->for_id = req.id;
-	resp->status = out.status;
-	resp->payload_len = out.len;
-	if (resp_payload != NULL && out.len > 0) {
-		memcpy(PAYLOAD(resp), resp_payload, out.len);
-		free(resp_payload);
-		resp_payload = NULL;
-	}
-	if (send_response(sock, resp) < 0) {
-		if (errno == EAGAIN || errno == EWOULDBLOCK)
-			goto retry_send;
-		LOG(ERR, "send: %s", strerror(errno));
-		goto close;
+	return api_respond(out, handler, req.id, ret, resp_payload);
+}
+
+static void api_read_cb(struct bufferevent *bev, void *priv) {
+	struct evbuffer *out = bufferevent_get_output(bev);
+	struct evbuffer *in = bufferevent_get_input(bev);
+	struct api_conn *conn = priv;
+	struct gr_api_request req;
+
+	// process all complete requests that were received so far
+	while (conn->job == NULL && evbuffer_get_length(in) >= sizeof(req)) {
+		if (evbuffer_get_length(out) >= API_OUT_HIGH_WATERMARK) {
+			// client is not reading its responses, wait for it
+			bufferevent_disable(bev, EV_READ);
+			return;
+		}
+		evbuffer_copyout(in, &req, sizeof(req));
+		if (req.payload_len > GR_API_MAX_MSG_LEN) {
+			LOG(ERR, "request payload too large: %u bytes", req.payload_len);
+			goto close;
+		}
+		if (evbuffer_get_length(in) < sizeof(req) + req.payload_len)
+			break;
+		if (process_request(conn, in, out) < 0)
+			goto close;
 	}
-	free(req_payload);
-	free(resp);
 	return;
+close:
+	api_conn_free(conn);
+}
 
-retry_send:
-	write_ev = event_new(ev_base, sock, EV_WRITE | EV_FINALIZE, api_write_cb, resp);
-	if (write_ev == NULL || event_add(write_ev, NULL) < 0) {
-		LOG(ERR, "failed to add event to loop");
-		if (write_ev != NULL)
-			event_free(write_ev);
-		goto close;
+static void api_job_done(struct api_job *job) {
+	struct api_conn *conn = job->priv;
+	struct evbuffer *out;
+
+	conn->job = NULL;
+	free(job->req_payload);
+
+	if (conn->bev == NULL) {
+		// client disconnected in the meantime
+		api_response_free(job->handler, job->resp_payload);
+		free(conn);
+		goto end;
 	}
-	free(req_payload);
-	return;
 
-close:
-	free(req_payload);
-	free(resp);
-	if (ev != NULL)
-		event_free_finalize(0, ev, finalize_close_fd);
+	out = bufferevent_get_output(conn->bev);
+	if (api_respond(out, job->handler, job->req.id, job->ret, job->resp_payload) < 0)
+		api_conn_free(conn);
+	else
+		api_read_cb(conn->bev, conn);
+end:
+	free(job);
+}
+
+static void api_write_cb(struct bufferevent *bev, void *priv) {
+	// output buffer is below the low watermark
+	if (!(bufferevent_get_enabled(bev) & EV_READ)) {
+		bufferevent_enable(bev, EV_READ);
+		api_read_cb(bev, priv);
+	}
+}
+
+static void api_event_cb(struct bufferevent *, short what, void *priv) {
+	if (what & BEV_EVENT_ERROR)
+		LOG(ERR, "api socket: %s", strerror(errno));
+	else if (what & BEV_EVENT_EOF)
+		LOG(DEBUG, "client disconnected");
+	else
+		return;
+	api_conn_free(priv);
 }
 
 static void listen_cb(evutil_socket_t sock, short what, void * /*ctx*/) {
+	struct api_conn *conn;
 	struct event *ev;
 	int fd;
 
@@ -287,15 +708,25 @@ static void listen_cb(evutil_socket_t sock, short what, void * /*ctx*/) {
 
 	LOG(DEBUG, "new connection");
 
-	ev = event_new(
-		ev_base, fd, EV_READ | EV_CLOSED | EV_PERSIST | EV_FINALIZE, api_read_cb, NULL
-	);
-	if (ev == NULL || event_add(ev, NULL) < 0) {
+	if ((conn = calloc(1, sizeof(*conn))) == NULL)
+		goto err;
+	conn->bev = bufferevent_socket_new(ev_base, fd, BEV_OPT_CLOSE_ON_FREE);
+	if (conn->bev == NULL)
+		goto err;
+	LIST_INSERT_HEAD(&api_conns, conn, next);
+
+	bufferevent_setcb(conn->bev, api_read_cb, api_write_cb, api_event_cb, conn);
+	bufferevent_setwatermark(conn->bev, EV_READ, 0, API_IN_HIGH_WATERMARK);
+	bufferevent_setwatermark(conn->bev, EV_WRITE, API_OUT_LOW_WATERMARK, 0);
+	if (bufferevent_enable(conn->bev, EV_READ | EV_WRITE) < 0) {
+		api_conn_free(conn);
 		LOG(ERR, "failed to add event to loop");
-		if (ev != NULL)
-			event_free(ev);
-		close(fd);
 	}
+	return;
+err:
+	LOG(ERR, "failed to add event to loop");
+	free(conn);
+	close(fd);
 }
 
 #define BACKLOG 16
@@ -347,13 +778,6 @@ static int listen_api_socket(void) {
 	return 0;
 }
 
-static int ev_close(const struct event_base *, const struct event *ev, void * /*priv*/) {
-	event_callback_fn cb = event_get_callback(ev);
-	if (cb == api_read_cb || cb == api_write_cb)
-		event_free_finalize(0, (struct event *)ev, finalize_close_fd);
-	return 0;
-}
-
 int main(int argc, char **argv) {
 	int ret = EXIT_FAILURE;
 	int err = 0;
@@ -388,8 +812,30 @@ int main(int argc, char **argv) {
 		goto shutdown;
 	}
 
+	ev_flush = event_new(ev_base, -1, EV_FINALIZE, events_flush_cb, NULL);
+	if (ev_flush == NULL) {
+		LOG(ERR, "event_new: %s", strerror(errno));
+		err = errno;
+		goto shutdown;
+	}
+
+	if (dpdk_log_drain_init(ev_base) < 0) {
+		err = errno;
+		goto shutdown;
+	}
+
 	modules_init(ev_base);
 
+	if (args.snapshot_path != NULL && snapshot_restore(args.snapshot_path) < 0) {
+		err = errno;
+		goto shutdown;
+	}
+
+	if (api_pool_start(ev_base, args.api_threads, api_job_done) < 0) {
+		err = errno;
+		goto shutdown;
+	}
+
 	if (listen_api_socket() < 0) {
 		err = errno;
 		goto shutdown;
@@ -417,12 +863,17 @@ shutdown:
 	if (ev_listen)
 		event_free_finalize(0, ev_listen, finalize_close_fd);
 
+	api_pool_stop();
 	if (ev_base) {
 		modules_fini(ev_base);
-		event_base_foreach_event(ev_base, ev_close, NULL);
+		dpdk_log_drain_fini();
+		while (!LIST_EMPTY(&api_conns))
+			api_conn_free(LIST_FIRST(&api_conns));
+		events_free();
 		event_base_free(ev_base);
 	}
 	unlink(args.api_sock_path);
+	snapshot_close();
 	libevent_global_shutdown();
 dpdk_stop:
 	dpdk_fini();
@@ -0,0 +1,225 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "control.h"
+#include "snapshot.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_log.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// The snapshot file is an append-only journal of the configuration requests
+// that were successfully processed. Records are aligned so that the payloads
+// can be passed to the API handlers directly from the mapped file.
+//
+// +-------------------+
+// | snapshot_header   |
+// +-------------------+
+// | snapshot_record   |
+// | payload + padding |
+// +-------------------+
+// | ...               |
+
+#define SNAPSHOT_MAGIC "GRSNAPSH"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_ALIGN 8
+
+struct snapshot_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t header_len;
+	// API structures are not stable across releases
+	char grout_version[32];
+};
+
+struct snapshot_record {
+	uint32_t type;
+	uint32_t payload_len;
+};
+
+static int snapshot_fd = -1;
+
+static void header_init(struct snapshot_header *hdr) {
+	memset(hdr, 0, sizeof(*hdr));
+	memcpy(hdr->magic, SNAPSHOT_MAGIC, sizeof(hdr->magic));
+	hdr->version = SNAPSHOT_VERSION;
+	hdr->header_len = sizeof(*hdr);
+	memccpy(hdr->grout_version, GROUT_VERSION, 0, sizeof(hdr->grout_version) - 1);
+}
+
+static bool header_valid(const void *data, size_t len) {
+	struct snapshot_header expected;
+
+	header_init(&expected);
+
+	return len >= sizeof(expected) && memcmp(data, &expected, sizeof(expected)) == 0;
+}
+
+// Run all records through their API handlers. Returns the offset of the end of
+// the last complete record.
+static size_t replay(const uint8_t *data, size_t len, unsigned *n_ok, unsigned *n_err) {
+	const struct gr_api_handler *handler;
+	const struct snapshot_record *rec;
+	struct gr_api_request req;
+	size_t off, next;
+	struct api_out out;
+	uint32_t status;
+	void *resp;
+
+	off = sizeof(struct snapshot_header);
+	while (off + sizeof(*rec) <= len) {
+		rec = (const struct snapshot_record *)(data + off);
+		next = off + sizeof(*rec) + RTE_ALIGN_CEIL(rec->payload_len, SNAPSHOT_ALIGN);
+		if (next > len || rec->payload_len > GR_API_MAX_MSG_LEN)
+			break; // interrupted write
+
+		req.type = rec->type;
+		if ((handler = lookup_api_handler(&req)) == NULL) {
+			LOG(ERR, "snapshot: unknown request type=0x%08x", rec->type);
+			(*n_err)++;
+		} else if ((status = api_request_check(handler, rec + 1, rec->payload_len)) != 0) {
+			LOG(ERR, "snapshot: %s: %s", handler->name, strerror(status));
+			(*n_err)++;
+		} else {
+			resp = NULL;
+			out = handler->callback(rec + 1, &resp);
+			api_response_free(handler, resp);
+			if (out.status != 0) {
+				LOG(ERR, "snapshot: %s: %s", handler->name, strerror(out.status));
+				(*n_err)++;
+			} else {
+				(*n_ok)++;
+			}
+		}
+		off = next;
+	}
+
+	return off;
+}
+
+static int snapshot_create(const char *path) {
+	struct snapshot_header hdr;
+	int fd;
+
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0600)) < 0)
+		return errno_log(errno, "open");
+	header_init(&hdr);
+	if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+		close(fd);
+		return errno_log(errno, "write");
+	}
+
+	return fd;
+}
+
+int snapshot_restore(const char *path) {
+	unsigned n_ok = 0, n_err = 0;
+	char old_path[PATH_MAX];
+	uint64_t start;
+	struct stat st;
+	size_t valid;
+	void *data;
+	int fd;
+
+	if ((fd = open(path, O_RDWR | O_APPEND | O_CLOEXEC)) < 0) {
+		if (errno != ENOENT)
+			return errno_log(errno, "open");
+		LOG(NOTICE, "snapshot: creating %s", path);
+		if ((snapshot_fd = snapshot_create(path)) < 0)
+			return snapshot_fd;
+		return 0;
+	}
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return errno_log(errno, "fstat");
+	}
+	data = NULL;
+	if (st.st_size > 0)
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+	if (data == MAP_FAILED) {
+		close(fd);
+		return errno_log(errno, "mmap");
+	}
+
+	if (data == NULL || !header_valid(data, st.st_size)) {
+		// keep the previous file around, it cannot be replayed
+		snprintf(old_path, sizeof(old_path), "%s.old", path);
+		LOG(WARNING, "snapshot: %s: incompatible, moved to %s", path, old_path);
+		if (data != NULL)
+			munmap(data, st.st_size);
+		close(fd);
+		if (rename(path, old_path) < 0)
+			return errno_log(errno, "rename");
+		if ((snapshot_fd = snapshot_create(path)) < 0)
+			return snapshot_fd;
+		return 0;
+	}
+
+	start = rte_get_tsc_cycles();
+	// the worker graphs are only built once all requests have been replayed
+	gr_modules_batch_begin();
+	valid = replay(data, st.st_size, &n_ok, &n_err);
+	gr_modules_batch_end();
+	munmap(data, st.st_size);
+
+	LOG(NOTICE,
+	    "snapshot: restored %u requests from %s in %.03fs (%u errors)",
+	    n_ok,
+	    path,
+	    (double)(rte_get_tsc_cycles() - start) / rte_get_tsc_hz(),
+	    n_err);
+
+	if (valid < (size_t)st.st_size) {
+		LOG(WARNING, "snapshot: dropping %zu bytes of partial record", st.st_size - valid);
+		if (ftruncate(fd, valid) < 0) {
+			close(fd);
+			return errno_log(errno, "ftruncate");
+		}
+	}
+	snapshot_fd = fd;
+
+	return 0;
+}
+
+void snapshot_append(const struct gr_api_request *req, const void *payload) {
+	static const uint8_t padding[SNAPSHOT_ALIGN];
+	uint32_t pad = RTE_ALIGN_CEIL(req->payload_len, SNAPSHOT_ALIGN) - req->payload_len;
+	struct snapshot_record rec = {
+		.type = req->type,
+		.payload_len = req->payload_len,
+	};
+	struct iovec iov[3] = {
+		{&rec, sizeof(rec)},
+		{(void *)payload, req->payload_len},
+		{(void *)padding, pad},
+	};
+	ssize_t len = iov[0].iov_len + iov[1].iov_len + iov[2].iov_len;
+
+	if (snapshot_fd < 0)
+		return;
+
+	// O_APPEND, the record is written at once
+	if (writev(snapshot_fd, iov, RTE_DIM(iov)) != len)
+		LOG(ERR, "snapshot: writev: %s", strerror(errno));
+}
+
+void snapshot_close(void) {
+	if (snapshot_fd >= 0)
+		close(snapshot_fd);
+	snapshot_fd = -1;
+}
@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_SNAPSHOT
+#define _GR_SNAPSHOT
+
+#include <gr_api.h>
+
+// Replay the configuration requests saved in the snapshot file and open it to
+// record the next ones. Must be called before accepting API connections.
+int snapshot_restore(const char *path);
+
+// Append a successful configuration request to the snapshot file.
+void snapshot_append(const struct gr_api_request *, const void *payload);
+
+void snapshot_close(void);
+
+#endif
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+// Must be included first, it turns the RTE_TRACE_POINT definitions of
+// gr_tracepoint.h into field registrations.
+#include <rte_trace_point_register.h>
+
+#include <gr_macro.h>
+#include <gr_tracepoint.h>
+
+RTE_TRACE_POINT_REGISTER(gr_trace_graph_reload, grout.graph.reload)
+RTE_TRACE_POINT_REGISTER(gr_trace_nh_state, grout.nh.state)
+RTE_TRACE_POINT_REGISTER(gr_trace_hold_queue_push, grout.hold_queue.push)
+RTE_TRACE_POINT_REGISTER(gr_trace_hold_queue_flush, grout.hold_queue.flush)
+RTE_TRACE_POINT_REGISTER(gr_trace_fib4_add, grout.fib4.add)
+RTE_TRACE_POINT_REGISTER(gr_trace_fib4_del, grout.fib4.del)
+RTE_TRACE_POINT_REGISTER(gr_trace_fib6_add, grout.fib6.add)
+RTE_TRACE_POINT_REGISTER(gr_trace_fib6_del, grout.fib6.del)
+RTE_TRACE_POINT_REGISTER(gr_trace_api_request_start, grout.api.request.start)
+RTE_TRACE_POINT_REGISTER(gr_trace_api_request_end, grout.api.request.end)
+RTE_TRACE_POINT_REGISTER(gr_trace_port_configure, grout.port.configure)
+
+const char *const gr_tracepoint_names[] = {
+	"grout.graph.reload",
+	"grout.nh.state",
+	"grout.hold_queue.push",
+	"grout.hold_queue.flush",
+	"grout.fib4.add",
+	"grout.fib4.del",
+	"grout.fib6.add",
+	"grout.fib6.del",
+	"grout.api.request.start",
+	"grout.api.request.end",
+	"grout.port.configure",
+};
+
+const unsigned gr_tracepoint_count = ARRAY_DIM(gr_tracepoint_names);
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _ACL_PRIV_H
+#define _ACL_PRIV_H
+
+#include <gr_acl.h>
+#include <gr_feature.h>
+#include <gr_iface.h>
+#include <gr_net_types.h>
+
+#include <rte_acl.h>
+#include <rte_byteorder.h>
+#include <rte_graph.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+
+#include <netinet/in.h>
+#include <stdint.h>
+#include <string.h>
+
+// Classification input, built from the packet headers. Fields are in network
+// order as required by rte_acl. Ports are zero for other protocols and for
+// non-first fragments.
+struct acl_ip4_key {
+	uint8_t proto;
+	uint8_t tos;
+	uint16_t reserved;
+	ip4_addr_t src;
+	ip4_addr_t dst;
+	rte_be16_t sport;
+	rte_be16_t dport;
+};
+
+static_assert(sizeof(struct acl_ip4_key) == 16);
+
+enum {
+	ACL_FIELD_PROTO,
+	ACL_FIELD_SRC,
+	ACL_FIELD_DST,
+	ACL_FIELD_SPORT,
+	ACL_FIELD_DPORT,
+	ACL_FIELD_TOS,
+	ACL_NUM_FIELDS,
+};
+
+RTE_ACL_RULE_DEF(acl_ip4_rule, ACL_NUM_FIELDS);
+
+// Compiled rules of an interface and direction. Never modified, replaced
+// as a whole when the rules change.
+struct acl_ruleset {
+	struct rte_acl_ctx *ctx;
+};
+
+// Feature of the ip4_input_features arc, enabled on interfaces with an
+// ingress ACL.
+extern struct gr_feature ip_acl_in_feature;
+
+// Matching rules userdata. Zero is returned by rte_acl_classify when no rule
+// matches. Policy based routing rules store their VRF instead of the action.
+#define ACL_USERDATA(action) ((action) + 1)
+#define ACL_USERDATA_VRF(userdata) ((userdata) - 1)
+
+static inline void acl_ip4_key_init(struct acl_ip4_key *key, struct rte_mbuf *m) {
+	const struct rte_ipv4_hdr *ip = rte_pktmbuf_mtod(m, const struct rte_ipv4_hdr *);
+	const rte_be16_t *ports;
+	uint16_t l3_len;
+
+	memset(key, 0, sizeof(*key));
+	key->proto = ip->next_proto_id;
+	key->tos = ip->type_of_service;
+	key->src = ip->src_addr;
+	key->dst = ip->dst_addr;
+
+	if (ip->fragment_offset & RTE_BE16(RTE_IPV4_HDR_OFFSET_MASK))
+		return;
+	switch (ip->next_proto_id) {
+	case IPPROTO_TCP:
+	case IPPROTO_UDP:
+	case IPPROTO_SCTP:
+		l3_len = rte_ipv4_hdr_len(ip);
+		if (rte_pktmbuf_data_len(m) < l3_len + 2 * sizeof(*ports))
+			break;
+		ports = rte_pktmbuf_mtod_offset(m, const rte_be16_t *, l3_len);
+		key->sport = ports[0];
+		key->dport = ports[1];
+		break;
+	}
+}
+
+// Classify packets with their ruleset. Consecutive packets with the same
+// ruleset are classified in a single call. Set results[i] to the userdata of
+// the matching rule, zero if none.
+static inline void acl_classify_results(
+	const struct acl_ruleset **rulesets,
+	struct rte_mbuf **mbufs,
+	uint16_t count,
+	uint32_t *results
+) {
+	struct acl_ip4_key keys[RTE_GRAPH_BURST_SIZE];
+	const uint8_t *data[RTE_GRAPH_BURST_SIZE];
+	uint16_t i, j;
+
+	for (i = 0; i < count; i++) {
+		acl_ip4_key_init(&keys[i], mbufs[i]);
+		data[i] = (const uint8_t *)&keys[i];
+	}
+
+	for (i = 0; i < count; i = j) {
+		for (j = i + 1; j < count && rulesets[j] == rulesets[i]; j++)
+			;
+		if (rulesets[i] == NULL
+		    || rte_acl_classify(rulesets[i]->ctx, &data[i], &results[i], j - i, 1) < 0)
+			memset(&results[i], 0, (j - i) * sizeof(*results));
+	}
+}
+
+// Same as acl_classify_results(). Set deny[i] to true for packets that must be
+// dropped.
+static inline void acl_classify_burst(
+	const struct acl_ruleset **rulesets,
+	struct rte_mbuf **mbufs,
+	uint16_t count,
+	bool *deny
+) {
+	uint32_t results[RTE_GRAPH_BURST_SIZE];
+
+	acl_classify_results(rulesets, mbufs, count, results);
+
+	for (uint16_t i = 0; i < count; i++)
+		deny[i] = results[i] == ACL_USERDATA(GR_ACL_DENY);
+}
+
+// ip_input policy based routing callback, see ip_input_pbr_set().
+void acl_pbr_classify(struct rte_mbuf **mbufs, uint16_t *vrfs, uint16_t count);
+
+#endif
@@ -0,0 +1,345 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_acl.h>
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_cli_iface.h>
+#include <gr_net_types.h>
+#include <gr_table.h>
+
+#include <ecoli.h>
+#include <libsmartcols.h>
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *acl_dir_name(uint8_t dir) {
+	switch (dir) {
+	case GR_ACL_DIR_IN:
+		return "in";
+	case GR_ACL_DIR_OUT:
+		return "out";
+	case GR_ACL_DIR_PBR:
+		return "pbr";
+	}
+	return "?";
+}
+
+static int parse_dir(const struct ec_pnode *p, uint8_t *dir) {
+	const char *s = arg_str(p, "DIR");
+
+	if (s == NULL)
+		return errno_set(EINVAL);
+	if (strcmp(s, "in") == 0)
+		*dir = GR_ACL_DIR_IN;
+	else if (strcmp(s, "out") == 0)
+		*dir = GR_ACL_DIR_OUT;
+	else
+		*dir = GR_ACL_DIR_PBR;
+
+	return 0;
+}
+
+static int parse_proto(const char *s, uint8_t *proto) {
+	unsigned long v;
+	char *end;
+
+	if (strcmp(s, "tcp") == 0)
+		*proto = IPPROTO_TCP;
+	else if (strcmp(s, "udp") == 0)
+		*proto = IPPROTO_UDP;
+	else if (strcmp(s, "sctp") == 0)
+		*proto = IPPROTO_SCTP;
+	else if (strcmp(s, "icmp") == 0)
+		*proto = IPPROTO_ICMP;
+	else {
+		errno = 0;
+		v = strtoul(s, &end, 10);
+		if (errno != 0 || *end != '\0' || v > UINT8_MAX)
+			return errno_set(EINVAL);
+		*proto = v;
+	}
+
+	return 0;
+}
+
+// Parse "PORT" or "MIN-MAX".
+static int parse_ports(const char *s, uint16_t *min, uint16_t *max) {
+	unsigned long lo, hi;
+	char *end;
+
+	errno = 0;
+	lo = strtoul(s, &end, 10);
+	hi = lo;
+	if (errno == 0 && *end == '-')
+		hi = strtoul(end + 1, &end, 10);
+	if (errno != 0 || *end != '\0' || lo > UINT16_MAX || hi > UINT16_MAX || lo > hi)
+		return errno_set(ERANGE);
+	*min = lo;
+	*max = hi;
+
+	return 0;
+}
+
+static cmd_status_t rule_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_acl_rule_add_req req = {.exist_ok = true};
+	struct gr_acl_rule *r = &req.entry.rule;
+	struct gr_iface iface;
+	const char *s;
+
+	if (iface_from_name(c, arg_str(p, "IFACE"), &iface) < 0)
+		return CMD_ERROR;
+	req.entry.iface_id = iface.id;
+	if (parse_dir(p, &req.entry.dir) < 0)
+		return CMD_ERROR;
+	if (arg_u16(p, "SEQ", &r->seq) < 0)
+		return CMD_ERROR;
+	if (arg_str(p, "VRF") != NULL) {
+		r->action = GR_ACL_SET_VRF;
+		if (arg_u16(p, "VRF", &r->vrf_id) < 0)
+			return CMD_ERROR;
+	} else if (strcmp(arg_str(p, "ACTION"), "deny") == 0) {
+		r->action = GR_ACL_DENY;
+	} else {
+		r->action = GR_ACL_PERMIT;
+	}
+	if ((s = arg_str(p, "PROTO")) != NULL && parse_proto(s, &r->proto) < 0)
+		return CMD_ERROR;
+	if ((s = arg_str(p, "SRC")) != NULL && ip4_net_parse(s, &r->src, true) < 0)
+		return CMD_ERROR;
+	if ((s = arg_str(p, "DST")) != NULL && ip4_net_parse(s, &r->dst, true) < 0)
+		return CMD_ERROR;
+	if ((s = arg_str(p, "SPORT")) != NULL && parse_ports(s, &r->sport_min, &r->sport_max) < 0)
+		return CMD_ERROR;
+	if ((s = arg_str(p, "DPORT")) != NULL && parse_ports(s, &r->dport_min, &r->dport_max) < 0)
+		return CMD_ERROR;
+	r->dscp = GR_ACL_DSCP_ANY;
+	if (arg_str(p, "DSCP") != NULL) {
+		uint64_t dscp;
+		if (arg_u64(p, "DSCP", &dscp) < 0)
+			return CMD_ERROR;
+		r->dscp = dscp;
+	}
+
+	if (gr_api_client_send_recv(c, GR_ACL_RULE_ADD, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t rule_del(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_acl_rule_del_req req = {.missing_ok = true};
+	struct gr_iface iface;
+
+	if (iface_from_name(c, arg_str(p, "IFACE"), &iface) < 0)
+		return CMD_ERROR;
+	req.iface_id = iface.id;
+	if (parse_dir(p, &req.dir) < 0)
+		return CMD_ERROR;
+	if (arg_u16(p, "SEQ", &req.seq) < 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_ACL_RULE_DEL, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t acl_flush(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_acl_flush_req req;
+	struct gr_iface iface;
+
+	if (iface_from_name(c, arg_str(p, "IFACE"), &iface) < 0)
+		return CMD_ERROR;
+	req.iface_id = iface.id;
+	if (parse_dir(p, &req.dir) < 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_ACL_FLUSH, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static void format_ports(char *buf, size_t len, uint16_t min, uint16_t max) {
+	if (min == 0 && max == 0)
+		snprintf(buf, len, "*");
+	else if (min == max)
+		snprintf(buf, len, "%u", min);
+	else
+		snprintf(buf, len, "%u-%u", min, max);
+}
+
+static void format_net(char *buf, size_t len, const struct ip4_net *net) {
+	if (net->prefixlen == 0)
+		snprintf(buf, len, "*");
+	else
+		ip4_net_format(net, buf, len);
+}
+
+static cmd_status_t rule_list(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_acl_rule_list_req req = {.iface_id = GR_IFACE_ID_UNDEF};
+	struct libscols_table *table = scols_new_table();
+	const struct gr_acl_rule_list_resp *resp;
+	struct gr_iface iface;
+	void *resp_ptr = NULL;
+	char buf[BUFSIZ];
+
+	if (table == NULL)
+		return CMD_ERROR;
+	if (arg_str(p, "IFACE") != NULL) {
+		if (iface_from_name(c, arg_str(p, "IFACE"), &iface) < 0) {
+			scols_unref_table(table);
+			return CMD_ERROR;
+		}
+		req.iface_id = iface.id;
+	}
+	if (gr_api_client_send_recv(c, GR_ACL_RULE_LIST, sizeof(req), &req, &resp_ptr) < 0) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+
+	resp = resp_ptr;
+
+	scols_table_new_column(table, "IFACE", 0, 0);
+	scols_table_new_column(table, "DIR", 0, 0);
+	scols_table_new_column(table, "SEQ", 0, 0);
+	scols_table_new_column(table, "ACTION", 0, 0);
+	scols_table_new_column(table, "PROTO", 0, 0);
+	scols_table_new_column(table, "SRC", 0, 0);
+	scols_table_new_column(table, "DST", 0, 0);
+	scols_table_new_column(table, "SPORT", 0, 0);
+	scols_table_new_column(table, "DPORT", 0, 0);
+	scols_table_new_column(table, "DSCP", 0, 0);
+	scols_table_set_column_separator(table, "  ");
+
+	for (size_t i = 0; i < resp->n_entries; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_acl_entry *e = &resp->entries[i];
+		const struct gr_acl_rule *r = &e->rule;
+
+		if (iface_from_id(c, e->iface_id, &iface) == 0)
+			scols_line_sprintf(line, 0, "%s", iface.name);
+		else
+			scols_line_sprintf(line, 0, "%u", e->iface_id);
+		scols_line_set_data(line, 1, acl_dir_name(e->dir));
+		scols_line_sprintf(line, 2, "%u", r->seq);
+		if (r->action == GR_ACL_SET_VRF)
+			scols_line_sprintf(line, 3, "vrf %u", r->vrf_id);
+		else
+			scols_line_set_data(line, 3, r->action == GR_ACL_DENY ? "deny" : "permit");
+		if (r->proto == 0)
+			scols_line_set_data(line, 4, "*");
+		else
+			scols_line_sprintf(line, 4, "%u", r->proto);
+		format_net(buf, sizeof(buf), &r->src);
+		scols_line_set_data(line, 5, buf);
+		format_net(buf, sizeof(buf), &r->dst);
+		scols_line_set_data(line, 6, buf);
+		format_ports(buf, sizeof(buf), r->sport_min, r->sport_max);
+		scols_line_set_data(line, 7, buf);
+		format_ports(buf, sizeof(buf), r->dport_min, r->dport_max);
+		scols_line_set_data(line, 8, buf);
+		if (r->dscp == GR_ACL_DSCP_ANY)
+			scols_line_set_data(line, 9, "*");
+		else
+			scols_line_sprintf(line, 9, "%u", r->dscp);
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+#define IFACE_ARG with_help("Interface name.", ec_node_dyn("IFACE", complete_iface_names, NULL))
+#define DIR_ARG                                                                                    \
+	with_help(                                                                                 \
+		"Filter received (in) or forwarded (out) packets, or select their VRF (pbr).",     \
+		ec_node_re("DIR", "in|out|pbr")                                                    \
+	)
+#define SEQ_ARG                                                                                    \
+	with_help(                                                                                 \
+		"Rule sequence number, lower numbers are evaluated first.",                        \
+		ec_node_uint("SEQ", 0, UINT16_MAX, 10)                                             \
+	)
+#define PORTS_RE "^[0-9]+(-[0-9]+)?$"
+
+#define ACL_CTX(root, ctx, help) CLI_CONTEXT(root, ctx, CTX_ARG("acl", help))
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		ACL_CTX(root, CTX_ADD, "Create access list elements."),
+		"rule IFACE DIR seq SEQ (ACTION)|(vrf VRF) "
+		"[(proto PROTO),(src SRC),(dst DST),(sport SPORT),(dport DPORT),(dscp DSCP)]",
+		rule_add,
+		"Add or replace an IPv4 access list rule.",
+		IFACE_ARG,
+		DIR_ARG,
+		SEQ_ARG,
+		with_help("Rule action.", ec_node_re("ACTION", "permit|deny")),
+		with_help(
+			"Look the route up in this VRF (pbr only).",
+			ec_node_uint("VRF", 0, UINT16_MAX - 1, 10)
+		),
+		with_help(
+			"IP protocol name or number, any if unset.",
+			ec_node_re("PROTO", "tcp|udp|sctp|icmp|[0-9]+")
+		),
+		with_help("Source network, any if unset.", ec_node_re("SRC", IPV4_NET_RE)),
+		with_help("Destination network, any if unset.", ec_node_re("DST", IPV4_NET_RE)),
+		with_help("Source port or port range.", ec_node_re("SPORT", PORTS_RE)),
+		with_help("Destination port or port range.", ec_node_re("DPORT", PORTS_RE)),
+		with_help("DSCP value, any if unset.", ec_node_uint("DSCP", 0, 63, 10))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		ACL_CTX(root, CTX_DEL, "Delete access list elements."),
+		"rule IFACE DIR seq SEQ",
+		rule_del,
+		"Delete an access list rule.",
+		IFACE_ARG,
+		DIR_ARG,
+		SEQ_ARG
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		ACL_CTX(root, CTX_CLEAR, "Clear access list elements."),
+		"rules IFACE DIR",
+		acl_flush,
+		"Delete all rules of an access list.",
+		IFACE_ARG,
+		DIR_ARG
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		ACL_CTX(root, CTX_SHOW, "Show access list details."),
+		"rule [iface IFACE]",
+		rule_list,
+		"List access list rules.",
+		IFACE_ARG
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "acl",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+}
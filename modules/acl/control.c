@@ -0,0 +1,446 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "acl_priv.h"
+#include "gr_acl.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_log.h>
+#include <gr_macro.h>
+#include <gr_net_types.h>
+#include <gr_rcu.h>
+#include <gr_stb_ds.h>
+
+#include <event2/event.h>
+#include <rte_acl.h>
+#include <rte_errno.h>
+#include <rte_malloc.h>
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Rules configured on each interface and direction, sorted by sequence number.
+static struct gr_acl_rule *acl_rules[MAX_IFACES][GR_ACL_DIR_PBR + 1];
+// Interfaces with policy based routing rules.
+static unsigned pbr_ifaces;
+// Compiled contexts must have unique names, see rte_acl_create().
+static uint32_t acl_gen;
+
+// Input fields layout, see struct acl_ip4_key. The first field must be one
+// byte long, the other ones are grouped in 4 bytes words.
+static const struct rte_acl_field_def acl_ip4_defs[ACL_NUM_FIELDS] = {
+	[ACL_FIELD_PROTO] = {
+		.type = RTE_ACL_FIELD_TYPE_BITMASK,
+		.size = sizeof(uint8_t),
+		.field_index = ACL_FIELD_PROTO,
+		.input_index = 0,
+		.offset = offsetof(struct acl_ip4_key, proto),
+	},
+	[ACL_FIELD_SRC] = {
+		.type = RTE_ACL_FIELD_TYPE_MASK,
+		.size = sizeof(ip4_addr_t),
+		.field_index = ACL_FIELD_SRC,
+		.input_index = 1,
+		.offset = offsetof(struct acl_ip4_key, src),
+	},
+	[ACL_FIELD_DST] = {
+		.type = RTE_ACL_FIELD_TYPE_MASK,
+		.size = sizeof(ip4_addr_t),
+		.field_index = ACL_FIELD_DST,
+		.input_index = 2,
+		.offset = offsetof(struct acl_ip4_key, dst),
+	},
+	[ACL_FIELD_SPORT] = {
+		.type = RTE_ACL_FIELD_TYPE_RANGE,
+		.size = sizeof(rte_be16_t),
+		.field_index = ACL_FIELD_SPORT,
+		.input_index = 3,
+		.offset = offsetof(struct acl_ip4_key, sport),
+	},
+	[ACL_FIELD_DPORT] = {
+		.type = RTE_ACL_FIELD_TYPE_RANGE,
+		.size = sizeof(rte_be16_t),
+		.field_index = ACL_FIELD_DPORT,
+		.input_index = 3,
+		.offset = offsetof(struct acl_ip4_key, dport),
+	},
+	[ACL_FIELD_TOS] = {
+		.type = RTE_ACL_FIELD_TYPE_BITMASK,
+		.size = sizeof(uint8_t),
+		.field_index = ACL_FIELD_TOS,
+		.input_index = 4,
+		.offset = offsetof(struct acl_ip4_key, tos),
+	},
+};
+
+static void acl_rule_to_rte(struct acl_ip4_rule *r, const struct gr_acl_rule *rule) {
+	memset(r, 0, sizeof(*r));
+	r->data.category_mask = 1;
+	// lower sequence numbers are evaluated first
+	r->data.priority = RTE_ACL_MAX_PRIORITY - rule->seq;
+	if (rule->action == GR_ACL_SET_VRF)
+		r->data.userdata = ACL_USERDATA(rule->vrf_id);
+	else
+		r->data.userdata = ACL_USERDATA(rule->action);
+
+	r->field[ACL_FIELD_PROTO].value.u8 = rule->proto;
+	r->field[ACL_FIELD_PROTO].mask_range.u8 = rule->proto != 0 ? UINT8_MAX : 0;
+	r->field[ACL_FIELD_SRC].value.u32 = rte_be_to_cpu_32(rule->src.ip);
+	r->field[ACL_FIELD_SRC].mask_range.u32 = rule->src.prefixlen;
+	r->field[ACL_FIELD_DST].value.u32 = rte_be_to_cpu_32(rule->dst.ip);
+	r->field[ACL_FIELD_DST].mask_range.u32 = rule->dst.prefixlen;
+	if (rule->sport_min == 0 && rule->sport_max == 0) {
+		r->field[ACL_FIELD_SPORT].mask_range.u16 = UINT16_MAX;
+	} else {
+		r->field[ACL_FIELD_SPORT].value.u16 = rule->sport_min;
+		r->field[ACL_FIELD_SPORT].mask_range.u16 = rule->sport_max;
+	}
+	if (rule->dport_min == 0 && rule->dport_max == 0) {
+		r->field[ACL_FIELD_DPORT].mask_range.u16 = UINT16_MAX;
+	} else {
+		r->field[ACL_FIELD_DPORT].value.u16 = rule->dport_min;
+		r->field[ACL_FIELD_DPORT].mask_range.u16 = rule->dport_max;
+	}
+	if (rule->dscp != GR_ACL_DSCP_ANY) {
+		// the two ECN bits are ignored
+		r->field[ACL_FIELD_TOS].value.u8 = rule->dscp << 2;
+		r->field[ACL_FIELD_TOS].mask_range.u8 = 0xfc;
+	}
+}
+
+static void acl_ruleset_free(void *obj) {
+	struct acl_ruleset *set = obj;
+
+	rte_acl_free(set->ctx);
+	rte_free(set);
+}
+
+// Compile rules into a new ruleset. The classification method is selected by
+// rte_acl according to the best SIMD instructions supported by the CPU.
+static struct acl_ruleset *acl_ruleset_build(const struct gr_acl_rule *rules) {
+	struct rte_acl_config cfg = {
+		.num_categories = 1,
+		.num_fields = ACL_NUM_FIELDS,
+	};
+	struct rte_acl_param params = {
+		.socket_id = SOCKET_ID_ANY,
+		.rule_size = RTE_ACL_RULE_SZ(ACL_NUM_FIELDS),
+		.max_rule_num = arrlen(rules),
+	};
+	char name[RTE_ACL_NAMESIZE];
+	const struct gr_acl_rule *rule;
+	struct acl_ruleset *set;
+	struct acl_ip4_rule r;
+	int ret;
+
+	if ((set = rte_zmalloc(__func__, sizeof(*set), 0)) == NULL)
+		return errno_set_null(ENOMEM);
+
+	snprintf(name, sizeof(name), "acl_%u", acl_gen++);
+	params.name = name;
+	if ((set->ctx = rte_acl_create(&params)) == NULL) {
+		ret = rte_errno;
+		goto err;
+	}
+
+	arrforeach (rule, rules) {
+		acl_rule_to_rte(&r, rule);
+		if ((ret = rte_acl_add_rules(set->ctx, (struct rte_acl_rule *)&r, 1)) < 0) {
+			ret = -ret;
+			goto err;
+		}
+	}
+
+	memcpy(cfg.defs, acl_ip4_defs, sizeof(acl_ip4_defs));
+	if ((ret = rte_acl_build(set->ctx, &cfg)) < 0) {
+		LOG(ERR, "rte_acl_build: %s", rte_strerror(-ret));
+		ret = -ret;
+		goto err;
+	}
+
+	return set;
+err:
+	acl_ruleset_free(set);
+	return errno_set_null(ret);
+}
+
+// Replace the rules of an interface and direction. The new ruleset is swapped
+// atomically and the previous one is freed once all workers are done with it.
+// On error, the current rules are left untouched and the new ones are freed.
+static int acl_commit(struct iface *iface, uint8_t dir, struct gr_acl_rule *rules) {
+	const struct acl_ruleset **slot, *old;
+	struct acl_ruleset *set = NULL;
+
+	if (arrlen(rules) > 0 && (set = acl_ruleset_build(rules)) == NULL) {
+		arrfree(rules);
+		return -errno;
+	}
+
+	switch (dir) {
+	case GR_ACL_DIR_IN:
+		slot = &iface->acl_in;
+		break;
+	case GR_ACL_DIR_OUT:
+		slot = &iface->acl_out;
+		break;
+	default:
+		slot = &iface->pbr;
+		break;
+	}
+	old = *slot;
+	__atomic_store_n(slot, set, __ATOMIC_RELEASE);
+	if (dir == GR_ACL_DIR_IN)
+		gr_feature_enable(&ip_acl_in_feature, iface->id, set != NULL);
+	if (dir == GR_ACL_DIR_PBR && old == NULL && set != NULL) {
+		if (pbr_ifaces++ == 0)
+			ip_input_pbr_set(acl_pbr_classify);
+	} else if (dir == GR_ACL_DIR_PBR && old != NULL && set == NULL) {
+		// ip_input only invokes the classifier while it is needed
+		if (--pbr_ifaces == 0)
+			ip_input_pbr_set(NULL);
+	}
+	if (old != NULL)
+		gr_rcu_defer_free(acl_ruleset_free, (void *)old);
+
+	arrfree(acl_rules[iface->id][dir]);
+	acl_rules[iface->id][dir] = rules;
+
+	return 0;
+}
+
+static struct gr_acl_rule *acl_rules_copy(const struct gr_acl_rule *rules) {
+	struct gr_acl_rule *copy = NULL;
+	const struct gr_acl_rule *r;
+
+	arrforeach (r, rules)
+		arrpush(copy, *r);
+
+	return copy;
+}
+
+static int acl_rule_validate(const struct gr_acl_rule *r, uint8_t dir) {
+	bool ports = r->sport_min || r->sport_max || r->dport_min || r->dport_max;
+
+	if (dir == GR_ACL_DIR_PBR) {
+		if (r->action != GR_ACL_SET_VRF)
+			return errno_set(EINVAL);
+		if (r->vrf_id >= IP4_MAX_VRFS)
+			return errno_set(EOVERFLOW);
+	} else if (r->action != GR_ACL_PERMIT && r->action != GR_ACL_DENY) {
+		return errno_set(EINVAL);
+	}
+	if (r->src.prefixlen > 32 || r->dst.prefixlen > 32)
+		return errno_set(EINVAL);
+	if (r->dscp != GR_ACL_DSCP_ANY && r->dscp > 63)
+		return errno_set(EINVAL);
+	if (r->sport_min > r->sport_max || r->dport_min > r->dport_max)
+		return errno_set(ERANGE);
+	// ports are only extracted for these protocols
+	if (ports && r->proto != IPPROTO_TCP && r->proto != IPPROTO_UDP
+	    && r->proto != IPPROTO_SCTP)
+		return errno_set(EPROTONOSUPPORT);
+
+	return 0;
+}
+
+static inline ip4_addr_t acl_netmask(uint8_t prefixlen) {
+	if (prefixlen == 0)
+		return 0;
+	return rte_cpu_to_be_32(UINT32_MAX << (32 - prefixlen));
+}
+
+static struct iface *acl_iface(uint16_t iface_id, uint8_t dir) {
+	if (dir > GR_ACL_DIR_PBR)
+		return errno_set_null(EINVAL);
+	return iface_from_id(iface_id);
+}
+
+// API handlers ////////////////////////////////////////////////////////////////
+
+static struct api_out rule_add_cb(const void *request, void ** /*response*/) {
+	const struct gr_acl_rule_add_req *req = request;
+	struct gr_acl_rule *rules, rule;
+	struct iface *iface;
+	size_t i;
+
+	if ((iface = acl_iface(req->entry.iface_id, req->entry.dir)) == NULL)
+		return api_out(errno, 0);
+	if (acl_rule_validate(&req->entry.rule, req->entry.dir) < 0)
+		return api_out(errno, 0);
+
+	rule = req->entry.rule;
+	rule.src.ip &= acl_netmask(rule.src.prefixlen);
+	rule.dst.ip &= acl_netmask(rule.dst.prefixlen);
+
+	rules = acl_rules_copy(acl_rules[iface->id][req->entry.dir]);
+	for (i = 0; i < arrlen(rules) && rules[i].seq < rule.seq; i++)
+		;
+	if (i < arrlen(rules) && rules[i].seq == rule.seq) {
+		if (!req->exist_ok) {
+			arrfree(rules);
+			return api_out(EEXIST, 0);
+		}
+		rules[i] = rule;
+	} else {
+		if (arrlen(rules) >= GR_ACL_MAX_RULES) {
+			arrfree(rules);
+			return api_out(ENOSPC, 0);
+		}
+		arrins(rules, i, rule);
+	}
+
+	if (acl_commit(iface, req->entry.dir, rules) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out rule_del_cb(const void *request, void ** /*response*/) {
+	const struct gr_acl_rule_del_req *req = request;
+	struct gr_acl_rule *rules;
+	struct iface *iface;
+	size_t i;
+
+	if ((iface = acl_iface(req->iface_id, req->dir)) == NULL)
+		return api_out(errno, 0);
+
+	rules = acl_rules[iface->id][req->dir];
+	for (i = 0; i < arrlen(rules) && rules[i].seq != req->seq; i++)
+		;
+	if (i == arrlen(rules)) {
+		if (req->missing_ok)
+			return api_out(0, 0);
+		return api_out(ENOENT, 0);
+	}
+
+	rules = acl_rules_copy(rules);
+	arrdel(rules, i);
+	if (acl_commit(iface, req->dir, rules) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out rule_list_cb(const void *request, void **response) {
+	const struct gr_acl_rule_list_req *req = request;
+	struct gr_acl_rule_list_resp *resp;
+	const struct gr_acl_rule *r;
+	struct gr_acl_entry *e;
+	uint16_t first, last;
+	size_t len, n;
+
+	first = 0;
+	last = MAX_IFACES - 1;
+	if (req->iface_id != GR_IFACE_ID_UNDEF) {
+		if (iface_from_id(req->iface_id) == NULL)
+			return api_out(errno, 0);
+		first = last = req->iface_id;
+	}
+
+	n = 0;
+	for (uint16_t id = first; id <= last; id++) {
+		for (uint8_t dir = GR_ACL_DIR_IN; dir <= GR_ACL_DIR_PBR; dir++)
+			n += arrlen(acl_rules[id][dir]);
+	}
+
+	len = sizeof(*resp) + n * sizeof(*resp->entries);
+	if (len > GR_API_MAX_MSG_LEN)
+		return api_out(EMSGSIZE, 0);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	for (uint16_t id = first; id <= last; id++) {
+		for (uint8_t dir = GR_ACL_DIR_IN; dir <= GR_ACL_DIR_PBR; dir++) {
+			arrforeach (r, acl_rules[id][dir]) {
+				e = &resp->entries[resp->n_entries++];
+				e->iface_id = id;
+				e->dir = dir;
+				e->rule = *r;
+			}
+		}
+	}
+
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+static struct api_out flush_cb(const void *request, void ** /*response*/) {
+	const struct gr_acl_flush_req *req = request;
+	struct iface *iface;
+
+	if ((iface = acl_iface(req->iface_id, req->dir)) == NULL)
+		return api_out(errno, 0);
+	if (acl_commit(iface, req->dir, NULL) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+// module //////////////////////////////////////////////////////////////////////
+
+static void acl_iface_event_handler(iface_event_t event, struct iface *iface) {
+	if (event != IFACE_EVENT_PRE_REMOVE)
+		return;
+	// removing the rules never fails
+	acl_commit(iface, GR_ACL_DIR_IN, NULL);
+	acl_commit(iface, GR_ACL_DIR_OUT, NULL);
+	acl_commit(iface, GR_ACL_DIR_PBR, NULL);
+}
+
+static void acl_fini(struct event_base *) {
+	struct iface *iface = NULL;
+
+	while ((iface = iface_next(GR_IFACE_TYPE_UNDEF, iface)) != NULL)
+		acl_iface_event_handler(IFACE_EVENT_PRE_REMOVE, iface);
+}
+
+static struct gr_module acl_module = {
+	.name = "acl",
+	.fini = acl_fini,
+	.fini_prio = 1000,
+};
+
+static struct gr_api_handler rule_add_handler = {
+	.name = "acl rule add",
+	.request_type = GR_ACL_RULE_ADD,
+	.callback = rule_add_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler rule_del_handler = {
+	.name = "acl rule del",
+	.request_type = GR_ACL_RULE_DEL,
+	.callback = rule_del_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler rule_list_handler = {
+	.name = "acl rule list",
+	.request_type = GR_ACL_RULE_LIST,
+	.callback = rule_list_cb,
+};
+static struct gr_api_handler flush_handler = {
+	.name = "acl flush",
+	.request_type = GR_ACL_FLUSH,
+	.callback = flush_cb,
+	.flags = GR_API_F_CONFIG,
+};
+
+static struct iface_event_handler acl_iface_event = {
+	.callback = acl_iface_event_handler,
+};
+
+RTE_INIT(acl_constructor) {
+	gr_register_api_handler(&rule_add_handler);
+	gr_register_api_handler(&rule_del_handler);
+	gr_register_api_handler(&rule_list_handler);
+	gr_register_api_handler(&flush_handler);
+	gr_register_module(&acl_module);
+	iface_event_register_handler(&acl_iface_event);
+}
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "acl_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_feature.h>
+#include <gr_graph.h>
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_mbuf.h>
+
+#include <rte_graph_worker.h>
+#include <rte_ip.h>
+
+enum {
+	FORWARD = 0,
+	LOCAL,
+	DENY,
+	EDGE_COUNT,
+};
+
+// Same decision as ip_input for permitted packets.
+static inline rte_edge_t permit_edge(const struct nexthop *nh, const struct rte_ipv4_hdr *ip) {
+	if (nh == NULL) // broadcast or link-local multicast
+		return LOCAL;
+	if (nh->flags & GR_IP4_NH_F_LOCAL && ip->dst_addr == nh->ip)
+		return LOCAL;
+	return FORWARD;
+}
+
+struct gr_feature ip_acl_in_feature = {
+	.arc = &ip4_input_features,
+	.node = "ip_acl_in",
+	.order = 100,
+};
+
+// Classify packets received on interfaces with an ingress ACL. Their route is
+// already resolved by ip_input. Permitted packets go to the next enabled input
+// feature or follow the path ip_input would have chosen.
+static uint16_t
+ip_acl_in_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	const struct acl_ruleset *rulesets[RTE_GRAPH_BURST_SIZE];
+	bool deny[RTE_GRAPH_BURST_SIZE];
+	const struct iface *iface, *last = NULL;
+	gr_feature_mask_t features = 0;
+	const struct rte_ipv4_hdr *ip;
+	const struct nexthop *nh;
+	struct rte_mbuf *m;
+	rte_edge_t edge;
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		m = objs[i];
+		gr_mbuf_prefetch_ahead(objs, i, nb_objs);
+		rulesets[i] = ip_output_mbuf_data(m)->input_iface->acl_in;
+	}
+
+	acl_classify_burst(rulesets, (struct rte_mbuf **)objs, nb_objs, deny);
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		m = objs[i];
+		nh = ip_output_mbuf_data(m)->nh;
+		iface = ip_output_mbuf_data(m)->input_iface;
+		ip = rte_pktmbuf_mtod(m, const struct rte_ipv4_hdr *);
+		if (iface != last) {
+			last = iface;
+			features = gr_feature_enabled(&ip4_input_features, iface->id);
+		}
+		if (deny[i])
+			edge = DENY;
+		else if ((edge = gr_feature_next(&ip_acl_in_feature, features))
+			 == RTE_EDGE_ID_INVALID)
+			edge = permit_edge(nh, ip);
+		rte_node_enqueue_x1(graph, node, edge, m);
+	}
+
+	return nb_objs;
+}
+
+static void ip_acl_in_register(void) {
+	gr_feature_register(&ip_acl_in_feature);
+}
+
+static struct rte_node_register ip_acl_in_node = {
+	.name = "ip_acl_in",
+
+	.process = ip_acl_in_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[FORWARD] = "ip_forward",
+		[LOCAL] = "ip_input_local",
+		[DENY] = "ip_acl_in_deny",
+	},
+};
+
+static struct gr_node_info ip_acl_in_info = {
+	.node = &ip_acl_in_node,
+	.register_callback = ip_acl_in_register,
+};
+
+GR_NODE_REGISTER(ip_acl_in_info);
+
+GR_DROP_REGISTER(ip_acl_in_deny);
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "acl_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_graph.h>
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_mbuf.h>
+
+#include <rte_graph_worker.h>
+
+enum {
+	OUTPUT = 0,
+	DENY,
+	EDGE_COUNT,
+};
+
+// Classify forwarded packets sent to interfaces with an egress ACL. The next
+// hop is resolved by ip_forward, ECMP groups included.
+static uint16_t
+ip_acl_out_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	const struct acl_ruleset *rulesets[RTE_GRAPH_BURST_SIZE];
+	bool deny[RTE_GRAPH_BURST_SIZE];
+	const struct nexthop *nh;
+	struct rte_mbuf *m;
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		m = objs[i];
+		gr_mbuf_prefetch_ahead(objs, i, nb_objs);
+		nh = ip_output_mbuf_data(m)->nh;
+		rulesets[i] = nh->iface != NULL ? nh->iface->acl_out : NULL;
+	}
+
+	acl_classify_burst(rulesets, (struct rte_mbuf **)objs, nb_objs, deny);
+
+	for (uint16_t i = 0; i < nb_objs; i++)
+		rte_node_enqueue_x1(graph, node, deny[i] ? DENY : OUTPUT, objs[i]);
+
+	return nb_objs;
+}
+
+static void ip_acl_out_register(void) {
+	ip_forward_acl_register("ip_acl_out");
+}
+
+static struct rte_node_register ip_acl_out_node = {
+	.name = "ip_acl_out",
+
+	.process = ip_acl_out_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[OUTPUT] = "ip_output",
+		[DENY] = "ip_acl_out_deny",
+	},
+};
+
+static struct gr_node_info ip_acl_out_info = {
+	.node = &ip_acl_out_node,
+	.register_callback = ip_acl_out_register,
+};
+
+GR_NODE_REGISTER(ip_acl_out_info);
+
+GR_DROP_REGISTER(ip_acl_out_deny);
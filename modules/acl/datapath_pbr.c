@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "acl_priv.h"
+
+#include <gr_eth_input.h>
+#include <gr_iface.h>
+
+#include <rte_graph_worker.h>
+#include <rte_mbuf.h>
+
+// Invoked by ip_input with the packets that need a route lookup. Consecutive
+// packets of the same input interface are classified in bulk. Packets that
+// match no rule keep the VRF of their input interface.
+void acl_pbr_classify(struct rte_mbuf **mbufs, uint16_t *vrfs, uint16_t count) {
+	const struct acl_ruleset *rulesets[RTE_GRAPH_BURST_SIZE];
+	uint32_t results[RTE_GRAPH_BURST_SIZE];
+	uint16_t i;
+
+	for (i = 0; i < count; i++)
+		rulesets[i] = eth_input_mbuf_data(mbufs[i])->iface->pbr;
+
+	acl_classify_results(rulesets, mbufs, count, results);
+
+	for (i = 0; i < count; i++) {
+		if (results[i] != 0)
+			vrfs[i] = ACL_USERDATA_VRF(results[i]);
+	}
+}
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_API_ACL
+#define _GR_API_ACL
+
+#include <gr_api.h>
+#include <gr_infra.h>
+#include <gr_net_types.h>
+
+#include <stdint.h>
+
+#define GR_ACL_MODULE 0xac15
+
+// Max number of rules per interface and direction.
+#define GR_ACL_MAX_RULES 4096
+
+#define GR_ACL_DIR_IN 0 // received packets, after the route lookup
+#define GR_ACL_DIR_OUT 1 // forwarded packets, before ip_output
+#define GR_ACL_DIR_PBR 2 // received packets, before the route lookup
+
+#define GR_ACL_PERMIT 0
+#define GR_ACL_DENY 1
+#define GR_ACL_SET_VRF 2 // GR_ACL_DIR_PBR only
+
+#define GR_ACL_DSCP_ANY 0xff
+
+// Stateless IPv4 filtering rule. Rules are evaluated by increasing sequence
+// number, the first matching rule wins. Packets that match no rule are
+// permitted.
+//
+// Policy based routing rules (GR_ACL_DIR_PBR) all have the GR_ACL_SET_VRF
+// action. The route of matching packets is looked up in the FIB of vrf_id
+// instead of the VRF of their input interface, before the ingress ACL.
+struct gr_acl_rule {
+	uint16_t seq;
+	uint8_t action; // GR_ACL_PERMIT, GR_ACL_DENY or GR_ACL_SET_VRF
+	uint8_t proto; // 0 for any
+	struct ip4_net src; // 0.0.0.0/0 for any
+	struct ip4_net dst; // 0.0.0.0/0 for any
+	// TCP, UDP and SCTP port ranges in host order, 0-0 for any
+	uint16_t sport_min;
+	uint16_t sport_max;
+	uint16_t dport_min;
+	uint16_t dport_max;
+	uint8_t dscp; // GR_ACL_DSCP_ANY for any
+	uint16_t vrf_id; // GR_ACL_SET_VRF only
+};
+
+struct gr_acl_entry {
+	uint16_t iface_id;
+	uint8_t dir; // GR_ACL_DIR_*
+	struct gr_acl_rule rule;
+};
+
+#define GR_ACL_RULE_ADD REQUEST_TYPE(GR_ACL_MODULE, 0x0001)
+
+struct gr_acl_rule_add_req {
+	struct gr_acl_entry entry;
+	uint8_t exist_ok; // replace the rule with the same seq
+};
+
+// struct gr_acl_rule_add_resp { };
+
+#define GR_ACL_RULE_DEL REQUEST_TYPE(GR_ACL_MODULE, 0x0002)
+
+struct gr_acl_rule_del_req {
+	uint16_t iface_id;
+	uint8_t dir;
+	uint16_t seq;
+	uint8_t missing_ok;
+};
+
+// struct gr_acl_rule_del_resp { };
+
+#define GR_ACL_RULE_LIST REQUEST_TYPE(GR_ACL_MODULE, 0x0003)
+
+struct gr_acl_rule_list_req {
+	uint16_t iface_id; // GR_IFACE_ID_UNDEF for all
+};
+
+struct gr_acl_rule_list_resp {
+	uint16_t n_entries;
+	struct gr_acl_entry entries[/* n_entries */];
+};
+
+#define GR_ACL_FLUSH REQUEST_TYPE(GR_ACL_MODULE, 0x0004)
+
+struct gr_acl_flush_req {
+	uint16_t iface_id;
+	uint8_t dir;
+};
+
+// struct gr_acl_flush_resp { };
+
+#endif
@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _BFD_PRIV_H
+#define _BFD_PRIV_H
+
+#include <gr_bfd.h>
+#include <gr_net_types.h>
+
+#include <rte_byteorder.h>
+#include <rte_common.h>
+#include <rte_spinlock.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/queue.h>
+
+// Generic control packet format without authentication (RFC 5880 section 4.1).
+struct bfd_ctrl {
+	uint8_t vers_diag; // version (3 bits) | diagnostic (5 bits)
+	uint8_t flags; // state (2 bits) | P | F | C | A | D | M
+	uint8_t detect_mult;
+	uint8_t length;
+	rte_be32_t my_disc;
+	rte_be32_t your_disc;
+	rte_be32_t desired_min_tx;
+	rte_be32_t required_min_rx;
+	rte_be32_t required_min_echo_rx;
+} __rte_packed;
+
+#define BFD_VERSION 1
+#define BFD_F_POLL 0x20
+#define BFD_F_FINAL 0x10
+#define BFD_F_AUTH 0x04
+#define BFD_F_MULTIPOINT 0x01
+#define BFD_STATE(flags) ((flags) >> 6)
+#define BFD_DIAG(vers_diag) ((vers_diag) & 0x1f)
+#define BFD_VERS(vers_diag) ((vers_diag) >> 5)
+
+// RFC 5881 section 5: all single hop packets are sent with the max TTL.
+#define BFD_TTL 255
+// RFC 5881 section 4: source port in the 49152 through 65535 range.
+#define BFD_SRC_PORT_MIN 49152
+// RFC 5880 section 6.8.3: not less than one second while not up.
+#define BFD_SLOW_INTERVAL_US 1000000
+
+#define BFD_MAX_SESSIONS 4096
+// Max number of sessions taken over by a worker per graph walk.
+#define BFD_ADOPT_BURST 4
+#define BFD_EVENT_RING_SIZE 4096
+
+// Per-worker timer wheel. Each slot covers BFD_WHEEL_TICK_US.
+#define BFD_WHEEL_TICK_US 1000
+#define BFD_WHEEL_SLOTS 1024
+
+struct bfd_session {
+	// Configuration, immutable once the session is published.
+	uint16_t vrf_id;
+	ip4_addr_t local;
+	ip4_addr_t peer;
+	uint32_t local_disc;
+	uint32_t min_tx_us;
+	uint32_t min_rx_us;
+	uint8_t detect_mult;
+	rte_be16_t src_port;
+
+	// Set by the control plane. The owner worker then releases the session.
+	bool deleted;
+	// Set by the owner worker, the session is no longer in any timer wheel.
+	bool released;
+
+	// State variables, updated by the worker that owns the session timers
+	// and by the workers that receive the peer control packets.
+	rte_spinlock_t lock;
+	uint8_t state;
+	uint8_t diag;
+	uint8_t remote_state;
+	uint8_t remote_detect_mult;
+	uint32_t remote_disc;
+	uint32_t remote_min_tx_us;
+	uint32_t remote_min_rx_us;
+	bool send_final; // a poll was received, reply with the F bit set
+	uint64_t detect_deadline; // TSC, zero while not armed
+	uint64_t next_tx; // TSC
+
+	// Owned by the worker which has adopted the session.
+	LIST_ENTRY(bfd_session) wheel_next;
+	uint64_t wheel_expire; // TSC
+
+	uint64_t tx_packets;
+	uint64_t rx_packets;
+
+	// Control plane only.
+	uint8_t reported_state;
+	uint64_t n_down;
+};
+
+// State change notification posted by the workers.
+struct bfd_event {
+	// The session may be freed before the event is processed. It is only
+	// dereferenced if it is still the one registered for vrf_id and peer.
+	struct bfd_session *session;
+	uint16_t vrf_id;
+	ip4_addr_t peer;
+	uint8_t state; // GR_BFD_STATE_*
+	uint8_t diag;
+};
+
+// Datapath interface.
+struct bfd_session *bfd_session_lookup(uint16_t vrf_id, ip4_addr_t peer);
+// Take over a session which is not owned by any worker. NULL if none.
+struct bfd_session *bfd_session_adopt(void);
+// Release the ownership of a session, another worker will adopt it.
+void bfd_session_abandon(struct bfd_session *);
+// Notify the control plane. With a NULL event, only wake it up to collect the
+// released sessions.
+void bfd_event_post(const struct bfd_event *);
+
+#endif
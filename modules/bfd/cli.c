@@ -0,0 +1,210 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_bfd.h>
+#include <gr_cli.h>
+#include <gr_net_types.h>
+#include <gr_table.h>
+
+#include <ecoli.h>
+#include <libsmartcols.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static cmd_status_t session_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_bfd_session_add_req req = {.exist_ok = true};
+	struct gr_bfd_session *s = &req.session;
+	uint16_t mult;
+	uint32_t ms;
+
+	if (inet_pton(AF_INET, arg_str(p, "PEER"), &s->peer) != 1) {
+		errno = EINVAL;
+		return CMD_ERROR;
+	}
+	if (inet_pton(AF_INET, arg_str(p, "LOCAL"), &s->local) != 1) {
+		errno = EINVAL;
+		return CMD_ERROR;
+	}
+	if (arg_u16(p, "VRF", &s->vrf_id) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u32(p, "TX", &ms) == 0)
+		s->min_tx_us = ms * 1000;
+	else if (errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u32(p, "RX", &ms) == 0)
+		s->min_rx_us = ms * 1000;
+	else if (errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u16(p, "MULT", &mult) == 0)
+		s->detect_mult = mult;
+	else if (errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_BFD_SESSION_ADD, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t session_del(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_bfd_session_del_req req = {.missing_ok = true};
+
+	if (inet_pton(AF_INET, arg_str(p, "PEER"), &req.peer) != 1) {
+		errno = EINVAL;
+		return CMD_ERROR;
+	}
+	if (arg_u16(p, "VRF", &req.vrf_id) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_BFD_SESSION_DEL, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t session_list(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_bfd_session_list_req req = {.vrf_id = GR_VRF_ID_ALL};
+	struct libscols_table *table = scols_new_table();
+	const struct gr_bfd_session_list_resp *resp;
+	void *resp_ptr = NULL;
+
+	if (table == NULL)
+		return CMD_ERROR;
+	if (arg_u16(p, "VRF", &req.vrf_id) < 0 && errno != ENOENT) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+
+	scols_table_new_column(table, "VRF", 0, 0);
+	scols_table_new_column(table, "PEER", 0, 0);
+	scols_table_new_column(table, "LOCAL", 0, 0);
+	scols_table_new_column(table, "STATE", 0, 0);
+	scols_table_new_column(table, "REMOTE", 0, 0);
+	scols_table_new_column(table, "DIAG", 0, 0);
+	scols_table_new_column(table, "TX_MS", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "RX_MS", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "MULT", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "TX_PKTS", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "RX_PKTS", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "DOWNS", 0, SCOLS_FL_RIGHT);
+	scols_table_set_column_separator(table, "  ");
+
+	do {
+		if (gr_api_client_send_recv(c, GR_BFD_SESSION_LIST, sizeof(req), &req, &resp_ptr)
+		    < 0) {
+			scols_unref_table(table);
+			return CMD_ERROR;
+		}
+
+		resp = resp_ptr;
+		for (size_t i = 0; i < resp->n_sessions; i++) {
+			struct libscols_line *line = scols_table_new_line(table, NULL);
+			const struct gr_bfd_session *s = &resp->sessions[i];
+
+			scols_line_sprintf(line, 0, "%u", s->vrf_id);
+			scols_line_sprintf(line, 1, IP4_ADDR_FMT, IP4_ADDR_SPLIT(&s->peer));
+			scols_line_sprintf(line, 2, IP4_ADDR_FMT, IP4_ADDR_SPLIT(&s->local));
+			scols_line_sprintf(line, 3, "%s", gr_bfd_state_name(s->state));
+			scols_line_sprintf(line, 4, "%s", gr_bfd_state_name(s->remote_state));
+			scols_line_sprintf(line, 5, "%s", gr_bfd_diag_name(s->diag));
+			scols_line_sprintf(line, 6, "%u", s->min_tx_us / 1000);
+			scols_line_sprintf(line, 7, "%u", s->min_rx_us / 1000);
+			scols_line_sprintf(line, 8, "%u", s->detect_mult);
+			scols_line_sprintf(line, 9, "%" PRIu64, s->tx_packets);
+			scols_line_sprintf(line, 10, "%" PRIu64, s->rx_packets);
+			scols_line_sprintf(line, 11, "%" PRIu64, s->n_down);
+		}
+
+		req.cursor = resp->next_cursor;
+		free(resp_ptr);
+	} while (req.cursor != 0);
+
+	gr_table_print(table);
+	scols_unref_table(table);
+
+	return CMD_SUCCESS;
+}
+
+#define BFD_CTX(root, ctx, help) CLI_CONTEXT(root, ctx, CTX_ARG("bfd", help))
+#define VRF_ARG with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10))
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		BFD_CTX(root, CTX_ADD, "Create bidirectional forwarding detection sessions."),
+		"session PEER local LOCAL [(vrf VRF),(tx TX),(rx RX),(multiplier MULT)]",
+		session_add,
+		"Detect failures of a directly connected IPv4 peer.",
+		with_help("Peer address.", ec_node_re("PEER", IPV4_RE)),
+		with_help("Local address of the control packets.", ec_node_re("LOCAL", IPV4_RE)),
+		VRF_ARG,
+		with_help(
+			"Desired min TX interval in milliseconds (default 300).",
+			ec_node_uint("TX", 10, UINT32_MAX / 1000, 10)
+		),
+		with_help(
+			"Required min RX interval in milliseconds (default 300).",
+			ec_node_uint("RX", 10, UINT32_MAX / 1000, 10)
+		),
+		with_help(
+			"Detection time multiplier (default 3).",
+			ec_node_uint("MULT", 1, UINT8_MAX, 10)
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		BFD_CTX(root, CTX_DEL, "Delete bidirectional forwarding detection sessions."),
+		"session PEER [vrf VRF]",
+		session_del,
+		"Delete a session.",
+		with_help("Peer address.", ec_node_re("PEER", IPV4_RE)),
+		VRF_ARG
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		BFD_CTX(root, CTX_SHOW, "Show bidirectional forwarding detection sessions."),
+		"session [vrf VRF]",
+		session_list,
+		"List all sessions.",
+		VRF_ARG
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static void session_event_print(const struct gr_api_client *, const void *obj) {
+	const struct gr_bfd_session *s = obj;
+
+	printf("vrf=%u peer=" IP4_ADDR_FMT " local=" IP4_ADDR_FMT " state=%s diag=%s",
+	       s->vrf_id,
+	       IP4_ADDR_SPLIT(&s->peer),
+	       IP4_ADDR_SPLIT(&s->local),
+	       gr_bfd_state_name(s->state),
+	       gr_bfd_diag_name(s->diag));
+}
+
+static struct cli_event_type session_state_event = {
+	.ev_type = GR_BFD_EVENT_SESSION_STATE,
+	.name = "bfd session",
+	.print = session_event_print,
+};
+
+static struct gr_cli_context ctx = {
+	.name = "bfd",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+	register_event_type(&session_state_event);
+}
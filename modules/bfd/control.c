@@ -0,0 +1,375 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "bfd_priv.h"
+
+#include <gr_api.h>
+#include <gr_bfd.h>
+#include <gr_control.h>
+#include <gr_ip4_control.h>
+#include <gr_log.h>
+#include <gr_macro.h>
+#include <gr_rcu.h>
+#include <gr_stb_ds.h>
+
+#include <event2/event.h>
+#include <rte_errno.h>
+#include <rte_hash.h>
+#include <rte_malloc.h>
+#include <rte_random.h>
+#include <rte_ring.h>
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct bfd_key {
+	ip4_addr_t peer;
+	uint32_t vrf_id; // zero padded
+};
+
+static struct rte_hash *bfd_hash;
+// Sessions which are not in the timer wheel of any worker.
+static struct rte_ring *adopt_ring;
+static struct rte_ring *event_ring;
+static struct event *bfd_ev;
+// Set when a state change could not be posted.
+static atomic_bool event_overflow;
+// Deleted sessions, waiting for their owner worker to release them.
+static struct bfd_session **deleted;
+static uint32_t next_disc;
+
+struct bfd_session *bfd_session_lookup(uint16_t vrf_id, ip4_addr_t peer) {
+	struct bfd_key key = {.peer = peer, .vrf_id = vrf_id};
+	void *data;
+
+	if (rte_hash_lookup_data(bfd_hash, &key, &data) < 0)
+		return NULL;
+
+	return data;
+}
+
+struct bfd_session *bfd_session_adopt(void) {
+	void *s;
+
+	if (rte_ring_dequeue(adopt_ring, &s) < 0)
+		return NULL;
+
+	return s;
+}
+
+void bfd_session_abandon(struct bfd_session *s) {
+	// The ring is large enough for all sessions, see session_add_cb.
+	if (rte_ring_enqueue(adopt_ring, s) < 0)
+		LOG(ERR, "bfd peer " IP4_ADDR_FMT ": adopt ring full", IP4_ADDR_SPLIT(&s->peer));
+}
+
+void bfd_event_post(const struct bfd_event *ev) {
+	if (ev != NULL && rte_ring_enqueue_elem(event_ring, ev, sizeof(*ev)) < 0)
+		atomic_store(&event_overflow, true);
+	// The event may come from any dataplane thread. Defer the processing
+	// to the event loop running in the main lcore.
+	event_active(bfd_ev, 0, 0);
+}
+
+static void bfd_to_api(struct bfd_session *s, struct gr_bfd_session *api) {
+	api->vrf_id = s->vrf_id;
+	api->local = s->local;
+	api->peer = s->peer;
+	api->min_tx_us = s->min_tx_us;
+	api->min_rx_us = s->min_rx_us;
+	api->detect_mult = s->detect_mult;
+	api->local_disc = s->local_disc;
+	rte_spinlock_lock(&s->lock);
+	api->state = s->state;
+	api->remote_state = s->remote_state;
+	api->diag = s->diag;
+	api->remote_disc = s->remote_disc;
+	rte_spinlock_unlock(&s->lock);
+	api->tx_packets = __atomic_load_n(&s->tx_packets, __ATOMIC_RELAXED);
+	api->rx_packets = __atomic_load_n(&s->rx_packets, __ATOMIC_RELAXED);
+	api->n_down = s->n_down;
+}
+
+static void bfd_report(struct bfd_session *s, uint8_t state, uint8_t diag) {
+	struct gr_bfd_session api;
+	struct nexthop *nh;
+
+	if (state == s->reported_state)
+		return;
+
+	LOG(INFO,
+	    "vrf %u peer " IP4_ADDR_FMT ": %s -> %s (%s)",
+	    s->vrf_id,
+	    IP4_ADDR_SPLIT(&s->peer),
+	    gr_bfd_state_name(s->reported_state),
+	    gr_bfd_state_name(state),
+	    gr_bfd_diag_name(diag));
+
+	// Only an up session that goes down is a failure, a peer that does not
+	// run BFD must not be removed from the ECMP groups.
+	nh = ip4_nexthop_lookup(s->vrf_id, s->peer);
+	if (s->reported_state == GR_BFD_STATE_UP) {
+		s->n_down++;
+		if (nh != NULL)
+			ip4_nexthop_set_alive(nh, false);
+	} else if (state == GR_BFD_STATE_UP) {
+		if (nh != NULL)
+			ip4_nexthop_set_alive(nh, true);
+	}
+	s->reported_state = state;
+
+	bfd_to_api(s, &api);
+	gr_event_push(GR_BFD_EVENT_SESSION_STATE, s, &api, sizeof(api));
+}
+
+static void bfd_event_cb(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	struct bfd_event evs[64];
+	struct bfd_session *s;
+	const void *key;
+	uint32_t iter;
+	void *data;
+	unsigned n;
+
+	do {
+		n = rte_ring_dequeue_burst_elem(
+			event_ring, evs, sizeof(*evs), ARRAY_DIM(evs), NULL
+		);
+		for (unsigned i = 0; i < n; i++) {
+			if (bfd_session_lookup(evs[i].vrf_id, evs[i].peer) != evs[i].session)
+				continue;
+			bfd_report(evs[i].session, evs[i].state, evs[i].diag);
+		}
+	} while (n == ARRAY_DIM(evs));
+
+	// Some state changes were lost, compare all sessions.
+	if (atomic_exchange(&event_overflow, false)) {
+		iter = 0;
+		while (rte_hash_iterate(bfd_hash, &key, &data, &iter) >= 0) {
+			uint8_t state, diag;
+			s = data;
+			rte_spinlock_lock(&s->lock);
+			state = s->state;
+			diag = s->diag;
+			rte_spinlock_unlock(&s->lock);
+			bfd_report(s, state, diag);
+		}
+	}
+
+	for (int i = arrlen(deleted) - 1; i >= 0; i--) {
+		s = deleted[i];
+		if (!__atomic_load_n(&s->released, __ATOMIC_ACQUIRE))
+			continue;
+		// bfd_input may still hold a reference obtained before deletion.
+		gr_rcu_defer_free(rte_free, s);
+		arrdelswap(deleted, i);
+	}
+}
+
+static struct api_out session_add_cb(const void *request, void ** /*response*/) {
+	const struct gr_bfd_session_add_req *req = request;
+	const struct gr_bfd_session *conf = &req->session;
+	struct bfd_key key = {.peer = conf->peer, .vrf_id = conf->vrf_id};
+	struct bfd_session *s;
+	struct nexthop *nh;
+	int ret;
+
+	if (conf->vrf_id >= IP4_MAX_VRFS)
+		return api_out(EOVERFLOW, 0);
+	if (conf->peer == 0 || conf->local == 0 || conf->peer == conf->local)
+		return api_out(EINVAL, 0);
+	if ((conf->min_tx_us != 0 && conf->min_tx_us < GR_BFD_MIN_INTERVAL_US)
+	    || (conf->min_rx_us != 0 && conf->min_rx_us < GR_BFD_MIN_INTERVAL_US))
+		return api_out(ERANGE, 0);
+
+	if (rte_hash_lookup(bfd_hash, &key) >= 0)
+		return api_out(req->exist_ok ? 0 : EEXIST, 0);
+
+	nh = ip4_nexthop_lookup(conf->vrf_id, conf->local);
+	if (nh == NULL || !(nh->flags & GR_IP4_NH_F_LOCAL))
+		return api_out(EADDRNOTAVAIL, 0);
+
+	// Deleted sessions are still in the timer wheels until released.
+	if (rte_hash_count(bfd_hash) + arrlen(deleted) >= BFD_MAX_SESSIONS)
+		return api_out(ENOSPC, 0);
+
+	s = rte_zmalloc(__func__, sizeof(*s), RTE_CACHE_LINE_SIZE);
+	if (s == NULL)
+		return api_out(ENOMEM, 0);
+
+	s->vrf_id = conf->vrf_id;
+	s->local = conf->local;
+	s->peer = conf->peer;
+	s->min_tx_us = conf->min_tx_us ?: GR_BFD_DEFAULT_INTERVAL_US;
+	s->min_rx_us = conf->min_rx_us ?: GR_BFD_DEFAULT_INTERVAL_US;
+	s->detect_mult = conf->detect_mult ?: GR_BFD_DEFAULT_DETECT_MULT;
+	if (++next_disc == 0)
+		next_disc++;
+	s->local_disc = next_disc;
+	s->src_port = rte_cpu_to_be_16(BFD_SRC_PORT_MIN + s->local_disc % 16384);
+	rte_spinlock_init(&s->lock);
+	s->state = GR_BFD_STATE_DOWN;
+	s->remote_state = GR_BFD_STATE_DOWN;
+	// RFC 5880 section 6.8.1: initialized to one microsecond.
+	s->remote_min_rx_us = 1;
+	s->reported_state = GR_BFD_STATE_DOWN;
+
+	if ((ret = rte_hash_add_key_data(bfd_hash, &key, s)) < 0) {
+		rte_free(s);
+		return api_out(-ret, 0);
+	}
+	bfd_session_abandon(s);
+
+	return api_out(0, 0);
+}
+
+static struct api_out session_del_cb(const void *request, void ** /*response*/) {
+	const struct gr_bfd_session_del_req *req = request;
+	struct bfd_key key = {.peer = req->peer, .vrf_id = req->vrf_id};
+	struct bfd_session *s;
+	struct nexthop *nh;
+
+	if ((s = bfd_session_lookup(req->vrf_id, req->peer)) == NULL)
+		return api_out(req->missing_ok ? 0 : ENOENT, 0);
+
+	rte_hash_del_key(bfd_hash, &key);
+	__atomic_store_n(&s->deleted, true, __ATOMIC_RELEASE);
+	arrpush(deleted, s);
+
+	// Without liveness detection, the next hop is usable again.
+	if ((nh = ip4_nexthop_lookup(req->vrf_id, req->peer)) != NULL)
+		ip4_nexthop_set_alive(nh, true);
+
+	return api_out(0, 0);
+}
+
+// Max number of sessions in a single list response.
+#define SESSION_LIST_MAX                                                                           \
+	((GR_API_MAX_MSG_LEN - sizeof(struct gr_bfd_session_list_resp))                            \
+	 / sizeof(struct gr_bfd_session))
+
+static struct api_out session_list_cb(const void *request, void **response) {
+	const struct gr_bfd_session_list_req *req = request;
+	struct gr_bfd_session_list_resp *resp;
+	struct bfd_session *s;
+	uint32_t iter, prev;
+	const void *key;
+	size_t len, n;
+	void *data;
+
+	n = RTE_MIN(rte_hash_count(bfd_hash), SESSION_LIST_MAX);
+	len = sizeof(*resp) + n * sizeof(*resp->sessions);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	// rte_hash_iterate() always visits the entries in the same order
+	iter = req->cursor;
+	prev = iter;
+	while (rte_hash_iterate(bfd_hash, &key, &data, &iter) >= 0) {
+		s = data;
+		if (req->vrf_id != GR_VRF_ID_ALL && s->vrf_id != req->vrf_id) {
+			prev = iter;
+			continue;
+		}
+		if (resp->n_sessions == n) {
+			resp->next_cursor = prev;
+			break;
+		}
+		bfd_to_api(s, &resp->sessions[resp->n_sessions++]);
+		prev = iter;
+	}
+
+	len = sizeof(*resp) + resp->n_sessions * sizeof(*resp->sessions);
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+static void bfd_init(struct event_base *ev_base) {
+	struct rte_hash_parameters params = {
+		.name = "bfd_sessions",
+		.entries = BFD_MAX_SESSIONS,
+		.key_len = sizeof(struct bfd_key),
+		.socket_id = SOCKET_ID_ANY,
+		.extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF,
+	};
+
+	bfd_hash = rte_hash_create(&params);
+	if (bfd_hash == NULL)
+		ABORT("rte_hash_create(bfd_sessions)");
+
+	adopt_ring = rte_ring_create("bfd_adopt", BFD_MAX_SESSIONS, SOCKET_ID_ANY, RING_F_EXACT_SZ);
+	if (adopt_ring == NULL)
+		ABORT("rte_ring_create(bfd_adopt): %s", rte_strerror(rte_errno));
+
+	event_ring = rte_ring_create_elem(
+		"bfd_events",
+		sizeof(struct bfd_event),
+		BFD_EVENT_RING_SIZE,
+		SOCKET_ID_ANY,
+		RING_F_MP_RTS_ENQ | RING_F_SC_DEQ
+	);
+	if (event_ring == NULL)
+		ABORT("rte_ring_create(bfd_events): %s", rte_strerror(rte_errno));
+
+	bfd_ev = gr_event_new(ev_base, -1, EV_FINALIZE, bfd_event_cb, NULL);
+	if (bfd_ev == NULL)
+		ABORT("gr_event_new() failed");
+
+	next_disc = rte_rand();
+}
+
+static void bfd_fini(struct event_base *) {
+	const void *key;
+	uint32_t iter;
+	void *data;
+
+	// The worker graphs are destroyed, no session is referenced anymore.
+	iter = 0;
+	while (rte_hash_iterate(bfd_hash, &key, &data, &iter) >= 0)
+		rte_free(data);
+	rte_hash_free(bfd_hash);
+	bfd_hash = NULL;
+	for (int i = 0; i < arrlen(deleted); i++)
+		rte_free(deleted[i]);
+	arrfree(deleted);
+	rte_ring_free(adopt_ring);
+	adopt_ring = NULL;
+	rte_ring_free(event_ring);
+	event_ring = NULL;
+	gr_event_free(bfd_ev);
+	bfd_ev = NULL;
+}
+
+static struct gr_module bfd_module = {
+	.name = "bfd",
+	.init = bfd_init,
+	.fini = bfd_fini,
+	.fini_prio = 1000,
+};
+
+static struct gr_api_handler session_add_handler = {
+	.name = "bfd session add",
+	.request_type = GR_BFD_SESSION_ADD,
+	.callback = session_add_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler session_del_handler = {
+	.name = "bfd session del",
+	.request_type = GR_BFD_SESSION_DEL,
+	.callback = session_del_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler session_list_handler = {
+	.name = "bfd session list",
+	.request_type = GR_BFD_SESSION_LIST,
+	.callback = session_list_cb,
+};
+
+RTE_INIT(bfd_constructor) {
+	gr_register_api_handler(&session_add_handler);
+	gr_register_api_handler(&session_del_handler);
+	gr_register_api_handler(&session_list_handler);
+	gr_register_module(&bfd_module);
+}
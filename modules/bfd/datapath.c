@@ -0,0 +1,496 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "bfd_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_graph.h>
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+#include <gr_mempool.h>
+
+#include <rte_byteorder.h>
+#include <rte_cycles.h>
+#include <rte_graph_worker.h>
+#include <rte_ip.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_random.h>
+#include <rte_udp.h>
+
+#include <netinet/in.h>
+#include <string.h>
+
+enum {
+	IP_OUTPUT = 0,
+	NO_ROUTE,
+	EDGE_COUNT,
+};
+
+enum {
+	INPUT_IP_OUTPUT = 0,
+	INPUT_INVALID,
+	INPUT_NO_SESSION,
+	INPUT_NO_ROUTE,
+	INPUT_EDGE_COUNT,
+};
+
+// Per-worker timer wheel of the adopted sessions. Sessions are inserted in the
+// slot of their next expiry. Slots are visited once per tick, entries that
+// expire in a later round are left in place.
+struct bfd_wheel {
+	uint64_t tick_cycles;
+	uint64_t cur_tick; // next tick to visit
+	LIST_HEAD(, bfd_session) slots[BFD_WHEEL_SLOTS];
+};
+
+// Stored in the node context area. One instance per graph.
+struct bfd_tx_ctx {
+	struct bfd_wheel *wheel;
+	struct rte_mempool *pool;
+};
+
+static_assert(sizeof(struct bfd_tx_ctx) <= RTE_NODE_CTX_SZ);
+
+static inline uint64_t us_to_cycles(uint64_t us) {
+	return us * rte_get_tsc_hz() / US_PER_S;
+}
+
+// RFC 5880 section 6.8.3: the TX interval is not less than one second while
+// the session is not up.
+static inline uint32_t bfd_desired_min_tx(const struct bfd_session *s) {
+	if (s->state != GR_BFD_STATE_UP)
+		return RTE_MAX(s->min_tx_us, (uint32_t)BFD_SLOW_INTERVAL_US);
+	return s->min_tx_us;
+}
+
+// Fill an empty mbuf with a control packet. Must be called with the session
+// lock held.
+static int bfd_build(struct rte_mbuf *m, struct bfd_session *s) {
+	struct ip_local_mbuf_data d;
+	struct rte_ipv4_hdr *ip;
+	struct rte_udp_hdr *udp;
+	struct bfd_ctrl *ctrl;
+	uint16_t len;
+
+	len = sizeof(*ip) + sizeof(*udp) + sizeof(*ctrl);
+	ip = (struct rte_ipv4_hdr *)rte_pktmbuf_append(m, len);
+	if (ip == NULL)
+		return errno_set(ENOBUFS);
+	udp = (struct rte_udp_hdr *)(ip + 1);
+	ctrl = (struct bfd_ctrl *)(udp + 1);
+
+	ctrl->vers_diag = (BFD_VERSION << 5) | s->diag;
+	ctrl->flags = s->state << 6;
+	if (s->send_final) {
+		ctrl->flags |= BFD_F_FINAL;
+		s->send_final = false;
+	}
+	ctrl->detect_mult = s->detect_mult;
+	ctrl->length = sizeof(*ctrl);
+	ctrl->my_disc = rte_cpu_to_be_32(s->local_disc);
+	ctrl->your_disc = rte_cpu_to_be_32(s->remote_disc);
+	ctrl->desired_min_tx = rte_cpu_to_be_32(bfd_desired_min_tx(s));
+	ctrl->required_min_rx = rte_cpu_to_be_32(s->min_rx_us);
+	ctrl->required_min_echo_rx = 0;
+
+	udp->src_port = s->src_port;
+	udp->dst_port = RTE_BE16(GR_BFD_UDP_PORT);
+	udp->dgram_len = rte_cpu_to_be_16(sizeof(*udp) + sizeof(*ctrl));
+	udp->dgram_cksum = 0;
+
+	d.src = s->local;
+	d.dst = s->peer;
+	d.len = sizeof(*udp) + sizeof(*ctrl);
+	d.vrf_id = s->vrf_id;
+	d.proto = IPPROTO_UDP;
+	ip_set_fields(m, ip, &d);
+	ip->type_of_service = 0xc0; // CS6, network control
+	ip->time_to_live = BFD_TTL;
+	udp->dgram_cksum = rte_ipv4_udptcp_cksum(ip, udp);
+
+	return 0;
+}
+
+// Hand over a control packet to ip_output. Single hop sessions are sent to the
+// next hop of the peer address, with the output interface resolved by the FIB.
+static inline rte_edge_t bfd_output(struct rte_mbuf *m, const struct bfd_session *s) {
+	struct ip_output_mbuf_data *d = ip_output_mbuf_data(m);
+
+	if ((d->nh = ip4_route_lookup(s->vrf_id, s->peer)) == NULL)
+		return NO_ROUTE;
+	d->input_iface = NULL;
+
+	return IP_OUTPUT;
+}
+
+static void bfd_wheel_insert(struct bfd_wheel *w, struct bfd_session *s, uint64_t expire) {
+	uint64_t tick = RTE_MAX(expire / w->tick_cycles, w->cur_tick);
+
+	s->wheel_expire = expire;
+	LIST_INSERT_HEAD(&w->slots[tick % BFD_WHEEL_SLOTS], s, wheel_next);
+}
+
+// RFC 5880 section 6.8.7: reduce the interval by a random 0 to 25% (10% when
+// the detection multiplier is 1) to avoid self synchronization.
+static inline uint64_t bfd_jitter(uint64_t cycles, uint8_t detect_mult) {
+	uint64_t pct = 75 + rte_rand_max(detect_mult == 1 ? 16 : 26);
+	return cycles * pct / 100;
+}
+
+// Process the timers of a session owned by this worker.
+static uint16_t bfd_session_expire(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	const struct bfd_tx_ctx *ctx,
+	struct bfd_session *s,
+	uint64_t now
+) {
+	struct bfd_event ev = {.session = s, .vrf_id = s->vrf_id, .peer = s->peer};
+	struct rte_mbuf *m = NULL;
+	bool changed = false;
+	uint64_t expire;
+	uint32_t interval;
+
+	rte_spinlock_lock(&s->lock);
+
+	// RFC 5880 section 6.8.4: no packet received during the detection time.
+	if (s->detect_deadline != 0 && now >= s->detect_deadline) {
+		s->state = GR_BFD_STATE_DOWN;
+		s->diag = GR_BFD_DIAG_TIME_EXPIRED;
+		s->remote_disc = 0;
+		s->detect_deadline = 0;
+		ev.state = s->state;
+		ev.diag = s->diag;
+		changed = true;
+	}
+
+	if (now >= s->next_tx) {
+		// A zero RequiredMinRxInterval means the peer does not want any
+		// periodic control packet.
+		if (s->remote_min_rx_us != 0 && (m = rte_pktmbuf_alloc(ctx->pool)) != NULL) {
+			if (bfd_build(m, s) < 0) {
+				rte_pktmbuf_free(m);
+				m = NULL;
+			}
+		}
+		interval = RTE_MAX(bfd_desired_min_tx(s), s->remote_min_rx_us);
+		s->next_tx = now + bfd_jitter(us_to_cycles(interval), s->detect_mult);
+	}
+
+	expire = s->next_tx;
+	if (s->detect_deadline != 0)
+		expire = RTE_MIN(expire, s->detect_deadline);
+
+	rte_spinlock_unlock(&s->lock);
+
+	bfd_wheel_insert(ctx->wheel, s, expire);
+	if (changed)
+		bfd_event_post(&ev);
+	if (m == NULL)
+		return 0;
+
+	s->tx_packets++;
+	rte_node_enqueue_x1(graph, node, bfd_output(m, s), m);
+
+	return 1;
+}
+
+static uint16_t bfd_tx_process(struct rte_graph *graph, struct rte_node *node, void **, uint16_t) {
+	struct bfd_tx_ctx *ctx = (struct bfd_tx_ctx *)node->ctx;
+	LIST_HEAD(, bfd_session) expired = LIST_HEAD_INITIALIZER(expired);
+	struct bfd_wheel *w = ctx->wheel;
+	struct bfd_session *s, *next;
+	uint64_t now, now_tick;
+	uint16_t sent = 0;
+
+	now = rte_rdtsc();
+
+	// Sessions are spread over the workers by letting them compete for the
+	// unowned ones, a few at a time.
+	for (unsigned i = 0; i < BFD_ADOPT_BURST; i++) {
+		if ((s = bfd_session_adopt()) == NULL)
+			break;
+		bfd_wheel_insert(w, s, now);
+	}
+
+	now_tick = now / w->tick_cycles;
+	if (now_tick < w->cur_tick)
+		return 0;
+	// Do not visit the same slot twice after a long stall.
+	if (now_tick - w->cur_tick >= BFD_WHEEL_SLOTS)
+		w->cur_tick = now_tick - BFD_WHEEL_SLOTS + 1;
+
+	for (; w->cur_tick <= now_tick; w->cur_tick++) {
+		s = LIST_FIRST(&w->slots[w->cur_tick % BFD_WHEEL_SLOTS]);
+		while (s != NULL) {
+			next = LIST_NEXT(s, wheel_next);
+			if (s->wheel_expire <= now) {
+				LIST_REMOVE(s, wheel_next);
+				LIST_INSERT_HEAD(&expired, s, wheel_next);
+			}
+			s = next;
+		}
+	}
+
+	while ((s = LIST_FIRST(&expired)) != NULL) {
+		LIST_REMOVE(s, wheel_next);
+		if (__atomic_load_n(&s->deleted, __ATOMIC_ACQUIRE)) {
+			__atomic_store_n(&s->released, true, __ATOMIC_RELEASE);
+			bfd_event_post(NULL);
+			continue;
+		}
+		sent += bfd_session_expire(graph, node, ctx, s, now);
+	}
+
+	return sent;
+}
+
+static int bfd_tx_init(const struct rte_graph *graph, struct rte_node *node) {
+	struct bfd_tx_ctx *ctx = (struct bfd_tx_ctx *)node->ctx;
+
+	ctx->wheel = rte_zmalloc_socket(
+		__func__, sizeof(*ctx->wheel), RTE_CACHE_LINE_SIZE, graph->socket
+	);
+	if (ctx->wheel == NULL)
+		return errno_log(ENOMEM, "rte_zmalloc_socket(bfd_wheel)");
+	for (unsigned i = 0; i < BFD_WHEEL_SLOTS; i++)
+		LIST_INIT(&ctx->wheel->slots[i]);
+	ctx->wheel->tick_cycles = us_to_cycles(BFD_WHEEL_TICK_US);
+	ctx->wheel->cur_tick = rte_rdtsc() / ctx->wheel->tick_cycles;
+
+	ctx->pool = gr_pktmbuf_pool_get(graph->socket, RTE_GRAPH_BURST_SIZE);
+	if (ctx->pool == NULL) {
+		rte_free(ctx->wheel);
+		ctx->wheel = NULL;
+		return errno_log(errno, "gr_pktmbuf_pool_get(bfd_tx)");
+	}
+
+	return 0;
+}
+
+static void bfd_tx_fini(const struct rte_graph *, struct rte_node *node) {
+	struct bfd_tx_ctx *ctx = (struct bfd_tx_ctx *)node->ctx;
+	struct bfd_session *s;
+
+	if (ctx->wheel != NULL) {
+		// The graph is being replaced. Give the sessions back so that the
+		// next graph of this or another worker takes over their timers.
+		for (unsigned i = 0; i < BFD_WHEEL_SLOTS; i++) {
+			while ((s = LIST_FIRST(&ctx->wheel->slots[i])) != NULL) {
+				LIST_REMOVE(s, wheel_next);
+				bfd_session_abandon(s);
+			}
+		}
+		rte_free(ctx->wheel);
+		ctx->wheel = NULL;
+	}
+	gr_pktmbuf_pool_release(ctx->pool, RTE_GRAPH_BURST_SIZE);
+	ctx->pool = NULL;
+}
+
+// RFC 5880 section 6.8.6: packets that must be discarded.
+static inline bool bfd_ctrl_valid(const struct bfd_ctrl *c, uint16_t len) {
+	if (BFD_VERS(c->vers_diag) != BFD_VERSION)
+		return false;
+	if (c->length < sizeof(*c) || c->length > len)
+		return false;
+	// authentication is not supported
+	if (c->flags & (BFD_F_AUTH | BFD_F_MULTIPOINT))
+		return false;
+	if (c->detect_mult == 0 || c->my_disc == 0)
+		return false;
+	if (c->your_disc == 0 && BFD_STATE(c->flags) != GR_BFD_STATE_DOWN
+	    && BFD_STATE(c->flags) != GR_BFD_STATE_ADMIN_DOWN)
+		return false;
+	return true;
+}
+
+// Run the reception state machine on a control packet from the peer. If reply
+// is not NULL, it is filled with a packet that carries the F bit.
+static void bfd_session_rx(
+	struct bfd_session *s,
+	const struct bfd_ctrl *c,
+	struct rte_mbuf *reply,
+	uint64_t now
+) {
+	struct bfd_event ev = {.session = s, .vrf_id = s->vrf_id, .peer = s->peer};
+	uint8_t prev, remote;
+	uint32_t interval;
+
+	rte_spinlock_lock(&s->lock);
+
+	prev = s->state;
+	remote = BFD_STATE(c->flags);
+	s->remote_disc = rte_be_to_cpu_32(c->my_disc);
+	s->remote_state = remote;
+	s->remote_detect_mult = c->detect_mult;
+	s->remote_min_tx_us = rte_be_to_cpu_32(c->desired_min_tx);
+	s->remote_min_rx_us = rte_be_to_cpu_32(c->required_min_rx);
+	if (c->flags & BFD_F_POLL)
+		s->send_final = true;
+
+	if (remote == GR_BFD_STATE_ADMIN_DOWN) {
+		if (s->state != GR_BFD_STATE_DOWN) {
+			s->state = GR_BFD_STATE_DOWN;
+			s->diag = GR_BFD_DIAG_NEIGHBOR_DOWN;
+		}
+	} else {
+		switch (s->state) {
+		case GR_BFD_STATE_DOWN:
+			if (remote == GR_BFD_STATE_DOWN)
+				s->state = GR_BFD_STATE_INIT;
+			else if (remote == GR_BFD_STATE_INIT)
+				s->state = GR_BFD_STATE_UP;
+			break;
+		case GR_BFD_STATE_INIT:
+			if (remote == GR_BFD_STATE_INIT || remote == GR_BFD_STATE_UP)
+				s->state = GR_BFD_STATE_UP;
+			break;
+		case GR_BFD_STATE_UP:
+			if (remote == GR_BFD_STATE_DOWN) {
+				s->state = GR_BFD_STATE_DOWN;
+				s->diag = GR_BFD_DIAG_NEIGHBOR_DOWN;
+			}
+			break;
+		}
+	}
+	if (s->state == GR_BFD_STATE_UP && prev != GR_BFD_STATE_UP)
+		s->diag = GR_BFD_DIAG_NONE;
+
+	// RFC 5880 section 6.8.4: detection time in asynchronous mode.
+	if (s->state == GR_BFD_STATE_INIT || s->state == GR_BFD_STATE_UP) {
+		interval = RTE_MAX(s->min_rx_us, s->remote_min_tx_us);
+		s->detect_deadline = now + s->remote_detect_mult * us_to_cycles(interval);
+	} else {
+		s->detect_deadline = 0;
+	}
+
+	if (reply != NULL && bfd_build(reply, s) < 0) {
+		// sent with the next periodic packet
+		s->send_final = true;
+	}
+	ev.state = s->state;
+	ev.diag = s->diag;
+
+	rte_spinlock_unlock(&s->lock);
+
+	__atomic_fetch_add(&s->rx_packets, 1, __ATOMIC_RELAXED);
+	if (ev.state != prev)
+		bfd_event_post(&ev);
+}
+
+static uint16_t
+bfd_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct ip_local_mbuf_data *ip_data;
+	const struct rte_ipv4_hdr *ip;
+	const struct bfd_ctrl *ctrl;
+	struct rte_mbuf *mbuf, *reply;
+	struct bfd_session *s;
+	rte_edge_t edge;
+	uint64_t now;
+
+	now = rte_rdtsc();
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+		ip_data = ip_local_mbuf_data(mbuf);
+		ctrl = rte_pktmbuf_mtod(mbuf, const struct bfd_ctrl *);
+
+		if (unlikely(ip_data->len < sizeof(*ctrl)
+			     || rte_pktmbuf_data_len(mbuf) < sizeof(*ctrl))) {
+			edge = INPUT_INVALID;
+			goto next;
+		}
+		// RFC 5881 section 5: the TTL must be 255. Control packets never
+		// have IP options, the IP header precedes the UDP header.
+		ip = rte_pktmbuf_mtod_offset(
+			mbuf,
+			const struct rte_ipv4_hdr *,
+			-(int)(sizeof(struct rte_udp_hdr) + sizeof(*ip))
+		);
+		if (ip->version_ihl != IPV4_VERSION_IHL || ip->time_to_live != BFD_TTL
+		    || !bfd_ctrl_valid(ctrl, ip_data->len)) {
+			edge = INPUT_INVALID;
+			goto next;
+		}
+
+		s = bfd_session_lookup(ip_data->vrf_id, ip_data->src);
+		if (s == NULL || s->local != ip_data->dst
+		    || (ctrl->your_disc != 0
+			&& rte_be_to_cpu_32(ctrl->your_disc) != s->local_disc)) {
+			edge = INPUT_NO_SESSION;
+			goto next;
+		}
+
+		// Reply to polls immediately, without waiting for the TX timer.
+		reply = NULL;
+		if (ctrl->flags & BFD_F_POLL)
+			reply = rte_pktmbuf_alloc(mbuf->pool);
+		bfd_session_rx(s, ctrl, reply, now);
+		rte_pktmbuf_free(mbuf);
+		if (reply == NULL)
+			continue;
+
+		mbuf = reply;
+		if (bfd_output(mbuf, s) == IP_OUTPUT)
+			edge = INPUT_IP_OUTPUT;
+		else
+			edge = INPUT_NO_ROUTE;
+next:
+		rte_node_enqueue_x1(graph, node, edge, mbuf);
+	}
+
+	return nb_objs;
+}
+
+static void bfd_input_register(void) {
+	udp_input_register_port(RTE_BE16(GR_BFD_UDP_PORT), "bfd_input");
+}
+
+static struct rte_node_register bfd_tx_node = {
+	.name = "bfd_tx",
+	.flags = RTE_NODE_SOURCE_F,
+
+	.process = bfd_tx_process,
+	.init = bfd_tx_init,
+	.fini = bfd_tx_fini,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[IP_OUTPUT] = "ip_output",
+		[NO_ROUTE] = "bfd_no_route",
+	},
+};
+
+static struct rte_node_register bfd_input_node = {
+	.name = "bfd_input",
+
+	.process = bfd_input_process,
+
+	.nb_edges = INPUT_EDGE_COUNT,
+	.next_nodes = {
+		[INPUT_IP_OUTPUT] = "ip_output",
+		[INPUT_INVALID] = "bfd_input_invalid",
+		[INPUT_NO_SESSION] = "bfd_input_no_session",
+		[INPUT_NO_ROUTE] = "bfd_no_route",
+	},
+};
+
+static struct gr_node_info bfd_tx_info = {
+	.node = &bfd_tx_node,
+};
+
+static struct gr_node_info bfd_input_info = {
+	.node = &bfd_input_node,
+	.register_callback = bfd_input_register,
+};
+
+GR_NODE_REGISTER(bfd_tx_info);
+GR_NODE_REGISTER(bfd_input_info);
+
+GR_DROP_REGISTER(bfd_no_route);
+GR_DROP_REGISTER(bfd_input_invalid);
+GR_DROP_REGISTER(bfd_input_no_session);
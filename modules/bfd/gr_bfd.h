@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_API_BFD
+#define _GR_API_BFD
+
+#include <gr_api.h>
+#include <gr_ip4.h>
+#include <gr_net_types.h>
+
+#include <stdint.h>
+
+#define GR_BFD_MODULE 0xbfd0
+
+// Single hop control packets destination port (RFC 5881).
+#define GR_BFD_UDP_PORT 3784
+
+// Session states (RFC 5880 section 4.1).
+#define GR_BFD_STATE_ADMIN_DOWN 0
+#define GR_BFD_STATE_DOWN 1
+#define GR_BFD_STATE_INIT 2
+#define GR_BFD_STATE_UP 3
+
+static inline const char *gr_bfd_state_name(uint8_t state) {
+	switch (state) {
+	case GR_BFD_STATE_ADMIN_DOWN:
+		return "admin-down";
+	case GR_BFD_STATE_DOWN:
+		return "down";
+	case GR_BFD_STATE_INIT:
+		return "init";
+	case GR_BFD_STATE_UP:
+		return "up";
+	}
+	return "?";
+}
+
+// Diagnostic codes (RFC 5880 section 4.1).
+#define GR_BFD_DIAG_NONE 0
+#define GR_BFD_DIAG_TIME_EXPIRED 1 // Control Detection Time Expired
+#define GR_BFD_DIAG_NEIGHBOR_DOWN 3 // Neighbor Signaled Session Down
+#define GR_BFD_DIAG_ADMIN_DOWN 7 // Administratively Down
+
+static inline const char *gr_bfd_diag_name(uint8_t diag) {
+	switch (diag) {
+	case GR_BFD_DIAG_NONE:
+		return "none";
+	case GR_BFD_DIAG_TIME_EXPIRED:
+		return "time-expired";
+	case GR_BFD_DIAG_NEIGHBOR_DOWN:
+		return "neighbor-down";
+	case GR_BFD_DIAG_ADMIN_DOWN:
+		return "admin-down";
+	}
+	return "?";
+}
+
+// Default timers: 3 x 300ms.
+#define GR_BFD_DEFAULT_INTERVAL_US 300000
+#define GR_BFD_DEFAULT_DETECT_MULT 3
+#define GR_BFD_MIN_INTERVAL_US 10000
+
+// Asynchronous mode session with a directly connected IPv4 peer. Control
+// packets are sent and received by the datapath workers. When an up session
+// goes down, ECMP groups stop using the next hop of the peer address until the
+// session comes back up.
+struct gr_bfd_session {
+	uint16_t vrf_id;
+	ip4_addr_t local; // source address of the control packets
+	ip4_addr_t peer;
+	uint32_t min_tx_us; // desired min TX interval, 0 for the default
+	uint32_t min_rx_us; // required min RX interval, 0 for the default
+	uint8_t detect_mult; // 0 for the default
+
+	// read only fields
+	uint8_t state; // GR_BFD_STATE_*
+	uint8_t remote_state; // GR_BFD_STATE_*
+	uint8_t diag; // GR_BFD_DIAG_* of the last transition to down
+	uint32_t local_disc;
+	uint32_t remote_disc;
+	uint64_t tx_packets;
+	uint64_t rx_packets;
+	uint64_t n_down; // number of transitions from up to down
+};
+
+#define GR_BFD_SESSION_ADD REQUEST_TYPE(GR_BFD_MODULE, 0x0001)
+
+struct gr_bfd_session_add_req {
+	struct gr_bfd_session session;
+	uint8_t exist_ok;
+};
+
+// struct gr_bfd_session_add_resp { };
+
+#define GR_BFD_SESSION_DEL REQUEST_TYPE(GR_BFD_MODULE, 0x0002)
+
+struct gr_bfd_session_del_req {
+	uint16_t vrf_id;
+	ip4_addr_t peer;
+	uint8_t missing_ok;
+};
+
+// struct gr_bfd_session_del_resp { };
+
+#define GR_BFD_SESSION_LIST REQUEST_TYPE(GR_BFD_MODULE, 0x0003)
+
+struct gr_bfd_session_list_req {
+	uint16_t vrf_id; // GR_VRF_ID_ALL for all VRFs
+	uint32_t cursor; // next_cursor of the previous response, zero to start
+};
+
+struct gr_bfd_session_list_resp {
+	uint32_t next_cursor; // zero when all sessions have been listed
+	uint16_t n_sessions;
+	struct gr_bfd_session sessions[/* n_sessions */];
+};
+
+// events //////////////////////////////////////////////////////////////////////
+
+// Payload: struct gr_bfd_session
+#define GR_BFD_EVENT_SESSION_STATE EVENT_TYPE(GR_BFD_MODULE, 0x0001)
+
+#endif
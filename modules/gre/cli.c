@@ -0,0 +1,180 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_cli_iface.h>
+#include <gr_gre.h>
+#include <gr_net_types.h>
+
+#include <ecoli.h>
+
+#include <errno.h>
+#include <string.h>
+
+static void gre_show(const struct gr_api_client *, const struct gr_iface *iface) {
+	const struct gr_iface_info_gre *gre = (const struct gr_iface_info_gre *)iface->info;
+	char local[64], remote[64];
+
+	inet_ntop(AF_INET, &gre->local, local, sizeof(local));
+	inet_ntop(AF_INET, &gre->remote, remote, sizeof(remote));
+	printf("local: %s\n", local);
+	printf("remote: %s\n", remote);
+	if (gre->flags & GR_GRE_F_KEY)
+		printf("key: %u\n", gre->key);
+	printf("seq: %s\n", gre->flags & GR_GRE_F_SEQ ? "on" : "off");
+}
+
+static void
+gre_list_info(const struct gr_api_client *, const struct gr_iface *iface, char *buf, size_t len) {
+	const struct gr_iface_info_gre *gre = (const struct gr_iface_info_gre *)iface->info;
+	char local[64], remote[64];
+
+	inet_ntop(AF_INET, &gre->local, local, sizeof(local));
+	inet_ntop(AF_INET, &gre->remote, remote, sizeof(remote));
+	if (gre->flags & GR_GRE_F_KEY)
+		snprintf(buf, len, "local=%s remote=%s key=%u", local, remote, gre->key);
+	else
+		snprintf(buf, len, "local=%s remote=%s", local, remote);
+}
+
+static struct cli_iface_type gre_type = {
+	.type_id = GR_IFACE_TYPE_GRE,
+	.name = "gre",
+	.show = gre_show,
+	.list_info = gre_list_info,
+};
+
+static uint64_t parse_gre_args(
+	const struct gr_api_client *c,
+	const struct ec_pnode *p,
+	struct gr_iface *iface,
+	bool update
+) {
+	uint64_t set_attrs = parse_iface_args(c, p, iface, update);
+	struct gr_iface_info_gre *gre;
+	const char *local, *remote, *seq;
+
+	gre = (struct gr_iface_info_gre *)iface->info;
+
+	local = arg_str(p, "LOCAL");
+	if (local != NULL) {
+		if (inet_pton(AF_INET, local, &gre->local) != 1) {
+			errno = EINVAL;
+			return 0;
+		}
+		set_attrs |= GR_GRE_SET_LOCAL;
+	}
+	remote = arg_str(p, "REMOTE");
+	if (remote != NULL) {
+		if (inet_pton(AF_INET, remote, &gre->remote) != 1) {
+			errno = EINVAL;
+			return 0;
+		}
+		set_attrs |= GR_GRE_SET_REMOTE;
+	}
+	if (gre->local == gre->remote) {
+		errno = EADDRINUSE;
+		return 0;
+	}
+	if (arg_u32(p, "KEY", &gre->key) == 0) {
+		gre->flags |= GR_GRE_F_KEY;
+		set_attrs |= GR_GRE_SET_KEY | GR_GRE_SET_FLAGS;
+	} else if (arg_str(p, "nokey") != NULL) {
+		gre->flags &= ~GR_GRE_F_KEY;
+		set_attrs |= GR_GRE_SET_FLAGS;
+	}
+	seq = arg_str(p, "SEQ");
+	if (seq != NULL && strcmp(seq, "on") == 0) {
+		gre->flags |= GR_GRE_F_SEQ;
+		set_attrs |= GR_GRE_SET_FLAGS;
+	} else if (seq != NULL && strcmp(seq, "off") == 0) {
+		gre->flags &= ~GR_GRE_F_SEQ;
+		set_attrs |= GR_GRE_SET_FLAGS;
+	}
+
+	if (set_attrs == 0)
+		errno = EINVAL;
+	return set_attrs;
+}
+
+static cmd_status_t gre_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	const struct gr_infra_iface_add_resp *resp;
+	struct gr_infra_iface_add_req req = {
+		.iface = {.type = GR_IFACE_TYPE_GRE, .flags = GR_IFACE_F_UP}
+	};
+	void *resp_ptr = NULL;
+
+	if (parse_gre_args(c, p, &req.iface, false) == 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_ADD, sizeof(req), &req, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	printf("Created interface %u\n", resp->iface_id);
+	free(resp_ptr);
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t gre_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_iface_set_req req = {0};
+
+	if ((req.set_attrs = parse_gre_args(c, p, &req.iface, true)) == 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+#define GRE_ATTRS_ARGS                                                                             \
+	IFACE_ATTRS_ARGS,                                                                          \
+		with_help("Local tunnel endpoint address.", ec_node_re("LOCAL", IPV4_RE)),         \
+		with_help("Remote tunnel endpoint address.", ec_node_re("REMOTE", IPV4_RE)),       \
+		with_help("Tunnel key.", ec_node_uint("KEY", 0, UINT32_MAX, 10)),                  \
+		with_help("Remove the tunnel key.", ec_node_str("nokey", "nokey")),                \
+		with_help("Enable/disable sequence numbers.", ec_node_re("SEQ", "on|off"))
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_ADD, CTX_ARG("interface", "Create interfaces.")),
+		"gre NAME local LOCAL remote REMOTE [(key KEY),(seq SEQ)," IFACE_ATTRS_CMD "]",
+		gre_add,
+		"Create a new GRE tunnel interface.",
+		with_help("Interface name.", ec_node("any", "NAME")),
+		GRE_ATTRS_ARGS
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("interface", "Modify interfaces.")),
+		"gre NAME (name NEW_NAME),(local LOCAL),(remote REMOTE),(key KEY|nokey),(seq SEQ),"
+			IFACE_ATTRS_CMD,
+		gre_set,
+		"Modify gre parameters.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_GRE))
+		),
+		with_help("New interface name.", ec_node("any", "NEW_NAME")),
+		GRE_ATTRS_ARGS
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "gre",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+	register_iface_type(&gre_type);
+}
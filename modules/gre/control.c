@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_gre.h"
+#include "gre_priv.h"
+
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_infra.h>
+#include <gr_ip4_control.h>
+#include <gr_log.h>
+
+#include <event2/event.h>
+#include <rte_hash.h>
+
+#include <assert.h>
+#include <string.h>
+
+static struct rte_hash *gre_hash;
+
+void gre_get_iface_bulk(const struct gre_key *keys, unsigned n, struct iface **ifaces) {
+	const void *key_ptrs[GRE_LOOKUP_BULK_MAX];
+	void *data[GRE_LOOKUP_BULK_MAX];
+	uint64_t hits = 0;
+
+	assert(n <= GRE_LOOKUP_BULK_MAX);
+
+	for (unsigned i = 0; i < n; i++)
+		key_ptrs[i] = &keys[i];
+
+	if (n > 0 && rte_hash_lookup_bulk_data(gre_hash, key_ptrs, n, &hits, data) < 0)
+		hits = 0;
+
+	for (unsigned i = 0; i < n; i++)
+		ifaces[i] = hits & (UINT64_C(1) << i) ? data[i] : NULL;
+}
+
+// Keyless tunnels are stored with a zero key.
+#define gre_iface_key(info) ((info)->flags & GR_GRE_F_KEY ? (info)->key : 0)
+
+static int iface_gre_reconfig(
+	struct iface *iface,
+	uint64_t set_attrs,
+	uint16_t flags,
+	uint16_t mtu,
+	uint16_t vrf_id,
+	const void *api_info
+) {
+	struct iface_info_gre *cur = (struct iface_info_gre *)iface->info;
+	const struct gr_iface_info_gre *next = api_info;
+	struct gre_key cur_key = {cur->local, cur->remote, gre_iface_key(cur), iface->vrf_id};
+	struct gre_key next_key = {next->local, next->remote, gre_iface_key(next), vrf_id};
+	void *data;
+	int ret;
+
+	if (set_attrs
+	    & (GR_IFACE_SET_VRF | GR_GRE_SET_LOCAL | GR_GRE_SET_REMOTE | GR_GRE_SET_KEY
+	       | GR_GRE_SET_FLAGS)) {
+		if (vrf_id >= IP4_MAX_VRFS)
+			return errno_set(EOVERFLOW);
+		if (next->flags & ~(GR_GRE_F_KEY | GR_GRE_F_SEQ))
+			return errno_set(EINVAL);
+
+		// changing only GR_GRE_F_SEQ keeps the same hash key
+		if (rte_hash_lookup_data(gre_hash, &next_key, &data) >= 0 && data != iface)
+			return errno_set(EADDRINUSE);
+
+		if (ip4_route_lookup(vrf_id, next->local) == NULL)
+			return -errno;
+		if (ip4_route_lookup(vrf_id, next->remote) == NULL)
+			return -errno;
+
+		if (memcmp(&cur_key, &next_key, sizeof(cur_key)) != 0)
+			rte_hash_del_key(gre_hash, &cur_key);
+
+		if ((ret = rte_hash_add_key_data(gre_hash, &next_key, iface)) < 0)
+			return errno_log(-ret, "rte_hash_add_key_data");
+
+		cur->local = next->local;
+		cur->remote = next->remote;
+		cur->key = gre_iface_key(next);
+		cur->flags = next->flags;
+		iface->vrf_id = vrf_id;
+	}
+
+	if (set_attrs & GR_IFACE_SET_FLAGS)
+		iface->flags = flags;
+	if (set_attrs & GR_IFACE_SET_MTU)
+		iface->mtu = mtu;
+
+	return 0;
+}
+
+static int iface_gre_fini(struct iface *iface) {
+	struct iface_info_gre *gre = (struct iface_info_gre *)iface->info;
+	struct gre_key key = {gre->local, gre->remote, gre_iface_key(gre), iface->vrf_id};
+
+	rte_hash_del_key(gre_hash, &key);
+
+	return 0;
+}
+
+static int iface_gre_init(struct iface *iface, const void *api_info) {
+	int ret;
+
+	ret = iface_gre_reconfig(
+		iface, IFACE_SET_ALL, iface->flags, iface->mtu, iface->vrf_id, api_info
+	);
+	if (ret < 0) {
+		iface_gre_fini(iface);
+		errno = -ret;
+	}
+
+	return ret;
+}
+
+static void gre_to_api(void *info, const struct iface *iface) {
+	const struct iface_info_gre *gre = (const struct iface_info_gre *)iface->info;
+	struct gr_iface_info_gre *api = info;
+
+	api->local = gre->local;
+	api->remote = gre->remote;
+	api->key = gre->key;
+	api->flags = gre->flags;
+}
+
+static struct iface_type iface_type_gre = {
+	.id = GR_IFACE_TYPE_GRE,
+	.name = "gre",
+	.info_size = sizeof(struct iface_info_gre),
+	.init = iface_gre_init,
+	.reconfig = iface_gre_reconfig,
+	.fini = iface_gre_fini,
+	.to_api = gre_to_api,
+};
+
+static void gre_init(struct event_base *) {
+	struct rte_hash_parameters params = {
+		.name = "gre",
+		.entries = MAX_IFACES,
+		.key_len = sizeof(struct gre_key),
+		.socket_id = SOCKET_ID_ANY,
+		.extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF
+			| RTE_HASH_EXTRA_FLAGS_TRANS_MEM_SUPPORT,
+	};
+	gre_hash = rte_hash_create(&params);
+	if (gre_hash == NULL)
+		ABORT("rte_hash_create(gre)");
+}
+
+static void gre_fini(struct event_base *) {
+	rte_hash_free(gre_hash);
+	gre_hash = NULL;
+}
+
+static struct gr_module gre_module = {
+	.name = "gre",
+	.init = gre_init,
+	.fini = gre_fini,
+	.fini_prio = 1000,
+};
+
+RTE_INIT(gre_constructor) {
+	gr_register_module(&gre_module);
+	iface_type_register(&iface_type_gre);
+}
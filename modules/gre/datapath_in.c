@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gre_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_eth_input.h>
+#include <gr_graph.h>
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_graph_worker.h>
+#include <rte_ip.h>
+#include <rte_mbuf_ptype.h>
+
+#include <netinet/in.h>
+#include <string.h>
+
+enum {
+	IP_INPUT = 0,
+	NO_TUNNEL,
+	INVALID,
+	EDGE_COUNT,
+};
+
+// Parse the GRE header and return its length, or 0 if it cannot be decapsulated.
+static inline uint16_t gre_parse(const struct rte_mbuf *m, uint16_t len, uint32_t *key) {
+	const struct gre_base_hdr *gre = rte_pktmbuf_mtod(m, const struct gre_base_hdr *);
+	const rte_be32_t *opt = (const rte_be32_t *)(gre + 1);
+	uint16_t hdr_len = sizeof(*gre);
+
+	if (unlikely(len < sizeof(*gre) || rte_pktmbuf_data_len(m) < sizeof(*gre)))
+		return 0;
+	if (unlikely(gre->flags & (GRE_F_ROUTING | GRE_F_VERSION)))
+		return 0;
+	if (unlikely(gre->proto != RTE_BE16(RTE_ETHER_TYPE_IPV4)))
+		return 0;
+
+	if (gre->flags & GRE_F_CSUM)
+		hdr_len += sizeof(*opt);
+	if (gre->flags & GRE_F_KEY)
+		hdr_len += sizeof(*opt);
+	if (gre->flags & GRE_F_SEQ)
+		hdr_len += sizeof(*opt);
+	if (unlikely(len < hdr_len || rte_pktmbuf_data_len(m) < hdr_len))
+		return 0;
+
+	*key = 0;
+	if (gre->flags & GRE_F_KEY)
+		*key = rte_be_to_cpu_32(opt[gre->flags & GRE_F_CSUM ? 1 : 0]);
+
+	return hdr_len;
+}
+
+static uint16_t
+gre_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct iface *ifaces[GRE_LOOKUP_BULK_MAX];
+	struct gre_key keys[GRE_LOOKUP_BULK_MAX];
+	struct iface_stats_batch stats = {.tx = false};
+	uint8_t key_idx[GRE_LOOKUP_BULK_MAX];
+	uint16_t hdr_len[GRE_LOOKUP_BULK_MAX];
+	struct eth_input_mbuf_data *eth_data;
+	struct ip_local_mbuf_data *ip_data;
+	uint16_t i, n, count, n_keys;
+	struct gr_spec_stream s;
+	struct rte_mbuf *mbuf;
+	struct gre_key key;
+	struct iface *gre;
+	rte_edge_t edge;
+
+	gr_spec_stream_init(&s, node, nb_objs);
+
+	for (n = 0; n < nb_objs; n += count) {
+		count = RTE_MIN(nb_objs - n, GRE_LOOKUP_BULK_MAX);
+
+		// First pass: parse the headers and collect the tunnel keys.
+		// Consecutive packets of the same tunnel share a single lookup.
+		n_keys = 0;
+		for (i = 0; i < count; i++) {
+			mbuf = objs[n + i];
+			ip_data = ip_local_mbuf_data(mbuf);
+			hdr_len[i] = gre_parse(mbuf, ip_data->len, &key.key);
+			if (hdr_len[i] == 0)
+				continue;
+			key.local = ip_data->dst;
+			key.remote = ip_data->src;
+			key.vrf_id = ip_data->vrf_id;
+			if (n_keys == 0 || memcmp(&keys[n_keys - 1], &key, sizeof(key)) != 0)
+				keys[n_keys++] = key;
+			key_idx[i] = n_keys - 1;
+		}
+		gre_get_iface_bulk(keys, n_keys, ifaces);
+
+		// Second pass: hand over the inner packets to ip_input.
+		for (i = 0; i < count; i++) {
+			mbuf = objs[n + i];
+			if (hdr_len[i] == 0) {
+				edge = INVALID;
+				goto next;
+			}
+			gre = ifaces[key_idx[i]];
+			if (gre == NULL) {
+				edge = NO_TUNNEL;
+				goto next;
+			}
+			// The optional checksum and sequence numbers are not checked.
+			rte_pktmbuf_adj(mbuf, hdr_len[i]);
+			// The hw checksum offload only works on the outer IP.
+			// Clear the offload flag so that ip_input will check it in software.
+			mbuf->ol_flags |= RTE_MBUF_F_RX_IP_CKSUM_NONE;
+			// Same for the packet type classification.
+			mbuf->packet_type = RTE_PTYPE_UNKNOWN;
+			eth_data = eth_input_mbuf_data(mbuf);
+			eth_data->iface = gre;
+			eth_data->eth_dst = ETH_DST_LOCAL;
+			iface_stats_add(&stats, gre->id, rte_pktmbuf_pkt_len(mbuf));
+			edge = IP_INPUT;
+next:
+			gr_spec_stream_enqueue(&s, graph, node, objs, n + i, edge);
+		}
+	}
+	gr_spec_stream_flush(&s, graph, node);
+	iface_stats_flush(&stats);
+
+	return nb_objs;
+}
+
+static void gre_input_register(void) {
+	ip_input_local_add_proto(IPPROTO_GRE, "gre_input");
+}
+
+static struct rte_node_register gre_input_node = {
+	.name = "gre_input",
+
+	.process = gre_input_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[IP_INPUT] = "ip_input",
+		[NO_TUNNEL] = "gre_input_no_tunnel",
+		[INVALID] = "gre_input_invalid",
+	},
+};
+
+static struct gr_node_info gre_input_info = {
+	.node = &gre_input_node,
+	.register_callback = gre_input_register,
+};
+
+GR_NODE_REGISTER(gre_input_info);
+
+GR_DROP_REGISTER(gre_input_no_tunnel);
+GR_DROP_REGISTER(gre_input_invalid);
@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_gre.h"
+#include "gre_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_graph.h>
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_graph_worker.h>
+#include <rte_ip.h>
+
+#include <netinet/in.h>
+
+enum {
+	IP_OUTPUT = 0,
+	NO_TUNNEL,
+	NO_HEADROOM,
+	EDGE_COUNT,
+};
+
+static uint16_t
+gre_output_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct iface_stats_batch stats = {.tx = true};
+	struct ip_output_mbuf_data *ip_data;
+	uint32_t route_gen, iface_gen;
+	struct ip_local_mbuf_data *tunnel;
+	struct iface_info_gre *gre;
+	struct gre_base_hdr *hdr;
+	struct rte_ipv4_hdr *inner;
+	struct rte_ipv4_hdr *outer;
+	const struct iface *iface;
+	struct rte_mbuf *mbuf;
+	uint16_t hdr_len;
+	rte_be32_t *opt;
+	rte_edge_t edge;
+
+	route_gen = __atomic_load_n(&ip4_route_gen, __ATOMIC_ACQUIRE);
+	iface_gen = __atomic_load_n(&iface_config_gen, __ATOMIC_ACQUIRE);
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+
+		// Resolve the GRE interface from the nexthop provided by ip_output.
+		ip_data = ip_output_mbuf_data(mbuf);
+		iface = ip_data->nh->iface;
+		if (iface == NULL || iface->type_id != GR_IFACE_TYPE_GRE) {
+			edge = NO_TUNNEL;
+			goto next;
+		}
+		ip_data->input_iface = iface;
+		gre = (struct iface_info_gre *)iface->info;
+
+		inner = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+		ip_cksum_resolve(mbuf, inner);
+
+		// Encapsulate with another IPv4 header and the GRE header with
+		// its optional fields.
+		hdr_len = sizeof(*hdr);
+		if (gre->flags & GR_GRE_F_KEY)
+			hdr_len += sizeof(*opt);
+		if (gre->flags & GR_GRE_F_SEQ)
+			hdr_len += sizeof(*opt);
+		outer = (struct rte_ipv4_hdr *)rte_pktmbuf_prepend(mbuf, sizeof(*outer) + hdr_len);
+		if (unlikely(outer == NULL)) {
+			edge = NO_HEADROOM;
+			goto next;
+		}
+		hdr = (struct gre_base_hdr *)(outer + 1);
+		hdr->flags = 0;
+		hdr->proto = RTE_BE16(RTE_ETHER_TYPE_IPV4);
+		opt = (rte_be32_t *)(hdr + 1);
+		if (gre->flags & GR_GRE_F_KEY) {
+			hdr->flags |= GRE_F_KEY;
+			*opt++ = rte_cpu_to_be_32(gre->key);
+		}
+		if (gre->flags & GR_GRE_F_SEQ) {
+			// Shared by all workers sending on this tunnel.
+			// Segments produced by port_gso reuse the same number.
+			hdr->flags |= GRE_F_SEQ;
+			*opt = rte_cpu_to_be_32(__atomic_fetch_add(&gre->seq, 1, __ATOMIC_RELAXED));
+		}
+
+		tunnel = ip_local_mbuf_data(mbuf);
+		tunnel->src = gre->local;
+		tunnel->dst = gre->remote;
+		tunnel->len = hdr_len + rte_be_to_cpu_16(inner->total_length);
+		tunnel->vrf_id = iface->vrf_id;
+		tunnel->proto = IPPROTO_GRE;
+		ip_set_fields(mbuf, outer, tunnel);
+		if (unlikely(mbuf->ol_flags & RTE_MBUF_F_TX_TCP_SEG)) {
+			// l3_len and l4_len keep describing the inner headers for
+			// port_gso. Only the inner IPv4 checksum can be offloaded.
+			ip_cksum_resolve(mbuf, outer);
+			mbuf->l3_len = rte_ipv4_hdr_len(inner);
+			mbuf->l2_len = hdr_len;
+			mbuf->outer_l3_len = sizeof(*outer);
+			mbuf->ol_flags |= RTE_MBUF_F_TX_IPV4 | RTE_MBUF_F_TX_IP_CKSUM
+				| RTE_MBUF_F_TX_OUTER_IPV4 | RTE_MBUF_F_TX_TUNNEL_GRE;
+		}
+		iface_stats_add(&stats, iface->id, tunnel->len);
+
+		// Resolve nexthop for the encapsulated packet.
+		ip_data->nh = ip4_route_cache_lookup(
+			&gre->route, iface->vrf_id, gre->remote, route_gen, iface_gen
+		);
+		edge = IP_OUTPUT;
+next:
+		rte_node_enqueue_x1(graph, node, edge, mbuf);
+	}
+	iface_stats_flush(&stats);
+
+	return nb_objs;
+}
+
+static void gre_output_register(void) {
+	ip_output_add_tunnel(GR_IFACE_TYPE_GRE, "gre_output");
+}
+
+static struct rte_node_register gre_output_node = {
+	.name = "gre_output",
+
+	.process = gre_output_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[IP_OUTPUT] = "ip_output",
+		[NO_TUNNEL] = "gre_output_no_tunnel",
+		[NO_HEADROOM] = "error_no_headroom",
+	},
+};
+
+static struct gr_node_info gre_output_info = {
+	.node = &gre_output_node,
+	.register_callback = gre_output_register,
+};
+
+GR_NODE_REGISTER(gre_output_info);
+
+GR_DROP_REGISTER(gre_output_no_tunnel);
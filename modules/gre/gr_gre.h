@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_API_GRE
+#define _GR_API_GRE
+
+#include <gr_api.h>
+#include <gr_bitops.h>
+#include <gr_infra.h>
+#include <gr_macro.h>
+#include <gr_net_types.h>
+
+#define GR_IFACE_TYPE_GRE 0x0005
+
+// GRE reconfig attributes
+#define GR_GRE_SET_LOCAL GR_BIT64(32)
+#define GR_GRE_SET_REMOTE GR_BIT64(33)
+#define GR_GRE_SET_KEY GR_BIT64(34)
+#define GR_GRE_SET_FLAGS GR_BIT64(35)
+
+// GRE tunnel flags
+#define GR_GRE_F_KEY GR_BIT16(0) // send and expect the key field
+#define GR_GRE_F_SEQ GR_BIT16(1) // send sequence numbers
+
+// Info for GR_IFACE_TYPE_GRE interfaces
+struct gr_iface_info_gre {
+	ip4_addr_t local;
+	ip4_addr_t remote;
+	uint32_t key; // only used with GR_GRE_F_KEY
+	uint16_t flags; // GR_GRE_F_*
+};
+
+static_assert(sizeof(struct gr_iface_info_gre) <= MEMBER_SIZE(struct gr_iface, info));
+
+#endif
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GRE_PRIV_H
+#define _GRE_PRIV_H
+
+#include <gr_iface.h>
+#include <gr_ip4_control.h>
+#include <gr_net_types.h>
+
+#include <rte_byteorder.h>
+#include <rte_hash.h>
+
+#include <stdint.h>
+
+struct __rte_aligned(alignof(void *)) iface_info_gre {
+	ip4_addr_t local;
+	ip4_addr_t remote;
+	uint32_t key;
+	uint16_t flags;
+	uint32_t seq; // next output sequence number
+	struct ip4_route_cache route; // underlay next hop of remote
+};
+
+struct gre_key {
+	ip4_addr_t local;
+	ip4_addr_t remote;
+	// zero when the tunnel has no key
+	uint32_t key;
+	// uint32_t to avoid padding bytes in the hash key, see struct ipip_key
+	uint32_t vrf_id;
+};
+
+#define GRE_LOOKUP_BULK_MAX RTE_HASH_LOOKUP_BULK_MAX
+
+// Lookup up to GRE_LOOKUP_BULK_MAX tunnels at once. Unknown tunnels are NULL.
+void gre_get_iface_bulk(const struct gre_key *keys, unsigned n, struct iface **ifaces);
+
+// RFC 2784 / RFC 2890 base header, followed by the optional fields in
+// checksum, key, sequence number order.
+struct gre_base_hdr {
+	rte_be16_t flags;
+	rte_be16_t proto;
+};
+
+#define GRE_F_CSUM RTE_BE16(0x8000)
+#define GRE_F_ROUTING RTE_BE16(0x4000)
+#define GRE_F_KEY RTE_BE16(0x2000)
+#define GRE_F_SEQ RTE_BE16(0x1000)
+#define GRE_F_VERSION RTE_BE16(0x0007)
+
+#endif
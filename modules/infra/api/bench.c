@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_infra.h"
+
+#include <gr_api.h>
+#include <gr_bench.h>
+#include <gr_control.h>
+
+#include <errno.h>
+#include <stdlib.h>
+
+static struct api_out bench_start_cb(const void *request, void ** /*response*/) {
+	if (bench_start(request) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out bench_stop_cb(const void * /*request*/, void ** /*response*/) {
+	if (bench_stop() < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out bench_get_cb(const void * /*request*/, void **response) {
+	struct gr_infra_bench_get_resp *resp;
+	size_t len;
+
+	if ((resp = bench_get(&len)) == NULL)
+		return api_out(errno, 0);
+
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+static struct gr_api_handler bench_start_handler = {
+	.name = "bench start",
+	.request_type = GR_INFRA_BENCH_START,
+	.callback = bench_start_cb,
+};
+
+static struct gr_api_handler bench_stop_handler = {
+	.name = "bench stop",
+	.request_type = GR_INFRA_BENCH_STOP,
+	.callback = bench_stop_cb,
+};
+
+static struct gr_api_handler bench_get_handler = {
+	.name = "bench get",
+	.request_type = GR_INFRA_BENCH_GET,
+	.callback = bench_get_cb,
+};
+
+RTE_INIT(bench_api_constructor) {
+	gr_register_api_handler(&bench_start_handler);
+	gr_register_api_handler(&bench_stop_handler);
+	gr_register_api_handler(&bench_get_handler);
+}
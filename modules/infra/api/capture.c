@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_infra.h"
+
+#include <gr_api.h>
+#include <gr_capture.h>
+#include <gr_control.h>
+
+#include <errno.h>
+#include <stdlib.h>
+
+static struct api_out capture_start_cb(const void *request, void ** /*response*/) {
+	if (capture_start(request) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out capture_stop_cb(const void * /*request*/, void ** /*response*/) {
+	if (capture_stop() < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out capture_get_cb(const void * /*request*/, void **response) {
+	struct gr_infra_capture_get_resp *resp;
+
+	if ((resp = malloc(sizeof(*resp))) == NULL)
+		return api_out(ENOMEM, 0);
+
+	capture_get(resp);
+	*response = resp;
+
+	return api_out(0, sizeof(*resp));
+}
+
+static struct gr_api_handler capture_start_handler = {
+	.name = "capture start",
+	.request_type = GR_INFRA_CAPTURE_START,
+	.callback = capture_start_cb,
+};
+
+static struct gr_api_handler capture_stop_handler = {
+	.name = "capture stop",
+	.request_type = GR_INFRA_CAPTURE_STOP,
+	.callback = capture_stop_cb,
+};
+
+static struct gr_api_handler capture_get_handler = {
+	.name = "capture get",
+	.request_type = GR_INFRA_CAPTURE_GET,
+	.callback = capture_get_cb,
+};
+
+RTE_INIT(capture_api_constructor) {
+	gr_register_api_handler(&capture_start_handler);
+	gr_register_api_handler(&capture_stop_handler);
+	gr_register_api_handler(&capture_get_handler);
+}
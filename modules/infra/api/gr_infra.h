@@ -20,11 +20,17 @@
 #define GR_IFACE_TYPE_UNDEF 0x0000
 #define GR_IFACE_TYPE_PORT 0x0001
 #define GR_IFACE_TYPE_VLAN 0x0002
+#define GR_IFACE_TYPE_BOND 0x0008
 
 // Interface configure flags
 #define GR_IFACE_F_UP GR_BIT16(0)
 #define GR_IFACE_F_PROMISC GR_BIT16(1)
 #define GR_IFACE_F_ALLMULTI GR_BIT16(2)
+// Drop IPv4/IPv6 packets whose source is not routed via the input interface.
+#define GR_IFACE_F_RPF_STRICT GR_BIT16(3)
+// Drop IPv4/IPv6 packets whose source has no route.
+#define GR_IFACE_F_RPF_LOOSE GR_BIT16(4)
+#define GR_IFACE_F_RPF (GR_IFACE_F_RPF_STRICT | GR_IFACE_F_RPF_LOOSE)
 // Interface state flags
 #define GR_IFACE_S_RUNNING GR_BIT16(0)
 
@@ -54,6 +60,18 @@ struct gr_iface {
 #define GR_PORT_SET_N_TXQS GR_BIT64(33)
 #define GR_PORT_SET_Q_SIZE GR_BIT64(34)
 #define GR_PORT_SET_MAC GR_BIT64(35)
+#define GR_PORT_SET_TX_POLICY GR_BIT64(36)
+#define GR_PORT_SET_CTRL_RXQ GR_BIT64(37)
+#define GR_PORT_SET_TX_FREE GR_BIT64(38)
+
+// What to do with packets that the driver did not accept for transmission.
+#define GR_PORT_TX_DROP 0 // drop them immediately
+#define GR_PORT_TX_RETRY 1 // retry sending them at most tx_limit times
+#define GR_PORT_TX_QUEUE 2 // hold at most tx_limit packets per worker and retry later
+
+#define GR_PORT_TX_RETRY_DEFAULT 4
+#define GR_PORT_TX_QUEUE_DEFAULT 1024
+#define GR_PORT_TX_QUEUE_MAX 32768
 
 // Info for GR_IFACE_TYPE_PORT interfaces
 struct gr_iface_info_port {
@@ -66,6 +84,15 @@ struct gr_iface_info_port {
 	uint16_t rxq_size;
 	uint16_t txq_size;
 	struct rte_ether_addr mac;
+	uint8_t tx_policy; // GR_PORT_TX_*
+	uint16_t tx_limit; // max retries or queued packets, 0 for the default
+	// steer ARP, NDP and traffic to local addresses to an extra rxq (index n_rxq)
+	uint8_t ctrl_rxq;
+	// return sent mbufs to the port pool in bulk (RTE_ETH_TX_OFFLOAD_MBUF_FAST_FREE)
+	uint8_t tx_fast_free;
+	// txq descriptors recycling thresholds, 0 for the driver defaults
+	uint16_t tx_free_thresh;
+	uint16_t tx_rs_thresh;
 };
 
 static_assert(sizeof(struct gr_iface_info_port) <= MEMBER_SIZE(struct gr_iface, info));
@@ -84,6 +111,28 @@ struct gr_iface_info_vlan {
 
 static_assert(sizeof(struct gr_iface_info_vlan) <= MEMBER_SIZE(struct gr_iface, info));
 
+// Bond reconfig attributes
+#define GR_BOND_SET_MODE GR_BIT64(32)
+#define GR_BOND_SET_MEMBERS GR_BIT64(33)
+#define GR_BOND_SET_MAC GR_BIT64(34)
+
+#define GR_BOND_MODE_BALANCE 0 // static link aggregation, all running members are used
+#define GR_BOND_MODE_LACP 1 // IEEE 802.1AX dynamic link aggregation
+
+#define GR_BOND_MAX_MEMBERS 8
+
+// Info for GR_IFACE_TYPE_BOND interfaces
+struct gr_iface_info_bond {
+	uint8_t mode; // GR_BOND_MODE_*
+	uint8_t n_members;
+	uint16_t member_ids[GR_BOND_MAX_MEMBERS]; // GR_IFACE_TYPE_PORT interfaces
+	struct rte_ether_addr mac; // defaults to the mac of the first member
+	// read-only, bit mask of the member indexes selected for transmission
+	uint8_t active_members;
+};
+
+static_assert(sizeof(struct gr_iface_info_bond) <= MEMBER_SIZE(struct gr_iface, info));
+
 struct gr_port_rxq_map {
 	uint16_t iface_id;
 	uint16_t rxq_id;
@@ -132,11 +181,15 @@ struct gr_infra_iface_get_resp {
 
 #define GR_INFRA_IFACE_LIST REQUEST_TYPE(GR_INFRA_MODULE, 0x0004)
 
+// Start with a zero cursor and send as many requests as needed with the
+// next_cursor of the previous response, until next_cursor is zero.
 struct gr_infra_iface_list_req {
 	uint16_t type; // use GR_IFACE_TYPE_UNDEF for all
+	uint16_t cursor;
 };
 
 struct gr_infra_iface_list_resp {
+	uint16_t next_cursor; // zero when all interfaces have been listed
 	uint16_t n_ifaces;
 	struct gr_iface ifaces[/* n_ifaces */];
 };
@@ -150,6 +203,26 @@ struct gr_infra_iface_set_req {
 
 // struct gr_infra_iface_set_resp { };
 
+#define GR_INFRA_IFACE_STATS_GET REQUEST_TYPE(GR_INFRA_MODULE, 0x0006)
+
+struct gr_infra_iface_stats_get_req {
+	uint16_t iface_id; // use GR_IFACE_ID_UNDEF for all
+};
+
+// Software counters, updated by the datapath for all interface types.
+struct gr_iface_stats {
+	uint16_t iface_id;
+	uint64_t rx_packets;
+	uint64_t rx_bytes;
+	uint64_t tx_packets;
+	uint64_t tx_bytes;
+};
+
+struct gr_infra_iface_stats_get_resp {
+	uint16_t n_stats;
+	struct gr_iface_stats stats[/* n_stats */];
+};
+
 // iface rxqs ///////////////////////////////////////////////////////////////////
 #define GR_INFRA_RXQ_LIST REQUEST_TYPE(GR_INFRA_MODULE, 0x0010)
 
@@ -170,6 +243,358 @@ struct gr_infra_rxq_set_req {
 
 // struct gr_infra_rxq_set_resp { };
 
+// port rss ///////////////////////////////////////////////////////////////////
+#define GR_PORT_RSS_F_IPV4 GR_BIT32(0)
+#define GR_PORT_RSS_F_IPV6 GR_BIT32(1)
+#define GR_PORT_RSS_F_TCP GR_BIT32(2) // TCP ports, IPv4 and IPv6
+#define GR_PORT_RSS_F_UDP GR_BIT32(3) // UDP ports, IPv4 and IPv6
+#define GR_PORT_RSS_F_SCTP GR_BIT32(4)
+#define GR_PORT_RSS_F_VLAN GR_BIT32(5) // outer VLAN ID
+#define GR_PORT_RSS_F_ESP GR_BIT32(6)
+#define GR_PORT_RSS_F_GTPU GR_BIT32(7)
+
+#define GR_PORT_RSS_KEY_SIZE 64
+#define GR_PORT_RETA_SIZE 512
+
+struct gr_port_rss {
+	uint32_t hash_fields; // GR_PORT_RSS_F_*
+	// Use a symmetric hash function so that both directions of a flow are
+	// received on the same rxq. Either done by the driver (symmetric
+	// Toeplitz) or with a symmetric key when the driver has no support.
+	uint8_t symmetric;
+	uint8_t key_len; // zero for the driver default key or on input to keep it
+	uint8_t key[GR_PORT_RSS_KEY_SIZE];
+	// Indirection table, rxq ID for each bucket. On input, the table
+	// is repeated as many times as necessary to fill the hardware table.
+	// The default table spreads buckets evenly over all datapath rxqs.
+	uint16_t reta_size;
+	uint16_t reta[GR_PORT_RETA_SIZE];
+};
+
+#define GR_INFRA_RSS_GET REQUEST_TYPE(GR_INFRA_MODULE, 0x0014)
+
+struct gr_infra_rss_get_req {
+	uint16_t iface_id;
+};
+
+struct gr_infra_rss_get_resp {
+	struct gr_port_rss rss;
+};
+
+#define GR_PORT_RSS_SET_HASH_FIELDS GR_BIT8(0)
+#define GR_PORT_RSS_SET_SYMMETRIC GR_BIT8(1)
+#define GR_PORT_RSS_SET_KEY GR_BIT8(2)
+#define GR_PORT_RSS_SET_RETA GR_BIT8(3) // zero reta_size to restore the default table
+
+#define GR_INFRA_RSS_SET REQUEST_TYPE(GR_INFRA_MODULE, 0x0015)
+
+struct gr_infra_rss_set_req {
+	uint16_t iface_id;
+	uint8_t set_attrs; // GR_PORT_RSS_SET_*
+	struct gr_port_rss rss;
+};
+
+// struct gr_infra_rss_set_resp { };
+
+// port qos ////////////////////////////////////////////////////////////////////
+#define GR_PORT_QOS_DISABLED 0
+#define GR_PORT_QOS_DSCP 1 // traffic class from the IP DSCP class selector
+#define GR_PORT_QOS_PCP 2 // traffic class from the VLAN priority
+
+#define GR_PORT_QOS_PIPES_MAX 4096
+#define GR_PORT_QOS_QUEUE_SIZE_DEFAULT 64
+#define GR_PORT_QOS_BURST_DEFAULT 65536
+#define GR_PORT_QOS_CPU_ANY UINT16_MAX
+
+// Hierarchical egress scheduler. Each pipe (subscriber) is selected from the
+// VLAN ID of the sent frames and shaped to pipe_rate. Within a pipe, priority
+// 7 to 1 are strict priority classes, priority 0 goes to the best effort
+// queues. All packets are scheduled by a single worker.
+struct gr_port_qos {
+	uint8_t classify; // GR_PORT_QOS_*
+	uint16_t n_pipes; // power of 2, 0 for a single pipe
+	uint16_t queue_size; // power of 2, in packets, 0 for the default
+	// worker running the scheduler or GR_PORT_QOS_CPU_ANY for the owner of txq 0
+	uint16_t cpu_id;
+	uint64_t rate; // port rate in bit/s
+	uint64_t pipe_rate; // bit/s, 0 for the port rate
+	uint32_t pipe_burst; // bytes, 0 for the default
+	// statistics, ignored on input
+	uint64_t enqueued;
+	uint64_t dropped; // by the scheduler queues
+};
+
+#define GR_INFRA_QOS_GET REQUEST_TYPE(GR_INFRA_MODULE, 0x0018)
+
+struct gr_infra_qos_get_req {
+	uint16_t iface_id;
+};
+
+struct gr_infra_qos_get_resp {
+	struct gr_port_qos qos;
+};
+
+#define GR_INFRA_QOS_SET REQUEST_TYPE(GR_INFRA_MODULE, 0x0019)
+
+struct gr_infra_qos_set_req {
+	uint16_t iface_id;
+	struct gr_port_qos qos;
+};
+
+// struct gr_infra_qos_set_resp { };
+
+// iface policer ///////////////////////////////////////////////////////////////
+#define GR_POLICER_DISABLED 0
+#define GR_POLICER_SRTCM 1 // single rate three color marker (RFC 2697)
+#define GR_POLICER_TRTCM 2 // two rate three color marker (RFC 2698)
+
+// What to do with yellow and red packets.
+#define GR_POLICER_PASS 0
+#define GR_POLICER_DROP 1
+#define GR_POLICER_REMARK 2 // set the IP DSCP
+
+// Color blind ingress policer of a port or VLAN interface. Each worker meters
+// the packets it receives with an equal share of the rates, the share of each
+// flow is approximated by the RSS distribution. Burst sizes are not divided.
+struct gr_policer {
+	uint8_t mode; // GR_POLICER_*
+	uint8_t yellow; // GR_POLICER_PASS, DROP or REMARK
+	uint8_t red; // GR_POLICER_PASS, DROP or REMARK
+	uint8_t yellow_dscp;
+	uint8_t red_dscp;
+	uint64_t cir; // committed rate in bytes/s
+	uint64_t pir; // peak rate in bytes/s, trTCM only
+	uint64_t cbs; // committed burst in bytes
+	uint64_t ebs; // excess (srTCM) or peak (trTCM) burst in bytes
+	// statistics, ignored on input
+	uint64_t n_green;
+	uint64_t n_yellow;
+	uint64_t n_red;
+};
+
+#define GR_INFRA_POLICER_GET REQUEST_TYPE(GR_INFRA_MODULE, 0x001a)
+
+struct gr_infra_policer_get_req {
+	uint16_t iface_id;
+};
+
+struct gr_infra_policer_get_resp {
+	struct gr_policer policer;
+};
+
+#define GR_INFRA_POLICER_SET REQUEST_TYPE(GR_INFRA_MODULE, 0x001b)
+
+struct gr_infra_policer_set_req {
+	uint16_t iface_id;
+	struct gr_policer policer;
+};
+
+// struct gr_infra_policer_set_resp { };
+
+// port mirror /////////////////////////////////////////////////////////////////
+#define GR_PORT_MIRROR_F_RX (1 << 0) // received frames, before any processing
+#define GR_PORT_MIRROR_F_TX (1 << 1) // transmitted frames
+
+// Copy the frames received and/or sent on a port to a monitor port. Copies
+// share the data buffers of the original packets and are sent in bursts on
+// the monitor port. They come from a dedicated pool and are dropped when it
+// is exhausted or when the rate is exceeded, forwarding is never affected.
+struct gr_port_mirror {
+	uint16_t dst_iface_id; // monitor port, GR_IFACE_ID_UNDEF to disable
+	uint8_t flags; // GR_PORT_MIRROR_F_*
+	uint16_t snaplen; // max bytes of each copy, 0 for the whole frame
+	uint32_t rate; // max copies per second, 0 for unlimited
+	// statistics, ignored on input
+	uint64_t packets;
+	uint64_t dropped; // rate limited or no mbuf available
+};
+
+#define GR_INFRA_MIRROR_GET REQUEST_TYPE(GR_INFRA_MODULE, 0x001c)
+
+struct gr_infra_mirror_get_req {
+	uint16_t iface_id;
+};
+
+struct gr_infra_mirror_get_resp {
+	struct gr_port_mirror mirror;
+};
+
+#define GR_INFRA_MIRROR_SET REQUEST_TYPE(GR_INFRA_MODULE, 0x001d)
+
+struct gr_infra_mirror_set_req {
+	uint16_t iface_id;
+	struct gr_port_mirror mirror;
+};
+
+// struct gr_infra_mirror_set_resp { };
+
+// exception path //////////////////////////////////////////////////////////////
+
+// Locally destined packets that grout does not handle (unknown IP protocols,
+// UDP ports without listener) are sent to a kernel network device so that the
+// routing daemons and services running on the host can use the addresses of
+// the interface. Packets sent by the host on that device are routed as if
+// generated by grout. Frames are exchanged in bursts with the kernel through
+// a virtio-user port using the vhost-net backend.
+#define GR_PUNT_IFNAME_SIZE 16
+
+struct gr_iface_punt {
+	char ifname[GR_PUNT_IFNAME_SIZE]; // kernel device, empty to disable
+	uint32_t rate; // max punted packets per second, 0 for unlimited
+	// statistics, ignored on input
+	uint64_t punted;
+	uint64_t injected;
+	uint64_t dropped; // rate limited or kernel device queue full
+	uint64_t coalesced; // TCP segments merged with the previous ones by GRO
+};
+
+#define GR_INFRA_PUNT_GET REQUEST_TYPE(GR_INFRA_MODULE, 0x001e)
+
+struct gr_infra_punt_get_req {
+	uint16_t iface_id;
+};
+
+struct gr_infra_punt_get_resp {
+	struct gr_iface_punt punt;
+};
+
+#define GR_INFRA_PUNT_SET REQUEST_TYPE(GR_INFRA_MODULE, 0x001f)
+
+struct gr_infra_punt_set_req {
+	uint16_t iface_id;
+	struct gr_iface_punt punt;
+};
+
+// struct gr_infra_punt_set_resp { };
+
+// port rxq pinning ////////////////////////////////////////////////////////////
+#define GR_PORT_PIN_VLAN 1 // outer VLAN ID
+#define GR_PORT_PIN_IP4 2 // IPv4 destination prefix
+#define GR_PORT_PIN_IP6 3 // IPv6 destination prefix
+
+#define GR_PORT_PINS_MAX 64
+
+// Steer the traffic of a tenant to a range of datapath rxqs with an rte_flow
+// rule, spread with RSS when the range has more than one rxq. Pinned rxqs are
+// removed from the default RSS indirection table and the rxq balancer never
+// mixes them with rxqs of other tenants on the same worker. The ranges of two
+// pins must either be identical (same tenant) or disjoint. At least one rxq
+// must remain for the traffic which does not match any pin.
+struct gr_port_pin {
+	uint8_t type; // GR_PORT_PIN_*
+	union {
+		uint16_t vlan_id;
+		struct ip4_net ip4;
+		struct ip6_net ip6;
+	};
+	uint16_t first_rxq;
+	uint16_t n_rxqs;
+	// ignored on input
+	uint8_t installed; // the rule was accepted by the driver
+};
+
+#define GR_INFRA_PORT_PIN_ADD REQUEST_TYPE(GR_INFRA_MODULE, 0x0080)
+
+struct gr_infra_port_pin_add_req {
+	uint16_t iface_id;
+	struct gr_port_pin pin;
+};
+
+// struct gr_infra_port_pin_add_resp { };
+
+#define GR_INFRA_PORT_PIN_DEL REQUEST_TYPE(GR_INFRA_MODULE, 0x0081)
+
+struct gr_infra_port_pin_del_req {
+	uint16_t iface_id;
+	struct gr_port_pin pin; // only the match is considered
+};
+
+// struct gr_infra_port_pin_del_resp { };
+
+#define GR_INFRA_PORT_PIN_LIST REQUEST_TYPE(GR_INFRA_MODULE, 0x0082)
+
+struct gr_infra_port_pin_list_req {
+	uint16_t iface_id;
+};
+
+struct gr_infra_port_pin_list_resp {
+	uint16_t n_pins;
+	struct gr_port_pin pins[/* n_pins */];
+};
+
+// workers /////////////////////////////////////////////////////////////////////
+#define GR_WORKER_POWER_AUTO 0 // poll, interrupt or sleep depending on grout options
+#define GR_WORKER_POWER_POLL 1 // busy poll all rx queues
+#define GR_WORKER_POWER_SLEEP 2 // micro-sleep when idle
+#define GR_WORKER_POWER_INTR 3 // block on rx interrupts when idle, requires --rx-interrupts
+#define GR_WORKER_POWER_MONITOR 4 // wait for rx descriptor writes (UMWAIT or equivalent)
+#define GR_WORKER_POWER_PAUSE 5 // short low power pauses when idle (TPAUSE or equivalent)
+
+struct gr_worker_info {
+	uint16_t cpu_id;
+	uint8_t power; // GR_WORKER_POWER_*
+	uint8_t active_power; // GR_WORKER_POWER_* actually used, never AUTO
+	uint16_t n_rxqs;
+	uint64_t total_cycles;
+	uint64_t busy_cycles;
+	uint64_t sleep_cycles;
+	uint64_t n_sleeps;
+	// graph walk durations, only with a stall threshold
+	uint64_t walk_max_ns;
+	uint64_t walk_p50_ns; // upper bound of the log2 bucket
+	uint64_t walk_p99_ns;
+	uint64_t walk_p999_ns;
+	uint64_t n_stalls;
+};
+
+#define GR_INFRA_WORKER_LIST REQUEST_TYPE(GR_INFRA_MODULE, 0x0012)
+
+// struct gr_infra_worker_list_req { };
+
+struct gr_infra_worker_list_resp {
+	uint16_t n_workers;
+	struct gr_worker_info workers[/* n_workers */];
+};
+
+#define GR_INFRA_WORKER_SET REQUEST_TYPE(GR_INFRA_MODULE, 0x0013)
+
+// Unsupported power policies fall back to GR_WORKER_POWER_SLEEP.
+struct gr_infra_worker_set_req {
+	uint16_t cpu_id;
+	uint8_t power; // GR_WORKER_POWER_*
+};
+
+// struct gr_infra_worker_set_resp { };
+
+// Graph walk watchdog. When the threshold is not zero, workers measure the
+// duration of each graph walk and log the walks which exceed it along with
+// the node call which took the most cycles.
+#define GR_INFRA_WORKER_WATCHDOG_SET REQUEST_TYPE(GR_INFRA_MODULE, 0x0016)
+
+struct gr_infra_worker_watchdog_set_req {
+	uint32_t threshold_us; // 0 to disable
+};
+
+// struct gr_infra_worker_watchdog_set_resp { };
+
+#define GR_INFRA_WORKER_STALL_LIST REQUEST_TYPE(GR_INFRA_MODULE, 0x0017)
+
+// struct gr_infra_worker_stall_list_req { };
+
+struct gr_worker_stall {
+	uint16_t cpu_id;
+	uint64_t age_us; // time since the end of the walk
+	uint64_t duration_ns;
+	char node[64];
+	uint64_t node_ns;
+};
+
+struct gr_infra_worker_stall_list_resp {
+	uint32_t threshold_us;
+	uint16_t n_stalls;
+	struct gr_worker_stall stalls[/* n_stalls */];
+};
+
 // stats ///////////////////////////////////////////////////////////////////////
 #define GR_INFRA_STAT_F_SW GR_BIT16(0) //!< include software stats
 #define GR_INFRA_STAT_F_HW GR_BIT16(1) //!< include hardware stats
@@ -193,6 +618,216 @@ struct gr_infra_stats_get_resp {
 // struct gr_infra_stats_reset_req { };
 // struct gr_infra_stats_reset_resp { };
 
+// Binary statistics.
+//
+// GR_INFRA_STATS_SCHEMA returns the names of all counters along with their
+// numeric ID. The schema only changes when ports are added, removed or
+// reconfigured. In that case, schema_gen is incremented.
+//
+// GR_INFRA_STATS_VALUES returns the counters values by ID. The server keeps
+// a generation number which is incremented every time any counter changes.
+// When since_gen is not zero, only the counters that changed after that
+// generation are returned. Requests with an outdated schema_gen fail with
+// ESTALE and the schema must be fetched again.
+//
+// Both responses are paginated. Start with a zero cursor and send as many
+// requests as needed with the next_cursor of the previous response, until
+// next_cursor is zero. Counters are only refreshed when cursor is zero, all
+// pages of a single walk report the same generation.
+#define GR_INFRA_STATS_SCHEMA REQUEST_TYPE(GR_INFRA_MODULE, 0x0022)
+
+struct gr_infra_stats_schema_req {
+	uint32_t cursor;
+};
+
+struct gr_infra_stat_desc {
+	uint32_t id;
+	uint16_t iface_id; // GR_IFACE_ID_UNDEF for software stats
+	char name[64];
+};
+
+struct gr_infra_stats_schema_resp {
+	uint32_t schema_gen;
+	uint32_t next_cursor;
+	uint32_t n_descs;
+	struct gr_infra_stat_desc descs[/* n_descs */];
+};
+
+#define GR_INFRA_STATS_VALUES REQUEST_TYPE(GR_INFRA_MODULE, 0x0023)
+
+struct gr_infra_stats_values_req {
+	uint32_t schema_gen;
+	uint32_t cursor;
+	uint64_t since_gen; // zero for all counters
+};
+
+struct gr_infra_stat_value {
+	uint32_t id;
+	uint64_t objs;
+	uint64_t calls;
+	uint64_t cycles;
+};
+
+struct gr_infra_stats_values_resp {
+	uint32_t schema_gen;
+	uint32_t next_cursor;
+	uint64_t gen;
+	uint32_t n_values;
+	struct gr_infra_stat_value values[/* n_values */];
+};
+
+// Per node log2 histograms of the number of cycles and objects per call. They
+// are disabled by default since they add two rdtsc per node call. Bucket 0
+// counts zero values, bucket i counts values in [2^(i-1), 2^i). The last
+// bucket also counts all larger values. Counters are merged from all workers
+// and cleared with GR_INFRA_STATS_RESET.
+#define GR_INFRA_STATS_HIST_BUCKETS 32
+
+#define GR_INFRA_STATS_HIST_SET REQUEST_TYPE(GR_INFRA_MODULE, 0x0024)
+
+struct gr_infra_stats_hist_set_req {
+	bool enabled;
+};
+
+// struct gr_infra_stats_hist_set_resp { };
+
+#define GR_INFRA_STATS_HIST_GET REQUEST_TYPE(GR_INFRA_MODULE, 0x0025)
+
+struct gr_infra_stats_hist_get_req {
+	char pattern[64]; // optional glob pattern
+};
+
+struct gr_infra_node_hist {
+	char name[64];
+	uint64_t calls;
+	uint64_t cycles[GR_INFRA_STATS_HIST_BUCKETS];
+	uint64_t objs[GR_INFRA_STATS_HIST_BUCKETS];
+};
+
+struct gr_infra_stats_hist_get_resp {
+	bool enabled;
+	uint16_t n_nodes;
+	struct gr_infra_node_hist nodes[/* n_nodes */];
+};
+
+// Time spent by packets between reception and transmission, including the
+// time spent in hold queues. The histogram uses the same log2 buckets, in TSC
+// cycles. Packets which were not received on a port are not sampled.
+#define GR_INFRA_STATS_DWELL_SET REQUEST_TYPE(GR_INFRA_MODULE, 0x0026)
+
+struct gr_infra_stats_dwell_set_req {
+	bool enabled;
+	uint32_t sample_rate; // record one packet out of sample_rate
+};
+
+// struct gr_infra_stats_dwell_set_resp { };
+
+#define GR_INFRA_STATS_DWELL_GET REQUEST_TYPE(GR_INFRA_MODULE, 0x0027)
+
+// struct gr_infra_stats_dwell_get_req { };
+
+struct gr_infra_stats_dwell_get_resp {
+	bool enabled;
+	uint32_t sample_rate;
+	uint64_t tsc_hz;
+	uint64_t samples;
+	uint64_t cycles[GR_INFRA_STATS_HIST_BUCKETS];
+};
+
+// Packets freed by the drop nodes, per drop reason (the drop node name) and
+// per receiving interface. Counters are merged from all workers and cleared
+// with GR_INFRA_STATS_RESET. Optionally, one dropped packet out of sample_rate
+// is copied to the packet trace buffer, even when packet trace is disabled.
+#define GR_INFRA_STATS_DROP_SET REQUEST_TYPE(GR_INFRA_MODULE, 0x0028)
+
+struct gr_infra_stats_drop_set_req {
+	uint32_t sample_rate; // 0 to disable sampling
+};
+
+// struct gr_infra_stats_drop_set_resp { };
+
+#define GR_INFRA_STATS_DROP_GET REQUEST_TYPE(GR_INFRA_MODULE, 0x0029)
+
+struct gr_infra_stats_drop_get_req {
+	uint16_t iface_id; // GR_IFACE_ID_UNDEF for all
+	char pattern[64]; // optional glob pattern on the drop reason
+	uint32_t cursor; // next_cursor of the previous response, zero to start
+};
+
+struct gr_infra_stat_drop {
+	char reason[64];
+	uint16_t iface_id; // GR_IFACE_ID_UNDEF if not received on a port, or if it was removed
+	uint64_t packets;
+};
+
+struct gr_infra_stats_drop_get_resp {
+	uint32_t sample_rate;
+	uint32_t next_cursor; // zero when all counters have been listed
+	uint16_t n_drops;
+	struct gr_infra_stat_drop drops[/* n_drops */];
+};
+
+// Packets and bytes received per VRF and per address family by ip_input and
+// ip6_input, including packets dropped afterwards. Counters are merged from
+// all workers and cleared with GR_INFRA_STATS_RESET.
+#define GR_INFRA_STATS_VRF_GET REQUEST_TYPE(GR_INFRA_MODULE, 0x002a)
+
+struct gr_infra_stats_vrf_get_req {
+	uint16_t vrf_id; // UINT16_MAX for all
+};
+
+struct gr_infra_stat_vrf {
+	uint16_t vrf_id;
+	uint8_t family; // AF_INET or AF_INET6
+	uint64_t packets;
+	uint64_t bytes;
+};
+
+struct gr_infra_stats_vrf_get_resp {
+	uint16_t n_vrfs;
+	struct gr_infra_stat_vrf vrfs[/* n_vrfs */];
+};
+
+// Most frequent destination prefixes, estimated from one received packet out
+// of sample_rate. Destination addresses are masked to a fixed prefix length,
+// the FIB is not involved. Cleared with GR_INFRA_STATS_RESET.
+#define GR_INFRA_STATS_TOP_PREFIX_SET REQUEST_TYPE(GR_INFRA_MODULE, 0x002b)
+
+struct gr_infra_stats_top_prefix_set_req {
+	uint32_t sample_rate; // 0 to disable
+	uint8_t ip4_prefixlen; // 1..32, 0 for the default (24)
+	uint8_t ip6_prefixlen; // 1..128, 0 for the default (48)
+};
+
+// struct gr_infra_stats_top_prefix_set_resp { };
+
+#define GR_INFRA_STATS_TOP_PREFIX_GET REQUEST_TYPE(GR_INFRA_MODULE, 0x002c)
+
+struct gr_infra_stats_top_prefix_get_req {
+	uint16_t vrf_id; // UINT16_MAX for all
+	uint16_t max_prefixes; // 0 for all
+};
+
+struct gr_infra_stat_prefix {
+	uint16_t vrf_id;
+	uint8_t family; // AF_INET or AF_INET6
+	uint8_t prefixlen;
+	union {
+		ip4_addr_t ip4;
+		struct rte_ipv6_addr ip6;
+	};
+	uint64_t packets; // estimated, may be overestimated by up to error
+	uint64_t error;
+};
+
+struct gr_infra_stats_top_prefix_get_resp {
+	uint32_t sample_rate;
+	uint8_t ip4_prefixlen;
+	uint8_t ip6_prefixlen;
+	uint16_t n_prefixes;
+	struct gr_infra_stat_prefix prefixes[/* n_prefixes */];
+};
+
 // graph ///////////////////////////////////////////////////////////////////////
 #define GR_INFRA_GRAPH_DUMP REQUEST_TYPE(GR_INFRA_MODULE, 0x0030)
 
@@ -203,4 +838,249 @@ struct gr_infra_graph_dump_resp {
 	char dot[/* len */];
 };
 
+#define GR_GRAPH_MODEL_RTC 0 // each worker runs the whole graph
+#define GR_GRAPH_MODEL_DISPATCH 1 // pinned nodes are handed over to their worker
+
+struct gr_graph_affinity {
+	char node[64];
+	uint16_t cpu_id;
+};
+
+#define GR_INFRA_GRAPH_MODEL_SET REQUEST_TYPE(GR_INFRA_MODULE, 0x0031)
+
+struct gr_infra_graph_model_set_req {
+	uint8_t model; // GR_GRAPH_MODEL_*
+};
+
+// struct gr_infra_graph_model_set_resp { };
+
+#define GR_INFRA_GRAPH_MODEL_GET REQUEST_TYPE(GR_INFRA_MODULE, 0x0032)
+
+// struct gr_infra_graph_model_get_req { };
+
+struct gr_infra_graph_model_get_resp {
+	uint8_t model; // GR_GRAPH_MODEL_*
+	uint16_t n_affinities;
+	struct gr_graph_affinity affinities[/* n_affinities */];
+};
+
+// Process all packets of a node on the given worker. Only applied with the
+// GR_GRAPH_MODEL_DISPATCH model. Source nodes cannot be pinned.
+#define GR_INFRA_GRAPH_AFFINITY_SET REQUEST_TYPE(GR_INFRA_MODULE, 0x0033)
+
+struct gr_infra_graph_affinity_set_req {
+	struct gr_graph_affinity affinity; // cpu_id UINT16_MAX to remove
+};
+
+// struct gr_infra_graph_affinity_set_resp { };
+
+// mempools ////////////////////////////////////////////////////////////////////
+struct gr_mempool_info {
+	char name[32];
+	int16_t socket_id; // -1 (SOCKET_ID_ANY) if not NUMA local
+	uint16_t data_room; // zero if not a packet mempool
+	uint32_t size; // total number of objects
+	uint32_t reserved; // mbufs reserved for rx/tx queues and rings
+	uint32_t cache_size; // per-lcore cache size
+	uint32_t in_use; // objects allocated
+	uint32_t avail; // objects available in the common pool
+	uint32_t cached; // objects available in per-lcore caches
+};
+
+#define GR_INFRA_MEMPOOL_LIST REQUEST_TYPE(GR_INFRA_MODULE, 0x0040)
+
+// struct gr_infra_mempool_list_req { };
+
+struct gr_infra_mempool_list_resp {
+	uint16_t n_mempools;
+	struct gr_mempool_info mempools[/* n_mempools */];
+};
+
+// memory //////////////////////////////////////////////////////////////////////
+// Subsystem name of the entries which report the DPDK heap of a NUMA socket.
+// All hugepage memory allocated by grout comes from these heaps.
+#define GR_MEM_HEAP "heap"
+// Heap memory not attributed to any subsystem.
+#define GR_MEM_OTHER "other"
+
+struct gr_mem_usage {
+	char subsystem[32];
+	int16_t socket_id;
+	uint64_t used; // bytes
+	uint64_t used_max; // high-water mark since startup, sampled every second
+	uint64_t total; // GR_MEM_HEAP only, size of the heap
+};
+
+#define GR_INFRA_MEMORY_GET REQUEST_TYPE(GR_INFRA_MODULE, 0x0041)
+
+// struct gr_infra_memory_get_req { };
+
+struct gr_infra_memory_get_resp {
+	uint16_t n_usages;
+	struct gr_mem_usage usages[/* n_usages */];
+};
+
+// packet trace ////////////////////////////////////////////////////////////////
+#define GR_INFRA_PACKET_TRACE_SET REQUEST_TYPE(GR_INFRA_MODULE, 0x0050)
+
+struct gr_infra_packet_trace_set_req {
+	bool enabled;
+	uint16_t iface_id; // GR_IFACE_ID_UNDEF for all
+	uint32_t sample_rate; // trace one packet out of sample_rate, 0 is the same as 1
+};
+
+// struct gr_infra_packet_trace_set_resp { };
+
+#define GR_INFRA_PACKET_TRACE_DUMP REQUEST_TYPE(GR_INFRA_MODULE, 0x0051)
+
+struct gr_infra_packet_trace_dump_req {
+	uint16_t max_packets; // 0 for all buffered packets
+};
+
+struct gr_infra_packet_trace_dump_resp {
+	uint32_t n_packets;
+	uint64_t lost; // records dropped because a worker ring or the buffer was full
+	uint32_t len;
+	char trace[/* len */]; // one line per packet, NUL terminated
+};
+
+// tracepoints /////////////////////////////////////////////////////////////////
+#define GR_INFRA_TRACEPOINT_NAME_SIZE 64
+
+#define GR_INFRA_TRACEPOINT_SET REQUEST_TYPE(GR_INFRA_MODULE, 0x0052)
+
+struct gr_infra_tracepoint_set_req {
+	// glob pattern, matched against DPDK and grout ("grout.*") tracepoint names
+	char pattern[GR_INFRA_TRACEPOINT_NAME_SIZE];
+	bool enabled;
+};
+
+// struct gr_infra_tracepoint_set_resp { };
+
+#define GR_INFRA_TRACEPOINT_LIST REQUEST_TYPE(GR_INFRA_MODULE, 0x0053)
+
+// struct gr_infra_tracepoint_list_req { };
+
+struct gr_infra_tracepoint {
+	char name[GR_INFRA_TRACEPOINT_NAME_SIZE];
+	bool enabled;
+};
+
+struct gr_infra_tracepoint_list_resp {
+	uint16_t n_tracepoints;
+	struct gr_infra_tracepoint tracepoints[/* n_tracepoints */];
+};
+
+// Write the trace buffers in the CTF format to the EAL trace directory.
+#define GR_INFRA_TRACEPOINT_SAVE REQUEST_TYPE(GR_INFRA_MODULE, 0x0054)
+
+// struct gr_infra_tracepoint_save_req { };
+// struct gr_infra_tracepoint_save_resp { };
+
+// packet capture //////////////////////////////////////////////////////////////
+#define GR_CAPTURE_MAX_NODES 16
+#define GR_CAPTURE_NODE_SIZE 64
+#define GR_CAPTURE_PATH_SIZE 108
+
+#define GR_INFRA_CAPTURE_START REQUEST_TYPE(GR_INFRA_MODULE, 0x0060)
+
+struct gr_infra_capture_start_req {
+	uint8_t n_nodes;
+	char nodes[GR_CAPTURE_MAX_NODES][GR_CAPTURE_NODE_SIZE]; // graph nodes or drop nodes
+	uint16_t iface_id; // port interface, GR_IFACE_ID_UNDEF for all
+	uint32_t snaplen; // 0 for the full packet
+	bool unix_socket; // connect to a listening UNIX socket instead of writing a file
+	char path[GR_CAPTURE_PATH_SIZE];
+};
+
+// struct gr_infra_capture_start_resp { };
+
+#define GR_INFRA_CAPTURE_STOP REQUEST_TYPE(GR_INFRA_MODULE, 0x0061)
+
+// struct gr_infra_capture_stop_req { };
+// struct gr_infra_capture_stop_resp { };
+
+#define GR_INFRA_CAPTURE_GET REQUEST_TYPE(GR_INFRA_MODULE, 0x0062)
+
+// struct gr_infra_capture_get_req { };
+
+struct gr_infra_capture_get_resp {
+	bool active;
+	uint8_t n_nodes;
+	char nodes[GR_CAPTURE_MAX_NODES][GR_CAPTURE_NODE_SIZE];
+	uint16_t iface_id;
+	uint32_t snaplen;
+	char path[GR_CAPTURE_PATH_SIZE];
+	uint64_t packets; // copied by the workers
+	uint64_t ring_full; // not copied, worker ring full
+	uint64_t no_mbuf; // not copied, capture mempool exhausted
+	uint64_t written; // written to the output
+	uint64_t write_errors; // not written, output error or too slow
+};
+
+// synthetic traffic benchmark /////////////////////////////////////////////////
+#define GR_BENCH_MAX_CPUS 64
+
+// Packets built from an Ethernet/IPv4/UDP template are injected in the graph
+// by the bench_source node of the selected workers, as if received on a port.
+// The template may be 802.1Q tagged and encapsulated in an outer IPIP header.
+// Packets sent to the sink port are counted and freed by the bench_sink node
+// instead of being transmitted.
+#define GR_INFRA_BENCH_START REQUEST_TYPE(GR_INFRA_MODULE, 0x0070)
+
+struct gr_infra_bench_start_req {
+	uint16_t iface_id; // port interface where packets are injected
+	uint16_t sink_iface_id; // port interface, GR_IFACE_ID_UNDEF for no sink
+	uint16_t n_cpus; // 0 for all workers
+	uint16_t cpu_ids[GR_BENCH_MAX_CPUS];
+	struct rte_ether_addr dst_mac; // all zeroes for the iface address
+	ip4_addr_t src;
+	ip4_addr_t dst;
+	uint16_t src_port;
+	uint16_t dst_port;
+	uint32_t n_flows; // incremented UDP source ports, 0 for 1
+	uint16_t pkt_len; // frame length without CRC, 0 for 60
+	uint16_t burst; // packets per graph walk, 0 for RTE_GRAPH_BURST_SIZE
+	uint32_t n_dsts; // incremented destination addresses, 0 for 1
+	uint16_t vlan_id; // first 802.1Q tag, 0 for untagged
+	uint16_t n_vlans; // incremented VLAN IDs, 0 for 1
+	ip4_addr_t outer_src; // outer IPIP header, 0 for none
+	ip4_addr_t outer_dst;
+};
+
+// struct gr_infra_bench_start_resp { };
+
+#define GR_INFRA_BENCH_STOP REQUEST_TYPE(GR_INFRA_MODULE, 0x0071)
+
+// struct gr_infra_bench_stop_req { };
+// struct gr_infra_bench_stop_resp { };
+
+#define GR_INFRA_BENCH_GET REQUEST_TYPE(GR_INFRA_MODULE, 0x0072)
+
+// struct gr_infra_bench_get_req { };
+
+struct gr_bench_worker {
+	uint16_t cpu_id;
+	uint64_t packets; // injected by bench_source
+	uint64_t no_mbuf; // not injected, mempool exhausted
+	uint64_t sink_packets; // freed by bench_sink
+	uint64_t sink_bytes;
+};
+
+struct gr_infra_bench_get_resp {
+	bool active;
+	struct gr_infra_bench_start_req params;
+	uint64_t duration_ns; // since the benchmark was started
+	uint16_t n_workers;
+	struct gr_bench_worker workers[/* n_workers */];
+};
+
+// events //////////////////////////////////////////////////////////////////////
+
+// The event object is a struct gr_iface.
+#define GR_INFRA_EVENT_IFACE_ADD EVENT_TYPE(GR_INFRA_MODULE, 0x0001)
+#define GR_INFRA_EVENT_IFACE_DEL EVENT_TYPE(GR_INFRA_MODULE, 0x0002)
+// Configuration or link status change. Coalesced.
+#define GR_INFRA_EVENT_IFACE_UPDATE EVENT_TYPE(GR_INFRA_MODULE, 0x0003)
+
 #endif
@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_STATS_SHM
+#define _GR_STATS_SHM
+
+#include <gr_infra.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only shared memory statistics segment.
+//
+// grout periodically publishes the software (per worker, per graph node)
+// and basic hardware port counters in a POSIX shared memory object. The
+// segment can be mapped by monitoring agents to read the counters without
+// sending requests on the API socket.
+//
+// Updates are protected by a sequence lock. Use gr_stats_shm_read() to get
+// a consistent copy of the segment before accessing its contents.
+
+#define GR_STATS_SHM_MAGIC 0x67727374 // "grst"
+#define GR_STATS_SHM_VERSION 2
+#define GR_STATS_SHM_PERIOD_MS 1000
+#define GR_STATS_SHM_NODE_NAME_SIZE 64
+
+struct gr_stats_shm_node {
+	uint64_t objs;
+	uint64_t calls;
+	uint64_t cycles;
+};
+
+struct gr_stats_shm_worker {
+	uint16_t cpu_id;
+	uint8_t power; // GR_WORKER_POWER_* currently used by the worker
+	uint64_t total_cycles;
+	uint64_t busy_cycles;
+	uint64_t sleep_cycles;
+	uint64_t n_sleeps;
+	// indexed by graph node id
+	struct gr_stats_shm_node nodes[/* gr_stats_shm.max_nodes */];
+};
+
+struct gr_stats_shm_port {
+	uint16_t iface_id;
+	uint16_t port_id;
+	char name[GR_IFACE_NAME_SIZE];
+	uint64_t rx_packets;
+	uint64_t rx_bytes;
+	uint64_t rx_missed;
+	uint64_t rx_errors;
+	uint64_t rx_nombuf;
+	uint64_t tx_packets;
+	uint64_t tx_bytes;
+	uint64_t tx_errors;
+};
+
+struct gr_stats_shm {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t size; // total size of the segment in bytes
+	// odd while the segment is being updated
+	_Atomic(uint64_t) seq;
+	// CLOCK_MONOTONIC nanoseconds of the last update
+	uint64_t timestamp;
+	uint32_t max_nodes;
+	uint32_t max_workers;
+	uint32_t max_ports;
+	uint32_t n_workers;
+	uint32_t n_ports;
+	// byte offsets from the start of the segment
+	uint32_t node_names_offset; // char[max_nodes][GR_STATS_SHM_NODE_NAME_SIZE]
+	uint32_t workers_offset; // worker_size * max_workers
+	uint32_t worker_size;
+	uint32_t ports_offset; // struct gr_stats_shm_port[max_ports]
+};
+
+static inline const char *gr_stats_shm_node_name(const struct gr_stats_shm *shm, uint32_t node) {
+	const char *names = (const char *)shm + shm->node_names_offset;
+	return &names[node * GR_STATS_SHM_NODE_NAME_SIZE];
+}
+
+static inline const struct gr_stats_shm_worker *
+gr_stats_shm_worker(const struct gr_stats_shm *shm, uint32_t i) {
+	const uint8_t *base = (const uint8_t *)shm + shm->workers_offset;
+	return (const struct gr_stats_shm_worker *)(base + i * shm->worker_size);
+}
+
+static inline const struct gr_stats_shm_port *
+gr_stats_shm_port(const struct gr_stats_shm *shm, uint32_t i) {
+	const uint8_t *base = (const uint8_t *)shm + shm->ports_offset;
+	return &((const struct gr_stats_shm_port *)base)[i];
+}
+
+// Map the statistics segment published by grout.
+// Returns NULL and sets errno on failure.
+static inline const struct gr_stats_shm *gr_stats_shm_open(const char *name) {
+	const struct gr_stats_shm *shm;
+	struct stat st;
+	int fd;
+
+	if ((fd = shm_open(name, O_RDONLY, 0)) < 0)
+		return NULL;
+	if (fstat(fd, &st) < 0)
+		goto err;
+	if ((size_t)st.st_size < sizeof(*shm)) {
+		errno = EPROTO;
+		goto err;
+	}
+	shm = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED)
+		goto err;
+	close(fd);
+
+	if (shm->magic != GR_STATS_SHM_MAGIC || shm->version != GR_STATS_SHM_VERSION
+	    || shm->size != (uint64_t)st.st_size) {
+		munmap((void *)shm, st.st_size);
+		errno = EPROTO;
+		return NULL;
+	}
+
+	return shm;
+err:
+	close(fd);
+	return NULL;
+}
+
+static inline void gr_stats_shm_close(const struct gr_stats_shm *shm) {
+	if (shm != NULL)
+		munmap((void *)shm, shm->size);
+}
+
+// Copy a consistent snapshot of the segment into buf which must be at least
+// shm->size bytes long. The accessors above can be used on the copy.
+// Returns 0 on success or a negative errno value.
+static inline int gr_stats_shm_read(const struct gr_stats_shm *shm, void *buf, size_t len) {
+	struct gr_stats_shm *copy = buf;
+	uint64_t seq;
+
+	if (len < shm->size) {
+		errno = ENOBUFS;
+		return -errno;
+	}
+
+	for (;;) {
+		seq = atomic_load_explicit(&shm->seq, memory_order_acquire);
+		if (seq & 1)
+			continue;
+		memcpy(buf, shm, shm->size);
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(&shm->seq, memory_order_relaxed) == seq)
+			break;
+	}
+	copy->seq = seq;
+
+	return 0;
+}
+
+#endif
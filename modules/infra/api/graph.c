@@ -5,12 +5,16 @@
 
 #include <gr_api.h>
 #include <gr_control.h>
+#include <gr_graph.h>
+#include <gr_stb_ds.h>
 #include <gr_worker.h>
 
 #include <rte_graph_worker.h>
 
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/queue.h>
 
 static struct api_out graph_dump(const void * /*request*/, void **response) {
@@ -58,8 +62,71 @@ static struct gr_api_handler graph_dump_handler = {
 	.name = "graph dump",
 	.request_type = GR_INFRA_GRAPH_DUMP,
 	.callback = graph_dump,
+	.flags = GR_API_F_READ,
+};
+
+static struct api_out graph_model_set_cb(const void *request, void ** /*response*/) {
+	const struct gr_infra_graph_model_set_req *req = request;
+
+	if (graph_model_set(req->model) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out graph_model_get_cb(const void * /*request*/, void **response) {
+	const struct gr_graph_affinity *affinities = graph_affinity_list();
+	struct gr_infra_graph_model_get_resp *resp;
+	size_t len;
+
+	len = sizeof(*resp) + arrlen(affinities) * sizeof(*affinities);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	resp->model = graph_model_get();
+	resp->n_affinities = arrlen(affinities);
+	if (resp->n_affinities > 0)
+		memcpy(resp->affinities, affinities, arrlen(affinities) * sizeof(*affinities));
+
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+static struct api_out graph_affinity_set_cb(const void *request, void ** /*response*/) {
+	const struct gr_infra_graph_affinity_set_req *req = request;
+	char node[sizeof(req->affinity.node)];
+
+	if (memccpy(node, req->affinity.node, 0, sizeof(node)) == NULL)
+		return api_out(ENAMETOOLONG, 0);
+	if (graph_affinity_set(node, req->affinity.cpu_id) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct gr_api_handler graph_model_set_handler = {
+	.name = "graph model set",
+	.request_type = GR_INFRA_GRAPH_MODEL_SET,
+	.callback = graph_model_set_cb,
+};
+
+static struct gr_api_handler graph_model_get_handler = {
+	.name = "graph model get",
+	.request_type = GR_INFRA_GRAPH_MODEL_GET,
+	.callback = graph_model_get_cb,
+	.flags = GR_API_F_READ,
+};
+
+static struct gr_api_handler graph_affinity_set_handler = {
+	.name = "graph affinity set",
+	.request_type = GR_INFRA_GRAPH_AFFINITY_SET,
+	.callback = graph_affinity_set_cb,
 };
 
 RTE_INIT(graph_init) {
 	gr_register_api_handler(&graph_dump_handler);
+	gr_register_api_handler(&graph_model_set_handler);
+	gr_register_api_handler(&graph_model_get_handler);
+	gr_register_api_handler(&graph_affinity_set_handler);
 }
@@ -78,21 +78,40 @@ static struct api_out iface_get(const void *request, void **response) {
 	return api_out(0, sizeof(*resp));
 }
 
+// Max number of interfaces in a single list response.
+#define IFACE_LIST_MAX                                                                             \
+	((GR_API_MAX_MSG_LEN - sizeof(struct gr_infra_iface_list_resp)) / sizeof(struct gr_iface))
+
 static struct api_out iface_list(const void *request, void **response) {
 	const struct gr_infra_iface_list_req *req = request;
 	struct gr_infra_iface_list_resp *resp = NULL;
 	const struct iface *iface = NULL;
-	uint16_t n_ifaces;
+	uint16_t n_ifaces, next_id;
 	size_t len;
 
-	n_ifaces = ifaces_count(req->type);
+	// interfaces are always iterated in increasing id order
+	n_ifaces = 0;
+	next_id = 0;
+	while ((iface = iface_next(req->type, iface)) != NULL) {
+		if (iface->id < req->cursor)
+			continue;
+		if (n_ifaces == IFACE_LIST_MAX) {
+			next_id = iface->id;
+			break;
+		}
+		n_ifaces++;
+	}
 
 	len = sizeof(*resp) + n_ifaces * sizeof(struct gr_iface);
 	if ((resp = calloc(1, len)) == NULL)
 		return api_out(ENOMEM, 0);
 
-	while ((iface = iface_next(req->type, iface)) != NULL)
-		iface_to_api(&resp->ifaces[resp->n_ifaces++], iface);
+	resp->next_cursor = next_id;
+	iface = NULL;
+	while (resp->n_ifaces < n_ifaces && (iface = iface_next(req->type, iface)) != NULL) {
+		if (iface->id >= req->cursor)
+			iface_to_api(&resp->ifaces[resp->n_ifaces++], iface);
+	}
 
 	*response = resp;
 
@@ -118,30 +137,112 @@ static struct api_out iface_set(const void *request, void ** /*response*/) {
 	return api_out(0, 0);
 }
 
+static struct api_out iface_stats_list(const void *request, void **response) {
+	const struct gr_infra_iface_stats_get_req *req = request;
+	struct gr_infra_iface_stats_get_resp *resp = NULL;
+	const struct iface *iface = NULL;
+	uint16_t n_stats;
+	size_t len;
+
+	if (req->iface_id != GR_IFACE_ID_UNDEF) {
+		if (iface_from_id(req->iface_id) == NULL)
+			return api_out(ENODEV, 0);
+		n_stats = 1;
+	} else {
+		n_stats = ifaces_count(GR_IFACE_TYPE_UNDEF);
+	}
+
+	len = sizeof(*resp) + n_stats * sizeof(struct gr_iface_stats);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	while ((iface = iface_next(GR_IFACE_TYPE_UNDEF, iface)) != NULL) {
+		struct gr_iface_stats *s;
+		struct iface_stats stats;
+
+		if (resp->n_stats == n_stats)
+			break;
+		if (req->iface_id != GR_IFACE_ID_UNDEF && iface->id != req->iface_id)
+			continue;
+
+		iface_stats_get(iface->id, &stats);
+		s = &resp->stats[resp->n_stats++];
+		s->iface_id = iface->id;
+		s->rx_packets = stats.rx.packets;
+		s->rx_bytes = stats.rx.bytes;
+		s->tx_packets = stats.tx.packets;
+		s->tx_bytes = stats.tx.bytes;
+	}
+
+	*response = resp;
+	return api_out(0, len);
+}
+
 static struct gr_api_handler iface_add_handler = {
 	.name = "iface add",
 	.request_type = GR_INFRA_IFACE_ADD,
 	.callback = iface_add,
+	.flags = GR_API_F_CONFIG,
 };
 static struct gr_api_handler iface_del_handler = {
 	.name = "iface del",
 	.request_type = GR_INFRA_IFACE_DEL,
 	.callback = iface_del,
+	.flags = GR_API_F_CONFIG,
 };
 static struct gr_api_handler iface_get_handler = {
 	.name = "iface get",
 	.request_type = GR_INFRA_IFACE_GET,
 	.callback = iface_get,
+	.flags = GR_API_F_READ,
 };
 static struct gr_api_handler iface_list_handler = {
 	.name = "iface list",
 	.request_type = GR_INFRA_IFACE_LIST,
 	.callback = iface_list,
+	.flags = GR_API_F_READ,
 };
 static struct gr_api_handler iface_set_handler = {
 	.name = "iface set",
 	.request_type = GR_INFRA_IFACE_SET,
 	.callback = iface_set,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler iface_stats_handler = {
+	.name = "iface stats get",
+	.request_type = GR_INFRA_IFACE_STATS_GET,
+	.callback = iface_stats_list,
+	.flags = GR_API_F_READ,
+};
+
+static void iface_event_push(iface_event_t event, struct iface *iface) {
+	const void *key = NULL;
+	struct gr_iface api;
+	uint32_t ev_type;
+
+	switch (event) {
+	case IFACE_EVENT_POST_ADD:
+		ev_type = GR_INFRA_EVENT_IFACE_ADD;
+		break;
+	case IFACE_EVENT_PRE_REMOVE:
+		ev_type = GR_INFRA_EVENT_IFACE_DEL;
+		break;
+	case IFACE_EVENT_POST_RECONFIG:
+	case IFACE_EVENT_PORT_POST_RECONFIG:
+	case IFACE_EVENT_PORT_LINK_CHANGE:
+		ev_type = GR_INFRA_EVENT_IFACE_UPDATE;
+		key = iface;
+		break;
+	default:
+		return;
+	}
+
+	iface_to_api(&api, iface);
+	gr_event_push(ev_type, key, &api, sizeof(api));
+}
+
+static struct iface_event_handler iface_event_push_handler = {
+	.callback = iface_event_push,
 };
 
 RTE_INIT(infra_api_init) {
@@ -150,4 +251,6 @@ RTE_INIT(infra_api_init) {
 	gr_register_api_handler(&iface_get_handler);
 	gr_register_api_handler(&iface_list_handler);
 	gr_register_api_handler(&iface_set_handler);
+	gr_register_api_handler(&iface_stats_handler);
+	iface_event_register_handler(&iface_event_push_handler);
 }
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_infra.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_memory.h>
+#include <gr_stb_ds.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct api_out memory_get(const void * /*request*/, void **response) {
+	struct gr_infra_memory_get_resp *resp;
+	struct gr_mem_usage *usages;
+	size_t len;
+
+	gr_mem_usage_get(&usages);
+
+	len = sizeof(*resp) + arrlen(usages) * sizeof(*usages);
+	if ((resp = calloc(1, len)) == NULL) {
+		arrfree(usages);
+		return api_out(ENOMEM, 0);
+	}
+
+	resp->n_usages = arrlen(usages);
+	if (arrlen(usages) > 0)
+		memcpy(resp->usages, usages, arrlen(usages) * sizeof(*usages));
+	arrfree(usages);
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+static struct gr_api_handler memory_get_handler = {
+	.name = "memory get",
+	.request_type = GR_INFRA_MEMORY_GET,
+	.callback = memory_get,
+};
+
+RTE_INIT(memory_api_init) {
+	gr_register_api_handler(&memory_get_handler);
+}
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_infra.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_mempool.h>
+#include <gr_stb_ds.h>
+
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void mempool_info_fill(struct rte_mempool *mp, void *priv) {
+	struct gr_mempool_info **infos = priv;
+	struct gr_mempool_info info = {
+		.socket_id = mp->socket_id,
+		.size = mp->size,
+		.reserved = gr_pktmbuf_pool_reserved(mp),
+		.cache_size = mp->cache_size,
+	};
+	uint32_t avail;
+
+	memccpy(info.name, mp->name, 0, sizeof(info.name));
+	if (mp->private_data_size >= sizeof(struct rte_pktmbuf_pool_private))
+		info.data_room = rte_pktmbuf_data_room_size(mp);
+
+	// Caches are read without synchronization, the counts are approximate.
+	if (mp->cache_size != 0) {
+		for (unsigned i = 0; i < RTE_MAX_LCORE; i++)
+			info.cached += mp->local_cache[i].len;
+	}
+	avail = rte_mempool_avail_count(mp);
+	info.avail = avail > info.cached ? avail - info.cached : 0;
+	info.in_use = mp->size > avail ? mp->size - avail : 0;
+
+	arrpush(*infos, info);
+}
+
+static struct api_out mempool_list(const void * /*request*/, void **response) {
+	struct gr_infra_mempool_list_resp *resp;
+	struct gr_mempool_info *infos = NULL;
+	size_t len;
+
+	rte_mempool_walk(mempool_info_fill, &infos);
+
+	len = sizeof(*resp) + arrlen(infos) * sizeof(*infos);
+	if ((resp = calloc(1, len)) == NULL) {
+		arrfree(infos);
+		return api_out(ENOMEM, 0);
+	}
+
+	resp->n_mempools = arrlen(infos);
+	if (arrlen(infos) > 0)
+		memcpy(resp->mempools, infos, arrlen(infos) * sizeof(*infos));
+	arrfree(infos);
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+static struct gr_api_handler mempool_list_handler = {
+	.name = "mempool list",
+	.request_type = GR_INFRA_MEMPOOL_LIST,
+	.callback = mempool_list,
+	.flags = GR_API_F_READ,
+};
+
+RTE_INIT(mempool_init) {
+	gr_register_api_handler(&mempool_list_handler);
+}
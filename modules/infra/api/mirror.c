@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_infra.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_port.h>
+
+#include <errno.h>
+#include <stdlib.h>
+
+static struct api_out mirror_get(const void *request, void **response) {
+	const struct gr_infra_mirror_get_req *req = request;
+	struct gr_infra_mirror_get_resp *resp;
+	struct iface *iface;
+
+	if ((iface = iface_from_id(req->iface_id)) == NULL)
+		return api_out(errno, 0);
+
+	if ((resp = calloc(1, sizeof(*resp))) == NULL)
+		return api_out(ENOMEM, 0);
+
+	if (port_mirror_get(iface, &resp->mirror) < 0) {
+		free(resp);
+		return api_out(errno, 0);
+	}
+	*response = resp;
+
+	return api_out(0, sizeof(*resp));
+}
+
+static struct api_out mirror_set(const void *request, void ** /*response*/) {
+	const struct gr_infra_mirror_set_req *req = request;
+	struct iface *iface;
+
+	if ((iface = iface_from_id(req->iface_id)) == NULL)
+		return api_out(errno, 0);
+
+	if (port_mirror_set(iface, &req->mirror) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct gr_api_handler mirror_get_handler = {
+	.name = "mirror get",
+	.request_type = GR_INFRA_MIRROR_GET,
+	.callback = mirror_get,
+};
+static struct gr_api_handler mirror_set_handler = {
+	.name = "mirror set",
+	.request_type = GR_INFRA_MIRROR_SET,
+	.callback = mirror_set,
+	.flags = GR_API_F_CONFIG,
+};
+
+RTE_INIT(mirror_init) {
+	gr_register_api_handler(&mirror_get_handler);
+	gr_register_api_handler(&mirror_set_handler);
+}
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_infra.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_iface.h>
+
+#include <errno.h>
+#include <stdlib.h>
+
+static struct api_out policer_get(const void *request, void **response) {
+	const struct gr_infra_policer_get_req *req = request;
+	struct gr_infra_policer_get_resp *resp;
+	struct iface *iface;
+
+	if ((iface = iface_from_id(req->iface_id)) == NULL)
+		return api_out(errno, 0);
+
+	if ((resp = calloc(1, sizeof(*resp))) == NULL)
+		return api_out(ENOMEM, 0);
+
+	if (iface_policer_get(iface, &resp->policer) < 0) {
+		free(resp);
+		return api_out(errno, 0);
+	}
+	*response = resp;
+
+	return api_out(0, sizeof(*resp));
+}
+
+static struct api_out policer_set(const void *request, void ** /*response*/) {
+	const struct gr_infra_policer_set_req *req = request;
+	struct iface *iface;
+
+	if ((iface = iface_from_id(req->iface_id)) == NULL)
+		return api_out(errno, 0);
+
+	if (iface_policer_set(iface, &req->policer) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct gr_api_handler policer_get_handler = {
+	.name = "policer get",
+	.request_type = GR_INFRA_POLICER_GET,
+	.callback = policer_get,
+};
+static struct gr_api_handler policer_set_handler = {
+	.name = "policer set",
+	.request_type = GR_INFRA_POLICER_SET,
+	.callback = policer_set,
+	.flags = GR_API_F_CONFIG,
+};
+
+RTE_INIT(policer_init) {
+	gr_register_api_handler(&policer_get_handler);
+	gr_register_api_handler(&policer_set_handler);
+}
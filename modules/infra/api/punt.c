@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_infra.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_iface.h>
+
+#include <errno.h>
+#include <stdlib.h>
+
+static struct api_out punt_get(const void *request, void **response) {
+	const struct gr_infra_punt_get_req *req = request;
+	struct gr_infra_punt_get_resp *resp;
+	struct iface *iface;
+
+	if ((iface = iface_from_id(req->iface_id)) == NULL)
+		return api_out(errno, 0);
+
+	if ((resp = calloc(1, sizeof(*resp))) == NULL)
+		return api_out(ENOMEM, 0);
+
+	if (iface_punt_get(iface, &resp->punt) < 0) {
+		free(resp);
+		return api_out(errno, 0);
+	}
+	*response = resp;
+
+	return api_out(0, sizeof(*resp));
+}
+
+static struct api_out punt_set(const void *request, void ** /*response*/) {
+	const struct gr_infra_punt_set_req *req = request;
+	struct iface *iface;
+
+	if ((iface = iface_from_id(req->iface_id)) == NULL)
+		return api_out(errno, 0);
+
+	if (iface_punt_set(iface, &req->punt) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct gr_api_handler punt_get_handler = {
+	.name = "punt get",
+	.request_type = GR_INFRA_PUNT_GET,
+	.callback = punt_get,
+};
+static struct gr_api_handler punt_set_handler = {
+	.name = "punt set",
+	.request_type = GR_INFRA_PUNT_SET,
+	.callback = punt_set,
+	.flags = GR_API_F_CONFIG,
+};
+
+RTE_INIT(punt_init) {
+	gr_register_api_handler(&punt_get_handler);
+	gr_register_api_handler(&punt_set_handler);
+}
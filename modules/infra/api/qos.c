@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_infra.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_port.h>
+
+#include <errno.h>
+#include <stdlib.h>
+
+static struct iface *qos_port(uint16_t iface_id) {
+	struct iface *iface = iface_from_id(iface_id);
+
+	if (iface == NULL)
+		return NULL;
+	if (iface->type_id != GR_IFACE_TYPE_PORT)
+		return errno_set_null(EMEDIUMTYPE);
+
+	return iface;
+}
+
+static struct api_out qos_get(const void *request, void **response) {
+	const struct gr_infra_qos_get_req *req = request;
+	struct gr_infra_qos_get_resp *resp;
+	struct iface *iface;
+
+	if ((iface = qos_port(req->iface_id)) == NULL)
+		return api_out(errno, 0);
+
+	if ((resp = calloc(1, sizeof(*resp))) == NULL)
+		return api_out(ENOMEM, 0);
+
+	if (port_qos_get(iface, &resp->qos) < 0) {
+		free(resp);
+		return api_out(errno, 0);
+	}
+	*response = resp;
+
+	return api_out(0, sizeof(*resp));
+}
+
+static struct api_out qos_set(const void *request, void ** /*response*/) {
+	const struct gr_infra_qos_set_req *req = request;
+	struct iface *iface;
+
+	if ((iface = qos_port(req->iface_id)) == NULL)
+		return api_out(errno, 0);
+
+	if (port_qos_set(iface, &req->qos) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct gr_api_handler qos_get_handler = {
+	.name = "qos get",
+	.request_type = GR_INFRA_QOS_GET,
+	.callback = qos_get,
+};
+static struct gr_api_handler qos_set_handler = {
+	.name = "qos set",
+	.request_type = GR_INFRA_QOS_SET,
+	.callback = qos_set,
+	.flags = GR_API_F_CONFIG,
+};
+
+RTE_INIT(qos_init) {
+	gr_register_api_handler(&qos_get_handler);
+	gr_register_api_handler(&qos_set_handler);
+}
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_infra.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_log.h>
+#include <gr_port.h>
+
+#include <errno.h>
+#include <stdlib.h>
+
+static struct iface_info_port *rss_port(uint16_t iface_id) {
+	struct iface *iface = iface_from_id(iface_id);
+
+	if (iface == NULL)
+		return NULL;
+	if (iface->type_id != GR_IFACE_TYPE_PORT)
+		return errno_set_null(EMEDIUMTYPE);
+
+	return (struct iface_info_port *)iface->info;
+}
+
+static struct api_out rss_get(const void *request, void **response) {
+	const struct gr_infra_rss_get_req *req = request;
+	struct gr_infra_rss_get_resp *resp;
+	struct iface_info_port *port;
+
+	if ((port = rss_port(req->iface_id)) == NULL)
+		return api_out(errno, 0);
+
+	if ((resp = calloc(1, sizeof(*resp))) == NULL)
+		return api_out(ENOMEM, 0);
+
+	if (port_rss_get(port, &resp->rss) < 0) {
+		free(resp);
+		return api_out(errno, 0);
+	}
+	*response = resp;
+
+	return api_out(0, sizeof(*resp));
+}
+
+static struct api_out rss_set(const void *request, void ** /*response*/) {
+	const struct gr_infra_rss_set_req *req = request;
+	struct iface_info_port *port;
+
+	if ((port = rss_port(req->iface_id)) == NULL)
+		return api_out(errno, 0);
+
+	if (port_rss_set(port, req->set_attrs, &req->rss) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct gr_api_handler rss_get_handler = {
+	.name = "rss get",
+	.request_type = GR_INFRA_RSS_GET,
+	.callback = rss_get,
+};
+static struct gr_api_handler rss_set_handler = {
+	.name = "rss set",
+	.request_type = GR_INFRA_RSS_SET,
+	.callback = rss_set,
+	.flags = GR_API_F_CONFIG,
+};
+
+RTE_INIT(rss_init) {
+	gr_register_api_handler(&rss_get_handler);
+	gr_register_api_handler(&rss_set_handler);
+}
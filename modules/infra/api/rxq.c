@@ -5,11 +5,14 @@
 
 #include <gr_api.h>
 #include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_log.h>
 #include <gr_port.h>
 #include <gr_stb_ds.h>
 #include <gr_worker.h>
 
 #include <errno.h>
+#include <stdlib.h>
 #include <sys/queue.h>
 #include <unistd.h>
 
@@ -61,18 +64,99 @@ static struct api_out rxq_set(const void *request, void ** /*response*/) {
 	return api_out(0, 0);
 }
 
+static struct iface_info_port *pin_port(uint16_t iface_id) {
+	struct iface *iface = iface_from_id(iface_id);
+
+	if (iface == NULL)
+		return NULL;
+	if (iface->type_id != GR_IFACE_TYPE_PORT)
+		return errno_set_null(EMEDIUMTYPE);
+
+	return (struct iface_info_port *)iface->info;
+}
+
+static struct api_out pin_add(const void *request, void ** /*response*/) {
+	const struct gr_infra_port_pin_add_req *req = request;
+	struct iface_info_port *port;
+
+	if ((port = pin_port(req->iface_id)) == NULL)
+		return api_out(errno, 0);
+
+	if (port_pin_add(port, &req->pin) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out pin_del(const void *request, void ** /*response*/) {
+	const struct gr_infra_port_pin_del_req *req = request;
+	struct iface_info_port *port;
+
+	if ((port = pin_port(req->iface_id)) == NULL)
+		return api_out(errno, 0);
+
+	if (port_pin_del(port, &req->pin) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out pin_list(const void *request, void **response) {
+	const struct gr_infra_port_pin_list_req *req = request;
+	struct gr_infra_port_pin_list_resp *resp;
+	struct iface_info_port *port;
+	size_t len;
+
+	if ((port = pin_port(req->iface_id)) == NULL)
+		return api_out(errno, 0);
+
+	len = sizeof(*resp) + arrlen(port->pins) * sizeof(struct gr_port_pin);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	for (int i = 0; i < arrlen(port->pins); i++)
+		resp->pins[resp->n_pins++] = port->pins[i].pin;
+	*response = resp;
+
+	return api_out(0, len);
+}
+
 static struct gr_api_handler rxq_list_handler = {
 	.name = "rxq list",
 	.request_type = GR_INFRA_RXQ_LIST,
 	.callback = rxq_list,
+	.flags = GR_API_F_READ,
 };
 static struct gr_api_handler rxq_set_handler = {
 	.name = "rxq set",
 	.request_type = GR_INFRA_RXQ_SET,
 	.callback = rxq_set,
+	.flags = GR_API_F_CONFIG,
+};
+
+static struct gr_api_handler pin_add_handler = {
+	.name = "port pin add",
+	.request_type = GR_INFRA_PORT_PIN_ADD,
+	.callback = pin_add,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler pin_del_handler = {
+	.name = "port pin del",
+	.request_type = GR_INFRA_PORT_PIN_DEL,
+	.callback = pin_del,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler pin_list_handler = {
+	.name = "port pin list",
+	.request_type = GR_INFRA_PORT_PIN_LIST,
+	.callback = pin_list,
+	.flags = GR_API_F_READ,
 };
 
 RTE_INIT(rxq_init) {
 	gr_register_api_handler(&rxq_list_handler);
 	gr_register_api_handler(&rxq_set_handler);
+	gr_register_api_handler(&pin_add_handler);
+	gr_register_api_handler(&pin_del_handler);
+	gr_register_api_handler(&pin_list_handler);
 }
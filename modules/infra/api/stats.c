@@ -3,17 +3,24 @@
 
 #include <gr_api.h>
 #include <gr_control.h>
+#include <gr_control_input.h>
+#include <gr_datapath.h>
+#include <gr_iface.h>
 #include <gr_infra.h>
 #include <gr_log.h>
+#include <gr_macro.h>
 #include <gr_port.h>
 #include <gr_stb_ds.h>
+#include <gr_vrf_stats.h>
 #include <gr_worker.h>
 
 #include <rte_common.h>
+#include <rte_cycles.h>
 #include <rte_ethdev.h>
 #include <rte_graph.h>
 
 #include <fnmatch.h>
+#include <sys/socket.h>
 
 struct stat_value {
 	uint64_t objs;
@@ -26,6 +33,23 @@ struct stat_entry {
 	struct stat_value value;
 };
 
+static void tx_policy_put(
+	struct stat_entry **smap,
+	const struct iface *iface,
+	const char *policy,
+	const struct iface_tx_policy_counters *c
+) {
+	struct stat_value value = {
+		.objs = c->packets,
+		.calls = c->calls,
+		.cycles = c->cycles,
+	};
+	char name[64];
+
+	snprintf(name, sizeof(name), "%s.%s", iface->name, policy);
+	shput(*smap, name, value);
+}
+
 static struct api_out stats_get(const void *request, void **response) {
 	const struct gr_infra_stats_get_req *req = request;
 	struct gr_infra_stats_get_resp *resp = NULL;
@@ -74,6 +98,27 @@ static struct api_out stats_get(const void *request, void **response) {
 				shput(smap, "idle", value);
 			}
 		}
+
+		// effect of the tx policies, per port
+		struct iface *iface = NULL;
+		while ((iface = iface_next(GR_IFACE_TYPE_PORT, iface)) != NULL) {
+			struct iface_stats stats;
+
+			iface_stats_get(iface->id, &stats);
+			tx_policy_put(&smap, iface, "tx_retry", &stats.tx_retry);
+			tx_policy_put(&smap, iface, "tx_queue", &stats.tx_queue);
+			tx_policy_put(&smap, iface, "tx_drop", &stats.tx_drop);
+		}
+
+		// control_input backpressure
+		struct control_input_stats ci_stats;
+		struct stat_value value = {0};
+
+		control_input_stats_get(&ci_stats);
+		value.objs = ci_stats.ring_full;
+		shput(smap, "control_input.ring_full", value);
+		value.objs = ci_stats.no_mbufs;
+		shput(smap, "control_input.no_mbufs", value);
 	}
 
 	if (req->flags & GR_INFRA_STAT_F_HW) {
@@ -182,6 +227,13 @@ static struct api_out stats_reset(const void * /*request*/, void ** /*response*/
 
 	STAILQ_FOREACH (worker, &workers, next)
 		atomic_store(&worker->stats_reset, true);
+	dwell_reset();
+	drop_reset();
+	vrf_stats_reset();
+
+	iface = NULL;
+	while ((iface = iface_next(GR_IFACE_TYPE_UNDEF, iface)) != NULL)
+		iface_stats_reset(iface->id);
 
 	iface = NULL;
 	while ((iface = iface_next(GR_IFACE_TYPE_PORT, iface)) != NULL) {
@@ -195,10 +247,553 @@ static struct api_out stats_reset(const void * /*request*/, void ** /*response*/
 	return api_out(0, 0);
 }
 
+static struct api_out stats_hist_set(const void *request, void ** /*response*/) {
+	const struct gr_infra_stats_hist_set_req *req = request;
+	struct worker *worker;
+
+	STAILQ_FOREACH (worker, &workers, next)
+		atomic_store(&worker->stats_hist, req->enabled);
+
+	return api_out(0, 0);
+}
+
+static struct api_out stats_hist_get(const void *request, void **response) {
+	const struct gr_infra_stats_hist_get_req *req = request;
+	struct gr_infra_stats_hist_get_resp *resp = NULL;
+	struct gr_infra_node_hist *hists = NULL;
+	unsigned n_nodes, max_nodes;
+	struct worker *worker;
+	size_t len;
+	int ret;
+
+	max_nodes = rte_node_max_count();
+	if ((hists = calloc(max_nodes, sizeof(*hists))) == NULL)
+		return api_out(ENOMEM, 0);
+
+	// merge the histograms of all workers, indexed by node id
+	STAILQ_FOREACH (worker, &workers, next) {
+		const struct worker_stats *w_stats = atomic_load(&worker->stats);
+		if (w_stats == NULL)
+			continue;
+		for (unsigned i = 0; i < w_stats->n_stats; i++) {
+			const struct node_stats *s = &w_stats->stats[i];
+			struct gr_infra_node_hist *h = &hists[s->node_id];
+			for (unsigned b = 0; b < GR_INFRA_STATS_HIST_BUCKETS; b++) {
+				h->calls += s->objs_hist[b];
+				h->cycles[b] += s->cycles_hist[b];
+				h->objs[b] += s->objs_hist[b];
+			}
+		}
+	}
+
+	n_nodes = 0;
+	for (rte_node_t node = 0; node < max_nodes; node++) {
+		const char *name = rte_node_id_to_name(node);
+		if (name == NULL || hists[node].calls == 0)
+			continue;
+		switch (fnmatch(req->pattern, name, 0)) {
+		case 0:
+			memccpy(hists[node].name, name, 0, sizeof(hists[node].name) - 1);
+			hists[n_nodes++] = hists[node];
+		case FNM_NOMATCH:
+			continue;
+		default:
+			ret = errno;
+			goto err;
+		}
+	}
+
+	len = sizeof(*resp) + n_nodes * sizeof(*hists);
+	if ((resp = calloc(1, len)) == NULL) {
+		ret = ENOMEM;
+		goto err;
+	}
+	worker = STAILQ_FIRST(&workers);
+	resp->enabled = worker != NULL && atomic_load(&worker->stats_hist);
+	resp->n_nodes = n_nodes;
+	memcpy(resp->nodes, hists, n_nodes * sizeof(*hists));
+	free(hists);
+
+	*response = resp;
+	return api_out(0, len);
+err:
+	free(hists);
+	return api_out(ret, 0);
+}
+
+static struct api_out stats_dwell_set(const void *request, void ** /*response*/) {
+	const struct gr_infra_stats_dwell_set_req *req = request;
+
+	dwell_configure(req->enabled, req->sample_rate);
+
+	return api_out(0, 0);
+}
+
+static struct api_out stats_dwell_get(const void * /*request*/, void **response) {
+	struct gr_infra_stats_dwell_get_resp *resp;
+
+	if ((resp = calloc(1, sizeof(*resp))) == NULL)
+		return api_out(ENOMEM, 0);
+
+	resp->enabled = __atomic_load_n(&dwell_enabled, __ATOMIC_RELAXED);
+	resp->sample_rate = dwell_get_sample_rate();
+	resp->tsc_hz = rte_get_tsc_hz();
+	resp->samples = dwell_get(resp->cycles);
+	*response = resp;
+
+	return api_out(0, sizeof(*resp));
+}
+
+static struct api_out stats_drop_set(const void *request, void ** /*response*/) {
+	const struct gr_infra_stats_drop_set_req *req = request;
+
+	drop_configure(req->sample_rate);
+
+	return api_out(0, 0);
+}
+
+// Max number of counters in a single drop stats response.
+#define DROP_LIST_MAX                                                                              \
+	((GR_API_MAX_MSG_LEN - sizeof(struct gr_infra_stats_drop_get_resp))                        \
+	 / sizeof(struct gr_infra_stat_drop))
+
+static struct api_out stats_drop_get(const void *request, void **response) {
+	const struct gr_infra_stats_drop_get_req *req = request;
+	struct gr_infra_stats_drop_get_resp *resp = NULL;
+	struct gr_infra_stat_drop *drops = NULL, d;
+	unsigned n_indexes, index;
+	const struct iface *iface;
+	uint32_t next_cursor = 0;
+	const char *name;
+	uint16_t port_id;
+	size_t len;
+
+	n_indexes = drop_max_nodes() * DROP_N_PORTS;
+
+	for (index = req->cursor; index < n_indexes; index++) {
+		port_id = index % DROP_N_PORTS;
+		if ((d.packets = drop_get(index / DROP_N_PORTS, port_id)) == 0)
+			continue;
+		if ((name = rte_node_id_to_name(index / DROP_N_PORTS)) == NULL)
+			continue;
+		if (req->pattern[0] != '\0' && fnmatch(req->pattern, name, 0) != 0)
+			continue;
+
+		d.iface_id = GR_IFACE_ID_UNDEF;
+		if (port_id != DROP_PORT_NONE && (iface = port_get_iface(port_id)) != NULL)
+			d.iface_id = iface->id;
+		if (req->iface_id != GR_IFACE_ID_UNDEF && req->iface_id != d.iface_id)
+			continue;
+
+		if (arrlen(drops) >= DROP_LIST_MAX) {
+			next_cursor = index;
+			break;
+		}
+		memccpy(d.reason, name, 0, sizeof(d.reason));
+		d.reason[sizeof(d.reason) - 1] = '\0';
+		arrpush(drops, d);
+	}
+
+	len = sizeof(*resp) + arrlen(drops) * sizeof(*drops);
+	if ((resp = calloc(1, len)) == NULL) {
+		arrfree(drops);
+		return api_out(ENOMEM, 0);
+	}
+
+	resp->sample_rate = drop_get_sample_rate();
+	resp->next_cursor = next_cursor;
+	resp->n_drops = arrlen(drops);
+	if (drops != NULL)
+		memcpy(resp->drops, drops, arrlen(drops) * sizeof(*drops));
+	arrfree(drops);
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+static const uint8_t vrf_stats_families[VRF_STATS_AF_COUNT] = {
+	[VRF_STATS_IP4] = AF_INET,
+	[VRF_STATS_IP6] = AF_INET6,
+};
+
+static struct api_out stats_vrf_get(const void *request, void **response) {
+	const struct gr_infra_stats_vrf_get_req *req = request;
+	struct gr_infra_stats_vrf_get_resp *resp = NULL;
+	struct gr_infra_stat_vrf *vrfs = NULL;
+	struct vrf_counters c;
+	size_t len;
+
+	for (uint16_t vrf_id = 0; vrf_id < VRF_STATS_MAX_VRFS; vrf_id++) {
+		if (req->vrf_id != UINT16_MAX && req->vrf_id != vrf_id)
+			continue;
+		for (vrf_stats_af_t af = 0; af < VRF_STATS_AF_COUNT; af++) {
+			vrf_stats_get(af, vrf_id, &c);
+			if (c.packets == 0)
+				continue;
+			struct gr_infra_stat_vrf v = {
+				.vrf_id = vrf_id,
+				.family = vrf_stats_families[af],
+				.packets = c.packets,
+				.bytes = c.bytes,
+			};
+			arrpush(vrfs, v);
+		}
+	}
+
+	len = sizeof(*resp) + arrlen(vrfs) * sizeof(*vrfs);
+	if ((resp = calloc(1, len)) == NULL) {
+		arrfree(vrfs);
+		return api_out(ENOMEM, 0);
+	}
+
+	resp->n_vrfs = arrlen(vrfs);
+	if (vrfs != NULL)
+		memcpy(resp->vrfs, vrfs, arrlen(vrfs) * sizeof(*vrfs));
+	arrfree(vrfs);
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+static struct api_out stats_top_prefix_set(const void *request, void ** /*response*/) {
+	const struct gr_infra_stats_top_prefix_set_req *req = request;
+	uint8_t ip4_prefixlen = req->ip4_prefixlen;
+	uint8_t ip6_prefixlen = req->ip6_prefixlen;
+
+	if (ip4_prefixlen > 32 || ip6_prefixlen > 128)
+		return api_out(EINVAL, 0);
+	if (ip4_prefixlen == 0)
+		ip4_prefixlen = 24;
+	if (ip6_prefixlen == 0)
+		ip6_prefixlen = 48;
+
+	vrf_stats_top_configure(req->sample_rate, ip4_prefixlen, ip6_prefixlen);
+
+	return api_out(0, 0);
+}
+
+// Max number of prefixes in a single top prefixes response.
+#define TOP_PREFIX_LIST_MAX                                                                        \
+	((GR_API_MAX_MSG_LEN - sizeof(struct gr_infra_stats_top_prefix_get_resp))                  \
+	 / sizeof(struct gr_infra_stat_prefix))
+
+static struct api_out stats_top_prefix_get(const void *request, void **response) {
+	const struct gr_infra_stats_top_prefix_get_req *req = request;
+	struct gr_infra_stats_top_prefix_get_resp *resp = NULL;
+	struct vrf_stats_prefix *prefixes;
+	unsigned max = TOP_PREFIX_LIST_MAX;
+	size_t len;
+	int n;
+
+	if (req->max_prefixes != 0)
+		max = RTE_MIN(max, req->max_prefixes);
+	if ((prefixes = calloc(max, sizeof(*prefixes))) == NULL)
+		return api_out(ENOMEM, 0);
+	if ((n = vrf_stats_top_get(req->vrf_id, prefixes, max)) < 0) {
+		free(prefixes);
+		return api_out(errno, 0);
+	}
+
+	len = sizeof(*resp) + n * sizeof(*resp->prefixes);
+	if ((resp = calloc(1, len)) == NULL) {
+		free(prefixes);
+		return api_out(ENOMEM, 0);
+	}
+
+	vrf_stats_top_config(&resp->sample_rate, &resp->ip4_prefixlen, &resp->ip6_prefixlen);
+	resp->n_prefixes = n;
+	for (int i = 0; i < n; i++) {
+		struct gr_infra_stat_prefix *p = &resp->prefixes[i];
+		p->vrf_id = prefixes[i].vrf_id;
+		p->family = vrf_stats_families[prefixes[i].af];
+		p->prefixlen = prefixes[i].prefixlen;
+		if (prefixes[i].af == VRF_STATS_IP4)
+			memcpy(&p->ip4, prefixes[i].addr, sizeof(p->ip4));
+		else
+			memcpy(&p->ip6, prefixes[i].addr, sizeof(p->ip6));
+		p->packets = prefixes[i].packets;
+		p->error = prefixes[i].error;
+	}
+	free(prefixes);
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+struct schema_port {
+	uint16_t port_id;
+	uint16_t iface_id;
+	uint32_t first_id;
+	unsigned n_xstats;
+};
+
+// Binary stats schema and last known counter values, indexed by stat ID.
+// Node stats IDs are the graph node IDs, followed by idle and xstats.
+static struct {
+	bool dirty;
+	uint32_t schema_gen;
+	uint64_t gen;
+	unsigned n_nodes;
+	unsigned n_stats;
+	struct gr_infra_stat_desc *descs;
+	struct stat_value *values;
+	struct stat_value *current;
+	uint64_t *changed_gen;
+	uint64_t *xstats;
+	unsigned n_ports;
+	struct schema_port ports[RTE_MAX_ETHPORTS];
+} schema = {.dirty = true};
+
+static void schema_free(void) {
+	free(schema.descs);
+	free(schema.values);
+	free(schema.current);
+	free(schema.changed_gen);
+	free(schema.xstats);
+	schema.descs = NULL;
+	schema.values = NULL;
+	schema.current = NULL;
+	schema.changed_gen = NULL;
+	schema.xstats = NULL;
+	schema.n_stats = 0;
+	schema.n_ports = 0;
+}
+
+static int schema_build(void) {
+	struct rte_eth_xstat_name *names = NULL;
+	unsigned n_stats, max_xstats;
+	struct iface *iface = NULL;
+	int ret;
+
+	schema_free();
+	schema.dirty = true;
+
+	schema.n_nodes = rte_node_max_count();
+	n_stats = schema.n_nodes + 1; // idle
+	max_xstats = 0;
+
+	while ((iface = iface_next(GR_IFACE_TYPE_PORT, iface)) != NULL) {
+		struct iface_info_port *port = (struct iface_info_port *)iface->info;
+		struct schema_port *p;
+
+		if (schema.n_ports == ARRAY_DIM(schema.ports))
+			break;
+		if ((ret = rte_eth_xstats_get_names(port->port_id, NULL, 0)) < 0)
+			goto err;
+
+		p = &schema.ports[schema.n_ports++];
+		p->port_id = port->port_id;
+		p->iface_id = iface->id;
+		p->first_id = n_stats;
+		p->n_xstats = ret;
+		n_stats += ret;
+		max_xstats = RTE_MAX(max_xstats, (unsigned)ret);
+	}
+
+	schema.descs = calloc(n_stats, sizeof(*schema.descs));
+	schema.values = calloc(n_stats, sizeof(*schema.values));
+	schema.current = calloc(n_stats, sizeof(*schema.current));
+	schema.changed_gen = calloc(n_stats, sizeof(*schema.changed_gen));
+	schema.xstats = calloc(max_xstats + 1, sizeof(*schema.xstats));
+	names = calloc(max_xstats + 1, sizeof(*names));
+	if (schema.descs == NULL || schema.values == NULL || schema.current == NULL
+	    || schema.changed_gen == NULL || schema.xstats == NULL || names == NULL) {
+		ret = -ENOMEM;
+		goto err;
+	}
+	schema.n_stats = n_stats;
+
+	for (unsigned i = 0; i < schema.n_stats; i++)
+		schema.descs[i].id = i;
+
+	for (rte_node_t node = 0; node < schema.n_nodes; node++) {
+		const char *name = rte_node_id_to_name(node);
+		if (name != NULL)
+			memccpy(schema.descs[node].name, name, 0, sizeof(schema.descs->name) - 1);
+	}
+	memccpy(schema.descs[schema.n_nodes].name, "idle", 0, sizeof(schema.descs->name) - 1);
+
+	for (unsigned p = 0; p < schema.n_ports; p++) {
+		const struct schema_port *port = &schema.ports[p];
+		const struct iface *iface = iface_from_id(port->iface_id);
+
+		ret = rte_eth_xstats_get_names(port->port_id, names, port->n_xstats);
+		if (ret < 0)
+			goto err;
+		if ((unsigned)ret != port->n_xstats) {
+			ret = -EAGAIN;
+			goto err;
+		}
+		for (unsigned i = 0; i < port->n_xstats; i++) {
+			struct gr_infra_stat_desc *d = &schema.descs[port->first_id + i];
+			d->iface_id = port->iface_id;
+			// prefix each xstat name with interface name
+			snprintf(d->name, sizeof(d->name), "%s.%s", iface->name, names[i].name);
+		}
+	}
+
+	free(names);
+	schema.schema_gen++;
+	schema.dirty = false;
+	return 0;
+err:
+	free(names);
+	schema_free();
+	return ret;
+}
+
+// Read all counters and record the ones that changed since the last refresh.
+static int schema_refresh(void) {
+	struct stat_value *cur = schema.current;
+	struct worker *worker;
+	bool changed = false;
+	int ret;
+
+	memset(cur, 0, schema.n_stats * sizeof(*cur));
+
+	STAILQ_FOREACH (worker, &workers, next) {
+		const struct worker_stats *w_stats = atomic_load(&worker->stats);
+		if (w_stats == NULL)
+			continue;
+		for (unsigned i = 0; i < w_stats->n_stats; i++) {
+			const struct node_stats *s = &w_stats->stats[i];
+			if (s->node_id >= schema.n_nodes)
+				continue;
+			cur[s->node_id].objs += s->objs;
+			cur[s->node_id].calls += s->calls;
+			cur[s->node_id].cycles += s->cycles;
+		}
+		cur[schema.n_nodes].calls += w_stats->n_sleeps;
+		cur[schema.n_nodes].cycles += w_stats->sleep_cycles;
+	}
+
+	for (unsigned p = 0; p < schema.n_ports; p++) {
+		const struct schema_port *port = &schema.ports[p];
+
+		// no names lookup, values are returned in the schema order
+		ret = rte_eth_xstats_get_by_id(port->port_id, NULL, schema.xstats, port->n_xstats);
+		if (ret < 0)
+			return ret;
+		if ((unsigned)ret != port->n_xstats) {
+			schema.dirty = true;
+			return -ESTALE;
+		}
+		for (unsigned i = 0; i < port->n_xstats; i++)
+			cur[port->first_id + i].objs = schema.xstats[i];
+	}
+
+	for (unsigned i = 0; i < schema.n_stats; i++) {
+		if (memcmp(&cur[i], &schema.values[i], sizeof(*cur)) == 0)
+			continue;
+		schema.values[i] = cur[i];
+		schema.changed_gen[i] = schema.gen + 1;
+		changed = true;
+	}
+	if (changed)
+		schema.gen++;
+
+	return 0;
+}
+
+#define STATS_SCHEMA_MAX                                                                           \
+	((GR_API_MAX_MSG_LEN - sizeof(struct gr_infra_stats_schema_resp))                          \
+	 / sizeof(struct gr_infra_stat_desc))
+
+static struct api_out stats_schema(const void *request, void **response) {
+	const struct gr_infra_stats_schema_req *req = request;
+	struct gr_infra_stats_schema_resp *resp;
+	uint32_t n = 0;
+	size_t len;
+	int ret;
+
+	if (schema.dirty && (ret = schema_build()) < 0)
+		return api_out(-ret, 0);
+
+	if (req->cursor < schema.n_stats)
+		n = RTE_MIN(schema.n_stats - req->cursor, STATS_SCHEMA_MAX);
+
+	len = sizeof(*resp) + n * sizeof(*resp->descs);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	resp->schema_gen = schema.schema_gen;
+	if (req->cursor + n < schema.n_stats)
+		resp->next_cursor = req->cursor + n;
+	resp->n_descs = n;
+	if (n > 0)
+		memcpy(resp->descs, &schema.descs[req->cursor], n * sizeof(*resp->descs));
+
+	*response = resp;
+	return api_out(0, len);
+}
+
+#define STATS_VALUES_MAX                                                                           \
+	((GR_API_MAX_MSG_LEN - sizeof(struct gr_infra_stats_values_resp))                          \
+	 / sizeof(struct gr_infra_stat_value))
+
+static struct api_out stats_values(const void *request, void **response) {
+	const struct gr_infra_stats_values_req *req = request;
+	struct gr_infra_stats_values_resp *resp;
+	uint32_t n, next, i;
+	size_t len;
+	int ret;
+
+	if (schema.dirty && (ret = schema_build()) < 0)
+		return api_out(-ret, 0);
+	if (req->schema_gen != schema.schema_gen)
+		return api_out(ESTALE, 0);
+	if (req->cursor == 0 && (ret = schema_refresh()) < 0)
+		return api_out(-ret, 0);
+
+	n = 0;
+	next = 0;
+	for (i = req->cursor; i < schema.n_stats; i++) {
+		if (req->since_gen != 0 && schema.changed_gen[i] <= req->since_gen)
+			continue;
+		if (n == STATS_VALUES_MAX) {
+			next = i;
+			break;
+		}
+		n++;
+	}
+
+	len = sizeof(*resp) + n * sizeof(*resp->values);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	resp->schema_gen = schema.schema_gen;
+	resp->next_cursor = next;
+	resp->gen = schema.gen;
+
+	for (i = req->cursor; i < schema.n_stats && resp->n_values < n; i++) {
+		struct gr_infra_stat_value *v;
+		if (req->since_gen != 0 && schema.changed_gen[i] <= req->since_gen)
+			continue;
+		v = &resp->values[resp->n_values++];
+		v->id = i;
+		v->objs = schema.values[i].objs;
+		v->calls = schema.values[i].calls;
+		v->cycles = schema.values[i].cycles;
+	}
+
+	*response = resp;
+	return api_out(0, len);
+}
+
+static void stats_iface_event(iface_event_t, struct iface *iface) {
+	if (iface->type_id == GR_IFACE_TYPE_PORT)
+		schema.dirty = true;
+}
+
+static void stats_fini(struct event_base *) {
+	schema_free();
+}
+
 static struct gr_api_handler stats_get_handler = {
 	.name = "stats get",
 	.request_type = GR_INFRA_STATS_GET,
 	.callback = stats_get,
+	.flags = GR_API_F_READ,
 };
 
 static struct gr_api_handler stats_reset_handler = {
@@ -207,7 +802,95 @@ static struct gr_api_handler stats_reset_handler = {
 	.callback = stats_reset,
 };
 
+static struct gr_api_handler stats_schema_handler = {
+	.name = "stats schema",
+	.request_type = GR_INFRA_STATS_SCHEMA,
+	.callback = stats_schema,
+};
+
+static struct gr_api_handler stats_values_handler = {
+	.name = "stats values",
+	.request_type = GR_INFRA_STATS_VALUES,
+	.callback = stats_values,
+};
+
+static struct gr_api_handler stats_hist_set_handler = {
+	.name = "stats histograms set",
+	.request_type = GR_INFRA_STATS_HIST_SET,
+	.callback = stats_hist_set,
+};
+
+static struct gr_api_handler stats_hist_get_handler = {
+	.name = "stats histograms get",
+	.request_type = GR_INFRA_STATS_HIST_GET,
+	.callback = stats_hist_get,
+};
+
+static struct gr_api_handler stats_dwell_set_handler = {
+	.name = "stats dwell set",
+	.request_type = GR_INFRA_STATS_DWELL_SET,
+	.callback = stats_dwell_set,
+};
+
+static struct gr_api_handler stats_dwell_get_handler = {
+	.name = "stats dwell get",
+	.request_type = GR_INFRA_STATS_DWELL_GET,
+	.callback = stats_dwell_get,
+};
+
+static struct gr_api_handler stats_drop_set_handler = {
+	.name = "stats drop set",
+	.request_type = GR_INFRA_STATS_DROP_SET,
+	.callback = stats_drop_set,
+};
+
+static struct gr_api_handler stats_drop_get_handler = {
+	.name = "stats drop get",
+	.request_type = GR_INFRA_STATS_DROP_GET,
+	.callback = stats_drop_get,
+};
+
+static struct gr_api_handler stats_vrf_get_handler = {
+	.name = "stats vrf get",
+	.request_type = GR_INFRA_STATS_VRF_GET,
+	.callback = stats_vrf_get,
+};
+
+static struct gr_api_handler stats_top_prefix_set_handler = {
+	.name = "stats top prefix set",
+	.request_type = GR_INFRA_STATS_TOP_PREFIX_SET,
+	.callback = stats_top_prefix_set,
+};
+
+static struct gr_api_handler stats_top_prefix_get_handler = {
+	.name = "stats top prefix get",
+	.request_type = GR_INFRA_STATS_TOP_PREFIX_GET,
+	.callback = stats_top_prefix_get,
+};
+
+static struct iface_event_handler stats_iface_event_handler = {
+	.callback = stats_iface_event,
+};
+
+static struct gr_module stats_module = {
+	.name = "stats",
+	.fini = stats_fini,
+};
+
 RTE_INIT(infra_stats_init) {
 	gr_register_api_handler(&stats_get_handler);
 	gr_register_api_handler(&stats_reset_handler);
+	gr_register_api_handler(&stats_schema_handler);
+	gr_register_api_handler(&stats_values_handler);
+	gr_register_api_handler(&stats_hist_set_handler);
+	gr_register_api_handler(&stats_hist_get_handler);
+	gr_register_api_handler(&stats_dwell_set_handler);
+	gr_register_api_handler(&stats_dwell_get_handler);
+	gr_register_api_handler(&stats_drop_set_handler);
+	gr_register_api_handler(&stats_drop_get_handler);
+	gr_register_api_handler(&stats_vrf_get_handler);
+	gr_register_api_handler(&stats_top_prefix_set_handler);
+	gr_register_api_handler(&stats_top_prefix_get_handler);
+	gr_register_module(&stats_module);
+	iface_event_register_handler(&stats_iface_event_handler);
 }
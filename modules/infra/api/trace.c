@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_infra.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_datapath.h>
+#include <gr_iface.h>
+#include <gr_log.h>
+
+#include <event2/event.h>
+#include <rte_cycles.h>
+#include <rte_malloc.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Records drained from the worker rings, waiting for a dump request.
+#define TRACE_BUFFER_SIZE 4096
+#define TRACE_DRAIN_BURST 256
+#define TRACE_DRAIN_PERIOD_US 100000
+
+static struct trace_record *buffer;
+static unsigned buffer_head; // oldest record
+static unsigned buffer_count;
+static uint64_t buffer_lost;
+static uint64_t ring_full_reported;
+// started with --trace-packets: log records instead of buffering them
+static bool trace_log;
+static struct event *drain_ev;
+
+static void trace_log_record(const struct trace_record *r) {
+	char buf[BUFSIZ];
+	trace_format(r, buf, sizeof(buf));
+	LOG(NOTICE, "%s", buf);
+}
+
+static void trace_buffer_push(const struct trace_record *r) {
+	if (buffer_count == TRACE_BUFFER_SIZE) {
+		// overwrite the oldest record
+		buffer_head = (buffer_head + 1) % TRACE_BUFFER_SIZE;
+		buffer_count--;
+		buffer_lost++;
+	}
+	buffer[(buffer_head + buffer_count) % TRACE_BUFFER_SIZE] = *r;
+	buffer_count++;
+}
+
+static void trace_drain_cb(evutil_socket_t, short, void *) {
+	struct trace_record records[TRACE_DRAIN_BURST];
+	unsigned n;
+
+	while ((n = trace_dequeue(records, ARRAY_DIM(records))) > 0) {
+		for (unsigned i = 0; i < n; i++) {
+			if (trace_log)
+				trace_log_record(&records[i]);
+			else
+				trace_buffer_push(&records[i]);
+		}
+	}
+}
+
+static void trace_format_time(const struct trace_record *r, char *buf, size_t len) {
+	uint64_t hz = rte_get_tsc_hz();
+	uint64_t age = rte_rdtsc() - r->timestamp;
+	struct timespec ts;
+	struct tm tm;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec -= age / hz;
+	ts.tv_nsec -= (age % hz) * 1000000000 / hz;
+	if (ts.tv_nsec < 0) {
+		ts.tv_nsec += 1000000000;
+		ts.tv_sec--;
+	}
+	localtime_r(&ts.tv_sec, &tm);
+	snprintf(
+		buf,
+		len,
+		"%02d:%02d:%02d.%06ld",
+		tm.tm_hour,
+		tm.tm_min,
+		tm.tm_sec,
+		ts.tv_nsec / 1000
+	);
+}
+
+static struct api_out trace_set(const void *request, void ** /*response*/) {
+	const struct gr_infra_packet_trace_set_req *req = request;
+
+	if (req->iface_id != GR_IFACE_ID_UNDEF && iface_from_id(req->iface_id) == NULL)
+		return api_out(ENODEV, 0);
+
+	trace_configure(req->iface_id, req->sample_rate);
+	__atomic_store_n(&packet_trace_enabled, req->enabled, __ATOMIC_RELEASE);
+
+	return api_out(0, 0);
+}
+
+static struct api_out trace_dump(const void *request, void **response) {
+	const struct gr_infra_packet_trace_dump_req *req = request;
+	struct gr_infra_packet_trace_dump_resp *resp;
+	char line[BUFSIZ], time[32];
+	size_t buf_len = 0, len;
+	uint64_t ring_full;
+	FILE *stream;
+	unsigned n;
+	char *buf;
+
+	// pick up what the workers produced since the last drain
+	trace_drain_cb(-1, 0, NULL);
+
+	n = buffer_count;
+	if (req->max_packets != 0 && req->max_packets < n)
+		n = req->max_packets;
+
+	if ((stream = open_memstream(&buf, &buf_len)) == NULL)
+		return api_out(errno, 0);
+
+	for (unsigned i = 0; i < n; i++) {
+		const struct trace_record *r = &buffer[buffer_head];
+		trace_format_time(r, time, sizeof(time));
+		trace_format(r, line, sizeof(line));
+		fprintf(stream, "%s %s\n", time, line);
+		buffer_head = (buffer_head + 1) % TRACE_BUFFER_SIZE;
+		buffer_count--;
+	}
+	fflush(stream);
+
+	len = sizeof(*resp) + buf_len + 1;
+	if ((resp = calloc(1, len)) == NULL) {
+		fclose(stream);
+		free(buf);
+		return api_out(ENOMEM, 0);
+	}
+	ring_full = trace_ring_full();
+	resp->n_packets = n;
+	resp->lost = buffer_lost + ring_full - ring_full_reported;
+	buffer_lost = 0;
+	ring_full_reported = ring_full;
+	resp->len = buf_len + 1;
+	memccpy(resp->trace, buf, 0, buf_len + 1);
+
+	fclose(stream);
+	free(buf);
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+static void trace_init(struct event_base *ev_base) {
+	struct timeval tv = {.tv_usec = TRACE_DRAIN_PERIOD_US};
+
+	trace_log = packet_trace_enabled;
+	buffer = rte_calloc(__func__, TRACE_BUFFER_SIZE, sizeof(*buffer), 0);
+	if (buffer == NULL)
+		ABORT("rte_calloc(trace buffer) failed");
+
+	drain_ev = gr_event_new(ev_base, -1, EV_PERSIST | EV_FINALIZE, trace_drain_cb, NULL);
+	if (drain_ev == NULL || event_add(drain_ev, &tv) < 0)
+		ABORT("failed to add trace drain event");
+}
+
+static void trace_fini(struct event_base *) {
+	if (drain_ev != NULL) {
+		gr_event_free(drain_ev);
+		drain_ev = NULL;
+	}
+	rte_free(buffer);
+	buffer = NULL;
+}
+
+static struct gr_api_handler trace_set_handler = {
+	.name = "packet trace set",
+	.request_type = GR_INFRA_PACKET_TRACE_SET,
+	.callback = trace_set,
+};
+
+static struct gr_api_handler trace_dump_handler = {
+	.name = "packet trace dump",
+	.request_type = GR_INFRA_PACKET_TRACE_DUMP,
+	.callback = trace_dump,
+};
+
+static struct gr_module trace_module = {
+	.name = "packet trace",
+	.init = trace_init,
+	.fini = trace_fini,
+};
+
+RTE_INIT(trace_constructor) {
+	gr_register_api_handler(&trace_set_handler);
+	gr_register_api_handler(&trace_dump_handler);
+	gr_register_module(&trace_module);
+}
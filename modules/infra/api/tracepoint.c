@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_infra.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_tracepoint.h>
+
+#include <rte_trace.h>
+#include <rte_trace_point.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct api_out tracepoint_set(const void *request, void ** /*response*/) {
+	const struct gr_infra_tracepoint_set_req *req = request;
+	int ret;
+
+	if (memchr(req->pattern, '\0', sizeof(req->pattern)) == NULL)
+		return api_out(ENAMETOOLONG, 0);
+
+	// returns 1 if at least one tracepoint matched
+	ret = rte_trace_pattern(req->pattern, req->enabled);
+	if (ret < 0)
+		return api_out(-ret, 0);
+	if (ret == 0)
+		return api_out(ENOENT, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out tracepoint_list(const void * /*request*/, void **response) {
+	struct gr_infra_tracepoint_list_resp *resp;
+	struct gr_infra_tracepoint *t;
+	rte_trace_point_t *handle;
+	size_t len;
+
+	len = sizeof(*resp) + gr_tracepoint_count * sizeof(*t);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	for (unsigned i = 0; i < gr_tracepoint_count; i++) {
+		// not registered when DPDK is built without trace support
+		if ((handle = rte_trace_point_lookup(gr_tracepoint_names[i])) == NULL)
+			continue;
+		t = &resp->tracepoints[resp->n_tracepoints++];
+		memccpy(t->name, gr_tracepoint_names[i], 0, sizeof(t->name));
+		t->enabled = rte_trace_point_is_enabled(handle);
+	}
+	len = sizeof(*resp) + resp->n_tracepoints * sizeof(*t);
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+static struct api_out tracepoint_save(const void * /*request*/, void ** /*response*/) {
+	int ret = rte_trace_save();
+	if (ret < 0)
+		return api_out(-ret, 0);
+	return api_out(0, 0);
+}
+
+static struct gr_api_handler set_handler = {
+	.name = "tracepoint set",
+	.request_type = GR_INFRA_TRACEPOINT_SET,
+	.callback = tracepoint_set,
+};
+
+static struct gr_api_handler list_handler = {
+	.name = "tracepoint list",
+	.request_type = GR_INFRA_TRACEPOINT_LIST,
+	.callback = tracepoint_list,
+	.flags = GR_API_F_READ,
+};
+
+static struct gr_api_handler save_handler = {
+	.name = "tracepoint save",
+	.request_type = GR_INFRA_TRACEPOINT_SAVE,
+	.callback = tracepoint_save,
+};
+
+RTE_INIT(tracepoint_constructor) {
+	gr_register_api_handler(&set_handler);
+	gr_register_api_handler(&list_handler);
+	gr_register_api_handler(&save_handler);
+}
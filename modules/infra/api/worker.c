@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_infra.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_log.h>
+#include <gr_stb_ds.h>
+#include <gr_worker.h>
+
+#include <rte_cycles.h>
+#include <rte_graph.h>
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+
+static uint64_t cycles_to_ns(uint64_t cycles) {
+	return cycles * 1000000000 / rte_get_tsc_hz();
+}
+
+// Upper bound of the histogram bucket which contains the given percentile.
+static uint64_t walk_percentile(const struct worker_stats *stats, uint64_t walks, double pct) {
+	uint64_t target = walks * pct / 100.0, count = 0;
+
+	for (unsigned b = 0; b < GR_INFRA_STATS_HIST_BUCKETS; b++) {
+		count += stats->walk_hist[b];
+		if (count > target)
+			return cycles_to_ns(UINT64_C(1) << b);
+	}
+
+	return cycles_to_ns(stats->walk_max_cycles);
+}
+
+static struct api_out worker_list(const void * /*request*/, void **response) {
+	struct gr_infra_worker_list_resp *resp = NULL;
+	const struct worker_stats *stats;
+	struct gr_worker_info *info;
+	struct worker *worker;
+	uint16_t n_workers = 0;
+	uint64_t walks;
+	size_t len;
+
+	STAILQ_FOREACH (worker, &workers, next)
+		n_workers++;
+
+	len = sizeof(*resp) + n_workers * sizeof(*resp->workers);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	STAILQ_FOREACH (worker, &workers, next) {
+		info = &resp->workers[resp->n_workers++];
+		info->cpu_id = worker->cpu_id;
+		info->power = atomic_load(&worker->power);
+		info->active_power = atomic_load(&worker->active_power);
+		info->n_rxqs = arrlen(worker->rxqs);
+		stats = atomic_load(&worker->stats);
+		if (stats != NULL) {
+			info->total_cycles = stats->total_cycles;
+			info->busy_cycles = stats->busy_cycles;
+			info->sleep_cycles = stats->sleep_cycles;
+			info->n_sleeps = stats->n_sleeps;
+			walks = 0;
+			for (unsigned b = 0; b < GR_INFRA_STATS_HIST_BUCKETS; b++)
+				walks += stats->walk_hist[b];
+			if (walks > 0) {
+				info->walk_max_ns = cycles_to_ns(stats->walk_max_cycles);
+				info->walk_p50_ns = walk_percentile(stats, walks, 50);
+				info->walk_p99_ns = walk_percentile(stats, walks, 99);
+				info->walk_p999_ns = walk_percentile(stats, walks, 99.9);
+			}
+			info->n_stalls = stats->n_stalls;
+		}
+	}
+
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+static struct api_out worker_set(const void *request, void ** /*response*/) {
+	const struct gr_infra_worker_set_req *req = request;
+	struct worker *worker;
+
+	if (req->power > GR_WORKER_POWER_PAUSE)
+		return api_out(EINVAL, 0);
+
+	STAILQ_FOREACH (worker, &workers, next) {
+		if (worker->cpu_id == req->cpu_id)
+			break;
+	}
+	if (worker == NULL)
+		return api_out(ENOENT, 0);
+
+	if (atomic_exchange(&worker->power, req->power) != req->power) {
+		LOG(INFO, "[CPU %u] power policy %u", worker->cpu_id, req->power);
+		// reevaluate the policy if the worker is blocked
+		worker_wakeup(worker);
+	}
+
+	return api_out(0, 0);
+}
+
+static struct api_out worker_watchdog_set(const void *request, void ** /*response*/) {
+	const struct gr_infra_worker_watchdog_set_req *req = request;
+	struct worker *worker;
+
+	STAILQ_FOREACH (worker, &workers, next)
+		atomic_store(&worker->stall_threshold_us, req->threshold_us);
+
+	return api_out(0, 0);
+}
+
+static struct api_out worker_stall_list(const void * /*request*/, void **response) {
+	struct gr_infra_worker_stall_list_resp *resp = NULL;
+	const struct worker_stats *stats;
+	struct gr_worker_stall *stall;
+	struct worker *worker;
+	uint16_t n_stalls = 0;
+	uint64_t now;
+	size_t len;
+
+	STAILQ_FOREACH (worker, &workers, next) {
+		if ((stats = atomic_load(&worker->stats)) != NULL)
+			n_stalls += RTE_MIN(stats->n_stalls, ARRAY_DIM(stats->stalls));
+	}
+
+	len = sizeof(*resp) + n_stalls * sizeof(*resp->stalls);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	now = rte_rdtsc();
+	STAILQ_FOREACH (worker, &workers, next) {
+		if ((stats = atomic_load(&worker->stats)) == NULL)
+			continue;
+		if (resp->threshold_us == 0)
+			resp->threshold_us = atomic_load(&worker->stall_threshold_us);
+		for (unsigned i = 0; i < RTE_MIN(stats->n_stalls, ARRAY_DIM(stats->stalls)); i++) {
+			const struct worker_stall *s = &stats->stalls[i];
+			const char *name = rte_node_id_to_name(s->node_id);
+			if (resp->n_stalls == n_stalls)
+				break; // the worker logged more stalls in the meantime
+			stall = &resp->stalls[resp->n_stalls++];
+			stall->cpu_id = worker->cpu_id;
+			stall->age_us = (now - s->tsc) * 1000000 / rte_get_tsc_hz();
+			stall->duration_ns = cycles_to_ns(s->cycles);
+			if (name != NULL)
+				memccpy(stall->node, name, 0, sizeof(stall->node) - 1);
+			stall->node_ns = cycles_to_ns(s->node_cycles);
+		}
+	}
+
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+static struct gr_api_handler worker_list_handler = {
+	.name = "worker list",
+	.request_type = GR_INFRA_WORKER_LIST,
+	.callback = worker_list,
+	.flags = GR_API_F_READ,
+};
+static struct gr_api_handler worker_set_handler = {
+	.name = "worker set",
+	.request_type = GR_INFRA_WORKER_SET,
+	.callback = worker_set,
+	.flags = GR_API_F_CONFIG,
+};
+
+static struct gr_api_handler worker_watchdog_set_handler = {
+	.name = "worker watchdog set",
+	.request_type = GR_INFRA_WORKER_WATCHDOG_SET,
+	.callback = worker_watchdog_set,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler worker_stall_list_handler = {
+	.name = "worker stall list",
+	.request_type = GR_INFRA_WORKER_STALL_LIST,
+	.callback = worker_stall_list,
+	.flags = GR_API_F_READ,
+};
+
+RTE_INIT(worker_api_init) {
+	gr_register_api_handler(&worker_list_handler);
+	gr_register_api_handler(&worker_set_handler);
+	gr_register_api_handler(&worker_watchdog_set_handler);
+	gr_register_api_handler(&worker_stall_list_handler);
+}
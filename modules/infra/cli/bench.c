@@ -0,0 +1,334 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_cli_iface.h"
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_infra.h>
+#include <gr_net_types.h>
+#include <gr_table.h>
+
+#include <ecoli.h>
+#include <libsmartcols.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int parse_cpus(const char *arg, struct gr_infra_bench_start_req *req) {
+	char *buf, *tok, *end, *save = NULL;
+	unsigned long cpu;
+
+	if ((buf = strdup(arg)) == NULL)
+		return -ENOMEM;
+
+	req->n_cpus = 0;
+	for (tok = strtok_r(buf, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+		if (req->n_cpus == GR_BENCH_MAX_CPUS) {
+			free(buf);
+			errno = E2BIG;
+			return -errno;
+		}
+		cpu = strtoul(tok, &end, 10);
+		if (*end != '\0' || cpu > UINT16_MAX) {
+			free(buf);
+			errno = EINVAL;
+			return -errno;
+		}
+		req->cpu_ids[req->n_cpus++] = cpu;
+	}
+	free(buf);
+
+	return 0;
+}
+
+static int arg_ip4(const struct ec_pnode *p, const char *id, const char *def, ip4_addr_t *ip) {
+	const char *str = arg_str(p, id) ?: def;
+
+	if (inet_pton(AF_INET, str, ip) != 1) {
+		errno = EINVAL;
+		return -errno;
+	}
+
+	return 0;
+}
+
+static cmd_status_t bench_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_bench_start_req req = {
+		.sink_iface_id = GR_IFACE_ID_UNDEF,
+		.src_port = 1024,
+		.dst_port = 9,
+	};
+	struct gr_iface iface;
+
+	if (iface_from_name(c, arg_str(p, "IFACE"), &iface) < 0)
+		return CMD_ERROR;
+	req.iface_id = iface.id;
+	if (arg_str(p, "SINK") != NULL) {
+		if (iface_from_name(c, arg_str(p, "SINK"), &iface) < 0)
+			return CMD_ERROR;
+		req.sink_iface_id = iface.id;
+	}
+	if (arg_str(p, "CPUS") != NULL && parse_cpus(arg_str(p, "CPUS"), &req) < 0)
+		return CMD_ERROR;
+	if (arg_eth_addr(p, "MAC", &req.dst_mac) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_ip4(p, "SRC", "192.0.2.1", &req.src) < 0)
+		return CMD_ERROR;
+	if (arg_ip4(p, "DST", "198.51.100.1", &req.dst) < 0)
+		return CMD_ERROR;
+	if (arg_u16(p, "SPORT", &req.src_port) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u16(p, "DPORT", &req.dst_port) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u32(p, "FLOWS", &req.n_flows) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u16(p, "LEN", &req.pkt_len) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u16(p, "BURST", &req.burst) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u32(p, "DSTS", &req.n_dsts) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u16(p, "VLAN", &req.vlan_id) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u16(p, "VLANS", &req.n_vlans) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_str(p, "OUTER_SRC") != NULL || arg_str(p, "OUTER_DST") != NULL) {
+		if (arg_ip4(p, "OUTER_SRC", "", &req.outer_src) < 0)
+			return CMD_ERROR;
+		if (arg_ip4(p, "OUTER_DST", "", &req.outer_dst) < 0)
+			return CMD_ERROR;
+	}
+
+	// node statistics only reflect the benchmark traffic
+	if (gr_api_client_send_recv(c, GR_INFRA_STATS_RESET, 0, NULL, NULL) < 0)
+		return CMD_ERROR;
+	if (gr_api_client_send_recv(c, GR_INFRA_BENCH_START, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t bench_del(const struct gr_api_client *c, const struct ec_pnode *) {
+	if (gr_api_client_send_recv(c, GR_INFRA_BENCH_STOP, 0, NULL, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static int bench_order_cycles(const void *sa, const void *sb) {
+	const struct gr_infra_stat *a = sa;
+	const struct gr_infra_stat *b = sb;
+	if (a->cycles == b->cycles)
+		return 0;
+	return a->cycles > b->cycles ? -1 : 1;
+}
+
+static int bench_nodes_print(const struct gr_api_client *c, double secs) {
+	struct gr_infra_stats_get_req req = {.flags = GR_INFRA_STAT_F_SW};
+	const struct gr_infra_stats_get_resp *resp;
+	struct libscols_table *table;
+	void *resp_ptr = NULL;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_STATS_GET, sizeof(req), &req, &resp_ptr) < 0)
+		return -errno;
+
+	resp = resp_ptr;
+	qsort((void *)resp->stats, resp->n_stats, sizeof(*resp->stats), bench_order_cycles);
+
+	table = scols_new_table();
+	scols_table_new_column(table, "NODE", 0, 0);
+	scols_table_new_column(table, "MPPS", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "PKTS/CALL", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "CYCLES/PKT", 0, SCOLS_FL_RIGHT);
+	scols_table_set_column_separator(table, "  ");
+
+	for (uint16_t i = 0; i < resp->n_stats; i++) {
+		const struct gr_infra_stat *s = &resp->stats[i];
+		struct libscols_line *line;
+
+		if (s->objs == 0 || s->calls == 0)
+			continue;
+		line = scols_table_new_line(table, NULL);
+		scols_line_sprintf(line, 0, "%s", s->name);
+		scols_line_sprintf(line, 1, "%.3f", s->objs / secs / 1000000.0);
+		scols_line_sprintf(line, 2, "%.1f", (double)s->objs / s->calls);
+		scols_line_sprintf(line, 3, "%.1f", (double)s->cycles / s->objs);
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return 0;
+}
+
+static cmd_status_t bench_show(const struct gr_api_client *c, const struct ec_pnode *) {
+	const struct gr_infra_bench_get_resp *resp;
+	uint64_t packets = 0, sink_packets = 0;
+	struct libscols_table *table;
+	char src[INET_ADDRSTRLEN];
+	char dst[INET_ADDRSTRLEN];
+	struct gr_iface iface;
+	void *resp_ptr = NULL;
+	double secs;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_BENCH_GET, 0, NULL, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	if (!resp->active) {
+		printf("bench: inactive\n");
+		free(resp_ptr);
+		return CMD_SUCCESS;
+	}
+
+	if (iface_from_id(c, resp->params.iface_id, &iface) == 0)
+		printf("iface: %s\n", iface.name);
+	if (resp->params.sink_iface_id == GR_IFACE_ID_UNDEF)
+		printf("sink: none\n");
+	else if (iface_from_id(c, resp->params.sink_iface_id, &iface) == 0)
+		printf("sink: %s\n", iface.name);
+	inet_ntop(AF_INET, &resp->params.src, src, sizeof(src));
+	inet_ntop(AF_INET, &resp->params.dst, dst, sizeof(dst));
+	printf("packets: " ETH_ADDR_FMT " %s:%u -> %s:%u\n",
+	       ETH_ADDR_SPLIT(&resp->params.dst_mac),
+	       src,
+	       resp->params.src_port,
+	       dst,
+	       resp->params.dst_port);
+	printf("flows: %u\n", resp->params.n_flows);
+	printf("dsts: %u\n", resp->params.n_dsts);
+	if (resp->params.vlan_id != 0)
+		printf("vlans: %u-%u\n",
+		       resp->params.vlan_id,
+		       resp->params.vlan_id + resp->params.n_vlans - 1);
+	if (resp->params.outer_dst != 0) {
+		inet_ntop(AF_INET, &resp->params.outer_src, src, sizeof(src));
+		inet_ntop(AF_INET, &resp->params.outer_dst, dst, sizeof(dst));
+		printf("ipip: %s -> %s\n", src, dst);
+	}
+	printf("size: %u\n", resp->params.pkt_len);
+	printf("burst: %u\n", resp->params.burst);
+	secs = resp->duration_ns / 1e9;
+	printf("duration: %.1fs\n\n", secs);
+	if (secs == 0)
+		secs = 1;
+
+	table = scols_new_table();
+	scols_table_new_column(table, "CPU", 0, 0);
+	scols_table_new_column(table, "RX_MPPS", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "SINK_MPPS", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "SINK_GBPS", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "NO_MBUF", 0, SCOLS_FL_RIGHT);
+	scols_table_set_column_separator(table, "  ");
+
+	for (uint16_t i = 0; i < resp->n_workers; i++) {
+		const struct gr_bench_worker *w = &resp->workers[i];
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+
+		scols_line_sprintf(line, 0, "%u", w->cpu_id);
+		scols_line_sprintf(line, 1, "%.3f", w->packets / secs / 1000000.0);
+		scols_line_sprintf(line, 2, "%.3f", w->sink_packets / secs / 1000000.0);
+		scols_line_sprintf(line, 3, "%.3f", w->sink_bytes * 8 / secs / 1e9);
+		scols_line_sprintf(line, 4, "%" PRIu64, w->no_mbuf);
+		packets += w->packets;
+		sink_packets += w->sink_packets;
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+	printf("\ntotal: rx %.3f Mpps, sink %.3f Mpps\n\n",
+	       packets / secs / 1000000.0,
+	       sink_packets / secs / 1000000.0);
+	free(resp_ptr);
+
+	if (bench_nodes_print(c, secs) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_ADD),
+		"bench IFACE [(sink SINK),(cpus CPUS),(dst-mac MAC),(src SRC),(dst DST),"
+		"(sport SPORT),(dport DPORT),(flows FLOWS),(size LEN),(burst BURST),(dsts DSTS),"
+		"(vlan VLAN),(vlans VLANS),(outer-src OUTER_SRC),(outer-dst OUTER_DST)]",
+		bench_add,
+		"Inject synthetic UDP traffic in the graph as if received on a port.",
+		with_help(
+			"Port where packets are injected.",
+			ec_node_dyn("IFACE", complete_iface_names, INT2PTR(GR_IFACE_TYPE_PORT))
+		),
+		with_help(
+			"Count and free the packets sent to this port.",
+			ec_node_dyn("SINK", complete_iface_names, INT2PTR(GR_IFACE_TYPE_PORT))
+		),
+		with_help(
+			"Comma separated worker CPUs, all by default.",
+			ec_node_re("CPUS", "[0-9]+(,[0-9]+)*")
+		),
+		with_help(
+			"Destination MAC address, the port address by default.",
+			ec_node_re("MAC", ETH_ADDR_RE)
+		),
+		with_help("Source IPv4 address.", ec_node_re("SRC", IPV4_RE)),
+		with_help("Destination IPv4 address.", ec_node_re("DST", IPV4_RE)),
+		with_help(
+			"First UDP source port, incremented for each flow.",
+			ec_node_uint("SPORT", 0, UINT16_MAX, 10)
+		),
+		with_help("UDP destination port.", ec_node_uint("DPORT", 0, UINT16_MAX, 10)),
+		with_help("Number of flows.", ec_node_uint("FLOWS", 1, UINT16_MAX + 1, 10)),
+		with_help(
+			"Frame length without CRC.", ec_node_uint("LEN", 42, UINT16_MAX, 10)
+		),
+		with_help(
+			"Packets injected per graph walk.", ec_node_uint("BURST", 1, 256, 10)
+		),
+		with_help(
+			"Number of destination addresses, incremented from DST.",
+			ec_node_uint("DSTS", 1, UINT32_MAX, 10)
+		),
+		with_help("First 802.1Q tag.", ec_node_uint("VLAN", 1, 4094, 10)),
+		with_help(
+			"Number of VLAN IDs, incremented from VLAN.",
+			ec_node_uint("VLANS", 1, 4094, 10)
+		),
+		with_help("Outer IPIP source address.", ec_node_re("OUTER_SRC", IPV4_RE)),
+		with_help("Outer IPIP destination address.", ec_node_re("OUTER_DST", IPV4_RE))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_DEL), "bench", bench_del, "Stop synthetic traffic."
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW),
+		"bench",
+		bench_show,
+		"Display synthetic traffic rates and the cost of each graph node."
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "infra bench",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+}
@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_cli_iface.h"
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_infra.h>
+#include <gr_macro.h>
+#include <gr_net_types.h>
+
+#include <ecoli.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *bond_mode_names[] = {
+	[GR_BOND_MODE_BALANCE] = "balance",
+	[GR_BOND_MODE_LACP] = "lacp",
+};
+
+static const char *bond_mode_name(uint8_t mode) {
+	if (mode < ARRAY_DIM(bond_mode_names))
+		return bond_mode_names[mode];
+	return "?";
+}
+
+static void bond_show(const struct gr_api_client *c, const struct gr_iface *iface) {
+	const struct gr_iface_info_bond *bond = (const struct gr_iface_info_bond *)iface->info;
+	struct gr_iface member;
+
+	printf("mode: %s\n", bond_mode_name(bond->mode));
+	printf("mac: " ETH_ADDR_FMT "\n", ETH_ADDR_SPLIT(&bond->mac));
+	printf("members:");
+	for (uint8_t i = 0; i < bond->n_members; i++) {
+		if (iface_from_id(c, bond->member_ids[i], &member) < 0)
+			printf(" %u", bond->member_ids[i]);
+		else
+			printf(" %s", member.name);
+		if (!(bond->active_members & GR_BIT8(i)))
+			printf("(inactive)");
+	}
+	printf("\n");
+}
+
+static void
+bond_list_info(const struct gr_api_client *, const struct gr_iface *iface, char *buf, size_t len) {
+	const struct gr_iface_info_bond *bond = (const struct gr_iface_info_bond *)iface->info;
+	unsigned n_active = 0;
+
+	for (uint8_t i = 0; i < bond->n_members; i++) {
+		if (bond->active_members & GR_BIT8(i))
+			n_active++;
+	}
+	snprintf(
+		buf,
+		len,
+		"mode=%s mac=" ETH_ADDR_FMT " members=%u active=%u",
+		bond_mode_name(bond->mode),
+		ETH_ADDR_SPLIT(&bond->mac),
+		bond->n_members,
+		n_active
+	);
+}
+
+static struct cli_iface_type bond_type = {
+	.type_id = GR_IFACE_TYPE_BOND,
+	.name = "bond",
+	.show = bond_show,
+	.list_info = bond_list_info,
+};
+
+static uint64_t parse_bond_args(
+	const struct gr_api_client *c,
+	const struct ec_pnode *p,
+	struct gr_iface *iface,
+	bool update
+) {
+	uint64_t set_attrs = parse_iface_args(c, p, iface, update);
+	struct gr_iface_info_bond *bond;
+	const struct ec_pnode *n;
+	struct gr_iface member;
+	const char *mode;
+	uint8_t count;
+
+	bond = (struct gr_iface_info_bond *)iface->info;
+
+	mode = arg_str(p, "MODE");
+	if (mode != NULL) {
+		for (uint8_t i = 0; i < ARRAY_DIM(bond_mode_names); i++) {
+			if (strcmp(mode, bond_mode_names[i]) == 0)
+				bond->mode = i;
+		}
+		set_attrs |= GR_BOND_SET_MODE;
+	}
+
+	count = 0;
+	for (n = ec_pnode_find(p, "MEMBER"); n != NULL;
+	     n = ec_pnode_find_next(p, n, "MEMBER", false)) {
+		const struct ec_strvec *v = ec_pnode_get_strvec(n);
+		if (count == GR_BOND_MAX_MEMBERS) {
+			errno = ERANGE;
+			return 0;
+		}
+		if (iface_from_name(c, ec_strvec_val(v, 0), &member) < 0)
+			return 0;
+		if (member.type != GR_IFACE_TYPE_PORT) {
+			errno = EMEDIUMTYPE;
+			return 0;
+		}
+		bond->member_ids[count++] = member.id;
+	}
+	if (count > 0) {
+		bond->n_members = count;
+		set_attrs |= GR_BOND_SET_MEMBERS;
+	}
+
+	if (arg_eth_addr(p, "MAC", &bond->mac) == 0)
+		set_attrs |= GR_BOND_SET_MAC;
+
+	if (set_attrs == 0)
+		errno = EINVAL;
+	return set_attrs;
+}
+
+static cmd_status_t bond_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	const struct gr_infra_iface_add_resp *resp;
+	struct gr_infra_iface_add_req req = {
+		.iface = {.type = GR_IFACE_TYPE_BOND, .flags = GR_IFACE_F_UP}
+	};
+	void *resp_ptr = NULL;
+
+	if (parse_bond_args(c, p, &req.iface, false) == 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_ADD, sizeof(req), &req, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	printf("Created interface %u\n", resp->iface_id);
+	free(resp_ptr);
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t bond_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_iface_set_req req = {0};
+
+	if ((req.set_attrs = parse_bond_args(c, p, &req.iface, true)) == 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+#define BOND_ATTRS_CMD IFACE_ATTRS_CMD ",(mac MAC)"
+
+#define BOND_ATTRS_ARGS                                                                            \
+	IFACE_ATTRS_ARGS,                                                                          \
+		with_help("Link aggregation mode.", ec_node_re("MODE", "balance|lacp")),           \
+		with_help(                                                                         \
+			"Member port interface.",                                                  \
+			ec_node_dyn("MEMBER", complete_iface_names, INT2PTR(GR_IFACE_TYPE_PORT))   \
+		),                                                                                 \
+		with_help("Set the ethernet address.", ec_node_re("MAC", ETH_ADDR_RE))
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_ADD, CTX_ARG("interface", "Create interfaces.")),
+		"bond NAME mode MODE members MEMBER+ [" BOND_ATTRS_CMD "]",
+		bond_add,
+		"Create a new link aggregation interface.",
+		with_help("Interface name.", ec_node("any", "NAME")),
+		BOND_ATTRS_ARGS
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("interface", "Modify interfaces.")),
+		"bond NAME (name NEW_NAME),(mode MODE),(members MEMBER+)," BOND_ATTRS_CMD,
+		bond_set,
+		"Modify link aggregation parameters.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_BOND))
+		),
+		with_help("New interface name.", ec_node("any", "NEW_NAME")),
+		BOND_ATTRS_ARGS
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "infra bond",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+	register_iface_type(&bond_type);
+}
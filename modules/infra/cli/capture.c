@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_cli_iface.h"
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_infra.h>
+
+#include <ecoli.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int parse_nodes(const char *arg, struct gr_infra_capture_start_req *req) {
+	char *buf, *tok, *save = NULL;
+
+	if ((buf = strdup(arg)) == NULL)
+		return -ENOMEM;
+
+	req->n_nodes = 0;
+	for (tok = strtok_r(buf, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+		if (req->n_nodes == GR_CAPTURE_MAX_NODES) {
+			free(buf);
+			errno = E2BIG;
+			return -errno;
+		}
+		if (strlen(tok) >= sizeof(req->nodes[0])) {
+			free(buf);
+			errno = ENAMETOOLONG;
+			return -errno;
+		}
+		memccpy(req->nodes[req->n_nodes++], tok, 0, sizeof(req->nodes[0]));
+	}
+	free(buf);
+
+	return 0;
+}
+
+static cmd_status_t capture_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_capture_start_req req = {.iface_id = GR_IFACE_ID_UNDEF};
+	struct gr_iface iface;
+
+	if (parse_nodes(arg_str(p, "NODES"), &req) < 0)
+		return CMD_ERROR;
+	req.unix_socket = arg_str(p, "socket") != NULL;
+	if (strlen(arg_str(p, "PATH")) >= sizeof(req.path)) {
+		errno = ENAMETOOLONG;
+		return CMD_ERROR;
+	}
+	memccpy(req.path, arg_str(p, "PATH"), 0, sizeof(req.path));
+	if (arg_str(p, "NAME") != NULL) {
+		if (iface_from_name(c, arg_str(p, "NAME"), &iface) < 0)
+			return CMD_ERROR;
+		req.iface_id = iface.id;
+	}
+	if (arg_u32(p, "LEN", &req.snaplen) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_CAPTURE_START, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t capture_del(const struct gr_api_client *c, const struct ec_pnode *) {
+	if (gr_api_client_send_recv(c, GR_INFRA_CAPTURE_STOP, 0, NULL, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t capture_show(const struct gr_api_client *c, const struct ec_pnode *) {
+	const struct gr_infra_capture_get_resp *resp;
+	struct gr_iface iface;
+	void *resp_ptr = NULL;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_CAPTURE_GET, 0, NULL, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	if (!resp->active) {
+		printf("capture: inactive\n");
+		free(resp_ptr);
+		return CMD_SUCCESS;
+	}
+
+	printf("nodes:");
+	for (unsigned i = 0; i < resp->n_nodes; i++)
+		printf("%s%.*s", i ? "," : " ", GR_CAPTURE_NODE_SIZE, resp->nodes[i]);
+	printf("\n");
+	printf("output: %.*s\n", GR_CAPTURE_PATH_SIZE, resp->path);
+	if (resp->iface_id == GR_IFACE_ID_UNDEF)
+		printf("iface: all\n");
+	else if (iface_from_id(c, resp->iface_id, &iface) == 0)
+		printf("iface: %s\n", iface.name);
+	else
+		printf("iface: %u\n", resp->iface_id);
+	if (resp->snaplen == 0)
+		printf("snaplen: full\n");
+	else
+		printf("snaplen: %u\n", resp->snaplen);
+	printf("packets: %" PRIu64 "\n", resp->packets);
+	printf("written: %" PRIu64 "\n", resp->written);
+	printf("ring_full: %" PRIu64 "\n", resp->ring_full);
+	printf("no_mbuf: %" PRIu64 "\n", resp->no_mbuf);
+	printf("write_errors: %" PRIu64 "\n", resp->write_errors);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_ADD),
+		"capture NODES (file|socket) PATH [(iface NAME),(snaplen LEN)]",
+		capture_add,
+		"Capture the packets processed by graph nodes in pcapng format.",
+		with_help(
+			"Comma separated graph node names.",
+			ec_node_re("NODES", "[a-z0-9_]+(,[a-z0-9_]+)*")
+		),
+		with_help("Write to a file.", ec_node_str("file", "file")),
+		with_help("Connect to a listening UNIX socket.", ec_node_str("socket", "socket")),
+		with_help("Output path.", ec_node("file", "PATH")),
+		with_help(
+			"Only capture packets received on this port.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_PORT))
+		),
+		with_help(
+			"Maximum number of bytes captured per packet.",
+			ec_node_uint("LEN", 1, UINT16_MAX, 10)
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_DEL), "capture", capture_del, "Stop packet capture."
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW),
+		"capture",
+		capture_show,
+		"Display packet capture status and counters."
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "infra capture",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+}
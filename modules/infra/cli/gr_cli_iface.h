@@ -46,7 +46,8 @@ int complete_iface_names(
 
 #define INT2PTR(i) (void *)(uintptr_t)(i)
 
-#define IFACE_ATTRS_CMD "(up|down),(promisc PROMISC),(allmulti ALLMULTI),(mtu MTU),(vrf VRF)"
+#define IFACE_ATTRS_CMD                                                                            \
+	"(up|down),(promisc PROMISC),(allmulti ALLMULTI),(mtu MTU),(vrf VRF),(rpf RPF)"
 
 #define IFACE_ATTRS_ARGS                                                                           \
 	with_help("Set the interface UP.", ec_node_str("up", "up")),                               \
@@ -60,6 +61,10 @@ int complete_iface_names(
 		with_help(                                                                         \
 			"L3 addressing/routing domain ID.",                                        \
 			ec_node_uint("VRF", 0, UINT16_MAX - 1, 10)                                 \
+		),                                                                                 \
+		with_help(                                                                         \
+			"Unicast reverse path forwarding check.",                                  \
+			ec_node_re("RPF", "strict|loose|off")                                      \
 		)
 
 uint64_t parse_iface_args(
@@ -8,7 +8,11 @@
 
 #include <ecoli.h>
 
+#include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 static cmd_status_t graph_dump(const struct gr_api_client *c, const struct ec_pnode *) {
@@ -26,6 +30,129 @@ static cmd_status_t graph_dump(const struct gr_api_client *c, const struct ec_pn
 	return CMD_SUCCESS;
 }
 
+static cmd_status_t model_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_graph_model_set_req req = {
+		.model = strcmp(arg_str(p, "MODEL"), "dispatch") == 0 ? GR_GRAPH_MODEL_DISPATCH
+								   : GR_GRAPH_MODEL_RTC,
+	};
+
+	if (gr_api_client_send_recv(c, GR_INFRA_GRAPH_MODEL_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t affinity_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_graph_affinity_set_req req = {.affinity.cpu_id = UINT16_MAX};
+
+	if (arg_u16(p, "CPU", &req.affinity.cpu_id) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	snprintf(req.affinity.node, sizeof(req.affinity.node), "%s", arg_str(p, "NODE"));
+
+	if (gr_api_client_send_recv(c, GR_INFRA_GRAPH_AFFINITY_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t model_show(const struct gr_api_client *c, const struct ec_pnode *) {
+	const struct gr_infra_graph_model_get_resp *resp;
+	void *resp_ptr = NULL;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_GRAPH_MODEL_GET, 0, NULL, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	printf("model: %s\n", resp->model == GR_GRAPH_MODEL_DISPATCH ? "dispatch" : "rtc");
+	for (unsigned i = 0; i < resp->n_affinities; i++)
+		printf("%s: cpu %u\n", resp->affinities[i].node, resp->affinities[i].cpu_id);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t histogram_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_stats_hist_set_req req = {
+		.enabled = strcmp(arg_str(p, "ENABLED"), "on") == 0,
+	};
+
+	if (gr_api_client_send_recv(c, GR_INFRA_STATS_HIST_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+#define HIST_BAR_WIDTH 40
+
+static void histogram_print(const char *title, const uint64_t *buckets, uint64_t calls) {
+	unsigned first = GR_INFRA_STATS_HIST_BUCKETS, last = 0;
+	char range[32], bar[HIST_BAR_WIDTH + 1];
+	uint64_t lo, hi;
+	unsigned width;
+
+	for (unsigned b = 0; b < GR_INFRA_STATS_HIST_BUCKETS; b++) {
+		if (buckets[b] == 0)
+			continue;
+		if (first == GR_INFRA_STATS_HIST_BUCKETS)
+			first = b;
+		last = b;
+	}
+	printf("  %s:\n", title);
+	for (unsigned b = first; b <= last && first < GR_INFRA_STATS_HIST_BUCKETS; b++) {
+		if (b == 0) {
+			snprintf(range, sizeof(range), "0");
+		} else {
+			lo = UINT64_C(1) << (b - 1);
+			hi = (UINT64_C(1) << b) - 1;
+			if (b == GR_INFRA_STATS_HIST_BUCKETS - 1)
+				snprintf(range, sizeof(range), "%lu+", lo);
+			else if (lo == hi)
+				snprintf(range, sizeof(range), "%lu", lo);
+			else
+				snprintf(range, sizeof(range), "%lu-%lu", lo, hi);
+		}
+		width = (buckets[b] * HIST_BAR_WIDTH + calls - 1) / calls;
+		memset(bar, '#', width);
+		bar[width] = '\0';
+		printf(
+			"    %21s  %12lu  %5.1f%%  %s\n",
+			range,
+			buckets[b],
+			100.0 * buckets[b] / calls,
+			bar
+		);
+	}
+}
+
+static cmd_status_t histogram_show(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_stats_hist_get_req req;
+	const struct gr_infra_stats_hist_get_resp *resp;
+	void *resp_ptr = NULL;
+	const char *pattern;
+
+	pattern = arg_str(p, "PATTERN");
+	if (pattern == NULL)
+		pattern = "*";
+	snprintf(req.pattern, sizeof(req.pattern), "%s", pattern);
+
+	if (gr_api_client_send_recv(c, GR_INFRA_STATS_HIST_GET, sizeof(req), &req, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	if (!resp->enabled)
+		printf("histograms are disabled, enable with: set graph histogram on\n");
+
+	for (unsigned i = 0; i < resp->n_nodes; i++) {
+		const struct gr_infra_node_hist *h = &resp->nodes[i];
+		printf("%s: %lu calls\n", h->name, h->calls);
+		histogram_print("packets per call", h->objs, h->calls);
+		histogram_print("cycles per call", h->cycles, h->calls);
+	}
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
 static int ctx_init(struct ec_node *root) {
 	int ret;
 
@@ -35,6 +162,55 @@ static int ctx_init(struct ec_node *root) {
 		graph_dump,
 		"Dump the graph in DOT format."
 	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW, CTX_ARG("graph", "Show packet processing graph info.")),
+		"histogram [pattern PATTERN]",
+		histogram_show,
+		"Display per node histograms of packets and cycles per call.",
+		with_help("Filter nodes by glob pattern.", ec_node("any", "PATTERN"))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW, CTX_ARG("graph", "Show packet processing graph info.")),
+		"model",
+		model_show,
+		"Display the graph model and the node affinities."
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("graph", "Set packet processing graph.")),
+		"model MODEL",
+		model_set,
+		"Change the graph model of all workers.",
+		with_help(
+			"Run the whole graph on each worker (rtc) or hand over the packets "
+			"of pinned nodes to their worker (dispatch).",
+			ec_node_re("MODEL", "rtc|dispatch")
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("graph", "Set packet processing graph.")),
+		"affinity NODE [cpu CPU]",
+		affinity_set,
+		"Pin a node to a worker with the dispatch model, unpin it without a CPU.",
+		with_help("Graph node name.", ec_node("any", "NODE")),
+		with_help("Worker CPU ID.", ec_node_uint("CPU", 0, UINT16_MAX - 1, 10))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("graph", "Set packet processing graph.")),
+		"histogram ENABLED",
+		histogram_set,
+		"Enable or disable per node histograms.",
+		with_help("Histograms state.", ec_node_re("ENABLED", "on|off"))
+	);
 	if (ret < 0)
 		return ret;
 
@@ -6,6 +6,7 @@
 #include <gr_api.h>
 #include <gr_cli.h>
 #include <gr_infra.h>
+#include <gr_macro.h>
 #include <gr_net_types.h>
 #include <gr_string.h>
 #include <gr_table.h>
@@ -14,6 +15,10 @@
 #include <libsmartcols.h>
 
 #include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/queue.h>
 
 static STAILQ_HEAD(, cli_iface_type) types = STAILQ_HEAD_INITIALIZER(types);
@@ -66,6 +71,78 @@ const struct cli_iface_type *type_from_id(uint16_t type_id) {
 	return NULL;
 }
 
+// Interface names and types for completion. Only kept between calls in
+// interactive mode, until an interface event is received.
+struct iface_name {
+	uint16_t type;
+	char name[GR_IFACE_NAME_SIZE];
+};
+static struct iface_name *iface_names;
+static unsigned n_iface_names;
+static bool iface_names_cached;
+
+static void iface_names_flush(void) {
+	free(iface_names);
+	iface_names = NULL;
+	n_iface_names = 0;
+	iface_names_cached = false;
+}
+
+static const uint32_t iface_names_events[] = {
+	GR_INFRA_EVENT_IFACE_ADD,
+	GR_INFRA_EVENT_IFACE_DEL,
+	GR_INFRA_EVENT_IFACE_UPDATE,
+};
+
+static struct cli_cache iface_names_cache = {
+	.ev_types = iface_names_events,
+	.n_ev_types = ARRAY_DIM(iface_names_events),
+	.flush = iface_names_flush,
+};
+
+static int iface_names_fetch(const struct gr_api_client *c, uint16_t type) {
+	struct gr_infra_iface_list_req req = {.type = type};
+	const struct gr_infra_iface_list_resp *resp;
+	struct iface_name *names;
+	void *resp_ptr = NULL;
+
+	iface_names_flush();
+
+	do {
+		if (gr_api_client_send_recv(c, GR_INFRA_IFACE_LIST, sizeof(req), &req, &resp_ptr)
+		    < 0)
+			goto fail;
+
+		resp = resp_ptr;
+		if (resp->n_ifaces > 0) {
+			names = realloc(
+				iface_names, (n_iface_names + resp->n_ifaces) * sizeof(*names)
+			);
+			if (names == NULL)
+				goto fail;
+			iface_names = names;
+		}
+
+		for (uint16_t i = 0; i < resp->n_ifaces; i++) {
+			const struct gr_iface *iface = &resp->ifaces[i];
+			struct iface_name *n = &iface_names[n_iface_names++];
+			n->type = iface->type;
+			memccpy(n->name, iface->name, 0, sizeof(n->name));
+		}
+
+		req.cursor = resp->next_cursor;
+		free(resp_ptr);
+		resp_ptr = NULL;
+	} while (req.cursor != 0);
+
+	iface_names_cached = true;
+	return 0;
+fail:
+	free(resp_ptr);
+	iface_names_flush();
+	return -1;
+}
+
 int complete_iface_names(
 	const struct gr_api_client *c,
 	const struct ec_node *node,
@@ -73,27 +150,31 @@ int complete_iface_names(
 	const char *arg,
 	void *cb_arg
 ) {
-	struct gr_infra_iface_list_req req = {.type = (uintptr_t)cb_arg};
-	const struct gr_infra_iface_list_resp *resp;
-	void *resp_ptr = NULL;
-	int ret = -1;
-
-	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_LIST, sizeof(req), &req, &resp_ptr) < 0)
-		goto fail;
-
-	resp = resp_ptr;
+	uint16_t type = (uintptr_t)cb_arg;
+	bool cached = cli_cache_sync();
+	int ret = 0;
+
+	if (!cached || !iface_names_cached) {
+		// fetch all types when caching so that all completions can use the list
+		if (iface_names_fetch(c, cached ? GR_IFACE_TYPE_UNDEF : type) < 0)
+			return -1;
+	}
 
-	for (uint16_t i = 0; i < resp->n_ifaces; i++) {
-		const struct gr_iface *iface = &resp->ifaces[i];
-		if (!ec_str_startswith(iface->name, arg))
+	for (unsigned i = 0; i < n_iface_names; i++) {
+		const struct iface_name *n = &iface_names[i];
+		if (type != GR_IFACE_TYPE_UNDEF && n->type != type)
 			continue;
-		if (!ec_comp_add_item(comp, node, EC_COMP_FULL, arg, iface->name))
-			goto fail;
+		if (!ec_str_startswith(n->name, arg))
+			continue;
+		if (!ec_comp_add_item(comp, node, EC_COMP_FULL, arg, n->name)) {
+			ret = -1;
+			break;
+		}
 	}
 
-	ret = 0;
-fail:
-	free(resp_ptr);
+	if (!cached)
+		iface_names_flush();
+
 	return ret;
 }
 
@@ -108,18 +189,25 @@ int iface_from_name(const struct gr_api_client *c, const char *name, struct gr_i
 		goto out;
 	}
 
-	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_LIST, sizeof(req), &req, &resp_ptr) < 0)
-		goto out;
-
-	resp = resp_ptr;
-	for (uint16_t i = 0; i < resp->n_ifaces; i++) {
-		const struct gr_iface *iter = &resp->ifaces[i];
-		if (strcmp(iter->name, name) == 0) {
-			*iface = *iter;
-			ret = 0;
+	do {
+		if (gr_api_client_send_recv(c, GR_INFRA_IFACE_LIST, sizeof(req), &req, &resp_ptr)
+		    < 0)
 			goto out;
+
+		resp = resp_ptr;
+		for (uint16_t i = 0; i < resp->n_ifaces; i++) {
+			const struct gr_iface *iter = &resp->ifaces[i];
+			if (strcmp(iter->name, name) == 0) {
+				*iface = *iter;
+				ret = 0;
+				goto out;
+			}
 		}
-	}
+
+		req.cursor = resp->next_cursor;
+		free(resp_ptr);
+		resp_ptr = NULL;
+	} while (req.cursor != 0);
 
 	errno = ENODEV;
 out:
@@ -148,7 +236,7 @@ uint64_t parse_iface_args(
 	struct gr_iface *iface,
 	bool update
 ) {
-	const char *name, *promisc, *allmulti;
+	const char *name, *promisc, *allmulti, *rpf;
 	uint64_t set_attrs = 0;
 
 	name = arg_str(p, "NAME");
@@ -192,6 +280,16 @@ uint64_t parse_iface_args(
 		set_attrs |= GR_IFACE_SET_FLAGS;
 	}
 
+	rpf = arg_str(p, "RPF");
+	if (rpf != NULL) {
+		iface->flags &= ~GR_IFACE_F_RPF;
+		if (strcmp(rpf, "strict") == 0)
+			iface->flags |= GR_IFACE_F_RPF_STRICT;
+		else if (strcmp(rpf, "loose") == 0)
+			iface->flags |= GR_IFACE_F_RPF_LOOSE;
+		set_attrs |= GR_IFACE_SET_FLAGS;
+	}
+
 	if (arg_u16(p, "MTU", &iface->mtu) == 0)
 		set_attrs |= GR_IFACE_SET_MTU;
 
@@ -227,9 +325,11 @@ static int iface_order(const void *ia, const void *ib) {
 static cmd_status_t iface_list(const struct gr_api_client *c, const struct ec_pnode *p) {
 	struct libscols_table *table = scols_new_table();
 	struct gr_infra_iface_list_resp *resp;
-	struct gr_infra_iface_list_req req;
+	struct gr_infra_iface_list_req req = {0};
+	struct gr_iface *ifaces = NULL, *tmp;
 	const struct cli_iface_type *type;
 	void *resp_ptr = NULL;
+	size_t n_ifaces = 0;
 
 	if (table == NULL)
 		return CMD_ERROR;
@@ -240,14 +340,6 @@ static cmd_status_t iface_list(const struct gr_api_client *c, const struct ec_pn
 	else
 		req.type = type->type_id;
 
-	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_LIST, sizeof(req), &req, &resp_ptr) < 0) {
-		scols_unref_table(table);
-		return CMD_ERROR;
-	}
-
-	resp = resp_ptr;
-	qsort(resp->ifaces, resp->n_ifaces, sizeof(*resp->ifaces), iface_order);
-
 	scols_table_new_column(table, "NAME", 0, 0);
 	scols_table_new_column(table, "ID", 0, 0);
 	scols_table_new_column(table, "FLAGS", 0, 0);
@@ -256,8 +348,31 @@ static cmd_status_t iface_list(const struct gr_api_client *c, const struct ec_pn
 	scols_table_new_column(table, "INFO", 0, 0);
 	scols_table_set_column_separator(table, "  ");
 
-	for (size_t i = 0; i < resp->n_ifaces; i++) {
-		const struct gr_iface *iface = &resp->ifaces[i];
+	do {
+		if (gr_api_client_send_recv(c, GR_INFRA_IFACE_LIST, sizeof(req), &req, &resp_ptr)
+		    < 0)
+			goto err;
+
+		resp = resp_ptr;
+		if (resp->n_ifaces > 0) {
+			tmp = realloc(ifaces, (n_ifaces + resp->n_ifaces) * sizeof(*ifaces));
+			if (tmp == NULL)
+				goto err;
+			ifaces = tmp;
+			memcpy(&ifaces[n_ifaces], resp->ifaces, resp->n_ifaces * sizeof(*ifaces));
+			n_ifaces += resp->n_ifaces;
+		}
+
+		req.cursor = resp->next_cursor;
+		free(resp_ptr);
+		resp_ptr = NULL;
+	} while (req.cursor != 0);
+
+	// sort once all pages are received, the order must not depend on paging
+	qsort(ifaces, n_ifaces, sizeof(*ifaces), iface_order);
+
+	for (size_t i = 0; i < n_ifaces; i++) {
+		const struct gr_iface *iface = &ifaces[i];
 		const struct cli_iface_type *type = type_from_id(iface->type);
 		struct libscols_line *line = scols_table_new_line(table, NULL);
 		char buf[BUFSIZ];
@@ -280,6 +395,10 @@ static cmd_status_t iface_list(const struct gr_api_client *c, const struct ec_pn
 			n += snprintf(buf + n, sizeof(buf) - n, " promisc");
 		if (iface->flags & GR_IFACE_F_ALLMULTI)
 			n += snprintf(buf + n, sizeof(buf) - n, " allmulti");
+		if (iface->flags & GR_IFACE_F_RPF_STRICT)
+			n += snprintf(buf + n, sizeof(buf) - n, " rpf-strict");
+		else if (iface->flags & GR_IFACE_F_RPF_LOOSE)
+			n += snprintf(buf + n, sizeof(buf) - n, " rpf-loose");
 		scols_line_set_data(line, 2, buf);
 
 		// vrf
@@ -297,11 +416,63 @@ static cmd_status_t iface_list(const struct gr_api_client *c, const struct ec_pn
 			type->list_info(c, iface, buf, sizeof(buf));
 			scols_line_set_data(line, 5, buf);
 		}
+
+		gr_table_flush(table);
 	}
 
-	scols_print_table(table);
+	gr_table_print(table);
 	scols_unref_table(table);
+	free(ifaces);
 
+	return CMD_SUCCESS;
+err:
+	free(resp_ptr);
+	free(ifaces);
+	scols_unref_table(table);
+	return CMD_ERROR;
+}
+
+static cmd_status_t iface_stats(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_iface_stats_get_req req = {.iface_id = GR_IFACE_ID_UNDEF};
+	const struct gr_infra_iface_stats_get_resp *resp;
+	struct libscols_table *table;
+	void *resp_ptr = NULL;
+	struct gr_iface iface;
+
+	if (arg_str(p, "NAME") != NULL) {
+		if (iface_from_name(c, arg_str(p, "NAME"), &iface) < 0)
+			return CMD_ERROR;
+		req.iface_id = iface.id;
+	}
+
+	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_STATS_GET, sizeof(req), &req, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	table = scols_new_table();
+	scols_table_new_column(table, "NAME", 0, 0);
+	scols_table_new_column(table, "RX_PACKETS", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "RX_BYTES", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "TX_PACKETS", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "TX_BYTES", 0, SCOLS_FL_RIGHT);
+	scols_table_set_column_separator(table, "  ");
+
+	for (uint16_t i = 0; i < resp->n_stats; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_iface_stats *s = &resp->stats[i];
+
+		if (iface_from_id(c, s->iface_id, &iface) < 0)
+			scols_line_sprintf(line, 0, "%u", s->iface_id);
+		else
+			scols_line_set_data(line, 0, iface.name);
+		scols_line_sprintf(line, 1, "%lu", s->rx_packets);
+		scols_line_sprintf(line, 2, "%lu", s->rx_bytes);
+		scols_line_sprintf(line, 3, "%lu", s->tx_packets);
+		scols_line_sprintf(line, 4, "%lu", s->tx_bytes);
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
 	free(resp_ptr);
 
 	return CMD_SUCCESS;
@@ -332,6 +503,10 @@ static cmd_status_t iface_show(const struct gr_api_client *c, const struct ec_pn
 		printf(" promisc");
 	if (iface.flags & GR_IFACE_F_ALLMULTI)
 		printf(" allmulti");
+	if (iface.flags & GR_IFACE_F_RPF_STRICT)
+		printf(" rpf-strict");
+	else if (iface.flags & GR_IFACE_F_RPF_LOOSE)
+		printf(" rpf-loose");
 	printf("\n");
 	printf("vrf: %u\n", iface.vrf_id);
 	printf("mtu: %u\n", iface.mtu);
@@ -346,6 +521,177 @@ static cmd_status_t iface_show(const struct gr_api_client *c, const struct ec_pn
 	return CMD_SUCCESS;
 }
 
+static uint8_t policer_action(const char *action, uint8_t def) {
+	if (action == NULL)
+		return def;
+	if (strcmp(action, "pass") == 0)
+		return GR_POLICER_PASS;
+	if (strcmp(action, "drop") == 0)
+		return GR_POLICER_DROP;
+	return GR_POLICER_REMARK;
+}
+
+static cmd_status_t policer_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_policer_set_req req = {0};
+	struct gr_policer *pol = &req.policer;
+	const char *mode = arg_str(p, "MODE");
+	struct gr_iface iface;
+	uint64_t v;
+
+	if (iface_from_name(c, arg_str(p, "NAME"), &iface) < 0)
+		return CMD_ERROR;
+
+	req.iface_id = iface.id;
+	if (strcmp(mode, "srtcm") == 0)
+		pol->mode = GR_POLICER_SRTCM;
+	else if (strcmp(mode, "trtcm") == 0)
+		pol->mode = GR_POLICER_TRTCM;
+	else
+		pol->mode = GR_POLICER_DISABLED;
+
+	// rates are given in bit/s
+	if (arg_u64(p, "CIR", &v) == 0)
+		pol->cir = v / 8;
+	else if (errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u64(p, "PIR", &v) == 0)
+		pol->pir = v / 8;
+	else if (errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u64(p, "CBS", &pol->cbs) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u64(p, "EBS", &pol->ebs) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u64(p, "YELLOW_DSCP", &v) == 0)
+		pol->yellow_dscp = v;
+	else if (errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u64(p, "RED_DSCP", &v) == 0)
+		pol->red_dscp = v;
+	else if (errno != ENOENT)
+		return CMD_ERROR;
+	pol->yellow = policer_action(arg_str(p, "YELLOW"), GR_POLICER_PASS);
+	pol->red = policer_action(arg_str(p, "RED"), GR_POLICER_DROP);
+
+	if (gr_api_client_send_recv(c, GR_INFRA_POLICER_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t policer_show(const struct gr_api_client *c, const struct ec_pnode *p) {
+	static const char *const mode_names[] = {
+		[GR_POLICER_DISABLED] = "off",
+		[GR_POLICER_SRTCM] = "srtcm",
+		[GR_POLICER_TRTCM] = "trtcm",
+	};
+	static const char *const action_names[] = {
+		[GR_POLICER_PASS] = "pass",
+		[GR_POLICER_DROP] = "drop",
+		[GR_POLICER_REMARK] = "remark",
+	};
+	struct gr_infra_policer_get_req req;
+	const struct gr_policer *pol;
+	void *resp_ptr = NULL;
+	struct gr_iface iface;
+
+	if (iface_from_name(c, arg_str(p, "NAME"), &iface) < 0)
+		return CMD_ERROR;
+
+	req.iface_id = iface.id;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_POLICER_GET, sizeof(req), &req, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	pol = &((const struct gr_infra_policer_get_resp *)resp_ptr)->policer;
+
+	printf("mode: %s\n", pol->mode < ARRAY_DIM(mode_names) ? mode_names[pol->mode] : "?");
+	if (pol->mode != GR_POLICER_DISABLED) {
+		printf("cir: %" PRIu64 " bit/s\n", pol->cir * 8);
+		if (pol->mode == GR_POLICER_TRTCM)
+			printf("pir: %" PRIu64 " bit/s\n", pol->pir * 8);
+		printf("cbs: %" PRIu64 " bytes\n", pol->cbs);
+		printf("%s: %" PRIu64 " bytes\n",
+		       pol->mode == GR_POLICER_TRTCM ? "pbs" : "ebs",
+		       pol->ebs);
+		printf("yellow: %s", action_names[pol->yellow]);
+		if (pol->yellow == GR_POLICER_REMARK)
+			printf(" dscp %u", pol->yellow_dscp);
+		printf("\n");
+		printf("red: %s", action_names[pol->red]);
+		if (pol->red == GR_POLICER_REMARK)
+			printf(" dscp %u", pol->red_dscp);
+		printf("\n");
+		printf("green_packets: %" PRIu64 "\n", pol->n_green);
+		printf("yellow_packets: %" PRIu64 "\n", pol->n_yellow);
+		printf("red_packets: %" PRIu64 "\n", pol->n_red);
+	}
+
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t punt_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_punt_set_req req = {0};
+	const char *netdev = arg_str(p, "NETDEV");
+	struct gr_iface iface;
+
+	if (iface_from_name(c, arg_str(p, "NAME"), &iface) < 0)
+		return CMD_ERROR;
+	req.iface_id = iface.id;
+
+	if (netdev != NULL) {
+		if (strlen(netdev) >= sizeof(req.punt.ifname)) {
+			errno = ENAMETOOLONG;
+			return CMD_ERROR;
+		}
+		memccpy(req.punt.ifname, netdev, 0, sizeof(req.punt.ifname));
+		if (arg_u32(p, "RATE", &req.punt.rate) < 0 && errno != ENOENT)
+			return CMD_ERROR;
+	}
+
+	if (gr_api_client_send_recv(c, GR_INFRA_PUNT_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t punt_show(const struct gr_api_client *c, const struct ec_pnode *p) {
+	const struct gr_iface_punt *punt;
+	struct gr_infra_punt_get_req req;
+	void *resp_ptr = NULL;
+	struct gr_iface iface;
+
+	if (iface_from_name(c, arg_str(p, "NAME"), &iface) < 0)
+		return CMD_ERROR;
+
+	req.iface_id = iface.id;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_PUNT_GET, sizeof(req), &req, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	punt = &((const struct gr_infra_punt_get_resp *)resp_ptr)->punt;
+
+	if (punt->ifname[0] == '\0') {
+		printf("netdev: none\n");
+	} else {
+		printf("netdev: %s\n", punt->ifname);
+		if (punt->rate != 0)
+			printf("rate: %u pkt/s\n", punt->rate);
+		else
+			printf("rate: unlimited\n");
+		printf("punted: %" PRIu64 "\n", punt->punted);
+		printf("injected: %" PRIu64 "\n", punt->injected);
+		printf("dropped: %" PRIu64 "\n", punt->dropped);
+		printf("coalesced: %" PRIu64 "\n", punt->coalesced);
+	}
+
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
 static int ctx_init(struct ec_node *root) {
 	int ret;
 
@@ -376,10 +722,147 @@ static int ctx_init(struct ec_node *root) {
 			ec_node_dyn("TYPE", complete_iface_types, NULL)
 		)
 	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW, CTX_ARG("interface", "Display interface details.")),
+		"stats [name NAME]",
+		iface_stats,
+		"Show interface software traffic counters.",
+		with_help(
+			"Show only this interface.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_UNDEF))
+		)
+	);
+	if (ret < 0)
+		return ret;
+
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("interface", "Modify interfaces.")),
+		"policer NAME MODE [(cir CIR),(pir PIR),(cbs CBS),(ebs EBS),(yellow YELLOW),"
+		"(yellow-dscp YELLOW_DSCP),(red RED),(red-dscp RED_DSCP)]",
+		policer_set,
+		"Set the ingress policer of an interface.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_UNDEF))
+		),
+		with_help(
+			"Single or two rate three color marker, off to disable.",
+			ec_node_re("MODE", "off|srtcm|trtcm")
+		),
+		with_help("Committed rate in bit/s.", ec_node_uint("CIR", 8, UINT64_MAX, 10)),
+		with_help("Peak rate in bit/s (trtcm).", ec_node_uint("PIR", 8, UINT64_MAX, 10)),
+		with_help("Committed burst in bytes.", ec_node_uint("CBS", 0, UINT64_MAX, 10)),
+		with_help(
+			"Excess (srtcm) or peak (trtcm) burst in bytes.",
+			ec_node_uint("EBS", 0, UINT64_MAX, 10)
+		),
+		with_help(
+			"Action on yellow packets (default pass).",
+			ec_node_re("YELLOW", "pass|drop|remark")
+		),
+		with_help(
+			"DSCP of remarked yellow packets.",
+			ec_node_uint("YELLOW_DSCP", 0, 63, 10)
+		),
+		with_help(
+			"Action on red packets (default drop).",
+			ec_node_re("RED", "pass|drop|remark")
+		),
+		with_help("DSCP of remarked red packets.", ec_node_uint("RED_DSCP", 0, 63, 10))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW, CTX_ARG("interface", "Display interface details.")),
+		"policer NAME",
+		policer_show,
+		"Show the ingress policer of an interface.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_UNDEF))
+		)
+	);
+	if (ret < 0)
+		return ret;
+
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("interface", "Modify interfaces.")),
+		"punt NAME netdev NETDEV [rate RATE]",
+		punt_set,
+		"Send unhandled local traffic to a kernel device and route what it sends.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_UNDEF))
+		),
+		with_help("Kernel network device name.", ec_node("any", "NETDEV")),
+		with_help(
+			"Max punted packets per second (default unlimited).",
+			ec_node_uint("RATE", 0, UINT32_MAX, 10)
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("interface", "Modify interfaces.")),
+		"punt NAME off",
+		punt_set,
+		"Remove the exception path of an interface.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_UNDEF))
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW, CTX_ARG("interface", "Display interface details.")),
+		"punt NAME",
+		punt_show,
+		"Show the exception path of an interface.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_UNDEF))
+		)
+	);
+	if (ret < 0)
+		return ret;
 
 	return 0;
 }
 
+static void iface_event_print(const struct gr_api_client *, const void *obj) {
+	const struct cli_iface_type *type;
+	const struct gr_iface *iface = obj;
+
+	type = type_from_id(iface->type);
+	printf("%s id=%u type=%s vrf=%u mtu=%u %s%s",
+	       iface->name,
+	       iface->id,
+	       type != NULL ? type->name : "?",
+	       iface->vrf_id,
+	       iface->mtu,
+	       iface->flags & GR_IFACE_F_UP ? "up" : "down",
+	       iface->state & GR_IFACE_S_RUNNING ? " running" : "");
+}
+
+static struct cli_event_type iface_add_event = {
+	.ev_type = GR_INFRA_EVENT_IFACE_ADD,
+	.name = "iface add",
+	.print = iface_event_print,
+};
+static struct cli_event_type iface_del_event = {
+	.ev_type = GR_INFRA_EVENT_IFACE_DEL,
+	.name = "iface del",
+	.print = iface_event_print,
+};
+static struct cli_event_type iface_update_event = {
+	.ev_type = GR_INFRA_EVENT_IFACE_UPDATE,
+	.name = "iface update",
+	.print = iface_event_print,
+};
+
 static struct gr_cli_context ctx = {
 	.name = "infra iface",
 	.init = ctx_init,
@@ -387,4 +870,8 @@ static struct gr_cli_context ctx = {
 
 static void __attribute__((constructor, used)) init(void) {
 	register_context(&ctx);
+	register_event_type(&iface_add_event);
+	register_event_type(&iface_del_event);
+	register_event_type(&iface_update_event);
+	register_cache(&iface_names_cache);
 }
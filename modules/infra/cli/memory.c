@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_infra.h>
+#include <gr_table.h>
+
+#include <ecoli.h>
+#include <libsmartcols.h>
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void set_bytes(struct libscols_line *line, int col, uint64_t bytes) {
+	static const char *const units[] = {"B", "K", "M", "G", "T"};
+	double value = bytes;
+	unsigned u = 0;
+
+	while (value >= 1024 && u < ARRAY_DIM(units) - 1) {
+		value /= 1024;
+		u++;
+	}
+	if (u == 0)
+		scols_line_sprintf(line, col, "%" PRIu64 "B", bytes);
+	else
+		scols_line_sprintf(line, col, "%.1f%s", value, units[u]);
+}
+
+static cmd_status_t memory_show(const struct gr_api_client *c, const struct ec_pnode *) {
+	struct libscols_table *heaps = scols_new_table();
+	struct libscols_table *subs = scols_new_table();
+	const struct gr_infra_memory_get_resp *resp;
+	struct libscols_line *line;
+	void *resp_ptr = NULL;
+
+	if (heaps == NULL || subs == NULL)
+		goto err;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_MEMORY_GET, 0, NULL, &resp_ptr) < 0)
+		goto err;
+
+	resp = resp_ptr;
+
+	scols_table_new_column(heaps, "SOCKET", 0, 0);
+	scols_table_new_column(heaps, "HEAP", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(heaps, "USED", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(heaps, "MAX", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(heaps, "FREE", 0, SCOLS_FL_RIGHT);
+	scols_table_set_column_separator(heaps, "  ");
+
+	scols_table_new_column(subs, "SUBSYSTEM", 0, 0);
+	scols_table_new_column(subs, "SOCKET", 0, 0);
+	scols_table_new_column(subs, "USED", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(subs, "MAX", 0, SCOLS_FL_RIGHT);
+	scols_table_set_column_separator(subs, "  ");
+
+	for (unsigned i = 0; i < resp->n_usages; i++) {
+		const struct gr_mem_usage *u = &resp->usages[i];
+
+		if (strcmp(u->subsystem, GR_MEM_HEAP) == 0) {
+			line = scols_table_new_line(heaps, NULL);
+			scols_line_sprintf(line, 0, "%d", u->socket_id);
+			set_bytes(line, 1, u->total);
+			set_bytes(line, 2, u->used);
+			set_bytes(line, 3, u->used_max);
+			set_bytes(line, 4, u->total > u->used ? u->total - u->used : 0);
+		} else {
+			line = scols_table_new_line(subs, NULL);
+			scols_line_sprintf(line, 0, "%s", u->subsystem);
+			scols_line_sprintf(line, 1, "%d", u->socket_id);
+			set_bytes(line, 2, u->used);
+			set_bytes(line, 3, u->used_max);
+		}
+	}
+
+	gr_table_print(heaps);
+	printf("\n");
+	gr_table_print(subs);
+	scols_unref_table(heaps);
+	scols_unref_table(subs);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+err:
+	scols_unref_table(heaps);
+	scols_unref_table(subs);
+	return CMD_ERROR;
+}
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW),
+		"memory",
+		memory_show,
+		"Display hugepage memory usage per subsystem and NUMA socket."
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "infra memory",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+}
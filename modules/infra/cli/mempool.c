@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_infra.h>
+#include <gr_table.h>
+
+#include <ecoli.h>
+#include <libsmartcols.h>
+
+#include <stdlib.h>
+
+static cmd_status_t mempool_list(const struct gr_api_client *c, const struct ec_pnode *) {
+	struct libscols_table *table = scols_new_table();
+	struct gr_infra_mempool_list_resp *resp;
+	void *resp_ptr = NULL;
+
+	if (table == NULL)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_MEMPOOL_LIST, 0, NULL, &resp_ptr) < 0) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+
+	resp = resp_ptr;
+
+	scols_table_new_column(table, "NAME", 0, 0);
+	scols_table_new_column(table, "SOCKET", 0, 0);
+	scols_table_new_column(table, "DATA_ROOM", 0, 0);
+	scols_table_new_column(table, "SIZE", 0, 0);
+	scols_table_new_column(table, "RESERVED", 0, 0);
+	scols_table_new_column(table, "IN_USE", 0, 0);
+	scols_table_new_column(table, "AVAIL", 0, 0);
+	scols_table_new_column(table, "CACHE_SIZE", 0, 0);
+	scols_table_new_column(table, "CACHED", 0, 0);
+	scols_table_set_column_separator(table, "  ");
+
+	for (size_t i = 0; i < resp->n_mempools; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_mempool_info *m = &resp->mempools[i];
+
+		scols_line_sprintf(line, 0, "%s", m->name);
+		if (m->socket_id < 0)
+			scols_line_set_data(line, 1, "any");
+		else
+			scols_line_sprintf(line, 1, "%d", m->socket_id);
+		if (m->data_room != 0)
+			scols_line_sprintf(line, 2, "%u", m->data_room);
+		else
+			scols_line_set_data(line, 2, "-");
+		scols_line_sprintf(line, 3, "%u", m->size);
+		scols_line_sprintf(line, 4, "%u", m->reserved);
+		scols_line_sprintf(line, 5, "%u", m->in_use);
+		scols_line_sprintf(line, 6, "%u", m->avail);
+		scols_line_sprintf(line, 7, "%u", m->cache_size);
+		scols_line_sprintf(line, 8, "%u", m->cached);
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW),
+		"mempool",
+		mempool_list,
+		"Display mempools occupancy."
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "infra mempool",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+}
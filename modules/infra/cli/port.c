@@ -14,8 +14,24 @@
 #include <rte_ether.h>
 
 #include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/queue.h>
 
+static const char *tx_policy_names[] = {
+	[GR_PORT_TX_DROP] = "drop",
+	[GR_PORT_TX_RETRY] = "retry",
+	[GR_PORT_TX_QUEUE] = "queue",
+};
+
+static const char *tx_policy_name(uint8_t policy) {
+	if (policy < ARRAY_DIM(tx_policy_names))
+		return tx_policy_names[policy];
+	return "?";
+}
+
 static void port_show(const struct gr_api_client *, const struct gr_iface *iface) {
 	const struct gr_iface_info_port *port = (const struct gr_iface_info_port *)iface->info;
 
@@ -26,6 +42,15 @@ static void port_show(const struct gr_api_client *, const struct gr_iface *iface
 	printf("n_txq: %u\n", port->n_txq);
 	printf("rxq_size: %u\n", port->rxq_size);
 	printf("txq_size: %u\n", port->txq_size);
+	printf("tx_policy: %s\n", tx_policy_name(port->tx_policy));
+	if (port->tx_policy != GR_PORT_TX_DROP)
+		printf("tx_limit: %u\n", port->tx_limit);
+	printf("ctrl_rxq: %s\n", port->ctrl_rxq ? "on" : "off");
+	printf("tx_fast_free: %s\n", port->tx_fast_free ? "on" : "off");
+	if (port->tx_free_thresh != 0)
+		printf("tx_free_thresh: %u\n", port->tx_free_thresh);
+	if (port->tx_rs_thresh != 0)
+		printf("tx_rs_thresh: %u\n", port->tx_rs_thresh);
 }
 
 static void
@@ -73,6 +98,31 @@ static uint64_t parse_port_args(
 		set_attrs |= GR_PORT_SET_Q_SIZE;
 	}
 
+	if (arg_str(p, "TX_POLICY") != NULL) {
+		const char *policy = arg_str(p, "TX_POLICY");
+		for (uint8_t i = 0; i < ARRAY_DIM(tx_policy_names); i++) {
+			if (strcmp(policy, tx_policy_names[i]) == 0)
+				port->tx_policy = i;
+		}
+		if (arg_u16(p, "TX_LIMIT", &port->tx_limit) < 0 && errno != ENOENT)
+			goto err;
+		set_attrs |= GR_PORT_SET_TX_POLICY;
+	}
+
+	if (arg_str(p, "CTRL_RXQ") != NULL) {
+		port->ctrl_rxq = strcmp(arg_str(p, "CTRL_RXQ"), "on") == 0;
+		set_attrs |= GR_PORT_SET_CTRL_RXQ;
+	}
+
+	if (arg_str(p, "FAST_FREE") != NULL) {
+		port->tx_fast_free = strcmp(arg_str(p, "FAST_FREE"), "on") == 0;
+		if (arg_u16(p, "TX_FREE_THRESH", &port->tx_free_thresh) < 0 && errno != ENOENT)
+			goto err;
+		if (arg_u16(p, "TX_RS_THRESH", &port->tx_rs_thresh) < 0 && errno != ENOENT)
+			goto err;
+		set_attrs |= GR_PORT_SET_TX_FREE;
+	}
+
 	if (set_attrs == 0)
 		errno = EINVAL;
 	return set_attrs;
@@ -177,19 +227,484 @@ static cmd_status_t rxq_list(const struct gr_api_client *c, const struct ec_pnod
 		scols_line_sprintf(line, 3, "%u", q->enabled);
 	}
 
-	scols_print_table(table);
+	gr_table_print(table);
 	scols_unref_table(table);
 	free(resp_ptr);
 
 	return CMD_SUCCESS;
 }
 
-#define PORT_ATTRS_CMD IFACE_ATTRS_CMD ",(mac MAC),(rxqs N_RXQ),(qsize Q_SIZE)"
+#define PORT_ATTRS_CMD                                                                             \
+	IFACE_ATTRS_CMD ",(mac MAC),(rxqs N_RXQ),(qsize Q_SIZE),"                                  \
+			"(txpolicy TX_POLICY [limit TX_LIMIT]),(ctrlq CTRL_RXQ),"                  \
+			"(fastfree FAST_FREE [freethresh TX_FREE_THRESH] [rsthresh TX_RS_THRESH])"
 
 #define PORT_ATTRS_ARGS                                                                            \
 	IFACE_ATTRS_ARGS, with_help("Set the ethernet address.", ec_node_re("MAC", ETH_ADDR_RE)),  \
 		with_help("Number of Rx queues.", ec_node_uint("N_RXQ", 0, UINT16_MAX - 1, 10)),   \
-		with_help("Rx/Tx queues size.", ec_node_uint("Q_SIZE", 0, UINT16_MAX - 1, 10))
+		with_help("Rx/Tx queues size.", ec_node_uint("Q_SIZE", 0, UINT16_MAX - 1, 10)),    \
+		with_help(                                                                         \
+			"What to do with packets not accepted by the driver.",                     \
+			ec_node_re("TX_POLICY", "drop|retry|queue")                                \
+		),                                                                                 \
+		with_help(                                                                         \
+			"Max retries or queued packets per worker.",                               \
+			ec_node_uint("TX_LIMIT", 1, GR_PORT_TX_QUEUE_MAX, 10)                      \
+		),                                                                                 \
+		with_help(                                                                         \
+			"Steer ARP, NDP and local traffic to a dedicated Rx queue.",               \
+			ec_node_re("CTRL_RXQ", "on|off")                                           \
+		),                                                                                 \
+		with_help(                                                                         \
+			"Return sent mbufs to the port pool in bulk.",                             \
+			ec_node_re("FAST_FREE", "on|off")                                          \
+		),                                                                                 \
+		with_help(                                                                         \
+			"Free sent mbufs when fewer Tx descriptors are available.",                \
+			ec_node_uint("TX_FREE_THRESH", 0, UINT16_MAX - 1, 10)                      \
+		),                                                                                 \
+		with_help(                                                                         \
+			"Request a completion report every N Tx descriptors.",                     \
+			ec_node_uint("TX_RS_THRESH", 0, UINT16_MAX - 1, 10)                        \
+		)
+
+// indexed by GR_PORT_RSS_F_* bit position
+static const char *rss_field_names[] = {
+	"ipv4",
+	"ipv6",
+	"tcp",
+	"udp",
+	"sctp",
+	"vlan",
+	"esp",
+	"gtpu",
+};
+
+static int parse_rss_fields(const char *arg, uint32_t *fields) {
+	char *buf, *tok, *save = NULL;
+	unsigned i;
+
+	if ((buf = strdup(arg)) == NULL)
+		return -ENOMEM;
+
+	*fields = 0;
+	for (tok = strtok_r(buf, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+		for (i = 0; i < ARRAY_DIM(rss_field_names); i++) {
+			if (strcmp(tok, rss_field_names[i]) == 0)
+				break;
+		}
+		if (i == ARRAY_DIM(rss_field_names)) {
+			free(buf);
+			errno = EINVAL;
+			return -errno;
+		}
+		*fields |= GR_BIT32(i);
+	}
+	free(buf);
+
+	return 0;
+}
+
+static int parse_rss_key(const char *arg, struct gr_port_rss *rss) {
+	size_t len = strlen(arg);
+
+	if (len % 2 != 0 || len / 2 > sizeof(rss->key)) {
+		errno = EINVAL;
+		return -errno;
+	}
+	for (size_t i = 0; i < len / 2; i++) {
+		if (sscanf(&arg[i * 2], "%2hhx", &rss->key[i]) != 1) {
+			errno = EINVAL;
+			return -errno;
+		}
+	}
+	rss->key_len = len / 2;
+
+	return 0;
+}
+
+static int parse_rss_reta(const char *arg, struct gr_port_rss *rss) {
+	const char *c = arg;
+	char *end;
+
+	rss->reta_size = 0;
+	if (strcmp(arg, "default") == 0)
+		return 0;
+
+	while (*c != '\0') {
+		if (rss->reta_size == ARRAY_DIM(rss->reta)) {
+			errno = ERANGE;
+			return -errno;
+		}
+		rss->reta[rss->reta_size++] = strtoul(c, &end, 10);
+		c = *end == ',' ? end + 1 : end;
+	}
+
+	return 0;
+}
+
+static cmd_status_t rss_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_rss_set_req req = {0};
+	struct gr_iface iface;
+
+	if (iface_from_name(c, arg_str(p, "NAME"), &iface) < 0)
+		return CMD_ERROR;
+
+	req.iface_id = iface.id;
+
+	if (arg_str(p, "FIELDS") != NULL) {
+		if (parse_rss_fields(arg_str(p, "FIELDS"), &req.rss.hash_fields) < 0)
+			return CMD_ERROR;
+		req.set_attrs |= GR_PORT_RSS_SET_HASH_FIELDS;
+	}
+	if (arg_str(p, "SYMMETRIC") != NULL) {
+		req.rss.symmetric = strcmp(arg_str(p, "SYMMETRIC"), "on") == 0;
+		req.set_attrs |= GR_PORT_RSS_SET_SYMMETRIC;
+	}
+	if (arg_str(p, "KEY") != NULL) {
+		if (strcmp(arg_str(p, "KEY"), "default") != 0
+		    && parse_rss_key(arg_str(p, "KEY"), &req.rss) < 0)
+			return CMD_ERROR;
+		req.set_attrs |= GR_PORT_RSS_SET_KEY;
+	}
+	if (arg_str(p, "RETA") != NULL) {
+		if (parse_rss_reta(arg_str(p, "RETA"), &req.rss) < 0)
+			return CMD_ERROR;
+		req.set_attrs |= GR_PORT_RSS_SET_RETA;
+	}
+	if (req.set_attrs == 0) {
+		errno = EINVAL;
+		return CMD_ERROR;
+	}
+
+	if (gr_api_client_send_recv(c, GR_INFRA_RSS_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t rss_show(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_rss_get_req req;
+	const struct gr_port_rss *rss;
+	void *resp_ptr = NULL;
+	struct gr_iface iface;
+	const char *sep = "";
+
+	if (iface_from_name(c, arg_str(p, "NAME"), &iface) < 0)
+		return CMD_ERROR;
+
+	req.iface_id = iface.id;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_RSS_GET, sizeof(req), &req, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	rss = &((const struct gr_infra_rss_get_resp *)resp_ptr)->rss;
+
+	printf("hash: ");
+	for (unsigned i = 0; i < ARRAY_DIM(rss_field_names); i++) {
+		if (rss->hash_fields & GR_BIT32(i)) {
+			printf("%s%s", sep, rss_field_names[i]);
+			sep = ",";
+		}
+	}
+	printf("\n");
+	printf("symmetric: %s\n", rss->symmetric ? "on" : "off");
+	printf("key: ");
+	for (unsigned i = 0; i < rss->key_len; i++)
+		printf("%02x", rss->key[i]);
+	printf("\n");
+	printf("reta_size: %u\n", rss->reta_size);
+	for (unsigned i = 0; i < rss->reta_size; i++) {
+		if (i % 16 == 0)
+			printf("%s%4u:", i > 0 ? "\n" : "", i);
+		printf(" %u", rss->reta[i]);
+	}
+	if (rss->reta_size > 0)
+		printf("\n");
+
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t qos_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_qos_set_req req = {.qos.cpu_id = GR_PORT_QOS_CPU_ANY};
+	const char *classify = arg_str(p, "CLASSIFY");
+	struct gr_iface iface;
+	uint64_t v;
+
+	if (iface_from_name(c, arg_str(p, "NAME"), &iface) < 0)
+		return CMD_ERROR;
+
+	req.iface_id = iface.id;
+	if (strcmp(classify, "dscp") == 0)
+		req.qos.classify = GR_PORT_QOS_DSCP;
+	else if (strcmp(classify, "pcp") == 0)
+		req.qos.classify = GR_PORT_QOS_PCP;
+	else
+		req.qos.classify = GR_PORT_QOS_DISABLED;
+
+	if (arg_u64(p, "RATE", &req.qos.rate) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u64(p, "PIPE_RATE", &req.qos.pipe_rate) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u16(p, "PIPES", &req.qos.n_pipes) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u16(p, "QSIZE", &req.qos.queue_size) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u16(p, "CPU", &req.qos.cpu_id) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u64(p, "BURST", &v) == 0)
+		req.qos.pipe_burst = v;
+	else if (errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_QOS_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t qos_show(const struct gr_api_client *c, const struct ec_pnode *p) {
+	static const char *const classify_names[] = {
+		[GR_PORT_QOS_DISABLED] = "off",
+		[GR_PORT_QOS_DSCP] = "dscp",
+		[GR_PORT_QOS_PCP] = "pcp",
+	};
+	struct gr_infra_qos_get_req req;
+	const struct gr_port_qos *qos;
+	void *resp_ptr = NULL;
+	struct gr_iface iface;
+
+	if (iface_from_name(c, arg_str(p, "NAME"), &iface) < 0)
+		return CMD_ERROR;
+
+	req.iface_id = iface.id;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_QOS_GET, sizeof(req), &req, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	qos = &((const struct gr_infra_qos_get_resp *)resp_ptr)->qos;
+
+	printf("classify: %s\n",
+	       qos->classify < ARRAY_DIM(classify_names) ? classify_names[qos->classify] : "?");
+	if (qos->classify != GR_PORT_QOS_DISABLED) {
+		printf("rate: %" PRIu64 " bit/s\n", qos->rate);
+		printf("pipes: %u\n", qos->n_pipes);
+		printf("pipe_rate: %" PRIu64 " bit/s\n", qos->pipe_rate);
+		printf("pipe_burst: %u bytes\n", qos->pipe_burst);
+		printf("queue_size: %u\n", qos->queue_size);
+		if (qos->cpu_id == GR_PORT_QOS_CPU_ANY)
+			printf("cpu: any\n");
+		else
+			printf("cpu: %u\n", qos->cpu_id);
+		printf("enqueued: %" PRIu64 "\n", qos->enqueued);
+		printf("dropped: %" PRIu64 "\n", qos->dropped);
+	}
+
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t mirror_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_mirror_set_req req = {0};
+	const char *dir = arg_str(p, "DIR");
+	const char *dst = arg_str(p, "DST");
+	struct gr_iface iface;
+
+	if (iface_from_name(c, arg_str(p, "NAME"), &iface) < 0)
+		return CMD_ERROR;
+	req.iface_id = iface.id;
+	req.mirror.dst_iface_id = GR_IFACE_ID_UNDEF;
+
+	if (dst != NULL) {
+		if (iface_from_name(c, dst, &iface) < 0)
+			return CMD_ERROR;
+		req.mirror.dst_iface_id = iface.id;
+		if (dir == NULL || strcmp(dir, "both") == 0)
+			req.mirror.flags = GR_PORT_MIRROR_F_RX | GR_PORT_MIRROR_F_TX;
+		else if (strcmp(dir, "rx") == 0)
+			req.mirror.flags = GR_PORT_MIRROR_F_RX;
+		else
+			req.mirror.flags = GR_PORT_MIRROR_F_TX;
+		if (arg_u16(p, "SNAPLEN", &req.mirror.snaplen) < 0 && errno != ENOENT)
+			return CMD_ERROR;
+		if (arg_u32(p, "RATE", &req.mirror.rate) < 0 && errno != ENOENT)
+			return CMD_ERROR;
+	}
+
+	if (gr_api_client_send_recv(c, GR_INFRA_MIRROR_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t mirror_show(const struct gr_api_client *c, const struct ec_pnode *p) {
+	const struct gr_port_mirror *mirror;
+	struct gr_infra_mirror_get_req req;
+	void *resp_ptr = NULL;
+	struct gr_iface iface;
+
+	if (iface_from_name(c, arg_str(p, "NAME"), &iface) < 0)
+		return CMD_ERROR;
+
+	req.iface_id = iface.id;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_MIRROR_GET, sizeof(req), &req, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	mirror = &((const struct gr_infra_mirror_get_resp *)resp_ptr)->mirror;
+
+	if (mirror->dst_iface_id == GR_IFACE_ID_UNDEF) {
+		printf("destination: none\n");
+	} else {
+		if (iface_from_id(c, mirror->dst_iface_id, &iface) == 0)
+			printf("destination: %s\n", iface.name);
+		else
+			printf("destination: %u\n", mirror->dst_iface_id);
+		printf("direction: %s%s\n",
+		       mirror->flags & GR_PORT_MIRROR_F_RX ? "rx" : "",
+		       mirror->flags & GR_PORT_MIRROR_F_TX ? "tx" : "");
+		if (mirror->snaplen != 0)
+			printf("snaplen: %u bytes\n", mirror->snaplen);
+		else
+			printf("snaplen: unlimited\n");
+		if (mirror->rate != 0)
+			printf("rate: %u pkt/s\n", mirror->rate);
+		else
+			printf("rate: unlimited\n");
+		printf("packets: %" PRIu64 "\n", mirror->packets);
+		printf("dropped: %" PRIu64 "\n", mirror->dropped);
+	}
+
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static int parse_pin_match(const struct ec_pnode *p, struct gr_port_pin *pin) {
+	const char *dst = arg_str(p, "DST");
+
+	if (arg_u16(p, "VLAN", &pin->vlan_id) == 0) {
+		pin->type = GR_PORT_PIN_VLAN;
+		return 0;
+	}
+	if (dst == NULL) {
+		errno = EINVAL;
+		return -errno;
+	}
+	if (ip4_net_parse(dst, &pin->ip4, true) == 0) {
+		pin->type = GR_PORT_PIN_IP4;
+		return 0;
+	}
+	if (ip6_net_parse(dst, &pin->ip6, true) < 0)
+		return -errno;
+	pin->type = GR_PORT_PIN_IP6;
+
+	return 0;
+}
+
+static cmd_status_t pin_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_port_pin_add_req req = {.pin.n_rxqs = 1};
+	struct gr_iface iface;
+
+	if (iface_from_name(c, arg_str(p, "NAME"), &iface) < 0)
+		return CMD_ERROR;
+	req.iface_id = iface.id;
+
+	if (parse_pin_match(p, &req.pin) < 0)
+		return CMD_ERROR;
+	if (arg_u16(p, "RXQ", &req.pin.first_rxq) < 0)
+		return CMD_ERROR;
+	if (arg_u16(p, "COUNT", &req.pin.n_rxqs) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_PORT_PIN_ADD, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t pin_del(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_port_pin_del_req req = {0};
+	struct gr_iface iface;
+
+	if (iface_from_name(c, arg_str(p, "NAME"), &iface) < 0)
+		return CMD_ERROR;
+	req.iface_id = iface.id;
+
+	if (parse_pin_match(p, &req.pin) < 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_PORT_PIN_DEL, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t pin_list(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct libscols_table *table = scols_new_table();
+	const struct gr_infra_port_pin_list_resp *resp;
+	struct gr_infra_port_pin_list_req req;
+	void *resp_ptr = NULL;
+	struct gr_iface iface;
+	char buf[64];
+
+	if (table == NULL)
+		return CMD_ERROR;
+
+	if (iface_from_name(c, arg_str(p, "NAME"), &iface) < 0) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+	req.iface_id = iface.id;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_PORT_PIN_LIST, sizeof(req), &req, &resp_ptr) < 0) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+	resp = resp_ptr;
+
+	scols_table_new_column(table, "MATCH", 0, 0);
+	scols_table_new_column(table, "RXQS", 0, 0);
+	scols_table_new_column(table, "INSTALLED", 0, 0);
+	scols_table_set_column_separator(table, "  ");
+
+	for (size_t i = 0; i < resp->n_pins; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_port_pin *pin = &resp->pins[i];
+
+		switch (pin->type) {
+		case GR_PORT_PIN_VLAN:
+			scols_line_sprintf(line, 0, "vlan %u", pin->vlan_id);
+			break;
+		case GR_PORT_PIN_IP4:
+			ip4_net_format(&pin->ip4, buf, sizeof(buf));
+			scols_line_sprintf(line, 0, "dst %s", buf);
+			break;
+		case GR_PORT_PIN_IP6:
+			ip6_net_format(&pin->ip6, buf, sizeof(buf));
+			scols_line_sprintf(line, 0, "dst %s", buf);
+			break;
+		default:
+			scols_line_sprintf(line, 0, "?");
+		}
+		if (pin->n_rxqs == 1)
+			scols_line_sprintf(line, 1, "%u", pin->first_rxq);
+		else
+			scols_line_sprintf(
+				line, 1, "%u-%u", pin->first_rxq, pin->first_rxq + pin->n_rxqs - 1
+			);
+		scols_line_sprintf(line, 2, "%u", pin->installed);
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
 
 static int ctx_init(struct ec_node *root) {
 	int ret;
@@ -239,6 +754,194 @@ static int ctx_init(struct ec_node *root) {
 		rxq_list,
 		"Display DPDK port RXQ assignment."
 	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_ADD, CTX_ARG("port", "Add DPDK port rxq pins.")),
+		"pin NAME (vlan VLAN)|(dst DST) rxq RXQ [count COUNT]",
+		pin_add,
+		"Steer a VLAN or destination prefix to dedicated RX queues.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_PORT))
+		),
+		with_help("Outer VLAN ID.", ec_node_uint("VLAN", 1, 4095, 10)),
+		with_help(
+			"IPv4 or IPv6 destination prefix.",
+			ec_node_re("DST", "(" IPV4_NET_RE ")|(" IPV6_NET_RE ")")
+		),
+		with_help("First RX queue ID.", ec_node_uint("RXQ", 0, UINT16_MAX - 1, 10)),
+		with_help(
+			"Number of RX queues, traffic is spread with RSS (default 1).",
+			ec_node_uint("COUNT", 1, UINT16_MAX - 1, 10)
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_DEL, CTX_ARG("port", "Delete DPDK port rxq pins.")),
+		"pin NAME (vlan VLAN)|(dst DST)",
+		pin_del,
+		"Stop steering a VLAN or destination prefix to dedicated RX queues.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_PORT))
+		),
+		with_help("Outer VLAN ID.", ec_node_uint("VLAN", 1, 4095, 10)),
+		with_help(
+			"IPv4 or IPv6 destination prefix.",
+			ec_node_re("DST", "(" IPV4_NET_RE ")|(" IPV6_NET_RE ")")
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW, CTX_ARG("port", "Display DPDK port information.")),
+		"pin NAME",
+		pin_list,
+		"Display DPDK port rxq pins.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_PORT))
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("port", "Set DPDK port queue mapping.")),
+		"rss NAME (hash FIELDS),(symmetric SYMMETRIC),(key KEY),(reta RETA)",
+		rss_set,
+		"Set DPDK port RSS configuration.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_PORT))
+		),
+		with_help(
+			"Comma separated hash fields (ipv4,ipv6,tcp,udp,sctp,vlan,esp,gtpu).",
+			ec_node_re("FIELDS", "[a-z0-9]+(,[a-z0-9]+)*")
+		),
+		with_help(
+			"Use a symmetric hash (both flow directions on the same queue).",
+			ec_node_re("SYMMETRIC", "on|off")
+		),
+		with_help("Hexadecimal hash key.", ec_node_re("KEY", "default|([0-9a-fA-F]{2})+")),
+		with_help(
+			"Comma separated RX queue IDs, repeated to fill the indirection table.",
+			ec_node_re("RETA", "default|[0-9]+(,[0-9]+)*")
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW, CTX_ARG("port", "Display DPDK port information.")),
+		"rss NAME",
+		rss_show,
+		"Display DPDK port RSS configuration.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_PORT))
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("port", "Set DPDK port queue mapping.")),
+		"qos NAME CLASSIFY [(rate RATE),(pipes PIPES),(pipe-rate PIPE_RATE),(burst BURST),"
+		"(queue-size QSIZE),(cpu CPU)]",
+		qos_set,
+		"Set DPDK port egress scheduler.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_PORT))
+		),
+		with_help(
+			"Traffic class from the IP DSCP or the VLAN priority, off to disable.",
+			ec_node_re("CLASSIFY", "off|dscp|pcp")
+		),
+		with_help("Port rate in bit/s.", ec_node_uint("RATE", 8, UINT64_MAX, 10)),
+		with_help(
+			"Number of pipes, selected from the VLAN ID (power of 2).",
+			ec_node_uint("PIPES", 1, GR_PORT_QOS_PIPES_MAX, 10)
+		),
+		with_help(
+			"Rate of each pipe in bit/s, the port rate if unset.",
+			ec_node_uint("PIPE_RATE", 8, UINT64_MAX, 10)
+		),
+		with_help(
+			"Burst size of each pipe in bytes.",
+			ec_node_uint("BURST", 1, UINT32_MAX, 10)
+		),
+		with_help(
+			"Packets per queue (power of 2).",
+			ec_node_uint("QSIZE", 1, UINT16_MAX, 10)
+		),
+		with_help(
+			"CPU of the worker running the scheduler.",
+			ec_node_uint("CPU", 0, UINT16_MAX - 1, 10)
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW, CTX_ARG("port", "Display DPDK port information.")),
+		"qos NAME",
+		qos_show,
+		"Display DPDK port egress scheduler configuration.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_PORT))
+		)
+	);
+	if (ret < 0)
+		return ret;
+
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("port", "Set DPDK port queue mapping.")),
+		"mirror NAME to DST [(direction DIR),(snaplen SNAPLEN),(rate RATE)]",
+		mirror_set,
+		"Copy the frames received and/or sent on a DPDK port to a monitor port.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_PORT))
+		),
+		with_help(
+			"Monitor port name.",
+			ec_node_dyn("DST", complete_iface_names, INT2PTR(GR_IFACE_TYPE_PORT))
+		),
+		with_help("Mirrored direction (default both).", ec_node_re("DIR", "rx|tx|both")),
+		with_help(
+			"Max bytes of each copy, 0 for the whole frame.",
+			ec_node_uint("SNAPLEN", 0, UINT16_MAX, 10)
+		),
+		with_help(
+			"Max copies per second, 0 for unlimited.",
+			ec_node_uint("RATE", 0, UINT32_MAX, 10)
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("port", "Set DPDK port queue mapping.")),
+		"mirror NAME off",
+		mirror_set,
+		"Stop mirroring a DPDK port.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_PORT))
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW, CTX_ARG("port", "Display DPDK port information.")),
+		"mirror NAME",
+		mirror_show,
+		"Display DPDK port mirror configuration and statistics.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_PORT))
+		)
+	);
 	if (ret < 0)
 		return ret;
 
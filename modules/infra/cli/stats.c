@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // Copyright (c) 2024 Robin Jarry
 
+#include "gr_cli_iface.h"
+
 #include <gr_api.h>
 #include <gr_cli.h>
 #include <gr_infra.h>
@@ -10,7 +12,12 @@
 #include <ecoli.h>
 #include <libsmartcols.h>
 
+#include <errno.h>
 #include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 static int stats_order_name(const void *sa, const void *sb) {
@@ -92,7 +99,7 @@ static cmd_status_t stats_get(const struct gr_api_client *c, const struct ec_pno
 			scols_line_sprintf(line, 5, "%.01f", cycles_pkt);
 		}
 
-		scols_print_table(table);
+		gr_table_print(table);
 		scols_unref_table(table);
 	}
 
@@ -110,6 +117,566 @@ static cmd_status_t stats_reset(const struct gr_api_client *c, const struct ec_p
 	return CMD_SUCCESS;
 }
 
+static cmd_status_t dwell_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_stats_dwell_set_req req = {
+		.enabled = strcmp(arg_str(p, "ENABLED"), "on") == 0,
+		.sample_rate = 1,
+	};
+
+	if (arg_u32(p, "RATE", &req.sample_rate) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_STATS_DWELL_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static double cycles_to_us(uint64_t cycles, uint64_t hz) {
+	return (double)cycles * 1000000.0 / (double)hz;
+}
+
+static cmd_status_t dwell_show(const struct gr_api_client *c, const struct ec_pnode *) {
+	const struct gr_infra_stats_dwell_get_resp *resp;
+	void *resp_ptr = NULL;
+	uint64_t lo, hi;
+	double pct;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_STATS_DWELL_GET, 0, NULL, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	printf("enabled: %s\n", resp->enabled ? "on" : "off");
+	printf("sample_rate: %u\n", resp->sample_rate);
+	printf("samples: %" PRIu64 "\n", resp->samples);
+
+	for (unsigned b = 0; b < GR_INFRA_STATS_HIST_BUCKETS && resp->samples > 0; b++) {
+		if (resp->cycles[b] == 0)
+			continue;
+		lo = b == 0 ? 0 : UINT64_C(1) << (b - 1);
+		hi = UINT64_C(1) << b;
+		if (b == GR_INFRA_STATS_HIST_BUCKETS - 1)
+			printf("  >= %.3fus", cycles_to_us(lo, resp->tsc_hz));
+		else
+			printf("  < %.3fus", cycles_to_us(hi, resp->tsc_hz));
+		pct = 100.0 * resp->cycles[b] / resp->samples;
+		printf(" %" PRIu64 " (%.1f%%)\n", resp->cycles[b], pct);
+	}
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t drop_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_stats_drop_set_req req = {0};
+
+	if (arg_u32(p, "RATE", &req.sample_rate) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_STATS_DROP_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t drop_show(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_stats_drop_get_req req = {.iface_id = GR_IFACE_ID_UNDEF};
+	const struct gr_infra_stats_drop_get_resp *resp;
+	struct libscols_table *table;
+	const char *pattern;
+	void *resp_ptr = NULL;
+	struct gr_iface iface;
+	uint32_t sample_rate = 0;
+
+	if (arg_str(p, "NAME") != NULL) {
+		if (iface_from_name(c, arg_str(p, "NAME"), &iface) < 0)
+			return CMD_ERROR;
+		req.iface_id = iface.id;
+	}
+	if ((pattern = arg_str(p, "PATTERN")) != NULL)
+		memccpy(req.pattern, pattern, 0, sizeof(req.pattern) - 1);
+
+	if ((table = scols_new_table()) == NULL)
+		return CMD_ERROR;
+	scols_table_new_column(table, "REASON", 0, 0);
+	scols_table_new_column(table, "IFACE", 0, 0);
+	scols_table_new_column(table, "PACKETS", 0, SCOLS_FL_RIGHT);
+	scols_table_set_column_separator(table, "  ");
+
+	do {
+		int ret = gr_api_client_send_recv(
+			c, GR_INFRA_STATS_DROP_GET, sizeof(req), &req, &resp_ptr
+		);
+		if (ret < 0) {
+			scols_unref_table(table);
+			return CMD_ERROR;
+		}
+
+		resp = resp_ptr;
+		sample_rate = resp->sample_rate;
+		for (uint16_t i = 0; i < resp->n_drops; i++) {
+			struct libscols_line *line = scols_table_new_line(table, NULL);
+			const struct gr_infra_stat_drop *d = &resp->drops[i];
+
+			scols_line_sprintf(line, 0, "%s", d->reason);
+			if (d->iface_id == GR_IFACE_ID_UNDEF)
+				scols_line_set_data(line, 1, "");
+			else if (iface_from_id(c, d->iface_id, &iface) < 0)
+				scols_line_sprintf(line, 1, "%u", d->iface_id);
+			else
+				scols_line_sprintf(line, 1, "%s", iface.name);
+			scols_line_sprintf(line, 2, "%" PRIu64, d->packets);
+		}
+
+		req.cursor = resp->next_cursor;
+		free(resp_ptr);
+	} while (req.cursor != 0);
+
+	if (sample_rate != 0)
+		printf("sampling 1 dropped packet out of %u to packet trace\n", sample_rate);
+	gr_table_print(table);
+	scols_unref_table(table);
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t vrf_show(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_stats_vrf_get_req req = {.vrf_id = UINT16_MAX};
+	const struct gr_infra_stats_vrf_get_resp *resp;
+	struct libscols_table *table;
+	void *resp_ptr = NULL;
+
+	if (arg_u16(p, "VRF", &req.vrf_id) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_STATS_VRF_GET, sizeof(req), &req, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	if ((table = scols_new_table()) == NULL) {
+		free(resp_ptr);
+		return CMD_ERROR;
+	}
+	scols_table_new_column(table, "VRF", 0, 0);
+	scols_table_new_column(table, "FAMILY", 0, 0);
+	scols_table_new_column(table, "PACKETS", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "BYTES", 0, SCOLS_FL_RIGHT);
+	scols_table_set_column_separator(table, "  ");
+
+	for (uint16_t i = 0; i < resp->n_vrfs; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_infra_stat_vrf *v = &resp->vrfs[i];
+
+		scols_line_sprintf(line, 0, "%u", v->vrf_id);
+		scols_line_set_data(line, 1, v->family == AF_INET6 ? "ip6" : "ip");
+		scols_line_sprintf(line, 2, "%" PRIu64, v->packets);
+		scols_line_sprintf(line, 3, "%" PRIu64, v->bytes);
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t top_prefix_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_stats_top_prefix_set_req req = {0};
+	uint16_t len;
+
+	if (arg_u32(p, "RATE", &req.sample_rate) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u16(p, "LEN4", &len) == 0)
+		req.ip4_prefixlen = len;
+	else if (errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u16(p, "LEN6", &len) == 0)
+		req.ip6_prefixlen = len;
+	else if (errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_STATS_TOP_PREFIX_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t top_prefix_show(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_stats_top_prefix_get_req req = {.vrf_id = UINT16_MAX};
+	const struct gr_infra_stats_top_prefix_get_resp *resp;
+	struct libscols_table *table;
+	void *resp_ptr = NULL;
+	char buf[INET6_ADDRSTRLEN];
+
+	if (arg_u16(p, "VRF", &req.vrf_id) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u16(p, "COUNT", &req.max_prefixes) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	int ret = gr_api_client_send_recv(
+		c, GR_INFRA_STATS_TOP_PREFIX_GET, sizeof(req), &req, &resp_ptr
+	);
+	if (ret < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	if ((table = scols_new_table()) == NULL) {
+		free(resp_ptr);
+		return CMD_ERROR;
+	}
+	scols_table_new_column(table, "VRF", 0, 0);
+	scols_table_new_column(table, "PREFIX", 0, 0);
+	scols_table_new_column(table, "PACKETS", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "ERROR", 0, SCOLS_FL_RIGHT);
+	scols_table_set_column_separator(table, "  ");
+
+	for (uint16_t i = 0; i < resp->n_prefixes; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_infra_stat_prefix *e = &resp->prefixes[i];
+
+		scols_line_sprintf(line, 0, "%u", e->vrf_id);
+		if (inet_ntop(e->family, &e->ip6, buf, sizeof(buf)) == NULL)
+			buf[0] = '\0';
+		scols_line_sprintf(line, 1, "%s/%u", buf, e->prefixlen);
+		scols_line_sprintf(line, 2, "%" PRIu64, e->packets);
+		scols_line_sprintf(line, 3, "%" PRIu64, e->error);
+	}
+
+	if (resp->sample_rate == 0)
+		printf("top prefixes accounting is disabled\n");
+	else
+		printf(
+			"sampling 1 received packet out of %u, ip4 /%u, ip6 /%u\n",
+			resp->sample_rate,
+			resp->ip4_prefixlen,
+			resp->ip6_prefixlen
+		);
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+// Live rates computed from the binary stats API.
+struct top_value {
+	uint64_t objs;
+	uint64_t calls;
+	uint64_t cycles;
+};
+
+struct top_state {
+	uint32_t schema_gen;
+	uint64_t gen;
+	uint32_t n_descs;
+	struct gr_infra_stat_desc *descs; // indexed by stat id
+	struct top_value *prev;
+	struct top_value *cur;
+	struct gr_infra_worker_list_resp *workers;
+	struct gr_infra_worker_list_resp *prev_workers;
+};
+
+static void top_state_free(struct top_state *st) {
+	free(st->descs);
+	free(st->prev);
+	free(st->cur);
+	free(st->workers);
+	free(st->prev_workers);
+	memset(st, 0, sizeof(*st));
+}
+
+static int top_schema(const struct gr_api_client *c, struct top_state *st) {
+	struct gr_infra_stats_schema_req req = {.cursor = 0};
+	const struct gr_infra_stats_schema_resp *resp;
+	struct gr_infra_stat_desc *descs;
+	void *resp_ptr;
+
+	top_state_free(st);
+	do {
+		resp_ptr = NULL;
+		if (gr_api_client_send_recv(c, GR_INFRA_STATS_SCHEMA, sizeof(req), &req, &resp_ptr)
+		    < 0)
+			return -errno;
+		resp = resp_ptr;
+		st->schema_gen = resp->schema_gen;
+		for (uint32_t i = 0; i < resp->n_descs; i++) {
+			const struct gr_infra_stat_desc *d = &resp->descs[i];
+			if (d->id >= st->n_descs) {
+				descs = realloc(st->descs, (d->id + 1) * sizeof(*descs));
+				if (descs == NULL) {
+					free(resp_ptr);
+					return -ENOMEM;
+				}
+				memset(&descs[st->n_descs],
+				       0,
+				       (d->id + 1 - st->n_descs) * sizeof(*descs));
+				st->descs = descs;
+				st->n_descs = d->id + 1;
+			}
+			st->descs[d->id] = *d;
+		}
+		req.cursor = resp->next_cursor;
+		free(resp_ptr);
+	} while (req.cursor != 0);
+
+	st->prev = calloc(st->n_descs, sizeof(*st->prev));
+	st->cur = calloc(st->n_descs, sizeof(*st->cur));
+	if (st->prev == NULL || st->cur == NULL)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static int top_values(const struct gr_api_client *c, struct top_state *st) {
+	struct gr_infra_stats_values_req req = {
+		.schema_gen = st->schema_gen,
+		.since_gen = st->gen,
+	};
+	const struct gr_infra_stats_values_resp *resp;
+	uint64_t gen = st->gen;
+	void *resp_ptr;
+
+	memcpy(st->prev, st->cur, st->n_descs * sizeof(*st->cur));
+	do {
+		resp_ptr = NULL;
+		if (gr_api_client_send_recv(c, GR_INFRA_STATS_VALUES, sizeof(req), &req, &resp_ptr)
+		    < 0)
+			return -errno;
+		resp = resp_ptr;
+		// all pages of a walk report the same generation
+		gen = resp->gen;
+		for (uint32_t i = 0; i < resp->n_values; i++) {
+			const struct gr_infra_stat_value *v = &resp->values[i];
+			if (v->id >= st->n_descs)
+				continue;
+			st->cur[v->id].objs = v->objs;
+			st->cur[v->id].calls = v->calls;
+			st->cur[v->id].cycles = v->cycles;
+		}
+		req.cursor = resp->next_cursor;
+		free(resp_ptr);
+	} while (req.cursor != 0);
+	st->gen = gen;
+
+	free(st->prev_workers);
+	st->prev_workers = st->workers;
+	st->workers = NULL;
+	resp_ptr = NULL;
+	if (gr_api_client_send_recv(c, GR_INFRA_WORKER_LIST, 0, NULL, &resp_ptr) < 0)
+		return -errno;
+	st->workers = resp_ptr;
+
+	return 0;
+}
+
+static int top_order_cycles(const void *a, const void *b, void *priv) {
+	const struct top_state *st = priv;
+	uint64_t da = st->cur[*(const uint32_t *)a].cycles - st->prev[*(const uint32_t *)a].cycles;
+	uint64_t db = st->cur[*(const uint32_t *)b].cycles - st->prev[*(const uint32_t *)b].cycles;
+	if (da == db)
+		return 0;
+	return da > db ? -1 : 1;
+}
+
+static uint64_t top_delta(const struct top_state *st, uint32_t id) {
+	return st->cur[id].objs - st->prev[id].objs;
+}
+
+static void top_print_workers(const struct top_state *st) {
+	struct libscols_table *table = scols_new_table();
+
+	scols_table_new_column(table, "CPU", 0, 0);
+	scols_table_new_column(table, "BUSY", 0, SCOLS_FL_RIGHT);
+	scols_table_set_column_separator(table, "  ");
+
+	for (uint16_t i = 0; i < st->workers->n_workers; i++) {
+		const struct gr_worker_info *w = &st->workers->workers[i];
+		const struct gr_worker_info *p = NULL;
+		struct libscols_line *line;
+		double busy = 0;
+
+		for (uint16_t j = 0; st->prev_workers && j < st->prev_workers->n_workers; j++) {
+			if (st->prev_workers->workers[j].cpu_id == w->cpu_id)
+				p = &st->prev_workers->workers[j];
+		}
+		if (p != NULL && w->total_cycles > p->total_cycles)
+			busy = 100.0 * (w->busy_cycles - p->busy_cycles)
+				/ (w->total_cycles - p->total_cycles);
+
+		line = scols_table_new_line(table, NULL);
+		scols_line_sprintf(line, 0, "%u", w->cpu_id);
+		scols_line_sprintf(line, 1, "%.1f%%", busy);
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+}
+
+static const char *top_xstat_name(const struct gr_infra_stat_desc *d) {
+	const char *dot = strchr(d->name, '.');
+	return dot != NULL ? dot + 1 : d->name;
+}
+
+static void top_print_ports(const struct top_state *st, double secs) {
+	static const char *rx_drops[] = {
+		"rx_missed_errors",
+		"rx_errors",
+		"rx_mbuf_allocation_errors",
+	};
+	struct libscols_table *table = scols_new_table();
+	uint16_t iface_id = GR_IFACE_ID_UNDEF;
+	uint64_t rx = 0, tx = 0, rx_drop = 0, tx_drop = 0;
+	struct libscols_line *line = NULL;
+	const struct gr_infra_stat_desc *d;
+	const char *name;
+
+	scols_table_new_column(table, "IFACE", 0, 0);
+	scols_table_new_column(table, "RX_MPPS", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "TX_MPPS", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "RX_DROPS/S", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "TX_DROPS/S", 0, SCOLS_FL_RIGHT);
+	scols_table_set_column_separator(table, "  ");
+
+	// xstats of the same port have consecutive ids
+	for (uint32_t id = 0; id <= st->n_descs; id++) {
+		d = id < st->n_descs ? &st->descs[id] : NULL;
+		if (d != NULL && d->iface_id == GR_IFACE_ID_UNDEF)
+			continue;
+		if (line != NULL && (d == NULL || d->iface_id != iface_id)) {
+			scols_line_sprintf(line, 1, "%.3f", rx / secs / 1000000.0);
+			scols_line_sprintf(line, 2, "%.3f", tx / secs / 1000000.0);
+			scols_line_sprintf(line, 3, "%.0f", rx_drop / secs);
+			scols_line_sprintf(line, 4, "%.0f", tx_drop / secs);
+			line = NULL;
+		}
+		if (d == NULL)
+			break;
+		if (line == NULL) {
+			iface_id = d->iface_id;
+			rx = tx = rx_drop = tx_drop = 0;
+			line = scols_table_new_line(table, NULL);
+			scols_line_sprintf(line, 0, "%.*s", (int)strcspn(d->name, "."), d->name);
+		}
+		name = top_xstat_name(d);
+		if (strcmp(name, "rx_good_packets") == 0)
+			rx = top_delta(st, id);
+		else if (strcmp(name, "tx_good_packets") == 0)
+			tx = top_delta(st, id);
+		else if (strcmp(name, "tx_errors") == 0)
+			tx_drop += top_delta(st, id);
+		for (unsigned i = 0; i < ARRAY_DIM(rx_drops); i++) {
+			if (strcmp(name, rx_drops[i]) == 0)
+				rx_drop += top_delta(st, id);
+		}
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+}
+
+static void top_print_nodes(const struct top_state *st, double secs, unsigned max_rows) {
+	struct libscols_table *table = scols_new_table();
+	uint64_t total_cycles = 0;
+	uint32_t *ids, n_ids = 0;
+
+	if ((ids = calloc(st->n_descs, sizeof(*ids))) == NULL)
+		return;
+	for (uint32_t id = 0; id < st->n_descs; id++) {
+		const struct gr_infra_stat_desc *d = &st->descs[id];
+		if (d->iface_id != GR_IFACE_ID_UNDEF || d->name[0] == '\0')
+			continue;
+		if (st->cur[id].calls == st->prev[id].calls)
+			continue;
+		total_cycles += st->cur[id].cycles - st->prev[id].cycles;
+		ids[n_ids++] = id;
+	}
+	qsort_r(ids, n_ids, sizeof(*ids), top_order_cycles, (void *)st);
+
+	scols_table_new_column(table, "NODE", 0, 0);
+	scols_table_new_column(table, "PPS", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "PKTS/CALL", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "CYCLES/PKT", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "CYCLES", 0, SCOLS_FL_RIGHT);
+	scols_table_set_column_separator(table, "  ");
+
+	for (uint32_t i = 0; i < n_ids && i < max_rows; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		uint32_t id = ids[i];
+		uint64_t objs = st->cur[id].objs - st->prev[id].objs;
+		uint64_t calls = st->cur[id].calls - st->prev[id].calls;
+		uint64_t cycles = st->cur[id].cycles - st->prev[id].cycles;
+
+		scols_line_sprintf(line, 0, "%s", st->descs[id].name);
+		scols_line_sprintf(line, 1, "%.0f", objs / secs);
+		scols_line_sprintf(line, 2, "%.1f", calls ? (double)objs / calls : 0.0);
+		scols_line_sprintf(line, 3, "%.1f", objs ? (double)cycles / objs : 0.0);
+		scols_line_sprintf(
+			line, 4, "%.1f%%", total_cycles ? 100.0 * cycles / total_cycles : 0.0
+		);
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(ids);
+}
+
+static double now_secs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static cmd_status_t stats_top(const struct gr_api_client *c, const struct ec_pnode *p) {
+	uint32_t interval = 1, count = 0, rows = 20;
+	struct top_state st = {0};
+	double start, secs;
+	int ret;
+
+	if (arg_u32(p, "INTERVAL", &interval) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u32(p, "COUNT", &count) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u32(p, "ROWS", &rows) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if ((ret = top_schema(c, &st)) < 0 || (ret = top_values(c, &st)) < 0)
+		goto err;
+	start = now_secs();
+
+	for (uint32_t i = 0; count == 0 || i < count; i++) {
+		// interrupted by SIGINT
+		if (sleep(interval) != 0)
+			break;
+		if ((ret = top_values(c, &st)) == -ESTALE) {
+			// ports were reconfigured, start over
+			if ((ret = top_schema(c, &st)) < 0 || (ret = top_values(c, &st)) < 0)
+				goto err;
+			start = now_secs();
+			continue;
+		}
+		if (ret < 0)
+			goto err;
+		secs = now_secs() - start;
+		start += secs;
+
+		printf("\033[H\033[2J");
+		printf("every %us, sorted by cycles, Ctrl-C to stop\n\n", interval);
+		top_print_workers(&st);
+		printf("\n");
+		top_print_ports(&st, secs);
+		printf("\n");
+		top_print_nodes(&st, secs, rows);
+		fflush(stdout);
+	}
+
+	top_state_free(&st);
+	return CMD_SUCCESS;
+err:
+	top_state_free(&st);
+	errno = -ret;
+	return CMD_ERROR;
+}
+
 static int ctx_init(struct ec_node *root) {
 	int ret;
 
@@ -129,6 +696,98 @@ static int ctx_init(struct ec_node *root) {
 	ret = CLI_COMMAND(
 		CLI_CONTEXT(root, CTX_CLEAR), "stats", stats_reset, "Reset all stats to zero."
 	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("stats", "Configure statistics.")),
+		"dwell ENABLED [sample RATE]",
+		dwell_set,
+		"Measure the time spent by packets between rx and tx.",
+		with_help("Measurement state.", ec_node_re("ENABLED", "on|off")),
+		with_help("Record one packet out of RATE.", ec_node_uint("RATE", 1, UINT32_MAX, 10))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW, CTX_ARG("stats", "Print statistics.")),
+		"dwell",
+		dwell_show,
+		"Print the histogram of the time spent by packets between rx and tx."
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("stats", "Configure statistics.")),
+		"drop-sample RATE",
+		drop_set,
+		"Copy dropped packets to the packet trace buffer.",
+		with_help(
+			"Copy one dropped packet out of RATE, 0 to disable.",
+			ec_node_uint("RATE", 0, UINT32_MAX, 10)
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW, CTX_ARG("stats", "Print statistics.")),
+		"drops [(iface NAME),(pattern PATTERN)]",
+		drop_show,
+		"Print the number of dropped packets per reason and per input interface.",
+		with_help(
+			"Only print packets received on this interface.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_PORT))
+		),
+		with_help("Filter drop reasons by glob pattern.", ec_node("any", "PATTERN"))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW, CTX_ARG("stats", "Print statistics.")),
+		"vrf [VRF]",
+		vrf_show,
+		"Print the number of packets and bytes received per VRF.",
+		with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("stats", "Configure statistics.")),
+		"top-prefixes RATE [(ip4-prefixlen LEN4),(ip6-prefixlen LEN6)]",
+		top_prefix_set,
+		"Estimate the most frequent destination prefixes from sampled packets.",
+		with_help(
+			"Account one received packet out of RATE, 0 to disable.",
+			ec_node_uint("RATE", 0, UINT32_MAX, 10)
+		),
+		with_help("IPv4 prefix length (default 24).", ec_node_uint("LEN4", 1, 32, 10)),
+		with_help("IPv6 prefix length (default 48).", ec_node_uint("LEN6", 1, 128, 10))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW, CTX_ARG("stats", "Print statistics.")),
+		"top-prefixes [(vrf VRF),(count COUNT)]",
+		top_prefix_show,
+		"Print the most frequent destination prefixes.",
+		with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10)),
+		with_help("Maximum number of prefixes.", ec_node_uint("COUNT", 1, UINT16_MAX, 10))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_ARG("stats", "Live statistics.")),
+		"top [(interval INTERVAL),(count COUNT),(rows ROWS)]",
+		stats_top,
+		"Periodically display worker load, port and node rates.",
+		with_help(
+			"Refresh interval in seconds.", ec_node_uint("INTERVAL", 1, UINT16_MAX, 10)
+		),
+		with_help(
+			"Stop after COUNT refreshes, forever by default.",
+			ec_node_uint("COUNT", 1, UINT32_MAX, 10)
+		),
+		with_help("Maximum number of nodes to display.", ec_node_uint("ROWS", 1, 1000, 10))
+	);
 	if (ret < 0)
 		return ret;
 
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_cli_iface.h"
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_infra.h>
+
+#include <ecoli.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static cmd_status_t trace_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_packet_trace_set_req req = {
+		.enabled = true,
+		.iface_id = GR_IFACE_ID_UNDEF,
+		.sample_rate = 1,
+	};
+	struct gr_iface iface;
+
+	if (arg_str(p, "NAME") != NULL) {
+		if (iface_from_name(c, arg_str(p, "NAME"), &iface) < 0)
+			return CMD_ERROR;
+		req.iface_id = iface.id;
+	}
+	if (arg_u32(p, "RATE", &req.sample_rate) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_PACKET_TRACE_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t trace_del(const struct gr_api_client *c, const struct ec_pnode *) {
+	struct gr_infra_packet_trace_set_req req = {
+		.enabled = false,
+		.iface_id = GR_IFACE_ID_UNDEF,
+		.sample_rate = 1,
+	};
+
+	if (gr_api_client_send_recv(c, GR_INFRA_PACKET_TRACE_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t trace_show(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_packet_trace_dump_req req = {0};
+	const struct gr_infra_packet_trace_dump_resp *resp;
+	void *resp_ptr = NULL;
+
+	if (arg_u16(p, "COUNT", &req.max_packets) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_PACKET_TRACE_DUMP, sizeof(req), &req, &resp_ptr)
+	    < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	// strip the trailing NUL byte
+	fwrite(resp->trace, 1, resp->len - 1, stdout);
+	if (resp->lost > 0)
+		printf("(%" PRIu64 " packets lost)\n", resp->lost);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET),
+		"trace [(iface NAME),(sample RATE)]",
+		trace_set,
+		"Enable packet tracing.",
+		with_help(
+			"Only trace packets received or sent on this interface.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_UNDEF))
+		),
+		with_help(
+			"Trace one packet out of RATE.", ec_node_uint("RATE", 1, UINT32_MAX, 10)
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_DEL), "trace", trace_del, "Disable packet tracing."
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW),
+		"trace [count COUNT]",
+		trace_show,
+		"Display and flush the traced packets.",
+		with_help(
+			"Maximum number of packets to display.",
+			ec_node_uint("COUNT", 1, UINT16_MAX, 10)
+		)
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "infra trace",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+}
@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_infra.h>
+#include <gr_table.h>
+
+#include <ecoli.h>
+#include <libsmartcols.h>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static cmd_status_t
+tracepoint_enable(const struct gr_api_client *c, const struct ec_pnode *p, bool enabled) {
+	struct gr_infra_tracepoint_set_req req = {.enabled = enabled};
+
+	if (memccpy(req.pattern, arg_str(p, "PATTERN"), 0, sizeof(req.pattern)) == NULL) {
+		errno = ENAMETOOLONG;
+		return CMD_ERROR;
+	}
+
+	if (gr_api_client_send_recv(c, GR_INFRA_TRACEPOINT_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t tracepoint_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	return tracepoint_enable(c, p, true);
+}
+
+static cmd_status_t tracepoint_del(const struct gr_api_client *c, const struct ec_pnode *p) {
+	return tracepoint_enable(c, p, false);
+}
+
+static cmd_status_t tracepoint_list(const struct gr_api_client *c, const struct ec_pnode *) {
+	struct libscols_table *table = scols_new_table();
+	const struct gr_infra_tracepoint_list_resp *resp;
+	void *resp_ptr = NULL;
+
+	if (table == NULL)
+		return CMD_ERROR;
+	if (gr_api_client_send_recv(c, GR_INFRA_TRACEPOINT_LIST, 0, NULL, &resp_ptr) < 0) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+
+	resp = resp_ptr;
+
+	scols_table_new_column(table, "NAME", 0, 0);
+	scols_table_new_column(table, "ENABLED", 0, 0);
+	scols_table_set_column_separator(table, "  ");
+
+	for (uint16_t i = 0; i < resp->n_tracepoints; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_infra_tracepoint *t = &resp->tracepoints[i];
+
+		scols_line_set_data(line, 0, t->name);
+		scols_line_set_data(line, 1, t->enabled ? "yes" : "no");
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t tracepoint_save(const struct gr_api_client *c, const struct ec_pnode *) {
+	if (gr_api_client_send_recv(c, GR_INFRA_TRACEPOINT_SAVE, 0, NULL, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET),
+		"tracepoint PATTERN",
+		tracepoint_set,
+		"Enable DPDK tracepoints.",
+		with_help(
+			"Glob pattern of tracepoint names (e.g. 'grout.*').",
+			ec_node("any", "PATTERN")
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_DEL),
+		"tracepoint PATTERN",
+		tracepoint_del,
+		"Disable DPDK tracepoints.",
+		with_help(
+			"Glob pattern of tracepoint names (e.g. 'grout.*').",
+			ec_node("any", "PATTERN")
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW),
+		"tracepoint",
+		tracepoint_list,
+		"List grout tracepoints."
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW),
+		"tracepoint ctf",
+		tracepoint_save,
+		"Write the trace buffers in the CTF format to the EAL trace directory."
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "infra tracepoint",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+}
@@ -0,0 +1,241 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_infra.h>
+#include <gr_macro.h>
+#include <gr_table.h>
+
+#include <ecoli.h>
+#include <libsmartcols.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *power_names[] = {
+	[GR_WORKER_POWER_AUTO] = "auto",
+	[GR_WORKER_POWER_POLL] = "poll",
+	[GR_WORKER_POWER_SLEEP] = "sleep",
+	[GR_WORKER_POWER_INTR] = "intr",
+	[GR_WORKER_POWER_MONITOR] = "monitor",
+	[GR_WORKER_POWER_PAUSE] = "pause",
+};
+
+static const char *power_name(uint8_t power) {
+	if (power < ARRAY_DIM(power_names))
+		return power_names[power];
+	return "?";
+}
+
+static cmd_status_t worker_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_worker_set_req req = {0};
+	const char *power;
+
+	if (arg_u16(p, "CPU", &req.cpu_id) < 0)
+		return CMD_ERROR;
+	power = arg_str(p, "POWER");
+	for (req.power = 0; req.power < ARRAY_DIM(power_names); req.power++) {
+		if (strcmp(power, power_names[req.power]) == 0)
+			break;
+	}
+
+	if (gr_api_client_send_recv(c, GR_INFRA_WORKER_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static int workers_order(const void *a, const void *b) {
+	const struct gr_worker_info *wa = a;
+	const struct gr_worker_info *wb = b;
+	return wa->cpu_id - wb->cpu_id;
+}
+
+static cmd_status_t worker_list(const struct gr_api_client *c, const struct ec_pnode *) {
+	struct libscols_table *table = scols_new_table();
+	struct gr_infra_worker_list_resp *resp;
+	void *resp_ptr = NULL;
+
+	if (table == NULL)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_WORKER_LIST, 0, NULL, &resp_ptr) < 0) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+
+	resp = resp_ptr;
+	qsort(resp->workers, resp->n_workers, sizeof(*resp->workers), workers_order);
+
+	scols_table_new_column(table, "CPU_ID", 0, 0);
+	scols_table_new_column(table, "RXQS", 0, 0);
+	scols_table_new_column(table, "POWER", 0, 0);
+	scols_table_new_column(table, "BUSY", 0, 0);
+	scols_table_new_column(table, "SLEEPS", 0, 0);
+	scols_table_new_column(table, "WALK_P50", 0, 0);
+	scols_table_new_column(table, "WALK_P99", 0, 0);
+	scols_table_new_column(table, "WALK_P999", 0, 0);
+	scols_table_new_column(table, "WALK_MAX", 0, 0);
+	scols_table_new_column(table, "STALLS", 0, 0);
+	scols_table_set_column_separator(table, "  ");
+
+	for (size_t i = 0; i < resp->n_workers; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_worker_info *w = &resp->workers[i];
+		double busy = 0;
+
+		if (w->total_cycles > 0)
+			busy = 100.0 * w->busy_cycles / w->total_cycles;
+
+		scols_line_sprintf(line, 0, "%u", w->cpu_id);
+		scols_line_sprintf(line, 1, "%u", w->n_rxqs);
+		if (w->power == w->active_power)
+			scols_line_sprintf(line, 2, "%s", power_name(w->power));
+		else
+			scols_line_sprintf(
+				line, 2, "%s (%s)", power_name(w->power), power_name(w->active_power)
+			);
+		scols_line_sprintf(line, 3, "%.1f%%", busy);
+		scols_line_sprintf(line, 4, "%" PRIu64, w->n_sleeps);
+		if (w->walk_max_ns != 0) {
+			scols_line_sprintf(line, 5, "%.1fus", w->walk_p50_ns / 1000.0);
+			scols_line_sprintf(line, 6, "%.1fus", w->walk_p99_ns / 1000.0);
+			scols_line_sprintf(line, 7, "%.1fus", w->walk_p999_ns / 1000.0);
+			scols_line_sprintf(line, 8, "%.1fus", w->walk_max_ns / 1000.0);
+			scols_line_sprintf(line, 9, "%" PRIu64, w->n_stalls);
+		} else {
+			for (unsigned c = 5; c <= 9; c++)
+				scols_line_set_data(line, c, "-");
+		}
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t watchdog_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_worker_watchdog_set_req req = {0};
+
+	if (arg_u32(p, "THRESHOLD", &req.threshold_us) < 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_WORKER_WATCHDOG_SET, sizeof(req), &req, NULL)
+	    < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static int stalls_order(const void *a, const void *b) {
+	const struct gr_worker_stall *sa = a;
+	const struct gr_worker_stall *sb = b;
+	if (sa->age_us == sb->age_us)
+		return 0;
+	return sa->age_us < sb->age_us ? -1 : 1;
+}
+
+static cmd_status_t stall_list(const struct gr_api_client *c, const struct ec_pnode *) {
+	struct libscols_table *table = scols_new_table();
+	struct gr_infra_worker_stall_list_resp *resp;
+	void *resp_ptr = NULL;
+
+	if (table == NULL)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_WORKER_STALL_LIST, 0, NULL, &resp_ptr) < 0) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+
+	resp = resp_ptr;
+	qsort(resp->stalls, resp->n_stalls, sizeof(*resp->stalls), stalls_order);
+
+	scols_table_new_column(table, "CPU_ID", 0, 0);
+	scols_table_new_column(table, "AGE", 0, 0);
+	scols_table_new_column(table, "DURATION", 0, 0);
+	scols_table_new_column(table, "SLOWEST_NODE", 0, 0);
+	scols_table_new_column(table, "NODE_DURATION", 0, 0);
+	scols_table_set_column_separator(table, "  ");
+
+	for (size_t i = 0; i < resp->n_stalls; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_worker_stall *s = &resp->stalls[i];
+
+		scols_line_sprintf(line, 0, "%u", s->cpu_id);
+		scols_line_sprintf(line, 1, "%.3fs", s->age_us / 1000000.0);
+		scols_line_sprintf(line, 2, "%.1fus", s->duration_ns / 1000.0);
+		scols_line_sprintf(line, 3, "%s", s->node);
+		scols_line_sprintf(line, 4, "%.1fus", s->node_ns / 1000.0);
+	}
+
+	if (resp->threshold_us == 0)
+		printf("watchdog disabled, enable with: set worker watchdog THRESHOLD\n");
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET),
+		"worker cpu CPU power POWER",
+		worker_set,
+		"Set the power policy of a datapath worker when idle.",
+		with_help("Worker CPU ID.", ec_node_uint("CPU", 0, UINT16_MAX - 1, 10)),
+		with_help(
+			"Power policy, unsupported policies fall back to sleep.",
+			ec_node_re("POWER", "auto|poll|sleep|intr|monitor|pause")
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW),
+		"worker",
+		worker_list,
+		"Display datapath workers and their power policy."
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET),
+		"worker watchdog THRESHOLD",
+		watchdog_set,
+		"Measure graph walk durations and log the ones longer than a threshold.",
+		with_help(
+			"Threshold in microseconds, 0 to disable.",
+			ec_node_uint("THRESHOLD", 0, UINT32_MAX, 10)
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW),
+		"worker stalls",
+		stall_list,
+		"Display the most recent graph walks longer than the watchdog threshold."
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "infra worker",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+}
@@ -0,0 +1,320 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_bench.h>
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+#include <gr_port.h>
+#include <gr_rcu.h>
+#include <gr_worker.h>
+
+#include <rte_byteorder.h>
+#include <rte_cycles.h>
+#include <rte_errno.h>
+#include <rte_ether.h>
+#include <rte_graph.h>
+#include <rte_ip.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_udp.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+
+#define BENCH_POOL_SIZE 32767
+#define BENCH_POOL_CACHE 256
+#define BENCH_DEFAULT_PKT_LEN (RTE_ETHER_MIN_LEN - RTE_ETHER_CRC_LEN)
+
+static struct gr_infra_bench_start_req params;
+static struct bench_template *template;
+// allocated on first use, packets may still be in flight after stopping
+static struct rte_mempool *pool;
+static uint64_t start_tsc;
+static bool active;
+
+static struct worker *bench_worker_find(uint16_t cpu_id) {
+	struct worker *worker;
+
+	STAILQ_FOREACH (worker, &workers, next) {
+		if (worker->cpu_id == cpu_id)
+			return worker;
+	}
+
+	return errno_set_null(ENOENT);
+}
+
+static bool bench_worker_selected(const struct worker *worker) {
+	if (params.n_cpus == 0)
+		return true;
+	for (uint16_t i = 0; i < params.n_cpus; i++) {
+		if (params.cpu_ids[i] == worker->cpu_id)
+			return true;
+	}
+	return false;
+}
+
+static const struct iface_info_port *bench_port_get(uint16_t iface_id, const struct iface **out) {
+	const struct iface *iface;
+
+	if ((iface = iface_from_id(iface_id)) == NULL)
+		return errno_set_null(ENODEV);
+	if (iface->type_id != GR_IFACE_TYPE_PORT)
+		return errno_set_null(EMEDIUMTYPE);
+	if (out != NULL)
+		*out = iface;
+
+	return (const struct iface_info_port *)iface->info;
+}
+
+static uint16_t bench_hdr_len(const struct gr_infra_bench_start_req *req) {
+	uint16_t len = BENCH_HDR_LEN;
+
+	if (req->vlan_id != 0)
+		len += sizeof(struct rte_vlan_hdr);
+	if (req->outer_dst != 0)
+		len += sizeof(struct rte_ipv4_hdr);
+
+	return len;
+}
+
+static void bench_ip_fill(
+	struct rte_ipv4_hdr *ip,
+	uint16_t len,
+	uint8_t proto,
+	ip4_addr_t src,
+	ip4_addr_t dst
+) {
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->total_length = rte_cpu_to_be_16(len);
+	ip->time_to_live = 64;
+	ip->next_proto_id = proto;
+	ip->src_addr = src;
+	ip->dst_addr = dst;
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+}
+
+static void
+bench_template_fill(struct bench_template *t, const struct gr_infra_bench_start_req *req) {
+	struct rte_ether_hdr *eth = (struct rte_ether_hdr *)t->hdr;
+	uint16_t len = t->pkt_len - sizeof(*eth);
+	rte_be16_t *ether_type = &eth->ether_type;
+	struct rte_ipv4_hdr *ip;
+	struct rte_vlan_hdr *vlan;
+	struct rte_udp_hdr *udp;
+	void *next = eth + 1;
+
+	memset(t->hdr, 0, sizeof(t->hdr));
+	if (rte_is_zero_ether_addr(&req->dst_mac))
+		iface_get_eth_addr(t->iface->id, &eth->dst_addr);
+	else
+		eth->dst_addr = req->dst_mac;
+	// locally administered, never used by a port
+	eth->src_addr = (struct rte_ether_addr) {{0x02, 0x00, 0x00, 0x00, 0x00, 0x01}};
+
+	if (req->vlan_id != 0) {
+		*ether_type = RTE_BE16(RTE_ETHER_TYPE_VLAN);
+		vlan = next;
+		vlan->vlan_tci = rte_cpu_to_be_16(req->vlan_id);
+		ether_type = &vlan->eth_proto;
+		len -= sizeof(*vlan);
+		next = vlan + 1;
+	}
+	*ether_type = RTE_BE16(RTE_ETHER_TYPE_IPV4);
+
+	if (req->outer_dst != 0) {
+		ip = next;
+		bench_ip_fill(ip, len, IPPROTO_IPIP, req->outer_src, req->outer_dst);
+		len -= sizeof(*ip);
+		next = ip + 1;
+	}
+
+	ip = next;
+	t->ip_offset = (uint8_t *)ip - t->hdr;
+	bench_ip_fill(ip, len, IPPROTO_UDP, req->src, req->dst);
+
+	// the UDP checksum is not set, the source port can be changed freely
+	udp = (struct rte_udp_hdr *)(ip + 1);
+	udp->dst_port = rte_cpu_to_be_16(req->dst_port);
+	udp->dgram_len = rte_cpu_to_be_16(len - sizeof(*ip));
+	udp->dgram_cksum = 0;
+}
+
+static void bench_workers_set(const struct bench_template *t) {
+	struct worker *worker;
+
+	STAILQ_FOREACH (worker, &workers, next) {
+		struct bench_worker *w = &bench_workers[worker->lcore_id];
+		const struct bench_template *cur = bench_worker_selected(worker) ? t : NULL;
+		__atomic_store_n(&w->template, cur, __ATOMIC_RELEASE);
+	}
+}
+
+int bench_start(const struct gr_infra_bench_start_req *req) {
+	const struct iface_info_port *port, *sink = NULL;
+	struct bench_template *t;
+	const struct iface *iface;
+	struct worker *worker;
+
+	if (active)
+		return errno_set(EBUSY);
+	if (req->n_cpus > GR_BENCH_MAX_CPUS || req->burst > RTE_GRAPH_BURST_SIZE)
+		return errno_set(EINVAL);
+	if (req->pkt_len != 0
+	    && (req->pkt_len < bench_hdr_len(req) || req->pkt_len > RTE_MBUF_DEFAULT_DATAROOM))
+		return errno_set(ERANGE);
+	if (req->vlan_id + RTE_MAX(req->n_vlans, 1) - 1 > RTE_ETHER_MAX_VLAN_ID
+	    || (req->n_vlans > 1 && req->vlan_id == 0))
+		return errno_set(ERANGE);
+	if ((req->outer_src == 0) != (req->outer_dst == 0))
+		return errno_set(EINVAL);
+	for (uint16_t i = 0; i < req->n_cpus; i++) {
+		if (bench_worker_find(req->cpu_ids[i]) == NULL)
+			return -errno;
+	}
+	if ((port = bench_port_get(req->iface_id, &iface)) == NULL)
+		return -errno;
+	if (req->sink_iface_id != GR_IFACE_ID_UNDEF
+	    && (sink = bench_port_get(req->sink_iface_id, NULL)) == NULL)
+		return -errno;
+
+	if (pool == NULL) {
+		pool = rte_pktmbuf_pool_create(
+			"bench",
+			BENCH_POOL_SIZE,
+			BENCH_POOL_CACHE,
+			GR_MBUF_PRIV_MAX_SIZE,
+			RTE_MBUF_DEFAULT_BUF_SIZE,
+			SOCKET_ID_ANY
+		);
+		if (pool == NULL)
+			return errno_log(rte_errno, "rte_pktmbuf_pool_create(bench)");
+	}
+
+	if ((t = rte_zmalloc(__func__, sizeof(*t), RTE_CACHE_LINE_SIZE)) == NULL)
+		return errno_set(ENOMEM);
+	t->iface = iface;
+	t->pool = pool;
+	t->port_id = port->port_id;
+	t->hdr_len = bench_hdr_len(req);
+	t->pkt_len = req->pkt_len ?: RTE_MAX(BENCH_DEFAULT_PKT_LEN, t->hdr_len);
+	t->burst = req->burst ?: RTE_GRAPH_BURST_SIZE;
+	t->src_port = req->src_port;
+	t->n_flows = req->n_flows ?: 1;
+	t->dst = rte_be_to_cpu_32(req->dst);
+	t->n_dsts = req->n_dsts ?: 1;
+	t->vlan_id = req->vlan_id;
+	t->n_vlans = req->n_vlans ?: 1;
+	bench_template_fill(t, req);
+
+	STAILQ_FOREACH (worker, &workers, next) {
+		struct bench_worker *w = &bench_workers[worker->lcore_id];
+		w->flow = 0;
+		w->dst = 0;
+		w->vlan = 0;
+		w->packets = 0;
+		w->no_mbuf = 0;
+		w->sink_packets = 0;
+		w->sink_bytes = 0;
+	}
+
+	params = *req;
+	params.pkt_len = t->pkt_len;
+	params.burst = t->burst;
+	params.n_flows = t->n_flows;
+	params.n_dsts = t->n_dsts;
+	params.n_vlans = t->n_vlans;
+	params.dst_mac = ((const struct rte_ether_hdr *)t->hdr)->dst_addr;
+	template = t;
+	start_tsc = rte_rdtsc();
+	active = true;
+	__atomic_store_n(
+		&bench_sink_port, sink ? sink->port_id : RTE_MAX_ETHPORTS, __ATOMIC_RELEASE
+	);
+	bench_workers_set(t);
+
+	return 0;
+}
+
+int bench_stop(void) {
+	if (!active)
+		return errno_set(ENOENT);
+
+	bench_workers_set(NULL);
+	__atomic_store_n(&bench_sink_port, RTE_MAX_ETHPORTS, __ATOMIC_RELEASE);
+	active = false;
+	// make sure that no worker is still using the template
+	gr_rcu_synchronize();
+	rte_free(template);
+	template = NULL;
+
+	return 0;
+}
+
+struct gr_infra_bench_get_resp *bench_get(size_t *len) {
+	struct gr_infra_bench_get_resp *resp;
+	struct worker *worker;
+	uint16_t n = 0;
+
+	STAILQ_FOREACH (worker, &workers, next)
+		n++;
+
+	*len = sizeof(*resp) + n * sizeof(resp->workers[0]);
+	if ((resp = calloc(1, *len)) == NULL)
+		return errno_set_null(ENOMEM);
+
+	resp->active = active;
+	if (!active)
+		return resp;
+
+	resp->params = params;
+	resp->duration_ns = (rte_rdtsc() - start_tsc) * 1000000000 / rte_get_tsc_hz();
+	n = 0;
+	STAILQ_FOREACH (worker, &workers, next) {
+		const struct bench_worker *w = &bench_workers[worker->lcore_id];
+		struct gr_bench_worker *o = &resp->workers[n++];
+		o->cpu_id = worker->cpu_id;
+		o->packets = __atomic_load_n(&w->packets, __ATOMIC_RELAXED);
+		o->no_mbuf = __atomic_load_n(&w->no_mbuf, __ATOMIC_RELAXED);
+		o->sink_packets = __atomic_load_n(&w->sink_packets, __ATOMIC_RELAXED);
+		o->sink_bytes = __atomic_load_n(&w->sink_bytes, __ATOMIC_RELAXED);
+	}
+	resp->n_workers = n;
+
+	return resp;
+}
+
+static void bench_iface_event(iface_event_t event, struct iface *iface) {
+	if (event != IFACE_EVENT_PRE_REMOVE || !active)
+		return;
+	if (iface->id == params.iface_id || iface->id == params.sink_iface_id) {
+		LOG(NOTICE, "%s removed, stopping benchmark", iface->name);
+		bench_stop();
+	}
+}
+
+static void bench_fini(struct event_base *) {
+	if (active)
+		bench_stop();
+	rte_mempool_free(pool);
+	pool = NULL;
+}
+
+static struct iface_event_handler bench_iface_event_handler = {
+	.callback = bench_iface_event,
+};
+
+static struct gr_module bench_module = {
+	.name = "bench",
+	.fini = bench_fini,
+	// after the ports are closed, their queues may hold packets from the pool
+	.fini_prio = 1100,
+};
+
+RTE_INIT(bench_constructor) {
+	gr_register_module(&bench_module);
+	iface_event_register_handler(&bench_iface_event_handler);
+}
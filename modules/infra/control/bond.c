@@ -0,0 +1,587 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_bond.h"
+
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_infra.h>
+#include <gr_log.h>
+#include <gr_macro.h>
+#include <gr_net_types.h>
+#include <gr_port.h>
+#include <gr_stb_ds.h>
+
+#include <event2/event.h>
+#include <rte_byteorder.h>
+#include <rte_errno.h>
+#include <rte_ether.h>
+#include <rte_ring.h>
+
+#include <string.h>
+
+static const struct rte_ether_addr lacp_dst_mac = LACP_DST_MAC;
+
+#define LACP_SYSTEM_PRIORITY 0xffff
+#define LACP_PORT_PRIORITY 0x00ff
+// Fast periodic rate and short timeout (IEEE 802.1AX section 6.4.4).
+#define LACP_TICK_SEC 1
+#define LACP_TIMEOUT_TICKS 3
+#define LACP_RING_SIZE 1024
+#define LACP_DEFAULT_STATE                                                                         \
+	(LACP_STATE_ACTIVITY | LACP_STATE_TIMEOUT | LACP_STATE_AGGREGATION | LACP_STATE_DEFAULTED)
+#define LACP_STATE_MUX (LACP_STATE_SYNC | LACP_STATE_COLLECTING | LACP_STATE_DISTRIBUTING)
+
+struct lacp_rx {
+	uint16_t port_id;
+	struct lacpdu pdu;
+};
+
+static struct rte_ring *lacp_ring;
+static struct event *lacp_rx_ev;
+static struct event *lacp_timer;
+
+// Rebuild the flow hash table from the active members. Buckets are updated in
+// place, packets in flight are sent either on the old or the new member.
+static void bond_update_tx_ports(struct iface *iface) {
+	struct iface_info_bond *bond = (struct iface_info_bond *)iface->info;
+	uint16_t ports[GR_BOND_MAX_MEMBERS];
+	uint16_t port_id;
+	unsigned n = 0;
+
+	for (unsigned i = 0; i < bond->n_members; i++) {
+		if (bond->members[i].active)
+			ports[n++] = bond->members[i].port_id;
+	}
+	for (unsigned b = 0; b < BOND_TX_BUCKETS; b++) {
+		port_id = n == 0 ? RTE_MAX_ETHPORTS : ports[b % n];
+		__atomic_store_n(&bond->tx_ports[b], port_id, __ATOMIC_RELAXED);
+	}
+
+	if (n > 0 && !(iface->state & GR_IFACE_S_RUNNING)) {
+		iface->state |= GR_IFACE_S_RUNNING;
+		iface_event_notify(IFACE_EVENT_PORT_LINK_CHANGE, iface);
+	} else if (n == 0 && iface->state & GR_IFACE_S_RUNNING) {
+		iface->state &= ~GR_IFACE_S_RUNNING;
+		iface_event_notify(IFACE_EVENT_PORT_LINK_CHANGE, iface);
+	}
+}
+
+static void bond_update_offloads(struct iface_info_bond *bond) {
+	const struct iface_info_port *port;
+	uint64_t offloads = UINT64_MAX;
+
+	for (unsigned i = 0; i < bond->n_members; i++) {
+		port = (const struct iface_info_port *)bond->members[i].iface->info;
+		offloads &= port->tx_offloads;
+	}
+	bond->tx_offloads = bond->n_members > 0 ? offloads : 0;
+}
+
+static void lacp_send(const struct iface *iface, unsigned index) {
+	const struct iface_info_bond *bond = (const struct iface_info_bond *)iface->info;
+	const struct bond_member *m = &bond->members[index];
+	struct lacpdu pdu = {
+		.subtype = LACP_SUBTYPE,
+		.version = LACP_VERSION,
+		.actor = {
+			.tlv_type = LACP_TLV_ACTOR,
+			.tlv_len = sizeof(struct lacp_participant),
+			.system_priority = RTE_BE16(LACP_SYSTEM_PRIORITY),
+			.system = bond->mac,
+			.key = rte_cpu_to_be_16(iface->id),
+			.port_priority = RTE_BE16(LACP_PORT_PRIORITY),
+			.port = rte_cpu_to_be_16(index + 1),
+			.state = m->actor_state,
+		},
+		.partner = m->partner,
+		.collector_tlv_type = LACP_TLV_COLLECTOR,
+		.collector_tlv_len = 16,
+	};
+
+	if (!(m->iface->state & GR_IFACE_S_RUNNING))
+		return;
+
+	pdu.partner.tlv_type = LACP_TLV_PARTNER;
+	pdu.partner.tlv_len = sizeof(struct lacp_participant);
+
+	if (lacp_output_send(m->port_id, &pdu) < 0)
+		LOG(DEBUG, "%s: lacp_output_send: %s", m->iface->name, strerror(errno));
+}
+
+static inline bool lacp_same_aggregator(
+	const struct lacp_participant *a,
+	const struct lacp_participant *b
+) {
+	return rte_is_same_ether_addr(&a->system, &b->system) && a->key == b->key
+		&& a->system_priority == b->system_priority;
+}
+
+// Simplified selection and mux machines: all members whose partner belongs to
+// the same aggregator as the first valid one are selected and collecting. They
+// are distributing as soon as the partner reports being in sync and collecting.
+static void lacp_select(struct iface *iface) {
+	struct iface_info_bond *bond = (struct iface_info_bond *)iface->info;
+	const struct lacp_participant *agg = NULL;
+	struct bond_member *m;
+	uint8_t state;
+
+	for (unsigned i = 0; i < bond->n_members; i++) {
+		m = &bond->members[i];
+		if ((m->iface->state & GR_IFACE_S_RUNNING) && m->partner_ttl > 0
+		    && (m->partner.state & LACP_STATE_AGGREGATION)) {
+			agg = &m->partner;
+			break;
+		}
+	}
+
+	for (unsigned i = 0; i < bond->n_members; i++) {
+		m = &bond->members[i];
+		state = m->actor_state & ~(LACP_STATE_MUX | LACP_STATE_DEFAULTED);
+		if (m->partner_ttl == 0) {
+			state |= LACP_STATE_DEFAULTED;
+		} else if (agg != NULL && (m->iface->state & GR_IFACE_S_RUNNING)
+			   && (m->partner.state & LACP_STATE_AGGREGATION)
+			   && lacp_same_aggregator(agg, &m->partner)) {
+			state |= LACP_STATE_SYNC | LACP_STATE_COLLECTING;
+			if ((m->partner.state & LACP_STATE_SYNC)
+			    && (m->partner.state & LACP_STATE_COLLECTING))
+				state |= LACP_STATE_DISTRIBUTING;
+		}
+		if (state != m->actor_state) {
+			m->actor_state = state;
+			// inform the partner immediately, do not wait for the next tick
+			lacp_send(iface, i);
+		}
+	}
+}
+
+// Select the members used for transmission and rebuild the flow hash table.
+static void bond_update(struct iface *iface) {
+	struct iface_info_bond *bond = (struct iface_info_bond *)iface->info;
+	struct bond_member *m;
+	bool active;
+
+	if (bond->mode == GR_BOND_MODE_LACP)
+		lacp_select(iface);
+
+	for (unsigned i = 0; i < bond->n_members; i++) {
+		m = &bond->members[i];
+		if (bond->mode == GR_BOND_MODE_LACP)
+			active = m->actor_state & LACP_STATE_DISTRIBUTING;
+		else
+			active = m->iface->state & GR_IFACE_S_RUNNING;
+		if (active != m->active)
+			LOG(INFO,
+			    "%s: member %s %s",
+			    iface->name,
+			    m->iface->name,
+			    active ? "active" : "inactive");
+		m->active = active;
+	}
+
+	bond_update_tx_ports(iface);
+}
+
+static int bond_get_members(
+	const struct iface *iface,
+	const struct gr_iface_info_bond *api,
+	struct iface **members
+) {
+	const struct iface_info_port *port;
+
+	if (api->n_members == 0 || api->n_members > GR_BOND_MAX_MEMBERS)
+		return errno_set(ERANGE);
+
+	for (unsigned i = 0; i < api->n_members; i++) {
+		if ((members[i] = iface_from_id(api->member_ids[i])) == NULL)
+			return -errno;
+		if (members[i]->type_id != GR_IFACE_TYPE_PORT)
+			return errno_set(EMEDIUMTYPE);
+		port = (const struct iface_info_port *)members[i]->info;
+		if (port->bond != NULL && port->bond != iface)
+			return errno_set(EBUSY);
+		for (unsigned j = 0; j < i; j++) {
+			if (members[j] == members[i])
+				return errno_set(EEXIST);
+		}
+	}
+
+	return 0;
+}
+
+static int bond_member_attach(struct iface *iface, struct iface *member) {
+	struct iface_info_bond *bond = (struct iface_info_bond *)iface->info;
+	struct iface_info_port *port = (struct iface_info_port *)member->info;
+	struct bond_member *m = &bond->members[bond->n_members];
+	const struct rte_ether_addr *mac;
+	int ret;
+
+	if ((ret = iface_add_eth_addr(member->id, &bond->mac)) < 0)
+		return ret;
+	if (bond->mode == GR_BOND_MODE_LACP) {
+		if ((ret = iface_add_eth_addr(member->id, &lacp_dst_mac)) < 0) {
+			iface_del_eth_addr(member->id, &bond->mac);
+			return ret;
+		}
+	}
+	arrforeach (mac, bond->mcast_macs) {
+		if (iface_add_eth_addr(member->id, mac) < 0)
+			LOG(WARNING,
+			    "%s: cannot add " ETH_ADDR_FMT ": %s",
+			    member->name,
+			    ETH_ADDR_SPLIT(mac),
+			    strerror(errno));
+	}
+
+	memset(m, 0, sizeof(*m));
+	m->iface = member;
+	m->port_id = port->port_id;
+	m->actor_state = LACP_DEFAULT_STATE;
+	bond->n_members++;
+
+	iface_add_subinterface(member, iface);
+	// from now on, packets received on the member are input on the bond
+	__atomic_store_n(&port->bond, iface, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+static void bond_members_detach(struct iface *iface) {
+	struct iface_info_bond *bond = (struct iface_info_bond *)iface->info;
+	const struct rte_ether_addr *mac;
+	struct iface_info_port *port;
+	struct bond_member *m;
+
+	for (unsigned i = 0; i < bond->n_members; i++) {
+		m = &bond->members[i];
+		port = (struct iface_info_port *)m->iface->info;
+		__atomic_store_n(&port->bond, NULL, __ATOMIC_RELEASE);
+		iface_del_subinterface(m->iface, iface);
+
+		// remove mac filters (ignore errors)
+		arrforeach (mac, bond->mcast_macs)
+			iface_del_eth_addr(m->iface->id, mac);
+		if (bond->mode == GR_BOND_MODE_LACP)
+			iface_del_eth_addr(m->iface->id, &lacp_dst_mac);
+		iface_del_eth_addr(m->iface->id, &bond->mac);
+	}
+	bond->n_members = 0;
+	bond_update_tx_ports(iface);
+}
+
+static int iface_bond_reconfig(
+	struct iface *iface,
+	uint64_t set_attrs,
+	uint16_t flags,
+	uint16_t mtu,
+	uint16_t vrf_id,
+	const void *api_info
+) {
+	struct iface_info_bond *bond = (struct iface_info_bond *)iface->info;
+	const struct gr_iface_info_bond *api = api_info;
+	struct iface *members[GR_BOND_MAX_MEMBERS];
+	const struct iface_info_port *port;
+	struct rte_ether_addr mac;
+	uint8_t n_members, mode;
+	int ret = 0;
+
+	mode = bond->mode;
+	if (set_attrs & GR_BOND_SET_MODE) {
+		if (api->mode != GR_BOND_MODE_BALANCE && api->mode != GR_BOND_MODE_LACP)
+			return errno_set(EINVAL);
+		mode = api->mode;
+	}
+
+	n_members = bond->n_members;
+	if (set_attrs & GR_BOND_SET_MEMBERS) {
+		if (bond_get_members(iface, api, members) < 0)
+			return -errno;
+		n_members = api->n_members;
+	} else {
+		for (unsigned i = 0; i < n_members; i++)
+			members[i] = bond->members[i].iface;
+	}
+
+	mac = bond->mac;
+	if ((set_attrs & GR_BOND_SET_MAC) && !rte_is_zero_ether_addr(&api->mac)) {
+		mac = api->mac;
+	} else if (rte_is_zero_ether_addr(&mac) && n_members > 0) {
+		port = (const struct iface_info_port *)members[0]->info;
+		mac = port->mac;
+	}
+
+	if (set_attrs & (GR_BOND_SET_MODE | GR_BOND_SET_MEMBERS | GR_BOND_SET_MAC)) {
+		bond_members_detach(iface);
+		bond->mode = mode;
+		bond->mac = mac;
+		for (unsigned i = 0; i < n_members; i++) {
+			if ((ret = bond_member_attach(iface, members[i])) < 0)
+				break;
+		}
+		bond_update_offloads(bond);
+		bond_update(iface);
+		if (bond->n_members != n_members)
+			return ret;
+	}
+
+	if (set_attrs & GR_IFACE_SET_FLAGS)
+		iface->flags = flags;
+	if (set_attrs & GR_IFACE_SET_MTU)
+		iface->mtu = mtu;
+	if (set_attrs & GR_IFACE_SET_VRF)
+		iface->vrf_id = vrf_id;
+
+	return 0;
+}
+
+static int iface_bond_fini(struct iface *iface) {
+	struct iface_info_bond *bond = (struct iface_info_bond *)iface->info;
+
+	bond_members_detach(iface);
+	arrfree(bond->mcast_macs);
+
+	return 0;
+}
+
+static int iface_bond_init(struct iface *iface, const void *api_info) {
+	int ret;
+
+	ret = iface_bond_reconfig(
+		iface, IFACE_SET_ALL, iface->flags, iface->mtu, iface->vrf_id, api_info
+	);
+	if (ret < 0) {
+		iface_bond_fini(iface);
+		errno = -ret;
+	}
+
+	return ret;
+}
+
+static int iface_bond_get_eth_addr(const struct iface *iface, struct rte_ether_addr *mac) {
+	const struct iface_info_bond *bond = (const struct iface_info_bond *)iface->info;
+	*mac = bond->mac;
+	return 0;
+}
+
+static int iface_bond_add_eth_addr(struct iface *iface, const struct rte_ether_addr *mac) {
+	struct iface_info_bond *bond = (struct iface_info_bond *)iface->info;
+	int ret;
+
+	if (mac == NULL || !rte_is_multicast_ether_addr(mac))
+		return errno_set(EINVAL);
+
+	for (unsigned i = 0; i < bond->n_members; i++) {
+		if ((ret = iface_add_eth_addr(bond->members[i].iface->id, mac)) < 0) {
+			while (i-- > 0)
+				iface_del_eth_addr(bond->members[i].iface->id, mac);
+			return ret;
+		}
+	}
+	// remembered for members attached later
+	arrpush(bond->mcast_macs, *mac);
+
+	return 0;
+}
+
+static int iface_bond_del_eth_addr(struct iface *iface, const struct rte_ether_addr *mac) {
+	struct iface_info_bond *bond = (struct iface_info_bond *)iface->info;
+	int ret, status = 0;
+
+	if (mac == NULL || !rte_is_multicast_ether_addr(mac))
+		return errno_set(EINVAL);
+
+	for (int i = 0; i < arrlen(bond->mcast_macs); i++) {
+		if (rte_is_same_ether_addr(&bond->mcast_macs[i], mac)) {
+			arrdelswap(bond->mcast_macs, i);
+			break;
+		}
+	}
+	for (unsigned i = 0; i < bond->n_members; i++) {
+		ret = iface_del_eth_addr(bond->members[i].iface->id, mac);
+		if (status == 0 && ret < 0)
+			status = ret;
+	}
+
+	return status;
+}
+
+static void bond_to_api(void *info, const struct iface *iface) {
+	const struct iface_info_bond *bond = (const struct iface_info_bond *)iface->info;
+	struct gr_iface_info_bond *api = info;
+
+	api->mode = bond->mode;
+	api->n_members = bond->n_members;
+	api->mac = bond->mac;
+	api->active_members = 0;
+	for (unsigned i = 0; i < bond->n_members; i++) {
+		api->member_ids[i] = bond->members[i].iface->id;
+		if (bond->members[i].active)
+			api->active_members |= GR_BIT8(i);
+	}
+}
+
+static struct iface_type iface_type_bond = {
+	.id = GR_IFACE_TYPE_BOND,
+	.name = "bond",
+	.info_size = sizeof(struct iface_info_bond),
+	.init = iface_bond_init,
+	.reconfig = iface_bond_reconfig,
+	.fini = iface_bond_fini,
+	.get_eth_addr = iface_bond_get_eth_addr,
+	.add_eth_addr = iface_bond_add_eth_addr,
+	.del_eth_addr = iface_bond_del_eth_addr,
+	.to_api = bond_to_api,
+};
+
+// Return the bond interface of which port_id is a member.
+static struct iface *bond_from_port_id(uint16_t port_id, struct bond_member **member) {
+	const struct iface_info_port *port;
+	struct iface_info_bond *bond;
+	const struct iface *iface;
+	struct iface *bond_iface;
+
+	if ((iface = port_get_iface(port_id)) == NULL)
+		return NULL;
+	port = (const struct iface_info_port *)iface->info;
+	if (port->bond == NULL || (bond_iface = iface_from_id(port->bond->id)) == NULL)
+		return NULL;
+
+	bond = (struct iface_info_bond *)bond_iface->info;
+	for (unsigned i = 0; i < bond->n_members; i++) {
+		if (bond->members[i].port_id == port_id) {
+			*member = &bond->members[i];
+			return bond_iface;
+		}
+	}
+
+	return NULL;
+}
+
+int bond_lacp_input(uint16_t port_id, const struct lacpdu *pdu) {
+	struct lacp_rx rx = {.port_id = port_id, .pdu = *pdu};
+	int ret = 0;
+
+	if (rte_ring_enqueue_elem(lacp_ring, &rx, sizeof(rx)) < 0)
+		ret = errno_set(ENOBUFS);
+	// The PDU may come from any dataplane thread. Defer the processing to
+	// the event loop running in the main lcore.
+	event_active(lacp_rx_ev, 0, 0);
+	return ret;
+}
+
+static void lacp_rx_cb(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	struct lacp_rx rxs[32];
+	struct iface_info_bond *bond;
+	struct bond_member *m;
+	struct iface *iface;
+	unsigned n;
+
+	n = rte_ring_dequeue_burst_elem(lacp_ring, rxs, sizeof(*rxs), ARRAY_DIM(rxs), NULL);
+
+	for (unsigned i = 0; i < n; i++) {
+		if ((iface = bond_from_port_id(rxs[i].port_id, &m)) == NULL)
+			continue;
+		bond = (struct iface_info_bond *)iface->info;
+		if (bond->mode != GR_BOND_MODE_LACP)
+			continue;
+		m->partner = rxs[i].pdu.actor;
+		m->partner_ttl = LACP_TIMEOUT_TICKS;
+		bond_update(iface);
+	}
+
+	if (!rte_ring_empty(lacp_ring))
+		event_active(lacp_rx_ev, 0, 0);
+}
+
+// Expire partners that went silent and send the periodic LACPDUs.
+static void lacp_timer_cb(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	struct iface_info_bond *bond;
+	struct iface *iface = NULL;
+	struct bond_member *m;
+
+	while ((iface = iface_next(GR_IFACE_TYPE_BOND, iface)) != NULL) {
+		bond = (struct iface_info_bond *)iface->info;
+		if (bond->mode != GR_BOND_MODE_LACP)
+			continue;
+		for (unsigned i = 0; i < bond->n_members; i++) {
+			m = &bond->members[i];
+			if (m->partner_ttl > 0 && --m->partner_ttl == 0) {
+				LOG(INFO, "%s: lacp partner expired", m->iface->name);
+				memset(&m->partner, 0, sizeof(m->partner));
+			}
+		}
+		bond_update(iface);
+		for (unsigned i = 0; i < bond->n_members; i++)
+			lacp_send(iface, i);
+	}
+}
+
+// Rebuild the flow hash table when a member port goes up or down, the graph
+// does not need to be reloaded.
+static void bond_iface_event_handler(iface_event_t event, struct iface *iface) {
+	const struct iface_info_port *port;
+	struct iface *bond_iface;
+
+	if (event != IFACE_EVENT_PORT_LINK_CHANGE && event != IFACE_EVENT_PORT_POST_RECONFIG)
+		return;
+	if (iface->type_id != GR_IFACE_TYPE_PORT)
+		return;
+	port = (const struct iface_info_port *)iface->info;
+	if (port->bond == NULL || (bond_iface = iface_from_id(port->bond->id)) == NULL)
+		return;
+
+	if (event == IFACE_EVENT_PORT_POST_RECONFIG)
+		bond_update_offloads((struct iface_info_bond *)bond_iface->info);
+	bond_update(bond_iface);
+}
+
+static void bond_init(struct event_base *ev_base) {
+	struct timeval tv = {.tv_sec = LACP_TICK_SEC};
+
+	lacp_ring = rte_ring_create_elem(
+		"bond_lacp",
+		sizeof(struct lacp_rx),
+		LACP_RING_SIZE,
+		SOCKET_ID_ANY,
+		RING_F_MP_RTS_ENQ | RING_F_SC_DEQ
+	);
+	if (lacp_ring == NULL)
+		ABORT("rte_ring_create(bond_lacp): %s", rte_strerror(rte_errno));
+
+	lacp_rx_ev = gr_event_new(ev_base, -1, EV_FINALIZE, lacp_rx_cb, NULL);
+	if (lacp_rx_ev == NULL)
+		ABORT("gr_event_new() failed");
+
+	lacp_timer = gr_event_new(ev_base, -1, EV_PERSIST | EV_FINALIZE, lacp_timer_cb, NULL);
+	if (lacp_timer == NULL)
+		ABORT("gr_event_new() failed");
+	if (event_add(lacp_timer, &tv) < 0)
+		ABORT("event_add() failed");
+}
+
+static void bond_fini(struct event_base *) {
+	gr_event_free(lacp_timer);
+	lacp_timer = NULL;
+	gr_event_free(lacp_rx_ev);
+	lacp_rx_ev = NULL;
+	rte_ring_free(lacp_ring);
+	lacp_ring = NULL;
+}
+
+static struct gr_module bond_module = {
+	.name = "bond",
+	.init = bond_init,
+	.fini = bond_fini,
+	.fini_prio = 1000,
+};
+
+static struct iface_event_handler bond_iface_event = {
+	.callback = bond_iface_event_handler,
+};
+
+RTE_INIT(bond_constructor) {
+	gr_register_module(&bond_module);
+	iface_type_register(&iface_type_bond);
+	iface_event_register_handler(&bond_iface_event);
+}
@@ -0,0 +1,376 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_capture.h>
+#include <gr_control.h>
+#include <gr_graph.h>
+#include <gr_iface.h>
+#include <gr_log.h>
+#include <gr_port.h>
+#include <gr_rcu.h>
+#include <gr_worker.h>
+
+#include <event2/event.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_graph_worker.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_pcapng.h>
+#include <rte_ring.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define CAPTURE_RING_SIZE 4096
+#define CAPTURE_POOL_SIZE 16383
+#define CAPTURE_POOL_CACHE 256
+#define CAPTURE_DRAIN_BURST 256
+#define CAPTURE_DRAIN_PERIOD_US 10000
+
+// Packet copies made by one worker, waiting to be written to the pcapng file.
+// The worker is the only ring producer and the only writer of the counters.
+// The drain event dequeues the copies and sums the counters, which are only
+// reset by capture_start before any worker enqueues into the new ring.
+struct __rte_cache_aligned capture_worker {
+	struct rte_ring *ring; // single producer, drained by the control plane
+	uint64_t packets;
+	uint64_t ring_full;
+	uint64_t no_mbuf;
+};
+
+static struct capture_worker capture_workers[RTE_MAX_LCORE];
+static struct gr_infra_capture_start_req params;
+static rte_node_t node_ids[GR_CAPTURE_MAX_NODES];
+static uint16_t port_filter;
+static uint32_t snaplen;
+static struct rte_mempool *pool;
+static rte_pcapng_t *pcapng;
+static struct event_base *capture_ev_base;
+static struct event *drain_ev;
+static uint64_t written;
+static uint64_t write_errors;
+static bool active;
+
+static void capture_enqueue(struct capture_worker *w, struct rte_mbuf **copies, unsigned n) {
+	unsigned enq = rte_ring_sp_enqueue_burst(w->ring, (void **)copies, n, NULL);
+	if (enq < n) {
+		rte_pktmbuf_free_bulk(&copies[enq], n - enq);
+		w->ring_full += n - enq;
+	}
+	w->packets += enq;
+}
+
+static uint16_t
+capture_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct capture_worker *w = &capture_workers[rte_lcore_id()];
+	struct rte_mbuf *copies[RTE_GRAPH_BURST_SIZE];
+	struct rte_mbuf *m;
+	unsigned n = 0;
+
+	if (w->ring == NULL)
+		goto process;
+
+	// Copy before processing, the node may modify or free the packets.
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		m = objs[i];
+		if (m->port >= RTE_MAX_ETHPORTS)
+			continue; // not associated with a port yet
+		if (port_filter != RTE_MAX_ETHPORTS && m->port != port_filter)
+			continue;
+		copies[n] = rte_pcapng_copy(
+			m->port, 0, m, pool, snaplen, RTE_PCAPNG_DIRECTION_UNKNOWN, node->name
+		);
+		if (copies[n] == NULL) {
+			w->no_mbuf++;
+			continue;
+		}
+		if (++n == ARRAY_DIM(copies)) {
+			capture_enqueue(w, copies, n);
+			n = 0;
+		}
+	}
+	if (n > 0)
+		capture_enqueue(w, copies, n);
+process:
+	return gr_node_process(node->id)(graph, node, objs, nb_objs);
+}
+
+static void capture_graph_set(struct rte_graph *graph, bool enable) {
+	struct rte_node *node;
+	rte_node_process_t process;
+
+	for (unsigned i = 0; i < params.n_nodes; i++) {
+		if ((node = rte_graph_node_get(graph->id, node_ids[i])) == NULL)
+			continue;
+		process = enable ? capture_process : gr_node_process(node_ids[i]);
+		__atomic_store_n(&node->process, process, __ATOMIC_RELEASE);
+	}
+}
+
+void capture_graph_apply(struct rte_graph *graph) {
+	if (active)
+		capture_graph_set(graph, true);
+}
+
+static void capture_workers_set(bool enable) {
+	struct worker *worker;
+
+	STAILQ_FOREACH (worker, &workers, next) {
+		for (unsigned i = 0; i < ARRAY_DIM(worker->graph); i++) {
+			if (worker->graph[i] != NULL)
+				capture_graph_set(worker->graph[i], enable);
+		}
+	}
+}
+
+static void capture_drain(void) {
+	struct rte_mbuf *mbufs[CAPTURE_DRAIN_BURST];
+	unsigned n;
+
+	for (unsigned i = 0; i < RTE_MAX_LCORE; i++) {
+		if (capture_workers[i].ring == NULL)
+			continue;
+		while ((n = rte_ring_sc_dequeue_burst(
+				capture_workers[i].ring, (void **)mbufs, ARRAY_DIM(mbufs), NULL
+			))
+		       > 0) {
+			if (rte_pcapng_write_packets(pcapng, mbufs, n) < 0)
+				write_errors += n;
+			else
+				written += n;
+			rte_pktmbuf_free_bulk(mbufs, n);
+		}
+	}
+}
+
+static void capture_drain_cb(evutil_socket_t, short, void *) {
+	capture_drain();
+}
+
+static const struct rte_node_register *capture_node_find(const char *name) {
+	struct gr_node_info *info;
+
+	STAILQ_FOREACH (info, &node_infos, next) {
+		if (strcmp(info->node->name, name) == 0)
+			return info->node;
+	}
+
+	return errno_set_null(ENOENT);
+}
+
+static int capture_open(const struct gr_infra_capture_start_req *req) {
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	int fd;
+
+	if (!req->unix_socket) {
+		fd = open(req->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd < 0)
+			return errno_log(errno, "open");
+		return fd;
+	}
+
+	memccpy(addr.sun_path, req->path, 0, sizeof(addr.sun_path) - 1);
+	if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+		return errno_log(errno, "socket");
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		int err = errno;
+		close(fd);
+		return errno_log(err, "connect");
+	}
+	// never block the control plane on a slow reader
+	if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
+		int err = errno;
+		close(fd);
+		return errno_log(err, "fcntl");
+	}
+
+	return fd;
+}
+
+static void capture_cleanup(void) {
+	if (drain_ev != NULL) {
+		gr_event_free(drain_ev);
+		drain_ev = NULL;
+	}
+	if (pcapng != NULL)
+		capture_drain();
+	for (unsigned i = 0; i < RTE_MAX_LCORE; i++) {
+		rte_ring_free(capture_workers[i].ring);
+		capture_workers[i].ring = NULL;
+	}
+	if (pcapng != NULL) {
+		rte_pcapng_close(pcapng);
+		pcapng = NULL;
+	}
+	rte_mempool_free(pool);
+	pool = NULL;
+}
+
+int capture_start(const struct gr_infra_capture_start_req *req) {
+	struct timeval tv = {.tv_usec = CAPTURE_DRAIN_PERIOD_US};
+	const struct rte_node_register *reg;
+	char name[RTE_RING_NAMESIZE];
+	const struct iface *iface;
+	struct worker *worker;
+	uint16_t port_id;
+	int fd, ret;
+
+	if (active)
+		return errno_set(EBUSY);
+	if (req->n_nodes == 0 || req->n_nodes > GR_CAPTURE_MAX_NODES)
+		return errno_set(EINVAL);
+	if (strnlen(req->path, sizeof(req->path)) == sizeof(req->path))
+		return errno_set(ENAMETOOLONG);
+
+	for (unsigned i = 0; i < req->n_nodes; i++) {
+		if (strnlen(req->nodes[i], sizeof(req->nodes[i])) == sizeof(req->nodes[i]))
+			return errno_set(ENAMETOOLONG);
+		if ((reg = capture_node_find(req->nodes[i])) == NULL)
+			return -errno;
+		// packets are produced by the process function of source nodes
+		if (reg->flags & RTE_NODE_SOURCE_F)
+			return errno_set(ENOTSUP);
+		node_ids[i] = reg->id;
+	}
+
+	port_filter = RTE_MAX_ETHPORTS;
+	if (req->iface_id != GR_IFACE_ID_UNDEF) {
+		if ((iface = iface_from_id(req->iface_id)) == NULL)
+			return errno_set(ENODEV);
+		if (iface->type_id != GR_IFACE_TYPE_PORT)
+			return errno_set(EMEDIUMTYPE);
+		port_filter = ((const struct iface_info_port *)iface->info)->port_id;
+	}
+	snaplen = req->snaplen ?: UINT32_MAX;
+
+	pool = rte_pktmbuf_pool_create(
+		"capture",
+		CAPTURE_POOL_SIZE,
+		CAPTURE_POOL_CACHE,
+		0,
+		rte_pcapng_mbuf_size(RTE_MBUF_DEFAULT_DATAROOM),
+		SOCKET_ID_ANY
+	);
+	if (pool == NULL)
+		return errno_log(rte_errno, "rte_pktmbuf_pool_create(capture)");
+
+	if ((fd = capture_open(req)) < 0) {
+		ret = fd;
+		goto err;
+	}
+	pcapng = rte_pcapng_fdopen(fd, NULL, NULL, "grout " GROUT_VERSION, NULL);
+	if (pcapng == NULL) {
+		close(fd);
+		ret = errno_log(rte_errno, "rte_pcapng_fdopen");
+		goto err;
+	}
+	RTE_ETH_FOREACH_DEV(port_id) {
+		iface = port_get_iface(port_id);
+		ret = rte_pcapng_add_interface(
+			pcapng, port_id, iface ? iface->name : NULL, NULL, NULL
+		);
+		if (ret < 0) {
+			ret = errno_log(-ret, "rte_pcapng_add_interface");
+			goto err;
+		}
+	}
+
+	STAILQ_FOREACH (worker, &workers, next) {
+		struct capture_worker *w = &capture_workers[worker->lcore_id];
+		snprintf(name, sizeof(name), "capture_%u", worker->lcore_id);
+		w->ring = rte_ring_create(
+			name,
+			CAPTURE_RING_SIZE,
+			rte_lcore_to_socket_id(worker->lcore_id),
+			RING_F_SP_ENQ | RING_F_SC_DEQ
+		);
+		if (w->ring == NULL) {
+			ret = errno_log(rte_errno, "rte_ring_create");
+			goto err;
+		}
+		w->packets = 0;
+		w->ring_full = 0;
+		w->no_mbuf = 0;
+	}
+
+	drain_ev = gr_event_new(
+		capture_ev_base, -1, EV_PERSIST | EV_FINALIZE, capture_drain_cb, NULL
+	);
+	if (drain_ev == NULL || event_add(drain_ev, &tv) < 0) {
+		ret = errno_set(ENOMEM);
+		goto err;
+	}
+
+	params = *req;
+	written = 0;
+	write_errors = 0;
+	active = true;
+	capture_workers_set(true);
+
+	return 0;
+err:
+	capture_cleanup();
+	return ret;
+}
+
+int capture_stop(void) {
+	if (!active)
+		return errno_set(ENOENT);
+
+	capture_workers_set(false);
+	active = false;
+	// make sure that no worker is still copying packets
+	gr_rcu_synchronize();
+	capture_cleanup();
+
+	return 0;
+}
+
+void capture_get(struct gr_infra_capture_get_resp *resp) {
+	memset(resp, 0, sizeof(*resp));
+	resp->active = active;
+	if (!active)
+		return;
+
+	resp->n_nodes = params.n_nodes;
+	memcpy(resp->nodes, params.nodes, sizeof(resp->nodes));
+	resp->iface_id = params.iface_id;
+	resp->snaplen = params.snaplen;
+	memcpy(resp->path, params.path, sizeof(resp->path));
+	for (unsigned i = 0; i < RTE_MAX_LCORE; i++) {
+		const struct capture_worker *w = &capture_workers[i];
+		resp->packets += __atomic_load_n(&w->packets, __ATOMIC_RELAXED);
+		resp->ring_full += __atomic_load_n(&w->ring_full, __ATOMIC_RELAXED);
+		resp->no_mbuf += __atomic_load_n(&w->no_mbuf, __ATOMIC_RELAXED);
+	}
+	resp->written = written;
+	resp->write_errors = write_errors;
+}
+
+static void capture_init(struct event_base *ev_base) {
+	capture_ev_base = ev_base;
+}
+
+static void capture_fini(struct event_base *) {
+	if (active)
+		capture_stop();
+}
+
+static struct gr_module capture_module = {
+	.name = "capture",
+	.init = capture_init,
+	.fini = capture_fini,
+	.fini_prio = -1000,
+};
+
+RTE_INIT(capture_constructor) {
+	gr_register_module(&capture_module);
+}
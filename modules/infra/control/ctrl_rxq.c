@@ -0,0 +1,230 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_iface.h>
+#include <gr_log.h>
+#include <gr_port.h>
+#include <gr_stb_ds.h>
+#include <gr_vlan.h>
+
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_flow.h>
+#include <rte_ip6.h>
+
+#include <netinet/icmp6.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+
+static struct rte_flow *
+ctrl_flow_create(const struct iface_info_port *p, const struct rte_flow_item *pattern) {
+	const struct rte_flow_attr attr = {.ingress = 1};
+	const struct rte_flow_action_queue queue = {.index = port_ctrl_rxq(p)};
+	const struct rte_flow_action actions[] = {
+		{.type = RTE_FLOW_ACTION_TYPE_QUEUE, .conf = &queue},
+		{.type = RTE_FLOW_ACTION_TYPE_END},
+	};
+	struct rte_flow_error err;
+	struct rte_flow *flow;
+
+	memset(&err, 0, sizeof(err));
+	flow = rte_flow_create(p->port_id, &attr, pattern, actions, &err);
+	if (flow == NULL)
+		LOG(NOTICE,
+		    "port %u: rte_flow_create: %s",
+		    p->port_id,
+		    err.message ? err.message : rte_strerror(rte_errno));
+
+	return flow;
+}
+
+static struct rte_flow *ctrl_flow_arp(const struct iface_info_port *p) {
+	const struct rte_flow_item_eth spec = {.hdr.ether_type = RTE_BE16(RTE_ETHER_TYPE_ARP)};
+	const struct rte_flow_item_eth mask = {.hdr.ether_type = RTE_BE16(0xffff)};
+	const struct rte_flow_item pattern[] = {
+		{.type = RTE_FLOW_ITEM_TYPE_ETH, .spec = &spec, .mask = &mask},
+		{.type = RTE_FLOW_ITEM_TYPE_END},
+	};
+	return ctrl_flow_create(p, pattern);
+}
+
+static struct rte_flow *ctrl_flow_ndp(const struct iface_info_port *p, uint8_t icmp6_type) {
+	const struct rte_flow_item_ipv6 ip_spec = {.hdr.proto = IPPROTO_ICMPV6};
+	const struct rte_flow_item_ipv6 ip_mask = {.hdr.proto = 0xff};
+	const struct rte_flow_item_icmp6 icmp_spec = {.type = icmp6_type};
+	const struct rte_flow_item_icmp6 icmp_mask = {.type = 0xff};
+	const struct rte_flow_item pattern[] = {
+		{.type = RTE_FLOW_ITEM_TYPE_ETH},
+		{.type = RTE_FLOW_ITEM_TYPE_IPV6, .spec = &ip_spec, .mask = &ip_mask},
+		{.type = RTE_FLOW_ITEM_TYPE_ICMP6, .spec = &icmp_spec, .mask = &icmp_mask},
+		{.type = RTE_FLOW_ITEM_TYPE_END},
+	};
+	return ctrl_flow_create(p, pattern);
+}
+
+static struct rte_flow *
+ctrl_flow_addr(const struct iface_info_port *p, const struct port_ctrl_addr *addr) {
+	struct rte_flow_item pattern[] = {
+		{.type = RTE_FLOW_ITEM_TYPE_ETH},
+		{.type = RTE_FLOW_ITEM_TYPE_VOID},
+		{.type = RTE_FLOW_ITEM_TYPE_END},
+	};
+	struct rte_flow_item_ipv6 ip6_spec, ip6_mask;
+	struct rte_flow_item_ipv4 ip4_spec, ip4_mask;
+
+	switch (addr->af) {
+	case AF_INET:
+		memset(&ip4_spec, 0, sizeof(ip4_spec));
+		memset(&ip4_mask, 0, sizeof(ip4_mask));
+		ip4_spec.hdr.dst_addr = addr->ip4;
+		ip4_mask.hdr.dst_addr = RTE_BE32(0xffffffff);
+		pattern[1].type = RTE_FLOW_ITEM_TYPE_IPV4;
+		pattern[1].spec = &ip4_spec;
+		pattern[1].mask = &ip4_mask;
+		break;
+	case AF_INET6:
+		memset(&ip6_spec, 0, sizeof(ip6_spec));
+		memset(&ip6_mask, 0, sizeof(ip6_mask));
+		ip6_spec.hdr.dst_addr = addr->ip6;
+		memset(&ip6_mask.hdr.dst_addr, 0xff, sizeof(ip6_mask.hdr.dst_addr));
+		pattern[1].type = RTE_FLOW_ITEM_TYPE_IPV6;
+		pattern[1].spec = &ip6_spec;
+		pattern[1].mask = &ip6_mask;
+		break;
+	default:
+		return errno_set_null(EAFNOSUPPORT);
+	}
+
+	return ctrl_flow_create(p, pattern);
+}
+
+static void ctrl_flow_destroy(const struct iface_info_port *p, struct rte_flow **flow) {
+	struct rte_flow_error err;
+
+	if (*flow == NULL)
+		return;
+	if (rte_flow_destroy(p->port_id, *flow, &err) < 0)
+		LOG(NOTICE, "port %u: rte_flow_destroy: %s", p->port_id, err.message);
+	*flow = NULL;
+}
+
+void port_ctrl_flows_destroy(struct iface_info_port *p) {
+	struct port_ctrl_addr *addr;
+	struct rte_flow **flow;
+
+	arrforeach (flow, p->ctrl_flows)
+		ctrl_flow_destroy(p, flow);
+	arrfree(p->ctrl_flows);
+	p->ctrl_flows = NULL;
+	arrforeach (addr, p->ctrl_addrs)
+		ctrl_flow_destroy(p, &addr->flow);
+}
+
+int port_ctrl_flows_apply(struct iface_info_port *p) {
+	static const uint8_t ndp_types[] = {
+		ND_ROUTER_SOLICIT,
+		ND_ROUTER_ADVERT,
+		ND_NEIGHBOR_SOLICIT,
+		ND_NEIGHBOR_ADVERT,
+		ND_REDIRECT,
+	};
+	struct port_ctrl_addr *addr;
+	struct rte_flow *flow;
+
+	port_ctrl_flows_destroy(p);
+	if (!p->ctrl_rxq)
+		return 0;
+
+	if ((flow = ctrl_flow_arp(p)) != NULL)
+		arrpush(p->ctrl_flows, flow);
+	for (unsigned i = 0; i < ARRAY_DIM(ndp_types); i++) {
+		if ((flow = ctrl_flow_ndp(p, ndp_types[i])) != NULL)
+			arrpush(p->ctrl_flows, flow);
+	}
+	arrforeach (addr, p->ctrl_addrs)
+		addr->flow = ctrl_flow_addr(p, addr);
+
+	LOG(INFO,
+	    "port %u: control traffic steered to rxq %u (%zu rules)",
+	    p->port_id,
+	    port_ctrl_rxq(p),
+	    (size_t)arrlen(p->ctrl_flows) + arrlen(p->ctrl_addrs));
+
+	return 0;
+}
+
+void port_ctrl_fini(struct iface_info_port *p) {
+	port_ctrl_flows_destroy(p);
+	arrfree(p->ctrl_addrs);
+	p->ctrl_addrs = NULL;
+}
+
+// Addresses of VLAN sub-interfaces are received on their parent port.
+static struct iface_info_port *ctrl_port(uint16_t iface_id) {
+	struct iface *iface = iface_from_id(iface_id);
+	const struct iface_info_vlan *vlan;
+
+	if (iface != NULL && iface->type_id == GR_IFACE_TYPE_VLAN) {
+		vlan = (const struct iface_info_vlan *)iface->info;
+		iface = iface_from_id(vlan->parent_id);
+	}
+	if (iface == NULL || iface->type_id != GR_IFACE_TYPE_PORT)
+		return NULL;
+
+	return (struct iface_info_port *)iface->info;
+}
+
+static bool ctrl_addr_equal(const struct port_ctrl_addr *a, int af, const void *addr) {
+	if (a->af != af)
+		return false;
+	if (af == AF_INET)
+		return a->ip4 == *(const ip4_addr_t *)addr;
+	return rte_ipv6_addr_eq(&a->ip6, addr);
+}
+
+int port_ctrl_addr_add(uint16_t iface_id, int af, const void *addr) {
+	struct iface_info_port *p = ctrl_port(iface_id);
+	struct port_ctrl_addr a = {.af = af};
+	struct port_ctrl_addr *e;
+
+	if (p == NULL)
+		return 0;
+
+	arrforeach (e, p->ctrl_addrs) {
+		if (ctrl_addr_equal(e, af, addr))
+			return 0;
+	}
+	switch (af) {
+	case AF_INET:
+		a.ip4 = *(const ip4_addr_t *)addr;
+		break;
+	case AF_INET6:
+		a.ip6 = *(const struct rte_ipv6_addr *)addr;
+		break;
+	default:
+		return errno_set(EAFNOSUPPORT);
+	}
+	if (p->ctrl_rxq)
+		a.flow = ctrl_flow_addr(p, &a);
+	arrpush(p->ctrl_addrs, a);
+
+	return 0;
+}
+
+int port_ctrl_addr_del(uint16_t iface_id, int af, const void *addr) {
+	struct iface_info_port *p = ctrl_port(iface_id);
+
+	if (p == NULL)
+		return 0;
+
+	for (int i = 0; i < arrlen(p->ctrl_addrs); i++) {
+		if (ctrl_addr_equal(&p->ctrl_addrs[i], af, addr)) {
+			ctrl_flow_destroy(p, &p->ctrl_addrs[i].flow);
+			arrdelswap(p->ctrl_addrs, i);
+			break;
+		}
+	}
+
+	return 0;
+}
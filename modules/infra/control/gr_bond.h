@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_INFRA_BOND_PRIV
+#define _GR_INFRA_BOND_PRIV
+
+#include <gr_bitops.h>
+#include <gr_iface.h>
+#include <gr_infra.h>
+
+#include <rte_build_config.h>
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Slow protocols destination address (IEEE 802.3 annex 57B).
+#define LACP_DST_MAC {{0x01, 0x80, 0xc2, 0x00, 0x00, 0x02}}
+#define LACP_SUBTYPE 0x01
+#define LACP_VERSION 0x01
+
+// Actor and partner port state bits.
+#define LACP_STATE_ACTIVITY GR_BIT8(0)
+#define LACP_STATE_TIMEOUT GR_BIT8(1) // short timeout (fast rate)
+#define LACP_STATE_AGGREGATION GR_BIT8(2)
+#define LACP_STATE_SYNC GR_BIT8(3)
+#define LACP_STATE_COLLECTING GR_BIT8(4)
+#define LACP_STATE_DISTRIBUTING GR_BIT8(5)
+#define LACP_STATE_DEFAULTED GR_BIT8(6)
+#define LACP_STATE_EXPIRED GR_BIT8(7)
+
+#define LACP_TLV_ACTOR 0x01
+#define LACP_TLV_PARTNER 0x02
+#define LACP_TLV_COLLECTOR 0x03
+
+struct lacp_participant {
+	uint8_t tlv_type;
+	uint8_t tlv_len;
+	rte_be16_t system_priority;
+	struct rte_ether_addr system;
+	rte_be16_t key;
+	rte_be16_t port_priority;
+	rte_be16_t port;
+	uint8_t state;
+	uint8_t reserved[3];
+} __rte_packed;
+
+// LACPDU as defined in IEEE 802.1AX section 6.4.2.
+struct lacpdu {
+	uint8_t subtype;
+	uint8_t version;
+	struct lacp_participant actor;
+	struct lacp_participant partner;
+	uint8_t collector_tlv_type;
+	uint8_t collector_tlv_len;
+	rte_be16_t collector_max_delay;
+	uint8_t collector_reserved[12];
+	uint8_t terminator_tlv_type;
+	uint8_t terminator_tlv_len;
+	uint8_t terminator_reserved[50];
+} __rte_packed;
+
+static_assert(sizeof(struct lacpdu) == 110);
+
+struct bond_member {
+	struct iface *iface; // GR_IFACE_TYPE_PORT
+	uint16_t port_id;
+	// selected for transmission
+	bool active;
+	// LACP state, only used in GR_BOND_MODE_LACP
+	uint8_t actor_state;
+	// timer ticks left before the partner information expires, 0 if defaulted
+	uint8_t partner_ttl;
+	struct lacp_participant partner;
+};
+
+// Number of flow hash buckets. Keeps the load imbalance between members below
+// 2% for up to GR_BOND_MAX_MEMBERS.
+#define BOND_TX_BUCKETS 256
+
+struct __rte_aligned(alignof(void *)) iface_info_bond {
+	uint8_t mode;
+	uint8_t n_members;
+	struct rte_ether_addr mac;
+	// RTE_ETH_TX_OFFLOAD_* flags enabled on all members
+	uint64_t tx_offloads;
+	struct bond_member members[GR_BOND_MAX_MEMBERS];
+	// multicast filters added on all members (stb_ds array)
+	struct rte_ether_addr *mcast_macs;
+	// member port_id of each flow hash bucket, RTE_MAX_ETHPORTS when no member
+	// is active. Updated in place by the control plane.
+	uint16_t tx_ports[BOND_TX_BUCKETS];
+};
+
+// Select the member port of a flow, RTE_MAX_ETHPORTS if none is active.
+static inline uint16_t bond_tx_port(const struct iface_info_bond *bond, uint32_t hash) {
+	return __atomic_load_n(&bond->tx_ports[hash % BOND_TX_BUCKETS], __ATOMIC_RELAXED);
+}
+
+// Send a LACPDU received on a member port to the control plane. Called from
+// datapath threads.
+int bond_lacp_input(uint16_t port_id, const struct lacpdu *);
+// Transmit a LACPDU on a member port. Called from the control plane.
+int lacp_output_send(uint16_t port_id, const struct lacpdu *);
+
+#endif
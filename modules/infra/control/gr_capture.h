@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_INFRA_CAPTURE
+#define _GR_INFRA_CAPTURE
+
+#include <gr_infra.h>
+
+#include <rte_graph.h>
+
+// Packet capture in pcapng format. The process function of the captured nodes
+// is wrapped in every worker graph. Packets are copied by the workers with
+// rte_pcapng_copy() in a dedicated mempool and handed over to the control
+// plane through per-worker rings. The control plane writes them to the output.
+int capture_start(const struct gr_infra_capture_start_req *);
+int capture_stop(void);
+void capture_get(struct gr_infra_capture_get_resp *);
+
+// Wrap the process function of the captured nodes in a new worker graph.
+void capture_graph_apply(struct rte_graph *);
+
+#endif
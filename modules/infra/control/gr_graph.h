@@ -21,9 +21,30 @@ struct gr_node_info {
 	struct rte_node_register *node;
 	void (*register_callback)(void);
 	void (*unregister_callback)(void);
+	// Optional. Return a process function specialized for the current
+	// configuration, or NULL to use node->process. Invoked from the control
+	// plane before worker graphs are created.
+	rte_node_process_t (*specialize)(void);
 	STAILQ_ENTRY(gr_node_info) next;
 };
 
+// Process function of a node selected for the current configuration.
+rte_node_process_t gr_node_process(rte_node_t node_id);
+// Evaluate the specialized node variants again on the next event loop
+// iteration. All worker graphs are recreated if any of them changed.
+void gr_node_specialize(void);
+
+struct gr_graph_affinity;
+
+uint8_t graph_model_get(void);
+// Recreate the graphs of all workers with a GR_GRAPH_MODEL_* model.
+int graph_model_set(uint8_t model);
+// Stb array of node affinities.
+const struct gr_graph_affinity *graph_affinity_list(void);
+// Pin a node to a worker, UINT16_MAX to remove the affinity. Only applied
+// with the GR_GRAPH_MODEL_DISPATCH model.
+int graph_affinity_set(const char *node, uint16_t cpu_id);
+
 STAILQ_HEAD(node_infos, gr_node_info);
 extern struct node_infos node_infos;
 
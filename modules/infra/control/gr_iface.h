@@ -8,11 +8,22 @@
 #include <gr_infra.h>
 
 #include <rte_ether.h>
+#include <rte_lcore.h>
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <sys/queue.h>
 
+// Max number of secondary unicast addresses checked by eth_input.
+#define IFACE_MAX_UCAST 4
+
+struct acl_ruleset;
+struct nat44_pool;
+struct iface_policer;
+struct iface_punt;
+struct iface_sampler;
+
 struct __rte_cache_aligned iface {
 	uint16_t id;
 	uint16_t type_id;
@@ -20,7 +31,33 @@ struct __rte_cache_aligned iface {
 	uint16_t state;
 	uint16_t mtu;
 	uint16_t vrf_id; // L3 addressing and routing domain
+	// Copies of the ethernet addresses for the datapath, updated by the
+	// control plane. Zero when the interface type has no ethernet address.
+	struct rte_ether_addr mac;
+	uint8_t n_ucast;
+	struct rte_ether_addr ucast[IFACE_MAX_UCAST]; // secondary unicast addresses
 	const struct iface **subinterfaces;
+	// L2 domain (e.g. bridge) of which this interface is a member. Frames
+	// received on members are not processed locally. NULL otherwise.
+	const struct iface *domain;
+	// IPv4 access lists applied to received and forwarded packets. Replaced
+	// atomically by the control plane. NULL when there are no rules.
+	const struct acl_ruleset *acl_in;
+	const struct acl_ruleset *acl_out;
+	// IPv4 policy based routing rules of received packets, same as acl_in.
+	const struct acl_ruleset *pbr;
+	// Source NAT pool of outside interfaces. Replaced atomically by the control
+	// plane. NULL otherwise.
+	struct nat44_pool *nat44;
+	// Ingress policer. Replaced atomically by the control plane. NULL when
+	// disabled.
+	struct iface_policer *policer;
+	// Packet sampling of received IP packets. Replaced atomically by the
+	// control plane. NULL when disabled.
+	struct iface_sampler *sampler;
+	// Exception path to a kernel network device. Replaced atomically by the
+	// control plane. NULL when disabled.
+	struct iface_punt *punt;
 	char *name;
 	alignas(alignof(void *)) uint8_t info[/* size depends on type */];
 };
@@ -76,17 +113,28 @@ int iface_reconfig(
 );
 int iface_destroy(uint16_t ifid);
 struct iface *iface_from_id(uint16_t ifid);
+// True when the interface, or the port below a VLAN sub-interface, has no
+// carrier. Interface types without link state (e.g. tunnels) are never down.
+bool iface_link_down(const struct iface *);
 void iface_add_subinterface(struct iface *parent, const struct iface *sub);
 void iface_del_subinterface(struct iface *parent, const struct iface *sub);
 int iface_get_eth_addr(uint16_t ifid, struct rte_ether_addr *);
+void iface_set_ucast_addrs(struct iface *, const struct rte_ether_addr *, unsigned n);
 int iface_add_eth_addr(uint16_t ifid, const struct rte_ether_addr *);
 int iface_del_eth_addr(uint16_t ifid, const struct rte_ether_addr *);
 uint16_t ifaces_count(uint16_t type_id);
 struct iface *iface_next(uint16_t type_id, const struct iface *prev);
+// Replace or remove (GR_POLICER_DISABLED) the ingress policer of an interface.
+int iface_policer_set(struct iface *, const struct gr_policer *);
+int iface_policer_get(const struct iface *, struct gr_policer *);
+// Create, update or remove (empty ifname) the exception path of an interface.
+int iface_punt_set(struct iface *, const struct gr_iface_punt *);
+int iface_punt_get(const struct iface *, struct gr_iface_punt *);
 
 #define IFACE_EVENTS                                                                               \
 	IFACE_EVENT(UNKNOWN), IFACE_EVENT(POST_ADD), IFACE_EVENT(PRE_REMOVE),                      \
-		IFACE_EVENT(PORT_POST_RECONFIG)
+		IFACE_EVENT(PORT_POST_RECONFIG), IFACE_EVENT(PORT_LINK_CHANGE),                    \
+		IFACE_EVENT(POST_RECONFIG)
 
 #define IFACE_EVENT(name) IFACE_EVENT_##name
 typedef enum {
@@ -100,8 +148,107 @@ struct iface_event_handler {
 	STAILQ_ENTRY(iface_event_handler) next;
 };
 void iface_event_register_handler(struct iface_event_handler *handler);
+
+// Incremented when an interface is added, reconfigured or destroyed. Datapath
+// caches derived from the interface configuration are stale when it changes.
+// Never zero.
+extern uint32_t iface_config_gen;
+
+// Ethernet header, with an 802.1Q tag for VLAN interfaces, built by eth_output
+// the first time a packet is sent to a resolved next hop. It is copied as is
+// in front of the following packets until iface_config_gen changes. The owner
+// must invalidate it when the destination address or interface changes.
+//
+// The version is a sequence counter. It is odd while a worker is building the
+// header and is incremented by 2 on every invalidation. Workers capture it
+// before reading the destination address of the next hop, only publish a new
+// header if it did not change since then, and readers discard their copy if it
+// changed while copying.
+struct eth_l2_rewrite {
+	uint32_t gen; // iface_config_gen when the header was built, 0 if invalid
+	uint32_t version;
+	uint16_t port_id;
+	uint16_t vlan_tci; // inserted by hardware if not zero
+	bool ip_cksum; // RTE_ETH_TX_OFFLOAD_IPV4_CKSUM is enabled on the port
+	uint8_t len;
+	uint8_t data[RTE_ETHER_HDR_LEN + sizeof(struct rte_vlan_hdr)];
+};
+
+// Must be called after the destination address was modified.
+static inline void eth_l2_rewrite_invalidate(struct eth_l2_rewrite *l2) {
+	__atomic_fetch_add(&l2->version, 2, __ATOMIC_RELEASE);
+	__atomic_store_n(&l2->gen, 0, __ATOMIC_RELEASE);
+}
+
+// Must be called before reading the destination address.
+static inline uint32_t eth_l2_rewrite_version(const struct eth_l2_rewrite *l2) {
+	return __atomic_load_n(&l2->version, __ATOMIC_ACQUIRE);
+}
 void iface_event_notify(iface_event_t event, struct iface *iface);
 
 #define MAX_IFACES 1024
 
+struct iface_counters {
+	uint64_t packets;
+	uint64_t bytes;
+};
+
+// Ports only, effect of the tx policy (see GR_PORT_TX_*).
+struct iface_tx_policy_counters {
+	uint64_t packets; // sent after a retry, sent from the overflow queue or dropped
+	uint64_t calls; // retries, packets queued or dropped bursts
+	uint64_t cycles; // time spent retrying or in the overflow queue
+};
+
+struct iface_stats {
+	struct iface_counters rx;
+	struct iface_counters tx;
+	struct iface_tx_policy_counters tx_retry;
+	struct iface_tx_policy_counters tx_queue;
+	struct iface_tx_policy_counters tx_drop;
+};
+
+// Software traffic counters indexed by interface ID. Each datapath lcore has
+// its own cache aligned array, only written by that lcore.
+extern struct iface_stats *iface_stats[RTE_MAX_LCORE];
+
+// Sum of all lcores counters since the interface creation or the last reset.
+void iface_stats_get(uint16_t ifid, struct iface_stats *);
+void iface_stats_reset(uint16_t ifid);
+
+// Accumulate counters for consecutive packets of the same interface in a graph
+// node and only write the lcore counters when the interface changes. Call
+// iface_stats_flush() at the end of the node process function.
+struct iface_stats_batch {
+	bool tx;
+	uint16_t iface_id;
+	uint32_t packets;
+	uint64_t bytes;
+};
+
+static inline void iface_stats_flush(struct iface_stats_batch *b) {
+	struct iface_counters *c;
+
+	if (b->packets == 0)
+		return;
+
+	if (b->tx)
+		c = &iface_stats[rte_lcore_id()][b->iface_id].tx;
+	else
+		c = &iface_stats[rte_lcore_id()][b->iface_id].rx;
+	c->packets += b->packets;
+	c->bytes += b->bytes;
+	b->packets = 0;
+	b->bytes = 0;
+}
+
+static inline void iface_stats_add(struct iface_stats_batch *b, uint16_t ifid, uint32_t len) {
+	if (ifid != b->iface_id) {
+		iface_stats_flush(b);
+		b->iface_id = ifid;
+	}
+	b->packets++;
+	b->bytes += len;
+}
+
 #endif
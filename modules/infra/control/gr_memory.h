@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_MEMORY
+#define _GR_MEMORY
+
+#include <gr_infra.h>
+
+#include <rte_mempool.h>
+#include <rte_memory.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/queue.h>
+
+// Memory accounting.
+//
+// Subsystems which allocate large amounts of hugepage memory report how much
+// they use on each NUMA socket. The reports are sampled every second to keep
+// high-water marks. The heap memory which is not reported by any subsystem is
+// accounted as GR_MEM_OTHER.
+
+struct gr_mem_reporter {
+	const char *name;
+	// Add the number of bytes used on each NUMA socket, see gr_mem_account().
+	void (*usage)(uint64_t bytes[RTE_MAX_NUMA_NODES]);
+	// high-water marks, managed by the accounting code
+	uint64_t max[RTE_MAX_NUMA_NODES];
+	STAILQ_ENTRY(gr_mem_reporter) next;
+};
+
+void gr_mem_reporter_register(struct gr_mem_reporter *);
+
+// Account len bytes starting at addr to the NUMA socket of the backing memory.
+void gr_mem_account(uint64_t bytes[RTE_MAX_NUMA_NODES], const void *addr, size_t len);
+
+// Account the memory chunks of a mempool.
+void gr_mem_account_mempool(uint64_t bytes[RTE_MAX_NUMA_NODES], struct rte_mempool *);
+
+// Sample all reporters and fill an stb_ds array with the current usage.
+int gr_mem_usage_get(struct gr_mem_usage **usages);
+
+#endif
@@ -4,9 +4,41 @@
 #ifndef _GR_MEMPOOL
 #define _GR_MEMPOOL
 
+#include <rte_common.h>
+#include <rte_ether.h>
+#include <rte_mbuf.h>
 #include <rte_mempool.h>
 
+#include <stdint.h>
+
+// Ethernet header, two VLAN tags and CRC.
+#define GR_ETH_FRAME_OVERHEAD (RTE_ETHER_HDR_LEN + 2 * RTE_VLAN_HLEN + RTE_ETHER_CRC_LEN)
+
+// Data room required to receive frames of mtu bytes in a single mbuf.
+// Never smaller than RTE_MBUF_DEFAULT_BUF_SIZE.
+static inline uint16_t gr_pktmbuf_data_room(uint16_t mtu) {
+	uint32_t room = RTE_PKTMBUF_HEADROOM + GR_ETH_FRAME_OVERHEAD + mtu;
+	room = RTE_MAX(room, (uint32_t)RTE_MBUF_DEFAULT_BUF_SIZE);
+	return RTE_MIN(room, (uint32_t)UINT16_MAX);
+}
+
+// Shared pool with RTE_MBUF_DEFAULT_BUF_SIZE data room.
 struct rte_mempool *gr_pktmbuf_pool_get(int8_t socket_id, uint32_t count);
+// Pool for the RX queues of a port. Unless gr_args()->port_pools is set, the
+// pool may be shared with other ports using the same data room.
+struct rte_mempool *gr_pktmbuf_pool_get_port(
+	uint16_t port_id,
+	int8_t socket_id,
+	uint32_t count,
+	uint16_t data_room
+);
 void gr_pktmbuf_pool_release(struct rte_mempool *mp, uint32_t count);
+// Number of mbufs reserved by all users of a pool, 0 if not allocated by grout.
+uint32_t gr_pktmbuf_pool_reserved(const struct rte_mempool *mp);
+
+// Fill sockets with the NUMA nodes that have hugepage memory, starting with
+// the socket of the calling thread. Returns the number of sockets, at least 1
+// (SOCKET_ID_ANY if no NUMA information is available).
+unsigned gr_numa_sockets(int sockets[RTE_MAX_NUMA_NODES]);
 
 #endif
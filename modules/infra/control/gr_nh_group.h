@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_NH_GROUP
+#define _GR_NH_GROUP
+
+#include <stdint.h>
+
+// Max number of members in an ECMP next hop group.
+#define NH_GROUP_MAX_MEMBERS 64
+// Number of hash buckets. Must be a power of 2.
+#define NH_GROUP_BUCKETS 256
+
+// Resilient ECMP next hop group.
+//
+// Flows are mapped to group members through a fixed size table of buckets
+// indexed by the packet hash. When the membership changes, only the buckets
+// pointing to removed members (plus the minimum required to give their share
+// to new members) are reassigned. All other flows keep their next hop.
+//
+// The members are opaque pointers so that the same table can be used by all
+// address families. Buckets are updated in place with pointer-sized stores:
+// datapath workers always see a valid member, either the old or the new one.
+struct nh_group {
+	uint32_t id; // zero for groups that are not referenced by ID
+	unsigned n_members;
+	void *members[NH_GROUP_MAX_MEMBERS];
+	void *buckets[NH_GROUP_BUCKETS];
+};
+
+static inline void *nh_group_select(const struct nh_group *g, uint32_t hash) {
+	// NIC indirection tables select the RX queue from the low order bits
+	// of the RSS hash. All packets received on the same queue share these
+	// bits. Fold the high order bits to avoid polarizing a worker onto a
+	// single member.
+	return g->buckets[(hash ^ (hash >> 16)) & (NH_GROUP_BUCKETS - 1)];
+}
+
+// Replace the members of a group, keeping unchanged members in their buckets.
+// Returns 0 on success or a negative errno value.
+int nh_group_set(struct nh_group *, unsigned n_members, void *const *members);
+
+// Spread the buckets over a subset of the members (e.g. the ones that can be
+// used), leaving the member list untouched. Buckets of the other members are
+// reassigned. Returns 0 on success or a negative errno value.
+int nh_group_rebalance(struct nh_group *, unsigned n_active, void *const *active);
+
+#endif
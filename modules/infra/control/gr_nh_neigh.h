@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_NH_NEIGH
+#define _GR_NH_NEIGH
+
+#include <gr_bitops.h>
+#include <gr_hold_queue.h>
+#include <gr_timer_wheel.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Address family agnostic part of the next hops resolved by a neighbor
+// discovery protocol (ARP for IPv4, NDP for IPv6).
+//
+// The neighbor state is embedded in the next hops of each family. The state
+// machine, the held packets expiration and the refresh probes are shared. All
+// neighbors are aged by a single timer wheel, regardless of their family.
+
+// Resolution state flags. GR_IP4_NH_F_* and GR_IP6_NH_F_* use the same values.
+#define NH_NEIGH_F_PENDING GR_BIT16(0) // probe sent
+#define NH_NEIGH_F_REACHABLE GR_BIT16(1) // reply received
+#define NH_NEIGH_F_STALE GR_BIT16(2) // reachable lifetime expired, need refresh
+#define NH_NEIGH_F_FAILED GR_BIT16(3) // all probes sent without reply
+#define NH_NEIGH_F_STATIC GR_BIT16(4) // configured by user, never expires
+#define NH_NEIGH_F_GATEWAY GR_BIT16(6) // gateway route, never fails
+
+// Max number of packets to hold per next hop waiting for resolution (default: 256).
+#define NH_NEIGH_MAX_HELD_PKTS 256
+// Max number of seconds a packet is held waiting for resolution (default: 3 sec).
+#define NH_NEIGH_HOLD_TIMEOUT 3
+// Reachable next hop lifetime after last reply received (default: 20 min).
+#define NH_NEIGH_LIFETIME_REACHABLE (20 * 60)
+// Send unicast probes for next hops carrying traffic this many seconds
+// before NH_NEIGH_LIFETIME_REACHABLE expires (default: 1 min).
+#define NH_NEIGH_REFRESH_AHEAD 60
+// Unreachable next hop lifetime after last unreplied request was sent (default: 1 min).
+#define NH_NEIGH_LIFETIME_UNREACHABLE 60
+// Max number of unicast probes to send after NH_NEIGH_LIFETIME_REACHABLE.
+#define NH_NEIGH_UCAST_PROBES 3
+// Max number of multicast (NDP) or broadcast (ARP) probes to send after
+// unicast probes failed.
+#define NH_NEIGH_MCAST_PROBES 3
+
+struct nh_neigh;
+
+// Invoked from the event loop thread when the aging deadline of a neighbor expires.
+typedef void (*nh_neigh_aging_cb_t)(struct nh_neigh *);
+
+struct nh_neigh {
+	uint64_t last_request, last_reply;
+	uint8_t ucast_probes : 4, mcast_probes : 4;
+	// set by datapath workers when sending packets, cleared by the refresh probes
+	bool used;
+	// packets waiting for resolution
+	struct hold_queue held;
+	// REACHABLE/STALE/PENDING/FAILED state aging
+	struct timer_wheel_entry aging;
+	nh_neigh_aging_cb_t aging_cb;
+};
+
+// Mark a neighbor as carrying traffic. The flag is only written when not set
+// already to avoid bouncing the cache line between workers.
+static inline void nh_neigh_touch(struct nh_neigh *n) {
+	if (!__atomic_load_n(&n->used, __ATOMIC_RELAXED))
+		__atomic_store_n(&n->used, true, __ATOMIC_RELAXED);
+}
+
+// Age of the last reply in seconds, zero if none was ever received.
+uint64_t nh_neigh_reply_age(const struct nh_neigh *);
+
+// Start aging a neighbor on the next tick.
+void nh_neigh_start(struct nh_neigh *, nh_neigh_aging_cb_t);
+// Stop aging a neighbor. It may be freed after an RCU grace period.
+void nh_neigh_stop(struct nh_neigh *);
+// Drop all held packets. Must only be called once the neighbor is stopped and
+// is no longer visible to the datapath workers.
+void nh_neigh_purge(struct nh_neigh *);
+
+// Actions to be taken by the owner of a neighbor after nh_neigh_age.
+#define NH_NEIGH_A_FLUSH GR_BIT8(0) // reachable with held packets, flush them
+#define NH_NEIGH_A_SOLICIT GR_BIT8(1) // send a probe
+#define NH_NEIGH_A_FAILED GR_BIT8(2) // all probes were sent without reply
+#define NH_NEIGH_A_DESTROY GR_BIT8(3) // unreachable lifetime expired, delete it
+
+// Run the state machine of a neighbor. Expire held packets and update the
+// NH_NEIGH_F_* bits of flags. Returns a combination of NH_NEIGH_A_* flags.
+uint8_t nh_neigh_age(struct nh_neigh *, uint16_t *flags, uint64_t now);
+// Schedule the next aging check of a neighbor according to its state.
+void nh_neigh_rearm(struct nh_neigh *, uint16_t flags, uint64_t now);
+
+#endif
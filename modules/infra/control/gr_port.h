@@ -9,7 +9,10 @@
 
 #include <rte_ethdev.h>
 #include <rte_ether.h>
+#include <rte_flow.h>
+#include <rte_ip6.h>
 #include <rte_mempool.h>
+#include <rte_ring.h>
 
 #include <stdint.h>
 #include <sys/queue.h>
@@ -28,6 +31,24 @@ struct mac_filter {
 	struct rte_ether_addr mac[RTE_ETH_NUM_RECEIVE_MAC_ADDR];
 };
 
+// Local address whose traffic is steered to the control rxq.
+struct port_ctrl_addr {
+	int af;
+	union {
+		ip4_addr_t ip4;
+		struct rte_ipv6_addr ip6;
+	};
+	struct rte_flow *flow; // NULL if not installed
+};
+
+// Traffic of a tenant steered to a range of datapath rxqs.
+struct port_pin {
+	struct gr_port_pin pin;
+	struct rte_flow *flow; // NULL if not installed
+};
+
+struct tx_sched;
+
 struct __rte_aligned(alignof(void *)) iface_info_port {
 	uint16_t port_id;
 	uint8_t n_rxq;
@@ -35,14 +56,114 @@ struct __rte_aligned(alignof(void *)) iface_info_port {
 	bool configured;
 	uint16_t rxq_size;
 	uint16_t txq_size;
+	uint8_t tx_policy;
+	uint16_t tx_limit;
+	// requested, only enabled when RTE_ETH_TX_OFFLOAD_MBUF_FAST_FREE is in tx_offloads
+	bool tx_fast_free;
+	uint16_t tx_free_thresh;
+	uint16_t tx_rs_thresh;
+	// RTE_PTYPE_*_MASK layers reliably reported by the driver in mbuf->packet_type
+	uint32_t ptype_mask;
+	// RTE_ETH_TX_OFFLOAD_* flags enabled on the port
+	uint64_t tx_offloads;
 	struct rte_ether_addr mac;
 	struct rte_mempool *pool;
 	char *devargs;
 	uint32_t pool_size;
+	uint16_t pool_data_room; // sized from the MTU, see gr_pktmbuf_data_room()
+	// only when txqs are shared between workers and the driver does not
+	// support lock-free concurrent access: one multi-producer ring per txq
+	// (stb_ds array) drained by the worker that owns the txq
+	struct rte_ring **txq_rings;
 	struct mac_filter ucast_filter;
 	struct mac_filter mcast_filter;
+	// RSS settings applied on every port configuration
+	uint32_t rss_fields; // GR_PORT_RSS_F_*, zero for the default
+	bool rss_symmetric;
+	uint8_t rss_key_len; // zero for the driver default
+	uint8_t rss_key[GR_PORT_RSS_KEY_SIZE];
+	// rxq index for each RSS bucket (stb_ds array), NULL for the default table
+	uint16_t *reta;
+	// ARP, NDP and local traffic is steered to an extra rxq with rte_flow rules
+	bool ctrl_rxq;
+	struct rte_flow **ctrl_flows; // stb_ds array
+	struct port_ctrl_addr *ctrl_addrs; // stb_ds array
+	// VLANs and destination prefixes steered to dedicated rxqs
+	struct port_pin *pins; // stb_ds array
+	// bond interface of which this port is a member, NULL otherwise
+	const struct iface *bond;
+	// egress scheduler, applied when the graphs are reloaded
+	struct gr_port_qos qos;
+	struct tx_sched *sched; // NULL when disabled
+	// copies of the received and/or sent frames to a monitor port
+	struct gr_port_mirror mirror;
 };
 
+// Index of the control rxq, only valid when ctrl_rxq is enabled.
+static inline uint16_t port_ctrl_rxq(const struct iface_info_port *p) {
+	return p->n_rxq;
+}
+
+// Number of rxqs configured on the port, including the control rxq.
+static inline uint16_t port_rxq_count(const struct iface_info_port *p) {
+	return p->n_rxq + (p->ctrl_rxq ? 1 : 0);
+}
+
+// Install the control traffic steering rules. The port must be started.
+// Rules that are not supported by the driver are skipped with a notice.
+int port_ctrl_flows_apply(struct iface_info_port *);
+// Remove all steering rules. Addresses are kept so that they can be re-applied.
+void port_ctrl_flows_destroy(struct iface_info_port *);
+void port_ctrl_fini(struct iface_info_port *);
+// Track a local address of an interface. Only port and VLAN interfaces are
+// considered, others are silently ignored.
+int port_ctrl_addr_add(uint16_t iface_id, int af, const void *addr);
+int port_ctrl_addr_del(uint16_t iface_id, int af, const void *addr);
+
+// Add or remove a tenant rxq pin. The rule is installed immediately when the
+// port is started and the RSS indirection table is updated.
+int port_pin_add(struct iface_info_port *, const struct gr_port_pin *);
+int port_pin_del(struct iface_info_port *, const struct gr_port_pin *);
+// Install the pin rules. The port must be started. Pins whose rxqs do not
+// exist anymore or which are not supported by the driver are skipped.
+int port_pin_flows_apply(struct iface_info_port *);
+// Remove all pin rules. Pins are kept so that they can be re-applied.
+void port_pin_flows_destroy(struct iface_info_port *);
+void port_pin_fini(struct iface_info_port *);
+// Tenant of a datapath rxq: zero when the rxq is shared by all the traffic
+// that does not match any pin, the same non-zero value for all the rxqs of a
+// pinned range otherwise.
+uint16_t port_rxq_tenant(const struct iface_info_port *, uint16_t rxq);
+
+#define PORT_RSS_HF_DEFAULT (RTE_ETH_RSS_VLAN | RTE_ETH_RSS_IP | RTE_ETH_RSS_UDP | RTE_ETH_RSS_TCP)
+
+// Override the driver default hash configuration with the port RSS settings.
+void port_rss_conf_fill(
+	const struct iface_info_port *,
+	const struct rte_eth_dev_info *,
+	struct rte_eth_rss_conf *
+);
+// Program the RSS indirection table. When no explicit table is set, buckets
+// are spread evenly over the shared datapath rxqs (excluding the control rxq
+// and the rxqs pinned to a tenant).
+int port_reta_apply(struct iface_info_port *, const struct rte_eth_dev_info *);
+// Number of RSS buckets pointing to an rxq.
+unsigned port_reta_buckets(const struct iface_info_port *, uint16_t rxq);
+// Reassign up to n_buckets RSS buckets from one rxq to another.
+// Returns the number of moved buckets or a negative errno value.
+int port_reta_move(struct iface_info_port *, uint16_t from, uint16_t to, unsigned n_buckets);
+int port_rss_set(struct iface_info_port *, uint8_t set_attrs, const struct gr_port_rss *);
+int port_rss_get(const struct iface_info_port *, struct gr_port_rss *);
+
+// Replace or remove (GR_PORT_QOS_DISABLED) the egress scheduler of a port.
+// Applied immediately, packets queued in the previous scheduler are lost.
+int port_qos_set(struct iface *, const struct gr_port_qos *);
+int port_qos_get(const struct iface *, struct gr_port_qos *);
+
+// Replace or remove (GR_IFACE_ID_UNDEF) the mirror session of a port.
+int port_mirror_set(struct iface *, const struct gr_port_mirror *);
+int port_mirror_get(const struct iface *, struct gr_port_mirror *);
+
 uint32_t port_get_rxq_buffer_us(uint16_t port_id, uint16_t rxq_id);
 int iface_port_reconfig(
 	struct iface *iface,
@@ -52,5 +173,8 @@ int iface_port_reconfig(
 	uint16_t vrf_id,
 	const void *api_info
 );
+// Reconfigure the tx queues of all ports after the number of workers changed.
+// The ports are stopped and started concurrently.
+int port_reconfig_all(void);
 const struct iface *port_get_iface(uint16_t port_id);
 #endif
@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_INFRA_RCU
+#define _GR_INFRA_RCU
+
+#include <rte_rcu_qsbr.h>
+
+// Quiescent state variable shared by all datapath workers. Workers report
+// a quiescent state after every graph walk and go offline when sleeping.
+struct rte_rcu_qsbr *gr_datapath_rcu(void);
+
+typedef void (*gr_rcu_free_cb_t)(void *obj);
+
+// Defer the release of an object until all datapath workers have reported
+// a quiescent state. The object must already be unreachable from the
+// datapath (removed from all lookup tables).
+void gr_rcu_defer_free(gr_rcu_free_cb_t, void *obj);
+
+// Wait until all datapath workers have reported a quiescent state.
+// Must only be called from the control plane thread.
+void gr_rcu_synchronize(void);
+
+// Start a grace period and return a token for gr_rcu_wait().
+uint64_t gr_rcu_start(void);
+
+// Wait until all datapath workers have reported a quiescent state since the
+// token was returned by gr_rcu_start(). Returns immediately if they already
+// have. Must only be called from the control plane thread.
+void gr_rcu_wait(uint64_t token);
+
+#endif
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_TIMER_WHEEL
+#define _GR_TIMER_WHEEL
+
+#include <event2/event.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/queue.h>
+
+// Hashed timer wheel with a one second resolution.
+//
+// Entries are meant to be embedded in the objects that need aging. Only the
+// entries whose deadline has expired are visited on every tick. Arming and
+// cancelling entries is safe from any thread. Expiry callbacks are invoked
+// from the event loop thread.
+
+struct timer_wheel_entry {
+	LIST_ENTRY(timer_wheel_entry) next;
+	uint64_t expire;
+	bool armed;
+};
+
+typedef void (*timer_wheel_cb_t)(struct timer_wheel_entry *);
+
+struct timer_wheel;
+
+struct timer_wheel *timer_wheel_create(struct event_base *, timer_wheel_cb_t);
+void timer_wheel_destroy(struct timer_wheel *);
+
+// Schedule the entry to expire in delay seconds. Re-arms it if already armed.
+void timer_wheel_arm(struct timer_wheel *, struct timer_wheel_entry *, uint32_t delay);
+void timer_wheel_cancel(struct timer_wheel *, struct timer_wheel_entry *);
+
+#endif
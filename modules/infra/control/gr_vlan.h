@@ -16,6 +16,8 @@ struct __rte_aligned(alignof(void *)) iface_info_vlan {
 	uint16_t parent_id;
 	uint16_t vlan_id;
 	struct rte_ether_addr mac;
+	// resolved from parent_id, cannot be destroyed while the VLAN exists
+	const struct iface *parent;
 };
 
 struct iface *vlan_get_iface(uint16_t port_id, uint16_t vlan_id);
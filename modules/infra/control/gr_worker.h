@@ -4,6 +4,8 @@
 #ifndef _GR_INFRA_WORKER
 #define _GR_INFRA_WORKER
 
+#include <gr_infra.h>
+
 #include <rte_common.h>
 #include <rte_graph.h>
 #include <rte_os.h>
@@ -19,6 +21,7 @@ struct queue_map {
 	uint16_t port_id;
 	uint16_t queue_id;
 	bool enabled;
+	bool shared; // txq owned by another worker, enqueue in its ring
 };
 
 struct node_stats {
@@ -26,6 +29,17 @@ struct node_stats {
 	uint64_t objs;
 	uint64_t calls;
 	uint64_t cycles;
+	// log2 histograms per call, only updated when worker.stats_hist is set
+	uint64_t cycles_hist[GR_INFRA_STATS_HIST_BUCKETS];
+	uint64_t objs_hist[GR_INFRA_STATS_HIST_BUCKETS];
+};
+
+// Graph walk longer than worker.stall_threshold_us.
+struct worker_stall {
+	uint64_t tsc; // end of the walk
+	uint64_t cycles; // duration of the walk
+	rte_node_t node_id; // slowest node call during the walk
+	uint64_t node_cycles;
 };
 
 struct worker_stats {
@@ -33,6 +47,12 @@ struct worker_stats {
 	uint64_t busy_cycles;
 	uint64_t sleep_cycles;
 	uint64_t n_sleeps;
+	// graph walk durations, only updated when worker.stall_threshold_us is set
+	uint64_t walk_max_cycles;
+	uint64_t walk_hist[GR_INFRA_STATS_HIST_BUCKETS];
+	// circular log of the most recent stalls
+	uint64_t n_stalls;
+	struct worker_stall stalls[16];
 	size_t n_stats;
 	struct node_stats stats[/* n_stats */];
 };
@@ -45,8 +65,13 @@ struct worker {
 	// synced with thread_fence
 	struct rte_graph *graph[2]; // dataplane: ro, ctlplane: rw
 	atomic_uint max_sleep_us; // dataplane: ro, ctlplane: rw
+	atomic_uint stats_interval; // dataplane: ro, ctlplane: rw
+	atomic_uint power; // GR_WORKER_POWER_*, dataplane: ro, ctlplane: rw
+	atomic_uint active_power; // GR_WORKER_POWER_*, dataplane: wo, ctlplane: ro
 
 	atomic_bool stats_reset; // dataplane: rw, ctlplane: rw
+	atomic_bool stats_hist; // dataplane: ro, ctlplane: rw
+	atomic_uint stall_threshold_us; // 0 to disable, dataplane: ro, ctlplane: rw
 	// dataplane: wo, ctlplane: ro, may be NULL
 	_Atomic(const struct worker_stats *) stats;
 
@@ -54,11 +79,15 @@ struct worker {
 	unsigned cpu_id;
 	unsigned lcore_id;
 	pid_t tid;
+	// eventfd used to interrupt blocking waits on RX interrupts, -1 if unused
+	int wakeup_fd;
 
 	// private for control plane only
 	pthread_t thread;
 	struct queue_map *rxqs;
 	struct queue_map *txqs;
+	// node variants generation of each graph
+	uint32_t graph_gen[2];
 	STAILQ_ENTRY(worker) next;
 } __rte_cache_aligned;
 
@@ -66,5 +95,7 @@ STAILQ_HEAD(workers, worker);
 extern struct workers workers;
 
 int worker_rxq_assign(uint16_t port_id, uint16_t rxq_id, uint16_t cpu_id);
+// Wake up a worker blocked waiting for RX interrupts.
+void worker_wakeup(struct worker *);
 
 #endif
@@ -2,10 +2,13 @@
 // Copyright (c) 2024 Robin Jarry
 
 #include "graph_priv.h"
+#include "worker_priv.h"
 
+#include <gr_capture.h>
 #include <gr_control.h>
 #include <gr_datapath.h>
 #include <gr_graph.h>
+#include <gr_iface.h>
 #include <gr_infra.h>
 #include <gr_log.h>
 #include <gr_port.h>
@@ -24,11 +27,24 @@
 #include <rte_hash.h>
 
 #include <stdatomic.h>
+#include <string.h>
 #include <sys/queue.h>
 #include <unistd.h>
 
 struct node_infos node_infos = STAILQ_HEAD_INITIALIZER(node_infos);
 static const char **node_names;
+// Process functions selected for the current configuration, indexed by node ID.
+static rte_node_process_t *node_processes;
+// Incremented when any of node_processes changes.
+static uint32_t node_processes_gen;
+static struct event *specialize_ev;
+
+static uint8_t graph_model = GR_GRAPH_MODEL_RTC;
+static struct gr_graph_affinity *graph_affinities;
+// Parent graphs of the worker clones, only with GR_GRAPH_MODEL_DISPATCH.
+// They are never walked.
+static struct rte_graph *dispatch_parents[2];
+static unsigned dispatch_index;
 
 struct node_data_key {
 	char graph[RTE_GRAPH_NAMESIZE];
@@ -130,31 +146,48 @@ void worker_graph_free(struct worker *worker) {
 	}
 }
 
-static int worker_graph_new(struct worker *worker, uint8_t index) {
-	struct rx_node_queues *rx = NULL;
-	struct tx_node_queues *tx = NULL;
-	char name[RTE_GRAPH_NAMESIZE];
+static unsigned worker_rxqs_enabled(const struct worker *worker) {
 	struct queue_map *qmap;
-	uint16_t graph_uid;
-	unsigned n_rxqs;
-	size_t len;
-	int ret;
+	unsigned n_rxqs = 0;
 
-	n_rxqs = 0;
 	arrforeach (qmap, worker->rxqs) {
 		if (qmap->enabled)
 			n_rxqs++;
 	}
-	if (n_rxqs == 0) {
-		worker->graph[index] = NULL;
-		return 0;
+
+	return n_rxqs;
+}
+
+// Worker that runs the scheduler of a port. Only workers with enabled rxqs
+// have a graph. Prefer the configured one, then the owner of txq 0.
+static const struct worker *sched_worker(const struct iface_info_port *port) {
+	const struct worker *worker, *owner = NULL, *any = NULL;
+	const struct queue_map *qmap;
+
+	STAILQ_FOREACH (worker, &workers, next) {
+		if (worker_rxqs_enabled(worker) == 0)
+			continue;
+		if (worker->cpu_id == port->qos.cpu_id)
+			return worker;
+		arrforeach (qmap, worker->txqs) {
+			if (qmap->port_id == port->port_id && qmap->queue_id == 0 && !qmap->shared)
+				owner = worker;
+		}
+		if (any == NULL)
+			any = worker;
 	}
 
-	// unique suffix for this graph
-	graph_uid = (worker->cpu_id << 1) | (0x1 & index);
-	snprintf(name, sizeof(name), "gr-%04x", graph_uid);
+	return owner != NULL ? owner : any;
+}
+
+// Build and store rx & tx nodes data for a graph.
+static int worker_node_data_set(struct worker *worker, const char *name, unsigned n_rxqs) {
+	struct rx_node_queues *rx = NULL;
+	struct tx_node_queues *tx = NULL;
+	struct queue_map *qmap;
+	size_t len;
+	int ret;
 
-	// build rx & tx nodes data
 	len = sizeof(*rx) + n_rxqs * sizeof(struct rx_port_queue);
 	rx = malloc(len);
 	if (rx == NULL) {
@@ -163,6 +196,9 @@ static int worker_graph_new(struct worker *worker, uint8_t index) {
 	}
 	n_rxqs = 0;
 	arrforeach (qmap, worker->rxqs) {
+		const struct iface_info_port *port;
+		const struct iface *iface;
+
 		if (!qmap->enabled)
 			continue;
 		LOG(DEBUG,
@@ -172,6 +208,16 @@ static int worker_graph_new(struct worker *worker, uint8_t index) {
 		    qmap->queue_id);
 		rx->queues[n_rxqs].port_id = qmap->port_id;
 		rx->queues[n_rxqs].rxq_id = qmap->queue_id;
+		iface = port_get_iface(qmap->port_id);
+		rx->queues[n_rxqs].iface = iface;
+		rx->queues[n_rxqs].ptype_mask = 0;
+		rx->queues[n_rxqs].control = false;
+		if (iface != NULL) {
+			port = (const struct iface_info_port *)iface->info;
+			rx->queues[n_rxqs].ptype_mask = port->ptype_mask;
+			rx->queues[n_rxqs].control = port->ctrl_rxq
+				&& qmap->queue_id == port_ctrl_rxq(port);
+		}
 		n_rxqs++;
 	}
 	rx->n_queues = n_rxqs;
@@ -188,17 +234,45 @@ static int worker_graph_new(struct worker *worker, uint8_t index) {
 		ret = -ENOMEM;
 		goto err;
 	}
+	memset(tx, 0, sizeof(*tx));
 	// initialize all to invalid queue_ids
-	memset(tx, 0xff, sizeof(*tx));
+	memset(tx->txq_ids, 0xff, sizeof(tx->txq_ids));
 	arrforeach (qmap, worker->txqs) {
+		const struct iface_info_port *port;
+		const struct iface *iface;
+		struct rte_ring *ring;
+
 		if (!qmap->enabled)
 			continue;
 		LOG(DEBUG,
-		    "[CPU %d] -> port %u txq %u",
+		    "[CPU %d] -> port %u txq %u%s",
 		    worker->cpu_id,
 		    qmap->port_id,
-		    qmap->queue_id);
+		    qmap->queue_id,
+		    qmap->shared ? " (shared)" : "");
 		tx->txq_ids[qmap->port_id] = qmap->queue_id;
+
+		if ((iface = port_get_iface(qmap->port_id)) == NULL)
+			continue;
+		port = (const struct iface_info_port *)iface->info;
+		tx->policies[qmap->port_id].iface_id = iface->id;
+		tx->policies[qmap->port_id].type = port->tx_policy;
+		tx->policies[qmap->port_id].limit = port->tx_limit;
+		tx->scheds[qmap->port_id] = port->sched;
+		if (port->tx_offloads & RTE_ETH_TX_OFFLOAD_MBUF_FAST_FREE)
+			tx->fast_free_pools[qmap->port_id] = port->pool;
+		if (port->sched != NULL && sched_worker(port) == worker)
+			tx->sched_ports[tx->n_scheds++] = qmap->port_id;
+		if (qmap->queue_id >= arrlen(port->txq_rings))
+			continue;
+		ring = port->txq_rings[qmap->queue_id];
+		if (qmap->shared) {
+			tx->rings[qmap->port_id] = ring;
+		} else {
+			tx->drains[tx->n_drains].port_id = qmap->port_id;
+			tx->drains[tx->n_drains].ring = ring;
+			tx->n_drains++;
+		}
 	}
 	if (gr_node_data_set(name, "port_tx", tx) < 0) {
 		if (rte_errno == 0)
@@ -206,7 +280,74 @@ static int worker_graph_new(struct worker *worker, uint8_t index) {
 		ret = -rte_errno;
 		goto err;
 	}
-	tx = NULL;
+
+	return 0;
+err:
+	free(rx);
+	free(tx);
+	return errno_set(-ret);
+}
+
+rte_node_process_t gr_node_process(rte_node_t node_id) {
+	return __atomic_load_n(&node_processes[node_id], __ATOMIC_ACQUIRE);
+}
+
+static void node_processes_update(void) {
+	rte_node_process_t process;
+	struct rte_node_register *reg;
+	struct gr_node_info *info;
+	bool changed = false;
+	const char *variant;
+
+	STAILQ_FOREACH (info, &node_infos, next) {
+		if (info->specialize == NULL)
+			continue;
+		reg = info->node;
+		variant = "specialized";
+		if ((process = info->specialize()) == NULL) {
+			process = reg->process;
+			variant = "default";
+		}
+		if (process != node_processes[reg->id]) {
+			LOG(INFO, "%s: using %s variant", reg->name, variant);
+			__atomic_store_n(&node_processes[reg->id], process, __ATOMIC_RELEASE);
+			changed = true;
+		}
+	}
+	if (changed)
+		node_processes_gen++;
+}
+
+static void graph_specialize(struct rte_graph *graph) {
+	struct gr_node_info *info;
+	struct rte_node *node;
+
+	STAILQ_FOREACH (info, &node_infos, next) {
+		if (info->specialize == NULL)
+			continue;
+		if ((node = rte_graph_node_get(graph->id, info->node->id)) != NULL)
+			node->process = node_processes[info->node->id];
+	}
+}
+
+static int worker_graph_new(struct worker *worker, uint8_t index) {
+	char name[RTE_GRAPH_NAMESIZE];
+	uint16_t graph_uid;
+	unsigned n_rxqs;
+	int ret;
+
+	n_rxqs = worker_rxqs_enabled(worker);
+	if (n_rxqs == 0) {
+		worker->graph[index] = NULL;
+		return 0;
+	}
+
+	// unique suffix for this graph
+	graph_uid = (worker->cpu_id << 1) | (0x1 & index);
+	snprintf(name, sizeof(name), "gr-%04x", graph_uid);
+
+	if ((ret = worker_node_data_set(worker, name, n_rxqs)) < 0)
+		goto err;
 
 	// graph init
 	struct rte_graph_param params = {
@@ -221,46 +362,350 @@ static int worker_graph_new(struct worker *worker, uint8_t index) {
 		goto err;
 	}
 	worker->graph[index] = rte_graph_lookup(name);
+	graph_specialize(worker->graph[index]);
+	worker->graph_gen[index] = node_processes_gen;
+	capture_graph_apply(worker->graph[index]);
 
 	return 0;
 err:
-	free(rx);
-	free(tx);
 	node_data_reset(name);
 	return errno_set(-ret);
 }
 
-int worker_graph_reload_all(void) {
-	struct worker *worker;
+static void graph_destroy(struct rte_graph *graph) {
+	int ret;
+
+	node_data_reset(graph->name);
+	if ((ret = rte_graph_destroy(graph->id)) < 0)
+		errno_log(-ret, "rte_graph_destroy");
+}
+
+// Pin the nodes which have an affinity to the worker which runs them. Other
+// nodes are processed by the worker that walks the graph.
+static void dispatch_affinity_apply(struct rte_graph *graph) {
+	const struct gr_graph_affinity *a;
+	const struct gr_node_info *info;
+	const struct worker *worker;
+	struct rte_node *node;
+	rte_graph_off_t off;
+	rte_node_t count;
+
+	rte_graph_foreach_node (count, off, graph, node)
+		node->dispatch.lcore_id = RTE_MAX_LCORE;
+
+	// Source nodes are skipped by rte_graph_walk() unless they are bound to
+	// the worker that walks the graph.
+	STAILQ_FOREACH (info, &node_infos, next) {
+		if (!(info->node->flags & RTE_NODE_SOURCE_F))
+			continue;
+		if ((node = rte_graph_node_get_by_name(graph->name, info->node->name)) != NULL)
+			node->dispatch.lcore_id = graph->dispatch.lcore_id;
+	}
+
+	arrforeach (a, graph_affinities) {
+		if ((worker = worker_find(a->cpu_id)) == NULL || worker->lcore_id >= RTE_MAX_LCORE)
+			continue;
+		if ((node = rte_graph_node_get_by_name(graph->name, a->node)) != NULL)
+			node->dispatch.lcore_id = worker->lcore_id;
+	}
+}
+
+static void dispatch_parents_free(void) {
+	for (unsigned i = 0; i < ARRAY_DIM(dispatch_parents); i++) {
+		if (dispatch_parents[i] != NULL)
+			graph_destroy(dispatch_parents[i]);
+		dispatch_parents[i] = NULL;
+	}
+}
+
+// Create a parent graph and one clone of it for each worker. Workers with no
+// rx queues also get a clone to process the nodes which are pinned to them.
+static int dispatch_graphs_new(unsigned index) {
+	char name[RTE_GRAPH_NAMESIZE], clone[RTE_GRAPH_NAMESIZE];
+	struct worker *worker, none = {.rxqs = NULL};
+	struct rte_graph *graph;
 	unsigned next;
 	int ret;
 
+	snprintf(name, sizeof(name), "gr-d%u", index);
+	// the parent graph is not walked, it has no queues
+	if ((ret = worker_node_data_set(&none, name, 0)) < 0)
+		goto err;
+
+	struct rte_graph_param params = {
+		.socket_id = SOCKET_ID_ANY,
+		.nb_node_patterns = arrlen(node_names),
+		.node_patterns = (const char **)node_names,
+	};
+	if (rte_graph_create(name, &params) == RTE_GRAPH_ID_INVALID) {
+		if (rte_errno == 0)
+			rte_errno = EINVAL;
+		ret = -rte_errno;
+		node_data_reset(name);
+		goto err;
+	}
+	dispatch_parents[index] = rte_graph_lookup(name);
+	// inherited by the clones, their work queues are only created when set
+	dispatch_parents[index]->model = RTE_GRAPH_MODEL_MCORE_DISPATCH;
+
 	STAILQ_FOREACH (worker, &workers, next) {
 		next = !atomic_load(&worker->cur_config);
+		snprintf(clone, sizeof(clone), "%04x", worker->cpu_id);
+		// rte_graph_clone() appends the clone name to the parent one
+		snprintf(name, sizeof(name), "gr-d%u-%s", index, clone);
+
+		if ((ret = worker_node_data_set(worker, name, worker_rxqs_enabled(worker))) < 0)
+			goto err;
+		params.socket_id = rte_lcore_to_socket_id(worker->lcore_id);
+		if (rte_graph_clone(dispatch_parents[index]->id, clone, &params)
+		    == RTE_GRAPH_ID_INVALID) {
+			if (rte_errno == 0)
+				rte_errno = EINVAL;
+			ret = -rte_errno;
+			node_data_reset(name);
+			goto err;
+		}
+		graph = rte_graph_lookup(name);
+		graph->model = RTE_GRAPH_MODEL_MCORE_DISPATCH;
+		// rte_graph_model_mcore_dispatch_core_bind() rejects non-EAL lcores
+		graph->dispatch.lcore_id = worker->lcore_id;
+		graph_specialize(graph);
+		dispatch_affinity_apply(graph);
+		capture_graph_apply(graph);
+		worker->graph[next] = graph;
+		worker->graph_gen[next] = node_processes_gen;
+	}
 
-		if ((ret = worker_graph_new(worker, next)) < 0)
-			return errno_log(-ret, "worker_graph_new");
+	return 0;
+err:
+	STAILQ_FOREACH (worker, &workers, next) {
+		next = !atomic_load(&worker->cur_config);
+		if (worker->graph[next] != NULL)
+			graph_destroy(worker->graph[next]);
+		worker->graph[next] = NULL;
+	}
+	if (dispatch_parents[index] != NULL)
+		graph_destroy(dispatch_parents[index]);
+	dispatch_parents[index] = NULL;
+	return errno_set(-ret);
+}
+
+// Replace the graphs of all workers at once. The clones of a parent graph
+// hand over packets to each other and must be switched together.
+static int dispatch_graphs_reload(void) {
+	unsigned index = !dispatch_index;
+	struct worker *worker;
+	unsigned next;
+	int ret;
+
+	node_processes_update();
 
-		// wait for datapath worker to pickup the config update
+	if ((ret = dispatch_graphs_new(index)) < 0)
+		return errno_log(-ret, "dispatch_graphs_new");
+
+	STAILQ_FOREACH (worker, &workers, next) {
+		next = !atomic_load(&worker->cur_config);
 		atomic_store_explicit(&worker->next_config, next, memory_order_release);
+		worker_wakeup(worker);
+	}
+	STAILQ_FOREACH (worker, &workers, next) {
+		next = atomic_load(&worker->next_config);
 		while (atomic_load_explicit(&worker->cur_config, memory_order_acquire) != next)
 			usleep(500);
+	}
 
-		// free old config
-		next = !next;
+	// free old config, clones first
+	STAILQ_FOREACH (worker, &workers, next) {
+		next = !atomic_load(&worker->cur_config);
+		if (worker->graph[next] != NULL)
+			graph_destroy(worker->graph[next]);
+		worker->graph[next] = NULL;
+	}
+	if (dispatch_parents[dispatch_index] != NULL)
+		graph_destroy(dispatch_parents[dispatch_index]);
+	dispatch_parents[dispatch_index] = NULL;
+	dispatch_index = index;
+
+	return 0;
+}
+
+// Update the rx & tx queues of the graph currently used by a worker without
+// interrupting it. Returns a negative value if a new graph must be created.
+static int worker_graph_update(struct worker *worker) {
+	unsigned cur = atomic_load(&worker->cur_config);
+	struct rte_graph *graph = worker->graph[cur];
+	unsigned n_rxqs = worker_rxqs_enabled(worker);
+	int ret;
+
+	if (graph == NULL || n_rxqs == 0 || atomic_load(&worker->next_config) != cur)
+		return errno_set(EAGAIN);
+	// node variants do not match the current configuration
+	if (worker->graph_gen[cur] != node_processes_gen)
+		return errno_set(EAGAIN);
+	// clones of a dispatch parent graph, the graph model may have changed
+	if (graph->model != RTE_GRAPH_MODEL_RTC)
+		return errno_set(EAGAIN);
+
+	if ((ret = worker_node_data_set(worker, graph->name, n_rxqs)) < 0)
+		return ret;
+	if ((ret = rx_node_queues_update(graph, gr_node_data_get(graph->name, "port_rx"))) < 0)
+		return ret;
+	ret = tx_node_queues_update(worker, graph, gr_node_data_get(graph->name, "port_tx"));
+	if (ret < 0)
+		return ret;
+
+	// the worker may be blocked waiting for interrupts on the old queues
+	worker_wakeup(worker);
+
+	return 0;
+}
+
+int worker_graph_reload(struct worker *worker) {
+	unsigned next;
+	int ret;
+
+	if (graph_model == GR_GRAPH_MODEL_DISPATCH)
+		return dispatch_graphs_reload();
+
+	node_processes_update();
+
+	// hitless update of the current graph when possible
+	if (worker_graph_update(worker) == 0)
+		return 0;
+
+	next = !atomic_load(&worker->cur_config);
 
-		if (worker->graph[next] != NULL) {
-			node_data_reset(worker->graph[next]->name);
-			if ((ret = rte_graph_destroy(worker->graph[next]->id)) < 0)
-				errno_log(-ret, "rte_graph_destroy");
-			worker->graph[next] = NULL;
+	if ((ret = worker_graph_new(worker, next)) < 0)
+		return errno_log(-ret, "worker_graph_new");
+
+	// wait for datapath worker to pickup the config update
+	atomic_store_explicit(&worker->next_config, next, memory_order_release);
+	worker_wakeup(worker);
+	while (atomic_load_explicit(&worker->cur_config, memory_order_acquire) != next)
+		usleep(500);
+
+	// free old config
+	next = !next;
+
+	if (worker->graph[next] != NULL) {
+		graph_destroy(worker->graph[next]);
+		worker->graph[next] = NULL;
+	}
+
+	return 0;
+}
+
+int worker_graph_reload_all(void) {
+	struct worker *worker;
+	int ret;
+
+	if (graph_model == GR_GRAPH_MODEL_DISPATCH)
+		return dispatch_graphs_reload();
+
+	STAILQ_FOREACH (worker, &workers, next) {
+		if ((ret = worker_graph_reload(worker)) < 0)
+			return ret;
+	}
+	// the workers do not use the clones anymore
+	dispatch_parents_free();
+
+	return 0;
+}
+
+uint8_t graph_model_get(void) {
+	return graph_model;
+}
+
+int graph_model_set(uint8_t model) {
+	uint8_t old = graph_model;
+	int ret;
+
+	switch (model) {
+	case GR_GRAPH_MODEL_RTC:
+	case GR_GRAPH_MODEL_DISPATCH:
+		break;
+	default:
+		return errno_set(EINVAL);
+	}
+	if (model == graph_model)
+		return 0;
+
+	graph_model = model;
+	if ((ret = worker_graph_reload_all()) < 0) {
+		graph_model = old;
+		return ret;
+	}
+	LOG(INFO, "using %s graph model", model == GR_GRAPH_MODEL_RTC ? "rtc" : "dispatch");
+
+	return 0;
+}
+
+const struct gr_graph_affinity *graph_affinity_list(void) {
+	return graph_affinities;
+}
+
+int graph_affinity_set(const char *node, uint16_t cpu_id) {
+	struct gr_graph_affinity *a = NULL;
+	struct gr_graph_affinity *iter;
+	struct gr_node_info *info;
+
+	STAILQ_FOREACH (info, &node_infos, next) {
+		if (strcmp(info->node->name, node) == 0)
+			break;
+	}
+	if (info == NULL)
+		return errno_set(ENOENT);
+	// source nodes run on every worker
+	if (info->node->flags & RTE_NODE_SOURCE_F)
+		return errno_set(EINVAL);
+	if (cpu_id != UINT16_MAX && worker_find(cpu_id) == NULL)
+		return errno_set(ENODEV);
+
+	arrforeach (iter, graph_affinities) {
+		if (strcmp(iter->node, node) == 0) {
+			a = iter;
+			break;
 		}
 	}
+	if (cpu_id == UINT16_MAX) {
+		if (a != NULL)
+			arrdelswap(graph_affinities, a - graph_affinities);
+	} else if (a != NULL) {
+		a->cpu_id = cpu_id;
+	} else {
+		struct gr_graph_affinity new = {.cpu_id = cpu_id};
+		memccpy(new.node, node, 0, sizeof(new.node));
+		arrpush(graph_affinities, new);
+	}
+
+	if (graph_model == GR_GRAPH_MODEL_DISPATCH)
+		return dispatch_graphs_reload();
 
 	return 0;
 }
 
-static void graph_init(struct event_base *) {
+// Recreate the graphs of the workers which use stale node variants.
+static void specialize_cb(evutil_socket_t, short, void *) {
+	struct worker *worker;
+	unsigned cur;
+
+	node_processes_update();
+
+	STAILQ_FOREACH (worker, &workers, next) {
+		cur = atomic_load(&worker->cur_config);
+		if (worker->graph[cur] == NULL || worker->graph_gen[cur] == node_processes_gen)
+			continue;
+		if (worker_graph_reload(worker) < 0)
+			errno_log(errno, "worker_graph_reload");
+	}
+}
+
+void gr_node_specialize(void) {
+	if (specialize_ev != NULL)
+		event_active(specialize_ev, 0, 0);
+}
+
+static void graph_init(struct event_base *ev_base) {
 	struct rte_node_register *reg;
 	struct gr_node_info *info;
 
@@ -283,6 +728,16 @@ static void graph_init(struct event_base *) {
 		}
 	}
 
+	node_processes = calloc(rte_node_max_count(), sizeof(*node_processes));
+	if (node_processes == NULL)
+		ABORT("calloc(node_processes) failed");
+	STAILQ_FOREACH (info, &node_infos, next)
+		node_processes[info->node->id] = info->node->process;
+
+	specialize_ev = gr_event_new(ev_base, -1, EV_FINALIZE, specialize_cb, NULL);
+	if (specialize_ev == NULL)
+		ABORT("gr_event_new() failed");
+
 	struct rte_hash_parameters params = {
 		.name = "node_data",
 		.entries = 1024,
@@ -313,10 +768,33 @@ static void graph_fini(struct event_base *) {
 	rte_hash_free(hash);
 	hash = NULL;
 
+	dispatch_parents_free();
+	arrfree(graph_affinities);
+	graph_affinities = NULL;
 	arrfree(node_names);
 	node_names = NULL;
+	free(node_processes);
+	node_processes = NULL;
+	gr_event_free(specialize_ev);
+	specialize_ev = NULL;
+}
+
+static void graph_iface_event(iface_event_t event, struct iface *) {
+	switch (event) {
+	case IFACE_EVENT_POST_ADD:
+	case IFACE_EVENT_PRE_REMOVE:
+		// The interface is only removed once all handlers have returned.
+		gr_node_specialize();
+		break;
+	default:
+		break;
+	}
 }
 
+static struct iface_event_handler graph_iface_event_handler = {
+	.callback = graph_iface_event,
+};
+
 static struct gr_module graph_module = {
 	.name = "graph",
 	.init = graph_init,
@@ -326,4 +804,5 @@ static struct gr_module graph_module = {
 
 RTE_INIT(control_graph_init) {
 	gr_register_module(&graph_module);
+	iface_event_register_handler(&graph_iface_event_handler);
 }
@@ -6,6 +6,8 @@
 
 #include <gr_worker.h>
 
+// Apply the queue assignments of a single worker.
+int worker_graph_reload(struct worker *);
 int worker_graph_reload_all(void);
 void worker_graph_free(struct worker *);
 
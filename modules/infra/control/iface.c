@@ -2,10 +2,12 @@
 // Copyright (c) 2024 Robin Jarry
 
 #include "gr_iface.h"
+#include "gr_vlan.h"
 
 #include <gr_control.h>
 #include <gr_log.h>
 #include <gr_macro.h>
+#include <gr_rcu.h>
 #include <gr_stb_ds.h>
 #include <gr_string.h>
 
@@ -49,8 +51,83 @@ static int next_ifid(uint16_t *ifid) {
 	return errno_set(ENOSPC);
 }
 
+struct iface_stats *iface_stats[RTE_MAX_LCORE];
+// Counters values at interface creation or last reset. Per lcore counters are
+// never written by the control plane.
+static struct iface_stats iface_stats_base[MAX_IFACES];
+
+static void policy_counters_add(
+	struct iface_tx_policy_counters *sum,
+	const struct iface_tx_policy_counters *c
+) {
+	sum->packets += c->packets;
+	sum->calls += c->calls;
+	sum->cycles += c->cycles;
+}
+
+static void policy_counters_sub(
+	struct iface_tx_policy_counters *sum,
+	const struct iface_tx_policy_counters *c
+) {
+	sum->packets -= c->packets;
+	sum->calls -= c->calls;
+	sum->cycles -= c->cycles;
+}
+
+static void iface_stats_sum(uint16_t ifid, struct iface_stats *sum) {
+	memset(sum, 0, sizeof(*sum));
+	for (unsigned lcore = 0; lcore < RTE_MAX_LCORE; lcore++) {
+		const struct iface_stats *s = iface_stats[lcore];
+		if (s == NULL)
+			continue;
+		sum->rx.packets += s[ifid].rx.packets;
+		sum->rx.bytes += s[ifid].rx.bytes;
+		sum->tx.packets += s[ifid].tx.packets;
+		sum->tx.bytes += s[ifid].tx.bytes;
+		policy_counters_add(&sum->tx_retry, &s[ifid].tx_retry);
+		policy_counters_add(&sum->tx_queue, &s[ifid].tx_queue);
+		policy_counters_add(&sum->tx_drop, &s[ifid].tx_drop);
+	}
+}
+
+void iface_stats_get(uint16_t ifid, struct iface_stats *stats) {
+	const struct iface_stats *base = &iface_stats_base[ifid];
+
+	iface_stats_sum(ifid, stats);
+	stats->rx.packets -= base->rx.packets;
+	stats->rx.bytes -= base->rx.bytes;
+	stats->tx.packets -= base->tx.packets;
+	stats->tx.bytes -= base->tx.bytes;
+	policy_counters_sub(&stats->tx_retry, &base->tx_retry);
+	policy_counters_sub(&stats->tx_queue, &base->tx_queue);
+	policy_counters_sub(&stats->tx_drop, &base->tx_drop);
+}
+
+void iface_stats_reset(uint16_t ifid) {
+	iface_stats_sum(ifid, &iface_stats_base[ifid]);
+}
+
 static STAILQ_HEAD(, iface_event_handler) event_handlers = STAILQ_HEAD_INITIALIZER(event_handlers);
 
+uint32_t iface_config_gen = 1;
+
+static void iface_config_changed(void) {
+	uint32_t gen = iface_config_gen + 1;
+	if (gen == 0)
+		gen = 1;
+	__atomic_store_n(&iface_config_gen, gen, __ATOMIC_RELEASE);
+}
+
+// Refresh the copy of the primary ethernet address read by eth_input.
+static void iface_eth_addr_refresh(struct iface *iface, const struct iface_type *type) {
+	struct rte_ether_addr mac = {0};
+
+	if (type->get_eth_addr != NULL && type->get_eth_addr(iface, &mac) < 0)
+		memset(&mac, 0, sizeof(mac));
+	if (!rte_is_same_ether_addr(&mac, &iface->mac))
+		iface->mac = mac;
+}
+
 void iface_event_register_handler(struct iface_event_handler *cb) {
 	STAILQ_INSERT_TAIL(&event_handlers, cb, next);
 }
@@ -104,8 +181,11 @@ struct iface *iface_create(
 
 	if (type->init(iface, api_info) < 0)
 		goto fail;
+	iface_eth_addr_refresh(iface, type);
 
+	iface_stats_reset(ifid);
 	ifaces[ifid] = iface;
+	iface_config_changed();
 
 	iface_event_notify(IFACE_EVENT_POST_ADD, iface);
 
@@ -128,6 +208,7 @@ int iface_reconfig(
 ) {
 	struct iface_type *type;
 	struct iface *iface;
+	int ret;
 
 	if (set_attrs == 0)
 		return errno_set(EINVAL);
@@ -151,7 +232,13 @@ int iface_reconfig(
 
 	type = iface_type_get(iface->type_id);
 	assert(type != NULL);
-	return type->reconfig(iface, set_attrs, flags, mtu, vrf_id, api_info);
+	ret = type->reconfig(iface, set_attrs, flags, mtu, vrf_id, api_info);
+	iface_eth_addr_refresh(iface, type);
+	iface_config_changed();
+	if (ret == 0)
+		iface_event_notify(IFACE_EVENT_POST_RECONFIG, iface);
+
+	return ret;
 }
 
 uint16_t ifaces_count(uint16_t type_id) {
@@ -192,6 +279,16 @@ struct iface *iface_from_id(uint16_t ifid) {
 	return iface;
 }
 
+void iface_set_ucast_addrs(struct iface *iface, const struct rte_ether_addr *macs, unsigned n) {
+	n = RTE_MIN(n, (unsigned)IFACE_MAX_UCAST);
+	// shrink first so that the datapath never reads stale entries
+	if (n < iface->n_ucast)
+		__atomic_store_n(&iface->n_ucast, n, __ATOMIC_RELEASE);
+	for (unsigned i = 0; i < n; i++)
+		iface->ucast[i] = macs[i];
+	__atomic_store_n(&iface->n_ucast, n, __ATOMIC_RELEASE);
+}
+
 int iface_get_eth_addr(uint16_t ifid, struct rte_ether_addr *mac) {
 	struct iface *iface = iface_from_id(ifid);
 	struct iface_type *type;
@@ -207,6 +304,20 @@ int iface_get_eth_addr(uint16_t ifid, struct rte_ether_addr *mac) {
 	return type->get_eth_addr(iface, mac);
 }
 
+bool iface_link_down(const struct iface *iface) {
+	const struct iface_info_vlan *vlan;
+
+	switch (iface->type_id) {
+	case GR_IFACE_TYPE_PORT:
+	case GR_IFACE_TYPE_BOND:
+		return !(iface->state & GR_IFACE_S_RUNNING);
+	case GR_IFACE_TYPE_VLAN:
+		vlan = (const struct iface_info_vlan *)iface->info;
+		return vlan->parent != NULL && iface_link_down(vlan->parent);
+	}
+	return false;
+}
+
 void iface_add_subinterface(struct iface *parent, const struct iface *sub) {
 	const struct iface **s;
 	arrforeach (s, parent->subinterfaces) {
@@ -255,6 +366,13 @@ int iface_del_eth_addr(uint16_t ifid, const struct rte_ether_addr *mac) {
 	return type->del_eth_addr(iface, mac);
 }
 
+static void iface_free(void *obj) {
+	struct iface *iface = obj;
+	free(iface->name);
+	arrfree(iface->subinterfaces);
+	rte_free(iface);
+}
+
 int iface_destroy(uint16_t ifid) {
 	struct iface *iface = iface_from_id(ifid);
 	struct iface_type *type;
@@ -269,12 +387,12 @@ int iface_destroy(uint16_t ifid) {
 	iface_event_notify(IFACE_EVENT_PRE_REMOVE, iface);
 
 	ifaces[ifid] = NULL;
+	iface_config_changed();
 	type = iface_type_get(iface->type_id);
 	assert(type != NULL);
 	ret = type->fini(iface);
-	free(iface->name);
-	arrfree(iface->subinterfaces);
-	rte_free(iface);
+	// Datapath workers may still be using this interface.
+	gr_rcu_defer_free(iface_free, iface);
 
 	return ret;
 }
@@ -310,6 +428,27 @@ static void iface_fini(struct event_base *) {
 
 	rte_free(ifaces);
 	ifaces = NULL;
+
+	for (unsigned lcore = 0; lcore < RTE_MAX_LCORE; lcore++) {
+		rte_free(iface_stats[lcore]);
+		iface_stats[lcore] = NULL;
+	}
+}
+
+static void iface_init_dp(void) {
+	unsigned lcore = rte_lcore_id();
+
+	if (iface_stats[lcore] != NULL)
+		return;
+
+	iface_stats[lcore] = rte_zmalloc_socket(
+		__func__,
+		MAX_IFACES * sizeof(struct iface_stats),
+		RTE_CACHE_LINE_SIZE,
+		rte_socket_id()
+	);
+	if (iface_stats[lcore] == NULL)
+		ABORT("rte_zmalloc_socket(iface_stats)");
 }
 
 static struct gr_module iface_module = {
@@ -317,6 +456,7 @@ static struct gr_module iface_module = {
 	.init = iface_init,
 	.fini = iface_fini,
 	.fini_prio = 1000,
+	.init_dp = iface_init_dp,
 };
 
 static void iface_event_debug(iface_event_t event, struct iface *iface) {
@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_control.h>
+#include <gr_log.h>
+#include <gr_memory.h>
+#include <gr_stb_ds.h>
+
+#include <event2/event.h>
+#include <rte_common.h>
+#include <rte_malloc.h>
+#include <rte_memory.h>
+#include <rte_mempool.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/queue.h>
+
+static STAILQ_HEAD(, gr_mem_reporter) reporters = STAILQ_HEAD_INITIALIZER(reporters);
+static uint64_t heap_max[RTE_MAX_NUMA_NODES];
+static uint64_t other_max[RTE_MAX_NUMA_NODES];
+static struct event *sample_ev;
+
+void gr_mem_reporter_register(struct gr_mem_reporter *r) {
+	STAILQ_INSERT_TAIL(&reporters, r, next);
+}
+
+void gr_mem_account(uint64_t bytes[RTE_MAX_NUMA_NODES], const void *addr, size_t len) {
+	const struct rte_memseg_list *msl = NULL;
+	int socket_id = 0;
+
+	if (addr != NULL)
+		msl = rte_mem_virt2memseg_list(addr);
+	// memory without NUMA affinity (e.g. --no-huge) is accounted to socket 0
+	if (msl != NULL && msl->socket_id >= 0 && msl->socket_id < RTE_MAX_NUMA_NODES)
+		socket_id = msl->socket_id;
+
+	bytes[socket_id] += len;
+}
+
+static void
+mempool_chunk_cb(struct rte_mempool *, void *bytes, struct rte_mempool_memhdr *hdr, unsigned) {
+	gr_mem_account(bytes, hdr->addr, hdr->len);
+}
+
+void gr_mem_account_mempool(uint64_t bytes[RTE_MAX_NUMA_NODES], struct rte_mempool *mp) {
+	if (mp != NULL)
+		rte_mempool_mem_iter(mp, mempool_chunk_cb, bytes);
+}
+
+static void usage_push(
+	struct gr_mem_usage **usages,
+	const char *subsystem,
+	int socket_id,
+	uint64_t used,
+	uint64_t used_max,
+	uint64_t total
+) {
+	struct gr_mem_usage u = {
+		.socket_id = socket_id,
+		.used = used,
+		.used_max = used_max,
+		.total = total,
+	};
+
+	if (usages == NULL)
+		return;
+	memccpy(u.subsystem, subsystem, 0, sizeof(u.subsystem) - 1);
+	arrpush(*usages, u); // NOLINT
+}
+
+static void mem_sample(struct gr_mem_usage **usages) {
+	uint64_t attributed[RTE_MAX_NUMA_NODES] = {0};
+	uint64_t bytes[RTE_MAX_NUMA_NODES];
+	struct rte_malloc_socket_stats stats;
+	struct gr_mem_reporter *r;
+	uint64_t other;
+
+	STAILQ_FOREACH (r, &reporters, next) {
+		memset(bytes, 0, sizeof(bytes));
+		r->usage(bytes);
+		for (unsigned s = 0; s < RTE_MAX_NUMA_NODES; s++) {
+			attributed[s] += bytes[s];
+			r->max[s] = RTE_MAX(r->max[s], bytes[s]);
+			if (r->max[s] != 0)
+				usage_push(usages, r->name, s, bytes[s], r->max[s], 0);
+		}
+	}
+
+	for (unsigned s = 0; s < RTE_MAX_NUMA_NODES; s++) {
+		if (rte_malloc_get_socket_stats(s, &stats) < 0 || stats.heap_totalsz_bytes == 0)
+			continue;
+		heap_max[s] = RTE_MAX(heap_max[s], stats.heap_allocsz_bytes);
+		usage_push(
+			usages,
+			GR_MEM_HEAP,
+			s,
+			stats.heap_allocsz_bytes,
+			heap_max[s],
+			stats.heap_totalsz_bytes
+		);
+		// reports are estimates and may exceed the actual allocations
+		other = 0;
+		if (stats.heap_allocsz_bytes > attributed[s])
+			other = stats.heap_allocsz_bytes - attributed[s];
+		other_max[s] = RTE_MAX(other_max[s], other);
+		usage_push(usages, GR_MEM_OTHER, s, other, other_max[s], 0);
+	}
+}
+
+int gr_mem_usage_get(struct gr_mem_usage **usages) {
+	*usages = NULL;
+	mem_sample(usages);
+	return arrlen(*usages);
+}
+
+static void mem_sample_cb(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	mem_sample(NULL);
+}
+
+static void memory_init(struct event_base *ev_base) {
+	struct timeval tv = {.tv_sec = 1};
+
+	sample_ev = gr_event_new(ev_base, -1, EV_PERSIST | EV_FINALIZE, mem_sample_cb, NULL);
+	if (sample_ev == NULL || event_add(sample_ev, &tv) < 0)
+		ABORT("failed to add memory sampling event");
+}
+
+static void memory_fini(struct event_base *) {
+	if (sample_ev != NULL) {
+		gr_event_free(sample_ev);
+		sample_ev = NULL;
+	}
+}
+
+static struct gr_module memory_module = {
+	.name = "memory",
+	.init = memory_init,
+	.fini = memory_fini,
+	// stop sampling before the reporters release their memory
+	.fini_prio = -2000,
+};
+
+RTE_INIT(memory_constructor) {
+	gr_register_module(&memory_module);
+}
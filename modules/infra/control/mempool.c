@@ -3,12 +3,23 @@
 
 #include "gr_mempool.h"
 
+#include <gr.h>
 #include <gr_log.h>
 #include <gr_mbuf.h>
+#include <gr_memory.h>
+
+#include <rte_malloc.h>
+#include <rte_memory.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 struct mempool_tracker {
 	struct rte_mempool *mp;
 	uint32_t reserved;
+	uint16_t data_room;
+	bool private; // dedicated to a single port, never shared
 };
 
 #define MAX_MEMPOOL_PER_NUMA 32
@@ -32,7 +43,26 @@ static int mt_sort(const void *p1, const void *p2) {
 static struct mempool_tracker trackers[MT_COUNT][MAX_MEMPOOL_PER_NUMA];
 static uint32_t mempool_default_size = MEMPOOL_DEFAULT_SIZE;
 
-struct rte_mempool *gr_pktmbuf_pool_get(int8_t socket_id, uint32_t count) {
+// Write to every page of the pool memory so that the first packets received
+// after startup do not take page faults on mbufs that were never used.
+static void pool_prefault(struct rte_mempool *, void *, struct rte_mempool_memhdr *hdr, unsigned) {
+	volatile uint8_t *addr = hdr->addr;
+	const struct rte_memseg *ms;
+	size_t page_size = 0;
+
+	if ((ms = rte_mem_virt2memseg(hdr->addr, NULL)) != NULL)
+		page_size = ms->hugepage_sz;
+	if (page_size == 0)
+		page_size = sysconf(_SC_PAGESIZE);
+
+	for (size_t off = 0; off < hdr->len; off += page_size)
+		addr[off] = addr[off];
+}
+
+// Get a pool with enough room for count mbufs of data_room bytes. When name is
+// not NULL, a new pool is created and will not be shared with other users.
+static struct rte_mempool *
+pool_get(int8_t socket_id, uint32_t count, uint16_t data_room, const char *name) {
 	char mp_name[RTE_MEMPOOL_NAMESIZE];
 	struct rte_mempool *mp = NULL;
 	uint32_t alloc_size;
@@ -44,33 +74,43 @@ struct rte_mempool *gr_pktmbuf_pool_get(int8_t socket_id, uint32_t count) {
 		unsigned mt_index = socket_id == SOCKET_ID_ANY ? 0 : socket_id + 1;
 		struct mempool_tracker *mt = &trackers[mt_index][i];
 		if (mt->mp == NULL) {
-			alloc_size = mempool_default_size;
-			if (count > mempool_default_size / 4) {
-				alloc_size = count * 2;
-				alloc_size = rte_align32pow2(alloc_size) - 1;
-				// For future mempools, increase default size;
-				mempool_default_size = alloc_size;
+			if (name != NULL) {
+				alloc_size = count;
+				memccpy(mp_name, name, 0, sizeof(mp_name));
+			} else {
+				alloc_size = mempool_default_size;
+				if (count > mempool_default_size / 4) {
+					alloc_size = count * 2;
+					alloc_size = rte_align32pow2(alloc_size) - 1;
+					// For future mempools, increase default size;
+					mempool_default_size = alloc_size;
+				}
+				snprintf(mp_name, sizeof(mp_name), "mbuf_%d:%d", socket_id, i);
 			}
-			sprintf(mp_name, "mbuf_%d:%d", socket_id, i);
 			LOG(DEBUG,
-			    "allocate mempool %s reserved %u (size %u)",
+			    "allocate mempool %s reserved %u (size %u, data room %u)",
 			    mp_name,
 			    count,
-			    alloc_size);
+			    alloc_size,
+			    data_room);
 			mt->mp = rte_pktmbuf_pool_create(
 				mp_name,
 				alloc_size,
-				RTE_MEMPOOL_CACHE_MAX_SIZE,
+				gr_args()->mempool_cache,
 				GR_MBUF_PRIV_MAX_SIZE,
-				RTE_MBUF_DEFAULT_BUF_SIZE,
+				data_room,
 				socket_id
 			);
 			if (mt->mp == NULL)
 				return errno_set_null(rte_errno);
+			rte_mempool_mem_iter(mt->mp, pool_prefault, NULL);
 			mt->reserved = count;
+			mt->data_room = data_room;
+			mt->private = name != NULL;
 			mp = mt->mp;
 			break;
-		} else if ((count + mt->reserved) <= mt->mp->size) {
+		} else if (name == NULL && !mt->private && mt->data_room == data_room
+			   && (count + mt->reserved) <= mt->mp->size) {
 			LOG(DEBUG,
 			    "reuse mempool %s reserved %u -> %u (size %u)",
 			    mt->mp->name,
@@ -91,6 +131,35 @@ struct rte_mempool *gr_pktmbuf_pool_get(int8_t socket_id, uint32_t count) {
 	return mp;
 }
 
+struct rte_mempool *gr_pktmbuf_pool_get(int8_t socket_id, uint32_t count) {
+	return pool_get(socket_id, count, RTE_MBUF_DEFAULT_BUF_SIZE, NULL);
+}
+
+struct rte_mempool *gr_pktmbuf_pool_get_port(
+	uint16_t port_id,
+	int8_t socket_id,
+	uint32_t count,
+	uint16_t data_room
+) {
+	char name[RTE_MEMPOOL_NAMESIZE];
+
+	if (!gr_args()->port_pools)
+		return pool_get(socket_id, count, data_room, NULL);
+
+	snprintf(name, sizeof(name), "mbuf_port%u", port_id);
+	return pool_get(socket_id, count, data_room, name);
+}
+
+uint32_t gr_pktmbuf_pool_reserved(const struct rte_mempool *mp) {
+	for (int s = 0; s < MT_COUNT; s++) {
+		for (int i = 0; i < MAX_MEMPOOL_PER_NUMA; i++) {
+			if (trackers[s][i].mp == mp)
+				return trackers[s][i].reserved;
+		}
+	}
+	return 0;
+}
+
 void gr_pktmbuf_pool_release(struct rte_mempool *mp, uint32_t count) {
 	if (mp == NULL)
 		return;
@@ -111,6 +180,8 @@ void gr_pktmbuf_pool_release(struct rte_mempool *mp, uint32_t count) {
 					rte_mempool_free(mp);
 					mt->mp = NULL;
 					mt->reserved = 0;
+					mt->data_room = 0;
+					mt->private = false;
 				}
 				break;
 			}
@@ -121,3 +192,43 @@ void gr_pktmbuf_pool_release(struct rte_mempool *mp, uint32_t count) {
 		qsort(mt, MAX_MEMPOOL_PER_NUMA, sizeof(*mt), mt_sort);
 	}
 }
+
+unsigned gr_numa_sockets(int sockets[RTE_MAX_NUMA_NODES]) {
+	struct rte_malloc_socket_stats stats;
+	int local = rte_socket_id();
+	unsigned n = 0;
+
+	if (local >= 0 && local < RTE_MAX_NUMA_NODES)
+		sockets[n++] = local;
+
+	for (unsigned i = 0; i < rte_socket_count(); i++) {
+		int socket_id = rte_socket_id_by_idx(i);
+		if (socket_id == local || socket_id < 0 || socket_id >= RTE_MAX_NUMA_NODES)
+			continue;
+		if (rte_malloc_get_socket_stats(socket_id, &stats) < 0)
+			continue;
+		if (stats.heap_totalsz_bytes == 0)
+			continue;
+		sockets[n++] = socket_id;
+	}
+	if (n == 0)
+		sockets[n++] = SOCKET_ID_ANY;
+
+	return n;
+}
+
+static void mbuf_pools_usage(uint64_t bytes[RTE_MAX_NUMA_NODES]) {
+	for (int s = 0; s < MT_COUNT; s++) {
+		for (int i = 0; i < MAX_MEMPOOL_PER_NUMA; i++)
+			gr_mem_account_mempool(bytes, trackers[s][i].mp);
+	}
+}
+
+static struct gr_mem_reporter mbuf_pools_reporter = {
+	.name = "mbuf pools",
+	.usage = mbuf_pools_usage,
+};
+
+RTE_INIT(mempool_constructor) {
+	gr_mem_reporter_register(&mbuf_pools_reporter);
+}
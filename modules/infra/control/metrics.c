@@ -0,0 +1,500 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr.h>
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_log.h>
+#include <gr_port.h>
+#include <gr_stats_shm.h>
+
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/event.h>
+#include <event2/listener.h>
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_telemetry.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+
+// Maximum size of the request headers.
+#define METRICS_MAX_REQUEST 8192
+
+struct metrics_conn {
+	struct bufferevent *bev;
+	LIST_ENTRY(metrics_conn) next;
+};
+
+static LIST_HEAD(, metrics_conn) metrics_conns = LIST_HEAD_INITIALIZER(metrics_conns);
+static struct evconnlistener *listener;
+
+// Copy a consistent snapshot of the statistics segment. The segment is mapped
+// for each call, this can be used from any thread.
+static struct gr_stats_shm *metrics_snapshot(void) {
+	const struct gr_stats_shm *shm;
+	struct gr_stats_shm *copy;
+
+	if ((shm = gr_stats_shm_open(gr_args()->stats_shm_name)) == NULL)
+		return NULL;
+	if ((copy = malloc(shm->size)) == NULL) {
+		gr_stats_shm_close(shm);
+		return errno_set_null(ENOMEM);
+	}
+	if (gr_stats_shm_read(shm, copy, shm->size) < 0) {
+		gr_stats_shm_close(shm);
+		free(copy);
+		return NULL;
+	}
+	gr_stats_shm_close(shm);
+
+	return copy;
+}
+
+#define METRIC_TYPE(out, name, type, help)                                                         \
+	evbuffer_add_printf(out, "# HELP " name " " help "\n# TYPE " name " " type "\n")
+
+static void metrics_workers(struct evbuffer *out, const struct gr_stats_shm *shm) {
+	const struct gr_stats_shm_worker *w;
+
+	METRIC_TYPE(out, "grout_worker_cycles_total", "counter", "Worker CPU cycles.");
+	for (uint32_t i = 0; i < shm->n_workers; i++) {
+		w = gr_stats_shm_worker(shm, i);
+		evbuffer_add_printf(
+			out,
+			"grout_worker_cycles_total{cpu=\"%u\",state=\"busy\"} %" PRIu64 "\n"
+			"grout_worker_cycles_total{cpu=\"%u\",state=\"sleep\"} %" PRIu64 "\n",
+			w->cpu_id,
+			w->busy_cycles,
+			w->cpu_id,
+			w->sleep_cycles
+		);
+	}
+	METRIC_TYPE(out, "grout_worker_sleeps_total", "counter", "Worker micro-sleeps.");
+	for (uint32_t i = 0; i < shm->n_workers; i++) {
+		w = gr_stats_shm_worker(shm, i);
+		evbuffer_add_printf(
+			out,
+			"grout_worker_sleeps_total{cpu=\"%u\"} %" PRIu64 "\n",
+			w->cpu_id,
+			w->n_sleeps
+		);
+	}
+}
+
+static void metrics_nodes(struct evbuffer *out, const struct gr_stats_shm *shm) {
+	static const struct {
+		const char *name;
+		const char *help;
+		size_t offset;
+	} fields[] = {
+		{"grout_node_packets_total",
+		 "Packets processed by graph nodes.",
+		 offsetof(struct gr_stats_shm_node, objs)},
+		{"grout_node_calls_total",
+		 "Graph node process calls.",
+		 offsetof(struct gr_stats_shm_node, calls)},
+		{"grout_node_cycles_total",
+		 "CPU cycles spent in graph nodes.",
+		 offsetof(struct gr_stats_shm_node, cycles)},
+	};
+	const struct gr_stats_shm_worker *w;
+	const struct gr_stats_shm_node *n;
+
+	for (unsigned f = 0; f < ARRAY_DIM(fields); f++) {
+		evbuffer_add_printf(
+			out,
+			"# HELP %s %s\n# TYPE %s counter\n",
+			fields[f].name,
+			fields[f].help,
+			fields[f].name
+		);
+		for (uint32_t i = 0; i < shm->n_workers; i++) {
+			w = gr_stats_shm_worker(shm, i);
+			for (uint32_t node = 0; node < shm->max_nodes; node++) {
+				n = &w->nodes[node];
+				if (n->calls == 0)
+					continue;
+				evbuffer_add_printf(
+					out,
+					"%s{cpu=\"%u\",node=\"%s\"} %" PRIu64 "\n",
+					fields[f].name,
+					w->cpu_id,
+					gr_stats_shm_node_name(shm, node),
+					*(const uint64_t *)((const uint8_t *)n + fields[f].offset)
+				);
+			}
+		}
+	}
+}
+
+static void metrics_ports(struct evbuffer *out, const struct gr_stats_shm *shm) {
+	static const struct {
+		const char *name;
+		size_t offset;
+	} fields[] = {
+		{"grout_port_rx_packets_total", offsetof(struct gr_stats_shm_port, rx_packets)},
+		{"grout_port_rx_bytes_total", offsetof(struct gr_stats_shm_port, rx_bytes)},
+		{"grout_port_rx_missed_total", offsetof(struct gr_stats_shm_port, rx_missed)},
+		{"grout_port_rx_errors_total", offsetof(struct gr_stats_shm_port, rx_errors)},
+		{"grout_port_rx_nombuf_total", offsetof(struct gr_stats_shm_port, rx_nombuf)},
+		{"grout_port_tx_packets_total", offsetof(struct gr_stats_shm_port, tx_packets)},
+		{"grout_port_tx_bytes_total", offsetof(struct gr_stats_shm_port, tx_bytes)},
+		{"grout_port_tx_errors_total", offsetof(struct gr_stats_shm_port, tx_errors)},
+	};
+	const struct gr_stats_shm_port *p;
+
+	for (unsigned f = 0; f < ARRAY_DIM(fields); f++) {
+		evbuffer_add_printf(out, "# TYPE %s counter\n", fields[f].name);
+		for (uint32_t i = 0; i < shm->n_ports; i++) {
+			p = gr_stats_shm_port(shm, i);
+			evbuffer_add_printf(
+				out,
+				"%s{iface=\"%s\"} %" PRIu64 "\n",
+				fields[f].name,
+				p->name,
+				*(const uint64_t *)((const uint8_t *)p + fields[f].offset)
+			);
+		}
+	}
+}
+
+// Extended stats are not published in the statistics segment. They are read
+// from the driver, this is only called from the control plane thread.
+static void metrics_xstats(struct evbuffer *out) {
+	struct rte_eth_xstat_name *names;
+	struct rte_eth_xstat *xstats;
+	struct iface *iface = NULL;
+	int num;
+
+	METRIC_TYPE(out, "grout_port_xstats_total", "counter", "Port driver extended stats.");
+	while ((iface = iface_next(GR_IFACE_TYPE_PORT, iface)) != NULL) {
+		const struct iface_info_port *port = (const struct iface_info_port *)iface->info;
+
+		if ((num = rte_eth_xstats_get(port->port_id, NULL, 0)) <= 0)
+			continue;
+		xstats = calloc(num, sizeof(*xstats));
+		names = calloc(num, sizeof(*names));
+		if (xstats == NULL || names == NULL)
+			goto next;
+		if (rte_eth_xstats_get(port->port_id, xstats, num) != num)
+			goto next;
+		if (rte_eth_xstats_get_names(port->port_id, names, num) != num)
+			goto next;
+		for (int i = 0; i < num; i++) {
+			evbuffer_add_printf(
+				out,
+				"grout_port_xstats_total{iface=\"%s\",name=\"%s\"} %" PRIu64 "\n",
+				iface->name,
+				names[i].name,
+				xstats[i].value
+			);
+		}
+next:
+		free(xstats);
+		free(names);
+	}
+}
+
+static int metrics_render(struct evbuffer *out) {
+	struct gr_stats_shm *shm;
+
+	if ((shm = metrics_snapshot()) == NULL)
+		return -errno;
+
+	METRIC_TYPE(out, "grout_tsc_hz", "gauge", "CPU cycles per second.");
+	evbuffer_add_printf(out, "grout_tsc_hz %" PRIu64 "\n", rte_get_tsc_hz());
+	metrics_workers(out, shm);
+	metrics_nodes(out, shm);
+	metrics_ports(out, shm);
+	metrics_xstats(out);
+	free(shm);
+
+	return 0;
+}
+
+static void metrics_conn_free(struct metrics_conn *conn) {
+	LIST_REMOVE(conn, next);
+	bufferevent_free(conn->bev);
+	free(conn);
+}
+
+static void metrics_conn_written(struct bufferevent *, void *priv) {
+	metrics_conn_free(priv);
+}
+
+static void metrics_conn_event(struct bufferevent *, short events, void *priv) {
+	if (events & (BEV_EVENT_EOF | BEV_EVENT_ERROR))
+		metrics_conn_free(priv);
+}
+
+static void metrics_reply(struct evbuffer *out, const char *status, struct evbuffer *body) {
+	evbuffer_add_printf(
+		out,
+		"HTTP/1.0 %s\r\n"
+		"Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+		"Content-Length: %zu\r\n"
+		"Connection: close\r\n"
+		"\r\n",
+		status,
+		evbuffer_get_length(body)
+	);
+	evbuffer_add_buffer(out, body);
+}
+
+static void metrics_conn_read(struct bufferevent *bev, void *priv) {
+	struct evbuffer *in = bufferevent_get_input(bev);
+	struct evbuffer *body;
+	struct evbuffer_ptr end;
+	const char *status;
+	char *line;
+
+	end = evbuffer_search(in, "\r\n\r\n", 4, NULL);
+	if (end.pos < 0) {
+		if (evbuffer_get_length(in) > METRICS_MAX_REQUEST)
+			metrics_conn_free(priv);
+		return; // wait for the end of the request headers
+	}
+
+	if ((line = evbuffer_readln(in, NULL, EVBUFFER_EOL_CRLF)) == NULL
+	    || (body = evbuffer_new()) == NULL) {
+		free(line);
+		metrics_conn_free(priv);
+		return;
+	}
+
+	if (strncmp(line, "GET /metrics ", strlen("GET /metrics ")) != 0) {
+		status = "404 Not Found";
+		evbuffer_add_printf(body, "not found\n");
+	} else if (metrics_render(body) < 0) {
+		status = "503 Service Unavailable";
+		evbuffer_drain(body, evbuffer_get_length(body));
+		evbuffer_add_printf(body, "%s\n", strerror(errno));
+	} else {
+		status = "200 OK";
+	}
+	free(line);
+
+	// close the connection once the response has been sent
+	bufferevent_disable(bev, EV_READ);
+	bufferevent_setcb(bev, NULL, metrics_conn_written, metrics_conn_event, priv);
+	metrics_reply(bufferevent_get_output(bev), status, body);
+	evbuffer_free(body);
+}
+
+static void metrics_accept(
+	struct evconnlistener *,
+	evutil_socket_t fd,
+	struct sockaddr *,
+	int /*socklen*/,
+	void *priv
+) {
+	struct event_base *base = priv;
+	struct metrics_conn *conn;
+
+	if ((conn = calloc(1, sizeof(*conn))) == NULL) {
+		evutil_closesocket(fd);
+		return;
+	}
+	conn->bev = bufferevent_socket_new(base, fd, BEV_OPT_CLOSE_ON_FREE);
+	if (conn->bev == NULL) {
+		evutil_closesocket(fd);
+		free(conn);
+		return;
+	}
+	LIST_INSERT_HEAD(&metrics_conns, conn, next);
+	bufferevent_setcb(conn->bev, metrics_conn_read, NULL, metrics_conn_event, conn);
+	bufferevent_enable(conn->bev, EV_READ);
+}
+
+// Parse IP:PORT or [IP6]:PORT.
+static struct addrinfo *metrics_addr(const char *addr) {
+	struct addrinfo hints = {
+		.ai_flags = AI_PASSIVE | AI_NUMERICHOST | AI_NUMERICSERV,
+		.ai_socktype = SOCK_STREAM,
+	};
+	struct addrinfo *res = NULL;
+	char *host, *port;
+	int ret;
+
+	if ((host = strdup(addr)) == NULL)
+		return errno_set_null(ENOMEM);
+	if ((port = strrchr(host, ':')) == NULL) {
+		free(host);
+		return errno_set_null(EINVAL);
+	}
+	*port++ = '\0';
+	if (host[0] == '[' && port - host >= 3 && port[-2] == ']') {
+		port[-2] = '\0';
+		memmove(host, host + 1, strlen(host));
+	}
+	if ((ret = getaddrinfo(host, port, &hints, &res)) != 0) {
+		LOG(ERR, "%s: %s", addr, gai_strerror(ret));
+		free(host);
+		return errno_set_null(EINVAL);
+	}
+	free(host);
+
+	return res;
+}
+
+static void metrics_init(struct event_base *ev_base) {
+	const char *addr = gr_args()->metrics_listen;
+	struct addrinfo *ai;
+
+	if (addr == NULL)
+		return;
+
+	if ((ai = metrics_addr(addr)) == NULL)
+		ABORT("invalid metrics address: %s", addr);
+
+	listener = evconnlistener_new_bind(
+		ev_base,
+		metrics_accept,
+		ev_base,
+		LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE | LEV_OPT_CLOSE_ON_EXEC,
+		-1,
+		ai->ai_addr,
+		ai->ai_addrlen
+	);
+	freeaddrinfo(ai);
+	if (listener == NULL)
+		ABORT("metrics listen on %s: %s", addr, strerror(errno));
+
+	LOG(INFO, "serving metrics on http://%s/metrics", addr);
+}
+
+static void metrics_fini(struct event_base *) {
+	struct metrics_conn *conn;
+
+	while ((conn = LIST_FIRST(&metrics_conns)) != NULL)
+		metrics_conn_free(conn);
+	if (listener != NULL) {
+		evconnlistener_free(listener);
+		listener = NULL;
+	}
+}
+
+// DPDK telemetry commands. They are executed in the telemetry thread and only
+// access the statistics segment.
+
+static int
+telemetry_workers(const char * /*cmd*/, const char * /*params*/, struct rte_tel_data *d) {
+	const struct gr_stats_shm_worker *w;
+	struct gr_stats_shm *shm;
+	struct rte_tel_data *c;
+	char key[32];
+
+	if ((shm = metrics_snapshot()) == NULL)
+		return -errno;
+
+	rte_tel_data_start_dict(d);
+	for (uint32_t i = 0; i < shm->n_workers; i++) {
+		w = gr_stats_shm_worker(shm, i);
+		if ((c = rte_tel_data_alloc()) == NULL)
+			break;
+		rte_tel_data_start_dict(c);
+		rte_tel_data_add_dict_uint(c, "total_cycles", w->total_cycles);
+		rte_tel_data_add_dict_uint(c, "busy_cycles", w->busy_cycles);
+		rte_tel_data_add_dict_uint(c, "sleep_cycles", w->sleep_cycles);
+		rte_tel_data_add_dict_uint(c, "sleeps", w->n_sleeps);
+		snprintf(key, sizeof(key), "cpu%u", w->cpu_id);
+		rte_tel_data_add_dict_container(d, key, c, 0);
+	}
+	free(shm);
+
+	return 0;
+}
+
+static int
+telemetry_nodes(const char * /*cmd*/, const char * /*params*/, struct rte_tel_data *d) {
+	const struct gr_stats_shm_node *n;
+	struct gr_stats_shm_node sum;
+	struct gr_stats_shm *shm;
+	struct rte_tel_data *c;
+
+	if ((shm = metrics_snapshot()) == NULL)
+		return -errno;
+
+	// sum of all workers
+	rte_tel_data_start_dict(d);
+	for (uint32_t node = 0; node < shm->max_nodes; node++) {
+		memset(&sum, 0, sizeof(sum));
+		for (uint32_t i = 0; i < shm->n_workers; i++) {
+			n = &gr_stats_shm_worker(shm, i)->nodes[node];
+			sum.objs += n->objs;
+			sum.calls += n->calls;
+			sum.cycles += n->cycles;
+		}
+		if (sum.calls == 0)
+			continue;
+		if ((c = rte_tel_data_alloc()) == NULL)
+			break;
+		rte_tel_data_start_dict(c);
+		rte_tel_data_add_dict_uint(c, "packets", sum.objs);
+		rte_tel_data_add_dict_uint(c, "calls", sum.calls);
+		rte_tel_data_add_dict_uint(c, "cycles", sum.cycles);
+		rte_tel_data_add_dict_container(d, gr_stats_shm_node_name(shm, node), c, 0);
+	}
+	free(shm);
+
+	return 0;
+}
+
+static int
+telemetry_ports(const char * /*cmd*/, const char * /*params*/, struct rte_tel_data *d) {
+	const struct gr_stats_shm_port *p;
+	struct gr_stats_shm *shm;
+	struct rte_tel_data *c;
+
+	if ((shm = metrics_snapshot()) == NULL)
+		return -errno;
+
+	rte_tel_data_start_dict(d);
+	for (uint32_t i = 0; i < shm->n_ports; i++) {
+		p = gr_stats_shm_port(shm, i);
+		if ((c = rte_tel_data_alloc()) == NULL)
+			break;
+		rte_tel_data_start_dict(c);
+		rte_tel_data_add_dict_uint(c, "port_id", p->port_id);
+		rte_tel_data_add_dict_uint(c, "rx_packets", p->rx_packets);
+		rte_tel_data_add_dict_uint(c, "rx_bytes", p->rx_bytes);
+		rte_tel_data_add_dict_uint(c, "rx_missed", p->rx_missed);
+		rte_tel_data_add_dict_uint(c, "rx_errors", p->rx_errors);
+		rte_tel_data_add_dict_uint(c, "rx_nombuf", p->rx_nombuf);
+		rte_tel_data_add_dict_uint(c, "tx_packets", p->tx_packets);
+		rte_tel_data_add_dict_uint(c, "tx_bytes", p->tx_bytes);
+		rte_tel_data_add_dict_uint(c, "tx_errors", p->tx_errors);
+		rte_tel_data_add_dict_container(d, p->name, c, 0);
+	}
+	free(shm);
+
+	return 0;
+}
+
+static struct gr_module metrics_module = {
+	.name = "metrics",
+	.init = metrics_init,
+	.fini = metrics_fini,
+};
+
+RTE_INIT(metrics_constructor) {
+	gr_register_module(&metrics_module);
+	rte_telemetry_register_cmd(
+		"/grout/workers", telemetry_workers, "Returns worker cycles. Takes no parameters"
+	);
+	rte_telemetry_register_cmd(
+		"/grout/nodes", telemetry_nodes, "Returns graph node stats. Takes no parameters"
+	);
+	rte_telemetry_register_cmd(
+		"/grout/ports", telemetry_ports, "Returns port stats. Takes no parameters"
+	);
+}
@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_infra.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+#include <gr_mirror.h>
+#include <gr_port.h>
+#include <gr_rcu.h>
+#include <gr_worker.h>
+
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+
+#include <errno.h>
+#include <sys/queue.h>
+
+// Shared by all mirror sessions. Copies only hold a reference on the original
+// data, most of them never use their own data room.
+#define MIRROR_POOL_SIZE 8191
+#define MIRROR_POOL_CACHE 256
+
+static struct rte_mempool *pool;
+
+static struct iface_info_port *mirror_port(const struct iface *iface) {
+	if (iface->type_id != GR_IFACE_TYPE_PORT)
+		return errno_set_null(EMEDIUMTYPE);
+	return (struct iface_info_port *)iface->info;
+}
+
+static struct port_mirror *
+mirror_new(const struct iface_info_port *dst, const struct gr_port_mirror *conf) {
+	struct port_mirror *mir;
+	struct worker *worker;
+	unsigned n_workers = 0;
+
+	// each worker gets an equal share of the rate
+	STAILQ_FOREACH (worker, &workers, next)
+		n_workers++;
+	if (n_workers == 0)
+		n_workers = 1;
+	if (conf->rate != 0 && conf->rate < n_workers)
+		return errno_set_null(ERANGE);
+
+	if (pool == NULL) {
+		pool = rte_pktmbuf_pool_create(
+			"mirror",
+			MIRROR_POOL_SIZE,
+			MIRROR_POOL_CACHE,
+			GR_MBUF_PRIV_MAX_SIZE,
+			RTE_MBUF_DEFAULT_BUF_SIZE,
+			SOCKET_ID_ANY
+		);
+		if (pool == NULL) {
+			errno_log(rte_errno, "rte_pktmbuf_pool_create(mirror)");
+			return NULL;
+		}
+	}
+
+	if ((mir = rte_zmalloc(__func__, sizeof(*mir), RTE_CACHE_LINE_SIZE)) == NULL)
+		return errno_set_null(ENOMEM);
+
+	mir->dst_port_id = dst->port_id;
+	mir->flags = conf->flags;
+	mir->multi_seg = dst->tx_offloads & RTE_ETH_TX_OFFLOAD_MULTI_SEGS;
+	mir->snaplen = conf->snaplen;
+	mir->rate = conf->rate / n_workers;
+	mir->pool = pool;
+
+	return mir;
+}
+
+int port_mirror_set(struct iface *iface, const struct gr_port_mirror *conf) {
+	struct iface_info_port *p, *dst = NULL;
+	struct port_mirror *mir = NULL, *old;
+	struct iface *dst_iface;
+
+	if ((p = mirror_port(iface)) == NULL)
+		return -errno;
+
+	if (conf->dst_iface_id != GR_IFACE_ID_UNDEF) {
+		if (conf->flags == 0
+		    || conf->flags & ~(GR_PORT_MIRROR_F_RX | GR_PORT_MIRROR_F_TX))
+			return errno_set(EINVAL);
+		if (conf->dst_iface_id == iface->id)
+			return errno_set(EINVAL);
+		if ((dst_iface = iface_from_id(conf->dst_iface_id)) == NULL)
+			return -errno;
+		if ((dst = mirror_port(dst_iface)) == NULL)
+			return -errno;
+		// copies are sent as-is on the monitor port, it cannot be mirrored
+		if (dst->mirror.dst_iface_id != GR_IFACE_ID_UNDEF)
+			return errno_set(EBUSY);
+		for (uint16_t i = 0; i < RTE_MAX_ETHPORTS; i++) {
+			const struct port_mirror *m = port_mirrors[i];
+			if (m != NULL && m->dst_port_id == p->port_id)
+				return errno_set(EBUSY);
+		}
+		if ((mir = mirror_new(dst, conf)) == NULL)
+			return -errno;
+	}
+
+	old = port_mirrors[p->port_id];
+	__atomic_store_n(&port_mirrors[p->port_id], mir, __ATOMIC_RELEASE);
+	gr_rcu_defer_free(rte_free, old);
+
+	p->mirror = *conf;
+	p->mirror.packets = 0;
+	p->mirror.dropped = 0;
+	if (mir == NULL) {
+		p->mirror.dst_iface_id = GR_IFACE_ID_UNDEF;
+		p->mirror.flags = 0;
+	}
+
+	if (mir != NULL)
+		LOG(INFO, "%s: mirrored to %s", iface->name, dst_iface->name);
+	else if (old != NULL)
+		LOG(INFO, "%s: mirror disabled", iface->name);
+
+	return 0;
+}
+
+int port_mirror_get(const struct iface *iface, struct gr_port_mirror *conf) {
+	const struct iface_info_port *p;
+	const struct port_mirror *mir;
+
+	if ((p = mirror_port(iface)) == NULL)
+		return -errno;
+
+	*conf = p->mirror;
+	if ((mir = port_mirrors[p->port_id]) != NULL) {
+		for (unsigned i = 0; i < RTE_DIM(mir->lcores); i++) {
+			conf->packets += mir->lcores[i].packets;
+			conf->dropped += mir->lcores[i].dropped;
+		}
+	}
+
+	return 0;
+}
+
+static void mirror_iface_event(iface_event_t event, struct iface *iface) {
+	struct gr_port_mirror disabled = {.dst_iface_id = GR_IFACE_ID_UNDEF};
+	struct iface_info_port *p;
+	struct iface *src = NULL;
+
+	if (event != IFACE_EVENT_PRE_REMOVE || iface->type_id != GR_IFACE_TYPE_PORT)
+		return;
+
+	p = (struct iface_info_port *)iface->info;
+	if (port_mirrors[p->port_id] != NULL)
+		port_mirror_set(iface, &disabled);
+
+	// sessions that send their copies to this port
+	while ((src = iface_next(GR_IFACE_TYPE_PORT, src)) != NULL) {
+		p = (struct iface_info_port *)src->info;
+		if (p->mirror.dst_iface_id == iface->id)
+			port_mirror_set(src, &disabled);
+	}
+}
+
+static void mirror_fini(struct event_base *) {
+	rte_mempool_free(pool);
+	pool = NULL;
+}
+
+static struct iface_event_handler mirror_iface_event_handler = {
+	.callback = mirror_iface_event,
+};
+
+static struct gr_module mirror_module = {
+	.name = "mirror",
+	.fini = mirror_fini,
+	// after the ports are closed, their queues may hold copies from the pool
+	.fini_prio = 1100,
+};
+
+RTE_INIT(mirror_constructor) {
+	gr_register_module(&mirror_module);
+	iface_event_register_handler(&mirror_iface_event_handler);
+}
@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_errno.h>
+#include <gr_nh_group.h>
+
+#include <errno.h>
+#include <string.h>
+
+int nh_group_rebalance(struct nh_group *g, unsigned n_members, void *const *members) {
+	unsigned count[NH_GROUP_MAX_MEMBERS] = {0};
+	unsigned target[NH_GROUP_MAX_MEMBERS];
+	int owner[NH_GROUP_BUCKETS];
+	unsigned b, i, base, extra;
+
+	if (n_members == 0 || n_members > NH_GROUP_MAX_MEMBERS)
+		return errno_set(ERANGE);
+
+	// Find the buckets that already point to one of the new members.
+	for (b = 0; b < NH_GROUP_BUCKETS; b++) {
+		owner[b] = -1;
+		for (i = 0; i < n_members; i++) {
+			if (g->buckets[b] != NULL && g->buckets[b] == members[i]) {
+				owner[b] = i;
+				count[i]++;
+				break;
+			}
+		}
+	}
+
+	// Spread the buckets evenly. Give the remainder to the members that
+	// already own more than their share so that fewer buckets move.
+	base = NH_GROUP_BUCKETS / n_members;
+	extra = NH_GROUP_BUCKETS % n_members;
+	for (i = 0; i < n_members; i++)
+		target[i] = base;
+	for (i = 0; i < n_members && extra > 0; i++) {
+		if (count[i] > base) {
+			target[i]++;
+			extra--;
+		}
+	}
+	for (i = 0; i < n_members && extra > 0; i++) {
+		if (target[i] == base) {
+			target[i]++;
+			extra--;
+		}
+	}
+
+	// Release the buckets of members that own more than their share.
+	for (b = 0; b < NH_GROUP_BUCKETS; b++) {
+		if (owner[b] >= 0 && count[owner[b]] > target[owner[b]]) {
+			count[owner[b]]--;
+			owner[b] = -1;
+		}
+	}
+
+	// Assign orphan buckets to the members that are below their share.
+	i = 0;
+	for (b = 0; b < NH_GROUP_BUCKETS; b++) {
+		if (owner[b] >= 0)
+			continue;
+		while (count[i] >= target[i])
+			i++;
+		g->buckets[b] = members[i];
+		count[i]++;
+	}
+
+	return 0;
+}
+
+int nh_group_set(struct nh_group *g, unsigned n_members, void *const *members) {
+	if (nh_group_rebalance(g, n_members, members) < 0)
+		return -errno;
+
+	memset(g->members, 0, sizeof(g->members));
+	memcpy(g->members, members, n_members * sizeof(*members));
+	g->n_members = n_members;
+
+	return 0;
+}
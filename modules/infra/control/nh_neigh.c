@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_control.h>
+#include <gr_hold_queue.h>
+#include <gr_log.h>
+#include <gr_nh_neigh.h>
+#include <gr_timer_wheel.h>
+#include <gr_tracepoint.h>
+
+#include <event2/event.h>
+#include <rte_common.h>
+#include <rte_cycles.h>
+
+static struct timer_wheel *neigh_wheel;
+
+static void neigh_aging_cb(struct timer_wheel_entry *e) {
+	struct nh_neigh *n = container_of(e, struct nh_neigh, aging);
+	n->aging_cb(n);
+}
+
+uint64_t nh_neigh_reply_age(const struct nh_neigh *n) {
+	if (n->last_reply == 0)
+		return 0;
+	return (rte_get_tsc_cycles() - n->last_reply) / rte_get_tsc_hz();
+}
+
+void nh_neigh_start(struct nh_neigh *n, nh_neigh_aging_cb_t cb) {
+	n->aging_cb = cb;
+	timer_wheel_arm(neigh_wheel, &n->aging, 1);
+}
+
+void nh_neigh_stop(struct nh_neigh *n) {
+	timer_wheel_cancel(neigh_wheel, &n->aging);
+}
+
+void nh_neigh_purge(struct nh_neigh *n) {
+	hold_queue_purge(&n->held);
+}
+
+uint8_t nh_neigh_age(struct nh_neigh *n, uint16_t *flags, uint64_t now) {
+	unsigned max_probes = NH_NEIGH_UCAST_PROBES + NH_NEIGH_MCAST_PROBES;
+	uint64_t reply_age, request_age;
+	uint16_t old_flags = *flags;
+	uint8_t actions = 0;
+	unsigned probes;
+
+	// Do not hold packets forever, even for gateways that never fail.
+	if (hold_queue_expire(&n->held, now, NH_NEIGH_HOLD_TIMEOUT * rte_get_tsc_hz()) > 0) {
+		// The queue may have been flushed while the packets were taken.
+		if (*flags & NH_NEIGH_F_REACHABLE)
+			actions |= NH_NEIGH_A_FLUSH;
+	}
+
+	reply_age = (now - n->last_reply) / rte_get_tsc_hz();
+	request_age = (now - n->last_request) / rte_get_tsc_hz();
+	probes = n->ucast_probes + n->mcast_probes;
+
+	if (*flags & (NH_NEIGH_F_PENDING | NH_NEIGH_F_STALE) && request_age > probes) {
+		if (probes >= max_probes && !(*flags & NH_NEIGH_F_GATEWAY)) {
+			*flags &= ~(NH_NEIGH_F_PENDING | NH_NEIGH_F_STALE);
+			*flags |= NH_NEIGH_F_FAILED;
+			actions |= NH_NEIGH_A_FAILED;
+		} else {
+			actions |= NH_NEIGH_A_SOLICIT;
+		}
+	} else if (*flags & NH_NEIGH_F_REACHABLE && reply_age <= NH_NEIGH_LIFETIME_REACHABLE) {
+		// Refresh next hops that carried traffic since the last probe before
+		// they become stale. Unused next hops are left to expire.
+		if (reply_age >= NH_NEIGH_LIFETIME_REACHABLE - NH_NEIGH_REFRESH_AHEAD
+		    && n->ucast_probes < NH_NEIGH_UCAST_PROBES
+		    && __atomic_exchange_n(&n->used, false, __ATOMIC_RELAXED))
+			actions |= NH_NEIGH_A_SOLICIT;
+	} else if (*flags & NH_NEIGH_F_REACHABLE) {
+		*flags &= ~NH_NEIGH_F_REACHABLE;
+		*flags |= NH_NEIGH_F_STALE;
+	} else if (*flags & NH_NEIGH_F_FAILED && request_age > NH_NEIGH_LIFETIME_UNREACHABLE) {
+		actions |= NH_NEIGH_A_DESTROY;
+	}
+
+	if (*flags != old_flags)
+		gr_trace_nh_state(n, old_flags, *flags);
+
+	return actions;
+}
+
+// Number of seconds until the next state transition of a neighbor.
+static uint32_t neigh_aging_delay(const struct nh_neigh *n, uint16_t flags, uint64_t now) {
+	uint64_t reply_age = (now - n->last_reply) / rte_get_tsc_hz();
+	uint64_t request_age = (now - n->last_request) / rte_get_tsc_hz();
+	unsigned probes = n->ucast_probes + n->mcast_probes;
+
+	// Expire held packets every second.
+	if (__atomic_load_n(&n->held.len, __ATOMIC_RELAXED) > 0)
+		return 1;
+
+	if (flags & (NH_NEIGH_F_PENDING | NH_NEIGH_F_STALE)) {
+		if (request_age <= probes)
+			return probes - request_age + 1;
+	} else if (flags & NH_NEIGH_F_REACHABLE) {
+		if (reply_age < NH_NEIGH_LIFETIME_REACHABLE - NH_NEIGH_REFRESH_AHEAD)
+			return NH_NEIGH_LIFETIME_REACHABLE - NH_NEIGH_REFRESH_AHEAD - reply_age;
+		// check every second if the next hop needs refreshing
+		if (reply_age <= NH_NEIGH_LIFETIME_REACHABLE)
+			return 1;
+	} else if (flags & NH_NEIGH_F_FAILED) {
+		if (request_age <= NH_NEIGH_LIFETIME_UNREACHABLE)
+			return NH_NEIGH_LIFETIME_UNREACHABLE - request_age + 1;
+	}
+
+	// Not resolved yet or deadline already expired.
+	return 1;
+}
+
+void nh_neigh_rearm(struct nh_neigh *n, uint16_t flags, uint64_t now) {
+	timer_wheel_arm(neigh_wheel, &n->aging, neigh_aging_delay(n, flags, now));
+}
+
+static void neigh_init(struct event_base *ev_base) {
+	neigh_wheel = timer_wheel_create(ev_base, neigh_aging_cb);
+	if (neigh_wheel == NULL)
+		ABORT("timer_wheel_create() failed");
+}
+
+static void neigh_fini(struct event_base *) {
+	timer_wheel_destroy(neigh_wheel);
+	neigh_wheel = NULL;
+}
+
+static struct gr_module neigh_module = {
+	.name = "nexthop neighbor",
+	.init = neigh_init,
+	.fini = neigh_fini,
+	// before the next hops of all address families are created
+	.init_prio = -100,
+	// after the next hops of all address families are destroyed
+	.fini_prio = 25000,
+};
+
+RTE_INIT(neigh_constructor) {
+	gr_register_module(&neigh_module);
+}
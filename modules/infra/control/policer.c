@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_iface.h>
+#include <gr_infra.h>
+#include <gr_log.h>
+#include <gr_policer.h>
+#include <gr_rcu.h>
+#include <gr_worker.h>
+
+#include <rte_common.h>
+#include <rte_malloc.h>
+#include <rte_meter.h>
+
+#include <errno.h>
+#include <sys/queue.h>
+
+static struct iface_policer *policer_new(const struct gr_policer *conf) {
+	struct iface_policer *p;
+	struct worker *worker;
+	unsigned n_workers = 0;
+	int ret;
+
+	// each worker gets an equal share of the rates
+	STAILQ_FOREACH (worker, &workers, next)
+		n_workers++;
+	if (n_workers == 0)
+		n_workers = 1;
+	if (conf->cir < n_workers || (conf->mode == GR_POLICER_TRTCM && conf->pir < conf->cir))
+		return errno_set_null(ERANGE);
+
+	if ((p = rte_zmalloc(__func__, sizeof(*p), RTE_CACHE_LINE_SIZE)) == NULL)
+		return errno_set_null(ENOMEM);
+
+	p->mode = conf->mode;
+	p->actions[RTE_COLOR_GREEN] = GR_POLICER_PASS;
+	p->actions[RTE_COLOR_YELLOW] = conf->yellow;
+	p->actions[RTE_COLOR_RED] = conf->red;
+	p->dscps[RTE_COLOR_YELLOW] = conf->yellow_dscp;
+	p->dscps[RTE_COLOR_RED] = conf->red_dscp;
+	p->conf = *conf;
+
+	if (conf->mode == GR_POLICER_SRTCM) {
+		struct rte_meter_srtcm_params params = {
+			.cir = conf->cir / n_workers,
+			.cbs = conf->cbs,
+			.ebs = conf->ebs,
+		};
+		if ((ret = rte_meter_srtcm_profile_config(&p->srtcm, &params)) < 0)
+			goto err;
+		for (unsigned i = 0; i < RTE_DIM(p->states); i++)
+			rte_meter_srtcm_config(&p->states[i].srtcm, &p->srtcm);
+	} else {
+		struct rte_meter_trtcm_params params = {
+			.cir = conf->cir / n_workers,
+			.pir = conf->pir / n_workers,
+			.cbs = conf->cbs,
+			.pbs = conf->ebs,
+		};
+		if ((ret = rte_meter_trtcm_profile_config(&p->trtcm, &params)) < 0)
+			goto err;
+		for (unsigned i = 0; i < RTE_DIM(p->states); i++)
+			rte_meter_trtcm_config(&p->states[i].trtcm, &p->trtcm);
+	}
+
+	return p;
+err:
+	rte_free(p);
+	return errno_set_null(-ret);
+}
+
+int iface_policer_set(struct iface *iface, const struct gr_policer *conf) {
+	struct iface_policer *p = NULL, *old;
+
+	switch (iface->type_id) {
+	case GR_IFACE_TYPE_PORT:
+	case GR_IFACE_TYPE_VLAN:
+	case GR_IFACE_TYPE_BOND:
+		break;
+	default:
+		return errno_set(EMEDIUMTYPE);
+	}
+	if (conf->mode > GR_POLICER_TRTCM || conf->yellow > GR_POLICER_REMARK
+	    || conf->red > GR_POLICER_REMARK || conf->yellow_dscp > 63 || conf->red_dscp > 63)
+		return errno_set(EINVAL);
+
+	if (conf->mode != GR_POLICER_DISABLED && (p = policer_new(conf)) == NULL)
+		return -errno;
+
+	old = iface->policer;
+	__atomic_store_n(&iface->policer, p, __ATOMIC_RELEASE);
+	if (old != NULL)
+		gr_rcu_defer_free(rte_free, old);
+
+	return 0;
+}
+
+int iface_policer_get(const struct iface *iface, struct gr_policer *conf) {
+	const struct iface_policer *p = iface->policer;
+
+	if (p == NULL) {
+		*conf = (struct gr_policer) {.mode = GR_POLICER_DISABLED};
+		return 0;
+	}
+
+	*conf = p->conf;
+	conf->n_green = conf->n_yellow = conf->n_red = 0;
+	for (unsigned i = 0; i < RTE_DIM(p->states); i++) {
+		const uint64_t *packets = p->states[i].packets;
+		conf->n_green += __atomic_load_n(&packets[RTE_COLOR_GREEN], __ATOMIC_RELAXED);
+		conf->n_yellow += __atomic_load_n(&packets[RTE_COLOR_YELLOW], __ATOMIC_RELAXED);
+		conf->n_red += __atomic_load_n(&packets[RTE_COLOR_RED], __ATOMIC_RELAXED);
+	}
+
+	return 0;
+}
+
+static void policer_iface_event(iface_event_t event, struct iface *iface) {
+	struct gr_policer disabled = {.mode = GR_POLICER_DISABLED};
+
+	if (event == IFACE_EVENT_PRE_REMOVE && iface->policer != NULL)
+		iface_policer_set(iface, &disabled);
+}
+
+static struct iface_event_handler policer_iface_event_handler = {
+	.callback = policer_iface_event,
+};
+
+RTE_INIT(policer_constructor) {
+	iface_event_register_handler(&policer_iface_event_handler);
+}
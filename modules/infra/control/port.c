@@ -13,6 +13,7 @@
 #include <gr_port.h>
 #include <gr_queue.h>
 #include <gr_stb_ds.h>
+#include <gr_tracepoint.h>
 #include <gr_worker.h>
 
 #include <numa.h>
@@ -22,8 +23,12 @@
 #include <rte_ethdev.h>
 #include <rte_ether.h>
 #include <rte_malloc.h>
+#include <rte_ring.h>
 
 #include <arpa/inet.h>
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -60,33 +65,104 @@ static uint16_t get_txq_size(struct iface_info_port *p, const struct rte_eth_dev
 	return p->txq_size;
 }
 
+// Enabled on ports that support them. Some drivers use a slower tx path when
+// any offload is enabled: do not request offloads that no node uses yet.
+// Chained mbufs are also sent by multicast replication, which shares the
+// payload between copies. The security offload is used by inline IPsec SAs.
+#define PORT_TX_OFFLOADS                                                                           \
+	(RTE_ETH_TX_OFFLOAD_VLAN_INSERT | RTE_ETH_TX_OFFLOAD_IPV4_CKSUM                            \
+	 | RTE_ETH_TX_OFFLOAD_TCP_TSO | RTE_ETH_TX_OFFLOAD_IPIP_TNL_TSO                            \
+	 | RTE_ETH_TX_OFFLOAD_VXLAN_TNL_TSO | RTE_ETH_TX_OFFLOAD_GRE_TNL_TSO                       \
+	 | RTE_ETH_TX_OFFLOAD_MULTI_SEGS | RTE_ETH_TX_OFFLOAD_SECURITY)
+
 static struct rte_eth_conf default_port_config = {
 	.rx_adv_conf = {
 		.rss_conf = {
 			.rss_key = NULL, // use default key
-			.rss_hf = RTE_ETH_RSS_VLAN
-				| RTE_ETH_RSS_IP
-				| RTE_ETH_RSS_UDP
-				| RTE_ETH_RSS_TCP,
+			.rss_hf = PORT_RSS_HF_DEFAULT,
 		},
 	},
 	.rxmode = {
-		.offloads = RTE_ETH_RX_OFFLOAD_CHECKSUM | RTE_ETH_RX_OFFLOAD_VLAN,
+		.offloads = RTE_ETH_RX_OFFLOAD_CHECKSUM | RTE_ETH_RX_OFFLOAD_VLAN
+			| RTE_ETH_RX_OFFLOAD_RSS_HASH | RTE_ETH_RX_OFFLOAD_SECURITY,
 	},
 };
 
-static void port_queue_assign(struct iface_info_port *p) {
+// CPUs attached to the same PCIe root complex as the device, empty if unknown.
+static void port_local_cpus(const struct rte_eth_dev_info *info, cpu_set_t *local) {
+	char path[128], buf[1024];
+	FILE *f;
+
+	CPU_ZERO(local);
+	snprintf(
+		path,
+		sizeof(path),
+		"/sys/bus/pci/devices/%s/local_cpulist",
+		rte_dev_name(info->device)
+	);
+	if ((f = fopen(path, "r")) == NULL)
+		return;
+	if (fgets(buf, sizeof(buf), f) != NULL) {
+		buf[strcspn(buf, "\n")] = '\0';
+		if (cpu_list_parse(buf, local) < 0)
+			CPU_ZERO(local);
+	}
+	fclose(f);
+}
+
+// Steer the MSI interrupts of a PCI device to the housekeeping CPUs, away from
+// the datapath workers. This is only a hint, it requires privileges and the
+// kernel may not honor it.
+static void port_irq_affinity(const struct iface_info_port *p) {
+	const char *cpus = gr_args()->housekeeping_cpus;
+	struct rte_eth_dev_info info;
+	char path[128];
+	struct dirent *e;
+	FILE *f;
+	DIR *d;
+
+	if (cpus == NULL || rte_eth_dev_info_get(p->port_id, &info) < 0)
+		return;
+
+	snprintf(
+		path,
+		sizeof(path),
+		"/sys/bus/pci/devices/%s/msi_irqs",
+		rte_dev_name(info.device)
+	);
+	if ((d = opendir(path)) == NULL)
+		return; // not a PCI device or no MSI vectors enabled
+
+	while ((e = readdir(d)) != NULL) {
+		if (e->d_name[0] == '.')
+			continue;
+		snprintf(path, sizeof(path), "/proc/irq/%s/smp_affinity_list", e->d_name);
+		if ((f = fopen(path, "w")) == NULL) {
+			LOG(NOTICE, "port %u: %s: %s", p->port_id, path, strerror(errno));
+			break;
+		}
+		fprintf(f, "%s\n", cpus);
+		if (fclose(f) != 0)
+			LOG(NOTICE, "port %u: %s: %s", p->port_id, path, strerror(errno));
+	}
+	closedir(d);
+}
+
+static void port_queue_assign(struct iface_info_port *p, const cpu_set_t *local) {
 	int socket_id = rte_eth_dev_socket_id(p->port_id);
-	struct worker *worker, *default_worker = NULL;
+	struct worker *worker, *default_worker;
 	// XXX: can we assume there will never be more than 64 rxqs per port?
+	uint16_t n_rxq = port_rxq_count(p);
 	uint64_t rxq_ids = 0;
-	uint16_t txq = 0;
+	unsigned index = 0;
 
 	STAILQ_FOREACH (worker, &workers, next) {
 		struct queue_map tx_qmap = {
 			.port_id = p->port_id,
-			.queue_id = txq,
+			.queue_id = index % p->n_txq,
 			.enabled = false,
+			// the first worker of each txq owns it, others go through its ring
+			.shared = index >= p->n_txq && arrlen(p->txq_rings) > 0,
 		};
 		for (int i = 0; i < arrlen(worker->txqs); i++) {
 			if (worker->txqs[i].port_id == p->port_id) {
@@ -95,14 +171,14 @@ static void port_queue_assign(struct iface_info_port *p) {
 				i--;
 			}
 		}
-		// assign one txq to every worker
+		// assign one txq to every worker, share them if there are not enough
 		arrpush(worker->txqs, tx_qmap);
-		txq++;
+		index++;
 
 		for (int i = 0; i < arrlen(worker->rxqs); i++) {
 			struct queue_map *qmap = &worker->rxqs[i];
 			if (qmap->port_id == p->port_id) {
-				if (qmap->queue_id < p->n_rxq) {
+				if (qmap->queue_id < n_rxq) {
 					// rxq already assigned to a worker
 					rxq_ids |= 1 << qmap->queue_id;
 				} else {
@@ -112,12 +188,9 @@ static void port_queue_assign(struct iface_info_port *p) {
 				}
 			}
 		}
-		if (socket_id == SOCKET_ID_ANY || socket_id == numa_node_of_cpu(worker->cpu_id)) {
-			default_worker = worker;
-		}
 	}
-	assert(default_worker != NULL);
-	for (uint16_t rxq = 0; rxq < p->n_rxq; rxq++) {
+	// spread the new rxqs over the workers, see worker_rxq_place()
+	for (uint16_t rxq = 0; rxq < n_rxq; rxq++) {
 		if (rxq_ids & (1 << rxq))
 			continue;
 		struct queue_map rx_qmap = {
@@ -125,75 +198,220 @@ static void port_queue_assign(struct iface_info_port *p) {
 			.queue_id = rxq,
 			.enabled = false,
 		};
+		default_worker = worker_rxq_place(socket_id, local);
+		assert(default_worker != NULL);
 		arrpush(default_worker->rxqs, rx_qmap);
 	}
 }
 
-static int port_configure(struct iface_info_port *p) {
+// Size of the rings used to share a txq between workers.
+#define TXQ_RING_SIZE 1024
+
+static void port_txq_rings_free(struct iface_info_port *p) {
+	struct rte_mbuf *mbufs[RTE_GRAPH_BURST_SIZE];
+	struct rte_ring **ring;
+	unsigned n;
+
+	arrforeach (ring, p->txq_rings) {
+		while ((n = rte_ring_dequeue_burst(*ring, (void **)mbufs, ARRAY_DIM(mbufs), NULL)))
+			rte_pktmbuf_free_bulk(mbufs, n);
+		rte_ring_free(*ring);
+	}
+	arrfree(p->txq_rings);
+	p->txq_rings = NULL;
+}
+
+static int port_txq_rings_alloc(struct iface_info_port *p, int socket_id) {
+	char name[RTE_RING_NAMESIZE];
+	struct rte_ring *ring;
+
+	for (uint16_t q = 0; q < p->n_txq; q++) {
+		snprintf(name, sizeof(name), "txq_%u_%u", p->port_id, q);
+		// multiple producers (sharing workers), single consumer (owner)
+		ring = rte_ring_create(name, TXQ_RING_SIZE, socket_id, RING_F_SC_DEQ);
+		if (ring == NULL) {
+			port_txq_rings_free(p);
+			return errno_log(rte_errno, "rte_ring_create");
+		}
+		arrpush(p->txq_rings, ring);
+	}
+
+	return 0;
+}
+
+// Request L2 and L3 packet type classification from the driver. The mask of
+// packet type layers that can be trusted by the datapath is stored in the port.
+// VLAN tagged frames are only told apart from untagged ones by some drivers.
+// If the driver cannot report it, the datapath falls back to software parsing
+// for the L2 layer.
+static void port_ptypes_configure(struct iface_info_port *p) {
+	const uint32_t mask = RTE_PTYPE_L2_MASK | RTE_PTYPE_L3_MASK;
+	uint32_t ptypes[64];
+	bool vlan, l3;
+	int ret, n;
+
+	p->ptype_mask = 0;
+
+	n = rte_eth_dev_get_supported_ptypes(p->port_id, mask, ptypes, RTE_DIM(ptypes));
+	vlan = l3 = false;
+	for (int i = 0; i < RTE_MIN(n, (int)RTE_DIM(ptypes)); i++) {
+		if ((ptypes[i] & RTE_PTYPE_L2_MASK) == RTE_PTYPE_L2_ETHER_VLAN)
+			vlan = true;
+		if (RTE_ETH_IS_IPV4_HDR(ptypes[i]) || RTE_ETH_IS_IPV6_HDR(ptypes[i]))
+			l3 = true;
+	}
+	if (!l3) {
+		LOG(INFO, "port %u: no packet type offload, parsing in software", p->port_id);
+		// some drivers skip classification work when no ptype is requested
+		rte_eth_dev_set_ptypes(p->port_id, RTE_PTYPE_UNKNOWN, NULL, 0);
+		return;
+	}
+
+	if ((ret = rte_eth_dev_set_ptypes(p->port_id, mask, NULL, 0)) < 0 && ret != -ENOTSUP) {
+		LOG(NOTICE, "port %u: rte_eth_dev_set_ptypes: %s", p->port_id, rte_strerror(-ret));
+		return;
+	}
+
+	p->ptype_mask = RTE_PTYPE_L3_MASK;
+	if (vlan)
+		p->ptype_mask |= RTE_PTYPE_L2_MASK;
+}
+
+static int port_configure(struct iface_info_port *p, uint16_t mtu) {
 	int socket_id = rte_eth_dev_socket_id(p->port_id);
 	struct rte_eth_conf conf = default_port_config;
-	uint16_t rxq_size, txq_size;
+	uint16_t rxq_size, txq_size, n_rxq, data_room;
+	struct rte_eth_txconf txconf;
 	struct rte_eth_dev_info info;
 	uint32_t mbuf_count;
+	cpu_set_t local;
 	int ret;
 
+	if ((ret = rte_eth_dev_info_get(p->port_id, &info)) < 0)
+		return errno_log(-ret, "rte_eth_dev_info_get");
+	port_local_cpus(&info, &local);
+
 	// ensure there is a datapath worker running on the socket where the port is
-	if ((ret = worker_ensure_default(socket_id)) < 0)
+	if ((ret = worker_ensure_default(socket_id, &local)) < 0)
 		return ret;
 
-	// FIXME: deal with drivers that do not support more than 1 (or N) tx queues
-	p->n_txq = worker_count();
 	if (p->n_rxq == 0)
 		p->n_rxq = 1;
 
-	if ((ret = rte_eth_dev_info_get(p->port_id, &info)) < 0)
-		return errno_log(-ret, "rte_eth_dev_info_get");
+	if (p->ctrl_rxq && info.max_rx_queues > 0 && info.max_rx_queues <= p->n_rxq) {
+		LOG(NOTICE, "port %u: not enough rxqs for control traffic", p->port_id);
+		p->ctrl_rxq = false;
+	}
+	n_rxq = port_rxq_count(p);
+
+	// the port is unplugged, no worker is using the rings anymore
+	port_txq_rings_free(p);
+
+	// one txq per worker, unless the driver does not support enough
+	p->n_txq = worker_count();
+	if (info.max_tx_queues > 0 && info.max_tx_queues < p->n_txq) {
+		p->n_txq = info.max_tx_queues;
+		if (info.tx_offload_capa & RTE_ETH_TX_OFFLOAD_MT_LOCKFREE) {
+			// workers can call rte_eth_tx_burst concurrently on the same txq
+			conf.txmode.offloads |= RTE_ETH_TX_OFFLOAD_MT_LOCKFREE;
+			LOG(INFO, "port %u: sharing %u lock-free txqs", p->port_id, p->n_txq);
+		} else {
+			if ((ret = port_txq_rings_alloc(p, socket_id)) < 0)
+				return ret;
+			LOG(INFO, "port %u: sharing %u txqs via rings", p->port_id, p->n_txq);
+		}
+	}
 
 	rxq_size = get_rxq_size(p, &info);
 	txq_size = get_txq_size(p, &info);
 
-	mbuf_count = rxq_size * p->n_rxq;
+	mbuf_count = rxq_size * n_rxq;
 	mbuf_count += txq_size * p->n_txq;
+	mbuf_count += TXQ_RING_SIZE * arrlen(p->txq_rings);
 	mbuf_count += RTE_GRAPH_BURST_SIZE;
 	mbuf_count = rte_align32pow2(mbuf_count) - 1;
-	if (mbuf_count != p->pool_size) {
+	data_room = gr_pktmbuf_data_room(mtu);
+	if (mbuf_count != p->pool_size || data_room != p->pool_data_room) {
 		gr_pktmbuf_pool_release(p->pool, p->pool_size);
-		p->pool = gr_pktmbuf_pool_get(socket_id, mbuf_count);
+		p->pool = gr_pktmbuf_pool_get_port(p->port_id, socket_id, mbuf_count, data_room);
 		p->pool_size = mbuf_count;
+		p->pool_data_room = data_room;
 	}
 
-	if (p->pool == NULL)
-		return errno_log(errno, "gr_pktmbuf_pool_get");
+	if (p->pool == NULL) {
+		p->pool_size = 0;
+		p->pool_data_room = 0;
+		return errno_log(errno, "gr_pktmbuf_pool_get_port");
+	}
 
+	port_rss_conf_fill(p, &info, &conf.rx_adv_conf.rss_conf);
 	// Limit configured rss hash functions to only those supported by hardware
 	conf.rx_adv_conf.rss_conf.rss_hf &= info.flow_type_rss_offloads;
 	if (conf.rx_adv_conf.rss_conf.rss_hf == 0)
 		conf.rxmode.mq_mode = RTE_ETH_MQ_RX_NONE;
 	else
 		conf.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
+	if (mtu != 0)
+		conf.rxmode.mtu = mtu;
+	if (mtu + GR_ETH_FRAME_OVERHEAD > data_room - RTE_PKTMBUF_HEADROOM) {
+		// frames do not fit in one mbuf, receive them as chained segments
+		conf.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_SCATTER;
+	}
 	conf.rxmode.offloads &= info.rx_offload_capa;
+	conf.txmode.offloads |= info.tx_offload_capa & PORT_TX_OFFLOADS;
+	if (p->tx_fast_free) {
+		// With per-port pools, forwarded packets come from the pools of the
+		// other ports and would all need to be copied by port_tx.
+		if (gr_args()->port_pools)
+			LOG(NOTICE, "port %u: fast free disabled by per-port pools", p->port_id);
+		else if (!(info.tx_offload_capa & RTE_ETH_TX_OFFLOAD_MBUF_FAST_FREE))
+			LOG(NOTICE, "port %u: fast free not supported", p->port_id);
+		else
+			conf.txmode.offloads |= RTE_ETH_TX_OFFLOAD_MBUF_FAST_FREE;
+	}
 	if (info.dev_flags != NULL && *info.dev_flags & RTE_ETH_DEV_INTR_LSC) {
 		conf.intr_conf.lsc = 1;
 	}
-
-	if ((ret = rte_eth_dev_configure(p->port_id, p->n_rxq, p->n_txq, &conf)) < 0)
+	if (gr_args()->rx_interrupts)
+		conf.intr_conf.rxq = 1;
+
+	ret = rte_eth_dev_configure(p->port_id, n_rxq, p->n_txq, &conf);
+	if (ret < 0 && conf.intr_conf.rxq) {
+		LOG(NOTICE, "port %u: rx interrupts not supported", p->port_id);
+		conf.intr_conf.rxq = 0;
+		ret = rte_eth_dev_configure(p->port_id, n_rxq, p->n_txq, &conf);
+	}
+	if (ret < 0)
 		return errno_log(-ret, "rte_eth_dev_configure");
 
+	p->tx_offloads = conf.txmode.offloads;
+	port_ptypes_configure(p);
+
 	// initialize rx/tx queues
-	for (size_t q = 0; q < p->n_rxq; q++) {
+	for (size_t q = 0; q < n_rxq; q++) {
 		ret = rte_eth_rx_queue_setup(p->port_id, q, rxq_size, socket_id, NULL, p->pool);
 		if (ret < 0)
 			return errno_log(-ret, "rte_eth_rx_queue_setup");
 	}
+	txconf = info.default_txconf;
+	txconf.offloads = 0; // port offloads apply to all txqs
+	if (p->tx_free_thresh != 0)
+		txconf.tx_free_thresh = p->tx_free_thresh;
+	if (p->tx_rs_thresh != 0)
+		txconf.tx_rs_thresh = p->tx_rs_thresh;
 	for (size_t q = 0; q < p->n_txq; q++) {
-		ret = rte_eth_tx_queue_setup(p->port_id, q, txq_size, socket_id, NULL);
+		ret = rte_eth_tx_queue_setup(p->port_id, q, txq_size, socket_id, &txconf);
 		if (ret < 0)
 			return errno_log(-ret, "rte_eth_tx_queue_setup");
 	}
 
-	port_queue_assign(p);
+	if (conf.rxmode.mq_mode == RTE_ETH_MQ_RX_RSS && port_reta_apply(p, &info) < 0)
+		LOG(NOTICE, "port %u: rss reta update: %s", p->port_id, strerror(errno));
+
+	port_queue_assign(p, &local);
 
 	p->configured = true;
+	gr_trace_port_configure(p->port_id, n_rxq, p->n_txq, mtu);
 
 	return 0;
 }
@@ -209,11 +427,29 @@ int iface_port_reconfig(
 	struct iface_info_port *p = (struct iface_info_port *)iface->info;
 	const struct gr_iface_info_port *api = api_info;
 	bool stopped = false;
+	uint16_t pool_mtu;
 	int ret;
 
+	if (set_attrs & GR_PORT_SET_TX_POLICY) {
+		if (api->tx_policy > GR_PORT_TX_QUEUE)
+			return errno_set(EINVAL);
+		if (api->tx_policy == GR_PORT_TX_QUEUE && api->tx_limit > GR_PORT_TX_QUEUE_MAX)
+			return errno_set(ERANGE);
+	}
+
 	if ((ret = port_unplug(p->port_id)) < 0)
 		return ret;
 
+	if (set_attrs & GR_PORT_SET_TX_POLICY) {
+		// applied by port_plug() when the graphs are reloaded
+		p->tx_policy = api->tx_policy;
+		p->tx_limit = api->tx_limit;
+		if (p->tx_limit == 0 && p->tx_policy == GR_PORT_TX_RETRY)
+			p->tx_limit = GR_PORT_TX_RETRY_DEFAULT;
+		if (p->tx_limit == 0 && p->tx_policy == GR_PORT_TX_QUEUE)
+			p->tx_limit = GR_PORT_TX_QUEUE_DEFAULT;
+	}
+
 	if (set_attrs & (GR_PORT_SET_N_RXQS | GR_PORT_SET_N_TXQS | GR_PORT_SET_Q_SIZE)) {
 		if (set_attrs & GR_PORT_SET_N_RXQS)
 			p->n_rxq = api->n_rxq;
@@ -226,13 +462,35 @@ int iface_port_reconfig(
 		p->configured = false;
 	}
 
+	if (set_attrs & GR_PORT_SET_CTRL_RXQ) {
+		p->ctrl_rxq = api->ctrl_rxq != 0;
+		p->configured = false;
+	}
+
+	if (set_attrs & GR_PORT_SET_TX_FREE) {
+		// the thresholds are validated by the driver when the txqs are set up
+		p->tx_fast_free = api->tx_fast_free != 0;
+		p->tx_free_thresh = api->tx_free_thresh;
+		p->tx_rs_thresh = api->tx_rs_thresh;
+		p->configured = false;
+	}
+
+	// RX buffers must be large enough for the MTU
+	pool_mtu = iface->mtu;
+	if ((set_attrs & GR_IFACE_SET_MTU) && mtu != 0)
+		pool_mtu = mtu;
+	if (gr_pktmbuf_data_room(pool_mtu) != p->pool_data_room)
+		p->configured = false;
+
 	if (!p->configured
 	    || (set_attrs & (GR_IFACE_SET_FLAGS | GR_IFACE_SET_MTU | GR_PORT_SET_MAC))) {
+		port_ctrl_flows_destroy(p);
+		port_pin_flows_destroy(p);
 		if ((ret = rte_eth_dev_stop(p->port_id)) < 0)
 			return errno_log(-ret, "rte_eth_dev_stop");
 		stopped = true;
 	}
-	if (!p->configured && (ret = port_configure(p)) < 0)
+	if (!p->configured && (ret = port_configure(p, pool_mtu)) < 0)
 		return ret;
 
 	if (set_attrs & GR_IFACE_SET_FLAGS) {
@@ -267,6 +525,9 @@ int iface_port_reconfig(
 		}
 		if (ret < 0)
 			errno_log(-ret, "rte_eth_dev_set_link_{up,down}");
+
+		iface->flags &= ~GR_IFACE_F_RPF;
+		iface->flags |= flags & GR_IFACE_F_RPF;
 	}
 
 	if ((set_attrs & GR_IFACE_SET_MTU) && mtu != 0) {
@@ -291,14 +552,100 @@ int iface_port_reconfig(
 			return errno_log(-ret, "rte_eth_macaddr_get");
 	}
 
-	if (stopped && (ret = rte_eth_dev_start(p->port_id)) < 0)
-		return errno_log(-ret, "rte_eth_dev_start");
+	if (stopped) {
+		if ((ret = rte_eth_dev_start(p->port_id)) < 0)
+			return errno_log(-ret, "rte_eth_dev_start");
+		port_ctrl_flows_apply(p);
+		port_pin_flows_apply(p);
+		// MSI vectors are allocated when the device is started
+		port_irq_affinity(p);
+	}
 
 	iface_event_notify(IFACE_EVENT_PORT_POST_RECONFIG, iface);
 
 	return port_plug(p->port_id);
 }
 
+struct port_job {
+	uint16_t port_id;
+	int (*func)(uint16_t port_id);
+	int ret;
+	bool threaded;
+	pthread_t thread;
+};
+
+static void *port_job_run(void *priv) {
+	struct port_job *job = priv;
+	job->ret = job->func(job->port_id);
+	return NULL;
+}
+
+// rte_eth_dev_stop() and rte_eth_dev_start() take hundreds of milliseconds with
+// some drivers. Call them concurrently, with one thread per port. The ports are
+// unplugged and not accessed by other threads meanwhile.
+static int
+port_jobs_run(struct port_job *jobs, unsigned n, int (*func)(uint16_t), const char *what) {
+	int ret = 0;
+
+	for (unsigned i = 0; i < n; i++) {
+		jobs[i].func = func;
+		jobs[i].ret = 0;
+		jobs[i].threaded = n > 1
+			&& pthread_create(&jobs[i].thread, NULL, port_job_run, &jobs[i]) == 0;
+		if (!jobs[i].threaded)
+			port_job_run(&jobs[i]);
+	}
+	for (unsigned i = 0; i < n; i++) {
+		if (jobs[i].threaded)
+			pthread_join(jobs[i].thread, NULL);
+		if (jobs[i].ret < 0 && ret == 0)
+			ret = errno_log(-jobs[i].ret, what);
+	}
+
+	return ret;
+}
+
+int port_reconfig_all(void) {
+	struct port_job jobs[RTE_MAX_ETHPORTS];
+	struct iface_info_port *p;
+	struct iface *iface = NULL;
+	unsigned n = 0;
+	int ret;
+
+	while ((iface = iface_next(GR_IFACE_TYPE_PORT, iface)) != NULL) {
+		p = (struct iface_info_port *)iface->info;
+		if ((ret = port_unplug(p->port_id)) < 0)
+			return ret;
+		port_ctrl_flows_destroy(p);
+		port_pin_flows_destroy(p);
+		// one txq per worker
+		p->n_txq = 0;
+		p->configured = false;
+		jobs[n++].port_id = p->port_id;
+	}
+
+	if ((ret = port_jobs_run(jobs, n, rte_eth_dev_stop, "rte_eth_dev_stop")) < 0)
+		return ret;
+	while ((iface = iface_next(GR_IFACE_TYPE_PORT, iface)) != NULL) {
+		p = (struct iface_info_port *)iface->info;
+		if ((ret = port_configure(p, iface->mtu)) < 0)
+			return ret;
+	}
+	if ((ret = port_jobs_run(jobs, n, rte_eth_dev_start, "rte_eth_dev_start")) < 0)
+		return ret;
+
+	while ((iface = iface_next(GR_IFACE_TYPE_PORT, iface)) != NULL) {
+		p = (struct iface_info_port *)iface->info;
+		port_ctrl_flows_apply(p);
+		port_pin_flows_apply(p);
+		iface_event_notify(IFACE_EVENT_PORT_POST_RECONFIG, iface);
+		if ((ret = port_plug(p->port_id)) < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
 static const struct iface *port_ifaces[RTE_MAX_ETHPORTS];
 
 static int iface_port_fini(struct iface *iface) {
@@ -312,6 +659,10 @@ static int iface_port_fini(struct iface *iface) {
 
 	port_ifaces[port->port_id] = NULL;
 
+	port_ctrl_fini(port);
+	port_pin_fini(port);
+	arrfree(port->reta);
+	port->reta = NULL;
 	free(port->devargs);
 	port->devargs = NULL;
 	if ((ret = rte_eth_dev_info_get(port->port_id, &info)) < 0)
@@ -322,6 +673,7 @@ static int iface_port_fini(struct iface *iface) {
 		LOG(ERR, "rte_eth_dev_close: %s", rte_strerror(-ret));
 	if (info.device != NULL && (ret = rte_dev_remove(info.device)) < 0)
 		LOG(ERR, "rte_dev_remove: %s", rte_strerror(-ret));
+	port_txq_rings_free(port);
 	if (port->pool != NULL) {
 		gr_pktmbuf_pool_release(port->pool, port->pool_size);
 		port->pool = NULL;
@@ -340,30 +692,63 @@ static int iface_port_fini(struct iface *iface) {
 		if (arrlen(worker->rxqs) == 0)
 			worker_destroy(worker->cpu_id);
 	}
-	if (worker_count() != n_workers) {
-		// update the number of tx queues for all ports
-		struct iface *iface = NULL;
-		while ((iface = iface_next(GR_IFACE_TYPE_PORT, iface)) != NULL) {
-			struct iface_info_port p = {.n_txq = 0};
-			ret = iface_port_reconfig(
-				iface,
-				GR_PORT_SET_N_TXQS,
-				iface->flags,
-				iface->mtu,
-				iface->vrf_id,
-				&p
-			);
-			if (ret < 0)
-				goto out;
+	// update the number of tx queues for all ports
+	if (worker_count() != n_workers)
+		ret = port_reconfig_all();
+
+	return ret;
+}
+
+// Append ",key=value" to devargs unless key was specified by the user.
+static size_t
+devargs_default(char *devargs, size_t len, size_t n, const char *key, const char *value) {
+	char match[32];
+
+	snprintf(match, sizeof(match), ",%s=", key);
+	if (n >= len || strstr(devargs, match) != NULL)
+		return n;
+	return n + snprintf(devargs + n, len - n, "%s%s", match, value);
+}
+
+#define AF_XDP_DRIVER "net_af_xdp"
+#define MEMIF_DRIVER "net_memif"
+
+// Some virtual drivers take their queue and ring parameters from the devargs
+// when the device is probed and cannot change them afterwards.
+//
+// AF_XDP opens one XDP socket per queue. Unless set explicitly, request as
+// many as the port will use and share a single UMEM between them since all
+// rxqs use the same mbuf pool. Zero-copy and busy polling are enabled by the
+// driver when the kernel supports them.
+//
+// memif negotiates the ring sizes with its peer when connecting. Request the
+// configured rxq size. Zero-copy (client role only) uses the memfd backed
+// segments of the --in-memory EAL mode.
+static void
+port_devargs_expand(const struct gr_iface_info_port *api, char *devargs, size_t len) {
+	uint16_t n_queues = RTE_MAX(api->n_rxq, 1) + (api->ctrl_rxq ? 1 : 0);
+	char value[16];
+	size_t n;
+
+	n = snprintf(devargs, len, "%s", api->devargs);
+
+	if (strncmp(api->devargs, AF_XDP_DRIVER, strlen(AF_XDP_DRIVER)) == 0) {
+		snprintf(value, sizeof(value), "%u", n_queues);
+		n = devargs_default(devargs, len, n, "queue_count", value);
+		devargs_default(devargs, len, n, "shared_umem", "1");
+	} else if (strncmp(api->devargs, MEMIF_DRIVER, strlen(MEMIF_DRIVER)) == 0) {
+		if (api->rxq_size != 0) {
+			// log2 of the number of descriptors
+			snprintf(value, sizeof(value), "%u", rte_log2_u32(api->rxq_size));
+			devargs_default(devargs, len, n, "rsize", value);
 		}
 	}
-out:
-	return ret;
 }
 
 static int iface_port_init(struct iface *iface, const void *api_info) {
 	struct iface_info_port *port = (struct iface_info_port *)iface->info;
 	const struct gr_iface_info_port *api = api_info;
+	char devargs[GR_PORT_DEVARGS_SIZE * 2];
 	uint16_t port_id = RTE_MAX_ETHPORTS;
 	struct rte_dev_iterator iterator;
 	int ret;
@@ -373,7 +758,8 @@ static int iface_port_init(struct iface *iface, const void *api_info) {
 		return errno_set(EEXIST);
 	}
 
-	if ((ret = rte_dev_probe(api->devargs)) < 0)
+	port_devargs_expand(api, devargs, sizeof(devargs));
+	if ((ret = rte_dev_probe(devargs)) < 0)
 		return errno_set(-ret);
 
 	RTE_ETH_FOREACH_MATCHING_DEV(port_id, api->devargs, &iterator) {
@@ -390,6 +776,9 @@ static int iface_port_init(struct iface *iface, const void *api_info) {
 		goto fail;
 	}
 
+	// must be set before plugging the port, graphs need it to find the txq rings
+	port_ifaces[port_id] = iface;
+
 	ret = iface_port_reconfig(
 		iface, IFACE_SET_ALL, iface->flags, iface->mtu, iface->vrf_id, api_info
 	);
@@ -398,7 +787,6 @@ static int iface_port_init(struct iface *iface, const void *api_info) {
 		errno = -ret;
 		goto fail;
 	}
-	port_ifaces[port_id] = iface;
 
 	return 0;
 fail:
@@ -456,6 +844,8 @@ static int port_mac_add(struct iface *iface, const struct rte_ether_addr *mac) {
 	filter->mac[i] = *mac;
 	filter->refcnt[i] = 1;
 	filter->count++;
+	if (!multicast)
+		iface_set_ucast_addrs(iface, filter->mac, filter->count);
 
 	LOG(INFO,
 	    "%s: enabling %s " ETH_ADDR_FMT " mac filter",
@@ -496,6 +886,8 @@ static int port_mac_add(struct iface *iface, const struct rte_ether_addr *mac) {
 
 	if (ret < 0) {
 		filter->count--;
+		if (!multicast)
+			iface_set_ucast_addrs(iface, filter->mac, filter->count);
 		return errno_log(-ret, mac_type);
 	}
 
@@ -558,6 +950,8 @@ found:
 			(filter->count - i - 1) * sizeof(filter->refcnt[i]));
 	}
 	filter->count--;
+	if (!multicast)
+		iface_set_ucast_addrs(iface, filter->mac, filter->count);
 
 	if (filter->flags & MAC_FILTER_F_ALL) {
 		if (filter->count > 0 && filter->flags & MAC_FILTER_F_UNSUPP)
@@ -600,6 +994,12 @@ static void port_to_api(void *info, const struct iface *iface) {
 	api->n_txq = port->n_txq;
 	api->rxq_size = port->rxq_size;
 	api->txq_size = port->txq_size;
+	api->tx_policy = port->tx_policy;
+	api->tx_limit = port->tx_limit;
+	api->ctrl_rxq = port->ctrl_rxq;
+	api->tx_fast_free = port->tx_fast_free;
+	api->tx_free_thresh = port->tx_free_thresh;
+	api->tx_rs_thresh = port->tx_rs_thresh;
 
 	if (rte_eth_dev_info_get(port->port_id, &dev_info) == 0) {
 		memccpy(api->driver_name, dev_info.driver_name, 0, sizeof(api->driver_name));
@@ -620,10 +1020,8 @@ static void link_event_cb(evutil_socket_t, short /*what*/, void * /*priv*/) {
 	struct iface *iface;
 
 	STAILQ_FOREACH (worker, &workers, next) {
-		if (gr_args()->poll_mode)
-			max_sleep_us = 0;
-		else
-			max_sleep_us = 1000; // unreasonably long maximum (1ms)
+		// Poll mode is handled by the worker power policy.
+		max_sleep_us = 1000; // unreasonably long maximum (1ms)
 
 		arrforeach (qmap, worker->rxqs) {
 			i = port_ifaces[qmap->port_id];
@@ -635,24 +1033,26 @@ static void link_event_cb(evutil_socket_t, short /*what*/, void * /*priv*/) {
 
 			if (rte_eth_link_get_nowait(qmap->port_id, &link) < 0) {
 				LOG(INFO, "%s: link status down", iface->name);
-				iface->state &= ~GR_IFACE_S_RUNNING;
+				if (iface->state & GR_IFACE_S_RUNNING) {
+					iface->state &= ~GR_IFACE_S_RUNNING;
+					iface_event_notify(IFACE_EVENT_PORT_LINK_CHANGE, iface);
+				}
 				continue;
 			}
 			if (link.link_status == RTE_ETH_LINK_UP) {
 				if (!(iface->state & GR_IFACE_S_RUNNING)) {
 					LOG(INFO, "%s: link status up", iface->name);
 					iface->state |= GR_IFACE_S_RUNNING;
+					iface_event_notify(IFACE_EVENT_PORT_LINK_CHANGE, iface);
 				}
 			} else {
 				if (iface->state & GR_IFACE_S_RUNNING) {
 					LOG(INFO, "%s: link status down", iface->name);
 					iface->state &= ~GR_IFACE_S_RUNNING;
+					iface_event_notify(IFACE_EVENT_PORT_LINK_CHANGE, iface);
 				}
 				continue;
 			}
-			if (gr_args()->poll_mode)
-				continue;
-
 			switch (link.link_speed) {
 			case RTE_ETH_SPEED_NUM_NONE:
 			case RTE_ETH_SPEED_NUM_UNKNOWN:
@@ -684,9 +1084,9 @@ static int lsc_port_cb(
 }
 
 static void port_init(struct event_base *base) {
-	link_event = event_new(base, -1, EV_PERSIST | EV_FINALIZE, link_event_cb, NULL);
+	link_event = gr_event_new(base, -1, EV_PERSIST | EV_FINALIZE, link_event_cb, NULL);
 	if (link_event == NULL)
-		ABORT("event_new() failed");
+		ABORT("gr_event_new() failed");
 	// Not all drivers support triggering link status change events.
 	// Ensure the link_event is triggered at least once every second.
 	struct timeval tv = {.tv_sec = 1};
@@ -697,7 +1097,7 @@ static void port_init(struct event_base *base) {
 
 static void port_fini(struct event_base *) {
 	rte_eth_dev_callback_unregister(RTE_ETH_ALL, RTE_ETH_EVENT_INTR_LSC, lsc_port_cb, NULL);
-	event_free(link_event);
+	gr_event_free(link_event);
 	link_event = NULL;
 }
 
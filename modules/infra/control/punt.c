@@ -0,0 +1,307 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_infra.h>
+#include <gr_log.h>
+#include <gr_mempool.h>
+#include <gr_punt.h>
+#include <gr_rcu.h>
+#include <gr_worker.h>
+
+#include <rte_dev.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_graph.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_spinlock.h>
+
+#include <errno.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define PUNT_QUEUE_SIZE 1024
+// ring descriptors and one burst held by a worker
+#define PUNT_RXQ_MBUFS (PUNT_QUEUE_SIZE + RTE_GRAPH_BURST_SIZE)
+
+// Mirror the grout interface on the kernel device. ARP is disabled: grout
+// resolves the next hops and the kernel sends its frames to its own address.
+static int netdev_setup(const char *ifname, const struct iface *iface, struct rte_ether_addr *mac) {
+	struct ifreq ifr;
+	int fd, ret = 0;
+	short flags;
+
+	if ((fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0)
+		return errno_log(errno, "socket");
+
+	memset(&ifr, 0, sizeof(ifr));
+	memccpy(ifr.ifr_name, ifname, 0, sizeof(ifr.ifr_name) - 1);
+
+	if (ioctl(fd, SIOCGIFFLAGS, &ifr) < 0) {
+		ret = errno_log(errno, "SIOCGIFFLAGS");
+		goto out;
+	}
+	flags = ifr.ifr_flags;
+	// the ethernet address cannot be changed while the device is up
+	ifr.ifr_flags = flags & ~IFF_UP;
+	if (ioctl(fd, SIOCSIFFLAGS, &ifr) < 0) {
+		ret = errno_log(errno, "SIOCSIFFLAGS");
+		goto out;
+	}
+	if (!rte_is_zero_ether_addr(&iface->mac)) {
+		ifr.ifr_hwaddr.sa_family = ARPHRD_ETHER;
+		memcpy(ifr.ifr_hwaddr.sa_data, &iface->mac, sizeof(iface->mac));
+		if (ioctl(fd, SIOCSIFHWADDR, &ifr) < 0) {
+			ret = errno_log(errno, "SIOCSIFHWADDR");
+			goto out;
+		}
+	}
+	if (iface->mtu != 0) {
+		ifr.ifr_mtu = iface->mtu;
+		if (ioctl(fd, SIOCSIFMTU, &ifr) < 0) {
+			ret = errno_log(errno, "SIOCSIFMTU");
+			goto out;
+		}
+	}
+	ifr.ifr_flags = flags | IFF_UP | IFF_NOARP;
+	if (ioctl(fd, SIOCSIFFLAGS, &ifr) < 0) {
+		ret = errno_log(errno, "SIOCSIFFLAGS");
+		goto out;
+	}
+	if (ioctl(fd, SIOCGIFHWADDR, &ifr) < 0) {
+		ret = errno_log(errno, "SIOCGIFHWADDR");
+		goto out;
+	}
+	memcpy(mac, ifr.ifr_hwaddr.sa_data, sizeof(*mac));
+out:
+	close(fd);
+	return ret;
+}
+
+static void punt_port_close(uint16_t port_id) {
+	struct rte_eth_dev_info info = {0};
+	int ret;
+
+	if ((ret = rte_eth_dev_info_get(port_id, &info)) < 0)
+		LOG(ERR, "rte_eth_dev_info_get: %s", rte_strerror(-ret));
+	if ((ret = rte_eth_dev_stop(port_id)) < 0)
+		LOG(ERR, "rte_eth_dev_stop: %s", rte_strerror(-ret));
+	if ((ret = rte_eth_dev_close(port_id)) < 0)
+		LOG(ERR, "rte_eth_dev_close: %s", rte_strerror(-ret));
+	if (info.device != NULL && (ret = rte_dev_remove(info.device)) < 0)
+		LOG(ERR, "rte_dev_remove: %s", rte_strerror(-ret));
+}
+
+static void punt_free(struct iface_punt *punt) {
+	if (punt == NULL)
+		return;
+	punt_port_close(punt->port_id);
+	gr_pktmbuf_pool_release(punt->pool, PUNT_RXQ_MBUFS);
+	rte_free(punt);
+}
+
+static uint32_t punt_worker_rate(uint32_t rate) {
+	struct worker *worker;
+	unsigned n_workers = 0;
+
+	// each worker gets an equal share of the rate
+	STAILQ_FOREACH (worker, &workers, next)
+		n_workers++;
+
+	return rate / RTE_MAX(n_workers, 1u);
+}
+
+static struct iface_punt *punt_new(const struct iface *iface, const struct gr_iface_punt *conf) {
+	char name[RTE_DEV_NAME_MAX_LEN], devargs[128];
+	struct rte_eth_conf eth_conf = {0};
+	struct rte_eth_dev_info info;
+	struct iface_punt *punt;
+	int ret;
+
+	if ((punt = rte_zmalloc(__func__, sizeof(*punt), RTE_CACHE_LINE_SIZE)) == NULL)
+		return errno_set_null(ENOMEM);
+
+	punt->iface = iface;
+	punt->conf = *conf;
+	punt->rate = punt_worker_rate(conf->rate);
+	rte_spinlock_init(&punt->tx_lock);
+	rte_spinlock_init(&punt->rx_lock);
+
+	// vhost-net copies the frames directly from/to the mbufs
+	snprintf(name, sizeof(name), "virtio_user_punt%u", iface->id);
+	snprintf(
+		devargs,
+		sizeof(devargs),
+		"%s,path=/dev/vhost-net,iface=%s,queues=1,queue_size=%u",
+		name,
+		conf->ifname,
+		PUNT_QUEUE_SIZE
+	);
+	if ((ret = rte_dev_probe(devargs)) < 0) {
+		errno_log(-ret, "rte_dev_probe");
+		rte_free(punt);
+		return NULL;
+	}
+	if ((ret = rte_eth_dev_get_port_by_name(name, &punt->port_id)) < 0) {
+		errno_log(-ret, "rte_eth_dev_get_port_by_name");
+		rte_free(punt);
+		return NULL;
+	}
+
+	if ((ret = rte_eth_dev_info_get(punt->port_id, &info)) < 0) {
+		errno_log(-ret, "rte_eth_dev_info_get");
+		goto err;
+	}
+	eth_conf.txmode.offloads = info.tx_offload_capa & RTE_ETH_TX_OFFLOAD_MULTI_SEGS;
+	// Coalesced TCP segments are handed over as a single GSO frame.
+	if ((info.tx_offload_capa & PUNT_GRO_OFFLOADS) == PUNT_GRO_OFFLOADS) {
+		eth_conf.txmode.offloads |= PUNT_GRO_OFFLOADS;
+		punt->gro = true;
+	}
+	if ((ret = rte_eth_dev_configure(punt->port_id, 1, 1, &eth_conf)) < 0) {
+		errno_log(-ret, "rte_eth_dev_configure");
+		goto err;
+	}
+	if ((punt->pool = gr_pktmbuf_pool_get(SOCKET_ID_ANY, PUNT_RXQ_MBUFS)) == NULL)
+		goto err;
+	ret = rte_eth_rx_queue_setup(
+		punt->port_id, 0, PUNT_QUEUE_SIZE, rte_socket_id(), NULL, punt->pool
+	);
+	if (ret < 0) {
+		errno_log(-ret, "rte_eth_rx_queue_setup");
+		goto err;
+	}
+	ret = rte_eth_tx_queue_setup(punt->port_id, 0, PUNT_QUEUE_SIZE, rte_socket_id(), NULL);
+	if (ret < 0) {
+		errno_log(-ret, "rte_eth_tx_queue_setup");
+		goto err;
+	}
+	// the kernel device is created when the queues are enabled
+	if ((ret = rte_eth_dev_start(punt->port_id)) < 0) {
+		errno_log(-ret, "rte_eth_dev_start");
+		goto err;
+	}
+	if ((ret = rte_eth_macaddr_get(punt->port_id, &punt->port_mac)) < 0) {
+		errno_log(-ret, "rte_eth_macaddr_get");
+		goto err;
+	}
+	if (netdev_setup(conf->ifname, iface, &punt->kernel_mac) < 0)
+		goto err;
+
+	return punt;
+err:
+	ret = errno;
+	punt_free(punt);
+	return errno_set_null(ret);
+}
+
+static void punt_publish(struct iface *iface, struct iface_punt *punt) {
+	struct iface_punt *old = iface->punt;
+	unsigned count = punt_count;
+
+	if (old != NULL) {
+		for (unsigned i = 0; i < count; i++) {
+			if (punt_ifaces[i] != old)
+				continue;
+			__atomic_store_n(&punt_ifaces[i], punt_ifaces[count - 1], __ATOMIC_RELEASE);
+			__atomic_store_n(&punt_ifaces[count - 1], NULL, __ATOMIC_RELEASE);
+			__atomic_store_n(&punt_count, --count, __ATOMIC_RELEASE);
+			break;
+		}
+	}
+	if (punt != NULL) {
+		__atomic_store_n(&punt_ifaces[count], punt, __ATOMIC_RELEASE);
+		__atomic_store_n(&punt_count, count + 1, __ATOMIC_RELEASE);
+	}
+	__atomic_store_n(&iface->punt, punt, __ATOMIC_RELEASE);
+
+	if (old != NULL) {
+		// the port is closed, workers must not use it anymore
+		gr_rcu_synchronize();
+		punt_free(old);
+	}
+}
+
+int iface_punt_set(struct iface *iface, const struct gr_iface_punt *conf) {
+	struct iface_punt *punt = NULL;
+	const struct iface *i = NULL;
+
+	if (memchr(conf->ifname, '\0', sizeof(conf->ifname)) == NULL)
+		return errno_set(ENAMETOOLONG);
+
+	if (conf->ifname[0] == '\0') {
+		if (iface->punt != NULL) {
+			LOG(INFO, "%s: exception path disabled", iface->name);
+			punt_publish(iface, NULL);
+		}
+		return 0;
+	}
+
+	if (conf->rate != 0 && punt_worker_rate(conf->rate) == 0)
+		return errno_set(ERANGE);
+
+	if (iface->punt != NULL && strcmp(iface->punt->conf.ifname, conf->ifname) == 0) {
+		// same kernel device, no need to recreate it
+		punt = iface->punt;
+		punt->conf.rate = conf->rate;
+		__atomic_store_n(&punt->rate, punt_worker_rate(conf->rate), __ATOMIC_RELAXED);
+		return 0;
+	}
+
+	while ((i = iface_next(GR_IFACE_TYPE_UNDEF, i)) != NULL) {
+		if (i->punt != NULL && strcmp(i->punt->conf.ifname, conf->ifname) == 0)
+			return errno_set(EADDRINUSE);
+	}
+
+	// the device name may be reused by the new configuration
+	if (iface->punt != NULL)
+		punt_publish(iface, NULL);
+	if ((punt = punt_new(iface, conf)) == NULL)
+		return -errno;
+	punt_publish(iface, punt);
+
+	LOG(INFO, "%s: exception path to kernel device %s", iface->name, conf->ifname);
+
+	return 0;
+}
+
+int iface_punt_get(const struct iface *iface, struct gr_iface_punt *conf) {
+	const struct iface_punt *punt = iface->punt;
+
+	if (punt == NULL) {
+		memset(conf, 0, sizeof(*conf));
+		return 0;
+	}
+
+	*conf = punt->conf;
+	conf->punted = conf->injected = conf->dropped = conf->coalesced = 0;
+	for (unsigned i = 0; i < RTE_DIM(punt->lcores); i++) {
+		conf->punted += __atomic_load_n(&punt->lcores[i].punted, __ATOMIC_RELAXED);
+		conf->injected += __atomic_load_n(&punt->lcores[i].injected, __ATOMIC_RELAXED);
+		conf->dropped += __atomic_load_n(&punt->lcores[i].dropped, __ATOMIC_RELAXED);
+		conf->coalesced += __atomic_load_n(&punt->lcores[i].coalesced, __ATOMIC_RELAXED);
+	}
+
+	return 0;
+}
+
+static void punt_iface_event(iface_event_t event, struct iface *iface) {
+	if (event == IFACE_EVENT_PRE_REMOVE && iface->punt != NULL)
+		punt_publish(iface, NULL);
+}
+
+static struct iface_event_handler punt_iface_event_handler = {
+	.callback = punt_iface_event,
+};
+
+RTE_INIT(punt_constructor) {
+	iface_event_register_handler(&punt_iface_event_handler);
+}
@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "graph_priv.h"
+
+#include <gr_iface.h>
+#include <gr_infra.h>
+#include <gr_log.h>
+#include <gr_macro.h>
+#include <gr_port.h>
+#include <gr_tx.h>
+
+#include <rte_common.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_graph.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_ring.h>
+#include <rte_sched.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+// Size of the ring used by the other workers to hand packets to the scheduler.
+#define SCHED_RING_SIZE 4096
+// Credit refill period of the traffic classes.
+#define SCHED_TC_PERIOD_MS 10
+#define SCHED_SUBPORT_BURST 1000000
+
+static void tx_sched_free(struct tx_sched *s) {
+	struct rte_mbuf *mbufs[RTE_GRAPH_BURST_SIZE];
+	unsigned n;
+
+	if (s == NULL)
+		return;
+	if (s->ring != NULL) {
+		while ((n = rte_ring_dequeue_burst(s->ring, (void **)mbufs, RTE_DIM(mbufs), NULL)))
+			rte_pktmbuf_free_bulk(mbufs, n);
+		rte_ring_free(s->ring);
+	}
+	// packets still in the queues are freed as well
+	rte_sched_port_free(s->port);
+	rte_free(s);
+}
+
+static struct tx_sched *tx_sched_new(const struct iface *iface, const struct gr_port_qos *qos) {
+	const struct iface_info_port *p = (const struct iface_info_port *)iface->info;
+	int socket_id = rte_eth_dev_socket_id(p->port_id);
+	char name[RTE_RING_NAMESIZE];
+	struct rte_sched_pipe_params pipe = {
+		.tb_rate = qos->pipe_rate / 8,
+		.tb_size = qos->pipe_burst,
+		.tc_period = SCHED_TC_PERIOD_MS,
+		.tc_ov_weight = 1,
+		.wrr_weights = {1, 1, 1, 1},
+	};
+	struct rte_sched_subport_profile_params profile = {
+		.tb_rate = qos->rate / 8,
+		.tb_size = SCHED_SUBPORT_BURST,
+		.tc_period = SCHED_TC_PERIOD_MS,
+	};
+	struct rte_sched_subport_params subport = {
+		.n_pipes_per_subport_enabled = qos->n_pipes,
+		.pipe_profiles = &pipe,
+		.n_pipe_profiles = 1,
+		.n_max_pipe_profiles = 1,
+	};
+	struct rte_sched_port_params params = {
+		.name = name,
+		.socket = socket_id == SOCKET_ID_ANY ? 0 : socket_id,
+		.rate = qos->rate / 8,
+		.mtu = iface->mtu,
+		.frame_overhead = RTE_SCHED_FRAME_OVERHEAD_DEFAULT,
+		.n_subports_per_port = 1,
+		.n_pipes_per_subport = qos->n_pipes,
+		.subport_profiles = &profile,
+		.n_subport_profiles = 1,
+		.n_max_subport_profiles = 1,
+	};
+	struct tx_sched *s;
+	int ret;
+
+	for (unsigned tc = 0; tc < RTE_SCHED_TRAFFIC_CLASSES_PER_PIPE; tc++) {
+		pipe.tc_rate[tc] = pipe.tb_rate;
+		profile.tc_rate[tc] = profile.tb_rate;
+		subport.qsize[tc] = qos->queue_size;
+	}
+
+	if ((s = rte_zmalloc_socket(__func__, sizeof(*s), RTE_CACHE_LINE_SIZE, socket_id)) == NULL)
+		return errno_set_null(ENOMEM);
+	s->classify = qos->classify;
+	s->pipe_mask = qos->n_pipes - 1;
+
+	snprintf(name, sizeof(name), "sched_%u", p->port_id);
+	if ((s->port = rte_sched_port_config(&params)) == NULL) {
+		ret = EINVAL;
+		goto err;
+	}
+	if ((ret = rte_sched_subport_config(s->port, 0, &subport, 0)) < 0) {
+		ret = -ret;
+		goto err;
+	}
+	for (uint32_t i = 0; i < qos->n_pipes; i++) {
+		if ((ret = rte_sched_pipe_config(s->port, 0, i, 0)) < 0) {
+			ret = -ret;
+			goto err;
+		}
+	}
+
+	// multiple producers (other workers), single consumer (scheduler worker)
+	s->ring = rte_ring_create(name, SCHED_RING_SIZE, socket_id, RING_F_SC_DEQ);
+	if (s->ring == NULL) {
+		ret = rte_errno;
+		goto err;
+	}
+
+	return s;
+err:
+	LOG(ERR, "%s: scheduler: %s", iface->name, strerror(ret));
+	tx_sched_free(s);
+	return errno_set_null(ret);
+}
+
+int port_qos_set(struct iface *iface, const struct gr_port_qos *api) {
+	struct iface_info_port *p = (struct iface_info_port *)iface->info;
+	struct gr_port_qos qos = *api;
+	struct tx_sched *s = NULL, *old;
+	int ret;
+
+	if (qos.classify > GR_PORT_QOS_PCP)
+		return errno_set(EINVAL);
+
+	if (qos.classify != GR_PORT_QOS_DISABLED) {
+		if (qos.n_pipes == 0)
+			qos.n_pipes = 1;
+		if (qos.queue_size == 0)
+			qos.queue_size = GR_PORT_QOS_QUEUE_SIZE_DEFAULT;
+		if (qos.pipe_rate == 0)
+			qos.pipe_rate = qos.rate;
+		if (qos.pipe_burst == 0)
+			qos.pipe_burst = GR_PORT_QOS_BURST_DEFAULT;
+		if (!rte_is_power_of_2(qos.n_pipes) || !rte_is_power_of_2(qos.queue_size))
+			return errno_set(EINVAL);
+		if (qos.n_pipes > GR_PORT_QOS_PIPES_MAX)
+			return errno_set(ERANGE);
+		if (qos.rate < 8 || qos.pipe_rate < 8 || qos.pipe_rate > qos.rate)
+			return errno_set(ERANGE);
+		if ((s = tx_sched_new(iface, &qos)) == NULL)
+			return -errno;
+	}
+	qos.enqueued = 0;
+	qos.dropped = 0;
+
+	old = p->sched;
+	p->sched = s;
+	p->qos = qos;
+	if ((ret = worker_graph_reload_all()) < 0) {
+		// the previous scheduler may still be in use
+		return ret;
+	}
+	tx_sched_free(old);
+
+	LOG(INFO,
+	    "%s: scheduler %s",
+	    iface->name,
+	    qos.classify == GR_PORT_QOS_DISABLED ? "disabled" : "enabled");
+
+	return 0;
+}
+
+int port_qos_get(const struct iface *iface, struct gr_port_qos *qos) {
+	const struct iface_info_port *p = (const struct iface_info_port *)iface->info;
+
+	*qos = p->qos;
+	if (p->sched != NULL) {
+		qos->enqueued = __atomic_load_n(&p->sched->enqueued, __ATOMIC_RELAXED);
+		qos->dropped = __atomic_load_n(&p->sched->dropped, __ATOMIC_RELAXED);
+	}
+
+	return 0;
+}
+
+static void qos_iface_event(iface_event_t event, struct iface *iface) {
+	struct iface_info_port *p = (struct iface_info_port *)iface->info;
+	struct gr_port_qos disabled = {.classify = GR_PORT_QOS_DISABLED};
+
+	if (event != IFACE_EVENT_PRE_REMOVE || iface->type_id != GR_IFACE_TYPE_PORT)
+		return;
+	if (p->sched != NULL)
+		port_qos_set(iface, &disabled);
+}
+
+static struct iface_event_handler qos_iface_event_handler = {
+	.callback = qos_iface_event,
+};
+
+RTE_INIT(qos_constructor) {
+	iface_event_register_handler(&qos_iface_event_handler);
+}
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_control.h>
+#include <gr_log.h>
+#include <gr_rcu.h>
+
+#include <event2/event.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_rcu_qsbr.h>
+
+// Max number of objects waiting to be released.
+#define RCU_DQ_SIZE (1 << 17)
+// Number of pending objects that triggers a reclaim on enqueue.
+#define RCU_DQ_RECLAIM_LIMIT 1024
+// Max number of objects released at once.
+#define RCU_DQ_RECLAIM_MAX 256
+
+struct rcu_entry {
+	gr_rcu_free_cb_t cb;
+	void *obj;
+};
+
+static struct rte_rcu_qsbr *rcu;
+static struct rte_rcu_qsbr_dq *dq;
+static struct event *reclaim_timer;
+
+struct rte_rcu_qsbr *gr_datapath_rcu(void) {
+	return rcu;
+}
+
+static void rcu_free(void * /*p*/, void *e, unsigned n) {
+	struct rcu_entry *entries = e;
+
+	for (unsigned i = 0; i < n; i++)
+		entries[i].cb(entries[i].obj);
+}
+
+void gr_rcu_synchronize(void) {
+	rte_rcu_qsbr_synchronize(rcu, RTE_QSBR_THRID_INVALID);
+}
+
+uint64_t gr_rcu_start(void) {
+	return rte_rcu_qsbr_start(rcu);
+}
+
+void gr_rcu_wait(uint64_t token) {
+	rte_rcu_qsbr_check(rcu, token, true);
+}
+
+void gr_rcu_defer_free(gr_rcu_free_cb_t cb, void *obj) {
+	struct rcu_entry entry = {.cb = cb, .obj = obj};
+
+	if (rte_rcu_qsbr_dq_enqueue(dq, &entry) == 0)
+		return;
+
+	if (rte_lcore_id() != rte_get_main_lcore()) {
+		// Waiting for a grace period from a datapath worker would never end.
+		LOG(ERR, "rte_rcu_qsbr_dq_enqueue: %s: leaking %p", rte_strerror(rte_errno), obj);
+		return;
+	}
+
+	// The defer queue is full, wait for a grace period and free right away.
+	gr_rcu_synchronize();
+	cb(obj);
+}
+
+static void rcu_reclaim(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	rte_rcu_qsbr_dq_reclaim(dq, RCU_DQ_SIZE, NULL, NULL, NULL);
+}
+
+static void rcu_init(struct event_base *ev_base) {
+	size_t size = rte_rcu_qsbr_get_memsize(RTE_MAX_LCORE);
+
+	rcu = rte_zmalloc("rcu", size, RTE_CACHE_LINE_SIZE);
+	if (rcu == NULL)
+		ABORT("rte_zmalloc(rcu)");
+	if (rte_rcu_qsbr_init(rcu, RTE_MAX_LCORE) < 0)
+		ABORT("rte_rcu_qsbr_init: %s", rte_strerror(rte_errno));
+
+	struct rte_rcu_qsbr_dq_parameters params = {
+		.name = "rcu",
+		.flags = RTE_RCU_QSBR_DQ_MT_LF,
+		.size = RCU_DQ_SIZE,
+		.esize = sizeof(struct rcu_entry),
+		.trigger_reclaim_limit = RCU_DQ_RECLAIM_LIMIT,
+		.max_reclaim_size = RCU_DQ_RECLAIM_MAX,
+		.free_fn = rcu_free,
+		.v = rcu,
+	};
+	dq = rte_rcu_qsbr_dq_create(&params);
+	if (dq == NULL)
+		ABORT("rte_rcu_qsbr_dq_create: %s", rte_strerror(rte_errno));
+
+	// Release pending objects even when nothing new is enqueued.
+	reclaim_timer = gr_event_new(ev_base, -1, EV_PERSIST | EV_FINALIZE, rcu_reclaim, NULL);
+	if (reclaim_timer == NULL)
+		ABORT("gr_event_new() failed");
+	struct timeval tv = {.tv_usec = 100000};
+	if (event_add(reclaim_timer, &tv) < 0)
+		ABORT("event_add() failed");
+}
+
+static void rcu_fini(struct event_base *) {
+	gr_event_free(reclaim_timer);
+	reclaim_timer = NULL;
+	// All workers are stopped at this point, this releases all pending objects.
+	if (rte_rcu_qsbr_dq_delete(dq) < 0)
+		LOG(ERR, "rte_rcu_qsbr_dq_delete: %s", rte_strerror(rte_errno));
+	dq = NULL;
+	rte_free(rcu);
+	rcu = NULL;
+}
+
+static struct gr_module rcu_module = {
+	.name = "rcu",
+	.init = rcu_init,
+	.fini = rcu_fini,
+	.init_prio = -1000,
+	.fini_prio = 30000,
+};
+
+RTE_INIT(rcu_constructor) {
+	gr_register_module(&rcu_module);
+}
@@ -0,0 +1,353 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_infra.h>
+#include <gr_log.h>
+#include <gr_port.h>
+#include <gr_stb_ds.h>
+
+#include <rte_ethdev.h>
+
+#include <errno.h>
+#include <string.h>
+
+static const struct {
+	uint32_t field;
+	uint64_t rss_hf;
+} rss_fields[] = {
+	{GR_PORT_RSS_F_IPV4,
+	 RTE_ETH_RSS_IPV4 | RTE_ETH_RSS_FRAG_IPV4 | RTE_ETH_RSS_NONFRAG_IPV4_OTHER},
+	{GR_PORT_RSS_F_IPV6,
+	 RTE_ETH_RSS_IPV6 | RTE_ETH_RSS_FRAG_IPV6 | RTE_ETH_RSS_NONFRAG_IPV6_OTHER
+		 | RTE_ETH_RSS_IPV6_EX},
+	{GR_PORT_RSS_F_TCP,
+	 RTE_ETH_RSS_NONFRAG_IPV4_TCP | RTE_ETH_RSS_NONFRAG_IPV6_TCP | RTE_ETH_RSS_IPV6_TCP_EX},
+	{GR_PORT_RSS_F_UDP,
+	 RTE_ETH_RSS_NONFRAG_IPV4_UDP | RTE_ETH_RSS_NONFRAG_IPV6_UDP | RTE_ETH_RSS_IPV6_UDP_EX},
+	{GR_PORT_RSS_F_SCTP, RTE_ETH_RSS_NONFRAG_IPV4_SCTP | RTE_ETH_RSS_NONFRAG_IPV6_SCTP},
+	{GR_PORT_RSS_F_VLAN, RTE_ETH_RSS_VLAN},
+	{GR_PORT_RSS_F_ESP, RTE_ETH_RSS_ESP},
+	{GR_PORT_RSS_F_GTPU, RTE_ETH_RSS_GTPU},
+};
+
+static uint64_t fields_to_rss_hf(uint32_t fields) {
+	uint64_t rss_hf = 0;
+
+	for (unsigned i = 0; i < ARRAY_DIM(rss_fields); i++) {
+		if (fields & rss_fields[i].field)
+			rss_hf |= rss_fields[i].rss_hf;
+	}
+
+	return rss_hf;
+}
+
+static uint32_t rss_hf_to_fields(uint64_t rss_hf) {
+	uint32_t fields = 0;
+
+	for (unsigned i = 0; i < ARRAY_DIM(rss_fields); i++) {
+		if (rss_hf & rss_fields[i].rss_hf)
+			fields |= rss_fields[i].field;
+	}
+
+	return fields;
+}
+
+// Well known Toeplitz key that produces the same hash when the source and
+// destination addresses and ports are swapped. Used when the driver does not
+// support the symmetric Toeplitz hash function.
+static uint8_t symmetric_key[GR_PORT_RSS_KEY_SIZE];
+
+RTE_INIT(symmetric_key_init) {
+	for (unsigned i = 0; i < sizeof(symmetric_key); i += 2) {
+		symmetric_key[i] = 0x6d;
+		symmetric_key[i + 1] = 0x5a;
+	}
+}
+
+static bool symmetric_toeplitz_supported(const struct rte_eth_dev_info *info) {
+	return info->rss_algo_capa
+		& RTE_ETH_HASH_ALGO_CAPA_MASK(RTE_ETH_HASH_FUNCTION_SYMMETRIC_TOEPLITZ);
+}
+
+void port_rss_conf_fill(
+	const struct iface_info_port *p,
+	const struct rte_eth_dev_info *info,
+	struct rte_eth_rss_conf *conf
+) {
+	if (p->rss_fields != 0)
+		conf->rss_hf = fields_to_rss_hf(p->rss_fields);
+
+	conf->rss_key = NULL;
+	conf->rss_key_len = 0;
+	conf->algorithm = RTE_ETH_HASH_FUNCTION_DEFAULT;
+
+	if (p->rss_key_len != 0 && p->rss_key_len == info->hash_key_size) {
+		conf->rss_key = (uint8_t *)p->rss_key;
+		conf->rss_key_len = p->rss_key_len;
+	}
+	if (p->rss_symmetric) {
+		if (symmetric_toeplitz_supported(info)) {
+			conf->algorithm = RTE_ETH_HASH_FUNCTION_SYMMETRIC_TOEPLITZ;
+		} else if (info->hash_key_size <= sizeof(symmetric_key)) {
+			conf->rss_key = symmetric_key;
+			conf->rss_key_len = info->hash_key_size;
+		}
+	}
+}
+
+static bool reta_valid(const struct iface_info_port *p, uint16_t reta_size) {
+	if (arrlen(p->reta) != reta_size)
+		return false;
+	for (uint16_t i = 0; i < reta_size; i++) {
+		if (p->reta[i] >= p->n_rxq || port_rxq_tenant(p, p->reta[i]) != 0)
+			return false;
+	}
+	return true;
+}
+
+static int reta_update(const struct iface_info_port *p) {
+	struct rte_eth_rss_reta_entry64 reta[RTE_ETH_RSS_RETA_SIZE_512 / RTE_ETH_RETA_GROUP_SIZE];
+	uint16_t size = arrlen(p->reta);
+	int ret;
+
+	memset(reta, 0, sizeof(reta));
+	for (uint16_t i = 0; i < size; i++) {
+		reta[i / RTE_ETH_RETA_GROUP_SIZE].mask |= 1ULL << (i % RTE_ETH_RETA_GROUP_SIZE);
+		reta[i / RTE_ETH_RETA_GROUP_SIZE].reta[i % RTE_ETH_RETA_GROUP_SIZE] = p->reta[i];
+	}
+	if ((ret = rte_eth_dev_rss_reta_update(p->port_id, reta, size)) < 0)
+		return errno_set(-ret);
+
+	return 0;
+}
+
+static int reta_size_get(const struct iface_info_port *p, uint16_t *size) {
+	struct rte_eth_dev_info info;
+	int ret;
+
+	if ((ret = rte_eth_dev_info_get(p->port_id, &info)) < 0)
+		return errno_set(-ret);
+	if (info.reta_size == 0 || info.reta_size > RTE_ETH_RSS_RETA_SIZE_512)
+		return errno_set(ENOTSUP);
+
+	*size = info.reta_size;
+
+	return 0;
+}
+
+// Datapath rxqs not pinned to a tenant. All rxqs if they are all pinned.
+static uint16_t shared_rxqs(const struct iface_info_port *p, uint16_t *rxqs) {
+	uint16_t n = 0;
+
+	for (uint16_t q = 0; q < p->n_rxq; q++) {
+		if (port_rxq_tenant(p, q) == 0)
+			rxqs[n++] = q;
+	}
+	if (n == 0) {
+		for (; n < p->n_rxq; n++)
+			rxqs[n] = n;
+	}
+
+	return n;
+}
+
+// Spread buckets evenly over the shared datapath rxqs.
+static void reta_reset(struct iface_info_port *p, uint16_t size) {
+	uint16_t rxqs[UINT8_MAX + 1];
+	uint16_t n = shared_rxqs(p, rxqs);
+
+	arrsetlen(p->reta, size);
+	for (uint16_t i = 0; i < size; i++)
+		p->reta[i] = rxqs[i % n];
+}
+
+int port_reta_apply(struct iface_info_port *p, const struct rte_eth_dev_info *info) {
+	uint16_t size = info->reta_size;
+
+	// The driver default table is fine when all rxqs receive RSS traffic.
+	// Once configured, the previous table must be overwritten.
+	if (p->reta == NULL && !p->ctrl_rxq && arrlen(p->pins) == 0 && !p->configured)
+		return 0;
+	if (size == 0 || size > RTE_ETH_RSS_RETA_SIZE_512)
+		return errno_set(ENOTSUP);
+
+	if (p->reta != NULL && !reta_valid(p, size)) {
+		LOG(NOTICE, "port %u: rss reta does not match rxqs, using default", p->port_id);
+		arrfree(p->reta);
+		p->reta = NULL;
+	}
+	if (p->reta == NULL) {
+		reta_reset(p, size);
+		if (reta_update(p) < 0)
+			return -errno;
+		// only keep explicit tables on reconfiguration
+		arrfree(p->reta);
+		p->reta = NULL;
+		return 0;
+	}
+
+	return reta_update(p);
+}
+
+unsigned port_reta_buckets(const struct iface_info_port *p, uint16_t rxq) {
+	uint16_t size, rxqs[UINT8_MAX + 1];
+	unsigned n = 0;
+
+	if (p->reta == NULL) {
+		if (reta_size_get(p, &size) < 0 || rxq >= p->n_rxq)
+			return 0;
+		n = shared_rxqs(p, rxqs);
+		for (uint16_t i = 0; i < n; i++) {
+			if (rxqs[i] == rxq)
+				return size / n + (i < size % n ? 1 : 0);
+		}
+		return 0;
+	}
+	for (int i = 0; i < arrlen(p->reta); i++) {
+		if (p->reta[i] == rxq)
+			n++;
+	}
+
+	return n;
+}
+
+int port_reta_move(struct iface_info_port *p, uint16_t from, uint16_t to, unsigned n_buckets) {
+	unsigned total, moved, stride;
+	uint16_t size;
+
+	if (from >= p->n_rxq || to >= p->n_rxq || from == to)
+		return errno_set(EINVAL);
+	if (port_rxq_tenant(p, from) != 0 || port_rxq_tenant(p, to) != 0)
+		return errno_set(EBUSY);
+	if (p->reta == NULL) {
+		if (reta_size_get(p, &size) < 0)
+			return -errno;
+		reta_reset(p, size);
+	}
+
+	total = port_reta_buckets(p, from);
+	// always leave at least one bucket to the source rxq
+	if (n_buckets >= total)
+		n_buckets = total - 1;
+	if (n_buckets == 0)
+		return 0;
+
+	// spread the moved buckets over the table
+	stride = total / n_buckets;
+	moved = 0;
+	for (int i = 0, seen = 0; i < arrlen(p->reta) && moved < n_buckets; i++) {
+		if (p->reta[i] != from)
+			continue;
+		if (seen++ % stride == 0) {
+			p->reta[i] = to;
+			moved++;
+		}
+	}
+
+	if (reta_update(p) < 0)
+		return -errno;
+
+	return moved;
+}
+
+int port_rss_set(struct iface_info_port *p, uint8_t set_attrs, const struct gr_port_rss *rss) {
+	struct rte_eth_rss_conf conf = {0};
+	struct rte_eth_dev_info info;
+	uint16_t *reta = NULL;
+	int ret;
+
+	if ((ret = rte_eth_dev_info_get(p->port_id, &info)) < 0)
+		return errno_set(-ret);
+
+	if (set_attrs & GR_PORT_RSS_SET_KEY && rss->key_len != 0
+	    && rss->key_len != info.hash_key_size)
+		return errno_set(EINVAL);
+	if (set_attrs & GR_PORT_RSS_SET_HASH_FIELDS
+	    && (fields_to_rss_hf(rss->hash_fields) & info.flow_type_rss_offloads) == 0)
+		return errno_set(ENOTSUP);
+	if (set_attrs & GR_PORT_RSS_SET_RETA && rss->reta_size != 0) {
+		if (info.reta_size == 0 || info.reta_size > RTE_ETH_RSS_RETA_SIZE_512)
+			return errno_set(ENOTSUP);
+		if (rss->reta_size > info.reta_size || rss->reta_size > GR_PORT_RETA_SIZE)
+			return errno_set(ERANGE);
+		for (uint16_t i = 0; i < rss->reta_size; i++) {
+			if (rss->reta[i] >= p->n_rxq)
+				return errno_set(EINVAL);
+			if (port_rxq_tenant(p, rss->reta[i]) != 0)
+				return errno_set(EBUSY);
+		}
+		arrsetlen(reta, info.reta_size);
+		for (uint16_t i = 0; i < info.reta_size; i++)
+			reta[i] = rss->reta[i % rss->reta_size];
+	}
+
+	if (set_attrs & GR_PORT_RSS_SET_HASH_FIELDS)
+		p->rss_fields = rss->hash_fields;
+	if (set_attrs & GR_PORT_RSS_SET_SYMMETRIC)
+		p->rss_symmetric = rss->symmetric;
+	if (set_attrs & GR_PORT_RSS_SET_KEY) {
+		p->rss_key_len = rss->key_len;
+		memcpy(p->rss_key, rss->key, rss->key_len);
+	}
+
+	if (set_attrs & ~GR_PORT_RSS_SET_RETA) {
+		conf.rss_hf = PORT_RSS_HF_DEFAULT;
+		port_rss_conf_fill(p, &info, &conf);
+		conf.rss_hf &= info.flow_type_rss_offloads;
+		if ((ret = rte_eth_dev_rss_hash_update(p->port_id, &conf)) < 0) {
+			arrfree(reta);
+			return errno_set(-ret);
+		}
+	}
+
+	if (set_attrs & GR_PORT_RSS_SET_RETA) {
+		arrfree(p->reta);
+		p->reta = reta;
+		if ((ret = port_reta_apply(p, &info)) < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+int port_rss_get(const struct iface_info_port *p, struct gr_port_rss *rss) {
+	struct rte_eth_rss_reta_entry64 reta[RTE_ETH_RSS_RETA_SIZE_512 / RTE_ETH_RETA_GROUP_SIZE];
+	uint8_t key[GR_PORT_RSS_KEY_SIZE];
+	struct rte_eth_rss_conf conf;
+	struct rte_eth_dev_info info;
+	int ret;
+
+	memset(rss, 0, sizeof(*rss));
+	rss->symmetric = p->rss_symmetric;
+
+	if ((ret = rte_eth_dev_info_get(p->port_id, &info)) < 0)
+		return errno_set(-ret);
+
+	memset(&conf, 0, sizeof(conf));
+	if (info.hash_key_size <= sizeof(key)) {
+		conf.rss_key = key;
+		conf.rss_key_len = info.hash_key_size;
+	}
+	if ((ret = rte_eth_dev_rss_hash_conf_get(p->port_id, &conf)) < 0)
+		return errno_set(-ret);
+	rss->hash_fields = rss_hf_to_fields(conf.rss_hf);
+	if (conf.rss_key != NULL) {
+		rss->key_len = conf.rss_key_len;
+		memcpy(rss->key, key, conf.rss_key_len);
+	}
+
+	if (info.reta_size == 0 || info.reta_size > RTE_ETH_RSS_RETA_SIZE_512)
+		return 0;
+
+	memset(reta, 0, sizeof(reta));
+	for (uint16_t i = 0; i < info.reta_size; i++)
+		reta[i / RTE_ETH_RETA_GROUP_SIZE].mask |= 1ULL << (i % RTE_ETH_RETA_GROUP_SIZE);
+	if ((ret = rte_eth_dev_rss_reta_query(p->port_id, reta, info.reta_size)) < 0)
+		return 0; // not all drivers support querying the table
+
+	rss->reta_size = info.reta_size;
+	for (uint16_t i = 0; i < info.reta_size; i++)
+		rss->reta[i] = reta[i / RTE_ETH_RETA_GROUP_SIZE].reta[i % RTE_ETH_RETA_GROUP_SIZE];
+
+	return 0;
+}
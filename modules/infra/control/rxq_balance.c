@@ -0,0 +1,567 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "worker_priv.h"
+
+#include <gr.h>
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_log.h>
+#include <gr_macro.h>
+#include <gr_port.h>
+#include <gr_stb_ds.h>
+#include <gr_worker.h>
+
+#include <event2/event.h>
+#include <numa.h>
+#include <rte_build_config.h>
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+
+#include <errno.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/queue.h>
+
+// Automatic RX queue balancing.
+//
+// Every period, the busy ratio of all workers is computed from their cycle
+// counters. When the busiest worker is loaded above BALANCE_MIN_LOAD and the
+// gap with the least loaded worker on the same NUMA socket is larger than
+// BALANCE_MIN_GAP for BALANCE_HOLD consecutive periods, one RX queue is moved
+// between them. The queue is chosen from the per-queue hardware packet
+// counters so that the load of both workers ends up as close as possible.
+//
+// When no whole queue can be moved without swapping the roles of both workers
+// (e.g. the busiest worker only polls one queue), RSS indirection table
+// buckets are moved instead, from a queue of the busiest worker to a queue of
+// the same port polled by the least loaded worker. The traffic is assumed to
+// be evenly spread over the buckets of a queue.
+//
+// After a move, no other queue is moved for BALANCE_COOLDOWN periods to let
+// the counters settle and to avoid queues flapping between workers.
+//
+// Workers polling queues pinned to a tenant are dedicated to it: queues are
+// only moved to workers which poll no queue of another tenant, and RSS buckets
+// are only moved between shared queues. A flood to one tenant can only load
+// the workers of that tenant.
+#define BALANCE_PERIOD_SEC 5
+#define BALANCE_MIN_LOAD 0.5
+#define BALANCE_MIN_GAP 0.2
+#define BALANCE_HOLD 2
+#define BALANCE_COOLDOWN 6
+
+// Automatic worker scaling, enabled with --autoscale.
+//
+// When all the workers of a NUMA socket are loaded above SCALE_UP_LOAD for
+// SCALE_HOLD consecutive periods, a worker is started on a free CPU of the
+// autoscale pool on that socket. The busiest RX queue of the busiest worker is
+// moved to it, the queue balancing then evens out the load.
+//
+// Workers running on CPUs of the pool are retired when their load stays below
+// SCALE_DOWN_LOAD for SCALE_IDLE periods and the least loaded worker of the
+// same socket can absorb it. All their RX queues are moved to that worker and
+// the empty worker is destroyed. Workers on other CPUs are never retired.
+//
+// Starting or stopping a worker changes the number of TX queues, all ports
+// are reconfigured.
+#define SCALE_UP_LOAD 0.8
+#define SCALE_DOWN_LOAD 0.1
+#define SCALE_HOLD 3
+#define SCALE_IDLE 12
+
+struct worker_load {
+	uint64_t total_cycles;
+	uint64_t busy_cycles;
+	double load;
+	bool valid;
+};
+
+static struct event *balance_ev;
+static struct worker_load loads[CPU_SETSIZE];
+static uint64_t rxq_packets[RTE_MAX_ETHPORTS][RTE_ETHDEV_QUEUE_STAT_CNTRS];
+static uint64_t rxq_rates[RTE_MAX_ETHPORTS][RTE_ETHDEV_QUEUE_STAT_CNTRS];
+static unsigned imbalance_periods;
+static unsigned cooldown;
+static bool scale_enabled;
+static cpu_set_t scale_cpus;
+static unsigned overload_periods[RTE_MAX_NUMA_NODES];
+static unsigned idle_periods[CPU_SETSIZE];
+
+static void update_rxq_rates(void) {
+	struct iface *iface = NULL;
+
+	while ((iface = iface_next(GR_IFACE_TYPE_PORT, iface)) != NULL) {
+		const struct iface_info_port *port = (const struct iface_info_port *)iface->info;
+		struct rte_eth_stats st;
+		uint16_t q;
+
+		if (rte_eth_stats_get(port->port_id, &st) < 0)
+			continue;
+
+		for (q = 0; q < port->n_rxq && q < RTE_ETHDEV_QUEUE_STAT_CNTRS; q++) {
+			uint64_t *prev = &rxq_packets[port->port_id][q];
+			if (st.q_ipackets[q] >= *prev)
+				rxq_rates[port->port_id][q] = st.q_ipackets[q] - *prev;
+			else
+				rxq_rates[port->port_id][q] = 0;
+			*prev = st.q_ipackets[q];
+		}
+	}
+}
+
+static void update_worker_loads(void) {
+	const struct worker_stats *stats;
+	struct worker_load *l;
+	struct worker *worker;
+
+	STAILQ_FOREACH (worker, &workers, next) {
+		if (worker->cpu_id >= ARRAY_DIM(loads))
+			continue;
+		l = &loads[worker->cpu_id];
+		stats = atomic_load(&worker->stats);
+		if (stats == NULL) {
+			l->valid = false;
+			continue;
+		}
+		// counters may have been reset in the meantime
+		l->valid = l->total_cycles != 0 && stats->total_cycles > l->total_cycles
+			&& stats->busy_cycles >= l->busy_cycles;
+		if (l->valid)
+			l->load = (double)(stats->busy_cycles - l->busy_cycles)
+				/ (stats->total_cycles - l->total_cycles);
+		l->total_cycles = stats->total_cycles;
+		l->busy_cycles = stats->busy_cycles;
+	}
+}
+
+static const struct worker_load *worker_load(const struct worker *worker) {
+	if (worker->cpu_id >= ARRAY_DIM(loads) || !loads[worker->cpu_id].valid)
+		return NULL;
+	return &loads[worker->cpu_id];
+}
+
+static unsigned enabled_rxqs(const struct worker *worker) {
+	struct queue_map *qmap;
+	unsigned n = 0;
+
+	arrforeach (qmap, worker->rxqs) {
+		if (qmap->enabled)
+			n++;
+	}
+	return n;
+}
+
+static uint64_t rxq_rate(const struct queue_map *qmap) {
+	if (qmap->port_id >= RTE_MAX_ETHPORTS || qmap->queue_id >= RTE_ETHDEV_QUEUE_STAT_CNTRS)
+		return 0;
+	return rxq_rates[qmap->port_id][qmap->queue_id];
+}
+
+// Zero for shared queues, unique per port and pinned queue range otherwise.
+static uint32_t rxq_tenant(const struct queue_map *qmap) {
+	const struct iface *iface = port_get_iface(qmap->port_id);
+	uint16_t tenant;
+
+	if (iface == NULL)
+		return 0;
+	tenant = port_rxq_tenant((const struct iface_info_port *)iface->info, qmap->queue_id);
+	if (tenant == 0)
+		return 0;
+
+	return ((uint32_t)qmap->port_id << 16) | tenant;
+}
+
+// Whether a queue can be moved to a worker without sharing it between tenants.
+static bool worker_accepts(const struct worker *worker, const struct queue_map *moved) {
+	uint32_t tenant = rxq_tenant(moved);
+	const struct queue_map *qmap;
+
+	arrforeach (qmap, worker->rxqs) {
+		if (rxq_tenant(qmap) != tenant)
+			return false;
+	}
+	return true;
+}
+
+// Find the pair of workers on the same socket with the largest load gap.
+static double find_imbalance(struct worker **hot, struct worker **cold) {
+	const struct worker_load *h, *c;
+	struct worker *w1, *w2;
+	double gap = 0;
+
+	*hot = *cold = NULL;
+
+	STAILQ_FOREACH (w1, &workers, next) {
+		if ((h = worker_load(w1)) == NULL || h->load < BALANCE_MIN_LOAD)
+			continue;
+		if (enabled_rxqs(w1) == 0)
+			continue;
+		STAILQ_FOREACH (w2, &workers, next) {
+			if (w2 == w1 || (c = worker_load(w2)) == NULL)
+				continue;
+			if (numa_node_of_cpu(w1->cpu_id) != numa_node_of_cpu(w2->cpu_id))
+				continue;
+			if (h->load - c->load > gap) {
+				gap = h->load - c->load;
+				*hot = w1;
+				*cold = w2;
+			}
+		}
+	}
+
+	return gap;
+}
+
+// Move RSS buckets from the hot worker busiest queue to a queue of the same
+// port polled by the cold worker. Returns true if any bucket was moved.
+static bool balance_reta(struct worker *hot, struct worker *cold, double gap, double load) {
+	const struct queue_map *src = NULL, *dst = NULL;
+	const struct queue_map *qh, *qc;
+	struct iface_info_port *port;
+	const struct iface *iface;
+	uint64_t total_rate = 0;
+	unsigned n_buckets;
+	double share;
+	int ret;
+
+	arrforeach (qh, hot->rxqs) {
+		if (qh->enabled)
+			total_rate += rxq_rate(qh);
+	}
+	arrforeach (qh, hot->rxqs) {
+		if (!qh->enabled || (iface = port_get_iface(qh->port_id)) == NULL)
+			continue;
+		port = (struct iface_info_port *)iface->info;
+		if (qh->queue_id >= port->n_rxq || port_rxq_tenant(port, qh->queue_id) != 0)
+			continue;
+		if (src != NULL && rxq_rate(qh) <= rxq_rate(src))
+			continue;
+		arrforeach (qc, cold->rxqs) {
+			if (qc->port_id == qh->port_id && qc->queue_id < port->n_rxq
+			    && port_rxq_tenant(port, qc->queue_id) == 0) {
+				src = qh;
+				dst = qc;
+				break;
+			}
+		}
+	}
+	if (src == NULL)
+		return false;
+
+	port = (struct iface_info_port *)port_get_iface(src->port_id)->info;
+	if (total_rate > 0)
+		share = load * rxq_rate(src) / total_rate;
+	else
+		share = load / enabled_rxqs(hot);
+	if (share <= 0)
+		return false;
+
+	n_buckets = port_reta_buckets(port, src->queue_id);
+	n_buckets = RTE_MAX(n_buckets * RTE_MIN(gap / 2 / share, 1.0), 1.0);
+
+	ret = port_reta_move(port, src->queue_id, dst->queue_id, n_buckets);
+	if (ret <= 0) {
+		if (ret < 0 && errno != ENOTSUP)
+			LOG(ERR, "port_reta_move: %s", strerror(errno));
+		return false;
+	}
+
+	LOG(NOTICE,
+	    "moved %d rss buckets of port %u from rxq %u (CPU %u) to rxq %u (CPU %u)",
+	    ret,
+	    src->port_id,
+	    src->queue_id,
+	    hot->cpu_id,
+	    dst->queue_id,
+	    cold->cpu_id);
+
+	return true;
+}
+
+// Queue with the highest packet rate, the first one if the driver does not
+// report per queue counters.
+static const struct queue_map *busiest_rxq(const struct worker *worker) {
+	const struct queue_map *qmap, *best = NULL;
+
+	arrforeach (qmap, worker->rxqs) {
+		if (qmap->enabled && (best == NULL || rxq_rate(qmap) > rxq_rate(best)))
+			best = qmap;
+	}
+	return best;
+}
+
+// Busiest worker of a socket which can give away a queue, NULL unless all the
+// workers of the socket are overloaded.
+static struct worker *socket_overloaded(int socket_id) {
+	const struct worker_load *l, *h = NULL;
+	struct worker *w, *hot = NULL;
+
+	STAILQ_FOREACH (w, &workers, next) {
+		if (numa_node_of_cpu(w->cpu_id) != socket_id)
+			continue;
+		if ((l = worker_load(w)) == NULL || l->load < SCALE_UP_LOAD)
+			return NULL;
+		if (enabled_rxqs(w) > 1 && (h == NULL || l->load > h->load)) {
+			h = l;
+			hot = w;
+		}
+	}
+
+	return hot;
+}
+
+static int scale_cpu_pick(int socket_id) {
+	unsigned main_lcore = rte_get_main_lcore();
+
+	for (unsigned cpu_id = 0; cpu_id < CPU_SETSIZE; cpu_id++) {
+		if (!CPU_ISSET(cpu_id, &scale_cpus) || cpu_id == main_lcore)
+			continue;
+		if (numa_node_of_cpu(cpu_id) != socket_id)
+			continue;
+		if (worker_find(cpu_id) == NULL)
+			return cpu_id;
+	}
+
+	return -1;
+}
+
+static bool scale_up(void) {
+	const struct queue_map *qmap;
+	uint16_t port_id, rxq_id;
+	struct worker *hot;
+	int cpu_id;
+
+	for (int s = 0; s < RTE_MAX_NUMA_NODES; s++) {
+		if ((hot = socket_overloaded(s)) == NULL) {
+			overload_periods[s] = 0;
+			continue;
+		}
+		if (++overload_periods[s] < SCALE_HOLD)
+			continue;
+		overload_periods[s] = 0;
+		if ((cpu_id = scale_cpu_pick(s)) < 0 || (qmap = busiest_rxq(hot)) == NULL)
+			continue;
+
+		// worker_rxq_assign() modifies the queue arrays
+		port_id = qmap->port_id;
+		rxq_id = qmap->queue_id;
+
+		LOG(NOTICE,
+		    "socket %d overloaded, moving port %u rxq %u from CPU %u to new CPU %d",
+		    s,
+		    port_id,
+		    rxq_id,
+		    hot->cpu_id,
+		    cpu_id);
+
+		if (worker_rxq_assign(port_id, rxq_id, cpu_id) < 0) {
+			LOG(ERR, "worker_rxq_assign: %s", strerror(errno));
+			continue;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+// Least loaded worker of the same socket which can take the load of idle.
+static struct worker *scale_target(const struct worker *idle, double load) {
+	const struct worker_load *l, *best_load = NULL;
+	struct worker *w, *best = NULL;
+	const struct queue_map *qmap;
+	bool accepted;
+
+	STAILQ_FOREACH (w, &workers, next) {
+		if (w == idle || numa_node_of_cpu(w->cpu_id) != numa_node_of_cpu(idle->cpu_id))
+			continue;
+		if ((l = worker_load(w)) == NULL || l->load + load >= SCALE_UP_LOAD)
+			continue;
+		accepted = true;
+		arrforeach (qmap, idle->rxqs) {
+			if (!worker_accepts(w, qmap))
+				accepted = false;
+		}
+		if (!accepted)
+			continue;
+		if (best == NULL || l->load < best_load->load) {
+			best = w;
+			best_load = l;
+		}
+	}
+
+	return best;
+}
+
+static bool scale_down(void) {
+	struct queue_map *qmap, *moved = NULL;
+	struct worker *w, *dst = NULL;
+	const struct worker_load *l;
+	bool done = false;
+	unsigned cpu_id;
+
+	STAILQ_FOREACH (w, &workers, next) {
+		if (w->cpu_id >= CPU_SETSIZE || !CPU_ISSET(w->cpu_id, &scale_cpus))
+			continue;
+		if ((l = worker_load(w)) == NULL || l->load >= SCALE_DOWN_LOAD) {
+			idle_periods[w->cpu_id] = 0;
+			continue;
+		}
+		if (++idle_periods[w->cpu_id] < SCALE_IDLE)
+			continue;
+		if ((dst = scale_target(w, l->load)) != NULL)
+			break;
+	}
+	if (w == NULL)
+		return false;
+
+	// The worker is destroyed when its last queue is moved.
+	cpu_id = w->cpu_id;
+	idle_periods[cpu_id] = 0;
+	arrforeach (qmap, w->rxqs)
+		arrpush(moved, *qmap);
+
+	LOG(NOTICE,
+	    "retiring idle worker on CPU %u, moving %u rxqs to CPU %u",
+	    cpu_id,
+	    (unsigned)arrlen(moved),
+	    dst->cpu_id);
+
+	gr_modules_batch_begin();
+	arrforeach (qmap, moved) {
+		if (worker_rxq_assign(qmap->port_id, qmap->queue_id, dst->cpu_id) < 0) {
+			LOG(ERR, "worker_rxq_assign: %s", strerror(errno));
+			break;
+		}
+		done = true;
+	}
+	gr_modules_batch_end();
+	arrfree(moved);
+
+	return done;
+}
+
+static void balance_cb(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	double gap, load, share, diff, best_diff;
+	const struct queue_map *best = NULL;
+	uint16_t port_id, rxq_id, src, dst;
+	const struct queue_map *qmap;
+	struct worker *hot, *cold;
+	uint64_t total_rate;
+	unsigned n_rxqs;
+
+	update_rxq_rates();
+	update_worker_loads();
+
+	if (cooldown > 0) {
+		cooldown--;
+		return;
+	}
+
+	if (scale_enabled && (scale_up() || scale_down())) {
+		imbalance_periods = 0;
+		cooldown = BALANCE_COOLDOWN;
+		return;
+	}
+	if (!gr_args()->balance_rxqs)
+		return;
+
+	gap = find_imbalance(&hot, &cold);
+	if (hot == NULL || gap < BALANCE_MIN_GAP) {
+		imbalance_periods = 0;
+		return;
+	}
+	if (++imbalance_periods < BALANCE_HOLD)
+		return;
+
+	// Estimate the share of the hot worker load caused by each queue. Use
+	// an even split if the driver does not report per queue counters.
+	load = worker_load(hot)->load;
+	n_rxqs = enabled_rxqs(hot);
+	total_rate = 0;
+	arrforeach (qmap, hot->rxqs) {
+		if (qmap->enabled)
+			total_rate += rxq_rate(qmap);
+	}
+
+	// Pick the queue that brings both workers closest to the same load
+	// without swapping their roles.
+	arrforeach (qmap, hot->rxqs) {
+		if (!qmap->enabled)
+			continue;
+		if (total_rate > 0)
+			share = load * rxq_rate(qmap) / total_rate;
+		else
+			share = load / n_rxqs;
+		if (share <= 0 || share >= gap || !worker_accepts(cold, qmap))
+			continue;
+		diff = share > gap / 2 ? share - gap / 2 : gap / 2 - share;
+		if (best == NULL || diff < best_diff) {
+			best = qmap;
+			best_diff = diff;
+		}
+	}
+	if (best == NULL) {
+		if (balance_reta(hot, cold, gap, load))
+			cooldown = BALANCE_COOLDOWN;
+		imbalance_periods = 0;
+		return;
+	}
+
+	// worker_rxq_assign() modifies the queue arrays
+	port_id = best->port_id;
+	rxq_id = best->queue_id;
+	src = hot->cpu_id;
+	dst = cold->cpu_id;
+
+	LOG(NOTICE,
+	    "moving port %u rxq %u from CPU %u (%.0f%% busy) to CPU %u (%.0f%% busy)",
+	    port_id,
+	    rxq_id,
+	    src,
+	    load * 100,
+	    dst,
+	    loads[dst].load * 100);
+
+	if (worker_rxq_assign(port_id, rxq_id, dst) < 0)
+		LOG(ERR, "worker_rxq_assign: %s", strerror(errno));
+
+	imbalance_periods = 0;
+	cooldown = BALANCE_COOLDOWN;
+}
+
+static void balance_init(struct event_base *ev_base) {
+	struct timeval tv = {.tv_sec = BALANCE_PERIOD_SEC};
+
+	if (gr_args()->autoscale_cpus != NULL) {
+		if (cpu_list_parse(gr_args()->autoscale_cpus, &scale_cpus) < 0)
+			ABORT("invalid autoscale CPU list: %s", gr_args()->autoscale_cpus);
+		scale_enabled = true;
+	}
+
+	if (!gr_args()->balance_rxqs && !scale_enabled)
+		return;
+
+	balance_ev = gr_event_new(ev_base, -1, EV_PERSIST | EV_FINALIZE, balance_cb, NULL);
+	if (balance_ev == NULL || event_add(balance_ev, &tv) < 0)
+		ABORT("failed to add rxq balance event");
+}
+
+static void balance_fini(struct event_base *) {
+	if (balance_ev != NULL) {
+		gr_event_free(balance_ev);
+		balance_ev = NULL;
+	}
+}
+
+static struct gr_module balance_module = {
+	.name = "rxq balance",
+	.init = balance_init,
+	.fini = balance_fini,
+	.fini_prio = -2000,
+};
+
+RTE_INIT(balance_constructor) {
+	gr_register_module(&balance_module);
+}
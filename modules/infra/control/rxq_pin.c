@@ -0,0 +1,271 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_infra.h>
+#include <gr_log.h>
+#include <gr_port.h>
+#include <gr_stb_ds.h>
+
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_flow.h>
+#include <rte_ip6.h>
+
+#include <errno.h>
+#include <string.h>
+
+// Control traffic rules use the default priority (0) and must win over the
+// pins, e.g. for ARP requests received on a pinned VLAN.
+#define PIN_FLOW_PRIORITY 1
+
+static bool pin_rxqs_valid(const struct iface_info_port *p, const struct gr_port_pin *pin) {
+	return pin->n_rxqs > 0 && pin->first_rxq + pin->n_rxqs <= p->n_rxq;
+}
+
+static struct rte_flow *pin_flow_create(const struct iface_info_port *p, struct port_pin *pin) {
+	struct rte_flow_attr attr = {.ingress = 1, .priority = PIN_FLOW_PRIORITY};
+	struct rte_flow_item pattern[] = {
+		{.type = RTE_FLOW_ITEM_TYPE_ETH},
+		{.type = RTE_FLOW_ITEM_TYPE_VOID},
+		{.type = RTE_FLOW_ITEM_TYPE_END},
+	};
+	struct rte_flow_action actions[] = {
+		{.type = RTE_FLOW_ACTION_TYPE_VOID},
+		{.type = RTE_FLOW_ACTION_TYPE_END},
+	};
+	struct rte_flow_item_ipv6 ip6_spec, ip6_mask;
+	struct rte_flow_item_ipv4 ip4_spec, ip4_mask;
+	struct rte_flow_item_vlan vlan_spec, vlan_mask;
+	uint16_t queues[GR_PORT_RETA_SIZE];
+	struct rte_flow_action_queue queue;
+	struct rte_flow_action_rss rss;
+	struct rte_flow_error err;
+	struct rte_flow *flow;
+
+	switch (pin->pin.type) {
+	case GR_PORT_PIN_VLAN:
+		memset(&vlan_spec, 0, sizeof(vlan_spec));
+		memset(&vlan_mask, 0, sizeof(vlan_mask));
+		vlan_spec.hdr.vlan_tci = rte_cpu_to_be_16(pin->pin.vlan_id);
+		vlan_mask.hdr.vlan_tci = RTE_BE16(0x0fff);
+		pattern[1].type = RTE_FLOW_ITEM_TYPE_VLAN;
+		pattern[1].spec = &vlan_spec;
+		pattern[1].mask = &vlan_mask;
+		break;
+	case GR_PORT_PIN_IP4:
+		memset(&ip4_spec, 0, sizeof(ip4_spec));
+		memset(&ip4_mask, 0, sizeof(ip4_mask));
+		ip4_spec.hdr.dst_addr = pin->pin.ip4.ip;
+		ip4_mask.hdr.dst_addr = rte_cpu_to_be_32(
+			(uint32_t)(UINT64_MAX << (32 - pin->pin.ip4.prefixlen))
+		);
+		pattern[1].type = RTE_FLOW_ITEM_TYPE_IPV4;
+		pattern[1].spec = &ip4_spec;
+		pattern[1].mask = &ip4_mask;
+		break;
+	case GR_PORT_PIN_IP6:
+		memset(&ip6_spec, 0, sizeof(ip6_spec));
+		memset(&ip6_mask, 0, sizeof(ip6_mask));
+		ip6_spec.hdr.dst_addr = pin->pin.ip6.ip;
+		memset(&ip6_mask.hdr.dst_addr, 0xff, sizeof(ip6_mask.hdr.dst_addr));
+		rte_ipv6_addr_mask(&ip6_mask.hdr.dst_addr, pin->pin.ip6.prefixlen);
+		pattern[1].type = RTE_FLOW_ITEM_TYPE_IPV6;
+		pattern[1].spec = &ip6_spec;
+		pattern[1].mask = &ip6_mask;
+		break;
+	default:
+		return errno_set_null(EAFNOSUPPORT);
+	}
+
+	if (pin->pin.n_rxqs == 1) {
+		queue.index = pin->pin.first_rxq;
+		actions[0].type = RTE_FLOW_ACTION_TYPE_QUEUE;
+		actions[0].conf = &queue;
+	} else {
+		for (uint16_t i = 0; i < pin->pin.n_rxqs; i++)
+			queues[i] = pin->pin.first_rxq + i;
+		// hash types and key left to zero for the driver defaults
+		memset(&rss, 0, sizeof(rss));
+		rss.queue_num = pin->pin.n_rxqs;
+		rss.queue = queues;
+		actions[0].type = RTE_FLOW_ACTION_TYPE_RSS;
+		actions[0].conf = &rss;
+	}
+
+	memset(&err, 0, sizeof(err));
+	flow = rte_flow_create(p->port_id, &attr, pattern, actions, &err);
+	if (flow == NULL) {
+		// not all drivers support rule priorities
+		attr.priority = 0;
+		memset(&err, 0, sizeof(err));
+		flow = rte_flow_create(p->port_id, &attr, pattern, actions, &err);
+	}
+	if (flow == NULL)
+		LOG(NOTICE,
+		    "port %u: rte_flow_create: %s",
+		    p->port_id,
+		    err.message ? err.message : rte_strerror(rte_errno));
+
+	return flow;
+}
+
+static void pin_flow_destroy(const struct iface_info_port *p, struct port_pin *pin) {
+	struct rte_flow_error err;
+
+	if (pin->flow == NULL)
+		return;
+	if (rte_flow_destroy(p->port_id, pin->flow, &err) < 0)
+		LOG(NOTICE, "port %u: rte_flow_destroy: %s", p->port_id, err.message);
+	pin->flow = NULL;
+	pin->pin.installed = 0;
+}
+
+static void pin_flow_install(const struct iface_info_port *p, struct port_pin *pin) {
+	if (!pin_rxqs_valid(p, &pin->pin)) {
+		LOG(NOTICE,
+		    "port %u: pinned rxqs %u-%u do not exist, skipped",
+		    p->port_id,
+		    pin->pin.first_rxq,
+		    pin->pin.first_rxq + pin->pin.n_rxqs - 1);
+		return;
+	}
+	pin->flow = pin_flow_create(p, pin);
+	pin->pin.installed = pin->flow != NULL;
+}
+
+void port_pin_flows_destroy(struct iface_info_port *p) {
+	struct port_pin *pin;
+
+	arrforeach (pin, p->pins)
+		pin_flow_destroy(p, pin);
+}
+
+int port_pin_flows_apply(struct iface_info_port *p) {
+	struct port_pin *pin;
+
+	port_pin_flows_destroy(p);
+	arrforeach (pin, p->pins)
+		pin_flow_install(p, pin);
+
+	if (arrlen(p->pins) > 0)
+		LOG(INFO, "port %u: %zu tenant rxq pins", p->port_id, (size_t)arrlen(p->pins));
+
+	return 0;
+}
+
+void port_pin_fini(struct iface_info_port *p) {
+	port_pin_flows_destroy(p);
+	arrfree(p->pins);
+	p->pins = NULL;
+}
+
+uint16_t port_rxq_tenant(const struct iface_info_port *p, uint16_t rxq) {
+	const struct port_pin *pin;
+
+	arrforeach (pin, p->pins) {
+		if (!pin_rxqs_valid(p, &pin->pin))
+			continue;
+		if (rxq >= pin->pin.first_rxq && rxq < pin->pin.first_rxq + pin->pin.n_rxqs)
+			return pin->pin.first_rxq + 1;
+	}
+
+	return 0;
+}
+
+static bool pin_match_equal(const struct gr_port_pin *a, const struct gr_port_pin *b) {
+	if (a->type != b->type)
+		return false;
+
+	switch (a->type) {
+	case GR_PORT_PIN_VLAN:
+		return a->vlan_id == b->vlan_id;
+	case GR_PORT_PIN_IP4:
+		return a->ip4.ip == b->ip4.ip && a->ip4.prefixlen == b->ip4.prefixlen;
+	case GR_PORT_PIN_IP6:
+		return rte_ipv6_addr_eq(&a->ip6.ip, &b->ip6.ip)
+			&& a->ip6.prefixlen == b->ip6.prefixlen;
+	}
+
+	return false;
+}
+
+static int pin_reta_update(struct iface_info_port *p) {
+	struct rte_eth_dev_info info;
+	int ret;
+
+	// applied by port_configure() otherwise
+	if (!p->configured)
+		return 0;
+	if ((ret = rte_eth_dev_info_get(p->port_id, &info)) < 0)
+		return errno_set(-ret);
+	if (port_reta_apply(p, &info) < 0)
+		LOG(NOTICE, "port %u: rss reta update: %s", p->port_id, strerror(errno));
+
+	return 0;
+}
+
+int port_pin_add(struct iface_info_port *p, const struct gr_port_pin *pin) {
+	struct port_pin new = {.pin = *pin};
+	const struct port_pin *e;
+	unsigned n_pinned = 0;
+	uint16_t first, last;
+
+	switch (pin->type) {
+	case GR_PORT_PIN_VLAN:
+		if (pin->vlan_id == 0 || pin->vlan_id > 4095)
+			return errno_set(EINVAL);
+		break;
+	case GR_PORT_PIN_IP4:
+		if (pin->ip4.prefixlen > 32)
+			return errno_set(EINVAL);
+		break;
+	case GR_PORT_PIN_IP6:
+		if (pin->ip6.prefixlen > RTE_IPV6_MAX_DEPTH)
+			return errno_set(EINVAL);
+		break;
+	default:
+		return errno_set(EINVAL);
+	}
+	if (!pin_rxqs_valid(p, pin))
+		return errno_set(ERANGE);
+	if (arrlen(p->pins) >= GR_PORT_PINS_MAX)
+		return errno_set(ENOSPC);
+
+	first = pin->first_rxq;
+	last = pin->first_rxq + pin->n_rxqs - 1;
+	arrforeach (e, p->pins) {
+		if (pin_match_equal(&e->pin, pin))
+			return errno_set(EEXIST);
+		if (e->pin.first_rxq == first && e->pin.n_rxqs == pin->n_rxqs)
+			continue;
+		// ranges of different tenants must not overlap
+		if (first < e->pin.first_rxq + e->pin.n_rxqs && e->pin.first_rxq <= last)
+			return errno_set(EBUSY);
+	}
+	for (uint16_t q = 0; q < p->n_rxq; q++) {
+		if ((q >= first && q <= last) || port_rxq_tenant(p, q) != 0)
+			n_pinned++;
+	}
+	// keep at least one rxq for the traffic which does not match any pin
+	if (n_pinned >= p->n_rxq)
+		return errno_set(ENOSPC);
+
+	new.pin.installed = 0;
+	if (p->configured)
+		pin_flow_install(p, &new);
+	arrpush(p->pins, new);
+
+	return pin_reta_update(p);
+}
+
+int port_pin_del(struct iface_info_port *p, const struct gr_port_pin *pin) {
+	for (int i = 0; i < arrlen(p->pins); i++) {
+		if (pin_match_equal(&p->pins[i].pin, pin)) {
+			pin_flow_destroy(p, &p->pins[i]);
+			arrdel(p->pins, i);
+			return pin_reta_update(p);
+		}
+	}
+
+	return errno_set(ENOENT);
+}
@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr.h>
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_log.h>
+#include <gr_port.h>
+#include <gr_stats_shm.h>
+#include <gr_worker.h>
+
+#include <event2/event.h>
+#include <rte_common.h>
+#include <rte_ethdev.h>
+#include <rte_graph.h>
+#include <rte_lcore.h>
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+static struct gr_stats_shm *shm;
+static struct event *shm_ev;
+// collected outside of the write section to keep it short
+static struct gr_stats_shm_port ports[RTE_MAX_ETHPORTS];
+
+static struct gr_stats_shm_worker *shm_worker(uint32_t i) {
+	return (struct gr_stats_shm_worker *)gr_stats_shm_worker(shm, i);
+}
+
+static void stats_shm_update(evutil_socket_t, short /*what*/, void *) {
+	struct gr_stats_shm_port *ports_dst;
+	struct iface *iface = NULL;
+	struct worker *worker;
+	struct timespec ts;
+	uint32_t n_ports;
+	uint32_t n;
+
+	n_ports = 0;
+	while ((iface = iface_next(GR_IFACE_TYPE_PORT, iface)) != NULL) {
+		const struct iface_info_port *port = (const struct iface_info_port *)iface->info;
+		struct gr_stats_shm_port *p;
+		struct rte_eth_stats st;
+
+		if (n_ports == shm->max_ports)
+			break;
+		if (rte_eth_stats_get(port->port_id, &st) < 0)
+			continue;
+
+		p = &ports[n_ports++];
+		p->iface_id = iface->id;
+		p->port_id = port->port_id;
+		memccpy(p->name, iface->name, 0, sizeof(p->name));
+		p->rx_packets = st.ipackets;
+		p->rx_bytes = st.ibytes;
+		p->rx_missed = st.imissed;
+		p->rx_errors = st.ierrors;
+		p->rx_nombuf = st.rx_nombuf;
+		p->tx_packets = st.opackets;
+		p->tx_bytes = st.obytes;
+		p->tx_errors = st.oerrors;
+	}
+
+	// begin write section, readers will retry until it is over
+	atomic_fetch_add_explicit(&shm->seq, 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	n = 0;
+	STAILQ_FOREACH (worker, &workers, next) {
+		const struct worker_stats *w_stats = atomic_load(&worker->stats);
+		struct gr_stats_shm_worker *w;
+
+		if (n == shm->max_workers)
+			break;
+
+		w = shm_worker(n++);
+		memset(w, 0, shm->worker_size);
+		w->cpu_id = worker->cpu_id;
+		w->power = atomic_load(&worker->active_power);
+		if (w_stats == NULL)
+			continue;
+
+		w->total_cycles = w_stats->total_cycles;
+		w->busy_cycles = w_stats->busy_cycles;
+		w->sleep_cycles = w_stats->sleep_cycles;
+		w->n_sleeps = w_stats->n_sleeps;
+		for (unsigned i = 0; i < w_stats->n_stats; i++) {
+			const struct node_stats *s = &w_stats->stats[i];
+			if (s->node_id >= shm->max_nodes)
+				continue;
+			w->nodes[s->node_id].objs = s->objs;
+			w->nodes[s->node_id].calls = s->calls;
+			w->nodes[s->node_id].cycles = s->cycles;
+		}
+	}
+	shm->n_workers = n;
+
+	ports_dst = (struct gr_stats_shm_port *)gr_stats_shm_port(shm, 0);
+	memcpy(ports_dst, ports, n_ports * sizeof(*ports));
+	shm->n_ports = n_ports;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	shm->timestamp = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+
+	atomic_fetch_add_explicit(&shm->seq, 1, memory_order_release);
+}
+
+static void stats_shm_init(struct event_base *ev_base) {
+	struct timeval tv = {
+		.tv_sec = GR_STATS_SHM_PERIOD_MS / 1000,
+		.tv_usec = (GR_STATS_SHM_PERIOD_MS % 1000) * 1000,
+	};
+	const char *name = gr_args()->stats_shm_name;
+	uint32_t max_nodes, names_off, workers_off, worker_size, ports_off;
+	size_t size;
+	int fd;
+
+	max_nodes = rte_node_max_count();
+	worker_size = sizeof(struct gr_stats_shm_worker)
+		+ max_nodes * sizeof(struct gr_stats_shm_node);
+	worker_size = RTE_ALIGN_CEIL(worker_size, alignof(struct gr_stats_shm_worker));
+	names_off = RTE_ALIGN_CEIL(sizeof(*shm), 8);
+	workers_off = RTE_ALIGN_CEIL(names_off + max_nodes * GR_STATS_SHM_NODE_NAME_SIZE, 8);
+	ports_off = workers_off + RTE_MAX_LCORE * worker_size;
+	size = ports_off + RTE_MAX_ETHPORTS * sizeof(struct gr_stats_shm_port);
+
+	// Never remove an existing segment: it may belong to another running instance.
+	if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644)) < 0) {
+		LOG(ERR, "shm_open(%s): %s, stats export disabled", name, strerror(errno));
+		return;
+	}
+	if (ftruncate(fd, size) < 0) {
+		LOG(ERR, "ftruncate(%s): %s, stats export disabled", name, strerror(errno));
+		goto err_unlink;
+	}
+	shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED) {
+		LOG(ERR, "mmap(%s): %s, stats export disabled", name, strerror(errno));
+		shm = NULL;
+		goto err_unlink;
+	}
+	close(fd);
+
+	shm->size = size;
+	shm->max_nodes = max_nodes;
+	shm->max_workers = RTE_MAX_LCORE;
+	shm->max_ports = RTE_MAX_ETHPORTS;
+	shm->node_names_offset = names_off;
+	shm->workers_offset = workers_off;
+	shm->worker_size = worker_size;
+	shm->ports_offset = ports_off;
+	for (rte_node_t node = 0; node < max_nodes; node++) {
+		const char *node_name = rte_node_id_to_name(node);
+		char *dst = (char *)gr_stats_shm_node_name(shm, node);
+		if (node_name != NULL)
+			memccpy(dst, node_name, 0, GR_STATS_SHM_NODE_NAME_SIZE - 1);
+	}
+	shm->version = GR_STATS_SHM_VERSION;
+	// readers check the magic last
+	atomic_thread_fence(memory_order_release);
+	shm->magic = GR_STATS_SHM_MAGIC;
+
+	shm_ev = gr_event_new(ev_base, -1, EV_PERSIST | EV_FINALIZE, stats_shm_update, NULL);
+	if (shm_ev == NULL || event_add(shm_ev, &tv) < 0) {
+		LOG(ERR, "failed to add stats shm event, stats export disabled");
+		if (shm_ev != NULL) {
+			gr_event_free(shm_ev);
+			shm_ev = NULL;
+		}
+		munmap(shm, size);
+		shm = NULL;
+		shm_unlink(name);
+		return;
+	}
+
+	LOG(INFO, "publishing stats in shared memory %s", name);
+	return;
+
+err_unlink:
+	close(fd);
+	shm_unlink(name);
+}
+
+static void stats_shm_fini(struct event_base *) {
+	if (shm_ev != NULL) {
+		gr_event_free(shm_ev);
+		shm_ev = NULL;
+	}
+	if (shm != NULL) {
+		munmap(shm, shm->size);
+		shm_unlink(gr_args()->stats_shm_name);
+		shm = NULL;
+	}
+}
+
+static struct gr_module stats_shm_module = {
+	.name = "stats shm",
+	.init = stats_shm_init,
+	.fini = stats_shm_fini,
+	// stop publishing before workers are destroyed
+	.fini_prio = -2000,
+};
+
+RTE_INIT(stats_shm_constructor) {
+	gr_register_module(&stats_shm_module);
+}
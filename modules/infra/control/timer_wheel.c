@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_control.h>
+#include <gr_errno.h>
+#include <gr_timer_wheel.h>
+
+#include <event2/event.h>
+#include <rte_spinlock.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/queue.h>
+
+// Must be a power of 2. Slightly more than one hour with a one second tick.
+// Entries with longer delays are visited once per wheel revolution.
+#define TIMER_WHEEL_SLOTS 4096
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+
+LIST_HEAD(timer_wheel_list, timer_wheel_entry);
+
+struct timer_wheel {
+	rte_spinlock_t lock;
+	uint64_t tick;
+	struct event *ev;
+	timer_wheel_cb_t cb;
+	// entries removed from their slot and waiting for their callback
+	struct timer_wheel_list expired;
+	struct timer_wheel_list slots[TIMER_WHEEL_SLOTS];
+};
+
+static void timer_wheel_tick(evutil_socket_t, short /*what*/, void *priv) {
+	struct timer_wheel *w = priv;
+	struct timer_wheel_entry *e, *tmp;
+	struct timer_wheel_list *slot;
+
+	rte_spinlock_lock(&w->lock);
+	w->tick++;
+	slot = &w->slots[w->tick & TIMER_WHEEL_MASK];
+	e = LIST_FIRST(slot);
+	while (e != NULL) {
+		tmp = LIST_NEXT(e, next);
+		if (e->expire <= w->tick) {
+			LIST_REMOVE(e, next);
+			LIST_INSERT_HEAD(&w->expired, e, next);
+		}
+		e = tmp;
+	}
+	rte_spinlock_unlock(&w->lock);
+
+	for (;;) {
+		// Entries may be re-armed or cancelled concurrently, only pop them
+		// from the expired list with the lock held.
+		rte_spinlock_lock(&w->lock);
+		e = LIST_FIRST(&w->expired);
+		if (e != NULL) {
+			LIST_REMOVE(e, next);
+			e->armed = false;
+		}
+		rte_spinlock_unlock(&w->lock);
+		if (e == NULL)
+			break;
+		w->cb(e);
+	}
+}
+
+struct timer_wheel *timer_wheel_create(struct event_base *base, timer_wheel_cb_t cb) {
+	struct timeval tv = {.tv_sec = 1};
+	struct timer_wheel *w;
+
+	if ((w = calloc(1, sizeof(*w))) == NULL)
+		return errno_set_null(ENOMEM);
+
+	rte_spinlock_init(&w->lock);
+	w->cb = cb;
+	LIST_INIT(&w->expired);
+	for (unsigned i = 0; i < TIMER_WHEEL_SLOTS; i++)
+		LIST_INIT(&w->slots[i]);
+
+	w->ev = gr_event_new(base, -1, EV_PERSIST | EV_FINALIZE, timer_wheel_tick, w);
+	if (w->ev == NULL) {
+		free(w);
+		return errno_set_null(ENOMEM);
+	}
+	if (event_add(w->ev, &tv) < 0) {
+		gr_event_free(w->ev);
+		free(w);
+		return errno_set_null(EINVAL);
+	}
+
+	return w;
+}
+
+void timer_wheel_destroy(struct timer_wheel *w) {
+	if (w == NULL)
+		return;
+	gr_event_free(w->ev);
+	free(w);
+}
+
+void timer_wheel_arm(struct timer_wheel *w, struct timer_wheel_entry *e, uint32_t delay) {
+	rte_spinlock_lock(&w->lock);
+	if (e->armed)
+		LIST_REMOVE(e, next);
+	e->expire = w->tick + (delay ?: 1);
+	e->armed = true;
+	LIST_INSERT_HEAD(&w->slots[e->expire & TIMER_WHEEL_MASK], e, next);
+	rte_spinlock_unlock(&w->lock);
+}
+
+void timer_wheel_cancel(struct timer_wheel *w, struct timer_wheel_entry *e) {
+	rte_spinlock_lock(&w->lock);
+	if (e->armed) {
+		LIST_REMOVE(e, next);
+		e->armed = false;
+	}
+	rte_spinlock_unlock(&w->lock);
+}
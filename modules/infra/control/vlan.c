@@ -7,29 +7,69 @@
 #include <gr_iface.h>
 #include <gr_infra.h>
 #include <gr_log.h>
+#include <gr_macro.h>
 #include <gr_port.h>
+#include <gr_rcu.h>
 
 #include <event2/event.h>
 #include <rte_ethdev.h>
 #include <rte_ether.h>
-#include <rte_hash.h>
+#include <rte_malloc.h>
 
 #include <string.h>
 
-struct vlan_key {
-	uint16_t parent_id;
-	uint16_t vlan_id;
+// Direct-indexed VLAN demux table. Allocated on first VLAN sub-interface
+// creation and released after the last one is destroyed.
+struct vlan_table {
+	unsigned count;
+	struct iface *ifaces[RTE_ETHER_MAX_VLAN_ID + 1];
 };
 
-static struct rte_hash *vlan_hash;
+// One table per parent interface, indexed by parent iface ID.
+static struct vlan_table *vlan_tables[MAX_IFACES];
 
 struct iface *vlan_get_iface(uint16_t parent_id, uint16_t vlan_id) {
-	void *data;
+	const struct vlan_table *table;
 
-	if (rte_hash_lookup_data(vlan_hash, &(struct vlan_key) {parent_id, vlan_id}, &data) < 0)
+	table = __atomic_load_n(&vlan_tables[parent_id], __ATOMIC_ACQUIRE);
+	if (table == NULL)
 		return NULL;
 
-	return data;
+	return __atomic_load_n(&table->ifaces[vlan_id & RTE_ETHER_MAX_VLAN_ID], __ATOMIC_ACQUIRE);
+}
+
+static bool vlan_table_used(uint16_t parent_id, uint16_t vlan_id) {
+	const struct vlan_table *table = vlan_tables[parent_id];
+	return table != NULL && table->ifaces[vlan_id] != NULL;
+}
+
+static int vlan_table_add(uint16_t parent_id, uint16_t vlan_id, struct iface *iface) {
+	struct vlan_table *table = vlan_tables[parent_id];
+
+	if (table == NULL) {
+		table = rte_zmalloc(__func__, sizeof(*table), RTE_CACHE_LINE_SIZE);
+		if (table == NULL)
+			return errno_set(ENOMEM);
+		__atomic_store_n(&vlan_tables[parent_id], table, __ATOMIC_RELEASE);
+	}
+	__atomic_store_n(&table->ifaces[vlan_id], iface, __ATOMIC_RELEASE);
+	table->count++;
+
+	return 0;
+}
+
+static void vlan_table_del(uint16_t parent_id, uint16_t vlan_id) {
+	struct vlan_table *table = vlan_tables[parent_id];
+
+	if (table == NULL || table->ifaces[vlan_id] == NULL)
+		return;
+
+	// the interface itself is freed after an RCU grace period
+	__atomic_store_n(&table->ifaces[vlan_id], NULL, __ATOMIC_RELEASE);
+	if (--table->count == 0) {
+		__atomic_store_n(&vlan_tables[parent_id], NULL, __ATOMIC_RELEASE);
+		gr_rcu_defer_free(rte_free, table);
+	}
 }
 
 static int get_parent_port_id(uint16_t parent_id, uint16_t *port_id) {
@@ -74,21 +114,22 @@ static int iface_vlan_reconfig(
 	parent_type = iface_type_get(next_parent->type_id);
 
 	if (set_attrs & (GR_VLAN_SET_PARENT | GR_VLAN_SET_VLAN)) {
-		struct vlan_key next_key = {next->parent_id, next->vlan_id};
 		uint16_t next_port_id = RTE_MAX_ETHPORTS;
 
+		if (next->vlan_id == 0 || next->vlan_id > RTE_ETHER_MAX_VLAN_ID)
+			return errno_set(EINVAL);
+
 		if (get_parent_port_id(next->parent_id, &next_port_id) < 0)
 			return -errno;
 
-		if (rte_hash_lookup(vlan_hash, &next_key) >= 0)
+		if (vlan_table_used(next->parent_id, next->vlan_id))
 			return errno_set(EADDRINUSE);
 
 		if (reconfig) {
 			// reconfig, *not initial config*
-			struct vlan_key cur_key = {cur->parent_id, cur->vlan_id};
 			uint16_t cur_port_id = RTE_MAX_ETHPORTS;
 
-			rte_hash_del_key(vlan_hash, &cur_key);
+			vlan_table_del(cur->parent_id, cur->vlan_id);
 			iface_del_subinterface(cur_parent, iface);
 
 			if (get_parent_port_id(cur->parent_id, &cur_port_id) < 0)
@@ -105,11 +146,12 @@ static int iface_vlan_reconfig(
 				return errno_set(-ret);
 		}
 		cur->parent_id = next->parent_id;
+		cur->parent = next_parent;
 		cur->vlan_id = next->vlan_id;
 		iface_add_subinterface(next_parent, iface);
 
-		if ((ret = rte_hash_add_key_data(vlan_hash, &next_key, iface)) < 0)
-			return errno_log(-ret, "rte_hash_add_key_data");
+		if (vlan_table_add(next->parent_id, next->vlan_id, iface) < 0)
+			return -errno;
 	}
 
 	if (set_attrs & GR_VLAN_SET_MAC) {
@@ -145,7 +187,8 @@ static int iface_vlan_fini(struct iface *iface) {
 
 	parent_type = iface_type_get(parent->type_id);
 
-	rte_hash_del_key(vlan_hash, &(struct vlan_key) {vlan->parent_id, vlan->vlan_id});
+	if (vlan_get_iface(vlan->parent_id, vlan->vlan_id) == iface)
+		vlan_table_del(vlan->parent_id, vlan->vlan_id);
 
 	if ((ret = rte_eth_dev_vlan_filter(port_id, vlan->vlan_id, false)) < 0)
 		errno_log(-ret, "rte_eth_dev_vlan_filter disable");
@@ -221,28 +264,15 @@ static struct iface_type iface_type_vlan = {
 	.to_api = vlan_to_api,
 };
 
-static void vlan_init(struct event_base *) {
-	struct rte_hash_parameters params = {
-		.name = "vlan",
-		.entries = MAX_IFACES,
-		.key_len = sizeof(struct vlan_key),
-		.socket_id = SOCKET_ID_ANY,
-		.extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF
-			| RTE_HASH_EXTRA_FLAGS_TRANS_MEM_SUPPORT,
-	};
-	vlan_hash = rte_hash_create(&params);
-	if (vlan_hash == NULL)
-		ABORT("rte_hash_create(vlan)");
-}
-
 static void vlan_fini(struct event_base *) {
-	rte_hash_free(vlan_hash);
-	vlan_hash = NULL;
+	for (unsigned i = 0; i < ARRAY_DIM(vlan_tables); i++) {
+		rte_free(vlan_tables[i]);
+		vlan_tables[i] = NULL;
+	}
 }
 
 static struct gr_module vlan_module = {
 	.name = "vlan",
-	.init = vlan_init,
 	.fini = vlan_fini,
 	.fini_prio = 1000,
 };
@@ -4,6 +4,7 @@
 #include "graph_priv.h"
 #include "worker_priv.h"
 
+#include <gr.h>
 #include <gr_control.h>
 #include <gr_datapath.h>
 #include <gr_infra.h>
@@ -24,15 +25,98 @@
 #include <rte_lcore.h>
 #include <rte_malloc.h>
 
+#include <dirent.h>
 #include <errno.h>
 #include <pthread.h>
 #include <sched.h>
 #include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
 #include <sys/queue.h>
 #include <unistd.h>
 
 struct workers workers = STAILQ_HEAD_INITIALIZER(workers);
 
+// Port plugs and queue assignments made during a configuration batch are
+// applied to the worker graphs once, when the batch ends. Port unplugs are
+// always applied immediately, the port queues are reconfigured afterwards.
+static unsigned batch_depth;
+static bool reload_pending;
+
+static void worker_free(struct worker *worker) {
+	if (worker->wakeup_fd >= 0)
+		close(worker->wakeup_fd);
+	rte_free(worker);
+}
+
+// Read a CPU list from sysfs, empty if unknown.
+static void cpu_sysfs_list(const char *path, cpu_set_t *cpus) {
+	char buf[1024];
+	FILE *f;
+
+	CPU_ZERO(cpus);
+	if ((f = fopen(path, "r")) == NULL)
+		return;
+	if (fgets(buf, sizeof(buf), f) != NULL) {
+		buf[strcspn(buf, "\n")] = '\0';
+		if (cpu_list_parse(buf, cpus) < 0)
+			CPU_ZERO(cpus);
+	}
+	fclose(f);
+}
+
+// Warn about what can interrupt a datapath worker: the kernel scheduler and
+// timer ticks when its CPU is not isolated, and the other threads of the
+// process which are allowed to run on the same CPU.
+static void worker_isolation_check(const struct worker *worker) {
+	char names[256] = "", path[64], comm[32];
+	unsigned count = 0;
+	struct dirent *e;
+	size_t n = 0;
+	cpu_set_t set;
+	pid_t tid;
+	FILE *f;
+	DIR *d;
+
+	cpu_sysfs_list("/sys/devices/system/cpu/isolated", &set);
+	if (!CPU_ISSET(worker->cpu_id, &set))
+		LOG(NOTICE, "[CPU %u] not isolated from the scheduler (isolcpus)", worker->cpu_id);
+	cpu_sysfs_list("/sys/devices/system/cpu/nohz_full", &set);
+	if (!CPU_ISSET(worker->cpu_id, &set))
+		LOG(NOTICE, "[CPU %u] timer ticks not disabled (nohz_full)", worker->cpu_id);
+
+	if ((d = opendir("/proc/self/task")) == NULL)
+		return;
+	while ((e = readdir(d)) != NULL) {
+		tid = atoi(e->d_name);
+		if (tid <= 0 || tid == worker->tid)
+			continue;
+		if (sched_getaffinity(tid, sizeof(set), &set) < 0)
+			continue;
+		if (!CPU_ISSET(worker->cpu_id, &set))
+			continue;
+		count++;
+		snprintf(path, sizeof(path), "/proc/self/task/%d/comm", tid);
+		if ((f = fopen(path, "r")) == NULL)
+			continue;
+		if (fgets(comm, sizeof(comm), f) != NULL && n < sizeof(names)) {
+			comm[strcspn(comm, "\n")] = '\0';
+			n += snprintf(names + n, sizeof(names) - n, "%s%s", n > 0 ? "," : "", comm);
+		}
+		fclose(f);
+	}
+	closedir(d);
+
+	if (count > 0)
+		LOG(WARNING,
+		    "[CPU %u] shared with %u other threads (%s), see --housekeeping",
+		    worker->cpu_id,
+		    count,
+		    names);
+}
+
 int worker_create(unsigned cpu_id) {
 	struct worker *worker = rte_zmalloc(__func__, sizeof(*worker), 0);
 	pthread_attr_t attr;
@@ -44,16 +128,32 @@ int worker_create(unsigned cpu_id) {
 
 	worker->cpu_id = cpu_id;
 	worker->lcore_id = LCORE_ID_ANY;
+	worker->stats_interval = gr_args()->stats_interval;
+	// instrumentation is enabled for all workers or none
+	if (!STAILQ_EMPTY(&workers)) {
+		const struct worker *first = STAILQ_FIRST(&workers);
+		worker->stats_hist = atomic_load(&first->stats_hist);
+		worker->stall_threshold_us = atomic_load(&first->stall_threshold_us);
+	}
+	worker->wakeup_fd = -1;
+	if (gr_args()->rx_interrupts) {
+		worker->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (worker->wakeup_fd < 0) {
+			ret = errno;
+			rte_free(worker);
+			return errno_log(ret, "eventfd");
+		}
+	}
 
 	if (!!(ret = pthread_attr_init(&attr))) {
-		rte_free(worker);
+		worker_free(worker);
 		return errno_log(ret, "pthread_attr_init");
 	}
 
 	CPU_ZERO(&cpuset);
 	CPU_SET(cpu_id, &cpuset);
 	if (!!(ret = pthread_attr_setaffinity_np(&attr, sizeof(cpuset), &cpuset))) {
-		rte_free(worker);
+		worker_free(worker);
 		pthread_attr_destroy(&attr);
 		return errno_log(ret, "pthread_attr_setaffinity_np");
 	}
@@ -61,7 +161,7 @@ int worker_create(unsigned cpu_id) {
 	if (!!(ret = pthread_create(&worker->thread, &attr, gr_datapath_loop, worker))) {
 		pthread_cancel(worker->thread);
 		pthread_attr_destroy(&attr);
-		rte_free(worker);
+		worker_free(worker);
 		return errno_log(ret, "pthread_create");
 	}
 
@@ -73,6 +173,7 @@ int worker_create(unsigned cpu_id) {
 
 	pthread_attr_destroy(&attr);
 	LOG(INFO, "worker %u started", worker->cpu_id);
+	worker_isolation_check(worker);
 	return 0;
 }
 
@@ -85,16 +186,27 @@ int worker_destroy(unsigned cpu_id) {
 	STAILQ_REMOVE(&workers, worker, worker, next);
 
 	atomic_store_explicit(&worker->shutdown, true, memory_order_release);
+	worker_wakeup(worker);
 	pthread_join(worker->thread, NULL);
 	worker_graph_free(worker);
 	arrfree(worker->rxqs);
 	arrfree(worker->txqs);
-	rte_free(worker);
+	worker_free(worker);
 
 	LOG(INFO, "worker %d destroyed", cpu_id);
 	return 0;
 }
 
+void worker_wakeup(struct worker *worker) {
+	uint64_t val = 1;
+
+	if (worker->wakeup_fd < 0)
+		return;
+	// the counter may only overflow if the worker is not reading it
+	if (write(worker->wakeup_fd, &val, sizeof(val)) < 0 && errno != EAGAIN)
+		LOG(ERR, "[CPU %u] write(wakeup_fd): %s", worker->cpu_id, strerror(errno));
+}
+
 size_t worker_count(void) {
 	struct worker *worker;
 	size_t count = 0;
@@ -118,36 +230,175 @@ struct worker *worker_find(unsigned cpu_id) {
 int port_unplug(uint16_t port_id) {
 	struct queue_map *qmap;
 	struct worker *worker;
-	int changed = 0;
+	int changed = 0, n, ret;
 
 	STAILQ_FOREACH (worker, &workers, next) {
+		n = 0;
 		arrforeach (qmap, worker->rxqs) {
 			if (qmap->port_id == port_id) {
 				qmap->enabled = false;
-				changed++;
+				n++;
 			}
 		}
 		arrforeach (qmap, worker->txqs) {
 			if (qmap->port_id == port_id) {
 				qmap->enabled = false;
-				changed++;
+				n++;
 			}
 		}
+		if (n == 0)
+			continue;
+		// the queues of the other ports are left untouched
+		if ((ret = worker_graph_reload(worker)) < 0)
+			return ret;
+		changed += n;
 	}
 	if (changed == 0)
 		return 0;
 
 	LOG(INFO, "port %u unplugged", port_id);
 
-	return worker_graph_reload_all();
+	return 0;
+}
+
+int cpu_list_parse(const char *arg, cpu_set_t *cpus) {
+	unsigned long first, last;
+	const char *s = arg;
+	char *end;
+
+	CPU_ZERO(cpus);
+	while (*s != '\0') {
+		errno = 0;
+		first = last = strtoul(s, &end, 10);
+		if (errno != 0 || end == s)
+			return errno_set(EINVAL);
+		if (*end == '-') {
+			s = end + 1;
+			last = strtoul(s, &end, 10);
+			if (errno != 0 || end == s || last < first)
+				return errno_set(EINVAL);
+		}
+		if (last >= CPU_SETSIZE)
+			return errno_set(ERANGE);
+		for (unsigned long cpu = first; cpu <= last; cpu++)
+			CPU_SET(cpu, cpus);
+		if (*end == ',')
+			end++;
+		else if (*end != '\0')
+			return errno_set(EINVAL);
+		s = end;
+	}
+
+	return CPU_COUNT(cpus) > 0 ? 0 : errno_set(EINVAL);
+}
+
+// Read the first integer of a CPU topology sysfs attribute, -1 if unknown.
+static int cpu_sysfs_int(unsigned cpu_id, const char *attr) {
+	char path[128];
+	int val = -1;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/%s", cpu_id, attr);
+	if ((f = fopen(path, "r")) == NULL)
+		return -1;
+	if (fscanf(f, "%d", &val) != 1)
+		val = -1;
+	fclose(f);
+
+	return val;
 }
 
-int worker_ensure_default(int socket_id) {
+// The topology is read once per CPU, values are stored plus one so that zero
+// means not read yet.
+static int cpu_cores[CPU_SETSIZE];
+static int cpu_llcs[CPU_SETSIZE];
+
+// Lowest CPU ID of the physical core, shared by SMT siblings.
+static int cpu_core(unsigned cpu_id) {
+	int core;
+
+	if (cpu_id >= CPU_SETSIZE)
+		return (int)cpu_id;
+	if (cpu_cores[cpu_id] == 0) {
+		core = cpu_sysfs_int(cpu_id, "topology/thread_siblings_list");
+		cpu_cores[cpu_id] = (core < 0 ? (int)cpu_id : core) + 1;
+	}
+	return cpu_cores[cpu_id] - 1;
+}
+
+// ID of the last level cache, -1 if unknown.
+static int cpu_llc(unsigned cpu_id) {
+	int llc = -1;
+
+	if (cpu_id >= CPU_SETSIZE)
+		return -1;
+	if (cpu_llcs[cpu_id] == 0) {
+		if (cpu_sysfs_int(cpu_id, "cache/index3/level") == 3)
+			llc = cpu_sysfs_int(cpu_id, "cache/index3/id");
+		cpu_llcs[cpu_id] = llc + 1;
+	}
+	return cpu_llcs[cpu_id] - 1;
+}
+
+static bool cpu_near(unsigned cpu_id, const cpu_set_t *local) {
+	int llc;
+
+	if (local == NULL || CPU_COUNT(local) == 0)
+		return true;
+	if (CPU_ISSET(cpu_id, local))
+		return true;
+	// shares a last level cache with one of the local CPUs
+	if ((llc = cpu_llc(cpu_id)) < 0)
+		return false;
+	for (unsigned c = 0; c < CPU_SETSIZE; c++) {
+		if (CPU_ISSET(c, local) && cpu_llc(c) == llc)
+			return true;
+	}
+	return false;
+}
+
+// RX queues polled by a worker, counted twice, and by the workers running on
+// the SMT siblings of its CPU which share the same execution units.
+static unsigned worker_rxq_load(const struct worker *worker) {
+	int core = cpu_core(worker->cpu_id);
+	const struct worker *w;
+	unsigned load = 0;
+
+	STAILQ_FOREACH (w, &workers, next) {
+		if (w == worker)
+			load += 2 * arrlen(w->rxqs);
+		else if (cpu_core(w->cpu_id) == core)
+			load += arrlen(w->rxqs);
+	}
+
+	return load;
+}
+
+struct worker *worker_rxq_place(int socket_id, const cpu_set_t *local) {
+	struct worker *worker, *best = NULL;
+	unsigned cost, best_cost = 0;
+
+	STAILQ_FOREACH (worker, &workers, next) {
+		cost = 4 * worker_rxq_load(worker);
+		if (!cpu_near(worker->cpu_id, local))
+			cost += 1;
+		if (socket_id != SOCKET_ID_ANY && socket_id != numa_node_of_cpu(worker->cpu_id))
+			cost += 1 << 20;
+		if (best == NULL || cost < best_cost) {
+			best = worker;
+			best_cost = cost;
+		}
+	}
+
+	return best;
+}
+
+int worker_ensure_default(int socket_id, const cpu_set_t *local) {
 	unsigned main_lcore = rte_get_main_lcore();
+	unsigned cpu_id, cost, best_cost = 0;
+	int ret, best = -1;
 	struct worker *worker;
 	cpu_set_t affinity;
-	unsigned cpu_id;
-	int ret;
 
 	if (!!(ret = pthread_getaffinity_np(pthread_self(), sizeof(affinity), &affinity)))
 		return errno_log(ret, "pthread_getaffinity_np");
@@ -162,7 +413,8 @@ int worker_ensure_default(int socket_id) {
 	if (socket_id == SOCKET_ID_ANY)
 		socket_id = numa_preferred();
 
-	// try to spawn the default worker on the correct socket excluding the main lcore
+	// try to spawn the default worker on the correct socket excluding the main lcore,
+	// preferably close to the port and not on an SMT sibling of the main lcore
 	for (cpu_id = 0; cpu_id < CPU_SETSIZE; cpu_id++) {
 		if (cpu_id == main_lcore)
 			continue;
@@ -170,8 +422,16 @@ int worker_ensure_default(int socket_id) {
 			continue;
 		if (socket_id != numa_node_of_cpu(cpu_id))
 			continue;
-		return worker_create(cpu_id);
+		cost = cpu_near(cpu_id, local) ? 0 : 2;
+		if (cpu_core(cpu_id) == cpu_core(main_lcore))
+			cost += 1;
+		if (best < 0 || cost < best_cost) {
+			best = cpu_id;
+			best_cost = cost;
+		}
 	}
+	if (best >= 0)
+		return worker_create(best);
 
 	// no available cpu found, fallback on whatever is left, even on the wrong socket
 	for (cpu_id = 0; cpu_id < CPU_SETSIZE; cpu_id++) {
@@ -191,28 +451,37 @@ int worker_ensure_default(int socket_id) {
 int port_plug(uint16_t port_id) {
 	struct queue_map *qmap;
 	struct worker *worker;
-	int changed = 0;
+	int changed = 0, n, ret;
 
 	STAILQ_FOREACH (worker, &workers, next) {
+		n = 0;
 		arrforeach (qmap, worker->rxqs) {
 			if (qmap->port_id == port_id) {
 				qmap->enabled = true;
-				changed++;
+				n++;
 			}
 		}
 		arrforeach (qmap, worker->txqs) {
 			if (qmap->port_id == port_id) {
 				qmap->enabled = true;
-				changed++;
+				n++;
 			}
 		}
+		if (n == 0)
+			continue;
+		// the queues of the other ports are left untouched
+		if (batch_depth > 0)
+			reload_pending = true;
+		else if ((ret = worker_graph_reload(worker)) < 0)
+			return ret;
+		changed += n;
 	}
 	if (changed == 0)
 		return errno_set(ENODEV);
 
 	LOG(INFO, "port %u plugged", port_id);
 
-	return worker_graph_reload_all();
+	return 0;
 }
 
 int worker_rxq_assign(uint16_t port_id, uint16_t rxq_id, uint16_t cpu_id) {
@@ -278,23 +547,13 @@ move:
 	};
 	arrpush(dst_worker->rxqs, rx_qmap);
 
-	if (reconfig) {
-		// number of workers changed, adjust number of tx queues
-		struct gr_iface_info_port p = {0};
-		struct iface *iface = NULL;
-
-		while ((iface = iface_next(GR_IFACE_TYPE_PORT, iface)) != NULL) {
-			ret = iface_port_reconfig(
-				iface,
-				GR_PORT_SET_N_TXQS,
-				iface->flags,
-				iface->mtu,
-				iface->vrf_id,
-				&p
-			);
-			if (ret < 0)
-				return ret;
-		}
+	// number of workers changed, adjust number of tx queues
+	if (reconfig && (ret = port_reconfig_all()) < 0)
+		return ret;
+
+	if (batch_depth > 0) {
+		reload_pending = true;
+		return 0;
 	}
 
 	return worker_graph_reload_all();
@@ -329,10 +588,24 @@ static void worker_fini(struct event_base *) {
 	STAILQ_INIT(&workers);
 }
 
+static void worker_batch_begin(void) {
+	batch_depth++;
+}
+
+static void worker_batch_end(void) {
+	if (batch_depth == 0 || --batch_depth > 0 || !reload_pending)
+		return;
+	reload_pending = false;
+	if (worker_graph_reload_all() < 0)
+		LOG(ERR, "worker_graph_reload_all: %s", strerror(errno));
+}
+
 static struct gr_module worker_module = {
 	.name = "worker",
 	.init = worker_init,
 	.fini = worker_fini,
+	.batch_begin = worker_batch_begin,
+	.batch_end = worker_batch_end,
 	.fini_prio = -1000,
 };
 
@@ -6,6 +6,8 @@
 
 #include "gr_worker.h"
 
+#include <sched.h>
+
 int port_unplug(uint16_t port_id);
 int port_plug(uint16_t port_id);
 
@@ -13,6 +15,13 @@ size_t worker_count(void);
 int worker_create(unsigned cpu_id);
 struct worker *worker_find(unsigned cpu_id);
 int worker_destroy(unsigned cpu_id);
-int worker_ensure_default(int socket_id);
+// Start a worker on the socket if none is running there. local is the set of
+// CPUs close to the port, it may be NULL or empty when unknown.
+int worker_ensure_default(int socket_id, const cpu_set_t *local);
+// Worker with the lowest RX queue load on the socket, preferring CPUs close to
+// the port and not sharing a physical core with other busy workers.
+struct worker *worker_rxq_place(int socket_id, const cpu_set_t *local);
+// Parse a list of CPU IDs and ranges, e.g. "2-5,8".
+int cpu_list_parse(const char *, cpu_set_t *);
 
 #endif
@@ -18,19 +18,42 @@
 #include <rte_ethdev.h>
 
 static struct iface *ifaces[] = {NULL, NULL, NULL};
-static struct worker w1 = {.cpu_id = 1, .started = true};
-static struct worker w2 = {.cpu_id = 2, .started = true};
-static struct worker w3 = {.cpu_id = 3, .started = true};
+static struct worker w1 = {.cpu_id = 1, .started = true, .wakeup_fd = -1};
+static struct worker w2 = {.cpu_id = 2, .started = true, .wakeup_fd = -1};
+static struct worker w3 = {.cpu_id = 3, .started = true, .wakeup_fd = -1};
 static struct rte_eth_dev_info dev_info = {.nb_rx_queues = 2};
 
 // mocked types/functions
 extern int gr_rte_log_type;
 int gr_rte_log_type;
+__thread struct gr_log_ring *gr_log_ring;
+void gr_log_push(uint32_t, struct gr_log_ratelimit *, const char *, ...) { }
 void gr_register_api_handler(struct gr_api_handler *) { }
 void gr_register_module(struct gr_module *) { }
 void iface_type_register(struct iface_type *) { }
 void iface_event_notify(iface_event_t, struct iface *) { }
-mock_func(struct rte_mempool *, gr_pktmbuf_pool_get(int8_t, uint32_t));
+int port_ctrl_flows_apply(struct iface_info_port *) {
+	return 0;
+}
+void port_ctrl_flows_destroy(struct iface_info_port *) { }
+void port_ctrl_fini(struct iface_info_port *) { }
+int port_pin_flows_apply(struct iface_info_port *) {
+	return 0;
+}
+void port_pin_flows_destroy(struct iface_info_port *) { }
+void port_pin_fini(struct iface_info_port *) { }
+void port_rss_conf_fill(
+	const struct iface_info_port *,
+	const struct rte_eth_dev_info *,
+	struct rte_eth_rss_conf *
+) { }
+int port_reta_apply(struct iface_info_port *, const struct rte_eth_dev_info *) {
+	return 0;
+}
+mock_func(
+	struct rte_mempool *,
+	gr_pktmbuf_pool_get_port(uint16_t, int8_t, uint32_t, uint16_t)
+);
 void gr_pktmbuf_pool_release(struct rte_mempool *, uint32_t) { }
 
 static struct gr_args args;
@@ -42,6 +65,8 @@ struct iface *iface_from_id(uint16_t ifid) {
 	return ifid < ARRAY_DIM(ifaces) ? ifaces[ifid] : NULL;
 }
 
+void iface_set_ucast_addrs(struct iface *, const struct rte_ether_addr *, unsigned) { }
+
 struct iface *iface_next(uint16_t /*type_id*/, const struct iface *prev) {
 	uint16_t ifid;
 	if (prev == NULL)
@@ -54,6 +79,7 @@ struct iface *iface_next(uint16_t /*type_id*/, const struct iface *prev) {
 }
 
 mock_func(int, worker_graph_reload_all(void));
+mock_func(int, worker_graph_reload(struct worker *));
 mock_func(void, worker_graph_free(struct worker *));
 mock_func(void *, gr_datapath_loop(void *));
 mock_func(void, __wrap_rte_free(void *));
@@ -74,6 +100,8 @@ mock_func(
 	int, __wrap_rte_eth_dev_info_get(uint16_t, struct rte_eth_dev_info *info), *info = dev_info;
 );
 mock_func(int, __wrap_rte_eth_dev_get_mtu(uint16_t, uint16_t *));
+mock_func(int, __wrap_rte_eth_dev_get_supported_ptypes(uint16_t, uint32_t, uint32_t *, int));
+mock_func(int, __wrap_rte_eth_dev_set_ptypes(uint16_t, uint32_t, uint32_t *, int));
 mock_func(int, __wrap_rte_eth_macaddr_get(uint16_t, struct rte_ether_addr *));
 mock_func(
 	int,
@@ -179,6 +207,7 @@ static int teardown(void **) {
 static void common_mocks(void) {
 	will_return_maybe(worker_graph_free, 0);
 	will_return_maybe(worker_graph_reload_all, 0);
+	will_return_maybe(worker_graph_reload, 0);
 	will_return_maybe(__wrap_pthread_create, 0);
 	will_return_maybe(__wrap_pthread_join, 0);
 	will_return_maybe(__wrap_rte_dev_name, "");
@@ -190,11 +219,13 @@ static void common_mocks(void) {
 	will_return_maybe(__wrap_rte_eth_tx_queue_setup, 0);
 	will_return_maybe(__wrap_rte_free, 0);
 	will_return_maybe(__wrap_rte_eth_dev_get_mtu, 0);
+	will_return_maybe(__wrap_rte_eth_dev_get_supported_ptypes, 0);
+	will_return_maybe(__wrap_rte_eth_dev_set_ptypes, 0);
 	will_return_maybe(__wrap_rte_eth_macaddr_get, 0);
 	will_return_maybe(__wrap_rte_get_main_lcore, 0);
 	will_return_maybe(__wrap_rte_mempool_free, 0);
 	will_return_maybe(__wrap_rte_pktmbuf_pool_create, 1);
-	will_return_maybe(gr_pktmbuf_pool_get, 1);
+	will_return_maybe(gr_pktmbuf_pool_get_port, 1);
 }
 
 static void rxq_assign_main_lcore(void **) {
@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_bench.h"
+#include "gr_datapath.h"
+#include "gr_eth_input.h"
+
+#include <gr_graph.h>
+#include <gr_log.h>
+
+#include <rte_graph_worker.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+
+#include <string.h>
+
+enum {
+	ETH_IN = 0,
+	NB_EDGES,
+};
+
+struct bench_worker bench_workers[RTE_MAX_LCORE];
+uint16_t bench_sink_port = RTE_MAX_ETHPORTS;
+
+static uint16_t
+bench_source_process(struct rte_graph *graph, struct rte_node *node, void **, uint16_t) {
+	struct bench_worker *w = &bench_workers[rte_lcore_id()];
+	const struct bench_template *t;
+	struct eth_input_mbuf_data *d;
+	struct rte_vlan_hdr *vlan;
+	struct rte_ipv4_hdr *ip;
+	struct rte_udp_hdr *udp;
+	struct rte_mbuf *m;
+
+	t = __atomic_load_n(&w->template, __ATOMIC_ACQUIRE);
+	if (t == NULL)
+		return 0;
+
+	if (rte_pktmbuf_alloc_bulk(t->pool, (struct rte_mbuf **)node->objs, t->burst) < 0) {
+		w->no_mbuf += t->burst;
+		return 0;
+	}
+
+	for (uint16_t i = 0; i < t->burst; i++) {
+		m = node->objs[i];
+		// only the headers are written, the payload is left as is
+		memcpy(rte_pktmbuf_mtod(m, void *), t->hdr, t->hdr_len);
+		m->data_len = t->pkt_len;
+		m->pkt_len = t->pkt_len;
+		m->port = t->port_id;
+		m->packet_type = 0;
+		udp = rte_pktmbuf_mtod_offset(m, struct rte_udp_hdr *, t->hdr_len - sizeof(*udp));
+		udp->src_port = rte_cpu_to_be_16(t->src_port + w->flow);
+		if (++w->flow >= t->n_flows)
+			w->flow = 0;
+		if (t->n_vlans > 1) {
+			vlan = rte_pktmbuf_mtod_offset(
+				m, struct rte_vlan_hdr *, sizeof(struct rte_ether_hdr)
+			);
+			vlan->vlan_tci = rte_cpu_to_be_16(t->vlan_id + w->vlan);
+			if (++w->vlan >= t->n_vlans)
+				w->vlan = 0;
+		}
+		if (t->n_dsts > 1) {
+			ip = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *, t->ip_offset);
+			ip->dst_addr = rte_cpu_to_be_32(t->dst + w->dst);
+			ip->hdr_checksum = 0;
+			ip->hdr_checksum = rte_ipv4_cksum(ip);
+			if (++w->dst >= t->n_dsts)
+				w->dst = 0;
+		}
+		d = eth_input_mbuf_data(m);
+		d->iface = t->iface;
+		d->eth_dst = ETH_DST_UNKNOWN;
+	}
+	if (unlikely(dwell_enabled))
+		dwell_stamp(node->objs, t->burst);
+	if (unlikely(packet_trace_enabled)) {
+		for (uint16_t i = 0; i < t->burst; i++)
+			trace_packet(node, t->iface->id, node->objs[i]);
+	}
+
+	rte_node_enqueue(graph, node, ETH_IN, node->objs, t->burst);
+	w->packets += t->burst;
+
+	return t->burst;
+}
+
+static uint16_t
+bench_sink_process(struct rte_graph *, struct rte_node *, void **objs, uint16_t nb_objs) {
+	struct bench_worker *w = &bench_workers[rte_lcore_id()];
+
+	if (unlikely(dwell_enabled))
+		dwell_record((struct rte_mbuf **)objs, nb_objs);
+
+	for (uint16_t i = 0; i < nb_objs; i++)
+		w->sink_bytes += rte_pktmbuf_pkt_len((struct rte_mbuf *)objs[i]);
+	w->sink_packets += nb_objs;
+
+	rte_pktmbuf_free_bulk((struct rte_mbuf **)objs, nb_objs);
+
+	return nb_objs;
+}
+
+static struct rte_node_register source_node = {
+	.name = "bench_source",
+	.flags = RTE_NODE_SOURCE_F,
+
+	.process = bench_source_process,
+
+	.nb_edges = NB_EDGES,
+	.next_nodes = {
+		[ETH_IN] = "eth_input",
+	},
+};
+
+static struct gr_node_info source_info = {
+	.node = &source_node,
+};
+
+GR_NODE_REGISTER(source_info);
+
+static struct rte_node_register sink_node = {
+	.name = "bench_sink",
+
+	.process = bench_sink_process,
+};
+
+static struct gr_node_info sink_info = {
+	.node = &sink_node,
+};
+
+GR_NODE_REGISTER(sink_info);
@@ -3,6 +3,7 @@
 
 #include "gr_control_input.h"
 
+#include <gr_control.h>
 #include <gr_eth_input.h>
 #include <gr_eth_output.h>
 #include <gr_graph.h>
@@ -12,9 +13,13 @@
 
 #include <rte_ether.h>
 #include <rte_graph_worker.h>
+#include <rte_lcore.h>
 #include <rte_malloc.h>
 #include <rte_version.h>
 
+#include <stdbool.h>
+#include <stdio.h>
+
 enum {
 	UNKNOWN_CONTROL_INPUT_TYPE,
 	EDGE_COUNT,
@@ -25,7 +30,19 @@ struct gr_control_input_msg {
 	void *data;
 };
 
+// Messages posted by non-datapath threads (i.e. the control plane).
+#define CONTROL_INPUT_RING_SIZE (RTE_GRAPH_BURST_SIZE * 16)
+// Messages posted by a datapath worker are consumed by the same worker.
+#define CONTROL_INPUT_WORKER_RING_SIZE (RTE_GRAPH_BURST_SIZE * 16)
+
 static struct rte_ring *control_input_ring;
+// Per datapath worker single producer/single consumer rings, indexed by lcore_id.
+static struct rte_ring *worker_rings[RTE_MAX_LCORE];
+// Set when the control_input node was processed by the worker since its graph
+// was (re)loaded. Otherwise, nothing drains its ring and messages are posted to
+// the shared ring. Only accessed by the worker itself.
+static bool worker_rings_polled[RTE_MAX_LCORE];
+static struct control_input_stats control_input_stats;
 
 static control_input_t next_id = 0;
 static rte_edge_t control_input_edges[1 << 8] = {UNKNOWN_CONTROL_INPUT_TYPE};
@@ -40,42 +57,72 @@ control_input_t gr_control_input_register_handler(const char *node_name) {
 
 int post_to_stack(control_input_t type, void *data) {
 	struct gr_control_input_msg msg = {.type = type, .data = data};
+	struct rte_ring *ring = NULL;
+	unsigned lcore_id;
 	int ret;
 
-	ret = rte_ring_enqueue_elem(control_input_ring, &msg, sizeof(msg));
-	if (ret < 0)
+	lcore_id = rte_lcore_id();
+	if (lcore_id < RTE_MAX_LCORE && worker_rings_polled[lcore_id])
+		ring = worker_rings[lcore_id];
+	if (ring == NULL)
+		ring = control_input_ring;
+
+	ret = rte_ring_enqueue_elem(ring, &msg, sizeof(msg));
+	if (ret < 0) {
+		__atomic_fetch_add(&control_input_stats.ring_full, 1, __ATOMIC_RELAXED);
 		return errno_set(-ret);
+	}
 
 	return 0;
 }
 
+void control_input_stats_get(struct control_input_stats *stats) {
+	stats->ring_full = __atomic_load_n(&control_input_stats.ring_full, __ATOMIC_RELAXED);
+	stats->no_mbufs = __atomic_load_n(&control_input_stats.no_mbufs, __ATOMIC_RELAXED);
+}
+
 static uint16_t control_input_process(
 	struct rte_graph *graph,
 	struct rte_node *node,
 	void ** /*objs*/,
 	uint16_t /*nb_objs*/
 ) {
+	struct rte_ring *local = worker_rings[rte_lcore_id()];
 	struct gr_control_input_msg msg[RTE_GRAPH_BURST_SIZE];
-	struct rte_mempool *mp;
-	struct rte_mbuf *mbuf;
-	uint16_t n;
-
-	n = rte_ring_dequeue_burst_elem(
-		control_input_ring,
-		msg,
-		sizeof(struct gr_control_input_msg),
-		RTE_GRAPH_BURST_SIZE,
-		NULL
-	);
+	struct rte_mbuf *mbufs[RTE_GRAPH_BURST_SIZE];
+	struct rte_mempool *mp = node->ctx_ptr;
+	unsigned n, count;
+
+	if (unlikely(local != NULL && !worker_rings_polled[rte_lcore_id()]))
+		worker_rings_polled[rte_lcore_id()] = true;
+
+	count = rte_ring_count(control_input_ring);
+	if (local != NULL)
+		count += rte_ring_count(local);
+	if (count == 0)
+		return 0;
+	count = RTE_MIN(count, (unsigned)RTE_GRAPH_BURST_SIZE);
+
+	// Allocate the mbufs before dequeuing so that messages are left in the rings
+	// for the next iteration when the mempool is exhausted.
+	if (rte_pktmbuf_alloc_bulk(mp, mbufs, count) < 0) {
+		__atomic_fetch_add(&control_input_stats.no_mbufs, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
 
-	mp = node->ctx_ptr;
+	n = 0;
+	if (local != NULL)
+		n = rte_ring_dequeue_burst_elem(local, msg, sizeof(*msg), count, NULL);
+	if (n < count)
+		n += rte_ring_dequeue_burst_elem(
+			control_input_ring, &msg[n], sizeof(*msg), count - n, NULL
+		);
+	if (n < count) // another worker dequeued messages in the meantime
+		rte_pktmbuf_free_bulk(&mbufs[n], count - n);
 
 	for (unsigned i = 0; i < n; i++) {
-		mbuf = rte_pktmbuf_alloc(mp);
-		if (mbuf) {
-			control_input_mbuf_data(mbuf)->data = msg[i].data;
-			rte_node_enqueue_x1(graph, node, control_input_edges[msg[i].type], mbuf);
-		}
+		control_input_mbuf_data(mbufs[i])->data = msg[i].data;
+		rte_node_enqueue_x1(graph, node, control_input_edges[msg[i].type], mbufs[i]);
 	}
 
 	return n;
@@ -99,18 +146,71 @@ static void control_input_register(void) {
 	control_input_ring = rte_ring_create_elem(
 		"control_input",
 		sizeof(struct gr_control_input_msg),
-		RTE_GRAPH_BURST_SIZE * 4,
+		CONTROL_INPUT_RING_SIZE,
 		SOCKET_ID_ANY,
 		RING_F_MP_RTS_ENQ | RING_F_MC_RTS_DEQ
 	);
 	if (control_input_ring == NULL)
-		ABORT("rte_ring_create(arp_output_request): %s", rte_strerror(rte_errno));
+		ABORT("rte_ring_create(control_input): %s", rte_strerror(rte_errno));
 }
 
 static void control_input_unregister(void) {
+	for (unsigned i = 0; i < RTE_MAX_LCORE; i++) {
+		rte_ring_free(worker_rings[i]);
+		worker_rings[i] = NULL;
+	}
 	rte_ring_free(control_input_ring);
 }
 
+static void control_input_init_dp(void) {
+	unsigned lcore_id = rte_lcore_id();
+	char name[RTE_RING_NAMESIZE];
+
+	worker_rings_polled[lcore_id] = false;
+	if (worker_rings[lcore_id] != NULL)
+		return;
+
+	snprintf(name, sizeof(name), "control_input_%u", lcore_id);
+	worker_rings[lcore_id] = rte_ring_create_elem(
+		name,
+		sizeof(struct gr_control_input_msg),
+		CONTROL_INPUT_WORKER_RING_SIZE,
+		rte_socket_id(),
+		RING_F_SP_ENQ | RING_F_SC_DEQ
+	);
+	if (worker_rings[lcore_id] == NULL)
+		ABORT("rte_ring_create(%s): %s", name, rte_strerror(rte_errno));
+}
+
+static void control_input_fini_dp(void) {
+	struct rte_ring *local = worker_rings[rte_lcore_id()];
+	struct gr_control_input_msg msg[RTE_GRAPH_BURST_SIZE];
+	unsigned n, sent;
+
+	if (local == NULL)
+		return;
+
+	worker_rings_polled[rte_lcore_id()] = false;
+
+	// This lcore may not run a graph anymore. Hand over pending messages to
+	// other workers so that they are not lost.
+	while ((n = rte_ring_dequeue_burst_elem(local, msg, sizeof(*msg), RTE_DIM(msg), NULL))) {
+		sent = rte_ring_enqueue_burst_elem(control_input_ring, msg, sizeof(*msg), n, NULL);
+		if (sent < n) {
+			__atomic_fetch_add(
+				&control_input_stats.ring_full, n - sent, __ATOMIC_RELAXED
+			);
+			LOG(ERR, "control_input: %u messages lost", n - sent);
+		}
+	}
+}
+
+static struct gr_module control_input_module = {
+	.name = "control_input",
+	.init_dp = control_input_init_dp,
+	.fini_dp = control_input_fini_dp,
+};
+
 static struct rte_node_register control_input_node = {
 	.flags = RTE_NODE_SOURCE_F,
 	.name = "control_input",
@@ -129,4 +229,8 @@ static struct gr_node_info info = {
 
 GR_NODE_REGISTER(info);
 
+RTE_INIT(control_input_constructor) {
+	gr_register_module(&control_input_module);
+}
+
 GR_DROP_REGISTER(control_input_unknown_type);
@@ -1,20 +1,166 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // Copyright (c) 2024 Robin Jarry
 
+#include <gr_control.h>
+#include <gr_datapath.h>
 #include <gr_graph.h>
+#include <gr_iface.h>
 #include <gr_log.h>
+#include <gr_port.h>
 
+#include <rte_errno.h>
 #include <rte_graph_worker.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
 #include <rte_mbuf.h>
 
+#include <stdlib.h>
+#include <string.h>
+
+// Drop counters of one worker, allocated on its NUMA node by drop_init_dp.
+// Only that worker increments them. The control plane sums them with relaxed
+// loads and compares against drop_base, it never writes to them.
+struct __rte_cache_aligned drop_worker {
+	// indexed by drop node ID and by receiving port, see drop_get()
+	uint64_t *counters;
+	uint32_t sample_count;
+};
+
+static struct drop_worker drop_workers[RTE_MAX_LCORE];
+// number of rows in the counters arrays
+static unsigned drop_n_nodes;
+// zero when sampling is disabled
+static uint32_t drop_sample_rate;
+// values at the last reset, control plane only
+static uint64_t *drop_base;
+
+static void drop_sample(
+	struct drop_worker *w,
+	const struct rte_node *node,
+	void *const *objs,
+	uint16_t nb_objs,
+	uint32_t rate
+) {
+	const struct iface *iface;
+	const struct rte_mbuf *m;
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		if (++w->sample_count < rate)
+			continue;
+		w->sample_count = 0;
+		m = objs[i];
+		// packets generated locally cannot be associated to an interface
+		if (m->port >= RTE_MAX_ETHPORTS || (iface = port_get_iface(m->port)) == NULL)
+			continue;
+		trace_drop_packet(node, iface->id, m);
+	}
+}
+
 uint16_t drop_packets(struct rte_graph *, struct rte_node *node, void **objs, uint16_t nb_objs) {
-	if (unlikely(packet_trace_enabled)) {
-		LOG(NOTICE, "[%s] %u packets", node->name, nb_objs);
+	struct drop_worker *w = &drop_workers[rte_lcore_id()];
+	uint32_t rate = __atomic_load_n(&drop_sample_rate, __ATOMIC_RELAXED);
+	const struct rte_mbuf *m;
+	uint64_t *counters;
+
+	if (unlikely(packet_trace_enabled))
+		trace_drop(node, nb_objs);
+
+	if (likely(w->counters != NULL && node->id < drop_n_nodes)) {
+		counters = &w->counters[node->id * DROP_N_PORTS];
+		for (uint16_t i = 0; i < nb_objs; i++) {
+			m = objs[i];
+			counters[RTE_MIN(m->port, (uint16_t)DROP_PORT_NONE)]++;
+		}
 	}
+	if (unlikely(rate != 0))
+		drop_sample(w, node, objs, nb_objs, rate);
+
 	rte_pktmbuf_free_bulk((struct rte_mbuf **)objs, nb_objs);
 
 	return nb_objs;
 }
 
+void drop_configure(uint32_t sample_rate) {
+	__atomic_store_n(&drop_sample_rate, sample_rate, __ATOMIC_RELAXED);
+}
+
+uint32_t drop_get_sample_rate(void) {
+	return __atomic_load_n(&drop_sample_rate, __ATOMIC_RELAXED);
+}
+
+unsigned drop_max_nodes(void) {
+	return drop_n_nodes;
+}
+
+static uint64_t drop_sum(unsigned index) {
+	uint64_t sum = 0;
+
+	for (unsigned i = 0; i < RTE_MAX_LCORE; i++) {
+		if (drop_workers[i].counters != NULL)
+			sum += __atomic_load_n(&drop_workers[i].counters[index], __ATOMIC_RELAXED);
+	}
+
+	return sum;
+}
+
+uint64_t drop_get(rte_node_t node_id, uint16_t port_id) {
+	unsigned index;
+
+	if (node_id >= drop_n_nodes || port_id > DROP_PORT_NONE)
+		return 0;
+
+	index = node_id * DROP_N_PORTS + port_id;
+	return drop_sum(index) - drop_base[index];
+}
+
+void drop_reset(void) {
+	for (unsigned i = 0; i < drop_n_nodes * DROP_N_PORTS; i++)
+		drop_base[i] = drop_sum(i);
+}
+
+static void drop_init(struct event_base *) {
+	drop_n_nodes = rte_node_max_count();
+	drop_base = calloc(drop_n_nodes * DROP_N_PORTS, sizeof(*drop_base));
+	if (drop_base == NULL)
+		ABORT("calloc(drop_base) failed");
+}
+
+static void drop_init_dp(void) {
+	unsigned lcore_id = rte_lcore_id();
+	struct drop_worker *w = &drop_workers[lcore_id];
+
+	if (w->counters != NULL)
+		return;
+
+	w->counters = rte_zmalloc_socket(
+		__func__,
+		drop_n_nodes * DROP_N_PORTS * sizeof(*w->counters),
+		RTE_CACHE_LINE_SIZE,
+		rte_socket_id()
+	);
+	if (w->counters == NULL)
+		ABORT("rte_zmalloc(drop counters): %s", rte_strerror(rte_errno));
+}
+
+static void drop_fini(struct event_base *) {
+	for (unsigned i = 0; i < RTE_MAX_LCORE; i++) {
+		rte_free(drop_workers[i].counters);
+		drop_workers[i].counters = NULL;
+	}
+	free(drop_base);
+	drop_base = NULL;
+}
+
+static struct gr_module drop_module = {
+	.name = "drop counters",
+	.init = drop_init,
+	.fini = drop_fini,
+	.init_dp = drop_init_dp,
+};
+
+RTE_INIT(drop_constructor) {
+	gr_register_module(&drop_module);
+}
+
 // Global drop counters, used by multiple nodes
 GR_DROP_REGISTER(error_no_headroom);
@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_datapath.h"
+
+#include <gr_control.h>
+#include <gr_infra.h>
+#include <gr_log.h>
+
+#include <rte_bitops.h>
+#include <rte_cycles.h>
+#include <rte_errno.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mbuf_dyn.h>
+
+#include <stdalign.h>
+#include <string.h>
+
+// Dwell time histogram filled by one worker for the packets it samples.
+// The control plane only reads it to sum all workers, the values at the last
+// reset are kept aside in dwell_base so that the worker never gets written to.
+struct __rte_cache_aligned dwell_worker {
+	uint32_t sample_count;
+	uint64_t samples;
+	uint64_t hist[GR_INFRA_STATS_HIST_BUCKETS];
+};
+
+bool dwell_enabled;
+int dwell_tsc_offset = -1;
+uint64_t dwell_tsc_flag;
+
+static struct dwell_worker dwell_workers[RTE_MAX_LCORE];
+static uint32_t dwell_sample_rate = 1;
+// values at the last reset, control plane only
+static struct dwell_worker dwell_base;
+
+static inline unsigned dwell_bucket(uint64_t cycles) {
+	if (cycles == 0)
+		return 0;
+	return RTE_MIN(64 - rte_clz64(cycles), GR_INFRA_STATS_HIST_BUCKETS - 1);
+}
+
+void dwell_record(struct rte_mbuf **mbufs, uint16_t n) {
+	struct dwell_worker *w = &dwell_workers[rte_lcore_id()];
+	uint32_t rate = __atomic_load_n(&dwell_sample_rate, __ATOMIC_RELAXED);
+	uint64_t now = rte_rdtsc();
+	struct rte_mbuf *m;
+
+	for (uint16_t i = 0; i < n; i++) {
+		m = mbufs[i];
+		// packets generated locally or copied do not carry a timestamp
+		if (!(m->ol_flags & dwell_tsc_flag))
+			continue;
+		if (++w->sample_count < rate)
+			continue;
+		w->sample_count = 0;
+		w->hist[dwell_bucket(now - *dwell_tsc(m))]++;
+		w->samples++;
+	}
+}
+
+void dwell_configure(bool enabled, uint32_t sample_rate) {
+	__atomic_store_n(&dwell_sample_rate, sample_rate ?: 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&dwell_enabled, enabled, __ATOMIC_RELEASE);
+}
+
+uint32_t dwell_get_sample_rate(void) {
+	return __atomic_load_n(&dwell_sample_rate, __ATOMIC_RELAXED);
+}
+
+static void dwell_sum(struct dwell_worker *sum) {
+	memset(sum, 0, sizeof(*sum));
+	for (unsigned i = 0; i < RTE_MAX_LCORE; i++) {
+		const struct dwell_worker *w = &dwell_workers[i];
+		sum->samples += __atomic_load_n(&w->samples, __ATOMIC_RELAXED);
+		for (unsigned b = 0; b < GR_INFRA_STATS_HIST_BUCKETS; b++)
+			sum->hist[b] += __atomic_load_n(&w->hist[b], __ATOMIC_RELAXED);
+	}
+}
+
+uint64_t dwell_get(uint64_t hist[GR_INFRA_STATS_HIST_BUCKETS]) {
+	struct dwell_worker sum;
+
+	dwell_sum(&sum);
+	for (unsigned b = 0; b < GR_INFRA_STATS_HIST_BUCKETS; b++)
+		hist[b] = sum.hist[b] - dwell_base.hist[b];
+
+	return sum.samples - dwell_base.samples;
+}
+
+void dwell_reset(void) {
+	dwell_sum(&dwell_base);
+}
+
+static void dwell_init(struct event_base *) {
+	static const struct rte_mbuf_dynfield field_desc = {
+		.name = "grout_dwell_tsc",
+		.size = sizeof(uint64_t),
+		.align = alignof(uint64_t),
+	};
+	static const struct rte_mbuf_dynflag flag_desc = {
+		.name = "grout_dwell_tsc_valid",
+	};
+	int bit;
+
+	dwell_tsc_offset = rte_mbuf_dynfield_register(&field_desc);
+	if (dwell_tsc_offset < 0)
+		ABORT("rte_mbuf_dynfield_register(dwell): %s", rte_strerror(rte_errno));
+	if ((bit = rte_mbuf_dynflag_register(&flag_desc)) < 0)
+		ABORT("rte_mbuf_dynflag_register(dwell): %s", rte_strerror(rte_errno));
+	dwell_tsc_flag = RTE_BIT64(bit);
+}
+
+static struct gr_module dwell_module = {
+	.name = "dwell time",
+	.init = dwell_init,
+};
+
+RTE_INIT(dwell_constructor) {
+	gr_register_module(&dwell_module);
+}
@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_eth_input.h"
+#include "gr_eth_output.h"
+#include "gr_node_bench.h"
+
+#include <gr_iface.h>
+#include <gr_macro.h>
+#include <gr_port.h>
+#include <gr_vlan.h>
+
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_mbuf.h>
+#include <rte_mbuf_ptype.h>
+
+#include <string.h>
+
+#define PKT_LEN 64
+
+static struct iface *port;
+static struct iface *vlan;
+
+// mocked types/functions
+struct iface *vlan_get_iface(uint16_t port_id, uint16_t vlan_id) {
+	if (port_id != port->id || vlan_id != 42)
+		return NULL;
+	return vlan;
+}
+
+static void eth_frame(struct rte_mbuf *m, const struct rte_ether_addr *dst) {
+	struct rte_ether_hdr *eth = (struct rte_ether_hdr *)rte_pktmbuf_append(m, PKT_LEN);
+
+	memset(eth, 0, PKT_LEN);
+	eth->dst_addr = *dst;
+	eth->src_addr = (struct rte_ether_addr) {{0x02, 0x00, 0x00, 0x00, 0x00, 0x02}};
+	eth->ether_type = RTE_BE16(RTE_ETHER_TYPE_IPV4);
+	eth_input_mbuf_data(m)->iface = port;
+	m->port = ((const struct iface_info_port *)port->info)->port_id;
+}
+
+static void eth_input_local(struct rte_mbuf *m, uint16_t) {
+	eth_frame(m, &((const struct iface_info_port *)port->info)->mac);
+}
+
+static void eth_input_ptype(struct rte_mbuf *m, uint16_t i) {
+	eth_input_local(m, i);
+	m->packet_type = RTE_PTYPE_L2_ETHER | RTE_PTYPE_L3_IPV4;
+}
+
+static void eth_input_vlan(struct rte_mbuf *m, uint16_t i) {
+	eth_input_local(m, i);
+	m->ol_flags |= RTE_MBUF_F_RX_VLAN_STRIPPED;
+	m->vlan_tci = 42;
+}
+
+static void eth_input_bcast(struct rte_mbuf *m, uint16_t) {
+	struct rte_ether_addr bcast;
+	memset(&bcast, 0xff, sizeof(bcast));
+	eth_frame(m, &bcast);
+}
+
+static struct eth_l2_rewrite l2;
+
+static void eth_output_port(struct rte_mbuf *m, uint16_t) {
+	struct eth_output_mbuf_data *d = eth_output_mbuf_data(m);
+	void *ip = rte_pktmbuf_append(m, PKT_LEN - RTE_ETHER_HDR_LEN);
+
+	memset(ip, 0, PKT_LEN - RTE_ETHER_HDR_LEN);
+	d->iface = port;
+	d->dst = (struct rte_ether_addr) {{0x02, 0x00, 0x00, 0x00, 0x00, 0x02}};
+	d->ether_type = RTE_BE16(RTE_ETHER_TYPE_IPV4);
+	d->l2 = NULL;
+}
+
+static void eth_output_cached(struct rte_mbuf *m, uint16_t i) {
+	struct eth_output_mbuf_data *d = eth_output_mbuf_data(m);
+
+	eth_output_port(m, i);
+	d->l2_version = eth_l2_rewrite_version(&l2);
+	d->l2 = &l2;
+}
+
+static void eth_output_vlan(struct rte_mbuf *m, uint16_t i) {
+	eth_output_port(m, i);
+	eth_output_mbuf_data(m)->iface = vlan;
+}
+
+static const struct node_bench benches[] = {
+	{"eth_input/local", "eth_input", 0, eth_input_local, "ip_input"},
+	{"eth_input/local/burst1", "eth_input", 1, eth_input_local, "ip_input"},
+	{"eth_input/ptype", "eth_input", 0, eth_input_ptype, "ip_input"},
+	{"eth_input/vlan", "eth_input", 0, eth_input_vlan, "ip_input"},
+	{"eth_input/broadcast", "eth_input", 0, eth_input_bcast, "ip_input"},
+	{"eth_output/port", "eth_output", 0, eth_output_port, "port_tx"},
+	{"eth_output/cached", "eth_output", 0, eth_output_cached, "port_tx"},
+	{"eth_output/vlan", "eth_output", 0, eth_output_vlan, "port_tx"},
+};
+
+int main(void) {
+	struct iface_info_vlan *v;
+	struct iface_info_port *p;
+
+	port = node_bench_iface_add(GR_IFACE_TYPE_PORT, 0, sizeof(*p));
+	p = (struct iface_info_port *)port->info;
+	p->mac = (struct rte_ether_addr) {{0x02, 0x00, 0x00, 0x00, 0x00, 0x01}};
+	port->mac = p->mac;
+	vlan = node_bench_iface_add(GR_IFACE_TYPE_VLAN, 0, sizeof(*v));
+	v = (struct iface_info_vlan *)vlan->info;
+	v->parent_id = port->id;
+	v->parent = port;
+	v->vlan_id = 42;
+	v->mac = p->mac;
+	vlan->mac = p->mac;
+
+	node_bench_init();
+	// normally registered by ip_input which is not linked
+	gr_eth_input_add_type(RTE_BE16(RTE_ETHER_TYPE_IPV4), "ip_input");
+
+	return node_bench_run(benches, ARRAY_DIM(benches));
+}
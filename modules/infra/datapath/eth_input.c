@@ -1,106 +1,420 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // Copyright (c) 2024 Robin Jarry
 
+#include "gr_datapath.h"
 #include "gr_eth_input.h"
+#include "gr_mbuf.h"
+#include "gr_policer.h"
 
 #include <gr_graph.h>
 #include <gr_log.h>
 #include <gr_vlan.h>
 
 #include <rte_byteorder.h>
+#include <rte_cpuflags.h>
+#include <rte_cycles.h>
 #include <rte_ether.h>
 #include <rte_graph.h>
 #include <rte_graph_worker.h>
 #include <rte_mbuf.h>
+#include <rte_mbuf_ptype.h>
+#include <rte_vect.h>
+
+#ifdef RTE_ARCH_X86
+#include <immintrin.h>
+#endif
+
+#include <stdbool.h>
+#include <string.h>
 
 enum {
 	UNKNOWN_ETHER_TYPE = 0,
 	UNKNOWN_VLAN,
 	INVALID_IFACE,
+	POLICED,
 	NB_EDGES,
 };
 
 static rte_edge_t l2l3_edges[1 << 16] = {UNKNOWN_ETHER_TYPE};
 
+// Indexed by L2 domain iface type, UNKNOWN_ETHER_TYPE when no node is registered.
+static rte_edge_t domain_edges[128] = {UNKNOWN_ETHER_TYPE};
+
+// Edges for packets classified by the NIC, indexed by the L2 and L3 layers of
+// mbuf->packet_type. This avoids looking up the large ether type table when
+// the driver supports packet type offload. Unknown entries fall back to the
+// ether type table.
+#define PTYPE_EDGE_MASK (RTE_PTYPE_L2_MASK | RTE_PTYPE_L3_MASK)
+static rte_edge_t ptype_edges[PTYPE_EDGE_MASK + 1] = {UNKNOWN_ETHER_TYPE};
+
+static void ptype_edges_add(uint32_t l2, const uint32_t *l3, unsigned n_l3, rte_edge_t edge) {
+	for (unsigned i = 0; i < n_l3; i++)
+		ptype_edges[l2 | l3[i]] = edge;
+}
+
 void gr_eth_input_add_type(rte_be16_t eth_type, const char *next_node) {
+	static const uint32_t ip4[] = {
+		RTE_PTYPE_L3_IPV4, RTE_PTYPE_L3_IPV4_EXT, RTE_PTYPE_L3_IPV4_EXT_UNKNOWN
+	};
+	static const uint32_t ip6[] = {
+		RTE_PTYPE_L3_IPV6, RTE_PTYPE_L3_IPV6_EXT, RTE_PTYPE_L3_IPV6_EXT_UNKNOWN
+	};
+	static const uint32_t l2[] = {
+		RTE_PTYPE_UNKNOWN, RTE_PTYPE_L2_ETHER, RTE_PTYPE_L2_ETHER_VLAN
+	};
+	static const uint32_t none[] = {RTE_PTYPE_UNKNOWN};
+	rte_edge_t edge;
+
 	LOG(DEBUG, "eth_input: type=0x%04x -> %s", rte_be_to_cpu_16(eth_type), next_node);
 	if (l2l3_edges[eth_type] != UNKNOWN_ETHER_TYPE)
 		ABORT("next node already registered for ether type=0x%04x",
 		      rte_be_to_cpu_16(eth_type));
-	l2l3_edges[eth_type] = gr_node_attach_parent("eth_input", next_node);
+	edge = gr_node_attach_parent("eth_input", next_node);
+	l2l3_edges[eth_type] = edge;
+
+	switch (eth_type) {
+	case RTE_BE16(RTE_ETHER_TYPE_IPV4):
+		for (unsigned i = 0; i < RTE_DIM(l2); i++)
+			ptype_edges_add(l2[i], ip4, RTE_DIM(ip4), edge);
+		break;
+	case RTE_BE16(RTE_ETHER_TYPE_IPV6):
+		for (unsigned i = 0; i < RTE_DIM(l2); i++)
+			ptype_edges_add(l2[i], ip6, RTE_DIM(ip6), edge);
+		break;
+	case RTE_BE16(RTE_ETHER_TYPE_ARP):
+		ptype_edges_add(RTE_PTYPE_L2_ETHER_ARP, none, RTE_DIM(none), edge);
+		break;
+	}
 }
 
-static uint16_t
-eth_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
-	uint16_t vlan_id, last_iface_id, last_vlan_id;
-	const struct iface *vlan_iface, *iface;
+void gr_eth_input_add_domain(uint16_t domain_type_id, const char *next_node) {
+	LOG(DEBUG, "eth_input: domain iface_type=%u -> %s", domain_type_id, next_node);
+	if (domain_type_id == GR_IFACE_TYPE_UNDEF || domain_type_id >= ARRAY_DIM(domain_edges))
+		ABORT("invalid iface type=%u", domain_type_id);
+	if (domain_edges[domain_type_id] != UNKNOWN_ETHER_TYPE)
+		ABORT("next node already registered for domain type=%u", domain_type_id);
+	domain_edges[domain_type_id] = gr_node_attach_parent("eth_input", next_node);
+}
+
+// Only trust the NIC classification for VLAN tagged frames. Unknown L2 packet
+// types are parsed in software.
+static inline bool eth_is_vlan(uint32_t ptype, rte_be16_t eth_type) {
+	switch (ptype & RTE_PTYPE_L2_MASK) {
+	case RTE_PTYPE_L2_ETHER:
+	case RTE_PTYPE_L2_ETHER_ARP:
+	case RTE_PTYPE_L2_ETHER_LLDP:
+		return false;
+	case RTE_PTYPE_L2_ETHER_VLAN:
+		return true;
+	}
+	return eth_type == RTE_BE16(RTE_ETHER_TYPE_VLAN);
+}
+
+// Ethernet addresses are loaded as 48-bit integers in the lower bits of
+// a 64-bit word with the first byte in the least significant position.
+// This allows comparing whole addresses with a single instruction and
+// checking the multicast bit with a mask, regardless of the CPU endianness.
+#define ETH_ADDR_BCAST UINT64_C(0x0000ffffffffffff)
+#define ETH_ADDR_MCAST UINT64_C(0x1)
+
+static inline uint64_t eth_addr_load(const struct rte_ether_addr *addr) {
+	uint64_t value = 0;
+	memcpy(&value, addr, sizeof(*addr));
+	return rte_le_to_cpu_64(value);
+}
+
+// Indexed by (multicast | broadcast << 1 | local << 2).
+static const uint8_t eth_dst_types[8] = {
+	[0] = ETH_DST_OTHER,
+	[1] = ETH_DST_MULTICAST,
+	[2] = ETH_DST_BROADCAST,
+	[3] = ETH_DST_BROADCAST,
+	[4] = ETH_DST_LOCAL,
+	[5] = ETH_DST_MULTICAST,
+	[6] = ETH_DST_BROADCAST,
+	[7] = ETH_DST_BROADCAST,
+};
+
+static inline uint8_t eth_dst_type(unsigned mcast, unsigned bcast, unsigned local) {
+	return eth_dst_types[(mcast & 1) | ((bcast & 1) << 1) | ((local & 1) << 2)];
+}
+
+// Slow path for interfaces with secondary unicast addresses.
+static inline uint8_t eth_ucast_type(const struct iface *iface, uint64_t dst) {
+	uint8_t n = __atomic_load_n(&iface->n_ucast, __ATOMIC_ACQUIRE);
+
+	for (uint8_t i = 0; i < n; i++) {
+		if (eth_addr_load(&iface->ucast[i]) == dst)
+			return ETH_DST_LOCAL;
+	}
+
+	return ETH_DST_OTHER;
+}
+
+typedef void (*eth_classify_t)(
+	const uint64_t *dst,
+	const uint64_t *mac,
+	uint8_t *types,
+	uint16_t n
+);
+
+static void
+eth_classify_scalar(const uint64_t *dst, const uint64_t *mac, uint8_t *types, uint16_t n) {
+	for (uint16_t i = 0; i < n; i++) {
+		types[i] = eth_dst_type(
+			dst[i] & ETH_ADDR_MCAST, dst[i] == ETH_ADDR_BCAST, dst[i] == mac[i]
+		);
+	}
+}
+
+#ifdef RTE_ARCH_X86
+__attribute__((target("sse4.1"))) static void
+eth_classify_sse(const uint64_t *dst, const uint64_t *mac, uint8_t *types, uint16_t n) {
+	const __m128i bcast = _mm_set1_epi64x(ETH_ADDR_BCAST);
+	const __m128i mcast = _mm_set1_epi64x(ETH_ADDR_MCAST);
+	unsigned local, bc, mc;
+	__m128i d, m;
+	uint16_t i;
+
+	for (i = 0; i + 2 <= n; i += 2) {
+		d = _mm_loadu_si128((const __m128i *)&dst[i]);
+		m = _mm_loadu_si128((const __m128i *)&mac[i]);
+		local = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(d, m)));
+		bc = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(d, bcast)));
+		d = _mm_and_si128(d, mcast);
+		mc = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(d, mcast)));
+		for (unsigned j = 0; j < 2; j++)
+			types[i + j] = eth_dst_type(mc >> j, bc >> j, local >> j);
+	}
+	eth_classify_scalar(&dst[i], &mac[i], &types[i], n - i);
+}
+
+__attribute__((target("avx2"))) static void
+eth_classify_avx2(const uint64_t *dst, const uint64_t *mac, uint8_t *types, uint16_t n) {
+	const __m256i bcast = _mm256_set1_epi64x(ETH_ADDR_BCAST);
+	const __m256i mcast = _mm256_set1_epi64x(ETH_ADDR_MCAST);
+	unsigned local, bc, mc;
+	__m256i d, m;
+	uint16_t i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		d = _mm256_loadu_si256((const __m256i *)&dst[i]);
+		m = _mm256_loadu_si256((const __m256i *)&mac[i]);
+		local = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(d, m)));
+		bc = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(d, bcast)));
+		d = _mm256_and_si256(d, mcast);
+		mc = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(d, mcast)));
+		for (unsigned j = 0; j < 4; j++)
+			types[i + j] = eth_dst_type(mc >> j, bc >> j, local >> j);
+	}
+	eth_classify_scalar(&dst[i], &mac[i], &types[i], n - i);
+}
+#endif
+
+#ifdef RTE_ARCH_ARM64
+static void
+eth_classify_neon(const uint64_t *dst, const uint64_t *mac, uint8_t *types, uint16_t n) {
+	const uint64x2_t bcast = vdupq_n_u64(ETH_ADDR_BCAST);
+	const uint64x2_t mcast = vdupq_n_u64(ETH_ADDR_MCAST);
+	uint64x2_t d, local, bc, mc;
+	uint16_t i;
+
+	for (i = 0; i + 2 <= n; i += 2) {
+		d = vld1q_u64(&dst[i]);
+		local = vceqq_u64(d, vld1q_u64(&mac[i]));
+		bc = vceqq_u64(d, bcast);
+		mc = vtstq_u64(d, mcast);
+		types[i] = eth_dst_type(
+			vgetq_lane_u64(mc, 0), vgetq_lane_u64(bc, 0), vgetq_lane_u64(local, 0)
+		);
+		types[i + 1] = eth_dst_type(
+			vgetq_lane_u64(mc, 1), vgetq_lane_u64(bc, 1), vgetq_lane_u64(local, 1)
+		);
+	}
+	eth_classify_scalar(&dst[i], &mac[i], &types[i], n - i);
+}
+#endif
+
+static eth_classify_t eth_classify = eth_classify_scalar;
+
+// Restore the ethernet header of a frame received on an L2 domain member.
+// A VLAN tag stripped in software is not restored.
+static inline rte_edge_t eth_domain_input(
+	struct rte_mbuf *m,
+	const struct rte_ether_hdr *eth,
+	rte_be16_t eth_type,
+	const struct iface *domain
+) {
+	struct rte_ether_hdr *l2;
+
+	l2 = (struct rte_ether_hdr *)rte_pktmbuf_prepend(m, sizeof(*l2));
+	if (l2 != eth) {
+		memmove(l2, eth, 2 * sizeof(struct rte_ether_addr));
+		l2->ether_type = eth_type;
+	}
+	// The NIC classification describes the tagged frame.
+	m->ol_flags &= ~RTE_MBUF_F_RX_VLAN_STRIPPED;
+	m->packet_type = RTE_PTYPE_UNKNOWN;
+
+	return domain_edges[domain->type_id];
+}
+
+static __rte_always_inline uint16_t eth_input_burst(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs,
+	const bool vlans
+) {
+	struct iface_stats_batch stats = {.tx = false};
+	uint16_t vlan_id;
+	const struct iface *vlan_iface;
+	uint64_t dsts[RTE_GRAPH_BURST_SIZE];
+	uint64_t macs[RTE_GRAPH_BURST_SIZE];
+	uint8_t types[RTE_GRAPH_BURST_SIZE];
 	struct eth_input_mbuf_data *eth_in;
-	struct rte_ether_addr iface_mac;
+	struct iface_policer *policer;
+	uint16_t i, n, count;
+	struct gr_spec_stream s;
 	struct rte_ether_hdr *eth;
 	struct rte_vlan_hdr *vlan;
 	rte_be16_t eth_type;
 	struct rte_mbuf *m;
+	uint64_t mac;
 	rte_edge_t edge;
+	uint64_t now = 0;
+	uint32_t len;
 
-	iface = NULL;
-	vlan_iface = NULL;
-	last_iface_id = UINT16_MAX;
-	last_vlan_id = UINT16_MAX;
-
-	for (uint16_t i = 0; i < nb_objs; i++) {
-		m = objs[i];
-
-		eth_in = eth_input_mbuf_data(m);
-		eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
-		rte_pktmbuf_adj(m, sizeof(*eth));
-		eth_type = eth->ether_type;
-		vlan_id = 0;
-
-		if (m->ol_flags & RTE_MBUF_F_RX_VLAN_STRIPPED) {
-			vlan_id = m->vlan_tci & 0xfff;
-		} else if (eth_type == RTE_BE16(RTE_ETHER_TYPE_VLAN)) {
-			vlan = rte_pktmbuf_mtod(m, struct rte_vlan_hdr *);
-			rte_pktmbuf_adj(m, sizeof(*vlan));
-			vlan_id = rte_be_to_cpu_16(vlan->vlan_tci) & 0xfff;
-			eth_type = vlan->eth_proto;
-		}
-		if (vlan_id != 0) {
-			if (eth_in->iface->id != last_iface_id || vlan_id != last_vlan_id) {
-				vlan_iface = vlan_get_iface(eth_in->iface->id, vlan_id);
-				last_iface_id = eth_in->iface->id;
-				last_vlan_id = vlan_id;
+	gr_spec_stream_init(&s, node, nb_objs);
+
+	for (n = 0; n < nb_objs; n += count) {
+		count = RTE_MIN(nb_objs - n, RTE_GRAPH_BURST_SIZE);
+
+		// First pass: strip headers, resolve the input interface and
+		// the next node. Destination addresses are only collected.
+		for (i = 0; i < count; i++) {
+			m = objs[n + i];
+			gr_mbuf_prefetch_ahead(objs, n + i, nb_objs);
+
+			eth_in = eth_input_mbuf_data(m);
+			len = rte_pktmbuf_pkt_len(m);
+			eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+			rte_pktmbuf_adj(m, sizeof(*eth));
+			eth_type = eth->ether_type;
+			dsts[i] = eth_addr_load(&eth->dst_addr);
+			macs[i] = 0;
+			vlan_id = 0;
+
+			if (m->ol_flags & RTE_MBUF_F_RX_VLAN_STRIPPED) {
+				vlan_id = m->vlan_tci & 0xfff;
+			} else if ((vlans || unlikely(eth_type == RTE_BE16(RTE_ETHER_TYPE_VLAN)))
+				   && eth_is_vlan(m->packet_type, eth_type)) {
+				// Without VLAN interfaces, only priority tagged frames
+				// are accepted and the NIC classification is ignored.
+				vlan = rte_pktmbuf_mtod(m, struct rte_vlan_hdr *);
+				rte_pktmbuf_adj(m, sizeof(*vlan));
+				vlan_id = rte_be_to_cpu_16(vlan->vlan_tci) & 0xfff;
+				eth_type = vlan->eth_proto;
+			}
+			if (vlan_id != 0) {
+				vlan_iface = NULL;
+				if (vlans)
+					vlan_iface = vlan_get_iface(eth_in->iface->id, vlan_id);
+				if (vlan_iface == NULL) {
+					edge = UNKNOWN_VLAN;
+					goto next;
+				}
+				eth_in->iface = vlan_iface;
 			}
-			if (vlan_iface == NULL) {
-				edge = UNKNOWN_VLAN;
+			policer = __atomic_load_n(&eth_in->iface->policer, __ATOMIC_ACQUIRE);
+			if (unlikely(policer != NULL)) {
+				if (now == 0)
+					now = rte_rdtsc();
+				if (!policer_check(policer, m, eth_type, len, now)) {
+					edge = POLICED;
+					goto next;
+				}
+			}
+			if (unlikely(eth_in->iface->domain != NULL)) {
+				edge = eth_domain_input(m, eth, eth_type, eth_in->iface->domain);
 				goto next;
 			}
-			eth_in->iface = vlan_iface;
-		}
-		edge = l2l3_edges[eth_type];
+			edge = ptype_edges[m->packet_type & PTYPE_EDGE_MASK];
+			if (edge == UNKNOWN_ETHER_TYPE)
+				edge = l2l3_edges[eth_type];
 
-		if (iface == NULL || iface->id != eth_in->iface->id) {
-			if (iface_get_eth_addr(eth_in->iface->id, &iface_mac) < 0) {
+			mac = eth_addr_load(&eth_in->iface->mac);
+			if (mac == 0) {
+				// interface type without an ethernet address
 				edge = INVALID_IFACE;
 				goto next;
 			}
-			iface = eth_in->iface;
+			macs[i] = mac;
+next:
+			// unknown vlan packets are accounted on the parent interface
+			iface_stats_add(&stats, eth_in->iface->id, len);
+			gr_spec_stream_enqueue(&s, graph, node, objs, n + i, edge);
 		}
-		if (unlikely(rte_is_multicast_ether_addr(&eth->dst_addr))) {
-			if (rte_is_broadcast_ether_addr(&eth->dst_addr))
-				eth_in->eth_dst = ETH_DST_BROADCAST;
-			else
-				eth_in->eth_dst = ETH_DST_MULTICAST;
-		} else if (rte_is_same_ether_addr(&eth->dst_addr, &iface_mac)) {
-			eth_in->eth_dst = ETH_DST_LOCAL;
-		} else {
-			eth_in->eth_dst = ETH_DST_OTHER;
+
+		// Second pass: classify all destination addresses at once.
+		// Dropped packets are classified as well, the result is unused.
+		eth_classify(dsts, macs, types, count);
+		for (i = 0; i < count; i++) {
+			eth_in = eth_input_mbuf_data(objs[n + i]);
+			if (types[i] == ETH_DST_OTHER && unlikely(eth_in->iface->n_ucast > 0))
+				types[i] = eth_ucast_type(eth_in->iface, dsts[i]);
+			eth_in->eth_dst = types[i];
 		}
-next:
-		rte_node_enqueue_x1(graph, node, edge, m);
 	}
+	gr_spec_stream_flush(&s, graph, node);
+	iface_stats_flush(&stats);
 	return nb_objs;
 }
 
+static uint16_t
+eth_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	return eth_input_burst(graph, node, objs, nb_objs, true);
+}
+
+static uint16_t eth_input_novlan_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	return eth_input_burst(graph, node, objs, nb_objs, false);
+}
+
+// Skip the VLAN tag parsing and the VLAN interface lookups when there are no
+// VLAN interfaces.
+static rte_node_process_t eth_input_specialize(void) {
+	if (iface_next(GR_IFACE_TYPE_VLAN, NULL) == NULL)
+		return eth_input_novlan_process;
+	return NULL;
+}
+
+static void eth_input_register(void) {
+	uint16_t bitwidth = rte_vect_get_max_simd_bitwidth();
+	const char *name = "scalar";
+
+#ifdef RTE_ARCH_X86
+	if (bitwidth >= RTE_VECT_SIMD_256 && rte_cpu_get_flag_enabled(RTE_CPUFLAG_AVX2) > 0) {
+		eth_classify = eth_classify_avx2;
+		name = "avx2";
+	} else if (bitwidth >= RTE_VECT_SIMD_128
+		   && rte_cpu_get_flag_enabled(RTE_CPUFLAG_SSE4_1) > 0) {
+		eth_classify = eth_classify_sse;
+		name = "sse4.1";
+	}
+#elif defined(RTE_ARCH_ARM64)
+	if (bitwidth >= RTE_VECT_SIMD_128) {
+		eth_classify = eth_classify_neon;
+		name = "neon";
+	}
+#endif
+	LOG(INFO, "eth_input: %s destination classification (max simd %u bits)", name, bitwidth);
+}
+
 static struct rte_node_register node = {
 	.name = "eth_input",
 	.process = eth_input_process,
@@ -109,12 +423,15 @@ static struct rte_node_register node = {
 		[UNKNOWN_ETHER_TYPE] = "eth_input_unknown_type",
 		[UNKNOWN_VLAN] = "eth_input_unknown_vlan",
 		[INVALID_IFACE] = "eth_input_invalid_iface",
+		[POLICED] = "eth_input_policed",
 		// other edges are updated dynamically with gr_eth_input_add_type
 	},
 };
 
 static struct gr_node_info info = {
 	.node = &node,
+	.register_callback = eth_input_register,
+	.specialize = eth_input_specialize,
 };
 
 GR_NODE_REGISTER(info);
@@ -122,3 +439,4 @@ GR_NODE_REGISTER(info);
 GR_DROP_REGISTER(eth_input_unknown_type);
 GR_DROP_REGISTER(eth_input_unknown_vlan);
 GR_DROP_REGISTER(eth_input_invalid_iface);
+GR_DROP_REGISTER(eth_input_policed);
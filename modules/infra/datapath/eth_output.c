@@ -3,7 +3,9 @@
 
 #include "gr_datapath.h"
 #include "gr_eth_output.h"
+#include "gr_mbuf.h"
 
+#include <gr_bond.h>
 #include <gr_graph.h>
 #include <gr_iface.h>
 #include <gr_log.h>
@@ -12,33 +14,193 @@
 
 #include <rte_ether.h>
 #include <rte_graph_worker.h>
+#include <rte_ip.h>
 
+#include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 enum {
 	TX = 0,
 	INVAL,
 	NO_HEADROOM,
+	GSO,
+	NO_MEMBER,
 	NB_EDGES,
 };
 
+// Indexed by iface type, TX when no tunnel is registered.
+static rte_edge_t tunnel_edges[128] = {TX};
+
+void eth_output_add_tunnel(uint16_t iface_type_id, const char *next_node) {
+	LOG(DEBUG, "eth_output: iface_type=%u -> %s", iface_type_id, next_node);
+	if (iface_type_id == GR_IFACE_TYPE_UNDEF || iface_type_id >= ARRAY_DIM(tunnel_edges))
+		ABORT("invalid iface type=%u", iface_type_id);
+	if (tunnel_edges[iface_type_id] != TX)
+		ABORT("next node already registered for iface type=%u", iface_type_id);
+	tunnel_edges[iface_type_id] = gr_node_attach_parent("eth_output", next_node);
+}
+
+// Locally generated IPv4 headers are flagged with RTE_MBUF_F_TX_IP_CKSUM.
+// Let the hardware compute the checksum, if supported by the egress port.
+// TCP segmentation requests are resolved by port_gso, record the L2 length.
+static inline void eth_tx_cksum(struct rte_mbuf *m, uint8_t l2_len, bool offload) {
+	struct rte_ipv4_hdr *ip;
+
+	if (likely(!(m->ol_flags & (RTE_MBUF_F_TX_IP_CKSUM | RTE_MBUF_F_TX_TCP_SEG))))
+		return;
+	if (unlikely(m->ol_flags & RTE_MBUF_F_TX_TCP_SEG)) {
+		if (m->ol_flags & RTE_MBUF_F_TX_TUNNEL_MASK)
+			m->outer_l2_len = l2_len;
+		else
+			m->l2_len = l2_len;
+		return;
+	}
+	if (offload) {
+		m->l2_len = l2_len;
+		return;
+	}
+	ip = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *, l2_len);
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+	m->ol_flags &= ~(RTE_MBUF_F_TX_IPV4 | RTE_MBUF_F_TX_IP_CKSUM);
+}
+
+// Copy the cached header in front of the packet. Return false if it was not
+// valid or if it was rebuilt or invalidated during the copy.
+static inline bool eth_l2_rewrite_load(
+	const struct eth_l2_rewrite *l2,
+	struct eth_l2_rewrite *copy,
+	struct rte_mbuf *mbuf,
+	uint32_t gen
+) {
+	uint32_t version;
+	void *eth;
+
+	version = __atomic_load_n(&l2->version, __ATOMIC_ACQUIRE);
+	if ((version & 1) || __atomic_load_n(&l2->gen, __ATOMIC_ACQUIRE) != gen)
+		return false;
+
+	copy->len = l2->len;
+	copy->port_id = l2->port_id;
+	copy->vlan_tci = l2->vlan_tci;
+	copy->ip_cksum = l2->ip_cksum;
+	eth = rte_pktmbuf_prepend(mbuf, copy->len);
+	if (unlikely(eth == NULL))
+		return false;
+	if (copy->len == RTE_ETHER_HDR_LEN)
+		memcpy(eth, l2->data, RTE_ETHER_HDR_LEN);
+	else
+		memcpy(eth, l2->data, sizeof(l2->data));
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&l2->version, __ATOMIC_RELAXED) != version) {
+		rte_pktmbuf_adj(mbuf, copy->len);
+		return false;
+	}
+	return true;
+}
+
+// Publish the header of the packet, unless another worker is building it or
+// the destination address of the next hop changed since it was read.
+static inline void eth_l2_rewrite_store(
+	struct eth_l2_rewrite *l2,
+	const struct rte_mbuf *mbuf,
+	uint32_t version,
+	uint8_t len,
+	bool ip_cksum,
+	uint32_t gen
+) {
+	if (version & 1)
+		return;
+	if (!__atomic_compare_exchange_n(
+		    &l2->version, &version, version + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED
+	    ))
+		return;
+	// Readers that already checked the former gen discard their copy because
+	// the version changed.
+	__atomic_store_n(&l2->gen, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	memcpy(l2->data, rte_pktmbuf_mtod(mbuf, const void *), len);
+	l2->len = len;
+	l2->port_id = mbuf->port;
+	l2->ip_cksum = ip_cksum;
+	l2->vlan_tci = mbuf->ol_flags & RTE_MBUF_F_TX_VLAN ? mbuf->vlan_tci : 0;
+	__atomic_store_n(&l2->gen, gen, __ATOMIC_RELEASE);
+
+	version++;
+	if (!__atomic_compare_exchange_n(
+		    &l2->version, &version, version + 1, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED
+	    )) {
+		// Invalidated while building, the destination may be stale.
+		__atomic_store_n(&l2->gen, 0, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&l2->version, 1, __ATOMIC_RELEASE);
+	}
+}
+
 static uint16_t
 eth_output_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct iface_stats_batch stats = {.tx = true};
 	const struct rte_ether_addr *src_mac;
+	const struct iface_info_bond *bond;
 	const struct iface_info_port *port;
 	struct eth_output_mbuf_data *priv;
 	struct iface_info_vlan *sub;
+	struct eth_l2_rewrite copy, *l2;
 	struct rte_vlan_hdr *vlan;
 	struct rte_ether_hdr *eth;
 	struct rte_mbuf *mbuf;
+	uint64_t tx_offloads;
+	uint16_t iface_id;
+	uint16_t port_id;
+	bool ip_cksum;
+	uint32_t gen;
+	uint8_t len;
+
+	gen = __atomic_load_n(&iface_config_gen, __ATOMIC_ACQUIRE);
 
 	for (uint16_t i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
+		gr_mbuf_prefetch_ahead(objs, i, nb_objs);
 		priv = eth_output_mbuf_data(mbuf);
+		iface_id = priv->iface->id;
+		l2 = priv->l2;
 
+		if (l2 != NULL && eth_l2_rewrite_load(l2, &copy, mbuf, gen)) {
+			// Fast path, the complete header was built for a previous packet.
+			mbuf->port = copy.port_id;
+			if (priv->iface->type_id == GR_IFACE_TYPE_BOND) {
+				// The member port depends on the flow, not on the next hop.
+				bond = (const struct iface_info_bond *)priv->iface->info;
+				mbuf->port = bond_tx_port(bond, mbuf->hash.rss);
+				if (unlikely(mbuf->port == RTE_MAX_ETHPORTS)) {
+					rte_node_enqueue_x1(graph, node, NO_MEMBER, mbuf);
+					continue;
+				}
+			}
+			if (copy.vlan_tci != 0) {
+				mbuf->vlan_tci = copy.vlan_tci;
+				mbuf->ol_flags |= RTE_MBUF_F_TX_VLAN;
+			}
+			eth_tx_cksum(mbuf, copy.len, copy.ip_cksum);
+			goto tx;
+		}
+
+		len = sizeof(*eth);
 		switch (priv->iface->type_id) {
 		case GR_IFACE_TYPE_VLAN:
 			sub = (struct iface_info_vlan *)priv->iface->info;
+			priv->iface = sub->parent;
+			src_mac = &sub->mac;
+			port = (const struct iface_info_port *)priv->iface->info;
+			port_id = port->port_id;
+			tx_offloads = port->tx_offloads;
+			if (tx_offloads & RTE_ETH_TX_OFFLOAD_VLAN_INSERT) {
+				// The tag is inserted by hardware, no need to move data.
+				mbuf->vlan_tci = sub->vlan_id;
+				mbuf->ol_flags |= RTE_MBUF_F_TX_VLAN;
+				break;
+			}
 			vlan = (struct rte_vlan_hdr *)rte_pktmbuf_prepend(mbuf, sizeof(*vlan));
 			if (unlikely(vlan == NULL)) {
 				rte_node_enqueue_x1(graph, node, NO_HEADROOM, mbuf);
@@ -47,16 +209,45 @@ eth_output_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 			vlan->vlan_tci = rte_cpu_to_be_16(sub->vlan_id);
 			vlan->eth_proto = priv->ether_type;
 			priv->ether_type = RTE_BE16(RTE_ETHER_TYPE_VLAN);
-			priv->iface = iface_from_id(sub->parent_id);
-			src_mac = &sub->mac;
-			port = (const struct iface_info_port *)priv->iface->info;
+			len += sizeof(*vlan);
 			break;
 		case GR_IFACE_TYPE_PORT:
 			port = (const struct iface_info_port *)priv->iface->info;
 			src_mac = &port->mac;
+			port_id = port->port_id;
+			tx_offloads = port->tx_offloads;
+			break;
+		case GR_IFACE_TYPE_BOND:
+			bond = (const struct iface_info_bond *)priv->iface->info;
+			src_mac = &bond->mac;
+			port_id = bond_tx_port(bond, mbuf->hash.rss);
+			tx_offloads = bond->tx_offloads;
+			if (unlikely(port_id == RTE_MAX_ETHPORTS)) {
+				rte_node_enqueue_x1(graph, node, NO_MEMBER, mbuf);
+				continue;
+			}
 			break;
 		default:
-			rte_node_enqueue_x1(graph, node, INVAL, mbuf);
+			if (priv->iface->type_id >= ARRAY_DIM(tunnel_edges)
+			    || tunnel_edges[priv->iface->type_id] == TX) {
+				rte_node_enqueue_x1(graph, node, INVAL, mbuf);
+				continue;
+			}
+			// L2 tunnel, the frame is encapsulated by the next node.
+			eth = (struct rte_ether_hdr *)rte_pktmbuf_prepend(mbuf, sizeof(*eth));
+			if (unlikely(eth == NULL)) {
+				rte_node_enqueue_x1(graph, node, NO_HEADROOM, mbuf);
+				continue;
+			}
+			eth->dst_addr = priv->dst;
+			eth->src_addr = priv->iface->mac;
+			eth->ether_type = priv->ether_type;
+			// offload flags only apply to the outer headers
+			eth_tx_cksum(mbuf, sizeof(*eth), false);
+			if (unlikely(packet_trace_enabled))
+				trace_packet(node, iface_id, mbuf);
+			iface_stats_add(&stats, iface_id, rte_pktmbuf_pkt_len(mbuf));
+			rte_node_enqueue_x1(graph, node, tunnel_edges[priv->iface->type_id], mbuf);
 			continue;
 		}
 
@@ -68,11 +259,22 @@ eth_output_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 		eth->dst_addr = priv->dst;
 		eth->src_addr = *src_mac;
 		eth->ether_type = priv->ether_type;
-		mbuf->port = port->port_id;
+		mbuf->port = port_id;
+		ip_cksum = tx_offloads & RTE_ETH_TX_OFFLOAD_IPV4_CKSUM;
+		eth_tx_cksum(mbuf, len, ip_cksum);
+		if (l2 != NULL)
+			eth_l2_rewrite_store(l2, mbuf, priv->l2_version, len, ip_cksum, gen);
+tx:
 		if (unlikely(packet_trace_enabled))
-			trace_packet("tx", priv->iface->name, mbuf);
+			trace_packet(node, iface_id, mbuf);
+		iface_stats_add(&stats, iface_id, rte_pktmbuf_pkt_len(mbuf));
+		if (unlikely(mbuf->ol_flags & RTE_MBUF_F_TX_TCP_SEG)) {
+			rte_node_enqueue_x1(graph, node, GSO, mbuf);
+			continue;
+		}
 		rte_node_enqueue_x1(graph, node, TX, mbuf);
 	}
+	iface_stats_flush(&stats);
 
 	return nb_objs;
 }
@@ -87,6 +289,8 @@ static struct rte_node_register node= {
 		[TX] = "port_tx",
 		[INVAL] = "eth_output_inval",
 		[NO_HEADROOM] = "error_no_headroom",
+		[GSO] = "port_gso",
+		[NO_MEMBER] = "eth_output_no_member",
 	},
 };
 
@@ -97,3 +301,4 @@ static struct gr_node_info info = {
 GR_NODE_REGISTER(info);
 
 GR_DROP_REGISTER(eth_output_inval);
+GR_DROP_REGISTER(eth_output_no_member);
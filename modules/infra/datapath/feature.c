@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_feature.h>
+#include <gr_graph.h>
+#include <gr_iface.h>
+#include <gr_log.h>
+#include <gr_stb_ds.h>
+
+#include <string.h>
+
+static struct gr_feature_arc **arcs;
+
+static void arc_add(struct gr_feature_arc *arc) {
+	struct gr_feature_arc **a;
+
+	arrforeach (a, arcs) {
+		if (*a == arc)
+			return;
+	}
+	arrpush(arcs, arc);
+}
+
+// Add a row for a node with edges to all features, except itself.
+static uint8_t arc_node_add(struct gr_feature_arc *arc, const char *node) {
+	uint8_t row;
+
+	if (arc->n_nodes == GR_FEATURE_ARC_MAX_NODES)
+		ABORT("feature arc %s: max number of nodes reached", arc->name);
+
+	row = arc->n_nodes++;
+	arc->nodes[row] = node;
+	for (uint8_t bit = 0; bit < arc->n_features; bit++) {
+		if (strcmp(arc->features[bit]->node, node) == 0)
+			arc->edges[row][bit] = RTE_EDGE_ID_INVALID;
+		else
+			arc->edges[row][bit] = gr_node_attach_parent(
+				node, arc->features[bit]->node
+			);
+	}
+
+	return row;
+}
+
+uint8_t gr_feature_arc_entry(struct gr_feature_arc *arc, const char *node) {
+	LOG(DEBUG, "feature arc %s: entry %s", arc->name, node);
+	arc_add(arc);
+	return arc_node_add(arc, node);
+}
+
+void gr_feature_register(struct gr_feature *f) {
+	struct gr_feature_arc *arc = f->arc;
+	uint8_t pos, bit, row;
+
+	if (arc->n_features == GR_FEATURE_MAX)
+		ABORT("feature arc %s: max number of features reached", arc->name);
+	arc_add(arc);
+
+	for (pos = 0; pos < arc->n_features && arc->features[pos]->order <= f->order; pos++)
+		;
+	// make room for the new feature, bits are in arc order
+	for (bit = arc->n_features; bit > pos; bit--) {
+		arc->features[bit] = arc->features[bit - 1];
+		arc->features[bit]->bit = bit;
+		for (row = 0; row < arc->n_nodes; row++)
+			arc->edges[row][bit] = arc->edges[row][bit - 1];
+	}
+	arc->features[pos] = f;
+	arc->n_features++;
+	f->bit = pos;
+	for (row = 0; row < arc->n_nodes; row++)
+		arc->edges[row][pos] = gr_node_attach_parent(arc->nodes[row], f->node);
+
+	f->row = arc_node_add(arc, f->node);
+
+	LOG(DEBUG, "feature arc %s: feature %s (order=%d)", arc->name, f->node, f->order);
+}
+
+static void arc_set(struct gr_feature_arc *arc, uint16_t iface_id, gr_feature_mask_t mask) {
+	gr_feature_mask_t old = arc->enabled[iface_id];
+
+	if (mask == old)
+		return;
+
+	__atomic_store_n(&arc->enabled[iface_id], mask, __ATOMIC_RELEASE);
+	if (old == 0)
+		__atomic_store_n(&arc->n_ifaces, arc->n_ifaces + 1, __ATOMIC_RELEASE);
+	else if (mask == 0)
+		__atomic_store_n(&arc->n_ifaces, arc->n_ifaces - 1, __ATOMIC_RELEASE);
+}
+
+void gr_feature_enable(struct gr_feature *f, uint16_t iface_id, bool enable) {
+	struct gr_feature_arc *arc = f->arc;
+	gr_feature_mask_t bit = 1U << f->bit;
+
+	if (iface_id >= MAX_IFACES)
+		return;
+
+	if (enable)
+		arc_set(arc, iface_id, arc->enabled[iface_id] | bit);
+	else
+		arc_set(arc, iface_id, arc->enabled[iface_id] & ~bit);
+}
+
+// Interface IDs are reused, do not leave stale bits behind.
+static void feature_iface_event(iface_event_t event, struct iface *iface) {
+	struct gr_feature_arc **a;
+
+	if (event != IFACE_EVENT_PRE_REMOVE)
+		return;
+
+	arrforeach (a, arcs)
+		arc_set(*a, iface->id, 0);
+}
+
+static struct iface_event_handler feature_iface_handler = {
+	.callback = feature_iface_event,
+};
+
+RTE_INIT(feature_constructor) {
+	iface_event_register_handler(&feature_iface_handler);
+}
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_INFRA_BENCH
+#define _GR_INFRA_BENCH
+
+#include <gr_iface.h>
+#include <gr_infra.h>
+
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_mempool.h>
+#include <rte_udp.h>
+
+#include <stdint.h>
+
+#define BENCH_HDR_LEN                                                                              \
+	(sizeof(struct rte_ether_hdr) + sizeof(struct rte_ipv4_hdr) + sizeof(struct rte_udp_hdr))
+// with an 802.1Q tag and an outer IPIP header
+#define BENCH_HDR_MAX_LEN                                                                          \
+	(BENCH_HDR_LEN + sizeof(struct rte_vlan_hdr) + sizeof(struct rte_ipv4_hdr))
+
+// Prebuilt packet headers, immutable once published to the workers.
+struct bench_template {
+	const struct iface *iface;
+	struct rte_mempool *pool;
+	uint16_t port_id;
+	uint16_t pkt_len;
+	uint16_t burst;
+	uint16_t src_port; // host order
+	uint32_t n_flows;
+	uint32_t dst; // host order
+	uint32_t n_dsts;
+	uint16_t vlan_id;
+	uint16_t n_vlans;
+	uint16_t ip_offset; // inner IPv4 header
+	uint16_t hdr_len;
+	uint8_t hdr[BENCH_HDR_MAX_LEN];
+};
+
+// Traffic generator state of one worker. The control plane publishes and
+// clears the template with release stores and resets the other fields only
+// while the template is NULL. Otherwise they are written by the worker alone
+// and read with relaxed loads for GR_INFRA_BENCH_GET.
+struct __rte_cache_aligned bench_worker {
+	// NULL when the source node of this worker is idle
+	const struct bench_template *template;
+	uint32_t flow;
+	uint32_t dst;
+	uint16_t vlan;
+	uint64_t packets;
+	uint64_t no_mbuf;
+	uint64_t sink_packets;
+	uint64_t sink_bytes;
+};
+
+extern struct bench_worker bench_workers[RTE_MAX_LCORE];
+
+// Packets sent to this port by port_tx are diverted to bench_sink.
+// RTE_MAX_ETHPORTS when disabled.
+extern uint16_t bench_sink_port;
+
+// Control plane only.
+int bench_start(const struct gr_infra_bench_start_req *);
+int bench_stop(void);
+struct gr_infra_bench_get_resp *bench_get(size_t *len);
+
+#endif
@@ -13,6 +13,14 @@ GR_MBUF_PRIV_DATA_TYPE(control_input_mbuf_data, { void *data; });
 typedef uint8_t control_input_t;
 
 control_input_t gr_control_input_register_handler(const char *node_name);
+// Returns -ENOBUFS when the control_input ring of the calling thread is full.
 int post_to_stack(control_input_t type, void *data);
 
+struct control_input_stats {
+	uint64_t ring_full; // messages rejected by post_to_stack
+	uint64_t no_mbufs; // processing attempts deferred because of mbuf shortage
+};
+
+void control_input_stats_get(struct control_input_stats *);
+
 #endif
@@ -4,10 +4,183 @@
 #ifndef _GR_INFRA_DATAPATH
 #define _GR_INFRA_DATAPATH
 
+#include <gr_infra.h>
+
+#include <rte_byteorder.h>
+#include <rte_cycles.h>
+#include <rte_graph_worker.h>
 #include <rte_mbuf.h>
+#include <rte_mbuf_dyn.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
 
 void *gr_datapath_loop(void *priv);
 
-void trace_packet(const char *node, const char *iface, const struct rte_mbuf *m);
+// Packet trace snapshot. Workers copy it in a per-worker ring when
+// packet_trace_enabled is set. The control plane decodes it lazily.
+#define TRACE_SNAPLEN 128
+
+struct trace_record {
+	uint64_t timestamp; // TSC value
+	rte_node_t node_id;
+	uint16_t iface_id; // GR_IFACE_ID_UNDEF for drop records
+	uint16_t vlan_id; // only when stripped by hardware
+	uint16_t len; // snapshot length
+	uint32_t pkt_len; // number of packets for drop records
+	uint8_t data[TRACE_SNAPLEN];
+};
+
+void trace_packet(const struct rte_node *node, uint16_t iface_id, const struct rte_mbuf *m);
+void trace_drop(const struct rte_node *node, uint16_t nb_objs);
+// Record a single dropped packet, regardless of packet_trace_enabled. Used to
+// sample the packets freed by the drop nodes.
+void trace_drop_packet(const struct rte_node *node, uint16_t iface_id, const struct rte_mbuf *m);
+
+// Control plane only.
+void trace_configure(uint16_t iface_id, uint32_t sample_rate);
+unsigned trace_dequeue(struct trace_record *records, unsigned n);
+uint64_t trace_ring_full(void);
+ssize_t trace_format(const struct trace_record *r, char *buf, size_t len);
+
+// Time spent by packets between rx and tx, including hold queues. When
+// dwell_enabled is set, port_rx stores a TSC value in an mbuf dynamic field
+// and port_tx records a sample of the elapsed cycles in per-worker log2
+// histograms. The dynamic flag tells apart packets which do not come from
+// port_rx, dynamic fields are not reset when mbufs are allocated.
+extern bool dwell_enabled;
+extern int dwell_tsc_offset;
+extern uint64_t dwell_tsc_flag;
+
+static inline uint64_t *dwell_tsc(struct rte_mbuf *m) {
+	return RTE_MBUF_DYNFIELD(m, dwell_tsc_offset, uint64_t *);
+}
+
+static inline void dwell_stamp(void **mbufs, uint16_t n) {
+	uint64_t now = rte_rdtsc();
+	struct rte_mbuf *m;
+
+	for (uint16_t i = 0; i < n; i++) {
+		m = mbufs[i];
+		*dwell_tsc(m) = now;
+		m->ol_flags |= dwell_tsc_flag;
+	}
+}
+
+void dwell_record(struct rte_mbuf **mbufs, uint16_t n);
+
+// Control plane only.
+void dwell_configure(bool enabled, uint32_t sample_rate);
+uint32_t dwell_get_sample_rate(void);
+// Returns the number of samples since the last reset.
+uint64_t dwell_get(uint64_t hist[GR_INFRA_STATS_HIST_BUCKETS]);
+void dwell_reset(void);
+
+// Drop counters. Each worker counts the packets freed by drop_packets() per
+// drop node and per receiving port. Packets which were not received on a port
+// are counted with DROP_PORT_NONE.
+#define DROP_PORT_NONE RTE_MAX_ETHPORTS
+#define DROP_N_PORTS (DROP_PORT_NONE + 1)
+
+// Control plane only.
+// Copy one dropped packet out of sample_rate to the trace rings, 0 to disable.
+void drop_configure(uint32_t sample_rate);
+uint32_t drop_get_sample_rate(void);
+unsigned drop_max_nodes(void);
+// Returns the number of packets dropped since the last reset.
+uint64_t drop_get(rte_node_t node_id, uint16_t port_id);
+void drop_reset(void);
+
+// Speculative enqueue of a node batch.
+//
+// Most of the time, all packets of a batch go to the same edge. Instead of
+// copying them one by one with rte_node_enqueue_x1(), the whole stream is
+// handed over to the next node with rte_node_next_stream_move() which only
+// swaps pointers when possible. Packets are only copied once the first
+// packet takes a different edge.
+//
+// The speculated edge is the dominant one of the previous batch. It is stored
+// at the end of node->ctx. Nodes using these helpers may only use ctx_ptr.
+//
+// The objs array passed to gr_spec_stream_enqueue() must be the one given to
+// the node process function and packets must be enqueued in order.
+#define GR_SPEC_STREAM_CTX(node) ((node)->ctx + RTE_NODE_CTX_SZ - sizeof(rte_edge_t))
+
+struct gr_spec_stream {
+	rte_edge_t edge; // speculated edge
+	rte_edge_t last; // last edge that was not the speculated one
+	uint16_t nb_objs;
+	uint16_t held; // packets for the speculated edge
+	void **to_next; // NULL as long as all packets took the speculated edge
+};
+
+static inline void
+gr_spec_stream_init(struct gr_spec_stream *s, const struct rte_node *node, uint16_t nb_objs) {
+	memcpy(&s->edge, GR_SPEC_STREAM_CTX(node), sizeof(s->edge));
+	s->last = s->edge;
+	s->nb_objs = nb_objs;
+	s->held = 0;
+	s->to_next = NULL;
+}
+
+// Must be called when a packet does not take the speculated edge, either
+// because it is enqueued elsewhere or because it was consumed by the node.
+static inline void gr_spec_stream_diverge(
+	struct gr_spec_stream *s,
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs
+) {
+	if (s->to_next != NULL)
+		return;
+	s->to_next = rte_node_next_stream_get(graph, node, s->edge, s->nb_objs);
+	// all previous packets took the speculated edge
+	memcpy(s->to_next, objs, s->held * sizeof(*objs));
+}
+
+static inline void gr_spec_stream_enqueue(
+	struct gr_spec_stream *s,
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t i,
+	rte_edge_t edge
+) {
+	if (likely(edge == s->edge)) {
+		if (unlikely(s->to_next != NULL))
+			s->to_next[s->held] = objs[i];
+		s->held++;
+	} else {
+		gr_spec_stream_diverge(s, graph, node, objs);
+		rte_node_enqueue_x1(graph, node, edge, objs[i]);
+		s->last = edge;
+	}
+}
+
+static inline void
+gr_spec_stream_flush(struct gr_spec_stream *s, struct rte_graph *graph, struct rte_node *node) {
+	if (s->to_next == NULL) {
+		if (s->held > 0)
+			rte_node_next_stream_move(graph, node, s->edge);
+	} else {
+		rte_node_next_stream_put(graph, node, s->edge, s->held);
+		// speculate on another edge if most packets did not take this one
+		if (s->held < s->nb_objs / 2)
+			memcpy(GR_SPEC_STREAM_CTX(node), &s->last, sizeof(s->last));
+	}
+}
+
+// Update an internet checksum after a 16-bit word of the covered data changed
+// from old to new, without summing the whole data again (RFC 1624).
+static inline rte_be16_t gr_cksum_update16(rte_be16_t cksum, rte_be16_t old, rte_be16_t new) {
+	uint32_t sum = (uint16_t)~cksum + (uint16_t)~old + new;
+
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+
+	return ~sum;
+}
 
 #endif
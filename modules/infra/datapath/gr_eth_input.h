@@ -24,6 +24,14 @@ GR_MBUF_PRIV_DATA_TYPE(eth_input_mbuf_data, {
 	eth_dst_type_t eth_dst;
 })
 
+// Register the next node for an ether type. For IPv4, IPv6 and ARP, packets
+// classified by the NIC (mbuf->packet_type) are also sent to this node.
+// Nodes that feed decapsulated packets back into the graph must reset
+// mbuf->packet_type since it describes the outer headers.
 void gr_eth_input_add_type(rte_be16_t eth_type, const char *node_name);
+// Register the next node for frames received on members of L2 domains of
+// type domain_type_id (see iface->domain). Frames are handed over with their
+// ethernet header and without VLAN tag.
+void gr_eth_input_add_domain(uint16_t domain_type_id, const char *node_name);
 
 #endif
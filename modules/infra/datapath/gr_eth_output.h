@@ -18,6 +18,24 @@ GR_MBUF_PRIV_DATA_TYPE(eth_output_mbuf_data, {
 	const struct iface *iface;
 	struct rte_ether_addr dst;
 	rte_be16_t ether_type;
+	// cached header for the above fields, may be NULL
+	struct eth_l2_rewrite *l2;
+	uint32_t l2_version; // l2->version when dst was read
 });
 
+// Set the destination address and the cached header of a next hop.
+static inline void eth_output_set_dst(
+	struct eth_output_mbuf_data *d,
+	const struct rte_ether_addr *lladdr,
+	struct eth_l2_rewrite *l2
+) {
+	d->l2_version = eth_l2_rewrite_version(l2);
+	d->dst = *lladdr;
+	d->l2 = l2;
+}
+
+// Send ethernet frames of iface_type_id interfaces to next_node once their
+// header is built, instead of port_tx. Used by L2 tunnels.
+void eth_output_add_tunnel(uint16_t iface_type_id, const char *next_node);
+
 #endif
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_FEATURE
+#define _GR_FEATURE
+
+#include <gr_iface.h>
+
+#include <rte_common.h>
+#include <rte_graph.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Optional per-interface features, modeled on the rte_graph feature arcs.
+//
+// An arc is an ordered list of feature nodes inserted between its entry nodes
+// and the path they would otherwise follow. Each interface has a bitmap of the
+// features enabled on it, in arc order. Entry nodes read the bitmap of the
+// input interface and send the packets to the first enabled feature, or
+// directly to their usual next node when the bitmap is empty. Each feature
+// node then sends the packets to the next enabled feature, the last one
+// chooses the final next node itself.
+//
+// Entry nodes skip the bitmap lookups altogether when no feature of the arc is
+// enabled on any interface. Otherwise, the bitmap is looked up once for each
+// run of consecutive packets received on the same interface, usually once per
+// burst. Enabling a feature on one interface costs the traffic of the other
+// ones nothing more than this lookup.
+//
+// Edges between all nodes of an arc are added when features are registered.
+// Features must be registered from the register_callback of a gr_node_info,
+// before any of them is enabled.
+
+#define GR_FEATURE_MAX 16
+#define GR_FEATURE_ARC_MAX_NODES 32
+
+typedef uint16_t gr_feature_mask_t;
+
+struct gr_feature;
+
+struct gr_feature_arc {
+	const char *name;
+	// Written by the control plane, read by the entry and feature nodes.
+	gr_feature_mask_t enabled[MAX_IFACES];
+	// Number of interfaces with at least one enabled feature.
+	uint16_t n_ifaces;
+	// Registered features, in arc order.
+	uint8_t n_features;
+	struct gr_feature *features[GR_FEATURE_MAX];
+	// Entry and feature nodes, indexed by gr_feature_arc_entry() rows.
+	uint8_t n_nodes;
+	const char *nodes[GR_FEATURE_ARC_MAX_NODES];
+	// Edges from each node to each feature, indexed by row and feature bit.
+	rte_edge_t edges[GR_FEATURE_ARC_MAX_NODES][GR_FEATURE_MAX];
+};
+
+struct gr_feature {
+	struct gr_feature_arc *arc;
+	const char *node;
+	// Features with a lower order run first.
+	int order;
+	// Assigned by gr_feature_register().
+	uint8_t bit;
+	uint8_t row;
+};
+
+// Register a node which sends packets to the features of an arc. Returns the
+// row to pass to gr_feature_arc_edge().
+uint8_t gr_feature_arc_entry(struct gr_feature_arc *, const char *node);
+// Register a feature node in its arc.
+void gr_feature_register(struct gr_feature *);
+// Enable or disable a feature on an interface.
+void gr_feature_enable(struct gr_feature *, uint16_t iface_id, bool enable);
+
+static inline bool gr_feature_arc_active(const struct gr_feature_arc *arc) {
+	return __atomic_load_n(&arc->n_ifaces, __ATOMIC_RELAXED) != 0;
+}
+
+static inline gr_feature_mask_t
+gr_feature_enabled(const struct gr_feature_arc *arc, uint16_t iface_id) {
+	return __atomic_load_n(&arc->enabled[iface_id], __ATOMIC_RELAXED);
+}
+
+// Edge from the node of a row to the first feature of a bitmap. Returns
+// RTE_EDGE_ID_INVALID when the bitmap is empty.
+static inline rte_edge_t
+gr_feature_arc_edge(const struct gr_feature_arc *arc, uint8_t row, gr_feature_mask_t mask) {
+	if (mask == 0)
+		return RTE_EDGE_ID_INVALID;
+	return arc->edges[row][__builtin_ctz(mask)];
+}
+
+// Edge from a feature node to the next enabled feature. Returns
+// RTE_EDGE_ID_INVALID when this feature is the last enabled one.
+static inline rte_edge_t gr_feature_next(const struct gr_feature *f, gr_feature_mask_t mask) {
+	mask &= ~(gr_feature_mask_t)((2U << f->bit) - 1);
+	return gr_feature_arc_edge(f->arc, f->row, mask);
+}
+
+#endif
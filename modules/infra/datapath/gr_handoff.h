@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_HANDOFF
+#define _GR_HANDOFF
+
+#include <rte_build_config.h>
+#include <rte_graph.h>
+#include <rte_mbuf.h>
+#include <rte_mbuf_dyn.h>
+
+#include <stdint.h>
+
+// Steer packets to another datapath worker.
+//
+// Features which need all packets of a flow on the same worker (reassembly,
+// sessions, sequence numbers) set the destination of each packet with
+// handoff_set() and enqueue them to the "handoff" node. Packets are passed
+// through single producer/single consumer rings, one per pair of workers.
+// The "handoff_input" source node of the destination worker drains its
+// inbound rings and forwards the packets to the node registered for their
+// handoff type. Packets destined to the current worker are forwarded directly.
+//
+// The destination is stored in a mbuf dynamic field, the private data of the
+// packets is preserved.
+
+typedef uint8_t handoff_t;
+
+struct handoff_dest {
+	uint16_t lcore_id;
+	handoff_t type;
+};
+
+extern int handoff_offset;
+
+// Register a node which receives handed off packets. Must be called from the
+// register_callback of a gr_node_info.
+handoff_t gr_handoff_register_handler(const char *node_name);
+
+// Worker lcore chosen for a flow hash among the running workers. Returns
+// RTE_MAX_LCORE when no worker is running. The mapping changes when workers
+// are started or stopped.
+unsigned handoff_lcore(uint32_t hash);
+
+static inline struct handoff_dest *handoff_dest(struct rte_mbuf *m) {
+	return RTE_MBUF_DYNFIELD(m, handoff_offset, struct handoff_dest *);
+}
+
+static inline void handoff_set(struct rte_mbuf *m, handoff_t type, unsigned lcore_id) {
+	struct handoff_dest *d = handoff_dest(m);
+	d->lcore_id = lcore_id;
+	d->type = type;
+}
+
+#endif
@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_HOLD_QUEUE
+#define _GR_HOLD_QUEUE
+
+#include <gr_mbuf.h>
+#include <gr_tracepoint.h>
+
+#include <rte_mbuf.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Packets waiting for a next hop resolution.
+//
+// Any number of workers may push packets concurrently without locking. The
+// packets are consumed all at once by atomically detaching the whole list.
+// This is safe from any thread as well. Packets are linked in reverse order
+// and reordered when detached.
+struct hold_queue {
+	struct rte_mbuf *head; // most recently held packet
+	int32_t len; // may be transiently off by the number of concurrent pushes
+	// total number of packets held, flushed after resolution and expired
+	uint32_t held;
+	uint32_t flushed;
+	uint32_t expired;
+};
+
+static inline bool hold_queue_full(const struct hold_queue *q, uint32_t max) {
+	return __atomic_load_n(&q->len, __ATOMIC_RELAXED) >= (int32_t)max;
+}
+
+// Link already held packets in front of the queue. The list from first to
+// last must be linked in reverse order. Returns true if the queue was empty.
+static inline bool hold_queue_link(
+	struct hold_queue *q,
+	struct rte_mbuf *first,
+	struct rte_mbuf *last,
+	uint32_t n
+) {
+	struct rte_mbuf *head = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+
+	do {
+		queue_mbuf_data(last)->next = head;
+	} while (!__atomic_compare_exchange_n(
+		&q->head, &head, first, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED
+	));
+	__atomic_fetch_add(&q->len, n, __ATOMIC_RELAXED);
+
+	return head == NULL;
+}
+
+// Returns true if the queue was empty.
+static inline bool hold_queue_push(struct hold_queue *q, struct rte_mbuf *m, uint64_t now) {
+	bool empty;
+
+	queue_mbuf_data(m)->held_at = now;
+	__atomic_fetch_add(&q->held, 1, __ATOMIC_RELAXED);
+	empty = hold_queue_link(q, m, m, 1);
+	gr_trace_hold_queue_push(q, __atomic_load_n(&q->len, __ATOMIC_RELAXED));
+
+	return empty;
+}
+
+// Detach all packets, oldest first. The caller owns the returned list.
+static inline struct rte_mbuf *hold_queue_take(struct hold_queue *q, uint32_t *count) {
+	struct rte_mbuf *m = __atomic_exchange_n(&q->head, NULL, __ATOMIC_ACQUIRE);
+	struct rte_mbuf *prev = NULL, *next;
+	uint32_t n = 0;
+
+	while (m != NULL) {
+		next = queue_mbuf_data(m)->next;
+		queue_mbuf_data(m)->next = prev;
+		prev = m;
+		m = next;
+		n++;
+	}
+	__atomic_fetch_sub(&q->len, n, __ATOMIC_RELAXED);
+	if (count != NULL)
+		*count = n;
+
+	return prev;
+}
+
+// Detach all packets to send them after resolution.
+static inline struct rte_mbuf *hold_queue_flush(struct hold_queue *q) {
+	struct rte_mbuf *m;
+	uint32_t n;
+
+	m = hold_queue_take(q, &n);
+	if (n > 0)
+		__atomic_fetch_add(&q->flushed, n, __ATOMIC_RELAXED);
+	gr_trace_hold_queue_flush(q, n);
+
+	return m;
+}
+
+// Free packets held for more than timeout TSC cycles. Returns the number of
+// packets that remain in the queue.
+uint32_t hold_queue_expire(struct hold_queue *q, uint64_t now, uint64_t timeout);
+
+// Free all packets.
+void hold_queue_purge(struct hold_queue *q);
+
+#endif
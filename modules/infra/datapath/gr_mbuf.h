@@ -6,9 +6,19 @@
 
 #include <rte_build_config.h>
 #include <rte_mbuf.h>
+#include <rte_prefetch.h>
 
+#include <assert.h>
+#include <stddef.h>
+
+// The private area of all mbufs starts right after struct rte_mbuf. Make sure
+// it begins on a cache line boundary so that it never straddles two lines.
 #define GR_MBUF_PRIV_MAX_SIZE RTE_CACHE_LINE_MIN_SIZE
+static_assert(sizeof(struct rte_mbuf) % RTE_CACHE_LINE_MIN_SIZE == 0);
 
+// All private data types alias the same bytes from offset zero. A node which
+// overwrites the private data of another node loses all of its fields unless
+// its own type is declared with GR_MBUF_PRIV_DATA_EXTENDS().
 #define GR_MBUF_PRIV_DATA_TYPE(type_name, fields)                                                  \
 	struct type_name fields;                                                                   \
 	static inline struct type_name *type_name(struct rte_mbuf *m) {                            \
@@ -16,6 +26,51 @@
 		return rte_mbuf_to_priv(m);                                                        \
 	}
 
-GR_MBUF_PRIV_DATA_TYPE(queue_mbuf_data, { struct rte_mbuf *next; });
+// Declare a private data type which preserves all fields of an earlier one.
+// The base fields are embedded first, at the same offsets, and can be accessed
+// directly. Nodes can fill the new fields without copying the base ones.
+#define GR_MBUF_PRIV_DATA_EXTENDS(type_name, base, fields)                                         \
+	struct type_name {                                                                         \
+		struct base;                                                                       \
+		struct fields;                                                                     \
+	};                                                                                         \
+	static inline struct type_name *type_name(struct rte_mbuf *m) {                            \
+		static_assert(sizeof(struct type_name) <= GR_MBUF_PRIV_MAX_SIZE);                  \
+		return rte_mbuf_to_priv(m);                                                        \
+	}
+
+// Fail the build unless two fields of different private data types occupy the
+// same bytes. To be used by nodes which rely on a field written by another
+// node through a different type.
+#define GR_MBUF_PRIV_OVERLAP(type_a, field_a, type_b, field_b)                                     \
+	static_assert(                                                                             \
+		offsetof(struct type_a, field_a) == offsetof(struct type_b, field_b)               \
+		&& sizeof(((struct type_a *)0)->field_a) == sizeof(((struct type_b *)0)->field_b), \
+		#type_a "." #field_a " does not overlap with " #type_b "." #field_b                \
+	)
+
+// Distances, in packets, at which gr_mbuf_prefetch_ahead() prefetches.
+#define GR_PREFETCH_MBUF_AHEAD 8
+#define GR_PREFETCH_DATA_AHEAD 4
+
+// To be called at the beginning of each iteration of a node loop. The mbuf
+// header is prefetched first. It must be in cache to find the packet data,
+// which is prefetched a few iterations later along with the private area.
+static inline void gr_mbuf_prefetch_ahead(void *const *objs, uint16_t i, uint16_t n) {
+	struct rte_mbuf *m;
+
+	if (i + GR_PREFETCH_MBUF_AHEAD < n)
+		rte_prefetch0(objs[i + GR_PREFETCH_MBUF_AHEAD]);
+	if (i + GR_PREFETCH_DATA_AHEAD < n) {
+		m = objs[i + GR_PREFETCH_DATA_AHEAD];
+		rte_prefetch0(rte_pktmbuf_mtod(m, void *));
+		rte_prefetch0(rte_mbuf_to_priv(m));
+	}
+}
+
+GR_MBUF_PRIV_DATA_TYPE(queue_mbuf_data, {
+	struct rte_mbuf *next;
+	uint64_t held_at; // TSC value when the packet was put in a hold queue
+});
 
 #endif
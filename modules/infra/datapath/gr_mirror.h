@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_INFRA_MIRROR
+#define _GR_INFRA_MIRROR
+
+#include <gr_infra.h>
+#include <gr_token_bucket.h>
+
+#include <rte_build_config.h>
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Received frames are modified in place by the next nodes. The first bytes,
+// where the headers are rewritten, are copied. The rest is shared.
+#define PORT_MIRROR_HDR_LEN 128
+
+// Mirror session of a source port. Never modified by the control plane,
+// replaced as a whole when the configuration changes.
+struct port_mirror {
+	uint16_t dst_port_id;
+	uint8_t flags; // GR_PORT_MIRROR_F_*
+	// the monitor port accepts chained mbufs, copies can share the data
+	bool multi_seg;
+	uint16_t snaplen; // 0 for the whole frame
+	uint32_t rate; // copies per second and per worker, 0 for unlimited
+	struct rte_mempool *pool;
+	// indexed by rte_lcore_id(), only written by that worker
+	struct __rte_cache_aligned {
+		struct token_bucket bucket;
+		uint64_t packets;
+		uint64_t dropped;
+	} lcores[RTE_MAX_LCORE];
+};
+
+// Indexed by source port_id, NULL when the port is not mirrored.
+extern struct port_mirror *port_mirrors[RTE_MAX_ETHPORTS];
+
+// Truncate a packet to len bytes, the segments beyond are freed.
+static inline void port_mirror_truncate(struct rte_mbuf *m, uint32_t len) {
+	struct rte_mbuf *s = m;
+	uint32_t off = 0;
+	uint16_t n_segs = 1;
+
+	if (rte_pktmbuf_pkt_len(m) <= len)
+		return;
+	while (off + s->data_len < len) {
+		off += s->data_len;
+		s = s->next;
+		n_segs++;
+	}
+	s->data_len = len - off;
+	if (s->next != NULL) {
+		rte_pktmbuf_free(s->next);
+		s->next = NULL;
+	}
+	m->pkt_len = len;
+	m->nb_segs = n_segs;
+}
+
+static inline struct rte_mbuf *
+port_mirror_clone(const struct port_mirror *mir, struct rte_mbuf *m, bool rx) {
+	uint32_t room = rte_pktmbuf_data_room_size(mir->pool) - RTE_PKTMBUF_HEADROOM;
+	uint32_t len = rte_pktmbuf_pkt_len(m);
+	struct rte_mbuf *c, *tail;
+	uint32_t hdr;
+
+	if (mir->snaplen != 0)
+		len = RTE_MIN(len, (uint32_t)mir->snaplen);
+
+	if (!mir->multi_seg) {
+		if (rx || m->nb_segs > 1)
+			return rte_pktmbuf_copy(m, mir->pool, 0, RTE_MIN(len, room));
+		if ((c = rte_pktmbuf_clone(m, mir->pool)) != NULL)
+			port_mirror_truncate(c, len);
+		return c;
+	}
+
+	if (!rx) {
+		// sent frames are not modified anymore
+		if ((c = rte_pktmbuf_clone(m, mir->pool)) != NULL)
+			port_mirror_truncate(c, len);
+		return c;
+	}
+
+	hdr = RTE_MIN(len, (uint32_t)PORT_MIRROR_HDR_LEN);
+	if ((c = rte_pktmbuf_copy(m, mir->pool, 0, hdr)) == NULL)
+		return NULL;
+	if (len > hdr && rte_pktmbuf_data_len(m) >= hdr) {
+		if ((tail = rte_pktmbuf_clone(m, mir->pool)) == NULL)
+			goto err;
+		rte_pktmbuf_adj(tail, hdr);
+		port_mirror_truncate(tail, len - hdr);
+		if (rte_pktmbuf_chain(c, tail) < 0) {
+			rte_pktmbuf_free(tail);
+			goto err;
+		}
+	}
+
+	return c;
+err:
+	rte_pktmbuf_free(c);
+	return NULL;
+}
+
+// Copy packets for the monitor port of a mirror session. Returns the number
+// of copies, their port is set to the monitor port.
+static inline uint16_t port_mirror_copy(
+	struct port_mirror *mir,
+	struct rte_mbuf **mbufs,
+	uint16_t n,
+	struct rte_mbuf **copies,
+	bool rx
+) {
+	typeof(mir->lcores[0]) *w = &mir->lcores[rte_lcore_id()];
+	struct rte_mbuf *c;
+	uint16_t n_copies = 0;
+
+	if (mir->rate != 0)
+		token_bucket_refill(&w->bucket, mir->rate, RTE_MAX(mir->rate / 10, 1), rte_rdtsc());
+
+	for (uint16_t i = 0; i < n; i++) {
+		if (mir->rate != 0 && !token_bucket_take(&w->bucket)) {
+			w->dropped++;
+			continue;
+		}
+		if ((c = port_mirror_clone(mir, mbufs[i], rx)) == NULL) {
+			w->dropped++;
+			continue;
+		}
+		if (rx && c->ol_flags & RTE_MBUF_F_RX_VLAN_STRIPPED)
+			c->ol_flags = RTE_MBUF_F_TX_VLAN;
+		else if (rx)
+			c->ol_flags = 0;
+		c->port = mir->dst_port_id;
+		copies[n_copies++] = c;
+	}
+	w->packets += n_copies;
+
+	return n_copies;
+}
+
+#endif
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_NODE_BENCH
+#define _GR_NODE_BENCH
+
+#include <gr_iface.h>
+
+#include <rte_mbuf.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Micro-benchmark of a single node process function.
+//
+// The node is instantiated in a mock graph where each edge leads to a fake
+// node which only collects packets. EAL is not initialized. Only the node
+// sources listed in the benchmark target are linked, the control plane
+// functions they call must be stubbed by each benchmark program.
+//
+// Before every call, all mbufs are reset, their private area is zeroed and
+// prepare() is invoked for each of them. Only the process function call is
+// timed. Samples are the average cycles per packet of a round of calls. The
+// report includes a 95% confidence interval of the mean over all rounds.
+struct node_bench {
+	const char *name;
+	const char *node; // node under test
+	uint16_t burst; // 0 for RTE_GRAPH_BURST_SIZE
+	// Build packet i of the burst. data_len and pkt_len are zero.
+	void (*prepare)(struct rte_mbuf *m, uint16_t i);
+	// Edge node that must receive all packets, NULL to skip the check.
+	const char *expect;
+};
+
+// Allocate a zeroed interface with the next free ID. Aborts on failure.
+struct iface *node_bench_iface_add(uint16_t type_id, uint16_t vrf_id, size_t info_size);
+
+// Invoke the register callbacks of all linked nodes. Must be called once,
+// after the benchmark program stubs are ready to be used.
+void node_bench_init(void);
+
+// Run all benchmarks and print a report line for each of them.
+// Returns EXIT_SUCCESS if all of them passed their checks.
+int node_bench_run(const struct node_bench *, unsigned n);
+
+#endif
@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_INFRA_POLICER
+#define _GR_INFRA_POLICER
+
+#include <gr_infra.h>
+
+#include <rte_byteorder.h>
+#include <rte_common.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_ip6.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_meter.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Meter and counters of one worker. No atomics are required.
+struct __rte_cache_aligned policer_state {
+	union {
+		struct rte_meter_srtcm srtcm;
+		struct rte_meter_trtcm trtcm;
+	};
+	uint64_t packets[RTE_COLORS];
+};
+
+struct iface_policer {
+	uint8_t mode; // GR_POLICER_SRTCM or GR_POLICER_TRTCM
+	uint8_t actions[RTE_COLORS]; // GR_POLICER_PASS, DROP or REMARK
+	uint8_t dscps[RTE_COLORS];
+	// rates divided by the number of workers
+	union {
+		struct rte_meter_srtcm_profile srtcm;
+		struct rte_meter_trtcm_profile trtcm;
+	};
+	struct gr_policer conf;
+	// indexed by rte_lcore_id()
+	struct policer_state states[RTE_MAX_LCORE];
+};
+
+static inline void policer_remark(struct rte_mbuf *m, rte_be16_t eth_type, uint8_t dscp) {
+	struct rte_ipv4_hdr *ip;
+	struct rte_ipv6_hdr *ip6;
+	uint32_t sum, vtc;
+	uint8_t tos;
+
+	switch (eth_type) {
+	case RTE_BE16(RTE_ETHER_TYPE_IPV4):
+		ip = rte_pktmbuf_mtod(m, struct rte_ipv4_hdr *);
+		tos = (dscp << 2) | (ip->type_of_service & 0x3);
+		// incremental checksum update (RFC 1624), tos is the low byte
+		sum = (uint16_t)~rte_be_to_cpu_16(ip->hdr_checksum) + (uint16_t)~ip->type_of_service
+			+ tos;
+		sum = (sum & 0xffff) + (sum >> 16);
+		sum = (sum & 0xffff) + (sum >> 16);
+		ip->hdr_checksum = rte_cpu_to_be_16(~sum);
+		ip->type_of_service = tos;
+		break;
+	case RTE_BE16(RTE_ETHER_TYPE_IPV6):
+		ip6 = rte_pktmbuf_mtod(m, struct rte_ipv6_hdr *);
+		vtc = rte_be_to_cpu_32(ip6->vtc_flow) & ~UINT32_C(0x0fc00000);
+		ip6->vtc_flow = rte_cpu_to_be_32(vtc | ((uint32_t)dscp << 22));
+		break;
+	}
+}
+
+// Meter a received frame with the state of the current worker. The packet
+// data must start at the L3 header. Returns false if the frame must be dropped.
+static inline bool policer_check(
+	struct iface_policer *p,
+	struct rte_mbuf *m,
+	rte_be16_t eth_type,
+	uint32_t len,
+	uint64_t now
+) {
+	struct policer_state *s = &p->states[rte_lcore_id()];
+	enum rte_color color;
+
+	if (p->mode == GR_POLICER_SRTCM)
+		color = rte_meter_srtcm_color_blind_check(&s->srtcm, &p->srtcm, now, len);
+	else
+		color = rte_meter_trtcm_color_blind_check(&s->trtcm, &p->trtcm, now, len);
+	s->packets[color]++;
+
+	switch (p->actions[color]) {
+	case GR_POLICER_DROP:
+		return false;
+	case GR_POLICER_REMARK:
+		policer_remark(m, eth_type, p->dscps[color]);
+		break;
+	}
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_INFRA_PUNT
+#define _GR_INFRA_PUNT
+
+#include "gr_mbuf.h"
+
+#include <gr_iface.h>
+#include <gr_infra.h>
+#include <gr_token_bucket.h>
+
+#include <rte_build_config.h>
+#include <rte_byteorder.h>
+#include <rte_ethdev.h>
+#include <rte_ether.h>
+#include <rte_mempool.h>
+#include <rte_spinlock.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Exception path of an interface. Replaced as a whole when the kernel device
+// changes, only the rate is updated in place.
+struct iface_punt {
+	const struct iface *iface;
+	uint16_t port_id; // virtio-user port connected to the kernel device
+	// The port has a single queue pair. All workers send on it, the first
+	// one that takes rx_lock polls it.
+	rte_spinlock_t tx_lock;
+	rte_spinlock_t rx_lock;
+	struct rte_ether_addr kernel_mac; // destination of punted frames
+	struct rte_ether_addr port_mac; // source of punted frames
+	uint32_t rate; // per worker, 0 for unlimited
+	bool gro; // the port supports PUNT_GRO_OFFLOADS
+	struct rte_mempool *pool; // rx queue
+	struct gr_iface_punt conf;
+	// indexed by rte_lcore_id(), only written by that worker
+	struct __rte_cache_aligned {
+		struct token_bucket bucket;
+		uint64_t punted;
+		uint64_t injected;
+		uint64_t dropped;
+		uint64_t coalesced;
+	} lcores[RTE_MAX_LCORE];
+};
+
+// Required to hand over TCP segments merged by rte_gro to the kernel device.
+#define PUNT_GRO_OFFLOADS                                                                          \
+	(RTE_ETH_TX_OFFLOAD_MULTI_SEGS | RTE_ETH_TX_OFFLOAD_TCP_TSO | RTE_ETH_TX_OFFLOAD_TCP_CKSUM)
+
+// Exception paths polled by punt_input, the first punt_count entries are set.
+// Workers may skip an entry or poll it twice while the control plane removes
+// another one. Removed entries are only freed after an RCU grace period.
+extern struct iface_punt *punt_ifaces[MAX_IFACES];
+extern unsigned punt_count;
+
+GR_MBUF_PRIV_DATA_TYPE(punt_mbuf_data, {
+	struct iface_punt *punt;
+	rte_be16_t ether_type;
+});
+
+// Frames received from the kernel devices are handed over to next_node without
+// their ethernet header. eth_input_mbuf_data.iface is set to the interface of
+// the exception path.
+void punt_input_register_type(rte_be16_t eth_type, const char *next_node);
+
+#endif
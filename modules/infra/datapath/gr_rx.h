@@ -4,11 +4,20 @@
 #ifndef _GR_INFRA_RX
 #define _GR_INFRA_RX
 
+#include <gr_iface.h>
+
+#include <rte_graph.h>
+
 #include <stdint.h>
 
 struct rx_port_queue {
 	uint16_t port_id;
 	uint16_t rxq_id;
+	const struct iface *iface; // NULL if the port has no interface
+	// applied to mbuf->packet_type to clear the layers not reported by the driver
+	uint32_t ptype_mask;
+	// control traffic rxq, never polled beyond its fair share of the burst
+	bool control;
 };
 
 struct rx_node_queues {
@@ -16,4 +25,17 @@ struct rx_node_queues {
 	struct rx_port_queue queues[/* n_queues */];
 };
 
+// Get the port_rx node of a graph.
+struct rte_node *rx_graph_node(const struct rte_graph *);
+
+// Get the RX queues polled by a port_rx node. The queues array is only valid
+// until the next quiescent state report.
+// Returns the number of queues.
+uint16_t rx_node_queues(const struct rte_node *, const struct rx_port_queue **queues);
+
+// Replace the RX queues polled by the port_rx node of a running graph.
+// Returns when no datapath worker is polling the previous queues anymore.
+// Must only be called from the control plane thread.
+int rx_node_queues_update(struct rte_graph *, const struct rx_node_queues *);
+
 #endif
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_INFRA_SAMPLE
+#define _GR_INFRA_SAMPLE
+
+#include <gr_iface.h>
+#include <gr_net_types.h>
+
+#include <rte_common.h>
+#include <rte_ip6.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_random.h>
+#include <rte_ring.h>
+
+#include <stdint.h>
+#include <string.h>
+
+// Bytes of the packet copied in each sample, starting at the L3 header.
+#define SAMPLE_HEADER_LEN 128
+
+// Header snippet and forwarding metadata of a sampled packet. Copied by value
+// in the per-worker rings.
+struct sample {
+	uint32_t skip; // packets seen since the previous sample on this worker
+	uint32_t frame_len;
+	uint16_t iface_id;
+	uint16_t out_iface_id; // GR_IFACE_ID_UNDEF when not forwarded
+	uint16_t vrf_id;
+	uint8_t af; // AF_INET or AF_INET6
+	uint8_t header_len;
+	union {
+		ip4_addr_t ip4;
+		struct rte_ipv6_addr ip6;
+	} nh; // zero when not forwarded
+	uint8_t header[SAMPLE_HEADER_LEN];
+};
+
+static_assert(sizeof(struct sample) % 4 == 0);
+
+// 1-in-N sampling of the packets received on an interface. Never modified by
+// the control plane, replaced as a whole when the rate changes.
+struct iface_sampler {
+	uint32_t rate;
+	// indexed by rte_lcore_id(), only written by that worker
+	struct __rte_cache_aligned {
+		uint32_t countdown;
+		uint32_t skip;
+	} lcores[RTE_MAX_LCORE];
+};
+
+// Flow samples taken by one worker. The worker fills the staging sample in
+// place, pushes it into the single producer ring and counts the samples lost
+// when the ring is full. The sflow control plane is the only ring consumer and
+// reads lost with relaxed loads.
+struct __rte_cache_aligned sample_worker {
+	struct rte_ring *ring; // single producer, drained by the control plane
+	uint64_t lost;
+	struct sample staging;
+};
+
+extern struct sample_worker sample_workers[RTE_MAX_LCORE];
+
+// Random interval with an average of rate, sampling must not synchronize
+// with periodic traffic patterns.
+static inline uint32_t sample_next_skip(uint32_t rate) {
+	if (rate <= 1)
+		return 1;
+	return 1 + rte_rand_max(2 * (uint64_t)rate - 1);
+}
+
+// Decrement the countdown of the current worker. When it reaches zero, return
+// the staging sample of the worker with the packet header already copied. The
+// caller fills the metadata and hands it to sample_push().
+static inline struct sample *sample_take(struct iface_sampler *s, const struct rte_mbuf *m) {
+	unsigned lcore_id = rte_lcore_id();
+	struct sample *sample;
+	const void *data;
+	uint32_t len;
+
+	if (likely(--s->lcores[lcore_id].countdown != 0))
+		return NULL;
+
+	sample = &sample_workers[lcore_id].staging;
+	sample->skip = s->lcores[lcore_id].skip;
+	s->lcores[lcore_id].skip = sample_next_skip(s->rate);
+	s->lcores[lcore_id].countdown = s->lcores[lcore_id].skip;
+
+	sample->frame_len = rte_pktmbuf_pkt_len(m);
+	len = RTE_MIN(sample->frame_len, (uint32_t)SAMPLE_HEADER_LEN);
+	data = rte_pktmbuf_read(m, 0, len, sample->header);
+	if (data != sample->header)
+		memcpy(sample->header, data, len);
+	sample->header_len = len;
+
+	return sample;
+}
+
+static inline void sample_push(const struct sample *sample) {
+	struct sample_worker *w = &sample_workers[rte_lcore_id()];
+
+	if (w->ring == NULL || rte_ring_sp_enqueue_elem(w->ring, sample, sizeof(*sample)) < 0)
+		w->lost++;
+}
+
+#endif
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_TOKEN_BUCKET
+#define _GR_TOKEN_BUCKET
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Token bucket owned by a single datapath worker. No locking is required.
+// Packed to fit in the node context area along with other fields.
+// A zeroed bucket is filled up to burst on the first refill.
+struct token_bucket {
+	uint64_t last; // TSC value of the last refill
+	uint32_t tokens;
+} __rte_packed;
+
+// Add the tokens earned since the last refill, up to burst.
+// rate is the number of tokens earned per second and must not be zero.
+static inline void
+token_bucket_refill(struct token_bucket *tb, uint32_t rate, uint32_t burst, uint64_t now) {
+	uint64_t hz = rte_get_tsc_hz();
+	uint64_t elapsed = now - tb->last;
+	uint64_t n;
+
+	if (elapsed >= hz) {
+		// idle for more than a second, avoid overflows
+		tb->tokens = RTE_MIN((uint64_t)tb->tokens + rate, (uint64_t)burst);
+		tb->last = now;
+		return;
+	}
+	n = elapsed * rate / hz;
+	if (n == 0)
+		return; // keep the fractional time for the next refill
+	tb->tokens = RTE_MIN(tb->tokens + n, (uint64_t)burst);
+	tb->last += n * hz / rate;
+}
+
+// Consume one token. Returns false if the bucket is empty.
+static inline bool token_bucket_take(struct token_bucket *tb) {
+	if (tb->tokens == 0)
+		return false;
+	tb->tokens--;
+	return true;
+}
+
+#endif
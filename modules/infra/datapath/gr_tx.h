@@ -5,11 +5,61 @@
 #define _GR_INFRA_TX
 
 #include <rte_build_config.h>
+#include <rte_graph.h>
+#include <rte_mempool.h>
+#include <rte_ring.h>
+#include <rte_sched.h>
 
 #include <stdint.h>
 
+struct tx_ring_drain {
+	uint16_t port_id;
+	struct rte_ring *ring;
+};
+
+struct tx_port_policy {
+	uint16_t iface_id;
+	uint8_t type; // GR_PORT_TX_*
+	uint16_t limit;
+};
+
+// Egress scheduler of a port. rte_sched is not thread safe, all packets are
+// enqueued and dequeued by a single worker. Other workers classify them and
+// hand them over through the ring.
+struct tx_sched {
+	struct rte_sched_port *port;
+	// multiple producers, drained by the scheduler worker
+	struct rte_ring *ring;
+	uint8_t classify; // GR_PORT_QOS_*
+	uint16_t pipe_mask;
+	// only written by the scheduler worker
+	uint64_t enqueued;
+	uint64_t dropped;
+};
+
 struct tx_node_queues {
 	uint16_t txq_ids[RTE_MAX_ETHPORTS];
+	struct tx_port_policy policies[RTE_MAX_ETHPORTS];
+	// non-NULL when the txq is owned by another worker
+	struct rte_ring *rings[RTE_MAX_ETHPORTS];
+	// rings of the shared txqs owned by this worker, drained by port_tx_drain
+	uint16_t n_drains;
+	struct tx_ring_drain drains[RTE_MAX_ETHPORTS];
+	// non-NULL when the port has a scheduler
+	struct tx_sched *scheds[RTE_MAX_ETHPORTS];
+	// ports whose scheduler runs on this worker, serviced by port_tx_drain
+	uint16_t n_scheds;
+	uint16_t sched_ports[RTE_MAX_ETHPORTS];
+	// non-NULL when the txq returns sent mbufs to this pool in bulk
+	struct rte_mempool *fast_free_pools[RTE_MAX_ETHPORTS];
 };
 
+struct worker;
+
+// Replace the TX queues used by the port_tx and port_tx_drain nodes of a running graph.
+// The packets waiting on the txqs that did not change are kept. Returns when the
+// worker has switched to the new queues and is not using the previous ones anymore.
+// Must only be called from the control plane thread.
+int tx_node_queues_update(struct worker *, struct rte_graph *, const struct tx_node_queues *);
+
 #endif
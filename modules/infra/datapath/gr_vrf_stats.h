@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_VRF_STATS
+#define _GR_VRF_STATS
+
+#include <rte_branch_prediction.h>
+#include <rte_common.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+
+#include <stdint.h>
+
+// Per-VRF forwarding counters, updated by ip_input and ip6_input.
+//
+// Each worker owns its counters and updates them without locking. Packets of
+// a burst are accounted per run of consecutive packets in the same VRF so that
+// most bursts only touch a single counter.
+//
+// Optionally, one packet out of a sample rate is accounted to its destination
+// prefix (the destination address masked to a fixed length) in a per-worker
+// Space-Saving table of the most frequent prefixes. The FIB is not involved.
+
+// Same value as IP4_MAX_VRFS and IP6_MAX_VRFS.
+#define VRF_STATS_MAX_VRFS 256
+// Number of entries of the per-worker top prefixes tables.
+#define VRF_STATS_TOP_SIZE 64
+
+typedef enum {
+	VRF_STATS_IP4,
+	VRF_STATS_IP6,
+	VRF_STATS_AF_COUNT,
+} vrf_stats_af_t;
+
+struct vrf_counters {
+	uint64_t packets;
+	uint64_t bytes;
+};
+
+struct vrf_stats_worker {
+	// indexed by address family and VRF ID, see vrf_stats_get()
+	struct vrf_counters *counters;
+	uint32_t sample_count;
+} __rte_cache_aligned;
+
+extern struct vrf_stats_worker vrf_stats_workers[RTE_MAX_LCORE];
+// zero when top prefixes accounting is disabled
+extern uint32_t vrf_stats_sample_rate;
+
+// Account sampled packets to their destination prefix. Only called when
+// vrf_stats_sample_rate is not zero.
+void vrf_stats_sample(
+	struct vrf_stats_worker *,
+	vrf_stats_af_t,
+	struct rte_mbuf **mbufs,
+	const uint16_t *vrfs,
+	uint16_t count,
+	uint32_t rate
+);
+
+// Account a burst of packets to their VRF. The mbufs data must point at the L3 header.
+static inline void vrf_stats_count(
+	vrf_stats_af_t af,
+	struct rte_mbuf **mbufs,
+	const uint16_t *vrfs,
+	uint16_t count
+) {
+	struct vrf_stats_worker *w = &vrf_stats_workers[rte_lcore_id()];
+	uint32_t rate = __atomic_load_n(&vrf_stats_sample_rate, __ATOMIC_RELAXED);
+	uint64_t packets = 0, bytes = 0;
+	struct vrf_counters *c;
+	uint16_t vrf_id;
+
+	if (unlikely(w->counters == NULL) || count == 0)
+		return;
+
+	c = &w->counters[af * VRF_STATS_MAX_VRFS];
+	vrf_id = vrfs[0];
+	for (uint16_t i = 0; i < count; i++) {
+		if (unlikely(vrfs[i] != vrf_id)) {
+			c[vrf_id % VRF_STATS_MAX_VRFS].packets += packets;
+			c[vrf_id % VRF_STATS_MAX_VRFS].bytes += bytes;
+			packets = bytes = 0;
+			vrf_id = vrfs[i];
+		}
+		packets++;
+		bytes += rte_pktmbuf_pkt_len(mbufs[i]);
+	}
+	c[vrf_id % VRF_STATS_MAX_VRFS].packets += packets;
+	c[vrf_id % VRF_STATS_MAX_VRFS].bytes += bytes;
+
+	if (unlikely(rate != 0))
+		vrf_stats_sample(w, af, mbufs, vrfs, count, rate);
+}
+
+// Control plane API.
+struct vrf_stats_prefix {
+	uint16_t vrf_id;
+	vrf_stats_af_t af;
+	uint8_t prefixlen;
+	uint8_t addr[16]; // destination address masked to prefixlen
+	uint64_t packets; // estimated number of packets, including error
+	uint64_t error; // overestimation upper bound
+};
+
+// Received packets and bytes since the last reset, merged from all workers.
+void vrf_stats_get(vrf_stats_af_t, uint16_t vrf_id, struct vrf_counters *);
+void vrf_stats_reset(void);
+
+// Enable top prefixes accounting when sample_rate is not zero. Changing the
+// prefix lengths clears the top prefixes tables.
+void vrf_stats_top_configure(uint32_t sample_rate, uint8_t ip4_prefixlen, uint8_t ip6_prefixlen);
+void vrf_stats_top_config(uint32_t *sample_rate, uint8_t *ip4_prefixlen, uint8_t *ip6_prefixlen);
+// Merge the top prefixes tables of all workers, sorted by decreasing number
+// of packets. Returns the number of prefixes stored in the array (at most
+// max), or a negative errno value.
+int vrf_stats_top_get(uint16_t vrf_id, struct vrf_stats_prefix *prefixes, unsigned max);
+
+#endif
@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_datapath.h"
+#include "gr_mbuf.h"
+
+#include <gr_graph.h>
+#include <gr_iface.h>
+#include <gr_log.h>
+#include <gr_mempool.h>
+#include <gr_port.h>
+
+#include <rte_ethdev.h>
+#include <rte_graph_worker.h>
+#include <rte_gso.h>
+#include <rte_ip.h>
+#include <rte_malloc.h>
+#include <rte_tcp.h>
+#include <rte_udp.h>
+
+enum {
+	TX = 0,
+	UNSUPPORTED,
+	ERROR,
+	EDGE_COUNT,
+};
+
+// Enough for a 64K TCP segment with the minimum GSO size.
+#define GSO_SEGS_MAX 128
+
+#define GSO_TX_FLAGS                                                                               \
+	(RTE_MBUF_F_TX_TCP_SEG | RTE_MBUF_F_TX_TCP_CKSUM | RTE_MBUF_F_TX_IPV4                      \
+	 | RTE_MBUF_F_TX_IP_CKSUM | RTE_MBUF_F_TX_OUTER_IPV4                                       \
+	 | RTE_MBUF_F_TX_OUTER_IP_CKSUM | RTE_MBUF_F_TX_TUNNEL_MASK)
+
+// TSO offload required by the egress port to segment the packet in hardware.
+static inline uint64_t gso_tso_offload(const struct rte_mbuf *m) {
+	switch (m->ol_flags & RTE_MBUF_F_TX_TUNNEL_MASK) {
+	case RTE_MBUF_F_TX_TUNNEL_IPIP:
+		return RTE_ETH_TX_OFFLOAD_IPIP_TNL_TSO;
+	case RTE_MBUF_F_TX_TUNNEL_VXLAN:
+		return RTE_ETH_TX_OFFLOAD_VXLAN_TNL_TSO;
+	case RTE_MBUF_F_TX_TUNNEL_GRE:
+		return RTE_ETH_TX_OFFLOAD_GRE_TNL_TSO;
+	case 0:
+		return RTE_ETH_TX_OFFLOAD_TCP_TSO;
+	}
+	return 0;
+}
+
+static inline void gso_ipv4_cksum(struct rte_ipv4_hdr *ip) {
+	ip->hdr_checksum = 0;
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+}
+
+// Resolve all checksums of a segment in software and clear the offload flags.
+static void gso_cksum(struct rte_mbuf *m) {
+	struct rte_ipv4_hdr *ip;
+	struct rte_tcp_hdr *tcp;
+	struct rte_udp_hdr *udp;
+	uint16_t off = 0;
+
+	if (m->ol_flags & RTE_MBUF_F_TX_OUTER_IPV4) {
+		ip = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *, m->outer_l2_len);
+		gso_ipv4_cksum(ip);
+		off = m->outer_l2_len + m->outer_l3_len;
+		if ((m->ol_flags & RTE_MBUF_F_TX_TUNNEL_MASK) == RTE_MBUF_F_TX_TUNNEL_VXLAN) {
+			// optional over IPv4, the template checksum is stale anyway
+			udp = rte_pktmbuf_mtod_offset(m, struct rte_udp_hdr *, off);
+			udp->dgram_cksum = 0;
+		}
+	}
+	off += m->l2_len;
+	ip = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *, off);
+	gso_ipv4_cksum(ip);
+	tcp = rte_pktmbuf_mtod_offset(m, struct rte_tcp_hdr *, off + m->l3_len);
+	tcp->cksum = 0;
+	tcp->cksum = rte_ipv4_udptcp_cksum_mbuf(m, ip, off + m->l3_len);
+	m->ol_flags &= ~GSO_TX_FLAGS;
+}
+
+// rte_gso does not support IPIP. The outer headers are segmented as if they
+// were part of the L2 header, their length and checksum are fixed afterwards.
+static void gso_ipip_fixup(struct rte_mbuf *m, uint16_t outer_l2_len) {
+	struct rte_ipv4_hdr *outer;
+
+	outer = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *, outer_l2_len);
+	outer->total_length = rte_cpu_to_be_16(rte_pktmbuf_pkt_len(m) - outer_l2_len);
+	gso_ipv4_cksum(outer);
+}
+
+static uint16_t
+gso_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct rte_mbuf *segs[GSO_SEGS_MAX];
+	struct rte_gso_ctx *ctx = node->ctx_ptr;
+	const struct iface_info_port *port;
+	uint16_t hdr_len, ipip_l2_len;
+	const struct iface *iface;
+	struct rte_mbuf *mbuf;
+	uint64_t offload;
+	int n;
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+		iface = port_get_iface(mbuf->port);
+		if (iface == NULL) {
+			rte_node_enqueue_x1(graph, node, ERROR, mbuf);
+			continue;
+		}
+		port = (const struct iface_info_port *)iface->info;
+
+		offload = gso_tso_offload(mbuf);
+		if (offload & port->tx_offloads) {
+			// segmented by hardware
+			rte_node_enqueue_x1(graph, node, TX, mbuf);
+			continue;
+		}
+		if (offload == 0 || !(mbuf->ol_flags & RTE_MBUF_F_TX_IPV4)) {
+			rte_node_enqueue_x1(graph, node, UNSUPPORTED, mbuf);
+			continue;
+		}
+
+		hdr_len = mbuf->l2_len + mbuf->l3_len + mbuf->l4_len;
+		ipip_l2_len = 0;
+		if (mbuf->ol_flags & RTE_MBUF_F_TX_TUNNEL_MASK)
+			hdr_len += mbuf->outer_l2_len + mbuf->outer_l3_len;
+		if (offload == RTE_ETH_TX_OFFLOAD_IPIP_TNL_TSO) {
+			ipip_l2_len = mbuf->outer_l2_len;
+			mbuf->l2_len += mbuf->outer_l2_len + mbuf->outer_l3_len;
+			mbuf->outer_l2_len = 0;
+			mbuf->outer_l3_len = 0;
+			mbuf->ol_flags &= ~(RTE_MBUF_F_TX_TUNNEL_MASK | RTE_MBUF_F_TX_OUTER_IPV4);
+		}
+
+		ctx->gso_size = hdr_len + mbuf->tso_segsz;
+		n = rte_gso_segment(mbuf, ctx, segs, ARRAY_DIM(segs));
+		if (n < 0) {
+			rte_node_enqueue_x1(graph, node, ERROR, mbuf);
+			continue;
+		}
+		if (n == 0) {
+			// already small enough
+			segs[0] = mbuf;
+			n = 1;
+		} else {
+			// segments hold a reference on the original payload
+			rte_pktmbuf_free(mbuf);
+		}
+
+		for (int j = 0; j < n; j++) {
+			struct rte_mbuf *s = segs[j];
+			if (ipip_l2_len != 0)
+				gso_ipip_fixup(s, ipip_l2_len);
+			gso_cksum(s);
+			if (!(port->tx_offloads & RTE_ETH_TX_OFFLOAD_MULTI_SEGS)
+			    && rte_pktmbuf_linearize(s) < 0) {
+				rte_node_enqueue_x1(graph, node, ERROR, s);
+				continue;
+			}
+			rte_node_enqueue_x1(graph, node, TX, s);
+		}
+	}
+
+	return nb_objs;
+}
+
+static int gso_init(const struct rte_graph *graph, struct rte_node *node) {
+	struct rte_gso_ctx *ctx;
+
+	ctx = rte_zmalloc_socket(__func__, sizeof(*ctx), RTE_CACHE_LINE_SIZE, graph->socket);
+	if (ctx == NULL) {
+		LOG(ERR, "rte_zmalloc_socket(): %s", rte_strerror(rte_errno));
+		return -ENOMEM;
+	}
+	ctx->direct_pool = gr_pktmbuf_pool_get(graph->socket, RTE_GRAPH_BURST_SIZE);
+	if (ctx->direct_pool == NULL) {
+		rte_free(ctx);
+		return errno_log(errno, "gr_pktmbuf_pool_get(port_gso)");
+	}
+	ctx->indirect_pool = ctx->direct_pool;
+	ctx->gso_types = RTE_ETH_TX_OFFLOAD_TCP_TSO | RTE_ETH_TX_OFFLOAD_VXLAN_TNL_TSO
+		| RTE_ETH_TX_OFFLOAD_GRE_TNL_TSO;
+	node->ctx_ptr = ctx;
+
+	return 0;
+}
+
+static void gso_fini(const struct rte_graph *, struct rte_node *node) {
+	struct rte_gso_ctx *ctx = node->ctx_ptr;
+
+	if (ctx == NULL)
+		return;
+	gr_pktmbuf_pool_release(ctx->direct_pool, RTE_GRAPH_BURST_SIZE);
+	rte_free(ctx);
+	node->ctx_ptr = NULL;
+}
+
+static struct rte_node_register node = {
+	.name = "port_gso",
+	.process = gso_process,
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[TX] = "port_tx",
+		[UNSUPPORTED] = "port_gso_unsupported",
+		[ERROR] = "port_gso_error",
+	},
+	.init = gso_init,
+	.fini = gso_fini,
+};
+
+static struct gr_node_info info = {
+	.node = &node,
+};
+
+GR_NODE_REGISTER(info);
+
+GR_DROP_REGISTER(port_gso_unsupported);
+GR_DROP_REGISTER(port_gso_error);
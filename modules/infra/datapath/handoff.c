@@ -0,0 +1,292 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_control.h>
+#include <gr_graph.h>
+#include <gr_handoff.h>
+#include <gr_log.h>
+
+#include <rte_errno.h>
+#include <rte_graph_worker.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_mbuf_dyn.h>
+#include <rte_ring.h>
+#include <rte_spinlock.h>
+
+#include <stdalign.h>
+#include <stdio.h>
+
+enum {
+	UNKNOWN_HANDOFF_TYPE = 0,
+	RING_FULL,
+	NO_WORKER,
+	EDGE_COUNT,
+};
+
+#define HANDOFF_RING_SIZE (RTE_GRAPH_BURST_SIZE * 8)
+
+int handoff_offset = -1;
+
+static handoff_t next_type;
+static rte_edge_t handoff_edges[1 << 8] = {UNKNOWN_HANDOFF_TYPE};
+static rte_edge_t input_edges[1 << 8] = {UNKNOWN_HANDOFF_TYPE};
+
+// Indexed by destination and source lcore. Rings are created when a worker is
+// started and kept until exit so that producers never see a freed ring.
+static struct rte_ring *handoff_rings[RTE_MAX_LCORE][RTE_MAX_LCORE];
+
+// Lcores running a datapath worker, only modified with handoff_lock held.
+static rte_spinlock_t handoff_lock = RTE_SPINLOCK_INITIALIZER;
+static bool handoff_active[RTE_MAX_LCORE];
+// sorted by lcore ID, see handoff_lcore()
+static uint16_t handoff_lcores[RTE_MAX_LCORE];
+static unsigned handoff_n_lcores;
+
+handoff_t gr_handoff_register_handler(const char *node_name) {
+	if (next_type == 0xff)
+		ABORT("handoff: max number of handlers reached");
+	LOG(DEBUG, "handoff: type=%hhu -> %s", next_type, node_name);
+	handoff_edges[next_type] = gr_node_attach_parent("handoff", node_name);
+	input_edges[next_type] = gr_node_attach_parent("handoff_input", node_name);
+	return next_type++;
+}
+
+unsigned handoff_lcore(uint32_t hash) {
+	unsigned n = __atomic_load_n(&handoff_n_lcores, __ATOMIC_ACQUIRE);
+
+	if (n == 0)
+		return RTE_MAX_LCORE;
+
+	return handoff_lcores[hash % n];
+}
+
+static uint16_t
+handoff_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	unsigned self = rte_lcore_id();
+	uint16_t start, run, sent;
+	struct rte_ring *ring;
+	struct rte_mbuf *m;
+	unsigned dst;
+	uint16_t i;
+
+	i = 0;
+	while (i < nb_objs) {
+		// consecutive packets for the same worker are enqueued in one burst
+		start = i;
+		dst = handoff_dest(objs[i])->lcore_id;
+		while (++i < nb_objs && handoff_dest(objs[i])->lcore_id == dst)
+			;
+		run = i - start;
+
+		if (dst == self) {
+			for (uint16_t j = start; j < i; j++) {
+				m = objs[j];
+				rte_node_enqueue_x1(
+					graph, node, handoff_edges[handoff_dest(m)->type], m
+				);
+			}
+			continue;
+		}
+
+		if (dst >= RTE_MAX_LCORE || (ring = handoff_rings[dst][self]) == NULL) {
+			rte_node_enqueue(graph, node, NO_WORKER, &objs[start], run);
+			continue;
+		}
+
+		sent = rte_ring_sp_enqueue_burst(ring, &objs[start], run, NULL);
+		if (unlikely(sent < run))
+			rte_node_enqueue(graph, node, RING_FULL, &objs[start + sent], run - sent);
+	}
+
+	return nb_objs;
+}
+
+static uint16_t handoff_input_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void ** /*objs*/,
+	uint16_t /*nb_objs*/
+) {
+	unsigned n_lcores = __atomic_load_n(&handoff_n_lcores, __ATOMIC_ACQUIRE);
+	struct rte_mbuf *mbufs[RTE_GRAPH_BURST_SIZE];
+	uint16_t *first = (uint16_t *)node->ctx;
+	unsigned self = rte_lcore_id();
+	struct rte_ring *ring;
+	unsigned count = 0;
+	struct rte_mbuf *m;
+	uint16_t src;
+
+	if (n_lcores < 2)
+		return 0;
+
+	// Start from a different source at each call so that a busy worker
+	// does not starve the others.
+	*first = (*first + 1) % n_lcores;
+	for (unsigned i = 0; i < n_lcores && count < RTE_DIM(mbufs); i++) {
+		src = handoff_lcores[(*first + i) % n_lcores];
+		if (src == self || (ring = handoff_rings[self][src]) == NULL)
+			continue;
+		count += rte_ring_sc_dequeue_burst(
+			ring, (void **)&mbufs[count], RTE_DIM(mbufs) - count, NULL
+		);
+	}
+
+	for (unsigned i = 0; i < count; i++) {
+		m = mbufs[i];
+		rte_node_enqueue_x1(graph, node, input_edges[handoff_dest(m)->type], m);
+	}
+
+	return count;
+}
+
+static struct rte_ring *handoff_ring_create(unsigned dst, unsigned src) {
+	unsigned socket_id = rte_lcore_to_socket_id(dst);
+	char name[RTE_RING_NAMESIZE];
+	struct rte_ring *ring;
+	ssize_t size;
+
+	if ((size = rte_ring_get_memsize(HANDOFF_RING_SIZE)) < 0)
+		ABORT("rte_ring_get_memsize: %s", rte_strerror(-size));
+
+	// The number of rings grows with the square of the number of workers.
+	// Do not reserve a memzone for each of them.
+	ring = rte_zmalloc_socket(__func__, size, RTE_CACHE_LINE_SIZE, socket_id);
+	if (ring == NULL)
+		ABORT("rte_zmalloc(handoff ring): %s", rte_strerror(rte_errno));
+
+	snprintf(name, sizeof(name), "handoff_%u_%u", src, dst);
+	if (rte_ring_init(ring, name, HANDOFF_RING_SIZE, RING_F_SP_ENQ | RING_F_SC_DEQ) < 0)
+		ABORT("rte_ring_init(%s): %s", name, rte_strerror(rte_errno));
+
+	return ring;
+}
+
+static void handoff_ring_flush(struct rte_ring *ring) {
+	void *objs[RTE_GRAPH_BURST_SIZE];
+	unsigned n;
+
+	while ((n = rte_ring_dequeue_burst(ring, objs, RTE_DIM(objs), NULL)) > 0)
+		rte_pktmbuf_free_bulk((struct rte_mbuf **)objs, n);
+}
+
+static void handoff_init_dp(void) {
+	unsigned lcore_id = rte_lcore_id();
+	unsigned i, other;
+
+	rte_spinlock_lock(&handoff_lock);
+	if (handoff_active[lcore_id])
+		goto out;
+
+	for (i = 0; i < handoff_n_lcores; i++) {
+		other = handoff_lcores[i];
+		if (handoff_rings[lcore_id][other] == NULL)
+			handoff_rings[lcore_id][other] = handoff_ring_create(lcore_id, other);
+		if (handoff_rings[other][lcore_id] == NULL)
+			handoff_rings[other][lcore_id] = handoff_ring_create(other, lcore_id);
+	}
+
+	// Keep the lcores sorted so that flows are steered to the same workers
+	// after a graph reload.
+	for (i = handoff_n_lcores; i > 0 && handoff_lcores[i - 1] > lcore_id; i--)
+		handoff_lcores[i] = handoff_lcores[i - 1];
+	handoff_lcores[i] = lcore_id;
+	__atomic_store_n(&handoff_n_lcores, handoff_n_lcores + 1, __ATOMIC_RELEASE);
+	handoff_active[lcore_id] = true;
+out:
+	rte_spinlock_unlock(&handoff_lock);
+}
+
+static void handoff_fini_dp(void) {
+	unsigned lcore_id = rte_lcore_id();
+	unsigned i;
+
+	rte_spinlock_lock(&handoff_lock);
+	if (!handoff_active[lcore_id])
+		goto out;
+
+	for (i = 0; i < handoff_n_lcores && handoff_lcores[i] != lcore_id; i++)
+		;
+	for (; i + 1 < handoff_n_lcores; i++)
+		handoff_lcores[i] = handoff_lcores[i + 1];
+	__atomic_store_n(&handoff_n_lcores, handoff_n_lcores - 1, __ATOMIC_RELEASE);
+	handoff_active[lcore_id] = false;
+
+	// The inbound rings are kept as is. Packets already handed off to this
+	// worker are processed when it runs a graph again.
+out:
+	rte_spinlock_unlock(&handoff_lock);
+}
+
+static void handoff_init(struct event_base *) {
+	static const struct rte_mbuf_dynfield field_desc = {
+		.name = "grout_handoff",
+		.size = sizeof(struct handoff_dest),
+		.align = alignof(struct handoff_dest),
+	};
+
+	handoff_offset = rte_mbuf_dynfield_register(&field_desc);
+	if (handoff_offset < 0)
+		ABORT("rte_mbuf_dynfield_register(handoff): %s", rte_strerror(rte_errno));
+}
+
+static void handoff_fini(struct event_base *) {
+	for (unsigned dst = 0; dst < RTE_MAX_LCORE; dst++) {
+		for (unsigned src = 0; src < RTE_MAX_LCORE; src++) {
+			if (handoff_rings[dst][src] == NULL)
+				continue;
+			handoff_ring_flush(handoff_rings[dst][src]);
+			rte_free(handoff_rings[dst][src]);
+			handoff_rings[dst][src] = NULL;
+		}
+	}
+	handoff_n_lcores = 0;
+}
+
+static struct gr_module handoff_module = {
+	.name = "handoff",
+	.init = handoff_init,
+	.fini = handoff_fini,
+	.init_dp = handoff_init_dp,
+	.fini_dp = handoff_fini_dp,
+};
+
+static struct rte_node_register handoff_node = {
+	.name = "handoff",
+	.process = handoff_process,
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[UNKNOWN_HANDOFF_TYPE] = "handoff_unknown_type",
+		[RING_FULL] = "handoff_ring_full",
+		[NO_WORKER] = "handoff_no_worker",
+	},
+};
+
+static struct gr_node_info handoff_info = {
+	.node = &handoff_node,
+};
+
+GR_NODE_REGISTER(handoff_info);
+
+static struct rte_node_register input_node = {
+	.flags = RTE_NODE_SOURCE_F,
+	.name = "handoff_input",
+	.process = handoff_input_process,
+	.nb_edges = 1,
+	.next_nodes = {[UNKNOWN_HANDOFF_TYPE] = "handoff_unknown_type"},
+};
+
+static struct gr_node_info input_info = {
+	.node = &input_node,
+};
+
+GR_NODE_REGISTER(input_info);
+
+RTE_INIT(handoff_constructor) {
+	gr_register_module(&handoff_module);
+}
+
+GR_DROP_REGISTER(handoff_unknown_type);
+GR_DROP_REGISTER(handoff_ring_full);
+GR_DROP_REGISTER(handoff_no_worker);
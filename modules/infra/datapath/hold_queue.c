@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_hold_queue.h>
+#include <gr_mbuf.h>
+
+#include <rte_mbuf.h>
+
+uint32_t hold_queue_expire(struct hold_queue *q, uint64_t now, uint64_t timeout) {
+	struct rte_mbuf *m, *next, *keep = NULL, *tail = NULL;
+	uint32_t n_kept = 0, n_expired = 0;
+
+	for (m = hold_queue_take(q, NULL); m != NULL; m = next) {
+		next = queue_mbuf_data(m)->next;
+		if (now - queue_mbuf_data(m)->held_at > timeout) {
+			rte_pktmbuf_free(m);
+			n_expired++;
+			continue;
+		}
+		// rebuild the list in reverse order, like hold_queue_push
+		queue_mbuf_data(m)->next = keep;
+		if (keep == NULL)
+			tail = m;
+		keep = m;
+		n_kept++;
+	}
+
+	if (n_expired > 0)
+		__atomic_fetch_add(&q->expired, n_expired, __ATOMIC_RELAXED);
+
+	// Put back the remaining packets. The ones that were held meanwhile by
+	// workers will be sent first.
+	if (keep != NULL)
+		hold_queue_link(q, keep, tail, n_kept);
+
+	return n_kept;
+}
+
+void hold_queue_purge(struct hold_queue *q) {
+	struct rte_mbuf *m, *next;
+
+	for (m = hold_queue_take(q, NULL); m != NULL; m = next) {
+		next = queue_mbuf_data(m)->next;
+		rte_pktmbuf_free(m);
+	}
+}
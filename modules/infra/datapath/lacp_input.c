@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_eth_input.h"
+
+#include <gr_bond.h>
+#include <gr_graph.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_graph_worker.h>
+#include <rte_mbuf.h>
+
+enum {
+	INVALID = 0,
+	QUEUE_FULL,
+	EDGE_COUNT,
+};
+
+static inline bool lacp_valid(const struct rte_mbuf *m, const struct lacpdu *pdu) {
+	if (rte_pktmbuf_data_len(m) < sizeof(*pdu))
+		return false;
+	if (pdu->subtype != LACP_SUBTYPE)
+		return false;
+	if (pdu->actor.tlv_type != LACP_TLV_ACTOR
+	    || pdu->actor.tlv_len != sizeof(struct lacp_participant))
+		return false;
+	if (pdu->partner.tlv_type != LACP_TLV_PARTNER
+	    || pdu->partner.tlv_len != sizeof(struct lacp_participant))
+		return false;
+	return true;
+}
+
+// LACPDUs are processed by the control plane. Other slow protocols (marker,
+// OAM) are not supported.
+static uint16_t
+lacp_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	const struct lacpdu *pdu;
+	struct rte_mbuf *mbuf;
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+		pdu = rte_pktmbuf_mtod(mbuf, const struct lacpdu *);
+
+		if (!lacp_valid(mbuf, pdu)) {
+			rte_node_enqueue_x1(graph, node, INVALID, mbuf);
+			continue;
+		}
+		// mbuf->port is the member on which the PDU was received, the
+		// input interface is the bond itself.
+		if (bond_lacp_input(mbuf->port, pdu) < 0) {
+			rte_node_enqueue_x1(graph, node, QUEUE_FULL, mbuf);
+			continue;
+		}
+		rte_pktmbuf_free(mbuf);
+	}
+
+	return nb_objs;
+}
+
+static void lacp_input_register(void) {
+	gr_eth_input_add_type(RTE_BE16(RTE_ETHER_TYPE_SLOW), "lacp_input");
+}
+
+static struct rte_node_register node = {
+	.name = "lacp_input",
+	.process = lacp_input_process,
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[INVALID] = "lacp_input_invalid",
+		[QUEUE_FULL] = "lacp_input_queue_full",
+	},
+};
+
+static struct gr_node_info info = {
+	.node = &node,
+	.register_callback = lacp_input_register,
+};
+
+GR_NODE_REGISTER(info);
+
+GR_DROP_REGISTER(lacp_input_invalid);
+GR_DROP_REGISTER(lacp_input_queue_full);
@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_control_input.h"
+#include "gr_eth_output.h"
+
+#include <gr_bond.h>
+#include <gr_graph.h>
+#include <gr_log.h>
+#include <gr_port.h>
+
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_graph_worker.h>
+#include <rte_mbuf.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+	OUTPUT = 0,
+	ERROR,
+	EDGE_COUNT,
+};
+
+struct lacp_tx_msg {
+	uint16_t port_id;
+	struct lacpdu pdu;
+};
+
+static control_input_t lacp_tx;
+
+int lacp_output_send(uint16_t port_id, const struct lacpdu *pdu) {
+	struct lacp_tx_msg *tx;
+	int ret;
+
+	if ((tx = malloc(sizeof(*tx))) == NULL)
+		return errno_set(ENOMEM);
+	tx->port_id = port_id;
+	tx->pdu = *pdu;
+
+	if ((ret = post_to_stack(lacp_tx, tx)) < 0)
+		free(tx);
+
+	return ret;
+}
+
+static uint16_t
+lacp_output_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	static const struct rte_ether_addr dst = LACP_DST_MAC;
+	struct eth_output_mbuf_data *eth_data;
+	const struct iface *iface;
+	struct lacp_tx_msg *tx;
+	struct rte_mbuf *mbuf;
+	struct lacpdu *pdu;
+	rte_edge_t edge;
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+		// eth_output_mbuf_data overlaps with control_input_mbuf_data
+		tx = control_input_mbuf_data(mbuf)->data;
+
+		// The member may have been removed since the PDU was posted.
+		iface = port_get_iface(tx->port_id);
+		if (iface == NULL) {
+			edge = ERROR;
+			goto next;
+		}
+		pdu = (struct lacpdu *)rte_pktmbuf_append(mbuf, sizeof(*pdu));
+		if (pdu == NULL) {
+			edge = ERROR;
+			goto next;
+		}
+		memcpy(pdu, &tx->pdu, sizeof(*pdu));
+
+		// Sent directly on the member port, not on the bond.
+		eth_data = eth_output_mbuf_data(mbuf);
+		eth_data->iface = iface;
+		eth_data->dst = dst;
+		eth_data->ether_type = RTE_BE16(RTE_ETHER_TYPE_SLOW);
+		eth_data->l2 = NULL;
+		edge = OUTPUT;
+next:
+		free(tx);
+		rte_node_enqueue_x1(graph, node, edge, mbuf);
+	}
+
+	return nb_objs;
+}
+
+static void lacp_output_register(void) {
+	lacp_tx = gr_control_input_register_handler("lacp_output");
+}
+
+static struct rte_node_register node = {
+	.name = "lacp_output",
+	.process = lacp_output_process,
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[OUTPUT] = "eth_output",
+		[ERROR] = "lacp_output_error",
+	},
+};
+
+static struct gr_node_info info = {
+	.node = &node,
+	.register_callback = lacp_output_register,
+};
+
+GR_NODE_REGISTER(info);
+
+GR_DROP_REGISTER(lacp_output_error);
@@ -4,88 +4,109 @@
 #include <gr.h>
 #include <gr_control.h>
 #include <gr_datapath.h>
+#include <gr_infra.h>
 #include <gr_log.h>
+#include <gr_rcu.h>
+#include <gr_rx.h>
+#include <gr_tracepoint.h>
 #include <gr_worker.h>
 
 #include <rte_atomic.h>
+#include <rte_bitops.h>
 #include <rte_common.h>
+#include <rte_cpuflags.h>
+#include <rte_cycles.h>
 #include <rte_eal.h>
+#include <rte_epoll.h>
 #include <rte_errno.h>
+#include <rte_ethdev.h>
 #include <rte_graph.h>
 #include <rte_graph_worker.h>
 #include <rte_lcore.h>
 #include <rte_malloc.h>
+#include <rte_pause.h>
+#include <rte_power_intrinsics.h>
+#include <rte_rcu_qsbr.h>
 
 #include <pthread.h>
 #include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
 #include <sys/prctl.h>
 #include <sys/queue.h>
 #include <unistd.h>
 
+// Per graph node context, indexed like the nodes of the current graph.
+struct node_totals {
+	// graph node counters values at the previous update
+	uint64_t objs;
+	uint64_t calls;
+	uint64_t cycles;
+	// index of the node in worker_stats.stats
+	uint32_t index;
+};
+
 struct stats_context {
-	struct rte_graph_cluster_stats *stats;
-	uint64_t last_count;
 	struct worker_stats *w_stats;
-	uint8_t node_to_index[256];
+	struct node_totals *prev;
+	unsigned n_prev;
+	// worker_stats.stats index + 1, indexed by node id
+	uint32_t *node_to_index;
+	// slowest node call of the current graph walk
+	rte_node_t slowest_node;
+	uint64_t slowest_cycles;
 };
 
-static int node_stats_callback(
-	bool /*is_first*/,
-	bool /*is_last*/,
-	void *cookie,
-	const struct rte_graph_cluster_node_stats *stats
-) {
-	struct stats_context *ctx = cookie;
-	struct node_stats *s;
-	uint64_t objs_incr;
-	uint8_t index;
-
-	objs_incr = stats->objs - stats->prev_objs;
-	ctx->last_count += objs_incr;
-	index = ctx->node_to_index[stats->id];
-	s = &ctx->w_stats->stats[index];
-	s->objs += objs_incr;
-	s->calls += stats->calls - stats->prev_calls;
-	s->cycles += stats->cycles - stats->prev_cycles;
-
-	return 0;
-}
-
 static inline void stats_reset(struct worker_stats *stats) {
 	for (unsigned i = 0; i < stats->n_stats; i++) {
 		struct node_stats *s = &stats->stats[i];
 		s->objs = 0;
 		s->calls = 0;
 		s->cycles = 0;
+		memset(s->cycles_hist, 0, sizeof(s->cycles_hist));
+		memset(s->objs_hist, 0, sizeof(s->objs_hist));
 	}
 	stats->sleep_cycles = 0;
 	stats->n_sleeps = 0;
+	stats->walk_max_cycles = 0;
+	memset(stats->walk_hist, 0, sizeof(stats->walk_hist));
+	stats->n_stalls = 0;
 }
 
-static int stats_reload(const struct rte_graph *graph, struct stats_context *ctx) {
-	struct rte_graph_cluster_stats_param stats_param;
-	const char *graph_names[1];
-
-	assert(graph != NULL);
-
-	if (ctx->stats != NULL) {
-		rte_graph_cluster_stats_destroy(ctx->stats);
-		ctx->stats = NULL;
+// Accumulate the graph nodes counters into the worker stats.
+// Returns the number of packets processed since the previous call.
+static uint64_t stats_update(const struct rte_graph *graph, struct stats_context *ctx) {
+	struct node_totals *prev;
+	struct node_stats *s;
+	struct rte_node *node;
+	rte_graph_off_t off;
+	uint64_t objs, total;
+	rte_node_t count;
+
+	total = 0;
+	rte_graph_foreach_node (count, off, graph, node) {
+		prev = &ctx->prev[count];
+		s = &ctx->w_stats->stats[prev->index];
+		objs = node->total_objs - prev->objs;
+		s->objs += objs;
+		s->calls += node->total_calls - prev->calls;
+		s->cycles += node->total_cycles - prev->cycles;
+		prev->objs = node->total_objs;
+		prev->calls = node->total_calls;
+		prev->cycles = node->total_cycles;
+		total += objs;
 	}
 
-	graph_names[0] = graph->name;
-	memset(&stats_param, 0, sizeof(stats_param));
-	stats_param.socket_id = graph->socket;
-	stats_param.nb_graph_patterns = 1;
-	stats_param.graph_patterns = graph_names;
-	stats_param.cookie = ctx;
-	stats_param.fn = node_stats_callback;
+	return total;
+}
 
-	ctx->stats = rte_graph_cluster_stats_create(&stats_param);
-	if (ctx->stats == NULL) {
-		LOG(ERR, "rte_graph_cluster_stats_create: %s", rte_strerror(rte_errno));
-		return -rte_errno;
-	}
+static int stats_reload(const struct rte_graph *graph, struct stats_context *ctx) {
+	struct rte_node *node;
+	rte_graph_off_t off;
+	rte_node_t count;
+
+	assert(graph != NULL);
 
 	if (ctx->w_stats == NULL) {
 		size_t len = sizeof(*ctx->w_stats) + graph->nb_nodes * sizeof(*ctx->w_stats->stats);
@@ -98,29 +119,331 @@ static int stats_reload(const struct rte_graph *graph, struct stats_context *ctx
 		}
 		ctx->w_stats->n_stats = graph->nb_nodes;
 
-		struct rte_node *node;
-		rte_graph_off_t off;
-		rte_node_t count;
-		rte_graph_foreach_node (count, off, graph, node) {
-			ctx->node_to_index[node->id] = count;
+		rte_graph_foreach_node (count, off, graph, node)
 			ctx->w_stats->stats[count].node_id = node->id;
+	}
+
+	if (ctx->n_prev < graph->nb_nodes) {
+		rte_free(ctx->prev);
+		ctx->prev = rte_zmalloc_socket(
+			__func__,
+			graph->nb_nodes * sizeof(*ctx->prev),
+			RTE_CACHE_LINE_SIZE,
+			graph->socket
+		);
+		if (ctx->prev == NULL) {
+			LOG(ERR, "rte_zmalloc_socket: %s", rte_strerror(rte_errno));
+			return -rte_errno;
+		}
+		ctx->n_prev = graph->nb_nodes;
+	}
+
+	// Resolve the worker stats index of each graph node once so that the
+	// periodic update only walks two arrays sequentially.
+	if (ctx->node_to_index == NULL) {
+		ctx->node_to_index = calloc(rte_node_max_count(), sizeof(*ctx->node_to_index));
+		if (ctx->node_to_index == NULL) {
+			LOG(ERR, "calloc: %s", strerror(errno));
+			return -errno;
+		}
+		for (uint32_t i = 0; i < ctx->w_stats->n_stats; i++)
+			ctx->node_to_index[ctx->w_stats->stats[i].node_id] = i + 1;
+	}
+
+	rte_graph_foreach_node (count, off, graph, node) {
+		if (node->id >= rte_node_max_count() || ctx->node_to_index[node->id] == 0) {
+			LOG(ERR, "node %s missing from worker stats", node->name);
+			return -ENOENT;
+		}
+		ctx->prev[count].index = ctx->node_to_index[node->id] - 1;
+		// the counters of a new graph start from zero
+		ctx->prev[count].objs = node->total_objs;
+		ctx->prev[count].calls = node->total_calls;
+		ctx->prev[count].cycles = node->total_cycles;
+	}
+
+	return 0;
+}
+
+static inline unsigned hist_bucket(uint64_t value) {
+	if (value == 0)
+		return 0;
+	return RTE_MIN(64 - rte_clz64(value), GR_INFRA_STATS_HIST_BUCKETS - 1);
+}
+
+// Same as rte_graph_walk() but also record the slowest node call and, if hist
+// is set, per call histograms of the number of cycles and objects. The node
+// total counters are updated identically.
+static inline void
+graph_walk_instrumented(struct rte_graph *graph, struct stats_context *ctx, bool hist) {
+	const rte_graph_off_t *cir_start = graph->cir_start;
+	const rte_node_t mask = graph->cir_mask;
+	uint32_t head = graph->head;
+	uint64_t start, cycles;
+	struct node_stats *s;
+	struct rte_node *node;
+	uint16_t rc;
+
+	while (likely(head != graph->tail)) {
+		node = RTE_PTR_ADD(graph, cir_start[(int32_t)head++]);
+		RTE_ASSERT(node->fence == RTE_GRAPH_FENCE);
+		rte_prefetch0(node->objs);
+		start = rte_rdtsc();
+		rc = node->process(graph, node, node->objs, node->idx);
+		cycles = rte_rdtsc() - start;
+		node->total_cycles += cycles;
+		node->total_calls++;
+		node->total_objs += rc;
+		node->idx = 0;
+		if (cycles > ctx->slowest_cycles) {
+			ctx->slowest_cycles = cycles;
+			ctx->slowest_node = node->id;
+		}
+		if (hist) {
+			s = &ctx->w_stats->stats[ctx->node_to_index[node->id] - 1];
+			s->cycles_hist[hist_bucket(cycles)]++;
+			s->objs_hist[hist_bucket(rc)]++;
+		}
+		head = likely((int32_t)head > 0) ? head & mask : head;
+	}
+	graph->tail = 0;
+}
+
+// Record the duration of a graph walk. Walks longer than the threshold are
+// logged along with the slowest node call.
+static inline void walk_record(struct stats_context *ctx, uint64_t cycles, uint64_t threshold) {
+	struct worker_stats *stats = ctx->w_stats;
+	struct worker_stall *stall;
+
+	stats->walk_hist[hist_bucket(cycles)]++;
+	if (cycles > stats->walk_max_cycles)
+		stats->walk_max_cycles = cycles;
+	if (cycles >= threshold) {
+		stall = &stats->stalls[stats->n_stalls % ARRAY_DIM(stats->stalls)];
+		stall->tsc = rte_rdtsc();
+		stall->cycles = cycles;
+		stall->node_id = ctx->slowest_node;
+		stall->node_cycles = ctx->slowest_cycles;
+		stats->n_stalls++;
+	}
+	ctx->slowest_cycles = 0;
+}
+
+struct power_context {
+	// port_rx node of the current graph and its context when the queues
+	// were copied, the control plane may replace it at any time
+	const struct rte_node *rx_node;
+	const void *rx_ctx;
+	// copy of the RX queues of the current graph
+	struct rx_port_queue *queues;
+	uint16_t n_queues;
+	// all queues are registered in the thread epoll instance
+	bool intr;
+	// the next RX descriptor address of all queues can be monitored
+	bool monitor;
+	// size of the queues and pmc arrays
+	uint16_t max_queues;
+	struct rte_power_monitor_cond *pmc;
+	struct rte_cpu_intrinsics cpu;
+	struct rte_epoll_event wakeup;
+};
+
+static void intr_unregister(struct power_context *ctx, uint16_t n_queues) {
+	for (uint16_t i = 0; i < n_queues; i++) {
+		const struct rx_port_queue *q = &ctx->queues[i];
+		rte_eth_dev_rx_intr_ctl_q(
+			q->port_id, q->rxq_id, RTE_EPOLL_PER_THREAD, RTE_INTR_EVENT_DEL, NULL
+		);
+	}
+	ctx->intr = false;
+}
+
+// Register the RX queues of a graph in the thread epoll instance.
+// Interrupts are only used if all queues support them.
+static void intr_register(struct power_context *ctx) {
+	const struct rx_port_queue *q;
+	uint16_t i;
+	int ret;
+
+	for (i = 0; i < ctx->n_queues; i++) {
+		q = &ctx->queues[i];
+		ret = rte_eth_dev_rx_intr_ctl_q(
+			q->port_id, q->rxq_id, RTE_EPOLL_PER_THREAD, RTE_INTR_EVENT_ADD, NULL
+		);
+		if (ret < 0) {
+			LOG(NOTICE,
+			    "port %u rxq %u: rx interrupts unavailable: %s",
+			    q->port_id,
+			    q->rxq_id,
+			    rte_strerror(-ret));
+			intr_unregister(ctx, i);
+			return;
+		}
+	}
+
+	ctx->intr = true;
+}
+
+// Forget about the RX queues of the current graph before it is released.
+static void power_release(struct power_context *ctx) {
+	if (ctx->intr)
+		intr_unregister(ctx, ctx->n_queues);
+	ctx->rx_node = NULL;
+	ctx->rx_ctx = NULL;
+	ctx->n_queues = 0;
+	ctx->monitor = false;
+}
+
+// Must be called while online (between two quiescent state reports).
+static int
+power_reload(const struct rte_graph *graph, const struct worker *w, struct power_context *ctx) {
+	const struct rx_port_queue *queues, *q;
+	uint16_t i, n_queues;
+
+	ctx->rx_node = rx_graph_node(graph);
+	ctx->rx_ctx = ctx->rx_node != NULL ? ctx->rx_node->ctx_ptr : NULL;
+	n_queues = rx_node_queues(ctx->rx_node, &queues);
+
+	if (ctx->max_queues < n_queues) {
+		rte_free(ctx->queues);
+		rte_free(ctx->pmc);
+		ctx->queues = rte_calloc_socket(
+			__func__, n_queues, sizeof(*ctx->queues), 0, graph->socket
+		);
+		ctx->pmc = rte_calloc_socket(
+			__func__, n_queues, sizeof(*ctx->pmc), 0, graph->socket
+		);
+		if (ctx->queues == NULL || ctx->pmc == NULL) {
+			ctx->max_queues = 0;
+			LOG(ERR, "rte_calloc_socket: %s", rte_strerror(rte_errno));
+			return -rte_errno;
 		}
+		ctx->max_queues = n_queues;
+	}
+	memcpy(ctx->queues, queues, n_queues * sizeof(*queues));
+	ctx->n_queues = n_queues;
+
+	if (w->wakeup_fd >= 0)
+		intr_register(ctx);
+
+	if (ctx->n_queues == 1)
+		ctx->monitor = ctx->cpu.power_monitor;
+	else
+		ctx->monitor = ctx->n_queues > 1 && ctx->cpu.power_monitor_multi;
+	for (i = 0; i < ctx->n_queues && ctx->monitor; i++) {
+		q = &ctx->queues[i];
+		if (rte_eth_get_monitor_addr(q->port_id, q->rxq_id, &ctx->pmc[i]) < 0)
+			ctx->monitor = false;
 	}
 
 	return 0;
 }
 
+// Resolve the power policy requested by the control plane into one that can
+// actually be used with the current graph.
+static unsigned power_resolve(unsigned power, const struct power_context *ctx) {
+	switch (power) {
+	case GR_WORKER_POWER_AUTO:
+		if (gr_args()->poll_mode)
+			return GR_WORKER_POWER_POLL;
+		if (ctx->intr)
+			return GR_WORKER_POWER_INTR;
+		break;
+	case GR_WORKER_POWER_POLL:
+	case GR_WORKER_POWER_PAUSE:
+		return power;
+	case GR_WORKER_POWER_INTR:
+		if (ctx->intr)
+			return power;
+		break;
+	case GR_WORKER_POWER_MONITOR:
+		if (ctx->monitor)
+			return power;
+		break;
+	}
+	return GR_WORKER_POWER_SLEEP;
+}
+
+#define INTR_WAIT_TIMEOUT_MS 1000
+
+// Arm the RX interrupts and block until one of them fires or until the
+// control plane wakes us up.
+static void intr_wait(struct worker *w, struct power_context *ctx) {
+	struct rte_epoll_event events[8];
+	const struct rx_port_queue *q;
+	uint16_t i, n_armed;
+	uint64_t val;
+	int ret;
+
+	for (n_armed = 0; n_armed < ctx->n_queues; n_armed++) {
+		q = &ctx->queues[n_armed];
+		if (rte_eth_dev_rx_intr_enable(q->port_id, q->rxq_id) < 0)
+			goto disable;
+	}
+	// Packets received before arming may not trigger any interrupt.
+	for (i = 0; i < ctx->n_queues; i++) {
+		q = &ctx->queues[i];
+		if (rte_eth_rx_queue_count(q->port_id, q->rxq_id) > 0)
+			goto disable;
+	}
+	if (atomic_load(&w->shutdown) || atomic_load(&w->next_config) != w->cur_config)
+		goto disable;
+
+	ret = rte_epoll_wait(RTE_EPOLL_PER_THREAD, events, RTE_DIM(events), INTR_WAIT_TIMEOUT_MS);
+	if (ret < 0 && errno != EINTR)
+		LOG(ERR, "[CPU %d] rte_epoll_wait: %s", w->cpu_id, strerror(errno));
+
+	while (read(w->wakeup_fd, &val, sizeof(val)) > 0)
+		;
+disable:
+	for (i = 0; i < n_armed; i++) {
+		q = &ctx->queues[i];
+		rte_eth_dev_rx_intr_disable(q->port_id, q->rxq_id);
+	}
+}
+
+// Wait until the NIC writes the next RX descriptor of any queue or until
+// the deadline expires.
+static void monitor_wait(struct power_context *ctx, uint64_t deadline) {
+	const struct rx_port_queue *q;
+
+	// the monitored address changes after every received packet
+	for (uint16_t i = 0; i < ctx->n_queues; i++) {
+		q = &ctx->queues[i];
+		if (rte_eth_get_monitor_addr(q->port_id, q->rxq_id, &ctx->pmc[i]) < 0)
+			return;
+	}
+	if (ctx->n_queues == 1)
+		rte_power_monitor(&ctx->pmc[0], deadline);
+	else
+		rte_power_monitor_multi(ctx->pmc, ctx->n_queues, deadline);
+}
+
+static void pause_wait(const struct power_context *ctx, uint64_t deadline) {
+	if (ctx->cpu.power_pause) {
+		rte_power_pause(deadline);
+	} else {
+		while (rte_rdtsc() < deadline)
+			rte_pause();
+	}
+}
+
 // The default timer resolution is around 50us, make it more precise
 #define SLEEP_RESOLUTION_NS 1000
 
 void *gr_datapath_loop(void *priv) {
-	struct stats_context ctx = {.last_count = 0};
-	uint64_t timestamp, timestamp_tmp, cycles;
-	uint32_t sleep, max_sleep_us;
+	uint32_t sleep, max_sleep_us, stats_interval;
+	uint64_t timestamp, timestamp_tmp, cycles, walk_start, stall_cycles;
+	struct power_context pwr = {0};
+	unsigned power, active_power;
+	struct stats_context ctx = {0};
 	struct worker *w = priv;
 	struct rte_graph *graph;
+	struct rte_rcu_qsbr *rcu;
 	unsigned cur, loop;
+	uint64_t count, tsc_us;
 	char name[16];
+	bool hist, rtc;
 
 #define log(lvl, fmt, ...) LOG(lvl, "[CPU %d] " fmt, w->cpu_id __VA_OPT__(, ) __VA_ARGS__)
 
@@ -134,20 +457,36 @@ void *gr_datapath_loop(void *priv) {
 	}
 
 	w->lcore_id = rte_lcore_id();
+	if (gr_log_async_start() < 0)
+		log(ERR, "gr_log_async_start: %s", strerror(errno));
 	snprintf(name, 15, "gr:loop-c%d", w->cpu_id);
 	if (pthread_setname_np(pthread_self(), name)) {
 		log(ERR, "pthread_setname_np: %s", rte_strerror(rte_errno));
 		return NULL;
 	}
-	if (!gr_args()->poll_mode) {
-		if (prctl(PR_SET_TIMERSLACK, SLEEP_RESOLUTION_NS) < 0) {
-			log(ERR, "prctl(PR_SET_TIMERSLACK): %s", strerror(errno));
-			return NULL;
-		}
+	if (prctl(PR_SET_TIMERSLACK, SLEEP_RESOLUTION_NS) < 0) {
+		log(ERR, "prctl(PR_SET_TIMERSLACK): %s", strerror(errno));
+		return NULL;
 	}
 
 	log(INFO, "lcore_id = %d", w->lcore_id);
 
+	rcu = gr_datapath_rcu();
+	if (rte_rcu_qsbr_thread_register(rcu, w->lcore_id) < 0) {
+		log(ERR, "rte_rcu_qsbr_thread_register: %s", rte_strerror(rte_errno));
+		return NULL;
+	}
+
+	rte_cpu_get_intrinsics_support(&pwr.cpu);
+	if (w->wakeup_fd >= 0) {
+		pwr.wakeup.epdata.event = EPOLLIN | EPOLLET;
+		if (rte_epoll_ctl(RTE_EPOLL_PER_THREAD, EPOLL_CTL_ADD, w->wakeup_fd, &pwr.wakeup)
+		    < 0) {
+			log(ERR, "rte_epoll_ctl: %s", strerror(errno));
+			return NULL;
+		}
+	}
+
 	static_assert(atomic_is_lock_free(&w->shutdown));
 	static_assert(atomic_is_lock_free(&w->cur_config));
 	static_assert(atomic_is_lock_free(&w->stats_reset));
@@ -165,33 +504,92 @@ reconfig:
 		usleep(1000);
 		goto reconfig;
 	}
+	gr_trace_graph_reload(w->lcore_id, w->cpu_id, cur);
 
 	if (stats_reload(graph, &ctx) < 0)
 		goto shutdown;
 	atomic_store(&w->stats, ctx.w_stats);
-
 	gr_modules_dp_init();
 
+	// Do not hold back the control plane while not walking a graph.
+	rte_rcu_qsbr_thread_online(rcu, w->lcore_id);
+
+	if (power_reload(graph, w, &pwr) < 0)
+		goto shutdown;
+
+	// Nodes of dispatch graphs may be processed by other workers. They can
+	// only be walked by rte_graph_walk().
+	rtc = rte_graph_worker_model_get(graph) == RTE_GRAPH_MODEL_RTC;
 	loop = 0;
 	sleep = 0;
+	tsc_us = rte_get_tsc_hz() / 1000000;
+	stats_interval = atomic_load(&w->stats_interval);
+	hist = atomic_load(&w->stats_hist);
+	stall_cycles = atomic_load(&w->stall_threshold_us) * tsc_us;
 	timestamp = rte_rdtsc();
 	for (;;) {
-		rte_graph_walk(graph);
+		if (stall_cycles != 0 && rtc) {
+			walk_start = rte_rdtsc();
+			graph_walk_instrumented(graph, &ctx, hist);
+			walk_record(&ctx, rte_rdtsc() - walk_start, stall_cycles);
+		} else if (hist && rtc) {
+			graph_walk_instrumented(graph, &ctx, true);
+		} else {
+			rte_graph_walk(graph);
+		}
+		// No references to shared objects are kept across graph walks.
+		rte_rcu_qsbr_quiescent(rcu, w->lcore_id);
 
-		if (++loop == 256) {
+		if (++loop >= stats_interval) {
 			if (atomic_load(&w->shutdown) || atomic_load(&w->next_config) != cur) {
+				rte_rcu_qsbr_thread_offline(rcu, w->lcore_id);
 				gr_modules_dp_fini();
+				power_release(&pwr);
 				goto reconfig;
 			}
 
-			ctx.last_count = 0;
-			rte_graph_cluster_stats_get(ctx.stats, false);
+			if (pwr.rx_node != NULL && pwr.rx_node->ctx_ptr != pwr.rx_ctx) {
+				// rx queues were updated in place by the control plane
+				power_release(&pwr);
+				if (power_reload(graph, w, &pwr) < 0)
+					goto shutdown;
+			}
+
+			count = stats_update(graph, &ctx);
 			timestamp_tmp = rte_rdtsc();
 			cycles = timestamp_tmp - timestamp;
 			max_sleep_us = atomic_load_explicit(&w->max_sleep_us, memory_order_relaxed);
-			if (ctx.last_count == 0 && max_sleep_us > 0) {
+			stats_interval = atomic_load(&w->stats_interval);
+			hist = atomic_load(&w->stats_hist);
+			stall_cycles = atomic_load(&w->stall_threshold_us) * tsc_us;
+			power = atomic_load_explicit(&w->power, memory_order_relaxed);
+			active_power = power_resolve(power, &pwr);
+			if (active_power != atomic_load(&w->active_power))
+				atomic_store(&w->active_power, active_power);
+			if (count == 0 && max_sleep_us > 0
+			    && active_power != GR_WORKER_POWER_POLL) {
 				sleep = sleep == max_sleep_us ? sleep : (sleep + 1);
-				usleep(sleep);
+				rte_rcu_qsbr_thread_offline(rcu, w->lcore_id);
+				switch (active_power) {
+				case GR_WORKER_POWER_INTR:
+					if (sleep < max_sleep_us) {
+						usleep(sleep);
+						break;
+					}
+					intr_wait(w, &pwr);
+					// resume polling at full speed
+					sleep = 0;
+					break;
+				case GR_WORKER_POWER_MONITOR:
+					monitor_wait(&pwr, timestamp_tmp + max_sleep_us * tsc_us);
+					break;
+				case GR_WORKER_POWER_PAUSE:
+					pause_wait(&pwr, timestamp_tmp + sleep * tsc_us);
+					break;
+				default:
+					usleep(sleep);
+				}
+				rte_rcu_qsbr_thread_online(rcu, w->lcore_id);
 				ctx.w_stats->sleep_cycles += rte_rdtsc() - timestamp_tmp;
 				ctx.w_stats->n_sleeps += 1;
 			} else {
@@ -209,9 +607,17 @@ reconfig:
 
 shutdown:
 	log(NOTICE, "shutting down tid=%d", w->tid);
+	rte_rcu_qsbr_thread_unregister(rcu, w->lcore_id);
+	power_release(&pwr);
+	if (w->wakeup_fd >= 0)
+		rte_epoll_ctl(RTE_EPOLL_PER_THREAD, EPOLL_CTL_DEL, w->wakeup_fd, &pwr.wakeup);
+	rte_free(pwr.queues);
+	rte_free(pwr.pmc);
 	atomic_store(&w->stats, NULL);
-	rte_graph_cluster_stats_destroy(ctx.stats);
+	rte_free(ctx.prev);
 	rte_free(ctx.w_stats);
+	free(ctx.node_to_index);
+	gr_log_async_stop();
 	rte_thread_unregister();
 	w->lcore_id = LCORE_ID_ANY;
 
@@ -0,0 +1,444 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_datapath.h"
+#include "gr_mbuf.h"
+#include "gr_node_bench.h"
+
+#include <gr.h>
+#include <gr_errno.h>
+#include <gr_graph.h>
+#include <gr_iface.h>
+#include <gr_log.h>
+#include <gr_macro.h>
+#include <gr_port.h>
+#include <gr_vlan.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_graph_worker.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_WARMUP 1000
+#define BENCH_ROUNDS 31
+#define BENCH_CALLS 1000
+// Student t quantile for a two-sided 95% interval with BENCH_ROUNDS - 1 degrees of freedom.
+#define BENCH_T95 2.042
+#define BENCH_MAX_ATTACHED 64
+#define BENCH_CIR_SIZE 256 // must be a power of 2 larger than any node edge count
+
+// mocked types/functions
+extern int gr_rte_log_type;
+int gr_rte_log_type;
+__thread struct gr_log_ring *gr_log_ring;
+void gr_log_push(uint32_t, struct gr_log_ratelimit *, const char *, ...) { }
+bool packet_trace_enabled;
+uint32_t iface_config_gen = 1;
+struct iface_stats *iface_stats[RTE_MAX_LCORE];
+struct node_infos node_infos = STAILQ_HEAD_INITIALIZER(node_infos);
+
+static struct gr_args args;
+const struct gr_args *gr_args(void) {
+	return &args;
+}
+
+void trace_packet(const struct rte_node *, uint16_t, const struct rte_mbuf *) { }
+void trace_drop(const struct rte_node *, uint16_t) { }
+
+// Edge nodes are fake, drop nodes are never called.
+uint16_t drop_packets(struct rte_graph *, struct rte_node *, void **, uint16_t nb_objs) {
+	return nb_objs;
+}
+
+static struct iface *ifaces[MAX_IFACES];
+
+struct iface *iface_from_id(uint16_t ifid) {
+	return ifid < ARRAY_DIM(ifaces) ? ifaces[ifid] : NULL;
+}
+
+struct iface *iface_next(uint16_t type_id, const struct iface *prev) {
+	struct iface *iface;
+
+	for (unsigned ifid = prev != NULL ? prev->id + 1 : 0; ifid < ARRAY_DIM(ifaces); ifid++) {
+		iface = ifaces[ifid];
+		if (iface != NULL && (type_id == GR_IFACE_TYPE_UNDEF || iface->type_id == type_id))
+			return iface;
+	}
+
+	return NULL;
+}
+
+int iface_get_eth_addr(uint16_t ifid, struct rte_ether_addr *mac) {
+	const struct iface *iface = iface_from_id(ifid);
+
+	if (iface == NULL)
+		return errno_set(ENODEV);
+
+	switch (iface->type_id) {
+	case GR_IFACE_TYPE_PORT:
+		*mac = ((const struct iface_info_port *)iface->info)->mac;
+		return 0;
+	case GR_IFACE_TYPE_VLAN:
+		*mac = ((const struct iface_info_vlan *)iface->info)->mac;
+		return 0;
+	}
+
+	return errno_set(EOPNOTSUPP);
+}
+
+// Edges added by register callbacks, in the order they were attached.
+static struct {
+	const char *parent;
+	const char *node;
+} attached[BENCH_MAX_ATTACHED];
+static unsigned n_attached;
+
+static struct rte_node_register *node_register_find(const char *name) {
+	struct gr_node_info *info;
+
+	STAILQ_FOREACH (info, &node_infos, next) {
+		if (strcmp(info->node->name, name) == 0)
+			return info->node;
+	}
+
+	return NULL;
+}
+
+rte_edge_t gr_node_attach_parent(const char *parent, const char *node) {
+	const struct rte_node_register *reg = node_register_find(parent);
+	rte_edge_t edge;
+
+	if (reg == NULL)
+		ABORT("'%s' parent node not found", parent);
+	if (n_attached == ARRAY_DIM(attached))
+		ABORT("too many attached edges");
+
+	edge = reg->nb_edges;
+	for (unsigned i = 0; i < n_attached; i++) {
+		if (strcmp(attached[i].parent, parent) == 0)
+			edge++;
+	}
+	attached[n_attached].parent = parent;
+	attached[n_attached].node = node;
+	n_attached++;
+
+	return edge;
+}
+
+struct iface *node_bench_iface_add(uint16_t type_id, uint16_t vrf_id, size_t info_size) {
+	size_t len = RTE_ALIGN_CEIL(sizeof(struct iface) + info_size, RTE_CACHE_LINE_SIZE);
+	struct iface *iface;
+
+	// zero is GR_IFACE_ID_UNDEF
+	for (uint16_t id = 1; id < ARRAY_DIM(ifaces); id++) {
+		if (ifaces[id] != NULL)
+			continue;
+		if ((iface = aligned_alloc(RTE_CACHE_LINE_SIZE, len)) == NULL)
+			ABORT("aligned_alloc(iface) failed");
+		memset(iface, 0, len);
+		iface->id = id;
+		iface->type_id = type_id;
+		iface->vrf_id = vrf_id;
+		iface->flags = GR_IFACE_F_UP;
+		iface->state = GR_IFACE_S_RUNNING;
+		iface->mtu = 1500;
+		ifaces[id] = iface;
+		return iface;
+	}
+
+	ABORT("no free interface id");
+}
+
+void node_bench_init(void) {
+	struct gr_node_info *info;
+
+	// iface_stats and the per-worker counters are indexed by lcore
+	RTE_PER_LCORE(_lcore_id) = 0;
+	if ((iface_stats[0] = calloc(MAX_IFACES, sizeof(*iface_stats[0]))) == NULL)
+		ABORT("calloc(iface_stats) failed");
+
+	STAILQ_FOREACH (info, &node_infos, next) {
+		if (info->register_callback != NULL)
+			info->register_callback();
+	}
+}
+
+// The node under test and one fake node for each of its edges.
+struct bench_graph {
+	struct rte_graph *graph;
+	struct rte_node_register *reg;
+	struct rte_node *node;
+	const char **edge_names;
+	uint64_t *edge_packets;
+};
+
+static struct rte_node *bench_node_alloc(const char *name, rte_edge_t nb_edges, uint16_t size) {
+	size_t len = sizeof(struct rte_node) + nb_edges * sizeof(struct rte_node *);
+	struct rte_node *node;
+
+	len = RTE_ALIGN_CEIL(len, RTE_CACHE_LINE_SIZE);
+	if ((node = aligned_alloc(RTE_CACHE_LINE_SIZE, len)) == NULL)
+		ABORT("aligned_alloc(node) failed");
+	memset(node, 0, len);
+	snprintf(node->name, sizeof(node->name), "%s", name);
+	node->nb_edges = nb_edges;
+	// Streams are swapped between nodes, all of them must have the same size.
+	node->size = size;
+	if ((node->objs = calloc(size, sizeof(void *))) == NULL)
+		ABORT("calloc(objs) failed");
+
+	return node;
+}
+
+static void bench_node_free(struct rte_node *node) {
+	free(node->objs);
+	free(node);
+}
+
+static int bench_graph_init(struct bench_graph *g, const char *name, uint16_t size) {
+	rte_edge_t nb_edges;
+	unsigned i;
+
+	memset(g, 0, sizeof(*g));
+	if ((g->reg = node_register_find(name)) == NULL)
+		return errno_set(ENOENT);
+
+	nb_edges = g->reg->nb_edges;
+	for (i = 0; i < n_attached; i++) {
+		if (strcmp(attached[i].parent, name) == 0)
+			nb_edges++;
+	}
+	if (nb_edges >= BENCH_CIR_SIZE)
+		return errno_set(E2BIG);
+
+	if ((g->graph = calloc(1, sizeof(*g->graph))) == NULL)
+		ABORT("calloc(graph) failed");
+	if ((g->graph->cir_start = calloc(BENCH_CIR_SIZE, sizeof(rte_graph_off_t))) == NULL)
+		ABORT("calloc(cir_start) failed");
+	g->graph->cir_mask = BENCH_CIR_SIZE - 1;
+	snprintf(g->graph->name, sizeof(g->graph->name), "bench");
+
+	g->edge_names = calloc(nb_edges, sizeof(*g->edge_names));
+	g->edge_packets = calloc(nb_edges, sizeof(*g->edge_packets));
+	if (g->edge_names == NULL || g->edge_packets == NULL)
+		ABORT("calloc(edges) failed");
+	for (i = 0; i < g->reg->nb_edges; i++)
+		g->edge_names[i] = g->reg->next_nodes[i];
+	for (unsigned j = 0; j < n_attached; j++) {
+		if (strcmp(attached[j].parent, name) == 0)
+			g->edge_names[i++] = attached[j].node;
+	}
+
+	g->node = bench_node_alloc(name, nb_edges, size);
+	g->node->process = g->reg->process;
+	for (i = 0; i < nb_edges; i++) {
+		g->node->nodes[i] = bench_node_alloc(g->edge_names[i], 0, size);
+		g->node->nodes[i]->id = i + 1;
+	}
+
+	if (g->reg->init != NULL && g->reg->init(g->graph, g->node) < 0)
+		return errno_set(EINVAL);
+
+	return 0;
+}
+
+static void bench_graph_fini(struct bench_graph *g) {
+	if (g->node != NULL) {
+		if (g->reg->fini != NULL)
+			g->reg->fini(g->graph, g->node);
+		for (rte_edge_t i = 0; i < g->node->nb_edges; i++)
+			bench_node_free(g->node->nodes[i]);
+		bench_node_free(g->node);
+	}
+	if (g->graph != NULL)
+		free(g->graph->cir_start);
+	free(g->graph);
+	free(g->edge_names);
+	free(g->edge_packets);
+}
+
+static struct rte_mbuf *bench_mbuf_alloc(void) {
+	size_t len = sizeof(struct rte_mbuf) + GR_MBUF_PRIV_MAX_SIZE + RTE_MBUF_DEFAULT_BUF_SIZE;
+	struct rte_mbuf *m;
+
+	len = RTE_ALIGN_CEIL(len, RTE_CACHE_LINE_SIZE);
+	if ((m = aligned_alloc(RTE_CACHE_LINE_SIZE, len)) == NULL)
+		ABORT("aligned_alloc(mbuf) failed");
+	memset(m, 0, sizeof(*m));
+	m->priv_size = GR_MBUF_PRIV_MAX_SIZE;
+	m->buf_addr = (char *)m + sizeof(*m) + GR_MBUF_PRIV_MAX_SIZE;
+	m->buf_len = RTE_MBUF_DEFAULT_BUF_SIZE;
+	m->nb_segs = 1;
+	rte_mbuf_refcnt_set(m, 1);
+
+	return m;
+}
+
+static void bench_burst_prepare(
+	const struct node_bench *b,
+	struct bench_graph *g,
+	struct rte_mbuf **mbufs,
+	uint16_t burst
+) {
+	for (uint16_t i = 0; i < burst; i++) {
+		rte_pktmbuf_reset(mbufs[i]);
+		memset(rte_mbuf_to_priv(mbufs[i]), 0, GR_MBUF_PRIV_MAX_SIZE);
+		b->prepare(mbufs[i], i);
+		g->node->objs[i] = mbufs[i];
+	}
+	g->node->idx = burst;
+}
+
+static uint64_t bench_call(struct bench_graph *g, uint16_t burst) {
+	uint64_t start, end;
+
+	start = rte_rdtsc_precise();
+	g->reg->process(g->graph, g->node, g->node->objs, burst);
+	end = rte_rdtsc_precise();
+	g->node->idx = 0;
+
+	return end - start;
+}
+
+// Empty the edge nodes. Returns the number of packets that were enqueued.
+static uint16_t bench_collect(struct bench_graph *g) {
+	struct rte_node *next;
+	uint16_t n = 0;
+
+	for (rte_edge_t i = 0; i < g->node->nb_edges; i++) {
+		next = g->node->nodes[i];
+		g->edge_packets[i] += next->idx;
+		n += next->idx;
+		next->idx = 0;
+	}
+	g->graph->tail = 0;
+
+	return n;
+}
+
+static uint64_t rdtsc_overhead(void) {
+	uint64_t start, min = UINT64_MAX;
+
+	for (unsigned i = 0; i < BENCH_CALLS; i++) {
+		start = rte_rdtsc_precise();
+		min = RTE_MIN(min, rte_rdtsc_precise() - start);
+	}
+
+	return min;
+}
+
+static int double_cmp(const void *a, const void *b) {
+	double da = *(const double *)a, db = *(const double *)b;
+	return (da > db) - (da < db);
+}
+
+static int bench_check(const struct node_bench *b, const struct bench_graph *g, uint64_t total) {
+	int ret = 0;
+
+	for (rte_edge_t i = 0; i < g->node->nb_edges; i++) {
+		if (b->expect == NULL || g->edge_packets[i] == 0)
+			continue;
+		if (strcmp(g->edge_names[i], b->expect) == 0 && g->edge_packets[i] == total)
+			continue;
+		fprintf(stderr,
+			"%s: %" PRIu64 "/%" PRIu64 " packets sent to %s, expected %s\n",
+			b->name,
+			g->edge_packets[i],
+			total,
+			g->edge_names[i],
+			b->expect);
+		ret = errno_set(EBADMSG);
+	}
+
+	return ret;
+}
+
+static int bench_one(const struct node_bench *b, uint64_t overhead) {
+	uint16_t burst = b->burst ?: RTE_GRAPH_BURST_SIZE;
+	double samples[BENCH_ROUNDS], mean, var, ci;
+	struct rte_mbuf *mbufs[RTE_GRAPH_BURST_SIZE];
+	struct bench_graph g;
+	uint64_t cycles, c;
+	int ret = 0;
+
+	if (burst > RTE_GRAPH_BURST_SIZE)
+		return errno_set(ERANGE);
+	for (uint16_t i = 0; i < burst; i++)
+		mbufs[i] = bench_mbuf_alloc();
+	if (bench_graph_init(&g, b->node, RTE_GRAPH_BURST_SIZE * 4) < 0) {
+		fprintf(stderr, "%s: %s: %s\n", b->name, b->node, strerror(errno));
+		ret = -errno;
+		goto out;
+	}
+
+	// Fill the caches and let a speculative edge settle.
+	for (unsigned i = 0; i < BENCH_WARMUP; i++) {
+		bench_burst_prepare(b, &g, mbufs, burst);
+		bench_call(&g, burst);
+		if (bench_collect(&g) != burst) {
+			fprintf(stderr, "%s: %s kept some packets\n", b->name, b->node);
+			ret = errno_set(EIO);
+			goto out;
+		}
+	}
+	memset(g.edge_packets, 0, g.node->nb_edges * sizeof(*g.edge_packets));
+
+	for (unsigned r = 0; r < BENCH_ROUNDS; r++) {
+		cycles = 0;
+		for (unsigned i = 0; i < BENCH_CALLS; i++) {
+			bench_burst_prepare(b, &g, mbufs, burst);
+			c = bench_call(&g, burst);
+			cycles += c > overhead ? c - overhead : 0;
+			bench_collect(&g);
+		}
+		samples[r] = (double)cycles / ((uint64_t)BENCH_CALLS * burst);
+	}
+
+	mean = 0;
+	for (unsigned r = 0; r < BENCH_ROUNDS; r++)
+		mean += samples[r];
+	mean /= BENCH_ROUNDS;
+	var = 0;
+	for (unsigned r = 0; r < BENCH_ROUNDS; r++)
+		var += (samples[r] - mean) * (samples[r] - mean);
+	var /= BENCH_ROUNDS - 1;
+	ci = BENCH_T95 * sqrt(var / BENCH_ROUNDS);
+	qsort(samples, BENCH_ROUNDS, sizeof(*samples), double_cmp);
+
+	printf("%-28s %-14s burst=%-3u cycles/pkt mean=%.1f +/-%.1f median=%.1f min=%.1f\n",
+	       b->name,
+	       b->node,
+	       burst,
+	       mean,
+	       ci,
+	       samples[BENCH_ROUNDS / 2],
+	       samples[0]);
+
+	ret = bench_check(b, &g, (uint64_t)BENCH_ROUNDS * BENCH_CALLS * burst);
+out:
+	bench_graph_fini(&g);
+	for (uint16_t i = 0; i < burst; i++)
+		free(mbufs[i]);
+
+	return ret;
+}
+
+int node_bench_run(const struct node_bench *benches, unsigned n) {
+	uint64_t overhead = rdtsc_overhead();
+	int status = EXIT_SUCCESS;
+
+	for (unsigned i = 0; i < n; i++) {
+		if (bench_one(&benches[i], overhead) < 0)
+			status = EXIT_FAILURE;
+	}
+
+	return status;
+}
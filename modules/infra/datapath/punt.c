@@ -0,0 +1,300 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_datapath.h"
+#include "gr_eth_input.h"
+#include "gr_punt.h"
+
+#include <gr_graph.h>
+#include <gr_iface.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_ether.h>
+#include <rte_graph_worker.h>
+#include <rte_gro.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+#include <rte_spinlock.h>
+#include <rte_tcp.h>
+
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+struct iface_punt *punt_ifaces[MAX_IFACES];
+unsigned punt_count;
+
+enum {
+	RATE_LIMITED = 0,
+	NO_HEADROOM,
+	QUEUE_FULL,
+	OUTPUT_EDGE_COUNT,
+};
+
+#define GRO_PTYPE (RTE_PTYPE_L2_ETHER | RTE_PTYPE_L3_IPV4 | RTE_PTYPE_L4_TCP)
+
+// Locally terminated TCP traffic (BGP sessions, management) crosses to the
+// kernel as many small segments. Mark the ones that rte_gro may coalesce. The
+// kernel does not check the checksum of merged segments, it is verified here.
+static bool gro_candidate(struct rte_mbuf *m, rte_be16_t ether_type) {
+	const struct rte_ipv4_hdr *ip;
+	const struct rte_tcp_hdr *tcp;
+
+	if (ether_type != RTE_BE16(RTE_ETHER_TYPE_IPV4))
+		return false;
+
+	ip = rte_pktmbuf_mtod_offset(m, const struct rte_ipv4_hdr *, sizeof(struct rte_ether_hdr));
+	if (ip->next_proto_id != IPPROTO_TCP || rte_ipv4_frag_pkt_is_fragmented(ip))
+		return false;
+
+	m->l2_len = sizeof(struct rte_ether_hdr);
+	m->l3_len = rte_ipv4_hdr_len(ip);
+	if (rte_pktmbuf_data_len(m) < m->l2_len + m->l3_len + sizeof(*tcp))
+		return false;
+	tcp = rte_pktmbuf_mtod_offset(m, const struct rte_tcp_hdr *, m->l2_len + m->l3_len);
+	m->l4_len = (tcp->data_off & 0xf0) >> 2;
+	if (rte_pktmbuf_data_len(m) < m->l2_len + m->l3_len + m->l4_len)
+		return false;
+	// pure acks are never merged, save the checksum verification
+	if (rte_be_to_cpu_16(ip->total_length) <= m->l3_len + m->l4_len)
+		return false;
+
+	switch (m->ol_flags & RTE_MBUF_F_RX_L4_CKSUM_MASK) {
+	case RTE_MBUF_F_RX_L4_CKSUM_GOOD:
+		break;
+	case RTE_MBUF_F_RX_L4_CKSUM_BAD:
+		return false;
+	default:
+		if (rte_ipv4_udptcp_cksum_mbuf_verify(m, ip, m->l2_len + m->l3_len) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+// Merged packets are chains of segments. Hand them over as a single GSO frame
+// with a partial checksum. The kernel resegments them if it forwards them.
+static void gro_tso_prepare(struct rte_mbuf *m) {
+	struct rte_ipv4_hdr *ip;
+	struct rte_tcp_hdr *tcp;
+
+	ip = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *, m->l2_len);
+	tcp = rte_pktmbuf_mtod_offset(m, struct rte_tcp_hdr *, m->l2_len + m->l3_len);
+
+	// rte_gro only updates the total length
+	ip->hdr_checksum = 0;
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+
+	m->ol_flags = RTE_MBUF_F_TX_TCP_SEG | RTE_MBUF_F_TX_TCP_CKSUM | RTE_MBUF_F_TX_IPV4;
+	// the first segment is the head of the chain
+	m->tso_segsz = rte_pktmbuf_data_len(m) - m->l2_len - m->l3_len - m->l4_len;
+	tcp->cksum = rte_ipv4_phdr_cksum(ip, m->ol_flags);
+}
+
+// Hand over a batch of frames of the same exception path to the kernel. The
+// mbufs are not copied, the vhost-net backend reads them directly.
+static void punt_tx(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	struct iface_punt *punt,
+	struct rte_mbuf **mbufs,
+	uint16_t n
+) {
+	typeof(punt->lcores[0]) *lc = &punt->lcores[rte_lcore_id()];
+	uint16_t sent, coalesced;
+
+	if (punt->gro && n > 1) {
+		// The batch holds all the frames of this exception path for the
+		// current graph walk. No GRO table needs to be kept across walks.
+		struct rte_gro_param param = {
+			.gro_types = RTE_GRO_TCP_IPV4,
+			.max_flow_num = RTE_GRO_MAX_BURST_ITEM_NUM,
+			.max_item_per_flow = RTE_GRO_MAX_BURST_ITEM_NUM,
+		};
+		coalesced = n;
+		n = rte_gro_reassemble_burst(mbufs, n, &param);
+		coalesced -= n;
+		if (coalesced > 0) {
+			lc->coalesced += coalesced;
+			for (uint16_t i = 0; i < n; i++) {
+				if (mbufs[i]->packet_type == GRO_PTYPE && mbufs[i]->nb_segs > 1)
+					gro_tso_prepare(mbufs[i]);
+			}
+		}
+	}
+
+	rte_spinlock_lock(&punt->tx_lock);
+	sent = rte_eth_tx_burst(punt->port_id, 0, mbufs, n);
+	rte_spinlock_unlock(&punt->tx_lock);
+
+	lc->punted += sent;
+	if (sent < n) {
+		lc->dropped += n - sent;
+		rte_node_enqueue(graph, node, QUEUE_FULL, (void **)&mbufs[sent], n - sent);
+	}
+}
+
+static uint16_t
+punt_output_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct iface_punt *punt, *batch_punt = NULL;
+	struct rte_mbuf *batch[RTE_GRAPH_BURST_SIZE];
+	struct punt_mbuf_data *d;
+	struct rte_ether_hdr *eth;
+	struct rte_mbuf *mbuf;
+	uint16_t n_batch = 0;
+	uint64_t now = 0;
+	uint32_t rate;
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+		d = punt_mbuf_data(mbuf);
+		punt = d->punt;
+
+		// protect the kernel and the workers from floods of local traffic
+		rate = __atomic_load_n(&punt->rate, __ATOMIC_RELAXED);
+		if (rate != 0) {
+			typeof(punt->lcores[0]) *lc = &punt->lcores[rte_lcore_id()];
+			if (now == 0)
+				now = rte_rdtsc();
+			token_bucket_refill(&lc->bucket, rate, RTE_MAX(rate / 10, 1), now);
+			if (!token_bucket_take(&lc->bucket)) {
+				lc->dropped++;
+				rte_node_enqueue_x1(graph, node, RATE_LIMITED, mbuf);
+				continue;
+			}
+		}
+
+		eth = (struct rte_ether_hdr *)rte_pktmbuf_prepend(mbuf, sizeof(*eth));
+		if (unlikely(eth == NULL)) {
+			rte_node_enqueue_x1(graph, node, NO_HEADROOM, mbuf);
+			continue;
+		}
+		eth->ether_type = d->ether_type;
+		rte_ether_addr_copy(&punt->kernel_mac, &eth->dst_addr);
+		rte_ether_addr_copy(&punt->port_mac, &eth->src_addr);
+		if (punt->gro && gro_candidate(mbuf, d->ether_type))
+			mbuf->packet_type = GRO_PTYPE;
+		else
+			mbuf->packet_type = RTE_PTYPE_UNKNOWN;
+		// only the coalesced TCP segments use offloads
+		mbuf->ol_flags = 0;
+
+		if (punt != batch_punt && n_batch > 0) {
+			punt_tx(graph, node, batch_punt, batch, n_batch);
+			n_batch = 0;
+		}
+		batch_punt = punt;
+		batch[n_batch++] = mbuf;
+	}
+	if (n_batch > 0)
+		punt_tx(graph, node, batch_punt, batch, n_batch);
+
+	return nb_objs;
+}
+
+static struct rte_node_register punt_output_node = {
+	.name = "punt_output",
+
+	.process = punt_output_process,
+
+	.nb_edges = OUTPUT_EDGE_COUNT,
+	.next_nodes = {
+		[RATE_LIMITED] = "punt_output_rate_limited",
+		[NO_HEADROOM] = "error_no_headroom",
+		[QUEUE_FULL] = "punt_output_queue_full",
+	},
+};
+
+static struct gr_node_info punt_output_info = {
+	.node = &punt_output_node,
+};
+
+GR_NODE_REGISTER(punt_output_info);
+
+GR_DROP_REGISTER(punt_output_rate_limited);
+GR_DROP_REGISTER(punt_output_queue_full);
+
+enum {
+	UNKNOWN_ETHER_TYPE = 0,
+	INPUT_EDGE_COUNT,
+};
+
+// Indexed by ether type in network order.
+static rte_edge_t input_edges[UINT16_MAX + 1] = {UNKNOWN_ETHER_TYPE};
+
+void punt_input_register_type(rte_be16_t eth_type, const char *next_node) {
+	LOG(DEBUG, "punt_input: type=0x%04x -> %s", rte_be_to_cpu_16(eth_type), next_node);
+	if (input_edges[eth_type] != UNKNOWN_ETHER_TYPE)
+		ABORT("next node already registered for type=0x%04x", rte_be_to_cpu_16(eth_type));
+	input_edges[eth_type] = gr_node_attach_parent("punt_input", next_node);
+}
+
+// Poll the kernel devices for host originated packets. The number of packets
+// injected by each device is limited to one burst per graph walk.
+static uint16_t
+punt_input_process(struct rte_graph *graph, struct rte_node *node, void **, uint16_t) {
+	struct rte_mbuf *mbufs[RTE_GRAPH_BURST_SIZE];
+	const struct rte_ether_hdr *eth;
+	struct eth_input_mbuf_data *d;
+	struct iface_punt *punt;
+	uint16_t n, total = 0;
+	rte_edge_t edge;
+	unsigned count;
+
+	count = __atomic_load_n(&punt_count, __ATOMIC_ACQUIRE);
+
+	for (unsigned p = 0; p < count; p++) {
+		if ((punt = __atomic_load_n(&punt_ifaces[p], __ATOMIC_ACQUIRE)) == NULL)
+			continue;
+		if (!rte_spinlock_trylock(&punt->rx_lock))
+			continue; // another worker is polling it
+		n = rte_eth_rx_burst(punt->port_id, 0, mbufs, RTE_DIM(mbufs));
+		rte_spinlock_unlock(&punt->rx_lock);
+		if (n == 0)
+			continue;
+
+		punt->lcores[rte_lcore_id()].injected += n;
+		for (uint16_t i = 0; i < n; i++) {
+			struct rte_mbuf *m = mbufs[i];
+			edge = UNKNOWN_ETHER_TYPE;
+			if (likely(rte_pktmbuf_data_len(m) >= sizeof(*eth))) {
+				eth = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
+				edge = input_edges[eth->ether_type];
+				rte_pktmbuf_adj(m, sizeof(*eth));
+			}
+			m->packet_type = RTE_PTYPE_UNKNOWN;
+			m->ol_flags = 0;
+			d = eth_input_mbuf_data(m);
+			d->iface = punt->iface;
+			d->eth_dst = ETH_DST_LOCAL;
+			rte_node_enqueue_x1(graph, node, edge, m);
+		}
+		total += n;
+	}
+
+	return total;
+}
+
+static struct rte_node_register punt_input_node = {
+	.name = "punt_input",
+	.flags = RTE_NODE_SOURCE_F,
+
+	.process = punt_input_process,
+
+	.nb_edges = INPUT_EDGE_COUNT,
+	.next_nodes = {
+		[UNKNOWN_ETHER_TYPE] = "punt_input_unknown_type",
+		// other edges are updated dynamically with punt_input_register_type
+	},
+};
+
+static struct gr_node_info punt_input_info = {
+	.node = &punt_input_node,
+};
+
+GR_NODE_REGISTER(punt_input_info);
+
+GR_DROP_REGISTER(punt_input_unknown_type);
@@ -3,12 +3,14 @@
 
 #include "gr_datapath.h"
 #include "gr_eth_input.h"
+#include "gr_mirror.h"
 #include "gr_rx.h"
 
 #include <gr_graph.h>
 #include <gr_iface.h>
 #include <gr_log.h>
 #include <gr_port.h>
+#include <gr_rcu.h>
 
 #include <rte_build_config.h>
 #include <rte_ethdev.h>
@@ -23,71 +25,141 @@
 enum {
 	ETH_IN = 0,
 	NO_IFACE,
+	MIRROR,
 	NB_EDGES,
 };
 
 struct rx_ctx {
-	uint16_t burst_size;
+	// minimum number of packets guaranteed to each queue on every walk
+	uint16_t fair_share;
+	// rotates the order in which busy queues get the unused budget
+	uint16_t next;
 	uint16_t n_queues;
 	struct rx_port_queue queues[/* n_queues */];
 };
 
-static uint16_t
-rx_process(struct rte_graph *graph, struct rte_node *node, void ** /*objs*/, uint16_t count) {
-	const struct rx_ctx *ctx = node->ctx_ptr;
+static inline uint16_t rx_queue_poll(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	const struct rx_port_queue *q,
+	uint16_t count,
+	uint16_t max
+) {
+	struct rte_mbuf *copies[RTE_GRAPH_BURST_SIZE];
+	const struct iface_info_port *port;
 	struct eth_input_mbuf_data *d;
 	const struct iface *iface;
-	struct rx_port_queue q;
-	uint16_t rx;
+	const struct iface *bond;
+	struct port_mirror *mir;
+	uint16_t rx, n;
 	unsigned r;
 
-	count = 0;
-	for (int i = 0; i < ctx->n_queues; i++) {
-		q = ctx->queues[i];
-		rx = rte_eth_rx_burst(
-			q.port_id, q.rxq_id, (struct rte_mbuf **)&node->objs[count], ctx->burst_size
-		);
-		iface = port_get_iface(q.port_id);
-		if (rx > 0 && iface == NULL) {
-			rte_node_enqueue(graph, node, NO_IFACE, &node->objs[count], rx);
-			continue;
-		}
+	rx = rte_eth_rx_burst(q->port_id, q->rxq_id, (struct rte_mbuf **)&node->objs[count], max);
+	if (rx > 0 && q->iface == NULL) {
+		rte_node_enqueue(graph, node, NO_IFACE, &node->objs[count], rx);
+		return 0;
+	}
+	if (rx == 0)
+		return 0;
+	mir = __atomic_load_n(&port_mirrors[q->port_id], __ATOMIC_ACQUIRE);
+	if (unlikely(mir != NULL) && mir->flags & GR_PORT_MIRROR_F_RX) {
+		// copy before the headers are modified by the next nodes
+		n = port_mirror_copy(mir, (struct rte_mbuf **)&node->objs[count], rx, copies, true);
+		if (n > 0)
+			rte_node_enqueue(graph, node, MIRROR, (void **)copies, n);
+	}
+	// Packets received on bond members are input on the bond interface.
+	// mbuf->port still identifies the member.
+	iface = q->iface;
+	port = (const struct iface_info_port *)iface->info;
+	bond = __atomic_load_n(&port->bond, __ATOMIC_ACQUIRE);
+	if (bond != NULL)
+		iface = bond;
+	for (r = count; r < count + rx; r++) {
+		struct rte_mbuf *m = node->objs[r];
+		m->packet_type &= q->ptype_mask;
+		d = eth_input_mbuf_data(m);
+		d->iface = iface;
+		d->eth_dst = ETH_DST_UNKNOWN;
+	}
+	if (unlikely(dwell_enabled))
+		dwell_stamp(&node->objs[count], rx);
+	if (unlikely(packet_trace_enabled)) {
 		for (r = count; r < count + rx; r++) {
-			d = eth_input_mbuf_data(node->objs[r]);
-			d->iface = iface;
-			d->eth_dst = ETH_DST_UNKNOWN;
-		}
-		if (unlikely(packet_trace_enabled)) {
-			for (r = count; r < count + rx; r++) {
-				trace_packet("rx", iface->name, node->objs[r]);
-			}
+			trace_packet(node, iface->id, node->objs[r]);
 		}
+	}
+
+	return rx;
+}
 
+static uint16_t
+rx_process(struct rte_graph *graph, struct rte_node *node, void ** /*objs*/, uint16_t count) {
+	struct rx_ctx *ctx = node->ctx_ptr;
+	uint16_t busy[RTE_GRAPH_BURST_SIZE];
+	uint16_t n_busy, budget, rx;
+
+	// Every queue gets its fair share of the burst first. Queues that filled
+	// their share probably have more packets waiting: the unused budget is
+	// split between them, starting with a different one on every walk.
+	// Control rxqs are low priority: a storm of ARP or local traffic must not
+	// delay forwarding.
+	count = 0;
+	n_busy = 0;
+	for (uint16_t i = 0; i < ctx->n_queues; i++) {
+		// only happens with more queues than RTE_GRAPH_BURST_SIZE
+		if (unlikely(count == RTE_GRAPH_BURST_SIZE))
+			break;
+		rx = rx_queue_poll(graph, node, &ctx->queues[i], count, ctx->fair_share);
+		if (rx == ctx->fair_share && !ctx->queues[i].control)
+			busy[n_busy++] = i;
 		count += rx;
 	}
+	for (uint16_t i = 0; i < n_busy && count < RTE_GRAPH_BURST_SIZE; i++) {
+		const struct rx_port_queue *q = &ctx->queues[busy[(i + ctx->next) % n_busy]];
+		budget = (RTE_GRAPH_BURST_SIZE - count) / (n_busy - i);
+		if (budget == 0)
+			continue;
+		count += rx_queue_poll(graph, node, q, count, budget);
+	}
+	ctx->next++;
 
 	rte_node_enqueue(graph, node, ETH_IN, node->objs, count);
 
 	return count;
 }
 
-static int rx_init(const struct rte_graph *graph, struct rte_node *node) {
-	const struct rx_node_queues *data;
+static struct rx_ctx *rx_ctx_new(const struct rte_graph *graph, const struct rx_node_queues *data) {
 	struct rx_ctx *ctx;
 
-	if ((data = gr_node_data_get(graph->name, node->name)) == NULL)
-		return -1;
+	if (data->n_queues == 0)
+		return errno_set_null(EINVAL);
 
-	ctx = rte_zmalloc(
-		__func__, sizeof(*ctx) + data->n_queues * sizeof(*ctx->queues), RTE_CACHE_LINE_SIZE
+	ctx = rte_zmalloc_socket(
+		__func__,
+		sizeof(*ctx) + data->n_queues * sizeof(*ctx->queues),
+		RTE_CACHE_LINE_SIZE,
+		graph->socket
 	);
 	if (ctx == NULL) {
-		LOG(ERR, "rte_zmalloc: %s", rte_strerror(rte_errno));
-		return -1;
+		LOG(ERR, "rte_zmalloc_socket: %s", rte_strerror(rte_errno));
+		return errno_set_null(ENOMEM);
 	}
 	ctx->n_queues = data->n_queues;
-	ctx->burst_size = RTE_GRAPH_BURST_SIZE / data->n_queues;
+	ctx->fair_share = RTE_MAX(RTE_GRAPH_BURST_SIZE / data->n_queues, 1);
 	memcpy(ctx->queues, data->queues, ctx->n_queues * sizeof(*ctx->queues));
+
+	return ctx;
+}
+
+static int rx_init(const struct rte_graph *graph, struct rte_node *node) {
+	const struct rx_node_queues *data;
+	struct rx_ctx *ctx;
+
+	if ((data = gr_node_data_get(graph->name, node->name)) == NULL)
+		return -1;
+	if ((ctx = rx_ctx_new(graph, data)) == NULL)
+		return -1;
 	node->ctx_ptr = ctx;
 
 	return 0;
@@ -97,6 +169,42 @@ static void rx_fini(const struct rte_graph *, struct rte_node *node) {
 	rte_free(node->ctx_ptr);
 }
 
+static struct rte_node_register node;
+
+struct rte_node *rx_graph_node(const struct rte_graph *graph) {
+	return rte_graph_node_get(graph->id, node.id);
+}
+
+uint16_t rx_node_queues(const struct rte_node *n, const struct rx_port_queue **queues) {
+	const struct rx_ctx *ctx = n != NULL ? n->ctx_ptr : NULL;
+
+	if (ctx == NULL) {
+		*queues = NULL;
+		return 0;
+	}
+	*queues = ctx->queues;
+
+	return ctx->n_queues;
+}
+
+int rx_node_queues_update(struct rte_graph *graph, const struct rx_node_queues *data) {
+	struct rte_node *n = rx_graph_node(graph);
+	struct rx_ctx *ctx, *old;
+
+	if (n == NULL)
+		return errno_set(ENOENT);
+	if ((ctx = rx_ctx_new(graph, data)) == NULL)
+		return -errno;
+
+	old = n->ctx_ptr;
+	__atomic_store_n(&n->ctx_ptr, ctx, __ATOMIC_RELEASE);
+	// make sure the old queues are not polled anymore when returning
+	gr_rcu_synchronize();
+	rte_free(old);
+
+	return 0;
+}
+
 static struct rte_node_register node = {
 	.name = "port_rx",
 	.flags = RTE_NODE_SOURCE_F,
@@ -109,6 +217,7 @@ static struct rte_node_register node = {
 	.next_nodes = {
 		[ETH_IN] = "eth_input",
 		[NO_IFACE] = "port_rx_no_iface",
+		[MIRROR] = "port_tx",
 	},
 };
 
@@ -0,0 +1,7 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_sample.h"
+
+// Rings are created by the exporter when sampling is first enabled.
+struct sample_worker sample_workers[RTE_MAX_LCORE];
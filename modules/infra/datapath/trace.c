@@ -4,58 +4,236 @@
 #include "gr_datapath.h"
 #include "gr_icmp6.h"
 
+#include <gr_control.h>
+#include <gr_iface.h>
 #include <gr_log.h>
 #include <gr_net_types.h>
 
 #include <rte_arp.h>
 #include <rte_byteorder.h>
+#include <rte_cycles.h>
 #include <rte_errno.h>
 #include <rte_ether.h>
 #include <rte_graph_worker.h>
 #include <rte_icmp.h>
 #include <rte_ip.h>
 #include <rte_ip6.h>
+#include <rte_lcore.h>
 #include <rte_mbuf.h>
+#include <rte_ring.h>
+
+#include <stdio.h>
+
+#define TRACE_RING_SIZE 1024
+
+// Packet trace state of one datapath lcore. Only the worker of that lcore
+// picks the packets to trace, enqueues their records and counts ring_full.
+// The control plane only dequeues records and reads ring_full atomically.
+struct __rte_cache_aligned trace_worker {
+	struct rte_ring *ring; // single producer, drained by the control plane
+	uint32_t sample_count;
+	uint64_t ring_full;
+};
+
+static struct trace_worker trace_workers[RTE_MAX_LCORE];
+static uint32_t trace_sample_rate = 1;
+static uint16_t trace_iface_id = GR_IFACE_ID_UNDEF;
+
+void trace_configure(uint16_t iface_id, uint32_t sample_rate) {
+	__atomic_store_n(&trace_iface_id, iface_id, __ATOMIC_RELAXED);
+	__atomic_store_n(&trace_sample_rate, sample_rate ?: 1, __ATOMIC_RELAXED);
+}
+
+static inline bool trace_sample(struct trace_worker *w) {
+	uint32_t rate = __atomic_load_n(&trace_sample_rate, __ATOMIC_RELAXED);
+	if (++w->sample_count < rate)
+		return false;
+	w->sample_count = 0;
+	return true;
+}
+
+static inline void
+trace_record_push(struct trace_worker *w, const struct rte_node *node, struct trace_record *r) {
+	r->timestamp = rte_rdtsc();
+	r->node_id = node->id;
+	if (rte_ring_sp_enqueue_elem(w->ring, r, sizeof(*r)) < 0)
+		w->ring_full++;
+}
+
+static void trace_record_packet(
+	struct trace_worker *w,
+	const struct rte_node *node,
+	uint16_t iface_id,
+	const struct rte_mbuf *m
+) {
+	struct trace_record r;
+
+	r.iface_id = iface_id;
+	r.vlan_id = 0;
+	if (m->ol_flags & RTE_MBUF_F_RX_VLAN_STRIPPED)
+		r.vlan_id = m->vlan_tci & 0xfff;
+	r.pkt_len = rte_pktmbuf_pkt_len(m);
+	r.len = RTE_MIN(rte_pktmbuf_data_len(m), (uint16_t)TRACE_SNAPLEN);
+	memcpy(r.data, rte_pktmbuf_mtod(m, const void *), r.len);
+
+	trace_record_push(w, node, &r);
+}
+
+void trace_packet(const struct rte_node *node, uint16_t iface_id, const struct rte_mbuf *m) {
+	struct trace_worker *w = &trace_workers[rte_lcore_id()];
+	uint16_t filter = __atomic_load_n(&trace_iface_id, __ATOMIC_RELAXED);
+
+	if (w->ring == NULL)
+		return;
+	if (filter != GR_IFACE_ID_UNDEF && filter != iface_id)
+		return;
+	if (!trace_sample(w))
+		return;
+
+	trace_record_packet(w, node, iface_id, m);
+}
+
+void trace_drop(const struct rte_node *node, uint16_t nb_objs) {
+	struct trace_worker *w = &trace_workers[rte_lcore_id()];
+	struct trace_record r;
+
+	// dropped packets are not associated to an interface
+	if (w->ring == NULL)
+		return;
+	if (__atomic_load_n(&trace_iface_id, __ATOMIC_RELAXED) != GR_IFACE_ID_UNDEF)
+		return;
+
+	r.iface_id = GR_IFACE_ID_UNDEF;
+	r.vlan_id = 0;
+	r.pkt_len = nb_objs;
+	r.len = 0;
+
+	trace_record_push(w, node, &r);
+}
+
+void trace_drop_packet(const struct rte_node *node, uint16_t iface_id, const struct rte_mbuf *m) {
+	struct trace_worker *w = &trace_workers[rte_lcore_id()];
+
+	if (w->ring == NULL)
+		return;
+
+	trace_record_packet(w, node, iface_id, m);
+}
+
+unsigned trace_dequeue(struct trace_record *records, unsigned n) {
+	unsigned count = 0;
+
+	for (unsigned i = 0; i < RTE_MAX_LCORE && count < n; i++) {
+		if (trace_workers[i].ring == NULL)
+			continue;
+		count += rte_ring_sc_dequeue_burst_elem(
+			trace_workers[i].ring, &records[count], sizeof(*records), n - count, NULL
+		);
+	}
+
+	return count;
+}
+
+uint64_t trace_ring_full(void) {
+	uint64_t total = 0;
+
+	for (unsigned i = 0; i < RTE_MAX_LCORE; i++)
+		total += __atomic_load_n(&trace_workers[i].ring_full, __ATOMIC_RELAXED);
+
+	return total;
+}
+
+static void trace_init_dp(void) {
+	unsigned lcore_id = rte_lcore_id();
+	char name[RTE_RING_NAMESIZE];
+
+	if (trace_workers[lcore_id].ring != NULL)
+		return;
+
+	snprintf(name, sizeof(name), "trace_%u", lcore_id);
+	trace_workers[lcore_id].ring = rte_ring_create_elem(
+		name,
+		sizeof(struct trace_record),
+		TRACE_RING_SIZE,
+		rte_socket_id(),
+		RING_F_SP_ENQ | RING_F_SC_DEQ
+	);
+	if (trace_workers[lcore_id].ring == NULL)
+		ABORT("rte_ring_create(%s): %s", name, rte_strerror(rte_errno));
+}
+
+static void trace_fini(struct event_base *) {
+	for (unsigned i = 0; i < RTE_MAX_LCORE; i++) {
+		rte_ring_free(trace_workers[i].ring);
+		trace_workers[i].ring = NULL;
+	}
+}
+
+static struct gr_module trace_module = {
+	.name = "trace rings",
+	.fini = trace_fini,
+	.init_dp = trace_init_dp,
+};
+
+RTE_INIT(trace_constructor) {
+	gr_register_module(&trace_module);
+}
+
+// Decoding is done by the control plane. The snapshot may be truncated, never
+// read headers past its length.
+#define SNAP(r, type, off)                                                                         \
+	((off) + sizeof(*(type)NULL) <= (r)->len ? (type)((r)->data + (off)) : NULL)
 
 static ssize_t trace_icmp6(
 	char *buf,
 	const size_t len,
-	const struct rte_mbuf *,
+	const struct trace_record *,
 	size_t *offset,
 	uint16_t payload_len
 );
 
-void trace_packet(const char *node, const char *iface, const struct rte_mbuf *m) {
-	char buf[BUFSIZ], src[64], dst[64];
+ssize_t trace_format(const struct trace_record *r, char *buf, size_t len) {
+	char src[64], dst[64], node[RTE_NODE_NAMESIZE];
 	const struct rte_ether_hdr *eth;
+	const struct iface *iface;
 	uint16_t ether_type;
 	size_t offset = 0;
 	ssize_t n = 0;
 
-	eth = rte_pktmbuf_mtod_offset(m, const struct rte_ether_hdr *, offset);
+	memccpy(node, rte_node_id_to_name(r->node_id) ?: "?", 0, sizeof(node));
+	node[sizeof(node) - 1] = '\0';
+
+	if (r->iface_id == GR_IFACE_ID_UNDEF) {
+		return snprintf(buf, len, "[%s] %u packets", node, r->pkt_len);
+	}
+	iface = iface_from_id(r->iface_id);
+	n += snprintf(buf + n, len - n, "[%s %s] ", node, iface ? iface->name : "?");
+
+	if ((eth = SNAP(r, const struct rte_ether_hdr *, offset)) == NULL)
+		goto truncated;
 	offset += sizeof(*eth);
 	ether_type = rte_be_to_cpu_16(eth->ether_type);
 
 	n += snprintf(
 		buf + n,
-		sizeof(buf) - n,
+		len - n,
 		ETH_ADDR_FMT " > " ETH_ADDR_FMT,
 		ETH_ADDR_SPLIT(&eth->src_addr),
 		ETH_ADDR_SPLIT(&eth->dst_addr)
 	);
 
-	if (m->ol_flags & RTE_MBUF_F_RX_VLAN_STRIPPED) {
-		uint16_t vlan_id = m->vlan_tci & 0xfff;
-		n += snprintf(buf + n, sizeof(buf) - n, " / VLAN id=%u", vlan_id);
+	if (r->vlan_id != 0) {
+		n += snprintf(buf + n, len - n, " / VLAN id=%u", r->vlan_id);
 	} else if (ether_type == RTE_ETHER_TYPE_VLAN) {
 		const struct rte_vlan_hdr *vlan;
 		uint16_t vlan_id;
 
-		vlan = rte_pktmbuf_mtod_offset(m, const struct rte_vlan_hdr *, offset);
+		if ((vlan = SNAP(r, const struct rte_vlan_hdr *, offset)) == NULL)
+			goto truncated;
 		offset += sizeof(*vlan);
 		vlan_id = rte_be_to_cpu_16(vlan->vlan_tci) & 0xfff;
 		ether_type = rte_be_to_cpu_16(vlan->eth_proto);
-		n += snprintf(buf + n, sizeof(buf) - n, " / VLAN id=%u", vlan_id);
+		n += snprintf(buf + n, len - n, " / VLAN id=%u", vlan_id);
 	}
 
 	switch (ether_type) {
@@ -63,34 +241,31 @@ void trace_packet(const char *node, const char *iface, const struct rte_mbuf *m)
 ipv4:
 		const struct rte_ipv4_hdr *ip;
 
-		ip = rte_pktmbuf_mtod_offset(m, const struct rte_ipv4_hdr *, offset);
+		if ((ip = SNAP(r, const struct rte_ipv4_hdr *, offset)) == NULL)
+			goto truncated;
 		offset += sizeof(*ip);
 		inet_ntop(AF_INET, &ip->src_addr, src, sizeof(src));
 		inet_ntop(AF_INET, &ip->dst_addr, dst, sizeof(dst));
 		n += snprintf(
-			buf + n,
-			sizeof(buf) - n,
-			" / IP %s > %s ttl=%hhu",
-			src,
-			dst,
-			ip->time_to_live
+			buf + n, len - n, " / IP %s > %s ttl=%hhu", src, dst, ip->time_to_live
 		);
 
 		switch (ip->next_proto_id) {
 		case IPPROTO_ICMP: {
 			const struct rte_icmp_hdr *icmp;
-			icmp = rte_pktmbuf_mtod_offset(m, const struct rte_icmp_hdr *, offset);
-			n += snprintf(buf + n, sizeof(buf) - n, " / ICMP");
+			if ((icmp = SNAP(r, const struct rte_icmp_hdr *, offset)) == NULL)
+				goto truncated;
+			n += snprintf(buf + n, len - n, " / ICMP");
 
 			if (icmp->icmp_type == RTE_IP_ICMP_ECHO_REQUEST && icmp->icmp_code == 0) {
-				n += snprintf(buf + n, sizeof(buf) - n, " echo request");
+				n += snprintf(buf + n, len - n, " echo request");
 			} else if (icmp->icmp_type == RTE_IP_ICMP_ECHO_REPLY
 				   && icmp->icmp_code == 0) {
-				n += snprintf(buf + n, sizeof(buf) - n, " echo reply");
+				n += snprintf(buf + n, len - n, " echo reply");
 			} else {
 				n += snprintf(
 					buf + n,
-					sizeof(buf) - n,
+					len - n,
 					" type=%hhu code=%hhu",
 					icmp->icmp_type,
 					icmp->icmp_code
@@ -98,7 +273,7 @@ ipv4:
 			}
 			n += snprintf(
 				buf + n,
-				sizeof(buf) - n,
+				len - n,
 				" id=%u seq=%u",
 				rte_be_to_cpu_16(icmp->icmp_ident),
 				rte_be_to_cpu_16(icmp->icmp_seq_nb)
@@ -108,7 +283,7 @@ ipv4:
 		case IPPROTO_IPIP:
 			goto ipv4;
 		default:
-			n += snprintf(buf + n, sizeof(buf) - n, " proto=%hhu", ip->next_proto_id);
+			n += snprintf(buf + n, len - n, " proto=%hhu", ip->next_proto_id);
 			break;
 		}
 
@@ -119,37 +294,29 @@ ipv4:
 		uint16_t payload_len;
 		int proto;
 
-		ip6 = rte_pktmbuf_mtod_offset(m, const struct rte_ipv6_hdr *, offset);
+		if ((ip6 = SNAP(r, const struct rte_ipv6_hdr *, offset)) == NULL)
+			goto truncated;
 		offset += sizeof(*ip6);
 		inet_ntop(AF_INET6, &ip6->src_addr, src, sizeof(src));
 		inet_ntop(AF_INET6, &ip6->dst_addr, dst, sizeof(dst));
 		n += snprintf(
-			buf + n,
-			sizeof(buf) - n,
-			" / IPv6 %s > %s ttl=%hhu",
-			src,
-			dst,
-			ip6->hop_limits
+			buf + n, len - n, " / IPv6 %s > %s ttl=%hhu", src, dst, ip6->hop_limits
 		);
 		payload_len = rte_be_to_cpu_16(ip6->payload_len);
 		proto = ip6->proto;
 
 		for (;;) {
 			size_t ext_size = 0;
-			int next_proto = rte_ipv6_get_next_ext(
-				rte_pktmbuf_mtod_offset(m, const uint8_t *, offset),
-				proto,
-				&ext_size
-			);
+			int next_proto;
+			// extension headers are at least 8 bytes long
+			if (SNAP(r, const uint64_t *, offset) == NULL)
+				goto truncated;
+			next_proto = rte_ipv6_get_next_ext(r->data + offset, proto, &ext_size);
 			if (next_proto < 0)
 				break;
 			if (proto != IPPROTO_HOPOPTS)
 				n += snprintf(
-					buf + n,
-					sizeof(buf) - n,
-					" Ext(%hhu len=%zu)",
-					proto,
-					ext_size
+					buf + n, len - n, " Ext(%hhu len=%zu)", proto, ext_size
 				);
 			offset += ext_size;
 			proto = next_proto;
@@ -157,10 +324,10 @@ ipv4:
 
 		switch (proto) {
 		case IPPROTO_ICMPV6:
-			n += trace_icmp6(buf + n, sizeof(buf) - n, m, &offset, payload_len);
+			n += trace_icmp6(buf + n, len - n, r, &offset, payload_len);
 			break;
 		default:
-			n += snprintf(buf + n, sizeof(buf) - n, " nh=%hhu", proto);
+			n += snprintf(buf + n, len - n, " nh=%hhu", proto);
 			break;
 		}
 
@@ -169,25 +336,22 @@ ipv4:
 	case RTE_ETHER_TYPE_ARP: {
 		const struct rte_arp_hdr *arp;
 
-		arp = rte_pktmbuf_mtod_offset(m, const struct rte_arp_hdr *, offset);
+		if ((arp = SNAP(r, const struct rte_arp_hdr *, offset)) == NULL)
+			goto truncated;
 
 		switch (rte_be_to_cpu_16(arp->arp_opcode)) {
 		case RTE_ARP_OP_REQUEST:
 			inet_ntop(AF_INET, &arp->arp_data.arp_sip, src, sizeof(src));
 			inet_ntop(AF_INET, &arp->arp_data.arp_tip, dst, sizeof(dst));
 			n += snprintf(
-				buf + n,
-				sizeof(buf) - n,
-				" / ARP request who has %s? tell %s",
-				dst,
-				src
+				buf + n, len - n, " / ARP request who has %s? tell %s", dst, src
 			);
 			break;
 		case RTE_ARP_OP_REPLY:
 			inet_ntop(AF_INET, &arp->arp_data.arp_sip, src, sizeof(src));
 			n += snprintf(
 				buf + n,
-				sizeof(buf) - n,
+				len - n,
 				" / ARP reply %s is at " ETH_ADDR_FMT,
 				src,
 				ETH_ADDR_SPLIT(&eth->src_addr)
@@ -196,7 +360,7 @@ ipv4:
 		default:
 			n += snprintf(
 				buf + n,
-				sizeof(buf) - n,
+				len - n,
 				" / ARP opcode=%u",
 				rte_be_to_cpu_16(arp->arp_opcode)
 			);
@@ -205,18 +369,22 @@ ipv4:
 		break;
 	}
 	default:
-		n += snprintf(buf + n, sizeof(buf) - n, " type=0x%04x", ether_type);
+		n += snprintf(buf + n, len - n, " type=0x%04x", ether_type);
 		break;
 	}
-	n += snprintf(buf + n, sizeof(buf) - n, ", (pkt_len=%u)", m->pkt_len);
+	goto end;
+truncated:
+	n += snprintf(buf + n, len - n, " [truncated]");
+end:
+	n += snprintf(buf + n, len - n, ", (pkt_len=%u)", r->pkt_len);
 
-	LOG(NOTICE, "[%s %s] %s", node, iface, buf);
+	return n;
 }
 
 static ssize_t trace_icmp6(
 	char *buf,
 	const size_t len,
-	const struct rte_mbuf *m,
+	const struct trace_record *r,
 	size_t *offset,
 	uint16_t payload_len
 ) {
@@ -226,7 +394,8 @@ static ssize_t trace_icmp6(
 	ssize_t n = 0;
 
 	n += snprintf(buf + n, len - n, " / ICMPv6");
-	icmp6 = rte_pktmbuf_mtod_offset(m, const struct icmp6 *, *offset);
+	if ((icmp6 = SNAP(r, const struct icmp6 *, *offset)) == NULL)
+		return n;
 	*offset += sizeof(*icmp6);
 	payload_len -= sizeof(*icmp6);
 
@@ -244,7 +413,9 @@ static ssize_t trace_icmp6(
 		n += snprintf(buf + n, len - n, " parameter problem");
 		break;
 	case ICMP6_TYPE_ECHO_REQUEST: {
-		const struct icmp6_echo_request *req = PAYLOAD(icmp6);
+		const struct icmp6_echo_request *req;
+		if ((req = SNAP(r, const struct icmp6_echo_request *, *offset)) == NULL)
+			break;
 		*offset += sizeof(*req);
 		payload_len -= sizeof(*req);
 		n += snprintf(
@@ -257,7 +428,9 @@ static ssize_t trace_icmp6(
 		break;
 	}
 	case ICMP6_TYPE_ECHO_REPLY: {
-		const struct icmp6_echo_reply *reply = PAYLOAD(icmp6);
+		const struct icmp6_echo_reply *reply;
+		if ((reply = SNAP(r, const struct icmp6_echo_reply *, *offset)) == NULL)
+			break;
 		*offset += sizeof(*reply);
 		payload_len -= sizeof(*reply);
 		n += snprintf(
@@ -270,35 +443,37 @@ static ssize_t trace_icmp6(
 		break;
 	}
 	case ICMP6_TYPE_ROUTER_SOLICIT:
-		const struct icmp6_router_solicit *rs = PAYLOAD(icmp6);
-		*offset += sizeof(*rs);
-		payload_len -= sizeof(*rs);
 		n += snprintf(buf + n, len - n, " router solicit");
-		opt = PAYLOAD(rs);
+		*offset += sizeof(struct icmp6_router_solicit);
+		payload_len -= sizeof(struct icmp6_router_solicit);
+		opt = SNAP(r, const struct icmp6_opt *, *offset);
 		break;
 	case ICMP6_TYPE_ROUTER_ADVERT:
-		const struct icmp6_router_advert *ra = PAYLOAD(icmp6);
-		*offset += sizeof(*ra);
-		payload_len -= sizeof(*ra);
 		n += snprintf(buf + n, len - n, " router advert");
-		opt = PAYLOAD(ra);
+		*offset += sizeof(struct icmp6_router_advert);
+		payload_len -= sizeof(struct icmp6_router_advert);
+		opt = SNAP(r, const struct icmp6_opt *, *offset);
 		break;
 	case ICMP6_TYPE_NEIGH_SOLICIT: {
-		const struct icmp6_neigh_solicit *ns = PAYLOAD(icmp6);
+		const struct icmp6_neigh_solicit *ns;
+		if ((ns = SNAP(r, const struct icmp6_neigh_solicit *, *offset)) == NULL)
+			break;
 		*offset += sizeof(*ns);
 		payload_len -= sizeof(*ns);
 		inet_ntop(AF_INET6, &ns->target, dst, sizeof(dst));
 		n += snprintf(buf + n, len - n, " neigh solicit who has %s?", dst);
-		opt = PAYLOAD(ns);
+		opt = SNAP(r, const struct icmp6_opt *, *offset);
 		break;
 	}
 	case ICMP6_TYPE_NEIGH_ADVERT: {
-		const struct icmp6_neigh_advert *na = PAYLOAD(icmp6);
+		const struct icmp6_neigh_advert *na;
+		if ((na = SNAP(r, const struct icmp6_neigh_advert *, *offset)) == NULL)
+			break;
 		*offset += sizeof(*na);
 		payload_len -= sizeof(*na);
 		inet_ntop(AF_INET6, &na->target, dst, sizeof(dst));
 		n += snprintf(buf + n, len - n, " neigh advert %s is at", dst);
-		opt = PAYLOAD(na);
+		opt = SNAP(r, const struct icmp6_opt *, *offset);
 		break;
 	}
 	default:
@@ -307,10 +482,14 @@ static ssize_t trace_icmp6(
 		break;
 	}
 
-	while (payload_len >= 8 && opt != NULL) {
+	while (payload_len >= 8 && opt != NULL && opt->len != 0) {
+		const struct icmp6_opt_lladdr *ll;
+
 		switch (opt->type) {
-		case ICMP6_OPT_SRC_LLADDR: {
-			const struct icmp6_opt_lladdr *ll = PAYLOAD(opt);
+		case ICMP6_OPT_SRC_LLADDR:
+			if ((ll = SNAP(r, const struct icmp6_opt_lladdr *, *offset + sizeof(*opt)))
+			    == NULL)
+				return n;
 			n += snprintf(
 				buf + n,
 				len - n,
@@ -318,9 +497,10 @@ static ssize_t trace_icmp6(
 				ETH_ADDR_SPLIT(&ll->mac)
 			);
 			break;
-		}
-		case ICMP6_OPT_TARGET_LLADDR: {
-			const struct icmp6_opt_lladdr *ll = PAYLOAD(opt);
+		case ICMP6_OPT_TARGET_LLADDR:
+			if ((ll = SNAP(r, const struct icmp6_opt_lladdr *, *offset + sizeof(*opt)))
+			    == NULL)
+				return n;
 			n += snprintf(
 				buf + n,
 				len - n,
@@ -328,7 +508,6 @@ static ssize_t trace_icmp6(
 				ETH_ADDR_SPLIT(&ll->mac)
 			);
 			break;
-		}
 		default:
 			n += snprintf(
 				buf + n,
@@ -342,7 +521,7 @@ static ssize_t trace_icmp6(
 		}
 		*offset += opt->len * 8;
 		payload_len -= opt->len * 8;
-		opt = rte_pktmbuf_mtod_offset(m, const struct icmp6_opt *, *offset);
+		opt = SNAP(r, const struct icmp6_opt *, *offset);
 	}
 
 	return n;
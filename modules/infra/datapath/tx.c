@@ -1,28 +1,400 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // Copyright (c) 2023 Robin Jarry
 
+#include "gr_bench.h"
+#include "gr_datapath.h"
+#include "gr_mirror.h"
 #include "gr_tx.h"
 
+#include <gr.h>
 #include <gr_graph.h>
+#include <gr_iface.h>
+#include <gr_infra.h>
 #include <gr_log.h>
+#include <gr_rcu.h>
 #include <gr_worker.h>
 
 #include <rte_build_config.h>
+#include <rte_cycles.h>
 #include <rte_ethdev.h>
+#include <rte_ether.h>
 #include <rte_graph_worker.h>
+#include <rte_ip.h>
+#include <rte_ip6.h>
 #include <rte_malloc.h>
+#include <rte_ring.h>
+#include <rte_sched.h>
 
 #include <stdint.h>
+#include <unistd.h>
 
 enum {
 	TX_ERROR = 0,
+	BENCH_SINK,
 	NB_EDGES,
 };
 
+// Per worker software queue for packets that the driver did not accept.
+struct tx_overflow {
+	uint32_t head;
+	uint32_t count;
+	uint32_t limit;
+	uint32_t mask;
+	struct {
+		struct rte_mbuf *mbuf;
+		uint64_t tsc; // when the packet was queued
+	} entries[];
+};
+
+struct tx_port {
+	uint16_t txq_id;
+	struct tx_port_policy policy;
+	// txq owned by another worker which will drain the ring
+	struct rte_ring *ring;
+	// only for txqs owned by this worker
+	struct rte_eth_dev_tx_buffer *buffer;
+	uint64_t deadline; // when the buffer must be flushed, 0 when empty
+	// only with GR_PORT_TX_QUEUE
+	struct tx_overflow *overflow;
+	// non-NULL when the port has a scheduler
+	struct tx_sched *sched;
+	bool sched_local; // the scheduler runs on this worker
+	// non-NULL when the txq returns sent mbufs to this pool in bulk
+	struct rte_mempool *fast_free_pool;
+};
+
 struct tx_ctx {
-	uint16_t txq_ids[RTE_MAX_ETHPORTS];
+	struct rte_graph *graph;
+	struct rte_node *node;
+	// maximum time packets can stay in the tx buffers
+	uint64_t flush_cycles;
+	// ports with packets in their tx buffer
+	uint16_t n_pending;
+	uint16_t pending[RTE_MAX_ETHPORTS];
+	// ports with an overflow queue
+	uint16_t n_overflows;
+	uint16_t overflows[RTE_MAX_ETHPORTS];
+	// ports whose scheduler runs on this worker
+	uint16_t n_scheds;
+	uint16_t scheds[RTE_MAX_ETHPORTS];
+	// published by the control plane, switched to by port_tx_drain
+	struct tx_ctx *next;
+	struct tx_drain_ctx *next_drain;
+	struct tx_port ports[RTE_MAX_ETHPORTS];
+};
+
+struct tx_drain_ctx {
+	// port_tx node of the same graph, to flush its buffers when it is not called
+	const struct rte_node *tx_node;
+	uint16_t n_drains;
+	struct tx_ring_drain drains[];
 };
 
+static inline struct iface_stats *tx_stats(const struct tx_port *p) {
+	return &iface_stats[rte_lcore_id()][p->policy.iface_id];
+}
+
+static inline void
+tx_drop(struct tx_ctx *ctx, struct tx_port *p, struct rte_mbuf **mbufs, uint16_t n) {
+	struct iface_stats *s = tx_stats(p);
+	s->tx_drop.packets += n;
+	s->tx_drop.calls++;
+	rte_node_enqueue(ctx->graph, ctx->node, TX_ERROR, (void **)mbufs, n);
+}
+
+static inline void tx_overflow_push(
+	struct tx_ctx *ctx,
+	struct tx_port *p,
+	struct rte_mbuf **mbufs,
+	uint16_t n,
+	uint64_t now
+) {
+	struct tx_overflow *q = p->overflow;
+	uint16_t i;
+
+	for (i = 0; i < n && q->count < q->limit; i++) {
+		uint32_t e = (q->head + q->count++) & q->mask;
+		q->entries[e].mbuf = mbufs[i];
+		q->entries[e].tsc = now;
+	}
+	tx_stats(p)->tx_queue.calls += i;
+	if (i < n)
+		tx_drop(ctx, p, &mbufs[i], n - i);
+}
+
+// Send as many queued packets as possible, oldest first.
+static inline void tx_overflow_flush(uint16_t port_id, struct tx_port *p, uint64_t now) {
+	struct rte_mbuf *mbufs[RTE_GRAPH_BURST_SIZE];
+	struct tx_overflow *q = p->overflow;
+	struct iface_stats *s = tx_stats(p);
+	uint16_t n, tx_ok;
+
+	while (q->count > 0) {
+		n = RTE_MIN(q->count, q->mask + 1 - q->head);
+		n = RTE_MIN(n, RTE_GRAPH_BURST_SIZE);
+		for (uint16_t i = 0; i < n; i++)
+			mbufs[i] = q->entries[q->head + i].mbuf;
+
+		tx_ok = rte_eth_tx_burst(port_id, p->txq_id, mbufs, n);
+		for (uint16_t i = 0; i < tx_ok; i++)
+			s->tx_queue.cycles += now - q->entries[q->head + i].tsc;
+		s->tx_queue.packets += tx_ok;
+		q->head = (q->head + tx_ok) & q->mask;
+		q->count -= tx_ok;
+		if (tx_ok < n)
+			break;
+	}
+}
+
+// Send packets on a txq owned by this worker, apply the port tx policy if the
+// driver does not accept all of them.
+static inline void
+tx_send(struct tx_ctx *ctx, uint16_t port_id, struct rte_mbuf **mbufs, uint16_t n) {
+	struct tx_port *p = &ctx->ports[port_id];
+	uint16_t tx_ok, sent;
+	struct iface_stats *s;
+	uint64_t start;
+
+	if (unlikely(dwell_enabled))
+		dwell_record(mbufs, n);
+
+	if (p->overflow != NULL && p->overflow->count > 0) {
+		// preserve ordering, older packets must be sent first
+		start = rte_rdtsc();
+		tx_overflow_flush(port_id, p, start);
+		if (p->overflow->count > 0) {
+			tx_overflow_push(ctx, p, mbufs, n, start);
+			return;
+		}
+	}
+
+	tx_ok = rte_eth_tx_burst(port_id, p->txq_id, mbufs, n);
+	if (likely(tx_ok == n))
+		return;
+
+	switch (p->policy.type) {
+	case GR_PORT_TX_RETRY:
+		s = tx_stats(p);
+		start = rte_rdtsc();
+		for (uint16_t r = 0; r < p->policy.limit && tx_ok < n; r++) {
+			sent = rte_eth_tx_burst(port_id, p->txq_id, &mbufs[tx_ok], n - tx_ok);
+			s->tx_retry.packets += sent;
+			s->tx_retry.calls++;
+			tx_ok += sent;
+		}
+		s->tx_retry.cycles += rte_rdtsc() - start;
+		if (tx_ok < n)
+			tx_drop(ctx, p, &mbufs[tx_ok], n - tx_ok);
+		break;
+	case GR_PORT_TX_QUEUE:
+		tx_overflow_push(ctx, p, &mbufs[tx_ok], n - tx_ok, rte_rdtsc());
+		break;
+	default:
+		tx_drop(ctx, p, &mbufs[tx_ok], n - tx_ok);
+		break;
+	}
+}
+
+static inline void tx_flush(struct tx_ctx *ctx, uint64_t now) {
+	struct rte_eth_dev_tx_buffer *buf;
+	uint16_t port_id;
+
+	for (uint16_t i = 0; i < ctx->n_pending;) {
+		port_id = ctx->pending[i];
+		if (ctx->ports[port_id].deadline > now) {
+			i++;
+			continue;
+		}
+		buf = ctx->ports[port_id].buffer;
+		if (buf->length > 0)
+			tx_send(ctx, port_id, buf->pkts, buf->length);
+		buf->length = 0;
+		ctx->ports[port_id].deadline = 0;
+		ctx->pending[i] = ctx->pending[--ctx->n_pending];
+	}
+}
+
+static inline bool tx_fast_free_ok(const struct rte_mbuf *m, const struct rte_mempool *pool) {
+	for (; m != NULL; m = m->next) {
+		if (m->pool != pool || !RTE_MBUF_DIRECT(m) || rte_mbuf_refcnt_read(m) != 1)
+			return false;
+	}
+	return true;
+}
+
+// With RTE_ETH_TX_OFFLOAD_MBUF_FAST_FREE, the driver puts sent mbufs back in
+// the pool of the first one without checking their reference count. Clones,
+// indirect mbufs and packets allocated from other pools (multicast copies,
+// mirrored frames, fragments, locally generated packets) are copied into the
+// port pool. Returns the number of packets left in the array.
+static inline uint16_t
+tx_fast_free_prepare(struct tx_ctx *ctx, struct tx_port *p, struct rte_mbuf **mbufs, uint16_t n) {
+	struct rte_mbuf *m, *c;
+	uint16_t i, j;
+
+	for (i = 0, j = 0; i < n; i++) {
+		m = mbufs[i];
+		if (likely(tx_fast_free_ok(m, p->fast_free_pool))) {
+			mbufs[j++] = m;
+			continue;
+		}
+		if ((c = rte_pktmbuf_copy(m, p->fast_free_pool, 0, UINT32_MAX)) == NULL) {
+			tx_drop(ctx, p, &m, 1);
+			continue;
+		}
+		rte_pktmbuf_free(m);
+		mbufs[j++] = c;
+	}
+
+	return j;
+}
+
+// Send packets on the txq of this worker or hand them over to its owner.
+static inline void
+tx_queue(struct tx_ctx *ctx, uint16_t port_id, struct rte_mbuf **mbufs, uint16_t n) {
+	struct tx_port *p = &ctx->ports[port_id];
+	struct rte_eth_dev_tx_buffer *buf;
+	uint16_t tx_ok;
+
+	if (p->fast_free_pool != NULL)
+		n = tx_fast_free_prepare(ctx, p, mbufs, n);
+
+	if ((buf = p->buffer) != NULL) {
+		// accumulate packets until a full burst is available or the deadline
+		// has passed
+		if (p->deadline == 0) {
+			p->deadline = rte_rdtsc() + ctx->flush_cycles;
+			ctx->pending[ctx->n_pending++] = port_id;
+		}
+		for (uint16_t i = 0; i < n; i++) {
+			buf->pkts[buf->length++] = mbufs[i];
+			if (buf->length == buf->size) {
+				tx_send(ctx, port_id, buf->pkts, buf->length);
+				buf->length = 0;
+			}
+		}
+	} else if (p->txq_id == 0xffff) {
+		rte_node_enqueue(ctx->graph, ctx->node, TX_ERROR, (void *)mbufs, n);
+	} else if (p->ring != NULL) {
+		// txq owned by another worker which will drain the ring
+		tx_ok = rte_ring_mp_enqueue_burst(p->ring, (void **)mbufs, n, NULL);
+		if (tx_ok < n) {
+			rte_node_enqueue(
+				ctx->graph, ctx->node, TX_ERROR, (void *)&mbufs[tx_ok], n - tx_ok
+			);
+		}
+	}
+}
+
+// Select the pipe from the VLAN ID and the traffic class from the DSCP class
+// selector or the VLAN priority. Priorities 7 to 1 map to the strict priority
+// classes 0 to 6, priority 0 to the best effort queues.
+static inline void tx_sched_classify(const struct tx_sched *s, struct rte_mbuf *m) {
+	const struct rte_ether_hdr *eth = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
+	const struct rte_ipv4_hdr *ip;
+	const struct rte_ipv6_hdr *ip6;
+	const struct rte_vlan_hdr *vlan;
+	rte_be16_t type = eth->ether_type;
+	uint16_t off = sizeof(*eth);
+	uint8_t prio, dscp = 0;
+	uint16_t tci = 0;
+	uint32_t tc;
+
+	if (m->ol_flags & RTE_MBUF_F_TX_VLAN) {
+		tci = m->vlan_tci;
+	} else if (type == RTE_BE16(RTE_ETHER_TYPE_VLAN)) {
+		vlan = (const struct rte_vlan_hdr *)(eth + 1);
+		tci = rte_be_to_cpu_16(vlan->vlan_tci);
+		type = vlan->eth_proto;
+		off += sizeof(*vlan);
+	}
+
+	if (s->classify == GR_PORT_QOS_PCP) {
+		prio = tci >> 13;
+	} else {
+		if (type == RTE_BE16(RTE_ETHER_TYPE_IPV4)) {
+			ip = rte_pktmbuf_mtod_offset(m, const struct rte_ipv4_hdr *, off);
+			dscp = ip->type_of_service >> 2;
+		} else if (type == RTE_BE16(RTE_ETHER_TYPE_IPV6)) {
+			ip6 = rte_pktmbuf_mtod_offset(m, const struct rte_ipv6_hdr *, off);
+			dscp = (rte_be_to_cpu_32(ip6->vtc_flow) >> 22) & 0x3f;
+		}
+		prio = dscp >> 3;
+	}
+	tc = prio == 0 ? RTE_SCHED_TRAFFIC_CLASS_BE : 7 - prio;
+
+	rte_sched_port_pkt_write(
+		s->port,
+		m,
+		0,
+		(tci & RTE_VLAN_ID_MASK) & s->pipe_mask,
+		tc,
+		prio == 0 ? dscp % RTE_SCHED_BE_QUEUES_PER_PIPE : 0,
+		RTE_COLOR_GREEN
+	);
+}
+
+static inline void tx_sched_enqueue(struct tx_sched *s, struct rte_mbuf **mbufs, uint16_t n) {
+	// dropped packets are freed by rte_sched
+	int n_ok = rte_sched_port_enqueue(s->port, mbufs, n);
+
+	s->enqueued += n_ok;
+	s->dropped += n - n_ok;
+}
+
+// Enqueue classified packets in the scheduler of their port. Inline when it
+// runs on this worker, through its ring otherwise.
+static inline void
+tx_sched_submit(struct tx_ctx *ctx, uint16_t port_id, struct rte_mbuf **mbufs, uint16_t n) {
+	struct tx_port *p = &ctx->ports[port_id];
+	unsigned n_ok;
+
+	for (uint16_t i = 0; i < n; i++)
+		tx_sched_classify(p->sched, mbufs[i]);
+
+	if (p->sched_local) {
+		tx_sched_enqueue(p->sched, mbufs, n);
+		return;
+	}
+	n_ok = rte_ring_mp_enqueue_burst(p->sched->ring, (void **)mbufs, n, NULL);
+	if (n_ok < n)
+		tx_drop(ctx, p, &mbufs[n_ok], n - n_ok);
+}
+
+// Run the scheduler of a port. Called by the worker that owns it.
+static inline uint16_t tx_sched_run(struct tx_ctx *ctx, uint16_t port_id) {
+	struct rte_mbuf *mbufs[RTE_GRAPH_BURST_SIZE];
+	struct tx_sched *s = ctx->ports[port_id].sched;
+	unsigned n;
+
+	// packets classified by other workers
+	n = rte_ring_sc_dequeue_burst(s->ring, (void **)mbufs, ARRAY_DIM(mbufs), NULL);
+	if (n > 0)
+		tx_sched_enqueue(s, mbufs, n);
+
+	n = rte_sched_port_dequeue(s->port, mbufs, ARRAY_DIM(mbufs));
+	if (n > 0)
+		tx_queue(ctx, port_id, mbufs, n);
+
+	return n;
+}
+
+struct port_mirror *port_mirrors[RTE_MAX_ETHPORTS];
+
+// Copies are sent directly, the monitor port cannot be mirrored itself.
+static inline void
+tx_mirror(struct tx_ctx *ctx, struct port_mirror *mir, struct rte_mbuf **mbufs, uint16_t n) {
+	struct rte_mbuf *copies[RTE_GRAPH_BURST_SIZE];
+	uint16_t k, len;
+
+	for (uint16_t i = 0; i < n; i += len) {
+		len = RTE_MIN(n - i, RTE_GRAPH_BURST_SIZE);
+		k = port_mirror_copy(mir, &mbufs[i], len, copies, false);
+		if (k > 0)
+			tx_queue(ctx, mir->dst_port_id, copies, k);
+	}
+}
+
 static inline void tx_burst(
 	struct rte_graph *graph,
 	struct rte_node *node,
@@ -30,17 +402,22 @@ static inline void tx_burst(
 	struct rte_mbuf **mbufs,
 	uint16_t n
 ) {
-	const struct tx_ctx *ctx = node->ctx_ptr;
-	uint16_t txq_id, tx_ok;
+	struct tx_ctx *ctx = node->ctx_ptr;
+	struct port_mirror *mir;
 
-	txq_id = ctx->txq_ids[port_id];
-	if (txq_id == 0xffff) {
-		rte_node_enqueue(graph, node, TX_ERROR, (void *)mbufs, n);
-	} else {
-		tx_ok = rte_eth_tx_burst(port_id, txq_id, mbufs, n);
-		if (tx_ok < n)
-			rte_node_enqueue(graph, node, TX_ERROR, (void *)&mbufs[tx_ok], n - tx_ok);
+	if (unlikely(port_id == bench_sink_port)) {
+		rte_node_enqueue(graph, node, BENCH_SINK, (void *)mbufs, n);
+		return;
 	}
+
+	mir = __atomic_load_n(&port_mirrors[port_id], __ATOMIC_ACQUIRE);
+	if (unlikely(mir != NULL) && mir->flags & GR_PORT_MIRROR_F_TX)
+		tx_mirror(ctx, mir, mbufs, n);
+
+	if (ctx->ports[port_id].sched != NULL)
+		tx_sched_submit(ctx, port_id, mbufs, n);
+	else
+		tx_queue(ctx, port_id, mbufs, n);
 }
 
 static uint16_t
@@ -71,31 +448,285 @@ tx_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t
 	if (burst_start != i)
 		tx_burst(graph, node, port_id, (void *)&objs[burst_start], i - burst_start);
 
+	tx_flush(node->ctx_ptr, rte_rdtsc());
+
 	return nb_objs;
 }
 
+static void tx_ctx_free(struct tx_ctx *ctx) {
+	struct rte_eth_dev_tx_buffer *buf;
+	struct tx_overflow *q;
+
+	if (ctx == NULL)
+		return;
+
+	// the txqs may be used by another worker now, drop the packets
+	for (uint16_t port_id = 0; port_id < RTE_MAX_ETHPORTS; port_id++) {
+		if ((buf = ctx->ports[port_id].buffer) != NULL) {
+			rte_pktmbuf_free_bulk(buf->pkts, buf->length);
+			rte_free(buf);
+		}
+		if ((q = ctx->ports[port_id].overflow) != NULL) {
+			for (uint32_t i = 0; i < q->count; i++)
+				rte_pktmbuf_free(q->entries[(q->head + i) & q->mask].mbuf);
+			rte_free(q);
+		}
+	}
+	rte_free(ctx);
+}
+
+static struct tx_ctx *tx_ctx_new(
+	const struct rte_graph *graph,
+	struct rte_node *node,
+	const struct tx_node_queues *data
+) {
+	struct tx_overflow *q;
+	struct tx_ctx *ctx;
+	struct tx_port *p;
+	uint32_t size;
+
+	ctx = rte_zmalloc_socket(__func__, sizeof(*ctx), RTE_CACHE_LINE_SIZE, graph->socket);
+	if (ctx == NULL) {
+		LOG(ERR, "rte_zmalloc_socket(): %s", rte_strerror(rte_errno));
+		return errno_set_null(ENOMEM);
+	}
+	// only used to enqueue unsent packets from the datapath
+	ctx->graph = (struct rte_graph *)graph;
+	ctx->node = node;
+	ctx->flush_cycles = gr_args()->tx_flush_us * rte_get_tsc_hz() / 1000000;
+
+	for (uint16_t port_id = 0; port_id < RTE_MAX_ETHPORTS; port_id++) {
+		p = &ctx->ports[port_id];
+		p->txq_id = data->txq_ids[port_id];
+		p->policy = data->policies[port_id];
+		p->ring = data->rings[port_id];
+		p->sched = data->scheds[port_id];
+		p->fast_free_pool = data->fast_free_pools[port_id];
+		if (p->txq_id == 0xffff || p->ring != NULL)
+			continue;
+
+		p->buffer = rte_zmalloc_socket(
+			__func__,
+			RTE_ETH_TX_BUFFER_SIZE(RTE_GRAPH_BURST_SIZE),
+			RTE_CACHE_LINE_SIZE,
+			graph->socket
+		);
+		if (p->buffer == NULL)
+			goto nomem;
+		rte_eth_tx_buffer_init(p->buffer, RTE_GRAPH_BURST_SIZE);
+
+		if (p->policy.type != GR_PORT_TX_QUEUE)
+			continue;
+
+		size = rte_align32pow2(p->policy.limit);
+		q = rte_zmalloc_socket(
+			__func__,
+			sizeof(*q) + size * sizeof(q->entries[0]),
+			RTE_CACHE_LINE_SIZE,
+			graph->socket
+		);
+		if (q == NULL)
+			goto nomem;
+		q->limit = p->policy.limit;
+		q->mask = size - 1;
+		p->overflow = q;
+		ctx->overflows[ctx->n_overflows++] = port_id;
+	}
+	for (uint16_t i = 0; i < data->n_scheds; i++) {
+		ctx->ports[data->sched_ports[i]].sched_local = true;
+		ctx->scheds[ctx->n_scheds++] = data->sched_ports[i];
+	}
+
+	return ctx;
+nomem:
+	LOG(ERR, "rte_zmalloc_socket(): %s", rte_strerror(rte_errno));
+	tx_ctx_free(ctx);
+	return errno_set_null(ENOMEM);
+}
+
 static int tx_init(const struct rte_graph *graph, struct rte_node *node) {
 	const struct tx_node_queues *data;
 	struct tx_ctx *ctx;
 
 	if ((data = gr_node_data_get(graph->name, node->name)) == NULL)
 		return -1;
+	if ((ctx = tx_ctx_new(graph, node, data)) == NULL)
+		return -1;
+	node->ctx_ptr = ctx;
+
+	return 0;
+}
+
+static void tx_fini(const struct rte_graph *, struct rte_node *node) {
+	tx_ctx_free(node->ctx_ptr);
+}
+
+// Switch to a new context published by the control plane. The packets waiting
+// on the txqs that are still owned by this worker are carried over. The others
+// are left in the old context and dropped when it is freed.
+static struct tx_ctx *
+tx_ctx_handover(struct rte_node *drain, struct tx_ctx *old, struct tx_ctx *ctx) {
+	struct tx_port *o, *p;
+
+	for (uint16_t port_id = 0; port_id < RTE_MAX_ETHPORTS; port_id++) {
+		o = &old->ports[port_id];
+		p = &ctx->ports[port_id];
+		if (o->buffer == NULL || p->buffer == NULL || o->txq_id != p->txq_id)
+			continue;
+
+		RTE_SWAP(o->buffer, p->buffer);
+		if (o->deadline != 0) {
+			p->deadline = o->deadline;
+			ctx->pending[ctx->n_pending++] = port_id;
+			o->deadline = 0;
+		}
+		if (o->overflow != NULL && p->overflow != NULL
+		    && o->overflow->mask == p->overflow->mask) {
+			RTE_SWAP(o->overflow, p->overflow);
+			p->overflow->limit = p->policy.limit;
+		}
+	}
+
+	__atomic_store_n(&drain->ctx_ptr, old->next_drain, __ATOMIC_RELEASE);
+	// the control plane waits for this store before freeing the old context
+	__atomic_store_n(&ctx->node->ctx_ptr, ctx, __ATOMIC_RELEASE);
+
+	return ctx;
+}
+
+static uint16_t
+tx_drain_process(struct rte_graph *, struct rte_node *node, void **, uint16_t) {
+	const struct tx_drain_ctx *ctx = node->ctx_ptr;
+	uint16_t count = 0, n, port_id;
+	struct tx_ctx *tx, *next;
+	struct tx_port *p;
+
+	// the owned txqs and their tx policy are in the port_tx context
+	tx = __atomic_load_n(&ctx->tx_node->ctx_ptr, __ATOMIC_ACQUIRE);
+	if (unlikely((next = __atomic_load_n(&tx->next, __ATOMIC_ACQUIRE)) != NULL)) {
+		tx = tx_ctx_handover(node, tx, next);
+		ctx = node->ctx_ptr;
+	}
+
+	for (uint16_t i = 0; i < ctx->n_drains; i++) {
+		const struct tx_ring_drain *d = &ctx->drains[i];
+		n = rte_ring_sc_dequeue_burst(d->ring, node->objs, RTE_GRAPH_BURST_SIZE, NULL);
+		if (n == 0)
+			continue;
+		tx_send(tx, d->port_id, (struct rte_mbuf **)node->objs, n);
+		count += n;
+	}
+
+	for (uint16_t i = 0; i < tx->n_scheds; i++)
+		count += tx_sched_run(tx, tx->scheds[i]);
+
+	// port_tx is not called when there are no packets to send
+	for (uint16_t i = 0; i < tx->n_overflows; i++) {
+		port_id = tx->overflows[i];
+		p = &tx->ports[port_id];
+		if (p->overflow->count > 0)
+			tx_overflow_flush(port_id, p, rte_rdtsc());
+	}
+	if (tx->n_pending > 0)
+		tx_flush(tx, rte_rdtsc());
+
+	return count;
+}
+
+static struct rte_node_register node;
+
+// rte_graph_node_get() cannot be used while the graph is being created
+static const struct rte_node *tx_graph_node(const struct rte_graph *graph) {
+	const struct rte_node *n;
+	rte_graph_off_t off;
+	rte_node_t count;
+
+	rte_graph_foreach_node (count, off, graph, n) {
+		if (n->id == node.id)
+			return n;
+	}
+
+	return NULL;
+}
+
+static struct tx_drain_ctx *
+tx_drain_ctx_new(const struct rte_graph *graph, const struct tx_node_queues *data) {
+	struct tx_drain_ctx *ctx;
+	size_t len;
 
-	ctx = rte_malloc(__func__, sizeof(*ctx), RTE_CACHE_LINE_SIZE);
+	len = sizeof(*ctx) + data->n_drains * sizeof(ctx->drains[0]);
+	ctx = rte_malloc_socket(__func__, len, RTE_CACHE_LINE_SIZE, graph->socket);
 	if (ctx == NULL) {
-		LOG(ERR, "rte_malloc(): %s", rte_strerror(rte_errno));
-		return -1;
+		LOG(ERR, "rte_malloc_socket(): %s", rte_strerror(rte_errno));
+		return errno_set_null(ENOMEM);
 	}
-	memcpy(ctx->txq_ids, data->txq_ids, sizeof(ctx->txq_ids));
+	ctx->tx_node = tx_graph_node(graph);
+	if (ctx->tx_node == NULL) {
+		rte_free(ctx);
+		return errno_set_null(ENOENT);
+	}
+	ctx->n_drains = data->n_drains;
+	memcpy(ctx->drains, data->drains, data->n_drains * sizeof(ctx->drains[0]));
+
+	return ctx;
+}
+
+static int tx_drain_init(const struct rte_graph *graph, struct rte_node *node) {
+	const struct tx_node_queues *data;
+	struct tx_drain_ctx *ctx;
+
+	// shares the port_tx node data
+	if ((data = gr_node_data_get(graph->name, "port_tx")) == NULL)
+		return -1;
+	if ((ctx = tx_drain_ctx_new(graph, data)) == NULL)
+		return -1;
 	node->ctx_ptr = ctx;
 
 	return 0;
 }
 
-static void tx_fini(const struct rte_graph *, struct rte_node *node) {
+static void tx_drain_fini(const struct rte_graph *, struct rte_node *node) {
 	rte_free(node->ctx_ptr);
 }
 
+static struct rte_node_register drain_node;
+
+int tx_node_queues_update(
+	struct worker *worker,
+	struct rte_graph *graph,
+	const struct tx_node_queues *data
+) {
+	struct rte_node *n = rte_graph_node_get(graph->id, node.id);
+	struct rte_node *d = rte_graph_node_get(graph->id, drain_node.id);
+	struct tx_drain_ctx *drain_ctx, *old_drain;
+	struct tx_ctx *ctx, *old;
+
+	if (n == NULL || d == NULL)
+		return errno_set(ENOENT);
+	if ((ctx = tx_ctx_new(graph, n, data)) == NULL)
+		return -errno;
+	if ((drain_ctx = tx_drain_ctx_new(graph, data)) == NULL) {
+		tx_ctx_free(ctx);
+		return -errno;
+	}
+
+	old = n->ctx_ptr;
+	old_drain = d->ctx_ptr;
+	// The worker switches to the new contexts itself between two packet
+	// bursts so that the unchanged txqs keep their buffered packets.
+	old->next_drain = drain_ctx;
+	__atomic_store_n(&old->next, ctx, __ATOMIC_RELEASE);
+	worker_wakeup(worker);
+	while (__atomic_load_n(&n->ctx_ptr, __ATOMIC_ACQUIRE) != ctx)
+		usleep(100);
+	// make sure the old queues are not used anymore when returning
+	gr_rcu_synchronize();
+	tx_ctx_free(old);
+	rte_free(old_drain);
+
+	return 0;
+}
+
 static struct rte_node_register node = {
 	.name = "port_tx",
 
@@ -106,6 +737,7 @@ static struct rte_node_register node = {
 	.nb_edges = NB_EDGES,
 	.next_nodes = {
 		[TX_ERROR] = "port_tx_error",
+		[BENCH_SINK] = "bench_sink",
 	},
 };
 
@@ -115,4 +747,27 @@ static struct gr_node_info info = {
 
 GR_NODE_REGISTER(info);
 
+// Transmit the packets enqueued by other workers in the rings of the shared
+// txqs that are owned by this worker.
+static struct rte_node_register drain_node = {
+	.name = "port_tx_drain",
+	.flags = RTE_NODE_SOURCE_F,
+
+	.process = tx_drain_process,
+	.init = tx_drain_init,
+	.fini = tx_drain_fini,
+
+	.nb_edges = NB_EDGES,
+	.next_nodes = {
+		[TX_ERROR] = "port_tx_error",
+		[BENCH_SINK] = "bench_sink",
+	},
+};
+
+static struct gr_node_info drain_info = {
+	.node = &drain_node,
+};
+
+GR_NODE_REGISTER(drain_info);
+
 GR_DROP_REGISTER(port_tx_error);
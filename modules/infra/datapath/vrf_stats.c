@@ -0,0 +1,272 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_control.h>
+#include <gr_log.h>
+#include <gr_vrf_stats.h>
+
+#include <rte_errno.h>
+#include <rte_ip4.h>
+#include <rte_ip6.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_spinlock.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct vrf_stats_worker vrf_stats_workers[RTE_MAX_LCORE];
+uint32_t vrf_stats_sample_rate;
+
+#define VRF_STATS_N_COUNTERS (VRF_STATS_AF_COUNT * VRF_STATS_MAX_VRFS)
+#define VRF_STATS_IP4_PREFIXLEN 24
+#define VRF_STATS_IP6_PREFIXLEN 48
+
+// Space-Saving table of the most frequent destination prefixes. Samples are
+// rare compared to the packet rate, the lock is only contended when the
+// control plane reads or clears the table.
+struct vrf_top {
+	rte_spinlock_t lock;
+	unsigned len;
+	struct vrf_stats_prefix entries[VRF_STATS_TOP_SIZE];
+} __rte_cache_aligned;
+
+static struct vrf_top vrf_tops[RTE_MAX_LCORE];
+static uint8_t vrf_prefixlens[VRF_STATS_AF_COUNT] = {
+	[VRF_STATS_IP4] = VRF_STATS_IP4_PREFIXLEN,
+	[VRF_STATS_IP6] = VRF_STATS_IP6_PREFIXLEN,
+};
+// values at the last reset, control plane only
+static struct vrf_counters vrf_base[VRF_STATS_N_COUNTERS];
+
+static void prefix_mask(uint8_t *addr, unsigned len, uint8_t prefixlen) {
+	for (unsigned i = 0; i < len; i++) {
+		if (prefixlen >= 8) {
+			prefixlen -= 8;
+		} else {
+			addr[i] &= (uint8_t)(0xff << (8 - prefixlen));
+			prefixlen = 0;
+		}
+	}
+}
+
+static void top_account(struct vrf_top *t, const struct vrf_stats_prefix *key, uint32_t weight) {
+	struct vrf_stats_prefix *e, *min = NULL;
+
+	for (unsigned i = 0; i < t->len; i++) {
+		e = &t->entries[i];
+		if (e->vrf_id == key->vrf_id && e->af == key->af && e->prefixlen == key->prefixlen
+		    && memcmp(e->addr, key->addr, sizeof(e->addr)) == 0) {
+			e->packets += weight;
+			return;
+		}
+		if (min == NULL || e->packets < min->packets)
+			min = e;
+	}
+
+	if (t->len < VRF_STATS_TOP_SIZE) {
+		e = &t->entries[t->len++];
+		*e = *key;
+		e->packets = weight;
+		e->error = 0;
+	} else {
+		// Evict the least frequent prefix. The new one inherits its count
+		// which is an upper bound of the number of packets it may have missed.
+		uint64_t evicted = min->packets;
+		*min = *key;
+		min->error = evicted;
+		min->packets = evicted + weight;
+	}
+}
+
+void vrf_stats_sample(
+	struct vrf_stats_worker *w,
+	vrf_stats_af_t af,
+	struct rte_mbuf **mbufs,
+	const uint16_t *vrfs,
+	uint16_t count,
+	uint32_t rate
+) {
+	struct vrf_top *t = &vrf_tops[rte_lcore_id()];
+	struct vrf_stats_prefix key;
+
+	for (uint16_t i = 0; i < count; i++) {
+		if (++w->sample_count < rate)
+			continue;
+		w->sample_count = 0;
+
+		memset(&key, 0, sizeof(key));
+		key.vrf_id = vrfs[i];
+		key.af = af;
+		key.prefixlen = __atomic_load_n(&vrf_prefixlens[af], __ATOMIC_RELAXED);
+		if (af == VRF_STATS_IP4) {
+			const struct rte_ipv4_hdr *ip;
+			ip = rte_pktmbuf_mtod(mbufs[i], const struct rte_ipv4_hdr *);
+			memcpy(key.addr, &ip->dst_addr, sizeof(ip->dst_addr));
+			prefix_mask(key.addr, sizeof(ip->dst_addr), key.prefixlen);
+		} else {
+			const struct rte_ipv6_hdr *ip;
+			ip = rte_pktmbuf_mtod(mbufs[i], const struct rte_ipv6_hdr *);
+			memcpy(key.addr, &ip->dst_addr, sizeof(ip->dst_addr));
+			prefix_mask(key.addr, sizeof(ip->dst_addr), key.prefixlen);
+		}
+
+		// Each sample stands for rate packets, the estimates remain
+		// valid when the sampling rate is changed.
+		rte_spinlock_lock(&t->lock);
+		top_account(t, &key, rate);
+		rte_spinlock_unlock(&t->lock);
+	}
+}
+
+static void vrf_sum(unsigned index, struct vrf_counters *sum) {
+	const struct vrf_counters *c;
+
+	memset(sum, 0, sizeof(*sum));
+
+	for (unsigned i = 0; i < RTE_MAX_LCORE; i++) {
+		if (vrf_stats_workers[i].counters == NULL)
+			continue;
+		c = &vrf_stats_workers[i].counters[index];
+		sum->packets += __atomic_load_n(&c->packets, __ATOMIC_RELAXED);
+		sum->bytes += __atomic_load_n(&c->bytes, __ATOMIC_RELAXED);
+	}
+}
+
+void vrf_stats_get(vrf_stats_af_t af, uint16_t vrf_id, struct vrf_counters *c) {
+	unsigned index = af * VRF_STATS_MAX_VRFS + vrf_id;
+
+	if (af >= VRF_STATS_AF_COUNT || vrf_id >= VRF_STATS_MAX_VRFS) {
+		memset(c, 0, sizeof(*c));
+		return;
+	}
+
+	vrf_sum(index, c);
+	c->packets -= vrf_base[index].packets;
+	c->bytes -= vrf_base[index].bytes;
+}
+
+static void top_clear(void) {
+	for (unsigned i = 0; i < RTE_MAX_LCORE; i++) {
+		rte_spinlock_lock(&vrf_tops[i].lock);
+		vrf_tops[i].len = 0;
+		rte_spinlock_unlock(&vrf_tops[i].lock);
+	}
+}
+
+void vrf_stats_reset(void) {
+	for (unsigned i = 0; i < VRF_STATS_N_COUNTERS; i++)
+		vrf_sum(i, &vrf_base[i]);
+	top_clear();
+}
+
+void vrf_stats_top_configure(uint32_t sample_rate, uint8_t ip4_prefixlen, uint8_t ip6_prefixlen) {
+	if (ip4_prefixlen != vrf_prefixlens[VRF_STATS_IP4]
+	    || ip6_prefixlen != vrf_prefixlens[VRF_STATS_IP6]) {
+		__atomic_store_n(&vrf_prefixlens[VRF_STATS_IP4], ip4_prefixlen, __ATOMIC_RELAXED);
+		__atomic_store_n(&vrf_prefixlens[VRF_STATS_IP6], ip6_prefixlen, __ATOMIC_RELAXED);
+		top_clear();
+	}
+	__atomic_store_n(&vrf_stats_sample_rate, sample_rate, __ATOMIC_RELAXED);
+}
+
+void vrf_stats_top_config(uint32_t *sample_rate, uint8_t *ip4_prefixlen, uint8_t *ip6_prefixlen) {
+	*sample_rate = __atomic_load_n(&vrf_stats_sample_rate, __ATOMIC_RELAXED);
+	*ip4_prefixlen = vrf_prefixlens[VRF_STATS_IP4];
+	*ip6_prefixlen = vrf_prefixlens[VRF_STATS_IP6];
+}
+
+static int prefix_order(const void *pa, const void *pb) {
+	const struct vrf_stats_prefix *a = pa;
+	const struct vrf_stats_prefix *b = pb;
+
+	if (a->packets > b->packets)
+		return -1;
+	if (a->packets < b->packets)
+		return 1;
+	return 0;
+}
+
+int vrf_stats_top_get(uint16_t vrf_id, struct vrf_stats_prefix *prefixes, unsigned max) {
+	const struct vrf_stats_prefix *e;
+	struct vrf_stats_prefix *merged;
+	unsigned len = 0, j;
+
+	merged = calloc(RTE_MAX_LCORE, sizeof(vrf_tops[0].entries));
+	if (merged == NULL)
+		return errno_set(ENOMEM);
+
+	// The same prefix may be reported by multiple workers.
+	for (unsigned i = 0; i < RTE_MAX_LCORE; i++) {
+		struct vrf_top *t = &vrf_tops[i];
+
+		rte_spinlock_lock(&t->lock);
+		for (unsigned k = 0; k < t->len; k++) {
+			e = &t->entries[k];
+			if (vrf_id != UINT16_MAX && e->vrf_id != vrf_id)
+				continue;
+			for (j = 0; j < len; j++) {
+				if (merged[j].vrf_id == e->vrf_id && merged[j].af == e->af
+				    && merged[j].prefixlen == e->prefixlen
+				    && memcmp(merged[j].addr, e->addr, sizeof(e->addr)) == 0)
+					break;
+			}
+			if (j < len) {
+				merged[j].packets += e->packets;
+				merged[j].error += e->error;
+			} else {
+				merged[len++] = *e;
+			}
+		}
+		rte_spinlock_unlock(&t->lock);
+	}
+
+	qsort(merged, len, sizeof(*merged), prefix_order);
+	len = RTE_MIN(len, max);
+	memcpy(prefixes, merged, len * sizeof(*merged));
+	free(merged);
+
+	return len;
+}
+
+static void vrf_stats_init_dp(void) {
+	unsigned lcore_id = rte_lcore_id();
+	struct vrf_stats_worker *w = &vrf_stats_workers[lcore_id];
+
+	if (w->counters != NULL)
+		return;
+
+	w->counters = rte_zmalloc_socket(
+		__func__,
+		VRF_STATS_N_COUNTERS * sizeof(*w->counters),
+		RTE_CACHE_LINE_SIZE,
+		rte_socket_id()
+	);
+	if (w->counters == NULL)
+		ABORT("rte_zmalloc(vrf counters): %s", rte_strerror(rte_errno));
+}
+
+static void vrf_stats_init(struct event_base *) {
+	for (unsigned i = 0; i < RTE_MAX_LCORE; i++)
+		rte_spinlock_init(&vrf_tops[i].lock);
+}
+
+static void vrf_stats_fini(struct event_base *) {
+	for (unsigned i = 0; i < RTE_MAX_LCORE; i++) {
+		rte_free(vrf_stats_workers[i].counters);
+		vrf_stats_workers[i].counters = NULL;
+	}
+}
+
+static struct gr_module vrf_stats_module = {
+	.name = "vrf stats",
+	.init = vrf_stats_init,
+	.fini = vrf_stats_fini,
+	.init_dp = vrf_stats_init_dp,
+};
+
+RTE_INIT(vrf_stats_constructor) {
+	gr_register_module(&vrf_stats_module);
+}
@@ -25,6 +25,9 @@ struct gr_ip4_ifaddr {
 #define GR_IP4_NH_F_LOCAL GR_BIT16(5) // Local address
 #define GR_IP4_NH_F_GATEWAY GR_BIT16(6) // Gateway route
 #define GR_IP4_NH_F_LINK GR_BIT16(7) // Connected link route
+#define GR_IP4_NH_F_GROUP GR_BIT16(8) // ECMP next hop group
+#define GR_IP4_NH_F_DOWN GR_BIT16(9) // Output interface link is down
+#define GR_IP4_NH_F_LEAKED GR_BIT16(10) // Referenced by routes of other VRFs
 typedef uint16_t gr_ip4_nh_flags_t;
 
 static inline const char *gr_ip4_nh_f_name(const gr_ip4_nh_flags_t flag) {
@@ -45,6 +48,12 @@ static inline const char *gr_ip4_nh_f_name(const gr_ip4_nh_flags_t flag) {
 		return "gateway";
 	case GR_IP4_NH_F_LINK:
 		return "link";
+	case GR_IP4_NH_F_GROUP:
+		return "group";
+	case GR_IP4_NH_F_DOWN:
+		return "down";
+	case GR_IP4_NH_F_LEAKED:
+		return "leaked";
 	}
 	return "";
 }
@@ -59,11 +68,15 @@ struct gr_ip4_nh {
 	gr_ip4_nh_flags_t flags;
 	uint16_t age; //<! number of seconds since last update
 	uint16_t held_pkts;
+	uint32_t held_total; //<! number of packets held since creation
+	uint32_t flushed_total; //<! held packets sent after resolution
+	uint32_t expired_total; //<! held packets dropped after the hold timeout
 };
 
 struct gr_ip4_route {
 	struct ip4_net dest;
 	ip4_addr_t nh;
+	uint16_t nh_vrf_id; // only filled in route list responses
 };
 
 #define GR_IP4_MODULE 0xf00d
@@ -91,15 +104,85 @@ struct gr_ip4_nh_del_req {
 
 #define GR_IP4_NH_LIST REQUEST_TYPE(GR_IP4_MODULE, 0x0003)
 
+// Start with a zero cursor and send as many requests as needed with the
+// next_cursor of the previous response, until next_cursor is zero.
 struct gr_ip4_nh_list_req {
 	uint16_t vrf_id;
+	uint32_t cursor;
 };
 
 struct gr_ip4_nh_list_resp {
+	uint32_t next_cursor; // zero when all next hops have been listed
 	uint16_t n_nhs;
 	struct gr_ip4_nh nhs[/* n_nhs */];
 };
 
+#define GR_IP4_NH_ADD_BULK REQUEST_TYPE(GR_IP4_MODULE, 0x0007)
+
+struct gr_ip4_nh_add_bulk_req {
+	uint8_t exist_ok;
+	uint16_t n_nhs;
+	struct gr_ip4_nh nhs[/* n_nhs */];
+};
+
+// struct gr_ip4_nh_add_bulk_resp = struct gr_api_bulk_resp
+
+#define GR_IP4_NH_DEL_BULK REQUEST_TYPE(GR_IP4_MODULE, 0x0008)
+
+struct gr_ip4_nh_del_bulk_req {
+	uint16_t vrf_id;
+	uint8_t missing_ok;
+	uint16_t n_hosts;
+	ip4_addr_t hosts[/* n_hosts */];
+};
+
+// struct gr_ip4_nh_del_bulk_resp = struct gr_api_bulk_resp
+
+// next hop groups /////////////////////////////////////////////////////////////
+
+// Max number of members in a next hop group.
+#define GR_IP4_NH_GROUP_MAX_NHS 64
+
+struct gr_ip4_nh_group {
+	uint32_t id;
+	uint16_t vrf_id;
+	uint8_t n_nhs;
+	uint32_t n_routes; //<! number of routes referencing this group
+	ip4_addr_t nhs[GR_IP4_NH_GROUP_MAX_NHS];
+};
+
+#define GR_IP4_NH_GROUP_ADD REQUEST_TYPE(GR_IP4_MODULE, 0x0004)
+
+struct gr_ip4_nh_group_add_req {
+	uint32_t id;
+	uint16_t vrf_id;
+	uint8_t exist_ok; // replace the members of an existing group
+	uint8_t n_nhs;
+	ip4_addr_t nhs[/* n_nhs */];
+};
+
+// struct gr_ip4_nh_group_add_resp { };
+
+#define GR_IP4_NH_GROUP_DEL REQUEST_TYPE(GR_IP4_MODULE, 0x0005)
+
+struct gr_ip4_nh_group_del_req {
+	uint32_t id;
+	uint8_t missing_ok;
+};
+
+// struct gr_ip4_nh_group_del_resp { };
+
+#define GR_IP4_NH_GROUP_LIST REQUEST_TYPE(GR_IP4_MODULE, 0x0006)
+
+struct gr_ip4_nh_group_list_req {
+	uint16_t vrf_id;
+};
+
+struct gr_ip4_nh_group_list_resp {
+	uint16_t n_groups;
+	struct gr_ip4_nh_group groups[/* n_groups */];
+};
+
 // routes //////////////////////////////////////////////////////////////////////
 
 #define GR_IP4_ROUTE_ADD REQUEST_TYPE(GR_IP4_MODULE, 0x0010)
@@ -108,7 +191,13 @@ struct gr_ip4_route_add_req {
 	uint16_t vrf_id;
 	struct ip4_net dest;
 	ip4_addr_t nh;
+	uint32_t nh_group_id; // use this next hop group instead of nh when non-zero
 	uint8_t exist_ok;
+	// Leak the route from another VRF: nh (or nh_group_id) is resolved in
+	// nh_vrf_id and the route references that next hop directly. Packets
+	// received in vrf_id are forwarded with a single FIB lookup.
+	uint8_t leak;
+	uint16_t nh_vrf_id;
 };
 
 // struct gr_ip4_route_add_resp { };
@@ -136,15 +225,94 @@ struct gr_ip4_route_get_resp {
 
 #define GR_IP4_ROUTE_LIST REQUEST_TYPE(GR_IP4_MODULE, 0x0013)
 
+// Large tables are listed in multiple pages. Start with a zero cursor and
+// send as many requests as needed with the next_cursor and last fields of the
+// previous response, until next_cursor is zero.
 struct gr_ip4_route_list_req {
 	uint16_t vrf_id;
+	uint32_t cursor;
+	struct ip4_net last;
 };
 
 struct gr_ip4_route_list_resp {
+	uint32_t next_cursor; // zero when all routes have been listed
+	struct ip4_net last; // last destination in this page
+	uint16_t n_routes;
+	struct gr_ip4_route routes[/* n_routes */];
+};
+
+// Max number of next hops of a multipath route.
+#define GR_IP4_ROUTE_MAX_NHS GR_IP4_NH_GROUP_MAX_NHS
+
+#define GR_IP4_ROUTE_ADD_MULTIPATH REQUEST_TYPE(GR_IP4_MODULE, 0x0014)
+
+struct gr_ip4_route_add_multipath_req {
+	uint16_t vrf_id;
+	struct ip4_net dest;
+	uint8_t exist_ok; // replace the next hops of an existing multipath route
+	uint8_t leak; // see gr_ip4_route_add_req
+	uint16_t nh_vrf_id;
+	uint8_t n_nhs;
+	ip4_addr_t nhs[/* n_nhs */];
+};
+
+// struct gr_ip4_route_add_multipath_resp { };
+
+#define GR_IP4_ROUTE_ADD_BULK REQUEST_TYPE(GR_IP4_MODULE, 0x0015)
+
+struct gr_ip4_route_add_bulk_req {
+	uint16_t vrf_id;
+	uint8_t exist_ok;
 	uint16_t n_routes;
 	struct gr_ip4_route routes[/* n_routes */];
 };
 
+// struct gr_ip4_route_add_bulk_resp = struct gr_api_bulk_resp
+
+#define GR_IP4_ROUTE_DEL_BULK REQUEST_TYPE(GR_IP4_MODULE, 0x0016)
+
+struct gr_ip4_route_del_bulk_req {
+	uint16_t vrf_id;
+	uint8_t missing_ok;
+	uint16_t n_dests;
+	struct ip4_net dests[/* n_dests */];
+};
+
+// struct gr_ip4_route_del_bulk_resp = struct gr_api_bulk_resp
+
+#define GR_IP4_ROUTE_LOOKUP_BULK REQUEST_TYPE(GR_IP4_MODULE, 0x0017)
+
+// Resolve many destinations with a single request, for example to check that
+// the FIB matches the RIB of a routing daemon. Addresses are resolved with a
+// longest prefix match in the FIB, like forwarded packets. When exact is set,
+// the destination prefixes are looked up exactly in the RIB instead.
+struct gr_ip4_route_lookup {
+	uint16_t vrf_id;
+	struct ip4_net dest; // prefixlen is ignored unless exact is set
+};
+
+struct gr_ip4_route_lookup_bulk_req {
+	uint8_t exact;
+	uint16_t n_lookups;
+	struct gr_ip4_route_lookup lookups[/* n_lookups */];
+};
+
+// ECMP routes report their first member with GR_IP4_NH_F_GROUP added to flags.
+struct gr_ip4_route_lookup_result {
+	uint32_t status; // zero, ENETUNREACH when no route matched or ENOENT (exact)
+	ip4_addr_t nh;
+	uint16_t nh_vrf_id;
+	uint16_t iface_id;
+	gr_ip4_nh_flags_t flags;
+};
+
+// The response must fit in GR_API_MAX_MSG_LEN, requests with too many lookups
+// fail with ERANGE.
+struct gr_ip4_route_lookup_bulk_resp {
+	uint16_t n_results;
+	struct gr_ip4_route_lookup_result results[/* n_results */];
+};
+
 // addresses ///////////////////////////////////////////////////////////////////
 
 #define GR_IP4_ADDR_ADD REQUEST_TYPE(GR_IP4_MODULE, 0x0021)
@@ -167,13 +335,139 @@ struct gr_ip4_addr_del_req {
 
 #define GR_IP4_ADDR_LIST REQUEST_TYPE(GR_IP4_MODULE, 0x0023)
 
+// Start with a zero cursor and send as many requests as needed with the
+// next_cursor of the previous response, until next_cursor is zero. The cursor
+// is opaque, it points at an address of an interface so that pages may end in
+// the middle of an interface.
 struct gr_ip4_addr_list_req {
 	uint16_t vrf_id;
+	uint32_t cursor;
 };
 
 struct gr_ip4_addr_list_resp {
+	uint32_t next_cursor; // zero when all addresses have been listed
 	uint16_t n_addrs;
 	struct gr_ip4_ifaddr addrs[/* n_addrs */];
 };
 
+// FIB configuration ///////////////////////////////////////////////////////////
+
+#define GR_IP4_FIB_AUTO 0 // reduced while small, DIR24_8 above a threshold
+#define GR_IP4_FIB_DIR24_8 1 // fastest lookups, fixed 2^24 entries table
+#define GR_IP4_FIB_REDUCED 2 // DIR24_8 with few tbl8 groups, same 64MB tbl24
+
+struct gr_ip4_fib_conf {
+	uint16_t vrf_id;
+	uint8_t type; // GR_IP4_FIB_*
+	uint8_t active_type; //<! type of the current table (output only)
+	uint32_t max_routes; // 0 for default
+	uint32_t num_tbl8; // number of /24 extension tables, 0 for default
+	uint8_t nh_size; // next hop size in bytes, 0 for default
+	uint32_t n_routes; //<! number of configured routes (output only)
+	uint64_t mem_size; //<! estimated memory usage in bytes (output only)
+};
+
+#define GR_IP4_FIB_SET REQUEST_TYPE(GR_IP4_MODULE, 0x0030)
+
+struct gr_ip4_fib_set_req {
+	struct gr_ip4_fib_conf conf;
+};
+
+struct gr_ip4_fib_set_resp {
+	struct gr_ip4_fib_conf conf;
+};
+
+#define GR_IP4_FIB_LIST REQUEST_TYPE(GR_IP4_MODULE, 0x0031)
+
+// struct gr_ip4_fib_list_req { };
+
+struct gr_ip4_fib_list_resp {
+	uint16_t n_fibs;
+	struct gr_ip4_fib_conf fibs[/* n_fibs */];
+};
+
+// ICMP errors rate limiting ///////////////////////////////////////////////////
+
+struct gr_ip4_icmp_limit {
+	uint8_t icmp_type; // GR_IP_ICMP_DEST_UNREACHABLE (3) or GR_IP_ICMP_TTL_EXCEEDED (11)
+	uint32_t rate; // max number of errors per second and per worker, 0 for unlimited
+	uint32_t burst; // max number of errors sent at once, 0 for default
+};
+
+#define GR_IP4_ICMP_LIMIT_SET REQUEST_TYPE(GR_IP4_MODULE, 0x0040)
+
+struct gr_ip4_icmp_limit_set_req {
+	struct gr_ip4_icmp_limit limit;
+};
+
+// struct gr_ip4_icmp_limit_set_resp { };
+
+#define GR_IP4_ICMP_LIMIT_LIST REQUEST_TYPE(GR_IP4_MODULE, 0x0041)
+
+// struct gr_ip4_icmp_limit_list_req { };
+
+struct gr_ip4_icmp_limit_list_resp {
+	uint16_t n_limits;
+	struct gr_ip4_icmp_limit limits[/* n_limits */];
+};
+
+// hardware flow offload ///////////////////////////////////////////////////////
+
+// Destinations forwarded through the flow cache (--flow-cache) at more than
+// threshold packets per second on one worker are forwarded entirely by the NIC
+// with rte_flow transfer rules: rewrite the ethernet addresses, decrement the
+// TTL and send to the egress port. Only possible between ports of the same
+// switch domain, without ACL, NAT or RPF checks. Rules are removed when their
+// hardware counters show no traffic for idle_timeout seconds, as soon as the
+// route of the destination changes and within a second when its next hop
+// changes.
+struct gr_ip4_offload_conf {
+	uint32_t threshold; // packets per second, 0 to disable and remove all rules
+	uint16_t max_flows; // 0 for the default
+	uint16_t idle_timeout; // seconds, 0 for the default
+};
+
+struct gr_ip4_offload_stats {
+	uint32_t n_flows; // currently offloaded destinations
+	uint64_t installed;
+	uint64_t failed; // rejected by the driver or not eligible
+	uint64_t expired;
+	uint64_t invalidated; // route or next hop changed
+	uint64_t packets; // forwarded by hardware, as reported by the rule counters
+	uint64_t bytes;
+};
+
+#define GR_IP4_OFFLOAD_SET REQUEST_TYPE(GR_IP4_MODULE, 0x0050)
+
+struct gr_ip4_offload_set_req {
+	struct gr_ip4_offload_conf conf;
+};
+
+// struct gr_ip4_offload_set_resp { };
+
+#define GR_IP4_OFFLOAD_GET REQUEST_TYPE(GR_IP4_MODULE, 0x0051)
+
+// struct gr_ip4_offload_get_req { };
+
+struct gr_ip4_offload_get_resp {
+	struct gr_ip4_offload_conf conf;
+	struct gr_ip4_offload_stats stats;
+};
+
+// events //////////////////////////////////////////////////////////////////////
+
+// The event object is a struct gr_ip4_nh. Next hop state changes made by the
+// datapath workers are reported by the next aging check.
+#define GR_IP4_EVENT_NH_UPDATE EVENT_TYPE(GR_IP4_MODULE, 0x0001) // coalesced
+#define GR_IP4_EVENT_NH_DEL EVENT_TYPE(GR_IP4_MODULE, 0x0002)
+
+// ECMP routes are reported with one event per group member.
+#define GR_IP4_EVENT_ROUTE_ADD EVENT_TYPE(GR_IP4_MODULE, 0x0010)
+#define GR_IP4_EVENT_ROUTE_DEL EVENT_TYPE(GR_IP4_MODULE, 0x0011)
+
+struct gr_ip4_route_event {
+	uint16_t vrf_id;
+	struct gr_ip4_route route;
+};
+
 #endif
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "ip.h"
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_ip4.h>
+#include <gr_table.h>
+
+#include <ecoli.h>
+#include <libsmartcols.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *fib_type_name(uint8_t type) {
+	switch (type) {
+	case GR_IP4_FIB_AUTO:
+		return "auto";
+	case GR_IP4_FIB_DIR24_8:
+		return "dir24_8";
+	case GR_IP4_FIB_REDUCED:
+		return "reduced";
+	}
+	return "?";
+}
+
+static cmd_status_t fib4_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	const struct gr_ip4_fib_set_resp *resp;
+	struct gr_ip4_fib_set_req req = {0};
+	void *resp_ptr = NULL;
+	const char *type;
+	const char *nh_size;
+
+	if (arg_u16(p, "VRF", &req.conf.vrf_id) < 0)
+		return CMD_ERROR;
+	type = arg_str(p, "TYPE");
+	if (type == NULL || strcmp(type, "auto") == 0)
+		req.conf.type = GR_IP4_FIB_AUTO;
+	else if (strcmp(type, "dir24_8") == 0)
+		req.conf.type = GR_IP4_FIB_DIR24_8;
+	else
+		req.conf.type = GR_IP4_FIB_REDUCED;
+	if (arg_u32(p, "MAX", &req.conf.max_routes) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u32(p, "TBL8", &req.conf.num_tbl8) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if ((nh_size = arg_str(p, "SIZE")) != NULL)
+		req.conf.nh_size = atoi(nh_size);
+
+	if (gr_api_client_send_recv(c, GR_IP4_FIB_SET, sizeof(req), &req, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	printf("vrf %u: %s, max routes %u, tbl8 %u, estimated memory %" PRIu64 " MiB\n",
+	       resp->conf.vrf_id,
+	       fib_type_name(resp->conf.active_type),
+	       resp->conf.max_routes,
+	       resp->conf.num_tbl8,
+	       resp->conf.mem_size >> 20);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t fib4_list(const struct gr_api_client *c, const struct ec_pnode *) {
+	struct libscols_table *table = scols_new_table();
+	const struct gr_ip4_fib_list_resp *resp;
+	void *resp_ptr = NULL;
+
+	if (table == NULL)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_IP4_FIB_LIST, 0, NULL, &resp_ptr) < 0) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+
+	resp = resp_ptr;
+	scols_table_new_column(table, "VRF", 0, 0);
+	scols_table_new_column(table, "TYPE", 0, 0);
+	scols_table_new_column(table, "ROUTES", 0, 0);
+	scols_table_new_column(table, "MAX_ROUTES", 0, 0);
+	scols_table_new_column(table, "TBL8", 0, 0);
+	scols_table_new_column(table, "NH_SIZE", 0, 0);
+	scols_table_new_column(table, "MEMORY", 0, 0);
+	scols_table_set_column_separator(table, "  ");
+
+	for (size_t i = 0; i < resp->n_fibs; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_ip4_fib_conf *fib = &resp->fibs[i];
+		scols_line_sprintf(line, 0, "%u", fib->vrf_id);
+		if (fib->type == fib->active_type)
+			scols_line_sprintf(line, 1, "%s", fib_type_name(fib->type));
+		else
+			scols_line_sprintf(
+				line,
+				1,
+				"%s (%s)",
+				fib_type_name(fib->type),
+				fib_type_name(fib->active_type)
+			);
+		scols_line_sprintf(line, 2, "%u", fib->n_routes);
+		scols_line_sprintf(line, 3, "%u", fib->max_routes);
+		scols_line_sprintf(line, 4, "%u", fib->num_tbl8);
+		scols_line_sprintf(line, 5, "%u", fib->nh_size);
+		scols_line_sprintf(line, 6, "%" PRIu64 "M", fib->mem_size >> 20);
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		IP_SET_CTX(root),
+		"fib vrf VRF [(type TYPE),(max-routes MAX),(tbl8 TBL8),(nh-size SIZE)]",
+		fib4_set,
+		"Configure the size of a VRF routing table. Existing routes are preserved.",
+		with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10)),
+		with_help(
+			"Table type, auto uses fewer tbl8 groups for small tables.",
+			ec_node_re("TYPE", "auto|dir24_8|reduced")
+		),
+		with_help("Maximum number of routes.", ec_node_uint("MAX", 1, UINT32_MAX, 10)),
+		with_help(
+			"Number of /24 extension tables for longer prefixes.",
+			ec_node_uint("TBL8", 1, UINT32_MAX, 10)
+		),
+		with_help("Next hop size in bytes.", ec_node_re("SIZE", "4|8"))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		IP_SHOW_CTX(root), "fib", fib4_list, "Show IPv4 routing tables configuration."
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "ipv4 fib",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+}
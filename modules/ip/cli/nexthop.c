@@ -15,6 +15,8 @@
 
 #include <errno.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 static cmd_status_t nh4_add(const struct gr_api_client *c, const struct ec_pnode *p) {
 	struct gr_ip4_nh_add_req req = {0};
@@ -67,61 +69,179 @@ static cmd_status_t nh4_list(const struct gr_api_client *c, const struct ec_pnod
 		scols_unref_table(table);
 		return CMD_ERROR;
 	}
-	if (gr_api_client_send_recv(c, GR_IP4_NH_LIST, sizeof(req), &req, &resp_ptr) < 0) {
-		scols_unref_table(table);
-		return CMD_ERROR;
-	}
-
-	resp = resp_ptr;
 
 	scols_table_new_column(table, "VRF", 0, 0);
 	scols_table_new_column(table, "IP", 0, 0);
 	scols_table_new_column(table, "MAC", 0, 0);
 	scols_table_new_column(table, "IFACE", 0, 0);
 	scols_table_new_column(table, "QUEUE", 0, 0);
+	scols_table_new_column(table, "HELD", 0, 0);
+	scols_table_new_column(table, "FLUSHED", 0, 0);
+	scols_table_new_column(table, "EXPIRED", 0, 0);
 	scols_table_new_column(table, "AGE", 0, 0);
 	scols_table_new_column(table, "STATE", 0, 0);
 	scols_table_set_column_separator(table, "  ");
 
-	for (size_t i = 0; i < resp->n_nhs; i++) {
+	do {
+		if (gr_api_client_send_recv(c, GR_IP4_NH_LIST, sizeof(req), &req, &resp_ptr) < 0) {
+			scols_unref_table(table);
+			return CMD_ERROR;
+		}
+
+		resp = resp_ptr;
+		for (size_t i = 0; i < resp->n_nhs; i++) {
+			struct libscols_line *line = scols_table_new_line(table, NULL);
+			const struct gr_ip4_nh *nh = &resp->nhs[i];
+
+			n = 0;
+			state[0] = '\0';
+			for (uint8_t i = 0; i < 16; i++) {
+				gr_ip4_nh_flags_t f = 1 << i;
+				if (f & nh->flags) {
+					n += snprintf(
+						state + n,
+						sizeof(state) - n,
+						"%s ",
+						gr_ip4_nh_f_name(f)
+					);
+				}
+			}
+			if (n > 0)
+				state[n - 1] = '\0';
+
+			inet_ntop(AF_INET, &nh->host, ip, sizeof(ip));
+
+			scols_line_sprintf(line, 0, "%u", nh->vrf_id);
+			scols_line_sprintf(line, 1, "%s", ip);
+			if (nh->flags & GR_IP4_NH_F_REACHABLE) {
+				scols_line_sprintf(line, 2, ETH_ADDR_FMT, ETH_ADDR_SPLIT(&nh->mac));
+				if (iface_from_id(c, nh->iface_id, &iface) == 0)
+					scols_line_sprintf(line, 3, "%s", iface.name);
+				else
+					scols_line_sprintf(line, 3, "%u", nh->iface_id);
+				scols_line_sprintf(line, 4, "%u", nh->held_pkts);
+				scols_line_sprintf(line, 8, "%u", nh->age);
+			} else {
+				scols_line_set_data(line, 2, "??:??:??:??:??:??");
+				scols_line_set_data(line, 3, "?");
+				scols_line_sprintf(line, 4, "%u", nh->held_pkts);
+				scols_line_set_data(line, 8, "?");
+			}
+			scols_line_sprintf(line, 5, "%u", nh->held_total);
+			scols_line_sprintf(line, 6, "%u", nh->flushed_total);
+			scols_line_sprintf(line, 7, "%u", nh->expired_total);
+			scols_line_sprintf(line, 9, "%s", state);
+		}
+
+		req.cursor = resp->next_cursor;
+		free(resp_ptr);
+		gr_table_flush(table);
+	} while (req.cursor != 0);
+
+	gr_table_print(table);
+	scols_unref_table(table);
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t nh4_group_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_ip4_nh_group_add_req *req;
+	cmd_status_t ret = CMD_ERROR;
+	const struct ec_pnode *n;
+	unsigned n_nhs = 0;
+	size_t len;
+
+	for (n = ec_pnode_find(p, "NH"); n != NULL; n = ec_pnode_find_next(p, n, "NH", false))
+		n_nhs++;
+	if (n_nhs > GR_IP4_NH_GROUP_MAX_NHS) {
+		errno = ERANGE;
+		return CMD_ERROR;
+	}
+	len = sizeof(*req) + n_nhs * sizeof(req->nhs[0]);
+	if ((req = calloc(1, len)) == NULL)
+		return CMD_ERROR;
+
+	req->exist_ok = true;
+	if (arg_u32(p, "ID", &req->id) < 0)
+		goto out;
+	for (n = ec_pnode_find(p, "NH"); n != NULL; n = ec_pnode_find_next(p, n, "NH", false)) {
+		const struct ec_strvec *v = ec_pnode_get_strvec(n);
+		if (inet_pton(AF_INET, ec_strvec_val(v, 0), &req->nhs[req->n_nhs++]) != 1) {
+			errno = EINVAL;
+			goto out;
+		}
+	}
+	if (arg_u16(p, "VRF", &req->vrf_id) < 0 && errno != ENOENT)
+		goto out;
+
+	if (gr_api_client_send_recv(c, GR_IP4_NH_GROUP_ADD, len, req, NULL) < 0)
+		goto out;
+
+	ret = CMD_SUCCESS;
+out:
+	free(req);
+	return ret;
+}
+
+static cmd_status_t nh4_group_del(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_ip4_nh_group_del_req req = {.missing_ok = true};
+
+	if (arg_u32(p, "ID", &req.id) < 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_IP4_NH_GROUP_DEL, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t nh4_group_list(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_ip4_nh_group_list_req req = {.vrf_id = UINT16_MAX};
+	struct libscols_table *table = scols_new_table();
+	const struct gr_ip4_nh_group_list_resp *resp;
+	char ip[INET_ADDRSTRLEN], nhs[BUFSIZ];
+	void *resp_ptr = NULL;
+	ssize_t n;
+
+	if (table == NULL)
+		return CMD_ERROR;
+	if (arg_u16(p, "VRF", &req.vrf_id) < 0 && errno != ENOENT) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+	if (gr_api_client_send_recv(c, GR_IP4_NH_GROUP_LIST, sizeof(req), &req, &resp_ptr) < 0) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+
+	resp = resp_ptr;
+
+	scols_table_new_column(table, "VRF", 0, 0);
+	scols_table_new_column(table, "ID", 0, 0);
+	scols_table_new_column(table, "ROUTES", 0, 0);
+	scols_table_new_column(table, "NEXT_HOPS", 0, 0);
+	scols_table_set_column_separator(table, "  ");
+
+	for (size_t i = 0; i < resp->n_groups; i++) {
 		struct libscols_line *line = scols_table_new_line(table, NULL);
-		const struct gr_ip4_nh *nh = &resp->nhs[i];
+		const struct gr_ip4_nh_group *g = &resp->groups[i];
 
 		n = 0;
-		state[0] = '\0';
-		for (uint8_t i = 0; i < 16; i++) {
-			gr_ip4_nh_flags_t f = 1 << i;
-			if (f & nh->flags) {
-				n += snprintf(
-					state + n, sizeof(state) - n, "%s ", gr_ip4_nh_f_name(f)
-				);
-			}
+		nhs[0] = '\0';
+		for (uint8_t j = 0; j < g->n_nhs; j++) {
+			inet_ntop(AF_INET, &g->nhs[j], ip, sizeof(ip));
+			n += snprintf(nhs + n, sizeof(nhs) - n, "%s ", ip);
 		}
 		if (n > 0)
-			state[n - 1] = '\0';
-
-		inet_ntop(AF_INET, &nh->host, ip, sizeof(ip));
-
-		scols_line_sprintf(line, 0, "%u", nh->vrf_id);
-		scols_line_sprintf(line, 1, "%s", ip);
-		if (nh->flags & GR_IP4_NH_F_REACHABLE) {
-			scols_line_sprintf(line, 2, ETH_ADDR_FMT, ETH_ADDR_SPLIT(&nh->mac));
-			if (iface_from_id(c, nh->iface_id, &iface) == 0)
-				scols_line_sprintf(line, 3, "%s", iface.name);
-			else
-				scols_line_sprintf(line, 3, "%u", nh->iface_id);
-			scols_line_sprintf(line, 4, "%u", nh->held_pkts);
-			scols_line_sprintf(line, 5, "%u", nh->age);
-		} else {
-			scols_line_set_data(line, 2, "??:??:??:??:??:??");
-			scols_line_set_data(line, 3, "?");
-			scols_line_sprintf(line, 4, "%u", nh->held_pkts);
-			scols_line_set_data(line, 5, "?");
-		}
-		scols_line_sprintf(line, 6, "%s", state);
+			nhs[n - 1] = '\0';
+
+		scols_line_sprintf(line, 0, "%u", g->vrf_id);
+		scols_line_sprintf(line, 1, "%u", g->id);
+		scols_line_sprintf(line, 2, "%u", g->n_routes);
+		scols_line_sprintf(line, 3, "%s", nhs);
 	}
 
-	scols_print_table(table);
+	gr_table_print(table);
 	scols_unref_table(table);
 	free(resp_ptr);
 
@@ -150,6 +270,35 @@ static int ctx_init(struct ec_node *root) {
 		with_help("IPv4 address.", ec_node_re("IP", IPV4_RE)),
 		with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10))
 	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		IP_ADD_CTX(root),
+		"nexthop group ID via NH+ [vrf VRF]",
+		nh4_group_add,
+		"Add (or replace the members of) a next hop group.",
+		with_help("Next hop group ID.", ec_node_uint("ID", 1, UINT16_MAX - 1, 10)),
+		with_help("IPv4 next hop address.", ec_node_re("NH", IPV4_RE)),
+		with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		IP_DEL_CTX(root),
+		"nexthop group ID",
+		nh4_group_del,
+		"Delete a next hop group.",
+		with_help("Next hop group ID.", ec_node_uint("ID", 1, UINT16_MAX - 1, 10))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		IP_SHOW_CTX(root),
+		"nexthop group [vrf VRF]",
+		nh4_group_list,
+		"List next hop groups.",
+		with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10))
+	);
 	if (ret < 0)
 		return ret;
 	ret = CLI_COMMAND(
@@ -165,6 +314,36 @@ static int ctx_init(struct ec_node *root) {
 	return 0;
 }
 
+static void nh4_event_print(const struct gr_api_client *c, const void *obj) {
+	const struct gr_ip4_nh *nh = obj;
+	struct gr_iface iface;
+
+	printf("vrf=%u " IP4_ADDR_FMT " mac=" ETH_ADDR_FMT,
+	       nh->vrf_id,
+	       IP4_ADDR_SPLIT(&nh->host),
+	       ETH_ADDR_SPLIT(&nh->mac));
+	if (iface_from_id(c, nh->iface_id, &iface) == 0)
+		printf(" iface=%s", iface.name);
+	else
+		printf(" iface=%u", nh->iface_id);
+	for (uint8_t i = 0; i < 16; i++) {
+		gr_ip4_nh_flags_t f = 1 << i;
+		if (f & nh->flags)
+			printf(" %s", gr_ip4_nh_f_name(f));
+	}
+}
+
+static struct cli_event_type nh4_update_event = {
+	.ev_type = GR_IP4_EVENT_NH_UPDATE,
+	.name = "ip nexthop update",
+	.print = nh4_event_print,
+};
+static struct cli_event_type nh4_del_event = {
+	.ev_type = GR_IP4_EVENT_NH_DEL,
+	.name = "ip nexthop del",
+	.print = nh4_event_print,
+};
+
 static struct gr_cli_context ctx = {
 	.name = "ipv4 nexthop",
 	.init = ctx_init,
@@ -172,4 +351,6 @@ static struct gr_cli_context ctx = {
 
 static void __attribute__((constructor, used)) init(void) {
 	register_context(&ctx);
+	register_event_type(&nh4_update_event);
+	register_event_type(&nh4_del_event);
 }
@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "ip.h"
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_ip4.h>
+
+#include <ecoli.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static cmd_status_t offload_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_ip4_offload_set_req req = {0};
+
+	if (arg_u32(p, "THRESHOLD", &req.conf.threshold) < 0)
+		return CMD_ERROR;
+	if (arg_u16(p, "MAX", &req.conf.max_flows) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u16(p, "IDLE", &req.conf.idle_timeout) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_IP4_OFFLOAD_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t offload_show(const struct gr_api_client *c, const struct ec_pnode *) {
+	const struct gr_ip4_offload_get_resp *resp;
+	void *resp_ptr = NULL;
+
+	if (gr_api_client_send_recv(c, GR_IP4_OFFLOAD_GET, 0, NULL, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	if (resp->conf.threshold == 0)
+		printf("threshold: disabled\n");
+	else
+		printf("threshold: %u pps\n", resp->conf.threshold);
+	printf("max_flows: %u\n", resp->conf.max_flows);
+	printf("idle_timeout: %us\n", resp->conf.idle_timeout);
+	printf("flows: %u\n", resp->stats.n_flows);
+	printf("installed: %" PRIu64 "\n", resp->stats.installed);
+	printf("failed: %" PRIu64 "\n", resp->stats.failed);
+	printf("expired: %" PRIu64 "\n", resp->stats.expired);
+	printf("invalidated: %" PRIu64 "\n", resp->stats.invalidated);
+	printf("packets: %" PRIu64 "\n", resp->stats.packets);
+	printf("bytes: %" PRIu64 "\n", resp->stats.bytes);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		IP_SET_CTX(root),
+		"offload THRESHOLD [max MAX] [idle IDLE]",
+		offload_set,
+		"Offload the destinations forwarded above a packet rate to hardware.",
+		with_help(
+			"Packets per second on one worker, 0 to disable.",
+			ec_node_uint("THRESHOLD", 0, UINT32_MAX, 10)
+		),
+		with_help("Max offloaded destinations.", ec_node_uint("MAX", 1, UINT16_MAX, 10)),
+		with_help(
+			"Seconds without traffic before removing a rule.",
+			ec_node_uint("IDLE", 1, UINT16_MAX, 10)
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		IP_SHOW_CTX(root),
+		"offload",
+		offload_show,
+		"Show the hardware flow offload configuration and statistics."
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "ipv4 offload",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+}
@@ -14,9 +14,63 @@
 #include <libsmartcols.h>
 
 #include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static cmd_status_t route4_add_multipath(
+	const struct gr_api_client *c,
+	const struct ec_pnode *p,
+	unsigned n_nhs
+) {
+	struct gr_ip4_route_add_multipath_req *req;
+	const struct ec_pnode *n;
+	cmd_status_t ret = CMD_ERROR;
+	size_t len;
+
+	if (n_nhs > GR_IP4_ROUTE_MAX_NHS) {
+		errno = ERANGE;
+		return CMD_ERROR;
+	}
+	len = sizeof(*req) + n_nhs * sizeof(req->nhs[0]);
+	if ((req = calloc(1, len)) == NULL)
+		return CMD_ERROR;
+
+	req->exist_ok = true;
+	if (ip4_net_parse(arg_str(p, "DEST"), &req->dest, true) < 0)
+		goto out;
+	for (n = ec_pnode_find(p, "NH"); n != NULL; n = ec_pnode_find_next(p, n, "NH", false)) {
+		const struct ec_strvec *v = ec_pnode_get_strvec(n);
+		if (inet_pton(AF_INET, ec_strvec_val(v, 0), &req->nhs[req->n_nhs++]) != 1) {
+			errno = EINVAL;
+			goto out;
+		}
+	}
+	if (arg_u16(p, "VRF", &req->vrf_id) < 0 && errno != ENOENT)
+		goto out;
+	if (arg_u16(p, "NH_VRF", &req->nh_vrf_id) == 0)
+		req->leak = true;
+	else if (errno != ENOENT)
+		goto out;
+
+	if (gr_api_client_send_recv(c, GR_IP4_ROUTE_ADD_MULTIPATH, len, req, NULL) < 0)
+		goto out;
+
+	ret = CMD_SUCCESS;
+out:
+	free(req);
+	return ret;
+}
 
 static cmd_status_t route4_add(const struct gr_api_client *c, const struct ec_pnode *p) {
 	struct gr_ip4_route_add_req req = {.exist_ok = true};
+	const struct ec_pnode *n;
+	unsigned n_nhs = 0;
+
+	for (n = ec_pnode_find(p, "NH"); n != NULL; n = ec_pnode_find_next(p, n, "NH", false))
+		n_nhs++;
+	if (n_nhs > 1)
+		return route4_add_multipath(c, p, n_nhs);
 
 	if (ip4_net_parse(arg_str(p, "DEST"), &req.dest, true) < 0)
 		return CMD_ERROR;
@@ -26,6 +80,30 @@ static cmd_status_t route4_add(const struct gr_api_client *c, const struct ec_pn
 	}
 	if (arg_u16(p, "VRF", &req.vrf_id) < 0 && errno != ENOENT)
 		return CMD_ERROR;
+	if (arg_u16(p, "NH_VRF", &req.nh_vrf_id) == 0)
+		req.leak = true;
+	else if (errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_IP4_ROUTE_ADD, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t route4_add_group(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_ip4_route_add_req req = {.exist_ok = true};
+
+	if (ip4_net_parse(arg_str(p, "DEST"), &req.dest, true) < 0)
+		return CMD_ERROR;
+	if (arg_u32(p, "ID", &req.nh_group_id) < 0)
+		return CMD_ERROR;
+	if (arg_u16(p, "VRF", &req.vrf_id) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u16(p, "NH_VRF", &req.nh_vrf_id) == 0)
+		req.leak = true;
+	else if (errno != ENOENT)
+		return CMD_ERROR;
 
 	if (gr_api_client_send_recv(c, GR_IP4_ROUTE_ADD, sizeof(req), &req, NULL) < 0)
 		return CMD_ERROR;
@@ -52,6 +130,7 @@ static cmd_status_t route4_list(const struct gr_api_client *c, const struct ec_p
 	const struct gr_ip4_route_list_resp *resp;
 	struct gr_ip4_route_list_req req = {0};
 	char dest[BUFSIZ], nh[BUFSIZ];
+	int n;
 	void *resp_ptr = NULL;
 
 	if (table == NULL)
@@ -60,28 +139,39 @@ static cmd_status_t route4_list(const struct gr_api_client *c, const struct ec_p
 	if (arg_u16(p, "VRF", &req.vrf_id) < 0 && errno != ENOENT)
 		return CMD_ERROR;
 
-	if (gr_api_client_send_recv(c, GR_IP4_ROUTE_LIST, sizeof(req), &req, &resp_ptr) < 0) {
-		scols_unref_table(table);
-		return CMD_ERROR;
-	}
-
-	resp = resp_ptr;
 	scols_table_new_column(table, "DESTINATION", 0, 0);
 	scols_table_new_column(table, "NEXT_HOP", 0, 0);
 	scols_table_set_column_separator(table, "  ");
 
-	for (size_t i = 0; i < resp->n_routes; i++) {
-		struct libscols_line *line = scols_table_new_line(table, NULL);
-		const struct gr_ip4_route *route = &resp->routes[i];
-		ip4_net_format(&route->dest, dest, sizeof(dest));
-		inet_ntop(AF_INET, &route->nh, nh, sizeof(nh));
-		scols_line_set_data(line, 0, dest);
-		scols_line_set_data(line, 1, nh);
-	}
+	do {
+		if (gr_api_client_send_recv(c, GR_IP4_ROUTE_LIST, sizeof(req), &req, &resp_ptr)
+		    < 0) {
+			scols_unref_table(table);
+			return CMD_ERROR;
+		}
+
+		resp = resp_ptr;
+		for (size_t i = 0; i < resp->n_routes; i++) {
+			struct libscols_line *line = scols_table_new_line(table, NULL);
+			const struct gr_ip4_route *route = &resp->routes[i];
+			ip4_net_format(&route->dest, dest, sizeof(dest));
+			inet_ntop(AF_INET, &route->nh, nh, sizeof(nh));
+			if (route->nh_vrf_id != req.vrf_id) {
+				n = strlen(nh);
+				snprintf(nh + n, sizeof(nh) - n, " vrf %u", route->nh_vrf_id);
+			}
+			scols_line_set_data(line, 0, dest);
+			scols_line_set_data(line, 1, nh);
+		}
 
-	scols_print_table(table);
+		req.cursor = resp->next_cursor;
+		req.last = resp->last;
+		free(resp_ptr);
+		gr_table_flush(table);
+	} while (req.cursor != 0);
+
+	gr_table_print(table);
 	scols_unref_table(table);
-	free(resp_ptr);
 
 	return CMD_SUCCESS;
 }
@@ -127,12 +217,31 @@ static int ctx_init(struct ec_node *root) {
 
 	ret = CLI_COMMAND(
 		IP_ADD_CTX(root),
-		"route DEST via NH [vrf VRF]",
+		"route DEST via NH+ [vrf VRF] [nh-vrf NH_VRF]",
 		route4_add,
-		"Add a new route.",
+		"Add a new route. Multiple next hops create an ECMP route.",
 		with_help("IPv4 destination prefix.", ec_node_re("DEST", IPV4_NET_RE)),
 		with_help("IPv4 next hop address.", ec_node_re("NH", IPV4_RE)),
-		with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10))
+		with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10)),
+		with_help(
+			"Leak the route from this L3 routing domain ID.",
+			ec_node_uint("NH_VRF", 0, UINT16_MAX - 1, 10)
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		IP_ADD_CTX(root),
+		"route DEST group ID [vrf VRF] [nh-vrf NH_VRF]",
+		route4_add_group,
+		"Add a new route via a next hop group.",
+		with_help("IPv4 destination prefix.", ec_node_re("DEST", IPV4_NET_RE)),
+		with_help("Next hop group ID.", ec_node_uint("ID", 1, UINT16_MAX - 1, 10)),
+		with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10)),
+		with_help(
+			"Leak the route from this L3 routing domain ID.",
+			ec_node_uint("NH_VRF", 0, UINT16_MAX - 1, 10)
+		)
 	);
 	if (ret < 0)
 		return ret;
@@ -160,6 +269,27 @@ static int ctx_init(struct ec_node *root) {
 	return 0;
 }
 
+static void route4_event_print(const struct gr_api_client *, const void *obj) {
+	const struct gr_ip4_route_event *ev = obj;
+
+	printf("vrf=%u " IP4_ADDR_FMT "/%hhu via " IP4_ADDR_FMT,
+	       ev->vrf_id,
+	       IP4_ADDR_SPLIT(&ev->route.dest.ip),
+	       ev->route.dest.prefixlen,
+	       IP4_ADDR_SPLIT(&ev->route.nh));
+}
+
+static struct cli_event_type route4_add_event = {
+	.ev_type = GR_IP4_EVENT_ROUTE_ADD,
+	.name = "ip route add",
+	.print = route4_event_print,
+};
+static struct cli_event_type route4_del_event = {
+	.ev_type = GR_IP4_EVENT_ROUTE_DEL,
+	.name = "ip route del",
+	.print = route4_event_print,
+};
+
 static struct gr_cli_context ctx = {
 	.name = "ipv4 route",
 	.init = ctx_init,
@@ -167,4 +297,6 @@ static struct gr_cli_context ctx = {
 
 static void __attribute__((constructor, used)) init(void) {
 	register_context(&ctx);
+	register_event_type(&route4_add_event);
+	register_event_type(&route4_del_event);
 }
@@ -8,6 +8,7 @@
 #include <gr_ip4_control.h>
 #include <gr_log.h>
 #include <gr_net_types.h>
+#include <gr_port.h>
 #include <gr_queue.h>
 
 #include <event2/event.h>
@@ -101,6 +102,7 @@ static struct api_out addr_add(const void *request, void ** /*response*/) {
 
 	ifaddrs->nh[addr_index] = nh;
 	ifaddrs->count++;
+	port_ctrl_addr_add(iface->id, AF_INET, &nh->ip);
 
 	return api_out(0, 0);
 }
@@ -130,6 +132,7 @@ static struct api_out addr_del(const void *request, void ** /*response*/) {
 	if ((nh->flags & (GR_IP4_NH_F_LOCAL | GR_IP4_NH_F_LINK)) || nh->ref_count > 1)
 		return api_out(EBUSY, 0);
 
+	port_ctrl_addr_del(req->addr.iface_id, AF_INET, &nh->ip);
 	ip4_route_cleanup(nh);
 
 	// shift the remaining addresses
@@ -140,36 +143,65 @@ static struct api_out addr_del(const void *request, void ** /*response*/) {
 	return api_out(0, 0);
 }
 
+// List cursor: interface id in the upper 16 bits, index of the first address
+// of that interface to return in the lower 16 bits.
+#define ADDR_CURSOR(iface_id, index) (((uint32_t)(iface_id) << 16) | (index))
+#define ADDR_CURSOR_IFACE(cursor) ((uint16_t)((cursor) >> 16))
+#define ADDR_CURSOR_INDEX(cursor) ((cursor) & UINT16_MAX)
+
+// Max number of addresses in a single list response.
+#define ADDR_LIST_MAX                                                                              \
+	((GR_API_MAX_MSG_LEN - sizeof(struct gr_ip4_addr_list_resp)) / sizeof(struct gr_ip4_ifaddr))
+
 static struct api_out addr_list(const void *request, void **response) {
 	const struct gr_ip4_addr_list_req *req = request;
 	struct gr_ip4_addr_list_resp *resp = NULL;
 	const struct hoplist *addrs;
 	struct gr_ip4_ifaddr *addr;
-	uint16_t iface_id, num;
+	uint32_t next_cursor;
+	uint16_t iface_id;
+	unsigned start, num;
 	size_t len;
 
+	// Stop at the first address that does not fit, the next page starts there.
 	num = 0;
-	for (iface_id = 0; iface_id < MAX_IFACES; iface_id++) {
+	next_cursor = 0;
+	start = ADDR_CURSOR_INDEX(req->cursor);
+	for (iface_id = ADDR_CURSOR_IFACE(req->cursor); iface_id < MAX_IFACES; iface_id++) {
 		addrs = ip4_addr_get_all(iface_id);
-		if (addrs == NULL || addrs->count == 0 || addrs->nh[0]->vrf_id != req->vrf_id)
+		if (addrs == NULL || addrs->count <= start || addrs->nh[0]->vrf_id != req->vrf_id) {
+			start = 0;
 			continue;
-		num += addrs->count;
+		}
+		if (num + addrs->count - start > ADDR_LIST_MAX) {
+			next_cursor = ADDR_CURSOR(iface_id, start + ADDR_LIST_MAX - num);
+			num = ADDR_LIST_MAX;
+			break;
+		}
+		num += addrs->count - start;
+		start = 0;
 	}
 
 	len = sizeof(*resp) + num * sizeof(struct gr_ip4_ifaddr);
 	if ((resp = calloc(len, 1)) == NULL)
 		return api_out(ENOMEM, 0);
 
-	for (iface_id = 0; iface_id < MAX_IFACES; iface_id++) {
+	resp->next_cursor = next_cursor;
+
+	start = ADDR_CURSOR_INDEX(req->cursor);
+	for (iface_id = ADDR_CURSOR_IFACE(req->cursor); resp->n_addrs < num; iface_id++) {
 		addrs = ip4_addr_get_all(iface_id);
-		if (addrs == NULL || addrs->count == 0 || addrs->nh[0]->vrf_id != req->vrf_id)
+		if (addrs == NULL || addrs->count <= start || addrs->nh[0]->vrf_id != req->vrf_id) {
+			start = 0;
 			continue;
-		for (unsigned i = 0; i < addrs->count; i++) {
+		}
+		for (unsigned i = start; i < addrs->count && resp->n_addrs < num; i++) {
 			addr = &resp->addrs[resp->n_addrs++];
 			addr->addr.ip = addrs->nh[i]->ip;
 			addr->addr.prefixlen = addrs->nh[i]->prefixlen;
 			addr->iface_id = iface_id;
 		}
+		start = 0;
 	}
 
 	*response = resp;
@@ -187,8 +219,10 @@ static void iface_event_handler(iface_event_t event, struct iface *iface) {
 	if (ifaddrs == NULL)
 		return;
 
-	for (unsigned i = 0; i < ifaddrs->count; i++)
+	for (unsigned i = 0; i < ifaddrs->count; i++) {
+		port_ctrl_addr_del(iface->id, AF_INET, &ifaddrs->nh[i]->ip);
 		ip4_route_cleanup(ifaddrs->nh[i]);
+	}
 
 	memset(ifaddrs, 0, sizeof(*ifaddrs));
 }
@@ -208,16 +242,19 @@ static struct gr_api_handler addr_add_handler = {
 	.name = "ipv4 address add",
 	.request_type = GR_IP4_ADDR_ADD,
 	.callback = addr_add,
+	.flags = GR_API_F_CONFIG,
 };
 static struct gr_api_handler addr_del_handler = {
 	.name = "ipv4 address del",
 	.request_type = GR_IP4_ADDR_DEL,
 	.callback = addr_del,
+	.flags = GR_API_F_CONFIG,
 };
 static struct gr_api_handler addr_list_handler = {
 	.name = "ipv4 address list",
 	.request_type = GR_IP4_ADDR_LIST,
 	.callback = addr_list,
+	.flags = GR_API_F_READ,
 };
 static struct gr_module addr_module = {
 	.name = "ipv4 address",
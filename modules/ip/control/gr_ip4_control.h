@@ -4,8 +4,11 @@
 #ifndef _GR_IP4_CONTROL
 #define _GR_IP4_CONTROL
 
+#include <gr_iface.h>
 #include <gr_ip4.h>
 #include <gr_net_types.h>
+#include <gr_nh_group.h>
+#include <gr_nh_neigh.h>
 
 #include <rte_ether.h>
 #include <rte_fib.h>
@@ -13,25 +16,53 @@
 #include <rte_rcu_qsbr.h>
 #include <rte_spinlock.h>
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 struct __rte_cache_aligned nexthop {
+	// Fields read by datapath workers for every packet. They are only written
+	// on state changes and must share the first cache line.
 	gr_ip4_nh_flags_t flags;
 	struct rte_ether_addr lladdr;
 	uint16_t vrf_id;
 	uint16_t iface_id;
 	ip4_addr_t ip;
-	uint64_t last_request, last_reply;
+	// ethernet header for lladdr, built by eth_output
+	struct eth_l2_rewrite l2;
+	// ECMP members, only set on GR_IP4_NH_F_GROUP next hops
+	struct nh_group *group;
+	// output interface resolved from iface_id, NULL while it does not exist
+	const struct iface *iface;
+
+	// Mutable bookkeeping, on a separate cache line so that updating it does
+	// not invalidate the line above for all workers.
+	// ARP resolution state, held packets and aging
+	alignas(RTE_CACHE_LINE_SIZE) struct nh_neigh neigh;
+	// index in the FIB next hop tables, assigned once and kept when freed
+	uint32_t id;
 	uint32_t ref_count; // number of routes referencing this nexthop
+	// number of routes of other VRFs referencing this nexthop, see GR_IP4_NH_F_LEAKED
+	uint32_t leak_count;
 	uint8_t prefixlen;
-	uint8_t ucast_probes : 4, bcast_probes : 4;
+	// set while a solicitation for this next hop is queued to control_input
+	bool solicit_queued;
+	// last flags reported to the API event subscribers
+	gr_ip4_nh_flags_t ev_flags;
+	// set by liveness detection protocols (e.g. BFD), see ip4_nexthop_set_alive
+	bool peer_down;
 	rte_spinlock_t lock;
-	// packets waiting for ARP resolution
-	uint16_t held_pkts_num;
-	struct rte_mbuf *held_pkts_head;
-	struct rte_mbuf *held_pkts_tail;
 };
 
+static_assert(offsetof(struct nexthop, iface) + sizeof(void *) <= RTE_CACHE_LINE_SIZE);
+// The neighbor state machine updates these flags in place.
+static_assert(GR_IP4_NH_F_PENDING == NH_NEIGH_F_PENDING);
+static_assert(GR_IP4_NH_F_REACHABLE == NH_NEIGH_F_REACHABLE);
+static_assert(GR_IP4_NH_F_STALE == NH_NEIGH_F_STALE);
+static_assert(GR_IP4_NH_F_FAILED == NH_NEIGH_F_FAILED);
+static_assert(GR_IP4_NH_F_STATIC == NH_NEIGH_F_STATIC);
+static_assert(GR_IP4_NH_F_GATEWAY == NH_NEIGH_F_GATEWAY);
+
 #define IP4_HOPLIST_MAX_SIZE 8
 
 struct hoplist {
@@ -39,36 +70,156 @@ struct hoplist {
 	struct nexthop *nh[IP4_HOPLIST_MAX_SIZE];
 };
 
-// Max number of packets to hold per next hop waiting for resolution (default: 256).
-#define IP4_NH_MAX_HELD_PKTS 256
-// Reachable next hop lifetime after last ARP reply received (default: 20 min).
-#define IP4_NH_LIFETIME_REACHABLE (20 * 60)
-// Unreachable next hop lifetime after last unreplied ARP request was sent (default: 1 min).
-#define IP4_NH_LIFETIME_UNREACHABLE 60
-// Max number of unicast ARP probes to send after IP4_NH_LIFETIME_REACHABLE.
-#define IP4_NH_UCAST_PROBES 3
-// Max number of broadcast ARP probes to send after unicast probes failed.
-#define IP4_NH_BCAST_PROBES 3
+// Max number of ARP solicitations sent per second per interface and per worker.
+#define IP4_NH_SOLICIT_RATE 100
+// Max number of ARP solicitations sent in a burst per interface and per worker.
+#define IP4_NH_SOLICIT_BURST 32
+// Max number of pending host route learning requests posted by datapath workers.
+#define IP4_NH_LEARN_RING_SIZE 1024
+// Max number of host routes created by the control plane per event loop iteration.
+#define IP4_NH_LEARN_BURST 64
 
 // XXX: why not 1337, eh?
 #define IP4_MAX_NEXT_HOPS (1 << 16)
 #define IP4_MAX_ROUTES (1 << 16)
+// VRFs with fewer routes use a FIB with fewer tbl8 groups, unless configured otherwise.
+#define IP4_FIB_REDUCED_MAX_ROUTES 1024
+// Number of tbl8 groups of reduced FIBs, enough for that many /24 prefixes
+// holding longer routes.
+#define IP4_FIB_REDUCED_NUM_TBL8 256
 #define IP4_MAX_VRFS 256
+#define IP4_MAX_NH_GROUPS (1 << 16)
 
 struct nexthop *ip4_nexthop_lookup(uint16_t vrf_id, ip4_addr_t ip);
 struct nexthop *ip4_nexthop_new(uint16_t vrf_id, uint16_t iface_id, ip4_addr_t ip);
 void ip4_nexthop_incref(struct nexthop *);
 void ip4_nexthop_decref(struct nexthop *);
+// Mark a next hop as carrying traffic.
+static inline void ip4_nexthop_touch(struct nexthop *nh) {
+	nh_neigh_touch(&nh->neigh);
+}
+// Report the liveness of a gateway as detected by a protocol such as BFD.
+// ECMP groups stop using the next hop while it is not alive, even if its
+// output interface is up.
+void ip4_nexthop_set_alive(struct nexthop *, bool alive);
+// Create an ECMP group next hop. Each member is referenced by the group.
+struct nexthop *
+ip4_nexthop_group_new(uint16_t vrf_id, unsigned n, struct nexthop *const *members);
+// Replace the members of an ECMP group. Flows of unchanged members keep their next hop.
+int ip4_nexthop_group_set(struct nexthop *group, unsigned n, struct nexthop *const *members);
+// Get a next hop group by its user assigned ID.
+struct nexthop *ip4_nexthop_group_get(uint32_t id);
+// Lookup (or create) the gateway next hops of a group. All ips must be routable.
+int ip4_nexthop_group_members(
+	uint16_t vrf_id,
+	unsigned n,
+	const ip4_addr_t *ips,
+	struct nexthop **members
+);
+// Release the members returned by ip4_nexthop_group_members that are not referenced.
+void ip4_nexthop_group_members_put(unsigned n, struct nexthop **members);
+// Request the asynchronous creation of a /32 host route by the control plane.
+// These functions are safe to call from datapath workers.
+int ip4_nexthop_learn(
+	uint16_t vrf_id,
+	uint16_t iface_id,
+	ip4_addr_t ip,
+	struct rte_ether_addr lladdr
+);
+int ip4_nexthop_learn_held(const struct nexthop *link);
 
 int ip4_route_insert(uint16_t vrf_id, ip4_addr_t ip, uint8_t prefixlen, struct nexthop *);
 int ip4_route_delete(uint16_t vrf_id, ip4_addr_t ip, uint8_t prefixlen);
+// Delete multiple routes without waiting for RCU grace periods. The errno value of
+// each deletion is stored in status.
+void ip4_route_delete_bulk(
+	uint16_t vrf_id,
+	unsigned n,
+	const struct ip4_net *dests,
+	uint32_t *status
+);
 struct nexthop *ip4_route_lookup(uint16_t vrf_id, ip4_addr_t ip);
+// Resolve n destination addresses (network order) in a single FIB walk.
+// Unroutable destinations are set to NULL in nhs.
+void ip4_route_lookup_bulk(
+	uint16_t vrf_id,
+	unsigned n,
+	const ip4_addr_t *ips,
+	struct nexthop **nhs
+);
 struct nexthop *ip4_route_lookup_exact(uint16_t vrf_id, ip4_addr_t ip, uint8_t prefixlen);
 void ip4_route_cleanup(struct nexthop *);
 
+// Incremented after every FIB modification and next hop release. Datapath
+// caches of route lookup results are stale when it changes. Never zero.
+extern uint32_t ip4_route_gen;
+void ip4_route_gen_bump(void);
+
+// Route lookup result for a fixed destination, such as the remote endpoint of
+// a tunnel, filled by datapath workers. It is valid for the ip4_route_gen and
+// iface_config_gen values stored along. seq is odd while a worker updates the
+// entry. It serves as a try lock so that concurrent writers never publish
+// mismatched fields.
+struct ip4_route_cache {
+	uint32_t seq;
+	uint32_t route_gen;
+	uint32_t iface_gen;
+	struct nexthop *nh;
+};
+
+// Next hops are released after an RCU grace period which starts after
+// ip4_route_gen is bumped. A cached entry read with a matching generation can
+// be safely dereferenced until the end of the current graph walk.
+static inline struct nexthop *ip4_route_cache_lookup(
+	struct ip4_route_cache *c,
+	uint16_t vrf_id,
+	ip4_addr_t dst,
+	uint32_t route_gen,
+	uint32_t iface_gen
+) {
+	uint32_t seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+	struct nexthop *nh;
+
+	if (!(seq & 1) && c->route_gen == route_gen && c->iface_gen == iface_gen) {
+		nh = c->nh;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&c->seq, __ATOMIC_RELAXED) == seq)
+			return nh;
+	}
+
+	nh = ip4_route_lookup(vrf_id, dst);
+
+	// Another worker is updating the entry, do not wait for it.
+	if (!(seq & 1)
+	    && __atomic_compare_exchange_n(
+		    &c->seq, &seq, seq + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED
+	    )) {
+		c->route_gen = route_gen;
+		c->iface_gen = iface_gen;
+		c->nh = nh;
+		__atomic_store_n(&c->seq, seq + 2, __ATOMIC_RELEASE);
+	}
+
+	return nh;
+}
+
+// Hardware flow offload candidates, see struct gr_ip4_offload_conf. Zero when
+// disabled, read by datapath workers without locking.
+extern uint32_t ip4_offload_threshold;
+// Report a destination forwarded above the threshold by the flow cache. Safe
+// to call from datapath workers. The control plane resolves the route again
+// before installing a rule.
+void ip4_offload_candidate(uint16_t vrf_id, uint16_t iface_id, ip4_addr_t dst);
+// Schedule the revalidation of the offloaded rules, called by ip4_route_gen_bump.
+void ip4_offload_route_changed(void);
+
 // get the default address for a given interface
 struct nexthop *ip4_addr_get_preferred(uint16_t iface_id, ip4_addr_t dst);
 // get all addresses for a given interface
 struct hoplist *ip4_addr_get_all(uint16_t iface_id);
 
+// ICMP error rate limit configuration. Fields are updated atomically and
+// may be read without locking.
+const struct gr_ip4_icmp_limit *ip4_icmp_limit_get(uint8_t icmp_type);
+
 #endif
@@ -0,0 +1,504 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr.h>
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_ip4.h>
+#include <gr_ip4_control.h>
+#include <gr_log.h>
+#include <gr_macro.h>
+#include <gr_port.h>
+#include <gr_stb_ds.h>
+
+#include <event2/event.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_flow.h>
+#include <rte_ring.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Hardware flow offload of the IPv4 destinations reported by the flow cache.
+//
+// Datapath workers post candidates in a ring when a flow cache entry forwards
+// more than ip4_offload_threshold packets in one second. Every period, the
+// control plane drains the ring, resolves the route of each candidate and
+// installs a transfer rule on the ingress port. Packets with a TTL lower than
+// 2 are always sent to software by a higher priority rule on each ingress
+// port so that ip_forward can reply with an ICMP error.
+//
+// The counters of all rules are read every period. Idle rules are removed and
+// active ones keep the ARP entry of their next hop alive. All rules are
+// resolved again after each FIB or next hop modification and every period. A
+// rule whose egress port or ethernet addresses differ is removed immediately,
+// its traffic goes back to software which reports it again if needed.
+#define OFFLOAD_PERIOD_SEC 1
+#define OFFLOAD_RING_SIZE 1024
+#define OFFLOAD_MAX_FLOWS_DEFAULT 1024
+#define OFFLOAD_IDLE_TIMEOUT_DEFAULT 10
+// TTL exception rules must have the highest priority.
+#define OFFLOAD_FLOW_PRIORITY 1
+
+uint32_t ip4_offload_threshold;
+
+struct offload_candidate {
+	uint16_t vrf_id;
+	uint16_t iface_id;
+	ip4_addr_t dst;
+};
+
+// What the rule of a destination does, compared by value to detect changes.
+struct offload_target {
+	uint16_t in_port;
+	uint16_t out_port;
+	struct rte_ether_addr in_mac;
+	struct rte_ether_addr src;
+	struct rte_ether_addr dst;
+};
+
+struct offload_flow {
+	struct offload_candidate key;
+	struct offload_target target;
+	struct rte_flow *flow;
+	uint64_t hits; // last counter values
+	uint64_t bytes;
+	uint16_t idle; // periods without traffic
+};
+
+static struct gr_ip4_offload_conf conf = {
+	.max_flows = OFFLOAD_MAX_FLOWS_DEFAULT,
+	.idle_timeout = OFFLOAD_IDLE_TIMEOUT_DEFAULT,
+};
+static struct gr_ip4_offload_stats stats;
+static struct offload_flow *flows; // stb_ds array
+static struct rte_flow *ttl_flows[RTE_MAX_ETHPORTS];
+static struct rte_ring *candidates;
+static struct event *period_ev;
+static struct event *invalidate_ev;
+static uint32_t route_gen;
+
+void ip4_offload_candidate(uint16_t vrf_id, uint16_t iface_id, ip4_addr_t dst) {
+	const struct offload_candidate c = {vrf_id, iface_id, dst};
+	// dropped when the ring is full, reported again at the next second
+	rte_ring_mp_enqueue_elem(candidates, &c, sizeof(c));
+}
+
+static bool same_switch(uint16_t a, uint16_t b) {
+	struct rte_eth_dev_info ia, ib;
+
+	if (rte_eth_dev_info_get(a, &ia) < 0 || rte_eth_dev_info_get(b, &ib) < 0)
+		return false;
+	if (ia.switch_info.domain_id == RTE_ETH_DEV_SWITCH_DOMAIN_ID_INVALID)
+		return false;
+	return ia.switch_info.domain_id == ib.switch_info.domain_id;
+}
+
+// Same conditions as the flow cache fast path, from port to port only.
+static int offload_resolve(const struct offload_candidate *c, struct offload_target *t) {
+	const struct iface *in, *out;
+	struct nexthop *nh;
+
+	if ((in = iface_from_id(c->iface_id)) == NULL)
+		return -errno;
+	if (in->type_id != GR_IFACE_TYPE_PORT || in->vrf_id != c->vrf_id)
+		return errno_set(EMEDIUMTYPE);
+	if (in->flags & GR_IFACE_F_RPF || in->acl_in != NULL || in->nat44 != NULL)
+		return errno_set(ENOTSUP);
+	if (in->pbr != NULL || in->policer != NULL || in->sampler != NULL || in->domain != NULL)
+		return errno_set(ENOTSUP);
+
+	if ((nh = ip4_route_lookup(c->vrf_id, c->dst)) == NULL)
+		return errno_set(EHOSTUNREACH);
+	if (nh->flags & (GR_IP4_NH_F_LOCAL | GR_IP4_NH_F_GROUP))
+		return errno_set(ENOTSUP);
+	if (nh->flags & GR_IP4_NH_F_LINK && nh->ip != c->dst)
+		return errno_set(ENOTSUP);
+	if (!(nh->flags & GR_IP4_NH_F_REACHABLE))
+		return errno_set(EHOSTUNREACH);
+
+	if ((out = nh->iface) == NULL || out->type_id != GR_IFACE_TYPE_PORT)
+		return errno_set(EMEDIUMTYPE);
+	if (out->acl_out != NULL || out->nat44 != NULL)
+		return errno_set(ENOTSUP);
+	// ip_fragment is not available in hardware
+	if (out->mtu < in->mtu)
+		return errno_set(EMSGSIZE);
+
+	t->in_port = ((const struct iface_info_port *)in->info)->port_id;
+	t->out_port = ((const struct iface_info_port *)out->info)->port_id;
+	t->in_mac = in->mac;
+	t->src = out->mac;
+	t->dst = nh->lladdr;
+
+	return 0;
+}
+
+static void offload_flow_destroy(uint16_t port_id, struct rte_flow **flow) {
+	struct rte_flow_error err;
+
+	if (*flow == NULL)
+		return;
+	if (rte_flow_destroy(port_id, *flow, &err) < 0)
+		LOG(NOTICE, "port %u: rte_flow_destroy: %s", port_id, err.message);
+	*flow = NULL;
+}
+
+static struct rte_flow *offload_flow_create(
+	uint16_t port_id,
+	uint32_t priority,
+	const struct rte_flow_item *pattern,
+	const struct rte_flow_action *actions
+) {
+	const struct rte_flow_attr attr = {.transfer = 1, .priority = priority};
+	struct rte_flow_error err;
+	struct rte_flow *flow;
+
+	memset(&err, 0, sizeof(err));
+	flow = rte_flow_create(port_id, &attr, pattern, actions, &err);
+	if (flow == NULL)
+		LOG(DEBUG,
+		    "port %u: rte_flow_create: %s",
+		    port_id,
+		    err.message ? err.message : rte_strerror(rte_errno));
+
+	return flow;
+}
+
+// Send the packets which must not be forwarded by hardware to software.
+static int ttl_flow_install(uint16_t port_id) {
+	const struct rte_flow_item_ethdev port = {.port_id = port_id};
+	const struct rte_flow_item_ipv4 ip_spec = {.hdr.time_to_live = 0};
+	const struct rte_flow_item_ipv4 ip_mask = {.hdr.time_to_live = 0xfe};
+	const struct rte_flow_item pattern[] = {
+		{.type = RTE_FLOW_ITEM_TYPE_REPRESENTED_PORT, .spec = &port},
+		{.type = RTE_FLOW_ITEM_TYPE_ETH},
+		{.type = RTE_FLOW_ITEM_TYPE_IPV4, .spec = &ip_spec, .mask = &ip_mask},
+		{.type = RTE_FLOW_ITEM_TYPE_END},
+	};
+	const struct rte_flow_action_ethdev to_sw = {.port_id = port_id};
+	const struct rte_flow_action actions[] = {
+		{.type = RTE_FLOW_ACTION_TYPE_PORT_REPRESENTOR, .conf = &to_sw},
+		{.type = RTE_FLOW_ACTION_TYPE_END},
+	};
+
+	if (ttl_flows[port_id] != NULL)
+		return 0;
+	ttl_flows[port_id] = offload_flow_create(port_id, 0, pattern, actions);
+	if (ttl_flows[port_id] == NULL)
+		return errno_set(ENOTSUP);
+
+	return 0;
+}
+
+static int offload_install(struct offload_flow *f) {
+	const struct rte_flow_item_ethdev in_port = {.port_id = f->target.in_port};
+	const struct rte_flow_item_eth eth_mask = {
+		.hdr.dst_addr.addr_bytes = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+	};
+	const struct rte_flow_item_ipv4 ip_mask = {.hdr.dst_addr = RTE_BE32(0xffffffff)};
+	const struct rte_flow_item_ipv4 ip_spec = {.hdr.dst_addr = f->key.dst};
+	const struct rte_flow_action_ethdev out_port = {.port_id = f->target.out_port};
+	struct rte_flow_action_set_mac set_src, set_dst;
+	const struct rte_flow_action_count count = {0};
+	struct rte_flow_item_eth eth_spec;
+
+	memset(&eth_spec, 0, sizeof(eth_spec));
+	eth_spec.hdr.dst_addr = f->target.in_mac;
+	memcpy(set_src.mac_addr, &f->target.src, sizeof(set_src.mac_addr));
+	memcpy(set_dst.mac_addr, &f->target.dst, sizeof(set_dst.mac_addr));
+
+	const struct rte_flow_item pattern[] = {
+		{.type = RTE_FLOW_ITEM_TYPE_REPRESENTED_PORT, .spec = &in_port},
+		{.type = RTE_FLOW_ITEM_TYPE_ETH, .spec = &eth_spec, .mask = &eth_mask},
+		{.type = RTE_FLOW_ITEM_TYPE_IPV4, .spec = &ip_spec, .mask = &ip_mask},
+		{.type = RTE_FLOW_ITEM_TYPE_END},
+	};
+	const struct rte_flow_action actions[] = {
+		{.type = RTE_FLOW_ACTION_TYPE_SET_MAC_SRC, .conf = &set_src},
+		{.type = RTE_FLOW_ACTION_TYPE_SET_MAC_DST, .conf = &set_dst},
+		{.type = RTE_FLOW_ACTION_TYPE_DEC_TTL},
+		{.type = RTE_FLOW_ACTION_TYPE_COUNT, .conf = &count},
+		{.type = RTE_FLOW_ACTION_TYPE_REPRESENTED_PORT, .conf = &out_port},
+		{.type = RTE_FLOW_ACTION_TYPE_END},
+	};
+
+	if (ttl_flow_install(f->target.in_port) < 0)
+		return -errno;
+
+	f->flow = offload_flow_create(f->target.in_port, OFFLOAD_FLOW_PRIORITY, pattern, actions);
+	if (f->flow == NULL)
+		return errno_set(ENOTSUP);
+
+	return 0;
+}
+
+static void offload_remove(int i) {
+	offload_flow_destroy(flows[i].target.in_port, &flows[i].flow);
+	arrdelswap(flows, i);
+}
+
+static bool port_has_flows(uint16_t port_id) {
+	const struct offload_flow *f;
+
+	arrforeach (f, flows) {
+		if (f->target.in_port == port_id)
+			return true;
+	}
+	return false;
+}
+
+static void ttl_flows_cleanup(void) {
+	for (uint16_t port_id = 0; port_id < RTE_MAX_ETHPORTS; port_id++) {
+		if (ttl_flows[port_id] != NULL && !port_has_flows(port_id))
+			offload_flow_destroy(port_id, &ttl_flows[port_id]);
+	}
+}
+
+static void offload_flush(void) {
+	while (arrlen(flows) > 0)
+		offload_remove(arrlen(flows) - 1);
+	ttl_flows_cleanup();
+}
+
+static const struct offload_flow *offload_find(const struct offload_candidate *c) {
+	const struct offload_flow *f;
+
+	arrforeach (f, flows) {
+		if (f->key.vrf_id == c->vrf_id && f->key.dst == c->dst
+		    && f->key.iface_id == c->iface_id)
+			return f;
+	}
+	return NULL;
+}
+
+static void offload_add(const struct offload_candidate *c) {
+	struct offload_flow f = {.key = *c};
+
+	if (offload_find(c) != NULL || arrlen(flows) >= conf.max_flows)
+		return;
+
+	if (offload_resolve(c, &f.target) < 0 || !same_switch(f.target.in_port, f.target.out_port)
+	    || offload_install(&f) < 0) {
+		stats.failed++;
+		return;
+	}
+
+	arrpush(flows, f);
+	stats.installed++;
+}
+
+// Remove the rules whose destination is not forwarded the same way anymore.
+static void offload_revalidate(void) {
+	struct offload_target t;
+
+	route_gen = __atomic_load_n(&ip4_route_gen, __ATOMIC_ACQUIRE);
+
+	for (int i = arrlen(flows) - 1; i >= 0; i--) {
+		if (offload_resolve(&flows[i].key, &t) == 0
+		    && memcmp(&t, &flows[i].target, sizeof(t)) == 0)
+			continue;
+		offload_remove(i);
+		stats.invalidated++;
+	}
+	ttl_flows_cleanup();
+}
+
+static void offload_age(void) {
+	const struct rte_flow_action count[] = {
+		{.type = RTE_FLOW_ACTION_TYPE_COUNT},
+		{.type = RTE_FLOW_ACTION_TYPE_END},
+	};
+	struct rte_flow_query_count q;
+	struct rte_flow_error err;
+	struct offload_flow *f;
+	struct nexthop *nh;
+
+	for (int i = arrlen(flows) - 1; i >= 0; i--) {
+		f = &flows[i];
+		memset(&q, 0, sizeof(q));
+		if (rte_flow_query(f->target.in_port, f->flow, count, &q, &err) < 0 || !q.hits_set)
+			continue;
+		if (q.hits != f->hits) {
+			stats.packets += q.hits - f->hits;
+			if (q.bytes_set)
+				stats.bytes += q.bytes - f->bytes;
+			f->hits = q.hits;
+			f->bytes = q.bytes;
+			f->idle = 0;
+			// keep the ARP entry of offloaded traffic alive
+			if ((nh = ip4_route_lookup(f->key.vrf_id, f->key.dst)) != NULL)
+				ip4_nexthop_touch(nh);
+			continue;
+		}
+		if (++f->idle * OFFLOAD_PERIOD_SEC >= conf.idle_timeout) {
+			offload_remove(i);
+			stats.expired++;
+		}
+	}
+}
+
+static void offload_period_cb(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	struct offload_candidate c[64];
+	unsigned n;
+
+	if (arrlen(flows) > 0) {
+		offload_revalidate();
+		offload_age();
+		ttl_flows_cleanup();
+	}
+
+	if (ip4_offload_threshold == 0) {
+		rte_ring_reset(candidates);
+		return;
+	}
+	while ((n = rte_ring_dequeue_burst_elem(candidates, c, sizeof(*c), ARRAY_DIM(c), NULL))
+	       > 0) {
+		for (unsigned i = 0; i < n; i++)
+			offload_add(&c[i]);
+	}
+}
+
+static void offload_invalidate_cb(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	offload_revalidate();
+}
+
+void ip4_offload_route_changed(void) {
+	if (invalidate_ev != NULL && arrlen(flows) > 0
+	    && route_gen != __atomic_load_n(&ip4_route_gen, __ATOMIC_RELAXED))
+		event_active(invalidate_ev, 0, 0);
+}
+
+static void offload_iface_event(iface_event_t event, struct iface *iface) {
+	uint16_t port_id;
+
+	if (iface->type_id != GR_IFACE_TYPE_PORT)
+		return;
+
+	switch (event) {
+	case IFACE_EVENT_PRE_REMOVE:
+	case IFACE_EVENT_PORT_POST_RECONFIG:
+		// the rules may not survive a port restart, let software report
+		// the flows again
+		port_id = ((const struct iface_info_port *)iface->info)->port_id;
+		for (int i = arrlen(flows) - 1; i >= 0; i--) {
+			if (flows[i].target.in_port == port_id
+			    || flows[i].target.out_port == port_id) {
+				offload_remove(i);
+				stats.invalidated++;
+			}
+		}
+		offload_flow_destroy(port_id, &ttl_flows[port_id]);
+		break;
+	case IFACE_EVENT_POST_RECONFIG:
+		if (arrlen(flows) > 0)
+			offload_revalidate();
+		break;
+	default:
+		break;
+	}
+}
+
+static struct api_out offload_set(const void *request, void ** /*response*/) {
+	const struct gr_ip4_offload_set_req *req = request;
+
+	conf.threshold = req->conf.threshold;
+	conf.max_flows = req->conf.max_flows ?: OFFLOAD_MAX_FLOWS_DEFAULT;
+	conf.idle_timeout = req->conf.idle_timeout ?: OFFLOAD_IDLE_TIMEOUT_DEFAULT;
+
+	if (conf.threshold == 0)
+		offload_flush();
+	while (arrlen(flows) > conf.max_flows)
+		offload_remove(arrlen(flows) - 1);
+	ttl_flows_cleanup();
+
+	if (conf.threshold != 0 && !gr_args()->flow_cache)
+		LOG(NOTICE, "hardware flow offload requires --flow-cache");
+
+	__atomic_store_n(&ip4_offload_threshold, conf.threshold, __ATOMIC_RELAXED);
+
+	return api_out(0, 0);
+}
+
+static struct api_out offload_get(const void * /*request*/, void **response) {
+	struct gr_ip4_offload_get_resp *resp;
+
+	if ((resp = calloc(1, sizeof(*resp))) == NULL)
+		return api_out(ENOMEM, 0);
+
+	resp->conf = conf;
+	resp->stats = stats;
+	resp->stats.n_flows = arrlen(flows);
+	*response = resp;
+
+	return api_out(0, sizeof(*resp));
+}
+
+static void offload_init(struct event_base *ev_base) {
+	struct timeval tv = {.tv_sec = OFFLOAD_PERIOD_SEC};
+
+	candidates = rte_ring_create_elem(
+		"ip4_offload",
+		sizeof(struct offload_candidate),
+		OFFLOAD_RING_SIZE,
+		SOCKET_ID_ANY,
+		RING_F_SC_DEQ
+	);
+	if (candidates == NULL)
+		ABORT("rte_ring_create(ip4_offload): %s", rte_strerror(rte_errno));
+
+	period_ev = gr_event_new(ev_base, -1, EV_PERSIST | EV_FINALIZE, offload_period_cb, NULL);
+	if (period_ev == NULL || event_add(period_ev, &tv) < 0)
+		ABORT("failed to add ip4 offload event");
+	invalidate_ev = gr_event_new(ev_base, -1, EV_FINALIZE, offload_invalidate_cb, NULL);
+	if (invalidate_ev == NULL)
+		ABORT("gr_event_new() failed");
+}
+
+static void offload_fini(struct event_base *) {
+	__atomic_store_n(&ip4_offload_threshold, 0, __ATOMIC_RELAXED);
+	offload_flush();
+	arrfree(flows);
+	flows = NULL;
+	gr_event_free(invalidate_ev);
+	invalidate_ev = NULL;
+	gr_event_free(period_ev);
+	period_ev = NULL;
+	rte_ring_free(candidates);
+	candidates = NULL;
+}
+
+static struct gr_api_handler set_handler = {
+	.name = "ipv4 offload set",
+	.request_type = GR_IP4_OFFLOAD_SET,
+	.callback = offload_set,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler get_handler = {
+	.name = "ipv4 offload get",
+	.request_type = GR_IP4_OFFLOAD_GET,
+	.callback = offload_get,
+	.flags = GR_API_F_READ,
+};
+
+static struct gr_module offload_module = {
+	.name = "ipv4 offload",
+	.init = offload_init,
+	.fini = offload_fini,
+	// rules must be removed before the ports and routes
+	.fini_prio = -1000,
+};
+
+static struct iface_event_handler offload_iface_handler = {
+	.callback = offload_iface_event,
+};
+
+RTE_INIT(offload_constructor) {
+	gr_register_api_handler(&set_handler);
+	gr_register_api_handler(&get_handler);
+	gr_register_module(&offload_module);
+	iface_event_register_handler(&offload_iface_handler);
+}
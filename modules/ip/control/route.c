@@ -7,8 +7,12 @@
 #include <gr_ip4.h>
 #include <gr_ip4_control.h>
 #include <gr_log.h>
+#include <gr_memory.h>
+#include <gr_mempool.h>
 #include <gr_net_types.h>
 #include <gr_queue.h>
+#include <gr_rcu.h>
+#include <gr_tracepoint.h>
 
 #include <event2/event.h>
 #include <rte_build_config.h>
@@ -19,12 +23,25 @@
 
 #include <arpa/inet.h>
 #include <errno.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/queue.h>
 
-static struct rte_fib **vrf_fibs;
+// VRF tables are replicated on every NUMA node with hugepage memory so that
+// datapath workers only access local memory. All replicas hold the same routes.
+// The first replica, local to the control plane, is used for RIB queries.
+static struct rte_fib **fib_replicas[RTE_MAX_NUMA_NODES];
+static int replica_sockets[RTE_MAX_NUMA_NODES];
+static unsigned n_replicas;
+// Replica index for each socket, sockets without a replica use the first one.
+static uint8_t socket_replicas[RTE_MAX_NUMA_NODES];
+static struct rte_fib **vrf_fibs; // fib_replicas[0]
+// The FIBs store next hop IDs rather than pointers so that DIR24_8 tables can
+// use 4 bytes entries. IDs are resolved with these tables, replicated on the
+// same NUMA nodes as the VRF tables.
+static struct nexthop **nh_replicas[RTE_MAX_NUMA_NODES];
 #define BLACKHOLE (IP4_MAX_NEXT_HOPS + 1)
 
 static struct rte_fib_conf fib_conf = {
@@ -33,11 +50,118 @@ static struct rte_fib_conf fib_conf = {
 	.max_routes = IP4_MAX_ROUTES,
 	.rib_ext_sz = 0,
 	.dir24_8 = {
-		.nh_sz = RTE_FIB_DIR24_8_8B,
+		.nh_sz = RTE_FIB_DIR24_8_4B,
 		.num_tbl8 = 1 << 15,
 	},
 };
 
+// Small VRFs use a DIR24_8 table with few tbl8 groups and a small RIB. The
+// tbl24 keeps its 2^24 entries (64MB) since rte_fib has no smaller backend that
+// does not walk the RIB on datapath lookups. Only the ~32MB of tbl8 groups of
+// the default configuration are saved.
+static struct rte_fib_conf reduced_conf = {
+	.type = RTE_FIB_DIR24_8,
+	.default_nh = BLACKHOLE,
+	// RIB nodes include intermediate nodes, leave room for them.
+	.max_routes = 2 * IP4_FIB_REDUCED_MAX_ROUTES,
+	.rib_ext_sz = 0,
+	.dir24_8 = {
+		.nh_sz = RTE_FIB_DIR24_8_4B,
+		.num_tbl8 = IP4_FIB_REDUCED_NUM_TBL8,
+	},
+};
+
+// FIB configuration of each VRF, applied when the table is created.
+static struct rte_fib_conf vrf_confs[IP4_MAX_VRFS];
+// FIB type requested via GR_IP4_FIB_SET, GR_IP4_FIB_AUTO by default.
+static uint8_t vrf_types[IP4_MAX_VRFS];
+// DIR24_8 configuration used when promoting GR_IP4_FIB_AUTO VRFs.
+static struct rte_fib_conf vrf_large_confs[IP4_MAX_VRFS];
+// True while vrf_confs is derived from reduced_conf.
+static bool vrf_reduced[IP4_MAX_VRFS];
+static uint32_t vrf_n_routes[IP4_MAX_VRFS];
+// Number of routes referencing a next hop of another VRF.
+static uint32_t vrf_n_leaks[IP4_MAX_VRFS];
+
+static struct rte_fib *
+fib_create(uint16_t vrf_id, int socket_id, const struct rte_fib_conf *conf) {
+	// FIB names must be unique. A VRF table may be recreated while the
+	// previous one is still in use by datapath workers.
+	static unsigned generation;
+	struct rte_fib *fib;
+	char name[64];
+
+	snprintf(name, sizeof(name), "ip_vrf_%u_%u", vrf_id, generation++);
+	fib = rte_fib_create(name, socket_id, conf);
+	if (fib == NULL)
+		return errno_set_null(rte_errno);
+
+	return fib;
+}
+
+// Create one table per replica. On error, no table is left allocated.
+static int fibs_create(uint16_t vrf_id, const struct rte_fib_conf *conf, struct rte_fib **fibs) {
+	for (unsigned i = 0; i < n_replicas; i++) {
+		fibs[i] = fib_create(vrf_id, replica_sockets[i], conf);
+		if (fibs[i] == NULL) {
+			int ret = errno;
+			while (i-- > 0)
+				rte_fib_free(fibs[i]);
+			return errno_set(ret);
+		}
+	}
+	return 0;
+}
+
+// Token of the grace period started by the last route deletion. rte_fib has no
+// RCU integration, tbl8 groups released by a deletion may be reused by the next
+// insertion. The first insertion that follows a deletion waits until no
+// datapath worker can still be walking them.
+static uint64_t fib_del_token;
+static bool fib_del_pending;
+
+// Add a route to all replicas of a VRF table.
+static int fibs_add(uint16_t vrf_id, uint32_t ip, uint8_t prefixlen, uintptr_t nh_id) {
+	int ret = 0;
+
+	if (fib_del_pending) {
+		gr_rcu_wait(fib_del_token);
+		fib_del_pending = false;
+	}
+
+	for (unsigned i = 0; i < n_replicas; i++) {
+		ret = rte_fib_add(fib_replicas[i][vrf_id], ip, prefixlen, nh_id);
+		if (ret < 0) {
+			while (i-- > 0)
+				rte_fib_delete(fib_replicas[i][vrf_id], ip, prefixlen);
+			break;
+		}
+	}
+	gr_trace_fib4_add(vrf_id, ip, prefixlen, nh_id, ret);
+	if (ret < 0)
+		return errno_set(-ret);
+
+	return 0;
+}
+
+// Delete a route from all replicas of a VRF table.
+static int fibs_delete(uint16_t vrf_id, uint32_t ip, uint8_t prefixlen) {
+	int ret = 0;
+
+	for (unsigned i = 0; i < n_replicas; i++) {
+		int r = rte_fib_delete(fib_replicas[i][vrf_id], ip, prefixlen);
+		if (r < 0 && ret == 0)
+			ret = r;
+	}
+	gr_trace_fib4_del(vrf_id, ip, prefixlen, ret);
+	fib_del_token = gr_rcu_start();
+	fib_del_pending = true;
+	if (ret < 0)
+		return errno_set(-ret);
+
+	return 0;
+}
+
 static struct rte_fib *get_fib(uint16_t vrf_id) {
 	struct rte_fib *fib;
 
@@ -51,6 +175,25 @@ static struct rte_fib *get_fib(uint16_t vrf_id) {
 	return fib;
 }
 
+// Get the VRF table replica local to the calling thread.
+static inline struct rte_fib *get_fib_local(uint16_t vrf_id) {
+	struct rte_fib **fibs = vrf_fibs;
+	unsigned socket_id = rte_socket_id();
+	struct rte_fib *fib;
+
+	if (vrf_id >= IP4_MAX_VRFS)
+		return errno_set_null(EOVERFLOW);
+
+	if (socket_id < RTE_MAX_NUMA_NODES)
+		fibs = fib_replicas[socket_replicas[socket_id]];
+
+	fib = fibs[vrf_id];
+	if (fib == NULL)
+		return errno_set_null(ENONET);
+
+	return fib;
+}
+
 static struct rte_fib *get_or_create_fib(uint16_t vrf_id) {
 	struct rte_fib *fib;
 
@@ -59,45 +202,125 @@ static struct rte_fib *get_or_create_fib(uint16_t vrf_id) {
 
 	fib = vrf_fibs[vrf_id];
 	if (fib == NULL) {
-		char name[64];
+		struct rte_fib *fibs[RTE_MAX_NUMA_NODES];
 
-		snprintf(name, sizeof(name), "ip_vrf_%u", vrf_id);
-		fib = rte_fib_create(name, SOCKET_ID_ANY, &fib_conf);
-		if (fib == NULL)
-			return errno_set_null(rte_errno);
-
-		vrf_fibs[vrf_id] = fib;
+		if (fibs_create(vrf_id, &vrf_confs[vrf_id], fibs) < 0)
+			return NULL;
+		for (unsigned i = 0; i < n_replicas; i++)
+			fib_replicas[i][vrf_id] = fibs[i];
+		fib = fibs[0];
 	}
 
 	return fib;
 }
 
-static inline uintptr_t nh_ptr_to_id(struct nexthop *nh) {
-	uintptr_t id = (uintptr_t)nh;
+// Copy all routes to another FIB. Next hop reference counts are not modified.
+static int fib_copy(struct rte_fib *src, struct rte_fib *dst) {
+	struct rte_rib *rib = rte_fib_get_rib(src);
+	struct rte_rib_node *rn = NULL;
+	uint8_t prefixlen;
+	uintptr_t nh_id;
+	uint32_t ip;
+	int ret;
 
-	// rte_fib stores the nexthop ID on 8 bytes minus one bit which is used
-	// to store metadata about the routing table.
-	//
-	// Address mappings in userspace are guaranteed on x86_64 and aarch64
-	// to use at most 47 bits, leaving at least 17 bits of headroom filled
-	// with zeroes.
-	//
-	// rte_fib_add already checks that the nexthop value does not exceed the
-	// maximum allowed value. For clarity, we explicitly fail if the MSB is
-	// not zero.
-	if (id & GR_BIT64(63))
-		ABORT("MSB is not 0, martian architecture?");
+	while ((rn = rte_rib_get_nxt(rib, 0, 0, rn, RTE_RIB_GET_NXT_ALL)) != NULL) {
+		rte_rib_get_ip(rn, &ip);
+		rte_rib_get_depth(rn, &prefixlen);
+		rte_rib_get_nh(rn, &nh_id);
+		if ((ret = rte_fib_add(dst, ip, prefixlen, nh_id)) < 0)
+			return errno_set(-ret);
+	}
+	// FIXME: remove this when rte_rib_get_nxt returns a default route, if any is configured
+	if ((rn = rte_rib_lookup_exact(rib, 0, 0)) != NULL) {
+		rte_rib_get_nh(rn, &nh_id);
+		if ((ret = rte_fib_add(dst, 0, 0, nh_id)) < 0)
+			return errno_set(-ret);
+	}
 
-	return id;
+	return 0;
+}
+
+// Replace the FIB of a VRF with a new one, preserving all routes.
+static int fib_replace(uint16_t vrf_id, const struct rte_fib_conf *conf) {
+	struct rte_fib *fibs[RTE_MAX_NUMA_NODES], *old[RTE_MAX_NUMA_NODES];
+	unsigned i;
+
+	if (fibs_create(vrf_id, conf, fibs) < 0)
+		return -errno;
+
+	// Route changes are only made by this thread, the old table cannot be
+	// modified while the routes are copied.
+	for (i = 0; i < n_replicas; i++) {
+		old[i] = fib_replicas[i][vrf_id];
+		if (old[0] != NULL && fib_copy(old[0], fibs[i]) < 0) {
+			int ret = errno;
+			for (i = 0; i < n_replicas; i++)
+				rte_fib_free(fibs[i]);
+			return errno_set(ret);
+		}
+	}
+	for (i = 0; i < n_replicas; i++)
+		fib_replicas[i][vrf_id] = fibs[i];
+	vrf_confs[vrf_id] = *conf;
+	if (old[0] != NULL) {
+		// Wait for datapath workers to stop using the previous tables.
+		gr_rcu_synchronize();
+		for (i = 0; i < n_replicas; i++)
+			rte_fib_free(old[i]);
+	}
+
+	return 0;
+}
+
+// Replace the reduced table of a GR_IP4_FIB_AUTO VRF with its large configuration.
+static int fib_promote(uint16_t vrf_id) {
+	if (vrf_types[vrf_id] != GR_IP4_FIB_AUTO || !vrf_reduced[vrf_id])
+		return errno_set(ENOSPC);
+	if (fib_replace(vrf_id, &vrf_large_confs[vrf_id]) < 0) {
+		int ret = errno;
+		LOG(WARNING, "vrf %u: promote to DIR24_8: %s", vrf_id, strerror(ret));
+		return errno_set(ret);
+	}
+	vrf_reduced[vrf_id] = false;
+	LOG(INFO, "vrf %u: promoted to DIR24_8", vrf_id);
+	return 0;
+}
+
+static inline uintptr_t nh_ptr_to_id(struct nexthop *nh) {
+	// The ID of a next hop never changes. Publish it before the FIBs
+	// reference it.
+	for (unsigned i = 0; i < n_replicas; i++)
+		__atomic_store_n(&nh_replicas[i][nh->id], nh, __ATOMIC_RELEASE);
+	return nh->id;
 }
 
 static inline struct nexthop *nh_id_to_ptr(uintptr_t id) {
-	return (struct nexthop *)id;
+	return nh_replicas[0][id];
+}
+
+// Get the next hop table replica local to the calling thread.
+static inline struct nexthop **nh_table_local(void) {
+	unsigned socket_id = rte_socket_id();
+
+	if (socket_id < RTE_MAX_NUMA_NODES)
+		return nh_replicas[socket_replicas[socket_id]];
+
+	return nh_replicas[0];
+}
+
+uint32_t ip4_route_gen = 1;
+
+void ip4_route_gen_bump(void) {
+	uint32_t gen = ip4_route_gen + 1;
+	if (gen == 0)
+		gen = 1;
+	__atomic_store_n(&ip4_route_gen, gen, __ATOMIC_RELEASE);
+	ip4_offload_route_changed();
 }
 
 struct nexthop *ip4_route_lookup(uint16_t vrf_id, ip4_addr_t ip) {
 	uint32_t host_order_ip = rte_be_to_cpu_32(ip);
-	struct rte_fib *fib = get_fib(vrf_id);
+	struct rte_fib *fib = get_fib_local(vrf_id);
 	uintptr_t nh_id;
 
 	if (fib == NULL)
@@ -107,7 +330,45 @@ struct nexthop *ip4_route_lookup(uint16_t vrf_id, ip4_addr_t ip) {
 	if (nh_id == BLACKHOLE)
 		return errno_set_null(EHOSTUNREACH);
 
-	return nh_id_to_ptr(nh_id);
+	return nh_table_local()[nh_id];
+}
+
+// Max number of addresses resolved per rte_fib_lookup_bulk call.
+#define LOOKUP_BULK_SIZE 64
+
+void ip4_route_lookup_bulk(
+	uint16_t vrf_id,
+	unsigned n,
+	const ip4_addr_t *ips,
+	struct nexthop **nhs
+) {
+	uint32_t host_order_ips[LOOKUP_BULK_SIZE];
+	uintptr_t nh_ids[LOOKUP_BULK_SIZE];
+	struct rte_fib *fib = get_fib_local(vrf_id);
+	struct nexthop **nh_table = nh_table_local();
+	unsigned i, j, count;
+
+	if (fib == NULL) {
+		for (i = 0; i < n; i++)
+			nhs[i] = NULL;
+		return;
+	}
+
+	for (i = 0; i < n; i += count) {
+		count = RTE_MIN(n - i, (unsigned)LOOKUP_BULK_SIZE);
+
+		for (j = 0; j < count; j++)
+			host_order_ips[j] = rte_be_to_cpu_32(ips[i + j]);
+
+		rte_fib_lookup_bulk(fib, host_order_ips, nh_ids, count);
+
+		for (j = 0; j < count; j++) {
+			if (nh_ids[j] == BLACKHOLE)
+				nhs[i + j] = NULL;
+			else
+				nhs[i + j] = nh_table[nh_ids[j]];
+		}
+	}
 }
 
 struct nexthop *ip4_route_lookup_exact(uint16_t vrf_id, ip4_addr_t ip, uint8_t prefixlen) {
@@ -129,6 +390,27 @@ struct nexthop *ip4_route_lookup_exact(uint16_t vrf_id, ip4_addr_t ip, uint8_t p
 	return nh_id_to_ptr(nh_id);
 }
 
+// ECMP routes are reported with one event per group member, like in route4_list.
+static void route_event_push(
+	uint32_t ev_type,
+	uint16_t vrf_id,
+	ip4_addr_t ip,
+	uint8_t prefixlen,
+	const struct nexthop *nh
+) {
+	struct gr_ip4_route_event ev = {.vrf_id = vrf_id, .route.dest = {ip, prefixlen}};
+
+	if (!(nh->flags & GR_IP4_NH_F_GROUP)) {
+		ev.route.nh = nh->ip;
+		gr_event_push(ev_type, NULL, &ev, sizeof(ev));
+		return;
+	}
+	for (unsigned i = 0; i < nh->group->n_members; i++) {
+		ev.route.nh = ((const struct nexthop *)nh->group->members[i])->ip;
+		gr_event_push(ev_type, NULL, &ev, sizeof(ev));
+	}
+}
+
 int ip4_route_insert(uint16_t vrf_id, ip4_addr_t ip, uint8_t prefixlen, struct nexthop *nh) {
 	struct rte_fib *fib = get_or_create_fib(vrf_id);
 	uint32_t host_order_ip = rte_be_to_cpu_32(ip);
@@ -144,8 +426,28 @@ int ip4_route_insert(uint16_t vrf_id, ip4_addr_t ip, uint8_t prefixlen, struct n
 		ret = -EEXIST;
 		goto fail;
 	}
-	if ((ret = rte_fib_add(fib, host_order_ip, prefixlen, nh_ptr_to_id(nh))) < 0)
+	ret = fibs_add(vrf_id, host_order_ip, prefixlen, nh_ptr_to_id(nh));
+	// reduced tables may run out of tbl8 groups before reaching the threshold
+	if (ret == -ENOSPC && fib_promote(vrf_id) == 0)
+		ret = fibs_add(vrf_id, host_order_ip, prefixlen, nh_ptr_to_id(nh));
+	if (ret < 0)
 		goto fail;
+	ip4_route_gen_bump();
+	route_event_push(GR_IP4_EVENT_ROUTE_ADD, vrf_id, ip, prefixlen, nh);
+
+	vrf_n_routes[vrf_id]++;
+	if (nh->vrf_id != vrf_id) {
+		if (nh->leak_count++ == 0) {
+			rte_spinlock_lock(&nh->lock);
+			nh->flags |= GR_IP4_NH_F_LEAKED;
+			rte_spinlock_unlock(&nh->lock);
+		}
+		vrf_n_leaks[vrf_id]++;
+	}
+	// The route was added, failing to promote the VRF table only means
+	// higher memory usage than necessary for the tbl8 groups.
+	if (vrf_n_routes[vrf_id] >= IP4_FIB_REDUCED_MAX_ROUTES)
+		fib_promote(vrf_id);
 
 	return 0;
 fail:
@@ -153,64 +455,194 @@ fail:
 	return errno_set(-ret);
 }
 
-int ip4_route_delete(uint16_t vrf_id, ip4_addr_t ip, uint8_t prefixlen) {
+// Remove a route from the FIB without releasing its next hop.
+static struct nexthop *route_remove(uint16_t vrf_id, ip4_addr_t ip, uint8_t prefixlen) {
 	uint32_t host_order_ip = rte_be_to_cpu_32(ip);
 	struct rte_fib *fib = get_fib(vrf_id);
 	struct nexthop *nh;
-	int ret;
 
 	if (fib == NULL)
-		return -errno;
+		return NULL;
 
 	nh = ip4_route_lookup_exact(vrf_id, ip, prefixlen);
 	if (nh == NULL)
-		return errno_set(ENOENT);
+		return errno_set_null(ENOENT);
 
-	if ((ret = rte_fib_delete(fib, host_order_ip, prefixlen)) < 0)
-		return errno_set(-ret);
+	if (fibs_delete(vrf_id, host_order_ip, prefixlen) < 0)
+		return NULL;
+	ip4_route_gen_bump();
+	route_event_push(GR_IP4_EVENT_ROUTE_DEL, vrf_id, ip, prefixlen, nh);
+
+	vrf_n_routes[vrf_id]--;
+	if (nh->vrf_id != vrf_id) {
+		if (--nh->leak_count == 0) {
+			rte_spinlock_lock(&nh->lock);
+			nh->flags &= ~GR_IP4_NH_F_LEAKED;
+			rte_spinlock_unlock(&nh->lock);
+		}
+		vrf_n_leaks[vrf_id]--;
+	}
+
+	return nh;
+}
 
+int ip4_route_delete(uint16_t vrf_id, ip4_addr_t ip, uint8_t prefixlen) {
+	struct nexthop *nh;
+
+	if ((nh = route_remove(vrf_id, ip, prefixlen)) == NULL)
+		return -errno;
+
+	// The next hop is only freed after a grace period, see fib_del_token
+	// for the FIB memory itself.
 	ip4_nexthop_decref(nh);
 
 	return 0;
 }
 
-static struct api_out route4_add(const void *request, void ** /*response*/) {
-	const struct gr_ip4_route_add_req *req = request;
-	uint32_t host_order_ip;
-	struct rte_fib *fib;
-	struct nexthop *nh;
-	int ret;
+void ip4_route_delete_bulk(
+	uint16_t vrf_id,
+	unsigned n,
+	const struct ip4_net *dests,
+	uint32_t *status
+) {
+	for (unsigned i = 0; i < n; i++) {
+		if (ip4_route_delete(vrf_id, dests[i].ip, dests[i].prefixlen) < 0)
+			status[i] = errno;
+		else
+			status[i] = 0;
+	}
+}
+
+// Routes referencing a next hop group do not need to be modified when the
+// group members change. Updating the group reroutes all its prefixes at once.
+static struct api_out route4_add_group(const struct gr_ip4_route_add_req *req) {
+	uint16_t nh_vrf_id = req->leak ? req->nh_vrf_id : req->vrf_id;
+	struct nexthop *nh, *group;
+
+	if ((group = ip4_nexthop_group_get(req->nh_group_id)) == NULL)
+		return api_out(errno, 0);
+	if (group->vrf_id != nh_vrf_id)
+		return api_out(EINVAL, 0);
 
 	nh = ip4_route_lookup_exact(req->vrf_id, req->dest.ip, req->dest.prefixlen);
 	if (nh != NULL) {
-		if (req->nh == nh->ip && req->exist_ok)
+		if (nh == group && req->exist_ok)
 			return api_out(0, 0);
 		return api_out(EEXIST, 0);
 	}
 
-	if (ip4_route_lookup(req->vrf_id, req->nh) == NULL)
-		return api_out(EHOSTUNREACH, 0);
-
-	if ((fib = get_or_create_fib(req->vrf_id)) == NULL)
+	// this also does ip4_nexthop_incref()
+	if (ip4_route_insert(req->vrf_id, req->dest.ip, req->dest.prefixlen, group) < 0)
 		return api_out(errno, 0);
 
-	if ((nh = ip4_nexthop_lookup(req->vrf_id, req->nh)) == NULL)
-		if ((nh = ip4_nexthop_new(req->vrf_id, GR_IFACE_ID_UNDEF, req->nh)) == NULL)
-			return api_out(errno, 0);
+	return api_out(0, 0);
+}
 
-	host_order_ip = ntohl(req->dest.ip);
+// Leaked routes (nh_vrf_id != vrf_id) reference the next hop of the other VRF
+// directly. The datapath only uses the next hop to forward, a single lookup in
+// the input VRF resolves the final adjacency.
+static int route_add(
+	uint16_t vrf_id,
+	const struct ip4_net *dest,
+	uint16_t nh_vrf_id,
+	ip4_addr_t gw,
+	bool exist_ok
+) {
+	struct nexthop *nh;
 
-	if ((ret = rte_fib_add(fib, host_order_ip, req->dest.prefixlen, nh_ptr_to_id(nh))) < 0) {
-		ip4_nexthop_decref(nh);
-		return api_out(-ret, 0);
+	nh = ip4_route_lookup_exact(vrf_id, dest->ip, dest->prefixlen);
+	if (nh != NULL) {
+		if (gw == nh->ip && nh_vrf_id == nh->vrf_id && exist_ok)
+			return 0;
+		return errno_set(EEXIST);
 	}
 
-	ip4_nexthop_incref(nh);
+	if (ip4_route_lookup(nh_vrf_id, gw) == NULL)
+		return errno_set(EHOSTUNREACH);
+
+	if ((nh = ip4_nexthop_lookup(nh_vrf_id, gw)) == NULL)
+		if ((nh = ip4_nexthop_new(nh_vrf_id, GR_IFACE_ID_UNDEF, gw)) == NULL)
+			return -errno;
+
+	// local delivery happens in the input VRF, do not leak local addresses
+	if (nh_vrf_id != vrf_id && nh->flags & GR_IP4_NH_F_LOCAL)
+		return errno_set(EADDRNOTAVAIL);
+
+	// this also does ip4_nexthop_incref()
+	if (ip4_route_insert(vrf_id, dest->ip, dest->prefixlen, nh) < 0)
+		return -errno;
+
 	nh->flags |= GR_IP4_NH_F_GATEWAY;
 
+	return 0;
+}
+
+static struct api_out route4_add(const void *request, void ** /*response*/) {
+	const struct gr_ip4_route_add_req *req = request;
+	uint16_t nh_vrf_id;
+
+	if (req->nh_group_id != 0)
+		return route4_add_group(req);
+
+	nh_vrf_id = req->leak ? req->nh_vrf_id : req->vrf_id;
+	if (route_add(req->vrf_id, &req->dest, nh_vrf_id, req->nh, req->exist_ok) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out route4_add_multipath(const void *request, void ** /*response*/) {
+	const struct gr_ip4_route_add_multipath_req *req = request;
+	uint16_t nh_vrf_id = req->leak ? req->nh_vrf_id : req->vrf_id;
+	struct nexthop *members[GR_IP4_ROUTE_MAX_NHS];
+	struct nexthop *nh;
+	int ret;
+
+	if (req->n_nhs == 0 || req->n_nhs > GR_IP4_ROUTE_MAX_NHS)
+		return api_out(ERANGE, 0);
+
+	nh = ip4_route_lookup_exact(req->vrf_id, req->dest.ip, req->dest.prefixlen);
+	if (nh != NULL
+	    && !(req->exist_ok && nh->flags & GR_IP4_NH_F_GROUP && nh->group->id == 0
+		 && nh->vrf_id == nh_vrf_id))
+		return api_out(EEXIST, 0);
+
+	if (ip4_nexthop_group_members(nh_vrf_id, req->n_nhs, req->nhs, members) < 0)
+		return api_out(errno, 0);
+
+	for (unsigned i = 0; nh_vrf_id != req->vrf_id && i < req->n_nhs; i++) {
+		if (members[i]->flags & GR_IP4_NH_F_LOCAL) {
+			errno = EADDRNOTAVAIL;
+			goto err;
+		}
+	}
+
+	if (nh != NULL) {
+		// Update the existing group in place. Flows hashed to members
+		// that are kept are not affected.
+		if (ip4_nexthop_group_set(nh, req->n_nhs, members) < 0)
+			goto err;
+	} else {
+		if ((nh = ip4_nexthop_group_new(nh_vrf_id, req->n_nhs, members)) == NULL)
+			goto err;
+		// this also does ip4_nexthop_incref()
+		// on error, the group and its unused members are released
+		if (ip4_route_insert(req->vrf_id, req->dest.ip, req->dest.prefixlen, nh) < 0)
+			return api_out(errno, 0);
+	}
+
+	for (unsigned i = 0; i < req->n_nhs; i++)
+		members[i]->flags |= GR_IP4_NH_F_GATEWAY;
+
 	return api_out(0, 0);
+err:
+	ret = errno;
+	ip4_nexthop_group_members_put(req->n_nhs, members);
+	return api_out(ret, 0);
 }
 
+GR_API_FLEX_CHECK(route4_add_multipath_check, gr_ip4_route_add_multipath_req, n_nhs, nhs)
+
 static struct api_out route4_del(const void *request, void ** /*response*/) {
 	const struct gr_ip4_route_del_req *req = request;
 	struct nexthop *nh;
@@ -230,6 +662,154 @@ static struct api_out route4_del(const void *request, void ** /*response*/) {
 	return api_out(0, 0);
 }
 
+static struct api_out route4_add_bulk(const void *request, void **response) {
+	const struct gr_ip4_route_add_bulk_req *req = request;
+	struct gr_api_bulk_resp *resp;
+	size_t len;
+
+	if (req->n_routes == 0
+	    || sizeof(*req) + req->n_routes * sizeof(*req->routes) > GR_API_MAX_MSG_LEN)
+		return api_out(ERANGE, 0);
+
+	len = sizeof(*resp) + req->n_routes * sizeof(*resp->status);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	for (uint16_t i = 0; i < req->n_routes; i++) {
+		const struct gr_ip4_route *r = &req->routes[i];
+		if (route_add(req->vrf_id, &r->dest, req->vrf_id, r->nh, req->exist_ok) < 0)
+			resp->status[i] = errno;
+	}
+	resp->n_status = req->n_routes;
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+GR_API_FLEX_CHECK(route4_add_bulk_check, gr_ip4_route_add_bulk_req, n_routes, routes)
+
+static struct api_out route4_del_bulk(const void *request, void **response) {
+	const struct gr_ip4_route_del_bulk_req *req = request;
+	struct gr_api_bulk_resp *resp = NULL;
+	struct ip4_net *dests = NULL;
+	uint16_t *index = NULL;
+	uint32_t *status = NULL;
+	struct nexthop *nh;
+	unsigned i, n;
+	size_t len;
+
+	if (req->n_dests == 0
+	    || sizeof(*req) + req->n_dests * sizeof(*req->dests) > GR_API_MAX_MSG_LEN)
+		return api_out(ERANGE, 0);
+
+	len = sizeof(*resp) + req->n_dests * sizeof(*resp->status);
+	if ((resp = calloc(1, len)) == NULL)
+		goto fail;
+	if ((dests = calloc(req->n_dests, sizeof(*dests))) == NULL)
+		goto fail;
+	if ((index = calloc(req->n_dests, sizeof(*index))) == NULL)
+		goto fail;
+	if ((status = calloc(req->n_dests, sizeof(*status))) == NULL)
+		goto fail;
+
+	// Same checks as route4_del, then remove all valid routes at once.
+	n = 0;
+	for (i = 0; i < req->n_dests; i++) {
+		const struct ip4_net *d = &req->dests[i];
+		nh = ip4_route_lookup_exact(req->vrf_id, d->ip, d->prefixlen);
+		if (nh == NULL) {
+			resp->status[i] = req->missing_ok ? 0 : ENOENT;
+		} else if (!(nh->flags & GR_IP4_NH_F_GATEWAY)) {
+			resp->status[i] = EBUSY;
+		} else {
+			dests[n] = *d;
+			index[n++] = i;
+		}
+	}
+	ip4_route_delete_bulk(req->vrf_id, n, dests, status);
+	for (i = 0; i < n; i++)
+		resp->status[index[i]] = status[i];
+
+	resp->n_status = req->n_dests;
+	*response = resp;
+
+	free(dests);
+	free(index);
+	free(status);
+	return api_out(0, len);
+fail:
+	free(resp);
+	free(dests);
+	free(index);
+	free(status);
+	return api_out(ENOMEM, 0);
+}
+
+GR_API_FLEX_CHECK(route4_del_bulk_check, gr_ip4_route_del_bulk_req, n_dests, dests)
+
+static void lookup_result(
+	struct gr_ip4_route_lookup_result *r,
+	const struct nexthop *nh,
+	uint32_t status
+) {
+	if (nh == NULL) {
+		r->status = status;
+		return;
+	}
+	// report the first member of ECMP routes
+	if (nh->flags & GR_IP4_NH_F_GROUP) {
+		r->flags = GR_IP4_NH_F_GROUP;
+		nh = nh->group->members[0];
+	}
+	r->nh = nh->ip;
+	r->nh_vrf_id = nh->vrf_id;
+	r->iface_id = nh->iface_id;
+	r->flags |= nh->flags;
+}
+
+static struct api_out route4_lookup_bulk(const void *request, void **response) {
+	const struct gr_ip4_route_lookup_bulk_req *req = request;
+	struct gr_ip4_route_lookup_bulk_resp *resp;
+	struct nexthop *nhs[LOOKUP_BULK_SIZE];
+	ip4_addr_t ips[LOOKUP_BULK_SIZE];
+	unsigned i, j, n;
+	size_t len;
+
+	len = sizeof(*resp) + req->n_lookups * sizeof(*resp->results);
+	if (req->n_lookups == 0 || len > GR_API_MAX_MSG_LEN)
+		return api_out(ERANGE, 0);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	for (i = 0; i < req->n_lookups; i += n) {
+		const struct gr_ip4_route_lookup *l = &req->lookups[i];
+
+		if (req->exact) {
+			nhs[0] = ip4_route_lookup_exact(l->vrf_id, l->dest.ip, l->dest.prefixlen);
+			lookup_result(&resp->results[i], nhs[0], ENOENT);
+			n = 1;
+			continue;
+		}
+
+		// resolve consecutive destinations of the same VRF together
+		for (n = 0; i + n < req->n_lookups && n < LOOKUP_BULK_SIZE; n++) {
+			if (l[n].vrf_id != l->vrf_id)
+				break;
+			ips[n] = l[n].dest.ip;
+		}
+		ip4_route_lookup_bulk(l->vrf_id, n, ips, nhs);
+		for (j = 0; j < n; j++)
+			lookup_result(&resp->results[i + j], nhs[j], ENETUNREACH);
+	}
+
+	resp->n_results = req->n_lookups;
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+GR_API_FLEX_CHECK(route4_lookup_bulk_check, gr_ip4_route_lookup_bulk_req, n_lookups, lookups)
+
 static struct api_out route4_get(const void *request, void **response) {
 	const struct gr_ip4_route_get_req *req = request;
 	struct gr_ip4_route_get_resp *resp = NULL;
@@ -238,6 +818,9 @@ static struct api_out route4_get(const void *request, void **response) {
 	nh = ip4_route_lookup(req->vrf_id, req->dest);
 	if (nh == NULL)
 		return api_out(ENETUNREACH, 0);
+	// report the first member of ECMP routes
+	if (nh->flags & GR_IP4_NH_F_GROUP)
+		nh = nh->group->members[0];
 
 	if ((resp = calloc(1, sizeof(*resp))) == NULL)
 		return api_out(ENOMEM, 0);
@@ -252,48 +835,243 @@ static struct api_out route4_get(const void *request, void **response) {
 	return api_out(0, sizeof(*resp));
 }
 
+static unsigned route_n_nhs(struct rte_rib_node *rn) {
+	const struct nexthop *nh;
+	uintptr_t nh_id;
+
+	rte_rib_get_nh(rn, &nh_id);
+	nh = nh_id_to_ptr(nh_id);
+	if (nh->flags & GR_IP4_NH_F_GROUP)
+		return nh->group->n_members;
+	return 1;
+}
+
+// ECMP routes are reported with one entry per group member.
+static void route_append(struct gr_ip4_route_list_resp *resp, struct rte_rib_node *rn) {
+	const struct nexthop *nh;
+	struct gr_ip4_route *r;
+	uint8_t prefixlen;
+	uintptr_t nh_id;
+	uint32_t ip;
+
+	rte_rib_get_nh(rn, &nh_id);
+	rte_rib_get_ip(rn, &ip);
+	rte_rib_get_depth(rn, &prefixlen);
+	nh = nh_id_to_ptr(nh_id);
+
+	for (unsigned i = 0; i < route_n_nhs(rn); i++) {
+		r = &resp->routes[resp->n_routes++];
+		r->dest.ip = htonl(ip);
+		r->dest.prefixlen = prefixlen;
+		r->nh_vrf_id = nh->vrf_id;
+		if (nh->flags & GR_IP4_NH_F_GROUP)
+			r->nh = ((const struct nexthop *)nh->group->members[i])->ip;
+		else
+			r->nh = nh->ip;
+	}
+}
+
+// Iterate over all RIB nodes, the default route last.
+static struct rte_rib_node *rib_next(struct rte_rib *rib, struct rte_rib_node *rn) {
+	struct rte_rib_node *next;
+	uint8_t depth = 1;
+
+	if (rn != NULL)
+		rte_rib_get_depth(rn, &depth);
+	if (depth == 0)
+		return NULL;
+
+	if ((next = rte_rib_get_nxt(rib, 0, 0, rn, RTE_RIB_GET_NXT_ALL)) != NULL)
+		return next;
+	// FIXME: remove this when rte_rib_get_nxt returns a default route, if any is configured
+	return rte_rib_lookup_exact(rib, 0, 0);
+}
+
+// Find where the previous page of a route listing ended.
+static struct rte_rib_node *
+route_list_resume(struct rte_rib *rib, const struct gr_ip4_route_list_req *req) {
+	struct rte_rib_node *rn;
+
+	if (req->cursor == 0)
+		return NULL;
+
+	// Fast path, the last listed route still exists.
+	rn = rte_rib_lookup_exact(rib, ntohl(req->last.ip), req->last.prefixlen);
+	if (rn != NULL)
+		return rn;
+
+	// The route was deleted in the mean time. Skip as many routes as
+	// were already listed. Entries may be missed or listed twice if the
+	// table is modified between pages.
+	rn = NULL;
+	for (uint32_t i = 0; i < req->cursor; i++) {
+		if ((rn = rib_next(rib, rn)) == NULL)
+			return errno_set_null(ENOENT);
+	}
+
+	return rn;
+}
+
+// Max number of routes in a single list response.
+#define ROUTE_LIST_MAX                                                                             \
+	((GR_API_MAX_MSG_LEN - sizeof(struct gr_ip4_route_list_resp)) / sizeof(struct gr_ip4_route))
+
 static struct api_out route4_list(const void *request, void **response) {
 	const struct gr_ip4_route_list_req *req = request;
 	struct gr_ip4_route_list_resp *resp = NULL;
 	struct rte_fib *fib = get_fib(req->vrf_id);
-	struct rte_rib_node *rn = NULL;
-	struct gr_ip4_route *r;
+	struct rte_rib_node *start, *rn, *next;
+	uint32_t n_nodes, ip;
 	struct rte_rib *rib;
 	size_t num, len;
-	uintptr_t nh_id;
-	uint32_t ip;
 
 	if (fib == NULL)
 		return api_out(errno, 0);
 
 	rib = rte_fib_get_rib(fib);
 
+	start = route_list_resume(rib, req);
+	if (start == NULL && req->cursor != 0) {
+		if ((resp = calloc(1, sizeof(*resp))) == NULL)
+			return api_out(ENOMEM, 0);
+		*response = resp;
+		return api_out(0, sizeof(*resp));
+	}
+
+	// Only complete RIB nodes are listed to avoid splitting ECMP routes.
 	num = 0;
-	while ((rn = rte_rib_get_nxt(rib, 0, 0, rn, RTE_RIB_GET_NXT_ALL)) != NULL)
-		num++;
-	// FIXME: remove this when rte_rib_get_nxt returns a default route, if any is configured
-	if (rte_rib_lookup_exact(rib, 0, 0) != NULL)
-		num++;
+	n_nodes = 0;
+	rn = start;
+	while ((next = rib_next(rib, rn)) != NULL) {
+		if (num + route_n_nhs(next) > ROUTE_LIST_MAX)
+			break;
+		num += route_n_nhs(next);
+		n_nodes++;
+		rn = next;
+	}
 
 	len = sizeof(*resp) + num * sizeof(struct gr_ip4_route);
 	if ((resp = calloc(1, len)) == NULL)
 		return api_out(ENOMEM, 0);
 
-	while ((rn = rte_rib_get_nxt(rib, 0, 0, rn, RTE_RIB_GET_NXT_ALL)) != NULL) {
-		r = &resp->routes[resp->n_routes++];
-		rte_rib_get_nh(rn, &nh_id);
+	rn = start;
+	for (uint32_t i = 0; i < n_nodes; i++) {
+		rn = rib_next(rib, rn);
+		route_append(resp, rn);
+	}
+	if (rn != NULL && rib_next(rib, rn) != NULL) {
+		resp->next_cursor = req->cursor + n_nodes;
 		rte_rib_get_ip(rn, &ip);
-		rte_rib_get_depth(rn, &r->dest.prefixlen);
-		r->dest.ip = htonl(ip);
-		r->nh = nh_id_to_ptr(nh_id)->ip;
+		rte_rib_get_depth(rn, &resp->last.prefixlen);
+		resp->last.ip = htonl(ip);
 	}
-	// FIXME: remove this when rte_rib_get_nxt returns a default route, if any is configured
-	if ((rn = rte_rib_lookup_exact(rib, 0, 0)) != NULL) {
-		r = &resp->routes[resp->n_routes++];
-		rte_rib_get_nh(rn, &nh_id);
-		r->dest.ip = 0;
-		r->dest.prefixlen = 0;
-		r->nh = nh_id_to_ptr(nh_id)->ip;
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+// Approximate size of a RIB node, including the mempool object header.
+#define RIB_NODE_SIZE 64
+
+static void fib_conf_to_api(uint16_t vrf_id, struct gr_ip4_fib_conf *api) {
+	const struct rte_fib_conf *conf = &vrf_confs[vrf_id];
+	uint64_t nh_size = 8;
+
+	api->vrf_id = vrf_id;
+	api->type = vrf_types[vrf_id];
+	api->max_routes = conf->max_routes;
+	api->n_routes = vrf_n_routes[vrf_id];
+	api->mem_size = (uint64_t)conf->max_routes * RIB_NODE_SIZE;
+
+	nh_size = 1 << conf->dir24_8.nh_sz;
+	api->active_type = vrf_reduced[vrf_id] ? GR_IP4_FIB_REDUCED : GR_IP4_FIB_DIR24_8;
+	api->num_tbl8 = conf->dir24_8.num_tbl8;
+	// DIR24_8 has one entry for every /24 prefix and 256 entries per tbl8 group.
+	api->mem_size += (nh_size << 24) + nh_size * 256 * (api->num_tbl8 + 1);
+	api->nh_size = nh_size;
+}
+
+static struct api_out fib4_set(const void *request, void **response) {
+	const struct gr_ip4_fib_set_req *req = request;
+	struct gr_ip4_fib_set_resp *resp = NULL;
+	uint16_t vrf_id = req->conf.vrf_id;
+	struct rte_fib_conf large = fib_conf;
+	struct rte_fib_conf conf;
+	bool reduced = false;
+
+	if (vrf_id >= IP4_MAX_VRFS)
+		return api_out(EOVERFLOW, 0);
+
+	if (req->conf.max_routes != 0)
+		large.max_routes = req->conf.max_routes;
+	if (req->conf.num_tbl8 != 0)
+		large.dir24_8.num_tbl8 = req->conf.num_tbl8;
+	switch (req->conf.nh_size) {
+	case 0:
+		break;
+	case 4:
+		large.dir24_8.nh_sz = RTE_FIB_DIR24_8_4B;
+		break;
+	case 8:
+		large.dir24_8.nh_sz = RTE_FIB_DIR24_8_8B;
+		break;
+	default:
+		// 2 bytes entries cannot hold the IDs of IP4_MAX_NEXT_HOPS next hops.
+		return api_out(ENOTSUP, 0);
+	}
+
+	switch (req->conf.type) {
+	case GR_IP4_FIB_AUTO:
+		reduced = vrf_n_routes[vrf_id] < IP4_FIB_REDUCED_MAX_ROUTES;
+		conf = reduced ? reduced_conf : large;
+		break;
+	case GR_IP4_FIB_DIR24_8:
+		conf = large;
+		break;
+	case GR_IP4_FIB_REDUCED:
+		reduced = true;
+		conf = reduced_conf;
+		if (req->conf.max_routes != 0)
+			conf.max_routes = req->conf.max_routes;
+		break;
+	default:
+		return api_out(EINVAL, 0);
+	}
+
+	if (vrf_fibs[vrf_id] == NULL)
+		vrf_confs[vrf_id] = conf; // created on first route insertion
+	else if (fib_replace(vrf_id, &conf) < 0)
+		return api_out(errno, 0);
+	vrf_types[vrf_id] = req->conf.type;
+	vrf_large_confs[vrf_id] = large;
+	vrf_reduced[vrf_id] = reduced;
+
+	if ((resp = calloc(1, sizeof(*resp))) == NULL)
+		return api_out(ENOMEM, 0);
+	fib_conf_to_api(vrf_id, &resp->conf);
+	*response = resp;
+
+	return api_out(0, sizeof(*resp));
+}
+
+static struct api_out fib4_list(const void * /*request*/, void **response) {
+	struct gr_ip4_fib_list_resp *resp = NULL;
+	uint16_t vrf_id, n;
+	size_t len;
+
+	n = 0;
+	for (vrf_id = 0; vrf_id < IP4_MAX_VRFS; vrf_id++) {
+		if (vrf_fibs[vrf_id] != NULL)
+			n++;
+	}
+
+	len = sizeof(*resp) + n * sizeof(*resp->fibs);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	for (vrf_id = 0; vrf_id < IP4_MAX_VRFS; vrf_id++) {
+		if (vrf_fibs[vrf_id] != NULL)
+			fib_conf_to_api(vrf_id, &resp->fibs[resp->n_fibs++]);
 	}
 	*response = resp;
 
@@ -301,51 +1079,123 @@ static struct api_out route4_list(const void *request, void **response) {
 }
 
 static void route4_init(struct event_base *) {
-	vrf_fibs = rte_calloc(
-		__func__, IP4_MAX_VRFS, sizeof(struct rte_fib *), RTE_CACHE_LINE_SIZE
-	);
-	if (vrf_fibs == NULL)
-		ABORT("rte_calloc(vrf_fibs): %s", rte_strerror(rte_errno));
+	n_replicas = gr_numa_sockets(replica_sockets);
+	for (unsigned i = 0; i < n_replicas; i++) {
+		fib_replicas[i] = rte_calloc_socket(
+			__func__,
+			IP4_MAX_VRFS,
+			sizeof(struct rte_fib *),
+			RTE_CACHE_LINE_SIZE,
+			replica_sockets[i]
+		);
+		if (fib_replicas[i] == NULL)
+			ABORT("rte_calloc(vrf_fibs): %s", rte_strerror(rte_errno));
+		nh_replicas[i] = rte_calloc_socket(
+			__func__,
+			IP4_MAX_NEXT_HOPS,
+			sizeof(struct nexthop *),
+			RTE_CACHE_LINE_SIZE,
+			replica_sockets[i]
+		);
+		if (nh_replicas[i] == NULL)
+			ABORT("rte_calloc(nh_replicas): %s", rte_strerror(rte_errno));
+		if (replica_sockets[i] >= 0)
+			socket_replicas[replica_sockets[i]] = i;
+	}
+	vrf_fibs = fib_replicas[0];
+	if (n_replicas > 1)
+		LOG(INFO, "VRF tables replicated on %u NUMA nodes", n_replicas);
+	for (uint16_t vrf_id = 0; vrf_id < IP4_MAX_VRFS; vrf_id++) {
+		vrf_confs[vrf_id] = reduced_conf;
+		vrf_large_confs[vrf_id] = fib_conf;
+		vrf_reduced[vrf_id] = true;
+	}
 }
 
 static void route4_fini(struct event_base *) {
 	for (uint16_t vrf_id = 0; vrf_id < IP4_MAX_VRFS; vrf_id++) {
-		rte_fib_free(vrf_fibs[vrf_id]);
-		vrf_fibs[vrf_id] = NULL;
+		for (unsigned i = 0; i < n_replicas; i++) {
+			rte_fib_free(fib_replicas[i][vrf_id]);
+			fib_replicas[i][vrf_id] = NULL;
+		}
+		vrf_n_routes[vrf_id] = 0;
+		vrf_n_leaks[vrf_id] = 0;
+	}
+	for (unsigned i = 0; i < n_replicas; i++) {
+		rte_free(fib_replicas[i]);
+		fib_replicas[i] = NULL;
+		rte_free(nh_replicas[i]);
+		nh_replicas[i] = NULL;
 	}
-	rte_free(vrf_fibs);
 	vrf_fibs = NULL;
 }
 
-void ip4_route_cleanup(struct nexthop *nh) {
-	uint8_t prefixlen, local_prefixlen;
+// Remove the members of an ECMP group that belong to the given subnet.
+// Returns false if no member is left.
+static bool group_prune(struct nexthop *nh, ip4_addr_t ip, uint8_t prefixlen) {
+	struct nexthop *members[NH_GROUP_MAX_MEMBERS];
+	unsigned i, n = 0;
+
+	for (i = 0; i < nh->group->n_members; i++) {
+		struct nexthop *member = nh->group->members[i];
+		if (!ip4_addr_same_subnet(member->ip, ip, prefixlen))
+			members[n++] = member;
+	}
+	if (n == 0)
+		return false;
+	if (n < nh->group->n_members && ip4_nexthop_group_set(nh, n, members) < 0)
+		LOG(ERR, "ip4_nexthop_group_set: %s", strerror(errno));
+
+	return true;
+}
+
+// Delete the routes of a VRF which reference next hops of nh_vrf_id in the
+// given subnet.
+static void route_cleanup_vrf(
+	uint16_t vrf_id,
+	uint16_t nh_vrf_id,
+	ip4_addr_t local_ip,
+	uint8_t local_prefixlen
+) {
 	struct rte_rib_node *rn = NULL;
+	struct rte_fib *fib;
 	struct rte_rib *rib;
-	ip4_addr_t local_ip;
+	struct nexthop *nh;
+	uint8_t prefixlen;
 	uintptr_t nh_id;
 	ip4_addr_t ip;
 
-	local_ip = nh->ip;
-	local_prefixlen = nh->prefixlen;
+	if ((fib = get_fib(vrf_id)) == NULL)
+		return;
 
-	rib = rte_fib_get_rib(get_fib(nh->vrf_id));
+	rib = rte_fib_get_rib(fib);
 	while ((rn = rte_rib_get_nxt(rib, 0, 0, rn, RTE_RIB_GET_NXT_ALL)) != NULL) {
 		rte_rib_get_nh(rn, &nh_id);
 		nh = nh_id_to_ptr(nh_id);
 
-		if (nh && ip4_addr_same_subnet(nh->ip, local_ip, local_prefixlen)) {
+		if (nh == NULL || nh->vrf_id != nh_vrf_id)
+			continue;
+
+		if (nh->flags & GR_IP4_NH_F_GROUP) {
+			if (group_prune(nh, local_ip, local_prefixlen))
+				continue;
+			rte_rib_get_ip(rn, &ip);
+			rte_rib_get_depth(rn, &prefixlen);
+			ip4_route_delete(vrf_id, rte_cpu_to_be_32(ip), prefixlen);
+		} else if (ip4_addr_same_subnet(nh->ip, local_ip, local_prefixlen)) {
 			rte_rib_get_ip(rn, &ip);
 			rte_rib_get_depth(rn, &prefixlen);
 			ip = rte_cpu_to_be_32(ip);
 
 			LOG(DEBUG,
-			    "delete " IP4_ADDR_FMT "/%d via " IP4_ADDR_FMT,
+			    "vrf %u: delete " IP4_ADDR_FMT "/%d via " IP4_ADDR_FMT,
+			    vrf_id,
 			    IP4_ADDR_SPLIT(&ip),
 			    prefixlen,
 			    IP4_ADDR_SPLIT(&nh->ip));
 
-			ip4_route_delete(nh->vrf_id, ip, prefixlen);
-			ip4_route_delete(nh->vrf_id, ip, 32);
+			ip4_route_delete(vrf_id, ip, prefixlen);
+			ip4_route_delete(vrf_id, ip, 32);
 		}
 	}
 
@@ -353,44 +1203,124 @@ void ip4_route_cleanup(struct nexthop *nh) {
 		rte_rib_get_nh(rn, &nh_id);
 		nh = nh_id_to_ptr(nh_id);
 
-		if (nh && ip4_addr_same_subnet(nh->ip, local_ip, local_prefixlen)) {
-			rte_rib_get_ip(rn, &ip);
-			rte_rib_get_depth(rn, &prefixlen);
-			ip = rte_cpu_to_be_32(ip);
+		if (nh == NULL || nh->vrf_id != nh_vrf_id)
+			return;
 
+		if (nh->flags & GR_IP4_NH_F_GROUP) {
+			if (!group_prune(nh, local_ip, local_prefixlen))
+				ip4_route_delete(vrf_id, 0, 0);
+		} else if (ip4_addr_same_subnet(nh->ip, local_ip, local_prefixlen)) {
 			LOG(DEBUG,
-			    "delete " IP4_ADDR_FMT "/%d via " IP4_ADDR_FMT,
-			    IP4_ADDR_SPLIT(&ip),
-			    prefixlen,
+			    "vrf %u: delete 0.0.0.0/0 via " IP4_ADDR_FMT,
+			    vrf_id,
 			    IP4_ADDR_SPLIT(&nh->ip));
 
-			ip4_route_delete(nh->vrf_id, nh->ip, nh->prefixlen);
-			ip4_route_delete(nh->vrf_id, nh->ip, 32);
+			ip4_route_delete(vrf_id, 0, 0);
+			ip4_route_delete(vrf_id, nh->ip, 32);
 		}
 	}
+}
 
-	ip4_route_delete(nh->vrf_id, local_ip, 32);
+void ip4_route_cleanup(struct nexthop *nh) {
+	uint16_t nh_vrf_id = nh->vrf_id;
+	uint8_t local_prefixlen = nh->prefixlen;
+	ip4_addr_t local_ip = nh->ip;
+
+	route_cleanup_vrf(nh_vrf_id, nh_vrf_id, local_ip, local_prefixlen);
+
+	// routes leaked from this VRF into other ones
+	for (uint16_t vrf_id = 0; vrf_id < IP4_MAX_VRFS; vrf_id++) {
+		if (vrf_id != nh_vrf_id && vrf_n_leaks[vrf_id] != 0)
+			route_cleanup_vrf(vrf_id, nh_vrf_id, local_ip, local_prefixlen);
+	}
+
+	ip4_route_delete(nh_vrf_id, local_ip, 32);
 }
 
 static struct gr_api_handler route4_add_handler = {
 	.name = "ipv4 route add",
 	.request_type = GR_IP4_ROUTE_ADD,
 	.callback = route4_add,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler route4_add_multipath_handler = {
+	.name = "ipv4 route add multipath",
+	.request_type = GR_IP4_ROUTE_ADD_MULTIPATH,
+	.callback = route4_add_multipath,
+	.check = route4_add_multipath_check,
+	.flags = GR_API_F_CONFIG,
 };
 static struct gr_api_handler route4_del_handler = {
 	.name = "ipv4 route del",
 	.request_type = GR_IP4_ROUTE_DEL,
 	.callback = route4_del,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler route4_lookup_bulk_handler = {
+	.name = "ipv4 route lookup bulk",
+	.request_type = GR_IP4_ROUTE_LOOKUP_BULK,
+	.callback = route4_lookup_bulk,
+	.check = route4_lookup_bulk_check,
+	.flags = GR_API_F_READ,
 };
+
 static struct gr_api_handler route4_get_handler = {
 	.name = "ipv4 route get",
 	.request_type = GR_IP4_ROUTE_GET,
 	.callback = route4_get,
+	.flags = GR_API_F_READ,
 };
 static struct gr_api_handler route4_list_handler = {
 	.name = "ipv4 route list",
 	.request_type = GR_IP4_ROUTE_LIST,
 	.callback = route4_list,
+	.flags = GR_API_F_READ,
+};
+
+static struct gr_api_handler route4_add_bulk_handler = {
+	.name = "ipv4 route add bulk",
+	.request_type = GR_IP4_ROUTE_ADD_BULK,
+	.callback = route4_add_bulk,
+	.check = route4_add_bulk_check,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler route4_del_bulk_handler = {
+	.name = "ipv4 route del bulk",
+	.request_type = GR_IP4_ROUTE_DEL_BULK,
+	.callback = route4_del_bulk,
+	.check = route4_del_bulk_check,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler fib4_set_handler = {
+	.name = "ipv4 fib set",
+	.request_type = GR_IP4_FIB_SET,
+	.callback = fib4_set,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler fib4_list_handler = {
+	.name = "ipv4 fib list",
+	.request_type = GR_IP4_FIB_LIST,
+	.callback = fib4_list,
+	.flags = GR_API_F_READ,
+};
+
+static void fib4_usage(uint64_t bytes[RTE_MAX_NUMA_NODES]) {
+	struct gr_ip4_fib_conf conf;
+
+	for (uint16_t vrf_id = 0; vrf_id < IP4_MAX_VRFS; vrf_id++) {
+		if (vrf_fibs[vrf_id] == NULL)
+			continue;
+		fib_conf_to_api(vrf_id, &conf);
+		for (unsigned i = 0; i < n_replicas; i++)
+			gr_mem_account(bytes, fib_replicas[i][vrf_id], conf.mem_size);
+	}
+	for (unsigned i = 0; i < n_replicas; i++)
+		gr_mem_account(bytes, nh_replicas[i], IP4_MAX_NEXT_HOPS * sizeof(struct nexthop *));
+}
+
+static struct gr_mem_reporter fib4_reporter = {
+	.name = "ipv4 fib",
+	.usage = fib4_usage,
 };
 
 static struct gr_module route4_module = {
@@ -402,8 +1332,15 @@ static struct gr_module route4_module = {
 
 RTE_INIT(control_ip_init) {
 	gr_register_api_handler(&route4_add_handler);
+	gr_register_api_handler(&route4_add_multipath_handler);
 	gr_register_api_handler(&route4_del_handler);
 	gr_register_api_handler(&route4_get_handler);
+	gr_register_api_handler(&route4_lookup_bulk_handler);
 	gr_register_api_handler(&route4_list_handler);
+	gr_register_api_handler(&route4_add_bulk_handler);
+	gr_register_api_handler(&route4_del_bulk_handler);
+	gr_register_api_handler(&fib4_set_handler);
+	gr_register_api_handler(&fib4_list_handler);
 	gr_register_module(&route4_module);
+	gr_mem_reporter_register(&fib4_reporter);
 }
@@ -3,10 +3,12 @@
 
 #include <gr_eth_input.h>
 #include <gr_graph.h>
+#include <gr_hold_queue.h>
 #include <gr_ip4_control.h>
 #include <gr_ip4_datapath.h>
 #include <gr_log.h>
 #include <gr_mbuf.h>
+#include <gr_tracepoint.h>
 
 #include <rte_arp.h>
 #include <rte_byteorder.h>
@@ -24,116 +26,206 @@ enum {
 	EDGE_COUNT,
 };
 
+#define NH_STATE_FLAGS                                                                             \
+	(GR_IP4_NH_F_REACHABLE | GR_IP4_NH_F_STALE | GR_IP4_NH_F_PENDING | GR_IP4_NH_F_FAILED)
+
 static inline void update_nexthop(
 	struct rte_graph *graph,
 	struct rte_node *node,
 	struct nexthop *nh,
 	uint64_t now,
-	uint16_t iface_id,
+	const struct iface *iface,
 	const struct rte_arp_hdr *arp
 ) {
 	struct ip_output_mbuf_data *o;
 	struct rte_mbuf *m, *next;
+	uint16_t old_flags;
 
 	// Static next hops never need updating.
 	if (nh->flags & GR_IP4_NH_F_STATIC)
 		return;
 
+	// Nothing changed, which is the common case with gratuitous ARP storms.
+	// Only refresh the timestamp, without the lock and without invalidating
+	// the L2 header that all workers use to forward through this next hop.
+	if ((nh->flags & NH_STATE_FLAGS) == GR_IP4_NH_F_REACHABLE && nh->iface == iface
+	    && rte_is_same_ether_addr(&nh->lladdr, &arp->arp_data.arp_sha)) {
+		nh->neigh.last_reply = now;
+		return;
+	}
+
 	rte_spinlock_lock(&nh->lock);
 
 	// Refresh all fields.
-	nh->last_reply = now;
-	nh->iface_id = iface_id;
+	old_flags = nh->flags;
+	nh->neigh.last_reply = now;
+	nh->iface_id = iface->id;
+	nh->iface = iface;
 	nh->flags |= GR_IP4_NH_F_REACHABLE;
 	nh->flags &= ~(GR_IP4_NH_F_STALE | GR_IP4_NH_F_PENDING | GR_IP4_NH_F_FAILED);
-	nh->ucast_probes = 0;
-	nh->bcast_probes = 0;
+	nh->neigh.ucast_probes = 0;
+	nh->neigh.mcast_probes = 0;
 	nh->lladdr = arp->arp_data.arp_sha;
+	eth_l2_rewrite_invalidate(&nh->l2);
+
+	rte_spinlock_unlock(&nh->lock);
+
+	if (old_flags != nh->flags)
+		gr_trace_nh_state(&nh->neigh, old_flags, nh->flags);
 
 	// Flush all held packets.
-	m = nh->held_pkts_head;
-	while (m != NULL) {
+	for (m = hold_queue_flush(&nh->neigh.held); m != NULL; m = next) {
 		next = queue_mbuf_data(m)->next;
 		o = ip_output_mbuf_data(m);
 		o->nh = nh;
 		o->input_iface = NULL;
 		rte_node_enqueue_x1(graph, node, IP_OUTPUT, m);
-		m = next;
 	}
-	nh->held_pkts_head = NULL;
-	nh->held_pkts_tail = NULL;
-	nh->held_pkts_num = 0;
+}
+
+static inline rte_edge_t arp_check(const struct rte_arp_hdr *arp) {
+	if (rte_be_to_cpu_16(arp->arp_hardware) != RTE_ARP_HRD_ETHER)
+		return PROTO_UNSUPP;
+	if (rte_be_to_cpu_16(arp->arp_protocol) != RTE_ETHER_TYPE_IPV4)
+		return PROTO_UNSUPP;
+	switch (rte_be_to_cpu_16(arp->arp_opcode)) {
+	case RTE_ARP_OP_REQUEST:
+		return OP_REQUEST;
+	case RTE_ARP_OP_REPLY:
+		return OP_REPLY;
+	}
+	return OP_UNSUPP;
+}
 
-	rte_spinlock_unlock(&nh->lock);
+// Same as ip4_addr_get_preferred() with the addresses of the input interface
+// already resolved.
+static inline struct nexthop *arp_local_addr(const struct hoplist *addrs, ip4_addr_t ip) {
+	if (addrs == NULL || addrs->count == 0)
+		return NULL;
+
+	for (unsigned i = 0; i < addrs->count; i++) {
+		struct nexthop *nh = addrs->nh[i];
+		if (ip4_addr_same_subnet(ip, nh->ip, nh->prefixlen))
+			return nh;
+	}
+
+	return addrs->nh[0];
+}
+
+// Resolve the sender addresses of all valid packets. Packets are grouped by
+// VRF, each group is resolved with a single FIB lookup. Most bursts only
+// contain one VRF and the outer loop runs exactly once.
+static void arp_lookup(
+	struct rte_mbuf **mbufs,
+	const rte_edge_t *edges,
+	struct nexthop **remotes,
+	uint16_t count
+) {
+	ip4_addr_t sips[RTE_GRAPH_BURST_SIZE];
+	struct nexthop *res[RTE_GRAPH_BURST_SIZE];
+	uint16_t idx[RTE_GRAPH_BURST_SIZE];
+	bool done[RTE_GRAPH_BURST_SIZE] = {false};
+	const struct rte_arp_hdr *arp;
+	uint16_t i, j, n, vrf_id;
+
+	for (i = 0; i < count; i++) {
+		if (done[i] || (edges[i] != OP_REQUEST && edges[i] != OP_REPLY))
+			continue;
+
+		vrf_id = eth_input_mbuf_data(mbufs[i])->iface->vrf_id;
+		n = 0;
+		for (j = i; j < count; j++) {
+			if (done[j] || (edges[j] != OP_REQUEST && edges[j] != OP_REPLY))
+				continue;
+			if (eth_input_mbuf_data(mbufs[j])->iface->vrf_id != vrf_id)
+				continue;
+			arp = rte_pktmbuf_mtod(mbufs[j], const struct rte_arp_hdr *);
+			sips[n] = arp->arp_data.arp_sip;
+			idx[n] = j;
+			done[j] = true;
+			n++;
+		}
+
+		ip4_route_lookup_bulk(vrf_id, n, sips, res);
+
+		for (j = 0; j < n; j++)
+			remotes[idx[j]] = res[j];
+	}
 }
 
 static uint16_t
 arp_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct nexthop *remotes[RTE_GRAPH_BURST_SIZE];
+	const struct iface *iface, *addrs_iface;
+	rte_edge_t edges[RTE_GRAPH_BURST_SIZE];
 	struct nexthop *remote, *local;
 	struct arp_mbuf_data *arp_data;
-	const struct iface *iface;
+	const struct hoplist *addrs;
+	struct rte_mbuf **mbufs;
 	struct rte_arp_hdr *arp;
 	struct rte_mbuf *mbuf;
+	uint16_t i, n, count;
 	rte_edge_t edge;
 	ip4_addr_t sip;
 	uint64_t now;
 
 	now = rte_get_tsc_cycles();
+	addrs_iface = NULL;
+	addrs = NULL;
 
-	for (uint16_t i = 0; i < nb_objs; i++) {
-		mbuf = objs[i];
+	for (n = 0; n < nb_objs; n += count) {
+		count = RTE_MIN(nb_objs - n, RTE_GRAPH_BURST_SIZE);
+		mbufs = (struct rte_mbuf **)&objs[n];
 
 		// ARP protocol sanity checks.
-		arp = rte_pktmbuf_mtod(mbuf, struct rte_arp_hdr *);
-		if (rte_be_to_cpu_16(arp->arp_hardware) != RTE_ARP_HRD_ETHER) {
-			edge = PROTO_UNSUPP;
-			goto next;
-		}
-		if (rte_be_to_cpu_16(arp->arp_protocol) != RTE_ETHER_TYPE_IPV4) {
-			edge = PROTO_UNSUPP;
-			goto next;
-		}
-		switch (rte_be_to_cpu_16(arp->arp_opcode)) {
-		case RTE_ARP_OP_REQUEST:
-			edge = OP_REQUEST;
-			break;
-		case RTE_ARP_OP_REPLY:
-			edge = OP_REPLY;
-			break;
-		default:
-			edge = OP_UNSUPP;
-			goto next;
+		for (i = 0; i < count; i++) {
+			gr_mbuf_prefetch_ahead((void **)mbufs, i, count);
+			arp = rte_pktmbuf_mtod(mbufs[i], struct rte_arp_hdr *);
+			edges[i] = arp_check(arp);
 		}
 
-		sip = arp->arp_data.arp_sip;
-		iface = eth_input_mbuf_data(mbuf)->iface;
-		local = ip4_addr_get_preferred(iface->id, sip);
-		remote = ip4_route_lookup(iface->vrf_id, sip);
-
-		if (remote != NULL && remote->ip == sip) {
-			update_nexthop(graph, node, remote, now, iface->id, arp);
-		} else if (local != NULL && local->ip == arp->arp_data.arp_tip) {
-			// Request/reply to our address but no next hop entry exists.
-			// Create a new next hop and its associated /32 route to allow
-			// faster lookups for next packets.
-			if ((remote = ip4_nexthop_new(iface->vrf_id, iface->id, sip)) == NULL) {
-				edge = ERROR;
+		arp_lookup(mbufs, edges, remotes, count);
+
+		for (i = 0; i < count; i++) {
+			mbuf = mbufs[i];
+			edge = edges[i];
+			if (edge != OP_REQUEST && edge != OP_REPLY)
 				goto next;
+
+			arp = rte_pktmbuf_mtod(mbuf, struct rte_arp_hdr *);
+			sip = arp->arp_data.arp_sip;
+			iface = eth_input_mbuf_data(mbuf)->iface;
+			// Bursts usually come from a single interface.
+			if (iface != addrs_iface) {
+				addrs = ip4_addr_get_all(iface->id);
+				addrs_iface = iface;
 			}
-			if (ip4_route_insert(iface->vrf_id, sip, 32, remote) < 0) {
-				edge = ERROR;
+			local = arp_local_addr(addrs, sip);
+			remote = remotes[i];
+
+			if (remote != NULL && remote->ip == sip) {
+				update_nexthop(graph, node, remote, now, iface, arp);
+			} else if (local != NULL && local->ip == arp->arp_data.arp_tip) {
+				// Request/reply to our address but no next hop entry
+				// exists. Ask the control plane to create a new next hop
+				// and its associated /32 route to allow faster lookups
+				// for next packets. ARP replies are crafted from the
+				// request sender fields, there is no need to wait for the
+				// next hop to exist.
+				ip4_nexthop_learn(
+					iface->vrf_id, iface->id, sip, arp->arp_data.arp_sha
+				);
+				remote = NULL;
+			} else {
+				edge = DROP;
 				goto next;
 			}
-			update_nexthop(graph, node, remote, now, iface->id, arp);
-		} else {
-			edge = DROP;
-			goto next;
-		}
-		arp_data = arp_mbuf_data(mbuf);
-		arp_data->local = local;
-		arp_data->remote = remote;
+			arp_data = arp_mbuf_data(mbuf);
+			arp_data->local = local;
+			arp_data->remote = remote;
 next:
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
+			rte_node_enqueue_x1(graph, node, edge, mbuf);
+		}
 	}
 
 	return nb_objs;
@@ -39,7 +39,7 @@ static uint16_t arp_output_reply_process(
 	for (uint16_t i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
 		arp_data = arp_mbuf_data(mbuf);
-		if (arp_data->local == NULL || arp_data->remote == NULL) {
+		if (arp_data->local == NULL) {
 			// mbuf is not an ARP request
 			edge = ERROR;
 			goto next;
@@ -55,12 +55,14 @@ static uint16_t arp_output_reply_process(
 		arp->arp_hardware = RTE_BE16(RTE_ARP_HRD_ETHER);
 		arp->arp_protocol = RTE_BE16(RTE_ETHER_TYPE_IPV4);
 		arp->arp_opcode = RTE_BE16(RTE_ARP_OP_REPLY);
-		arp->arp_data.arp_tha = arp_data->remote->lladdr;
+		// The remote next hop may not exist yet if it is being learned by the
+		// control plane. Reply to the request sender fields.
+		arp->arp_data.arp_tha = arp->arp_data.arp_sha;
 		if (iface_get_eth_addr(iface->id, &arp->arp_data.arp_sha) < 0) {
 			edge = ERROR;
 			goto next;
 		}
-		arp->arp_data.arp_tip = arp_data->remote->ip;
+		arp->arp_data.arp_tip = arp->arp_data.arp_sip;
 		arp->arp_data.arp_sip = arp_data->local->ip;
 
 		// Prepare ethernet layer info.
@@ -68,6 +70,7 @@ static uint16_t arp_output_reply_process(
 		eth_data->dst = arp->arp_data.arp_tha;
 		eth_data->ether_type = RTE_BE16(RTE_ETHER_TYPE_ARP);
 		eth_data->iface = iface;
+		eth_data->l2 = NULL;
 		edge = OUTPUT;
 		num++;
 next:
@@ -9,6 +9,7 @@
 #include <gr_ip4_control.h>
 #include <gr_ip4_datapath.h>
 #include <gr_log.h>
+#include <gr_token_bucket.h>
 
 #include <rte_arp.h>
 #include <rte_byteorder.h>
@@ -17,20 +18,33 @@
 #include <rte_ether.h>
 #include <rte_graph_worker.h>
 #include <rte_ip.h>
+#include <rte_malloc.h>
 #include <rte_mbuf.h>
 
 enum {
 	OUTPUT = 0,
 	ERROR,
+	RATE_LIMITED,
 	EDGE_COUNT,
 };
 
 static control_input_t arp_solicit;
 
 int arp_output_request_solicit(struct nexthop *nh) {
+	int ret;
+
 	if (nh == NULL)
 		return errno_set(EINVAL);
-	return post_to_stack(arp_solicit, nh);
+
+	// coalesce with a solicitation that was not processed yet
+	if (__atomic_exchange_n(&nh->solicit_queued, true, __ATOMIC_ACQ_REL))
+		return 0;
+
+	ret = post_to_stack(arp_solicit, nh);
+	if (ret < 0)
+		__atomic_store_n(&nh->solicit_queued, false, __ATOMIC_RELEASE);
+
+	return ret;
 }
 
 static uint16_t arp_output_request_process(
@@ -39,6 +53,7 @@ static uint16_t arp_output_request_process(
 	void **objs,
 	uint16_t n_objs
 ) {
+	struct token_bucket *buckets = node->ctx_ptr;
 	struct eth_output_mbuf_data *eth_data;
 	struct nexthop *local, *nh;
 	struct rte_arp_hdr *arp;
@@ -53,6 +68,18 @@ static uint16_t arp_output_request_process(
 	for (unsigned i = 0; i < n_objs; i++) {
 		mbuf = objs[i];
 		nh = (struct nexthop *)control_input_mbuf_data(mbuf)->data;
+		__atomic_store_n(&nh->solicit_queued, false, __ATOMIC_RELEASE);
+
+		// The control plane will send another solicitation on the next
+		// aging iteration since last_request is not updated.
+		token_bucket_refill(
+			&buckets[nh->iface_id], IP4_NH_SOLICIT_RATE, IP4_NH_SOLICIT_BURST, now
+		);
+		if (!token_bucket_take(&buckets[nh->iface_id])) {
+			edge = RATE_LIMITED;
+			goto next;
+		}
+
 		local = ip4_addr_get_preferred(nh->iface_id, nh->ip);
 		if (local == NULL) {
 			edge = ERROR;
@@ -75,7 +102,7 @@ static uint16_t arp_output_request_process(
 			goto next;
 		}
 		arp->arp_data.arp_sip = local->ip;
-		if (nh->last_reply != 0)
+		if (nh->neigh.last_reply != 0)
 			arp->arp_data.arp_tha = nh->lladdr;
 		else
 			memset(&arp->arp_data.arp_tha, 0xff, sizeof(arp->arp_data.arp_tha));
@@ -83,16 +110,17 @@ static uint16_t arp_output_request_process(
 
 		// Prepare ethernet layer info.
 		eth_data = eth_output_mbuf_data(mbuf);
-		if (nh->ucast_probes < IP4_NH_UCAST_PROBES) {
+		if (nh->neigh.ucast_probes < NH_NEIGH_UCAST_PROBES) {
 			eth_data->dst = arp->arp_data.arp_tha;
-			nh->ucast_probes++;
+			nh->neigh.ucast_probes++;
 		} else {
 			memset(&eth_data->dst, 0xff, sizeof(eth_data->dst));
-			nh->bcast_probes++;
+			nh->neigh.mcast_probes++;
 		}
-		nh->last_request = now;
+		nh->neigh.last_request = now;
 		eth_data->ether_type = RTE_BE16(RTE_ETHER_TYPE_ARP);
-		eth_data->iface = iface_from_id(nh->iface_id);
+		eth_data->iface = nh->iface;
+		eth_data->l2 = NULL;
 
 		edge = OUTPUT;
 		sent++;
@@ -103,6 +131,20 @@ next:
 	return sent;
 }
 
+static int arp_output_request_init(const struct rte_graph *graph, struct rte_node *node) {
+	node->ctx_ptr = rte_zmalloc_socket(
+		__func__, MAX_IFACES * sizeof(struct token_bucket), 0, graph->socket
+	);
+	if (node->ctx_ptr == NULL)
+		return errno_log(ENOMEM, "rte_zmalloc_socket");
+	return 0;
+}
+
+static void arp_output_request_fini(const struct rte_graph *, struct rte_node *node) {
+	rte_free(node->ctx_ptr);
+	node->ctx_ptr = NULL;
+}
+
 static void arp_output_request_register(void) {
 	arp_solicit = gr_control_input_register_handler("arp_output_request");
 }
@@ -110,10 +152,13 @@ static void arp_output_request_register(void) {
 static struct rte_node_register arp_output_request_node = {
 	.name = "arp_output_request",
 	.process = arp_output_request_process,
+	.init = arp_output_request_init,
+	.fini = arp_output_request_fini,
 	.nb_edges = EDGE_COUNT,
 	.next_nodes = {
 		[OUTPUT] = "eth_output",
 		[ERROR] = "arp_output_error",
+		[RATE_LIMITED] = "arp_output_request_rate_limited",
 	},
 };
 
@@ -125,3 +170,4 @@ static struct gr_node_info arp_output_request_info = {
 GR_NODE_REGISTER(arp_output_request_info);
 
 GR_DROP_REGISTER(arp_output_error);
+GR_DROP_REGISTER(arp_output_request_rate_limited);
@@ -4,6 +4,7 @@
 #ifndef _GR_IP4_DATAPATH_H
 #define _GR_IP4_DATAPATH_H
 
+#include <gr_feature.h>
 #include <gr_iface.h>
 #include <gr_ip4_control.h>
 #include <gr_mbuf.h>
@@ -12,8 +13,11 @@
 #include <rte_byteorder.h>
 #include <rte_graph_worker.h>
 #include <rte_ip.h>
+#include <rte_jhash.h>
+#include <rte_mbuf.h>
 
 #include <stdint.h>
+#include <string.h>
 
 GR_MBUF_PRIV_DATA_TYPE(ip_output_mbuf_data, {
 	const struct iface *input_iface;
@@ -25,7 +29,8 @@ GR_MBUF_PRIV_DATA_TYPE(arp_mbuf_data, {
 	struct nexthop *remote;
 });
 
-GR_MBUF_PRIV_DATA_TYPE(ip_local_mbuf_data, {
+// The input interface and next hop are preserved for local and tunneled packets.
+GR_MBUF_PRIV_DATA_EXTENDS(ip_local_mbuf_data, ip_output_mbuf_data, {
 	ip4_addr_t src;
 	ip4_addr_t dst;
 	uint16_t len;
@@ -34,13 +39,47 @@ GR_MBUF_PRIV_DATA_TYPE(ip_local_mbuf_data, {
 });
 
 void ip_input_local_add_proto(uint8_t proto, const char *next_node);
+// Deliver local UDP datagrams destined to dst_port (network order) to next_node.
+// ip_local_mbuf_data.len is the UDP payload length.
+void udp_input_register_port(rte_be16_t dst_port, const char *next_node);
 void ip_output_add_tunnel(uint16_t iface_type_id, const char *next_node);
+// Forward multicast packets to non link-local groups to next_node instead of
+// delivering them locally.
+void ip_input_mcast_register(const char *next_node);
+// Select the FIB of the route lookup of received packets (policy based
+// routing). vrfs[i] is initialized with the VRF of the input interface of
+// mbufs[i]. While set, ip_input invokes the callback once per burst with all
+// packets that need a route lookup. NULL to disable.
+typedef void (*ip_input_pbr_cb_t)(struct rte_mbuf **mbufs, uint16_t *vrfs, uint16_t count);
+void ip_input_pbr_set(ip_input_pbr_cb_t);
+// Optional features of the packets received on an interface, e.g. the ingress
+// ACL. Packets enter the arc once their route is resolved, instead of going to
+// ip_forward or ip_input_local. The ip_output_mbuf_data next hop and input
+// interface are set. The last enabled feature sends the packets to ip_forward
+// or ip_input_local itself.
+extern struct gr_feature_arc ip4_input_features;
+// Send forwarded packets to next_node instead of ip_output when the output
+// interface has an egress ACL. The ECMP group member is already selected.
+void ip_forward_acl_register(const char *next_node);
+// Send packets received on NAT outside interfaces to next_node once their
+// route is resolved. Packets without a NAT session are handed over to
+// ip4_input_features, ip_forward, ip_input_local or ip_error_dest_unreach.
+void ip_input_nat_register(const char *next_node);
+// Send forwarded packets to next_node instead of ip_output when the output
+// interface is a NAT outside interface. The ECMP group member is already
+// selected.
+void ip_forward_nat_register(const char *next_node);
 int arp_output_request_solicit(struct nexthop *nh);
+// Re-inject the packets held by a reachable next hop into ip_output.
+int ip_hold_flush(struct nexthop *nh);
 
 #define IPV4_VERSION_IHL 0x45
 #define IPV4_DEFAULT_TTL 64
 
-static inline void ip_set_fields(struct rte_ipv4_hdr *ip, struct ip_local_mbuf_data *data) {
+// Fill a locally generated IPv4 header. The checksum is computed by the egress
+// port if it supports RTE_ETH_TX_OFFLOAD_IPV4_CKSUM, by eth_output otherwise.
+static inline void
+ip_set_fields(struct rte_mbuf *m, struct rte_ipv4_hdr *ip, struct ip_local_mbuf_data *data) {
 	ip->version_ihl = IPV4_VERSION_IHL;
 	ip->type_of_service = 0;
 	ip->total_length = rte_cpu_to_be_16(data->len + rte_ipv4_hdr_len(ip));
@@ -51,10 +90,56 @@ static inline void ip_set_fields(struct rte_ipv4_hdr *ip, struct ip_local_mbuf_d
 	ip->src_addr = data->src;
 	ip->dst_addr = data->dst;
 	ip->hdr_checksum = 0;
-	ip->hdr_checksum = rte_ipv4_cksum(ip);
+	m->l3_len = rte_ipv4_hdr_len(ip);
+	m->ol_flags |= RTE_MBUF_F_TX_IPV4 | RTE_MBUF_F_TX_IP_CKSUM;
+}
+
+// Compute the checksum of a header filled by ip_set_fields() in software.
+// Must be called before encapsulating the packet since the offload flags only
+// apply to the outermost header.
+static inline void ip_cksum_resolve(struct rte_mbuf *m, struct rte_ipv4_hdr *ip) {
+	if (m->ol_flags & RTE_MBUF_F_TX_IP_CKSUM) {
+		ip->hdr_checksum = rte_ipv4_cksum(ip);
+		m->ol_flags &= ~(RTE_MBUF_F_TX_IPV4 | RTE_MBUF_F_TX_IP_CKSUM);
+	}
+}
+
+// Multicast group outside of the local network control block (224.0.0.0/24).
+static inline bool ip_mcast_routable(ip4_addr_t dst) {
+	uint32_t addr = rte_be_to_cpu_32(dst);
+	return RTE_IS_IPV4_MCAST(addr) && (addr & 0xffffff00) != RTE_IPV4(224, 0, 0, 0);
+}
+
+// Flow hash used to select ECMP next hops. Use the RSS hash computed by the NIC
+// when available. Otherwise, hash the addresses, protocol and L4 ports. L4
+// ports are not included for fragmented packets.
+static inline uint32_t ip4_flow_hash(const struct rte_mbuf *m, const struct rte_ipv4_hdr *ip) {
+	const rte_be16_t frag = RTE_BE16(RTE_IPV4_HDR_MF_FLAG | RTE_IPV4_HDR_OFFSET_MASK);
+	uint16_t len = rte_ipv4_hdr_len(ip);
+	uint32_t ports = 0;
+
+	if (m->ol_flags & RTE_MBUF_F_RX_RSS_HASH)
+		return m->hash.rss;
+
+	switch (ip->next_proto_id) {
+	case IPPROTO_TCP:
+	case IPPROTO_UDP:
+	case IPPROTO_SCTP:
+		// Only the first fragment has L4 ports. They are ignored for all
+		// fragments, including the first one (MF set, offset zero), so that
+		// every fragment of a datagram selects the same next hop.
+		if (ip->fragment_offset & frag)
+			break;
+		if (rte_pktmbuf_data_len(m) >= len + sizeof(ports))
+			memcpy(&ports, (const uint8_t *)ip + len, sizeof(ports));
+		break;
+	}
+
+	return rte_jhash_3words(ip->src_addr, ip->dst_addr, ports, ip->next_proto_id);
 }
 
 #define GR_IP_ICMP_DEST_UNREACHABLE 3
 #define GR_IP_ICMP_TTL_EXCEEDED 11
+#define GR_IP_ICMP_CODE_FRAG_NEEDED 4
 
 #endif
@@ -15,28 +15,66 @@
 #include <rte_ip.h>
 
 enum {
-	OUTPUT = 0,
+	IP_OUTPUT = 0,
 	INVALID,
 	UNSUPPORTED,
+	NO_HEADROOM,
+	NO_ROUTE,
 	EDGE_COUNT,
 };
 
 #define ICMP_MIN_SIZE 8
 
+// Turn an echo request into its reply in place. The ICMP checksum is updated
+// for the type change only, the payload is not summed again. The reply
+// bypasses icmp_output and goes straight to ip_output.
+static inline rte_edge_t
+icmp_echo_reply(struct rte_mbuf *mbuf, struct rte_icmp_hdr *icmp, struct ip_local_mbuf_data *d) {
+	rte_be16_t old = *(rte_be16_t *)icmp; // type and code
+	struct ip_output_mbuf_data *o;
+	struct rte_ipv4_hdr *ip;
+	struct nexthop *nh;
+	ip4_addr_t tmp;
+
+	icmp->icmp_type = RTE_IP_ICMP_ECHO_REPLY;
+	icmp->icmp_cksum = gr_cksum_update16(icmp->icmp_cksum, old, *(rte_be16_t *)icmp);
+
+	tmp = d->dst;
+	d->dst = d->src;
+	d->src = tmp;
+
+	// the original IP header is still in the headroom
+	ip = (struct rte_ipv4_hdr *)rte_pktmbuf_prepend(mbuf, sizeof(*ip));
+	if (unlikely(ip == NULL))
+		return NO_HEADROOM;
+	ip_set_fields(mbuf, ip, d);
+
+	if ((nh = ip4_route_lookup(d->vrf_id, d->dst)) == NULL)
+		return NO_ROUTE;
+	o = ip_output_mbuf_data(mbuf);
+	o->nh = nh;
+	o->input_iface = NULL;
+
+	return IP_OUTPUT;
+}
+
 static uint16_t
 icmp_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
 	struct ip_local_mbuf_data *ip_data;
 	struct rte_icmp_hdr *icmp;
 	struct rte_mbuf *mbuf;
+	uint16_t cksum;
 	rte_edge_t edge;
-	ip4_addr_t ip;
 
 	for (uint16_t i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
 		icmp = rte_pktmbuf_mtod(mbuf, struct rte_icmp_hdr *);
 		ip_data = ip_local_mbuf_data(mbuf);
 
-		if (ip_data->len < ICMP_MIN_SIZE || (uint16_t)~rte_raw_cksum(icmp, ip_data->len)) {
+		// the payload may be split across multiple segments
+		if (ip_data->len < ICMP_MIN_SIZE
+		    || rte_raw_cksum_mbuf(mbuf, 0, ip_data->len, &cksum) < 0
+		    || (uint16_t)~cksum) {
 			edge = INVALID;
 			goto next;
 		}
@@ -46,16 +84,11 @@ icmp_input_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 				edge = INVALID;
 				goto next;
 			}
-			icmp->icmp_type = RTE_IP_ICMP_ECHO_REPLY;
-			ip = ip_data->dst;
-			ip_data->dst = ip_data->src;
-			ip_data->src = ip;
+			edge = icmp_echo_reply(mbuf, icmp, ip_data);
 			break;
 		default:
 			edge = UNSUPPORTED;
-			goto next;
 		}
-		edge = OUTPUT;
 next:
 		rte_node_enqueue_x1(graph, node, edge, mbuf);
 	}
@@ -74,9 +107,11 @@ static struct rte_node_register icmp_input_node = {
 
 	.nb_edges = EDGE_COUNT,
 	.next_nodes = {
-		[OUTPUT] = "icmp_output",
+		[IP_OUTPUT] = "ip_output",
 		[INVALID] = "icmp_input_invalid",
 		[UNSUPPORTED] = "icmp_input_unsupported",
+		[NO_HEADROOM] = "error_no_headroom",
+		[NO_ROUTE] = "icmp_output_no_route",
 	},
 };
 
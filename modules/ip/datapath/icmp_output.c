@@ -29,6 +29,7 @@ icmp_output_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 	struct rte_ipv4_hdr *ip;
 	struct rte_mbuf *mbuf;
 	struct nexthop *nh;
+	uint16_t cksum;
 	rte_edge_t edge;
 
 	for (uint16_t i = 0; i < nb_objs; i++) {
@@ -37,14 +38,17 @@ icmp_output_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 
 		icmp = rte_pktmbuf_mtod(mbuf, struct rte_icmp_hdr *);
 		icmp->icmp_cksum = 0;
-		icmp->icmp_cksum = ~rte_raw_cksum(icmp, local_data->len);
+		// the payload may be split across multiple segments
+		if (rte_raw_cksum_mbuf(mbuf, 0, local_data->len, &cksum) < 0)
+			cksum = 0;
+		icmp->icmp_cksum = ~cksum;
 
 		ip = (struct rte_ipv4_hdr *)rte_pktmbuf_prepend(mbuf, sizeof(*ip));
 		if (unlikely(ip == NULL)) {
 			edge = NO_HEADROOM;
 			goto next;
 		}
-		ip_set_fields(ip, local_data);
+		ip_set_fields(mbuf, ip, local_data);
 		if ((nh = ip4_route_lookup(local_data->vrf_id, local_data->dst)) == NULL) {
 			// Do not let packets go to ip_output from icmp_output
 			// with no available route to avoid loops of destination
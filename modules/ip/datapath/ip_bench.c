@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_eth_input.h>
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_macro.h>
+#include <gr_node_bench.h>
+#include <gr_port.h>
+#include <gr_sample.h>
+
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+#include <rte_mbuf_ptype.h>
+
+#include <netinet/in.h>
+#include <string.h>
+
+#define IP_LEN 46
+#define SRC_ADDR RTE_BE32(RTE_IPV4(192, 0, 2, 1))
+#define DST_ADDR RTE_BE32(RTE_IPV4(198, 51, 100, 1))
+#define UNREACH_ADDR RTE_BE32(RTE_IPV4(203, 0, 113, 1))
+
+static struct iface *port;
+static struct iface *port_vrf1;
+static struct nexthop nh;
+
+// mocked types/functions
+uint32_t ip4_route_gen = 1;
+uint32_t ip4_offload_threshold;
+void ip4_offload_candidate(uint16_t, uint16_t, ip4_addr_t) { }
+struct sample_worker sample_workers[RTE_MAX_LCORE];
+void gr_eth_input_add_type(rte_be16_t, const char *) { }
+uint8_t gr_feature_arc_entry(struct gr_feature_arc *, const char *) {
+	return 0;
+}
+int ip4_nexthop_learn_held(const struct nexthop *) {
+	return 0;
+}
+int arp_output_request_solicit(struct nexthop *) {
+	return 0;
+}
+int ip_hold_flush(struct nexthop *) {
+	return 0;
+}
+void ip4_route_lookup_bulk(uint16_t, unsigned n, const ip4_addr_t *ips, struct nexthop **nhs) {
+	for (unsigned i = 0; i < n; i++)
+		nhs[i] = ips[i] == UNREACH_ADDR ? NULL : &nh;
+}
+
+static struct rte_ipv4_hdr *ip_packet(struct rte_mbuf *m, ip4_addr_t dst) {
+	struct rte_ipv4_hdr *ip = (struct rte_ipv4_hdr *)rte_pktmbuf_append(m, IP_LEN);
+
+	memset(ip, 0, IP_LEN);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->total_length = RTE_BE16(IP_LEN);
+	ip->time_to_live = 64;
+	ip->next_proto_id = IPPROTO_UDP;
+	ip->src_addr = SRC_ADDR;
+	ip->dst_addr = dst;
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+
+	return ip;
+}
+
+static void ip_input_prepare(struct rte_mbuf *m, const struct iface *iface, ip4_addr_t dst) {
+	struct eth_input_mbuf_data *e = eth_input_mbuf_data(m);
+
+	ip_packet(m, dst);
+	e->iface = iface;
+	e->eth_dst = ETH_DST_LOCAL;
+}
+
+static void ip_input_forward(struct rte_mbuf *m, uint16_t) {
+	ip_input_prepare(m, port, DST_ADDR);
+}
+
+static void ip_input_cksum_offload(struct rte_mbuf *m, uint16_t i) {
+	ip_input_forward(m, i);
+	m->ol_flags |= RTE_MBUF_F_RX_IP_CKSUM_GOOD;
+	m->packet_type = RTE_PTYPE_L2_ETHER | RTE_PTYPE_L3_IPV4;
+}
+
+// Alternate between two VRFs to measure the cost of grouping lookups.
+static void ip_input_vrfs(struct rte_mbuf *m, uint16_t i) {
+	ip_input_prepare(m, i % 2 ? port_vrf1 : port, DST_ADDR);
+}
+
+static void ip_input_no_route(struct rte_mbuf *m, uint16_t) {
+	ip_input_prepare(m, port, UNREACH_ADDR);
+}
+
+static void ip_output_prepare(struct rte_mbuf *m, uint16_t) {
+	struct ip_output_mbuf_data *d = ip_output_mbuf_data(m);
+
+	ip_packet(m, DST_ADDR);
+	d->input_iface = port;
+	d->nh = &nh;
+}
+
+static const struct node_bench benches[] = {
+	{"ip_input/forward", "ip_input", 0, ip_input_forward, "ip_forward"},
+	{"ip_input/forward/burst1", "ip_input", 1, ip_input_forward, "ip_forward"},
+	{"ip_input/cksum_offload", "ip_input", 0, ip_input_cksum_offload, "ip_forward"},
+	{"ip_input/two_vrfs", "ip_input", 0, ip_input_vrfs, "ip_forward"},
+	{"ip_input/no_route", "ip_input", 0, ip_input_no_route, "ip_error_dest_unreach"},
+	{"ip_forward", "ip_forward", 0, ip_output_prepare, "ip_output"},
+	{"ip_output/reachable", "ip_output", 0, ip_output_prepare, "eth_output"},
+};
+
+int main(void) {
+	port = node_bench_iface_add(GR_IFACE_TYPE_PORT, 0, sizeof(struct iface_info_port));
+	port_vrf1 = node_bench_iface_add(GR_IFACE_TYPE_PORT, 1, sizeof(struct iface_info_port));
+	nh.flags = GR_IP4_NH_F_REACHABLE | GR_IP4_NH_F_GATEWAY;
+	nh.iface_id = port->id;
+	nh.iface = port;
+	nh.ip = RTE_BE32(RTE_IPV4(192, 0, 2, 254));
+	nh.lladdr = (struct rte_ether_addr) {{0x02, 0x00, 0x00, 0x00, 0x00, 0x02}};
+
+	node_bench_init();
+
+	return node_bench_run(benches, ARRAY_DIM(benches));
+}
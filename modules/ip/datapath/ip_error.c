@@ -7,8 +7,10 @@
 #include <gr_ip4_datapath.h>
 #include <gr_log.h>
 #include <gr_mbuf.h>
+#include <gr_token_bucket.h>
 
 #include <rte_common.h>
+#include <rte_cycles.h>
 #include <rte_graph_worker.h>
 #include <rte_icmp.h>
 #include <rte_ip.h>
@@ -17,9 +19,35 @@ enum edges {
 	ICMP_OUTPUT = 0,
 	NO_HEADROOM,
 	NO_IP,
+	RATE_LIMITED,
 	EDGE_COUNT,
 };
 
+// Stored in the node context area. One instance per worker.
+struct ip_error_ctx {
+	struct token_bucket bucket;
+	uint8_t icmp_type;
+	uint8_t icmp_code;
+};
+
+static_assert(sizeof(struct ip_error_ctx) <= RTE_NODE_CTX_SZ);
+
+// Refill the bucket once per burst. Returns false if errors are not limited.
+static inline bool ip_error_limit_refill(struct ip_error_ctx *ctx) {
+	const struct gr_ip4_icmp_limit *l = ip4_icmp_limit_get(ctx->icmp_type);
+	uint32_t rate, burst;
+
+	if (l == NULL)
+		return false;
+	rate = __atomic_load_n(&l->rate, __ATOMIC_RELAXED);
+	if (rate == 0)
+		return false;
+	burst = __atomic_load_n(&l->burst, __ATOMIC_RELAXED);
+	token_bucket_refill(&ctx->bucket, rate, burst, rte_rdtsc());
+
+	return true;
+}
+
 static uint16_t
 ip_error_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
 	struct ip_local_mbuf_data *ip_data;
@@ -28,14 +56,26 @@ ip_error_process(struct rte_graph *graph, struct rte_node *node, void **objs, ui
 	struct rte_ipv4_hdr *ip;
 	struct rte_mbuf *mbuf;
 	struct nexthop *nh;
-	uint8_t icmp_type;
+	uint8_t icmp_type, icmp_code;
+	struct ip_error_ctx *ctx;
 	rte_edge_t edge;
+	uint16_t mtu;
+	bool limited;
 
-	icmp_type = node->ctx[0];
+	ctx = (struct ip_error_ctx *)node->ctx;
+	icmp_type = ctx->icmp_type;
+	icmp_code = ctx->icmp_code;
+	limited = ip_error_limit_refill(ctx);
 
 	for (uint16_t i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
 
+		// Drop excess errors before touching the packet.
+		if (limited && !token_bucket_take(&ctx->bucket)) {
+			edge = RATE_LIMITED;
+			goto next;
+		}
+
 		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
 		icmp = (struct rte_icmp_hdr *)rte_pktmbuf_prepend(mbuf, sizeof(*icmp));
 		if (unlikely(icmp == NULL)) {
@@ -43,6 +83,15 @@ ip_error_process(struct rte_graph *graph, struct rte_node *node, void **objs, ui
 			goto next;
 		}
 
+		// RFC1191: advertise the MTU of the next hop network. The output
+		// next hop must be read before the private area is overwritten.
+		mtu = 0;
+		if (icmp_code == GR_IP_ICMP_CODE_FRAG_NEEDED) {
+			nh = ip_output_mbuf_data(mbuf)->nh;
+			if ((iface = nh->iface) != NULL)
+				mtu = iface->mtu;
+		}
+
 		// Get the local router IP address from the input iface
 		iface = ip_output_mbuf_data(mbuf)->input_iface;
 		if (iface == NULL) {
@@ -64,10 +113,10 @@ ip_error_process(struct rte_graph *graph, struct rte_node *node, void **objs, ui
 		ip_data->proto = IPPROTO_ICMP;
 
 		icmp->icmp_type = icmp_type;
-		icmp->icmp_code = 0; // time to live exceeded in transit
+		icmp->icmp_code = icmp_code;
 		icmp->icmp_cksum = 0;
 		icmp->icmp_ident = 0;
-		icmp->icmp_seq_nb = 0;
+		icmp->icmp_seq_nb = rte_cpu_to_be_16(mtu);
 
 		edge = ICMP_OUTPUT;
 next:
@@ -78,12 +127,21 @@ next:
 }
 
 static int ttl_exceeded_init(const struct rte_graph *, struct rte_node *node) {
-	node->ctx[0] = GR_IP_ICMP_TTL_EXCEEDED;
+	struct ip_error_ctx *ctx = (struct ip_error_ctx *)node->ctx;
+	ctx->icmp_type = GR_IP_ICMP_TTL_EXCEEDED;
 	return 0;
 }
 
 static int no_route_init(const struct rte_graph *, struct rte_node *node) {
-	node->ctx[0] = GR_IP_ICMP_DEST_UNREACHABLE;
+	struct ip_error_ctx *ctx = (struct ip_error_ctx *)node->ctx;
+	ctx->icmp_type = GR_IP_ICMP_DEST_UNREACHABLE;
+	return 0;
+}
+
+static int frag_needed_init(const struct rte_graph *, struct rte_node *node) {
+	struct ip_error_ctx *ctx = (struct ip_error_ctx *)node->ctx;
+	ctx->icmp_type = GR_IP_ICMP_DEST_UNREACHABLE;
+	ctx->icmp_code = GR_IP_ICMP_CODE_FRAG_NEEDED;
 	return 0;
 }
 
@@ -95,6 +153,7 @@ static struct rte_node_register ip_forward_ttl_exceeded_node = {
 		[ICMP_OUTPUT] = "icmp_output",
 		[NO_HEADROOM] = "error_no_headroom",
 		[NO_IP] = "error_no_local_ip",
+		[RATE_LIMITED] = "ip_error_rate_limited",
 	},
 	.init = ttl_exceeded_init,
 };
@@ -107,10 +166,24 @@ static struct rte_node_register no_route_node = {
 		[ICMP_OUTPUT] = "icmp_output",
 		[NO_HEADROOM] = "error_no_headroom",
 		[NO_IP] = "error_no_local_ip",
+		[RATE_LIMITED] = "ip_error_rate_limited",
 	},
 	.init = no_route_init,
 };
 
+static struct rte_node_register frag_needed_node = {
+	.name = "ip_error_frag_needed",
+	.process = ip_error_process,
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[ICMP_OUTPUT] = "icmp_output",
+		[NO_HEADROOM] = "error_no_headroom",
+		[NO_IP] = "error_no_local_ip",
+		[RATE_LIMITED] = "ip_error_rate_limited",
+	},
+	.init = frag_needed_init,
+};
+
 static struct gr_node_info info_ttl_exceeded = {
 	.node = &ip_forward_ttl_exceeded_node,
 };
@@ -119,7 +192,13 @@ static struct gr_node_info info_no_route = {
 	.node = &no_route_node,
 };
 
+static struct gr_node_info info_frag_needed = {
+	.node = &frag_needed_node,
+};
+
 GR_NODE_REGISTER(info_ttl_exceeded);
 GR_NODE_REGISTER(info_no_route);
+GR_NODE_REGISTER(info_frag_needed);
 
 GR_DROP_REGISTER(error_no_local_ip);
+GR_DROP_REGISTER(ip_error_rate_limited);
@@ -1,12 +1,21 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // Copyright (c) 2024 Robin Jarry
 
+#include <gr_datapath.h>
 #include <gr_graph.h>
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
 
 #include <rte_fib.h>
 #include <rte_graph_worker.h>
 #include <rte_ip.h>
 #include <rte_mbuf.h>
+#include <rte_vect.h>
+
+#include <stddef.h>
+#include <string.h>
 
 enum edges {
 	OUTPUT = 0,
@@ -14,28 +23,157 @@ enum edges {
 	EDGE_COUNT,
 };
 
-static uint16_t
-ip_forward_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+// Packets sent to interfaces with an egress ACL, see ip_forward_acl_register().
+static rte_edge_t acl_edge = RTE_EDGE_ID_INVALID;
+
+void ip_forward_acl_register(const char *next_node) {
+	LOG(DEBUG, "ip_forward: acl -> %s", next_node);
+	if (acl_edge != RTE_EDGE_ID_INVALID)
+		ABORT("next node already registered for acl");
+	acl_edge = gr_node_attach_parent("ip_forward", next_node);
+}
+
+// Packets sent to NAT outside interfaces, see ip_forward_nat_register().
+static rte_edge_t nat_edge = RTE_EDGE_ID_INVALID;
+
+void ip_forward_nat_register(const char *next_node) {
+	LOG(DEBUG, "ip_forward: nat -> %s", next_node);
+	if (nat_edge != RTE_EDGE_ID_INVALID)
+		ABORT("next node already registered for nat");
+	nat_edge = gr_node_attach_parent("ip_forward", next_node);
+}
+
+// Select the output interface features that apply to the packet. Source NAT
+// comes first, the egress ACL is then applied to the translated packet.
+static inline rte_edge_t output_edge(struct rte_mbuf *m, const struct rte_ipv4_hdr *ip) {
+	struct ip_output_mbuf_data *d = ip_output_mbuf_data(m);
+	struct nexthop *nh = d->nh;
+	const struct iface *iface;
+
+	if (nh->flags & GR_IP4_NH_F_GROUP) {
+		nh = nh_group_select(nh->group, ip4_flow_hash(m, ip));
+		// not selected again by ip_output
+		d->nh = nh;
+	}
+
+	if ((iface = nh->iface) == NULL)
+		return OUTPUT;
+	if (unlikely(iface->nat44 != NULL))
+		return nat_edge;
+	if (unlikely(iface->acl_out != NULL))
+		return acl_edge;
+	return OUTPUT;
+}
+
+#if (defined(RTE_ARCH_X86) || defined(RTE_ARCH_ARM64)) && RTE_BYTE_ORDER == RTE_LITTLE_ENDIAN
+// Number of headers updated at once by ttl_decrement_x4().
+#define TTL_LANES 4
+#endif
+
+#define TTL_WORD_OFFSET offsetof(struct rte_ipv4_hdr, time_to_live)
+
+#ifdef TTL_LANES
+// Decrement the TTL of four headers at once and update their checksum like the
+// scalar path does. Each 32-bit word holds the time_to_live, next_proto_id and
+// hdr_checksum fields, loaded in host order. The words are left untouched if
+// any TTL is expired.
+static inline bool ttl_decrement_x4(uint32_t *words) {
+#ifdef RTE_ARCH_X86
+	__m128i w = _mm_loadu_si128((const __m128i *)words);
+	__m128i ttl = _mm_and_si128(w, _mm_set1_epi32(0xff));
+	__m128i carry;
+
+	if (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(ttl, _mm_set1_epi32(2)))) != 0)
+		return false;
+
+	// RTE_BE16(0x0100) is added to the checksum field, with an end-around
+	// carry when it reaches 0xffff.
+	carry = _mm_cmpgt_epi32(_mm_srli_epi32(w, 16), _mm_set1_epi32(0xfffd));
+	carry = _mm_and_si128(carry, _mm_set1_epi32(0x10000));
+	w = _mm_add_epi32(w, _mm_set1_epi32(0x10000 - 1));
+	_mm_storeu_si128((__m128i *)words, _mm_add_epi32(w, carry));
+#else
+	uint32x4_t w = vld1q_u32(words);
+	uint32x4_t ttl = vandq_u32(w, vdupq_n_u32(0xff));
+	uint32x4_t carry;
+
+	if (vmaxvq_u32(vcltq_u32(ttl, vdupq_n_u32(2))) != 0)
+		return false;
+
+	carry = vandq_u32(vcgeq_u32(w, vdupq_n_u32(0xfffe0000)), vdupq_n_u32(0x10000));
+	w = vaddq_u32(w, vdupq_n_u32(0x10000 - 1));
+	vst1q_u32(words, vaddq_u32(w, carry));
+#endif
+	return true;
+}
+#endif
+
+static inline void ip_forward_one(
+	struct gr_spec_stream *s,
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t i
+) {
+	struct rte_mbuf *mbuf = objs[i];
 	struct rte_ipv4_hdr *ip;
-	struct rte_mbuf *mbuf;
 	rte_be32_t csum;
-	uint16_t i;
 
-	for (i = 0; i < nb_objs; i++) {
-		mbuf = objs[i];
-		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+	ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
 
-		if (ip->time_to_live <= 1) {
-			rte_node_enqueue_x1(graph, node, TTL_EXCEEDED, mbuf);
+	if (ip->time_to_live <= 1) {
+		gr_spec_stream_enqueue(s, graph, node, objs, i, TTL_EXCEEDED);
+		return;
+	}
+	ip->time_to_live -= 1;
+	csum = ip->hdr_checksum + RTE_BE16(0x0100);
+	csum += csum >= 0xffff;
+	ip->hdr_checksum = csum;
+	gr_spec_stream_enqueue(s, graph, node, objs, i, output_edge(mbuf, ip));
+}
+
+static uint16_t
+ip_forward_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+#ifdef TTL_LANES
+	struct rte_ipv4_hdr *hdrs[TTL_LANES];
+	uint32_t words[TTL_LANES];
+	uint16_t j;
+#endif
+	struct gr_spec_stream s;
+	uint16_t i = 0;
+
+	gr_spec_stream_init(&s, node, nb_objs);
+
+#ifdef TTL_LANES
+	// Expired TTLs are rare. Headers are updated in groups and only go
+	// through the scalar path when one of them is expired.
+	for (; i + TTL_LANES <= nb_objs; i += TTL_LANES) {
+		for (j = 0; j < TTL_LANES; j++) {
+			gr_mbuf_prefetch_ahead(objs, i + j, nb_objs);
+			hdrs[j] = rte_pktmbuf_mtod((struct rte_mbuf *)objs[i + j], void *);
+			memcpy(&words[j], RTE_PTR_ADD(hdrs[j], TTL_WORD_OFFSET), sizeof(words[j]));
+		}
+		if (unlikely(!ttl_decrement_x4(words))) {
+			for (j = 0; j < TTL_LANES; j++)
+				ip_forward_one(&s, graph, node, objs, i + j);
 			continue;
 		}
-		ip->time_to_live -= 1;
-		csum = ip->hdr_checksum + RTE_BE16(0x0100);
-		csum += csum >= 0xffff;
-		ip->hdr_checksum = csum;
-		rte_node_enqueue_x1(graph, node, OUTPUT, mbuf);
+		for (j = 0; j < TTL_LANES; j++) {
+			memcpy(RTE_PTR_ADD(hdrs[j], TTL_WORD_OFFSET), &words[j], sizeof(words[j]));
+			gr_spec_stream_enqueue(
+				&s, graph, node, objs, i + j, output_edge(objs[i + j], hdrs[j])
+			);
+		}
+	}
+#endif
+
+	for (; i < nb_objs; i++) {
+		gr_mbuf_prefetch_ahead(objs, i, nb_objs);
+		ip_forward_one(&s, graph, node, objs, i);
 	}
 
+	gr_spec_stream_flush(&s, graph, node);
+
 	return nb_objs;
 }
 
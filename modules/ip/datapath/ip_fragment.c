@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_datapath.h>
+#include <gr_graph.h>
+#include <gr_iface.h>
+#include <gr_ip4_datapath.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+#include <gr_mempool.h>
+
+#include <rte_graph_worker.h>
+#include <rte_ip.h>
+#include <rte_ip_frag.h>
+#include <rte_mbuf.h>
+
+// Enough for a 64K datagram over the minimum IPv4 MTU of 576 bytes.
+#define IP_FRAGMENT_MAX 128
+
+enum {
+	IP_OUTPUT = 0,
+	ERROR,
+	EDGE_COUNT,
+};
+
+static uint16_t
+ip_fragment_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct rte_mbuf *frags[IP_FRAGMENT_MAX];
+	struct rte_mempool *pool = node->ctx_ptr;
+	struct ip_output_mbuf_data *data;
+	const struct iface *iface;
+	struct rte_ipv4_hdr *ip;
+	struct rte_mbuf *mbuf;
+	uint16_t max_copy;
+	int n;
+
+	max_copy = rte_pktmbuf_data_room_size(pool) - RTE_PKTMBUF_HEADROOM;
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+		data = ip_output_mbuf_data(mbuf);
+		iface = data->nh->iface;
+		if (iface == NULL) {
+			rte_node_enqueue_x1(graph, node, ERROR, mbuf);
+			continue;
+		}
+
+		// Copy the payload in single segment fragments when they fit in the
+		// pool data room. Otherwise, attach the original data to the fragments
+		// with indirect mbufs. This is only used for jumbo MTUs for which the
+		// ports have RTE_ETH_TX_OFFLOAD_MULTI_SEGS enabled.
+		if (iface->mtu <= max_copy)
+			n = rte_ipv4_fragment_copy_nonseg_packet(
+				mbuf, frags, ARRAY_DIM(frags), iface->mtu, pool
+			);
+		else
+			n = rte_ipv4_fragment_packet(
+				mbuf, frags, ARRAY_DIM(frags), iface->mtu, pool, pool
+			);
+		if (n < 0) {
+			rte_node_enqueue_x1(graph, node, ERROR, mbuf);
+			continue;
+		}
+
+		for (int j = 0; j < n; j++) {
+			struct rte_mbuf *f = frags[j];
+			*ip_output_mbuf_data(f) = *data;
+			ip = rte_pktmbuf_mtod(f, struct rte_ipv4_hdr *);
+			// The header checksums are left for eth_output to resolve.
+			f->l3_len = rte_ipv4_hdr_len(ip);
+			f->ol_flags |= RTE_MBUF_F_TX_IPV4 | RTE_MBUF_F_TX_IP_CKSUM;
+			rte_node_enqueue_x1(graph, node, IP_OUTPUT, f);
+		}
+		// Indirect fragments hold a reference on the original data.
+		rte_pktmbuf_free(mbuf);
+	}
+
+	return nb_objs;
+}
+
+static int ip_fragment_init(const struct rte_graph *graph, struct rte_node *node) {
+	node->ctx_ptr = gr_pktmbuf_pool_get(graph->socket, RTE_GRAPH_BURST_SIZE);
+
+	if (node->ctx_ptr == NULL)
+		return errno_log(errno, "gr_pktmbuf_pool_get(ip_fragment)");
+
+	return 0;
+}
+
+static void ip_fragment_fini(const struct rte_graph *, struct rte_node *node) {
+	gr_pktmbuf_pool_release(node->ctx_ptr, RTE_GRAPH_BURST_SIZE);
+	node->ctx_ptr = NULL;
+}
+
+static struct rte_node_register fragment_node = {
+	.name = "ip_fragment",
+	.process = ip_fragment_process,
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[IP_OUTPUT] = "ip_output",
+		[ERROR] = "ip_fragment_error",
+	},
+	.init = ip_fragment_init,
+	.fini = ip_fragment_fini,
+};
+
+static struct gr_node_info info = {
+	.node = &fragment_node,
+};
+
+GR_NODE_REGISTER(info);
+
+GR_DROP_REGISTER(ip_fragment_error);
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_control_input.h>
+#include <gr_datapath.h>
+#include <gr_graph.h>
+#include <gr_hold_queue.h>
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+
+#include <rte_graph_worker.h>
+#include <rte_mbuf.h>
+
+enum {
+	IP_OUTPUT = 0,
+	EDGE_COUNT,
+};
+
+static control_input_t hold_flush;
+
+int ip_hold_flush(struct nexthop *nh) {
+	if (nh == NULL)
+		return errno_set(EINVAL);
+	return post_to_stack(hold_flush, nh);
+}
+
+static uint16_t ip_hold_flush_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	struct ip_output_mbuf_data *o;
+	struct rte_mbuf *m, *next;
+	struct nexthop *nh;
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		nh = control_input_mbuf_data(objs[i])->data;
+
+		// Packets have been held by this next hop while it was already
+		// reachable. Send them to ip_output again.
+		for (m = hold_queue_flush(&nh->neigh.held); m != NULL; m = next) {
+			next = queue_mbuf_data(m)->next;
+			o = ip_output_mbuf_data(m);
+			o->nh = nh;
+			o->input_iface = NULL;
+			rte_node_enqueue_x1(graph, node, IP_OUTPUT, m);
+		}
+
+		// The message mbuf allocated by control_input does not carry any packet data.
+		rte_pktmbuf_free(objs[i]);
+	}
+
+	return nb_objs;
+}
+
+static void ip_hold_flush_register(void) {
+	hold_flush = gr_control_input_register_handler("ip_hold_flush");
+}
+
+static struct rte_node_register node = {
+	.name = "ip_hold_flush",
+	.process = ip_hold_flush_process,
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[IP_OUTPUT] = "ip_output",
+	},
+};
+
+static struct gr_node_info info = {
+	.node = &node,
+	.register_callback = ip_hold_flush_register,
+};
+
+GR_NODE_REGISTER(info);
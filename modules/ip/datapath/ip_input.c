@@ -1,13 +1,20 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // Copyright (c) 2024 Robin Jarry
 
+#include <gr.h>
+#include <gr_datapath.h>
 #include <gr_eth_input.h>
+#include <gr_eth_output.h>
 #include <gr_graph.h>
 #include <gr_ip4_control.h>
 #include <gr_ip4_datapath.h>
 #include <gr_log.h>
+#include <gr_mbuf.h>
+#include <gr_sample.h>
+#include <gr_vrf_stats.h>
 
 #include <rte_byteorder.h>
+#include <rte_cycles.h>
 #include <rte_errno.h>
 #include <rte_ether.h>
 #include <rte_fib.h>
@@ -15,119 +22,562 @@
 #include <rte_ip.h>
 #include <rte_mbuf.h>
 #include <rte_mbuf_dyn.h>
+#include <rte_malloc.h>
+#include <rte_mbuf_ptype.h>
+
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <string.h>
 
 enum edges {
 	FORWARD = 0,
 	LOCAL,
 	NO_ROUTE,
 	BAD_CHECKSUM,
+	BAD_VERSION,
 	BAD_LENGTH,
 	OTHER_HOST,
+	ETH_OUTPUT,
+	RPF_FAIL,
 	EDGE_COUNT,
 };
 
+// Sentinel edge value for packets that passed validation and need a route lookup.
+#define LOOKUP EDGE_COUNT
+
+// Routable multicast packets are delivered locally unless a multicast
+// forwarding node is registered.
+static rte_edge_t mcast_edge = LOCAL;
+
+void ip_input_mcast_register(const char *next_node) {
+	LOG(DEBUG, "ip_input: multicast -> %s", next_node);
+	if (mcast_edge != LOCAL)
+		ABORT("next node already registered for multicast");
+	mcast_edge = gr_node_attach_parent("ip_input", next_node);
+}
+
+// Policy based routing classifier, see ip_input_pbr_set().
+static ip_input_pbr_cb_t pbr_cb;
+
+void ip_input_pbr_set(ip_input_pbr_cb_t cb) {
+	__atomic_store_n(&pbr_cb, cb, __ATOMIC_RELEASE);
+}
+
+struct gr_feature_arc ip4_input_features = {.name = "ip4_input"};
+static uint8_t features_row;
+
+// Packets received on NAT outside interfaces, see ip_input_nat_register().
+static rte_edge_t nat_edge = RTE_EDGE_ID_INVALID;
+
+void ip_input_nat_register(const char *next_node) {
+	LOG(DEBUG, "ip_input: nat -> %s", next_node);
+	if (nat_edge != RTE_EDGE_ID_INVALID)
+		ABORT("next node already registered for nat");
+	nat_edge = gr_node_attach_parent("ip_input", next_node);
+}
+
+// Per-worker flow cache (--flow-cache).
+//
+// Direct mapped table of route lookup results indexed by (vrf, destination).
+// Entries are only valid for the ip4_route_gen and iface_config_gen values at
+// the time they were filled. Next hops are released after an RCU grace period
+// which starts after the generation is bumped. A worker that read the old
+// generation during the current graph walk can still safely dereference them.
+#define FLOW_CACHE_SIZE 4096 // must be a power of 2
+
+struct flow_entry {
+	uint32_t route_gen;
+	uint32_t iface_gen;
+	ip4_addr_t dst;
+	uint16_t vrf_id;
+	struct nexthop *nh;
+	// egress ethernet interface when packets can bypass ip_forward and ip_output
+	const struct iface *iface;
+	// packets sent to eth_output during the hit_sec second, for the hardware
+	// offload candidates (see ip4_offload_threshold)
+	uint32_t hit_sec;
+	uint32_t hits;
+};
+
+struct flow_cache {
+	uint32_t route_gen;
+	uint32_t iface_gen;
+	struct flow_entry entries[FLOW_CACHE_SIZE];
+};
+
+static inline struct flow_entry *flow_entry(struct flow_cache *c, uint16_t vrf_id, ip4_addr_t dst) {
+	uint32_t h = (dst ^ vrf_id) * UINT32_C(2654435761);
+	return &c->entries[h >> (32 - __builtin_ctz(FLOW_CACHE_SIZE))];
+}
+
+static inline bool flow_entry_valid(
+	const struct flow_cache *c,
+	const struct flow_entry *f,
+	uint16_t vrf_id,
+	ip4_addr_t dst
+) {
+	return f->route_gen == c->route_gen && f->iface_gen == c->iface_gen && f->dst == dst
+		&& f->vrf_id == vrf_id;
+}
+
+static void flow_entry_fill(
+	const struct flow_cache *c,
+	struct flow_entry *f,
+	uint16_t vrf_id,
+	ip4_addr_t dst,
+	struct nexthop *nh
+) {
+	const struct iface *iface = NULL;
+
+	if (!(nh->flags & (GR_IP4_NH_F_LOCAL | GR_IP4_NH_F_GROUP))
+	    && (!(nh->flags & GR_IP4_NH_F_LINK) || nh->ip == dst)) {
+		iface = nh->iface;
+		if (iface != NULL && iface->type_id != GR_IFACE_TYPE_PORT
+		    && iface->type_id != GR_IFACE_TYPE_VLAN)
+			iface = NULL;
+	}
+
+	f->route_gen = c->route_gen;
+	f->iface_gen = c->iface_gen;
+	f->dst = dst;
+	f->vrf_id = vrf_id;
+	f->nh = nh;
+	f->iface = iface;
+	f->hits = 0;
+}
+
+// Report the entry to the control plane once when it forwards more packets
+// than the offload threshold in one second.
+static inline void flow_entry_account(
+	struct flow_entry *f,
+	uint32_t threshold,
+	uint32_t sec,
+	const struct iface *iface
+) {
+	if (f->hit_sec != sec) {
+		f->hit_sec = sec;
+		f->hits = 0;
+	}
+	if (++f->hits == threshold && iface->type_id == GR_IFACE_TYPE_PORT
+	    && f->iface->type_id == GR_IFACE_TYPE_PORT)
+		ip4_offload_candidate(f->vrf_id, iface->id, f->dst);
+}
+
+// Unicast reverse path forwarding (RFC 3704). In strict mode, the route to the
+// source address must go through the input interface (or one of the members
+// of an ECMP group). In loose mode, any route to the source address will do.
+static inline bool rpf_check(const struct iface *iface, const struct nexthop *nh) {
+	if (nh == NULL)
+		return false;
+	if (!(iface->flags & GR_IFACE_F_RPF_STRICT))
+		return true;
+	if (nh->flags & GR_IP4_NH_F_GROUP) {
+		for (unsigned i = 0; i < nh->group->n_members; i++) {
+			const struct nexthop *m = nh->group->members[i];
+			if (m->iface_id == iface->id)
+				return true;
+		}
+		return false;
+	}
+	return nh->iface_id == iface->id;
+}
+
+static inline rte_edge_t lookup_edge(const struct nexthop *nh, ip4_addr_t dst) {
+	if (nh == NULL)
+		return NO_ROUTE;
+	// If the resolved next hop is local and the destination IP is
+	// ourselves, send to ip_local.
+	if (nh->flags & GR_IP4_NH_F_LOCAL && dst == nh->ip)
+		return LOCAL;
+	return FORWARD;
+}
+
+// Resolve cached destinations. Packets sent directly to eth_output have their
+// TTL decremented here, like ip_forward does.
+static void flow_cache_lookup(
+	struct flow_cache *c,
+	struct rte_mbuf **mbufs,
+	rte_edge_t *edges,
+	struct nexthop **nhs,
+	const struct iface **ifaces,
+	const uint16_t *vrfs,
+	uint16_t count
+) {
+	uint32_t threshold, sec = 0;
+	const struct iface *iface;
+	struct rte_ipv4_hdr *ip;
+	struct flow_entry *f;
+	struct nexthop *nh;
+	rte_be32_t csum;
+
+	c->route_gen = __atomic_load_n(&ip4_route_gen, __ATOMIC_ACQUIRE);
+	c->iface_gen = __atomic_load_n(&iface_config_gen, __ATOMIC_ACQUIRE);
+	threshold = __atomic_load_n(&ip4_offload_threshold, __ATOMIC_RELAXED);
+	if (threshold != 0)
+		sec = rte_rdtsc() / rte_get_tsc_hz();
+
+	for (uint16_t i = 0; i < count; i++) {
+		if (edges[i] != LOOKUP)
+			continue;
+		iface = eth_input_mbuf_data(mbufs[i])->iface;
+		// the source address must be looked up as well
+		if (iface->flags & GR_IFACE_F_RPF)
+			continue;
+		// the TTL must only be decremented once the packet is accepted
+		if (gr_feature_enabled(&ip4_input_features, iface->id) != 0 || iface->nat44 != NULL)
+			continue;
+		ip = rte_pktmbuf_mtod(mbufs[i], struct rte_ipv4_hdr *);
+		f = flow_entry(c, vrfs[i], ip->dst_addr);
+		if (!flow_entry_valid(c, f, vrfs[i], ip->dst_addr))
+			continue;
+
+		nh = f->nh;
+		nhs[i] = nh;
+		edges[i] = lookup_edge(nh, ip->dst_addr);
+		if (f->iface == NULL || !(nh->flags & GR_IP4_NH_F_REACHABLE))
+			continue;
+		// egress ACLs and NAT are applied between ip_forward and ip_output
+		if (f->iface->acl_out != NULL || f->iface->nat44 != NULL)
+			continue;
+		if (ip->time_to_live <= 1)
+			continue; // ip_forward sends the ICMP error
+		ip->time_to_live -= 1;
+		csum = ip->hdr_checksum + RTE_BE16(0x0100);
+		csum += csum >= 0xffff;
+		ip->hdr_checksum = csum;
+		ip4_nexthop_touch(nh);
+		if (threshold != 0)
+			flow_entry_account(f, threshold, sec, iface);
+		ifaces[i] = f->iface;
+		edges[i] = ETH_OUTPUT;
+	}
+}
+
+static void ip_input_lookup(
+	struct flow_cache *cache,
+	struct rte_mbuf **mbufs,
+	rte_edge_t *edges,
+	struct nexthop **nhs,
+	uint16_t *vrfs,
+	uint16_t count
+) {
+	// destinations followed by the sources of packets that need an RPF check
+	ip4_addr_t dst[RTE_GRAPH_BURST_SIZE * 2];
+	struct nexthop *res[RTE_GRAPH_BURST_SIZE * 2];
+	ip4_addr_t src[RTE_GRAPH_BURST_SIZE];
+	uint16_t idx[RTE_GRAPH_BURST_SIZE];
+	// 1-based index in src, 0 if the input interface has no RPF check
+	uint16_t rpf[RTE_GRAPH_BURST_SIZE];
+	const struct rte_ipv4_hdr *ip;
+	const struct iface *iface;
+	uint16_t i, j, n, m, vrf_id;
+
+	// Group the packets by VRF and resolve all destinations of each group
+	// with a single FIB lookup. Most bursts only contain one VRF and this
+	// loop runs exactly once.
+	for (i = 0; i < count; i++) {
+		if (edges[i] != LOOKUP)
+			continue;
+
+		vrf_id = vrfs[i];
+		n = 0;
+		m = 0;
+		for (j = i; j < count; j++) {
+			if (edges[j] != LOOKUP || vrfs[j] != vrf_id)
+				continue;
+			ip = rte_pktmbuf_mtod(mbufs[j], const struct rte_ipv4_hdr *);
+			dst[n] = ip->dst_addr;
+			idx[n] = j;
+			rpf[n] = 0;
+			iface = eth_input_mbuf_data(mbufs[j])->iface;
+			if (unlikely(iface->flags & GR_IFACE_F_RPF)) {
+				src[m++] = ip->src_addr;
+				rpf[n] = m;
+			}
+			n++;
+		}
+		// Sources are resolved in the same FIB lookup as destinations.
+		memcpy(&dst[n], src, m * sizeof(*src));
+
+		ip4_route_lookup_bulk(vrf_id, n + m, dst, res);
+
+		for (j = 0; j < n; j++) {
+			struct nexthop *nh = res[j];
+			uint16_t k = idx[j];
+
+			if (unlikely(rpf[j] != 0)) {
+				iface = eth_input_mbuf_data(mbufs[k])->iface;
+				if (!rpf_check(iface, res[n + rpf[j] - 1])) {
+					edges[k] = RPF_FAIL;
+					continue;
+				}
+			}
+			nhs[k] = nh;
+			edges[k] = lookup_edge(nh, dst[j]);
+			if (cache != NULL && nh != NULL) {
+				struct flow_entry *f = flow_entry(cache, vrf_id, dst[j]);
+				flow_entry_fill(cache, f, vrf_id, dst[j], nh);
+			}
+		}
+	}
+}
+
+// Classify the packets that need a route lookup in a single call and replace
+// their VRF with the selected one.
+static void ip_input_pbr(
+	ip_input_pbr_cb_t cb,
+	struct rte_mbuf **mbufs,
+	const rte_edge_t *edges,
+	uint16_t *vrfs,
+	uint16_t count
+) {
+	struct rte_mbuf *lookup[RTE_GRAPH_BURST_SIZE];
+	uint16_t vrf_ids[RTE_GRAPH_BURST_SIZE];
+	uint16_t idx[RTE_GRAPH_BURST_SIZE];
+	uint16_t i, n = 0;
+
+	for (i = 0; i < count; i++) {
+		if (edges[i] != LOOKUP)
+			continue;
+		lookup[n] = mbufs[i];
+		vrf_ids[n] = vrfs[i];
+		idx[n++] = i;
+	}
+	if (n == 0)
+		return;
+
+	cb(lookup, vrf_ids, n);
+
+	for (i = 0; i < n; i++)
+		vrfs[idx[i]] = vrf_ids[i];
+}
+
+// First enabled input feature, or edge when there is none. The bitmap is only
+// looked up again when the input interface changes.
+static inline rte_edge_t features_edge(
+	const struct iface *iface,
+	const struct iface **last,
+	gr_feature_mask_t *features,
+	rte_edge_t edge
+) {
+	if (iface != *last) {
+		*last = iface;
+		*features = gr_feature_enabled(&ip4_input_features, iface->id);
+	}
+	if (*features == 0)
+		return edge;
+	return gr_feature_arc_edge(&ip4_input_features, features_row, *features);
+}
+
+static void ip_input_sample(
+	struct sample *sample,
+	const struct iface *iface,
+	const struct nexthop *nh,
+	rte_edge_t edge
+) {
+	const struct rte_ipv4_hdr *ip = (const struct rte_ipv4_hdr *)sample->header;
+
+	sample->iface_id = iface->id;
+	sample->vrf_id = iface->vrf_id;
+	sample->af = AF_INET;
+	sample->out_iface_id = GR_IFACE_ID_UNDEF;
+	memset(&sample->nh, 0, sizeof(sample->nh));
+	if (nh != NULL && (edge == FORWARD || edge == ETH_OUTPUT)) {
+		sample->out_iface_id = nh->iface_id;
+		// connected destinations are their own next hop
+		if (nh->flags & GR_IP4_NH_F_LINK && sample->header_len >= sizeof(*ip))
+			sample->nh.ip4 = ip->dst_addr;
+		else
+			sample->nh.ip4 = nh->ip;
+	}
+	sample_push(sample);
+}
+
 static uint16_t
 ip_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	const struct iface *ifaces[RTE_GRAPH_BURST_SIZE];
+	struct flow_cache *cache = node->ctx_ptr;
+	struct eth_output_mbuf_data *o;
+	struct nexthop *nhs[RTE_GRAPH_BURST_SIZE];
+	const struct iface *last;
+	struct iface_sampler *sampler;
+	rte_edge_t edges[RTE_GRAPH_BURST_SIZE];
+	uint16_t vrfs[RTE_GRAPH_BURST_SIZE];
 	struct eth_input_mbuf_data *e;
 	struct ip_output_mbuf_data *d;
-	const struct iface *iface;
+	struct gr_spec_stream s;
+	struct rte_mbuf **mbufs;
 	struct rte_ipv4_hdr *ip;
+	gr_feature_mask_t features;
+	ip_input_pbr_cb_t pbr;
+	struct sample *sample;
 	struct rte_mbuf *mbuf;
-	struct nexthop *nh;
-	rte_edge_t edge;
-	uint16_t i;
-
-	for (i = 0; i < nb_objs; i++) {
-		iface = NULL;
-		nh = NULL;
-		mbuf = objs[i];
-		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
-		e = eth_input_mbuf_data(mbuf);
-		d = ip_output_mbuf_data(mbuf);
-		iface = e->iface;
-
-		// RFC 1812 section 5.2.2 IP Header Validation
-		//
-		// (1) The packet length reported by the Link Layer must be large
-		//     enough to hold the minimum length legal IP datagram (20 bytes).
-		// XXX: already checked by hardware
-
-		// (2) The IP checksum must be correct.
-		switch (mbuf->ol_flags & RTE_MBUF_F_RX_IP_CKSUM_MASK) {
-		case RTE_MBUF_F_RX_IP_CKSUM_NONE:
-		case RTE_MBUF_F_RX_IP_CKSUM_UNKNOWN:
-			// if this is not checked in H/W, check it.
-			if (rte_ipv4_cksum(ip)) {
-				edge = BAD_CHECKSUM;
-				goto next;
+	uint16_t i, n, count;
+	bool arc_active;
+
+	gr_spec_stream_init(&s, node, nb_objs);
+	arc_active = gr_feature_arc_active(&ip4_input_features);
+	pbr = __atomic_load_n(&pbr_cb, __ATOMIC_ACQUIRE);
+	last = NULL;
+	features = 0;
+
+	for (n = 0; n < nb_objs; n += count) {
+		count = RTE_MIN(nb_objs - n, RTE_GRAPH_BURST_SIZE);
+		mbufs = (struct rte_mbuf **)&objs[n];
+
+		for (i = 0; i < count; i++) {
+			mbuf = mbufs[i];
+			gr_mbuf_prefetch_ahead((void **)mbufs, i, count);
+			ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+			e = eth_input_mbuf_data(mbuf);
+			nhs[i] = NULL;
+			vrfs[i] = e->iface->vrf_id;
+
+			// RFC 1812 section 5.2.2 IP Header Validation
+			//
+			// (1) The packet length reported by the Link Layer must be large
+			//     enough to hold the minimum length legal IP datagram (20 bytes).
+			// XXX: already checked by hardware
+
+			// (2) The IP checksum must be correct.
+			switch (mbuf->ol_flags & RTE_MBUF_F_RX_IP_CKSUM_MASK) {
+			case RTE_MBUF_F_RX_IP_CKSUM_NONE:
+			case RTE_MBUF_F_RX_IP_CKSUM_UNKNOWN:
+				// if this is not checked in H/W, check it.
+				if (rte_ipv4_cksum(ip)) {
+					edges[i] = BAD_CHECKSUM;
+					continue;
+				}
+				break;
+			case RTE_MBUF_F_RX_IP_CKSUM_BAD:
+				edges[i] = BAD_CHECKSUM;
+				continue;
 			}
-			break;
-		case RTE_MBUF_F_RX_IP_CKSUM_BAD:
-			edge = BAD_CHECKSUM;
-			goto next;
-		}
 
-		// (3) The IP version number must be 4.  If the version number is not 4
-		//     then the packet may be another version of IP, such as IPng or
-		//     ST-II.
-		// (4) The IP header length field must be large enough to hold the
-		//     minimum length legal IP datagram (20 bytes = 5 words).
-		// XXX: already checked by hardware
-
-		// (5) The IP total length field must be large enough to hold the IP
-		//     datagram header, whose length is specified in the IP header
-		//     length field.
-		if (rte_cpu_to_be_16(ip->total_length) < sizeof(struct rte_ipv4_hdr)) {
-			edge = BAD_LENGTH;
-			goto next;
-		}
+			// (3) The IP version number must be 4.  If the version number is not 4
+			//     then the packet may be another version of IP, such as IPng or
+			//     ST-II.
+			// (4) The IP header length field must be large enough to hold the
+			//     minimum length legal IP datagram (20 bytes = 5 words).
+			// Already checked by hardware if it classified the packet as IPv4.
+			if (!RTE_ETH_IS_IPV4_HDR(mbuf->packet_type)) {
+				if ((ip->version_ihl >> 4) != IPVERSION) {
+					edges[i] = BAD_VERSION;
+					continue;
+				}
+				if (rte_ipv4_hdr_len(ip) < sizeof(struct rte_ipv4_hdr)) {
+					edges[i] = BAD_LENGTH;
+					continue;
+				}
+			}
 
-		switch (e->eth_dst) {
-		case ETH_DST_LOCAL:
-			// Packet sent to our ethernet address.
-			break;
-		case ETH_DST_BROADCAST:
-		case ETH_DST_MULTICAST:
-			// Non unicast ethernet destination. No need for a route lookup.
-			edge = LOCAL;
-			goto next;
-		case ETH_DST_OTHER:
-		default:
-			// Drop all packets not sent to our ethernet address
-			edge = OTHER_HOST;
-			goto next;
-		}
+			// (5) The IP total length field must be large enough to hold the IP
+			//     datagram header, whose length is specified in the IP header
+			//     length field.
+			if (rte_cpu_to_be_16(ip->total_length) < sizeof(struct rte_ipv4_hdr)) {
+				edges[i] = BAD_LENGTH;
+				continue;
+			}
 
-		nh = ip4_route_lookup(iface->vrf_id, ip->dst_addr);
-		if (nh == NULL) {
-			edge = NO_ROUTE;
-			goto next;
+			switch (e->eth_dst) {
+			case ETH_DST_LOCAL:
+				// Packet sent to our ethernet address.
+				edges[i] = LOOKUP;
+				break;
+			case ETH_DST_MULTICAST:
+				// Link-local groups (224.0.0.0/24) are never forwarded.
+				if (ip_mcast_routable(ip->dst_addr)) {
+					edges[i] = mcast_edge;
+					break;
+				}
+				// fallthrough
+			case ETH_DST_BROADCAST:
+				// Non unicast ethernet destination. No need for a route lookup.
+				edges[i] = LOCAL;
+				break;
+			case ETH_DST_OTHER:
+			default:
+				// Drop all packets not sent to our ethernet address
+				edges[i] = OTHER_HOST;
+				break;
+			}
 		}
 
-		// If the resolved next hop is local and the destination IP is ourselves,
-		// send to ip_local.
-		if (nh->flags & GR_IP4_NH_F_LOCAL && ip->dst_addr == nh->ip)
-			edge = LOCAL;
-		else
-			edge = FORWARD;
-next:
-		// Store the resolved next hop for ip_output to avoid a second route lookup.
-		d->nh = nh;
-		d->input_iface = iface;
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
+		if (unlikely(pbr != NULL))
+			ip_input_pbr(pbr, mbufs, edges, vrfs, count);
+		if (cache != NULL)
+			flow_cache_lookup(cache, mbufs, edges, nhs, ifaces, vrfs, count);
+		ip_input_lookup(cache, mbufs, edges, nhs, vrfs, count);
+		vrf_stats_count(VRF_STATS_IP4, mbufs, vrfs, count);
+
+		for (i = 0; i < count; i++) {
+			mbuf = mbufs[i];
+			e = eth_input_mbuf_data(mbuf);
+			sampler = e->iface->sampler;
+			if (unlikely(sampler != NULL)
+			    && (sample = sample_take(sampler, mbuf)) != NULL)
+				ip_input_sample(sample, e->iface, nhs[i], edges[i]);
+			if (edges[i] == ETH_OUTPUT) {
+				o = eth_output_mbuf_data(mbuf);
+				eth_output_set_dst(o, &nhs[i]->lladdr, &nhs[i]->l2);
+				o->ether_type = RTE_BE16(RTE_ETHER_TYPE_IPV4);
+				o->iface = ifaces[i];
+				gr_spec_stream_enqueue(&s, graph, node, objs, n + i, edges[i]);
+				continue;
+			}
+			// Translated before the ingress ACL. Broadcast and link-local
+			// multicast packets (LOCAL without a next hop) are not translated.
+			if (unlikely(e->iface->nat44 != NULL)
+			    && (edges[i] == FORWARD || edges[i] == NO_ROUTE
+				|| (edges[i] == LOCAL && nhs[i] != NULL)))
+				edges[i] = nat_edge;
+			else if (unlikely(arc_active) && (edges[i] == FORWARD || edges[i] == LOCAL))
+				edges[i] = features_edge(e->iface, &last, &features, edges[i]);
+			d = ip_output_mbuf_data(mbuf);
+			// Store the resolved next hop for ip_output to avoid a second route lookup.
+			d->input_iface = e->iface;
+			d->nh = nhs[i];
+			gr_spec_stream_enqueue(&s, graph, node, objs, n + i, edges[i]);
+		}
 	}
 
+	gr_spec_stream_flush(&s, graph, node);
+
 	return nb_objs;
 }
 
+static int ip_input_init(const struct rte_graph *graph, struct rte_node *node) {
+	struct flow_cache *cache;
+
+	node->ctx_ptr = NULL;
+	if (!gr_args()->flow_cache)
+		return 0;
+
+	cache = rte_zmalloc_socket(__func__, sizeof(*cache), RTE_CACHE_LINE_SIZE, graph->socket);
+	if (cache == NULL) {
+		LOG(ERR, "rte_zmalloc_socket: %s", rte_strerror(rte_errno));
+		return -ENOMEM;
+	}
+	node->ctx_ptr = cache;
+
+	return 0;
+}
+
+static void ip_input_fini(const struct rte_graph *, struct rte_node *node) {
+	rte_free(node->ctx_ptr);
+}
+
 static void ip_input_register(void) {
 	gr_eth_input_add_type(RTE_BE16(RTE_ETHER_TYPE_IPV4), "ip_input");
+	features_row = gr_feature_arc_entry(&ip4_input_features, "ip_input");
 }
 
 static struct rte_node_register input_node = {
 	.name = "ip_input",
 
 	.process = ip_input_process,
+	.init = ip_input_init,
+	.fini = ip_input_fini,
 
 	.nb_edges = EDGE_COUNT,
 	.next_nodes = {
@@ -135,8 +585,11 @@ static struct rte_node_register input_node = {
 		[LOCAL] = "ip_input_local",
 		[NO_ROUTE] = "ip_error_dest_unreach",
 		[BAD_CHECKSUM] = "ip_input_bad_checksum",
+		[BAD_VERSION] = "ip_input_bad_version",
 		[BAD_LENGTH] = "ip_input_bad_length",
 		[OTHER_HOST] = "ip_input_other_host",
+		[ETH_OUTPUT] = "eth_output",
+		[RPF_FAIL] = "ip_input_rpf_fail",
 	},
 };
 
@@ -148,5 +601,7 @@ static struct gr_node_info info = {
 GR_NODE_REGISTER(info);
 
 GR_DROP_REGISTER(ip_input_bad_checksum);
+GR_DROP_REGISTER(ip_input_bad_version);
 GR_DROP_REGISTER(ip_input_bad_length);
 GR_DROP_REGISTER(ip_input_other_host);
+GR_DROP_REGISTER(ip_input_rpf_fail);
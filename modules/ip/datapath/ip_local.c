@@ -6,10 +6,27 @@
 #include <gr_ip4_datapath.h>
 #include <gr_log.h>
 
+#include <rte_cycles.h>
+#include <rte_errno.h>
 #include <rte_graph_worker.h>
 #include <rte_ip.h>
+#include <rte_ip_frag.h>
+#include <rte_malloc.h>
 #include <rte_mbuf.h>
 
+// Reassembly table sizing, per worker.
+#define IP_REASS_BUCKETS 1024
+#define IP_REASS_BUCKET_ENTRIES 16
+#define IP_REASS_MAX_FLOWS (IP_REASS_BUCKETS * IP_REASS_BUCKET_ENTRIES / 4)
+#define IP_REASS_TIMEOUT_MS 2000
+
+// Owned by a single worker graph, no locking required.
+struct ip_reass_ctx {
+	struct rte_ip_frag_tbl *tbl;
+	// Mbufs of expired or invalid fragments, freed once per graph walk.
+	struct rte_ip_frag_death_row death_row;
+};
+
 #define UNKNOWN_PROTO 0
 static rte_edge_t edges[256] = {UNKNOWN_PROTO};
 
@@ -26,38 +43,96 @@ static uint16_t ip_input_local_process(
 	void **objs,
 	uint16_t nb_objs
 ) {
+	struct ip_reass_ctx *ctx = node->ctx_ptr;
+	struct ip_local_mbuf_data *data;
 	struct rte_ipv4_hdr *ip;
 	struct rte_mbuf *mbuf;
 	rte_edge_t edge;
+	uint64_t now;
 	uint16_t i;
 
+	now = rte_rdtsc();
+
 	for (i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
 		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+		if (unlikely(rte_ipv4_frag_pkt_is_fragmented(ip))) {
+			mbuf->l2_len = 0;
+			mbuf->l3_len = rte_ipv4_hdr_len(ip);
+			mbuf = rte_ipv4_frag_reassemble_packet(
+				ctx->tbl, &ctx->death_row, mbuf, now, ip
+			);
+			if (mbuf == NULL)
+				continue; // incomplete datagram or invalid fragment
+			// The first fragment mbuf is the head of the reassembled chain.
+			ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+		}
 		edge = edges[ip->next_proto_id];
-		if (edge != UNKNOWN_PROTO) {
-			const struct iface *iface = ip_output_mbuf_data(mbuf)->input_iface;
-			struct ip_local_mbuf_data *data = ip_local_mbuf_data(mbuf);
-			data->src = ip->src_addr;
-			data->dst = ip->dst_addr;
-			data->len = rte_be_to_cpu_16(ip->total_length) - rte_ipv4_hdr_len(ip);
-			data->vrf_id = iface->vrf_id;
-			data->proto = ip->next_proto_id;
+		// also filled for unknown protocols, ip_punt needs them
+		data = ip_local_mbuf_data(mbuf);
+		data->src = ip->src_addr;
+		data->dst = ip->dst_addr;
+		data->len = rte_be_to_cpu_16(ip->total_length) - rte_ipv4_hdr_len(ip);
+		data->vrf_id = data->input_iface->vrf_id;
+		data->proto = ip->next_proto_id;
+		if (edge != UNKNOWN_PROTO)
 			rte_pktmbuf_adj(mbuf, sizeof(*ip));
-		}
 		rte_node_enqueue_x1(graph, node, edge, mbuf);
 	}
 
+	rte_ip_frag_free_death_row(&ctx->death_row, 0);
+
 	return nb_objs;
 }
 
+static int ip_input_local_init(const struct rte_graph *graph, struct rte_node *node) {
+	struct ip_reass_ctx *ctx;
+	uint64_t timeout;
+
+	ctx = rte_zmalloc_socket(__func__, sizeof(*ctx), RTE_CACHE_LINE_SIZE, graph->socket);
+	if (ctx == NULL) {
+		LOG(ERR, "rte_zmalloc_socket(): %s", rte_strerror(rte_errno));
+		return -ENOMEM;
+	}
+
+	timeout = rte_get_tsc_hz() * IP_REASS_TIMEOUT_MS / 1000;
+	ctx->tbl = rte_ip_frag_table_create(
+		IP_REASS_BUCKETS,
+		IP_REASS_BUCKET_ENTRIES,
+		IP_REASS_MAX_FLOWS,
+		timeout,
+		graph->socket
+	);
+	if (ctx->tbl == NULL) {
+		LOG(ERR, "rte_ip_frag_table_create(): %s", rte_strerror(rte_errno));
+		rte_free(ctx);
+		return -rte_errno;
+	}
+	node->ctx_ptr = ctx;
+
+	return 0;
+}
+
+static void ip_input_local_fini(const struct rte_graph *, struct rte_node *node) {
+	struct ip_reass_ctx *ctx = node->ctx_ptr;
+
+	if (ctx == NULL)
+		return;
+	rte_ip_frag_free_death_row(&ctx->death_row, 0);
+	rte_ip_frag_table_destroy(ctx->tbl);
+	rte_free(ctx);
+	node->ctx_ptr = NULL;
+}
+
 static struct rte_node_register input_node = {
 	.name = "ip_input_local",
 	.process = ip_input_local_process,
 	.nb_edges = 1,
 	.next_nodes = {
-		[UNKNOWN_PROTO] = "ip_input_local_unknown_proto",
+		[UNKNOWN_PROTO] = "ip_punt",
 	},
+	.init = ip_input_local_init,
+	.fini = ip_input_local_fini,
 };
 
 static struct gr_node_info info = {
@@ -65,5 +140,3 @@ static struct gr_node_info info = {
 };
 
 GR_NODE_REGISTER(info);
-
-GR_DROP_REGISTER(ip_input_local_unknown_proto);
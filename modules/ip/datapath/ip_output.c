@@ -5,6 +5,7 @@
 #include <gr_eth_input.h>
 #include <gr_eth_output.h>
 #include <gr_graph.h>
+#include <gr_hold_queue.h>
 #include <gr_iface.h>
 #include <gr_ip4.h>
 #include <gr_ip4_control.h>
@@ -13,6 +14,7 @@
 #include <gr_mbuf.h>
 
 #include <rte_byteorder.h>
+#include <rte_cycles.h>
 #include <rte_ether.h>
 #include <rte_fib.h>
 #include <rte_graph_worker.h>
@@ -24,6 +26,9 @@ enum {
 	NO_ROUTE,
 	ERROR,
 	QUEUE_FULL,
+	FRAGMENT,
+	FRAG_NEEDED,
+	LINK_DOWN,
 	EDGE_COUNT,
 };
 
@@ -45,35 +50,49 @@ typedef enum {
 } hold_status_t;
 
 static inline hold_status_t maybe_hold_packet(struct nexthop *nh, struct rte_mbuf *mbuf) {
-	hold_status_t status;
-
 	if (nh->flags & GR_IP4_NH_F_REACHABLE) {
-		status = OK_TO_SEND;
-	} else if (nh->held_pkts_num < IP4_NH_MAX_HELD_PKTS) {
-		queue_mbuf_data(mbuf)->next = NULL;
-		rte_spinlock_lock(&nh->lock);
-		if (nh->held_pkts_head == NULL)
-			nh->held_pkts_head = mbuf;
-		else
-			queue_mbuf_data(nh->held_pkts_tail)->next = mbuf;
-		nh->held_pkts_tail = mbuf;
-		nh->held_pkts_num++;
-		rte_spinlock_unlock(&nh->lock);
-		if (!(nh->flags & GR_IP4_NH_F_PENDING)) {
-			arp_output_request_solicit(nh);
-			nh->flags |= GR_IP4_NH_F_PENDING;
-		}
-		status = HELD;
-	} else {
-		status = HOLD_QUEUE_FULL;
+		ip4_nexthop_touch(nh);
+		return OK_TO_SEND;
+	}
+	if (hold_queue_full(&nh->neigh.held, NH_NEIGH_MAX_HELD_PKTS))
+		return HOLD_QUEUE_FULL;
+
+	hold_queue_push(&nh->neigh.held, mbuf, rte_get_tsc_cycles());
+	if (!(nh->flags & GR_IP4_NH_F_PENDING)) {
+		arp_output_request_solicit(nh);
+		nh->flags |= GR_IP4_NH_F_PENDING;
 	}
+	// The next hop may have been resolved and its queue flushed before the
+	// packet was pushed. Make sure it does not stay there.
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (unlikely(nh->flags & GR_IP4_NH_F_REACHABLE))
+		ip_hold_flush(nh);
 
-	return status;
+	return HELD;
 }
 
-static uint16_t
-ip_output_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+static inline hold_status_t hold_link_packet(struct nexthop *nh, struct rte_mbuf *mbuf) {
+	if (hold_queue_full(&nh->neigh.held, NH_NEIGH_MAX_HELD_PKTS))
+		return HOLD_QUEUE_FULL;
+
+	// Only notify the control plane when the queue was empty. It processes
+	// all packets held by the connected next hop at once. If the notification
+	// cannot be posted, the control plane will catch up with a full scan.
+	if (hold_queue_push(&nh->neigh.held, mbuf, rte_get_tsc_cycles()))
+		ip4_nexthop_learn_held(nh);
+
+	return HELD;
+}
+
+static __rte_always_inline uint16_t ip_output_burst(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs,
+	const bool tunnels
+) {
 	struct eth_output_mbuf_data *eth_data;
+	struct gr_spec_stream s;
 	const struct iface *iface;
 	struct rte_ipv4_hdr *ip;
 	struct rte_mbuf *mbuf;
@@ -82,9 +101,11 @@ ip_output_process(struct rte_graph *graph, struct rte_node *node, void **objs, u
 	rte_edge_t edge;
 
 	sent = 0;
+	gr_spec_stream_init(&s, node, nb_objs);
 
 	for (i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
+		gr_mbuf_prefetch_ahead(objs, i, nb_objs);
 		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
 
 		nh = ip_output_mbuf_data(mbuf)->nh;
@@ -92,42 +113,56 @@ ip_output_process(struct rte_graph *graph, struct rte_node *node, void **objs, u
 			edge = NO_ROUTE;
 			goto next;
 		}
-		iface = iface_from_id(nh->iface_id);
+		if (nh->flags & GR_IP4_NH_F_GROUP)
+			nh = nh_group_select(nh->group, ip4_flow_hash(mbuf, ip));
+		iface = nh->iface;
 		if (iface == NULL) {
 			edge = ERROR;
 			goto next;
 		}
+		if (unlikely(nh->flags & GR_IP4_NH_F_DOWN)) {
+			edge = LINK_DOWN;
+			goto next;
+		}
 		// Determine what is the next node based on the output interface type
 		// By default, it will be eth_output unless another output node was registered.
-		edge = edges[iface->type_id];
-		if (edge != ETH_OUTPUT)
+		edge = tunnels ? edges[iface->type_id] : ETH_OUTPUT;
+		if (edge != ETH_OUTPUT) {
+			// Tunnel nodes need the selected group member.
+			ip_output_mbuf_data(mbuf)->nh = nh;
 			goto next;
+		}
+
+		// TCP segmentation requests are handled by port_gso.
+		if (unlikely(iface->mtu != 0 && rte_be_to_cpu_16(ip->total_length) > iface->mtu)
+		    && !(mbuf->ol_flags & RTE_MBUF_F_TX_TCP_SEG)) {
+			// Keep the selected group member for ip_fragment and ip_error.
+			ip_output_mbuf_data(mbuf)->nh = nh;
+			if (ip->fragment_offset & RTE_BE16(RTE_IPV4_HDR_DF_FLAG))
+				edge = FRAG_NEEDED;
+			else
+				edge = FRAGMENT;
+			goto next;
+		}
 
 		if (nh->flags & GR_IP4_NH_F_LINK && ip->dst_addr != nh->ip) {
 			// The resolved next hop is associated with a "connected" route.
 			// We currently do not have an explicit entry for this destination IP.
-			// Create a new next hop and its associated /32 route so that next
-			// packets take it in priority with a single route lookup.
-			struct nexthop *remote = ip4_nexthop_new(
-				nh->vrf_id, nh->iface_id, ip->dst_addr
-			);
-			if (remote == NULL) {
-				edge = ERROR;
-				goto next;
+			// Creating a next hop and its /32 route is up to the control plane.
+			// Meanwhile, the packet waits in the connected next hop hold queue.
+			if (hold_link_packet(nh, mbuf) == HELD) {
+				gr_spec_stream_diverge(&s, graph, node, objs);
+				continue;
 			}
-			if (ip4_route_insert(nh->vrf_id, ip->dst_addr, 32, remote) < 0) {
-				edge = ERROR;
-				goto next;
-			}
-
-			ip_output_mbuf_data(mbuf)->nh = remote;
-			nh = remote;
+			edge = QUEUE_FULL;
+			goto next;
 		}
 
 		switch (maybe_hold_packet(nh, mbuf)) {
 		case HELD:
 			// The packet was stored in the next hop hold queue to be flushed upon
 			// reception of an ARP request or reply from the destination IP.
+			gr_spec_stream_diverge(&s, graph, node, objs);
 			continue;
 		case HOLD_QUEUE_FULL:
 			//
@@ -140,17 +175,46 @@ ip_output_process(struct rte_graph *graph, struct rte_node *node, void **objs, u
 
 		// Prepare ethernet layer info.
 		eth_data = eth_output_mbuf_data(mbuf);
-		eth_data->dst = nh->lladdr;
+		eth_output_set_dst(eth_data, &nh->lladdr, &nh->l2);
 		eth_data->ether_type = RTE_BE16(RTE_ETHER_TYPE_IPV4);
 		eth_data->iface = iface;
 		sent++;
 next:
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
+		gr_spec_stream_enqueue(&s, graph, node, objs, i, edge);
 	}
 
+	gr_spec_stream_flush(&s, graph, node);
+
 	return sent;
 }
 
+static uint16_t
+ip_output_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	return ip_output_burst(graph, node, objs, nb_objs, true);
+}
+
+static uint16_t ip_output_notunnel_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	return ip_output_burst(graph, node, objs, nb_objs, false);
+}
+
+// Skip the output node lookup when there are no interfaces with a registered
+// tunnel output node.
+static rte_node_process_t ip_output_specialize(void) {
+	const struct iface *iface = NULL;
+
+	while ((iface = iface_next(GR_IFACE_TYPE_UNDEF, iface)) != NULL) {
+		if (edges[iface->type_id] != ETH_OUTPUT)
+			return NULL;
+	}
+
+	return ip_output_notunnel_process;
+}
+
 static struct rte_node_register output_node = {
 	.name = "ip_output",
 	.process = ip_output_process,
@@ -160,14 +224,19 @@ static struct rte_node_register output_node = {
 		[NO_ROUTE] = "ip_error_dest_unreach",
 		[ERROR] = "ip_output_error",
 		[QUEUE_FULL] = "arp_queue_full",
+		[FRAGMENT] = "ip_fragment",
+		[FRAG_NEEDED] = "ip_error_frag_needed",
+		[LINK_DOWN] = "ip_output_link_down",
 	},
 };
 
 static struct gr_node_info info = {
 	.node = &output_node,
+	.specialize = ip_output_specialize,
 };
 
 GR_NODE_REGISTER(info);
 
 GR_DROP_REGISTER(ip_output_error);
+GR_DROP_REGISTER(ip_output_link_down);
 GR_DROP_REGISTER(arp_queue_full);
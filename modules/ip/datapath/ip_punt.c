@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_datapath.h>
+#include <gr_eth_input.h>
+#include <gr_graph.h>
+#include <gr_iface.h>
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+#include <gr_punt.h>
+
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_graph_worker.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+
+#include <netinet/in.h>
+
+enum {
+	PUNT = 0,
+	UNKNOWN_PROTO,
+	UNKNOWN_PORT,
+	PUNT_EDGE_COUNT,
+};
+
+// Local packets that no node handles. They are handed over to the kernel
+// device of the interface that owns the destination address, if any.
+static uint16_t
+ip_punt_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct ip_local_mbuf_data *ip_data;
+	struct iface_punt *punt;
+	struct punt_mbuf_data *d;
+	struct rte_mbuf *mbuf;
+	struct nexthop *nh;
+	rte_edge_t edge;
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+		ip_data = ip_local_mbuf_data(mbuf);
+		punt = NULL;
+
+		nh = ip4_route_lookup(ip_data->vrf_id, ip_data->dst);
+		if (nh != NULL && nh->iface != NULL)
+			punt = __atomic_load_n(&nh->iface->punt, __ATOMIC_ACQUIRE);
+		if (punt == NULL) {
+			edge = ip_data->proto == IPPROTO_UDP ? UNKNOWN_PORT : UNKNOWN_PROTO;
+			goto next;
+		}
+		d = punt_mbuf_data(mbuf);
+		d->punt = punt;
+		d->ether_type = RTE_BE16(RTE_ETHER_TYPE_IPV4);
+		edge = PUNT;
+next:
+		rte_node_enqueue_x1(graph, node, edge, mbuf);
+	}
+
+	return nb_objs;
+}
+
+static struct rte_node_register ip_punt_node = {
+	.name = "ip_punt",
+
+	.process = ip_punt_process,
+
+	.nb_edges = PUNT_EDGE_COUNT,
+	.next_nodes = {
+		[PUNT] = "punt_output",
+		[UNKNOWN_PROTO] = "ip_input_local_unknown_proto",
+		[UNKNOWN_PORT] = "udp_input_unknown_port",
+	},
+};
+
+static struct gr_node_info ip_punt_info = {
+	.node = &ip_punt_node,
+};
+
+GR_NODE_REGISTER(ip_punt_info);
+
+GR_DROP_REGISTER(ip_input_local_unknown_proto);
+GR_DROP_REGISTER(udp_input_unknown_port);
+
+enum {
+	OUTPUT = 0,
+	INVALID,
+	NO_ROUTE,
+	INJECT_EDGE_COUNT,
+};
+
+// Packets sent by the kernel. They are routed in the VRF of the interface that
+// owns the exception path, the kernel cannot resolve the next hops itself.
+static uint16_t
+ip_inject_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct ip_output_mbuf_data *o;
+	const struct iface *iface;
+	struct rte_ipv4_hdr *ip;
+	struct rte_mbuf *mbuf;
+	struct nexthop *nh;
+	rte_edge_t edge;
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+		iface = eth_input_mbuf_data(mbuf)->iface;
+		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+
+		if (unlikely(rte_pktmbuf_data_len(mbuf) < sizeof(*ip)
+			     || rte_pktmbuf_data_len(mbuf) < rte_ipv4_hdr_len(ip)
+			     || (ip->version_ihl >> 4) != 4)) {
+			edge = INVALID;
+			goto next;
+		}
+		if ((nh = ip4_route_lookup(iface->vrf_id, ip->dst_addr)) == NULL) {
+			edge = NO_ROUTE;
+			goto next;
+		}
+		o = ip_output_mbuf_data(mbuf);
+		o->nh = nh;
+		o->input_iface = NULL;
+		edge = OUTPUT;
+next:
+		rte_node_enqueue_x1(graph, node, edge, mbuf);
+	}
+
+	return nb_objs;
+}
+
+static void ip_inject_register(void) {
+	punt_input_register_type(RTE_BE16(RTE_ETHER_TYPE_IPV4), "ip_inject");
+}
+
+static struct rte_node_register ip_inject_node = {
+	.name = "ip_inject",
+
+	.process = ip_inject_process,
+
+	.nb_edges = INJECT_EDGE_COUNT,
+	.next_nodes = {
+		[OUTPUT] = "ip_output",
+		[INVALID] = "ip_inject_invalid",
+		[NO_ROUTE] = "ip_inject_no_route",
+	},
+};
+
+static struct gr_node_info ip_inject_info = {
+	.node = &ip_inject_node,
+	.register_callback = ip_inject_register,
+};
+
+GR_NODE_REGISTER(ip_inject_info);
+
+GR_DROP_REGISTER(ip_inject_invalid);
+GR_DROP_REGISTER(ip_inject_no_route);
@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_datapath.h>
+#include <gr_graph.h>
+#include <gr_ip4_datapath.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+
+#include <rte_byteorder.h>
+#include <rte_graph_worker.h>
+#include <rte_mbuf.h>
+#include <rte_udp.h>
+
+#include <netinet/in.h>
+
+enum {
+	UNKNOWN_PORT = 0,
+	INVALID,
+	EDGE_COUNT,
+};
+
+// Indexed by destination port in network order.
+static rte_edge_t edges[UINT16_MAX + 1] = {UNKNOWN_PORT};
+
+void udp_input_register_port(rte_be16_t dst_port, const char *next_node) {
+	LOG(DEBUG, "udp_input: port=%hu -> %s", rte_be_to_cpu_16(dst_port), next_node);
+	if (edges[dst_port] != UNKNOWN_PORT)
+		ABORT("next node already registered for udp port=%hu", rte_be_to_cpu_16(dst_port));
+	edges[dst_port] = gr_node_attach_parent("udp_input", next_node);
+}
+
+static uint16_t
+udp_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct ip_local_mbuf_data *ip_data;
+	struct gr_spec_stream s;
+	struct rte_udp_hdr *udp;
+	struct rte_mbuf *mbuf;
+	rte_edge_t edge;
+
+	gr_spec_stream_init(&s, node, nb_objs);
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+		ip_data = ip_local_mbuf_data(mbuf);
+
+		if (unlikely(ip_data->len < sizeof(*udp)
+			     || rte_pktmbuf_data_len(mbuf) < sizeof(*udp))) {
+			edge = INVALID;
+			goto next;
+		}
+		udp = rte_pktmbuf_mtod(mbuf, struct rte_udp_hdr *);
+		edge = edges[udp->dst_port];
+		if (edge != UNKNOWN_PORT) {
+			// Checksums are left to the next node. Tunnel protocols
+			// usually send them as zero.
+			ip_data->len -= sizeof(*udp);
+			rte_pktmbuf_adj(mbuf, sizeof(*udp));
+		} else {
+			// ip_punt hands over the whole datagram to the kernel
+			rte_pktmbuf_prepend(mbuf, sizeof(struct rte_ipv4_hdr));
+		}
+next:
+		gr_spec_stream_enqueue(&s, graph, node, objs, i, edge);
+	}
+	gr_spec_stream_flush(&s, graph, node);
+
+	return nb_objs;
+}
+
+static void udp_input_register(void) {
+	ip_input_local_add_proto(IPPROTO_UDP, "udp_input");
+}
+
+static struct rte_node_register udp_input_node = {
+	.name = "udp_input",
+
+	.process = udp_input_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[UNKNOWN_PORT] = "ip_punt",
+		[INVALID] = "udp_input_invalid",
+	},
+};
+
+static struct gr_node_info udp_input_info = {
+	.node = &udp_input_node,
+	.register_callback = udp_input_register,
+};
+
+GR_NODE_REGISTER(udp_input_info);
+
+GR_DROP_REGISTER(udp_input_invalid);
@@ -27,6 +27,8 @@ struct gr_ip6_ifaddr {
 #define GR_IP6_NH_F_GATEWAY GR_BIT16(6) // Gateway route
 #define GR_IP6_NH_F_LINK GR_BIT16(7) // Connected link route
 #define GR_IP6_NH_F_MCAST GR_BIT16(8) // Multicast address
+#define GR_IP6_NH_F_GROUP GR_BIT16(9) // ECMP next hop group
+#define GR_IP6_NH_F_DOWN GR_BIT16(10) // Output interface link is down
 typedef uint16_t gr_ip6_nh_flags_t;
 
 static inline const char *gr_ip6_nh_f_name(const gr_ip6_nh_flags_t flag) {
@@ -49,6 +51,10 @@ static inline const char *gr_ip6_nh_f_name(const gr_ip6_nh_flags_t flag) {
 		return "link";
 	case GR_IP6_NH_F_MCAST:
 		return "multicast";
+	case GR_IP6_NH_F_GROUP:
+		return "group";
+	case GR_IP6_NH_F_DOWN:
+		return "down";
 	}
 	return "";
 }
@@ -63,6 +69,9 @@ struct gr_ip6_nh {
 	gr_ip6_nh_flags_t flags;
 	uint16_t age; //<! number of seconds since last update
 	uint16_t held_pkts;
+	uint32_t held_total; //<! number of packets held since creation
+	uint32_t flushed_total; //<! held packets sent after resolution
+	uint32_t expired_total; //<! held packets dropped after the hold timeout
 };
 
 struct gr_ip6_route {
@@ -95,15 +104,85 @@ struct gr_ip6_nh_del_req {
 
 #define GR_IP6_NH_LIST REQUEST_TYPE(GR_IP6_MODULE, 0x0003)
 
+// Start with a zero cursor and send as many requests as needed with the
+// next_cursor of the previous response, until next_cursor is zero.
 struct gr_ip6_nh_list_req {
 	uint16_t vrf_id;
+	uint32_t cursor;
 };
 
 struct gr_ip6_nh_list_resp {
+	uint32_t next_cursor; // zero when all next hops have been listed
 	uint16_t n_nhs;
 	struct gr_ip6_nh nhs[/* n_nhs */];
 };
 
+#define GR_IP6_NH_ADD_BULK REQUEST_TYPE(GR_IP6_MODULE, 0x0007)
+
+struct gr_ip6_nh_add_bulk_req {
+	uint8_t exist_ok;
+	uint16_t n_nhs;
+	struct gr_ip6_nh nhs[/* n_nhs */];
+};
+
+// struct gr_ip6_nh_add_bulk_resp = struct gr_api_bulk_resp
+
+#define GR_IP6_NH_DEL_BULK REQUEST_TYPE(GR_IP6_MODULE, 0x0008)
+
+struct gr_ip6_nh_del_bulk_req {
+	uint16_t vrf_id;
+	uint8_t missing_ok;
+	uint16_t n_hosts;
+	struct rte_ipv6_addr hosts[/* n_hosts */];
+};
+
+// struct gr_ip6_nh_del_bulk_resp = struct gr_api_bulk_resp
+
+// next hop groups /////////////////////////////////////////////////////////////
+
+// Max number of members in a next hop group.
+#define GR_IP6_NH_GROUP_MAX_NHS 64
+
+struct gr_ip6_nh_group {
+	uint32_t id;
+	uint16_t vrf_id;
+	uint8_t n_nhs;
+	uint32_t n_routes; //<! number of routes referencing this group
+	struct rte_ipv6_addr nhs[GR_IP6_NH_GROUP_MAX_NHS];
+};
+
+#define GR_IP6_NH_GROUP_ADD REQUEST_TYPE(GR_IP6_MODULE, 0x0004)
+
+struct gr_ip6_nh_group_add_req {
+	uint32_t id;
+	uint16_t vrf_id;
+	uint8_t exist_ok; // replace the members of an existing group
+	uint8_t n_nhs;
+	struct rte_ipv6_addr nhs[/* n_nhs */];
+};
+
+// struct gr_ip6_nh_group_add_resp { };
+
+#define GR_IP6_NH_GROUP_DEL REQUEST_TYPE(GR_IP6_MODULE, 0x0005)
+
+struct gr_ip6_nh_group_del_req {
+	uint32_t id;
+	uint8_t missing_ok;
+};
+
+// struct gr_ip6_nh_group_del_resp { };
+
+#define GR_IP6_NH_GROUP_LIST REQUEST_TYPE(GR_IP6_MODULE, 0x0006)
+
+struct gr_ip6_nh_group_list_req {
+	uint16_t vrf_id;
+};
+
+struct gr_ip6_nh_group_list_resp {
+	uint16_t n_groups;
+	struct gr_ip6_nh_group groups[/* n_groups */];
+};
+
 // routes //////////////////////////////////////////////////////////////////////
 
 #define GR_IP6_ROUTE_ADD REQUEST_TYPE(GR_IP6_MODULE, 0x0010)
@@ -112,6 +191,7 @@ struct gr_ip6_route_add_req {
 	uint16_t vrf_id;
 	struct ip6_net dest;
 	struct rte_ipv6_addr nh;
+	uint32_t nh_group_id; // use this next hop group instead of nh when non-zero
 	uint8_t exist_ok;
 };
 
@@ -140,15 +220,89 @@ struct gr_ip6_route_get_resp {
 
 #define GR_IP6_ROUTE_LIST REQUEST_TYPE(GR_IP6_MODULE, 0x0013)
 
+// Large tables are listed in multiple pages. Start with a zero cursor and
+// send as many requests as needed with the next_cursor and last fields of the
+// previous response, until next_cursor is zero.
 struct gr_ip6_route_list_req {
 	uint16_t vrf_id;
+	uint32_t cursor;
+	struct ip6_net last;
 };
 
 struct gr_ip6_route_list_resp {
+	uint32_t next_cursor; // zero when all routes have been listed
+	struct ip6_net last; // last destination in this page
 	uint16_t n_routes;
 	struct gr_ip6_route routes[/* n_routes */];
 };
 
+// Max number of next hops of a multipath route.
+#define GR_IP6_ROUTE_MAX_NHS GR_IP6_NH_GROUP_MAX_NHS
+
+#define GR_IP6_ROUTE_ADD_MULTIPATH REQUEST_TYPE(GR_IP6_MODULE, 0x0014)
+
+struct gr_ip6_route_add_multipath_req {
+	uint16_t vrf_id;
+	struct ip6_net dest;
+	uint8_t exist_ok; // replace the next hops of an existing multipath route
+	uint8_t n_nhs;
+	struct rte_ipv6_addr nhs[/* n_nhs */];
+};
+
+// struct gr_ip6_route_add_multipath_resp { };
+
+#define GR_IP6_ROUTE_ADD_BULK REQUEST_TYPE(GR_IP6_MODULE, 0x0015)
+
+struct gr_ip6_route_add_bulk_req {
+	uint16_t vrf_id;
+	uint8_t exist_ok;
+	uint16_t n_routes;
+	struct gr_ip6_route routes[/* n_routes */];
+};
+
+// struct gr_ip6_route_add_bulk_resp = struct gr_api_bulk_resp
+
+#define GR_IP6_ROUTE_DEL_BULK REQUEST_TYPE(GR_IP6_MODULE, 0x0016)
+
+struct gr_ip6_route_del_bulk_req {
+	uint16_t vrf_id;
+	uint8_t missing_ok;
+	uint16_t n_dests;
+	struct ip6_net dests[/* n_dests */];
+};
+
+// struct gr_ip6_route_del_bulk_resp = struct gr_api_bulk_resp
+
+#define GR_IP6_ROUTE_LOOKUP_BULK REQUEST_TYPE(GR_IP6_MODULE, 0x0017)
+
+// Same as GR_IP4_ROUTE_LOOKUP_BULK.
+struct gr_ip6_route_lookup {
+	uint16_t vrf_id;
+	struct ip6_net dest; // prefixlen is ignored unless exact is set
+};
+
+struct gr_ip6_route_lookup_bulk_req {
+	uint8_t exact;
+	uint16_t n_lookups;
+	struct gr_ip6_route_lookup lookups[/* n_lookups */];
+};
+
+// ECMP routes report their first member with GR_IP6_NH_F_GROUP added to flags.
+struct gr_ip6_route_lookup_result {
+	uint32_t status; // zero, ENETUNREACH when no route matched or ENOENT (exact)
+	struct rte_ipv6_addr nh;
+	uint16_t nh_vrf_id;
+	uint16_t iface_id;
+	gr_ip6_nh_flags_t flags;
+};
+
+// The response must fit in GR_API_MAX_MSG_LEN, requests with too many lookups
+// fail with ERANGE.
+struct gr_ip6_route_lookup_bulk_resp {
+	uint16_t n_results;
+	struct gr_ip6_route_lookup_result results[/* n_results */];
+};
+
 // addresses ///////////////////////////////////////////////////////////////////
 
 #define GR_IP6_ADDR_ADD REQUEST_TYPE(GR_IP6_MODULE, 0x0021)
@@ -171,13 +325,96 @@ struct gr_ip6_addr_del_req {
 
 #define GR_IP6_ADDR_LIST REQUEST_TYPE(GR_IP6_MODULE, 0x0023)
 
+// Start with a zero cursor and send as many requests as needed with the
+// next_cursor of the previous response, until next_cursor is zero. The cursor
+// is opaque, it points at an address of an interface so that pages may end in
+// the middle of an interface.
 struct gr_ip6_addr_list_req {
 	uint16_t vrf_id;
+	uint32_t cursor;
 };
 
 struct gr_ip6_addr_list_resp {
+	uint32_t next_cursor; // zero when all addresses have been listed
 	uint16_t n_addrs;
 	struct gr_ip6_ifaddr addrs[/* n_addrs */];
 };
 
+// FIB configuration ///////////////////////////////////////////////////////////
+
+#define GR_IP6_FIB_AUTO 0 // reduced while small, TRIE above a threshold, grown when full
+#define GR_IP6_FIB_TRIE 1 // fastest lookups, fixed 2^24 entries first level table
+#define GR_IP6_FIB_REDUCED 2 // TRIE with few tbl8 groups, same 64MB tbl24
+
+struct gr_ip6_fib_conf {
+	uint16_t vrf_id;
+	uint8_t type; // GR_IP6_FIB_*
+	uint8_t active_type; //<! type of the current table (output only)
+	uint32_t max_routes; // 0 for default
+	uint32_t num_tbl8; // number of extension tables, 0 for default
+	uint8_t nh_size; // next hop size in bytes, 0 for default
+	uint32_t n_routes; //<! number of configured routes (output only)
+	uint64_t mem_size; //<! estimated memory usage in bytes (output only)
+};
+
+#define GR_IP6_FIB_SET REQUEST_TYPE(GR_IP6_MODULE, 0x0030)
+
+struct gr_ip6_fib_set_req {
+	struct gr_ip6_fib_conf conf;
+};
+
+struct gr_ip6_fib_set_resp {
+	struct gr_ip6_fib_conf conf;
+};
+
+#define GR_IP6_FIB_LIST REQUEST_TYPE(GR_IP6_MODULE, 0x0031)
+
+// struct gr_ip6_fib_list_req { };
+
+struct gr_ip6_fib_list_resp {
+	uint16_t n_fibs;
+	struct gr_ip6_fib_conf fibs[/* n_fibs */];
+};
+
+// ICMP errors rate limiting ///////////////////////////////////////////////////
+
+struct gr_ip6_icmp_limit {
+	uint8_t icmp_type; // ICMPv6 destination unreachable (1) or time exceeded (3)
+	uint32_t rate; // max number of errors per second and per worker, 0 for unlimited
+	uint32_t burst; // max number of errors sent at once, 0 for default
+};
+
+#define GR_IP6_ICMP_LIMIT_SET REQUEST_TYPE(GR_IP6_MODULE, 0x0040)
+
+struct gr_ip6_icmp_limit_set_req {
+	struct gr_ip6_icmp_limit limit;
+};
+
+// struct gr_ip6_icmp_limit_set_resp { };
+
+#define GR_IP6_ICMP_LIMIT_LIST REQUEST_TYPE(GR_IP6_MODULE, 0x0041)
+
+// struct gr_ip6_icmp_limit_list_req { };
+
+struct gr_ip6_icmp_limit_list_resp {
+	uint16_t n_limits;
+	struct gr_ip6_icmp_limit limits[/* n_limits */];
+};
+
+// events //////////////////////////////////////////////////////////////////////
+
+// The event object is a struct gr_ip6_nh. Next hop state changes made by the
+// datapath workers are reported by the next aging check.
+#define GR_IP6_EVENT_NH_UPDATE EVENT_TYPE(GR_IP6_MODULE, 0x0001) // coalesced
+#define GR_IP6_EVENT_NH_DEL EVENT_TYPE(GR_IP6_MODULE, 0x0002)
+
+// ECMP routes are reported with one event per group member.
+#define GR_IP6_EVENT_ROUTE_ADD EVENT_TYPE(GR_IP6_MODULE, 0x0010)
+#define GR_IP6_EVENT_ROUTE_DEL EVENT_TYPE(GR_IP6_MODULE, 0x0011)
+
+struct gr_ip6_route_event {
+	uint16_t vrf_id;
+	struct gr_ip6_route route;
+};
+
 #endif
@@ -64,31 +64,35 @@ static cmd_status_t addr_list(const struct gr_api_client *c, const struct ec_pno
 		return CMD_ERROR;
 	}
 
-	if (gr_api_client_send_recv(c, GR_IP6_ADDR_LIST, sizeof(req), &req, &resp_ptr) < 0) {
-		scols_unref_table(table);
-		return CMD_ERROR;
-	}
-
-	resp = resp_ptr;
-
 	scols_table_new_column(table, "IFACE", 0, 0);
 	scols_table_new_column(table, "ADDRESS", 0, 0);
 	scols_table_set_column_separator(table, "  ");
 
-	for (size_t i = 0; i < resp->n_addrs; i++) {
-		struct libscols_line *line = scols_table_new_line(table, NULL);
-		const struct gr_ip6_ifaddr *addr = &resp->addrs[i];
-		ip6_net_format(&addr->addr, buf, sizeof(buf));
-		if (iface_from_id(c, addr->iface_id, &iface) == 0)
-			scols_line_sprintf(line, 0, "%s", iface.name);
-		else
-			scols_line_sprintf(line, 0, "%u", addr->iface_id);
-		scols_line_sprintf(line, 1, "%s", buf);
-	}
-
-	scols_print_table(table);
+	do {
+		if (gr_api_client_send_recv(c, GR_IP6_ADDR_LIST, sizeof(req), &req, &resp_ptr)
+		    < 0) {
+			scols_unref_table(table);
+			return CMD_ERROR;
+		}
+
+		resp = resp_ptr;
+		for (size_t i = 0; i < resp->n_addrs; i++) {
+			struct libscols_line *line = scols_table_new_line(table, NULL);
+			const struct gr_ip6_ifaddr *addr = &resp->addrs[i];
+			ip6_net_format(&addr->addr, buf, sizeof(buf));
+			if (iface_from_id(c, addr->iface_id, &iface) == 0)
+				scols_line_sprintf(line, 0, "%s", iface.name);
+			else
+				scols_line_sprintf(line, 0, "%u", addr->iface_id);
+			scols_line_sprintf(line, 1, "%s", buf);
+		}
+
+		req.cursor = resp->next_cursor;
+		free(resp_ptr);
+	} while (req.cursor != 0);
+
+	gr_table_print(table);
 	scols_unref_table(table);
-	free(resp_ptr);
 
 	return CMD_SUCCESS;
 }
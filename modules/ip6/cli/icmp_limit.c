@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "ip.h"
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_ip6.h>
+#include <gr_table.h>
+
+#include <ecoli.h>
+#include <libsmartcols.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ICMP_DEST_UNREACH 1
+#define ICMP_TTL_EXCEEDED 3
+
+static const char *icmp_type_name(uint8_t type) {
+	switch (type) {
+	case ICMP_DEST_UNREACH:
+		return "dest-unreach";
+	case ICMP_TTL_EXCEEDED:
+		return "ttl-exceeded";
+	}
+	return "?";
+}
+
+static cmd_status_t icmp_limit_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_ip6_icmp_limit_set_req req = {0};
+	const char *type = arg_str(p, "TYPE");
+
+	if (type == NULL)
+		return CMD_ERROR;
+	if (strcmp(type, "dest-unreach") == 0)
+		req.limit.icmp_type = ICMP_DEST_UNREACH;
+	else
+		req.limit.icmp_type = ICMP_TTL_EXCEEDED;
+	if (arg_u32(p, "RATE", &req.limit.rate) < 0)
+		return CMD_ERROR;
+	if (arg_u32(p, "BURST", &req.limit.burst) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_IP6_ICMP_LIMIT_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t icmp_limit_list(const struct gr_api_client *c, const struct ec_pnode *) {
+	struct libscols_table *table = scols_new_table();
+	const struct gr_ip6_icmp_limit_list_resp *resp;
+	void *resp_ptr = NULL;
+
+	if (table == NULL)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_IP6_ICMP_LIMIT_LIST, 0, NULL, &resp_ptr) < 0) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+
+	resp = resp_ptr;
+	scols_table_new_column(table, "TYPE", 0, 0);
+	scols_table_new_column(table, "RATE", 0, 0);
+	scols_table_new_column(table, "BURST", 0, 0);
+	scols_table_set_column_separator(table, "  ");
+
+	for (size_t i = 0; i < resp->n_limits; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_ip6_icmp_limit *l = &resp->limits[i];
+		scols_line_sprintf(line, 0, "%s", icmp_type_name(l->icmp_type));
+		if (l->rate == 0)
+			scols_line_sprintf(line, 1, "unlimited");
+		else
+			scols_line_sprintf(line, 1, "%u/s", l->rate);
+		scols_line_sprintf(line, 2, "%u", l->burst);
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		IP6_SET_CTX(root),
+		"icmp-limit TYPE rate RATE [burst BURST]",
+		icmp_limit_set,
+		"Limit the number of ICMPv6 errors sent per second by each worker.",
+		with_help("ICMPv6 error type.", ec_node_re("TYPE", "dest-unreach|ttl-exceeded")),
+		with_help(
+			"Max errors per second, 0 for unlimited.",
+			ec_node_uint("RATE", 0, UINT32_MAX, 10)
+		),
+		with_help("Max errors sent at once.", ec_node_uint("BURST", 1, UINT32_MAX, 10))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		IP6_SHOW_CTX(root), "icmp-limit", icmp_limit_list, "Show ICMPv6 errors rate limits."
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "ipv6 icmp limit",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+}
@@ -14,9 +14,58 @@
 #include <libsmartcols.h>
 
 #include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static cmd_status_t route6_add_multipath(
+	const struct gr_api_client *c,
+	const struct ec_pnode *p,
+	unsigned n_nhs
+) {
+	struct gr_ip6_route_add_multipath_req *req;
+	const struct ec_pnode *n;
+	cmd_status_t ret = CMD_ERROR;
+	size_t len;
+
+	if (n_nhs > GR_IP6_ROUTE_MAX_NHS) {
+		errno = ERANGE;
+		return CMD_ERROR;
+	}
+	len = sizeof(*req) + n_nhs * sizeof(req->nhs[0]);
+	if ((req = calloc(1, len)) == NULL)
+		return CMD_ERROR;
+
+	req->exist_ok = true;
+	if (ip6_net_parse(arg_str(p, "DEST"), &req->dest, true) < 0)
+		goto out;
+	for (n = ec_pnode_find(p, "NH"); n != NULL; n = ec_pnode_find_next(p, n, "NH", false)) {
+		const struct ec_strvec *v = ec_pnode_get_strvec(n);
+		if (inet_pton(AF_INET6, ec_strvec_val(v, 0), &req->nhs[req->n_nhs++]) != 1) {
+			errno = EINVAL;
+			goto out;
+		}
+	}
+	if (arg_u16(p, "VRF", &req->vrf_id) < 0 && errno != ENOENT)
+		goto out;
+
+	if (gr_api_client_send_recv(c, GR_IP6_ROUTE_ADD_MULTIPATH, len, req, NULL) < 0)
+		goto out;
+
+	ret = CMD_SUCCESS;
+out:
+	free(req);
+	return ret;
+}
 
 static cmd_status_t route6_add(const struct gr_api_client *c, const struct ec_pnode *p) {
 	struct gr_ip6_route_add_req req = {.exist_ok = true};
+	const struct ec_pnode *n;
+	unsigned n_nhs = 0;
+
+	for (n = ec_pnode_find(p, "NH"); n != NULL; n = ec_pnode_find_next(p, n, "NH", false))
+		n_nhs++;
+	if (n_nhs > 1)
+		return route6_add_multipath(c, p, n_nhs);
 
 	if (ip6_net_parse(arg_str(p, "DEST"), &req.dest, true) < 0)
 		return CMD_ERROR;
@@ -33,6 +82,22 @@ static cmd_status_t route6_add(const struct gr_api_client *c, const struct ec_pn
 	return CMD_SUCCESS;
 }
 
+static cmd_status_t route6_add_group(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_ip6_route_add_req req = {.exist_ok = true};
+
+	if (ip6_net_parse(arg_str(p, "DEST"), &req.dest, true) < 0)
+		return CMD_ERROR;
+	if (arg_u32(p, "ID", &req.nh_group_id) < 0)
+		return CMD_ERROR;
+	if (arg_u16(p, "VRF", &req.vrf_id) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_IP6_ROUTE_ADD, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
 static cmd_status_t route6_del(const struct gr_api_client *c, const struct ec_pnode *p) {
 	struct gr_ip6_route_del_req req = {.missing_ok = true};
 
@@ -60,28 +125,35 @@ static cmd_status_t route6_list(const struct gr_api_client *c, const struct ec_p
 	if (arg_u16(p, "VRF", &req.vrf_id) < 0 && errno != ENOENT)
 		return CMD_ERROR;
 
-	if (gr_api_client_send_recv(c, GR_IP6_ROUTE_LIST, sizeof(req), &req, &resp_ptr) < 0) {
-		scols_unref_table(table);
-		return CMD_ERROR;
-	}
-
-	resp = resp_ptr;
 	scols_table_new_column(table, "DESTINATION", 0, 0);
 	scols_table_new_column(table, "NEXT_HOP", 0, 0);
 	scols_table_set_column_separator(table, "  ");
 
-	for (size_t i = 0; i < resp->n_routes; i++) {
-		struct libscols_line *line = scols_table_new_line(table, NULL);
-		const struct gr_ip6_route *route = &resp->routes[i];
-		ip6_net_format(&route->dest, dest, sizeof(dest));
-		inet_ntop(AF_INET6, &route->nh, nh, sizeof(nh));
-		scols_line_set_data(line, 0, dest);
-		scols_line_set_data(line, 1, nh);
-	}
+	do {
+		if (gr_api_client_send_recv(c, GR_IP6_ROUTE_LIST, sizeof(req), &req, &resp_ptr)
+		    < 0) {
+			scols_unref_table(table);
+			return CMD_ERROR;
+		}
+
+		resp = resp_ptr;
+		for (size_t i = 0; i < resp->n_routes; i++) {
+			struct libscols_line *line = scols_table_new_line(table, NULL);
+			const struct gr_ip6_route *route = &resp->routes[i];
+			ip6_net_format(&route->dest, dest, sizeof(dest));
+			inet_ntop(AF_INET6, &route->nh, nh, sizeof(nh));
+			scols_line_set_data(line, 0, dest);
+			scols_line_set_data(line, 1, nh);
+		}
+
+		req.cursor = resp->next_cursor;
+		req.last = resp->last;
+		free(resp_ptr);
+		gr_table_flush(table);
+	} while (req.cursor != 0);
 
-	scols_print_table(table);
+	gr_table_print(table);
 	scols_unref_table(table);
-	free(resp_ptr);
 
 	return CMD_SUCCESS;
 }
@@ -127,13 +199,24 @@ static int ctx_init(struct ec_node *root) {
 
 	ret = CLI_COMMAND(
 		IP6_ADD_CTX(root),
-		"route DEST via NH [vrf VRF]",
+		"route DEST via NH+ [vrf VRF]",
 		route6_add,
-		"Add a new route.",
+		"Add a new route. Multiple next hops create an ECMP route.",
 		with_help("IPv6 destination prefix.", ec_node_re("DEST", IPV6_NET_RE)),
 		with_help("IPv6 next hop address.", ec_node_re("NH", IPV6_RE)),
 		with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10))
 	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		IP6_ADD_CTX(root),
+		"route DEST group ID [vrf VRF]",
+		route6_add_group,
+		"Add a new route via a next hop group.",
+		with_help("IPv6 destination prefix.", ec_node_re("DEST", IPV6_NET_RE)),
+		with_help("Next hop group ID.", ec_node_uint("ID", 1, UINT16_MAX - 1, 10)),
+		with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10))
+	);
 	if (ret < 0)
 		return ret;
 	ret = CLI_COMMAND(
@@ -160,6 +243,27 @@ static int ctx_init(struct ec_node *root) {
 	return 0;
 }
 
+static void route6_event_print(const struct gr_api_client *, const void *obj) {
+	const struct gr_ip6_route_event *ev = obj;
+
+	printf("vrf=%u " IPV6_ADDR_FMT "/%hhu via " IPV6_ADDR_FMT,
+	       ev->vrf_id,
+	       IPV6_ADDR_SPLIT(&ev->route.dest.ip),
+	       ev->route.dest.prefixlen,
+	       IPV6_ADDR_SPLIT(&ev->route.nh));
+}
+
+static struct cli_event_type route6_add_event = {
+	.ev_type = GR_IP6_EVENT_ROUTE_ADD,
+	.name = "ip6 route add",
+	.print = route6_event_print,
+};
+static struct cli_event_type route6_del_event = {
+	.ev_type = GR_IP6_EVENT_ROUTE_DEL,
+	.name = "ip6 route del",
+	.print = route6_event_print,
+};
+
 static struct gr_cli_context ctx = {
 	.name = "ipv6 route",
 	.init = ctx_init,
@@ -167,4 +271,6 @@ static struct gr_cli_context ctx = {
 
 static void __attribute__((constructor, used)) init(void) {
 	register_context(&ctx);
+	register_event_type(&route6_add_event);
+	register_event_type(&route6_del_event);
 }
@@ -4,8 +4,11 @@
 #ifndef _GR_IP6_CONTROL
 #define _GR_IP6_CONTROL
 
+#include <gr_iface.h>
 #include <gr_ip6.h>
 #include <gr_net_types.h>
+#include <gr_nh_group.h>
+#include <gr_nh_neigh.h>
 
 #include <rte_ether.h>
 #include <rte_fib6.h>
@@ -14,25 +17,52 @@
 #include <rte_rcu_qsbr.h>
 #include <rte_spinlock.h>
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <sys/queue.h>
 
 struct __rte_cache_aligned nexthop6 {
+	// Fields read by datapath workers for every packet. They are only written
+	// on state changes and must share the first cache line.
 	gr_ip6_nh_flags_t flags;
-	struct rte_ether_addr lladdr;
 	uint16_t vrf_id;
 	uint16_t iface_id;
 	struct rte_ipv6_addr ip;
-	uint64_t last_request, last_reply;
-	uint32_t ref_count; // number of routes (or interfaces) referencing this nexthop
+	// ethernet header for lladdr, built by eth_output
+	struct eth_l2_rewrite l2;
+	// ECMP members, only set on GR_IP6_NH_F_GROUP next hops
+	struct nh_group *group;
+
+	// Mutable bookkeeping, on a separate cache line so that updating it does
+	// not invalidate the line above for all workers.
+	// lladdr is only read when building l2 and does not fit above.
+	alignas(RTE_CACHE_LINE_SIZE) struct rte_ether_addr lladdr;
 	uint8_t prefixlen;
-	uint8_t ucast_probes : 4, mcast_probes : 4;
+	// NDP resolution state, held packets and aging
+	struct nh_neigh neigh;
+	// index in the FIB next hop tables, assigned once and kept when freed
+	uint32_t id;
+	uint32_t ref_count; // number of routes (or interfaces) referencing this nexthop
+	// set while a solicitation for this next hop is queued to control_input
+	bool solicit_queued;
+	// last flags reported to the API event subscribers
+	gr_ip6_nh_flags_t ev_flags;
+	// set on host next hops learned from the datapath, see IP6_NH_LEARN_MAX
+	bool learned;
+	TAILQ_ENTRY(nexthop6) lru;
 	rte_spinlock_t lock;
-	// packets waiting for NDP resolution
-	uint16_t held_pkts_num;
-	struct rte_mbuf *held_pkts_head;
-	struct rte_mbuf *held_pkts_tail;
 };
 
+static_assert(offsetof(struct nexthop6, group) + sizeof(void *) <= RTE_CACHE_LINE_SIZE);
+// The neighbor state machine updates these flags in place.
+static_assert(GR_IP6_NH_F_PENDING == NH_NEIGH_F_PENDING);
+static_assert(GR_IP6_NH_F_REACHABLE == NH_NEIGH_F_REACHABLE);
+static_assert(GR_IP6_NH_F_STALE == NH_NEIGH_F_STALE);
+static_assert(GR_IP6_NH_F_FAILED == NH_NEIGH_F_FAILED);
+static_assert(GR_IP6_NH_F_STATIC == NH_NEIGH_F_STATIC);
+static_assert(GR_IP6_NH_F_GATEWAY == NH_NEIGH_F_GATEWAY);
+
 #define IP6_HOPLIST_MAX_SIZE 16
 
 struct hoplist6 {
@@ -40,34 +70,139 @@ struct hoplist6 {
 	struct nexthop6 *nh[IP6_HOPLIST_MAX_SIZE];
 };
 
-// Max number of packets to hold per next hop waiting for resolution (default: 256).
-#define IP6_NH_MAX_HELD_PKTS 256
-// Reachable next hop lifetime after last NDP reply received (default: 20 min).
-#define IP6_NH_LIFETIME_REACHABLE (20 * 60)
-// Unreachable next hop lifetime after last unreplied NDP request was sent (default: 1 min).
-#define IP6_NH_LIFETIME_UNREACHABLE 60
-// Max number of unicast NDP probes to send after IP6_NH_LIFETIME_REACHABLE.
-#define IP6_NH_UCAST_PROBES 3
-// Max number of multicast NDP probes to send after unicast probes failed.
-#define IP6_NH_MCAST_PROBES 3
+// Max number of NDP solicitations sent per second per interface and per worker.
+#define IP6_NH_SOLICIT_RATE 100
+// Max number of NDP solicitations sent in a burst per interface and per worker.
+#define IP6_NH_SOLICIT_BURST 32
+// Max number of pending host route learning requests posted by datapath workers.
+#define IP6_NH_LEARN_RING_SIZE 1024
+// Max number of host routes created by the control plane per event loop iteration.
+#define IP6_NH_LEARN_BURST 64
+// Max number of host routes learned from the datapath. Beyond that, the least
+// recently used ones are evicted.
+#define IP6_NH_LEARN_MAX (IP6_MAX_NEXT_HOPS / 4)
+// Max number of learned host routes examined to find one to evict.
+#define IP6_NH_EVICT_SCAN 8
+// Max number of free next hops cached per lcore.
+#define IP6_NH_POOL_CACHE_SIZE 64
 
 // XXX: why not 1337, eh?
 #define IP6_MAX_NEXT_HOPS (1 << 16)
 #define IP6_MAX_ROUTES (1 << 16)
+// VRFs with fewer routes use a FIB with fewer tbl8 groups, unless configured otherwise.
+#define IP6_FIB_REDUCED_MAX_ROUTES 1024
+// Number of tbl8 groups of reduced FIBs. Each prefix longer than /24 needs one
+// group per additional byte that it does not share with other routes.
+#define IP6_FIB_REDUCED_NUM_TBL8 1024
+// GR_IP6_FIB_AUTO tables are grown when full, up to this number of routes.
+#define IP6_FIB_AUTO_MAX_ROUTES (1 << 20)
 #define IP6_MAX_VRFS 256
+#define IP6_MAX_NH_GROUPS (1 << 16)
 
 struct nexthop6 *ip6_nexthop_lookup(uint16_t vrf_id, const struct rte_ipv6_addr *);
 struct nexthop6 *ip6_nexthop_new(uint16_t vrf_id, uint16_t iface_id, const struct rte_ipv6_addr *);
 void ip6_nexthop_incref(struct nexthop6 *);
 void ip6_nexthop_decref(struct nexthop6 *);
+// Mark a next hop as carrying traffic.
+static inline void ip6_nexthop_touch(struct nexthop6 *nh) {
+	nh_neigh_touch(&nh->neigh);
+}
+// Create an ECMP group next hop. Each member is referenced by the group.
+struct nexthop6 *
+ip6_nexthop_group_new(uint16_t vrf_id, unsigned n, struct nexthop6 *const *members);
+// Replace the members of an ECMP group. Flows of unchanged members keep their next hop.
+int ip6_nexthop_group_set(struct nexthop6 *group, unsigned n, struct nexthop6 *const *members);
+// Get a next hop group by its user assigned ID.
+struct nexthop6 *ip6_nexthop_group_get(uint32_t id);
+// Lookup (or create) the gateway next hops of a group. All ips must be routable.
+int ip6_nexthop_group_members(
+	uint16_t vrf_id,
+	unsigned n,
+	const struct rte_ipv6_addr *ips,
+	struct nexthop6 **members
+);
+// Release the members returned by ip6_nexthop_group_members that are not referenced.
+void ip6_nexthop_group_members_put(unsigned n, struct nexthop6 **members);
+// Request the asynchronous creation of a /128 host route by the control plane.
+// These functions are safe to call from datapath workers.
+int ip6_nexthop_learn(
+	uint16_t vrf_id,
+	uint16_t iface_id,
+	const struct rte_ipv6_addr *ip,
+	struct rte_ether_addr lladdr
+);
+int ip6_nexthop_learn_held(const struct nexthop6 *link);
 
 int ip6_route_insert(uint16_t vrf_id, const struct rte_ipv6_addr *, uint8_t prefixlen, struct nexthop6 *);
 int ip6_route_delete(uint16_t vrf_id, const struct rte_ipv6_addr *, uint8_t prefixlen);
+// Delete multiple routes without waiting for RCU grace periods. The errno value of
+// each deletion is stored in status.
+void ip6_route_delete_bulk(
+	uint16_t vrf_id,
+	unsigned n,
+	const struct ip6_net *dests,
+	uint32_t *status
+);
 void ip6_route_cleanup(struct nexthop6 *);
 struct nexthop6 *ip6_route_lookup(uint16_t vrf_id, const struct rte_ipv6_addr *);
+// Resolve n destination addresses in a single FIB walk.
+// Unroutable destinations are set to NULL in nhs.
+void ip6_route_lookup_bulk(
+	uint16_t vrf_id,
+	unsigned n,
+	const struct rte_ipv6_addr *,
+	struct nexthop6 **nhs
+);
 struct nexthop6 *
 ip6_route_lookup_exact(uint16_t vrf_id, const struct rte_ipv6_addr *, uint8_t prefixlen);
 
+// Incremented after every FIB modification and next hop release. Datapath
+// caches of route lookup results are stale when it changes. Never zero.
+extern uint32_t ip6_route_gen;
+void ip6_route_gen_bump(void);
+
+// IPv6 counterpart of struct ip4_route_cache.
+struct ip6_route_cache {
+	uint32_t seq;
+	uint32_t route_gen;
+	uint32_t iface_gen;
+	struct nexthop6 *nh;
+};
+
+// Same rules as ip4_route_cache_lookup.
+static inline struct nexthop6 *ip6_route_cache_lookup(
+	struct ip6_route_cache *c,
+	uint16_t vrf_id,
+	const struct rte_ipv6_addr *dst,
+	uint32_t route_gen,
+	uint32_t iface_gen
+) {
+	uint32_t seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+	struct nexthop6 *nh;
+
+	if (!(seq & 1) && c->route_gen == route_gen && c->iface_gen == iface_gen) {
+		nh = c->nh;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&c->seq, __ATOMIC_RELAXED) == seq)
+			return nh;
+	}
+
+	nh = ip6_route_lookup(vrf_id, dst);
+
+	// Another worker is updating the entry, do not wait for it.
+	if (!(seq & 1)
+	    && __atomic_compare_exchange_n(
+		    &c->seq, &seq, seq + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED
+	    )) {
+		c->route_gen = route_gen;
+		c->iface_gen = iface_gen;
+		c->nh = nh;
+		__atomic_store_n(&c->seq, seq + 2, __ATOMIC_RELEASE);
+	}
+
+	return nh;
+}
+
 // get the default address for a given interface
 struct nexthop6 *ip6_addr_get_preferred(uint16_t iface_id, const struct rte_ipv6_addr *);
 // get all addresses for a given interface
@@ -75,4 +210,8 @@ struct hoplist6 *ip6_addr_get_all(uint16_t iface_id);
 // determine if the given interface is member of the provided multicast address group
 struct nexthop6 *ip6_mcast_get_member(uint16_t iface_id, const struct rte_ipv6_addr *mcast);
 
+// ICMP error rate limit configuration. Fields are updated atomically and
+// may be read without locking.
+const struct gr_ip6_icmp_limit *ip6_icmp_limit_get(uint8_t icmp_type);
+
 #endif
@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_errno.h>
+#include <gr_icmp6.h>
+#include <gr_ip6.h>
+#include <gr_ip6_control.h>
+#include <gr_macro.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Defaults similar to the Linux icmp_msgs_per_sec and icmp_msgs_burst sysctls.
+#define ICMP_LIMIT_DEFAULT_RATE 1000
+#define ICMP_LIMIT_DEFAULT_BURST 50
+
+static struct gr_ip6_icmp_limit limits[] = {
+	{ICMP6_ERR_DEST_UNREACH, ICMP_LIMIT_DEFAULT_RATE, ICMP_LIMIT_DEFAULT_BURST},
+	{ICMP6_ERR_TTL_EXCEEDED, ICMP_LIMIT_DEFAULT_RATE, ICMP_LIMIT_DEFAULT_BURST},
+};
+
+const struct gr_ip6_icmp_limit *ip6_icmp_limit_get(uint8_t icmp_type) {
+	for (unsigned i = 0; i < ARRAY_DIM(limits); i++) {
+		if (limits[i].icmp_type == icmp_type)
+			return &limits[i];
+	}
+	return errno_set_null(ENOENT);
+}
+
+static struct api_out icmp_limit_set(const void *request, void ** /*response*/) {
+	const struct gr_ip6_icmp_limit_set_req *req = request;
+	struct gr_ip6_icmp_limit *l = NULL;
+	uint32_t burst;
+
+	for (unsigned i = 0; i < ARRAY_DIM(limits); i++) {
+		if (limits[i].icmp_type == req->limit.icmp_type)
+			l = &limits[i];
+	}
+	if (l == NULL)
+		return api_out(EINVAL, 0);
+
+	burst = req->limit.burst;
+	if (burst == 0)
+		burst = ICMP_LIMIT_DEFAULT_BURST;
+
+	// Datapath workers read these without locking. A transient mix of
+	// old and new values is harmless.
+	__atomic_store_n(&l->burst, burst, __ATOMIC_RELAXED);
+	__atomic_store_n(&l->rate, req->limit.rate, __ATOMIC_RELAXED);
+
+	return api_out(0, 0);
+}
+
+static struct api_out icmp_limit_list(const void * /*request*/, void **response) {
+	struct gr_ip6_icmp_limit_list_resp *resp;
+	size_t len;
+
+	len = sizeof(*resp) + sizeof(limits);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	resp->n_limits = ARRAY_DIM(limits);
+	memcpy(resp->limits, limits, sizeof(limits));
+
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+static struct gr_api_handler set_handler = {
+	.name = "ipv6 icmp limit set",
+	.request_type = GR_IP6_ICMP_LIMIT_SET,
+	.callback = icmp_limit_set,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler list_handler = {
+	.name = "ipv6 icmp limit list",
+	.request_type = GR_IP6_ICMP_LIMIT_LIST,
+	.callback = icmp_limit_list,
+};
+
+RTE_INIT(control_ip6_icmp_limit_init) {
+	gr_register_api_handler(&set_handler);
+	gr_register_api_handler(&list_handler);
+}
@@ -8,25 +8,61 @@
 #include <gr_ip6_control.h>
 #include <gr_ip6_datapath.h>
 #include <gr_log.h>
+#include <gr_memory.h>
 #include <gr_net_types.h>
 #include <gr_queue.h>
+#include <gr_rcu.h>
 #include <gr_stb_ds.h>
 
 #include <event2/event.h>
 #include <rte_errno.h>
 #include <rte_ether.h>
+#include <rte_hash.h>
 #include <rte_ip6.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
 #include <rte_mempool.h>
+#include <rte_ring.h>
 
+#include <assert.h>
 #include <errno.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/queue.h>
 
 static struct rte_mempool *nh_pool;
 
+// Hashed as a whole. The address is byte aligned, neither a 16 nor a 32 bits
+// vrf_id causes any padding.
+struct nexthop6_key {
+	struct rte_ipv6_addr ip;
+	uint32_t vrf_id;
+};
+
+static_assert(sizeof(struct nexthop6_key) == sizeof(struct rte_ipv6_addr) + sizeof(uint32_t));
+
+static struct rte_hash *nh_hash;
+// next hop groups indexed by user assigned ID
+static struct nexthop6 **nh_groups;
+// host next hops learned from the datapath, least recently used first
+static TAILQ_HEAD(, nexthop6) learned_nhs = TAILQ_HEAD_INITIALIZER(learned_nhs);
+static unsigned n_learned;
+
+static void nh_aging_cb(struct nh_neigh *);
+
+static void nh_clear(struct nexthop6 *nh) {
+	uint32_t id = nh->id;
+
+	memset(nh, 0, sizeof(*nh));
+	nh->id = id;
+}
+
 struct nexthop6 *
 ip6_nexthop_new(uint16_t vrf_id, uint16_t iface_id, const struct rte_ipv6_addr *ip) {
+	struct nexthop6_key key = {*ip, vrf_id};
 	struct nexthop6 *nh;
 	void *data;
 	int ret;
@@ -39,42 +75,91 @@ ip6_nexthop_new(uint16_t vrf_id, uint16_t iface_id, const struct rte_ipv6_addr *
 	nh->iface_id = iface_id;
 	nh->ip = *ip;
 
+	if ((ret = rte_hash_add_key_data(nh_hash, &key, nh)) < 0) {
+		nh_clear(nh);
+		rte_mempool_put(nh_pool, nh);
+		return errno_set_null(-ret);
+	}
+
+	nh_neigh_start(&nh->neigh, nh_aging_cb);
+
 	return nh;
 }
 
-struct lookup_filter {
-	uint16_t vrf_id;
-	const struct rte_ipv6_addr *ip;
-	struct nexthop6 *nh;
-};
+struct nexthop6 *ip6_nexthop_lookup(uint16_t vrf_id, const struct rte_ipv6_addr *ip) {
+	struct nexthop6_key key = {*ip, vrf_id};
+	void *data;
+
+	if (rte_hash_lookup_data(nh_hash, &key, &data) < 0)
+		return errno_set_null(ENOENT);
 
-static void nh_lookup_cb(struct rte_mempool *, void *opaque, void *obj, unsigned /*obj_idx*/) {
-	struct lookup_filter *filter = opaque;
+	return data;
+}
+
+static void nh_free(void *obj) {
 	struct nexthop6 *nh = obj;
-	if (filter->nh == NULL && nh->ref_count > 0 && rte_ipv6_addr_eq(&nh->ip, filter->ip)
-	    && nh->vrf_id == filter->vrf_id)
-		filter->nh = nh;
+
+	// Flush all held packets.
+	nh_neigh_purge(&nh->neigh);
+	rte_free(nh->group);
+	nh_clear(nh);
+	rte_mempool_put(nh_pool, nh);
 }
 
-struct nexthop6 *ip6_nexthop_lookup(uint16_t vrf_id, const struct rte_ipv6_addr *ip) {
-	struct lookup_filter filter = {.vrf_id = vrf_id, .ip = ip};
-	rte_mempool_obj_iter(nh_pool, nh_lookup_cb, &filter);
-	return filter.nh ?: errno_set_null(ENOENT);
+static void nh_to_api(const struct nexthop6 *nh, struct gr_ip6_nh *api_nh) {
+	api_nh->host = nh->ip;
+	api_nh->iface_id = nh->iface_id;
+	api_nh->vrf_id = nh->vrf_id;
+	api_nh->mac = nh->lladdr;
+	api_nh->flags = nh->flags;
+	api_nh->age = nh_neigh_reply_age(&nh->neigh);
+	api_nh->held_pkts = RTE_MAX(__atomic_load_n(&nh->neigh.held.len, __ATOMIC_RELAXED), 0);
+	api_nh->held_total = __atomic_load_n(&nh->neigh.held.held, __ATOMIC_RELAXED);
+	api_nh->flushed_total = __atomic_load_n(&nh->neigh.held.flushed, __ATOMIC_RELAXED);
+	api_nh->expired_total = __atomic_load_n(&nh->neigh.held.expired, __ATOMIC_RELAXED);
+}
+
+// Report the state changes to the API event subscribers. ECMP groups and
+// multicast addresses are not listed, they are not reported either.
+static void nh_event_push(uint32_t ev_type, struct nexthop6 *nh) {
+	struct gr_ip6_nh api_nh;
+	const void *key = NULL;
+
+	if (nh->flags & GR_IP6_NH_F_GROUP || rte_ipv6_addr_is_mcast(&nh->ip))
+		return;
+	if (ev_type == GR_IP6_EVENT_NH_UPDATE) {
+		if (nh->flags == nh->ev_flags)
+			return;
+		nh->ev_flags = nh->flags;
+		key = nh;
+	}
+	nh_to_api(nh, &api_nh);
+	gr_event_push(ev_type, key, &api_nh, sizeof(api_nh));
 }
 
 void ip6_nexthop_decref(struct nexthop6 *nh) {
 	if (nh->ref_count <= 1) {
-		rte_spinlock_lock(&nh->lock);
-		// Flush all held packets.
-		struct rte_mbuf *m = nh->held_pkts_head;
-		while (m != NULL) {
-			struct rte_mbuf *next = queue_mbuf_data(m)->next;
-			rte_pktmbuf_free(m);
-			m = next;
+		nh_event_push(GR_IP6_EVENT_NH_DEL, nh);
+		// Another next hop may have replaced this one in the index.
+		struct nexthop6_key key = {nh->ip, nh->vrf_id};
+		void *data;
+		if (rte_hash_lookup_data(nh_hash, &key, &data) >= 0 && data == nh)
+			rte_hash_del_key(nh_hash, &key);
+		nh_neigh_stop(&nh->neigh);
+		if (nh->learned) {
+			TAILQ_REMOVE(&learned_nhs, nh, lru);
+			nh->learned = false;
+			n_learned--;
 		}
-		rte_spinlock_unlock(&nh->lock);
-		memset(nh, 0, sizeof(*nh));
-		rte_mempool_put(nh_pool, nh);
+		if (nh->flags & GR_IP6_NH_F_GROUP) {
+			for (unsigned i = 0; i < nh->group->n_members; i++)
+				ip6_nexthop_decref(nh->group->members[i]);
+		}
+		nh->ref_count = 0;
+		// Flush cached references before the grace period starts.
+		ip6_route_gen_bump();
+		// Datapath workers may still be using this next hop.
+		gr_rcu_defer_free(nh_free, nh);
 	} else {
 		nh->ref_count--;
 	}
@@ -84,64 +169,644 @@ void ip6_nexthop_incref(struct nexthop6 *nh) {
 	nh->ref_count++;
 }
 
-static struct api_out nh6_add(const void *request, void ** /*response*/) {
-	const struct gr_ip6_nh_add_req *req = request;
+static bool nh_link_down(const struct nexthop6 *nh) {
+	const struct iface *iface = iface_from_id(nh->iface_id);
+	return iface != NULL && iface_link_down(iface);
+}
+
+// Synchronize GR_IP6_NH_F_DOWN with the link state of the output interface.
+// Returns true if the flag was changed.
+static bool nh_link_sync(struct nexthop6 *nh) {
+	bool down = nh_link_down(nh);
+
+	if (down == !!(nh->flags & GR_IP6_NH_F_DOWN))
+		return false;
+	if (down)
+		nh->flags |= GR_IP6_NH_F_DOWN;
+	else
+		nh->flags &= ~GR_IP6_NH_F_DOWN;
+	return true;
+}
+
+// Spread the buckets of a group over the members whose link is up. When all
+// links are down, the buckets are left as they are.
+static int nh_group_rebalance_up(struct nexthop6 *nh) {
+	void *active[NH_GROUP_MAX_MEMBERS];
+	unsigned n = 0;
+
+	for (unsigned i = 0; i < nh->group->n_members; i++) {
+		if (!nh_link_down(nh->group->members[i]))
+			active[n++] = nh->group->members[i];
+	}
+	if (n == 0)
+		return 0;
+
+	return nh_group_rebalance(nh->group, n, active);
+}
+
+int ip6_nexthop_group_set(struct nexthop6 *nh, unsigned n, struct nexthop6 *const *members) {
+	struct nexthop6 *old[NH_GROUP_MAX_MEMBERS];
+	void *ptrs[NH_GROUP_MAX_MEMBERS];
+	unsigned i, n_old;
+	int ret;
+
+	if (n == 0 || n > NH_GROUP_MAX_MEMBERS)
+		return errno_set(ERANGE);
+
+	for (i = 0; i < n; i++) {
+		// groups of groups are not supported
+		if (members[i]->flags & GR_IP6_NH_F_GROUP)
+			return errno_set(EINVAL);
+		ptrs[i] = members[i];
+	}
+
+	n_old = nh->group->n_members;
+	for (i = 0; i < n_old; i++)
+		old[i] = nh->group->members[i];
+
+	if ((ret = nh_group_set(nh->group, n, ptrs)) < 0)
+		return ret;
+	if ((ret = nh_group_rebalance_up(nh)) < 0)
+		return ret;
+
+	for (i = 0; i < n; i++)
+		ip6_nexthop_incref(members[i]);
+	// Datapath workers may still be using the removed members.
+	// Their release is deferred by ip6_nexthop_decref.
+	for (i = 0; i < n_old; i++)
+		ip6_nexthop_decref(old[i]);
+
+	return 0;
+}
+
+struct nexthop6 *
+ip6_nexthop_group_new(uint16_t vrf_id, unsigned n, struct nexthop6 *const *members) {
 	struct nexthop6 *nh;
+	void *data;
 	int ret;
 
-	if (rte_ipv6_addr_is_unspec(&req->nh.host) || rte_ipv6_addr_is_mcast(&req->nh.host))
-		return api_out(EINVAL, 0);
-	if (req->nh.vrf_id >= IP6_MAX_VRFS)
-		return api_out(EOVERFLOW, 0);
-	if (iface_from_id(req->nh.iface_id) == NULL)
-		return api_out(errno, 0);
+	if ((ret = rte_mempool_get(nh_pool, &data)) < 0)
+		return errno_set_null(-ret);
 
-	if ((nh = ip6_nexthop_lookup(req->nh.vrf_id, &req->nh.host)) != NULL) {
-		if (req->exist_ok && req->nh.iface_id == nh->iface_id
-		    && rte_is_same_ether_addr(&req->nh.mac, &nh->lladdr))
-			return api_out(0, 0);
-		return api_out(EEXIST, 0);
+	nh = data;
+	nh->group = rte_zmalloc(__func__, sizeof(*nh->group), RTE_CACHE_LINE_SIZE);
+	if (nh->group == NULL) {
+		rte_mempool_put(nh_pool, nh);
+		return errno_set_null(ENOMEM);
 	}
+	// Group next hops are not indexed in the next hop hash table and do not age.
+	nh->vrf_id = vrf_id;
+	nh->iface_id = GR_IFACE_ID_UNDEF;
+	nh->flags = GR_IP6_NH_F_GROUP | GR_IP6_NH_F_GATEWAY;
 
-	if ((nh = ip6_nexthop_new(req->nh.vrf_id, req->nh.iface_id, &req->nh.host)) == NULL)
-		return api_out(errno, 0);
+	if ((ret = ip6_nexthop_group_set(nh, n, members)) < 0) {
+		rte_free(nh->group);
+		nh_clear(nh);
+		rte_mempool_put(nh_pool, nh);
+		return errno_set_null(-ret);
+	}
+
+	return nh;
+}
+
+struct nexthop6 *ip6_nexthop_group_get(uint32_t id) {
+	if (id == 0 || id >= IP6_MAX_NH_GROUPS)
+		return errno_set_null(ERANGE);
+	if (nh_groups[id] == NULL)
+		return errno_set_null(ENOENT);
+	return nh_groups[id];
+}
+
+int ip6_nexthop_group_members(
+	uint16_t vrf_id,
+	unsigned n,
+	const struct rte_ipv6_addr *ips,
+	struct nexthop6 **members
+) {
+	unsigned i, j;
 
-	nh->lladdr = req->nh.mac;
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < i; j++) {
+			if (rte_ipv6_addr_eq(&ips[j], &ips[i]))
+				return errno_set(EINVAL);
+		}
+		if (ip6_route_lookup(vrf_id, &ips[i]) == NULL)
+			return errno_set(EHOSTUNREACH);
+	}
+
+	for (i = 0; i < n; i++) {
+		members[i] = ip6_nexthop_lookup(vrf_id, &ips[i]);
+		if (members[i] == NULL)
+			members[i] = ip6_nexthop_new(vrf_id, GR_IFACE_ID_UNDEF, &ips[i]);
+		if (members[i] == NULL) {
+			int ret = errno;
+			ip6_nexthop_group_members_put(i, members);
+			return errno_set(ret);
+		}
+	}
+
+	return 0;
+}
+
+void ip6_nexthop_group_members_put(unsigned n, struct nexthop6 **members) {
+	for (unsigned i = 0; i < n; i++) {
+		if (members[i]->ref_count == 0)
+			ip6_nexthop_decref(members[i]);
+	}
+}
+
+struct nh_learn_req {
+	uint16_t vrf_id;
+	uint16_t iface_id;
+	struct rte_ipv6_addr ip;
+	// All zeroes when requesting to learn the packets held by a connected next hop.
+	struct rte_ether_addr lladdr;
+};
+
+static struct rte_ring *learn_ring;
+static struct event *learn_ev;
+
+// Set when a learning request could not be posted.
+static atomic_bool learn_overflow;
+
+static int nh_learn_post(const struct nh_learn_req *req) {
+	int ret = 0;
+
+	if (rte_ring_enqueue_elem(learn_ring, req, sizeof(*req)) < 0) {
+		atomic_store(&learn_overflow, true);
+		ret = errno_set(ENOBUFS);
+	}
+	// The request may come from any dataplane thread. Defer the processing
+	// to the event loop running in the main lcore.
+	event_active(learn_ev, 0, 0);
+	return ret;
+}
+
+int ip6_nexthop_learn(
+	uint16_t vrf_id,
+	uint16_t iface_id,
+	const struct rte_ipv6_addr *ip,
+	struct rte_ether_addr lladdr
+) {
+	struct nh_learn_req req = {
+		.vrf_id = vrf_id,
+		.iface_id = iface_id,
+		.ip = *ip,
+		.lladdr = lladdr,
+	};
+	return nh_learn_post(&req);
+}
+
+int ip6_nexthop_learn_held(const struct nexthop6 *link) {
+	struct nh_learn_req req = {
+		.vrf_id = link->vrf_id,
+		.iface_id = link->iface_id,
+		.ip = link->ip,
+	};
+	return nh_learn_post(&req);
+}
+
+// Make room for a new learned host route. Entries are examined oldest first
+// and moved to the tail of the list. Resolved next hops carrying traffic and
+// next hops also used by other routes are skipped.
+static int nh_learned_evict(void) {
+	struct nexthop6 *nh, *victim = NULL;
+
+	for (unsigned i = 0; i < IP6_NH_EVICT_SCAN; i++) {
+		if ((nh = TAILQ_FIRST(&learned_nhs)) == NULL)
+			break;
+		TAILQ_REMOVE(&learned_nhs, nh, lru);
+		TAILQ_INSERT_TAIL(&learned_nhs, nh, lru);
+		if (nh->ref_count != 1)
+			continue;
+		if (victim == NULL)
+			victim = nh;
+		if (!(nh->flags & GR_IP6_NH_F_REACHABLE)
+		    || !__atomic_load_n(&nh->neigh.used, __ATOMIC_RELAXED)) {
+			victim = nh;
+			break;
+		}
+	}
+	if (victim == NULL)
+		return errno_set(ENOSPC);
+
+	LOG(DEBUG, IPV6_ADDR_FMT " vrf=%u: evicted", IPV6_ADDR_SPLIT(&victim->ip), victim->vrf_id);
+	// this also does ip6_nexthop_decref(), removing it from the list
+	ip6_route_cleanup(victim);
+
+	return 0;
+}
+
+static struct nexthop6 *
+host_route_new(uint16_t vrf_id, uint16_t iface_id, const struct rte_ipv6_addr *ip) {
+	struct nexthop6 *nh;
+
+	if (n_learned >= IP6_NH_LEARN_MAX && nh_learned_evict() < 0)
+		return NULL;
+
+	if ((nh = ip6_nexthop_new(vrf_id, iface_id, ip)) == NULL)
+		return NULL;
+
+	// this also does ip6_nexthop_incref()
+	if (ip6_route_insert(vrf_id, ip, RTE_IPV6_MAX_DEPTH, nh) < 0)
+		return NULL;
+
+	TAILQ_INSERT_TAIL(&learned_nhs, nh, lru);
+	nh->learned = true;
+	n_learned++;
+
+	return nh;
+}
+
+static void nh_learn_lladdr(const struct nh_learn_req *req) {
+	struct nexthop6 *nh;
+
+	// The next hop may have been created by a previous request.
+	if (ip6_nexthop_lookup(req->vrf_id, &req->ip) != NULL)
+		return;
+
+	if ((nh = host_route_new(req->vrf_id, req->iface_id, &req->ip)) == NULL) {
+		LOG(ERR, "host_route_new: %s", strerror(errno));
+		return;
+	}
+
+	rte_spinlock_lock(&nh->lock);
+	nh->lladdr = req->lladdr;
+	nh->neigh.last_reply = rte_get_tsc_cycles();
+	nh->flags |= GR_IP6_NH_F_REACHABLE;
+	rte_spinlock_unlock(&nh->lock);
+	nh_event_push(GR_IP6_EVENT_NH_UPDATE, nh);
+}
+
+// Move the packets held by a connected next hop to their own host next hop,
+// creating at most budget new next hops and /128 routes. Held packets that
+// could not be processed are kept in the connected next hop hold queue.
+static unsigned nh_learn_held(const struct nh_learn_req *req, unsigned budget) {
+	struct rte_mbuf *m, *next, *keep = NULL, *keep_tail = NULL;
+	struct nexthop6 *link, *nh, **touched = NULL;
+	const struct rte_ipv6_hdr *ip;
+	uint32_t n_keep = 0;
+
+	link = ip6_nexthop_lookup(req->vrf_id, &req->ip);
+	if (link == NULL || !(link->flags & GR_IP6_NH_F_LINK))
+		return budget;
+
+	for (m = hold_queue_take(&link->neigh.held, NULL); m != NULL; m = next) {
+		next = queue_mbuf_data(m)->next;
+		ip = rte_pktmbuf_mtod(m, const struct rte_ipv6_hdr *);
+
+		nh = ip6_route_lookup(link->vrf_id, &ip->dst_addr);
+		if (nh == link) {
+			if (budget == 0) {
+				// keep the list in reverse order, like hold_queue_push
+				queue_mbuf_data(m)->next = keep;
+				if (keep == NULL)
+					keep_tail = m;
+				keep = m;
+				n_keep++;
+				continue;
+			}
+			nh = host_route_new(link->vrf_id, link->iface_id, &ip->dst_addr);
+			budget--;
+		}
+		// Neighbors which failed to resolve drop packets until they expire.
+		if (nh == NULL || nh->flags & GR_IP6_NH_F_FAILED
+		    || hold_queue_full(&nh->neigh.held, NH_NEIGH_MAX_HELD_PKTS)) {
+			rte_pktmbuf_free(m);
+			continue;
+		}
+
+		// The original hold time is preserved for expiration.
+		if (hold_queue_link(&nh->neigh.held, m, m, 1))
+			arrpush(touched, nh);
+	}
+
+	if (keep != NULL) {
+		// Put back unprocessed packets.
+		hold_queue_link(&link->neigh.held, keep, keep_tail, n_keep);
+		if (nh_learn_post(req) < 0)
+			LOG(ERR, "nh_learn_post: %s", strerror(errno));
+	}
+
+	arrforeach (nh, touched) {
+		if (nh->flags & GR_IP6_NH_F_REACHABLE) {
+			if (ip6_hold_flush(nh) < 0)
+				LOG(ERR, "ip6_hold_flush: %s", strerror(errno));
+		} else if (!(nh->flags & GR_IP6_NH_F_PENDING)) {
+			if (ip6_nexthop_solicit(nh) < 0)
+				LOG(ERR, "ip6_nexthop_solicit: %s", strerror(errno));
+			nh->flags |= GR_IP6_NH_F_PENDING;
+		}
+	}
+	arrfree(touched);
+
+	return budget;
+}
+
+static void
+nh_learn_overflow_cb(struct rte_mempool *, void * /*opaque*/, void *obj, unsigned /*obj_idx*/) {
+	struct nexthop6 *nh = obj;
+
+	if (nh->ref_count > 0 && nh->flags & GR_IP6_NH_F_LINK
+	    && __atomic_load_n(&nh->neigh.held.len, __ATOMIC_RELAXED) > 0)
+		ip6_nexthop_learn_held(nh);
+}
+
+static void nh_learn_cb(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	struct nh_learn_req reqs[IP6_NH_LEARN_BURST];
+	unsigned budget = IP6_NH_LEARN_BURST;
+	unsigned n;
+
+	// Some connected next hops may hold packets without any pending request.
+	// Only scan the whole pool in that case.
+	if (atomic_exchange(&learn_overflow, false))
+		rte_mempool_obj_iter(nh_pool, nh_learn_overflow_cb, NULL);
+
+	// Host routes are created in bursts to avoid starving the event loop.
+	n = rte_ring_dequeue_burst_elem(learn_ring, reqs, sizeof(*reqs), ARRAY_DIM(reqs), NULL);
+
+	for (unsigned i = 0; i < n; i++) {
+		if (rte_is_zero_ether_addr(&reqs[i].lladdr)) {
+			budget = nh_learn_held(&reqs[i], budget);
+		} else if (budget == 0) {
+			// In case the ring is full, the request is dropped. The
+			// neighbor will send another solicitation anyway.
+			nh_learn_post(&reqs[i]);
+		} else {
+			nh_learn_lladdr(&reqs[i]);
+			budget--;
+		}
+	}
+
+	if (!rte_ring_empty(learn_ring)) {
+		// More requests are pending, give other events a chance to run.
+		struct timeval tv = {.tv_usec = 1000};
+		event_add(learn_ev, &tv);
+	}
+}
+
+static int nh_add(const struct gr_ip6_nh *base, bool exist_ok) {
+	struct nexthop6 *nh;
+
+	if (rte_ipv6_addr_is_unspec(&base->host) || rte_ipv6_addr_is_mcast(&base->host))
+		return errno_set(EINVAL);
+	if (base->vrf_id >= IP6_MAX_VRFS)
+		return errno_set(EOVERFLOW);
+	if (iface_from_id(base->iface_id) == NULL)
+		return -errno;
+
+	if ((nh = ip6_nexthop_lookup(base->vrf_id, &base->host)) != NULL) {
+		if (exist_ok && base->iface_id == nh->iface_id
+		    && rte_is_same_ether_addr(&base->mac, &nh->lladdr))
+			return 0;
+		return errno_set(EEXIST);
+	}
+
+	if ((nh = ip6_nexthop_new(base->vrf_id, base->iface_id, &base->host)) == NULL)
+		return -errno;
+
+	nh->lladdr = base->mac;
 	nh->flags = GR_IP6_NH_F_STATIC | GR_IP6_NH_F_REACHABLE;
-	ret = ip6_route_insert(nh->vrf_id, &nh->ip, RTE_IPV6_MAX_DEPTH, nh);
+	nh_event_push(GR_IP6_EVENT_NH_UPDATE, nh);
+
+	return ip6_route_insert(nh->vrf_id, &nh->ip, RTE_IPV6_MAX_DEPTH, nh);
+}
+
+static struct api_out nh6_add(const void *request, void ** /*response*/) {
+	const struct gr_ip6_nh_add_req *req = request;
+
+	if (nh_add(&req->nh, req->exist_ok) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+// Returns 1 if the next hop exists and can be deleted.
+static int nh_del_check(uint16_t vrf_id, const struct rte_ipv6_addr *host, bool missing_ok) {
+	struct nexthop6 *nh;
+
+	if (vrf_id >= IP6_MAX_VRFS)
+		return errno_set(EOVERFLOW);
+
+	if ((nh = ip6_nexthop_lookup(vrf_id, host)) == NULL) {
+		if (errno == ENOENT && missing_ok)
+			return 0;
+		return -errno;
+	}
+	if ((nh->flags & (GR_IP6_NH_F_LOCAL | GR_IP6_NH_F_LINK | GR_IP6_NH_F_GATEWAY))
+	    || nh->ref_count > 1)
+		return errno_set(EBUSY);
 
-	return api_out(-ret, 0);
+	return 1;
 }
 
 static struct api_out nh6_del(const void *request, void ** /*response*/) {
 	const struct gr_ip6_nh_del_req *req = request;
+	int ret;
+
+	if ((ret = nh_del_check(req->vrf_id, &req->host, req->missing_ok)) <= 0)
+		return api_out(-ret, 0);
+
+	// this also does ip6_nexthop_decref(), freeing the next hop
+	if (ip6_route_delete(req->vrf_id, &req->host, RTE_IPV6_MAX_DEPTH) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out nh6_add_bulk(const void *request, void **response) {
+	const struct gr_ip6_nh_add_bulk_req *req = request;
+	struct gr_api_bulk_resp *resp;
+	size_t len;
+
+	if (req->n_nhs == 0 || sizeof(*req) + req->n_nhs * sizeof(*req->nhs) > GR_API_MAX_MSG_LEN)
+		return api_out(ERANGE, 0);
+
+	len = sizeof(*resp) + req->n_nhs * sizeof(*resp->status);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	for (uint16_t i = 0; i < req->n_nhs; i++) {
+		if (nh_add(&req->nhs[i], req->exist_ok) < 0)
+			resp->status[i] = errno;
+	}
+	resp->n_status = req->n_nhs;
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+GR_API_FLEX_CHECK(nh6_add_bulk_check, gr_ip6_nh_add_bulk_req, n_nhs, nhs)
+
+static struct api_out nh6_del_bulk(const void *request, void **response) {
+	const struct gr_ip6_nh_del_bulk_req *req = request;
+	struct gr_api_bulk_resp *resp = NULL;
+	struct ip6_net *dests = NULL;
+	uint16_t *index = NULL;
+	uint32_t *status = NULL;
+	unsigned i, n;
+	size_t len;
+	int ret;
+
+	if (req->n_hosts == 0
+	    || sizeof(*req) + req->n_hosts * sizeof(*req->hosts) > GR_API_MAX_MSG_LEN)
+		return api_out(ERANGE, 0);
+
+	len = sizeof(*resp) + req->n_hosts * sizeof(*resp->status);
+	if ((resp = calloc(1, len)) == NULL)
+		goto fail;
+	if ((dests = calloc(req->n_hosts, sizeof(*dests))) == NULL)
+		goto fail;
+	if ((index = calloc(req->n_hosts, sizeof(*index))) == NULL)
+		goto fail;
+	if ((status = calloc(req->n_hosts, sizeof(*status))) == NULL)
+		goto fail;
+
+	n = 0;
+	for (i = 0; i < req->n_hosts; i++) {
+		ret = nh_del_check(req->vrf_id, &req->hosts[i], req->missing_ok);
+		if (ret < 0) {
+			resp->status[i] = -ret;
+		} else if (ret > 0) {
+			dests[n].ip = req->hosts[i];
+			dests[n].prefixlen = RTE_IPV6_MAX_DEPTH;
+			index[n++] = i;
+		}
+	}
+	// this also does ip6_nexthop_decref(), freeing the next hops
+	ip6_route_delete_bulk(req->vrf_id, n, dests, status);
+	for (i = 0; i < n; i++)
+		resp->status[index[i]] = status[i];
+
+	resp->n_status = req->n_hosts;
+	*response = resp;
+
+	free(dests);
+	free(index);
+	free(status);
+	return api_out(0, len);
+fail:
+	free(resp);
+	free(dests);
+	free(index);
+	free(status);
+	return api_out(ENOMEM, 0);
+}
+
+GR_API_FLEX_CHECK(nh6_del_bulk_check, gr_ip6_nh_del_bulk_req, n_hosts, hosts)
+
+static struct api_out nh6_group_add(const void *request, void ** /*response*/) {
+	const struct gr_ip6_nh_group_add_req *req = request;
+	struct nexthop6 *members[GR_IP6_NH_GROUP_MAX_NHS];
 	struct nexthop6 *nh;
+	int ret;
 
+	if (req->id == 0 || req->id >= IP6_MAX_NH_GROUPS)
+		return api_out(ERANGE, 0);
 	if (req->vrf_id >= IP6_MAX_VRFS)
 		return api_out(EOVERFLOW, 0);
+	if (req->n_nhs == 0 || req->n_nhs > GR_IP6_NH_GROUP_MAX_NHS)
+		return api_out(ERANGE, 0);
+
+	nh = nh_groups[req->id];
+	if (nh != NULL && !(req->exist_ok && nh->vrf_id == req->vrf_id))
+		return api_out(EEXIST, 0);
+
+	if (ip6_nexthop_group_members(req->vrf_id, req->n_nhs, req->nhs, members) < 0)
+		return api_out(errno, 0);
+
+	if (nh != NULL) {
+		// All routes referencing the group follow the new members at once.
+		if (ip6_nexthop_group_set(nh, req->n_nhs, members) < 0)
+			goto err;
+	} else {
+		if ((nh = ip6_nexthop_group_new(req->vrf_id, req->n_nhs, members)) == NULL)
+			goto err;
+		nh->group->id = req->id;
+		// the group table holds one reference
+		ip6_nexthop_incref(nh);
+		nh_groups[req->id] = nh;
+	}
+
+	for (unsigned i = 0; i < req->n_nhs; i++)
+		members[i]->flags |= GR_IP6_NH_F_GATEWAY;
+
+	return api_out(0, 0);
+err:
+	ret = errno;
+	ip6_nexthop_group_members_put(req->n_nhs, members);
+	return api_out(ret, 0);
+}
+
+GR_API_FLEX_CHECK(nh6_group_add_check, gr_ip6_nh_group_add_req, n_nhs, nhs)
 
-	if ((nh = ip6_nexthop_lookup(req->vrf_id, &req->host)) == NULL) {
+static struct api_out nh6_group_del(const void *request, void ** /*response*/) {
+	const struct gr_ip6_nh_group_del_req *req = request;
+	struct nexthop6 *nh;
+
+	if ((nh = ip6_nexthop_group_get(req->id)) == NULL) {
 		if (errno == ENOENT && req->missing_ok)
 			return api_out(0, 0);
 		return api_out(errno, 0);
 	}
-	if ((nh->flags & (GR_IP6_NH_F_LOCAL | GR_IP6_NH_F_LINK | GR_IP6_NH_F_GATEWAY))
-	    || nh->ref_count > 1)
+	if (nh->ref_count > 1)
 		return api_out(EBUSY, 0);
 
-	// this also does ip6_nexthop_decref(), freeing the next hop
-	if (ip6_route_delete(req->vrf_id, &req->host, RTE_IPV6_MAX_DEPTH) < 0)
-		return api_out(errno, 0);
+	nh_groups[req->id] = NULL;
+	ip6_nexthop_decref(nh);
 
 	return api_out(0, 0);
 }
 
+static struct api_out nh6_group_list(const void *request, void **response) {
+	const struct gr_ip6_nh_group_list_req *req = request;
+	struct gr_ip6_nh_group_list_resp *resp = NULL;
+	struct gr_ip6_nh_group *g;
+	const struct nexthop6 *nh;
+	uint32_t id;
+	size_t len;
+	unsigned n;
+
+	n = 0;
+	for (id = 1; id < IP6_MAX_NH_GROUPS; id++) {
+		nh = nh_groups[id];
+		if (nh != NULL && (nh->vrf_id == req->vrf_id || req->vrf_id == UINT16_MAX))
+			n++;
+	}
+
+	len = sizeof(*resp) + n * sizeof(*resp->groups);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	for (id = 1; id < IP6_MAX_NH_GROUPS; id++) {
+		nh = nh_groups[id];
+		if (nh == NULL || (nh->vrf_id != req->vrf_id && req->vrf_id != UINT16_MAX))
+			continue;
+		g = &resp->groups[resp->n_groups++];
+		g->id = id;
+		g->vrf_id = nh->vrf_id;
+		g->n_routes = nh->ref_count - 1;
+		g->n_nhs = nh->group->n_members;
+		for (unsigned i = 0; i < g->n_nhs; i++)
+			g->nhs[i] = ((const struct nexthop6 *)nh->group->members[i])->ip;
+	}
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+// Max number of next hops in a single list response.
+#define NH_LIST_MAX                                                                                \
+	((GR_API_MAX_MSG_LEN - sizeof(struct gr_ip6_nh_list_resp)) / sizeof(struct gr_ip6_nh))
+
 struct list_context {
 	uint16_t vrf_id;
+	uint32_t cursor;
+	uint32_t next_cursor;
 	struct gr_ip6_nh *nh;
 };
 
-static void nh_list_cb(struct rte_mempool *, void *opaque, void *obj, unsigned /*obj_idx*/) {
+static void nh_list_cb(struct rte_mempool *, void *opaque, void *obj, unsigned obj_idx) {
 	struct list_context *ctx = opaque;
 	struct nexthop6 *nh = obj;
 	struct gr_ip6_nh api_nh;
@@ -149,102 +814,158 @@ static void nh_list_cb(struct rte_mempool *, void *opaque, void *obj, unsigned /
 	if (nh->ref_count == 0 || (nh->vrf_id != ctx->vrf_id && ctx->vrf_id != UINT16_MAX)
 	    || rte_ipv6_addr_is_mcast(&nh->ip))
 		return;
+	// ECMP group members are listed individually
+	if (nh->flags & GR_IP6_NH_F_GROUP)
+		return;
+	// mempool objects are always iterated in the same order
+	if (obj_idx < ctx->cursor || ctx->next_cursor != 0)
+		return;
+	if (arrlen(ctx->nh) >= NH_LIST_MAX) {
+		ctx->next_cursor = obj_idx;
+		return;
+	}
 
-	api_nh.host = nh->ip;
-	api_nh.iface_id = nh->iface_id;
-	api_nh.vrf_id = nh->vrf_id;
-	api_nh.mac = nh->lladdr;
-	api_nh.flags = nh->flags;
-	if (nh->last_reply > 0)
-		api_nh.age = (rte_get_tsc_cycles() - nh->last_reply) / rte_get_tsc_hz();
-	else
-		api_nh.age = 0;
-	api_nh.held_pkts = nh->held_pkts_num;
+	nh_to_api(nh, &api_nh);
 	arrpush(ctx->nh, api_nh);
 }
 
+static void nh_array_free(void *nhs) {
+	arrfree(nhs);
+}
+
 static struct api_out nh6_list(const void *request, void **response) {
 	const struct gr_ip6_nh_list_req *req = request;
-	struct list_context ctx = {.vrf_id = req->vrf_id, .nh = NULL};
-	struct gr_ip6_nh_list_resp *resp = NULL;
-	size_t len;
+	struct list_context ctx = {.vrf_id = req->vrf_id, .cursor = req->cursor, .nh = NULL};
+	struct gr_ip6_nh_list_resp *hdr;
+	struct api_iov_resp *resp;
 
 	rte_mempool_obj_iter(nh_pool, nh_list_cb, &ctx);
 
-	len = sizeof(*resp) + arrlen(ctx.nh) * sizeof(*ctx.nh);
-	if ((resp = calloc(len, 1)) == NULL) {
+	// The next hops are sent from the array they were collected in.
+	hdr = calloc(1, sizeof(*hdr));
+	resp = calloc(1, sizeof(*resp) + 2 * sizeof(*resp->iov));
+	if (hdr == NULL || resp == NULL) {
 		arrfree(ctx.nh);
+		free(resp);
+		free(hdr);
 		return api_out(ENOMEM, 0);
 	}
 
-	resp->n_nhs = arrlen(ctx.nh);
-	memcpy(&resp->nhs, ctx.nh, arrlen(ctx.nh) * sizeof(*ctx.nh));
-	arrfree(ctx.nh);
+	hdr->next_cursor = ctx.next_cursor;
+	hdr->n_nhs = arrlen(ctx.nh);
+	resp->n_iov = 2;
+	resp->iov[0].base = hdr;
+	resp->iov[0].len = offsetof(struct gr_ip6_nh_list_resp, nhs);
+	resp->iov[0].free = free;
+	resp->iov[1].base = ctx.nh;
+	resp->iov[1].len = arrlen(ctx.nh) * sizeof(*ctx.nh);
+	resp->iov[1].free = nh_array_free;
 	*response = resp;
 
-	return api_out(0, len);
+	return api_out(0, resp->iov[0].len + resp->iov[1].len);
 }
 
-static void nh_gc_cb(struct rte_mempool *, void * /*opaque*/, void *obj, unsigned /*obj_idx*/) {
+static void nh_aging_cb(struct nh_neigh *n) {
+	struct nexthop6 *nh = container_of(n, struct nexthop6, neigh);
 	uint64_t now = rte_get_tsc_cycles();
-	uint64_t reply_age, request_age;
-	unsigned probes, max_probes;
-	struct nexthop6 *nh = obj;
-
-	max_probes = IP6_NH_UCAST_PROBES + IP6_NH_MCAST_PROBES;
+	uint8_t actions;
 
-	if (nh->ref_count == 0 || nh->flags & GR_IP6_NH_F_STATIC)
+	// Static next hops never expire and are not re-armed.
+	if (nh->flags & GR_IP6_NH_F_STATIC)
 		return;
 
-	reply_age = (now - nh->last_reply) / rte_get_tsc_hz();
-	request_age = (now - nh->last_request) / rte_get_tsc_hz();
-	probes = nh->ucast_probes + nh->mcast_probes;
-
-	if (nh->flags & (GR_IP6_NH_F_PENDING | GR_IP6_NH_F_STALE) && request_age > probes) {
-		if (probes >= max_probes && !(nh->flags & GR_IP6_NH_F_GATEWAY)) {
-			LOG(DEBUG,
-			    IPV6_ADDR_FMT " vrf=%u failed_probes=%u held_pkts=%u: %s -> failed",
-			    IPV6_ADDR_SPLIT(&nh->ip),
-			    nh->vrf_id,
-			    probes,
-			    nh->held_pkts_num,
-			    gr_ip6_nh_f_name(nh->flags & (GR_IP6_NH_F_PENDING | GR_IP6_NH_F_STALE))
-			);
-			nh->flags &= ~(GR_IP6_NH_F_PENDING | GR_IP6_NH_F_STALE);
-			nh->flags |= GR_IP6_NH_F_FAILED;
-		} else {
-			if (ip6_nexthop_solicit(nh) < 0)
-				LOG(ERR, "arp_output_request_solicit: %s", strerror(errno));
-		}
-	} else if (nh->flags & GR_IP6_NH_F_REACHABLE && reply_age > IP6_NH_LIFETIME_REACHABLE) {
-		nh->flags &= ~GR_IP6_NH_F_REACHABLE;
-		nh->flags |= GR_IP6_NH_F_STALE;
-	} else if (nh->flags & GR_IP6_NH_F_FAILED && request_age > IP6_NH_LIFETIME_UNREACHABLE) {
+	if (nh->ref_count == 0)
+		goto rearm;
+
+	actions = nh_neigh_age(n, &nh->flags, now);
+
+	if (actions & NH_NEIGH_A_FLUSH && ip6_hold_flush(nh) < 0)
+		LOG(ERR, "ip6_hold_flush: %s", strerror(errno));
+	if (actions & NH_NEIGH_A_SOLICIT && ip6_nexthop_solicit(nh) < 0)
+		LOG(ERR, "ip6_nexthop_solicit: %s", strerror(errno));
+	if (actions & (NH_NEIGH_A_FAILED | NH_NEIGH_A_DESTROY)) {
 		LOG(DEBUG,
-		    IPV6_ADDR_FMT " vrf=%u failed_probes=%u held_pkts=%u: failed -> <destroy>",
+		    IPV6_ADDR_FMT " vrf=%u failed_probes=%u held_pkts=%d: %s",
 		    IPV6_ADDR_SPLIT(&nh->ip),
 		    nh->vrf_id,
-		    probes,
-		    nh->held_pkts_num);
-
+		    n->ucast_probes + n->mcast_probes,
+		    n->held.len,
+		    actions & NH_NEIGH_A_DESTROY ? "failed -> <destroy>" : "-> failed");
+	}
+	if (actions & NH_NEIGH_A_DESTROY) {
 		// this also does ip6_nexthop_decref(), freeing the next hop
 		// and buffered packets.
 		ip6_route_cleanup(nh);
+		return;
+	}
+	// next hops created while their link was down
+	nh_link_sync(nh);
+	// also catches the resolutions made by ndp_na_input in the datapath
+	nh_event_push(GR_IP6_EVENT_NH_UPDATE, nh);
+rearm:
+	nh_neigh_rearm(n, nh->flags, now);
+}
+
+static void nh_link_cb(struct rte_mempool *, void *opaque, void *obj, unsigned /*obj_idx*/) {
+	struct nexthop6 *nh = obj;
+	bool *changed = opaque;
+
+	if (nh->flags & (GR_IP6_NH_F_GROUP | GR_IP6_NH_F_MCAST))
+		return;
+	if (nh_link_sync(nh)) {
+		nh_event_push(GR_IP6_EVENT_NH_UPDATE, nh);
+		*changed = true;
 	}
 }
 
-static void nexthop_gc(evutil_socket_t, short /*what*/, void * /*priv*/) {
-	rte_mempool_obj_iter(nh_pool, nh_gc_cb, NULL);
+static void nh_group_link_cb(struct rte_mempool *, void *, void *obj, unsigned /*obj_idx*/) {
+	struct nexthop6 *nh = obj;
+
+	if (nh->flags & GR_IP6_NH_F_GROUP && nh_group_rebalance_up(nh) < 0)
+		LOG(ERR, "nh_group_rebalance: %s", strerror(errno));
 }
 
-static struct event *nh_gc_timer;
+static void nh_iface_event(iface_event_t event, struct iface *) {
+	bool changed = false;
+
+	if (event != IFACE_EVENT_PORT_LINK_CHANGE)
+		return;
+
+	// The link of a port also affects the VLAN sub-interfaces on top of it.
+	// Check all next hops instead of tracking which ones use it.
+	rte_mempool_obj_iter(nh_pool, nh_link_cb, &changed);
+
+	// Fast reroute: move the flows of the ECMP groups away from the members
+	// that went down without waiting for the routes to be withdrawn. The cost
+	// only depends on the number of next hops, not on the number of routes.
+	if (changed)
+		rte_mempool_obj_iter(nh_pool, nh_group_link_cb, NULL);
+}
+
+static struct iface_event_handler nh_iface_event_handler = {
+	.callback = nh_iface_event,
+};
+
+// Objects keep the same index for the pool lifetime.
+static void nh_id_init_cb(struct rte_mempool *, void *, void *obj, unsigned obj_idx) {
+	struct nexthop6 *nh = obj;
+	nh->id = obj_idx;
+}
 
 static void nh6_init(struct event_base *ev_base) {
+	unsigned n = rte_align32pow2(IP6_MAX_NEXT_HOPS) - 1;
+	unsigned cache_size;
+
+	// Datapath workers create next hops when learning neighbors. Per-lcore
+	// caches avoid contention on the pool ring. Keep the number of objects
+	// held in all caches to a small fraction of the pool.
+	cache_size = RTE_MIN(n / (16 * rte_lcore_count()), (unsigned)IP6_NH_POOL_CACHE_SIZE);
+
 	nh_pool = rte_mempool_create(
 		"ip6_nh", // name
-		rte_align32pow2(IP6_MAX_NEXT_HOPS) - 1,
+		n,
 		sizeof(struct nexthop6),
-		0, // cache size
+		cache_size,
 		0, // priv size
 		NULL, // mp_init
 		NULL, // mp_init_arg
@@ -255,18 +976,58 @@ static void nh6_init(struct event_base *ev_base) {
 	);
 	if (nh_pool == NULL)
 		ABORT("rte_mempool_create(ip6_nh) failed");
+	rte_mempool_obj_iter(nh_pool, nh_id_init_cb, NULL);
+
+	struct rte_hash_parameters params = {
+		.name = "ip6_nh",
+		.entries = IP6_MAX_NEXT_HOPS,
+		.key_len = sizeof(struct nexthop6_key),
+		.socket_id = SOCKET_ID_ANY,
+		// NDP input nodes look up and create next hops from datapath workers.
+		.extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY
+			| RTE_HASH_EXTRA_FLAGS_MULTI_WRITER_ADD
+			| RTE_HASH_EXTRA_FLAGS_TRANS_MEM_SUPPORT,
+	};
+	nh_hash = rte_hash_create(&params);
+	if (nh_hash == NULL)
+		ABORT("rte_hash_create(ip6_nh)");
 
-	nh_gc_timer = event_new(ev_base, -1, EV_PERSIST | EV_FINALIZE, nexthop_gc, NULL);
-	if (nh_gc_timer == NULL)
-		ABORT("event_new() failed");
-	struct timeval tv = {.tv_sec = 1};
-	if (event_add(nh_gc_timer, &tv) < 0)
-		ABORT("event_add() failed");
+	learn_ring = rte_ring_create_elem(
+		"ip6_nh_learn",
+		sizeof(struct nh_learn_req),
+		IP6_NH_LEARN_RING_SIZE,
+		SOCKET_ID_ANY,
+		RING_F_MP_RTS_ENQ | RING_F_SC_DEQ
+	);
+	if (learn_ring == NULL)
+		ABORT("rte_ring_create(ip6_nh_learn): %s", rte_strerror(rte_errno));
+
+	learn_ev = gr_event_new(ev_base, -1, EV_FINALIZE, nh_learn_cb, NULL);
+	if (learn_ev == NULL)
+		ABORT("gr_event_new() failed");
+
+	nh_groups = rte_calloc(
+		__func__, IP6_MAX_NH_GROUPS, sizeof(struct nexthop6 *), RTE_CACHE_LINE_SIZE
+	);
+	if (nh_groups == NULL)
+		ABORT("rte_calloc(nh_groups): %s", rte_strerror(rte_errno));
 }
 
 static void nh6_fini(struct event_base *) {
-	event_free(nh_gc_timer);
-	nh_gc_timer = NULL;
+	for (uint32_t id = 1; id < IP6_MAX_NH_GROUPS; id++) {
+		if (nh_groups[id] != NULL)
+			rte_free(nh_groups[id]->group);
+	}
+	rte_free(nh_groups);
+	nh_groups = NULL;
+	gr_event_free(learn_ev);
+	learn_ev = NULL;
+	rte_ring_free(learn_ring);
+	learn_ring = NULL;
+	TAILQ_INIT(&learned_nhs);
+	n_learned = 0;
+	rte_hash_free(nh_hash);
+	nh_hash = NULL;
 	rte_mempool_free(nh_pool);
 	nh_pool = NULL;
 }
@@ -275,16 +1036,61 @@ static struct gr_api_handler nh6_add_handler = {
 	.name = "ipv6 nexthop add",
 	.request_type = GR_IP6_NH_ADD,
 	.callback = nh6_add,
+	.flags = GR_API_F_CONFIG,
 };
 static struct gr_api_handler nh6_del_handler = {
 	.name = "ipv6 nexthop del",
 	.request_type = GR_IP6_NH_DEL,
 	.callback = nh6_del,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler nh6_add_bulk_handler = {
+	.name = "ipv6 nexthop add bulk",
+	.request_type = GR_IP6_NH_ADD_BULK,
+	.callback = nh6_add_bulk,
+	.check = nh6_add_bulk_check,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler nh6_del_bulk_handler = {
+	.name = "ipv6 nexthop del bulk",
+	.request_type = GR_IP6_NH_DEL_BULK,
+	.callback = nh6_del_bulk,
+	.check = nh6_del_bulk_check,
+	.flags = GR_API_F_CONFIG,
 };
 static struct gr_api_handler nh6_list_handler = {
 	.name = "ipv6 nexthop list",
 	.request_type = GR_IP6_NH_LIST,
 	.callback = nh6_list,
+	.flags = GR_API_F_READ | GR_API_F_IOV,
+};
+static struct gr_api_handler nh6_group_add_handler = {
+	.name = "ipv6 nexthop group add",
+	.request_type = GR_IP6_NH_GROUP_ADD,
+	.callback = nh6_group_add,
+	.check = nh6_group_add_check,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler nh6_group_del_handler = {
+	.name = "ipv6 nexthop group del",
+	.request_type = GR_IP6_NH_GROUP_DEL,
+	.callback = nh6_group_del,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler nh6_group_list_handler = {
+	.name = "ipv6 nexthop group list",
+	.request_type = GR_IP6_NH_GROUP_LIST,
+	.callback = nh6_group_list,
+	.flags = GR_API_F_READ,
+};
+
+static void nh6_usage(uint64_t bytes[RTE_MAX_NUMA_NODES]) {
+	gr_mem_account_mempool(bytes, nh_pool);
+}
+
+static struct gr_mem_reporter nh6_reporter = {
+	.name = "ipv6 nexthops",
+	.usage = nh6_usage,
 };
 
 static struct gr_module nh6_module = {
@@ -297,6 +1103,13 @@ static struct gr_module nh6_module = {
 RTE_INIT(control_ip_init) {
 	gr_register_api_handler(&nh6_add_handler);
 	gr_register_api_handler(&nh6_del_handler);
+	gr_register_api_handler(&nh6_add_bulk_handler);
+	gr_register_api_handler(&nh6_del_bulk_handler);
 	gr_register_api_handler(&nh6_list_handler);
+	gr_register_api_handler(&nh6_group_add_handler);
+	gr_register_api_handler(&nh6_group_del_handler);
+	gr_register_api_handler(&nh6_group_list_handler);
 	gr_register_module(&nh6_module);
+	gr_mem_reporter_register(&nh6_reporter);
+	iface_event_register_handler(&nh_iface_event_handler);
 }
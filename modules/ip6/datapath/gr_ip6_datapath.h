@@ -14,8 +14,11 @@
 #include <rte_ether.h>
 #include <rte_graph_worker.h>
 #include <rte_ip6.h>
+#include <rte_jhash.h>
+#include <rte_mbuf.h>
 
 #include <stdint.h>
+#include <string.h>
 
 GR_MBUF_PRIV_DATA_TYPE(ip6_output_mbuf_data, {
 	const struct iface *input_iface;
@@ -27,18 +30,27 @@ GR_MBUF_PRIV_DATA_TYPE(ndp_mbuf_data, {
 	struct nexthop6 *remote;
 });
 
-GR_MBUF_PRIV_DATA_TYPE(ip6_local_mbuf_data, {
+// The input interface and next hop are preserved for local and tunneled packets.
+GR_MBUF_PRIV_DATA_EXTENDS(ip6_local_mbuf_data, ip6_output_mbuf_data, {
 	struct rte_ipv6_addr src;
 	struct rte_ipv6_addr dst;
-	uint16_t len;
+	uint16_t len; // upper layer length, without the extension headers
 	uint8_t hop_limit;
-	uint8_t proto;
-	const struct iface *input_iface;
+	uint8_t proto; // upper layer protocol, or IPPROTO_ROUTING
+	// Length of the extension headers between the IPv6 header and the
+	// packet data. The IPv6 header starts sizeof(rte_ipv6_hdr) + ext_len
+	// bytes before the data.
+	uint16_t ext_len;
 });
 
 void ip6_input_local_add_proto(uint8_t proto, const char *next_node);
 void ip6_output_add_tunnel(uint16_t iface_type_id, const char *next_node);
+// Forward multicast packets to groups beyond link-local scope that have no
+// local member to next_node instead of dropping them.
+void ip6_input_mcast_register(const char *next_node);
 int ip6_nexthop_solicit(struct nexthop6 *nh);
+// Re-inject the packets held by a reachable next hop into ip6_output.
+int ip6_hold_flush(struct nexthop6 *nh);
 
 #define IP6_DEFAULT_HOP_LIMIT 255
 
@@ -57,6 +69,36 @@ static inline void ip6_set_fields(
 	ip->dst_addr = *dst;
 }
 
+// Multicast group beyond link-local scope.
+static inline bool ip6_mcast_routable(const struct rte_ipv6_addr *dst) {
+	return rte_ipv6_mc_scope(dst) > RTE_IPV6_MC_SCOPE_LINKLOCAL;
+}
+
+// Flow hash used to select ECMP next hops. Use the RSS hash computed by the NIC
+// when available. Otherwise, hash the addresses, flow label and protocol. L4
+// ports are only included when no extension header precedes them.
+static inline uint32_t ip6_flow_hash(const struct rte_mbuf *m, const struct rte_ipv6_hdr *ip) {
+	uint32_t ports = 0;
+
+	if (m->ol_flags & RTE_MBUF_F_RX_RSS_HASH)
+		return m->hash.rss;
+
+	switch (ip->proto) {
+	case IPPROTO_TCP:
+	case IPPROTO_UDP:
+	case IPPROTO_SCTP:
+		if (rte_pktmbuf_data_len(m) >= sizeof(*ip) + sizeof(ports))
+			memcpy(&ports, ip + 1, sizeof(ports));
+		break;
+	}
+
+	return rte_jhash(
+		&ip->src_addr,
+		2 * sizeof(ip->src_addr),
+		ports ^ (ip->vtc_flow & RTE_BE32(RTE_IPV6_HDR_FL_MASK)) ^ ip->proto
+	);
+}
+
 void ndp_update_nexthop(
 	struct rte_graph *graph,
 	struct rte_node *node,
@@ -16,19 +16,51 @@
 
 enum {
 	ICMP6_OUTPUT = 0,
+	IP6_OUTPUT,
 	NEIGH_SOLICIT,
 	NEIGH_ADVERT,
 	BAD_CHECKSUM,
 	INVALID,
 	UNSUPPORTED,
+	NO_ROUTE,
 	EDGE_COUNT,
 };
 
+// Turn an echo request into its reply in place. Swapping the addresses does
+// not change the pseudo header sum, the ICMPv6 checksum is only updated for
+// the type change. The reply bypasses icmp6_output and goes straight to
+// ip6_output. Requests with extension headers take the icmp6_output path.
+static inline rte_edge_t
+icmp6_echo_reply(struct rte_mbuf *mbuf, struct icmp6 *icmp6, struct ip6_local_mbuf_data *d) {
+	rte_be16_t old = *(rte_be16_t *)icmp6; // type and code
+	struct rte_ipv6_addr tmp;
+	struct rte_ipv6_hdr *ip;
+	struct nexthop6 *nh;
+
+	icmp6->type = ICMP6_TYPE_ECHO_REPLY;
+	tmp = d->dst;
+	d->dst = d->src;
+	d->src = tmp;
+	if (d->ext_len != 0)
+		return ICMP6_OUTPUT;
+
+	icmp6->cksum = gr_cksum_update16(icmp6->cksum, old, *(rte_be16_t *)icmp6);
+
+	// the original IPv6 header is still in the headroom
+	ip = (struct rte_ipv6_hdr *)rte_pktmbuf_prepend(mbuf, sizeof(*ip));
+	ip6_set_fields(ip, d->len, IPPROTO_ICMPV6, &d->src, &d->dst);
+
+	if ((nh = ip6_route_lookup(d->input_iface->vrf_id, &d->dst)) == NULL)
+		return NO_ROUTE;
+	d->nh = nh;
+
+	return IP6_OUTPUT;
+}
+
 static uint16_t
 icmp6_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
 	struct ip6_local_mbuf_data *d;
 	struct icmp6 *icmp6;
-	struct rte_ipv6_addr tmp_ip;
 	struct rte_mbuf *mbuf;
 	rte_edge_t next;
 
@@ -43,12 +75,7 @@ icmp6_input_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 				next = INVALID;
 				goto next;
 			}
-			icmp6->type = ICMP6_TYPE_ECHO_REPLY;
-			// swap source/destination addresses
-			tmp_ip = d->dst;
-			d->dst = d->src;
-			d->src = tmp_ip;
-			next = ICMP6_OUTPUT;
+			next = icmp6_echo_reply(mbuf, icmp6, d);
 			break;
 		case ICMP6_TYPE_NEIGH_SOLICIT:
 			next = NEIGH_SOLICIT;
@@ -80,11 +107,13 @@ static struct rte_node_register icmp6_input_node = {
 	.nb_edges = EDGE_COUNT,
 	.next_nodes = {
 		[ICMP6_OUTPUT] = "icmp6_output",
+		[IP6_OUTPUT] = "ip6_output",
 		[NEIGH_SOLICIT] = "ndp_ns_input",
 		[NEIGH_ADVERT] = "ndp_na_input",
 		[BAD_CHECKSUM] = "icmp6_input_bad_checksum",
 		[INVALID] = "icmp6_input_invalid",
 		[UNSUPPORTED] = "icmp6_input_unsupported",
+		[NO_ROUTE] = "icmp6_output_no_route",
 	},
 };
 
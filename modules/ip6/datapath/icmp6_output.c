@@ -27,9 +27,7 @@ static uint16_t icmp6_output_process(
 	void **objs,
 	uint16_t nb_objs
 ) {
-	struct ip6_output_mbuf_data *o;
 	struct ip6_local_mbuf_data *d;
-	const struct iface *iface;
 	struct rte_ipv6_hdr *ip;
 	struct rte_mbuf *mbuf;
 	struct nexthop6 *nh;
@@ -49,16 +47,13 @@ static uint16_t icmp6_output_process(
 		ip6_set_fields(ip, d->len, IPPROTO_ICMPV6, &d->src, &d->dst);
 		// Compute ICMP6 checksum with pseudo header
 		icmp6->cksum = 0;
-		icmp6->cksum = rte_ipv6_udptcp_cksum(ip, icmp6);
+		icmp6->cksum = rte_ipv6_udptcp_cksum_mbuf(mbuf, ip, sizeof(*ip));
 
 		if ((nh = ip6_route_lookup(d->input_iface->vrf_id, &d->dst)) == NULL) {
 			edge = NO_ROUTE;
 			goto next;
 		}
-		o = ip6_output_mbuf_data(mbuf);
-		iface = d->input_iface;
-		o->nh = nh;
-		o->input_iface = iface;
+		d->nh = nh;
 		edge = OUTPUT;
 next:
 		rte_node_enqueue_x1(graph, node, edge, mbuf);
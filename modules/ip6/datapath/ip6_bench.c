@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_eth_input.h>
+#include <gr_ip6_control.h>
+#include <gr_ip6_datapath.h>
+#include <gr_macro.h>
+#include <gr_node_bench.h>
+#include <gr_port.h>
+#include <gr_sample.h>
+
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_ip6.h>
+#include <rte_mbuf.h>
+
+#include <netinet/in.h>
+#include <string.h>
+
+#define PAYLOAD_LEN 8
+
+static const struct rte_ipv6_addr src_addr = {
+	{0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01}
+};
+static const struct rte_ipv6_addr dst_addr = {
+	{0x20, 0x01, 0x0d, 0xb8, 0, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01}
+};
+static const struct rte_ipv6_addr mcast_addr = {
+	{0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01}
+};
+
+static struct iface *port;
+static struct nexthop6 nh;
+
+// mocked types/functions
+struct sample_worker sample_workers[RTE_MAX_LCORE];
+void gr_eth_input_add_type(rte_be16_t, const char *) { }
+int ip6_nexthop_solicit(struct nexthop6 *) {
+	return 0;
+}
+int ip6_hold_flush(struct nexthop6 *) {
+	return 0;
+}
+int ip6_nexthop_learn_held(const struct nexthop6 *) {
+	return 0;
+}
+struct nexthop6 *ip6_mcast_get_member(uint16_t, const struct rte_ipv6_addr *) {
+	return &nh;
+}
+void ip6_route_lookup_bulk(
+	uint16_t,
+	unsigned n,
+	const struct rte_ipv6_addr *,
+	struct nexthop6 **nhs
+) {
+	for (unsigned i = 0; i < n; i++)
+		nhs[i] = &nh;
+}
+
+static void ip6_packet(struct rte_mbuf *m, const struct rte_ipv6_addr *dst) {
+	struct rte_ipv6_hdr *ip;
+
+	ip = (struct rte_ipv6_hdr *)rte_pktmbuf_append(m, sizeof(*ip) + PAYLOAD_LEN);
+	memset(ip, 0, sizeof(*ip) + PAYLOAD_LEN);
+	ip->vtc_flow = RTE_BE32(0x60000000);
+	ip->payload_len = RTE_BE16(PAYLOAD_LEN);
+	ip->proto = IPPROTO_UDP;
+	ip->hop_limits = 64;
+	ip->src_addr = src_addr;
+	ip->dst_addr = *dst;
+}
+
+static void ip6_input_forward(struct rte_mbuf *m, uint16_t) {
+	struct eth_input_mbuf_data *e = eth_input_mbuf_data(m);
+
+	ip6_packet(m, &dst_addr);
+	e->iface = port;
+	e->eth_dst = ETH_DST_LOCAL;
+}
+
+static void ip6_input_mcast(struct rte_mbuf *m, uint16_t) {
+	struct eth_input_mbuf_data *e = eth_input_mbuf_data(m);
+
+	ip6_packet(m, &mcast_addr);
+	e->iface = port;
+	e->eth_dst = ETH_DST_MULTICAST;
+}
+
+static void ip6_forward_prepare(struct rte_mbuf *m, uint16_t) {
+	ip6_packet(m, &dst_addr);
+}
+
+static void ip6_output_prepare(struct rte_mbuf *m, uint16_t) {
+	struct ip6_output_mbuf_data *d = ip6_output_mbuf_data(m);
+
+	ip6_packet(m, &dst_addr);
+	d->input_iface = port;
+	d->nh = &nh;
+}
+
+static const struct node_bench benches[] = {
+	{"ip6_input/forward", "ip6_input", 0, ip6_input_forward, "ip6_forward"},
+	{"ip6_input/forward/burst1", "ip6_input", 1, ip6_input_forward, "ip6_forward"},
+	{"ip6_input/multicast", "ip6_input", 0, ip6_input_mcast, "ip6_input_local"},
+	{"ip6_forward", "ip6_forward", 0, ip6_forward_prepare, "ip6_output"},
+	{"ip6_output/reachable", "ip6_output", 0, ip6_output_prepare, "eth_output"},
+};
+
+int main(void) {
+	port = node_bench_iface_add(GR_IFACE_TYPE_PORT, 0, sizeof(struct iface_info_port));
+	nh.flags = GR_IP6_NH_F_REACHABLE | GR_IP6_NH_F_GATEWAY;
+	nh.iface_id = port->id;
+	nh.lladdr = (struct rte_ether_addr) {{0x02, 0x00, 0x00, 0x00, 0x00, 0x02}};
+
+	node_bench_init();
+
+	return node_bench_run(benches, ARRAY_DIM(benches));
+}
@@ -8,8 +8,10 @@
 #include <gr_ip6_datapath.h>
 #include <gr_log.h>
 #include <gr_mbuf.h>
+#include <gr_token_bucket.h>
 
 #include <rte_common.h>
+#include <rte_cycles.h>
 #include <rte_graph_worker.h>
 #include <rte_ip.h>
 
@@ -17,9 +19,34 @@ enum edges {
 	ICMP_OUTPUT = 0,
 	NO_HEADROOM,
 	NO_IP,
+	RATE_LIMITED,
 	EDGE_COUNT,
 };
 
+// Stored in the node context area. One instance per worker.
+struct ip6_error_ctx {
+	struct token_bucket bucket;
+	uint8_t icmp_type;
+};
+
+static_assert(sizeof(struct ip6_error_ctx) <= RTE_NODE_CTX_SZ);
+
+// Refill the bucket once per burst. Returns false if errors are not limited.
+static inline bool ip6_error_limit_refill(struct ip6_error_ctx *ctx) {
+	const struct gr_ip6_icmp_limit *l = ip6_icmp_limit_get(ctx->icmp_type);
+	uint32_t rate, burst;
+
+	if (l == NULL)
+		return false;
+	rate = __atomic_load_n(&l->rate, __ATOMIC_RELAXED);
+	if (rate == 0)
+		return false;
+	burst = __atomic_load_n(&l->burst, __ATOMIC_RELAXED);
+	token_bucket_refill(&ctx->bucket, rate, burst, rte_rdtsc());
+
+	return true;
+}
+
 static uint16_t
 ip6_error_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
 	struct icmp6_err_dest_unreach *du;
@@ -31,13 +58,23 @@ ip6_error_process(struct rte_graph *graph, struct rte_node *node, void **objs, u
 	struct rte_mbuf *mbuf;
 	struct nexthop6 *nh;
 	struct icmp6 *icmp6;
+	struct ip6_error_ctx *ctx;
 	rte_edge_t edge;
+	bool limited;
 
-	icmp_type = node->ctx[0];
+	ctx = (struct ip6_error_ctx *)node->ctx;
+	icmp_type = ctx->icmp_type;
+	limited = ip6_error_limit_refill(ctx);
 
 	for (uint16_t i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
 
+		// Drop excess errors before touching the packet.
+		if (limited && !token_bucket_take(&ctx->bucket)) {
+			edge = RATE_LIMITED;
+			goto next;
+		}
+
 		// Get the pointer to the start of the ipv6 header before
 		// prepending any data
 		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv6_hdr *);
@@ -93,7 +130,6 @@ ip6_error_process(struct rte_graph *graph, struct rte_node *node, void **objs, u
 		d->src = nh->ip;
 		d->dst = ip->src_addr;
 		d->len = rte_pktmbuf_pkt_len(mbuf);
-		d->input_iface = iface;
 		edge = ICMP_OUTPUT;
 next:
 		rte_node_enqueue_x1(graph, node, edge, mbuf);
@@ -103,12 +139,14 @@ next:
 }
 
 static int ttl_exceeded_init(const struct rte_graph *, struct rte_node *node) {
-	node->ctx[0] = ICMP6_ERR_TTL_EXCEEDED;
+	struct ip6_error_ctx *ctx = (struct ip6_error_ctx *)node->ctx;
+	ctx->icmp_type = ICMP6_ERR_TTL_EXCEEDED;
 	return 0;
 }
 
 static int no_route_init(const struct rte_graph *, struct rte_node *node) {
-	node->ctx[0] = ICMP6_ERR_DEST_UNREACH;
+	struct ip6_error_ctx *ctx = (struct ip6_error_ctx *)node->ctx;
+	ctx->icmp_type = ICMP6_ERR_DEST_UNREACH;
 	return 0;
 }
 
@@ -120,6 +158,7 @@ static struct rte_node_register dest_unreach_node = {
 		[ICMP_OUTPUT] = "icmp6_output",
 		[NO_HEADROOM] = "error_no_headroom",
 		[NO_IP] = "error_no_local_ip",
+		[RATE_LIMITED] = "ip6_error_rate_limited",
 	},
 	.init = no_route_init,
 };
@@ -132,6 +171,7 @@ static struct rte_node_register ttl_exceeded_node = {
 		[ICMP_OUTPUT] = "icmp6_output",
 		[NO_HEADROOM] = "error_no_headroom",
 		[NO_IP] = "error_no_local_ip",
+		[RATE_LIMITED] = "ip6_error_rate_limited",
 	},
 	.init = ttl_exceeded_init,
 };
@@ -146,3 +186,5 @@ static struct gr_node_info ttl_exceeded_info = {
 
 GR_NODE_REGISTER(dest_unreach_info);
 GR_NODE_REGISTER(ttl_exceeded_info);
+
+GR_DROP_REGISTER(ip6_error_rate_limited);
@@ -1,12 +1,18 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // Copyright (c) 2024 Robin Jarry
 
+#include <gr_datapath.h>
 #include <gr_graph.h>
+#include <gr_mbuf.h>
 
 #include <rte_fib6.h>
 #include <rte_graph_worker.h>
 #include <rte_ip.h>
 #include <rte_mbuf.h>
+#include <rte_vect.h>
+
+#include <stddef.h>
+#include <string.h>
 
 enum edges {
 	OUTPUT = 0,
@@ -14,23 +20,97 @@ enum edges {
 	EDGE_COUNT,
 };
 
+#if (defined(RTE_ARCH_X86) || defined(RTE_ARCH_ARM64)) && RTE_BYTE_ORDER == RTE_LITTLE_ENDIAN
+// Number of headers updated at once by hop_limit_decrement_x4().
+#define HOP_LIMIT_LANES 4
+#endif
+
+#define HOP_LIMIT_WORD_OFFSET offsetof(struct rte_ipv6_hdr, payload_len)
+
+#ifdef HOP_LIMIT_LANES
+// Decrement the hop limit of four headers at once. Each 32-bit word holds the
+// payload_len, proto and hop_limits fields, loaded in host order. The words are
+// left untouched if any hop limit is expired.
+static inline bool hop_limit_decrement_x4(uint32_t *words) {
+#ifdef RTE_ARCH_X86
+	__m128i w = _mm_loadu_si128((const __m128i *)words);
+	__m128i hl = _mm_srli_epi32(w, 24);
+
+	if (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(hl, _mm_set1_epi32(2)))) != 0)
+		return false;
+
+	_mm_storeu_si128((__m128i *)words, _mm_sub_epi32(w, _mm_set1_epi32(1 << 24)));
+#else
+	uint32x4_t w = vld1q_u32(words);
+
+	if (vmaxvq_u32(vcltq_u32(w, vdupq_n_u32(2 << 24))) != 0)
+		return false;
+
+	vst1q_u32(words, vsubq_u32(w, vdupq_n_u32(1 << 24)));
+#endif
+	return true;
+}
+#endif
+
+static inline void ip6_forward_one(
+	struct gr_spec_stream *s,
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t i
+) {
+	struct rte_ipv6_hdr *ip;
+
+	ip = rte_pktmbuf_mtod((struct rte_mbuf *)objs[i], struct rte_ipv6_hdr *);
+	if (ip->hop_limits <= 1) {
+		gr_spec_stream_enqueue(s, graph, node, objs, i, TTL_EXCEEDED);
+		return;
+	}
+	ip->hop_limits -= 1;
+	gr_spec_stream_enqueue(s, graph, node, objs, i, OUTPUT);
+}
+
 static uint16_t
 ip6_forward_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
-	struct rte_ipv6_hdr *ip;
-	struct rte_mbuf *mbuf;
-	uint16_t i;
+#ifdef HOP_LIMIT_LANES
+	uint32_t words[HOP_LIMIT_LANES];
+	void *ptrs[HOP_LIMIT_LANES];
+	uint16_t j;
+#endif
+	struct gr_spec_stream s;
+	uint16_t i = 0;
 
-	for (i = 0; i < nb_objs; i++) {
-		mbuf = objs[i];
-		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv6_hdr *);
+	// When no hop limit is expired, the whole batch is moved to ip6_output
+	// without copying the packet pointers.
+	gr_spec_stream_init(&s, node, nb_objs);
 
-		if (ip->hop_limits <= 1) {
-			rte_node_enqueue_x1(graph, node, TTL_EXCEEDED, mbuf);
+#ifdef HOP_LIMIT_LANES
+	for (; i + HOP_LIMIT_LANES <= nb_objs; i += HOP_LIMIT_LANES) {
+		for (j = 0; j < HOP_LIMIT_LANES; j++) {
+			gr_mbuf_prefetch_ahead(objs, i + j, nb_objs);
+			ptrs[j] = rte_pktmbuf_mtod_offset(
+				(struct rte_mbuf *)objs[i + j], void *, HOP_LIMIT_WORD_OFFSET
+			);
+			memcpy(&words[j], ptrs[j], sizeof(words[j]));
+		}
+		if (unlikely(!hop_limit_decrement_x4(words))) {
+			for (j = 0; j < HOP_LIMIT_LANES; j++)
+				ip6_forward_one(&s, graph, node, objs, i + j);
 			continue;
 		}
-		ip->hop_limits -= 1;
-		rte_node_enqueue_x1(graph, node, OUTPUT, mbuf);
+		for (j = 0; j < HOP_LIMIT_LANES; j++) {
+			memcpy(ptrs[j], &words[j], sizeof(words[j]));
+			gr_spec_stream_enqueue(&s, graph, node, objs, i + j, OUTPUT);
+		}
 	}
+#endif
+
+	for (; i < nb_objs; i++) {
+		gr_mbuf_prefetch_ahead(objs, i, nb_objs);
+		ip6_forward_one(&s, graph, node, objs, i);
+	}
+
+	gr_spec_stream_flush(&s, graph, node);
 
 	return nb_objs;
 }
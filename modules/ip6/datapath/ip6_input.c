@@ -6,6 +6,9 @@
 #include <gr_ip6_control.h>
 #include <gr_ip6_datapath.h>
 #include <gr_log.h>
+#include <gr_mbuf.h>
+#include <gr_sample.h>
+#include <gr_vrf_stats.h>
 
 #include <rte_byteorder.h>
 #include <rte_errno.h>
@@ -15,6 +18,13 @@
 #include <rte_ip6.h>
 #include <rte_mbuf.h>
 #include <rte_mbuf_dyn.h>
+#include <rte_mbuf_ptype.h>
+
+#include <netinet/in.h>
+#include <string.h>
+
+// The input interface set by eth_input is left in place for the next nodes.
+GR_MBUF_PRIV_OVERLAP(eth_input_mbuf_data, iface, ip6_output_mbuf_data, input_iface);
 
 enum edges {
 	FORWARD = 0,
@@ -25,94 +35,235 @@ enum edges {
 	BAD_VERSION,
 	BAD_ADDR,
 	BAD_LENGTH,
+	RPF_FAIL,
 	EDGE_COUNT,
 };
 
+// Sentinel edge value for packets that passed validation and need a route lookup.
+#define LOOKUP EDGE_COUNT
+
+// Multicast packets to groups that have no local member are dropped unless
+// a multicast forwarding node is registered.
+static rte_edge_t mcast_edge = NOT_MEMBER;
+
+void ip6_input_mcast_register(const char *next_node) {
+	LOG(DEBUG, "ip6_input: multicast -> %s", next_node);
+	if (mcast_edge != NOT_MEMBER)
+		ABORT("next node already registered for multicast");
+	mcast_edge = gr_node_attach_parent("ip6_input", next_node);
+}
+
+// Unicast reverse path forwarding (RFC 3704). In strict mode, the route to the
+// source address must go through the input interface (or one of the members
+// of an ECMP group). In loose mode, any route to the source address will do.
+static inline bool rpf_check(const struct iface *iface, const struct nexthop6 *nh) {
+	if (nh == NULL)
+		return false;
+	if (!(iface->flags & GR_IFACE_F_RPF_STRICT))
+		return true;
+	if (nh->flags & GR_IP6_NH_F_GROUP) {
+		for (unsigned i = 0; i < nh->group->n_members; i++) {
+			const struct nexthop6 *m = nh->group->members[i];
+			if (m->iface_id == iface->id)
+				return true;
+		}
+		return false;
+	}
+	return nh->iface_id == iface->id;
+}
+
+static void ip6_input_lookup(
+	struct rte_mbuf **mbufs,
+	rte_edge_t *edges,
+	struct nexthop6 **nhs,
+	uint16_t *vrfs,
+	uint16_t count
+) {
+	// destinations followed by the sources of packets that need an RPF check
+	struct rte_ipv6_addr dst[RTE_GRAPH_BURST_SIZE * 2];
+	struct nexthop6 *res[RTE_GRAPH_BURST_SIZE * 2];
+	struct rte_ipv6_addr src[RTE_GRAPH_BURST_SIZE];
+	uint16_t idx[RTE_GRAPH_BURST_SIZE];
+	// 1-based index in src, 0 if the input interface has no RPF check
+	uint16_t rpf[RTE_GRAPH_BURST_SIZE];
+	const struct rte_ipv6_hdr *ip;
+	const struct iface *iface;
+	uint16_t i, j, n, m, vrf_id;
+
+	// Group the packets by VRF and resolve all destinations of each group
+	// with a single FIB lookup. Most bursts only contain one VRF and this
+	// loop runs exactly once.
+	for (i = 0; i < count; i++) {
+		if (edges[i] != LOOKUP)
+			continue;
+
+		vrf_id = vrfs[i];
+		n = 0;
+		m = 0;
+		for (j = i; j < count; j++) {
+			if (edges[j] != LOOKUP || vrfs[j] != vrf_id)
+				continue;
+			ip = rte_pktmbuf_mtod(mbufs[j], const struct rte_ipv6_hdr *);
+			dst[n] = ip->dst_addr;
+			idx[n] = j;
+			rpf[n] = 0;
+			iface = eth_input_mbuf_data(mbufs[j])->iface;
+			// link-local sources are always on-link
+			if (unlikely(iface->flags & GR_IFACE_F_RPF)
+			    && !rte_ipv6_addr_is_linklocal(&ip->src_addr)) {
+				src[m++] = ip->src_addr;
+				rpf[n] = m;
+			}
+			n++;
+		}
+		// Sources are resolved in the same FIB lookup as destinations.
+		memcpy(&dst[n], src, m * sizeof(*src));
+
+		ip6_route_lookup_bulk(vrf_id, n + m, dst, res);
+
+		for (j = 0; j < n; j++) {
+			struct nexthop6 *nh = res[j];
+			uint16_t k = idx[j];
+
+			if (unlikely(rpf[j] != 0)) {
+				iface = eth_input_mbuf_data(mbufs[k])->iface;
+				if (!rpf_check(iface, res[n + rpf[j] - 1])) {
+					edges[k] = RPF_FAIL;
+					continue;
+				}
+			}
+			nhs[k] = nh;
+			if (nh == NULL)
+				edges[k] = DEST_UNREACH;
+			// If the resolved next hop is local and the destination IP is
+			// ourselves, send to ip6_local.
+			else if (nh->flags & GR_IP6_NH_F_LOCAL && rte_ipv6_addr_eq(&dst[j], &nh->ip))
+				edges[k] = LOCAL;
+			else
+				edges[k] = FORWARD;
+		}
+	}
+}
+
+static void ip6_input_sample(
+	struct sample *sample,
+	const struct iface *iface,
+	const struct nexthop6 *nh,
+	rte_edge_t edge
+) {
+	const struct rte_ipv6_hdr *ip = (const struct rte_ipv6_hdr *)sample->header;
+
+	sample->iface_id = iface->id;
+	sample->vrf_id = iface->vrf_id;
+	sample->af = AF_INET6;
+	sample->out_iface_id = GR_IFACE_ID_UNDEF;
+	memset(&sample->nh, 0, sizeof(sample->nh));
+	if (nh != NULL && edge == FORWARD) {
+		sample->out_iface_id = nh->iface_id;
+		// connected destinations are their own next hop
+		if (nh->flags & GR_IP6_NH_F_LINK && sample->header_len >= sizeof(*ip))
+			sample->nh.ip6 = ip->dst_addr;
+		else
+			sample->nh.ip6 = nh->ip;
+	}
+	sample_push(sample);
+}
+
 static uint16_t
 ip6_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
-	struct ip6_output_mbuf_data *d;
+	struct nexthop6 *nhs[RTE_GRAPH_BURST_SIZE];
+	rte_edge_t edges[RTE_GRAPH_BURST_SIZE];
+	uint16_t vrfs[RTE_GRAPH_BURST_SIZE];
+	struct iface_sampler *sampler;
 	struct eth_input_mbuf_data *e;
 	const struct iface *iface;
+	struct rte_mbuf **mbufs;
 	struct rte_ipv6_hdr *ip;
+	struct sample *sample;
 	struct rte_mbuf *mbuf;
-	struct nexthop6 *nh;
-	rte_edge_t edge;
-	uint16_t i;
-
-	for (i = 0; i < nb_objs; i++) {
-		mbuf = objs[i];
-		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv6_hdr *);
-		e = eth_input_mbuf_data(mbuf);
-		d = ip6_output_mbuf_data(mbuf);
-		iface = e->iface;
-		nh = NULL;
-
-		if (rte_ipv6_check_version(ip)) {
-			edge = BAD_VERSION;
-			goto next;
-		}
+	uint16_t i, n, count;
 
-		if (rte_ipv6_addr_is_mcast(&ip->src_addr)
-		    || rte_ipv6_addr_is_unspec(&ip->dst_addr)) {
-			edge = BAD_ADDR;
-			goto next;
-		}
+	for (n = 0; n < nb_objs; n += count) {
+		count = RTE_MIN(nb_objs - n, RTE_GRAPH_BURST_SIZE);
+		mbufs = (struct rte_mbuf **)&objs[n];
+
+		for (i = 0; i < count; i++) {
+			mbuf = mbufs[i];
+			gr_mbuf_prefetch_ahead((void **)mbufs, i, count);
+			ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv6_hdr *);
+			e = eth_input_mbuf_data(mbuf);
+			iface = e->iface;
+			nhs[i] = NULL;
+			vrfs[i] = iface->vrf_id;
+
+			// already checked by hardware if classified as IPv6
+			if (!RTE_ETH_IS_IPV6_HDR(mbuf->packet_type) && rte_ipv6_check_version(ip)) {
+				edges[i] = BAD_VERSION;
+				continue;
+			}
 
-		if (unlikely(rte_ipv6_addr_is_mcast(&ip->dst_addr))) {
-			switch (rte_ipv6_mc_scope(&ip->dst_addr)) {
-			case RTE_IPV6_MC_SCOPE_RESERVED:
-				// RFC4291 2.7:
-				// Nodes must not originate a packet to a multicast address
-				// whose scope field contains the reserved value 0; if such
-				// a packet is received, it must be silently dropped.
-			case RTE_IPV6_MC_SCOPE_IFACELOCAL:
-				// This should only happen if the input interface is a loopback
-				// interface. For now, we do not have support for these.
-				edge = BAD_ADDR;
+			if (rte_ipv6_addr_is_mcast(&ip->src_addr)
+			    || rte_ipv6_addr_is_unspec(&ip->dst_addr)) {
+				edges[i] = BAD_ADDR;
+				continue;
+			}
+
+			if (unlikely(rte_ipv6_addr_is_mcast(&ip->dst_addr))) {
+				switch (rte_ipv6_mc_scope(&ip->dst_addr)) {
+				case RTE_IPV6_MC_SCOPE_RESERVED:
+					// RFC4291 2.7:
+					// Nodes must not originate a packet to a multicast address
+					// whose scope field contains the reserved value 0; if such
+					// a packet is received, it must be silently dropped.
+				case RTE_IPV6_MC_SCOPE_IFACELOCAL:
+					// This should only happen if the input interface is a
+					// loopback interface. For now, we do not have support for
+					// these.
+					edges[i] = BAD_ADDR;
+					break;
+				default:
+					nhs[i] = ip6_mcast_get_member(iface->id, &ip->dst_addr);
+					if (nhs[i] != NULL)
+						edges[i] = LOCAL;
+					else if (ip6_mcast_routable(&ip->dst_addr))
+						edges[i] = mcast_edge;
+					else
+						edges[i] = NOT_MEMBER;
+				}
+				continue;
+			}
+
+			switch (e->eth_dst) {
+			case ETH_DST_LOCAL:
+				// Packet sent to our ethernet address.
+				edges[i] = LOOKUP;
+				break;
+			case ETH_DST_BROADCAST:
+			case ETH_DST_MULTICAST:
+				// Non unicast ethernet destination. No need for a route lookup.
+				edges[i] = LOCAL;
 				break;
+			case ETH_DST_OTHER:
 			default:
-				nh = ip6_mcast_get_member(iface->id, &ip->dst_addr);
-				if (nh == NULL)
-					edge = NOT_MEMBER;
-				else
-					edge = LOCAL;
+				// Drop all packets not sent to our ethernet address
+				edges[i] = OTHER_HOST;
+				break;
 			}
-			goto next;
 		}
 
-		switch (e->eth_dst) {
-		case ETH_DST_LOCAL:
-			// Packet sent to our ethernet address.
-			break;
-		case ETH_DST_BROADCAST:
-		case ETH_DST_MULTICAST:
-			// Non unicast ethernet destination. No need for a route lookup.
-			edge = LOCAL;
-			goto next;
-		case ETH_DST_OTHER:
-		default:
-			// Drop all packets not sent to our ethernet address
-			edge = OTHER_HOST;
-			goto next;
-		}
+		ip6_input_lookup(mbufs, edges, nhs, vrfs, count);
+		vrf_stats_count(VRF_STATS_IP6, mbufs, vrfs, count);
 
-		nh = ip6_route_lookup(iface->vrf_id, &ip->dst_addr);
-		if (nh == NULL) {
-			edge = DEST_UNREACH;
-			goto next;
+		for (i = 0; i < count; i++) {
+			iface = eth_input_mbuf_data(mbufs[i])->iface;
+			sampler = iface->sampler;
+			if (unlikely(sampler != NULL)
+			    && (sample = sample_take(sampler, mbufs[i])) != NULL)
+				ip6_input_sample(sample, iface, nhs[i], edges[i]);
+			// Store the resolved next hop for ip6_output to avoid a second route lookup.
+			ip6_output_mbuf_data(mbufs[i])->nh = nhs[i];
+			rte_node_enqueue_x1(graph, node, edges[i], mbufs[i]);
 		}
-
-		// If the resolved next hop is local and the destination IP is ourselves,
-		// send to ip6_local.
-		if (nh->flags & GR_IP6_NH_F_LOCAL && rte_ipv6_addr_eq(&ip->dst_addr, &nh->ip))
-			edge = LOCAL;
-		else
-			edge = FORWARD;
-
-next:
-		// Store the resolved next hop for ip6_output to avoid a second route lookup.
-		d->nh = nh;
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
 	}
 
 	return nb_objs;
@@ -137,6 +288,7 @@ static struct rte_node_register input_node = {
 		[BAD_VERSION] = "ip6_input_bad_version",
 		[BAD_ADDR] = "ip6_input_bad_addr",
 		[BAD_LENGTH] = "ip6_input_bad_length",
+		[RPF_FAIL] = "ip6_input_rpf_fail",
 	},
 };
 
@@ -152,3 +304,4 @@ GR_DROP_REGISTER(ip6_input_other_host);
 GR_DROP_REGISTER(ip6_input_bad_version);
 GR_DROP_REGISTER(ip6_input_bad_addr);
 GR_DROP_REGISTER(ip6_input_bad_length);
+GR_DROP_REGISTER(ip6_input_rpf_fail);
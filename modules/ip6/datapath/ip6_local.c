@@ -7,17 +7,81 @@
 #include <gr_ip6_datapath.h>
 #include <gr_log.h>
 
+#include <rte_cycles.h>
 #include <rte_graph_worker.h>
 #include <rte_ip6.h>
 #include <rte_mbuf.h>
 
+#include <netinet/in.h>
+
 enum {
 	UNKNOWN_PROTO = 0,
 	BAD_CHECKSUM,
+	BAD_EXT_HDR,
+	HBH_RATE_LIMIT,
 	EDGE_COUNT,
 };
 static rte_edge_t edges[256] = {UNKNOWN_PROTO};
 
+// Extension headers skipped before the upper layer protocol demux. Routing
+// headers are left for srv6_local. Fragments are not reassembled and AH is
+// not verified, they are demuxed as is.
+static const bool ext_hdrs[256] = {
+	[IPPROTO_HOPOPTS] = true,
+	[IPPROTO_DSTOPTS] = true,
+};
+
+// Longer extension header chains are dropped.
+#define IP6_EXT_HDRS_MAX 8
+
+// Hop-by-hop options headers accepted per second by each worker. Their
+// processing may be rate limited (RFC 9673), they are a known DoS vector.
+#define IP6_HBH_RATE_MAX 1000
+
+// Stored in the node context area. One instance per graph.
+struct ip6_local_ctx {
+	uint64_t hbh_window; // TSC value at the start of the current second
+	uint32_t hbh_count;
+};
+
+static_assert(sizeof(struct ip6_local_ctx) <= RTE_NODE_CTX_SZ);
+
+static inline bool hbh_allowed(struct ip6_local_ctx *ctx, uint64_t now) {
+	if (now - ctx->hbh_window >= rte_get_tsc_hz()) {
+		ctx->hbh_window = now;
+		ctx->hbh_count = 0;
+	}
+	return ++ctx->hbh_count <= IP6_HBH_RATE_MAX;
+}
+
+// Walk the extension header chain once. Returns the upper layer protocol and
+// stores the total length of the skipped headers in ext_len. Returns -1 if the
+// chain is truncated or too long.
+static inline int ext_hdrs_skip(const struct rte_mbuf *m, uint8_t proto, uint16_t *ext_len) {
+	const struct rte_ipv6_hdr *ip = rte_pktmbuf_mtod(m, const struct rte_ipv6_hdr *);
+	uint16_t payload_len = rte_be_to_cpu_16(ip->payload_len);
+	const uint8_t *hdr;
+	uint8_t buf[2];
+	uint16_t len;
+
+	len = 0;
+	for (unsigned n = 0; ext_hdrs[proto]; n++) {
+		if (n == IP6_EXT_HDRS_MAX)
+			return -1;
+		// next header and header length fields
+		hdr = rte_pktmbuf_read(m, sizeof(*ip) + len, sizeof(buf), buf);
+		if (hdr == NULL)
+			return -1;
+		proto = hdr[0];
+		len += (hdr[1] + 1) << 3;
+		if (len > payload_len)
+			return -1;
+	}
+	*ext_len = len;
+
+	return proto;
+}
+
 void ip6_input_local_add_proto(uint8_t proto, const char *next_node) {
 	LOG(DEBUG, "ip6_input_local: proto=%hhu -> %s", proto, next_node);
 	if (edges[proto] != UNKNOWN_PROTO)
@@ -31,50 +95,73 @@ static uint16_t ip6_input_local_process(
 	void **objs,
 	uint16_t nb_objs
 ) {
+	struct ip6_local_ctx *ctx = (struct ip6_local_ctx *)node->ctx;
 	struct ip6_local_mbuf_data *d;
-	const struct iface *iface;
 	struct rte_ipv6_hdr *ip;
+	uint16_t i, ext_len;
 	struct rte_mbuf *m;
 	rte_edge_t edge;
-	uint16_t i;
+	uint64_t now;
+	int proto;
+
+	now = rte_rdtsc();
 
 	for (i = 0; i < nb_objs; i++) {
 		m = objs[i];
 		ip = rte_pktmbuf_mtod(m, struct rte_ipv6_hdr *);
 
-		edge = edges[ip->proto];
+		// Most packets have no extension header.
+		proto = ip->proto;
+		ext_len = 0;
+		if (unlikely(ext_hdrs[proto])) {
+			if (proto == IPPROTO_HOPOPTS && !hbh_allowed(ctx, now)) {
+				edge = HBH_RATE_LIMIT;
+				goto next;
+			}
+			if ((proto = ext_hdrs_skip(m, proto, &ext_len)) < 0) {
+				edge = BAD_EXT_HDR;
+				goto next;
+			}
+		}
+
+		edge = edges[proto];
 		if (edge == UNKNOWN_PROTO)
 			goto next;
 
-		// prepare ip local data
-		iface = ip6_output_mbuf_data(m)->input_iface;
+		// prepare ip local data, input_iface is preserved
 		d = ip6_local_mbuf_data(m);
 		d->src = ip->src_addr;
 		d->dst = ip->dst_addr;
-		d->len = rte_be_to_cpu_16(ip->payload_len);
+		d->len = rte_be_to_cpu_16(ip->payload_len) - ext_len;
 		d->hop_limit = ip->hop_limits;
-		d->proto = ip->proto;
-		d->input_iface = iface;
-		rte_pktmbuf_adj(m, sizeof(*ip));
-
-		// strip IPv6 extension headers
-		while (rte_pktmbuf_pkt_len(m) > 0) {
-			size_t ext_size = 0;
-			int next_proto = rte_ipv6_get_next_ext(
-				rte_pktmbuf_mtod(m, uint8_t *), d->proto, &ext_size
-			);
-			if (next_proto < 0)
-				break;
-			rte_pktmbuf_adj(m, ext_size);
-			d->proto = next_proto;
-		};
+		d->proto = proto;
+		d->ext_len = ext_len;
+		rte_pktmbuf_adj(m, sizeof(*ip) + ext_len);
+
+		// tunneled packets have no checksum over the pseudo header
+		switch (d->proto) {
+		case IPPROTO_TCP:
+		case IPPROTO_UDP:
+		case IPPROTO_ICMPV6:
+			break;
+		default:
+			goto next;
+		}
 
 		// verify checksum if not already checked by hardware
 		switch (m->ol_flags & RTE_MBUF_F_RX_L4_CKSUM_MASK) {
 		case RTE_MBUF_F_RX_L4_CKSUM_NONE:
 		case RTE_MBUF_F_RX_L4_CKSUM_UNKNOWN:
-			if (rte_ipv6_udptcp_cksum_verify(ip, rte_pktmbuf_mtod(m, void *)))
+			if (unlikely(ext_len != 0)) {
+				// the pseudo header has the upper layer length and protocol
+				struct rte_ipv6_hdr phdr = *ip;
+				phdr.payload_len = rte_cpu_to_be_16(d->len);
+				phdr.proto = proto;
+				if (rte_ipv6_udptcp_cksum_mbuf_verify(m, &phdr, 0))
+					edge = BAD_CHECKSUM;
+			} else if (rte_ipv6_udptcp_cksum_mbuf_verify(m, ip, 0)) {
 				edge = BAD_CHECKSUM;
+			}
 			break;
 		case RTE_MBUF_F_RX_L4_CKSUM_BAD:
 			edge = BAD_CHECKSUM;
@@ -94,6 +181,8 @@ static struct rte_node_register input_node = {
 	.next_nodes = {
 		[UNKNOWN_PROTO] = "ip6_input_local_unknown_proto",
 		[BAD_CHECKSUM] = "ip6_input_local_bad_checksum",
+		[BAD_EXT_HDR] = "ip6_input_local_bad_ext_hdr",
+		[HBH_RATE_LIMIT] = "ip6_input_local_hbh_rate_limit",
 	},
 };
 
@@ -105,3 +194,5 @@ GR_NODE_REGISTER(info);
 
 GR_DROP_REGISTER(ip6_input_local_unknown_proto);
 GR_DROP_REGISTER(ip6_input_local_bad_checksum);
+GR_DROP_REGISTER(ip6_input_local_bad_ext_hdr);
+GR_DROP_REGISTER(ip6_input_local_hbh_rate_limit);
@@ -5,6 +5,7 @@
 #include <gr_eth_input.h>
 #include <gr_eth_output.h>
 #include <gr_graph.h>
+#include <gr_hold_queue.h>
 #include <gr_iface.h>
 #include <gr_ip6.h>
 #include <gr_ip6_control.h>
@@ -13,6 +14,7 @@
 #include <gr_mbuf.h>
 
 #include <rte_byteorder.h>
+#include <rte_cycles.h>
 #include <rte_ether.h>
 #include <rte_fib6.h>
 #include <rte_graph_worker.h>
@@ -24,6 +26,8 @@ enum {
 	DEST_UNREACH,
 	ERROR,
 	QUEUE_FULL,
+	LINK_DOWN,
+	NEIGH_FAILED,
 	EDGE_COUNT,
 };
 
@@ -46,30 +50,41 @@ typedef enum {
 
 static inline hold_status_t maybe_hold_packet(struct nexthop6 *nh, struct rte_mbuf *mbuf) {
 	struct rte_ipv6_hdr *ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv6_hdr *);
-	hold_status_t status;
-
-	if (nh->flags & GR_IP6_NH_F_REACHABLE || rte_ipv6_addr_is_mcast(&ip->dst_addr)) {
-		status = OK_TO_SEND;
-	} else if (nh->held_pkts_num < IP6_NH_MAX_HELD_PKTS) {
-		queue_mbuf_data(mbuf)->next = NULL;
-		rte_spinlock_lock(&nh->lock);
-		if (nh->held_pkts_head == NULL)
-			nh->held_pkts_head = mbuf;
-		else
-			queue_mbuf_data(nh->held_pkts_tail)->next = mbuf;
-		nh->held_pkts_tail = mbuf;
-		nh->held_pkts_num++;
-		rte_spinlock_unlock(&nh->lock);
-		if (!(nh->flags & GR_IP6_NH_F_PENDING)) {
-			ip6_nexthop_solicit(nh);
-			nh->flags |= GR_IP6_NH_F_PENDING;
-		}
-		status = HELD;
-	} else {
-		status = HOLD_QUEUE_FULL;
+
+	if (rte_ipv6_addr_is_mcast(&ip->dst_addr))
+		return OK_TO_SEND;
+	if (nh->flags & GR_IP6_NH_F_REACHABLE) {
+		ip6_nexthop_touch(nh);
+		return OK_TO_SEND;
+	}
+	if (hold_queue_full(&nh->neigh.held, NH_NEIGH_MAX_HELD_PKTS))
+		return HOLD_QUEUE_FULL;
+
+	hold_queue_push(&nh->neigh.held, mbuf, rte_get_tsc_cycles());
+	if (!(nh->flags & GR_IP6_NH_F_PENDING)) {
+		ip6_nexthop_solicit(nh);
+		nh->flags |= GR_IP6_NH_F_PENDING;
 	}
+	// The next hop may have been resolved and its queue flushed before the
+	// packet was pushed. Make sure it does not stay there.
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (unlikely(nh->flags & GR_IP6_NH_F_REACHABLE))
+		ip6_hold_flush(nh);
+
+	return HELD;
+}
+
+static inline hold_status_t hold_link_packet(struct nexthop6 *nh, struct rte_mbuf *mbuf) {
+	if (hold_queue_full(&nh->neigh.held, NH_NEIGH_MAX_HELD_PKTS))
+		return HOLD_QUEUE_FULL;
+
+	// Only notify the control plane when the queue was empty. It processes
+	// all packets held by the connected next hop at once. If the notification
+	// cannot be posted, the control plane will catch up with a full scan.
+	if (hold_queue_push(&nh->neigh.held, mbuf, rte_get_tsc_cycles()))
+		ip6_nexthop_learn_held(nh);
 
-	return status;
+	return HELD;
 }
 
 static uint16_t
@@ -86,6 +101,7 @@ ip6_output_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 
 	for (i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
+		gr_mbuf_prefetch_ahead(objs, i, nb_objs);
 		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv6_hdr *);
 
 		nh = ip6_output_mbuf_data(mbuf)->nh;
@@ -93,37 +109,41 @@ ip6_output_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 			edge = DEST_UNREACH;
 			goto next;
 		}
+		if (nh->flags & GR_IP6_NH_F_GROUP)
+			nh = nh_group_select(nh->group, ip6_flow_hash(mbuf, ip));
 		iface = iface_from_id(nh->iface_id);
 		if (iface == NULL) {
 			edge = ERROR;
 			goto next;
 		}
+		if (unlikely(nh->flags & GR_IP6_NH_F_DOWN)) {
+			edge = LINK_DOWN;
+			goto next;
+		}
 		// Determine what is the next node based on the output interface type
 		// By default, it will be eth_output unless another output node was registered.
 		edge = edges[iface->type_id];
-		if (edge != ETH_OUTPUT)
+		if (edge != ETH_OUTPUT) {
+			// Tunnel nodes need the selected group member.
+			ip6_output_mbuf_data(mbuf)->nh = nh;
 			goto next;
+		}
 
 		if (nh->flags & GR_IP6_NH_F_LINK && !rte_ipv6_addr_is_mcast(&ip->dst_addr)
 		    && !rte_ipv6_addr_eq(&ip->dst_addr, &nh->ip)) {
 			// The resolved next hop is associated with a "connected" route.
 			// We currently do not have an explicit entry for this destination IP.
-			// Create a new next hop and its associated /128 route so that next
-			// packets take it in priority with a single route lookup.
-			struct nexthop6 *remote = ip6_nexthop_new(
-				nh->vrf_id, nh->iface_id, &ip->dst_addr
-			);
-			if (remote == NULL) {
-				edge = ERROR;
-				goto next;
-			}
-			if (ip6_route_insert(nh->vrf_id, &ip->dst_addr, RTE_IPV6_MAX_DEPTH, remote)
-			    < 0) {
-				edge = ERROR;
-				goto next;
-			}
-			ip6_output_mbuf_data(mbuf)->nh = remote;
-			nh = remote;
+			// Creating a next hop and its /128 route is up to the control plane.
+			// Meanwhile, the packet waits in the connected next hop hold queue.
+			if (hold_link_packet(nh, mbuf) == HELD)
+				continue;
+			edge = QUEUE_FULL;
+			goto next;
+		}
+		if (unlikely(nh->flags & GR_IP6_NH_F_FAILED)) {
+			// Incomplete neighbor, do not solicit it again until it expires.
+			edge = NEIGH_FAILED;
+			goto next;
 		}
 
 		switch (maybe_hold_packet(nh, mbuf)) {
@@ -142,10 +162,12 @@ ip6_output_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 
 		// Prepare ethernet layer info.
 		eth_data = eth_output_mbuf_data(mbuf);
-		if (rte_ipv6_addr_is_mcast(&ip->dst_addr))
+		if (rte_ipv6_addr_is_mcast(&ip->dst_addr)) {
 			rte_ether_mcast_from_ipv6(&eth_data->dst, &ip->dst_addr);
-		else
-			eth_data->dst = nh->lladdr;
+			eth_data->l2 = NULL;
+		} else {
+			eth_output_set_dst(eth_data, &nh->lladdr, &nh->l2);
+		}
 		eth_data->ether_type = RTE_BE16(RTE_ETHER_TYPE_IPV6);
 		eth_data->iface = iface;
 		sent++;
@@ -165,6 +187,8 @@ static struct rte_node_register output_node = {
 		[ERROR] = "ip6_output_error",
 		[DEST_UNREACH] = "ip6_error_dest_unreach",
 		[QUEUE_FULL] = "ndp_queue_full",
+		[LINK_DOWN] = "ip6_output_link_down",
+		[NEIGH_FAILED] = "ndp_neigh_failed",
 	},
 };
 
@@ -175,4 +199,6 @@ static struct gr_node_info info = {
 GR_NODE_REGISTER(info);
 
 GR_DROP_REGISTER(ip6_output_error);
+GR_DROP_REGISTER(ip6_output_link_down);
 GR_DROP_REGISTER(ndp_queue_full);
+GR_DROP_REGISTER(ndp_neigh_failed);
@@ -2,11 +2,13 @@
 // Copyright (c) 2024 Robin Jarry
 
 #include <gr_graph.h>
+#include <gr_hold_queue.h>
 #include <gr_icmp6.h>
 #include <gr_ip6_control.h>
 #include <gr_ip6_datapath.h>
 #include <gr_log.h>
 #include <gr_mbuf.h>
+#include <gr_tracepoint.h>
 
 #include <rte_byteorder.h>
 #include <rte_ether.h>
@@ -19,6 +21,9 @@ enum {
 	EDGE_COUNT,
 };
 
+#define NH_STATE_FLAGS                                                                             \
+	(GR_IP6_NH_F_REACHABLE | GR_IP6_NH_F_STALE | GR_IP6_NH_F_PENDING | GR_IP6_NH_F_FAILED)
+
 // Declaration in gr_ip6_datapath.h. This function is shared with ndp_ns_input.
 void ndp_update_nexthop(
 	struct rte_graph *graph,
@@ -29,37 +34,48 @@ void ndp_update_nexthop(
 ) {
 	struct ip6_output_mbuf_data *d;
 	struct rte_mbuf *m, *next;
+	uint16_t old_flags;
 
 	// Static next hops never need updating.
 	if (nh->flags & GR_IP6_NH_F_STATIC)
 		return;
 
+	// Nothing changed, which is the common case with unsolicited
+	// advertisement storms. Only refresh the timestamp, without the lock and
+	// without invalidating the L2 header that all workers use to forward
+	// through this next hop.
+	if ((nh->flags & NH_STATE_FLAGS) == GR_IP6_NH_F_REACHABLE && nh->iface_id == iface->id
+	    && rte_is_same_ether_addr(&nh->lladdr, mac)) {
+		nh->neigh.last_reply = rte_get_tsc_cycles();
+		return;
+	}
+
 	rte_spinlock_lock(&nh->lock);
 
 	// Refresh all fields.
-	nh->last_reply = rte_get_tsc_cycles();
+	old_flags = nh->flags;
+	nh->neigh.last_reply = rte_get_tsc_cycles();
 	nh->iface_id = iface->id;
 	nh->flags |= GR_IP6_NH_F_REACHABLE;
 	nh->flags &= ~(GR_IP6_NH_F_STALE | GR_IP6_NH_F_PENDING | GR_IP6_NH_F_FAILED);
-	nh->ucast_probes = 0;
-	nh->mcast_probes = 0;
+	nh->neigh.ucast_probes = 0;
+	nh->neigh.mcast_probes = 0;
 	nh->lladdr = *mac;
+	eth_l2_rewrite_invalidate(&nh->l2);
+
+	rte_spinlock_unlock(&nh->lock);
+
+	if (old_flags != nh->flags)
+		gr_trace_nh_state(&nh->neigh, old_flags, nh->flags);
 
 	// Flush all held packets.
-	m = nh->held_pkts_head;
-	while (m != NULL) {
+	for (m = hold_queue_flush(&nh->neigh.held); m != NULL; m = next) {
 		next = queue_mbuf_data(m)->next;
 		d = ip6_output_mbuf_data(m);
 		d->nh = nh;
 		d->input_iface = NULL;
 		rte_node_enqueue_x1(graph, node, IP_OUTPUT, m);
-		m = next;
 	}
-	nh->held_pkts_head = NULL;
-	nh->held_pkts_tail = NULL;
-	nh->held_pkts_num = 0;
-
-	rte_spinlock_unlock(&nh->lock);
 }
 
 static uint16_t ndp_na_input_process(
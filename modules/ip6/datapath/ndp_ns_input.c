@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // Copyright (c) 2024 Robin Jarry
 
+#include <gr_eth_output.h>
 #include <gr_graph.h>
 #include <gr_icmp6.h>
 #include <gr_ip6_control.h>
@@ -15,18 +16,35 @@
 
 enum {
 	IP_OUTPUT = 0,
+	ETH_OUTPUT,
 	INVAL,
-	ERROR,
 	IGNORE,
 	EDGE_COUNT,
 };
 
+// Find the solicited address among the addresses of the input interface.
+static inline struct nexthop6 *
+ndp_local_addr(const struct hoplist6 *addrs, const struct rte_ipv6_addr *target) {
+	if (addrs == NULL)
+		return NULL;
+
+	for (unsigned i = 0; i < addrs->count; i++) {
+		if (rte_ipv6_addr_eq(&addrs->nh[i]->ip, target))
+			return addrs->nh[i];
+	}
+
+	return NULL;
+}
+
 static uint16_t ndp_ns_input_process(
 	struct rte_graph *graph,
 	struct rte_node *node,
 	void **objs,
 	uint16_t nb_objs
 ) {
+	const struct iface *iface, *addrs_iface = NULL;
+	struct eth_output_mbuf_data *eth_data;
+	const struct hoplist6 *addrs = NULL;
 	struct nexthop6 *remote, *local;
 	struct icmp6_neigh_solicit *ns;
 	struct icmp6_neigh_advert *na;
@@ -34,13 +52,12 @@ static uint16_t ndp_ns_input_process(
 	struct rte_ipv6_addr src, dst;
 	struct rte_ether_addr lladdr;
 	struct icmp6_opt_lladdr *ll;
-	const struct iface *iface;
 	struct rte_ipv6_hdr *ip;
 	struct icmp6_opt *opt;
 	struct rte_mbuf *mbuf;
 	uint16_t payload_len;
 	struct icmp6 *icmp6;
-	bool lladdr_found;
+	bool lladdr_found, direct;
 	rte_edge_t next;
 
 #define ASSERT_NDP(condition)                                                                      \
@@ -53,6 +70,7 @@ static uint16_t ndp_ns_input_process(
 
 	for (uint16_t i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
+		direct = false;
 
 		d = ip6_local_mbuf_data(mbuf);
 		icmp6 = rte_pktmbuf_mtod(mbuf, struct icmp6 *);
@@ -76,8 +94,13 @@ static uint16_t ndp_ns_input_process(
 		// - Target Address is not a multicast address.
 		ASSERT_NDP(!rte_ipv6_addr_is_mcast(&ns->target));
 
-		local = ip6_addr_get_preferred(iface->id, &ns->target);
-		if (!rte_ipv6_addr_eq(&local->ip, &ns->target)) {
+		// Bursts usually come from a single interface.
+		if (iface != addrs_iface) {
+			addrs = ip6_addr_get_all(iface->id);
+			addrs_iface = iface;
+		}
+		local = ndp_local_addr(addrs, &ns->target);
+		if (local == NULL) {
 			next = IGNORE;
 			goto next;
 		}
@@ -124,26 +147,19 @@ static uint16_t ndp_ns_input_process(
 			na->solicited = 0;
 		} else {
 			if (lladdr_found) {
-				// update or create the nexthop that sent the solicitation
-				if ((remote = ip6_nexthop_lookup(iface->vrf_id, &src)) == NULL) {
-					remote = ip6_nexthop_new(iface->vrf_id, iface->id, &src);
-					if (remote != NULL
-					    && ip6_route_insert(
-						       iface->vrf_id,
-						       &src,
-						       RTE_IPV6_MAX_DEPTH,
-						       remote
-					       ) < 0) {
-						next = ERROR;
-						goto next;
-					}
-				}
-				if (remote == NULL) {
-					next = ERROR;
-					goto next;
+				// update the nexthop that sent the solicitation
+				remote = ip6_nexthop_lookup(iface->vrf_id, &src);
+				if (remote != NULL) {
+					ndp_update_nexthop(graph, node, remote, iface, &lladdr);
+					ip6_output_mbuf_data(mbuf)->nh = remote;
+				} else {
+					// Ask the control plane to create a new next hop and
+					// its associated /128 route. The advertisement is sent
+					// to the link-layer address option without waiting for
+					// the next hop to exist.
+					ip6_nexthop_learn(iface->vrf_id, iface->id, &src, lladdr);
+					direct = true;
 				}
-				ndp_update_nexthop(graph, node, remote, iface, &lladdr);
-				ip6_output_mbuf_data(mbuf)->nh = remote;
 			}
 			// Otherwise, the node MUST set the Solicited flag to one and unicast the
 			// advertisement to the Source Address of the solicitation.
@@ -158,7 +174,16 @@ static uint16_t ndp_ns_input_process(
 		icmp6->cksum = 0;
 		icmp6->cksum = rte_ipv6_udptcp_cksum(ip, icmp6);
 
-		next = IP_OUTPUT;
+		if (direct) {
+			eth_data = eth_output_mbuf_data(mbuf);
+			eth_data->iface = iface;
+			eth_data->dst = lladdr;
+			eth_data->ether_type = RTE_BE16(RTE_ETHER_TYPE_IPV6);
+			eth_data->l2 = NULL;
+			next = ETH_OUTPUT;
+		} else {
+			next = IP_OUTPUT;
+		}
 next:
 		rte_node_enqueue_x1(graph, node, next, mbuf);
 	}
@@ -174,8 +199,8 @@ static struct rte_node_register node = {
 	.nb_edges = EDGE_COUNT,
 	.next_nodes = {
 		[IP_OUTPUT] = "ip6_output",
+		[ETH_OUTPUT] = "eth_output",
 		[INVAL] = "ndp_ns_input_inval",
-		[ERROR] = "ndp_ns_input_error",
 		[IGNORE] = "ndp_ns_input_ignore",
 	},
 };
@@ -187,5 +212,4 @@ static struct gr_node_info info = {
 GR_NODE_REGISTER(info);
 
 GR_DROP_REGISTER(ndp_ns_input_inval);
-GR_DROP_REGISTER(ndp_ns_input_error);
 GR_DROP_REGISTER(ndp_ns_input_ignore);
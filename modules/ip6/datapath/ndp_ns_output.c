@@ -11,6 +11,7 @@
 #include <gr_ip6_datapath.h>
 #include <gr_log.h>
 #include <gr_macro.h>
+#include <gr_token_bucket.h>
 
 #include <rte_byteorder.h>
 #include <rte_errno.h>
@@ -18,6 +19,7 @@
 #include <rte_ether.h>
 #include <rte_graph_worker.h>
 #include <rte_ip.h>
+#include <rte_malloc.h>
 #include <rte_mbuf.h>
 #include <rte_ring.h>
 #include <rte_spinlock.h>
@@ -25,15 +27,27 @@
 enum {
 	OUTPUT = 0,
 	ERROR,
+	RATE_LIMITED,
 	EDGE_COUNT,
 };
 
 static control_input_t ndp_solicit;
 
 int ip6_nexthop_solicit(struct nexthop6 *nh) {
+	int ret;
+
 	if (nh == NULL)
 		return errno_set(EINVAL);
-	return post_to_stack(ndp_solicit, nh);
+
+	// coalesce with a solicitation that was not processed yet
+	if (__atomic_exchange_n(&nh->solicit_queued, true, __ATOMIC_ACQ_REL))
+		return 0;
+
+	ret = post_to_stack(ndp_solicit, nh);
+	if (ret < 0)
+		__atomic_store_n(&nh->solicit_queued, false, __ATOMIC_RELEASE);
+
+	return ret;
 }
 
 static uint16_t ndp_ns_output_process(
@@ -42,6 +56,7 @@ static uint16_t ndp_ns_output_process(
 	void **objs,
 	uint16_t nb_objs
 ) {
+	struct token_bucket *buckets = node->ctx_ptr;
 	struct icmp6_opt_lladdr *lladdr;
 	struct icmp6_neigh_solicit *ns;
 	struct nexthop6 *local, *nh;
@@ -52,6 +67,9 @@ static uint16_t ndp_ns_output_process(
 	uint16_t payload_len;
 	struct icmp6 *icmp6;
 	rte_edge_t next;
+	uint64_t now;
+
+	now = rte_get_tsc_cycles();
 
 	for (unsigned i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
@@ -61,6 +79,18 @@ static uint16_t ndp_ns_output_process(
 			next = ERROR;
 			goto next;
 		}
+		__atomic_store_n(&nh->solicit_queued, false, __ATOMIC_RELEASE);
+
+		// The control plane will send another solicitation on the next
+		// aging iteration since last_request is not updated.
+		token_bucket_refill(
+			&buckets[nh->iface_id], IP6_NH_SOLICIT_RATE, IP6_NH_SOLICIT_BURST, now
+		);
+		if (!token_bucket_take(&buckets[nh->iface_id])) {
+			next = RATE_LIMITED;
+			goto next;
+		}
+
 		local = ip6_addr_get_preferred(nh->iface_id, &nh->ip);
 		if (local == NULL) {
 			next = ERROR;
@@ -79,12 +109,12 @@ static uint16_t ndp_ns_output_process(
 		opt->len = ICMP6_OPT_LEN(sizeof(*opt) + sizeof(*lladdr));
 		lladdr = (struct icmp6_opt_lladdr *)rte_pktmbuf_append(mbuf, sizeof(*lladdr));
 		lladdr->mac = local->lladdr;
-		if (nh->last_reply != 0 && nh->ucast_probes < IP6_NH_UCAST_PROBES) {
+		if (nh->neigh.last_reply != 0 && nh->neigh.ucast_probes < NH_NEIGH_UCAST_PROBES) {
 			dst = nh->ip;
-			nh->ucast_probes++;
+			nh->neigh.ucast_probes++;
 		} else {
 			rte_ipv6_solnode_from_addr(&dst, &nh->ip);
-			nh->mcast_probes++;
+			nh->neigh.mcast_probes++;
 		}
 		// Fill IPv6 layer
 		payload_len = rte_pktmbuf_pkt_len(mbuf);
@@ -94,7 +124,7 @@ static uint16_t ndp_ns_output_process(
 		icmp6->cksum = 0;
 		icmp6->cksum = rte_ipv6_udptcp_cksum(ip, icmp6);
 
-		nh->last_request = rte_get_tsc_cycles();
+		nh->neigh.last_request = now;
 		ip6_output_mbuf_data(mbuf)->nh = nh;
 		next = OUTPUT;
 next:
@@ -104,6 +134,20 @@ next:
 	return nb_objs;
 }
 
+static int ndp_ns_output_init(const struct rte_graph *graph, struct rte_node *node) {
+	node->ctx_ptr = rte_zmalloc_socket(
+		__func__, MAX_IFACES * sizeof(struct token_bucket), 0, graph->socket
+	);
+	if (node->ctx_ptr == NULL)
+		return errno_log(ENOMEM, "rte_zmalloc_socket");
+	return 0;
+}
+
+static void ndp_ns_output_fini(const struct rte_graph *, struct rte_node *node) {
+	rte_free(node->ctx_ptr);
+	node->ctx_ptr = NULL;
+}
+
 static void ndp_output_solicit_register(void) {
 	ndp_solicit = gr_control_input_register_handler("ndp_ns_output");
 }
@@ -111,10 +155,13 @@ static void ndp_output_solicit_register(void) {
 static struct rte_node_register node = {
 	.name = "ndp_ns_output",
 	.process = ndp_ns_output_process,
+	.init = ndp_ns_output_init,
+	.fini = ndp_ns_output_fini,
 	.nb_edges = EDGE_COUNT,
 	.next_nodes = {
 		[OUTPUT] = "ip6_output",
 		[ERROR] = "ndp_ns_output_error",
+		[RATE_LIMITED] = "ndp_ns_output_rate_limited",
 	},
 };
 
@@ -126,3 +173,4 @@ static struct gr_node_info info = {
 GR_NODE_REGISTER(info);
 
 GR_DROP_REGISTER(ndp_ns_output_error);
+GR_DROP_REGISTER(ndp_ns_output_rate_limited);
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_cli_iface.h>
+#include <gr_ip6tnl.h>
+#include <gr_net_types.h>
+
+#include <ecoli.h>
+#include <rte_ip6.h>
+
+#include <errno.h>
+
+static void ip6tnl_show(const struct gr_api_client *, const struct gr_iface *iface) {
+	const struct gr_iface_info_ip6tnl *tnl = (const struct gr_iface_info_ip6tnl *)iface->info;
+	char local[64], remote[64];
+
+	inet_ntop(AF_INET6, &tnl->local, local, sizeof(local));
+	inet_ntop(AF_INET6, &tnl->remote, remote, sizeof(remote));
+	printf("local: %s\n", local);
+	printf("remote: %s\n", remote);
+}
+
+static void ip6tnl_list_info(
+	const struct gr_api_client *,
+	const struct gr_iface *iface,
+	char *buf,
+	size_t len
+) {
+	const struct gr_iface_info_ip6tnl *tnl = (const struct gr_iface_info_ip6tnl *)iface->info;
+	char local[64], remote[64];
+
+	inet_ntop(AF_INET6, &tnl->local, local, sizeof(local));
+	inet_ntop(AF_INET6, &tnl->remote, remote, sizeof(remote));
+	snprintf(buf, len, "local=%s remote=%s", local, remote);
+}
+
+static struct cli_iface_type ip6tnl_type = {
+	.type_id = GR_IFACE_TYPE_IP6TNL,
+	.name = "ip6tnl",
+	.show = ip6tnl_show,
+	.list_info = ip6tnl_list_info,
+};
+
+static uint64_t parse_ip6tnl_args(
+	const struct gr_api_client *c,
+	const struct ec_pnode *p,
+	struct gr_iface *iface,
+	bool update
+) {
+	uint64_t set_attrs = parse_iface_args(c, p, iface, update);
+	struct gr_iface_info_ip6tnl *tnl;
+	const char *local, *remote;
+
+	tnl = (struct gr_iface_info_ip6tnl *)iface->info;
+
+	local = arg_str(p, "LOCAL");
+	if (local != NULL) {
+		if (inet_pton(AF_INET6, local, &tnl->local) != 1) {
+			errno = EINVAL;
+			return 0;
+		}
+		set_attrs |= GR_IP6TNL_SET_LOCAL;
+	}
+	remote = arg_str(p, "REMOTE");
+	if (remote != NULL) {
+		if (inet_pton(AF_INET6, remote, &tnl->remote) != 1) {
+			errno = EINVAL;
+			return 0;
+		}
+		set_attrs |= GR_IP6TNL_SET_REMOTE;
+	}
+	if (rte_ipv6_addr_eq(&tnl->local, &tnl->remote)) {
+		errno = EADDRINUSE;
+		return 0;
+	}
+
+	if (set_attrs == 0)
+		errno = EINVAL;
+	return set_attrs;
+}
+
+static cmd_status_t ip6tnl_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	const struct gr_infra_iface_add_resp *resp;
+	struct gr_infra_iface_add_req req = {
+		.iface = {.type = GR_IFACE_TYPE_IP6TNL, .flags = GR_IFACE_F_UP}
+	};
+	void *resp_ptr = NULL;
+
+	if (parse_ip6tnl_args(c, p, &req.iface, false) == 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_ADD, sizeof(req), &req, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	printf("Created interface %u\n", resp->iface_id);
+	free(resp_ptr);
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t ip6tnl_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_iface_set_req req = {0};
+
+	if ((req.set_attrs = parse_ip6tnl_args(c, p, &req.iface, true)) == 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+#define IP6TNL_ATTRS_ARGS                                                                          \
+	IFACE_ATTRS_ARGS,                                                                          \
+		with_help("Local tunnel endpoint address.", ec_node_re("LOCAL", IPV6_RE)),         \
+		with_help("Remote tunnel endpoint address.", ec_node_re("REMOTE", IPV6_RE))
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_ADD, CTX_ARG("interface", "Create interfaces.")),
+		"ip6tnl NAME local LOCAL remote REMOTE [" IFACE_ATTRS_CMD "]",
+		ip6tnl_add,
+		"Create a new IPv6 tunnel interface.",
+		with_help("Interface name.", ec_node("any", "NAME")),
+		IP6TNL_ATTRS_ARGS
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("interface", "Modify interfaces.")),
+		"ip6tnl NAME (name NEW_NAME),(local LOCAL),(remote REMOTE)," IFACE_ATTRS_CMD,
+		ip6tnl_set,
+		"Modify ip6tnl parameters.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_IP6TNL))
+		),
+		with_help("New interface name.", ec_node("any", "NEW_NAME")),
+		IP6TNL_ATTRS_ARGS
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "ip6tnl",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+	register_iface_type(&ip6tnl_type);
+}
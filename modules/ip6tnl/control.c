@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_ip6tnl.h"
+#include "ip6tnl_priv.h"
+
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_infra.h>
+#include <gr_ip6_control.h>
+#include <gr_log.h>
+
+#include <event2/event.h>
+#include <rte_hash.h>
+#include <rte_ip6.h>
+
+#include <assert.h>
+#include <string.h>
+
+static struct rte_hash *ip6tnl_hash;
+
+void ip6tnl_get_iface_bulk(const struct ip6tnl_key *keys, unsigned n, struct iface **ifaces) {
+	const void *key_ptrs[IP6TNL_LOOKUP_BULK_MAX];
+	void *data[IP6TNL_LOOKUP_BULK_MAX];
+	uint64_t hits = 0;
+
+	assert(n <= IP6TNL_LOOKUP_BULK_MAX);
+
+	for (unsigned i = 0; i < n; i++)
+		key_ptrs[i] = &keys[i];
+
+	if (n > 0 && rte_hash_lookup_bulk_data(ip6tnl_hash, key_ptrs, n, &hits, data) < 0)
+		hits = 0;
+
+	for (unsigned i = 0; i < n; i++)
+		ifaces[i] = hits & (UINT64_C(1) << i) ? data[i] : NULL;
+}
+
+static int iface_ip6tnl_reconfig(
+	struct iface *iface,
+	uint64_t set_attrs,
+	uint16_t flags,
+	uint16_t mtu,
+	uint16_t vrf_id,
+	const void *api_info
+) {
+	struct iface_info_ip6tnl *cur = (struct iface_info_ip6tnl *)iface->info;
+	const struct gr_iface_info_ip6tnl *next = api_info;
+	struct ip6tnl_key cur_key = {cur->local, cur->remote, iface->vrf_id};
+	struct ip6tnl_key next_key = {next->local, next->remote, vrf_id};
+	int ret;
+
+	if (set_attrs & (GR_IFACE_SET_VRF | GR_IP6TNL_SET_LOCAL | GR_IP6TNL_SET_REMOTE)) {
+		if (vrf_id >= IP6_MAX_VRFS)
+			return errno_set(EOVERFLOW);
+
+		if (rte_hash_lookup(ip6tnl_hash, &next_key) >= 0)
+			return errno_set(EADDRINUSE);
+
+		// ip6_route_lookup does not set errno for VRFs without routes
+		if (ip6_route_lookup(vrf_id, &next->local) == NULL)
+			return errno_set(EHOSTUNREACH);
+		if (ip6_route_lookup(vrf_id, &next->remote) == NULL)
+			return errno_set(EHOSTUNREACH);
+
+		if (memcmp(&cur_key, &next_key, sizeof(cur_key)) != 0)
+			rte_hash_del_key(ip6tnl_hash, &cur_key);
+
+		if ((ret = rte_hash_add_key_data(ip6tnl_hash, &next_key, iface)) < 0)
+			return errno_log(-ret, "rte_hash_add_key_data");
+
+		cur->local = next->local;
+		cur->remote = next->remote;
+		iface->vrf_id = vrf_id;
+	}
+
+	if (set_attrs & GR_IFACE_SET_FLAGS)
+		iface->flags = flags;
+	if (set_attrs & GR_IFACE_SET_MTU)
+		iface->mtu = mtu;
+
+	return 0;
+}
+
+static int iface_ip6tnl_fini(struct iface *iface) {
+	struct iface_info_ip6tnl *ip6tnl = (struct iface_info_ip6tnl *)iface->info;
+	struct ip6tnl_key key = {ip6tnl->local, ip6tnl->remote, iface->vrf_id};
+
+	rte_hash_del_key(ip6tnl_hash, &key);
+
+	return 0;
+}
+
+static int iface_ip6tnl_init(struct iface *iface, const void *api_info) {
+	int ret;
+
+	ret = iface_ip6tnl_reconfig(
+		iface, IFACE_SET_ALL, iface->flags, iface->mtu, iface->vrf_id, api_info
+	);
+	if (ret < 0) {
+		iface_ip6tnl_fini(iface);
+		errno = -ret;
+	}
+
+	return ret;
+}
+
+static void ip6tnl_to_api(void *info, const struct iface *iface) {
+	const struct iface_info_ip6tnl *ip6tnl = (const struct iface_info_ip6tnl *)iface->info;
+	struct gr_iface_info_ip6tnl *api = info;
+
+	api->local = ip6tnl->local;
+	api->remote = ip6tnl->remote;
+}
+
+static struct iface_type iface_type_ip6tnl = {
+	.id = GR_IFACE_TYPE_IP6TNL,
+	.name = "ip6tnl",
+	.info_size = sizeof(struct iface_info_ip6tnl),
+	.init = iface_ip6tnl_init,
+	.reconfig = iface_ip6tnl_reconfig,
+	.fini = iface_ip6tnl_fini,
+	.to_api = ip6tnl_to_api,
+};
+
+static void ip6tnl_init(struct event_base *) {
+	struct rte_hash_parameters params = {
+		.name = "ip6tnl",
+		.entries = MAX_IFACES,
+		.key_len = sizeof(struct ip6tnl_key),
+		.socket_id = SOCKET_ID_ANY,
+		.extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF
+			| RTE_HASH_EXTRA_FLAGS_TRANS_MEM_SUPPORT,
+	};
+	ip6tnl_hash = rte_hash_create(&params);
+	if (ip6tnl_hash == NULL)
+		ABORT("rte_hash_create(ip6tnl)");
+}
+
+static void ip6tnl_fini(struct event_base *) {
+	rte_hash_free(ip6tnl_hash);
+	ip6tnl_hash = NULL;
+}
+
+static struct gr_module ip6tnl_module = {
+	.name = "ip6tnl",
+	.init = ip6tnl_init,
+	.fini = ip6tnl_fini,
+	.fini_prio = 1000,
+};
+
+RTE_INIT(ip6tnl_constructor) {
+	gr_register_module(&ip6tnl_module);
+	iface_type_register(&iface_type_ip6tnl);
+}
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "ip6tnl_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_eth_input.h>
+#include <gr_graph.h>
+#include <gr_ip6_datapath.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_graph_worker.h>
+#include <rte_ip6.h>
+#include <rte_mbuf_ptype.h>
+
+#include <netinet/in.h>
+#include <string.h>
+
+enum {
+	IP_INPUT = 0,
+	IP6_INPUT,
+	NO_TUNNEL,
+	EDGE_COUNT,
+};
+
+static uint16_t ip6tnl_input_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	struct iface *ifaces[IP6TNL_LOOKUP_BULK_MAX];
+	struct ip6tnl_key keys[IP6TNL_LOOKUP_BULK_MAX];
+	struct iface_stats_batch stats = {.tx = false};
+	uint8_t key_idx[IP6TNL_LOOKUP_BULK_MAX];
+	struct eth_input_mbuf_data *eth_data;
+	struct ip6_local_mbuf_data *ip_data;
+	uint16_t i, n, count, n_keys;
+	struct gr_spec_stream s;
+	struct ip6tnl_key key;
+	struct rte_mbuf *mbuf;
+	struct iface *tunnel;
+	rte_edge_t edge;
+
+	gr_spec_stream_init(&s, node, nb_objs);
+
+	for (n = 0; n < nb_objs; n += count) {
+		count = RTE_MIN(nb_objs - n, IP6TNL_LOOKUP_BULK_MAX);
+
+		// First pass: collect the tunnel keys. Consecutive packets of
+		// the same tunnel share a single lookup.
+		n_keys = 0;
+		for (i = 0; i < count; i++) {
+			ip_data = ip6_local_mbuf_data(objs[n + i]);
+			key.local = ip_data->dst;
+			key.remote = ip_data->src;
+			key.vrf_id = ip_data->input_iface->vrf_id;
+			if (n_keys == 0 || memcmp(&keys[n_keys - 1], &key, sizeof(key)) != 0)
+				keys[n_keys++] = key;
+			key_idx[i] = n_keys - 1;
+		}
+		ip6tnl_get_iface_bulk(keys, n_keys, ifaces);
+
+		// Second pass: hand over the inner packets to ip_input or ip6_input.
+		for (i = 0; i < count; i++) {
+			mbuf = objs[n + i];
+			tunnel = ifaces[key_idx[i]];
+			if (tunnel == NULL) {
+				edge = NO_TUNNEL;
+				goto next;
+			}
+			if (ip6_local_mbuf_data(mbuf)->proto == IPPROTO_IPV6)
+				edge = IP6_INPUT;
+			else
+				edge = IP_INPUT;
+			// The hw checksum offload only works on the outer IP.
+			// Clear the offload flag so that ip_input will check it in software.
+			mbuf->ol_flags |= RTE_MBUF_F_RX_IP_CKSUM_NONE;
+			// Same for the packet type classification.
+			mbuf->packet_type = RTE_PTYPE_UNKNOWN;
+			eth_data = eth_input_mbuf_data(mbuf);
+			eth_data->iface = tunnel;
+			eth_data->eth_dst = ETH_DST_LOCAL;
+			iface_stats_add(&stats, tunnel->id, rte_pktmbuf_pkt_len(mbuf));
+next:
+			gr_spec_stream_enqueue(&s, graph, node, objs, n + i, edge);
+		}
+	}
+	gr_spec_stream_flush(&s, graph, node);
+	iface_stats_flush(&stats);
+
+	return nb_objs;
+}
+
+static void ip6tnl_input_register(void) {
+	ip6_input_local_add_proto(IPPROTO_IPIP, "ip6tnl_input");
+	ip6_input_local_add_proto(IPPROTO_IPV6, "ip6tnl_input");
+}
+
+static struct rte_node_register ip6tnl_input_node = {
+	.name = "ip6tnl_input",
+
+	.process = ip6tnl_input_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[IP_INPUT] = "ip_input",
+		[IP6_INPUT] = "ip6_input",
+		[NO_TUNNEL] = "ip6tnl_input_no_tunnel",
+	},
+};
+
+static struct gr_node_info ip6tnl_input_info = {
+	.node = &ip6tnl_input_node,
+	.register_callback = ip6tnl_input_register,
+};
+
+GR_NODE_REGISTER(ip6tnl_input_info);
+
+GR_DROP_REGISTER(ip6tnl_input_no_tunnel);
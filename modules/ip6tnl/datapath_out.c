@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_ip6tnl.h"
+#include "ip6tnl_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_graph.h>
+#include <gr_ip4_datapath.h>
+#include <gr_ip6_control.h>
+#include <gr_ip6_datapath.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+
+#include <rte_byteorder.h>
+#include <rte_graph_worker.h>
+#include <rte_ip.h>
+#include <rte_ip6.h>
+
+#include <netinet/in.h>
+
+enum {
+	IP6_OUTPUT = 0,
+	NO_TUNNEL,
+	NO_HEADROOM,
+	UNSUPPORTED,
+	EDGE_COUNT,
+};
+
+// This node is attached to both ip_output and ip6_output. Resolve the tunnel
+// interface from the next hop stored by either of them.
+static inline const struct iface *ip6tnl_output_iface(struct rte_mbuf *m, uint8_t version) {
+	const struct nexthop6 *nh6;
+
+	if (version == 4)
+		return ip_output_mbuf_data(m)->nh->iface;
+
+	nh6 = ip6_output_mbuf_data(m)->nh;
+	return iface_from_id(nh6->iface_id);
+}
+
+static uint16_t ip6tnl_output_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	struct iface_stats_batch stats = {.tx = true};
+	struct ip6_output_mbuf_data *ip6_data;
+	struct iface_info_ip6tnl *ip6tnl;
+	uint32_t route_gen, iface_gen;
+	struct rte_ipv4_hdr *inner4;
+	struct rte_ipv6_hdr *inner6;
+	struct rte_ipv6_hdr *outer;
+	const struct iface *iface;
+	struct rte_mbuf *mbuf;
+	uint32_t hash;
+	uint8_t version;
+	uint16_t len;
+	uint8_t proto;
+	rte_edge_t edge;
+
+	route_gen = __atomic_load_n(&ip6_route_gen, __ATOMIC_ACQUIRE);
+	iface_gen = __atomic_load_n(&iface_config_gen, __ATOMIC_ACQUIRE);
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+
+		version = *rte_pktmbuf_mtod(mbuf, const uint8_t *) >> 4;
+		iface = ip6tnl_output_iface(mbuf, version);
+		if (iface == NULL || iface->type_id != GR_IFACE_TYPE_IP6TNL) {
+			edge = NO_TUNNEL;
+			goto next;
+		}
+		ip6tnl = (struct iface_info_ip6tnl *)iface->info;
+
+		// port_gso only supports IPv4 outer headers.
+		if (unlikely(mbuf->ol_flags & RTE_MBUF_F_TX_TCP_SEG)) {
+			edge = UNSUPPORTED;
+			goto next;
+		}
+
+		// The inner flow hash becomes the outer flow label so that the
+		// underlay can spread the tunnel flows over ECMP paths.
+		if (version == 4) {
+			inner4 = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+			ip_cksum_resolve(mbuf, inner4);
+			hash = ip4_flow_hash(mbuf, inner4);
+			len = rte_be_to_cpu_16(inner4->total_length);
+			proto = IPPROTO_IPIP;
+		} else {
+			inner6 = rte_pktmbuf_mtod(mbuf, struct rte_ipv6_hdr *);
+			hash = ip6_flow_hash(mbuf, inner6);
+			len = sizeof(*inner6) + rte_be_to_cpu_16(inner6->payload_len);
+			proto = IPPROTO_IPV6;
+		}
+
+		outer = (struct rte_ipv6_hdr *)rte_pktmbuf_prepend(mbuf, sizeof(*outer));
+		if (unlikely(outer == NULL)) {
+			edge = NO_HEADROOM;
+			goto next;
+		}
+		ip6_set_fields(outer, len, proto, &ip6tnl->local, &ip6tnl->remote);
+		outer->vtc_flow |= rte_cpu_to_be_32(hash & RTE_IPV6_HDR_FL_MASK);
+		iface_stats_add(&stats, iface->id, len);
+
+		// Resolve nexthop for the encapsulated packet.
+		ip6_data = ip6_output_mbuf_data(mbuf);
+		ip6_data->input_iface = iface;
+		ip6_data->nh = ip6_route_cache_lookup(
+			&ip6tnl->route, iface->vrf_id, &ip6tnl->remote, route_gen, iface_gen
+		);
+		edge = IP6_OUTPUT;
+next:
+		rte_node_enqueue_x1(graph, node, edge, mbuf);
+	}
+	iface_stats_flush(&stats);
+
+	return nb_objs;
+}
+
+static void ip6tnl_output_register(void) {
+	ip_output_add_tunnel(GR_IFACE_TYPE_IP6TNL, "ip6tnl_output");
+	ip6_output_add_tunnel(GR_IFACE_TYPE_IP6TNL, "ip6tnl_output");
+}
+
+static struct rte_node_register ip6tnl_output_node = {
+	.name = "ip6tnl_output",
+
+	.process = ip6tnl_output_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[IP6_OUTPUT] = "ip6_output",
+		[NO_TUNNEL] = "ip6tnl_output_no_tunnel",
+		[NO_HEADROOM] = "error_no_headroom",
+		[UNSUPPORTED] = "ip6tnl_output_unsupported",
+	},
+};
+
+static struct gr_node_info ip6tnl_output_info = {
+	.node = &ip6tnl_output_node,
+	.register_callback = ip6tnl_output_register,
+};
+
+GR_NODE_REGISTER(ip6tnl_output_info);
+
+GR_DROP_REGISTER(ip6tnl_output_no_tunnel);
+GR_DROP_REGISTER(ip6tnl_output_unsupported);
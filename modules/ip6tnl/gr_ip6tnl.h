@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_API_IP6TNL
+#define _GR_API_IP6TNL
+
+#include <gr_api.h>
+#include <gr_bitops.h>
+#include <gr_infra.h>
+#include <gr_macro.h>
+#include <gr_net_types.h>
+
+#include <rte_ip6.h>
+
+// IPv4 or IPv6 packets encapsulated in IPv6 (RFC 2473)
+#define GR_IFACE_TYPE_IP6TNL 0x0006
+
+// IP6TNL reconfig attributes
+#define GR_IP6TNL_SET_LOCAL GR_BIT64(32)
+#define GR_IP6TNL_SET_REMOTE GR_BIT64(33)
+
+// Info for GR_IFACE_TYPE_IP6TNL interfaces
+struct gr_iface_info_ip6tnl {
+	struct rte_ipv6_addr local;
+	struct rte_ipv6_addr remote;
+};
+
+static_assert(sizeof(struct gr_iface_info_ip6tnl) <= MEMBER_SIZE(struct gr_iface, info));
+
+#endif
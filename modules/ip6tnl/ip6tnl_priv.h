@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _IP6TNL_PRIV_H
+#define _IP6TNL_PRIV_H
+
+#include <gr_iface.h>
+#include <gr_ip6_control.h>
+
+#include <rte_hash.h>
+#include <rte_ip6.h>
+
+#include <stdint.h>
+
+struct __rte_aligned(alignof(void *)) iface_info_ip6tnl {
+	struct rte_ipv6_addr local;
+	struct rte_ipv6_addr remote;
+	struct ip6_route_cache route; // underlay next hop of remote
+};
+
+struct ip6tnl_key {
+	struct rte_ipv6_addr local;
+	struct rte_ipv6_addr remote;
+	// uint32_t to avoid padding bytes in the hash key, see struct ipip_key
+	uint32_t vrf_id;
+};
+
+#define IP6TNL_LOOKUP_BULK_MAX RTE_HASH_LOOKUP_BULK_MAX
+
+// Lookup up to IP6TNL_LOOKUP_BULK_MAX tunnels at once. Unknown tunnels are NULL.
+void ip6tnl_get_iface_bulk(const struct ip6tnl_key *keys, unsigned n, struct iface **ifaces);
+
+#endif
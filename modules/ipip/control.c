@@ -16,21 +16,9 @@
 #include <rte_ether.h>
 #include <rte_hash.h>
 
+#include <assert.h>
 #include <string.h>
 
-struct ipip_key {
-	ip4_addr_t local;
-	ip4_addr_t remote;
-	// XXX: Using uint16_t causes the compiler to add 2 bytes padding at the
-	// end of the structure. When the structure is initialized on the stack,
-	// the padding bytes have undetermined contents.
-	//
-	// This structure is used to compute a hash key. In order to get
-	// deterministic results, use uint32_t to store the vrf_id so that the
-	// compiler does not insert any padding.
-	uint32_t vrf_id;
-};
-
 static struct rte_hash *ipip_hash;
 
 struct iface *ipip_get_iface(ip4_addr_t local, ip4_addr_t remote, uint16_t vrf_id) {
@@ -43,6 +31,23 @@ struct iface *ipip_get_iface(ip4_addr_t local, ip4_addr_t remote, uint16_t vrf_i
 	return data;
 }
 
+void ipip_get_iface_bulk(const struct ipip_key *keys, unsigned n, struct iface **ifaces) {
+	const void *key_ptrs[IPIP_LOOKUP_BULK_MAX];
+	void *data[IPIP_LOOKUP_BULK_MAX];
+	uint64_t hits = 0;
+
+	assert(n <= IPIP_LOOKUP_BULK_MAX);
+
+	for (unsigned i = 0; i < n; i++)
+		key_ptrs[i] = &keys[i];
+
+	if (n > 0 && rte_hash_lookup_bulk_data(ipip_hash, key_ptrs, n, &hits, data) < 0)
+		hits = 0;
+
+	for (unsigned i = 0; i < n; i++)
+		ifaces[i] = hits & (UINT64_C(1) << i) ? data[i] : NULL;
+}
+
 static int iface_ipip_reconfig(
 	struct iface *iface,
 	uint64_t set_attrs,
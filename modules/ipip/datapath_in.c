@@ -15,8 +15,10 @@
 #include <rte_ether.h>
 #include <rte_graph_worker.h>
 #include <rte_ip.h>
+#include <rte_mbuf_ptype.h>
 
 #include <netinet/in.h>
+#include <string.h>
 
 enum {
 	IP_INPUT = 0,
@@ -26,44 +28,60 @@ enum {
 
 static uint16_t
 ipip_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct iface *ifaces[IPIP_LOOKUP_BULK_MAX];
+	struct ipip_key keys[IPIP_LOOKUP_BULK_MAX];
+	struct iface_stats_batch stats = {.tx = false};
+	uint8_t key_idx[IPIP_LOOKUP_BULK_MAX];
 	struct eth_input_mbuf_data *eth_data;
 	struct ip_local_mbuf_data *ip_data;
-	ip4_addr_t last_src, last_dst;
-	uint16_t last_vrf_id;
+	uint16_t i, n, count, n_keys;
+	struct gr_spec_stream s;
+	struct ipip_key key;
 	struct rte_mbuf *mbuf;
 	struct iface *ipip;
 	rte_edge_t edge;
 
-	ipip = NULL;
-	last_src = 0;
-	last_dst = 0;
-	last_vrf_id = UINT16_MAX;
-
-	for (uint16_t i = 0; i < nb_objs; i++) {
-		mbuf = objs[i];
-		ip_data = ip_local_mbuf_data(mbuf);
-
-		if (ip_data->dst != last_dst || ip_data->src != last_src
-		    || ip_data->vrf_id != last_vrf_id) {
-			ipip = ipip_get_iface(ip_data->dst, ip_data->src, ip_data->vrf_id);
-			last_dst = ip_data->dst;
-			last_src = ip_data->src;
-			last_vrf_id = ip_data->vrf_id;
-		}
-		if (ipip == NULL) {
-			edge = NO_TUNNEL;
-			goto next;
+	gr_spec_stream_init(&s, node, nb_objs);
+
+	for (n = 0; n < nb_objs; n += count) {
+		count = RTE_MIN(nb_objs - n, IPIP_LOOKUP_BULK_MAX);
+
+		// First pass: collect the tunnel keys. Consecutive packets of
+		// the same tunnel share a single lookup.
+		n_keys = 0;
+		for (i = 0; i < count; i++) {
+			ip_data = ip_local_mbuf_data(objs[n + i]);
+			key = (struct ipip_key) {ip_data->dst, ip_data->src, ip_data->vrf_id};
+			if (n_keys == 0 || memcmp(&keys[n_keys - 1], &key, sizeof(key)) != 0)
+				keys[n_keys++] = key;
+			key_idx[i] = n_keys - 1;
 		}
-		// The hw checksum offload only works on the outer IP.
-		// Clear the offload flag so that ip_input will check it in software.
-		mbuf->ol_flags |= RTE_MBUF_F_RX_IP_CKSUM_NONE;
-		eth_data = eth_input_mbuf_data(mbuf);
-		eth_data->iface = ipip;
-		eth_data->eth_dst = ETH_DST_LOCAL;
-		edge = IP_INPUT;
+		ipip_get_iface_bulk(keys, n_keys, ifaces);
+
+		// Second pass: hand over the inner packets to ip_input.
+		for (i = 0; i < count; i++) {
+			mbuf = objs[n + i];
+			ipip = ifaces[key_idx[i]];
+			if (ipip == NULL) {
+				edge = NO_TUNNEL;
+				goto next;
+			}
+			// The hw checksum offload only works on the outer IP.
+			// Clear the offload flag so that ip_input will check it in software.
+			mbuf->ol_flags |= RTE_MBUF_F_RX_IP_CKSUM_NONE;
+			// Same for the packet type classification.
+			mbuf->packet_type = RTE_PTYPE_UNKNOWN;
+			eth_data = eth_input_mbuf_data(mbuf);
+			eth_data->iface = ipip;
+			eth_data->eth_dst = ETH_DST_LOCAL;
+			iface_stats_add(&stats, ipip->id, rte_pktmbuf_pkt_len(mbuf));
+			edge = IP_INPUT;
 next:
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
+			gr_spec_stream_enqueue(&s, graph, node, objs, n + i, edge);
+		}
 	}
+	gr_spec_stream_flush(&s, graph, node);
+	iface_stats_flush(&stats);
 
 	return nb_objs;
 }
@@ -28,48 +28,69 @@ enum {
 
 static uint16_t
 ipip_output_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct iface_stats_batch stats = {.tx = true};
 	struct ip_output_mbuf_data *ip_data;
-	const struct iface_info_ipip *ipip;
-	struct ip_local_mbuf_data tunnel;
-	const struct rte_ipv4_hdr *inner;
+	uint32_t route_gen, iface_gen;
+	struct ip_local_mbuf_data *tunnel;
+	struct iface_info_ipip *ipip;
+	struct rte_ipv4_hdr *inner;
 	struct rte_ipv4_hdr *outer;
 	const struct iface *iface;
 	struct rte_mbuf *mbuf;
 	rte_edge_t edge;
 
+	route_gen = __atomic_load_n(&ip4_route_gen, __ATOMIC_ACQUIRE);
+	iface_gen = __atomic_load_n(&iface_config_gen, __ATOMIC_ACQUIRE);
+
 	for (uint16_t i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
 
 		// Resolve the IPIP interface from the nexthop provided by ip_output.
 		ip_data = ip_output_mbuf_data(mbuf);
-		iface = iface_from_id(ip_data->nh->iface_id);
+		iface = ip_data->nh->iface;
 		if (iface == NULL || iface->type_id != GR_IFACE_TYPE_IPIP) {
 			edge = NO_TUNNEL;
 			goto next;
 		}
 		ip_data->input_iface = iface;
-		ipip = (const struct iface_info_ipip *)iface->info;
+		ipip = (struct iface_info_ipip *)iface->info;
 
 		// Encapsulate with another IPv4 header.
-		inner = rte_pktmbuf_mtod(mbuf, const struct rte_ipv4_hdr *);
-		tunnel.src = ipip->local;
-		tunnel.dst = ipip->remote;
-		tunnel.len = rte_be_to_cpu_16(inner->total_length);
-		tunnel.vrf_id = iface->vrf_id;
-		tunnel.proto = IPPROTO_IPIP;
+		inner = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+		ip_cksum_resolve(mbuf, inner);
+		tunnel = ip_local_mbuf_data(mbuf);
+		tunnel->src = ipip->local;
+		tunnel->dst = ipip->remote;
+		tunnel->len = rte_be_to_cpu_16(inner->total_length);
+		tunnel->vrf_id = iface->vrf_id;
+		tunnel->proto = IPPROTO_IPIP;
 		outer = (struct rte_ipv4_hdr *)rte_pktmbuf_prepend(mbuf, sizeof(*outer));
 		if (unlikely(outer == NULL)) {
 			edge = NO_HEADROOM;
 			goto next;
 		}
-		ip_set_fields(outer, &tunnel);
+		ip_set_fields(mbuf, outer, tunnel);
+		if (unlikely(mbuf->ol_flags & RTE_MBUF_F_TX_TCP_SEG)) {
+			// l3_len and l4_len keep describing the inner headers for
+			// port_gso. Only the inner IPv4 checksum can be offloaded.
+			ip_cksum_resolve(mbuf, outer);
+			mbuf->l3_len = rte_ipv4_hdr_len(inner);
+			mbuf->l2_len = 0;
+			mbuf->outer_l3_len = sizeof(*outer);
+			mbuf->ol_flags |= RTE_MBUF_F_TX_IPV4 | RTE_MBUF_F_TX_IP_CKSUM
+				| RTE_MBUF_F_TX_OUTER_IPV4 | RTE_MBUF_F_TX_TUNNEL_IPIP;
+		}
+		iface_stats_add(&stats, iface->id, tunnel->len);
 
 		// Resolve nexthop for the encapsulated packet.
-		ip_data->nh = ip4_route_lookup(iface->vrf_id, ipip->remote);
+		ip_data->nh = ip4_route_cache_lookup(
+			&ipip->route, iface->vrf_id, ipip->remote, route_gen, iface_gen
+		);
 		edge = IP_OUTPUT;
 next:
 		rte_node_enqueue_x1(graph, node, edge, mbuf);
 	}
+	iface_stats_flush(&stats);
 
 	return nb_objs;
 }
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "ipip_priv.h"
+
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_ipip.h>
+#include <gr_macro.h>
+#include <gr_node_bench.h>
+#include <gr_port.h>
+
+#include <rte_byteorder.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+
+#include <netinet/in.h>
+#include <string.h>
+
+#define IP_LEN 46
+
+static struct nexthop tunnel_nh;
+static struct nexthop underlay_nh;
+
+// mocked types/functions
+uint32_t ip4_route_gen = 1;
+void ip_output_add_tunnel(uint16_t, const char *) { }
+struct nexthop *ip4_route_lookup(uint16_t, ip4_addr_t) {
+	return &underlay_nh;
+}
+
+static void ipip_output_prepare(struct rte_mbuf *m, uint16_t) {
+	struct rte_ipv4_hdr *ip = (struct rte_ipv4_hdr *)rte_pktmbuf_append(m, IP_LEN);
+
+	memset(ip, 0, IP_LEN);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->total_length = RTE_BE16(IP_LEN);
+	ip->time_to_live = 63;
+	ip->next_proto_id = IPPROTO_UDP;
+	ip->src_addr = RTE_BE32(RTE_IPV4(192, 0, 2, 1));
+	ip->dst_addr = RTE_BE32(RTE_IPV4(198, 51, 100, 1));
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+	ip_output_mbuf_data(m)->nh = &tunnel_nh;
+}
+
+static void ipip_output_cksum(struct rte_mbuf *m, uint16_t i) {
+	ipip_output_prepare(m, i);
+	// inner header generated locally, resolved in software before encapsulation
+	m->ol_flags |= RTE_MBUF_F_TX_IPV4 | RTE_MBUF_F_TX_IP_CKSUM;
+}
+
+static const struct node_bench benches[] = {
+	{"ipip_output", "ipip_output", 0, ipip_output_prepare, "ip_output"},
+	{"ipip_output/burst1", "ipip_output", 1, ipip_output_prepare, "ip_output"},
+	{"ipip_output/inner_cksum", "ipip_output", 0, ipip_output_cksum, "ip_output"},
+};
+
+int main(void) {
+	struct iface_info_ipip *ipip;
+	struct iface *port, *tunnel;
+
+	port = node_bench_iface_add(GR_IFACE_TYPE_PORT, 0, sizeof(struct iface_info_port));
+	tunnel = node_bench_iface_add(GR_IFACE_TYPE_IPIP, 0, sizeof(*ipip));
+	ipip = (struct iface_info_ipip *)tunnel->info;
+	ipip->local = RTE_BE32(RTE_IPV4(203, 0, 113, 1));
+	ipip->remote = RTE_BE32(RTE_IPV4(203, 0, 113, 2));
+	tunnel_nh.iface_id = tunnel->id;
+	tunnel_nh.iface = tunnel;
+	underlay_nh.flags = GR_IP4_NH_F_REACHABLE;
+	underlay_nh.iface_id = port->id;
+	underlay_nh.iface = port;
+
+	node_bench_init();
+
+	return node_bench_run(benches, ARRAY_DIM(benches));
+}
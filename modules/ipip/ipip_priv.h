@@ -5,15 +5,37 @@
 #define _IPIP_PRIV_H
 
 #include <gr_iface.h>
+#include <gr_ip4_control.h>
 #include <gr_net_types.h>
 
+#include <rte_hash.h>
+
 #include <stdint.h>
 
 struct __rte_aligned(alignof(void *)) iface_info_ipip {
 	ip4_addr_t local;
 	ip4_addr_t remote;
+	struct ip4_route_cache route; // underlay next hop of remote
 };
 
 struct iface *ipip_get_iface(ip4_addr_t local, ip4_addr_t remote, uint16_t vrf_id);
 
+struct ipip_key {
+	ip4_addr_t local;
+	ip4_addr_t remote;
+	// XXX: Using uint16_t causes the compiler to add 2 bytes padding at the
+	// end of the structure. When the structure is initialized on the stack,
+	// the padding bytes have undetermined contents.
+	//
+	// This structure is used to compute a hash key. In order to get
+	// deterministic results, use uint32_t to store the vrf_id so that the
+	// compiler does not insert any padding.
+	uint32_t vrf_id;
+};
+
+#define IPIP_LOOKUP_BULK_MAX RTE_HASH_LOOKUP_BULK_MAX
+
+// Lookup up to IPIP_LOOKUP_BULK_MAX tunnels at once. Unknown tunnels are NULL.
+void ipip_get_iface_bulk(const struct ipip_key *keys, unsigned n, struct iface **ifaces);
+
 #endif
@@ -0,0 +1,357 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_cli_iface.h>
+#include <gr_ipsec.h>
+#include <gr_net_types.h>
+#include <gr_table.h>
+
+#include <ecoli.h>
+#include <libsmartcols.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void ipsec_show(const struct gr_api_client *, const struct gr_iface *iface) {
+	const struct gr_iface_info_ipsec *ipsec = (const struct gr_iface_info_ipsec *)iface->info;
+	char local[64], remote[64];
+
+	inet_ntop(AF_INET, &ipsec->local, local, sizeof(local));
+	inet_ntop(AF_INET, &ipsec->remote, remote, sizeof(remote));
+	printf("local: %s\n", local);
+	printf("remote: %s\n", remote);
+}
+
+static void
+ipsec_list_info(const struct gr_api_client *, const struct gr_iface *iface, char *buf, size_t len) {
+	const struct gr_iface_info_ipsec *ipsec = (const struct gr_iface_info_ipsec *)iface->info;
+	char local[64], remote[64];
+
+	inet_ntop(AF_INET, &ipsec->local, local, sizeof(local));
+	inet_ntop(AF_INET, &ipsec->remote, remote, sizeof(remote));
+	snprintf(buf, len, "local=%s remote=%s", local, remote);
+}
+
+static struct cli_iface_type ipsec_type = {
+	.type_id = GR_IFACE_TYPE_IPSEC,
+	.name = "ipsec",
+	.show = ipsec_show,
+	.list_info = ipsec_list_info,
+};
+
+static uint64_t parse_ipsec_args(
+	const struct gr_api_client *c,
+	const struct ec_pnode *p,
+	struct gr_iface *iface,
+	bool update
+) {
+	uint64_t set_attrs = parse_iface_args(c, p, iface, update);
+	struct gr_iface_info_ipsec *ipsec;
+	const char *local, *remote;
+
+	ipsec = (struct gr_iface_info_ipsec *)iface->info;
+
+	local = arg_str(p, "LOCAL");
+	if (local != NULL) {
+		if (inet_pton(AF_INET, local, &ipsec->local) != 1) {
+			errno = EINVAL;
+			return 0;
+		}
+		set_attrs |= GR_IPSEC_SET_LOCAL;
+	}
+	remote = arg_str(p, "REMOTE");
+	if (remote != NULL) {
+		if (inet_pton(AF_INET, remote, &ipsec->remote) != 1) {
+			errno = EINVAL;
+			return 0;
+		}
+		set_attrs |= GR_IPSEC_SET_REMOTE;
+	}
+	if (ipsec->local == ipsec->remote) {
+		errno = EADDRINUSE;
+		return 0;
+	}
+
+	if (set_attrs == 0)
+		errno = EINVAL;
+	return set_attrs;
+}
+
+static cmd_status_t ipsec_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	const struct gr_infra_iface_add_resp *resp;
+	struct gr_infra_iface_add_req req = {
+		.iface = {.type = GR_IFACE_TYPE_IPSEC, .flags = GR_IFACE_F_UP}
+	};
+	void *resp_ptr = NULL;
+
+	if (parse_ipsec_args(c, p, &req.iface, false) == 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_ADD, sizeof(req), &req, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	printf("Created interface %u\n", resp->iface_id);
+	free(resp_ptr);
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t ipsec_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_iface_set_req req = {0};
+
+	if ((req.set_attrs = parse_ipsec_args(c, p, &req.iface, true)) == 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t cryptodev_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_ipsec_cryptodev_set_req req = {0};
+
+	if (strlen(arg_str(p, "DEVARGS")) >= sizeof(req.devargs)) {
+		errno = ENAMETOOLONG;
+		return CMD_ERROR;
+	}
+	memccpy(req.devargs, arg_str(p, "DEVARGS"), 0, sizeof(req.devargs));
+
+	if (gr_api_client_send_recv(c, GR_IPSEC_CRYPTODEV_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static void parse_dir(const struct ec_pnode *p, uint8_t *dir) {
+	*dir = strcmp(arg_str(p, "DIR"), "in") == 0 ? GR_IPSEC_DIR_IN : GR_IPSEC_DIR_OUT;
+}
+
+static int parse_key(const char *str, struct gr_ipsec_sa *sa) {
+	size_t len;
+
+	if (strncmp(str, "0x", 2) == 0)
+		str += 2;
+	len = strlen(str);
+	if (len != 32 && len != 64)
+		return errno_set(EINVAL);
+	sa->alg = len == 64 ? GR_IPSEC_ALG_AES_GCM_256 : GR_IPSEC_ALG_AES_GCM_128;
+
+	for (size_t i = 0; i < len / 2; i++) {
+		if (sscanf(&str[2 * i], "%2hhx", &sa->key[i]) != 1)
+			return errno_set(EINVAL);
+	}
+
+	return 0;
+}
+
+static cmd_status_t sa_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	const struct gr_ipsec_sa_add_resp *resp;
+	struct gr_ipsec_sa_add_req req = {.exist_ok = true};
+	struct gr_ipsec_sa *sa = &req.sa;
+	void *resp_ptr = NULL;
+	struct gr_iface iface;
+	uint32_t salt;
+
+	if (iface_from_name(c, arg_str(p, "IFACE"), &iface) < 0)
+		return CMD_ERROR;
+	sa->iface_id = iface.id;
+	parse_dir(p, &sa->dir);
+	if (arg_u32(p, "SPI", &sa->spi) < 0)
+		return CMD_ERROR;
+	if (parse_key(arg_str(p, "KEY"), sa) < 0)
+		return CMD_ERROR;
+	if (arg_u32(p, "SALT", &salt) < 0)
+		return CMD_ERROR;
+	sa->salt = htonl(salt);
+	if (arg_u32(p, "WINDOW", &sa->replay_window) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	sa->esn = arg_str(p, "esn") != NULL;
+
+	if (gr_api_client_send_recv(c, GR_IPSEC_SA_ADD, sizeof(req), &req, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	printf("offload: %s\n", resp->offload == GR_IPSEC_OFFLOAD_INLINE ? "inline" : "lookaside");
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t sa_del(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_ipsec_sa_del_req req = {.missing_ok = true};
+	struct gr_iface iface;
+
+	if (iface_from_name(c, arg_str(p, "IFACE"), &iface) < 0)
+		return CMD_ERROR;
+	req.iface_id = iface.id;
+	parse_dir(p, &req.dir);
+	if (arg_u32(p, "SPI", &req.spi) < 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_IPSEC_SA_DEL, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t sa_list(const struct gr_api_client *c, const struct ec_pnode *) {
+	struct libscols_table *table = scols_new_table();
+	const struct gr_ipsec_sa_list_resp *resp;
+	struct gr_iface iface;
+	void *resp_ptr = NULL;
+
+	if (table == NULL)
+		return CMD_ERROR;
+	if (gr_api_client_send_recv(c, GR_IPSEC_SA_LIST, 0, NULL, &resp_ptr) < 0) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+
+	resp = resp_ptr;
+
+	scols_table_new_column(table, "IFACE", 0, 0);
+	scols_table_new_column(table, "DIR", 0, 0);
+	scols_table_new_column(table, "SPI", 0, 0);
+	scols_table_new_column(table, "ALG", 0, 0);
+	scols_table_new_column(table, "OFFLOAD", 0, 0);
+	scols_table_new_column(table, "PACKETS", 0, 0);
+	scols_table_new_column(table, "BYTES", 0, 0);
+	scols_table_new_column(table, "ERRORS", 0, 0);
+	scols_table_set_column_separator(table, "  ");
+
+	for (size_t i = 0; i < resp->n_sas; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_ipsec_sa_status *st = &resp->sas[i];
+
+		if (iface_from_id(c, st->sa.iface_id, &iface) == 0)
+			scols_line_sprintf(line, 0, "%s", iface.name);
+		else
+			scols_line_sprintf(line, 0, "%u", st->sa.iface_id);
+		scols_line_set_data(line, 1, st->sa.dir == GR_IPSEC_DIR_IN ? "in" : "out");
+		scols_line_sprintf(line, 2, "0x%08x", st->sa.spi);
+		scols_line_sprintf(
+			line,
+			3,
+			"aes-gcm-%u%s",
+			st->sa.alg == GR_IPSEC_ALG_AES_GCM_256 ? 256 : 128,
+			st->sa.esn ? "+esn" : ""
+		);
+		scols_line_set_data(
+			line, 4, st->offload == GR_IPSEC_OFFLOAD_INLINE ? "inline" : "lookaside"
+		);
+		scols_line_sprintf(line, 5, "%" PRIu64, st->packets);
+		scols_line_sprintf(line, 6, "%" PRIu64, st->bytes);
+		scols_line_sprintf(line, 7, "%" PRIu64, st->errors);
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+#define IPSEC_ATTRS_ARGS                                                                           \
+	IFACE_ATTRS_ARGS,                                                                          \
+		with_help("Local tunnel endpoint address.", ec_node_re("LOCAL", IPV4_RE)),         \
+		with_help("Remote tunnel endpoint address.", ec_node_re("REMOTE", IPV4_RE))
+
+#define SA_ARGS                                                                                    \
+	with_help(                                                                                 \
+		"IPsec interface name.",                                                           \
+		ec_node_dyn("IFACE", complete_iface_names, INT2PTR(GR_IFACE_TYPE_IPSEC))           \
+	),                                                                                         \
+		with_help("Traffic direction.", ec_node_re("DIR", "in|out")),                      \
+		with_help("Security parameter index.", ec_node_uint("SPI", 256, UINT32_MAX, 0))
+
+#define IPSEC_CTX(root, ctx, help) CLI_CONTEXT(root, ctx, CTX_ARG("ipsec", help))
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_ADD, CTX_ARG("interface", "Create interfaces.")),
+		"ipsec NAME local LOCAL remote REMOTE [" IFACE_ATTRS_CMD "]",
+		ipsec_add,
+		"Create a new IPsec ESP tunnel interface.",
+		with_help("Interface name.", ec_node("any", "NAME")),
+		IPSEC_ATTRS_ARGS
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("interface", "Modify interfaces.")),
+		"ipsec NAME (name NEW_NAME),(local LOCAL),(remote REMOTE)," IFACE_ATTRS_CMD,
+		ipsec_set,
+		"Modify ipsec parameters.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_IPSEC))
+		),
+		with_help("New interface name.", ec_node("any", "NEW_NAME")),
+		IPSEC_ATTRS_ARGS
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		IPSEC_CTX(root, CTX_SET, "Configure IPsec."),
+		"cryptodev DEVARGS",
+		cryptodev_set,
+		"Probe the crypto device used when inline offload is not available.",
+		with_help("Crypto device, e.g. crypto_openssl0.", ec_node("any", "DEVARGS"))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		IPSEC_CTX(root, CTX_ADD, "Create IPsec elements."),
+		"sa IFACE DIR spi SPI key KEY salt SALT [(window WINDOW),(esn)]",
+		sa_add,
+		"Add an AES-GCM security association. The last outbound SA added is used.",
+		SA_ARGS,
+		with_help(
+			"AES-GCM key, 128 or 256 bits in hexadecimal.",
+			ec_node_re("KEY", "(0x)?([0-9a-fA-F]{32}|[0-9a-fA-F]{64})")
+		),
+		with_help("AES-GCM salt in hexadecimal.", ec_node_uint("SALT", 0, UINT32_MAX, 16)),
+		with_help("Anti-replay window size.", ec_node_uint("WINDOW", 0, 4096, 10)),
+		with_help("Use extended sequence numbers.", ec_node_str("esn", "esn"))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		IPSEC_CTX(root, CTX_DEL, "Delete IPsec elements."),
+		"sa IFACE DIR spi SPI",
+		sa_del,
+		"Delete a security association.",
+		SA_ARGS
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		IPSEC_CTX(root, CTX_SHOW, "Show IPsec details."),
+		"sa",
+		sa_list,
+		"List security associations and their counters."
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "ipsec",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+	register_iface_type(&ipsec_type);
+}
@@ -0,0 +1,784 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_ipsec.h"
+#include "ipsec_priv.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_infra.h>
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_log.h>
+#include <gr_port.h>
+#include <gr_rcu.h>
+#include <gr_stb_ds.h>
+
+#include <event2/event.h>
+#include <rte_crypto.h>
+#include <rte_cryptodev.h>
+#include <rte_dev.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_flow.h>
+#include <rte_hash.h>
+#include <rte_ip.h>
+#include <rte_ipsec.h>
+#include <rte_malloc.h>
+#include <rte_security.h>
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define IPSEC_MAX_SAS 4096
+#define IPSEC_OP_POOL_SIZE 16383
+#define IPSEC_OP_POOL_CACHE 256
+#define IPSEC_QP_DESC 2048
+#define IPSEC_MAX_QPS 64
+// Max time to wait for the crypto ops of a deleted SA to complete.
+#define IPSEC_DRAIN_TIMEOUT_US 1000000
+
+static struct rte_hash *sa_hash; // inbound SAs
+static struct ipsec_sa **sas; // stb_ds array, all SAs
+static struct rte_mempool *sec_pools[RTE_MAX_ETHPORTS]; // inline sessions
+
+void ipsec_sa_lookup_bulk(const struct ipsec_key *keys, unsigned n, struct ipsec_sa **out) {
+	const void *key_ptrs[IPSEC_LOOKUP_BULK_MAX];
+	void *data[IPSEC_LOOKUP_BULK_MAX];
+	uint64_t hits = 0;
+
+	for (unsigned i = 0; i < n; i++)
+		key_ptrs[i] = &keys[i];
+
+	if (n > 0 && rte_hash_lookup_bulk_data(sa_hash, key_ptrs, n, &hits, data) < 0)
+		hits = 0;
+
+	for (unsigned i = 0; i < n; i++)
+		out[i] = hits & (UINT64_C(1) << i) ? data[i] : NULL;
+}
+
+// crypto device ///////////////////////////////////////////////////////////////
+
+static void cryptodev_fini(void) {
+	if (ipsec_cdev.started) {
+		__atomic_store_n(&ipsec_cdev.started, false, __ATOMIC_RELEASE);
+		gr_rcu_synchronize();
+		rte_cryptodev_stop(ipsec_cdev.dev_id);
+		rte_cryptodev_close(ipsec_cdev.dev_id);
+	}
+	rte_mempool_free(ipsec_cdev.op_pool);
+	rte_mempool_free(ipsec_cdev.session_pool);
+	memset(&ipsec_cdev, 0, sizeof(ipsec_cdev));
+}
+
+// Crypto devices are named after their bus device, e.g. "crypto_openssl0" or
+// "0000:3d:01.0_qat_sym".
+static int cryptodev_find(const char *devargs) {
+	size_t len = strcspn(devargs, ",");
+	const char *name;
+
+	for (uint8_t dev_id = 0; dev_id < rte_cryptodev_count(); dev_id++) {
+		if ((name = rte_cryptodev_name_get(dev_id)) == NULL)
+			continue;
+		if (strncmp(name, devargs, len) == 0)
+			return dev_id;
+	}
+
+	return errno_set(ENODEV);
+}
+
+static int cryptodev_set(const char *devargs) {
+	struct rte_cryptodev_sym_capability_idx cap = {
+		.type = RTE_CRYPTO_SYM_XFORM_AEAD,
+		.algo.aead = RTE_CRYPTO_AEAD_AES_GCM,
+	};
+	struct rte_cryptodev_qp_conf qp_conf = {.nb_descriptors = IPSEC_QP_DESC};
+	struct rte_cryptodev_config conf = {.socket_id = SOCKET_ID_ANY};
+	struct rte_cryptodev_info info;
+	int ret, dev_id;
+
+	if (ipsec_cdev.started)
+		return errno_set(EBUSY);
+
+	if ((ret = rte_dev_probe(devargs)) < 0 && ret != -EEXIST)
+		return errno_log(-ret, "rte_dev_probe");
+	if ((dev_id = cryptodev_find(devargs)) < 0)
+		return -errno;
+	if (rte_cryptodev_sym_capability_get(dev_id, &cap) == NULL)
+		return errno_set(ENOTSUP);
+
+	rte_cryptodev_info_get(dev_id, &info);
+	ipsec_cdev.dev_id = dev_id;
+	ipsec_cdev.n_qps = RTE_MIN(info.max_nb_queue_pairs, IPSEC_MAX_QPS);
+	if (ipsec_cdev.n_qps == 0)
+		return errno_set(ENOTSUP);
+
+	ipsec_cdev.op_pool = rte_crypto_op_pool_create(
+		"ipsec_ops",
+		RTE_CRYPTO_OP_TYPE_SYMMETRIC,
+		IPSEC_OP_POOL_SIZE,
+		IPSEC_OP_POOL_CACHE,
+		IPSEC_IV_MAX_SIZE,
+		SOCKET_ID_ANY
+	);
+	if (ipsec_cdev.op_pool == NULL) {
+		ret = errno_log(rte_errno, "rte_crypto_op_pool_create");
+		goto err;
+	}
+	ipsec_cdev.session_pool = rte_cryptodev_sym_session_pool_create(
+		"ipsec_sessions",
+		IPSEC_MAX_SAS,
+		rte_cryptodev_sym_get_private_session_size(dev_id),
+		0,
+		0,
+		SOCKET_ID_ANY
+	);
+	if (ipsec_cdev.session_pool == NULL) {
+		ret = errno_log(rte_errno, "rte_cryptodev_sym_session_pool_create");
+		goto err;
+	}
+
+	conf.nb_queue_pairs = ipsec_cdev.n_qps;
+	if ((ret = rte_cryptodev_configure(dev_id, &conf)) < 0) {
+		ret = errno_log(-ret, "rte_cryptodev_configure");
+		goto err;
+	}
+	qp_conf.mp_session = ipsec_cdev.session_pool;
+	for (uint16_t qp = 0; qp < ipsec_cdev.n_qps; qp++) {
+		ret = rte_cryptodev_queue_pair_setup(dev_id, qp, &qp_conf, SOCKET_ID_ANY);
+		if (ret < 0) {
+			ret = errno_log(-ret, "rte_cryptodev_queue_pair_setup");
+			goto err;
+		}
+		rte_spinlock_init(&ipsec_cdev.qps[qp].lock);
+	}
+	if ((ret = rte_cryptodev_start(dev_id)) < 0) {
+		ret = errno_log(-ret, "rte_cryptodev_start");
+		goto err;
+	}
+	__atomic_store_n(&ipsec_cdev.started, true, __ATOMIC_RELEASE);
+
+	LOG(INFO,
+	    "%s: %s, %u queue pairs",
+	    rte_cryptodev_name_get(dev_id),
+	    info.driver_name,
+	    ipsec_cdev.n_qps);
+
+	return 0;
+err:
+	cryptodev_fini();
+	return ret;
+}
+
+// security associations ///////////////////////////////////////////////////////
+
+static uint64_t sa_in_flight(const struct ipsec_sa *sa) {
+	uint64_t enqueued = 0, completed = 0;
+
+	for (unsigned i = 0; i < RTE_DIM(sa->stats); i++) {
+		enqueued += __atomic_load_n(&sa->stats[i].enqueued, __ATOMIC_RELAXED);
+		completed += __atomic_load_n(&sa->stats[i].completed, __ATOMIC_RELAXED);
+	}
+
+	return enqueued - completed;
+}
+
+static void sa_free(struct ipsec_sa *sa) {
+	if (sa == NULL)
+		return;
+
+	switch (sa->ss.type) {
+	case RTE_SECURITY_ACTION_TYPE_NONE:
+		if (sa->ss.crypto.ses != NULL)
+			rte_cryptodev_sym_session_free(sa->ss.crypto.dev_id, sa->ss.crypto.ses);
+		break;
+	case RTE_SECURITY_ACTION_TYPE_INLINE_CRYPTO:
+		if (sa->flow != NULL)
+			rte_flow_destroy(sa->port_id, sa->flow, NULL);
+		if (sa->ss.security.ses != NULL)
+			rte_security_session_destroy(sa->ss.security.ctx, sa->ss.security.ses);
+		break;
+	default:
+		break;
+	}
+	rte_free(sa->ss.sa);
+	rte_free(sa);
+}
+
+// The datapath only knows the SA through the hash and the interface which
+// have been updated already.
+static void sa_release(struct ipsec_sa *sa) {
+	gr_rcu_synchronize();
+	for (unsigned us = 0; sa_in_flight(sa) > 0 && us < IPSEC_DRAIN_TIMEOUT_US; us += 100)
+		usleep(100);
+	if (sa_in_flight(sa) > 0) {
+		// freeing the session now would crash the worker that dequeues them
+		LOG(ERR, "SA 0x%08x: crypto operations still pending, leaking", sa->conf.spi);
+		return;
+	}
+	sa_free(sa);
+}
+
+static const struct iface *sa_underlay_port(uint16_t vrf_id, ip4_addr_t addr) {
+	const struct nexthop *nh = ip4_route_lookup(vrf_id, addr);
+
+	if (nh == NULL || nh->iface == NULL || nh->iface->type_id != GR_IFACE_TYPE_PORT)
+		return NULL;
+
+	return nh->iface;
+}
+
+// Try to create an inline crypto session on the underlay port: the egress port
+// of the remote endpoint (outbound) or the port that owns the local address
+// (inbound). Returns a negative value if not supported.
+static int sa_inline_init(
+	struct ipsec_sa *sa,
+	const struct iface_info_ipsec *tun,
+	struct rte_security_ipsec_xform *ipsec,
+	struct rte_crypto_sym_xform *aead
+) {
+	struct rte_security_capability_idx idx = {
+		.action = RTE_SECURITY_ACTION_TYPE_INLINE_CRYPTO,
+		.protocol = RTE_SECURITY_PROTOCOL_IPSEC,
+		.ipsec = {
+			.proto = ipsec->proto,
+			.mode = ipsec->mode,
+			.direction = ipsec->direction,
+		},
+	};
+	struct rte_security_session_conf conf = {
+		.action_type = RTE_SECURITY_ACTION_TYPE_INLINE_CRYPTO,
+		.protocol = RTE_SECURITY_PROTOCOL_IPSEC,
+		.ipsec = *ipsec,
+		.crypto_xform = aead,
+	};
+	const struct rte_security_capability *cap;
+	const struct iface_info_port *port;
+	char name[RTE_MEMPOOL_NAMESIZE];
+	struct rte_eth_conf eth_conf;
+	const struct iface *iface;
+	void *ctx, *ses;
+
+	if (sa->conf.dir == GR_IPSEC_DIR_OUT)
+		iface = sa_underlay_port(sa->iface->vrf_id, tun->remote);
+	else
+		iface = sa_underlay_port(sa->iface->vrf_id, tun->local);
+	if (iface == NULL)
+		return -1;
+	port = (const struct iface_info_port *)iface->info;
+
+	if ((ctx = rte_eth_dev_get_sec_ctx(port->port_id)) == NULL)
+		return -1;
+	if ((cap = rte_security_capability_get(ctx, &idx)) == NULL)
+		return -1;
+	if (rte_eth_dev_conf_get(port->port_id, &eth_conf) < 0)
+		return -1;
+	if (sa->conf.dir == GR_IPSEC_DIR_OUT && !(port->tx_offloads & RTE_ETH_TX_OFFLOAD_SECURITY))
+		return -1;
+	if (sa->conf.dir == GR_IPSEC_DIR_IN
+	    && !(eth_conf.rxmode.offloads & RTE_ETH_RX_OFFLOAD_SECURITY))
+		return -1;
+
+	if (sec_pools[port->port_id] == NULL) {
+		snprintf(name, sizeof(name), "ipsec_sec_%u", port->port_id);
+		sec_pools[port->port_id] = rte_mempool_create(
+			name,
+			IPSEC_MAX_SAS,
+			rte_security_session_get_size(ctx),
+			0,
+			0,
+			NULL,
+			NULL,
+			NULL,
+			NULL,
+			SOCKET_ID_ANY,
+			0
+		);
+		if (sec_pools[port->port_id] == NULL)
+			return errno_log(rte_errno, "rte_mempool_create");
+	}
+	if ((ses = rte_security_session_create(ctx, &conf, sec_pools[port->port_id])) == NULL)
+		return -1;
+
+	sa->ss.type = RTE_SECURITY_ACTION_TYPE_INLINE_CRYPTO;
+	sa->ss.security.ses = ses;
+	sa->ss.security.ctx = ctx;
+	sa->ss.security.ol_flags = cap->ol_flags;
+	sa->offload = GR_IPSEC_OFFLOAD_INLINE;
+	sa->port_id = port->port_id;
+
+	if (sa->conf.dir == GR_IPSEC_DIR_IN) {
+		// steer the packets of this SA to the decryption engine
+		struct rte_flow_item_ipv4 ip = {.hdr.dst_addr = tun->local};
+		struct rte_flow_item_ipv4 ip_mask = {.hdr.dst_addr = UINT32_MAX};
+		struct rte_flow_item_esp esp = {.hdr.spi = rte_cpu_to_be_32(sa->conf.spi)};
+		struct rte_flow_item_esp esp_mask = {.hdr.spi = UINT32_MAX};
+		struct rte_flow_item pattern[] = {
+			{.type = RTE_FLOW_ITEM_TYPE_ETH},
+			{.type = RTE_FLOW_ITEM_TYPE_IPV4, .spec = &ip, .mask = &ip_mask},
+			{.type = RTE_FLOW_ITEM_TYPE_ESP, .spec = &esp, .mask = &esp_mask},
+			{.type = RTE_FLOW_ITEM_TYPE_END},
+		};
+		struct rte_flow_action_security action = {.security_session = ses};
+		struct rte_flow_action actions[] = {
+			{.type = RTE_FLOW_ACTION_TYPE_SECURITY, .conf = &action},
+			{.type = RTE_FLOW_ACTION_TYPE_END},
+		};
+		struct rte_flow_attr attr = {.ingress = 1};
+		struct rte_flow_error error;
+
+		sa->flow = rte_flow_create(sa->port_id, &attr, pattern, actions, &error);
+		if (sa->flow == NULL) {
+			LOG(NOTICE,
+			    "%s: SA 0x%08x: rte_flow_create: %s",
+			    iface->name,
+			    sa->conf.spi,
+			    error.message ? error.message : "unknown error");
+			rte_security_session_destroy(ctx, ses);
+			memset(&sa->ss.security, 0, sizeof(sa->ss.security));
+			sa->ss.type = RTE_SECURITY_ACTION_TYPE_NONE;
+			sa->offload = GR_IPSEC_OFFLOAD_NONE;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int sa_lookaside_init(struct ipsec_sa *sa, struct rte_crypto_sym_xform *aead) {
+	void *ses;
+
+	if (!ipsec_cdev.started)
+		return errno_set(ENODEV);
+
+	ses = rte_cryptodev_sym_session_create(ipsec_cdev.dev_id, aead, ipsec_cdev.session_pool);
+	if (ses == NULL)
+		return errno_log(rte_errno, "rte_cryptodev_sym_session_create");
+
+	sa->ss.type = RTE_SECURITY_ACTION_TYPE_NONE;
+	sa->ss.crypto.ses = ses;
+	sa->ss.crypto.dev_id = ipsec_cdev.dev_id;
+	sa->offload = GR_IPSEC_OFFLOAD_NONE;
+
+	return 0;
+}
+
+static struct ipsec_sa *sa_new(const struct gr_ipsec_sa *conf, const struct iface *iface) {
+	const struct iface_info_ipsec *tun = (const struct iface_info_ipsec *)iface->info;
+	bool out = conf->dir == GR_IPSEC_DIR_OUT;
+	struct rte_ipv4_hdr hdr = {
+		.version_ihl = IPV4_VERSION_IHL,
+		.time_to_live = IPV4_DEFAULT_TTL,
+		.next_proto_id = IPPROTO_ESP,
+		.src_addr = out ? tun->local : tun->remote,
+		.dst_addr = out ? tun->remote : tun->local,
+	};
+	struct rte_crypto_sym_xform aead = {
+		.type = RTE_CRYPTO_SYM_XFORM_AEAD,
+		.aead = {
+			.op = out ? RTE_CRYPTO_AEAD_OP_ENCRYPT : RTE_CRYPTO_AEAD_OP_DECRYPT,
+			.algo = RTE_CRYPTO_AEAD_AES_GCM,
+			.key = {
+				.data = conf->key,
+				.length = conf->alg == GR_IPSEC_ALG_AES_GCM_256 ? 32 : 16,
+			},
+			.iv = {.offset = IPSEC_IV_OFFSET, .length = 12},
+			.digest_length = 16,
+			.aad_length = conf->esn ? 12 : 8,
+		},
+	};
+	struct rte_ipsec_sa_prm prm = {
+		.flags = RTE_IPSEC_SAFLAG_SQN_ATOM,
+		.ipsec_xform = {
+			.spi = conf->spi,
+			.salt = conf->salt,
+			.options.esn = conf->esn,
+			.direction = out ? RTE_SECURITY_IPSEC_SA_DIR_EGRESS
+					 : RTE_SECURITY_IPSEC_SA_DIR_INGRESS,
+			.proto = RTE_SECURITY_IPSEC_SA_PROTO_ESP,
+			.mode = RTE_SECURITY_IPSEC_SA_MODE_TUNNEL,
+			.tunnel = {
+				.type = RTE_SECURITY_IPSEC_TUNNEL_IPV4,
+				.ipv4 = {
+					.src_ip.s_addr = hdr.src_addr,
+					.dst_ip.s_addr = hdr.dst_addr,
+					.ttl = IPV4_DEFAULT_TTL,
+				},
+			},
+			.replay_win_sz = out ? 0 : conf->replay_window,
+		},
+		.crypto_xform = &aead,
+		.tun = {
+			.hdr_len = sizeof(hdr),
+			.hdr_l3_off = 0,
+			.next_proto = IPPROTO_IPIP,
+			.hdr = &hdr,
+		},
+	};
+	struct ipsec_sa *sa;
+	int size, ret;
+
+	if ((sa = rte_zmalloc(__func__, sizeof(*sa), RTE_CACHE_LINE_SIZE)) == NULL)
+		return errno_set_null(ENOMEM);
+	sa->conf = *conf;
+	sa->iface = iface;
+
+	if ((size = rte_ipsec_sa_size(&prm)) < 0) {
+		errno = -size;
+		goto err;
+	}
+	if ((sa->ss.sa = rte_zmalloc(__func__, size, RTE_CACHE_LINE_SIZE)) == NULL) {
+		errno = ENOMEM;
+		goto err;
+	}
+	if ((ret = rte_ipsec_sa_init(sa->ss.sa, &prm, size)) < 0) {
+		errno = -ret;
+		goto err;
+	}
+
+	// fall back to the crypto device if the underlay port cannot do it
+	if (sa_inline_init(sa, tun, &prm.ipsec_xform, &aead) < 0
+	    && sa_lookaside_init(sa, &aead) < 0)
+		goto err;
+	if ((ret = rte_ipsec_session_prepare(&sa->ss)) < 0) {
+		errno = -ret;
+		goto err;
+	}
+
+	return sa;
+err:
+	ret = errno;
+	sa_free(sa);
+	return errno_set_null(ret);
+}
+
+static struct ipsec_sa *sa_find(uint16_t iface_id, uint8_t dir, uint32_t spi) {
+	struct ipsec_sa *sa;
+
+	for (int i = 0; i < arrlen(sas); i++) {
+		sa = sas[i];
+		if (sa->iface->id == iface_id && sa->conf.dir == dir && sa->conf.spi == spi)
+			return sa;
+	}
+
+	return NULL;
+}
+
+static int sa_add(const struct gr_ipsec_sa *conf, bool exist_ok, uint8_t *offload) {
+	struct gr_ipsec_sa c = *conf;
+	struct iface_info_ipsec *tun;
+	struct ipsec_key key;
+	struct ipsec_sa *sa;
+	struct iface *iface;
+	int ret;
+
+	if ((iface = iface_from_id(c.iface_id)) == NULL)
+		return -errno;
+	if (iface->type_id != GR_IFACE_TYPE_IPSEC)
+		return errno_set(EMEDIUMTYPE);
+	if (c.dir != GR_IPSEC_DIR_IN && c.dir != GR_IPSEC_DIR_OUT)
+		return errno_set(EINVAL);
+	if (c.alg != GR_IPSEC_ALG_AES_GCM_128 && c.alg != GR_IPSEC_ALG_AES_GCM_256)
+		return errno_set(EINVAL);
+	// SPIs 1 to 255 are reserved by IANA
+	if (c.spi < 256)
+		return errno_set(EINVAL);
+	if (c.dir == GR_IPSEC_DIR_IN && c.replay_window == 0)
+		c.replay_window = GR_IPSEC_REPLAY_WINDOW_DEFAULT;
+
+	if ((sa = sa_find(iface->id, c.dir, c.spi)) != NULL) {
+		if (!exist_ok)
+			return errno_set(EEXIST);
+		*offload = sa->offload;
+		return 0;
+	}
+	key = (struct ipsec_key) {rte_cpu_to_be_32(c.spi), iface->vrf_id};
+	if (c.dir == GR_IPSEC_DIR_IN && rte_hash_lookup(sa_hash, &key) >= 0)
+		return errno_set(EADDRINUSE);
+	if (arrlen(sas) >= IPSEC_MAX_SAS)
+		return errno_set(ENOSPC);
+
+	if ((sa = sa_new(&c, iface)) == NULL)
+		return -errno;
+
+	tun = (struct iface_info_ipsec *)iface->info;
+	if (c.dir == GR_IPSEC_DIR_IN) {
+		if ((ret = rte_hash_add_key_data(sa_hash, &key, sa)) < 0) {
+			sa_free(sa);
+			return errno_log(-ret, "rte_hash_add_key_data");
+		}
+	} else {
+		// the previous outbound SA is kept until deleted by the IKE daemon
+		__atomic_store_n(&tun->out, sa, __ATOMIC_RELEASE);
+	}
+	arrpush(sas, sa);
+	*offload = sa->offload;
+
+	LOG(INFO,
+	    "%s: %s SA 0x%08x added (%s)",
+	    iface->name,
+	    c.dir == GR_IPSEC_DIR_IN ? "inbound" : "outbound",
+	    c.spi,
+	    sa->offload == GR_IPSEC_OFFLOAD_INLINE ? "inline" : "lookaside");
+
+	return 0;
+}
+
+static void sa_del(struct ipsec_sa *sa) {
+	struct iface_info_ipsec *tun = (struct iface_info_ipsec *)sa->iface->info;
+	struct ipsec_key key = {rte_cpu_to_be_32(sa->conf.spi), sa->iface->vrf_id};
+	struct ipsec_sa *next = NULL;
+
+	for (int i = 0; i < arrlen(sas); i++) {
+		if (sas[i] == sa) {
+			arrdel(sas, i);
+			break;
+		}
+	}
+
+	if (sa->conf.dir == GR_IPSEC_DIR_IN) {
+		rte_hash_del_key(sa_hash, &key);
+	} else if (tun->out == sa) {
+		// fall back to the most recent remaining outbound SA
+		for (int i = 0; i < arrlen(sas); i++) {
+			if (sas[i]->iface == sa->iface && sas[i]->conf.dir == GR_IPSEC_DIR_OUT)
+				next = sas[i];
+		}
+		__atomic_store_n(&tun->out, next, __ATOMIC_RELEASE);
+	}
+
+	LOG(INFO,
+	    "%s: %s SA 0x%08x deleted",
+	    sa->iface->name,
+	    sa->conf.dir == GR_IPSEC_DIR_IN ? "inbound" : "outbound",
+	    sa->conf.spi);
+
+	sa_release(sa);
+}
+
+static void sa_del_iface(const struct iface *iface) {
+	for (int i = arrlen(sas) - 1; i >= 0; i--) {
+		if (sas[i]->iface == iface)
+			sa_del(sas[i]);
+	}
+}
+
+// interface type //////////////////////////////////////////////////////////////
+
+static int iface_ipsec_reconfig(
+	struct iface *iface,
+	uint64_t set_attrs,
+	uint16_t flags,
+	uint16_t mtu,
+	uint16_t vrf_id,
+	const void *api_info
+) {
+	struct iface_info_ipsec *cur = (struct iface_info_ipsec *)iface->info;
+	const struct gr_iface_info_ipsec *next = api_info;
+
+	if (set_attrs & (GR_IFACE_SET_VRF | GR_IPSEC_SET_LOCAL | GR_IPSEC_SET_REMOTE)) {
+		if (vrf_id >= IP4_MAX_VRFS)
+			return errno_set(EOVERFLOW);
+		if (next->local == next->remote)
+			return errno_set(EADDRINUSE);
+		if (ip4_route_lookup(vrf_id, next->local) == NULL)
+			return -errno;
+		if (ip4_route_lookup(vrf_id, next->remote) == NULL)
+			return -errno;
+		// the tunnel endpoints are part of the SAs
+		for (int i = 0; i < arrlen(sas); i++) {
+			if (sas[i]->iface == iface)
+				return errno_set(EBUSY);
+		}
+		cur->local = next->local;
+		cur->remote = next->remote;
+		iface->vrf_id = vrf_id;
+	}
+
+	if (set_attrs & GR_IFACE_SET_FLAGS)
+		iface->flags = flags;
+	if (set_attrs & GR_IFACE_SET_MTU)
+		iface->mtu = mtu;
+
+	return 0;
+}
+
+static int iface_ipsec_fini(struct iface *iface) {
+	sa_del_iface(iface);
+	return 0;
+}
+
+static int iface_ipsec_init(struct iface *iface, const void *api_info) {
+	int ret;
+
+	ret = iface_ipsec_reconfig(
+		iface, IFACE_SET_ALL, iface->flags, iface->mtu, iface->vrf_id, api_info
+	);
+	if (ret < 0)
+		errno = -ret;
+
+	return ret;
+}
+
+static void ipsec_to_api(void *info, const struct iface *iface) {
+	const struct iface_info_ipsec *ipsec = (const struct iface_info_ipsec *)iface->info;
+	struct gr_iface_info_ipsec *api = info;
+
+	api->local = ipsec->local;
+	api->remote = ipsec->remote;
+}
+
+static struct iface_type iface_type_ipsec = {
+	.id = GR_IFACE_TYPE_IPSEC,
+	.name = "ipsec",
+	.info_size = sizeof(struct iface_info_ipsec),
+	.init = iface_ipsec_init,
+	.reconfig = iface_ipsec_reconfig,
+	.fini = iface_ipsec_fini,
+	.to_api = ipsec_to_api,
+};
+
+// API handlers ////////////////////////////////////////////////////////////////
+
+static struct api_out cryptodev_set_cb(const void *request, void ** /*response*/) {
+	const struct gr_ipsec_cryptodev_set_req *req = request;
+	char devargs[GR_PORT_DEVARGS_SIZE];
+
+	memccpy(devargs, req->devargs, 0, sizeof(devargs));
+	devargs[sizeof(devargs) - 1] = '\0';
+
+	if (cryptodev_set(devargs) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out sa_add_cb(const void *request, void **response) {
+	const struct gr_ipsec_sa_add_req *req = request;
+	struct gr_ipsec_sa_add_resp *resp;
+	uint8_t offload;
+
+	if (sa_add(&req->sa, req->exist_ok, &offload) < 0)
+		return api_out(errno, 0);
+
+	if ((resp = calloc(1, sizeof(*resp))) == NULL)
+		return api_out(ENOMEM, 0);
+	resp->offload = offload;
+	*response = resp;
+
+	return api_out(0, sizeof(*resp));
+}
+
+static struct api_out sa_del_cb(const void *request, void ** /*response*/) {
+	const struct gr_ipsec_sa_del_req *req = request;
+	struct ipsec_sa *sa;
+
+	if ((sa = sa_find(req->iface_id, req->dir, req->spi)) == NULL)
+		return api_out(req->missing_ok ? 0 : ENOENT, 0);
+
+	sa_del(sa);
+
+	return api_out(0, 0);
+}
+
+static struct api_out sa_list_cb(const void * /*request*/, void **response) {
+	struct gr_ipsec_sa_list_resp *resp;
+	struct gr_ipsec_sa_status *st;
+	const struct ipsec_sa *sa;
+	size_t len;
+
+	len = sizeof(*resp) + arrlen(sas) * sizeof(*resp->sas);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	for (int i = 0; i < arrlen(sas); i++) {
+		sa = sas[i];
+		st = &resp->sas[resp->n_sas++];
+		st->sa = sa->conf;
+		memset(st->sa.key, 0, sizeof(st->sa.key));
+		st->sa.salt = 0;
+		st->offload = sa->offload;
+		for (unsigned l = 0; l < RTE_DIM(sa->stats); l++) {
+			st->packets += sa->stats[l].packets;
+			st->bytes += sa->stats[l].bytes;
+			st->errors += sa->stats[l].errors;
+		}
+	}
+
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+// module //////////////////////////////////////////////////////////////////////
+
+static void ipsec_init(struct event_base *) {
+	struct rte_hash_parameters params = {
+		.name = "ipsec_sa",
+		.entries = IPSEC_MAX_SAS,
+		.key_len = sizeof(struct ipsec_key),
+		.socket_id = SOCKET_ID_ANY,
+		.extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF
+			| RTE_HASH_EXTRA_FLAGS_TRANS_MEM_SUPPORT,
+	};
+	sa_hash = rte_hash_create(&params);
+	if (sa_hash == NULL)
+		ABORT("rte_hash_create(ipsec_sa)");
+}
+
+static void ipsec_fini(struct event_base *) {
+	while (arrlen(sas) > 0)
+		sa_del(sas[arrlen(sas) - 1]);
+	arrfree(sas);
+	cryptodev_fini();
+	for (unsigned i = 0; i < RTE_DIM(sec_pools); i++) {
+		rte_mempool_free(sec_pools[i]);
+		sec_pools[i] = NULL;
+	}
+	rte_hash_free(sa_hash);
+	sa_hash = NULL;
+}
+
+static struct gr_module ipsec_module = {
+	.name = "ipsec",
+	.init = ipsec_init,
+	.fini = ipsec_fini,
+	.fini_prio = 1000,
+};
+
+static struct gr_api_handler cryptodev_set_handler = {
+	.name = "ipsec cryptodev set",
+	.request_type = GR_IPSEC_CRYPTODEV_SET,
+	.callback = cryptodev_set_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler sa_add_handler = {
+	.name = "ipsec sa add",
+	.request_type = GR_IPSEC_SA_ADD,
+	.callback = sa_add_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler sa_del_handler = {
+	.name = "ipsec sa del",
+	.request_type = GR_IPSEC_SA_DEL,
+	.callback = sa_del_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler sa_list_handler = {
+	.name = "ipsec sa list",
+	.request_type = GR_IPSEC_SA_LIST,
+	.callback = sa_list_cb,
+};
+
+RTE_INIT(ipsec_constructor) {
+	gr_register_module(&ipsec_module);
+	iface_type_register(&iface_type_ipsec);
+	gr_register_api_handler(&cryptodev_set_handler);
+	gr_register_api_handler(&sa_add_handler);
+	gr_register_api_handler(&sa_del_handler);
+	gr_register_api_handler(&sa_list_handler);
+}
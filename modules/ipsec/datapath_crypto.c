@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "ipsec_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_graph.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+
+#include <rte_crypto.h>
+#include <rte_graph_worker.h>
+#include <rte_ipsec.h>
+
+enum {
+	IP_OUTPUT = 0,
+	IP_INPUT,
+	CRYPTO_ERROR,
+	EDGE_COUNT,
+};
+
+struct ipsec_cryptodev ipsec_cdev;
+
+// Resume the packets processed by the lookaside crypto device. Each worker
+// dequeues its own queue pair.
+static uint16_t
+esp_crypto_done_process(struct rte_graph *graph, struct rte_node *node, void **, uint16_t) {
+	struct rte_ipsec_group groups[RTE_GRAPH_BURST_SIZE];
+	struct rte_crypto_op *ops[RTE_GRAPH_BURST_SIZE];
+	struct rte_mbuf *mbufs[RTE_GRAPH_BURST_SIZE];
+	uint16_t n, n_groups, k;
+	struct ipsec_sa *sa;
+	rte_edge_t edge;
+
+	if (!__atomic_load_n(&ipsec_cdev.started, __ATOMIC_ACQUIRE))
+		return 0;
+	if ((n = ipsec_crypto_dequeue(ops, RTE_DIM(ops))) == 0)
+		return 0;
+
+	// the crypto ops status is reported in the mbuf flags
+	n_groups = rte_ipsec_pkt_crypto_group((const struct rte_crypto_op **)ops, mbufs, groups, n);
+	rte_mempool_put_bulk(ipsec_cdev.op_pool, (void **)ops, n);
+
+	for (uint16_t g = 0; g < n_groups; g++) {
+		struct rte_mbuf **m = groups[g].m;
+		sa = container_of(groups[g].id.ptr, struct ipsec_sa, ss);
+		typeof(sa->stats[0]) *stats = &sa->stats[rte_lcore_id()];
+
+		// failed packets are moved at the end
+		k = rte_ipsec_pkt_process(&sa->ss, m, groups[g].cnt);
+		stats->completed += groups[g].cnt;
+		stats->errors += groups[g].cnt - k;
+		stats->packets += k;
+
+		for (uint16_t i = 0; i < k; i++)
+			stats->bytes += rte_pktmbuf_pkt_len(m[i]);
+		if (sa->conf.dir == GR_IPSEC_DIR_OUT) {
+			for (uint16_t i = 0; i < k; i++)
+				esp_outer_cksum(m[i]);
+			edge = IP_OUTPUT;
+		} else {
+			esp_input_finish(sa, m, k);
+			edge = IP_INPUT;
+		}
+		rte_node_enqueue(graph, node, edge, (void **)m, k);
+		if (k < groups[g].cnt) {
+			rte_node_enqueue(
+				graph, node, CRYPTO_ERROR, (void **)&m[k], groups[g].cnt - k
+			);
+		}
+	}
+
+	return n;
+}
+
+static struct rte_node_register esp_crypto_done_node = {
+	.name = "esp_crypto_done",
+	.flags = RTE_NODE_SOURCE_F,
+
+	.process = esp_crypto_done_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[IP_OUTPUT] = "ip_output",
+		[IP_INPUT] = "ip_input",
+		[CRYPTO_ERROR] = "esp_crypto_error",
+	},
+};
+
+static struct gr_node_info esp_crypto_done_info = {
+	.node = &esp_crypto_done_node,
+};
+
+GR_NODE_REGISTER(esp_crypto_done_info);
+
+GR_DROP_REGISTER(esp_crypto_busy);
+GR_DROP_REGISTER(esp_crypto_error);
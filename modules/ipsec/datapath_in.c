@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "ipsec_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_graph.h>
+#include <gr_ip4_datapath.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+
+#include <rte_crypto.h>
+#include <rte_esp.h>
+#include <rte_graph_worker.h>
+#include <rte_ipsec.h>
+
+#include <netinet/in.h>
+#include <string.h>
+
+enum {
+	IP_INPUT = 0,
+	NO_SA,
+	NO_OFFLOAD,
+	CRYPTO_BUSY,
+	DECAP_ERROR,
+	EDGE_COUNT,
+};
+
+static void esp_input_batch(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	struct ipsec_sa *sa,
+	struct rte_mbuf **mbufs,
+	uint16_t n
+) {
+	struct rte_crypto_op *ops[RTE_GRAPH_BURST_SIZE];
+	typeof(sa->stats[0]) *stats = &sa->stats[rte_lcore_id()];
+	uint16_t k, n_ok;
+
+	if (sa->offload == GR_IPSEC_OFFLOAD_INLINE) {
+		// already decrypted by the port, check the status and strip the headers
+		k = rte_ipsec_pkt_process(&sa->ss, mbufs, n);
+		esp_input_finish(sa, mbufs, k);
+		for (uint16_t i = 0; i < k; i++)
+			stats->bytes += rte_pktmbuf_pkt_len(mbufs[i]);
+		stats->packets += k;
+		rte_node_enqueue(graph, node, IP_INPUT, (void **)mbufs, k);
+		goto end;
+	}
+
+	if (!rte_crypto_op_bulk_alloc(ipsec_cdev.op_pool, RTE_CRYPTO_OP_TYPE_SYMMETRIC, ops, n)) {
+		rte_node_enqueue(graph, node, CRYPTO_BUSY, (void **)mbufs, n);
+		stats->errors += n;
+		return;
+	}
+	// failed packets are moved at the end
+	k = rte_ipsec_pkt_crypto_prepare(&sa->ss, mbufs, ops, n);
+	n_ok = ipsec_crypto_enqueue(ops, k);
+	stats->enqueued += n_ok;
+	if (n_ok < k) {
+		rte_node_enqueue(graph, node, CRYPTO_BUSY, (void **)&mbufs[n_ok], k - n_ok);
+		stats->errors += k - n_ok;
+	}
+	rte_mempool_put_bulk(ipsec_cdev.op_pool, (void **)&ops[n_ok], n - n_ok);
+end:
+	if (k < n) {
+		rte_node_enqueue(graph, node, DECAP_ERROR, (void **)&mbufs[k], n - k);
+		stats->errors += n - k;
+	}
+}
+
+static uint16_t
+esp_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct ipsec_sa *sas[IPSEC_LOOKUP_BULK_MAX], *sa, *batch_sa;
+	struct rte_mbuf *batch[IPSEC_LOOKUP_BULK_MAX];
+	struct ipsec_key keys[IPSEC_LOOKUP_BULK_MAX];
+	struct iface_stats_batch stats = {.tx = false};
+	uint8_t key_idx[IPSEC_LOOKUP_BULK_MAX];
+	struct ip_local_mbuf_data *ip_data;
+	uint16_t i, n, count, n_keys;
+	const struct iface_info_ipsec *tun;
+	const struct rte_esp_hdr *esp;
+	uint16_t n_batch;
+	struct ipsec_key key;
+	struct rte_mbuf *mbuf;
+
+	for (n = 0; n < nb_objs; n += count) {
+		count = RTE_MIN(nb_objs - n, IPSEC_LOOKUP_BULK_MAX);
+
+		// First pass: collect the SA keys. Consecutive packets of the
+		// same SA share a single lookup.
+		n_keys = 0;
+		for (i = 0; i < count; i++) {
+			mbuf = objs[n + i];
+			ip_data = ip_local_mbuf_data(mbuf);
+			key.spi = 0; // reserved, never used by an SA
+			key.vrf_id = ip_data->vrf_id;
+			if (likely(rte_pktmbuf_data_len(mbuf) >= sizeof(*esp))) {
+				esp = rte_pktmbuf_mtod(mbuf, const struct rte_esp_hdr *);
+				key.spi = esp->spi;
+			}
+			if (n_keys == 0 || memcmp(&keys[n_keys - 1], &key, sizeof(key)) != 0)
+				keys[n_keys++] = key;
+			key_idx[i] = n_keys - 1;
+		}
+		ipsec_sa_lookup_bulk(keys, n_keys, sas);
+
+		// Second pass: decrypt the packets, one batch per SA.
+		batch_sa = NULL;
+		n_batch = 0;
+		for (i = 0; i < count; i++) {
+			mbuf = objs[n + i];
+			sa = sas[key_idx[i]];
+			tun = sa != NULL ? (const struct iface_info_ipsec *)sa->iface->info : NULL;
+			if (tun == NULL || tun->remote != ip_local_mbuf_data(mbuf)->src) {
+				rte_node_enqueue_x1(graph, node, NO_SA, mbuf);
+				continue;
+			}
+			if (sa->offload == GR_IPSEC_OFFLOAD_INLINE
+			    && !(mbuf->ol_flags & RTE_MBUF_F_RX_SEC_OFFLOAD)) {
+				// received on another port than the one with the session
+				rte_node_enqueue_x1(graph, node, NO_OFFLOAD, mbuf);
+				continue;
+			}
+			// the ESP header is at the start of the packet
+			mbuf->l2_len = 0;
+			mbuf->l3_len = 0;
+			iface_stats_add(&stats, sa->iface->id, rte_pktmbuf_pkt_len(mbuf));
+			if (sa != batch_sa && n_batch > 0) {
+				esp_input_batch(graph, node, batch_sa, batch, n_batch);
+				n_batch = 0;
+			}
+			batch_sa = sa;
+			batch[n_batch++] = mbuf;
+		}
+		if (n_batch > 0)
+			esp_input_batch(graph, node, batch_sa, batch, n_batch);
+	}
+	iface_stats_flush(&stats);
+
+	return nb_objs;
+}
+
+static void esp_input_register(void) {
+	ip_input_local_add_proto(IPPROTO_ESP, "esp_input");
+}
+
+static struct rte_node_register esp_input_node = {
+	.name = "esp_input",
+
+	.process = esp_input_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[IP_INPUT] = "ip_input",
+		[NO_SA] = "esp_input_no_sa",
+		[NO_OFFLOAD] = "esp_input_no_offload",
+		[CRYPTO_BUSY] = "esp_crypto_busy",
+		[DECAP_ERROR] = "esp_input_error",
+	},
+};
+
+static struct gr_node_info esp_input_info = {
+	.node = &esp_input_node,
+	.register_callback = esp_input_register,
+};
+
+GR_NODE_REGISTER(esp_input_info);
+
+GR_DROP_REGISTER(esp_input_no_sa);
+GR_DROP_REGISTER(esp_input_no_offload);
+GR_DROP_REGISTER(esp_input_error);
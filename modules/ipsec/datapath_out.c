@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "ipsec_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_graph.h>
+#include <gr_iface.h>
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_ipsec.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+#include <gr_port.h>
+
+#include <rte_crypto.h>
+#include <rte_graph_worker.h>
+#include <rte_ip.h>
+#include <rte_ipsec.h>
+
+enum {
+	IP_OUTPUT = 0,
+	NO_TUNNEL,
+	NO_SA,
+	OFFLOAD_MISMATCH,
+	CRYPTO_BUSY,
+	ENCAP_ERROR,
+	EDGE_COUNT,
+};
+
+// Encrypt a batch of packets of the same SA. Lookaside packets are handed over
+// to the crypto device and resume in ipsec_crypto_done. Inline packets only
+// get their ESP headers, the underlay port encrypts them.
+static void esp_output_batch(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	struct ipsec_sa *sa,
+	struct rte_mbuf **mbufs,
+	uint16_t n
+) {
+	struct rte_crypto_op *ops[RTE_GRAPH_BURST_SIZE];
+	typeof(sa->stats[0]) *stats = &sa->stats[rte_lcore_id()];
+	uint16_t k, n_ok;
+
+	if (sa->offload == GR_IPSEC_OFFLOAD_INLINE) {
+		k = rte_ipsec_pkt_process(&sa->ss, mbufs, n);
+		for (uint16_t i = 0; i < k; i++)
+			esp_outer_cksum(mbufs[i]);
+		stats->packets += k;
+		rte_node_enqueue(graph, node, IP_OUTPUT, (void **)mbufs, k);
+		goto end;
+	}
+
+	if (!rte_crypto_op_bulk_alloc(ipsec_cdev.op_pool, RTE_CRYPTO_OP_TYPE_SYMMETRIC, ops, n)) {
+		rte_node_enqueue(graph, node, CRYPTO_BUSY, (void **)mbufs, n);
+		stats->errors += n;
+		return;
+	}
+	// failed packets are moved at the end
+	k = rte_ipsec_pkt_crypto_prepare(&sa->ss, mbufs, ops, n);
+	n_ok = ipsec_crypto_enqueue(ops, k);
+	stats->enqueued += n_ok;
+	if (n_ok < k) {
+		rte_node_enqueue(graph, node, CRYPTO_BUSY, (void **)&mbufs[n_ok], k - n_ok);
+		stats->errors += k - n_ok;
+	}
+	rte_mempool_put_bulk(ipsec_cdev.op_pool, (void **)&ops[n_ok], n - n_ok);
+end:
+	if (k < n) {
+		rte_node_enqueue(graph, node, ENCAP_ERROR, (void **)&mbufs[k], n - k);
+		stats->errors += n - k;
+	}
+}
+
+static uint16_t
+esp_output_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct iface_stats_batch stats = {.tx = true};
+	struct rte_mbuf *batch[RTE_GRAPH_BURST_SIZE];
+	struct ip_output_mbuf_data *ip_data;
+	struct ipsec_sa *sa, *batch_sa = NULL;
+	const struct iface_info_port *port;
+	uint32_t route_gen, iface_gen;
+	struct iface_info_ipsec *ipsec;
+	const struct iface *iface;
+	struct rte_ipv4_hdr *inner;
+	uint16_t n_batch = 0;
+	struct rte_mbuf *mbuf;
+	rte_edge_t edge;
+
+	route_gen = __atomic_load_n(&ip4_route_gen, __ATOMIC_ACQUIRE);
+	iface_gen = __atomic_load_n(&iface_config_gen, __ATOMIC_ACQUIRE);
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+
+		ip_data = ip_output_mbuf_data(mbuf);
+		iface = ip_data->nh->iface;
+		if (iface == NULL || iface->type_id != GR_IFACE_TYPE_IPSEC) {
+			edge = NO_TUNNEL;
+			goto next;
+		}
+		ipsec = (struct iface_info_ipsec *)iface->info;
+		if ((sa = __atomic_load_n(&ipsec->out, __ATOMIC_ACQUIRE)) == NULL) {
+			edge = NO_SA;
+			goto next;
+		}
+		// encryption must happen after segmentation
+		if (unlikely(mbuf->ol_flags & RTE_MBUF_F_TX_TCP_SEG)) {
+			edge = ENCAP_ERROR;
+			goto next;
+		}
+		ip_data->input_iface = iface;
+
+		// The offload flags only apply to the outer header.
+		inner = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+		ip_cksum_resolve(mbuf, inner);
+		mbuf->ol_flags &= ~RTE_MBUF_F_TX_OFFLOAD_MASK;
+		// the protected data starts at the inner IP header
+		mbuf->l2_len = 0;
+		iface_stats_add(&stats, iface->id, rte_pktmbuf_pkt_len(mbuf));
+
+		// Resolve nexthop for the encapsulated packet.
+		ip_data->nh = ip4_route_cache_lookup(
+			&ipsec->route, iface->vrf_id, ipsec->remote, route_gen, iface_gen
+		);
+		if (sa->offload == GR_IPSEC_OFFLOAD_INLINE) {
+			// only the port that owns the security session can encrypt
+			iface = ip_data->nh != NULL ? ip_data->nh->iface : NULL;
+			if (iface == NULL || iface->type_id != GR_IFACE_TYPE_PORT) {
+				edge = OFFLOAD_MISMATCH;
+				goto next;
+			}
+			port = (const struct iface_info_port *)iface->info;
+			if (port->port_id != sa->port_id) {
+				edge = OFFLOAD_MISMATCH;
+				goto next;
+			}
+		}
+
+		if (sa != batch_sa && n_batch > 0) {
+			esp_output_batch(graph, node, batch_sa, batch, n_batch);
+			n_batch = 0;
+		}
+		batch_sa = sa;
+		batch[n_batch++] = mbuf;
+		if (n_batch == RTE_DIM(batch)) {
+			esp_output_batch(graph, node, batch_sa, batch, n_batch);
+			n_batch = 0;
+		}
+		continue;
+next:
+		rte_node_enqueue_x1(graph, node, edge, mbuf);
+	}
+	if (n_batch > 0)
+		esp_output_batch(graph, node, batch_sa, batch, n_batch);
+	iface_stats_flush(&stats);
+
+	return nb_objs;
+}
+
+static void esp_output_register(void) {
+	ip_output_add_tunnel(GR_IFACE_TYPE_IPSEC, "esp_output");
+}
+
+static struct rte_node_register esp_output_node = {
+	.name = "esp_output",
+
+	.process = esp_output_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[IP_OUTPUT] = "ip_output",
+		[NO_TUNNEL] = "esp_output_no_tunnel",
+		[NO_SA] = "esp_output_no_sa",
+		[OFFLOAD_MISMATCH] = "esp_output_offload_mismatch",
+		[CRYPTO_BUSY] = "esp_crypto_busy",
+		[ENCAP_ERROR] = "esp_output_error",
+	},
+};
+
+static struct gr_node_info esp_output_info = {
+	.node = &esp_output_node,
+	.register_callback = esp_output_register,
+};
+
+GR_NODE_REGISTER(esp_output_info);
+
+GR_DROP_REGISTER(esp_output_no_tunnel);
+GR_DROP_REGISTER(esp_output_no_sa);
+GR_DROP_REGISTER(esp_output_offload_mismatch);
+GR_DROP_REGISTER(esp_output_error);
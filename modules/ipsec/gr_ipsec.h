@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_API_IPSEC
+#define _GR_API_IPSEC
+
+#include <gr_api.h>
+#include <gr_bitops.h>
+#include <gr_infra.h>
+#include <gr_macro.h>
+#include <gr_net_types.h>
+
+#define GR_IFACE_TYPE_IPSEC 0x000a
+
+// IPsec reconfig attributes
+#define GR_IPSEC_SET_LOCAL GR_BIT64(32)
+#define GR_IPSEC_SET_REMOTE GR_BIT64(33)
+
+// Info for GR_IFACE_TYPE_IPSEC interfaces. Route based ESP tunnel: packets
+// routed through the interface are encrypted with its outbound SA, ESP
+// packets received from the remote endpoint are decrypted with one of its
+// inbound SAs and input on the interface.
+struct gr_iface_info_ipsec {
+	ip4_addr_t local;
+	ip4_addr_t remote;
+};
+
+static_assert(sizeof(struct gr_iface_info_ipsec) <= MEMBER_SIZE(struct gr_iface, info));
+
+#define GR_IPSEC_MODULE 0x15ec
+
+#define GR_IPSEC_DIR_IN 1
+#define GR_IPSEC_DIR_OUT 2
+
+#define GR_IPSEC_ALG_AES_GCM_128 1
+#define GR_IPSEC_ALG_AES_GCM_256 2
+
+#define GR_IPSEC_KEY_SIZE 32
+#define GR_IPSEC_REPLAY_WINDOW_DEFAULT 128
+
+#define GR_IPSEC_OFFLOAD_NONE 0 // cryptodev, lookaside
+#define GR_IPSEC_OFFLOAD_INLINE 1 // rte_security inline crypto on the underlay port
+
+// Security association negotiated by an external IKE daemon. Rekeying is
+// done by adding the new SAs before deleting the old ones: an interface has
+// only one outbound SA (the last one added) but can have several inbound SAs.
+struct gr_ipsec_sa {
+	uint32_t spi;
+	uint16_t iface_id;
+	uint8_t dir; // GR_IPSEC_DIR_*
+	uint8_t alg; // GR_IPSEC_ALG_*
+	uint8_t key[GR_IPSEC_KEY_SIZE]; // only the first 16 bytes with AES_GCM_128
+	uint32_t salt; // network order
+	uint32_t replay_window; // inbound only, 0 for the default
+	bool esn; // extended sequence numbers
+};
+
+struct gr_ipsec_sa_status {
+	struct gr_ipsec_sa sa; // the key is never returned
+	uint8_t offload; // GR_IPSEC_OFFLOAD_*
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t errors; // crypto failures, replayed or invalid packets
+};
+
+// crypto device ///////////////////////////////////////////////////////////////
+
+// Probe and configure the crypto device used by the lookaside SAs, e.g.
+// "crypto_openssl0" or a PCI address.
+#define GR_IPSEC_CRYPTODEV_SET REQUEST_TYPE(GR_IPSEC_MODULE, 0x0001)
+
+struct gr_ipsec_cryptodev_set_req {
+	char devargs[GR_PORT_DEVARGS_SIZE];
+};
+
+// struct gr_ipsec_cryptodev_set_resp { };
+
+// security associations ///////////////////////////////////////////////////////
+
+#define GR_IPSEC_SA_ADD REQUEST_TYPE(GR_IPSEC_MODULE, 0x0002)
+
+struct gr_ipsec_sa_add_req {
+	struct gr_ipsec_sa sa;
+	uint8_t exist_ok;
+};
+
+struct gr_ipsec_sa_add_resp {
+	uint8_t offload; // GR_IPSEC_OFFLOAD_*
+};
+
+#define GR_IPSEC_SA_DEL REQUEST_TYPE(GR_IPSEC_MODULE, 0x0003)
+
+struct gr_ipsec_sa_del_req {
+	uint16_t iface_id;
+	uint8_t dir; // GR_IPSEC_DIR_*
+	uint32_t spi;
+	uint8_t missing_ok;
+};
+
+// struct gr_ipsec_sa_del_resp { };
+
+#define GR_IPSEC_SA_LIST REQUEST_TYPE(GR_IPSEC_MODULE, 0x0004)
+
+// struct gr_ipsec_sa_list_req { };
+
+struct gr_ipsec_sa_list_resp {
+	uint16_t n_sas;
+	struct gr_ipsec_sa_status sas[/* n_sas */];
+};
+
+#endif
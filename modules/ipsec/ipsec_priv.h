@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _IPSEC_PRIV_H
+#define _IPSEC_PRIV_H
+
+#include <gr_eth_input.h>
+#include <gr_iface.h>
+#include <gr_ip4_control.h>
+#include <gr_ipsec.h>
+#include <gr_net_types.h>
+
+#include <rte_build_config.h>
+#include <rte_crypto.h>
+#include <rte_cryptodev.h>
+#include <rte_hash.h>
+#include <rte_ip.h>
+#include <rte_ipsec.h>
+#include <rte_lcore.h>
+#include <rte_mbuf_ptype.h>
+#include <rte_spinlock.h>
+
+#include <stdint.h>
+
+// Offset of the IV in the crypto operations, right after the symmetric op.
+#define IPSEC_IV_OFFSET (sizeof(struct rte_crypto_op) + sizeof(struct rte_crypto_sym_op))
+#define IPSEC_IV_MAX_SIZE 16
+
+struct ipsec_sa {
+	struct gr_ipsec_sa conf;
+	const struct iface *iface;
+	// lookaside or inline rte_ipsec session
+	struct rte_ipsec_session ss;
+	uint8_t offload; // GR_IPSEC_OFFLOAD_*
+	uint16_t port_id; // underlay port with GR_IPSEC_OFFLOAD_INLINE
+	struct rte_flow *flow; // inbound inline SA steering rule
+	// indexed by rte_lcore_id(), only written by that worker
+	struct __rte_cache_aligned {
+		uint64_t packets;
+		uint64_t bytes;
+		uint64_t errors;
+		// crypto ops, the session cannot be freed while they differ
+		uint64_t enqueued;
+		uint64_t completed;
+	} stats[RTE_MAX_LCORE];
+};
+
+struct __rte_aligned(alignof(void *)) iface_info_ipsec {
+	ip4_addr_t local;
+	ip4_addr_t remote;
+	struct ip4_route_cache route; // underlay next hop of remote
+	struct ipsec_sa *out; // NULL until the IKE daemon has added an outbound SA
+};
+
+struct ipsec_key {
+	uint32_t spi; // network order
+	// uint32_t to avoid padding bytes in the hash key, see struct ipip_key
+	uint32_t vrf_id;
+};
+
+#define IPSEC_LOOKUP_BULK_MAX RTE_HASH_LOOKUP_BULK_MAX
+
+// Lookup up to IPSEC_LOOKUP_BULK_MAX inbound SAs at once. Unknown SAs are NULL.
+void ipsec_sa_lookup_bulk(const struct ipsec_key *keys, unsigned n, struct ipsec_sa **sas);
+
+// Lookaside crypto device shared by all workers. Each worker uses the queue
+// pair rte_lcore_id() % n_qps. Queue pairs are not thread safe, the lock is
+// only contended when there are more workers than queue pairs.
+struct ipsec_cryptodev {
+	uint8_t dev_id;
+	bool started;
+	uint16_t n_qps;
+	struct rte_mempool *op_pool;
+	struct rte_mempool *session_pool;
+	struct __rte_cache_aligned {
+		rte_spinlock_t lock;
+		uint32_t in_flight; // ops enqueued and not dequeued yet
+	} qps[RTE_MAX_LCORE];
+};
+
+extern struct ipsec_cryptodev ipsec_cdev;
+
+static inline uint16_t ipsec_cryptodev_qp(void) {
+	return rte_lcore_id() % ipsec_cdev.n_qps;
+}
+
+// Enqueue crypto operations prepared by rte_ipsec_pkt_crypto_prepare().
+// Returns the number of ops accepted by the device.
+static inline uint16_t ipsec_crypto_enqueue(struct rte_crypto_op **ops, uint16_t n) {
+	uint16_t qp = ipsec_cryptodev_qp();
+	uint16_t n_ok;
+
+	rte_spinlock_lock(&ipsec_cdev.qps[qp].lock);
+	n_ok = rte_cryptodev_enqueue_burst(ipsec_cdev.dev_id, qp, ops, n);
+	rte_spinlock_unlock(&ipsec_cdev.qps[qp].lock);
+	__atomic_add_fetch(&ipsec_cdev.qps[qp].in_flight, n_ok, __ATOMIC_RELAXED);
+
+	return n_ok;
+}
+
+static inline uint16_t ipsec_crypto_dequeue(struct rte_crypto_op **ops, uint16_t n) {
+	uint16_t qp = ipsec_cryptodev_qp();
+	uint16_t n_ok;
+
+	if (__atomic_load_n(&ipsec_cdev.qps[qp].in_flight, __ATOMIC_RELAXED) == 0)
+		return 0;
+	rte_spinlock_lock(&ipsec_cdev.qps[qp].lock);
+	n_ok = rte_cryptodev_dequeue_burst(ipsec_cdev.dev_id, qp, ops, n);
+	rte_spinlock_unlock(&ipsec_cdev.qps[qp].lock);
+	__atomic_sub_fetch(&ipsec_cdev.qps[qp].in_flight, n_ok, __ATOMIC_RELAXED);
+
+	return n_ok;
+}
+
+// The outer header is copied from the SA template by rte_ipsec, only the
+// length and packet id are updated. Let the egress port or eth_output compute
+// the checksum.
+static inline void esp_outer_cksum(struct rte_mbuf *m) {
+	struct rte_ipv4_hdr *ip = rte_pktmbuf_mtod(m, struct rte_ipv4_hdr *);
+
+	ip->hdr_checksum = 0;
+	m->l2_len = 0;
+	m->l3_len = rte_ipv4_hdr_len(ip);
+	m->ol_flags |= RTE_MBUF_F_TX_IPV4 | RTE_MBUF_F_TX_IP_CKSUM;
+}
+
+// Prepare decrypted packets for ip_input on the tunnel interface.
+static inline void
+esp_input_finish(const struct ipsec_sa *sa, struct rte_mbuf **mbufs, uint16_t n) {
+	const uint64_t sec_flags = RTE_MBUF_F_RX_SEC_OFFLOAD | RTE_MBUF_F_RX_SEC_OFFLOAD_FAILED;
+	struct eth_input_mbuf_data *eth_data;
+
+	for (uint16_t i = 0; i < n; i++) {
+		struct rte_mbuf *m = mbufs[i];
+		// The hw checksum and ptype info only apply to the outer IP.
+		m->ol_flags = (m->ol_flags & ~sec_flags) | RTE_MBUF_F_RX_IP_CKSUM_NONE;
+		m->packet_type = RTE_PTYPE_UNKNOWN;
+		eth_data = eth_input_mbuf_data(m);
+		eth_data->iface = sa->iface;
+		eth_data->eth_dst = ETH_DST_LOCAL;
+	}
+}
+
+#endif
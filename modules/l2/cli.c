@@ -0,0 +1,357 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_cli_iface.h>
+#include <gr_l2.h>
+#include <gr_net_types.h>
+#include <gr_table.h>
+
+#include <ecoli.h>
+#include <libsmartcols.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void bridge_show(const struct gr_api_client *c, const struct gr_iface *iface) {
+	const struct gr_iface_info_bridge *br = (const struct gr_iface_info_bridge *)iface->info;
+	struct gr_iface member;
+
+	printf("mac: " ETH_ADDR_FMT "\n", ETH_ADDR_SPLIT(&br->mac));
+	printf("ageing: %us\n", br->ageing_time);
+	printf("members:");
+	for (uint16_t i = 0; i < br->n_members; i++) {
+		if (iface_from_id(c, br->member_ids[i], &member) < 0)
+			printf(" %u", br->member_ids[i]);
+		else
+			printf(" %s", member.name);
+	}
+	printf("\n");
+}
+
+static void bridge_list_info(
+	const struct gr_api_client *,
+	const struct gr_iface *iface,
+	char *buf,
+	size_t len
+) {
+	const struct gr_iface_info_bridge *br = (const struct gr_iface_info_bridge *)iface->info;
+
+	snprintf(
+		buf,
+		len,
+		"mac=" ETH_ADDR_FMT " members=%u ageing=%u",
+		ETH_ADDR_SPLIT(&br->mac),
+		br->n_members,
+		br->ageing_time
+	);
+}
+
+static struct cli_iface_type bridge_type = {
+	.type_id = GR_IFACE_TYPE_BRIDGE,
+	.name = "bridge",
+	.show = bridge_show,
+	.list_info = bridge_list_info,
+};
+
+static uint64_t parse_bridge_args(
+	const struct gr_api_client *c,
+	const struct ec_pnode *p,
+	struct gr_iface *iface,
+	bool update
+) {
+	uint64_t set_attrs = parse_iface_args(c, p, iface, update);
+	struct gr_iface_info_bridge *br;
+	const struct ec_pnode *n;
+	struct gr_iface member;
+	uint16_t count;
+
+	br = (struct gr_iface_info_bridge *)iface->info;
+
+	count = 0;
+	for (n = ec_pnode_find(p, "MEMBER"); n != NULL;
+	     n = ec_pnode_find_next(p, n, "MEMBER", false)) {
+		const struct ec_strvec *v = ec_pnode_get_strvec(n);
+		if (count == GR_BRIDGE_MAX_MEMBERS) {
+			errno = ERANGE;
+			return 0;
+		}
+		if (iface_from_name(c, ec_strvec_val(v, 0), &member) < 0)
+			return 0;
+		br->member_ids[count++] = member.id;
+	}
+	if (count > 0 || arg_str(p, "none") != NULL) {
+		br->n_members = count;
+		set_attrs |= GR_BRIDGE_SET_MEMBERS;
+	}
+
+	if (arg_u16(p, "AGEING", &br->ageing_time) == 0)
+		set_attrs |= GR_BRIDGE_SET_AGEING;
+
+	if (arg_eth_addr(p, "MAC", &br->mac) == 0)
+		set_attrs |= GR_BRIDGE_SET_MAC;
+
+	if (set_attrs == 0)
+		errno = EINVAL;
+	return set_attrs;
+}
+
+static cmd_status_t bridge_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	const struct gr_infra_iface_add_resp *resp;
+	struct gr_infra_iface_add_req req = {
+		.iface = {.type = GR_IFACE_TYPE_BRIDGE, .flags = GR_IFACE_F_UP}
+	};
+	void *resp_ptr = NULL;
+
+	if (parse_bridge_args(c, p, &req.iface, false) == 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_ADD, sizeof(req), &req, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	printf("Created interface %u\n", resp->iface_id);
+	free(resp_ptr);
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t bridge_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_iface_set_req req = {0};
+
+	if ((req.set_attrs = parse_bridge_args(c, p, &req.iface, true)) == 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static int bridge_from_name(const struct gr_api_client *c, const char *name, uint16_t *id) {
+	struct gr_iface iface;
+
+	if (iface_from_name(c, name, &iface) < 0)
+		return -errno;
+	if (iface.type != GR_IFACE_TYPE_BRIDGE)
+		return errno_set(EMEDIUMTYPE);
+	*id = iface.id;
+
+	return 0;
+}
+
+static cmd_status_t fdb_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_l2_fdb_add_req req = {.exist_ok = true};
+	struct gr_iface iface;
+
+	if (arg_eth_addr(p, "MAC", &req.entry.mac) < 0)
+		return CMD_ERROR;
+	if (bridge_from_name(c, arg_str(p, "BRIDGE"), &req.entry.bridge_id) < 0)
+		return CMD_ERROR;
+	if (iface_from_name(c, arg_str(p, "IFACE"), &iface) < 0)
+		return CMD_ERROR;
+	req.entry.iface_id = iface.id;
+
+	if (gr_api_client_send_recv(c, GR_L2_FDB_ADD, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t fdb_del(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_l2_fdb_del_req req = {.missing_ok = true};
+
+	if (arg_eth_addr(p, "MAC", &req.mac) < 0)
+		return CMD_ERROR;
+	if (bridge_from_name(c, arg_str(p, "BRIDGE"), &req.bridge_id) < 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_L2_FDB_DEL, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t fdb_flush(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_l2_fdb_flush_req req = {.iface_id = GR_IFACE_ID_UNDEF};
+	struct gr_iface iface;
+
+	if (bridge_from_name(c, arg_str(p, "BRIDGE"), &req.bridge_id) < 0)
+		return CMD_ERROR;
+	if (arg_str(p, "IFACE") != NULL) {
+		if (iface_from_name(c, arg_str(p, "IFACE"), &iface) < 0)
+			return CMD_ERROR;
+		req.iface_id = iface.id;
+	}
+	req.all = arg_str(p, "all") != NULL;
+
+	if (gr_api_client_send_recv(c, GR_L2_FDB_FLUSH, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t fdb_list(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_l2_fdb_list_req req = {.bridge_id = GR_IFACE_ID_UNDEF};
+	struct libscols_table *table = scols_new_table();
+	const struct gr_l2_fdb_list_resp *resp;
+	struct gr_iface iface;
+	void *resp_ptr = NULL;
+
+	if (table == NULL)
+		return CMD_ERROR;
+	if (arg_str(p, "BRIDGE") != NULL) {
+		if (bridge_from_name(c, arg_str(p, "BRIDGE"), &req.bridge_id) < 0) {
+			scols_unref_table(table);
+			return CMD_ERROR;
+		}
+	}
+	if (gr_api_client_send_recv(c, GR_L2_FDB_LIST, sizeof(req), &req, &resp_ptr) < 0) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+
+	resp = resp_ptr;
+
+	scols_table_new_column(table, "BRIDGE", 0, 0);
+	scols_table_new_column(table, "MAC", 0, 0);
+	scols_table_new_column(table, "IFACE", 0, 0);
+	scols_table_new_column(table, "FLAGS", 0, 0);
+	scols_table_new_column(table, "AGE", 0, 0);
+	scols_table_set_column_separator(table, "  ");
+
+	for (size_t i = 0; i < resp->n_entries; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_l2_fdb_entry *e = &resp->entries[i];
+
+		if (iface_from_id(c, e->bridge_id, &iface) == 0)
+			scols_line_set_data(line, 0, iface.name);
+		else
+			scols_line_sprintf(line, 0, "%u", e->bridge_id);
+		scols_line_sprintf(line, 1, ETH_ADDR_FMT, ETH_ADDR_SPLIT(&e->mac));
+		if (iface_from_id(c, e->iface_id, &iface) == 0)
+			scols_line_set_data(line, 2, iface.name);
+		else
+			scols_line_sprintf(line, 2, "%u", e->iface_id);
+		if (e->flags & GR_L2_FDB_F_STATIC) {
+			scols_line_set_data(line, 3, "static");
+			scols_line_set_data(line, 4, "");
+		} else {
+			scols_line_set_data(line, 3, "learned");
+			scols_line_sprintf(line, 4, "%us", e->age);
+		}
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+#define BRIDGE_ATTRS_CMD IFACE_ATTRS_CMD ",(ageing AGEING),(mac MAC)"
+
+#define BRIDGE_ATTRS_ARGS                                                                          \
+	IFACE_ATTRS_ARGS,                                                                          \
+		with_help(                                                                         \
+			"Member port, VLAN or bond interface.",                                    \
+			ec_node_dyn("MEMBER", complete_iface_names, NULL)                          \
+		),                                                                                 \
+		with_help(                                                                         \
+			"Lifetime of learned addresses in seconds.",                               \
+			ec_node_uint("AGEING", 1, UINT16_MAX, 10)                                  \
+		),                                                                                 \
+		with_help("Set the ethernet address.", ec_node_re("MAC", ETH_ADDR_RE))
+
+#define BRIDGE_ARG                                                                                 \
+	with_help(                                                                                 \
+		"Bridge interface name.",                                                          \
+		ec_node_dyn("BRIDGE", complete_iface_names, INT2PTR(GR_IFACE_TYPE_BRIDGE))         \
+	)
+
+#define L2_CTX(root, ctx, help) CLI_CONTEXT(root, ctx, CTX_ARG("l2", help))
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_ADD, CTX_ARG("interface", "Create interfaces.")),
+		"bridge NAME [(members MEMBER+)," BRIDGE_ATTRS_CMD "]",
+		bridge_add,
+		"Create a new bridge interface.",
+		with_help("Interface name.", ec_node("any", "NAME")),
+		BRIDGE_ATTRS_ARGS
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("interface", "Modify interfaces.")),
+		"bridge NAME (name NEW_NAME),(members (MEMBER+|none))," BRIDGE_ATTRS_CMD,
+		bridge_set,
+		"Modify bridge parameters.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_BRIDGE))
+		),
+		with_help("New interface name.", ec_node("any", "NEW_NAME")),
+		with_help("Remove all members.", ec_node_str("none", "none")),
+		BRIDGE_ATTRS_ARGS
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		L2_CTX(root, CTX_ADD, "Create L2 switching elements."),
+		"fdb MAC bridge BRIDGE iface IFACE",
+		fdb_add,
+		"Add a static forwarding entry.",
+		with_help("Destination ethernet address.", ec_node_re("MAC", ETH_ADDR_RE)),
+		BRIDGE_ARG,
+		with_help("Bridge member.", ec_node_dyn("IFACE", complete_iface_names, NULL))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		L2_CTX(root, CTX_DEL, "Delete L2 switching elements."),
+		"fdb MAC bridge BRIDGE",
+		fdb_del,
+		"Delete a forwarding entry.",
+		with_help("Destination ethernet address.", ec_node_re("MAC", ETH_ADDR_RE)),
+		BRIDGE_ARG
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		L2_CTX(root, CTX_CLEAR, "Clear L2 switching elements."),
+		"fdb bridge BRIDGE [(iface IFACE),(all)]",
+		fdb_flush,
+		"Flush learned forwarding entries.",
+		BRIDGE_ARG,
+		with_help("Bridge member.", ec_node_dyn("IFACE", complete_iface_names, NULL)),
+		with_help("Also flush static entries.", ec_node_str("all", "all"))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		L2_CTX(root, CTX_SHOW, "Show L2 switching details."),
+		"fdb [bridge BRIDGE]",
+		fdb_list,
+		"List forwarding entries.",
+		BRIDGE_ARG
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "l2",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+	register_iface_type(&bridge_type);
+}
@@ -0,0 +1,656 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_l2.h"
+#include "l2_priv.h"
+
+#include <gr_api.h>
+#include <gr_bond.h>
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_log.h>
+#include <gr_macro.h>
+#include <gr_net_types.h>
+#include <gr_port.h>
+#include <gr_rcu.h>
+#include <gr_stb_ds.h>
+#include <gr_vlan.h>
+
+#include <event2/event.h>
+#include <rte_cycles.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_hash.h>
+#include <rte_malloc.h>
+#include <rte_ring.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define L2_LEARN_RING_SIZE 4096
+#define L2_AGEING_TICK_SEC 1
+
+struct l2_learn_req {
+	struct l2_fdb_key key;
+	uint16_t iface_id;
+	uint16_t reserved;
+};
+
+static_assert(sizeof(struct l2_learn_req) % 4 == 0);
+
+static struct rte_hash *fdb_hash;
+static struct rte_ring *learn_ring;
+static struct event *learn_ev;
+static struct event *ageing_timer;
+
+// forwarding database /////////////////////////////////////////////////////////
+
+void l2_fdb_get_bulk(
+	const struct l2_fdb_key *keys,
+	unsigned n,
+	const struct l2_fdb_entry **entries
+) {
+	const void *key_ptrs[L2_LOOKUP_BULK_MAX];
+	void *data[L2_LOOKUP_BULK_MAX];
+	uint64_t hits = 0;
+
+	assert(n <= L2_LOOKUP_BULK_MAX);
+
+	for (unsigned i = 0; i < n; i++)
+		key_ptrs[i] = &keys[i];
+
+	if (n > 0 && rte_hash_lookup_bulk_data(fdb_hash, key_ptrs, n, &hits, data) < 0)
+		hits = 0;
+
+	for (unsigned i = 0; i < n; i++)
+		entries[i] = hits & (UINT64_C(1) << i) ? data[i] : NULL;
+}
+
+static int fdb_insert(const struct l2_fdb_key *key, const struct iface *iface, uint8_t flags) {
+	struct l2_fdb_entry *e;
+	int ret;
+
+	if ((e = rte_zmalloc(__func__, sizeof(*e), 0)) == NULL)
+		return errno_set(ENOMEM);
+	e->iface = iface;
+	e->flags = flags;
+	e->last_seen = rte_get_tsc_cycles();
+
+	if ((ret = rte_hash_add_key_data(fdb_hash, key, e)) < 0) {
+		rte_free(e);
+		return errno_set(-ret);
+	}
+
+	return 0;
+}
+
+// The entry is freed by the hash library once all workers have reported
+// a quiescent state, see fdb_entry_free().
+static void fdb_remove(const struct l2_fdb_key *key) {
+	rte_hash_del_key(fdb_hash, key);
+}
+
+static void fdb_entry_free(void *, void *data) {
+	rte_free(data);
+}
+
+// Remove entries of a bridge. Limit to a member when iface is not NULL. Static
+// entries are only removed if all is true.
+static void fdb_flush(uint16_t bridge_id, const struct iface *iface, bool all) {
+	const struct l2_fdb_entry *e;
+	struct l2_fdb_key *keys = NULL;
+	const struct l2_fdb_key *key;
+	uint32_t iter = 0;
+	void *data;
+
+	while (rte_hash_iterate(fdb_hash, (const void **)&key, &data, &iter) >= 0) {
+		e = data;
+		if (key->bridge_id != bridge_id && bridge_id != GR_IFACE_ID_UNDEF)
+			continue;
+		if (iface != NULL && e->iface != iface)
+			continue;
+		if ((e->flags & GR_L2_FDB_F_STATIC) && !all)
+			continue;
+		arrpush(keys, *key);
+	}
+	arrforeach (key, keys)
+		fdb_remove(key);
+	arrfree(keys);
+}
+
+// Return the bridge member iface_id, NULL if it is not a member of bridge_id.
+static const struct iface *fdb_member(uint16_t bridge_id, uint16_t iface_id) {
+	const struct iface *iface;
+
+	if ((iface = iface_from_id(iface_id)) == NULL)
+		return NULL;
+	if (iface->domain == NULL || iface->domain->id != bridge_id)
+		return errno_set_null(EXDEV);
+
+	return iface;
+}
+
+int l2_fdb_learn(uint16_t bridge_id, const struct rte_ether_addr *mac, uint16_t iface_id) {
+	struct l2_learn_req req = {.key = {*mac, bridge_id}, .iface_id = iface_id};
+	int ret = 0;
+
+	if (rte_ring_enqueue_elem(learn_ring, &req, sizeof(req)) < 0)
+		ret = errno_set(ENOBUFS);
+	// Defer the table update to the event loop running in the main lcore.
+	event_active(learn_ev, 0, 0);
+	return ret;
+}
+
+static void learn_cb(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	struct l2_learn_req reqs[64];
+	const struct iface *iface;
+	struct l2_fdb_entry *e;
+	void *data;
+	unsigned n;
+
+	n = rte_ring_dequeue_burst_elem(learn_ring, reqs, sizeof(*reqs), ARRAY_DIM(reqs), NULL);
+
+	for (unsigned i = 0; i < n; i++) {
+		// the member may have left the bridge in the meantime
+		if ((iface = fdb_member(reqs[i].key.bridge_id, reqs[i].iface_id)) == NULL)
+			continue;
+		if (rte_hash_lookup_data(fdb_hash, &reqs[i].key, &data) < 0) {
+			if (fdb_insert(&reqs[i].key, iface, 0) < 0)
+				LOG(WARNING,
+				    "%s: cannot learn " ETH_ADDR_FMT ": %s",
+				    iface->name,
+				    ETH_ADDR_SPLIT(&reqs[i].key.mac),
+				    strerror(errno));
+			continue;
+		}
+		e = data;
+		if (e->flags & GR_L2_FDB_F_STATIC)
+			continue;
+		// the address moved to another member
+		if (e->iface != iface)
+			__atomic_store_n(&e->iface, iface, __ATOMIC_RELEASE);
+		e->last_seen = rte_get_tsc_cycles();
+	}
+
+	if (!rte_ring_empty(learn_ring))
+		event_active(learn_ev, 0, 0);
+}
+
+static uint16_t bridge_ageing_time(uint16_t bridge_id) {
+	const struct iface_info_bridge *br;
+	const struct iface *iface;
+
+	if ((iface = iface_from_id(bridge_id)) == NULL || iface->type_id != GR_IFACE_TYPE_BRIDGE)
+		return 0;
+	br = (const struct iface_info_bridge *)iface->info;
+
+	return br->ageing_time;
+}
+
+static void ageing_cb(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	uint64_t now = rte_get_tsc_cycles();
+	uint64_t hz = rte_get_tsc_hz();
+	const struct l2_fdb_entry *e;
+	struct l2_fdb_key *keys = NULL;
+	const struct l2_fdb_key *key;
+	uint32_t iter = 0;
+	void *data;
+
+	while (rte_hash_iterate(fdb_hash, (const void **)&key, &data, &iter) >= 0) {
+		e = data;
+		if (e->flags & GR_L2_FDB_F_STATIC)
+			continue;
+		if (now - e->last_seen > bridge_ageing_time(key->bridge_id) * hz)
+			arrpush(keys, *key);
+	}
+	arrforeach (key, keys)
+		fdb_remove(key);
+	arrfree(keys);
+}
+
+// bridge interfaces ///////////////////////////////////////////////////////////
+
+// Number of bridge members using each port. Bridged frames are not addressed
+// to the port address, promiscuous mode is enabled as long as it is non-zero.
+static uint16_t promisc_refs[RTE_MAX_ETHPORTS];
+
+static unsigned member_ports(const struct iface *member, uint16_t *port_ids) {
+	const struct iface_info_bond *bond;
+	const struct iface_info_vlan *vlan;
+	const struct iface_info_port *port;
+	unsigned n = 0;
+
+	switch (member->type_id) {
+	case GR_IFACE_TYPE_PORT:
+		port = (const struct iface_info_port *)member->info;
+		port_ids[n++] = port->port_id;
+		break;
+	case GR_IFACE_TYPE_VLAN:
+		vlan = (const struct iface_info_vlan *)member->info;
+		port = (const struct iface_info_port *)vlan->parent->info;
+		port_ids[n++] = port->port_id;
+		break;
+	case GR_IFACE_TYPE_BOND:
+		bond = (const struct iface_info_bond *)member->info;
+		for (unsigned i = 0; i < bond->n_members; i++)
+			port_ids[n++] = bond->members[i].port_id;
+		break;
+	}
+
+	return n;
+}
+
+static void member_promisc(const struct iface *member, bool enable) {
+	uint16_t port_ids[GR_BOND_MAX_MEMBERS];
+	const struct iface *port;
+	unsigned n;
+	int ret;
+
+	n = member_ports(member, port_ids);
+	for (unsigned i = 0; i < n; i++) {
+		if (enable) {
+			if (promisc_refs[port_ids[i]]++ > 0)
+				continue;
+			ret = rte_eth_promiscuous_enable(port_ids[i]);
+		} else {
+			if (promisc_refs[port_ids[i]] == 0 || --promisc_refs[port_ids[i]] > 0)
+				continue;
+			// leave it enabled if requested on the port itself
+			port = port_get_iface(port_ids[i]);
+			if (port != NULL && port->flags & GR_IFACE_F_PROMISC)
+				continue;
+			ret = rte_eth_promiscuous_disable(port_ids[i]);
+		}
+		if (ret < 0)
+			errno_log(-ret, "rte_eth_promiscuous_{en,dis}able");
+	}
+}
+
+static int bridge_get_members(
+	const struct iface *iface,
+	const struct gr_iface_info_bridge *api,
+	struct iface **members
+) {
+	if (api->n_members > GR_BRIDGE_MAX_MEMBERS)
+		return errno_set(ERANGE);
+
+	for (unsigned i = 0; i < api->n_members; i++) {
+		if ((members[i] = iface_from_id(api->member_ids[i])) == NULL)
+			return -errno;
+		switch (members[i]->type_id) {
+		case GR_IFACE_TYPE_PORT:
+		case GR_IFACE_TYPE_VLAN:
+		case GR_IFACE_TYPE_BOND:
+			break;
+		default:
+			return errno_set(EMEDIUMTYPE);
+		}
+		if (members[i]->domain != NULL && members[i]->domain != iface)
+			return errno_set(EBUSY);
+		for (unsigned j = 0; j < i; j++) {
+			if (members[j] == members[i])
+				return errno_set(EEXIST);
+		}
+	}
+
+	return 0;
+}
+
+static void bridge_member_attach(struct iface *iface, struct iface *member) {
+	struct iface_info_bridge *br = (struct iface_info_bridge *)iface->info;
+
+	member_promisc(member, true);
+	iface_add_subinterface(member, iface);
+	__atomic_store_n(&br->members[br->n_members], member, __ATOMIC_RELAXED);
+	__atomic_store_n(&br->n_members, br->n_members + 1, __ATOMIC_RELEASE);
+	// from now on, frames received on the member are switched by the bridge
+	__atomic_store_n(&member->domain, iface, __ATOMIC_RELEASE);
+}
+
+static void bridge_member_detach(struct iface *iface, unsigned index) {
+	struct iface_info_bridge *br = (struct iface_info_bridge *)iface->info;
+	struct iface *member = iface_from_id(br->members[index]->id);
+	uint16_t last = br->n_members - 1;
+
+	__atomic_store_n(&member->domain, NULL, __ATOMIC_RELEASE);
+	__atomic_store_n(&br->members[index], br->members[last], __ATOMIC_RELAXED);
+	__atomic_store_n(&br->n_members, last, __ATOMIC_RELEASE);
+	iface_del_subinterface(member, iface);
+	member_promisc(member, false);
+	fdb_flush(iface->id, member, true);
+}
+
+static bool bridge_has_member(const struct iface *member, struct iface **members, unsigned n) {
+	for (unsigned i = 0; i < n; i++) {
+		if (members[i] == member)
+			return true;
+	}
+	return false;
+}
+
+static int iface_bridge_reconfig(
+	struct iface *iface,
+	uint64_t set_attrs,
+	uint16_t flags,
+	uint16_t mtu,
+	uint16_t vrf_id,
+	const void *api_info
+) {
+	struct iface_info_bridge *br = (struct iface_info_bridge *)iface->info;
+	const struct gr_iface_info_bridge *api = api_info;
+	struct iface *members[GR_BRIDGE_MAX_MEMBERS];
+
+	if (set_attrs & GR_BRIDGE_SET_MEMBERS) {
+		if (bridge_get_members(iface, api, members) < 0)
+			return -errno;
+		// Only touch the members that change, frames keep flowing
+		// between the others.
+		for (unsigned i = br->n_members; i > 0; i--) {
+			if (!bridge_has_member(br->members[i - 1], members, api->n_members))
+				bridge_member_detach(iface, i - 1);
+		}
+		for (unsigned i = 0; i < api->n_members; i++) {
+			if (members[i]->domain == NULL)
+				bridge_member_attach(iface, members[i]);
+		}
+	}
+
+	if (set_attrs & GR_BRIDGE_SET_AGEING) {
+		if (api->ageing_time == 0)
+			br->ageing_time = GR_BRIDGE_AGEING_DEFAULT;
+		else
+			br->ageing_time = api->ageing_time;
+	}
+
+	if (set_attrs & GR_BRIDGE_SET_MAC) {
+		if (rte_is_zero_ether_addr(&api->mac))
+			rte_eth_random_addr(br->mac.addr_bytes);
+		else if (rte_is_unicast_ether_addr(&api->mac))
+			br->mac = api->mac;
+		else
+			return errno_set(EINVAL);
+	}
+
+	if (set_attrs & GR_IFACE_SET_FLAGS)
+		iface->flags = flags;
+	if (set_attrs & GR_IFACE_SET_MTU)
+		iface->mtu = mtu;
+	if (set_attrs & GR_IFACE_SET_VRF)
+		iface->vrf_id = vrf_id;
+
+	return 0;
+}
+
+static int iface_bridge_fini(struct iface *iface) {
+	struct iface_info_bridge *br = (struct iface_info_bridge *)iface->info;
+
+	while (br->n_members > 0)
+		bridge_member_detach(iface, br->n_members - 1);
+	fdb_flush(iface->id, NULL, true);
+
+	return 0;
+}
+
+static int iface_bridge_init(struct iface *iface, const void *api_info) {
+	int ret;
+
+	ret = iface_bridge_reconfig(
+		iface, IFACE_SET_ALL, iface->flags, iface->mtu, iface->vrf_id, api_info
+	);
+	if (ret < 0) {
+		iface_bridge_fini(iface);
+		errno = -ret;
+	}
+
+	return ret;
+}
+
+static int iface_bridge_get_eth_addr(const struct iface *iface, struct rte_ether_addr *mac) {
+	const struct iface_info_bridge *br = (const struct iface_info_bridge *)iface->info;
+	*mac = br->mac;
+	return 0;
+}
+
+static void bridge_to_api(void *info, const struct iface *iface) {
+	const struct iface_info_bridge *br = (const struct iface_info_bridge *)iface->info;
+	struct gr_iface_info_bridge *api = info;
+
+	api->ageing_time = br->ageing_time;
+	api->mac = br->mac;
+	api->n_members = br->n_members;
+	for (unsigned i = 0; i < br->n_members; i++)
+		api->member_ids[i] = br->members[i]->id;
+}
+
+static struct iface_type iface_type_bridge = {
+	.id = GR_IFACE_TYPE_BRIDGE,
+	.name = "bridge",
+	.info_size = sizeof(struct iface_info_bridge),
+	.init = iface_bridge_init,
+	.reconfig = iface_bridge_reconfig,
+	.fini = iface_bridge_fini,
+	.get_eth_addr = iface_bridge_get_eth_addr,
+	.to_api = bridge_to_api,
+};
+
+// Port reconfiguration may reset promiscuous mode.
+static void l2_iface_event_handler(iface_event_t event, struct iface *iface) {
+	const struct iface_info_port *port;
+
+	if (event != IFACE_EVENT_PORT_POST_RECONFIG || iface->type_id != GR_IFACE_TYPE_PORT)
+		return;
+	port = (const struct iface_info_port *)iface->info;
+	if (promisc_refs[port->port_id] > 0 && rte_eth_promiscuous_enable(port->port_id) < 0)
+		LOG(WARNING, "%s: cannot enable promiscuous mode", iface->name);
+}
+
+// API handlers ////////////////////////////////////////////////////////////////
+
+static struct api_out fdb_add_cb(const void *request, void ** /*response*/) {
+	const struct gr_l2_fdb_add_req *req = request;
+	struct l2_fdb_key key = {req->entry.mac, req->entry.bridge_id};
+	const struct iface *iface;
+	struct l2_fdb_entry *e;
+	void *data;
+
+	if (!rte_is_unicast_ether_addr(&req->entry.mac) || rte_is_zero_ether_addr(&req->entry.mac))
+		return api_out(EINVAL, 0);
+	if ((iface = fdb_member(req->entry.bridge_id, req->entry.iface_id)) == NULL)
+		return api_out(errno, 0);
+
+	if (rte_hash_lookup_data(fdb_hash, &key, &data) >= 0) {
+		e = data;
+		if (!(e->flags & GR_L2_FDB_F_STATIC)) {
+			// a configured entry overrides a learned one
+			__atomic_store_n(&e->iface, iface, __ATOMIC_RELEASE);
+			e->flags |= GR_L2_FDB_F_STATIC;
+			return api_out(0, 0);
+		}
+		if (req->exist_ok && e->iface == iface)
+			return api_out(0, 0);
+		return api_out(EEXIST, 0);
+	}
+
+	if (fdb_insert(&key, iface, GR_L2_FDB_F_STATIC) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out fdb_del_cb(const void *request, void ** /*response*/) {
+	const struct gr_l2_fdb_del_req *req = request;
+	struct l2_fdb_key key = {req->mac, req->bridge_id};
+
+	if (rte_hash_lookup(fdb_hash, &key) < 0) {
+		if (req->missing_ok)
+			return api_out(0, 0);
+		return api_out(ENOENT, 0);
+	}
+	fdb_remove(&key);
+
+	return api_out(0, 0);
+}
+
+static struct api_out fdb_list_cb(const void *request, void **response) {
+	const struct gr_l2_fdb_list_req *req = request;
+	uint64_t now = rte_get_tsc_cycles();
+	uint64_t hz = rte_get_tsc_hz();
+	struct gr_l2_fdb_list_resp *resp;
+	const struct l2_fdb_entry *e;
+	const struct l2_fdb_key *key;
+	struct gr_l2_fdb_entry *api;
+	uint32_t iter;
+	size_t len, n;
+	void *data;
+
+	n = 0;
+	iter = 0;
+	while (rte_hash_iterate(fdb_hash, (const void **)&key, &data, &iter) >= 0) {
+		if (key->bridge_id == req->bridge_id || req->bridge_id == GR_IFACE_ID_UNDEF)
+			n++;
+	}
+
+	len = sizeof(*resp) + n * sizeof(*resp->entries);
+	if (len > GR_API_MAX_MSG_LEN)
+		return api_out(EMSGSIZE, 0);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	iter = 0;
+	while (rte_hash_iterate(fdb_hash, (const void **)&key, &data, &iter) >= 0) {
+		if (key->bridge_id != req->bridge_id && req->bridge_id != GR_IFACE_ID_UNDEF)
+			continue;
+		if (resp->n_entries == n)
+			break;
+		e = data;
+		api = &resp->entries[resp->n_entries++];
+		api->bridge_id = key->bridge_id;
+		api->mac = key->mac;
+		api->iface_id = e->iface->id;
+		api->flags = e->flags;
+		if (!(e->flags & GR_L2_FDB_F_STATIC))
+			api->age = (now - e->last_seen) / hz;
+	}
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+static struct api_out fdb_flush_cb(const void *request, void ** /*response*/) {
+	const struct gr_l2_fdb_flush_req *req = request;
+	const struct iface *iface = NULL;
+
+	if (req->iface_id != GR_IFACE_ID_UNDEF) {
+		if ((iface = fdb_member(req->bridge_id, req->iface_id)) == NULL)
+			return api_out(errno, 0);
+	}
+	fdb_flush(req->bridge_id, iface, req->all);
+
+	return api_out(0, 0);
+}
+
+// module //////////////////////////////////////////////////////////////////////
+
+static void l2_init(struct event_base *ev_base) {
+	struct timeval tv = {.tv_sec = L2_AGEING_TICK_SEC};
+	struct rte_hash_parameters params = {
+		.name = "l2_fdb",
+		.entries = L2_FDB_SIZE,
+		.key_len = sizeof(struct l2_fdb_key),
+		.socket_id = SOCKET_ID_ANY,
+		.extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF
+			| RTE_HASH_EXTRA_FLAGS_TRANS_MEM_SUPPORT,
+	};
+	// With lock-free readers, deleted keys slots and entries can only be
+	// reused after all workers have reported a quiescent state. Learned
+	// entries come and go, let the hash library reclaim them.
+	struct rte_hash_rcu_config rcu = {
+		.v = gr_datapath_rcu(),
+		.mode = RTE_HASH_QSBR_MODE_DQ,
+		.free_key_data_func = fdb_entry_free,
+	};
+
+	fdb_hash = rte_hash_create(&params);
+	if (fdb_hash == NULL)
+		ABORT("rte_hash_create(l2_fdb)");
+	if (rte_hash_rcu_qsbr_add(fdb_hash, &rcu) < 0)
+		ABORT("rte_hash_rcu_qsbr_add(l2_fdb): %s", rte_strerror(rte_errno));
+
+	learn_ring = rte_ring_create_elem(
+		"l2_learn",
+		sizeof(struct l2_learn_req),
+		L2_LEARN_RING_SIZE,
+		SOCKET_ID_ANY,
+		RING_F_MP_RTS_ENQ | RING_F_SC_DEQ
+	);
+	if (learn_ring == NULL)
+		ABORT("rte_ring_create(l2_learn): %s", rte_strerror(rte_errno));
+
+	learn_ev = gr_event_new(ev_base, -1, EV_FINALIZE, learn_cb, NULL);
+	if (learn_ev == NULL)
+		ABORT("gr_event_new() failed");
+
+	ageing_timer = gr_event_new(ev_base, -1, EV_PERSIST | EV_FINALIZE, ageing_cb, NULL);
+	if (ageing_timer == NULL)
+		ABORT("gr_event_new() failed");
+	if (event_add(ageing_timer, &tv) < 0)
+		ABORT("event_add() failed");
+}
+
+static void l2_fini(struct event_base *) {
+	gr_event_free(ageing_timer);
+	ageing_timer = NULL;
+	gr_event_free(learn_ev);
+	learn_ev = NULL;
+	rte_ring_free(learn_ring);
+	learn_ring = NULL;
+	// entries still in the table are freed with their keys
+	rte_hash_free(fdb_hash);
+	fdb_hash = NULL;
+}
+
+static struct gr_module l2_module = {
+	.name = "l2",
+	.init = l2_init,
+	.fini = l2_fini,
+	.fini_prio = 1000,
+};
+
+static struct gr_api_handler fdb_add_handler = {
+	.name = "l2 fdb add",
+	.request_type = GR_L2_FDB_ADD,
+	.callback = fdb_add_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler fdb_del_handler = {
+	.name = "l2 fdb del",
+	.request_type = GR_L2_FDB_DEL,
+	.callback = fdb_del_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler fdb_list_handler = {
+	.name = "l2 fdb list",
+	.request_type = GR_L2_FDB_LIST,
+	.callback = fdb_list_cb,
+};
+static struct gr_api_handler fdb_flush_handler = {
+	.name = "l2 fdb flush",
+	.request_type = GR_L2_FDB_FLUSH,
+	.callback = fdb_flush_cb,
+};
+
+static struct iface_event_handler l2_iface_event = {
+	.callback = l2_iface_event_handler,
+};
+
+RTE_INIT(l2_constructor) {
+	gr_register_api_handler(&fdb_add_handler);
+	gr_register_api_handler(&fdb_del_handler);
+	gr_register_api_handler(&fdb_list_handler);
+	gr_register_api_handler(&fdb_flush_handler);
+	gr_register_module(&l2_module);
+	iface_type_register(&iface_type_bridge);
+	iface_event_register_handler(&l2_iface_event);
+}
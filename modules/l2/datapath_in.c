@@ -0,0 +1,268 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "l2_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_eth_input.h>
+#include <gr_eth_output.h>
+#include <gr_graph.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+#include <gr_mempool.h>
+
+#include <rte_cycles.h>
+#include <rte_ether.h>
+#include <rte_graph_worker.h>
+#include <rte_hash_crc.h>
+#include <rte_malloc.h>
+
+#include <string.h>
+
+enum {
+	OUTPUT = 0,
+	LOCAL,
+	FILTERED,
+	NO_BRIDGE,
+	NO_MEMBER,
+	EDGE_COUNT,
+};
+
+// Per-worker cache of the recently learned addresses. The control plane is
+// only notified once per BRIDGE_LEARN_REFRESH_SEC for each address, or as soon
+// as an address moves to another member.
+#define BRIDGE_LEARN_CACHE_SIZE 1024 // must be a power of 2
+#define BRIDGE_LEARN_REFRESH_SEC 1
+// Flooded frames are duplicated with indirect mbufs allocated from this pool.
+#define BRIDGE_POOL_SIZE (RTE_GRAPH_BURST_SIZE * 8)
+
+struct bridge_learn_cache {
+	uint64_t key; // struct l2_fdb_key as an integer
+	uint64_t posted; // TSC cycles
+	uint16_t iface_id;
+};
+
+struct bridge_input_ctx {
+	struct rte_mempool *pool;
+	uint64_t refresh; // TSC cycles
+	struct bridge_learn_cache cache[BRIDGE_LEARN_CACHE_SIZE];
+};
+
+static inline void bridge_learn(
+	struct bridge_input_ctx *ctx,
+	uint16_t bridge_id,
+	const struct rte_ether_addr *mac,
+	uint16_t iface_id,
+	uint64_t now
+) {
+	struct l2_fdb_key key = {*mac, bridge_id};
+	struct bridge_learn_cache *c;
+	uint64_t k;
+
+	memcpy(&k, &key, sizeof(k));
+	c = &ctx->cache[rte_hash_crc_8byte(k, 0) & (BRIDGE_LEARN_CACHE_SIZE - 1)];
+	if (c->key == k && c->iface_id == iface_id && now - c->posted < ctx->refresh)
+		return;
+	// retried with the next frame if the queue is full
+	if (l2_fdb_learn(bridge_id, mac, iface_id) < 0)
+		return;
+	c->key = k;
+	c->iface_id = iface_id;
+	c->posted = now;
+}
+
+// Send the frame to every member but the input one. The frame data is shared
+// between all copies with refcounted indirect mbufs. Only the local copy, which
+// may be modified in place by the IP stack, gets its own data.
+static void bridge_flood(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	struct rte_mempool *pool,
+	const struct iface *bridge,
+	const struct iface *input,
+	struct rte_mbuf *m,
+	bool local
+) {
+	const struct iface_info_bridge *br = (const struct iface_info_bridge *)bridge->info;
+	const struct iface *member, *last = NULL;
+	struct rte_mbuf *c;
+	uint16_t n;
+
+	// local delivery is skipped when no mbuf is available
+	if (local && (c = rte_pktmbuf_copy(m, pool, 0, UINT32_MAX)) != NULL) {
+		eth_input_mbuf_data(c)->iface = bridge;
+		rte_node_enqueue_x1(graph, node, LOCAL, c);
+	}
+
+	n = __atomic_load_n(&br->n_members, __ATOMIC_ACQUIRE);
+	for (uint16_t i = 0; i < n; i++) {
+		member = __atomic_load_n(&br->members[i], __ATOMIC_RELAXED);
+		if (member == input)
+			continue;
+		if (last != NULL) {
+			if ((c = rte_pktmbuf_clone(m, pool)) == NULL)
+				break;
+			bridge_output_mbuf_data(c)->iface = last;
+			rte_node_enqueue_x1(graph, node, OUTPUT, c);
+		}
+		last = member;
+	}
+
+	if (last == NULL) {
+		rte_node_enqueue_x1(graph, node, NO_MEMBER, m);
+		return;
+	}
+	bridge_output_mbuf_data(m)->iface = last;
+	rte_node_enqueue_x1(graph, node, OUTPUT, m);
+}
+
+static uint16_t bridge_input_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	const struct iface *bridges[L2_LOOKUP_BULK_MAX];
+	const struct l2_fdb_entry *entries[L2_LOOKUP_BULK_MAX];
+	struct l2_fdb_key keys[L2_LOOKUP_BULK_MAX];
+	struct bridge_input_ctx *ctx = node->ctx_ptr;
+	uint64_t now = rte_get_tsc_cycles();
+	const struct iface_info_bridge *br;
+	const struct rte_ether_addr *src;
+	const struct iface *iface, *dst;
+	const struct iface *bridge;
+	struct rte_ether_hdr *eth;
+	uint16_t i, n, count;
+	struct rte_mbuf *m;
+	rte_edge_t edge;
+	bool local;
+
+	for (n = 0; n < nb_objs; n += count) {
+		count = RTE_MIN(nb_objs - n, L2_LOOKUP_BULK_MAX);
+
+		// First pass: learn the source addresses and collect the
+		// destination addresses.
+		for (i = 0; i < count; i++) {
+			m = objs[n + i];
+			gr_mbuf_prefetch_ahead(objs, n + i, nb_objs);
+			eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+			// eth_output_mbuf_data->iface is the bridge itself for
+			// locally originated frames
+			iface = eth_input_mbuf_data(m)->iface;
+			if (iface->type_id == GR_IFACE_TYPE_BRIDGE) {
+				bridge = iface;
+			} else {
+				bridge = __atomic_load_n(&iface->domain, __ATOMIC_ACQUIRE);
+				src = &eth->src_addr;
+				if (bridge != NULL && rte_is_valid_assigned_ether_addr(src))
+					bridge_learn(ctx, bridge->id, src, iface->id, now);
+			}
+			bridges[i] = bridge;
+			keys[i].mac = eth->dst_addr;
+			keys[i].bridge_id = bridge != NULL ? bridge->id : GR_IFACE_ID_UNDEF;
+		}
+
+		l2_fdb_get_bulk(keys, count, entries);
+
+		// Second pass: forward, flood or deliver locally.
+		for (i = 0; i < count; i++) {
+			m = objs[n + i];
+			bridge = bridges[i];
+			if (bridge == NULL) {
+				// the member left the bridge in the meantime
+				edge = NO_BRIDGE;
+				goto next;
+			}
+			br = (const struct iface_info_bridge *)bridge->info;
+			iface = eth_input_mbuf_data(m)->iface;
+
+			if (rte_is_multicast_ether_addr(&keys[i].mac)) {
+				local = iface != bridge;
+				bridge_flood(graph, node, ctx->pool, bridge, iface, m, local);
+				continue;
+			}
+			if (rte_is_same_ether_addr(&keys[i].mac, &br->mac)) {
+				// locally originated frames cannot loop back
+				edge = iface != bridge ? LOCAL : FILTERED;
+				eth_input_mbuf_data(m)->iface = bridge;
+				goto next;
+			}
+			if (entries[i] == NULL) {
+				// unknown unicast
+				bridge_flood(graph, node, ctx->pool, bridge, iface, m, false);
+				continue;
+			}
+			dst = __atomic_load_n(&entries[i]->iface, __ATOMIC_ACQUIRE);
+			if (dst == iface) {
+				edge = FILTERED;
+				goto next;
+			}
+			bridge_output_mbuf_data(m)->iface = dst;
+			edge = OUTPUT;
+next:
+			rte_node_enqueue_x1(graph, node, edge, m);
+		}
+	}
+
+	return nb_objs;
+}
+
+static int bridge_input_init(const struct rte_graph *graph, struct rte_node *node) {
+	struct bridge_input_ctx *ctx;
+
+	ctx = rte_zmalloc_socket(__func__, sizeof(*ctx), RTE_CACHE_LINE_SIZE, graph->socket);
+	if (ctx == NULL)
+		return errno_log(ENOMEM, "rte_zmalloc_socket(bridge_input)");
+
+	ctx->pool = gr_pktmbuf_pool_get(graph->socket, BRIDGE_POOL_SIZE);
+	if (ctx->pool == NULL) {
+		rte_free(ctx);
+		return errno_log(errno, "gr_pktmbuf_pool_get(bridge_input)");
+	}
+	ctx->refresh = BRIDGE_LEARN_REFRESH_SEC * rte_get_tsc_hz();
+	node->ctx_ptr = ctx;
+
+	return 0;
+}
+
+static void bridge_input_fini(const struct rte_graph *, struct rte_node *node) {
+	struct bridge_input_ctx *ctx = node->ctx_ptr;
+
+	gr_pktmbuf_pool_release(ctx->pool, BRIDGE_POOL_SIZE);
+	rte_free(ctx);
+	node->ctx_ptr = NULL;
+}
+
+static void bridge_input_register(void) {
+	gr_eth_input_add_domain(GR_IFACE_TYPE_BRIDGE, "bridge_input");
+	// frames sent on the bridge interface itself
+	eth_output_add_tunnel(GR_IFACE_TYPE_BRIDGE, "bridge_input");
+}
+
+static struct rte_node_register bridge_input_node = {
+	.name = "bridge_input",
+
+	.process = bridge_input_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[OUTPUT] = "bridge_output",
+		[LOCAL] = "eth_input",
+		[FILTERED] = "bridge_input_filtered",
+		[NO_BRIDGE] = "bridge_input_no_bridge",
+		[NO_MEMBER] = "bridge_input_no_member",
+	},
+	.init = bridge_input_init,
+	.fini = bridge_input_fini,
+};
+
+static struct gr_node_info bridge_input_info = {
+	.node = &bridge_input_node,
+	.register_callback = bridge_input_register,
+};
+
+GR_NODE_REGISTER(bridge_input_info);
+
+GR_DROP_REGISTER(bridge_input_filtered);
+GR_DROP_REGISTER(bridge_input_no_bridge);
+GR_DROP_REGISTER(bridge_input_no_member);
@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "l2_priv.h"
+
+#include <gr_bond.h>
+#include <gr_datapath.h>
+#include <gr_graph.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+#include <gr_mempool.h>
+#include <gr_port.h>
+#include <gr_vlan.h>
+
+#include <rte_ether.h>
+#include <rte_graph_worker.h>
+#include <rte_mbuf.h>
+
+enum {
+	TX = 0,
+	GSO,
+	INVAL,
+	NO_MEMBER,
+	NO_HEADROOM,
+	NO_MBUF,
+	EDGE_COUNT,
+};
+
+// Frames are sent as is on the member ports. Only VLAN members need data to be
+// modified when the tag cannot be inserted by hardware.
+static uint16_t bridge_output_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	struct iface_stats_batch stats = {.tx = true};
+	struct rte_mempool *pool = node->ctx_ptr;
+	const struct iface_info_bond *bond;
+	const struct iface_info_port *port;
+	const struct iface_info_vlan *vlan;
+	const struct iface *member;
+	struct rte_mbuf *m, *c;
+	rte_edge_t edge;
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		m = objs[i];
+		gr_mbuf_prefetch_ahead(objs, i, nb_objs);
+		member = bridge_output_mbuf_data(m)->iface;
+
+		switch (member->type_id) {
+		case GR_IFACE_TYPE_PORT:
+			port = (const struct iface_info_port *)member->info;
+			m->port = port->port_id;
+			break;
+		case GR_IFACE_TYPE_VLAN:
+			vlan = (const struct iface_info_vlan *)member->info;
+			port = (const struct iface_info_port *)vlan->parent->info;
+			m->port = port->port_id;
+			m->vlan_tci = vlan->vlan_id;
+			if (port->tx_offloads & RTE_ETH_TX_OFFLOAD_VLAN_INSERT) {
+				m->ol_flags |= RTE_MBUF_F_TX_VLAN;
+				break;
+			}
+			if (!RTE_MBUF_DIRECT(m) || rte_mbuf_refcnt_read(m) > 1) {
+				// The frame data is shared with other flooded copies
+				// and cannot be modified in place.
+				if ((c = rte_pktmbuf_copy(m, pool, 0, UINT32_MAX)) == NULL) {
+					edge = NO_MBUF;
+					goto next;
+				}
+				rte_pktmbuf_free(m);
+				m = c;
+			}
+			if (rte_vlan_insert(&m) < 0) {
+				edge = NO_HEADROOM;
+				goto next;
+			}
+			break;
+		case GR_IFACE_TYPE_BOND:
+			bond = (const struct iface_info_bond *)member->info;
+			m->port = bond_tx_port(bond, m->hash.rss);
+			if (unlikely(m->port == RTE_MAX_ETHPORTS)) {
+				edge = NO_MEMBER;
+				goto next;
+			}
+			break;
+		default:
+			edge = INVAL;
+			goto next;
+		}
+
+		if (unlikely(packet_trace_enabled))
+			trace_packet(node, member->id, m);
+		iface_stats_add(&stats, member->id, rte_pktmbuf_pkt_len(m));
+		// only for locally originated frames, see eth_output
+		if (unlikely(m->ol_flags & RTE_MBUF_F_TX_TCP_SEG))
+			edge = GSO;
+		else
+			edge = TX;
+next:
+		rte_node_enqueue_x1(graph, node, edge, m);
+	}
+	iface_stats_flush(&stats);
+
+	return nb_objs;
+}
+
+static int bridge_output_init(const struct rte_graph *graph, struct rte_node *node) {
+	node->ctx_ptr = gr_pktmbuf_pool_get(graph->socket, RTE_GRAPH_BURST_SIZE);
+
+	if (node->ctx_ptr == NULL)
+		return errno_log(errno, "gr_pktmbuf_pool_get(bridge_output)");
+
+	return 0;
+}
+
+static void bridge_output_fini(const struct rte_graph *, struct rte_node *node) {
+	gr_pktmbuf_pool_release(node->ctx_ptr, RTE_GRAPH_BURST_SIZE);
+	node->ctx_ptr = NULL;
+}
+
+static struct rte_node_register bridge_output_node = {
+	.name = "bridge_output",
+
+	.process = bridge_output_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[TX] = "port_tx",
+		[GSO] = "port_gso",
+		[INVAL] = "bridge_output_inval",
+		[NO_MEMBER] = "bridge_output_no_member",
+		[NO_HEADROOM] = "error_no_headroom",
+		[NO_MBUF] = "bridge_output_no_mbuf",
+	},
+	.init = bridge_output_init,
+	.fini = bridge_output_fini,
+};
+
+static struct gr_node_info bridge_output_info = {
+	.node = &bridge_output_node,
+};
+
+GR_NODE_REGISTER(bridge_output_info);
+
+GR_DROP_REGISTER(bridge_output_inval);
+GR_DROP_REGISTER(bridge_output_no_member);
+GR_DROP_REGISTER(bridge_output_no_mbuf);
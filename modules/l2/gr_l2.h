@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_API_L2
+#define _GR_API_L2
+
+#include <gr_api.h>
+#include <gr_bitops.h>
+#include <gr_infra.h>
+#include <gr_macro.h>
+#include <gr_net_types.h>
+
+#include <stdint.h>
+
+// Bridge domains. Frames received on member interfaces are switched between
+// them based on their destination address. Frames sent to the bridge address
+// are processed locally, on the bridge interface.
+#define GR_IFACE_TYPE_BRIDGE 0x0009
+
+#define GR_BRIDGE_MAX_MEMBERS 64
+#define GR_BRIDGE_AGEING_DEFAULT 300 // seconds
+
+// Bridge reconfig attributes
+#define GR_BRIDGE_SET_MEMBERS GR_BIT64(32)
+#define GR_BRIDGE_SET_AGEING GR_BIT64(33)
+#define GR_BRIDGE_SET_MAC GR_BIT64(34)
+
+// Info for GR_IFACE_TYPE_BRIDGE interfaces
+struct gr_iface_info_bridge {
+	uint16_t ageing_time; // learned entries lifetime in seconds, 0 for the default
+	struct rte_ether_addr mac; // random if unset
+	uint16_t n_members;
+	// GR_IFACE_TYPE_PORT, GR_IFACE_TYPE_VLAN or GR_IFACE_TYPE_BOND interfaces
+	uint16_t member_ids[GR_BRIDGE_MAX_MEMBERS];
+};
+
+static_assert(sizeof(struct gr_iface_info_bridge) <= MEMBER_SIZE(struct gr_iface, info));
+
+#define GR_L2_MODULE 0xb12d
+
+// forwarding database /////////////////////////////////////////////////////////
+
+#define GR_L2_FDB_F_STATIC GR_BIT8(0) // configured, never aged out
+
+struct gr_l2_fdb_entry {
+	uint16_t bridge_id;
+	struct rte_ether_addr mac;
+	uint16_t iface_id; // bridge member
+	uint8_t flags; // GR_L2_FDB_F_*
+	uint32_t age; // seconds since the address was last seen, 0 for static entries
+};
+
+#define GR_L2_FDB_ADD REQUEST_TYPE(GR_L2_MODULE, 0x0001)
+
+struct gr_l2_fdb_add_req {
+	struct gr_l2_fdb_entry entry; // flags and age are ignored, entries are static
+	uint8_t exist_ok;
+};
+
+// struct gr_l2_fdb_add_resp { };
+
+#define GR_L2_FDB_DEL REQUEST_TYPE(GR_L2_MODULE, 0x0002)
+
+struct gr_l2_fdb_del_req {
+	uint16_t bridge_id;
+	struct rte_ether_addr mac;
+	uint8_t missing_ok;
+};
+
+// struct gr_l2_fdb_del_resp { };
+
+#define GR_L2_FDB_LIST REQUEST_TYPE(GR_L2_MODULE, 0x0003)
+
+struct gr_l2_fdb_list_req {
+	uint16_t bridge_id; // GR_IFACE_ID_UNDEF for all
+};
+
+struct gr_l2_fdb_list_resp {
+	uint16_t n_entries;
+	struct gr_l2_fdb_entry entries[/* n_entries */];
+};
+
+#define GR_L2_FDB_FLUSH REQUEST_TYPE(GR_L2_MODULE, 0x0004)
+
+struct gr_l2_fdb_flush_req {
+	uint16_t bridge_id;
+	uint16_t iface_id; // GR_IFACE_ID_UNDEF for all members
+	uint8_t all; // also flush static entries
+};
+
+// struct gr_l2_fdb_flush_resp { };
+
+#endif
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _L2_PRIV_H
+#define _L2_PRIV_H
+
+#include <gr_iface.h>
+#include <gr_l2.h>
+#include <gr_mbuf.h>
+
+#include <rte_ether.h>
+#include <rte_hash.h>
+
+#include <stdint.h>
+
+struct __rte_aligned(alignof(void *)) iface_info_bridge {
+	uint16_t ageing_time;
+	struct rte_ether_addr mac;
+	// Flooding list read by the datapath. Members are removed by moving the
+	// last one in their slot, a removed member may get a few extra frames.
+	uint16_t n_members;
+	const struct iface *members[GR_BRIDGE_MAX_MEMBERS];
+};
+
+struct l2_fdb_key {
+	struct rte_ether_addr mac;
+	uint16_t bridge_id;
+};
+
+static_assert(sizeof(struct l2_fdb_key) == 8);
+
+struct l2_fdb_entry {
+	// bridge member, updated in place when the address moves
+	const struct iface *iface;
+	uint8_t flags; // GR_L2_FDB_F_*
+	uint64_t last_seen; // TSC cycles
+};
+
+#define L2_FDB_SIZE (1 << 16)
+#define L2_LOOKUP_BULK_MAX RTE_HASH_LOOKUP_BULK_MAX
+
+// Lookup up to L2_LOOKUP_BULK_MAX addresses at once. Unknown ones are NULL.
+void l2_fdb_get_bulk(
+	const struct l2_fdb_key *keys,
+	unsigned n,
+	const struct l2_fdb_entry **entries
+);
+
+// Ask the control plane to learn that mac is reachable via iface_id. Called
+// from datapath threads, requests are dropped when the queue is full.
+int l2_fdb_learn(uint16_t bridge_id, const struct rte_ether_addr *mac, uint16_t iface_id);
+
+GR_MBUF_PRIV_DATA_TYPE(bridge_output_mbuf_data, { const struct iface *iface; });
+
+#endif
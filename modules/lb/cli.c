@@ -0,0 +1,230 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_lb.h>
+#include <gr_net_types.h>
+#include <gr_table.h>
+
+#include <ecoli.h>
+#include <libsmartcols.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int parse_proto(const struct ec_pnode *p, uint8_t *proto) {
+	const char *str = arg_str(p, "PROTO");
+
+	if (str == NULL)
+		return -errno;
+	if (strcmp(str, "tcp") == 0)
+		*proto = IPPROTO_TCP;
+	else
+		*proto = IPPROTO_UDP;
+
+	return 0;
+}
+
+static cmd_status_t service_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_lb_service_add_req req = {.exist_ok = true};
+	struct gr_lb_service *s = &req.service;
+	const char *encap = arg_str(p, "ENCAP");
+	const struct ec_pnode *n;
+
+	if (inet_pton(AF_INET, arg_str(p, "VIP"), &s->vip) != 1) {
+		errno = EINVAL;
+		return CMD_ERROR;
+	}
+	if (parse_proto(p, &s->proto) < 0)
+		return CMD_ERROR;
+	if (arg_u16(p, "PORT", &s->port) < 0)
+		return CMD_ERROR;
+	if (inet_pton(AF_INET, arg_str(p, "SRC"), &s->src) != 1) {
+		errno = EINVAL;
+		return CMD_ERROR;
+	}
+	for (n = ec_pnode_find(p, "BACKEND"); n != NULL;
+	     n = ec_pnode_find_next(p, n, "BACKEND", false)) {
+		const struct ec_strvec *v = ec_pnode_get_strvec(n);
+		if (s->n_backends == GR_LB_MAX_BACKENDS) {
+			errno = ERANGE;
+			return CMD_ERROR;
+		}
+		if (inet_pton(AF_INET, ec_strvec_val(v, 0), &s->backends[s->n_backends++]) != 1) {
+			errno = EINVAL;
+			return CMD_ERROR;
+		}
+	}
+	if (encap != NULL && strcmp(encap, "gue") == 0)
+		s->encap = GR_LB_ENCAP_GUE;
+	else
+		s->encap = GR_LB_ENCAP_IPIP;
+	if (arg_u16(p, "GUE_PORT", &s->gue_port) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u32(p, "SIZE", &s->table_size) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u16(p, "VRF", &s->vrf_id) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_LB_SERVICE_ADD, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t service_del(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_lb_service_del_req req = {.missing_ok = true};
+
+	if (inet_pton(AF_INET, arg_str(p, "VIP"), &req.vip) != 1) {
+		errno = EINVAL;
+		return CMD_ERROR;
+	}
+	if (parse_proto(p, &req.proto) < 0)
+		return CMD_ERROR;
+	if (arg_u16(p, "PORT", &req.port) < 0)
+		return CMD_ERROR;
+	if (arg_u16(p, "VRF", &req.vrf_id) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_LB_SERVICE_DEL, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t service_list(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct libscols_table *table = scols_new_table();
+	struct gr_lb_service_list_req req = {.vrf_id = UINT16_MAX};
+	const struct gr_lb_service_list_resp *resp;
+	void *resp_ptr = NULL;
+	char buf[BUFSIZ];
+	size_t len;
+
+	if (table == NULL)
+		return CMD_ERROR;
+	if (arg_u16(p, "VRF", &req.vrf_id) < 0 && errno != ENOENT) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+	if (gr_api_client_send_recv(c, GR_LB_SERVICE_LIST, sizeof(req), &req, &resp_ptr) < 0) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+
+	resp = resp_ptr;
+
+	scols_table_new_column(table, "VRF", 0, 0);
+	scols_table_new_column(table, "SERVICE", 0, 0);
+	scols_table_new_column(table, "SRC", 0, 0);
+	scols_table_new_column(table, "ENCAP", 0, 0);
+	scols_table_new_column(table, "TABLE", 0, 0);
+	scols_table_new_column(table, "BACKENDS", 0, 0);
+	scols_table_set_column_separator(table, "  ");
+
+	for (size_t i = 0; i < resp->n_services; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_lb_service *s = &resp->services[i];
+
+		scols_line_sprintf(line, 0, "%u", s->vrf_id);
+		scols_line_sprintf(
+			line,
+			1,
+			"%s " IP4_ADDR_FMT ":%u",
+			s->proto == IPPROTO_TCP ? "tcp" : "udp",
+			IP4_ADDR_SPLIT(&s->vip),
+			s->port
+		);
+		scols_line_sprintf(line, 2, IP4_ADDR_FMT, IP4_ADDR_SPLIT(&s->src));
+		if (s->encap == GR_LB_ENCAP_GUE)
+			scols_line_sprintf(line, 3, "gue:%u", s->gue_port);
+		else
+			scols_line_set_data(line, 3, "ipip");
+		scols_line_sprintf(line, 4, "%u", s->table_size);
+		buf[0] = '\0';
+		len = 0;
+		for (uint16_t b = 0; b < s->n_backends; b++) {
+			len += snprintf(
+				buf + len,
+				sizeof(buf) - len,
+				"%s" IP4_ADDR_FMT,
+				b > 0 ? "," : "",
+				IP4_ADDR_SPLIT(&s->backends[b])
+			);
+		}
+		scols_line_set_data(line, 5, buf);
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+#define SERVICE_ARGS                                                                               \
+	with_help("Virtual IPv4 address of the service.", ec_node_re("VIP", IPV4_RE)),             \
+		with_help("L4 protocol.", ec_node_re("PROTO", "tcp|udp")),                         \
+		with_help("Destination port.", ec_node_uint("PORT", 1, UINT16_MAX, 10)),           \
+		with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10))
+
+#define LB_CTX(root, ctx, help) CLI_CONTEXT(root, ctx, CTX_ARG("lb", help))
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		LB_CTX(root, CTX_ADD, "Create load balancer elements."),
+		"service VIP PROTO PORT src SRC backend BACKEND+ "
+		"[(encap ENCAP),(gue-port GUE_PORT),(table SIZE),(vrf VRF)]",
+		service_add,
+		"Add or replace a load balanced service.",
+		SERVICE_ARGS,
+		with_help("Outer source address.", ec_node_re("SRC", IPV4_RE)),
+		with_help("Backend address.", ec_node_re("BACKEND", IPV4_RE)),
+		with_help("Encapsulation (default ipip).", ec_node_re("ENCAP", "ipip|gue")),
+		with_help(
+			"GUE destination port (default 6080).",
+			ec_node_uint("GUE_PORT", 1, UINT16_MAX, 10)
+		),
+		with_help(
+			"Prime size of the lookup table (default 65537).",
+			ec_node_uint("SIZE", 2, GR_LB_TABLE_SIZE_MAX, 10)
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		LB_CTX(root, CTX_DEL, "Delete load balancer elements."),
+		"service VIP PROTO PORT [vrf VRF]",
+		service_del,
+		"Delete a load balanced service.",
+		SERVICE_ARGS
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		LB_CTX(root, CTX_SHOW, "Show load balancer details."),
+		"service [vrf VRF]",
+		service_list,
+		"List load balanced services.",
+		with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10))
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "lb",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+}
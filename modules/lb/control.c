@@ -0,0 +1,393 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_lb.h"
+#include "lb_priv.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_feature.h>
+#include <gr_iface.h>
+#include <gr_ip4_control.h>
+#include <gr_log.h>
+#include <gr_net_types.h>
+#include <gr_rcu.h>
+
+#include <event2/event.h>
+#include <rte_errno.h>
+#include <rte_hash.h>
+#include <rte_jhash.h>
+#include <rte_malloc.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct rte_hash *lb_hash;
+static uint32_t vrf_n_services[IP4_MAX_VRFS];
+
+void lb_service_get_bulk(const struct lb_key *keys, unsigned n, struct lb_service **services) {
+	const void *key_ptrs[LB_LOOKUP_BULK_MAX];
+	void *data[LB_LOOKUP_BULK_MAX];
+	uint64_t hits = 0;
+
+	assert(n <= LB_LOOKUP_BULK_MAX);
+
+	for (unsigned i = 0; i < n; i++)
+		key_ptrs[i] = &keys[i];
+
+	if (n > 0 && rte_hash_lookup_bulk_data(lb_hash, key_ptrs, n, &hits, data) < 0)
+		hits = 0;
+
+	for (unsigned i = 0; i < n; i++)
+		services[i] = hits & (UINT64_C(1) << i) ? data[i] : NULL;
+}
+
+// maglev //////////////////////////////////////////////////////////////////////
+
+#define MAGLEV_SEED_OFFSET 0x6d61676c
+#define MAGLEV_SEED_SKIP 0x65763432
+#define MAGLEV_EMPTY UINT8_MAX
+
+// Fill the lookup table as described in "Maglev: A Fast and Reliable Software
+// Network Load Balancer" (NSDI 2016). Each backend has a preference order of
+// all table entries, derived from its address. Backends take turns claiming
+// their next preferred entry that is still empty until the table is full.
+static void maglev_populate(struct lb_service *s) {
+	uint32_t offset[GR_LB_MAX_BACKENDS], skip[GR_LB_MAX_BACKENDS];
+	uint32_t next[GR_LB_MAX_BACKENDS];
+	uint32_t m = s->table_size;
+	uint32_t filled = 0;
+	uint64_t c;
+
+	for (uint16_t i = 0; i < s->n_backends; i++) {
+		ip4_addr_t addr = s->backends[i].addr;
+		offset[i] = rte_jhash_1word(addr, MAGLEV_SEED_OFFSET) % m;
+		skip[i] = rte_jhash_1word(addr, MAGLEV_SEED_SKIP) % (m - 1) + 1;
+		next[i] = 0;
+	}
+
+	memset(s->table, MAGLEV_EMPTY, m);
+
+	for (;;) {
+		for (uint16_t i = 0; i < s->n_backends; i++) {
+			// m is prime, the preference order is a permutation of
+			// all entries and an empty one is always found
+			do {
+				c = (offset[i] + (uint64_t)next[i] * skip[i]) % m;
+				next[i]++;
+			} while (s->table[c] != MAGLEV_EMPTY);
+			s->table[c] = i;
+			if (++filled == m)
+				return;
+		}
+	}
+}
+
+static bool is_prime(uint32_t n) {
+	if (n < 2)
+		return false;
+	for (uint32_t d = 2; d <= n / d; d++) {
+		if (n % d == 0)
+			return false;
+	}
+	return true;
+}
+
+// services ////////////////////////////////////////////////////////////////////
+
+static void lb_key_init(
+	struct lb_key *key,
+	uint16_t vrf_id,
+	ip4_addr_t vip,
+	uint8_t proto,
+	uint16_t port
+) {
+	memset(key, 0, sizeof(*key));
+	key->vip = vip;
+	key->vrf_id = vrf_id;
+	key->port = rte_cpu_to_be_16(port);
+	key->proto = proto;
+}
+
+static int lb_key_validate(const struct lb_key *key) {
+	if (key->vrf_id >= IP4_MAX_VRFS)
+		return errno_set(EOVERFLOW);
+	if (key->proto != IPPROTO_TCP && key->proto != IPPROTO_UDP)
+		return errno_set(EPROTONOSUPPORT);
+	if (key->vip == 0 || key->port == 0)
+		return errno_set(EINVAL);
+	return 0;
+}
+
+static int addr_cmp(const void *a, const void *b) {
+	uint32_t x = rte_be_to_cpu_32(*(const ip4_addr_t *)a);
+	uint32_t y = rte_be_to_cpu_32(*(const ip4_addr_t *)b);
+	return (x > y) - (x < y);
+}
+
+// Backends are sorted so that the lookup table does not depend on the order in
+// which they were specified.
+static struct lb_service *lb_service_from_api(const struct gr_lb_service *api) {
+	ip4_addr_t backends[GR_LB_MAX_BACKENDS];
+	uint32_t table_size = api->table_size;
+	struct lb_service *s;
+
+	if (api->n_backends == 0 || api->n_backends > GR_LB_MAX_BACKENDS)
+		return errno_set_null(ERANGE);
+	if (table_size == 0)
+		table_size = GR_LB_TABLE_SIZE_DEFAULT;
+	if (table_size > GR_LB_TABLE_SIZE_MAX || table_size <= api->n_backends
+	    || !is_prime(table_size))
+		return errno_set_null(EDOM);
+	if (api->encap != GR_LB_ENCAP_IPIP && api->encap != GR_LB_ENCAP_GUE)
+		return errno_set_null(EINVAL);
+	if (api->src == 0)
+		return errno_set_null(EDESTADDRREQ);
+
+	memcpy(backends, api->backends, api->n_backends * sizeof(*backends));
+	qsort(backends, api->n_backends, sizeof(*backends), addr_cmp);
+	for (uint16_t i = 0; i < api->n_backends; i++) {
+		if (backends[i] == 0)
+			return errno_set_null(EINVAL);
+		if (i > 0 && backends[i] == backends[i - 1])
+			return errno_set_null(EEXIST);
+	}
+
+	s = rte_zmalloc(__func__, sizeof(*s) + table_size, RTE_CACHE_LINE_SIZE);
+	if (s == NULL)
+		return errno_set_null(ENOMEM);
+
+	s->src = api->src;
+	s->encap = api->encap;
+	s->gue_port = rte_cpu_to_be_16(api->gue_port ?: GR_LB_GUE_PORT);
+	s->table_size = table_size;
+	s->n_backends = api->n_backends;
+	for (uint16_t i = 0; i < s->n_backends; i++)
+		s->backends[i].addr = backends[i];
+
+	maglev_populate(s);
+
+	return s;
+}
+
+static void lb_service_to_api(
+	struct gr_lb_service *api,
+	const struct lb_key *key,
+	const struct lb_service *s
+) {
+	memset(api, 0, sizeof(*api));
+	api->vrf_id = key->vrf_id;
+	api->vip = key->vip;
+	api->proto = key->proto;
+	api->port = rte_be_to_cpu_16(key->port);
+	api->src = s->src;
+	api->encap = s->encap;
+	api->gue_port = rte_be_to_cpu_16(s->gue_port);
+	api->table_size = s->table_size;
+	api->n_backends = s->n_backends;
+	for (uint16_t i = 0; i < s->n_backends; i++)
+		api->backends[i] = s->backends[i].addr;
+}
+
+// Packets received in a VRF are only sent to the lb node when this VRF has at
+// least one service.
+static void lb_vrf_enable(uint16_t vrf_id, bool enable) {
+	struct iface *iface = NULL;
+
+	while ((iface = iface_next(GR_IFACE_TYPE_UNDEF, iface)) != NULL) {
+		if (iface->vrf_id == vrf_id)
+			gr_feature_enable(&lb_feature, iface->id, enable);
+	}
+}
+
+static void lb_iface_event_handler(iface_event_t event, struct iface *iface) {
+	bool enable;
+
+	switch (event) {
+	case IFACE_EVENT_POST_ADD:
+	case IFACE_EVENT_POST_RECONFIG:
+		enable = iface->vrf_id < IP4_MAX_VRFS && vrf_n_services[iface->vrf_id] != 0;
+		gr_feature_enable(&lb_feature, iface->id, enable);
+		break;
+	default:
+		break;
+	}
+}
+
+// Replace the service in place or insert it. The previous service, if any, is
+// freed once all workers are done with it.
+static int lb_service_set(const struct lb_key *key, struct lb_service *s) {
+	void *old = NULL;
+	int ret;
+
+	rte_hash_lookup_data(lb_hash, key, &old);
+	if ((ret = rte_hash_add_key_data(lb_hash, key, s)) < 0) {
+		rte_free(s);
+		return errno_set(-ret);
+	}
+	if (old != NULL) {
+		gr_rcu_defer_free(rte_free, old);
+	} else if (vrf_n_services[key->vrf_id]++ == 0) {
+		lb_vrf_enable(key->vrf_id, true);
+	}
+
+	return 0;
+}
+
+// The service is freed by the hash library once all workers have reported
+// a quiescent state, see lb_service_free().
+static void lb_service_remove(const struct lb_key *key) {
+	if (rte_hash_del_key(lb_hash, key) < 0)
+		return;
+	if (--vrf_n_services[key->vrf_id] == 0)
+		lb_vrf_enable(key->vrf_id, false);
+}
+
+static void lb_service_free(void *, void *data) {
+	rte_free(data);
+}
+
+// API handlers ////////////////////////////////////////////////////////////////
+
+static struct api_out service_add_cb(const void *request, void ** /*response*/) {
+	const struct gr_lb_service_add_req *req = request;
+	const struct gr_lb_service *api = &req->service;
+	struct lb_service *s;
+	struct lb_key key;
+
+	lb_key_init(&key, api->vrf_id, api->vip, api->proto, api->port);
+	if (lb_key_validate(&key) < 0)
+		return api_out(errno, 0);
+	if (rte_hash_lookup(lb_hash, &key) >= 0 && !req->exist_ok)
+		return api_out(EEXIST, 0);
+	if ((s = lb_service_from_api(api)) == NULL)
+		return api_out(errno, 0);
+	if (lb_service_set(&key, s) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out service_del_cb(const void *request, void ** /*response*/) {
+	const struct gr_lb_service_del_req *req = request;
+	struct lb_key key;
+
+	lb_key_init(&key, req->vrf_id, req->vip, req->proto, req->port);
+	if (lb_key_validate(&key) < 0)
+		return api_out(errno, 0);
+	if (rte_hash_lookup(lb_hash, &key) < 0) {
+		if (req->missing_ok)
+			return api_out(0, 0);
+		return api_out(ENOENT, 0);
+	}
+	lb_service_remove(&key);
+
+	return api_out(0, 0);
+}
+
+static struct api_out service_list_cb(const void *request, void **response) {
+	const struct gr_lb_service_list_req *req = request;
+	struct gr_lb_service_list_resp *resp;
+	const struct lb_key *key;
+	uint32_t iter;
+	size_t len, n;
+	void *data;
+
+	n = 0;
+	iter = 0;
+	while (rte_hash_iterate(lb_hash, (const void **)&key, &data, &iter) >= 0) {
+		if (key->vrf_id == req->vrf_id || req->vrf_id == UINT16_MAX)
+			n++;
+	}
+
+	len = sizeof(*resp) + n * sizeof(*resp->services);
+	if (len > GR_API_MAX_MSG_LEN)
+		return api_out(EMSGSIZE, 0);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	iter = 0;
+	while (rte_hash_iterate(lb_hash, (const void **)&key, &data, &iter) >= 0) {
+		if (key->vrf_id != req->vrf_id && req->vrf_id != UINT16_MAX)
+			continue;
+		if (resp->n_services == n)
+			break;
+		lb_service_to_api(&resp->services[resp->n_services++], key, data);
+	}
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+// module //////////////////////////////////////////////////////////////////////
+
+static void lb_init(struct event_base *) {
+	struct rte_hash_parameters params = {
+		.name = "lb_services",
+		.entries = LB_SERVICES_SIZE,
+		.key_len = sizeof(struct lb_key),
+		.socket_id = SOCKET_ID_ANY,
+		.extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF
+			| RTE_HASH_EXTRA_FLAGS_TRANS_MEM_SUPPORT,
+	};
+	// With lock-free readers, deleted keys slots and services can only be
+	// reused after all workers have reported a quiescent state.
+	struct rte_hash_rcu_config rcu = {
+		.v = gr_datapath_rcu(),
+		.mode = RTE_HASH_QSBR_MODE_DQ,
+		.free_key_data_func = lb_service_free,
+	};
+
+	lb_hash = rte_hash_create(&params);
+	if (lb_hash == NULL)
+		ABORT("rte_hash_create(lb_services)");
+	if (rte_hash_rcu_qsbr_add(lb_hash, &rcu) < 0)
+		ABORT("rte_hash_rcu_qsbr_add(lb_services): %s", rte_strerror(rte_errno));
+}
+
+static void lb_fini(struct event_base *) {
+	// services still in the table are freed with their keys
+	rte_hash_free(lb_hash);
+	lb_hash = NULL;
+	memset(vrf_n_services, 0, sizeof(vrf_n_services));
+}
+
+static struct gr_module lb_module = {
+	.name = "lb",
+	.init = lb_init,
+	.fini = lb_fini,
+	.fini_prio = 1000,
+};
+
+static struct gr_api_handler service_add_handler = {
+	.name = "lb service add",
+	.request_type = GR_LB_SERVICE_ADD,
+	.callback = service_add_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler service_del_handler = {
+	.name = "lb service del",
+	.request_type = GR_LB_SERVICE_DEL,
+	.callback = service_del_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler service_list_handler = {
+	.name = "lb service list",
+	.request_type = GR_LB_SERVICE_LIST,
+	.callback = service_list_cb,
+};
+
+static struct iface_event_handler lb_iface_event = {
+	.callback = lb_iface_event_handler,
+};
+
+RTE_INIT(lb_constructor) {
+	gr_register_api_handler(&service_add_handler);
+	gr_register_api_handler(&service_del_handler);
+	gr_register_api_handler(&service_list_handler);
+	gr_register_module(&lb_module);
+	iface_event_register_handler(&lb_iface_event);
+}
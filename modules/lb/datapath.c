@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "lb_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_feature.h>
+#include <gr_graph.h>
+#include <gr_iface.h>
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_lb.h>
+#include <gr_mbuf.h>
+
+#include <rte_byteorder.h>
+#include <rte_graph_worker.h>
+#include <rte_ip.h>
+#include <rte_jhash.h>
+#include <rte_udp.h>
+
+#include <netinet/in.h>
+#include <string.h>
+
+enum {
+	FORWARD = 0,
+	LOCAL,
+	IP_OUTPUT,
+	NO_HEADROOM,
+	EDGE_COUNT,
+};
+
+struct gr_feature lb_feature = {
+	.arc = &ip4_input_features,
+	.node = "lb",
+	// after the ingress ACLs
+	.order = 200,
+};
+
+// Same decision as ip_input for packets that are not sent to a service.
+static inline rte_edge_t pass_edge(const struct nexthop *nh, const struct rte_ipv4_hdr *ip) {
+	if (nh == NULL) // broadcast or link-local multicast
+		return LOCAL;
+	if (nh->flags & GR_IP4_NH_F_LOCAL && ip->dst_addr == nh->ip)
+		return LOCAL;
+	return FORWARD;
+}
+
+// Unlike ip4_flow_hash(), never use the RSS hash. The result must not depend on
+// the NIC so that all routers announcing the same VIP select the same backend.
+static inline uint32_t lb_flow_hash(const struct rte_ipv4_hdr *ip, uint32_t ports) {
+	return rte_jhash_3words(ip->src_addr, ip->dst_addr, ports, ip->next_proto_id);
+}
+
+// Build the service key of a packet. Returns false if it cannot belong to any
+// service. Non-first fragments have no L4 header and cannot be matched, none of
+// the fragments of a datagram are load balanced. They follow the route of the
+// VIP instead.
+static inline bool lb_key_fill(
+	const struct rte_mbuf *m,
+	const struct rte_ipv4_hdr *ip,
+	uint16_t vrf_id,
+	struct lb_key *key,
+	uint32_t *ports
+) {
+	const rte_be16_t frag = RTE_BE16(RTE_IPV4_HDR_MF_FLAG | RTE_IPV4_HDR_OFFSET_MASK);
+	uint16_t len = rte_ipv4_hdr_len(ip);
+
+	if (ip->next_proto_id != IPPROTO_TCP && ip->next_proto_id != IPPROTO_UDP)
+		return false;
+	if (ip->fragment_offset & frag)
+		return false;
+	if (rte_pktmbuf_data_len(m) < len + sizeof(*ports))
+		return false;
+
+	// source and destination ports, in network order
+	memcpy(ports, (const uint8_t *)ip + len, sizeof(*ports));
+
+	memset(key, 0, sizeof(*key));
+	key->vip = ip->dst_addr;
+	key->vrf_id = vrf_id;
+	key->port = ((const rte_be16_t *)ports)[1];
+	key->proto = ip->next_proto_id;
+
+	return true;
+}
+
+static inline rte_edge_t lb_encap(
+	struct rte_mbuf *m,
+	struct lb_service *s,
+	uint32_t hash,
+	uint16_t vrf_id,
+	uint32_t route_gen,
+	uint32_t iface_gen
+) {
+	struct lb_backend *b = &s->backends[s->table[hash % s->table_size]];
+	struct ip_local_mbuf_data *tunnel;
+	struct rte_ipv4_hdr *inner, *outer;
+	struct rte_udp_hdr *udp;
+
+	inner = rte_pktmbuf_mtod(m, struct rte_ipv4_hdr *);
+	tunnel = ip_local_mbuf_data(m);
+	tunnel->src = s->src;
+	tunnel->dst = b->addr;
+	tunnel->len = rte_be_to_cpu_16(inner->total_length);
+	tunnel->vrf_id = vrf_id;
+
+	if (s->encap == GR_LB_ENCAP_GUE) {
+		tunnel->len += sizeof(*udp);
+		tunnel->proto = IPPROTO_UDP;
+		outer = (struct rte_ipv4_hdr *)rte_pktmbuf_prepend(
+			m, sizeof(*outer) + sizeof(*udp)
+		);
+		if (unlikely(outer == NULL))
+			return NO_HEADROOM;
+		udp = (struct rte_udp_hdr *)(outer + 1);
+		// ephemeral source port for ECMP and RSS on the backend side
+		udp->src_port = rte_cpu_to_be_16(0xc000 | (hash & 0x3fff));
+		udp->dst_port = s->gue_port;
+		udp->dgram_len = rte_cpu_to_be_16(tunnel->len);
+		udp->dgram_cksum = 0; // optional over IPv4
+	} else {
+		tunnel->proto = IPPROTO_IPIP;
+		outer = (struct rte_ipv4_hdr *)rte_pktmbuf_prepend(m, sizeof(*outer));
+		if (unlikely(outer == NULL))
+			return NO_HEADROOM;
+	}
+	ip_set_fields(m, outer, tunnel);
+
+	// Resolve the next hop of the encapsulated packet.
+	ip_output_mbuf_data(m)->nh = ip4_route_cache_lookup(
+		&b->route, vrf_id, b->addr, route_gen, iface_gen
+	);
+
+	return IP_OUTPUT;
+}
+
+// Packets sent to a service are encapsulated to the backend selected by the
+// Maglev lookup table of the service. Other packets go to the next enabled
+// input feature or follow the path ip_input would have chosen.
+static uint16_t
+lb_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct lb_service *services[LB_LOOKUP_BULK_MAX];
+	uint32_t ports[LB_LOOKUP_BULK_MAX];
+	struct lb_key keys[LB_LOOKUP_BULK_MAX];
+	uint16_t idx[LB_LOOKUP_BULK_MAX];
+	rte_edge_t edges[RTE_GRAPH_BURST_SIZE];
+	const struct iface *iface, *last = NULL;
+	struct ip_output_mbuf_data *d;
+	gr_feature_mask_t features = 0;
+	uint32_t route_gen, iface_gen;
+	const struct rte_ipv4_hdr *ip;
+	uint16_t i, j, n, count;
+	struct rte_mbuf *m;
+
+	route_gen = __atomic_load_n(&ip4_route_gen, __ATOMIC_ACQUIRE);
+	iface_gen = __atomic_load_n(&iface_config_gen, __ATOMIC_ACQUIRE);
+
+	for (i = 0; i < nb_objs; i += count) {
+		count = RTE_MIN(nb_objs - i, RTE_GRAPH_BURST_SIZE);
+		n = 0;
+
+		for (j = i; j < i + count; j++) {
+			m = objs[j];
+			gr_mbuf_prefetch_ahead(objs, j, nb_objs);
+			d = ip_output_mbuf_data(m);
+			iface = d->input_iface;
+			ip = rte_pktmbuf_mtod(m, const struct rte_ipv4_hdr *);
+			if (iface != last) {
+				last = iface;
+				features = gr_feature_enabled(&ip4_input_features, iface->id);
+			}
+			edges[j - i] = gr_feature_next(&lb_feature, features);
+			if (edges[j - i] == RTE_EDGE_ID_INVALID)
+				edges[j - i] = pass_edge(d->nh, ip);
+
+			if (lb_key_fill(m, ip, iface->vrf_id, &keys[n], &ports[n]))
+				idx[n++] = j;
+			// lookup the services in bulk, usually once per burst
+			if (n == LB_LOOKUP_BULK_MAX || j == i + count - 1) {
+				lb_service_get_bulk(keys, n, services);
+				for (uint16_t k = 0; k < n; k++) {
+					if (services[k] == NULL)
+						continue;
+					m = objs[idx[k]];
+					ip = rte_pktmbuf_mtod(m, const struct rte_ipv4_hdr *);
+					edges[idx[k] - i] = lb_encap(
+						m,
+						services[k],
+						lb_flow_hash(ip, ports[k]),
+						keys[k].vrf_id,
+						route_gen,
+						iface_gen
+					);
+				}
+				n = 0;
+			}
+		}
+
+		for (j = i; j < i + count; j++)
+			rte_node_enqueue_x1(graph, node, edges[j - i], objs[j]);
+	}
+
+	return nb_objs;
+}
+
+static void lb_register(void) {
+	gr_feature_register(&lb_feature);
+}
+
+static struct rte_node_register lb_node = {
+	.name = "lb",
+
+	.process = lb_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[FORWARD] = "ip_forward",
+		[LOCAL] = "ip_input_local",
+		[IP_OUTPUT] = "ip_output",
+		[NO_HEADROOM] = "error_no_headroom",
+	},
+};
+
+static struct gr_node_info lb_info = {
+	.node = &lb_node,
+	.register_callback = lb_register,
+};
+
+GR_NODE_REGISTER(lb_info);
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_API_LB
+#define _GR_API_LB
+
+#include <gr_api.h>
+#include <gr_infra.h>
+#include <gr_net_types.h>
+
+#include <stdint.h>
+
+#define GR_LB_MODULE 0x1bba
+
+#define GR_LB_MAX_BACKENDS 64
+// Size of the Maglev lookup table of a service. It must be a prime number,
+// much larger than the number of backends. Larger tables spread the flows more
+// evenly between backends at the cost of memory and rebuild time.
+#define GR_LB_TABLE_SIZE_DEFAULT 65537
+#define GR_LB_TABLE_SIZE_MAX 1048573
+// Default destination port of GR_LB_ENCAP_GUE.
+#define GR_LB_GUE_PORT 6080
+
+typedef enum {
+	GR_LB_ENCAP_IPIP = 0,
+	// Generic UDP Encapsulation variant 1 (draft-ietf-intarea-gue): the
+	// inner IPv4 header directly follows the UDP header.
+	GR_LB_ENCAP_GUE,
+} gr_lb_encap_t;
+
+// Stateless L4 load balancer. TCP or UDP packets received for vip:port are
+// sent to one of the backends, encapsulated in an outer IPv4 header from src to
+// the backend address. Backends reply directly to the clients.
+//
+// The backend of a packet only depends on its 5-tuple and on the backend list.
+// All workers, and all routers with the same services, select the same one.
+// Adding or removing a backend only moves the flows of about 1/n_backends of
+// the lookup table (Maglev hashing).
+//
+// Packets to the VIP must be routed by grout in the service VRF (with a local
+// address or a route). They are intercepted after the ingress ACLs.
+struct gr_lb_service {
+	uint16_t vrf_id;
+	ip4_addr_t vip;
+	uint8_t proto; // IPPROTO_TCP or IPPROTO_UDP
+	uint16_t port; // destination port in host order
+	ip4_addr_t src; // outer source address
+	uint8_t encap; // gr_lb_encap_t
+	uint16_t gue_port; // outer destination port in host order, 0 for GR_LB_GUE_PORT
+	uint32_t table_size; // 0 for GR_LB_TABLE_SIZE_DEFAULT
+	uint16_t n_backends;
+	ip4_addr_t backends[GR_LB_MAX_BACKENDS];
+};
+
+#define GR_LB_SERVICE_ADD REQUEST_TYPE(GR_LB_MODULE, 0x0001)
+
+struct gr_lb_service_add_req {
+	struct gr_lb_service service;
+	uint8_t exist_ok; // replace the existing service
+};
+
+// struct gr_lb_service_add_resp { };
+
+#define GR_LB_SERVICE_DEL REQUEST_TYPE(GR_LB_MODULE, 0x0002)
+
+struct gr_lb_service_del_req {
+	uint16_t vrf_id;
+	ip4_addr_t vip;
+	uint8_t proto;
+	uint16_t port;
+	uint8_t missing_ok;
+};
+
+// struct gr_lb_service_del_resp { };
+
+#define GR_LB_SERVICE_LIST REQUEST_TYPE(GR_LB_MODULE, 0x0003)
+
+struct gr_lb_service_list_req {
+	uint16_t vrf_id; // UINT16_MAX for all
+};
+
+struct gr_lb_service_list_resp {
+	uint16_t n_services;
+	struct gr_lb_service services[/* n_services */];
+};
+
+#endif
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _LB_PRIV_H
+#define _LB_PRIV_H
+
+#include <gr_feature.h>
+#include <gr_ip4_control.h>
+#include <gr_lb.h>
+#include <gr_net_types.h>
+
+#include <rte_byteorder.h>
+#include <rte_hash.h>
+
+#include <stdint.h>
+
+struct lb_key {
+	ip4_addr_t vip;
+	uint16_t vrf_id;
+	rte_be16_t port;
+	uint8_t proto;
+	uint8_t reserved[3]; // must be zero
+};
+
+static_assert(sizeof(struct lb_key) == 12);
+
+struct lb_backend {
+	ip4_addr_t addr;
+	struct ip4_route_cache route; // underlay next hop of addr
+};
+
+// Services are never modified once inserted in the table, except for the
+// route caches of their backends. Updates replace the whole service and its
+// lookup table, the previous one is freed after all workers are done with it.
+struct lb_service {
+	ip4_addr_t src;
+	rte_be16_t gue_port;
+	uint8_t encap;
+	uint16_t n_backends;
+	uint32_t table_size;
+	struct lb_backend backends[GR_LB_MAX_BACKENDS];
+	// Maglev lookup table, indexes of backends.
+	uint8_t table[/* table_size */];
+};
+
+static_assert(GR_LB_MAX_BACKENDS <= UINT8_MAX);
+
+#define LB_SERVICES_SIZE 1024
+#define LB_LOOKUP_BULK_MAX RTE_HASH_LOOKUP_BULK_MAX
+
+// Lookup up to LB_LOOKUP_BULK_MAX services at once. Unknown ones are NULL.
+void lb_service_get_bulk(const struct lb_key *keys, unsigned n, struct lb_service **services);
+
+extern struct gr_feature lb_feature;
+
+#endif
@@ -0,0 +1,228 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_cli_iface.h>
+#include <gr_mcast.h>
+#include <gr_net_types.h>
+#include <gr_table.h>
+
+#include <ecoli.h>
+#include <libsmartcols.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+// Parse the group address and the optional source address. Both must be of
+// the same family.
+static int parse_group_source(
+	const struct ec_pnode *p,
+	uint8_t *family,
+	union gr_mcast_addr *group,
+	union gr_mcast_addr *source
+) {
+	const char *src = arg_str(p, "SOURCE");
+
+	if (inet_pton(AF_INET, arg_str(p, "GROUP"), &group->ip4) == 1)
+		*family = AF_INET;
+	else if (inet_pton(AF_INET6, arg_str(p, "GROUP"), &group->ip6) == 1)
+		*family = AF_INET6;
+	else
+		return errno_set(EINVAL);
+
+	if (src != NULL && inet_pton(*family, src, source) != 1)
+		return errno_set(EAFNOSUPPORT);
+
+	return 0;
+}
+
+static cmd_status_t route_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_mcast_route_add_req req = {.route.iif_id = GR_IFACE_ID_UNDEF, .exist_ok = true};
+	struct gr_mcast_route *r = &req.route;
+	const struct ec_pnode *n;
+	struct gr_iface iface;
+
+	if (parse_group_source(p, &r->family, &r->group, &r->source) < 0)
+		return CMD_ERROR;
+	if (arg_str(p, "IIF") != NULL) {
+		if (iface_from_name(c, arg_str(p, "IIF"), &iface) < 0)
+			return CMD_ERROR;
+		r->iif_id = iface.id;
+	}
+	for (n = ec_pnode_find(p, "OIF"); n != NULL; n = ec_pnode_find_next(p, n, "OIF", false)) {
+		const struct ec_strvec *v = ec_pnode_get_strvec(n);
+		if (r->n_oifs == GR_MCAST_MAX_OIFS) {
+			errno = ERANGE;
+			return CMD_ERROR;
+		}
+		if (iface_from_name(c, ec_strvec_val(v, 0), &iface) < 0)
+			return CMD_ERROR;
+		r->oif_ids[r->n_oifs++] = iface.id;
+	}
+	if (arg_u16(p, "VRF", &r->vrf_id) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_MCAST_ROUTE_ADD, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t route_del(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_mcast_route_del_req req = {.missing_ok = true};
+
+	if (parse_group_source(p, &req.family, &req.group, &req.source) < 0)
+		return CMD_ERROR;
+	if (arg_u16(p, "VRF", &req.vrf_id) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_MCAST_ROUTE_DEL, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static void iface_name(const struct gr_api_client *c, uint16_t iface_id, char *buf, size_t len) {
+	struct gr_iface iface;
+
+	if (iface_from_id(c, iface_id, &iface) == 0)
+		snprintf(buf, len, "%s", iface.name);
+	else
+		snprintf(buf, len, "%u", iface_id);
+}
+
+static cmd_status_t route_list(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_mcast_route_list_req req = {.vrf_id = UINT16_MAX};
+	struct libscols_table *table = scols_new_table();
+	const struct gr_mcast_route_list_resp *resp;
+	void *resp_ptr = NULL;
+	char buf[BUFSIZ];
+	size_t len;
+
+	if (table == NULL)
+		return CMD_ERROR;
+	if (arg_u16(p, "VRF", &req.vrf_id) < 0 && errno != ENOENT) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+	if (gr_api_client_send_recv(c, GR_MCAST_ROUTE_LIST, sizeof(req), &req, &resp_ptr) < 0) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+
+	resp = resp_ptr;
+
+	scols_table_new_column(table, "VRF", 0, 0);
+	scols_table_new_column(table, "SOURCE", 0, 0);
+	scols_table_new_column(table, "GROUP", 0, 0);
+	scols_table_new_column(table, "IIF", 0, 0);
+	scols_table_new_column(table, "OIFS", 0, 0);
+	scols_table_set_column_separator(table, "  ");
+
+	for (size_t i = 0; i < resp->n_routes; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_mcast_route *r = &resp->routes[i];
+		union gr_mcast_addr any = {0};
+
+		scols_line_sprintf(line, 0, "%u", r->vrf_id);
+		if (memcmp(&r->source, &any, sizeof(any)) == 0) {
+			scols_line_set_data(line, 1, "*");
+		} else {
+			inet_ntop(r->family, &r->source, buf, sizeof(buf));
+			scols_line_set_data(line, 1, buf);
+		}
+		inet_ntop(r->family, &r->group, buf, sizeof(buf));
+		scols_line_set_data(line, 2, buf);
+		if (r->iif_id == GR_IFACE_ID_UNDEF) {
+			scols_line_set_data(line, 3, "*");
+		} else {
+			iface_name(c, r->iif_id, buf, sizeof(buf));
+			scols_line_set_data(line, 3, buf);
+		}
+		len = 0;
+		buf[0] = '\0';
+		// at most GR_MCAST_MAX_OIFS names, always fits
+		for (uint16_t j = 0; j < r->n_oifs; j++) {
+			if (j > 0)
+				buf[len++] = ' ';
+			iface_name(c, r->oif_ids[j], buf + len, sizeof(buf) - len);
+			len += strlen(buf + len);
+		}
+		scols_line_set_data(line, 4, buf);
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+#define GROUP_ARG with_help("Multicast group address.", ec_node_re("GROUP", IPV4_RE "|" IPV6_RE))
+#define SOURCE_ARG                                                                                 \
+	with_help(                                                                                 \
+		"Source address, any source if unset.",                                            \
+		ec_node_re("SOURCE", IPV4_RE "|" IPV6_RE)                                          \
+	)
+#define VRF_ARG with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10))
+
+#define MCAST_CTX(root, ctx, help) CLI_CONTEXT(root, ctx, CTX_ARG("mcast", help))
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		MCAST_CTX(root, CTX_ADD, "Create multicast routing elements."),
+		"route GROUP oifs OIF+ [(source SOURCE),(iif IIF),(vrf VRF)]",
+		route_add,
+		"Add or replace a multicast route.",
+		GROUP_ARG,
+		with_help(
+			"Outgoing port, VLAN or bond interface.",
+			ec_node_dyn("OIF", complete_iface_names, NULL)
+		),
+		SOURCE_ARG,
+		with_help(
+			"Only forward packets received on this interface.",
+			ec_node_dyn("IIF", complete_iface_names, NULL)
+		),
+		VRF_ARG
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		MCAST_CTX(root, CTX_DEL, "Delete multicast routing elements."),
+		"route GROUP [(source SOURCE),(vrf VRF)]",
+		route_del,
+		"Delete a multicast route.",
+		GROUP_ARG,
+		SOURCE_ARG,
+		VRF_ARG
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		MCAST_CTX(root, CTX_SHOW, "Show multicast routing details."),
+		"route [vrf VRF]",
+		route_list,
+		"List multicast routes.",
+		VRF_ARG
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "mcast",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+}
@@ -0,0 +1,407 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_mcast.h"
+#include "mcast_priv.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_ip6_control.h>
+#include <gr_ip6_datapath.h>
+#include <gr_log.h>
+#include <gr_macro.h>
+#include <gr_net_types.h>
+#include <gr_rcu.h>
+#include <gr_stb_ds.h>
+
+#include <event2/event.h>
+#include <rte_errno.h>
+#include <rte_hash.h>
+#include <rte_malloc.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+static struct rte_hash *mcast_hash;
+
+// multicast fib ///////////////////////////////////////////////////////////////
+
+void mcast_route_get_bulk(
+	const struct mcast_key *keys,
+	unsigned n,
+	const struct mcast_route **routes
+) {
+	const void *key_ptrs[2 * MCAST_LOOKUP_BULK_MAX];
+	struct mcast_key any[MCAST_LOOKUP_BULK_MAX];
+	void *data[2 * MCAST_LOOKUP_BULK_MAX];
+	uint64_t hits = 0;
+
+	assert(n <= MCAST_LOOKUP_BULK_MAX);
+
+	for (unsigned i = 0; i < n; i++) {
+		any[i] = keys[i];
+		memset(&any[i].source, 0, sizeof(any[i].source));
+		key_ptrs[i] = &keys[i];
+		key_ptrs[n + i] = &any[i];
+	}
+
+	if (n > 0 && rte_hash_lookup_bulk_data(mcast_hash, key_ptrs, 2 * n, &hits, data) < 0)
+		hits = 0;
+
+	for (unsigned i = 0; i < n; i++) {
+		if (hits & (UINT64_C(1) << i))
+			routes[i] = data[i];
+		else if (hits & (UINT64_C(1) << (n + i)))
+			routes[i] = data[n + i];
+		else
+			routes[i] = NULL;
+	}
+}
+
+static void mcast_key_init(
+	struct mcast_key *key,
+	uint16_t vrf_id,
+	uint8_t family,
+	const union gr_mcast_addr *source,
+	const union gr_mcast_addr *group
+) {
+	memset(key, 0, sizeof(*key));
+	key->vrf_id = vrf_id;
+	key->family = family;
+	if (family == AF_INET) {
+		key->source.ip4 = source->ip4;
+		key->group.ip4 = group->ip4;
+	} else {
+		key->source.ip6 = source->ip6;
+		key->group.ip6 = group->ip6;
+	}
+}
+
+static int mcast_key_validate(const struct mcast_key *key) {
+	switch (key->family) {
+	case AF_INET:
+		if (key->vrf_id >= IP4_MAX_VRFS)
+			return errno_set(EOVERFLOW);
+		// link-local groups are always delivered locally
+		if (!ip_mcast_routable(key->group.ip4))
+			return errno_set(EADDRNOTAVAIL);
+		if (RTE_IS_IPV4_MCAST(rte_be_to_cpu_32(key->source.ip4)))
+			return errno_set(EINVAL);
+		break;
+	case AF_INET6:
+		if (key->vrf_id >= IP6_MAX_VRFS)
+			return errno_set(EOVERFLOW);
+		if (!ip6_mcast_routable(&key->group.ip6))
+			return errno_set(EADDRNOTAVAIL);
+		if (rte_ipv6_addr_is_mcast(&key->source.ip6))
+			return errno_set(EINVAL);
+		break;
+	default:
+		return errno_set(EAFNOSUPPORT);
+	}
+
+	return 0;
+}
+
+static struct mcast_route *mcast_route_alloc(const struct iface *iif, uint16_t n_oifs) {
+	struct mcast_route *r;
+
+	r = rte_zmalloc(__func__, sizeof(*r) + n_oifs * sizeof(*r->oifs), 0);
+	if (r == NULL)
+		return errno_set_null(ENOMEM);
+	r->iif = iif;
+	r->n_oifs = n_oifs;
+
+	return r;
+}
+
+// Replace the route data in place or insert it. The previous route, if any, is
+// freed once all workers are done with it.
+static int mcast_route_set(const struct mcast_key *key, struct mcast_route *r) {
+	void *old = NULL;
+	int ret;
+
+	rte_hash_lookup_data(mcast_hash, key, &old);
+	if ((ret = rte_hash_add_key_data(mcast_hash, key, r)) < 0) {
+		rte_free(r);
+		return errno_set(-ret);
+	}
+	if (old != NULL)
+		gr_rcu_defer_free(rte_free, old);
+
+	return 0;
+}
+
+// The route is freed by the hash library once all workers have reported
+// a quiescent state, see mcast_route_free().
+static void mcast_route_remove(const struct mcast_key *key) {
+	rte_hash_del_key(mcast_hash, key);
+}
+
+static void mcast_route_free(void *, void *data) {
+	rte_free(data);
+}
+
+static struct mcast_route *mcast_route_from_api(const struct gr_mcast_route *api) {
+	const struct iface *iif = NULL, *oif;
+	struct mcast_route *r;
+
+	if (api->n_oifs > GR_MCAST_MAX_OIFS)
+		return errno_set_null(ERANGE);
+	if (api->iif_id != GR_IFACE_ID_UNDEF) {
+		if ((iif = iface_from_id(api->iif_id)) == NULL)
+			return NULL;
+		if (iif->vrf_id != api->vrf_id)
+			return errno_set_null(EXDEV);
+	}
+	if ((r = mcast_route_alloc(iif, api->n_oifs)) == NULL)
+		return NULL;
+
+	for (unsigned i = 0; i < api->n_oifs; i++) {
+		if ((oif = iface_from_id(api->oif_ids[i])) == NULL)
+			goto err;
+		switch (oif->type_id) {
+		case GR_IFACE_TYPE_PORT:
+		case GR_IFACE_TYPE_VLAN:
+		case GR_IFACE_TYPE_BOND:
+			break;
+		default:
+			errno = EMEDIUMTYPE;
+			goto err;
+		}
+		if (oif->vrf_id != api->vrf_id) {
+			errno = EXDEV;
+			goto err;
+		}
+		for (unsigned j = 0; j < i; j++) {
+			if (r->oifs[j] == oif) {
+				errno = EEXIST;
+				goto err;
+			}
+		}
+		r->oifs[i] = oif;
+	}
+
+	return r;
+err:
+	rte_free(r);
+	return NULL;
+}
+
+static void mcast_route_to_api(
+	struct gr_mcast_route *api,
+	const struct mcast_key *key,
+	const struct mcast_route *r
+) {
+	api->vrf_id = key->vrf_id;
+	api->family = key->family;
+	api->source = key->source;
+	api->group = key->group;
+	api->iif_id = r->iif != NULL ? r->iif->id : GR_IFACE_ID_UNDEF;
+	api->n_oifs = r->n_oifs;
+	for (unsigned i = 0; i < r->n_oifs; i++)
+		api->oif_ids[i] = r->oifs[i]->id;
+}
+
+// Replace a route with a copy that does not include oif.
+static int mcast_route_prune(
+	const struct mcast_key *key,
+	const struct mcast_route *r,
+	const struct iface *oif
+) {
+	struct mcast_route *new;
+
+	if ((new = mcast_route_alloc(r->iif, r->n_oifs - 1)) == NULL)
+		return -errno;
+	new->n_oifs = 0;
+	for (unsigned i = 0; i < r->n_oifs; i++) {
+		if (r->oifs[i] != oif)
+			new->oifs[new->n_oifs++] = r->oifs[i];
+	}
+
+	return mcast_route_set(key, new);
+}
+
+// Routes received on a removed interface are deleted. Removed outgoing
+// interfaces are pruned from the replication lists. Routes that cannot be
+// pruned are deleted as well.
+static void mcast_iface_event_handler(iface_event_t event, struct iface *iface) {
+	struct mcast_key *keys = NULL;
+	const struct mcast_route *r;
+	const struct mcast_key *key;
+	uint32_t iter = 0;
+	void *data;
+
+	if (event != IFACE_EVENT_PRE_REMOVE)
+		return;
+
+	while (rte_hash_iterate(mcast_hash, (const void **)&key, &data, &iter) >= 0) {
+		r = data;
+		if (r->iif == iface) {
+			arrpush(keys, *key);
+			continue;
+		}
+		for (unsigned i = 0; i < r->n_oifs; i++) {
+			if (r->oifs[i] == iface) {
+				arrpush(keys, *key);
+				break;
+			}
+		}
+	}
+
+	arrforeach (key, keys) {
+		if (rte_hash_lookup_data(mcast_hash, key, &data) < 0)
+			continue;
+		r = data;
+		if (r->iif == iface || mcast_route_prune(key, r, iface) < 0)
+			mcast_route_remove(key);
+	}
+	arrfree(keys);
+}
+
+// API handlers ////////////////////////////////////////////////////////////////
+
+static struct api_out route_add_cb(const void *request, void ** /*response*/) {
+	const struct gr_mcast_route_add_req *req = request;
+	const struct gr_mcast_route *api = &req->route;
+	struct mcast_route *r;
+	struct mcast_key key;
+
+	mcast_key_init(&key, api->vrf_id, api->family, &api->source, &api->group);
+	if (mcast_key_validate(&key) < 0)
+		return api_out(errno, 0);
+	if (rte_hash_lookup(mcast_hash, &key) >= 0 && !req->exist_ok)
+		return api_out(EEXIST, 0);
+	if ((r = mcast_route_from_api(api)) == NULL)
+		return api_out(errno, 0);
+	if (mcast_route_set(&key, r) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out route_del_cb(const void *request, void ** /*response*/) {
+	const struct gr_mcast_route_del_req *req = request;
+	struct mcast_key key;
+
+	mcast_key_init(&key, req->vrf_id, req->family, &req->source, &req->group);
+	if (mcast_key_validate(&key) < 0)
+		return api_out(errno, 0);
+	if (rte_hash_lookup(mcast_hash, &key) < 0) {
+		if (req->missing_ok)
+			return api_out(0, 0);
+		return api_out(ENOENT, 0);
+	}
+	mcast_route_remove(&key);
+
+	return api_out(0, 0);
+}
+
+static struct api_out route_list_cb(const void *request, void **response) {
+	const struct gr_mcast_route_list_req *req = request;
+	struct gr_mcast_route_list_resp *resp;
+	const struct mcast_key *key;
+	uint32_t iter;
+	size_t len, n;
+	void *data;
+
+	n = 0;
+	iter = 0;
+	while (rte_hash_iterate(mcast_hash, (const void **)&key, &data, &iter) >= 0) {
+		if (key->vrf_id == req->vrf_id || req->vrf_id == UINT16_MAX)
+			n++;
+	}
+
+	len = sizeof(*resp) + n * sizeof(*resp->routes);
+	if (len > GR_API_MAX_MSG_LEN)
+		return api_out(EMSGSIZE, 0);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	iter = 0;
+	while (rte_hash_iterate(mcast_hash, (const void **)&key, &data, &iter) >= 0) {
+		if (key->vrf_id != req->vrf_id && req->vrf_id != UINT16_MAX)
+			continue;
+		if (resp->n_routes == n)
+			break;
+		mcast_route_to_api(&resp->routes[resp->n_routes++], key, data);
+	}
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+// module //////////////////////////////////////////////////////////////////////
+
+static void mcast_init(struct event_base *) {
+	struct rte_hash_parameters params = {
+		.name = "mcast_fib",
+		.entries = MCAST_FIB_SIZE,
+		.key_len = sizeof(struct mcast_key),
+		.socket_id = SOCKET_ID_ANY,
+		.extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF
+			| RTE_HASH_EXTRA_FLAGS_TRANS_MEM_SUPPORT,
+	};
+	// With lock-free readers, deleted keys slots and routes can only be
+	// reused after all workers have reported a quiescent state.
+	struct rte_hash_rcu_config rcu = {
+		.v = gr_datapath_rcu(),
+		.mode = RTE_HASH_QSBR_MODE_DQ,
+		.free_key_data_func = mcast_route_free,
+	};
+
+	mcast_hash = rte_hash_create(&params);
+	if (mcast_hash == NULL)
+		ABORT("rte_hash_create(mcast_fib)");
+	if (rte_hash_rcu_qsbr_add(mcast_hash, &rcu) < 0)
+		ABORT("rte_hash_rcu_qsbr_add(mcast_fib): %s", rte_strerror(rte_errno));
+}
+
+static void mcast_fini(struct event_base *) {
+	// routes still in the table are freed with their keys
+	rte_hash_free(mcast_hash);
+	mcast_hash = NULL;
+}
+
+static struct gr_module mcast_module = {
+	.name = "mcast",
+	.init = mcast_init,
+	.fini = mcast_fini,
+	.fini_prio = 1000,
+};
+
+static struct gr_api_handler route_add_handler = {
+	.name = "mcast route add",
+	.request_type = GR_MCAST_ROUTE_ADD,
+	.callback = route_add_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler route_del_handler = {
+	.name = "mcast route del",
+	.request_type = GR_MCAST_ROUTE_DEL,
+	.callback = route_del_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler route_list_handler = {
+	.name = "mcast route list",
+	.request_type = GR_MCAST_ROUTE_LIST,
+	.callback = route_list_cb,
+};
+
+static struct iface_event_handler mcast_iface_event = {
+	.callback = mcast_iface_event_handler,
+};
+
+RTE_INIT(mcast_constructor) {
+	gr_register_api_handler(&route_add_handler);
+	gr_register_api_handler(&route_del_handler);
+	gr_register_api_handler(&route_list_handler);
+	gr_register_module(&mcast_module);
+	iface_event_register_handler(&mcast_iface_event);
+}
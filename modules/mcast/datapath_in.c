@@ -0,0 +1,205 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "mcast_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_graph.h>
+#include <gr_ip4_datapath.h>
+#include <gr_ip6_datapath.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+
+#include <rte_graph_worker.h>
+#include <rte_ip.h>
+#include <rte_ip6.h>
+
+#include <string.h>
+#include <sys/socket.h>
+
+// The input interface is read without knowing the address family.
+GR_MBUF_PRIV_OVERLAP(ip_output_mbuf_data, input_iface, ip6_output_mbuf_data, input_iface);
+
+enum {
+	REPLICATE = 0,
+	NO_ROUTE,
+	RPF_FAIL,
+	TTL_EXCEEDED,
+	EDGE_COUNT,
+};
+
+// Decrement the TTL or hop limit. Return false if the packet must be dropped.
+// No ICMP error is sent in response to multicast packets (RFC 1812 4.3.2.7).
+static inline bool mcast_hop(struct rte_mbuf *m, uint8_t family) {
+	struct rte_ipv6_hdr *ip6;
+	struct rte_ipv4_hdr *ip;
+	rte_be32_t csum;
+
+	if (family == AF_INET) {
+		ip = rte_pktmbuf_mtod(m, struct rte_ipv4_hdr *);
+		if (ip->time_to_live <= 1)
+			return false;
+		ip->time_to_live -= 1;
+		csum = ip->hdr_checksum + RTE_BE16(0x0100);
+		csum += csum >= 0xffff;
+		ip->hdr_checksum = csum;
+	} else {
+		ip6 = rte_pktmbuf_mtod(m, struct rte_ipv6_hdr *);
+		if (ip6->hop_limits <= 1)
+			return false;
+		ip6->hop_limits -= 1;
+	}
+
+	return true;
+}
+
+static inline void mcast_key_from_mbuf(
+	struct mcast_key *key,
+	struct rte_mbuf *m,
+	const struct iface *iface,
+	uint8_t family
+) {
+	const struct rte_ipv6_hdr *ip6;
+	const struct rte_ipv4_hdr *ip;
+
+	memset(key, 0, sizeof(*key));
+	key->vrf_id = iface->vrf_id;
+	key->family = family;
+	if (family == AF_INET) {
+		ip = rte_pktmbuf_mtod(m, const struct rte_ipv4_hdr *);
+		key->source.ip4 = ip->src_addr;
+		key->group.ip4 = ip->dst_addr;
+	} else {
+		ip6 = rte_pktmbuf_mtod(m, const struct rte_ipv6_hdr *);
+		key->source.ip6 = ip6->src_addr;
+		key->group.ip6 = ip6->dst_addr;
+	}
+}
+
+static __rte_always_inline uint16_t mcast_forward_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs,
+	uint8_t family
+) {
+	const struct mcast_route *routes[MCAST_LOOKUP_BULK_MAX];
+	const struct iface *ifaces[MCAST_LOOKUP_BULK_MAX];
+	struct mcast_key keys[MCAST_LOOKUP_BULK_MAX];
+	const struct mcast_route *r;
+	struct mcast_mbuf_data *d;
+	uint16_t i, n, count;
+	struct rte_mbuf *m;
+	rte_edge_t edge;
+
+	for (n = 0; n < nb_objs; n += count) {
+		count = RTE_MIN(nb_objs - n, MCAST_LOOKUP_BULK_MAX);
+
+		for (i = 0; i < count; i++) {
+			m = objs[n + i];
+			gr_mbuf_prefetch_ahead(objs, n + i, nb_objs);
+			ifaces[i] = ip_output_mbuf_data(m)->input_iface;
+			mcast_key_from_mbuf(&keys[i], m, ifaces[i], family);
+		}
+
+		mcast_route_get_bulk(keys, count, routes);
+
+		for (i = 0; i < count; i++) {
+			m = objs[n + i];
+			r = routes[i];
+			if (r == NULL) {
+				edge = NO_ROUTE;
+				goto next;
+			}
+			if (r->iif != NULL && r->iif != ifaces[i]) {
+				edge = RPF_FAIL;
+				goto next;
+			}
+			if (!mcast_hop(m, family)) {
+				edge = TTL_EXCEEDED;
+				goto next;
+			}
+			d = mcast_mbuf_data(m);
+			d->iface = ifaces[i];
+			d->route = r;
+			edge = REPLICATE;
+next:
+			rte_node_enqueue_x1(graph, node, edge, m);
+		}
+	}
+
+	return nb_objs;
+}
+
+static uint16_t ip_mcast_forward_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	return mcast_forward_process(graph, node, objs, nb_objs, AF_INET);
+}
+
+static uint16_t ip6_mcast_forward_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	return mcast_forward_process(graph, node, objs, nb_objs, AF_INET6);
+}
+
+static void ip_mcast_forward_register(void) {
+	ip_input_mcast_register("ip_mcast_forward");
+}
+
+static void ip6_mcast_forward_register(void) {
+	ip6_input_mcast_register("ip6_mcast_forward");
+}
+
+static struct rte_node_register ip_mcast_forward_node = {
+	.name = "ip_mcast_forward",
+
+	.process = ip_mcast_forward_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[REPLICATE] = "mcast_replicate",
+		// without a multicast route, keep the previous behaviour
+		[NO_ROUTE] = "ip_input_local",
+		[RPF_FAIL] = "ip_mcast_forward_rpf_fail",
+		[TTL_EXCEEDED] = "ip_mcast_forward_ttl_exceeded",
+	},
+};
+
+static struct rte_node_register ip6_mcast_forward_node = {
+	.name = "ip6_mcast_forward",
+
+	.process = ip6_mcast_forward_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[REPLICATE] = "mcast_replicate",
+		[NO_ROUTE] = "ip6_input_not_member",
+		[RPF_FAIL] = "ip6_mcast_forward_rpf_fail",
+		[TTL_EXCEEDED] = "ip6_mcast_forward_ttl_exceeded",
+	},
+};
+
+static struct gr_node_info ip_mcast_forward_info = {
+	.node = &ip_mcast_forward_node,
+	.register_callback = ip_mcast_forward_register,
+};
+
+static struct gr_node_info ip6_mcast_forward_info = {
+	.node = &ip6_mcast_forward_node,
+	.register_callback = ip6_mcast_forward_register,
+};
+
+GR_NODE_REGISTER(ip_mcast_forward_info);
+GR_NODE_REGISTER(ip6_mcast_forward_info);
+
+GR_DROP_REGISTER(ip_mcast_forward_rpf_fail);
+GR_DROP_REGISTER(ip_mcast_forward_ttl_exceeded);
+GR_DROP_REGISTER(ip6_mcast_forward_rpf_fail);
+GR_DROP_REGISTER(ip6_mcast_forward_ttl_exceeded);
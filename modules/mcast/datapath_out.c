@@ -0,0 +1,225 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "mcast_priv.h"
+
+#include <gr_bond.h>
+#include <gr_datapath.h>
+#include <gr_eth_output.h>
+#include <gr_graph.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+#include <gr_mempool.h>
+#include <gr_port.h>
+#include <gr_vlan.h>
+
+#include <rte_ether.h>
+#include <rte_graph_worker.h>
+#include <rte_ip.h>
+#include <rte_ip6.h>
+#include <rte_mbuf.h>
+
+#include <string.h>
+
+enum {
+	OUTPUT = 0,
+	NO_OIF,
+	EDGE_COUNT,
+};
+
+// Header mbufs and indirect mbufs are allocated from this pool.
+#define MCAST_POOL_SIZE (RTE_GRAPH_BURST_SIZE * 8)
+// Below this size, copying the whole packet is cheaper than attaching the
+// payload to another mbuf.
+#define MCAST_COPY_MAX 128
+
+// Chained mbufs can only be sent on ports that have multi segments enabled.
+static inline bool oif_multi_segs(const struct iface *oif) {
+	const struct iface_info_bond *bond;
+	const struct iface_info_vlan *vlan;
+	const struct iface_info_port *port;
+
+	switch (oif->type_id) {
+	case GR_IFACE_TYPE_PORT:
+		port = (const struct iface_info_port *)oif->info;
+		return port->tx_offloads & RTE_ETH_TX_OFFLOAD_MULTI_SEGS;
+	case GR_IFACE_TYPE_VLAN:
+		vlan = (const struct iface_info_vlan *)oif->info;
+		port = (const struct iface_info_port *)vlan->parent->info;
+		return port->tx_offloads & RTE_ETH_TX_OFFLOAD_MULTI_SEGS;
+	case GR_IFACE_TYPE_BOND:
+		bond = (const struct iface_info_bond *)oif->info;
+		return bond->tx_offloads & RTE_ETH_TX_OFFLOAD_MULTI_SEGS;
+	}
+
+	return false;
+}
+
+// Build a copy of the packet with its own L3 header. The header is written in
+// a new mbuf which is chained to a clone of the payload. The packet data is
+// shared between all copies and is never modified.
+static struct rte_mbuf *
+mcast_copy(struct rte_mempool *pool, struct rte_mbuf *m, uint16_t l3_len, bool zero_copy) {
+	struct rte_mbuf *h, *c;
+
+	if (!zero_copy)
+		return rte_pktmbuf_copy(m, pool, 0, UINT32_MAX);
+
+	if ((h = rte_pktmbuf_alloc(pool)) == NULL)
+		return NULL;
+	if ((c = rte_pktmbuf_clone(m, pool)) == NULL)
+		goto err;
+	rte_pktmbuf_adj(c, l3_len);
+	memcpy(rte_pktmbuf_append(h, l3_len), rte_pktmbuf_mtod(m, void *), l3_len);
+	if (rte_pktmbuf_chain(h, c) < 0) {
+		rte_pktmbuf_free(c);
+		goto err;
+	}
+	h->hash = m->hash;
+	h->packet_type = m->packet_type;
+
+	return h;
+err:
+	rte_pktmbuf_free(h);
+	return NULL;
+}
+
+static inline void
+mcast_eth_dst(struct rte_mbuf *m, struct rte_ether_addr *dst, rte_be16_t *type) {
+	const struct rte_ipv6_hdr *ip6;
+	const struct rte_ipv4_hdr *ip;
+	uint32_t group;
+
+	ip = rte_pktmbuf_mtod(m, const struct rte_ipv4_hdr *);
+	if ((ip->version_ihl >> 4) == 4) {
+		// RFC 1112 6.4: 01:00:5e + low-order 23 bits of the group
+		group = rte_be_to_cpu_32(ip->dst_addr);
+		dst->addr_bytes[0] = 0x01;
+		dst->addr_bytes[1] = 0x00;
+		dst->addr_bytes[2] = 0x5e;
+		dst->addr_bytes[3] = (group >> 16) & 0x7f;
+		dst->addr_bytes[4] = (group >> 8) & 0xff;
+		dst->addr_bytes[5] = group & 0xff;
+		*type = RTE_BE16(RTE_ETHER_TYPE_IPV4);
+	} else {
+		ip6 = rte_pktmbuf_mtod(m, const struct rte_ipv6_hdr *);
+		rte_ether_mcast_from_ipv6(dst, &ip6->dst_addr);
+		*type = RTE_BE16(RTE_ETHER_TYPE_IPV6);
+	}
+}
+
+static inline uint16_t mcast_l3_len(struct rte_mbuf *m) {
+	const struct rte_ipv4_hdr *ip = rte_pktmbuf_mtod(m, const struct rte_ipv4_hdr *);
+
+	if ((ip->version_ihl >> 4) == 4)
+		return rte_ipv4_hdr_len(ip);
+	// extension headers are not modified, they are part of the shared payload
+	return sizeof(struct rte_ipv6_hdr);
+}
+
+static inline void mcast_output(
+	struct rte_mbuf *m,
+	const struct iface *oif,
+	const struct rte_ether_addr *dst,
+	rte_be16_t ether_type
+) {
+	struct eth_output_mbuf_data *o = eth_output_mbuf_data(m);
+
+	o->iface = oif;
+	o->dst = *dst;
+	o->ether_type = ether_type;
+	// no rewrite cache, the destination depends on the group
+	o->l2 = NULL;
+}
+
+// Send the packet on every outgoing interface of its route but the input one.
+// The last interface gets the original packet. Its ethernet header is
+// prepended in the headroom of the first segment, which is not referenced by
+// the other copies. When no mbuf is available, the remaining interfaces are
+// skipped.
+static uint16_t mcast_replicate_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	struct rte_mempool *pool = node->ctx_ptr;
+	const struct iface *input, *oif, *last;
+	const struct mcast_route *r;
+	struct rte_ether_addr dst;
+	struct rte_mbuf *m, *c;
+	rte_be16_t ether_type;
+	uint16_t l3_len;
+	bool shared;
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		m = objs[i];
+		gr_mbuf_prefetch_ahead(objs, i, nb_objs);
+		input = mcast_mbuf_data(m)->iface;
+		r = mcast_mbuf_data(m)->route;
+		l3_len = mcast_l3_len(m);
+		mcast_eth_dst(m, &dst, &ether_type);
+		// the first segment must also hold more than the L3 header
+		shared = rte_pktmbuf_pkt_len(m) > MCAST_COPY_MAX && m->data_len > l3_len;
+		last = NULL;
+
+		for (uint16_t j = 0; j < r->n_oifs; j++) {
+			oif = r->oifs[j];
+			if (oif == input)
+				continue;
+			if (last != NULL) {
+				c = mcast_copy(pool, m, l3_len, shared && oif_multi_segs(last));
+				if (c == NULL)
+					break;
+				mcast_output(c, last, &dst, ether_type);
+				rte_node_enqueue_x1(graph, node, OUTPUT, c);
+			}
+			last = oif;
+		}
+
+		if (last == NULL) {
+			rte_node_enqueue_x1(graph, node, NO_OIF, m);
+			continue;
+		}
+		mcast_output(m, last, &dst, ether_type);
+		rte_node_enqueue_x1(graph, node, OUTPUT, m);
+	}
+
+	return nb_objs;
+}
+
+static int mcast_replicate_init(const struct rte_graph *graph, struct rte_node *node) {
+	node->ctx_ptr = gr_pktmbuf_pool_get(graph->socket, MCAST_POOL_SIZE);
+
+	if (node->ctx_ptr == NULL)
+		return errno_log(errno, "gr_pktmbuf_pool_get(mcast_replicate)");
+
+	return 0;
+}
+
+static void mcast_replicate_fini(const struct rte_graph *, struct rte_node *node) {
+	gr_pktmbuf_pool_release(node->ctx_ptr, MCAST_POOL_SIZE);
+	node->ctx_ptr = NULL;
+}
+
+static struct rte_node_register mcast_replicate_node = {
+	.name = "mcast_replicate",
+
+	.process = mcast_replicate_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[OUTPUT] = "eth_output",
+		[NO_OIF] = "mcast_replicate_no_oif",
+	},
+	.init = mcast_replicate_init,
+	.fini = mcast_replicate_fini,
+};
+
+static struct gr_node_info mcast_replicate_info = {
+	.node = &mcast_replicate_node,
+};
+
+GR_NODE_REGISTER(mcast_replicate_info);
+
+GR_DROP_REGISTER(mcast_replicate_no_oif);
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_API_MCAST
+#define _GR_API_MCAST
+
+#include <gr_api.h>
+#include <gr_infra.h>
+#include <gr_net_types.h>
+
+#include <stdint.h>
+
+#define GR_MCAST_MODULE 0x3ca5
+
+// Replication list size of a multicast route.
+#define GR_MCAST_MAX_OIFS 32
+
+union gr_mcast_addr {
+	ip4_addr_t ip4;
+	struct rte_ipv6_addr ip6;
+};
+
+// Packets received on iif and sent to group by source are replicated on all
+// oifs. Routes with a zero source address match any source (*,G). Specific
+// (S,G) routes are preferred.
+struct gr_mcast_route {
+	uint16_t vrf_id;
+	uint8_t family; // AF_INET or AF_INET6
+	union gr_mcast_addr source; // zero for any source
+	union gr_mcast_addr group;
+	uint16_t iif_id; // expected input interface, GR_IFACE_ID_UNDEF for any
+	uint16_t n_oifs;
+	// GR_IFACE_TYPE_PORT, GR_IFACE_TYPE_VLAN or GR_IFACE_TYPE_BOND interfaces
+	uint16_t oif_ids[GR_MCAST_MAX_OIFS];
+};
+
+#define GR_MCAST_ROUTE_ADD REQUEST_TYPE(GR_MCAST_MODULE, 0x0001)
+
+struct gr_mcast_route_add_req {
+	struct gr_mcast_route route;
+	uint8_t exist_ok; // replace the existing route
+};
+
+// struct gr_mcast_route_add_resp { };
+
+#define GR_MCAST_ROUTE_DEL REQUEST_TYPE(GR_MCAST_MODULE, 0x0002)
+
+struct gr_mcast_route_del_req {
+	uint16_t vrf_id;
+	uint8_t family;
+	union gr_mcast_addr source;
+	union gr_mcast_addr group;
+	uint8_t missing_ok;
+};
+
+// struct gr_mcast_route_del_resp { };
+
+#define GR_MCAST_ROUTE_LIST REQUEST_TYPE(GR_MCAST_MODULE, 0x0003)
+
+struct gr_mcast_route_list_req {
+	uint16_t vrf_id; // UINT16_MAX for all
+};
+
+struct gr_mcast_route_list_resp {
+	uint16_t n_routes;
+	struct gr_mcast_route routes[/* n_routes */];
+};
+
+#endif
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _MCAST_PRIV_H
+#define _MCAST_PRIV_H
+
+#include <gr_iface.h>
+#include <gr_mbuf.h>
+#include <gr_mcast.h>
+
+#include <rte_hash.h>
+
+#include <stdint.h>
+
+struct mcast_key {
+	union gr_mcast_addr group;
+	union gr_mcast_addr source; // zero for (*,G) routes
+	uint16_t vrf_id;
+	uint8_t family;
+	uint8_t reserved; // must be zero
+};
+
+static_assert(sizeof(struct mcast_key) == 36);
+
+// Routes are never modified once inserted in the table. Updates replace the
+// whole route, the previous one is freed after all workers are done with it.
+struct mcast_route {
+	const struct iface *iif; // NULL for any
+	uint16_t n_oifs;
+	const struct iface *oifs[/* n_oifs */];
+};
+
+#define MCAST_FIB_SIZE (1 << 14)
+// Two lookups per packet, (S,G) then (*,G).
+#define MCAST_LOOKUP_BULK_MAX (RTE_HASH_LOOKUP_BULK_MAX / 2)
+
+// Lookup the most specific route, (S,G) or (*,G), of up to MCAST_LOOKUP_BULK_MAX
+// keys at once. Unknown ones are NULL.
+void mcast_route_get_bulk(
+	const struct mcast_key *keys,
+	unsigned n,
+	const struct mcast_route **routes
+);
+
+GR_MBUF_PRIV_DATA_TYPE(mcast_mbuf_data, {
+	const struct iface *iface; // input interface
+	const struct mcast_route *route;
+});
+
+#endif
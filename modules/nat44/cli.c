@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_cli_iface.h>
+#include <gr_nat44.h>
+#include <gr_net_types.h>
+#include <gr_table.h>
+
+#include <ecoli.h>
+#include <libsmartcols.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static cmd_status_t pool_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_nat44_pool_add_req req = {.exist_ok = true};
+	struct gr_nat44_pool *pool = &req.pool;
+	struct gr_iface iface;
+	const char *max;
+
+	if (iface_from_name(c, arg_str(p, "IFACE"), &iface) < 0)
+		return CMD_ERROR;
+	pool->iface_id = iface.id;
+	if (ip4_net_parse(arg_str(p, "INSIDE"), &pool->inside, true) < 0)
+		return CMD_ERROR;
+	if (inet_pton(AF_INET, arg_str(p, "MIN"), &pool->addr_min) != 1) {
+		errno = EINVAL;
+		return CMD_ERROR;
+	}
+	pool->addr_max = pool->addr_min;
+	if ((max = arg_str(p, "MAX")) != NULL && inet_pton(AF_INET, max, &pool->addr_max) != 1) {
+		errno = EINVAL;
+		return CMD_ERROR;
+	}
+
+	if (gr_api_client_send_recv(c, GR_NAT44_POOL_ADD, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t pool_del(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_nat44_pool_del_req req = {.missing_ok = true};
+	struct gr_iface iface;
+
+	if (iface_from_name(c, arg_str(p, "IFACE"), &iface) < 0)
+		return CMD_ERROR;
+	req.iface_id = iface.id;
+
+	if (gr_api_client_send_recv(c, GR_NAT44_POOL_DEL, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t pool_list(const struct gr_api_client *c, const struct ec_pnode *) {
+	struct libscols_table *table = scols_new_table();
+	const struct gr_nat44_pool_list_resp *resp;
+	struct gr_iface iface;
+	void *resp_ptr = NULL;
+	char buf[BUFSIZ];
+
+	if (table == NULL)
+		return CMD_ERROR;
+	if (gr_api_client_send_recv(c, GR_NAT44_POOL_LIST, 0, NULL, &resp_ptr) < 0) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+
+	resp = resp_ptr;
+
+	scols_table_new_column(table, "IFACE", 0, 0);
+	scols_table_new_column(table, "INSIDE", 0, 0);
+	scols_table_new_column(table, "ADDRESSES", 0, 0);
+	scols_table_new_column(table, "BLOCKS", 0, 0);
+	scols_table_new_column(table, "USED", 0, 0);
+	scols_table_new_column(table, "SESSIONS", 0, 0);
+	scols_table_set_column_separator(table, "  ");
+
+	for (size_t i = 0; i < resp->n_pools; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_nat44_pool_status *st = &resp->pools[i];
+
+		if (iface_from_id(c, st->pool.iface_id, &iface) == 0)
+			scols_line_sprintf(line, 0, "%s", iface.name);
+		else
+			scols_line_sprintf(line, 0, "%u", st->pool.iface_id);
+		ip4_net_format(&st->pool.inside, buf, sizeof(buf));
+		scols_line_set_data(line, 1, buf);
+		scols_line_sprintf(
+			line,
+			2,
+			IP4_ADDR_FMT "-" IP4_ADDR_FMT,
+			IP4_ADDR_SPLIT(&st->pool.addr_min),
+			IP4_ADDR_SPLIT(&st->pool.addr_max)
+		);
+		scols_line_sprintf(line, 3, "%u", st->blocks_total);
+		scols_line_sprintf(line, 4, "%u", st->blocks_used);
+		scols_line_sprintf(line, 5, "%" PRIu64, st->sessions);
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+#define IFACE_ARG                                                                                  \
+	with_help("Outside interface name.", ec_node_dyn("IFACE", complete_iface_names, NULL))
+
+#define NAT44_CTX(root, ctx, help) CLI_CONTEXT(root, ctx, CTX_ARG("nat44", help))
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		NAT44_CTX(root, CTX_ADD, "Create source NAT elements."),
+		"pool IFACE inside INSIDE addr MIN [to MAX]",
+		pool_add,
+		"Add or replace the source NAT pool of an outside interface.",
+		IFACE_ARG,
+		with_help("Translated source network.", ec_node_re("INSIDE", IPV4_NET_RE)),
+		with_help("First outside address.", ec_node_re("MIN", IPV4_RE)),
+		with_help("Last outside address.", ec_node_re("MAX", IPV4_RE))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		NAT44_CTX(root, CTX_DEL, "Delete source NAT elements."),
+		"pool IFACE",
+		pool_del,
+		"Delete the source NAT pool of an outside interface.",
+		IFACE_ARG
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		NAT44_CTX(root, CTX_SHOW, "Show source NAT details."),
+		"pool",
+		pool_list,
+		"List source NAT pools and their usage."
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "nat44",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+}
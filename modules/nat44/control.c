@@ -0,0 +1,424 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_nat44.h"
+#include "nat44_priv.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_log.h>
+#include <gr_macro.h>
+#include <gr_net_types.h>
+#include <gr_rcu.h>
+#include <gr_stb_ds.h>
+#include <gr_worker.h>
+
+#include <event2/event.h>
+#include <rte_errno.h>
+#include <rte_hash.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_ring.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NAT44_EVENTS_RING_SIZE 4096
+
+struct nat44_worker *nat44_workers[RTE_MAX_LCORE];
+
+// Configured pools, indexed by outside interface ID.
+static struct nat44_pool *pools[MAX_IFACES];
+// Replaced and deleted pools, freed once no block is allocated anymore.
+static struct nat44_pool **dead_pools;
+static uint16_t pool_id;
+static struct event *events_timer;
+
+// workers /////////////////////////////////////////////////////////////////////
+
+static void nat44_worker_free(struct nat44_worker *w) {
+	if (w == NULL)
+		return;
+	rte_hash_free(w->sessions);
+	rte_hash_free(w->subscribers);
+	rte_free(w->slots);
+	rte_free(w->blocks);
+	rte_free(w);
+}
+
+static struct nat44_worker *nat44_worker_alloc(unsigned lcore_id) {
+	int socket_id = rte_lcore_to_socket_id(lcore_id);
+	char sessions_name[RTE_HASH_NAMESIZE];
+	char subscribers_name[RTE_HASH_NAMESIZE];
+	struct rte_hash_parameters sessions = {
+		.name = sessions_name,
+		.entries = 2 * NAT44_MAX_SESSIONS, // OUT and IN keys
+		.key_len = sizeof(struct nat44_key),
+		.socket_id = socket_id,
+		// sessions are looked up by other workers to translate replies
+		.extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF,
+	};
+	struct rte_hash_parameters subscribers = {
+		.name = subscribers_name,
+		.entries = NAT44_MAX_SUBSCRIBERS,
+		.key_len = sizeof(struct nat44_subscriber_key),
+		.socket_id = socket_id,
+	};
+	// Deleted key slots, and their session, can only be reused after all
+	// workers have reported a quiescent state.
+	struct rte_hash_rcu_config rcu = {
+		.v = gr_datapath_rcu(),
+		.mode = RTE_HASH_QSBR_MODE_DQ,
+	};
+	struct nat44_worker *w;
+
+	snprintf(sessions_name, sizeof(sessions_name), "nat44_sessions_%u", lcore_id);
+	snprintf(subscribers_name, sizeof(subscribers_name), "nat44_subscribers_%u", lcore_id);
+
+	if ((w = rte_zmalloc_socket(__func__, sizeof(*w), RTE_CACHE_LINE_SIZE, socket_id)) == NULL)
+		return errno_set_null(ENOMEM);
+	for (unsigned i = 0; i < ARRAY_DIM(w->wheel); i++)
+		w->wheel[i] = NAT44_NO_SESSION;
+
+	if ((w->sessions = rte_hash_create(&sessions)) == NULL)
+		goto err;
+	if (rte_hash_rcu_qsbr_add(w->sessions, &rcu) < 0)
+		goto err;
+	if ((w->subscribers = rte_hash_create(&subscribers)) == NULL)
+		goto err;
+
+	w->slots = rte_calloc_socket(
+		__func__,
+		rte_hash_max_key_id(w->sessions) + 1,
+		sizeof(*w->slots),
+		RTE_CACHE_LINE_SIZE,
+		socket_id
+	);
+	w->blocks = rte_calloc_socket(
+		__func__,
+		rte_hash_max_key_id(w->subscribers) + 1,
+		sizeof(*w->blocks),
+		RTE_CACHE_LINE_SIZE,
+		socket_id
+	);
+	if (w->slots == NULL || w->blocks == NULL) {
+		rte_errno = ENOMEM;
+		goto err;
+	}
+
+	return w;
+err:
+	LOG(ERR, "nat44 worker %u: %s", lcore_id, rte_strerror(rte_errno));
+	nat44_worker_free(w);
+	return errno_set_null(rte_errno);
+}
+
+static int nat44_workers_alloc_all(void) {
+	struct worker *worker;
+
+	STAILQ_FOREACH (worker, &workers, next) {
+		unsigned lcore_id = worker->lcore_id;
+
+		if (nat44_workers[lcore_id] != NULL)
+			continue;
+		if ((nat44_workers[lcore_id] = nat44_worker_alloc(lcore_id)) == NULL)
+			return -errno;
+	}
+
+	return 0;
+}
+
+int nat44_workers_alloc(void) {
+	// the session tables are large, only allocate them when needed
+	for (unsigned i = 0; i < ARRAY_DIM(pools); i++) {
+		if (pools[i] != NULL)
+			return nat44_workers_alloc_all();
+	}
+	return 0;
+}
+
+// pools ///////////////////////////////////////////////////////////////////////
+
+static void nat44_pool_free(struct nat44_pool *pool) {
+	rte_ring_free(pool->free_blocks);
+	rte_ring_free(pool->events);
+	rte_free(pool);
+}
+
+static struct nat44_pool *nat44_pool_alloc(const struct gr_nat44_pool *api) {
+	uint32_t n_addrs = rte_be_to_cpu_32(api->addr_max) - rte_be_to_cpu_32(api->addr_min) + 1;
+	uint32_t n_blocks = n_addrs * NAT44_BLOCKS_PER_ADDR;
+	char name[RTE_RING_NAMESIZE];
+	struct nat44_pool *pool;
+
+	pool = rte_zmalloc(__func__, sizeof(*pool) + n_blocks * sizeof(*pool->owners), 0);
+	if (pool == NULL)
+		return errno_set_null(ENOMEM);
+
+	// never zero, zeroed subscriber and session keys do not match any pool
+	if (++pool_id == 0)
+		pool_id = 1;
+	pool->id = pool_id;
+	pool->iface_id = api->iface_id;
+	pool->inside = api->inside;
+	pool->inside_mask = pool->inside.prefixlen == 0
+		? 0
+		: rte_cpu_to_be_32(UINT32_MAX << (32 - pool->inside.prefixlen));
+	pool->inside.ip &= pool->inside_mask;
+	pool->addr_min = rte_be_to_cpu_32(api->addr_min);
+	pool->addr_max = rte_be_to_cpu_32(api->addr_max);
+	pool->n_blocks = n_blocks;
+	pool->refcnt = 1;
+
+	snprintf(name, sizeof(name), "nat44_blocks_%u", pool->id);
+	pool->free_blocks = rte_ring_create_elem(
+		name, sizeof(uint32_t), rte_align32pow2(n_blocks + 1), SOCKET_ID_ANY, 0
+	);
+	snprintf(name, sizeof(name), "nat44_events_%u", pool->id);
+	pool->events = rte_ring_create_elem(
+		name,
+		sizeof(struct nat44_event),
+		NAT44_EVENTS_RING_SIZE,
+		SOCKET_ID_ANY,
+		RING_F_MP_RTS_ENQ | RING_F_SC_DEQ
+	);
+	if (pool->free_blocks == NULL || pool->events == NULL) {
+		errno = rte_errno;
+		nat44_pool_free(pool);
+		return NULL;
+	}
+	// consecutive subscribers get blocks of consecutive addresses
+	for (uint32_t b = 0; b < NAT44_BLOCKS_PER_ADDR; b++) {
+		for (uint32_t a = 0; a < n_addrs; a++) {
+			uint32_t index = a * NAT44_BLOCKS_PER_ADDR + b;
+			rte_ring_enqueue_elem(pool->free_blocks, &index, sizeof(index));
+		}
+	}
+
+	return pool;
+}
+
+static void nat44_pool_log_events(struct nat44_pool *pool) {
+	const struct iface *iface = iface_from_id(pool->iface_id);
+	uint64_t lost = __atomic_exchange_n(&pool->events_lost, 0, __ATOMIC_RELAXED);
+	struct nat44_event ev;
+	ip4_addr_t addr;
+	rte_be16_t port;
+
+	while (rte_ring_dequeue_elem(pool->events, &ev, sizeof(ev)) == 0) {
+		nat44_block_addr_port(pool, ev.block, 0, &addr, &port);
+		LOG(INFO,
+		    "%s: " IP4_ADDR_FMT " %s " IP4_ADDR_FMT " ports %u-%u",
+		    iface ? iface->name : "[deleted]",
+		    IP4_ADDR_SPLIT(&ev.subscriber),
+		    ev.alloc ? "->" : "released",
+		    IP4_ADDR_SPLIT(&addr),
+		    rte_be_to_cpu_16(port),
+		    rte_be_to_cpu_16(port) + GR_NAT44_BLOCK_SIZE - 1);
+	}
+	if (lost > 0)
+		LOG(WARNING, "%" PRIu64 " port block events not logged", lost);
+}
+
+// Drop the configuration reference. Called once workers cannot see the pool
+// through its interface anymore.
+static void nat44_pool_release(void *obj) {
+	struct nat44_pool *pool = obj;
+
+	__atomic_fetch_sub(&pool->refcnt, 1, __ATOMIC_RELEASE);
+	arrpush(dead_pools, pool);
+}
+
+static void nat44_pool_set(struct iface *iface, struct nat44_pool *pool) {
+	struct nat44_pool *old = pools[iface->id];
+
+	pools[iface->id] = pool;
+	__atomic_store_n(&iface->nat44, pool, __ATOMIC_RELEASE);
+	if (old != NULL)
+		gr_rcu_defer_free(nat44_pool_release, old);
+}
+
+static void nat44_events_cb(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	for (unsigned i = 0; i < ARRAY_DIM(pools); i++) {
+		if (pools[i] != NULL)
+			nat44_pool_log_events(pools[i]);
+	}
+	for (int i = arrlen(dead_pools) - 1; i >= 0; i--) {
+		nat44_pool_log_events(dead_pools[i]);
+		if (__atomic_load_n(&dead_pools[i]->refcnt, __ATOMIC_ACQUIRE) == 0) {
+			nat44_pool_free(dead_pools[i]);
+			arrdelswap(dead_pools, i);
+		}
+	}
+}
+
+// API handlers ////////////////////////////////////////////////////////////////
+
+static struct api_out pool_add_cb(const void *request, void ** /*response*/) {
+	const struct gr_nat44_pool_add_req *req = request;
+	const struct gr_nat44_pool *api = &req->pool;
+	struct nat44_pool *pool;
+	struct iface *iface;
+	uint32_t min, max;
+
+	if ((iface = iface_from_id(api->iface_id)) == NULL)
+		return api_out(errno, 0);
+	if (pools[iface->id] != NULL && !req->exist_ok)
+		return api_out(EEXIST, 0);
+	if (api->inside.prefixlen > 32)
+		return api_out(EINVAL, 0);
+	min = rte_be_to_cpu_32(api->addr_min);
+	max = rte_be_to_cpu_32(api->addr_max);
+	if (min == 0 || min > max)
+		return api_out(EINVAL, 0);
+	if (max - min >= GR_NAT44_MAX_ADDRS)
+		return api_out(ERANGE, 0);
+	for (unsigned i = 0; i < ARRAY_DIM(pools); i++) {
+		// replies must only match one pool
+		if (i != iface->id && pools[i] != NULL && min <= pools[i]->addr_max
+		    && max >= pools[i]->addr_min)
+			return api_out(EADDRINUSE, 0);
+	}
+
+	// allocate the worker states before the pool becomes visible
+	if (nat44_workers_alloc_all() < 0)
+		return api_out(errno, 0);
+	if ((pool = nat44_pool_alloc(api)) == NULL)
+		return api_out(errno, 0);
+	nat44_pool_set(iface, pool);
+
+	LOG(INFO,
+	    "%s: nat44 pool " IP4_ADDR_FMT "-" IP4_ADDR_FMT ", %u port blocks",
+	    iface->name,
+	    IP4_ADDR_SPLIT(&api->addr_min),
+	    IP4_ADDR_SPLIT(&api->addr_max),
+	    pool->n_blocks);
+
+	return api_out(0, 0);
+}
+
+static struct api_out pool_del_cb(const void *request, void ** /*response*/) {
+	const struct gr_nat44_pool_del_req *req = request;
+	struct iface *iface;
+
+	if ((iface = iface_from_id(req->iface_id)) == NULL)
+		return api_out(errno, 0);
+	if (pools[iface->id] == NULL)
+		return api_out(req->missing_ok ? 0 : ENOENT, 0);
+
+	// existing sessions are aged out by their worker
+	nat44_pool_set(iface, NULL);
+
+	return api_out(0, 0);
+}
+
+static struct api_out pool_list_cb(const void * /*request*/, void **response) {
+	struct gr_nat44_pool_list_resp *resp;
+	struct gr_nat44_pool_status *st;
+	const struct nat44_pool *pool;
+	size_t len, n = 0;
+
+	for (unsigned i = 0; i < ARRAY_DIM(pools); i++)
+		n += pools[i] != NULL;
+
+	len = sizeof(*resp) + n * sizeof(*resp->pools);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	for (unsigned i = 0; i < ARRAY_DIM(pools); i++) {
+		if ((pool = pools[i]) == NULL)
+			continue;
+		st = &resp->pools[resp->n_pools++];
+		st->pool.iface_id = pool->iface_id;
+		st->pool.inside = pool->inside;
+		st->pool.addr_min = rte_cpu_to_be_32(pool->addr_min);
+		st->pool.addr_max = rte_cpu_to_be_32(pool->addr_max);
+		st->blocks_total = pool->n_blocks;
+		st->blocks_used = pool->n_blocks - rte_ring_count(pool->free_blocks);
+		for (unsigned l = 0; l < RTE_MAX_LCORE; l++)
+			st->sessions += __atomic_load_n(&pool->sessions[l], __ATOMIC_RELAXED);
+	}
+
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+// module //////////////////////////////////////////////////////////////////////
+
+static void nat44_iface_event_handler(iface_event_t event, struct iface *iface) {
+	if (event == IFACE_EVENT_PRE_REMOVE && pools[iface->id] != NULL)
+		nat44_pool_set(iface, NULL);
+}
+
+static void nat44_init(struct event_base *ev_base) {
+	struct timeval tv = {.tv_sec = 1};
+
+	events_timer = gr_event_new(ev_base, -1, EV_PERSIST | EV_FINALIZE, nat44_events_cb, NULL);
+	if (events_timer == NULL)
+		ABORT("gr_event_new() failed");
+	if (event_add(events_timer, &tv) < 0)
+		ABORT("event_add() failed");
+}
+
+static void nat44_fini(struct event_base *) {
+	struct nat44_pool **pool;
+
+	gr_event_free(events_timer);
+	events_timer = NULL;
+
+	// workers are stopped, blocks do not need to be released
+	for (unsigned i = 0; i < ARRAY_DIM(pools); i++) {
+		if (pools[i] != NULL)
+			nat44_pool_free(pools[i]);
+		pools[i] = NULL;
+	}
+	arrforeach (pool, dead_pools)
+		nat44_pool_free(*pool);
+	arrfree(dead_pools);
+	for (unsigned i = 0; i < ARRAY_DIM(nat44_workers); i++) {
+		nat44_worker_free(nat44_workers[i]);
+		nat44_workers[i] = NULL;
+	}
+}
+
+static struct gr_module nat44_module = {
+	.name = "nat44",
+	.init = nat44_init,
+	.fini = nat44_fini,
+	.fini_prio = 1000,
+};
+
+static struct gr_api_handler pool_add_handler = {
+	.name = "nat44 pool add",
+	.request_type = GR_NAT44_POOL_ADD,
+	.callback = pool_add_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler pool_del_handler = {
+	.name = "nat44 pool del",
+	.request_type = GR_NAT44_POOL_DEL,
+	.callback = pool_del_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler pool_list_handler = {
+	.name = "nat44 pool list",
+	.request_type = GR_NAT44_POOL_LIST,
+	.callback = pool_list_cb,
+};
+
+static struct iface_event_handler nat44_iface_event = {
+	.callback = nat44_iface_event_handler,
+};
+
+RTE_INIT(nat44_constructor) {
+	gr_register_api_handler(&pool_add_handler);
+	gr_register_api_handler(&pool_del_handler);
+	gr_register_api_handler(&pool_list_handler);
+	gr_register_module(&nat44_module);
+	iface_event_register_handler(&nat44_iface_event);
+}
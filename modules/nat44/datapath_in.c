@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "nat44_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_feature.h>
+#include <gr_graph.h>
+#include <gr_iface.h>
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_mbuf.h>
+
+#include <rte_graph_worker.h>
+#include <rte_hash.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+
+enum {
+	FORWARD = 0,
+	LOCAL,
+	NO_ROUTE,
+	EDGE_COUNT,
+};
+
+static uint8_t features_row;
+
+// Same decision as ip_input for the (translated) destination.
+static inline rte_edge_t
+input_edge(const struct iface *iface, const struct nexthop *nh, ip4_addr_t dst) {
+	rte_edge_t edge;
+
+	if (nh == NULL)
+		return NO_ROUTE;
+	edge = gr_feature_arc_edge(
+		&ip4_input_features,
+		features_row,
+		gr_feature_enabled(&ip4_input_features, iface->id)
+	);
+	if (edge != RTE_EDGE_ID_INVALID)
+		return edge;
+	if (nh->flags & GR_IP4_NH_F_LOCAL && dst == nh->ip)
+		return LOCAL;
+	return FORWARD;
+}
+
+// Return the state of the worker that owns the session of a reply, NULL if
+// the destination does not belong to the pool.
+static inline struct nat44_worker *
+reply_owner(const struct nat44_pool *pool, const struct nat44_key *key) {
+	uint32_t block = nat44_block_index(pool, key->dst, key->dport);
+
+	if (block >= pool->n_blocks)
+		return NULL;
+
+	return nat44_workers[__atomic_load_n(&pool->owners[block], __ATOMIC_RELAXED)];
+}
+
+// Translate the destination of replies received on outside interfaces. The
+// session is looked up in the table of the worker that created it, replies
+// with the same owner are looked up in bulk. Other packets are not modified.
+static uint16_t
+nat44_in_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct nat44_worker *owners[RTE_HASH_LOOKUP_BULK_MAX];
+	struct nat44_key keys[RTE_HASH_LOOKUP_BULK_MAX];
+	const void *key_ptrs[RTE_HASH_LOOKUP_BULK_MAX];
+	void *sessions[RTE_HASH_LOOKUP_BULK_MAX];
+	struct nat44_l4 l4s[RTE_HASH_LOOKUP_BULK_MAX];
+	struct nat44_worker *w = nat44_workers[rte_lcore_id()];
+	struct ip_output_mbuf_data *d;
+	const struct nat44_pool *pool;
+	struct nat44_session *s;
+	struct rte_ipv4_hdr *ip;
+	uint16_t i, j, n, count;
+	struct rte_mbuf *m;
+	uint64_t hits;
+	uint32_t now;
+
+	now = nat44_now();
+	if (w != NULL)
+		nat44_age(w, now);
+
+	for (n = 0; n < nb_objs; n += count) {
+		count = RTE_MIN(nb_objs - n, RTE_HASH_LOOKUP_BULK_MAX);
+
+		for (i = 0; i < count; i++) {
+			m = objs[n + i];
+			gr_mbuf_prefetch_ahead(objs, n + i, nb_objs);
+			ip = rte_pktmbuf_mtod(m, struct rte_ipv4_hdr *);
+			pool = __atomic_load_n(
+				&ip_output_mbuf_data(m)->input_iface->nat44, __ATOMIC_ACQUIRE
+			);
+			key_ptrs[i] = &keys[i];
+			sessions[i] = NULL;
+			owners[i] = NULL;
+			if (pool == NULL || !nat44_parse(m, ip, NAT44_DIR_IN, &keys[i], &l4s[i]))
+				continue;
+			keys[i].pool_id = pool->id;
+			owners[i] = reply_owner(pool, &keys[i]);
+		}
+
+		for (i = 0; i < count; i = j) {
+			for (j = i + 1; j < count && owners[j] == owners[i]; j++)
+				;
+			if (owners[i] == NULL)
+				continue;
+			hits = 0;
+			rte_hash_lookup_bulk_data(
+				owners[i]->sessions, &key_ptrs[i], j - i, &hits, &sessions[i]
+			);
+			for (uint16_t k = i; k < j; k++) {
+				if (!(hits & (UINT64_C(1) << (k - i))))
+					sessions[k] = NULL;
+			}
+		}
+
+		for (i = 0; i < count; i++) {
+			m = objs[n + i];
+			d = ip_output_mbuf_data(m);
+			ip = rte_pktmbuf_mtod(m, struct rte_ipv4_hdr *);
+			if ((s = sessions[i]) != NULL) {
+				__atomic_store_n(&s->last_seen, now, __ATOMIC_RELAXED);
+				nat44_rewrite(ip, &l4s[i], NAT44_DIR_IN, s->key.src, s->key.sport);
+				d->nh = ip4_route_lookup(d->input_iface->vrf_id, ip->dst_addr);
+			}
+			rte_node_enqueue_x1(
+				graph, node, input_edge(d->input_iface, d->nh, ip->dst_addr), m
+			);
+		}
+	}
+
+	return nb_objs;
+}
+
+static int nat44_in_init(const struct rte_graph *, struct rte_node *) {
+	return nat44_workers_alloc();
+}
+
+static void nat44_in_register(void) {
+	ip_input_nat_register("nat44_in");
+	features_row = gr_feature_arc_entry(&ip4_input_features, "nat44_in");
+}
+
+static struct rte_node_register nat44_in_node = {
+	.name = "nat44_in",
+
+	.process = nat44_in_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[FORWARD] = "ip_forward",
+		[LOCAL] = "ip_input_local",
+		[NO_ROUTE] = "ip_error_dest_unreach",
+	},
+	.init = nat44_in_init,
+};
+
+static struct gr_node_info nat44_in_info = {
+	.node = &nat44_in_node,
+	.register_callback = nat44_in_register,
+};
+
+GR_NODE_REGISTER(nat44_in_info);
@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "nat44_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_graph.h>
+#include <gr_iface.h>
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_mbuf.h>
+
+#include <rte_graph_worker.h>
+#include <rte_hash.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+
+enum {
+	OUTPUT = 0,
+	ACL,
+	NO_PORT,
+	UNSUPPORTED,
+	EDGE_COUNT,
+};
+
+static inline rte_edge_t output_edge(const struct iface *iface) {
+	// the egress ACL is applied to the translated packet
+	return iface->acl_out != NULL ? ACL : OUTPUT;
+}
+
+// Translate the source of packets sent by subscribers on outside interfaces.
+// Known flows are looked up in bulk. New flows get a session from the outside
+// port block of their subscriber.
+static uint16_t
+nat44_out_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct nat44_worker *w = nat44_workers[rte_lcore_id()];
+	struct nat44_key keys[RTE_HASH_LOOKUP_BULK_MAX];
+	const void *key_ptrs[RTE_HASH_LOOKUP_BULK_MAX];
+	struct nat44_pool *pools[RTE_HASH_LOOKUP_BULK_MAX];
+	struct nat44_l4 l4s[RTE_HASH_LOOKUP_BULK_MAX];
+	rte_edge_t edges[RTE_HASH_LOOKUP_BULK_MAX];
+	int32_t positions[RTE_HASH_LOOKUP_BULK_MAX];
+	const struct iface *iface;
+	struct nat44_session *s;
+	struct rte_ipv4_hdr *ip;
+	uint16_t i, n, count;
+	struct rte_mbuf *m;
+	uint32_t now;
+
+	now = nat44_now();
+	if (w != NULL)
+		nat44_age(w, now);
+
+	for (n = 0; n < nb_objs; n += count) {
+		count = RTE_MIN(nb_objs - n, RTE_HASH_LOOKUP_BULK_MAX);
+
+		for (i = 0; i < count; i++) {
+			m = objs[n + i];
+			gr_mbuf_prefetch_ahead(objs, n + i, nb_objs);
+			iface = ip_output_mbuf_data(m)->nh->iface;
+			ip = rte_pktmbuf_mtod(m, struct rte_ipv4_hdr *);
+			key_ptrs[i] = &keys[i];
+			// invalid key, never matched
+			keys[i].dir = UINT8_MAX;
+			edges[i] = output_edge(iface);
+			// may be replaced concurrently, only read it once
+			pools[i] = __atomic_load_n(&iface->nat44, __ATOMIC_ACQUIRE);
+			if (pools[i] == NULL
+			    || (ip->src_addr & pools[i]->inside_mask) != pools[i]->inside.ip)
+				continue; // not a subscriber
+			if (w == NULL) {
+				edges[i] = NO_PORT;
+				continue;
+			}
+			if (!nat44_parse(m, ip, NAT44_DIR_OUT, &keys[i], &l4s[i])) {
+				edges[i] = UNSUPPORTED;
+				continue;
+			}
+			keys[i].pool_id = pools[i]->id;
+			edges[i] = EDGE_COUNT; // translated below
+		}
+
+		if (w != NULL)
+			rte_hash_lookup_bulk(w->sessions, key_ptrs, count, positions);
+
+		for (i = 0; i < count; i++) {
+			m = objs[n + i];
+			if (edges[i] != EDGE_COUNT)
+				goto next;
+			iface = ip_output_mbuf_data(m)->nh->iface;
+			if (positions[i] >= 0) {
+				s = &w->slots[positions[i]];
+			} else if ((positions[i] = rte_hash_lookup(w->sessions, &keys[i])) >= 0) {
+				// created for a previous packet of this burst
+				s = &w->slots[positions[i]];
+			} else {
+				s = nat44_session_create(w, pools[i], &keys[i], now);
+				if (s == NULL) {
+					edges[i] = NO_PORT;
+					goto next;
+				}
+			}
+			__atomic_store_n(&s->last_seen, now, __ATOMIC_RELAXED);
+			ip = rte_pktmbuf_mtod(m, struct rte_ipv4_hdr *);
+			nat44_rewrite(ip, &l4s[i], NAT44_DIR_OUT, s->outside_addr, s->outside_port);
+			edges[i] = output_edge(iface);
+next:
+			rte_node_enqueue_x1(graph, node, edges[i], m);
+		}
+	}
+
+	return nb_objs;
+}
+
+static int nat44_out_init(const struct rte_graph *, struct rte_node *) {
+	return nat44_workers_alloc();
+}
+
+static void nat44_out_register(void) {
+	ip_forward_nat_register("nat44_out");
+}
+
+static struct rte_node_register nat44_out_node = {
+	.name = "nat44_out",
+
+	.process = nat44_out_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[OUTPUT] = "ip_output",
+		[ACL] = "ip_acl_out",
+		[NO_PORT] = "nat44_out_no_port",
+		[UNSUPPORTED] = "nat44_out_unsupported",
+	},
+	.init = nat44_out_init,
+};
+
+static struct gr_node_info nat44_out_info = {
+	.node = &nat44_out_node,
+	.register_callback = nat44_out_register,
+};
+
+GR_NODE_REGISTER(nat44_out_info);
+
+GR_DROP_REGISTER(nat44_out_no_port);
+GR_DROP_REGISTER(nat44_out_unsupported);
@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_API_NAT44
+#define _GR_API_NAT44
+
+#include <gr_api.h>
+#include <gr_infra.h>
+#include <gr_net_types.h>
+
+#include <stdint.h>
+
+#define GR_NAT44_MODULE 0x4a44
+
+// Outside ports are allocated to subscribers in blocks of this size, starting
+// from GR_NAT44_PORT_MIN. A subscriber gets one block on every worker that
+// handles its flows.
+#define GR_NAT44_BLOCK_SIZE 256
+#define GR_NAT44_PORT_MIN 1024
+// Max number of outside addresses per pool.
+#define GR_NAT44_MAX_ADDRS 256
+
+// Idle session timeouts in seconds.
+#define GR_NAT44_TCP_TIMEOUT 300
+#define GR_NAT44_UDP_TIMEOUT 120
+#define GR_NAT44_ICMP_TIMEOUT 60
+
+// Source NAT of TCP, UDP and ICMP echo flows forwarded on an outside
+// interface. Only sources that belong to the inside network are translated.
+struct gr_nat44_pool {
+	uint16_t iface_id; // outside interface
+	struct ip4_net inside;
+	ip4_addr_t addr_min;
+	ip4_addr_t addr_max;
+};
+
+#define GR_NAT44_POOL_ADD REQUEST_TYPE(GR_NAT44_MODULE, 0x0001)
+
+struct gr_nat44_pool_add_req {
+	struct gr_nat44_pool pool;
+	uint8_t exist_ok; // replace the pool, existing sessions are aged out
+};
+
+// struct gr_nat44_pool_add_resp { };
+
+#define GR_NAT44_POOL_DEL REQUEST_TYPE(GR_NAT44_MODULE, 0x0002)
+
+struct gr_nat44_pool_del_req {
+	uint16_t iface_id;
+	uint8_t missing_ok;
+};
+
+// struct gr_nat44_pool_del_resp { };
+
+#define GR_NAT44_POOL_LIST REQUEST_TYPE(GR_NAT44_MODULE, 0x0003)
+
+// struct gr_nat44_pool_list_req { };
+
+struct gr_nat44_pool_status {
+	struct gr_nat44_pool pool;
+	uint32_t blocks_total;
+	uint32_t blocks_used;
+	uint64_t sessions; // on all workers
+};
+
+struct gr_nat44_pool_list_resp {
+	uint16_t n_pools;
+	struct gr_nat44_pool_status pools[/* n_pools */];
+};
+
+#endif
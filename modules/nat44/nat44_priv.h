@@ -0,0 +1,269 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _NAT44_PRIV_H
+#define _NAT44_PRIV_H
+
+#include <gr_nat44.h>
+#include <gr_net_types.h>
+
+#include <rte_byteorder.h>
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_hash.h>
+#include <rte_icmp.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_ring.h>
+#include <rte_tcp.h>
+#include <rte_udp.h>
+
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define NAT44_BLOCKS_PER_ADDR ((UINT16_MAX + 1 - GR_NAT44_PORT_MIN) / GR_NAT44_BLOCK_SIZE)
+// Per worker.
+#define NAT44_MAX_SESSIONS (1 << 16)
+#define NAT44_MAX_SUBSCRIBERS (1 << 14)
+// Must be a power of 2 larger than the longest timeout.
+#define NAT44_WHEEL_SLOTS 512
+#define NAT44_NO_SESSION UINT32_MAX
+
+struct nat44_pool {
+	// part of all session keys, a replaced pool never matches existing sessions
+	uint16_t id;
+	uint16_t iface_id;
+	struct ip4_net inside;
+	ip4_addr_t inside_mask;
+	uint32_t addr_min; // host order
+	uint32_t addr_max; // host order
+	uint32_t n_blocks;
+	// one for the configuration plus one per allocated block
+	uint32_t refcnt;
+	// indexes (uint32_t) of the unallocated blocks, shared by all workers
+	struct rte_ring *free_blocks;
+	// struct nat44_event
+	struct rte_ring *events;
+	uint64_t events_lost;
+	// active sessions, indexed by lcore_id and only written by that worker
+	uint64_t sessions[RTE_MAX_LCORE];
+	// lcore_id of the worker that allocated each block
+	uint16_t owners[/* n_blocks */];
+};
+
+// Sessions are stored twice in the same hash table. The OUT key matches
+// packets sent by subscribers and the IN key matches their replies.
+#define NAT44_DIR_OUT 0
+#define NAT44_DIR_IN 1
+
+struct nat44_key {
+	ip4_addr_t src;
+	ip4_addr_t dst;
+	rte_be16_t sport; // ICMP echo identifier, OUT keys only
+	rte_be16_t dport; // ICMP echo identifier, IN keys only
+	uint8_t proto;
+	uint8_t dir;
+	uint16_t pool_id;
+};
+
+static_assert(sizeof(struct nat44_key) == 16);
+
+struct nat44_session {
+	struct nat44_key key; // OUT key
+	ip4_addr_t outside_addr;
+	rte_be16_t outside_port;
+	uint16_t timeout;
+	uint32_t block; // index in nat44_worker.blocks
+	// updated by the worker that receives the replies
+	uint32_t last_seen;
+	uint32_t expire;
+	uint32_t next; // timer wheel slot list
+};
+
+struct nat44_subscriber_key {
+	ip4_addr_t addr;
+	uint16_t pool_id;
+	uint16_t reserved;
+};
+
+// Ports of a subscriber on one worker.
+struct nat44_block {
+	struct nat44_pool *pool;
+	uint32_t index; // in the pool
+	uint32_t n_sessions;
+	uint64_t used[GR_NAT44_BLOCK_SIZE / 64];
+};
+
+// Per-worker connection tracking state. Sessions are only created, aged and
+// deleted by the worker that owns them. Other workers may look them up to
+// translate replies. No locks are involved.
+struct nat44_worker {
+	struct rte_hash *sessions;
+	struct rte_hash *subscribers;
+	// indexed by the position of the OUT key in sessions
+	struct nat44_session *slots;
+	// indexed by the position of the key in subscribers
+	struct nat44_block *blocks;
+	uint32_t tick; // last aged second
+	uint32_t wheel[NAT44_WHEEL_SLOTS];
+};
+
+// Indexed by lcore_id, see nat44_workers_alloc().
+extern struct nat44_worker *nat44_workers[RTE_MAX_LCORE];
+// Allocate the state of workers that do not have one yet.
+int nat44_workers_alloc(void);
+
+// Create a session for a packet sent by a subscriber. Returns NULL if no
+// outside port or session slot is available.
+struct nat44_session *nat44_session_create(
+	struct nat44_worker *,
+	struct nat44_pool *,
+	const struct nat44_key *,
+	uint32_t now
+);
+// Delete the sessions that have been idle for longer than their timeout.
+void nat44_age(struct nat44_worker *, uint32_t now);
+
+// Translated fields of a packet.
+struct nat44_l4 {
+	rte_be16_t *port; // source port for OUT keys, destination port for IN keys
+	rte_be16_t *csum; // NULL for UDP datagrams without checksum
+	bool pseudo; // the checksum covers the addresses
+};
+
+// Parse the packet headers into a session key. Returns false for fragments
+// and unsupported protocols.
+static inline bool nat44_parse(
+	struct rte_mbuf *m,
+	struct rte_ipv4_hdr *ip,
+	uint8_t dir,
+	struct nat44_key *key,
+	struct nat44_l4 *l4
+) {
+	uint16_t l3_len = rte_ipv4_hdr_len(ip);
+	struct rte_icmp_hdr *icmp;
+	struct rte_tcp_hdr *tcp;
+	struct rte_udp_hdr *udp;
+
+	if (ip->fragment_offset & RTE_BE16(RTE_IPV4_HDR_OFFSET_MASK | RTE_IPV4_HDR_MF_FLAG))
+		return false;
+	// all supported headers hold their ports and checksum in 8 bytes
+	if (rte_pktmbuf_data_len(m) < l3_len + 8)
+		return false;
+
+	key->src = ip->src_addr;
+	key->dst = ip->dst_addr;
+	key->proto = ip->next_proto_id;
+	key->dir = dir;
+
+	switch (ip->next_proto_id) {
+	case IPPROTO_TCP:
+		tcp = rte_pktmbuf_mtod_offset(m, struct rte_tcp_hdr *, l3_len);
+		key->sport = tcp->src_port;
+		key->dport = tcp->dst_port;
+		l4->port = dir == NAT44_DIR_OUT ? &tcp->src_port : &tcp->dst_port;
+		l4->csum = &tcp->cksum;
+		l4->pseudo = true;
+		break;
+	case IPPROTO_UDP:
+		udp = rte_pktmbuf_mtod_offset(m, struct rte_udp_hdr *, l3_len);
+		key->sport = udp->src_port;
+		key->dport = udp->dst_port;
+		l4->port = dir == NAT44_DIR_OUT ? &udp->src_port : &udp->dst_port;
+		l4->csum = udp->dgram_cksum != 0 ? &udp->dgram_cksum : NULL;
+		l4->pseudo = true;
+		break;
+	case IPPROTO_ICMP:
+		icmp = rte_pktmbuf_mtod_offset(m, struct rte_icmp_hdr *, l3_len);
+		if (icmp->icmp_type != (dir == NAT44_DIR_OUT ? RTE_ICMP_TYPE_ECHO_REQUEST
+							     : RTE_ICMP_TYPE_ECHO_REPLY))
+			return false;
+		key->sport = dir == NAT44_DIR_OUT ? icmp->icmp_ident : 0;
+		key->dport = dir == NAT44_DIR_IN ? icmp->icmp_ident : 0;
+		l4->port = &icmp->icmp_ident;
+		l4->csum = &icmp->icmp_cksum;
+		l4->pseudo = false;
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+// Block allocation and release, logged by the control plane.
+struct nat44_event {
+	ip4_addr_t subscriber;
+	uint16_t block;
+	bool alloc;
+};
+
+static inline void nat44_block_addr_port(
+	const struct nat44_pool *pool,
+	uint32_t block,
+	uint16_t offset,
+	ip4_addr_t *addr,
+	rte_be16_t *port
+) {
+	*addr = rte_cpu_to_be_32(pool->addr_min + block / NAT44_BLOCKS_PER_ADDR);
+	*port = rte_cpu_to_be_16(
+		GR_NAT44_PORT_MIN + (block % NAT44_BLOCKS_PER_ADDR) * GR_NAT44_BLOCK_SIZE + offset
+	);
+}
+
+// Return the index of the block that holds an outside address and port or
+// UINT32_MAX if they do not belong to the pool.
+static inline uint32_t
+nat44_block_index(const struct nat44_pool *pool, ip4_addr_t addr, rte_be16_t port) {
+	uint32_t a = rte_be_to_cpu_32(addr);
+	uint16_t p = rte_be_to_cpu_16(port);
+
+	if (a < pool->addr_min || a > pool->addr_max || p < GR_NAT44_PORT_MIN)
+		return UINT32_MAX;
+
+	return (a - pool->addr_min) * NAT44_BLOCKS_PER_ADDR
+		+ (p - GR_NAT44_PORT_MIN) / GR_NAT44_BLOCK_SIZE;
+}
+
+// Incremental checksum update of a 16 bits word (RFC 1624).
+static inline rte_be16_t nat44_csum16(rte_be16_t csum, rte_be16_t old, rte_be16_t new) {
+	uint32_t sum = (uint16_t)~csum + (uint16_t)~old + new;
+
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+
+	return ~sum;
+}
+
+static inline rte_be16_t nat44_csum32(rte_be16_t csum, uint32_t old, uint32_t new) {
+	csum = nat44_csum16(csum, old >> 16, new >> 16);
+	return nat44_csum16(csum, old & 0xffff, new & 0xffff);
+}
+
+// Rewrite the source (OUT) or destination (IN) address and port of a packet.
+static inline void nat44_rewrite(
+	struct rte_ipv4_hdr *ip,
+	const struct nat44_l4 *l4,
+	uint8_t dir,
+	ip4_addr_t addr,
+	rte_be16_t port
+) {
+	ip4_addr_t *a = dir == NAT44_DIR_OUT ? &ip->src_addr : &ip->dst_addr;
+
+	ip->hdr_checksum = nat44_csum32(ip->hdr_checksum, *a, addr);
+	if (l4->csum != NULL) {
+		if (l4->pseudo)
+			*l4->csum = nat44_csum32(*l4->csum, *a, addr);
+		*l4->csum = nat44_csum16(*l4->csum, *l4->port, port);
+	}
+	*a = addr;
+	*l4->port = port;
+}
+
+static inline uint32_t nat44_now(void) {
+	return rte_rdtsc() / rte_get_tsc_hz();
+}
+
+#endif
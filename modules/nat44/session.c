@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "nat44_priv.h"
+
+#include <rte_hash.h>
+#include <rte_lcore.h>
+#include <rte_ring.h>
+
+#include <string.h>
+
+static uint16_t nat44_timeout(uint8_t proto) {
+	switch (proto) {
+	case IPPROTO_TCP:
+		return GR_NAT44_TCP_TIMEOUT;
+	case IPPROTO_UDP:
+		return GR_NAT44_UDP_TIMEOUT;
+	}
+	return GR_NAT44_ICMP_TIMEOUT;
+}
+
+// Reply key of a session.
+static void nat44_in_key(struct nat44_key *in, const struct nat44_session *s) {
+	in->src = s->key.dst;
+	in->dst = s->outside_addr;
+	in->sport = s->key.dport;
+	in->dport = s->outside_port;
+	in->proto = s->key.proto;
+	in->dir = NAT44_DIR_IN;
+	in->pool_id = s->key.pool_id;
+}
+
+static void nat44_event(struct nat44_pool *pool, ip4_addr_t addr, uint32_t block, bool alloc) {
+	struct nat44_event ev = {.subscriber = addr, .block = block, .alloc = alloc};
+
+	if (rte_ring_enqueue_elem(pool->events, &ev, sizeof(ev)) < 0)
+		__atomic_fetch_add(&pool->events_lost, 1, __ATOMIC_RELAXED);
+}
+
+// Get the block of a subscriber or allocate one from the pool.
+static struct nat44_block *
+nat44_block_get(struct nat44_worker *w, struct nat44_pool *pool, ip4_addr_t addr) {
+	struct nat44_subscriber_key key = {.addr = addr, .pool_id = pool->id};
+	struct nat44_block *b;
+	uint32_t index;
+	int32_t pos;
+
+	if ((pos = rte_hash_lookup(w->subscribers, &key)) >= 0)
+		return &w->blocks[pos];
+
+	if (rte_ring_dequeue_elem(pool->free_blocks, &index, sizeof(index)) < 0)
+		return NULL;
+	if ((pos = rte_hash_add_key(w->subscribers, &key)) < 0) {
+		rte_ring_enqueue_elem(pool->free_blocks, &index, sizeof(index));
+		return NULL;
+	}
+
+	b = &w->blocks[pos];
+	memset(b, 0, sizeof(*b));
+	b->pool = pool;
+	b->index = index;
+	__atomic_store_n(&pool->owners[b->index], rte_lcore_id(), __ATOMIC_RELAXED);
+	__atomic_fetch_add(&pool->refcnt, 1, __ATOMIC_RELAXED);
+	nat44_event(pool, addr, b->index, true);
+
+	return b;
+}
+
+static void nat44_block_release(struct nat44_worker *w, struct nat44_block *b, ip4_addr_t addr) {
+	struct nat44_subscriber_key key = {.addr = addr, .pool_id = b->pool->id};
+	struct nat44_pool *pool = b->pool;
+
+	rte_hash_del_key(w->subscribers, &key);
+	nat44_event(pool, addr, b->index, false);
+	// the ring holds all blocks, it cannot be full
+	rte_ring_enqueue_elem(pool->free_blocks, &b->index, sizeof(b->index));
+	// the control plane frees removed pools once no block is allocated
+	__atomic_fetch_sub(&pool->refcnt, 1, __ATOMIC_RELEASE);
+}
+
+static void nat44_wheel_insert(struct nat44_worker *w, struct nat44_session *s, uint32_t pos) {
+	uint32_t *slot = &w->wheel[s->expire % NAT44_WHEEL_SLOTS];
+
+	s->next = *slot;
+	*slot = pos;
+}
+
+struct nat44_session *nat44_session_create(
+	struct nat44_worker *w,
+	struct nat44_pool *pool,
+	const struct nat44_key *key,
+	uint32_t now
+) {
+	struct nat44_session *s;
+	struct nat44_key in;
+	struct nat44_block *b;
+	unsigned i;
+	int32_t pos;
+	int bit;
+
+	if ((b = nat44_block_get(w, pool, key->src)) == NULL)
+		return NULL;
+
+	// first free port of the block
+	for (i = 0; i < RTE_DIM(b->used); i++) {
+		if (b->used[i] != UINT64_MAX)
+			break;
+	}
+	if (i == RTE_DIM(b->used))
+		return NULL;
+	bit = __builtin_ctzll(~b->used[i]);
+
+	if ((pos = rte_hash_add_key(w->sessions, key)) < 0)
+		goto err;
+
+	s = &w->slots[pos];
+	s->key = *key;
+	nat44_block_addr_port(pool, b->index, i * 64 + bit, &s->outside_addr, &s->outside_port);
+	s->timeout = nat44_timeout(key->proto);
+	s->block = b - w->blocks;
+	s->last_seen = now;
+	s->expire = now + s->timeout;
+
+	nat44_in_key(&in, s);
+	if (rte_hash_add_key_data(w->sessions, &in, s) < 0) {
+		rte_hash_del_key(w->sessions, key);
+		goto err;
+	}
+
+	b->used[i] |= UINT64_C(1) << bit;
+	b->n_sessions++;
+	nat44_wheel_insert(w, s, pos);
+	pool->sessions[rte_lcore_id()]++;
+
+	return s;
+err:
+	if (b->n_sessions == 0)
+		nat44_block_release(w, b, key->src);
+	return NULL;
+}
+
+static void nat44_session_delete(struct nat44_worker *w, struct nat44_session *s) {
+	struct nat44_block *b = &w->blocks[s->block];
+	struct nat44_key in;
+	uint16_t offset;
+
+	nat44_in_key(&in, s);
+	// The key slots, and therefore the session, are only reused once all
+	// workers have reported a quiescent state.
+	rte_hash_del_key(w->sessions, &in);
+	rte_hash_del_key(w->sessions, &s->key);
+
+	offset = (rte_be_to_cpu_16(s->outside_port) - GR_NAT44_PORT_MIN) % GR_NAT44_BLOCK_SIZE;
+	b->used[offset / 64] &= ~(UINT64_C(1) << (offset % 64));
+	b->pool->sessions[rte_lcore_id()]--;
+	if (--b->n_sessions == 0)
+		nat44_block_release(w, b, s->key.src);
+}
+
+void nat44_age(struct nat44_worker *w, uint32_t now) {
+	struct nat44_session *s;
+	uint32_t pos, next, seen;
+	uint32_t *slot;
+
+	if (w->tick == 0)
+		w->tick = now;
+
+	// after a long pause, a single revolution visits all sessions
+	if (now - w->tick > NAT44_WHEEL_SLOTS)
+		w->tick = now - NAT44_WHEEL_SLOTS;
+
+	while (w->tick < now) {
+		w->tick++;
+		slot = &w->wheel[w->tick % NAT44_WHEEL_SLOTS];
+		pos = *slot;
+		*slot = NAT44_NO_SESSION;
+		for (; pos != NAT44_NO_SESSION; pos = next) {
+			s = &w->slots[pos];
+			next = s->next;
+			seen = __atomic_load_n(&s->last_seen, __ATOMIC_RELAXED);
+			if (now - seen < s->timeout) {
+				// refreshed since it was armed
+				s->expire = seen + s->timeout;
+				nat44_wheel_insert(w, s, pos);
+				continue;
+			}
+			nat44_session_delete(w, s);
+		}
+	}
+}
@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_cli_iface.h>
+#include <gr_net_types.h>
+#include <gr_sflow.h>
+#include <gr_table.h>
+
+#include <ecoli.h>
+#include <libsmartcols.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static cmd_status_t collector_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_sflow_collector_set_req req = {0};
+	struct gr_sflow_collector *col = &req.collector;
+	const char *format = arg_str(p, "FORMAT");
+	const char *agent = arg_str(p, "AGENT");
+
+	if (inet_pton(AF_INET, arg_str(p, "ADDR"), &col->addr) != 1) {
+		errno = EINVAL;
+		return CMD_ERROR;
+	}
+	if (agent != NULL && inet_pton(AF_INET, agent, &col->agent) != 1) {
+		errno = EINVAL;
+		return CMD_ERROR;
+	}
+	if (format != NULL && strcmp(format, "ipfix") == 0)
+		col->format = GR_SFLOW_FORMAT_IPFIX;
+	else
+		col->format = GR_SFLOW_FORMAT_SFLOW;
+	if (arg_u16(p, "PORT", &col->port) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+	if (arg_u32(p, "DOMAIN", &col->domain_id) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_SFLOW_COLLECTOR_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t collector_del(const struct gr_api_client *c, const struct ec_pnode *) {
+	struct gr_sflow_collector_set_req req = {0};
+
+	if (gr_api_client_send_recv(c, GR_SFLOW_COLLECTOR_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t iface_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_sflow_iface_set_req req = {0};
+	struct gr_iface iface;
+
+	if (iface_from_name(c, arg_str(p, "IFACE"), &iface) < 0)
+		return CMD_ERROR;
+	req.iface_id = iface.id;
+	if (arg_u32(p, "RATE", &req.rate) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_SFLOW_IFACE_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t sflow_show(const struct gr_api_client *c, const struct ec_pnode *) {
+	struct libscols_table *table = scols_new_table();
+	const struct gr_sflow_show_resp *resp;
+	const struct gr_sflow_collector *col;
+	struct gr_iface iface;
+	void *resp_ptr = NULL;
+
+	if (table == NULL)
+		return CMD_ERROR;
+	if (gr_api_client_send_recv(c, GR_SFLOW_SHOW, 0, NULL, &resp_ptr) < 0) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+
+	resp = resp_ptr;
+	col = &resp->collector;
+
+	if (col->addr != 0) {
+		printf("collector: " IP4_ADDR_FMT ":%u\n", IP4_ADDR_SPLIT(&col->addr), col->port);
+		printf("format: %s\n", col->format == GR_SFLOW_FORMAT_IPFIX ? "ipfix" : "sflow");
+		if (col->format == GR_SFLOW_FORMAT_SFLOW)
+			printf("agent: " IP4_ADDR_FMT "\n", IP4_ADDR_SPLIT(&col->agent));
+		printf("domain: %u\n", col->domain_id);
+	} else {
+		printf("collector: none\n");
+	}
+	printf("samples: %" PRIu64 "\n", resp->samples);
+	printf("lost: %" PRIu64 "\n", resp->lost);
+	printf("datagrams: %" PRIu64 "\n", resp->datagrams);
+	printf("errors: %" PRIu64 "\n", resp->errors);
+
+	scols_table_new_column(table, "IFACE", 0, 0);
+	scols_table_new_column(table, "RATE", 0, SCOLS_FL_RIGHT);
+	scols_table_new_column(table, "SAMPLES", 0, SCOLS_FL_RIGHT);
+	scols_table_set_column_separator(table, "  ");
+
+	for (size_t i = 0; i < resp->n_ifaces; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_sflow_iface *s = &resp->ifaces[i];
+
+		if (iface_from_id(c, s->iface_id, &iface) == 0)
+			scols_line_sprintf(line, 0, "%s", iface.name);
+		else
+			scols_line_sprintf(line, 0, "%u", s->iface_id);
+		scols_line_sprintf(line, 1, "%u", s->rate);
+		scols_line_sprintf(line, 2, "%" PRIu64, s->samples);
+	}
+
+	if (resp->n_ifaces > 0)
+		gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+#define IFACE_ARG                                                                                  \
+	with_help("Interface name.", ec_node_dyn("IFACE", complete_iface_names, NULL))
+
+#define SFLOW_CTX(root, ctx, help) CLI_CONTEXT(root, ctx, CTX_ARG("sflow", help))
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		SFLOW_CTX(root, CTX_SET, "Configure packet sampling."),
+		"collector ADDR [(port PORT),(format FORMAT),(agent AGENT),(domain DOMAIN)]",
+		collector_set,
+		"Export the packet samples to a collector over UDP.",
+		with_help("Collector address.", ec_node_re("ADDR", IPV4_RE)),
+		with_help("Collector UDP port.", ec_node_uint("PORT", 1, UINT16_MAX, 10)),
+		with_help("Export format (default sflow).", ec_node_re("FORMAT", "sflow|ipfix")),
+		with_help("sFlow agent address.", ec_node_re("AGENT", IPV4_RE)),
+		with_help(
+			"sFlow sub-agent ID or IPFIX observation domain ID.",
+			ec_node_uint("DOMAIN", 0, UINT32_MAX, 10)
+		)
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		SFLOW_CTX(root, CTX_SET, "Configure packet sampling."),
+		"interface IFACE rate RATE",
+		iface_set,
+		"Sample one out of RATE IP packets received on an interface.",
+		IFACE_ARG,
+		with_help("Average sampling interval.", ec_node_uint("RATE", 1, UINT32_MAX, 10))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		SFLOW_CTX(root, CTX_DEL, "Disable packet sampling."),
+		"collector",
+		collector_del,
+		"Stop exporting the packet samples."
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		SFLOW_CTX(root, CTX_DEL, "Disable packet sampling."),
+		"interface IFACE",
+		iface_set,
+		"Stop sampling the packets received on an interface.",
+		IFACE_ARG
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SHOW),
+		"sflow",
+		sflow_show,
+		"Show packet sampling configuration and statistics."
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "sflow",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+}
@@ -0,0 +1,542 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_sflow.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_log.h>
+#include <gr_macro.h>
+#include <gr_net_types.h>
+#include <gr_rcu.h>
+#include <gr_sample.h>
+#include <gr_worker.h>
+
+#include <event2/event.h>
+#include <rte_byteorder.h>
+#include <rte_errno.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_ring.h>
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SAMPLE_RING_SIZE 1024
+#define DRAIN_BURST 32
+#define DRAIN_PERIOD_US 100000
+// Max size of exported datagrams, samples are aggregated until it is reached.
+#define EXPORT_MTU 1400
+// IPFIX templates are sent periodically, UDP collectors may miss them.
+#define IPFIX_TEMPLATE_PERIOD_S 30
+
+static struct gr_sflow_collector collector;
+static struct sockaddr_in collector_addr;
+static int sock = -1;
+// Sampling rate of each interface, indexed by interface ID.
+static uint32_t rates[MAX_IFACES];
+static uint64_t iface_samples[MAX_IFACES];
+// sFlow sample_pool, packets seen by the datapath.
+static uint64_t iface_pools[MAX_IFACES];
+static uint32_t datagram_seq;
+static uint32_t ipfix_seq;
+static time_t ipfix_template_sent;
+static uint64_t samples, datagrams, errors;
+static struct timespec start_time;
+static struct event *drain_ev;
+
+// Samples ring of all workers. New workers get theirs on the next drain.
+static int sample_rings_alloc(void) {
+	char name[RTE_RING_NAMESIZE];
+	struct worker *worker;
+	struct rte_ring *ring;
+
+	STAILQ_FOREACH (worker, &workers, next) {
+		struct sample_worker *w = &sample_workers[worker->lcore_id];
+		if (w->ring != NULL)
+			continue;
+		snprintf(name, sizeof(name), "sample_%u", worker->lcore_id);
+		ring = rte_ring_create_elem(
+			name,
+			sizeof(struct sample),
+			SAMPLE_RING_SIZE,
+			rte_lcore_to_socket_id(worker->lcore_id),
+			RING_F_SP_ENQ | RING_F_SC_DEQ
+		);
+		if (ring == NULL)
+			return errno_log(rte_errno, "rte_ring_create_elem");
+		__atomic_store_n(&w->ring, ring, __ATOMIC_RELEASE);
+	}
+
+	return 0;
+}
+
+// encoding ////////////////////////////////////////////////////////////////////
+
+struct export_buf {
+	uint8_t data[EXPORT_MTU];
+	size_t len;
+	unsigned n_samples;
+};
+
+static void buf_put(struct export_buf *b, const void *data, size_t len) {
+	memcpy(&b->data[b->len], data, len);
+	b->len += len;
+}
+
+static void buf_put16(struct export_buf *b, uint16_t v) {
+	v = rte_cpu_to_be_16(v);
+	buf_put(b, &v, sizeof(v));
+}
+
+static void buf_put32(struct export_buf *b, uint32_t v) {
+	v = rte_cpu_to_be_32(v);
+	buf_put(b, &v, sizeof(v));
+}
+
+// Write the length of a set whose header starts skip bytes before offset.
+static void buf_set_len16(struct export_buf *b, size_t offset, size_t skip) {
+	uint16_t len = rte_cpu_to_be_16(b->len - offset + skip);
+	memcpy(&b->data[offset], &len, sizeof(len));
+}
+
+static void buf_set32(struct export_buf *b, size_t offset, uint32_t v) {
+	v = rte_cpu_to_be_32(v);
+	memcpy(&b->data[offset], &v, sizeof(v));
+}
+
+// sFlow version 5 datagram header, num_samples is updated before sending.
+#define SFLOW_NUM_SAMPLES_OFFSET 24
+// Flow sample with a raw packet header and an extended router record.
+#define SFLOW_SAMPLE_MAX_LEN (40 + 24 + SAMPLE_HEADER_LEN + 36)
+
+#define SFLOW_FLOW_SAMPLE 1
+#define SFLOW_RAW_HEADER 1
+#define SFLOW_EXTENDED_ROUTER 1002
+#define SFLOW_PROTO_IPV4 11
+#define SFLOW_PROTO_IPV6 12
+#define SFLOW_ADDR_IPV4 1
+#define SFLOW_ADDR_IPV6 2
+
+static void sflow_header(struct export_buf *b) {
+	struct timespec now;
+	uint32_t uptime;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	uptime = (now.tv_sec - start_time.tv_sec) * 1000
+		+ (now.tv_nsec - start_time.tv_nsec) / 1000000;
+
+	buf_put32(b, 5);
+	buf_put32(b, SFLOW_ADDR_IPV4);
+	buf_put(b, &collector.agent, sizeof(collector.agent));
+	buf_put32(b, collector.domain_id);
+	buf_put32(b, ++datagram_seq);
+	buf_put32(b, uptime);
+	buf_put32(b, 0); // num_samples
+}
+
+static void sflow_sample(struct export_buf *b, const struct sample *s, uint64_t lost) {
+	size_t sample_len, record_len;
+
+	buf_put32(b, SFLOW_FLOW_SAMPLE);
+	sample_len = b->len;
+	buf_put32(b, 0);
+	buf_put32(b, iface_samples[s->iface_id]);
+	buf_put32(b, s->iface_id); // source_id, ifIndex type
+	buf_put32(b, rates[s->iface_id] ?: 1);
+	buf_put32(b, iface_pools[s->iface_id]);
+	buf_put32(b, lost);
+	buf_put32(b, s->iface_id);
+	buf_put32(b, s->out_iface_id);
+	buf_put32(b, 2); // num_records
+
+	buf_put32(b, SFLOW_RAW_HEADER);
+	record_len = b->len;
+	buf_put32(b, 0);
+	buf_put32(b, s->af == AF_INET ? SFLOW_PROTO_IPV4 : SFLOW_PROTO_IPV6);
+	buf_put32(b, s->frame_len);
+	buf_put32(b, 0); // stripped
+	buf_put32(b, s->header_len);
+	buf_put(b, s->header, s->header_len);
+	while (b->len % 4)
+		b->data[b->len++] = 0;
+	buf_set32(b, record_len, b->len - record_len - 4);
+
+	buf_put32(b, SFLOW_EXTENDED_ROUTER);
+	record_len = b->len;
+	buf_put32(b, 0);
+	if (s->af == AF_INET) {
+		buf_put32(b, SFLOW_ADDR_IPV4);
+		buf_put(b, &s->nh.ip4, sizeof(s->nh.ip4));
+	} else {
+		buf_put32(b, SFLOW_ADDR_IPV6);
+		buf_put(b, &s->nh.ip6, sizeof(s->nh.ip6));
+	}
+	buf_put32(b, 0); // src_mask_len, unknown
+	buf_put32(b, 0); // dst_mask_len, unknown
+	buf_set32(b, record_len, b->len - record_len - 4);
+
+	buf_set32(b, sample_len, b->len - sample_len - 4);
+}
+
+// IPFIX message header, length and sequence are updated before sending.
+#define IPFIX_SEQ_OFFSET 8
+#define IPFIX_SET_TEMPLATE 2
+#define IPFIX_TEMPLATE_IPV4 256
+#define IPFIX_TEMPLATE_IPV6 257
+#define IPFIX_VARLEN 0xffff
+// Data set with a single record.
+#define IPFIX_SAMPLE_MAX_LEN (4 + 20 + 16 + 1 + SAMPLE_HEADER_LEN)
+
+// Information elements (RFC 7012).
+#define IPFIX_IE_INGRESS_INTERFACE 10
+#define IPFIX_IE_EGRESS_INTERFACE 14
+#define IPFIX_IE_NEXT_HOP_IPV4 15
+#define IPFIX_IE_NEXT_HOP_IPV6 62
+#define IPFIX_IE_IP_TOTAL_LENGTH 224
+#define IPFIX_IE_INGRESS_VRF_ID 234
+#define IPFIX_IE_SAMPLING_PACKET_INTERVAL 305
+#define IPFIX_IE_IP_HEADER_PACKET_SECTION 313
+
+static void ipfix_header(struct export_buf *b) {
+	buf_put16(b, 10);
+	buf_put16(b, 0); // length
+	buf_put32(b, time(NULL));
+	buf_put32(b, 0); // sequence
+	buf_put32(b, collector.domain_id);
+}
+
+static void ipfix_template(struct export_buf *b, uint16_t id, uint16_t nh_ie, uint16_t nh_len) {
+	buf_put16(b, id);
+	buf_put16(b, 7); // field count
+	buf_put16(b, IPFIX_IE_INGRESS_INTERFACE);
+	buf_put16(b, 4);
+	buf_put16(b, IPFIX_IE_EGRESS_INTERFACE);
+	buf_put16(b, 4);
+	buf_put16(b, IPFIX_IE_INGRESS_VRF_ID);
+	buf_put16(b, 4);
+	buf_put16(b, IPFIX_IE_SAMPLING_PACKET_INTERVAL);
+	buf_put16(b, 4);
+	buf_put16(b, IPFIX_IE_IP_TOTAL_LENGTH);
+	buf_put16(b, 4);
+	buf_put16(b, nh_ie);
+	buf_put16(b, nh_len);
+	buf_put16(b, IPFIX_IE_IP_HEADER_PACKET_SECTION);
+	buf_put16(b, IPFIX_VARLEN);
+}
+
+static void ipfix_templates(struct export_buf *b) {
+	size_t set_len;
+
+	buf_put16(b, IPFIX_SET_TEMPLATE);
+	set_len = b->len;
+	buf_put16(b, 0);
+	ipfix_template(b, IPFIX_TEMPLATE_IPV4, IPFIX_IE_NEXT_HOP_IPV4, 4);
+	ipfix_template(b, IPFIX_TEMPLATE_IPV6, IPFIX_IE_NEXT_HOP_IPV6, 16);
+	buf_set_len16(b, set_len, 2);
+}
+
+static void ipfix_sample(struct export_buf *b, const struct sample *s) {
+	size_t set_len;
+
+	buf_put16(b, s->af == AF_INET ? IPFIX_TEMPLATE_IPV4 : IPFIX_TEMPLATE_IPV6);
+	set_len = b->len;
+	buf_put16(b, 0);
+	buf_put32(b, s->iface_id);
+	buf_put32(b, s->out_iface_id);
+	buf_put32(b, s->vrf_id);
+	buf_put32(b, rates[s->iface_id] ?: 1);
+	buf_put32(b, s->frame_len);
+	if (s->af == AF_INET)
+		buf_put(b, &s->nh.ip4, sizeof(s->nh.ip4));
+	else
+		buf_put(b, &s->nh.ip6, sizeof(s->nh.ip6));
+	b->data[b->len++] = s->header_len;
+	buf_put(b, s->header, s->header_len);
+	buf_set_len16(b, set_len, 2);
+}
+
+// export //////////////////////////////////////////////////////////////////////
+
+static void export_start(struct export_buf *b) {
+	b->len = 0;
+	b->n_samples = 0;
+	if (collector.format == GR_SFLOW_FORMAT_SFLOW) {
+		sflow_header(b);
+	} else {
+		ipfix_header(b);
+		if (time(NULL) - ipfix_template_sent >= IPFIX_TEMPLATE_PERIOD_S) {
+			ipfix_templates(b);
+			ipfix_template_sent = time(NULL);
+		}
+	}
+}
+
+static void export_flush(struct export_buf *b) {
+	const struct sockaddr *dst = (const struct sockaddr *)&collector_addr;
+
+	if (b->n_samples == 0)
+		return;
+
+	if (collector.format == GR_SFLOW_FORMAT_SFLOW) {
+		buf_set32(b, SFLOW_NUM_SAMPLES_OFFSET, b->n_samples);
+	} else {
+		uint16_t len = rte_cpu_to_be_16(b->len);
+		memcpy(&b->data[2], &len, sizeof(len));
+		// number of data records sent before this message
+		buf_set32(b, IPFIX_SEQ_OFFSET, ipfix_seq);
+		ipfix_seq += b->n_samples;
+	}
+
+	if (sendto(sock, b->data, b->len, 0, dst, sizeof(collector_addr)) < 0)
+		errors++;
+	else
+		datagrams++;
+
+	export_start(b);
+}
+
+static void export_sample(struct export_buf *b, const struct sample *s, uint64_t lost) {
+	size_t max_len;
+
+	max_len = collector.format == GR_SFLOW_FORMAT_SFLOW ? SFLOW_SAMPLE_MAX_LEN
+							    : IPFIX_SAMPLE_MAX_LEN;
+	if (b->len + max_len > sizeof(b->data))
+		export_flush(b);
+
+	if (collector.format == GR_SFLOW_FORMAT_SFLOW)
+		sflow_sample(b, s, lost);
+	else
+		ipfix_sample(b, s);
+	b->n_samples++;
+}
+
+static void sflow_drain_cb(evutil_socket_t, short, void *) {
+	struct sample burst[DRAIN_BURST];
+	struct export_buf b;
+	uint64_t lost = 0;
+	unsigned n;
+
+	sample_rings_alloc();
+
+	for (unsigned i = 0; i < ARRAY_DIM(sample_workers); i++)
+		lost += __atomic_load_n(&sample_workers[i].lost, __ATOMIC_RELAXED);
+
+	if (sock >= 0)
+		export_start(&b);
+
+	for (unsigned i = 0; i < ARRAY_DIM(sample_workers); i++) {
+		struct rte_ring *ring = sample_workers[i].ring;
+		if (ring == NULL)
+			continue;
+		while ((n = rte_ring_sc_dequeue_burst_elem(
+				ring, burst, sizeof(*burst), ARRAY_DIM(burst), NULL
+			))
+		       > 0) {
+			for (unsigned j = 0; j < n; j++) {
+				const struct sample *s = &burst[j];
+				// the interface may have been removed since
+				if (rates[s->iface_id] == 0)
+					continue;
+				iface_samples[s->iface_id]++;
+				iface_pools[s->iface_id] += s->skip;
+				samples++;
+				if (sock >= 0)
+					export_sample(&b, s, lost);
+			}
+		}
+	}
+
+	if (sock >= 0)
+		export_flush(&b);
+}
+
+// api /////////////////////////////////////////////////////////////////////////
+
+static struct api_out collector_set_cb(const void *request, void ** /*response*/) {
+	const struct gr_sflow_collector_set_req *req = request;
+	struct gr_sflow_collector c = req->collector;
+	int fd = -1;
+
+	if (c.format > GR_SFLOW_FORMAT_IPFIX)
+		return api_out(EINVAL, 0);
+	if (c.port == 0)
+		c.port = c.format == GR_SFLOW_FORMAT_SFLOW ? GR_SFLOW_PORT_SFLOW
+							   : GR_SFLOW_PORT_IPFIX;
+
+	if (c.addr != 0) {
+		fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (fd < 0)
+			return api_out(errno, 0);
+	}
+	if (sock >= 0)
+		close(sock);
+	sock = fd;
+
+	collector = c;
+	memset(&collector_addr, 0, sizeof(collector_addr));
+	collector_addr.sin_family = AF_INET;
+	collector_addr.sin_addr.s_addr = c.addr;
+	collector_addr.sin_port = rte_cpu_to_be_16(c.port);
+	// send the templates with the next message
+	ipfix_template_sent = 0;
+
+	if (c.addr != 0)
+		LOG(INFO,
+		    "exporting %s samples to " IP4_ADDR_FMT ":%u",
+		    c.format == GR_SFLOW_FORMAT_SFLOW ? "sflow" : "ipfix",
+		    IP4_ADDR_SPLIT(&c.addr),
+		    c.port);
+
+	return api_out(0, 0);
+}
+
+static int sflow_iface_set(struct iface *iface, uint32_t rate) {
+	struct iface_sampler *s = NULL, *old;
+
+	if (rate != 0) {
+		if (sample_rings_alloc() < 0)
+			return -errno;
+		if ((s = rte_zmalloc(__func__, sizeof(*s), RTE_CACHE_LINE_SIZE)) == NULL)
+			return errno_set(ENOMEM);
+		s->rate = rate;
+		for (unsigned i = 0; i < ARRAY_DIM(s->lcores); i++) {
+			s->lcores[i].skip = sample_next_skip(rate);
+			s->lcores[i].countdown = s->lcores[i].skip;
+		}
+	}
+
+	if (rates[iface->id] != rate) {
+		iface_samples[iface->id] = 0;
+		iface_pools[iface->id] = 0;
+	}
+	rates[iface->id] = rate;
+
+	old = iface->sampler;
+	__atomic_store_n(&iface->sampler, s, __ATOMIC_RELEASE);
+	if (old != NULL)
+		gr_rcu_defer_free(rte_free, old);
+
+	return 0;
+}
+
+static struct api_out iface_set_cb(const void *request, void ** /*response*/) {
+	const struct gr_sflow_iface_set_req *req = request;
+	struct iface *iface;
+
+	if ((iface = iface_from_id(req->iface_id)) == NULL)
+		return api_out(errno, 0);
+	if (sflow_iface_set(iface, req->rate) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out show_cb(const void * /*request*/, void **response) {
+	struct gr_sflow_show_resp *resp;
+	struct gr_sflow_iface *i;
+	size_t len, n = 0;
+
+	for (unsigned id = 0; id < ARRAY_DIM(rates); id++)
+		n += rates[id] != 0;
+
+	len = sizeof(*resp) + n * sizeof(*resp->ifaces);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	resp->collector = collector;
+	resp->samples = samples;
+	for (unsigned l = 0; l < ARRAY_DIM(sample_workers); l++)
+		resp->lost += __atomic_load_n(&sample_workers[l].lost, __ATOMIC_RELAXED);
+	resp->datagrams = datagrams;
+	resp->errors = errors;
+	for (unsigned id = 0; id < ARRAY_DIM(rates); id++) {
+		if (rates[id] == 0)
+			continue;
+		i = &resp->ifaces[resp->n_ifaces++];
+		i->iface_id = id;
+		i->rate = rates[id];
+		i->samples = iface_samples[id];
+	}
+
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+// module //////////////////////////////////////////////////////////////////////
+
+static void sflow_iface_event(iface_event_t event, struct iface *iface) {
+	if (event == IFACE_EVENT_PRE_REMOVE && iface->sampler != NULL)
+		sflow_iface_set(iface, 0);
+}
+
+static void sflow_init(struct event_base *ev_base) {
+	struct timeval tv = {.tv_usec = DRAIN_PERIOD_US};
+
+	clock_gettime(CLOCK_MONOTONIC, &start_time);
+	collector.port = GR_SFLOW_PORT_SFLOW;
+
+	drain_ev = gr_event_new(ev_base, -1, EV_PERSIST | EV_FINALIZE, sflow_drain_cb, NULL);
+	if (drain_ev == NULL)
+		ABORT("gr_event_new() failed");
+	if (event_add(drain_ev, &tv) < 0)
+		ABORT("event_add() failed");
+}
+
+static void sflow_fini(struct event_base *) {
+	gr_event_free(drain_ev);
+	drain_ev = NULL;
+	if (sock >= 0)
+		close(sock);
+	sock = -1;
+	// workers are stopped
+	for (unsigned i = 0; i < ARRAY_DIM(sample_workers); i++) {
+		rte_ring_free(sample_workers[i].ring);
+		sample_workers[i].ring = NULL;
+	}
+}
+
+static struct gr_module sflow_module = {
+	.name = "sflow",
+	.init = sflow_init,
+	.fini = sflow_fini,
+	.fini_prio = 1000,
+};
+
+static struct gr_api_handler collector_set_handler = {
+	.name = "sflow collector set",
+	.request_type = GR_SFLOW_COLLECTOR_SET,
+	.callback = collector_set_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler iface_set_handler = {
+	.name = "sflow iface set",
+	.request_type = GR_SFLOW_IFACE_SET,
+	.callback = iface_set_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler show_handler = {
+	.name = "sflow show",
+	.request_type = GR_SFLOW_SHOW,
+	.callback = show_cb,
+};
+
+static struct iface_event_handler sflow_iface_event_handler = {
+	.callback = sflow_iface_event,
+};
+
+RTE_INIT(sflow_constructor) {
+	gr_register_api_handler(&collector_set_handler);
+	gr_register_api_handler(&iface_set_handler);
+	gr_register_api_handler(&show_handler);
+	gr_register_module(&sflow_module);
+	iface_event_register_handler(&sflow_iface_event_handler);
+}
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_API_SFLOW
+#define _GR_API_SFLOW
+
+#include <gr_api.h>
+#include <gr_net_types.h>
+
+#include <stdint.h>
+
+#define GR_SFLOW_MODULE 0x5f10
+
+// Export formats of the sampled packets.
+#define GR_SFLOW_FORMAT_SFLOW 0 // sFlow version 5
+#define GR_SFLOW_FORMAT_IPFIX 1 // RFC 7011
+
+#define GR_SFLOW_PORT_SFLOW 6343
+#define GR_SFLOW_PORT_IPFIX 4739
+
+// Samples are exported over UDP by the control plane, not by the workers.
+// The collector must be reachable from the host network stack.
+struct gr_sflow_collector {
+	ip4_addr_t addr; // 0 to disable the export
+	uint16_t port; // 0 for the default port of the format
+	uint8_t format; // GR_SFLOW_FORMAT_*
+	ip4_addr_t agent; // sFlow agent address, ignored with IPFIX
+	uint32_t domain_id; // sFlow sub-agent ID or IPFIX observation domain ID
+};
+
+#define GR_SFLOW_COLLECTOR_SET REQUEST_TYPE(GR_SFLOW_MODULE, 0x0001)
+
+struct gr_sflow_collector_set_req {
+	struct gr_sflow_collector collector;
+};
+
+// struct gr_sflow_collector_set_resp { };
+
+// Sample one out of rate IP packets received on an interface, on average.
+#define GR_SFLOW_IFACE_SET REQUEST_TYPE(GR_SFLOW_MODULE, 0x0002)
+
+struct gr_sflow_iface_set_req {
+	uint16_t iface_id;
+	uint32_t rate; // 0 to disable sampling
+};
+
+// struct gr_sflow_iface_set_resp { };
+
+#define GR_SFLOW_SHOW REQUEST_TYPE(GR_SFLOW_MODULE, 0x0003)
+
+// struct gr_sflow_show_req { };
+
+struct gr_sflow_iface {
+	uint16_t iface_id;
+	uint32_t rate;
+	uint64_t samples;
+};
+
+struct gr_sflow_show_resp {
+	struct gr_sflow_collector collector;
+	uint64_t samples; // dequeued from the workers
+	uint64_t lost; // not handed to the control plane, ring full
+	uint64_t datagrams; // sent to the collector
+	uint64_t errors; // failed to send
+	uint16_t n_ifaces;
+	struct gr_sflow_iface ifaces[/* n_ifaces */];
+};
+
+#endif
@@ -0,0 +1,316 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_cli_iface.h>
+#include <gr_net_types.h>
+#include <gr_srv6.h>
+#include <gr_table.h>
+
+#include <ecoli.h>
+#include <libsmartcols.h>
+#include <rte_ip6.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void srv6_show(const struct gr_api_client *, const struct gr_iface *iface) {
+	const struct gr_iface_info_srv6 *srv6 = (const struct gr_iface_info_srv6 *)iface->info;
+	char buf[64];
+
+	inet_ntop(AF_INET6, &srv6->src, buf, sizeof(buf));
+	printf("src: %s\n", buf);
+	printf("segments:");
+	for (uint8_t i = 0; i < srv6->n_segments; i++) {
+		inet_ntop(AF_INET6, &srv6->segments[i], buf, sizeof(buf));
+		printf(" %s", buf);
+	}
+	printf("\n");
+	printf("encap_vrf: %u\n", srv6->encap_vrf_id);
+}
+
+static void
+srv6_list_info(const struct gr_api_client *, const struct gr_iface *iface, char *buf, size_t len) {
+	const struct gr_iface_info_srv6 *srv6 = (const struct gr_iface_info_srv6 *)iface->info;
+	char src[64], seg[64];
+
+	inet_ntop(AF_INET6, &srv6->src, src, sizeof(src));
+	inet_ntop(AF_INET6, &srv6->segments[0], seg, sizeof(seg));
+	snprintf(buf, len, "src=%s segment=%s n_segments=%u", src, seg, srv6->n_segments);
+}
+
+static struct cli_iface_type srv6_type = {
+	.type_id = GR_IFACE_TYPE_SRV6,
+	.name = "srv6",
+	.show = srv6_show,
+	.list_info = srv6_list_info,
+};
+
+static uint64_t parse_srv6_args(
+	const struct gr_api_client *c,
+	const struct ec_pnode *p,
+	struct gr_iface *iface,
+	bool update
+) {
+	uint64_t set_attrs = parse_iface_args(c, p, iface, update);
+	struct gr_iface_info_srv6 *srv6;
+	const struct ec_pnode *n;
+	const char *src;
+	uint8_t count;
+
+	srv6 = (struct gr_iface_info_srv6 *)iface->info;
+
+	src = arg_str(p, "SRC");
+	if (src != NULL) {
+		if (inet_pton(AF_INET6, src, &srv6->src) != 1) {
+			errno = EINVAL;
+			return 0;
+		}
+		set_attrs |= GR_SRV6_SET_SRC;
+	}
+	count = 0;
+	for (n = ec_pnode_find(p, "SEG"); n != NULL; n = ec_pnode_find_next(p, n, "SEG", false)) {
+		const struct ec_strvec *v = ec_pnode_get_strvec(n);
+		if (count == GR_SRV6_MAX_SEGMENTS) {
+			errno = ERANGE;
+			return 0;
+		}
+		if (inet_pton(AF_INET6, ec_strvec_val(v, 0), &srv6->segments[count++]) != 1) {
+			errno = EINVAL;
+			return 0;
+		}
+	}
+	if (count > 0) {
+		srv6->n_segments = count;
+		set_attrs |= GR_SRV6_SET_SEGMENTS;
+	}
+	if (arg_u16(p, "ENCAP_VRF", &srv6->encap_vrf_id) == 0)
+		set_attrs |= GR_SRV6_SET_ENCAP_VRF;
+
+	if (set_attrs == 0)
+		errno = EINVAL;
+	return set_attrs;
+}
+
+static cmd_status_t srv6_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	const struct gr_infra_iface_add_resp *resp;
+	struct gr_infra_iface_add_req req = {
+		.iface = {.type = GR_IFACE_TYPE_SRV6, .flags = GR_IFACE_F_UP}
+	};
+	void *resp_ptr = NULL;
+
+	if (parse_srv6_args(c, p, &req.iface, false) == 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_ADD, sizeof(req), &req, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	printf("Created interface %u\n", resp->iface_id);
+	free(resp_ptr);
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t srv6_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_iface_set_req req = {0};
+
+	if ((req.set_attrs = parse_srv6_args(c, p, &req.iface, true)) == 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t localsid_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_srv6_localsid_add_req req = {.exist_ok = true};
+	const char *behavior = arg_str(p, "BEHAVIOR");
+	struct gr_iface iface;
+
+	if (inet_pton(AF_INET6, arg_str(p, "SID"), &req.localsid.sid) != 1) {
+		errno = EINVAL;
+		return CMD_ERROR;
+	}
+	if (strcmp(behavior, "end") == 0)
+		req.localsid.behavior = GR_SRV6_BEHAVIOR_END;
+	else if (strcmp(behavior, "end.dt4") == 0)
+		req.localsid.behavior = GR_SRV6_BEHAVIOR_END_DT4;
+	else if (strcmp(behavior, "end.dt6") == 0)
+		req.localsid.behavior = GR_SRV6_BEHAVIOR_END_DT6;
+	if (arg_str(p, "IFACE") != NULL) {
+		if (iface_from_name(c, arg_str(p, "IFACE"), &iface) < 0)
+			return CMD_ERROR;
+		req.localsid.out_iface_id = iface.id;
+	} else if (req.localsid.behavior != GR_SRV6_BEHAVIOR_END) {
+		// decapsulated packets need an interface in the target VRF
+		errno = EDESTADDRREQ;
+		return CMD_ERROR;
+	}
+	if (arg_u16(p, "VRF", &req.localsid.vrf_id) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_SRV6_LOCALSID_ADD, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t localsid_del(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_srv6_localsid_del_req req = {.missing_ok = true};
+
+	if (inet_pton(AF_INET6, arg_str(p, "SID"), &req.sid) != 1) {
+		errno = EINVAL;
+		return CMD_ERROR;
+	}
+	if (arg_u16(p, "VRF", &req.vrf_id) < 0 && errno != ENOENT)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_SRV6_LOCALSID_DEL, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t localsid_list(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_srv6_localsid_list_req req = {.vrf_id = UINT16_MAX};
+	struct libscols_table *table = scols_new_table();
+	const struct gr_srv6_localsid_list_resp *resp;
+	struct gr_iface iface;
+	void *resp_ptr = NULL;
+	char buf[64];
+
+	if (table == NULL)
+		return CMD_ERROR;
+	if (arg_u16(p, "VRF", &req.vrf_id) < 0 && errno != ENOENT) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+	if (gr_api_client_send_recv(c, GR_SRV6_LOCALSID_LIST, sizeof(req), &req, &resp_ptr) < 0) {
+		scols_unref_table(table);
+		return CMD_ERROR;
+	}
+
+	resp = resp_ptr;
+
+	scols_table_new_column(table, "VRF", 0, 0);
+	scols_table_new_column(table, "SID", 0, 0);
+	scols_table_new_column(table, "BEHAVIOR", 0, 0);
+	scols_table_new_column(table, "IFACE", 0, 0);
+	scols_table_set_column_separator(table, "  ");
+
+	for (size_t i = 0; i < resp->n_localsids; i++) {
+		struct libscols_line *line = scols_table_new_line(table, NULL);
+		const struct gr_srv6_localsid *l = &resp->localsids[i];
+
+		scols_line_sprintf(line, 0, "%u", l->vrf_id);
+		inet_ntop(AF_INET6, &l->sid, buf, sizeof(buf));
+		scols_line_set_data(line, 1, buf);
+		scols_line_set_data(line, 2, gr_srv6_behavior_name(l->behavior));
+		if (l->behavior == GR_SRV6_BEHAVIOR_END)
+			scols_line_set_data(line, 3, "");
+		else if (iface_from_id(c, l->out_iface_id, &iface) == 0)
+			scols_line_set_data(line, 3, iface.name);
+		else
+			scols_line_sprintf(line, 3, "%u", l->out_iface_id);
+	}
+
+	gr_table_print(table);
+	scols_unref_table(table);
+	free(resp_ptr);
+
+	return CMD_SUCCESS;
+}
+
+#define SRV6_ATTRS_CMD "(src SRC),(segments SEG+),(encap-vrf ENCAP_VRF)"
+
+#define SRV6_ATTRS_ARGS                                                                            \
+	IFACE_ATTRS_ARGS,                                                                          \
+		with_help("Outer source address.", ec_node_re("SRC", IPV6_RE)),                    \
+		with_help("Segments to visit, in order.", ec_node_re("SEG", IPV6_RE)),             \
+		with_help(                                                                         \
+			"L3 routing domain of the outer packets.",                                 \
+			ec_node_uint("ENCAP_VRF", 0, UINT16_MAX - 1, 10)                           \
+		)
+
+#define SRV6_CTX(root, ctx, help) CLI_CONTEXT(root, ctx, CTX_ARG("srv6", help))
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_ADD, CTX_ARG("interface", "Create interfaces.")),
+		"srv6 NAME src SRC segments SEG+ [(encap-vrf ENCAP_VRF)," IFACE_ATTRS_CMD "]",
+		srv6_add,
+		"Create a new SRv6 headend interface.",
+		with_help("Interface name.", ec_node("any", "NAME")),
+		SRV6_ATTRS_ARGS
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("interface", "Modify interfaces.")),
+		"srv6 NAME (name NEW_NAME)," SRV6_ATTRS_CMD "," IFACE_ATTRS_CMD,
+		srv6_set,
+		"Modify srv6 parameters.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_SRV6))
+		),
+		with_help("New interface name.", ec_node("any", "NEW_NAME")),
+		SRV6_ATTRS_ARGS
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		SRV6_CTX(root, CTX_ADD, "Create SRv6 stack elements."),
+		"localsid SID behavior BEHAVIOR [(iface IFACE),(vrf VRF)]",
+		localsid_add,
+		"Add a local segment identifier.",
+		with_help("Segment identifier.", ec_node_re("SID", IPV6_RE)),
+		with_help(
+			"Behavior applied to packets sent to the SID.",
+			ec_node_re("BEHAVIOR", "end|end\\.dt4|end\\.dt6")
+		),
+		with_help(
+			"Receive decapsulated packets on this interface (End.DT4/End.DT6).",
+			ec_node_dyn("IFACE", complete_iface_names, NULL)
+		),
+		with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		SRV6_CTX(root, CTX_DEL, "Delete SRv6 stack elements."),
+		"localsid SID [vrf VRF]",
+		localsid_del,
+		"Delete a local segment identifier.",
+		with_help("Segment identifier.", ec_node_re("SID", IPV6_RE)),
+		with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10))
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		SRV6_CTX(root, CTX_SHOW, "Show SRv6 stack details."),
+		"localsid [vrf VRF]",
+		localsid_list,
+		"List local segment identifiers.",
+		with_help("L3 routing domain ID.", ec_node_uint("VRF", 0, UINT16_MAX - 1, 10))
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "srv6",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+	register_iface_type(&srv6_type);
+}
@@ -0,0 +1,369 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_srv6.h"
+#include "srv6_priv.h"
+
+#include <gr_api.h>
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_infra.h>
+#include <gr_ip6_control.h>
+#include <gr_log.h>
+#include <gr_rcu.h>
+
+#include <event2/event.h>
+#include <rte_hash.h>
+#include <rte_ip6.h>
+#include <rte_malloc.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+
+// headend interfaces //////////////////////////////////////////////////////////
+
+// The SRH lists the segments in reverse order, the first segment to visit is
+// the last entry. It is also copied as the outer destination address.
+static void srv6_srh_build(struct srv6_srh *srh, uint8_t n, const struct rte_ipv6_addr *segments) {
+	memset(srh, 0, sizeof(*srh));
+	srh->hdr.hdr_len = (SRV6_SRH_LEN(n) >> 3) - 1;
+	srh->hdr.type = RTE_IPV6_SRCRT_TYPE_4;
+	srh->hdr.segments_left = n - 1;
+	srh->hdr.last_entry = n - 1;
+	for (uint8_t i = 0; i < n; i++)
+		srh->segments[n - 1 - i] = segments[i];
+}
+
+static int iface_srv6_reconfig(
+	struct iface *iface,
+	uint64_t set_attrs,
+	uint16_t flags,
+	uint16_t mtu,
+	uint16_t vrf_id,
+	const void *api_info
+) {
+	struct iface_info_srv6 *cur = (struct iface_info_srv6 *)iface->info;
+	const struct gr_iface_info_srv6 *next = api_info;
+
+	if (set_attrs & GR_IFACE_SET_VRF) {
+		if (vrf_id >= IP6_MAX_VRFS)
+			return errno_set(EOVERFLOW);
+		iface->vrf_id = vrf_id;
+	}
+
+	if (set_attrs & (GR_SRV6_SET_SRC | GR_SRV6_SET_SEGMENTS | GR_SRV6_SET_ENCAP_VRF)) {
+		if (next->encap_vrf_id >= IP6_MAX_VRFS)
+			return errno_set(EOVERFLOW);
+		if (next->n_segments == 0 || next->n_segments > GR_SRV6_MAX_SEGMENTS)
+			return errno_set(ERANGE);
+
+		// ip6_route_lookup does not set errno for VRFs without routes
+		if (ip6_route_lookup(next->encap_vrf_id, &next->src) == NULL)
+			return errno_set(EHOSTUNREACH);
+		if (ip6_route_lookup(next->encap_vrf_id, &next->segments[0]) == NULL)
+			return errno_set(EHOSTUNREACH);
+
+		cur->src = next->src;
+		cur->encap_vrf_id = next->encap_vrf_id;
+		cur->n_segments = next->n_segments;
+		memcpy(cur->segments, next->segments, next->n_segments * sizeof(*next->segments));
+		srv6_srh_build(&cur->srh, cur->n_segments, cur->segments);
+	}
+
+	if (set_attrs & GR_IFACE_SET_FLAGS)
+		iface->flags = flags;
+	if (set_attrs & GR_IFACE_SET_MTU)
+		iface->mtu = mtu;
+
+	return 0;
+}
+
+static int iface_srv6_fini(struct iface *) {
+	return 0;
+}
+
+static int iface_srv6_init(struct iface *iface, const void *api_info) {
+	int ret;
+
+	ret = iface_srv6_reconfig(
+		iface, IFACE_SET_ALL, iface->flags, iface->mtu, iface->vrf_id, api_info
+	);
+	if (ret < 0)
+		errno = -ret;
+
+	return ret;
+}
+
+static void srv6_to_api(void *info, const struct iface *iface) {
+	const struct iface_info_srv6 *srv6 = (const struct iface_info_srv6 *)iface->info;
+	struct gr_iface_info_srv6 *api = info;
+
+	api->src = srv6->src;
+	api->encap_vrf_id = srv6->encap_vrf_id;
+	api->n_segments = srv6->n_segments;
+	memcpy(api->segments, srv6->segments, srv6->n_segments * sizeof(*srv6->segments));
+}
+
+static struct iface_type iface_type_srv6 = {
+	.id = GR_IFACE_TYPE_SRV6,
+	.name = "srv6",
+	.info_size = sizeof(struct iface_info_srv6),
+	.init = iface_srv6_init,
+	.reconfig = iface_srv6_reconfig,
+	.fini = iface_srv6_fini,
+	.to_api = srv6_to_api,
+};
+
+// local SIDs //////////////////////////////////////////////////////////////////
+
+static struct rte_hash *localsid_hash;
+
+void srv6_localsid_get_bulk(
+	const struct srv6_localsid_key *keys,
+	unsigned n,
+	const struct srv6_localsid **sids
+) {
+	const void *key_ptrs[SRV6_LOOKUP_BULK_MAX];
+	void *data[SRV6_LOOKUP_BULK_MAX];
+	uint64_t hits = 0;
+
+	assert(n <= SRV6_LOOKUP_BULK_MAX);
+
+	for (unsigned i = 0; i < n; i++)
+		key_ptrs[i] = &keys[i];
+
+	if (n > 0 && rte_hash_lookup_bulk_data(localsid_hash, key_ptrs, n, &hits, data) < 0)
+		hits = 0;
+
+	for (unsigned i = 0; i < n; i++)
+		sids[i] = hits & (UINT64_C(1) << i) ? data[i] : NULL;
+}
+
+// SIDs are also installed as /128 local routes so that ip6_input delivers the
+// matching packets to ip6_input_local.
+static int localsid_add(const struct gr_srv6_localsid *l, bool exist_ok) {
+	struct srv6_localsid_key key = {l->sid, l->vrf_id};
+	const struct iface *out_iface = NULL;
+	struct srv6_localsid *sid;
+	struct nexthop6 *nh;
+	void *data;
+	int ret;
+
+	if (l->vrf_id >= IP6_MAX_VRFS)
+		return errno_set(EOVERFLOW);
+
+	switch (l->behavior) {
+	case GR_SRV6_BEHAVIOR_END:
+		break;
+	case GR_SRV6_BEHAVIOR_END_DT4:
+	case GR_SRV6_BEHAVIOR_END_DT6:
+		if ((out_iface = iface_from_id(l->out_iface_id)) == NULL)
+			return -errno;
+		break;
+	default:
+		return errno_set(EINVAL);
+	}
+
+	if (rte_hash_lookup_data(localsid_hash, &key, &data) >= 0) {
+		sid = data;
+		if (exist_ok && sid->behavior == l->behavior && sid->out_iface == out_iface)
+			return 0;
+		return errno_set(EEXIST);
+	}
+
+	if (ip6_nexthop_lookup(l->vrf_id, &l->sid) != NULL)
+		return errno_set(EADDRINUSE);
+
+	if ((sid = rte_zmalloc(__func__, sizeof(*sid), 0)) == NULL)
+		return errno_set(ENOMEM);
+	sid->behavior = l->behavior;
+	sid->out_iface = out_iface;
+
+	if ((ret = rte_hash_add_key_data(localsid_hash, &key, sid)) < 0) {
+		rte_free(sid);
+		return errno_log(-ret, "rte_hash_add_key_data");
+	}
+
+	if ((nh = ip6_nexthop_new(l->vrf_id, GR_IFACE_ID_UNDEF, &l->sid)) == NULL) {
+		ret = -errno;
+		goto fail;
+	}
+	nh->prefixlen = RTE_IPV6_MAX_DEPTH;
+	nh->flags = GR_IP6_NH_F_LOCAL | GR_IP6_NH_F_REACHABLE | GR_IP6_NH_F_STATIC;
+
+	// this also does ip6_nexthop_incref(), the next hop is released on error
+	if ((ret = ip6_route_insert(l->vrf_id, &l->sid, RTE_IPV6_MAX_DEPTH, nh)) < 0)
+		goto fail;
+
+	return 0;
+fail:
+	rte_hash_del_key(localsid_hash, &key);
+	gr_rcu_defer_free(rte_free, sid);
+	return errno_set(-ret);
+}
+
+static int localsid_del(uint16_t vrf_id, const struct rte_ipv6_addr *addr) {
+	struct srv6_localsid_key key = {*addr, vrf_id};
+	void *data;
+
+	if (rte_hash_lookup_data(localsid_hash, &key, &data) < 0)
+		return errno_set(ENOENT);
+
+	if (ip6_route_delete(vrf_id, addr, RTE_IPV6_MAX_DEPTH) < 0)
+		LOG(WARNING, "vrf %u: route delete: %s", vrf_id, strerror(errno));
+
+	rte_hash_del_key(localsid_hash, &key);
+	gr_rcu_defer_free(rte_free, data);
+
+	return 0;
+}
+
+static struct api_out localsid_add_cb(const void *request, void ** /*response*/) {
+	const struct gr_srv6_localsid_add_req *req = request;
+
+	if (localsid_add(&req->localsid, req->exist_ok) < 0)
+		return api_out(errno, 0);
+
+	return api_out(0, 0);
+}
+
+static struct api_out localsid_del_cb(const void *request, void ** /*response*/) {
+	const struct gr_srv6_localsid_del_req *req = request;
+
+	if (localsid_del(req->vrf_id, &req->sid) < 0) {
+		if (errno != ENOENT || !req->missing_ok)
+			return api_out(errno, 0);
+	}
+
+	return api_out(0, 0);
+}
+
+static struct api_out localsid_list_cb(const void *request, void **response) {
+	const struct gr_srv6_localsid_list_req *req = request;
+	struct gr_srv6_localsid_list_resp *resp;
+	const struct srv6_localsid_key *key;
+	const struct srv6_localsid *sid;
+	struct gr_srv6_localsid *l;
+	uint32_t iter;
+	size_t len, n;
+	void *data;
+
+	n = 0;
+	iter = 0;
+	while (rte_hash_iterate(localsid_hash, (const void **)&key, &data, &iter) >= 0) {
+		if (key->vrf_id == req->vrf_id || req->vrf_id == UINT16_MAX)
+			n++;
+	}
+
+	len = sizeof(*resp) + n * sizeof(*resp->localsids);
+	if (len > GR_API_MAX_MSG_LEN)
+		return api_out(EMSGSIZE, 0);
+	if ((resp = calloc(1, len)) == NULL)
+		return api_out(ENOMEM, 0);
+
+	iter = 0;
+	while (rte_hash_iterate(localsid_hash, (const void **)&key, &data, &iter) >= 0) {
+		if (key->vrf_id != req->vrf_id && req->vrf_id != UINT16_MAX)
+			continue;
+		sid = data;
+		l = &resp->localsids[resp->n_localsids++];
+		l->sid = key->sid;
+		l->vrf_id = key->vrf_id;
+		l->behavior = sid->behavior;
+		if (sid->out_iface != NULL)
+			l->out_iface_id = sid->out_iface->id;
+	}
+	*response = resp;
+
+	return api_out(0, len);
+}
+
+// Decapsulated packets must not be sent to removed interfaces.
+static void srv6_iface_event_handler(iface_event_t event, struct iface *iface) {
+	const struct srv6_localsid_key *key;
+	const struct srv6_localsid *sid;
+	struct srv6_localsid_key del;
+	uint32_t iter;
+	void *data;
+
+	if (event != IFACE_EVENT_PRE_REMOVE)
+		return;
+
+	iter = 0;
+	while (rte_hash_iterate(localsid_hash, (const void **)&key, &data, &iter) >= 0) {
+		sid = data;
+		if (sid->out_iface != iface)
+			continue;
+		// the hash key is released by localsid_del
+		del = *key;
+		if (localsid_del(del.vrf_id, &del.sid) < 0)
+			LOG(WARNING, "%s: localsid_del: %s", iface->name, strerror(errno));
+	}
+}
+
+static void srv6_init(struct event_base *) {
+	struct rte_hash_parameters params = {
+		.name = "srv6_localsid",
+		.entries = IP6_MAX_ROUTES,
+		.key_len = sizeof(struct srv6_localsid_key),
+		.socket_id = SOCKET_ID_ANY,
+		.extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF
+			| RTE_HASH_EXTRA_FLAGS_TRANS_MEM_SUPPORT,
+	};
+	localsid_hash = rte_hash_create(&params);
+	if (localsid_hash == NULL)
+		ABORT("rte_hash_create(srv6_localsid)");
+}
+
+static void srv6_fini(struct event_base *) {
+	const void *key;
+	uint32_t iter;
+	void *data;
+
+	iter = 0;
+	while (rte_hash_iterate(localsid_hash, &key, &data, &iter) >= 0)
+		rte_free(data);
+	rte_hash_free(localsid_hash);
+	localsid_hash = NULL;
+}
+
+static struct gr_api_handler localsid_add_handler = {
+	.name = "srv6 localsid add",
+	.request_type = GR_SRV6_LOCALSID_ADD,
+	.callback = localsid_add_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler localsid_del_handler = {
+	.name = "srv6 localsid del",
+	.request_type = GR_SRV6_LOCALSID_DEL,
+	.callback = localsid_del_cb,
+	.flags = GR_API_F_CONFIG,
+};
+static struct gr_api_handler localsid_list_handler = {
+	.name = "srv6 localsid list",
+	.request_type = GR_SRV6_LOCALSID_LIST,
+	.callback = localsid_list_cb,
+};
+
+static struct gr_module srv6_module = {
+	.name = "srv6",
+	.init = srv6_init,
+	.fini = srv6_fini,
+	.fini_prio = 1000,
+};
+
+static struct iface_event_handler srv6_iface_event = {
+	.callback = srv6_iface_event_handler,
+};
+
+RTE_INIT(srv6_constructor) {
+	gr_register_api_handler(&localsid_add_handler);
+	gr_register_api_handler(&localsid_del_handler);
+	gr_register_api_handler(&localsid_list_handler);
+	gr_register_module(&srv6_module);
+	iface_type_register(&iface_type_srv6);
+	iface_event_register_handler(&srv6_iface_event);
+}
@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "srv6_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_eth_input.h>
+#include <gr_graph.h>
+#include <gr_ip6_datapath.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+
+#include <rte_byteorder.h>
+#include <rte_graph_worker.h>
+#include <rte_ip6.h>
+#include <rte_mbuf_ptype.h>
+
+#include <netinet/in.h>
+#include <string.h>
+
+enum {
+	IP_INPUT = 0,
+	IP6_INPUT,
+	NO_SID,
+	INVALID,
+	EDGE_COUNT,
+};
+
+// Validate the segment routing header (RFC 8754) and return it, or NULL if
+// the packet cannot be processed.
+static inline struct rte_ipv6_routing_ext *srv6_parse(struct rte_mbuf *m, uint16_t len) {
+	struct rte_ipv6_routing_ext *srh = rte_pktmbuf_mtod(m, struct rte_ipv6_routing_ext *);
+	uint16_t srh_len;
+
+	if (unlikely(len < sizeof(*srh) || rte_pktmbuf_data_len(m) < sizeof(*srh)))
+		return NULL;
+	if (unlikely(srh->type != RTE_IPV6_SRCRT_TYPE_4))
+		return NULL;
+
+	srh_len = (srh->hdr_len + 1) << 3;
+	if (unlikely(len < srh_len || rte_pktmbuf_data_len(m) < srh_len))
+		return NULL;
+	if (unlikely(srh->segments_left > srh->last_entry))
+		return NULL;
+	if (unlikely(SRV6_SRH_LEN(srh->last_entry + 1) > srh_len))
+		return NULL;
+
+	return srh;
+}
+
+static uint16_t srv6_local_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	struct rte_ipv6_routing_ext *srhs[SRV6_LOOKUP_BULK_MAX];
+	const struct srv6_localsid *sids[SRV6_LOOKUP_BULK_MAX];
+	struct srv6_localsid_key keys[SRV6_LOOKUP_BULK_MAX];
+	struct iface_stats_batch stats = {.tx = false};
+	uint8_t key_idx[SRV6_LOOKUP_BULK_MAX];
+	struct eth_input_mbuf_data *eth_data;
+	struct ip6_local_mbuf_data *ip_data;
+	const struct srv6_localsid *sid;
+	struct rte_ipv6_routing_ext *srh;
+	uint16_t i, n, count, n_keys;
+	const struct iface *iface;
+	struct rte_ipv6_addr *seg;
+	struct srv6_localsid_key key;
+	struct rte_ipv6_hdr *ip;
+	struct gr_spec_stream s;
+	struct rte_mbuf *mbuf;
+	rte_edge_t edge;
+
+	gr_spec_stream_init(&s, node, nb_objs);
+
+	for (n = 0; n < nb_objs; n += count) {
+		count = RTE_MIN(nb_objs - n, SRV6_LOOKUP_BULK_MAX);
+
+		// First pass: parse the headers and collect the SIDs. Consecutive
+		// packets sent to the same SID share a single lookup.
+		n_keys = 0;
+		for (i = 0; i < count; i++) {
+			mbuf = objs[n + i];
+			ip_data = ip6_local_mbuf_data(mbuf);
+			srhs[i] = srv6_parse(mbuf, ip_data->len);
+			if (srhs[i] == NULL)
+				continue;
+			key.sid = ip_data->dst;
+			key.vrf_id = ip_data->input_iface->vrf_id;
+			if (n_keys == 0 || memcmp(&keys[n_keys - 1], &key, sizeof(key)) != 0)
+				keys[n_keys++] = key;
+			key_idx[i] = n_keys - 1;
+		}
+		srv6_localsid_get_bulk(keys, n_keys, sids);
+
+		// Second pass: apply the SID behaviors.
+		for (i = 0; i < count; i++) {
+			mbuf = objs[n + i];
+			srh = srhs[i];
+			if (srh == NULL) {
+				edge = INVALID;
+				goto next;
+			}
+			sid = sids[key_idx[i]];
+			if (sid == NULL) {
+				edge = NO_SID;
+				goto next;
+			}
+			iface = ip6_local_mbuf_data(mbuf)->input_iface;
+
+			switch (sid->behavior) {
+			case GR_SRV6_BEHAVIOR_END:
+				if (srh->segments_left == 0) {
+					edge = INVALID;
+					goto next;
+				}
+				// Restore the IPv6 header and the extension headers
+				// stripped by ip6_input_local and route the packet to the
+				// next segment. The hop limit is decremented by
+				// ip6_forward.
+				srh->segments_left--;
+				seg = (struct rte_ipv6_addr *)(srh + 1);
+				ip = (struct rte_ipv6_hdr *)rte_pktmbuf_prepend(
+					mbuf, sizeof(*ip) + ip6_local_mbuf_data(mbuf)->ext_len
+				);
+				ip->dst_addr = seg[srh->segments_left];
+				edge = IP6_INPUT;
+				break;
+			case GR_SRV6_BEHAVIOR_END_DT4:
+			case GR_SRV6_BEHAVIOR_END_DT6:
+				if (srh->segments_left != 0) {
+					edge = INVALID;
+					goto next;
+				}
+				if (sid->behavior == GR_SRV6_BEHAVIOR_END_DT4
+				    && srh->next_hdr == IPPROTO_IPIP)
+					edge = IP_INPUT;
+				else if (sid->behavior == GR_SRV6_BEHAVIOR_END_DT6
+					 && srh->next_hdr == IPPROTO_IPV6)
+					edge = IP6_INPUT;
+				else {
+					edge = INVALID;
+					goto next;
+				}
+				rte_pktmbuf_adj(mbuf, (srh->hdr_len + 1) << 3);
+				// The hw checksum offload only works on the outer IP.
+				// Clear the offload flag so that ip_input will check it
+				// in software.
+				mbuf->ol_flags |= RTE_MBUF_F_RX_IP_CKSUM_NONE;
+				// Same for the packet type classification.
+				mbuf->packet_type = RTE_PTYPE_UNKNOWN;
+				// The inner packet is routed in the VRF of this interface.
+				iface = sid->out_iface;
+				iface_stats_add(&stats, iface->id, rte_pktmbuf_pkt_len(mbuf));
+				break;
+			default:
+				edge = INVALID;
+				goto next;
+			}
+			eth_data = eth_input_mbuf_data(mbuf);
+			eth_data->iface = iface;
+			eth_data->eth_dst = ETH_DST_LOCAL;
+next:
+			gr_spec_stream_enqueue(&s, graph, node, objs, n + i, edge);
+		}
+	}
+	gr_spec_stream_flush(&s, graph, node);
+	iface_stats_flush(&stats);
+
+	return nb_objs;
+}
+
+static void srv6_local_register(void) {
+	ip6_input_local_add_proto(IPPROTO_ROUTING, "srv6_local");
+}
+
+static struct rte_node_register srv6_local_node = {
+	.name = "srv6_local",
+
+	.process = srv6_local_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[IP_INPUT] = "ip_input",
+		[IP6_INPUT] = "ip6_input",
+		[NO_SID] = "srv6_local_no_sid",
+		[INVALID] = "srv6_local_invalid",
+	},
+};
+
+static struct gr_node_info srv6_local_info = {
+	.node = &srv6_local_node,
+	.register_callback = srv6_local_register,
+};
+
+GR_NODE_REGISTER(srv6_local_info);
+
+GR_DROP_REGISTER(srv6_local_no_sid);
+GR_DROP_REGISTER(srv6_local_invalid);
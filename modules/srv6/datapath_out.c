@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_srv6.h"
+#include "srv6_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_graph.h>
+#include <gr_ip4_datapath.h>
+#include <gr_ip6_control.h>
+#include <gr_ip6_datapath.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+
+#include <rte_byteorder.h>
+#include <rte_graph_worker.h>
+#include <rte_ip.h>
+#include <rte_ip6.h>
+
+#include <netinet/in.h>
+#include <string.h>
+
+enum {
+	IP6_OUTPUT = 0,
+	NO_TUNNEL,
+	NO_HEADROOM,
+	UNSUPPORTED,
+	EDGE_COUNT,
+};
+
+// This node is attached to both ip_output and ip6_output. Resolve the headend
+// interface from the next hop stored by either of them.
+static inline const struct iface *srv6_output_iface(struct rte_mbuf *m, uint8_t version) {
+	const struct nexthop6 *nh6;
+
+	if (version == 4)
+		return ip_output_mbuf_data(m)->nh->iface;
+
+	nh6 = ip6_output_mbuf_data(m)->nh;
+	return iface_from_id(nh6->iface_id);
+}
+
+// H.Encaps (RFC 8986): push an outer IPv6 header and a segment routing header
+// copied from the template prepared by the control plane.
+static uint16_t srv6_output_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	struct iface_stats_batch stats = {.tx = true};
+	struct ip6_output_mbuf_data *ip6_data;
+	uint32_t route_gen, iface_gen;
+	struct iface_info_srv6 *srv6;
+	struct rte_ipv4_hdr *inner4;
+	struct rte_ipv6_hdr *inner6;
+	struct rte_ipv6_hdr *outer;
+	struct srv6_srh *srh;
+	const struct iface *iface;
+	struct rte_mbuf *mbuf;
+	uint16_t srh_len;
+	uint32_t hash;
+	uint8_t version;
+	uint16_t len;
+	uint8_t proto;
+	rte_edge_t edge;
+
+	route_gen = __atomic_load_n(&ip6_route_gen, __ATOMIC_ACQUIRE);
+	iface_gen = __atomic_load_n(&iface_config_gen, __ATOMIC_ACQUIRE);
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+
+		version = *rte_pktmbuf_mtod(mbuf, const uint8_t *) >> 4;
+		iface = srv6_output_iface(mbuf, version);
+		if (iface == NULL || iface->type_id != GR_IFACE_TYPE_SRV6) {
+			edge = NO_TUNNEL;
+			goto next;
+		}
+		srv6 = (struct iface_info_srv6 *)iface->info;
+
+		// port_gso only supports IPv4 outer headers.
+		if (unlikely(mbuf->ol_flags & RTE_MBUF_F_TX_TCP_SEG)) {
+			edge = UNSUPPORTED;
+			goto next;
+		}
+
+		// The inner flow hash becomes the outer flow label so that the
+		// underlay can spread the flows over ECMP paths.
+		if (version == 4) {
+			inner4 = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+			ip_cksum_resolve(mbuf, inner4);
+			hash = ip4_flow_hash(mbuf, inner4);
+			len = rte_be_to_cpu_16(inner4->total_length);
+			proto = IPPROTO_IPIP;
+		} else {
+			inner6 = rte_pktmbuf_mtod(mbuf, struct rte_ipv6_hdr *);
+			hash = ip6_flow_hash(mbuf, inner6);
+			len = sizeof(*inner6) + rte_be_to_cpu_16(inner6->payload_len);
+			proto = IPPROTO_IPV6;
+		}
+
+		// The SRH is always inserted, even with a single segment. Without
+		// it, the packet would be handed to ip6tnl_input on the other end.
+		srh_len = SRV6_SRH_LEN(srv6->n_segments);
+		outer = (struct rte_ipv6_hdr *)rte_pktmbuf_prepend(mbuf, sizeof(*outer) + srh_len);
+		if (unlikely(outer == NULL)) {
+			edge = NO_HEADROOM;
+			goto next;
+		}
+		srh = (struct srv6_srh *)(outer + 1);
+		memcpy(srh, &srv6->srh, srh_len);
+		srh->hdr.next_hdr = proto;
+		len += srh_len;
+		ip6_set_fields(outer, len, IPPROTO_ROUTING, &srv6->src, &srv6->segments[0]);
+		outer->vtc_flow |= rte_cpu_to_be_32(hash & RTE_IPV6_HDR_FL_MASK);
+		iface_stats_add(&stats, iface->id, len);
+
+		// Resolve nexthop for the encapsulated packet in the underlay VRF.
+		ip6_data = ip6_output_mbuf_data(mbuf);
+		ip6_data->input_iface = iface;
+		ip6_data->nh = ip6_route_cache_lookup(
+			&srv6->route, srv6->encap_vrf_id, &srv6->segments[0], route_gen, iface_gen
+		);
+		edge = IP6_OUTPUT;
+next:
+		rte_node_enqueue_x1(graph, node, edge, mbuf);
+	}
+	iface_stats_flush(&stats);
+
+	return nb_objs;
+}
+
+static void srv6_output_register(void) {
+	ip_output_add_tunnel(GR_IFACE_TYPE_SRV6, "srv6_output");
+	ip6_output_add_tunnel(GR_IFACE_TYPE_SRV6, "srv6_output");
+}
+
+static struct rte_node_register srv6_output_node = {
+	.name = "srv6_output",
+
+	.process = srv6_output_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[IP6_OUTPUT] = "ip6_output",
+		[NO_TUNNEL] = "srv6_output_no_tunnel",
+		[NO_HEADROOM] = "error_no_headroom",
+		[UNSUPPORTED] = "srv6_output_unsupported",
+	},
+};
+
+static struct gr_node_info srv6_output_info = {
+	.node = &srv6_output_node,
+	.register_callback = srv6_output_register,
+};
+
+GR_NODE_REGISTER(srv6_output_info);
+
+GR_DROP_REGISTER(srv6_output_no_tunnel);
+GR_DROP_REGISTER(srv6_output_unsupported);
@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_API_SRV6
+#define _GR_API_SRV6
+
+#include <gr_api.h>
+#include <gr_bitops.h>
+#include <gr_infra.h>
+#include <gr_macro.h>
+#include <gr_net_types.h>
+
+#include <rte_ip6.h>
+
+#include <stdint.h>
+
+// SRv6 headend interfaces (RFC 8986 H.Encaps). Packets routed through them
+// are encapsulated in IPv6 with a segment routing header.
+#define GR_IFACE_TYPE_SRV6 0x0007
+
+#define GR_SRV6_MAX_SEGMENTS 8
+
+// SRV6 reconfig attributes
+#define GR_SRV6_SET_SRC GR_BIT64(32)
+#define GR_SRV6_SET_SEGMENTS GR_BIT64(33)
+#define GR_SRV6_SET_ENCAP_VRF GR_BIT64(34)
+
+// Info for GR_IFACE_TYPE_SRV6 interfaces
+struct gr_iface_info_srv6 {
+	struct rte_ipv6_addr src;
+	uint16_t encap_vrf_id; // VRF of the underlay routes
+	uint8_t n_segments;
+	struct rte_ipv6_addr segments[GR_SRV6_MAX_SEGMENTS]; // in traversal order
+};
+
+static_assert(sizeof(struct gr_iface_info_srv6) <= MEMBER_SIZE(struct gr_iface, info));
+
+#define GR_SRV6_MODULE 0x5e6e
+
+// local SIDs //////////////////////////////////////////////////////////////////
+
+#define GR_SRV6_BEHAVIOR_END 1 // next segment
+#define GR_SRV6_BEHAVIOR_END_DT4 2 // decapsulate and lookup in an IPv4 VRF
+#define GR_SRV6_BEHAVIOR_END_DT6 3 // decapsulate and lookup in an IPv6 VRF
+
+static inline const char *gr_srv6_behavior_name(uint8_t behavior) {
+	switch (behavior) {
+	case GR_SRV6_BEHAVIOR_END:
+		return "end";
+	case GR_SRV6_BEHAVIOR_END_DT4:
+		return "end.dt4";
+	case GR_SRV6_BEHAVIOR_END_DT6:
+		return "end.dt6";
+	}
+	return "?";
+}
+
+struct gr_srv6_localsid {
+	struct rte_ipv6_addr sid;
+	uint16_t vrf_id;
+	uint8_t behavior; // GR_SRV6_BEHAVIOR_*
+	// End.DT4/End.DT6: decapsulated packets are received on this interface
+	// and routed in its VRF.
+	uint16_t out_iface_id;
+};
+
+#define GR_SRV6_LOCALSID_ADD REQUEST_TYPE(GR_SRV6_MODULE, 0x0001)
+
+struct gr_srv6_localsid_add_req {
+	struct gr_srv6_localsid localsid;
+	uint8_t exist_ok;
+};
+
+// struct gr_srv6_localsid_add_resp { };
+
+#define GR_SRV6_LOCALSID_DEL REQUEST_TYPE(GR_SRV6_MODULE, 0x0002)
+
+struct gr_srv6_localsid_del_req {
+	uint16_t vrf_id;
+	struct rte_ipv6_addr sid;
+	uint8_t missing_ok;
+};
+
+// struct gr_srv6_localsid_del_resp { };
+
+#define GR_SRV6_LOCALSID_LIST REQUEST_TYPE(GR_SRV6_MODULE, 0x0003)
+
+struct gr_srv6_localsid_list_req {
+	uint16_t vrf_id;
+};
+
+struct gr_srv6_localsid_list_resp {
+	uint16_t n_localsids;
+	struct gr_srv6_localsid localsids[/* n_localsids */];
+};
+
+#endif
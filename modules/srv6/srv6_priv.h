@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _SRV6_PRIV_H
+#define _SRV6_PRIV_H
+
+#include <gr_iface.h>
+#include <gr_ip6_control.h>
+#include <gr_srv6.h>
+
+#include <rte_hash.h>
+#include <rte_ip6.h>
+
+#include <stdint.h>
+
+// Segment routing header with room for GR_SRV6_MAX_SEGMENTS (RFC 8754).
+struct srv6_srh {
+	struct rte_ipv6_routing_ext hdr;
+	struct rte_ipv6_addr segments[GR_SRV6_MAX_SEGMENTS]; // in reverse order
+} __rte_packed;
+
+struct __rte_aligned(alignof(void *)) iface_info_srv6 {
+	struct rte_ipv6_addr src;
+	uint16_t encap_vrf_id;
+	uint8_t n_segments;
+	struct rte_ipv6_addr segments[GR_SRV6_MAX_SEGMENTS];
+	// Prebuilt from segments, only next_hdr changes per packet.
+	struct srv6_srh srh;
+	struct ip6_route_cache route; // underlay next hop of segments[0]
+};
+
+// Length in bytes of a segment routing header with n segments.
+#define SRV6_SRH_LEN(n) (sizeof(struct rte_ipv6_routing_ext) + (n) * sizeof(struct rte_ipv6_addr))
+
+struct srv6_localsid_key {
+	struct rte_ipv6_addr sid;
+	// uint32_t to avoid padding bytes in the hash key, see struct ipip_key
+	uint32_t vrf_id;
+};
+
+struct srv6_localsid {
+	uint8_t behavior;
+	const struct iface *out_iface; // End.DT4/End.DT6 only
+};
+
+#define SRV6_LOOKUP_BULK_MAX RTE_HASH_LOOKUP_BULK_MAX
+
+// Lookup up to SRV6_LOOKUP_BULK_MAX local SIDs at once. Unknown SIDs are NULL.
+void srv6_localsid_get_bulk(
+	const struct srv6_localsid_key *keys,
+	unsigned n,
+	const struct srv6_localsid **sids
+);
+
+#endif
@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include <gr_api.h>
+#include <gr_cli.h>
+#include <gr_cli_iface.h>
+#include <gr_net_types.h>
+#include <gr_vhost.h>
+
+#include <ecoli.h>
+
+#include <errno.h>
+#include <string.h>
+
+static void vhost_show(const struct gr_api_client *, const struct gr_iface *iface) {
+	const struct gr_iface_info_vhost *vhost = (const struct gr_iface_info_vhost *)iface->info;
+
+	printf("path: %s\n", vhost->path);
+	printf("dmadev: %s\n", vhost->dmadev[0] != '\0' ? vhost->dmadev : "none");
+	printf("mac: " ETH_ADDR_FMT "\n", ETH_ADDR_SPLIT(&vhost->mac));
+	printf("guest: %s\n", vhost->connected ? "connected" : "disconnected");
+}
+
+static void
+vhost_list_info(const struct gr_api_client *, const struct gr_iface *iface, char *buf, size_t len) {
+	const struct gr_iface_info_vhost *vhost = (const struct gr_iface_info_vhost *)iface->info;
+	size_t n;
+
+	n = snprintf(buf, len, "path=%s", vhost->path);
+	if (vhost->dmadev[0] != '\0' && n < len)
+		snprintf(buf + n, len - n, " dmadev=%s", vhost->dmadev);
+}
+
+static struct cli_iface_type vhost_type = {
+	.type_id = GR_IFACE_TYPE_VHOST,
+	.name = "vhost",
+	.show = vhost_show,
+	.list_info = vhost_list_info,
+};
+
+static uint64_t parse_vhost_args(
+	const struct gr_api_client *c,
+	const struct ec_pnode *p,
+	struct gr_iface *iface,
+	bool update
+) {
+	uint64_t set_attrs = parse_iface_args(c, p, iface, update);
+	struct gr_iface_info_vhost *vhost;
+	const char *path, *dmadev;
+
+	vhost = (struct gr_iface_info_vhost *)iface->info;
+
+	path = arg_str(p, "PATH");
+	if (path != NULL && memccpy(vhost->path, path, 0, sizeof(vhost->path)) == NULL) {
+		errno = ENAMETOOLONG;
+		return 0;
+	}
+	dmadev = arg_str(p, "DMADEV");
+	if (dmadev != NULL && memccpy(vhost->dmadev, dmadev, 0, sizeof(vhost->dmadev)) == NULL) {
+		errno = ENAMETOOLONG;
+		return 0;
+	}
+	if (arg_eth_addr(p, "MAC", &vhost->mac) == 0)
+		set_attrs |= GR_VHOST_SET_MAC;
+
+	if (set_attrs == 0)
+		errno = EINVAL;
+	return set_attrs;
+}
+
+static cmd_status_t vhost_add(const struct gr_api_client *c, const struct ec_pnode *p) {
+	const struct gr_infra_iface_add_resp *resp;
+	struct gr_infra_iface_add_req req = {
+		.iface = {.type = GR_IFACE_TYPE_VHOST, .flags = GR_IFACE_F_UP}
+	};
+	void *resp_ptr = NULL;
+
+	// a random address is generated when MAC is omitted
+	if (parse_vhost_args(c, p, &req.iface, false) == 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_ADD, sizeof(req), &req, &resp_ptr) < 0)
+		return CMD_ERROR;
+
+	resp = resp_ptr;
+	printf("Created interface %u\n", resp->iface_id);
+	free(resp_ptr);
+	return CMD_SUCCESS;
+}
+
+static cmd_status_t vhost_set(const struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_infra_iface_set_req req = {0};
+
+	if ((req.set_attrs = parse_vhost_args(c, p, &req.iface, true)) == 0)
+		return CMD_ERROR;
+
+	if (gr_api_client_send_recv(c, GR_INFRA_IFACE_SET, sizeof(req), &req, NULL) < 0)
+		return CMD_ERROR;
+
+	return CMD_SUCCESS;
+}
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_ADD, CTX_ARG("interface", "Create interfaces.")),
+		"vhost NAME path PATH [(dmadev DMADEV),(mac MAC)," IFACE_ATTRS_CMD "]",
+		vhost_add,
+		"Create a new vhost-user interface.",
+		with_help("Interface name.", ec_node("any", "NAME")),
+		with_help("vhost-user socket path.", ec_node("file", "PATH")),
+		with_help(
+			"DMA device that copies the frames sent to the guest.",
+			ec_node("any", "DMADEV")
+		),
+		with_help("Set the ethernet address.", ec_node_re("MAC", ETH_ADDR_RE)),
+		IFACE_ATTRS_ARGS
+	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		CLI_CONTEXT(root, CTX_SET, CTX_ARG("interface", "Modify interfaces.")),
+		"vhost NAME (name NEW_NAME),(mac MAC)," IFACE_ATTRS_CMD,
+		vhost_set,
+		"Modify vhost parameters.",
+		with_help(
+			"Interface name.",
+			ec_node_dyn("NAME", complete_iface_names, INT2PTR(GR_IFACE_TYPE_VHOST))
+		),
+		with_help("New interface name.", ec_node("any", "NEW_NAME")),
+		with_help("Set the ethernet address.", ec_node_re("MAC", ETH_ADDR_RE)),
+		IFACE_ATTRS_ARGS
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct gr_cli_context ctx = {
+	.name = "vhost",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	register_context(&ctx);
+	register_iface_type(&vhost_type);
+}
@@ -0,0 +1,310 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_vhost.h"
+#include "vhost_priv.h"
+
+#include <gr_iface.h>
+#include <gr_infra.h>
+#include <gr_log.h>
+#include <gr_mempool.h>
+#include <gr_rcu.h>
+
+#include <rte_dmadev.h>
+#include <rte_ether.h>
+#include <rte_graph.h>
+#include <rte_mbuf.h>
+#include <rte_spinlock.h>
+#include <rte_vhost.h>
+#include <rte_vhost_async.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+#define VHOST_RX_MBUFS 4096
+
+// Serializes the vhost-user callbacks, which run in the vhost library thread,
+// with the interfaces creation and destruction.
+static pthread_mutex_t vhost_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// DMA devices are shared by all vhost interfaces, they are only configured once.
+static bool dma_configured[RTE_DMADEV_DEFAULT_MAX];
+
+static int vhost_dma_setup(const char *name) {
+	struct rte_dma_vchan_conf vchan = {.direction = RTE_DMA_DIR_MEM_TO_MEM};
+	struct rte_dma_conf conf = {.nb_vchans = 1};
+	struct rte_dma_info info;
+	int dma_id, ret;
+
+	if ((dma_id = rte_dma_get_dev_id_by_name(name)) < 0)
+		return errno_set(ENODEV);
+	if (dma_id >= (int)RTE_DIM(dma_configured))
+		return errno_set(ERANGE);
+	if (dma_configured[dma_id])
+		return dma_id;
+
+	if ((ret = rte_dma_info_get(dma_id, &info)) < 0)
+		return errno_log(-ret, "rte_dma_info_get");
+	vchan.nb_desc = info.max_desc;
+	if ((ret = rte_dma_configure(dma_id, &conf)) < 0)
+		return errno_log(-ret, "rte_dma_configure");
+	if ((ret = rte_dma_vchan_setup(dma_id, 0, &vchan)) < 0)
+		return errno_log(-ret, "rte_dma_vchan_setup");
+	if ((ret = rte_dma_start(dma_id)) < 0)
+		return errno_log(-ret, "rte_dma_start");
+	if ((ret = rte_vhost_async_dma_configure(dma_id, 0)) < 0)
+		return errno_log(-ret, "rte_vhost_async_dma_configure");
+
+	dma_configured[dma_id] = true;
+	LOG(INFO, "%s: dma device %d ready for vhost async copies", name, dma_id);
+
+	return dma_id;
+}
+
+static const struct iface *vhost_from_path(const char *path) {
+	const struct iface_info_vhost *vhost;
+
+	for (unsigned i = 0; i < vhost_count; i++) {
+		vhost = (const struct iface_info_vhost *)vhost_ifaces[i]->info;
+		if (strcmp(vhost->path, path) == 0)
+			return vhost_ifaces[i];
+	}
+	return NULL;
+}
+
+// Called with vhost_lock held.
+static void vhost_detach(struct iface *iface) {
+	struct iface_info_vhost *vhost = (struct iface_info_vhost *)iface->info;
+	struct rte_mbuf *pkts[RTE_GRAPH_BURST_SIZE];
+	int vid = vhost->vid;
+	uint16_t n;
+
+	if (vid < 0)
+		return;
+
+	__atomic_store_n(&vhost->vid, -1, __ATOMIC_RELEASE);
+	__atomic_fetch_and(&iface->state, ~GR_IFACE_S_RUNNING, __ATOMIC_RELAXED);
+	// no worker is using the device anymore
+	gr_rcu_synchronize();
+
+	if (vhost->dma_id >= 0) {
+		while (vhost->inflight > 0) {
+			n = rte_vhost_clear_queue_thread_unsafe(
+				vid, VIRTIO_RXQ, pkts, RTE_DIM(pkts), vhost->dma_id, 0
+			);
+			vhost->inflight -= n;
+			rte_pktmbuf_free_bulk(pkts, n);
+		}
+		rte_vhost_async_channel_unregister(vid, VIRTIO_RXQ);
+	}
+	LOG(INFO, "%s: guest detached", iface->name);
+}
+
+static int vhost_new_device(int vid) {
+	struct iface_info_vhost *vhost;
+	char path[GR_VHOST_PATH_SIZE];
+	struct iface *iface;
+	int ret = 0;
+
+	if (rte_vhost_get_ifname(vid, path, sizeof(path)) < 0)
+		return -1;
+
+	pthread_mutex_lock(&vhost_lock);
+	if ((iface = (struct iface *)vhost_from_path(path)) == NULL) {
+		ret = -1;
+		goto out;
+	}
+	vhost = (struct iface_info_vhost *)iface->info;
+	if (vhost->dma_id >= 0 && (ret = rte_vhost_async_channel_register(vid, VIRTIO_RXQ)) < 0) {
+		LOG(ERR, "%s: rte_vhost_async_channel_register failed", iface->name);
+		goto out;
+	}
+	// guest notifications are useless, the queues are polled
+	rte_vhost_enable_guest_notification(vid, VIRTIO_RXQ, 0);
+	rte_vhost_enable_guest_notification(vid, VIRTIO_TXQ, 0);
+	vhost->inflight = 0;
+	__atomic_store_n(&vhost->vid, vid, __ATOMIC_RELEASE);
+	__atomic_fetch_or(&iface->state, GR_IFACE_S_RUNNING, __ATOMIC_RELAXED);
+	LOG(INFO, "%s: guest attached", iface->name);
+out:
+	pthread_mutex_unlock(&vhost_lock);
+	return ret;
+}
+
+static void vhost_destroy_device(int vid) {
+	char path[GR_VHOST_PATH_SIZE];
+	struct iface *iface;
+
+	if (rte_vhost_get_ifname(vid, path, sizeof(path)) < 0)
+		return;
+
+	pthread_mutex_lock(&vhost_lock);
+	if ((iface = (struct iface *)vhost_from_path(path)) != NULL)
+		vhost_detach(iface);
+	pthread_mutex_unlock(&vhost_lock);
+}
+
+static const struct rte_vhost_device_ops vhost_ops = {
+	.new_device = vhost_new_device,
+	.destroy_device = vhost_destroy_device,
+};
+
+static void vhost_list_del(const struct iface *iface) {
+	unsigned count = vhost_count;
+
+	for (unsigned i = 0; i < count; i++) {
+		if (vhost_ifaces[i] != iface)
+			continue;
+		__atomic_store_n(&vhost_ifaces[i], vhost_ifaces[count - 1], __ATOMIC_RELEASE);
+		__atomic_store_n(&vhost_ifaces[count - 1], NULL, __ATOMIC_RELEASE);
+		__atomic_store_n(&vhost_count, count - 1, __ATOMIC_RELEASE);
+		break;
+	}
+}
+
+static int iface_vhost_reconfig(
+	struct iface *iface,
+	uint64_t set_attrs,
+	uint16_t flags,
+	uint16_t mtu,
+	uint16_t vrf_id,
+	const void *api_info
+) {
+	struct iface_info_vhost *vhost = (struct iface_info_vhost *)iface->info;
+	const struct gr_iface_info_vhost *next = api_info;
+
+	if (set_attrs & GR_VHOST_SET_MAC) {
+		if (rte_is_zero_ether_addr(&next->mac))
+			rte_eth_random_addr(vhost->mac.addr_bytes);
+		else if (rte_is_unicast_ether_addr(&next->mac))
+			vhost->mac = next->mac;
+		else
+			return errno_set(EINVAL);
+	}
+
+	if (set_attrs & GR_IFACE_SET_FLAGS)
+		iface->flags = flags;
+	if (set_attrs & GR_IFACE_SET_MTU)
+		iface->mtu = mtu;
+	if (set_attrs & GR_IFACE_SET_VRF)
+		iface->vrf_id = vrf_id;
+
+	return 0;
+}
+
+static int iface_vhost_fini(struct iface *iface) {
+	struct iface_info_vhost *vhost = (struct iface_info_vhost *)iface->info;
+
+	pthread_mutex_lock(&vhost_lock);
+	vhost_list_del(iface);
+	vhost_detach(iface);
+	pthread_mutex_unlock(&vhost_lock);
+
+	if (vhost->path[0] != '\0' && rte_vhost_driver_unregister(vhost->path) < 0)
+		LOG(ERR, "%s: rte_vhost_driver_unregister failed", iface->name);
+	gr_pktmbuf_pool_release(vhost->pool, VHOST_RX_MBUFS);
+	vhost->pool = NULL;
+
+	return 0;
+}
+
+static int iface_vhost_init(struct iface *iface, const void *api_info) {
+	struct iface_info_vhost *vhost = (struct iface_info_vhost *)iface->info;
+	const struct gr_iface_info_vhost *conf = api_info;
+	uint64_t flags = 0;
+	int ret;
+
+	vhost->vid = -1;
+	vhost->dma_id = -1;
+	rte_spinlock_init(&vhost->rx_lock);
+	rte_spinlock_init(&vhost->tx_lock);
+
+	if (conf->path[0] == '\0' || memchr(conf->path, '\0', sizeof(conf->path)) == NULL)
+		return errno_set(EINVAL);
+	if (memchr(conf->dmadev, '\0', sizeof(conf->dmadev)) == NULL)
+		return errno_set(ENAMETOOLONG);
+
+	if (conf->dmadev[0] != '\0') {
+		if ((ret = vhost_dma_setup(conf->dmadev)) < 0)
+			return ret;
+		vhost->dma_id = ret;
+		flags |= RTE_VHOST_USER_ASYNC_COPY;
+	}
+
+	ret = iface_vhost_reconfig(
+		iface, IFACE_SET_ALL, iface->flags, iface->mtu, iface->vrf_id, api_info
+	);
+	if (ret < 0)
+		return ret;
+
+	vhost->pool = gr_pktmbuf_pool_get(SOCKET_ID_ANY, VHOST_RX_MBUFS);
+	if (vhost->pool == NULL)
+		return -errno;
+
+	if (rte_vhost_driver_register(conf->path, flags) < 0) {
+		gr_pktmbuf_pool_release(vhost->pool, VHOST_RX_MBUFS);
+		return errno_set(EADDRINUSE);
+	}
+	memccpy(vhost->path, conf->path, 0, sizeof(vhost->path));
+	memccpy(vhost->dmadev, conf->dmadev, 0, sizeof(vhost->dmadev));
+
+	pthread_mutex_lock(&vhost_lock);
+	__atomic_store_n(&vhost_ifaces[vhost_count], iface, __ATOMIC_RELEASE);
+	__atomic_store_n(&vhost_count, vhost_count + 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&vhost_lock);
+
+	if (rte_vhost_driver_callback_register(conf->path, &vhost_ops) < 0) {
+		ret = errno_set(EINVAL);
+		goto err;
+	}
+	if (rte_vhost_driver_start(conf->path) < 0) {
+		ret = errno_log(EIO, "rte_vhost_driver_start");
+		goto err;
+	}
+
+	return 0;
+err:
+	iface_vhost_fini(iface);
+	return ret;
+}
+
+static int iface_vhost_get_eth_addr(const struct iface *iface, struct rte_ether_addr *mac) {
+	const struct iface_info_vhost *vhost = (const struct iface_info_vhost *)iface->info;
+	*mac = vhost->mac;
+	return 0;
+}
+
+static int iface_vhost_eth_addr_filter(struct iface *, const struct rte_ether_addr *mac) {
+	// Without a filter, all multicast frames sent by the guest are accepted.
+	if (mac == NULL || !rte_is_multicast_ether_addr(mac))
+		return errno_set(EINVAL);
+	return 0;
+}
+
+static void vhost_to_api(void *info, const struct iface *iface) {
+	const struct iface_info_vhost *vhost = (const struct iface_info_vhost *)iface->info;
+	struct gr_iface_info_vhost *api = info;
+
+	memccpy(api->path, vhost->path, 0, sizeof(api->path));
+	memccpy(api->dmadev, vhost->dmadev, 0, sizeof(api->dmadev));
+	api->mac = vhost->mac;
+	api->connected = __atomic_load_n(&vhost->vid, __ATOMIC_ACQUIRE) >= 0;
+}
+
+static struct iface_type iface_type_vhost = {
+	.id = GR_IFACE_TYPE_VHOST,
+	.name = "vhost",
+	.info_size = sizeof(struct iface_info_vhost),
+	.init = iface_vhost_init,
+	.reconfig = iface_vhost_reconfig,
+	.fini = iface_vhost_fini,
+	.get_eth_addr = iface_vhost_get_eth_addr,
+	.add_eth_addr = iface_vhost_eth_addr_filter,
+	.del_eth_addr = iface_vhost_eth_addr_filter,
+	.to_api = vhost_to_api,
+};
+
+RTE_INIT(vhost_constructor) {
+	iface_type_register(&iface_type_vhost);
+}
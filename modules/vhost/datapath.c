@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_vhost.h"
+#include "vhost_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_eth_input.h>
+#include <gr_eth_output.h>
+#include <gr_graph.h>
+#include <gr_iface.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+
+#include <rte_graph_worker.h>
+#include <rte_mbuf.h>
+#include <rte_spinlock.h>
+#include <rte_vhost.h>
+#include <rte_vhost_async.h>
+
+#include <stdint.h>
+
+const struct iface *vhost_ifaces[MAX_IFACES];
+unsigned vhost_count;
+
+void vhost_tx_completed(struct iface_info_vhost *vhost, int vid) {
+	struct rte_mbuf *done[RTE_GRAPH_BURST_SIZE];
+	uint16_t n;
+
+	while (vhost->inflight > 0) {
+		n = rte_vhost_poll_enqueue_completed(
+			vid, VIRTIO_RXQ, done, RTE_DIM(done), vhost->dma_id, 0
+		);
+		if (n == 0)
+			break;
+		__atomic_store_n(&vhost->inflight, vhost->inflight - n, __ATOMIC_RELAXED);
+		rte_pktmbuf_free_bulk(done, n);
+	}
+}
+
+enum {
+	ETH_INPUT = 0,
+	RX_EDGE_COUNT,
+};
+
+// Poll the guests transmissions. The DMA completions are also checked here so
+// that mbufs sent to idle guests are returned to their pool in a timely manner.
+static uint16_t
+vhost_rx_process(struct rte_graph *graph, struct rte_node *node, void **, uint16_t) {
+	struct rte_mbuf *mbufs[RTE_GRAPH_BURST_SIZE];
+	struct iface_info_vhost *vhost;
+	struct eth_input_mbuf_data *d;
+	const struct iface *iface;
+	uint16_t n, total = 0;
+	unsigned count;
+	int vid;
+
+	count = __atomic_load_n(&vhost_count, __ATOMIC_ACQUIRE);
+
+	for (unsigned v = 0; v < count; v++) {
+		if ((iface = __atomic_load_n(&vhost_ifaces[v], __ATOMIC_ACQUIRE)) == NULL)
+			continue;
+		vhost = (struct iface_info_vhost *)iface->info;
+		if ((vid = __atomic_load_n(&vhost->vid, __ATOMIC_ACQUIRE)) < 0)
+			continue;
+
+		if (vhost->dma_id >= 0 && __atomic_load_n(&vhost->inflight, __ATOMIC_RELAXED) > 0
+		    && rte_spinlock_trylock(&vhost->tx_lock)) {
+			vhost_tx_completed(vhost, vid);
+			rte_spinlock_unlock(&vhost->tx_lock);
+		}
+
+		if (!rte_spinlock_trylock(&vhost->rx_lock))
+			continue; // another worker is polling it
+		n = rte_vhost_dequeue_burst(vid, VIRTIO_TXQ, vhost->pool, mbufs, RTE_DIM(mbufs));
+		rte_spinlock_unlock(&vhost->rx_lock);
+		if (n == 0)
+			continue;
+
+		for (uint16_t i = 0; i < n; i++) {
+			d = eth_input_mbuf_data(mbufs[i]);
+			d->iface = iface;
+			d->eth_dst = ETH_DST_UNKNOWN;
+		}
+		if (unlikely(packet_trace_enabled)) {
+			for (uint16_t i = 0; i < n; i++)
+				trace_packet(node, iface->id, mbufs[i]);
+		}
+		// Interface stats are accounted by eth_input.
+		rte_node_enqueue(graph, node, ETH_INPUT, (void **)mbufs, n);
+		total += n;
+	}
+
+	return total;
+}
+
+static struct rte_node_register vhost_rx_node = {
+	.name = "vhost_rx",
+	.flags = RTE_NODE_SOURCE_F,
+
+	.process = vhost_rx_process,
+
+	.nb_edges = RX_EDGE_COUNT,
+	.next_nodes = {
+		[ETH_INPUT] = "eth_input",
+	},
+};
+
+static struct gr_node_info vhost_rx_info = {
+	.node = &vhost_rx_node,
+};
+
+GR_NODE_REGISTER(vhost_rx_info);
+
+enum {
+	NOT_CONNECTED = 0,
+	QUEUE_FULL,
+	TX_EDGE_COUNT,
+};
+
+// Send a burst of frames of the same interface to the guest. With a DMA device,
+// the mbufs are only freed once the copy is complete.
+static void vhost_tx_burst(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	const struct iface *iface,
+	struct rte_mbuf **mbufs,
+	uint16_t n
+) {
+	struct iface_info_vhost *vhost = (struct iface_info_vhost *)iface->info;
+	uint16_t sent;
+	int vid;
+
+	if ((vid = __atomic_load_n(&vhost->vid, __ATOMIC_ACQUIRE)) < 0) {
+		rte_node_enqueue(graph, node, NOT_CONNECTED, (void **)mbufs, n);
+		return;
+	}
+
+	rte_spinlock_lock(&vhost->tx_lock);
+	if (vhost->dma_id >= 0) {
+		sent = rte_vhost_submit_enqueue_burst(vid, VIRTIO_RXQ, mbufs, n, vhost->dma_id, 0);
+		__atomic_store_n(&vhost->inflight, vhost->inflight + sent, __ATOMIC_RELAXED);
+		vhost_tx_completed(vhost, vid);
+	} else {
+		// synchronous copies, the mbufs are not referenced anymore
+		sent = rte_vhost_enqueue_burst(vid, VIRTIO_RXQ, mbufs, n);
+		rte_pktmbuf_free_bulk(mbufs, sent);
+	}
+	rte_spinlock_unlock(&vhost->tx_lock);
+
+	if (sent < n)
+		rte_node_enqueue(graph, node, QUEUE_FULL, (void **)&mbufs[sent], n - sent);
+}
+
+static uint16_t
+vhost_tx_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	const struct iface *iface, *batch_iface = NULL;
+	struct rte_mbuf *batch[RTE_GRAPH_BURST_SIZE];
+	struct rte_mbuf *mbuf;
+	uint16_t n_batch = 0;
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+		// Interface stats are accounted by eth_output.
+		iface = eth_output_mbuf_data(mbuf)->iface;
+		if (iface != batch_iface && n_batch > 0) {
+			vhost_tx_burst(graph, node, batch_iface, batch, n_batch);
+			n_batch = 0;
+		}
+		batch_iface = iface;
+		batch[n_batch++] = mbuf;
+	}
+	if (n_batch > 0)
+		vhost_tx_burst(graph, node, batch_iface, batch, n_batch);
+
+	return nb_objs;
+}
+
+static void vhost_tx_register(void) {
+	eth_output_add_tunnel(GR_IFACE_TYPE_VHOST, "vhost_tx");
+}
+
+static struct rte_node_register vhost_tx_node = {
+	.name = "vhost_tx",
+
+	.process = vhost_tx_process,
+
+	.nb_edges = TX_EDGE_COUNT,
+	.next_nodes = {
+		[NOT_CONNECTED] = "vhost_tx_not_connected",
+		[QUEUE_FULL] = "vhost_tx_queue_full",
+	},
+};
+
+static struct gr_node_info vhost_tx_info = {
+	.node = &vhost_tx_node,
+	.register_callback = vhost_tx_register,
+};
+
+GR_NODE_REGISTER(vhost_tx_info);
+
+GR_DROP_REGISTER(vhost_tx_not_connected);
+GR_DROP_REGISTER(vhost_tx_queue_full);
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _GR_API_VHOST
+#define _GR_API_VHOST
+
+#include <gr_api.h>
+#include <gr_bitops.h>
+#include <gr_infra.h>
+#include <gr_macro.h>
+
+#include <rte_ether.h>
+
+#define GR_IFACE_TYPE_VHOST 0x000b
+
+// vhost reconfig attributes
+#define GR_VHOST_SET_MAC GR_BIT64(32)
+
+#define GR_VHOST_PATH_SIZE 108 // sizeof(sockaddr_un.sun_path)
+#define GR_VHOST_DMADEV_SIZE 64
+
+// Info for GR_IFACE_TYPE_VHOST interfaces. grout is the vhost-user server, the
+// socket is created at path. The path and dmadev cannot be changed.
+struct gr_iface_info_vhost {
+	char path[GR_VHOST_PATH_SIZE];
+	// DMA device that copies the frames sent to the guest. Empty when the
+	// copies are done by the workers.
+	char dmadev[GR_VHOST_DMADEV_SIZE];
+	struct rte_ether_addr mac;
+	bool connected; // read only, a guest is attached to the socket
+};
+
+static_assert(sizeof(struct gr_iface_info_vhost) <= MEMBER_SIZE(struct gr_iface, info));
+
+#endif
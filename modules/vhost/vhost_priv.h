@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _VHOST_PRIV_H
+#define _VHOST_PRIV_H
+
+#include "gr_vhost.h"
+
+#include <gr_iface.h>
+
+#include <rte_ether.h>
+#include <rte_mempool.h>
+#include <rte_spinlock.h>
+
+#include <stdint.h>
+
+struct __rte_aligned(alignof(void *)) iface_info_vhost {
+	char path[GR_VHOST_PATH_SIZE];
+	char dmadev[GR_VHOST_DMADEV_SIZE];
+	struct rte_ether_addr mac;
+	// vhost device id, -1 while no guest is attached
+	int vid;
+	int16_t dma_id; // -1 for synchronous copies
+	// The device has a single queue pair. All workers send to the guest,
+	// the first one that takes rx_lock polls the guest transmissions.
+	rte_spinlock_t rx_lock;
+	// also serializes the DMA completions polling
+	rte_spinlock_t tx_lock;
+	uint32_t inflight; // mbufs submitted to the DMA device, under tx_lock
+	struct rte_mempool *pool; // frames sent by the guest
+};
+
+// Interfaces polled by vhost_rx, the first vhost_count entries are set. See
+// punt_ifaces for the concurrency rules.
+extern const struct iface *vhost_ifaces[MAX_IFACES];
+extern unsigned vhost_count;
+
+// Free the mbufs whose copy to the guest is complete. Called with tx_lock held.
+void vhost_tx_completed(struct iface_info_vhost *, int vid);
+
+#endif
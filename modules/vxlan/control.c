@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_vxlan.h"
+#include "vxlan_priv.h"
+
+#include <gr_control.h>
+#include <gr_iface.h>
+#include <gr_infra.h>
+#include <gr_ip4_control.h>
+#include <gr_log.h>
+
+#include <event2/event.h>
+#include <rte_ether.h>
+#include <rte_hash.h>
+
+#include <assert.h>
+#include <string.h>
+
+static struct rte_hash *vxlan_hash;
+
+void vxlan_get_iface_bulk(const struct vxlan_key *keys, unsigned n, struct iface **ifaces) {
+	const void *key_ptrs[VXLAN_LOOKUP_BULK_MAX];
+	void *data[VXLAN_LOOKUP_BULK_MAX];
+	uint64_t hits = 0;
+
+	assert(n <= VXLAN_LOOKUP_BULK_MAX);
+
+	for (unsigned i = 0; i < n; i++)
+		key_ptrs[i] = &keys[i];
+
+	if (n > 0 && rte_hash_lookup_bulk_data(vxlan_hash, key_ptrs, n, &hits, data) < 0)
+		hits = 0;
+
+	for (unsigned i = 0; i < n; i++)
+		ifaces[i] = hits & (UINT64_C(1) << i) ? data[i] : NULL;
+}
+
+static int iface_vxlan_reconfig(
+	struct iface *iface,
+	uint64_t set_attrs,
+	uint16_t flags,
+	uint16_t mtu,
+	uint16_t vrf_id,
+	const void *api_info
+) {
+	struct iface_info_vxlan *cur = (struct iface_info_vxlan *)iface->info;
+	const struct gr_iface_info_vxlan *next = api_info;
+	struct vxlan_key cur_key = {cur->local, cur->remote, cur->vni, iface->vrf_id};
+	struct vxlan_key next_key = {next->local, next->remote, next->vni, vrf_id};
+	int ret;
+
+	if (set_attrs
+	    & (GR_IFACE_SET_VRF | GR_VXLAN_SET_LOCAL | GR_VXLAN_SET_REMOTE | GR_VXLAN_SET_VNI)) {
+		if (vrf_id >= IP4_MAX_VRFS)
+			return errno_set(EOVERFLOW);
+		if (next->vni > GR_VXLAN_VNI_MAX)
+			return errno_set(ERANGE);
+
+		if (rte_hash_lookup(vxlan_hash, &next_key) >= 0)
+			return errno_set(EADDRINUSE);
+
+		if (ip4_route_lookup(vrf_id, next->local) == NULL)
+			return -errno;
+		if (ip4_route_lookup(vrf_id, next->remote) == NULL)
+			return -errno;
+
+		if (memcmp(&cur_key, &next_key, sizeof(cur_key)) != 0)
+			rte_hash_del_key(vxlan_hash, &cur_key);
+
+		if ((ret = rte_hash_add_key_data(vxlan_hash, &next_key, iface)) < 0)
+			return errno_log(-ret, "rte_hash_add_key_data");
+
+		cur->local = next->local;
+		cur->remote = next->remote;
+		cur->vni = next->vni;
+		iface->vrf_id = vrf_id;
+	}
+
+	if (set_attrs & GR_VXLAN_SET_MAC) {
+		if (rte_is_zero_ether_addr(&next->mac))
+			rte_eth_random_addr(cur->mac.addr_bytes);
+		else if (rte_is_unicast_ether_addr(&next->mac))
+			cur->mac = next->mac;
+		else
+			return errno_set(EINVAL);
+	}
+
+	if (set_attrs & GR_IFACE_SET_FLAGS)
+		iface->flags = flags;
+	if (set_attrs & GR_IFACE_SET_MTU)
+		iface->mtu = mtu;
+
+	return 0;
+}
+
+static int iface_vxlan_fini(struct iface *iface) {
+	struct iface_info_vxlan *vxlan = (struct iface_info_vxlan *)iface->info;
+	struct vxlan_key key = {vxlan->local, vxlan->remote, vxlan->vni, iface->vrf_id};
+
+	rte_hash_del_key(vxlan_hash, &key);
+
+	return 0;
+}
+
+static int iface_vxlan_init(struct iface *iface, const void *api_info) {
+	int ret;
+
+	ret = iface_vxlan_reconfig(
+		iface, IFACE_SET_ALL, iface->flags, iface->mtu, iface->vrf_id, api_info
+	);
+	if (ret < 0) {
+		iface_vxlan_fini(iface);
+		errno = -ret;
+	}
+
+	return ret;
+}
+
+static int iface_vxlan_get_eth_addr(const struct iface *iface, struct rte_ether_addr *mac) {
+	const struct iface_info_vxlan *vxlan = (const struct iface_info_vxlan *)iface->info;
+	*mac = vxlan->mac;
+	return 0;
+}
+
+static int iface_vxlan_eth_addr_filter(struct iface *, const struct rte_ether_addr *mac) {
+	// Without a filter, all decapsulated multicast frames are accepted.
+	if (mac == NULL || !rte_is_multicast_ether_addr(mac))
+		return errno_set(EINVAL);
+	return 0;
+}
+
+static void vxlan_to_api(void *info, const struct iface *iface) {
+	const struct iface_info_vxlan *vxlan = (const struct iface_info_vxlan *)iface->info;
+	struct gr_iface_info_vxlan *api = info;
+
+	api->local = vxlan->local;
+	api->remote = vxlan->remote;
+	api->vni = vxlan->vni;
+	api->mac = vxlan->mac;
+}
+
+static struct iface_type iface_type_vxlan = {
+	.id = GR_IFACE_TYPE_VXLAN,
+	.name = "vxlan",
+	.info_size = sizeof(struct iface_info_vxlan),
+	.init = iface_vxlan_init,
+	.reconfig = iface_vxlan_reconfig,
+	.fini = iface_vxlan_fini,
+	.get_eth_addr = iface_vxlan_get_eth_addr,
+	.add_eth_addr = iface_vxlan_eth_addr_filter,
+	.del_eth_addr = iface_vxlan_eth_addr_filter,
+	.to_api = vxlan_to_api,
+};
+
+static void vxlan_init(struct event_base *) {
+	struct rte_hash_parameters params = {
+		.name = "vxlan",
+		.entries = MAX_IFACES,
+		.key_len = sizeof(struct vxlan_key),
+		.socket_id = SOCKET_ID_ANY,
+		.extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF
+			| RTE_HASH_EXTRA_FLAGS_TRANS_MEM_SUPPORT,
+	};
+	vxlan_hash = rte_hash_create(&params);
+	if (vxlan_hash == NULL)
+		ABORT("rte_hash_create(vxlan)");
+}
+
+static void vxlan_fini(struct event_base *) {
+	rte_hash_free(vxlan_hash);
+	vxlan_hash = NULL;
+}
+
+static struct gr_module vxlan_module = {
+	.name = "vxlan",
+	.init = vxlan_init,
+	.fini = vxlan_fini,
+	.fini_prio = 1000,
+};
+
+RTE_INIT(vxlan_constructor) {
+	gr_register_module(&vxlan_module);
+	iface_type_register(&iface_type_vxlan);
+}
@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_vxlan.h"
+#include "vxlan_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_eth_input.h>
+#include <gr_graph.h>
+#include <gr_ip4_datapath.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_graph_worker.h>
+#include <rte_mbuf_ptype.h>
+#include <rte_vxlan.h>
+
+#include <string.h>
+
+enum {
+	ETH_INPUT = 0,
+	NO_TUNNEL,
+	INVALID,
+	EDGE_COUNT,
+};
+
+// I flag, the VNI field is valid
+#define VXLAN_FLAGS_VNI RTE_BE32(0x08000000)
+
+static uint16_t
+vxlan_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct iface *ifaces[VXLAN_LOOKUP_BULK_MAX];
+	struct vxlan_key keys[VXLAN_LOOKUP_BULK_MAX];
+	uint8_t key_idx[VXLAN_LOOKUP_BULK_MAX];
+	struct eth_input_mbuf_data *eth_data;
+	struct ip_local_mbuf_data *ip_data;
+	uint16_t i, n, count, n_keys;
+	const struct rte_vxlan_hdr *hdr;
+	struct gr_spec_stream s;
+	struct vxlan_key key;
+	struct rte_mbuf *mbuf;
+	struct iface *vxlan;
+	rte_edge_t edge;
+
+	gr_spec_stream_init(&s, node, nb_objs);
+
+	for (n = 0; n < nb_objs; n += count) {
+		count = RTE_MIN(nb_objs - n, VXLAN_LOOKUP_BULK_MAX);
+
+		// First pass: validate the headers and collect the tunnel keys.
+		// Consecutive packets of the same tunnel share a single lookup.
+		n_keys = 0;
+		for (i = 0; i < count; i++) {
+			mbuf = objs[n + i];
+			ip_data = ip_local_mbuf_data(mbuf);
+			hdr = rte_pktmbuf_mtod(mbuf, const struct rte_vxlan_hdr *);
+			if (unlikely(ip_data->len < sizeof(*hdr) + RTE_ETHER_HDR_LEN
+				     || rte_pktmbuf_data_len(mbuf) < sizeof(*hdr)
+				     || !(hdr->vx_flags & VXLAN_FLAGS_VNI))) {
+				key_idx[i] = UINT8_MAX;
+				continue;
+			}
+			key = (struct vxlan_key) {
+				ip_data->dst,
+				ip_data->src,
+				rte_be_to_cpu_32(hdr->vx_vni) >> 8,
+				ip_data->vrf_id,
+			};
+			if (n_keys == 0 || memcmp(&keys[n_keys - 1], &key, sizeof(key)) != 0)
+				keys[n_keys++] = key;
+			key_idx[i] = n_keys - 1;
+		}
+		vxlan_get_iface_bulk(keys, n_keys, ifaces);
+
+		// Second pass: hand over the inner frames to eth_input.
+		for (i = 0; i < count; i++) {
+			mbuf = objs[n + i];
+			if (key_idx[i] == UINT8_MAX) {
+				edge = INVALID;
+				goto next;
+			}
+			vxlan = ifaces[key_idx[i]];
+			if (vxlan == NULL) {
+				edge = NO_TUNNEL;
+				goto next;
+			}
+			rte_pktmbuf_adj(mbuf, sizeof(*hdr));
+			// The hw offloads only apply to the outer headers.
+			// Clear them so that the inner packet is checked in software.
+			mbuf->ol_flags |= RTE_MBUF_F_RX_IP_CKSUM_NONE;
+			mbuf->ol_flags &= ~RTE_MBUF_F_RX_VLAN_STRIPPED;
+			mbuf->packet_type = RTE_PTYPE_UNKNOWN;
+			// Interface stats are accounted by eth_input.
+			eth_data = eth_input_mbuf_data(mbuf);
+			eth_data->iface = vxlan;
+			eth_data->eth_dst = ETH_DST_UNKNOWN;
+			edge = ETH_INPUT;
+next:
+			gr_spec_stream_enqueue(&s, graph, node, objs, n + i, edge);
+		}
+	}
+	gr_spec_stream_flush(&s, graph, node);
+
+	return nb_objs;
+}
+
+static void vxlan_input_register(void) {
+	udp_input_register_port(RTE_BE16(GR_VXLAN_UDP_PORT), "vxlan_input");
+}
+
+static struct rte_node_register vxlan_input_node = {
+	.name = "vxlan_input",
+
+	.process = vxlan_input_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[ETH_INPUT] = "eth_input",
+		[NO_TUNNEL] = "vxlan_input_no_tunnel",
+		[INVALID] = "vxlan_input_invalid",
+	},
+};
+
+static struct gr_node_info vxlan_input_info = {
+	.node = &vxlan_input_node,
+	.register_callback = vxlan_input_register,
+};
+
+GR_NODE_REGISTER(vxlan_input_info);
+
+GR_DROP_REGISTER(vxlan_input_no_tunnel);
+GR_DROP_REGISTER(vxlan_input_invalid);
@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#include "gr_vxlan.h"
+#include "vxlan_priv.h"
+
+#include <gr_datapath.h>
+#include <gr_eth_output.h>
+#include <gr_graph.h>
+#include <gr_ip4_control.h>
+#include <gr_ip4_datapath.h>
+#include <gr_log.h>
+#include <gr_mbuf.h>
+
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_graph_worker.h>
+#include <rte_ip.h>
+#include <rte_jhash.h>
+#include <rte_udp.h>
+#include <rte_vxlan.h>
+
+#include <netinet/in.h>
+
+enum {
+	IP_OUTPUT = 0,
+	NO_TUNNEL,
+	NO_HEADROOM,
+	EDGE_COUNT,
+};
+
+// RFC 7348 recommends picking the outer UDP source port from a hash of the
+// inner frame in the dynamic/private range, so that the underlay can spread
+// the tunnel flows over ECMP paths and RSS queues.
+static inline rte_be16_t vxlan_src_port(const struct rte_mbuf *m) {
+	const struct rte_ether_hdr *eth = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
+	const struct rte_ipv4_hdr *ip = (const struct rte_ipv4_hdr *)(eth + 1);
+	uint32_t hash;
+
+	if (eth->ether_type == RTE_BE16(RTE_ETHER_TYPE_IPV4)
+	    && rte_pktmbuf_data_len(m) >= sizeof(*eth) + sizeof(*ip))
+		hash = ip4_flow_hash(m, ip);
+	else if (m->ol_flags & RTE_MBUF_F_RX_RSS_HASH)
+		hash = m->hash.rss;
+	else
+		hash = rte_jhash(eth, sizeof(*eth), 0);
+
+	return rte_cpu_to_be_16(49152 | (hash & 0x3fff));
+}
+
+static uint16_t vxlan_output_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	struct ip_output_mbuf_data *ip_data;
+	uint32_t route_gen, iface_gen;
+	struct ip_local_mbuf_data *tunnel;
+	struct iface_info_vxlan *vxlan;
+	struct rte_vxlan_hdr *hdr;
+	struct rte_ipv4_hdr *outer;
+	const struct iface *iface;
+	struct rte_udp_hdr *udp;
+	struct rte_mbuf *mbuf;
+	rte_be16_t src_port;
+	uint8_t inner_l3_len;
+	rte_edge_t edge;
+
+	route_gen = __atomic_load_n(&ip4_route_gen, __ATOMIC_ACQUIRE);
+	iface_gen = __atomic_load_n(&iface_config_gen, __ATOMIC_ACQUIRE);
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+
+		// eth_output has built the inner ethernet header and updated the
+		// interface stats.
+		iface = eth_output_mbuf_data(mbuf)->iface;
+		if (iface == NULL || iface->type_id != GR_IFACE_TYPE_VXLAN) {
+			edge = NO_TUNNEL;
+			goto next;
+		}
+		vxlan = (struct iface_info_vxlan *)iface->info;
+
+		src_port = vxlan_src_port(mbuf);
+		tunnel = ip_local_mbuf_data(mbuf);
+		tunnel->src = vxlan->local;
+		tunnel->dst = vxlan->remote;
+		tunnel->len = sizeof(*udp) + sizeof(*hdr) + rte_pktmbuf_pkt_len(mbuf);
+		tunnel->vrf_id = iface->vrf_id;
+		tunnel->proto = IPPROTO_UDP;
+
+		hdr = (struct rte_vxlan_hdr *)rte_pktmbuf_prepend(
+			mbuf, sizeof(*outer) + sizeof(*udp) + sizeof(*hdr)
+		);
+		if (unlikely(hdr == NULL)) {
+			edge = NO_HEADROOM;
+			goto next;
+		}
+		outer = (struct rte_ipv4_hdr *)hdr;
+		udp = (struct rte_udp_hdr *)(outer + 1);
+		hdr = (struct rte_vxlan_hdr *)(udp + 1);
+		hdr->vx_flags = RTE_BE32(0x08000000);
+		hdr->vx_vni = rte_cpu_to_be_32(vxlan->vni << 8);
+		udp->src_port = src_port;
+		udp->dst_port = RTE_BE16(GR_VXLAN_UDP_PORT);
+		udp->dgram_len = rte_cpu_to_be_16(tunnel->len);
+		udp->dgram_cksum = 0; // optional over IPv4
+		inner_l3_len = mbuf->l3_len;
+		ip_set_fields(mbuf, outer, tunnel);
+		if (unlikely(mbuf->ol_flags & RTE_MBUF_F_TX_TCP_SEG)) {
+			// l2_len was set to the inner ethernet header by eth_output.
+			// Only the inner IPv4 checksum can be offloaded.
+			ip_cksum_resolve(mbuf, outer);
+			mbuf->l3_len = inner_l3_len;
+			mbuf->l2_len += sizeof(*udp) + sizeof(*hdr);
+			mbuf->outer_l3_len = sizeof(*outer);
+			mbuf->ol_flags |= RTE_MBUF_F_TX_IPV4 | RTE_MBUF_F_TX_IP_CKSUM
+				| RTE_MBUF_F_TX_OUTER_IPV4 | RTE_MBUF_F_TX_TUNNEL_VXLAN;
+		}
+
+		// Resolve nexthop for the encapsulated packet.
+		ip_data = ip_output_mbuf_data(mbuf);
+		ip_data->input_iface = iface;
+		ip_data->nh = ip4_route_cache_lookup(
+			&vxlan->route, iface->vrf_id, vxlan->remote, route_gen, iface_gen
+		);
+		edge = IP_OUTPUT;
+next:
+		rte_node_enqueue_x1(graph, node, edge, mbuf);
+	}
+
+	return nb_objs;
+}
+
+static void vxlan_output_register(void) {
+	eth_output_add_tunnel(GR_IFACE_TYPE_VXLAN, "vxlan_output");
+}
+
+static struct rte_node_register vxlan_output_node = {
+	.name = "vxlan_output",
+
+	.process = vxlan_output_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[IP_OUTPUT] = "ip_output",
+		[NO_TUNNEL] = "vxlan_output_no_tunnel",
+		[NO_HEADROOM] = "error_no_headroom",
+	},
+};
+
+static struct gr_node_info vxlan_output_info = {
+	.node = &vxlan_output_node,
+	.register_callback = vxlan_output_register,
+};
+
+GR_NODE_REGISTER(vxlan_output_info);
+
+GR_DROP_REGISTER(vxlan_output_no_tunnel);
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2024 Robin Jarry
+
+#ifndef _VXLAN_PRIV_H
+#define _VXLAN_PRIV_H
+
+#include <gr_iface.h>
+#include <gr_ip4_control.h>
+#include <gr_net_types.h>
+
+#include <rte_ether.h>
+#include <rte_hash.h>
+
+#include <stdint.h>
+
+struct __rte_aligned(alignof(void *)) iface_info_vxlan {
+	ip4_addr_t local;
+	ip4_addr_t remote;
+	uint32_t vni;
+	struct rte_ether_addr mac;
+	struct ip4_route_cache route; // underlay next hop of remote
+};
+
+struct vxlan_key {
+	ip4_addr_t local;
+	ip4_addr_t remote;
+	uint32_t vni;
+	// uint32_t to avoid padding bytes in the hash key, see struct ipip_key
+	uint32_t vrf_id;
+};
+
+#define VXLAN_LOOKUP_BULK_MAX RTE_HASH_LOOKUP_BULK_MAX
+
+// Lookup up to VXLAN_LOOKUP_BULK_MAX tunnels at once. Unknown tunnels are NULL.
+void vxlan_get_iface_bulk(const struct vxlan_key *keys, unsigned n, struct iface **ifaces);
+
+#endif
@@ -17,10 +17,12 @@ Source0: https://github.com/DPDK/grout/archive/%{branch}.tar.gz#/%{name}-%{versi
 BuildRequires: gcc
 BuildRequires: git
 BuildRequires: libarchive-devel
+BuildRequires: libbpf-devel
 BuildRequires: libcmocka-devel
 BuildRequires: libedit-devel
 BuildRequires: libevent-devel
 BuildRequires: libsmartcols-devel
+BuildRequires: libxdp-devel
 BuildRequires: make
 BuildRequires: meson
 BuildRequires: ninja-build
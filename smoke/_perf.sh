@@ -0,0 +1,76 @@
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+# Forwarding performance scenarios, sourced by *_perf.sh after _init.sh.
+#
+# Packets are injected on $p0 by the built-in traffic source and counted by
+# the bench_sink node when routed to $p1. Both ports are net_null devices, no
+# packet ever reaches a driver. Results are printed as one JSON object per
+# line and appended to $PERF_RESULTS when set:
+#
+#   {"scenario":"...","rx_mpps":X,"mpps":X,"cycles_per_pkt":X,"p99_us":X}
+#
+# mpps is the forwarded rate, cycles_per_pkt the sum of all graph node cycles
+# except the traffic source and sink divided by the injected packets. p99_us
+# is the upper bound of the dwell histogram bucket holding the 99th
+# percentile.
+
+: ${PERF_DURATION:=5}
+: ${PERF_DWELL_SAMPLE:=64}
+
+# large route tables would take forever to dump on exit
+cat > $tmp/cleanup <<EOC
+grcli show stats software
+grcli show interface all
+EOC
+
+p0=${run_id}0
+p1=${run_id}1
+
+grcli add interface port $p0 devargs net_null0,no-rx=1 mac f0:0d:ac:dc:00:00
+grcli add interface port $p1 devargs net_null1,no-rx=1 mac f0:0d:ac:dc:00:01
+grcli add ip address 172.16.0.1/24 iface $p0
+grcli add ip address 172.16.1.1/24 iface $p1
+grcli add ip nexthop 172.16.1.2 mac ba:d0:ca:ca:00:01 iface $p1
+grcli add ip route 0.0.0.0/0 via 172.16.1.2
+
+# perf_run NAME [BENCH_ARGS...]
+perf_run() {
+	local name=$1 rates cycles p99 result
+	shift
+
+	grcli set stats dwell on sample $PERF_DWELL_SAMPLE
+	# statistics are reset when the traffic starts
+	grcli add bench $p0 sink $p1 "$@"
+	sleep $PERF_DURATION
+	grcli show bench > $tmp/bench
+	grcli -o raw show stats software > $tmp/stats
+	grcli show stats dwell > $tmp/dwell
+	grcli del bench
+	grcli set stats dwell off
+
+	rates=$(sed -nE 's/^total: rx ([0-9.]+) Mpps, sink ([0-9.]+) Mpps$/\1 \2/p' $tmp/bench)
+	cycles=$(awk -F'\t' '
+		$1 == "bench_source" { pkts = $3; next }
+		$1 == "bench_sink" || $3 == 0 { next }
+		{ cycles += $2 * $5 }
+		END { printf "%.1f", pkts ? cycles / pkts : 0 }' $tmp/stats)
+	p99=$(awk '
+		$1 == "samples:" { total = $2; next }
+		$1 == "<" || $1 == ">=" {
+			n += $3
+			if (total && p99 == "" && n >= total * 0.99) {
+				p99 = $2
+				sub(/us$/, "", p99)
+			}
+		}
+		END { print p99 == "" ? "null" : p99 }' $tmp/dwell)
+
+	set -- $rates
+	result=$(printf '{"scenario":"%s","rx_mpps":%s,"mpps":%s,"cycles_per_pkt":%s,"p99_us":%s}' \
+		"$name" "${1:-0}" "${2:-0}" "$cycles" "$p99")
+	echo "$result"
+	if [ -n "$PERF_RESULTS" ]; then
+		echo "$result" >> "$PERF_RESULTS"
+	fi
+}
@@ -0,0 +1,65 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add interface port $p1 devargs net_tap1,iface=$p1 mac f0:0d:ac:dc:00:01
+grcli add ip address 172.16.0.1/24 iface $p0
+grcli add ip address 172.16.1.1/24 iface $p1
+
+for n in 0 1; do
+	p=$run_id$n
+	ip netns add $p
+	echo ip netns del $p >> $tmp/cleanup
+	ip link set $p netns $p
+	ip -n $p link set $p address ba:d0:ca:ca:00:0$n
+	ip -n $p link set $p up
+	ip -n $p addr add 172.16.$n.2/24 dev $p
+	ip -n $p route add default via 172.16.$n.1
+	ip -n $p addr show
+done
+
+ip netns exec $p0 ping -i0.01 -c3 -n 172.16.1.2
+
+# ingress, forwarded and local packets are filtered
+grcli add acl rule $p0 in seq 10 deny proto icmp dst 172.16.1.2/32
+grcli add acl rule $p0 in seq 20 deny proto icmp dst 172.16.0.1/32 dscp 46
+grcli show acl rule
+if ip netns exec $p0 ping -i0.01 -c3 -n -w1 172.16.1.2; then
+	echo "ping to 172.16.1.2 not denied on $p0 input" >&2
+	exit 1
+fi
+ip netns exec $p0 ping -i0.01 -c3 -n 172.16.0.1
+if ip netns exec $p0 ping -i0.01 -c3 -n -w1 -Q 0xb8 172.16.0.1; then
+	echo "ping to 172.16.0.1 with dscp 46 not denied on $p0 input" >&2
+	exit 1
+fi
+
+# a lower sequence number is evaluated first
+grcli add acl rule $p0 in seq 5 permit proto icmp src 172.16.0.0/24
+ip netns exec $p0 ping -i0.01 -c3 -n 172.16.1.2
+grcli clear acl rules $p0 in
+
+# egress
+grcli add acl rule $p1 out seq 10 deny src 172.16.0.2/32
+if ip netns exec $p0 ping -i0.01 -c3 -n -w1 172.16.1.2; then
+	echo "ping to 172.16.1.2 not denied on $p1 output" >&2
+	exit 1
+fi
+# locally generated replies are not filtered
+ip netns exec $p1 ping -i0.01 -c3 -n 172.16.1.1
+grcli del acl rule $p1 out seq 10
+ip netns exec $p0 ping -i0.01 -c3 -n 172.16.1.2
+
+# rules are removed with their interface
+grcli add acl rule $p1 in seq 10 deny
+grcli del interface $p1
+if grcli show acl rule | grep -q "^$p1 "; then
+	echo "rules not removed with $p1" >&2
+	exit 1
+fi
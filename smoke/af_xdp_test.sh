@@ -0,0 +1,25 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+x0=${run_id}x0
+
+ip netns add $p0
+echo ip netns del $p0 >> $tmp/cleanup
+ip link add $x0 type veth peer name $p0 netns $p0
+echo ip link del $x0 >> $tmp/cleanup
+ip link set $x0 up
+
+grcli add interface port $x0 devargs net_af_xdp0,iface=$x0 mac f0:0d:ac:dc:00:00
+grcli show interface name $x0 | grep -q "driver: *net_af_xdp"
+grcli add ip address 10.99.0.1/24 iface $x0
+
+ip -n $p0 link set $p0 address ba:d0:ca:ca:00:00
+ip -n $p0 link set $p0 up
+ip -n $p0 addr add 10.99.0.2/24 dev $p0
+ip -n $p0 addr show
+
+ip netns exec $p0 ping -i0.01 -c3 -n 10.99.0.1
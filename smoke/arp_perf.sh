@@ -0,0 +1,33 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+. $(dirname $0)/_perf.sh
+
+: ${PERF_NEIGHS:=200}
+
+# hosts 172.16.1.10 and above, in the connected subnet of $p1
+for i in $(seq 0 $((PERF_NEIGHS - 1))); do
+	h=172.16.1.$((i + 10))
+	echo "add ip nexthop $h mac ba:d0:ca:ca:01:$(printf %02x $i) iface $p1" >> $tmp/add
+	echo "del ip nexthop $h" >> $tmp/del
+done
+grcli -e -f $tmp/add
+
+perf_run arp_static dst 172.16.1.10 dsts $PERF_NEIGHS
+
+# Delete and re-create the neighbors while traffic is flowing. In between,
+# packets hit unresolved next hops and trigger ARP requests. Errors are
+# expected when the datapath re-created a neighbor before the static one.
+{
+	while :; do
+		grcli -f $tmp/del
+		grcli -f $tmp/add
+	done
+} > /dev/null 2>&1 &
+churn=$!
+echo "kill $churn" >> $tmp/cleanup
+
+perf_run arp_churn dst 172.16.1.10 dsts $PERF_NEIGHS
+kill $churn
@@ -0,0 +1,34 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add ip address 172.16.0.1/24 iface $p0
+
+ip netns add $p0
+echo ip netns del $p0 >> $tmp/cleanup
+ip link set $p0 netns $p0
+ip -n $p0 link set $p0 address ba:d0:ca:ca:00:00
+ip -n $p0 link set $p0 up
+ip -n $p0 addr add 172.16.0.2/24 dev $p0
+
+# the source address must be local
+if grcli add bfd session 172.16.0.2 local 172.16.0.3; then
+	echo "bfd session added with a non local address" >&2
+	exit 1
+fi
+
+grcli add bfd session 172.16.0.2 local 172.16.0.1 tx 100 rx 100 multiplier 3
+ip netns exec $p0 ping -i0.01 -c3 -n 172.16.0.1
+sleep 3
+grcli show bfd session
+
+# the peer does not run BFD, the session stays down with slow control packets
+grcli show bfd session | awk '$2 == "172.16.0.2" && $4 == "down" && $10 > 0 {ok=1} END {exit !ok}'
+
+grcli del bfd session 172.16.0.2
+grcli show bfd session | awk '$2 == "172.16.0.2" {exit 1}'
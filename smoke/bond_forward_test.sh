@@ -0,0 +1,47 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+p2=${run_id}2
+b0=${run_id}b
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add interface port $p1 devargs net_tap1,iface=$p1 mac f0:0d:ac:dc:00:01
+grcli add interface port $p2 devargs net_tap2,iface=$p2 mac f0:0d:ac:dc:00:02
+grcli add interface bond $b0 mode lacp members $p0 $p1 mac f0:0d:ac:dc:00:10
+grcli add ip address 172.16.0.1/24 iface $b0
+grcli add ip address 172.16.1.1/24 iface $p2
+
+ip netns add $b0
+echo ip netns del $b0 >> $tmp/cleanup
+ip -n $b0 link add bond0 type bond mode 802.3ad lacp_rate fast miimon 100
+for p in $p0 $p1; do
+	ip link set $p netns $b0
+	ip -n $b0 link set $p master bond0
+done
+ip -n $b0 link set bond0 address ba:d0:ca:ca:00:00
+ip -n $b0 link set bond0 up
+ip -n $b0 addr add 172.16.0.2/24 dev bond0
+ip -n $b0 route add default via 172.16.0.1
+ip -n $b0 addr show
+
+ip netns add $p2
+echo ip netns del $p2 >> $tmp/cleanup
+ip link set $p2 netns $p2
+ip -n $p2 link set $p2 address ba:d0:ca:ca:00:02
+ip -n $p2 link set $p2 up
+ip -n $p2 addr add 172.16.1.2/24 dev $p2
+ip -n $p2 route add default via 172.16.1.1
+ip -n $p2 addr show
+
+# wait for LACP to converge on both sides
+ip netns exec $b0 ping -i0.1 -c3 -w10 172.16.1.2
+ip netns exec $p2 ping -i0.01 -c3 172.16.0.2
+
+grcli show interface name $b0
+# the linux bond must have negotiated with grout
+ip netns exec $b0 grep -q "Partner Mac Address: f0:0d:ac:dc:00:10" /proc/net/bonding/bond0
@@ -0,0 +1,37 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+br=${run_id}br
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add interface port $p1 devargs net_tap1,iface=$p1 mac f0:0d:ac:dc:00:01
+grcli add interface bridge $br members $p0 $p1 mac f0:0d:ac:dc:00:10
+grcli add ip address 172.16.0.1/24 iface $br
+
+for n in 0 1; do
+	p=$run_id$n
+	ip netns add $p
+	echo ip netns del $p >> $tmp/cleanup
+	ip link set $p netns $p
+	ip -n $p link set $p address ba:d0:ca:ca:00:0$n
+	ip -n $p link set $p up
+	ip -n $p addr add 172.16.0.$((n+2))/24 dev $p
+	ip -n $p addr show
+done
+
+# switched between the members
+ip netns exec $p0 ping -i0.01 -c3 -n 172.16.0.3
+ip netns exec $p1 ping -i0.01 -c3 -n 172.16.0.2
+# delivered locally on the bridge interface
+ip netns exec $p0 ping -i0.01 -c3 -n 172.16.0.1
+ip netns exec $p1 ping -i0.01 -c3 -n 172.16.0.1
+
+grcli show interface name $br
+grcli show l2 fdb bridge $br
+grcli show l2 fdb bridge $br | grep -q "ba:d0:ca:ca:00:00.*$p0"
+grcli show l2 fdb bridge $br | grep -q "ba:d0:ca:ca:00:01.*$p1"
@@ -0,0 +1,34 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add ip address 172.16.0.1/24 iface $p0
+
+ip netns add $p0
+echo ip netns del $p0 >> $tmp/cleanup
+ip link set $p0 netns $p0
+ip -n $p0 link set $p0 address ba:d0:ca:ca:00:00
+ip -n $p0 link set $p0 up
+ip -n $p0 addr add 172.16.0.2/24 dev $p0
+
+grcli clear stats
+grcli set stats drop-sample 1
+
+# resolving the echo replies next hop: the ARP reply is freed by arp_input_reply
+ip netns exec $p0 ping -i0.01 -c3 -n 172.16.0.1
+
+grcli show stats drops
+grcli show stats drops iface $p0 pattern 'arp_*' \
+	| awk -v p=$p0 '$1 == "arp_input_reply" && $2 == p && $3 > 0 {ok=1} END {exit !ok}'
+
+# sampled drops end up in the packet trace buffer
+grcli show trace | grep -F arp_input_reply
+
+grcli set stats drop-sample 0
+grcli clear stats
+grcli show stats drops | awk '$1 == "arp_input_reply" {exit 1}'
@@ -0,0 +1,33 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+
+grcli events > $tmp/events &
+events_pid=$!
+echo "kill $events_pid" >> $tmp/cleanup
+# give it time to subscribe
+sleep 1
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add ip address 172.16.0.1/24 iface $p0
+grcli add ip route 10.0.0.0/8 via 172.16.0.2
+grcli del ip route 10.0.0.0/8
+grcli set interface port $p0 mtu 1400
+grcli del interface $p0
+
+sleep 1
+kill -INT $events_pid
+wait $events_pid || true
+cat $tmp/events
+
+grep -q "iface add $p0 " $tmp/events
+grep -q "ip route add vrf=0 10.0.0.0/8 via 172.16.0.2" $tmp/events
+grep -q "ip route del vrf=0 10.0.0.0/8 via 172.16.0.2" $tmp/events
+grep -q "iface update $p0 .* mtu=1400 " $tmp/events
+grep -q "iface del $p0 " $tmp/events
+# the sequence must not have any gap
+! grep -q "events lost" $tmp/events
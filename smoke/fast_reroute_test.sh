@@ -0,0 +1,48 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+p2=${run_id}2
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add interface port $p1 devargs net_tap1,iface=$p1 mac f0:0d:ac:dc:00:01
+grcli add interface port $p2 devargs net_tap2,iface=$p2 mac f0:0d:ac:dc:00:02
+grcli add ip address 172.16.0.1/24 iface $p0
+grcli add ip address 172.16.1.1/24 iface $p1
+grcli add ip address 172.16.2.1/24 iface $p2
+grcli add ip route 10.0.0.0/24 via 172.16.1.2 172.16.2.2
+
+for n in 0 1 2; do
+	p=$run_id$n
+	ip netns add $p
+	echo ip netns del $p >> $tmp/cleanup
+	ip link set $p netns $p
+	ip -n $p link set $p address ba:d0:ca:ca:00:0$n
+	ip -n $p link set $p up
+	ip -n $p addr add 172.16.$n.2/24 dev $p
+	ip -n $p route add default via 172.16.$n.1
+done
+
+# same anycast address behind both ECMP next hops
+ip -n $p1 addr add 10.0.0.1/32 dev lo
+ip -n $p2 addr add 10.0.0.1/32 dev lo
+
+ip netns exec $p0 ping -i0.01 -c3 10.0.0.1
+
+# the route is not withdrawn, the group must skip the member without carrier
+for n in 1 2; do
+	p=$run_id$n
+	ip -n $p link set $p down
+	sleep 2
+	grcli show ip nexthop
+	grcli show ip nexthop | grep "172.16.$n.2 " | grep -qw down
+	ip netns exec $p0 ping -i0.01 -c10 -W1 10.0.0.1 | grep -q " 0% packet loss"
+	ip -n $p link set $p up
+	ip -n $p route add default via 172.16.$n.1
+	sleep 2
+	! grcli show ip nexthop | grep "172.16.$n.2 " | grep -qw down
+done
@@ -0,0 +1,29 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add ip6 address fd00:ba4:1::1/64 iface $p0
+grcli set ip6 fib vrf 0 type auto max-routes 1024 tbl8 256
+
+# the table stays reduced until the transaction is committed
+{
+	echo "transaction begin"
+	for i in $(seq 0 2999); do
+		printf 'add ip6 route 2001:db8:%x::/48 via fd00:ba4:1::2\n' $i
+	done
+	echo "transaction commit"
+} > $tmp/routes
+grcli -e -f $tmp/routes
+
+grcli show ip6 fib
+# the table was promoted to TRIE and grown to hold all routes
+grcli show ip6 fib | awk '$1 == 0 && $3 == "(trie)" && $4 >= 3000 && $5 > 1024 {ok = 1}
+	END {exit !ok}'
+
+n=$(grcli show ip6 route | grep -c "2001:db8:[0-9a-f]*::/48 *fd00:ba4:1::2")
+[ "$n" -eq 3000 ]
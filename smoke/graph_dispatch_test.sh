@@ -0,0 +1,54 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add interface port $p1 devargs net_tap1,iface=$p1 mac f0:0d:ac:dc:00:01
+grcli add ip address 172.16.0.1/24 iface $p0
+grcli add ip address 172.16.1.1/24 iface $p1
+
+for n in 0 1; do
+	p=$run_id$n
+	ip netns add $p
+	echo ip netns del $p >> $tmp/cleanup
+	ip link set $p netns $p
+	ip -n $p link set $p address ba:d0:ca:ca:00:0$n
+	ip -n $p link set $p up
+	ip -n $p addr add 172.16.$n.2/24 dev $p
+	ip -n $p route add default via 172.16.$n.1
+done
+
+cpu=$(grcli show worker | awk 'NR == 2 {print $1}')
+grcli set graph affinity ip_forward cpu $cpu
+grcli set graph model dispatch
+grcli show graph model | grep -qx "model: dispatch"
+grcli show graph model | grep -qx "ip_forward: cpu $cpu"
+
+ip netns exec $p0 ping -i0.01 -c3 172.16.1.2
+ip netns exec $p1 ping -i0.01 -c3 172.16.0.2
+
+# the rx nodes of a clone with no pinned nodes must still be walked
+other=$(seq 0 $(($(nproc) - 1)) | grep -vx "$cpu" | tail -n1)
+grcli set port qmap $p0 rxq 0 cpu $other
+grcli set port qmap $p1 rxq 0 cpu $other
+grcli show graph model | grep -qx "model: dispatch"
+ip netns exec $p0 ping -i0.01 -c3 172.16.1.2
+ip netns exec $p1 ping -i0.01 -c3 172.16.0.2
+
+# source nodes cannot be pinned
+if grcli set graph affinity port_rx cpu $cpu; then
+	echo "source node port_rx pinned to cpu $cpu" >&2
+	exit 1
+fi
+
+grcli set graph affinity ip_forward
+grcli set graph model rtc
+grcli show graph model | grep -qx "model: rtc"
+! grcli show graph model | grep -q "ip_forward"
+
+ip netns exec $p0 ping -i0.01 -c3 172.16.1.2
@@ -0,0 +1,28 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add ip address 172.16.0.1/24 iface $p0
+
+for i in $(seq 0 39); do
+	for j in $(seq 0 249); do
+		echo "add ip route 10.$i.$j.0/24 via 172.16.0.2"
+	done
+done > $tmp/routes
+grcli -e -f $tmp/routes
+
+n=$(grcli show ip route | grep -c "via 172.16.0.2")
+[ "$n" -eq 10000 ]
+
+# errors of pipelined requests must be reported with their line number
+printf 'add ip route 10.0.0.0/24 via 172.16.0.2\n' > $tmp/dup
+if grcli -e -f $tmp/dup 2> $tmp/err; then
+	echo "duplicate route added"
+	exit 1
+fi
+grep -q "line 1: command failed" $tmp/err
@@ -0,0 +1,40 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+gretun=${run_id}gre1
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:01
+grcli add interface port $p1 devargs net_tap1,iface=$p1 mac f0:0d:ac:dc:00:02
+grcli add ip address 10.99.0.1/24 iface $p0
+grcli add ip address 172.16.1.1/24 iface $p1
+grcli add interface gre $gretun local 172.16.1.1 remote 172.16.1.2 key 42 seq on
+grcli add ip address 10.98.0.1/24 iface $gretun
+
+ip netns add $p0
+echo ip netns del $p0 >> $tmp/cleanup
+ip link set $p0 netns $p0
+ip -n $p0 link set $p0 address ba:d0:ca:ca:00:00
+ip -n $p0 link set $p0 up
+ip -n $p0 addr add 10.99.0.2/24 dev $p0
+ip -n $p0 route add default via 10.99.0.1
+ip -n $p0 addr show
+
+ip netns add $p1
+echo ip netns del $p1 >> $tmp/cleanup
+ip link set $p1 netns $p1
+ip -n $p1 link set $p1 address ba:d0:ca:ca:00:01
+ip -n $p1 link set $p1 up
+ip -n $p1 addr add 172.16.1.2/24 dev $p1
+ip -n $p1 tunnel add $gretun mode gre local 172.16.1.2 remote 172.16.1.1 key 42
+ip -n $p1 link set $gretun up
+ip -n $p1 addr add 10.98.0.2/24 dev $gretun
+ip -n $p1 route add default via 10.98.0.1
+ip -n $p1 addr show
+
+ip netns exec $p0 ping -i0.01 -c3 10.98.0.2
+ip netns exec $p1 ping -i0.01 -c3 10.99.0.2
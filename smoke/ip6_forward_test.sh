@@ -32,3 +32,7 @@ ip netns exec $p1 ping6 -i0.01 -c3 fd00:ba4:1::1
 ip netns exec $p2 ping6 -i0.01 -c3 fd00:ba4:2::1
 ip netns exec $p1 traceroute6 -N1 fd00:ba4:2::2
 ip netns exec $p2 traceroute6 -N1 fd00:ba4:1::2
+
+# host routes of the neighbors are created by the control plane
+grcli show ip6 route | grep -q "fd00:ba4:2::2/128"
+grcli show ip6 route | grep -q "fd00:ba4:1::2/128"
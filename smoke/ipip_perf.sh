@@ -0,0 +1,17 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+. $(dirname $0)/_perf.sh
+
+iptun=${run_id}tun1
+
+grcli add interface ipip $iptun local 172.16.1.1 remote 172.16.1.2
+grcli add ip address 10.98.0.1/24 iface $iptun
+grcli add ip route 203.0.113.0/24 via 10.98.0.2
+
+# plain packets routed into the tunnel
+perf_run ipip_encap dst 203.0.113.1
+# tunneled packets to the local endpoint, the inner packets use the default route
+perf_run ipip_decap outer-src 172.16.1.2 outer-dst 172.16.1.1
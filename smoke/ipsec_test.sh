@@ -0,0 +1,67 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+tun=${run_id}sec1
+
+key_out=0x000102030405060708090a0b0c0d0e0f
+key_in=0x101112131415161718191a1b1c1d1e1f
+salt_out=0xcafe0001
+salt_in=0xcafe0002
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:01
+grcli add interface port $p1 devargs net_tap1,iface=$p1 mac f0:0d:ac:dc:00:02
+grcli add ip address 10.99.0.1/24 iface $p0
+grcli add ip address 172.16.1.1/24 iface $p1
+grcli add interface ipsec $tun local 172.16.1.1 remote 172.16.1.2
+grcli add ip address 10.98.0.1/24 iface $tun
+# tap ports have no inline offload, use a software crypto device
+grcli set ipsec cryptodev crypto_openssl0
+grcli add ipsec sa $tun out spi 0x1001 key $key_out salt $salt_out
+grcli add ipsec sa $tun in spi 0x2001 key $key_in salt $salt_in
+
+ip netns add $p0
+echo ip netns del $p0 >> $tmp/cleanup
+ip link set $p0 netns $p0
+ip -n $p0 link set $p0 address ba:d0:ca:ca:00:00
+ip -n $p0 link set $p0 up
+ip -n $p0 addr add 10.99.0.2/24 dev $p0
+ip -n $p0 route add default via 10.99.0.1
+ip -n $p0 addr show
+
+ip netns add $p1
+echo ip netns del $p1 >> $tmp/cleanup
+ip link set $p1 netns $p1
+ip -n $p1 link set $p1 address ba:d0:ca:ca:00:01
+ip -n $p1 link set $p1 up
+ip -n $p1 addr add 172.16.1.2/24 dev $p1
+# route based kernel peer: the SAs of grout with reversed directions
+ip -n $p1 link add $tun type xfrm if_id 42
+ip -n $p1 link set $tun up
+ip -n $p1 addr add 10.98.0.2/24 dev $tun
+ip -n $p1 route add default via 10.98.0.1
+ip -n $p1 xfrm state add src 172.16.1.1 dst 172.16.1.2 proto esp spi 0x1001 \
+	mode tunnel if_id 42 aead 'rfc4106(gcm(aes))' ${key_out}${salt_out#0x} 128
+ip -n $p1 xfrm state add src 172.16.1.2 dst 172.16.1.1 proto esp spi 0x2001 \
+	mode tunnel if_id 42 aead 'rfc4106(gcm(aes))' ${key_in}${salt_in#0x} 128
+ip -n $p1 xfrm policy add dir out tmpl src 172.16.1.2 dst 172.16.1.1 proto esp \
+	mode tunnel if_id 42
+ip -n $p1 xfrm policy add dir in tmpl src 172.16.1.1 dst 172.16.1.2 proto esp \
+	mode tunnel if_id 42
+ip -n $p1 addr show
+
+ip netns exec $p0 ping -i0.01 -c3 10.98.0.2
+ip netns exec $p1 ping -i0.01 -c3 10.99.0.2
+
+grcli show ipsec sa
+
+# once the outbound SA is removed, nothing must leave unencrypted
+grcli del ipsec sa $tun out spi 0x1001
+if ip netns exec $p0 ping -i0.01 -c3 -W1 10.98.0.2; then
+	echo "packets forwarded without outbound SA" >&2
+	exit 1
+fi
@@ -0,0 +1,66 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add interface port $p1 devargs net_tap1,iface=$p1 mac f0:0d:ac:dc:00:01
+grcli add ip address 172.16.0.1/24 iface $p0
+grcli add ip address 172.16.1.1/24 iface $p1
+
+for n in 0 1; do
+	p=$run_id$n
+	ip netns add $p
+	echo ip netns del $p >> $tmp/cleanup
+	ip link set $p netns $p
+	ip -n $p link set $p address ba:d0:ca:ca:00:0$n
+	ip -n $p link set $p up
+	ip -n $p addr add 172.16.$n.2/24 dev $p
+	ip -n $p route add default via 172.16.$n.1
+	ip -n $p addr show
+done
+# two backends in the same namespace
+ip -n $p1 addr add 172.16.1.3/24 dev $p1
+# the VIP must be routed by grout
+grcli add ip route 10.100.0.0/24 via 172.16.1.2
+
+send() {
+	for i in 1 2 3; do
+		ip netns exec $p0 bash -c "echo lb > /dev/udp/10.100.0.1/$1"
+	done
+}
+
+grcli add lb service 10.100.0.1 udp 53 src 172.16.1.1 backend 172.16.1.2 172.16.1.3
+grcli show lb service
+
+timeout 5 ip netns exec $p1 tcpdump -nn -i $p1 -c 3 ip proto 4 and src 172.16.1.1 &
+pid=$!
+sleep 1
+send 53
+wait $pid
+
+grcli add lb service 10.100.0.1 udp 53 src 172.16.1.1 backend 172.16.1.2 172.16.1.3 encap gue
+grcli show lb service | grep -q "gue:6080"
+
+timeout 5 ip netns exec $p1 tcpdump -nn -i $p1 -c 3 udp dst port 6080 and src 172.16.1.1 &
+pid=$!
+sleep 1
+send 53
+wait $pid
+
+# other ports of the VIP are routed without encapsulation
+timeout 5 ip netns exec $p1 tcpdump -nn -i $p1 -c 3 udp dst port 54 and dst 10.100.0.1 &
+pid=$!
+sleep 1
+send 54
+wait $pid
+
+grcli del lb service 10.100.0.1 udp 53
+if grcli show lb service | grep -q 10.100.0.1; then
+	echo "service 10.100.0.1 not deleted" >&2
+	exit 1
+fi
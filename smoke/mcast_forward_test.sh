@@ -0,0 +1,66 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+p2=${run_id}2
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add interface port $p1 devargs net_tap1,iface=$p1 mac f0:0d:ac:dc:00:01
+grcli add interface port $p2 devargs net_tap2,iface=$p2 mac f0:0d:ac:dc:00:02
+grcli add ip address 172.16.0.1/24 iface $p0
+grcli add ip address 172.16.1.1/24 iface $p1
+grcli add ip address 172.16.2.1/24 iface $p2
+
+for n in 0 1 2; do
+	p=$run_id$n
+	ip netns add $p
+	echo ip netns del $p >> $tmp/cleanup
+	ip link set $p netns $p
+	ip -n $p link set $p address ba:d0:ca:ca:00:0$n
+	ip -n $p link set $p up
+	ip -n $p addr add 172.16.$n.2/24 dev $p
+	ip -n $p route add default via 172.16.$n.1
+	# answer echo requests sent to multicast groups
+	ip netns exec $p sysctl -w net.ipv4.icmp_echo_ignore_broadcasts=0
+	ip -n $p addr show
+done
+
+grcli add mcast route 239.1.1.1 oifs $p1 $p2 iif $p0
+grcli add mcast route 239.1.1.2 oifs $p2 source 172.16.0.2
+grcli show mcast route
+
+# replicated on both receivers, each one sends a unicast reply
+ip netns exec $p0 ping -i0.01 -c3 -t8 -n 239.1.1.1 | tee $tmp/ping
+grep -q "from 172.16.1.2" $tmp/ping
+grep -q "from 172.16.2.2" $tmp/ping
+
+# (S,G) route
+ip netns exec $p0 ping -i0.01 -c3 -t8 -n 239.1.1.2 | tee $tmp/ping
+grep -q "from 172.16.2.2" $tmp/ping
+if grep -q "from 172.16.1.2" $tmp/ping; then
+	echo "239.1.1.2 forwarded to $p1" >&2
+	exit 1
+fi
+
+# reverse path check, packets received on $p1 are not forwarded
+ip netns exec $p1 ping -i0.01 -c3 -t8 -n -w1 239.1.1.1 | tee $tmp/ping || true
+if grep -q "from 172.16.2.2" $tmp/ping; then
+	echo "239.1.1.1 forwarded from $p1" >&2
+	exit 1
+fi
+
+# without a route, multicast packets are not forwarded anymore
+grcli del mcast route 239.1.1.1
+ip netns exec $p0 ping -i0.01 -c3 -t8 -n -w1 239.1.1.1 | tee $tmp/ping || true
+if grep -q "from 172.16.[12].2" $tmp/ping; then
+	echo "239.1.1.1 forwarded without a route" >&2
+	exit 1
+fi
+
+# removed outgoing interfaces are pruned from the routes
+grcli del interface $p2
+grcli show mcast route | grep -q "239.1.1.2"
@@ -0,0 +1,33 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+m0=${run_id}m0
+m1=${run_id}m1
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add ip address 10.99.0.1/24 iface $p0
+
+# both ends of the memif connection are ports of grout, in separate VRFs
+grcli add interface port $m0 devargs net_memif0,role=server,socket=$tmp/memif.sock \
+	mac f0:0d:ac:dc:00:01 qsize 512
+grcli add interface port $m1 devargs net_memif1,role=client,socket=$tmp/memif.sock \
+	vrf 1 mac f0:0d:ac:dc:01:00
+grcli add ip address 10.98.0.1/24 iface $m0
+grcli add ip address 10.98.0.2/24 iface $m1
+grcli add ip route 0.0.0.0/0 via 10.98.0.1 vrf 1
+
+ip netns add $p0
+echo ip netns del $p0 >> $tmp/cleanup
+ip link set $p0 netns $p0
+ip -n $p0 link set $p0 address ba:d0:ca:ca:00:00
+ip -n $p0 link set $p0 up
+ip -n $p0 addr add 10.99.0.2/24 dev $p0
+ip -n $p0 route add default via 10.99.0.1
+ip -n $p0 addr show
+
+ip netns exec $p0 ping -i0.01 -c3 -n 10.98.0.1
+ip netns exec $p0 ping -i0.01 -c3 -n -s 1400 10.98.0.2
@@ -0,0 +1,21 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add ip address 172.16.0.1/24 iface $p0
+grcli add ip6 address fd00:ba4:0::1/64 iface $p0
+
+grcli show memory
+grcli show memory | grep -q "^SOCKET "
+for subsystem in "mbuf pools" "ipv4 fib" "ipv6 fib" "ipv4 nexthops" "ipv6 nexthops" other; do
+	grcli show memory | grep -q "^$subsystem "
+done
+
+# high-water marks survive releases
+grcli del interface $p0
+grcli show memory | grep "^mbuf pools "
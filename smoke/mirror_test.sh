@@ -0,0 +1,52 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+p2=${run_id}2
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add interface port $p1 devargs net_tap1,iface=$p1 mac f0:0d:ac:dc:00:01
+grcli add interface port $p2 devargs net_tap2,iface=$p2 mac f0:0d:ac:dc:00:02
+grcli add ip address 172.16.0.1/24 iface $p0
+grcli add ip address 172.16.1.1/24 iface $p1
+
+for n in 0 1; do
+	p=$run_id$n
+	ip netns add $p
+	echo ip netns del $p >> $tmp/cleanup
+	ip link set $p netns $p
+	ip -n $p link set $p address ba:d0:ca:ca:00:0$n
+	ip -n $p link set $p up
+	ip -n $p addr add 172.16.$n.2/24 dev $p
+	ip -n $p route add default via 172.16.$n.1
+done
+ip link set $p2 up
+
+# the monitor port cannot be mirrored itself
+grcli set port mirror $p0 to $p2 snaplen 64
+if grcli set port mirror $p2 to $p1; then
+	echo "monitor port $p2 mirrored" >&2
+	exit 1
+fi
+
+timeout 5 tcpdump -nn -i $p2 -c 6 -w $tmp/mirror.pcap icmp &
+pid=$!
+sleep 1
+ip netns exec $p0 ping -i0.01 -c3 -n -s 1000 172.16.1.2
+wait $pid
+# both directions, truncated to the snaplen
+tcpdump -nn -e -r $tmp/mirror.pcap | grep -c "length 64:" | grep -qx 6
+grcli show port mirror $p0
+grcli show port mirror $p0 | awk '$1 == "packets:" && $2 >= 6 {ok=1} END {exit !ok}'
+
+# rate capped copies do not affect forwarding
+grcli set port mirror $p0 to $p2 direction rx rate 1
+ip netns exec $p0 ping -i0.01 -c20 -n 172.16.1.2
+grcli show port mirror $p0 | awk '$1 == "dropped:" && $2 > 0 {ok=1} END {exit !ok}'
+
+grcli set port mirror $p0 off
+grcli show port mirror $p0 | grep -qx "destination: none"
@@ -0,0 +1,45 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add interface port $p1 devargs net_tap1,iface=$p1 mac f0:0d:ac:dc:00:01
+grcli add ip address 172.16.0.1/24 iface $p0
+grcli add ip address 172.16.1.1/24 iface $p1
+grcli add nat44 pool $p1 inside 172.16.0.0/24 addr 198.51.100.1 to 198.51.100.2
+grcli show nat44 pool
+
+for n in 0 1; do
+	p=$run_id$n
+	ip netns add $p
+	echo ip netns del $p >> $tmp/cleanup
+	ip link set $p netns $p
+	ip -n $p link set $p address ba:d0:ca:ca:00:0$n
+	ip -n $p link set $p up
+	ip -n $p addr add 172.16.$n.2/24 dev $p
+	ip -n $p addr show
+done
+ip -n $p0 route add default via 172.16.0.1
+# the outside host only knows how to reach the translated addresses
+ip -n $p1 route add 198.51.100.0/24 via 172.16.1.1
+
+ip netns exec $p0 ping -i0.01 -c3 -n 172.16.1.2
+grcli show nat44 pool
+if ! grcli show nat44 pool | grep -q "^$p1 .* 1  *1 *$"; then
+	echo "no port block allocated for 172.16.0.2 on $p1" >&2
+	exit 1
+fi
+
+# locally generated packets are not translated
+ip netns exec $p1 ping -i0.01 -c3 -n 172.16.1.1
+
+grcli del nat44 pool $p1
+if ip netns exec $p0 ping -i0.01 -c3 -n -w1 172.16.1.2; then
+	echo "ping to 172.16.1.2 translated without pool" >&2
+	exit 1
+fi
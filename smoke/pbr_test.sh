@@ -0,0 +1,68 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+p2=${run_id}2
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add interface port $p1 devargs net_tap1,iface=$p1 mac f0:0d:ac:dc:00:01
+grcli add interface port $p2 devargs net_tap2,iface=$p2 vrf 1 mac f0:0d:ac:dc:01:02
+grcli add ip address 172.16.0.1/24 iface $p0
+grcli add ip address 172.16.1.1/24 iface $p1
+grcli add ip address 172.16.2.1/24 iface $p2
+
+for n in 0 1 2; do
+	p=$run_id$n
+	ip netns add $p
+	echo ip netns del $p >> $tmp/cleanup
+	ip link set $p netns $p
+	ip -n $p link set $p address ba:d0:ca:ca:00:0$n
+	ip -n $p link set $p up
+	ip -n $p addr add 172.16.$n.2/24 dev $p
+	ip -n $p route add default via 172.16.$n.1
+	ip -n $p addr show
+done
+# the same destination is reachable through both VRFs
+ip -n $p1 addr add 10.0.0.1/32 dev lo
+ip -n $p2 addr add 10.0.0.1/32 dev lo
+grcli add ip route 10.0.0.0/24 via 172.16.1.2
+grcli add ip route 10.0.0.0/24 via 172.16.2.2 vrf 1
+
+ip netns exec $p0 ping -i0.01 -c3 -n 172.16.1.2
+ip netns exec $p0 ping -i0.01 -c3 -n 10.0.0.1
+
+# expedited forwarding traffic is routed in vrf 1, replies back in vrf 0
+grcli add acl rule $p0 pbr seq 10 vrf 1 src 172.16.0.0/24 dscp 46
+grcli add acl rule $p2 pbr seq 10 vrf 0 dst 172.16.0.0/24
+grcli show acl rule
+grcli del ip route 10.0.0.0/24
+if ip netns exec $p0 ping -i0.01 -c3 -n -w1 10.0.0.1; then
+	echo "ping to 10.0.0.1 routed without policy" >&2
+	exit 1
+fi
+ip netns exec $p0 ping -i0.01 -c3 -n -Q 0xb8 10.0.0.1
+
+# ingress ACLs are evaluated after policy based routing
+grcli add acl rule $p0 in seq 10 deny dst 10.0.0.1/32
+if ip netns exec $p0 ping -i0.01 -c3 -n -w1 -Q 0xb8 10.0.0.1; then
+	echo "ping to 10.0.0.1 not denied on $p0 input" >&2
+	exit 1
+fi
+grcli clear acl rules $p0 in
+
+grcli clear acl rules $p0 pbr
+if ip netns exec $p0 ping -i0.01 -c3 -n -w1 -Q 0xb8 10.0.0.1; then
+	echo "ping to 10.0.0.1 routed after flushing the policy" >&2
+	exit 1
+fi
+
+# rules are removed with their interface
+grcli del interface $p2
+if grcli show acl rule | grep -q "^$p2 "; then
+	echo "rules not removed with $p2" >&2
+	exit 1
+fi
@@ -0,0 +1,28 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+here=$(dirname $0)
+builddir=${1?build dir}
+export PERF_RESULTS=${PERF_RESULTS:-$builddir/perf.json}
+log=$(mktemp)
+trap "rm -f $log" EXIT
+result=0
+
+: > "$PERF_RESULTS"
+
+for script in $here/*_perf.sh; do
+	name=$(basename $script)
+	printf "%s ... " "$name"
+	if "$script" "$builddir" >$log 2>&1; then
+		echo OK
+	else
+		result=1
+		echo FAILED
+		cat $log
+	fi
+done
+
+cat "$PERF_RESULTS"
+
+exit $result
@@ -0,0 +1,41 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add interface port $p1 devargs net_tap1,iface=$p1 mac f0:0d:ac:dc:00:01
+grcli add ip address 172.16.0.1/24 iface $p0
+grcli add ip address 172.16.1.1/24 iface $p1
+
+for n in 0 1; do
+	p=$run_id$n
+	ip netns add $p
+	echo ip netns del $p >> $tmp/cleanup
+	ip link set $p netns $p
+	ip -n $p link set $p address ba:d0:ca:ca:00:0$n
+	ip -n $p link set $p up
+	ip -n $p addr add 172.16.$n.2/24 dev $p
+	ip -n $p route add default via 172.16.$n.1
+done
+
+# small packets fit in the committed burst
+grcli set interface policer $p0 srtcm cir 1000000 cbs 10000 ebs 10000
+ip netns exec $p0 ping -i0.01 -c3 -n 172.16.1.2
+grcli show interface policer $p0
+grcli show interface policer $p0 | awk '$1 == "green_packets:" && $2 > 0 {ok=1} END {exit !ok}'
+
+# large packets exceed all buckets and are dropped
+grcli set interface policer $p0 trtcm cir 8000 pir 8000 cbs 100 ebs 100
+if ip netns exec $p0 ping -i0.01 -c3 -n -w1 -s 1000 172.16.1.2; then
+	echo "large packets not policed on $p0 input" >&2
+	exit 1
+fi
+grcli show interface policer $p0 | awk '$1 == "red_packets:" && $2 > 0 {ok=1} END {exit !ok}'
+
+grcli set interface policer $p0 off
+ip netns exec $p0 ping -i0.01 -c3 -n -s 1000 172.16.1.2
@@ -0,0 +1,46 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+k0=${run_id}k0
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add ip address 10.99.0.1/24 iface $p0
+
+ip netns add $p0
+echo ip netns del $p0 >> $tmp/cleanup
+ip link set $p0 netns $p0
+ip -n $p0 link set $p0 address ba:d0:ca:ca:00:00
+ip -n $p0 link set $p0 up
+ip -n $p0 addr add 10.99.0.2/24 dev $p0
+
+grcli set interface punt $p0 netdev $k0
+grcli show interface punt $p0 | grep -qx "netdev: $k0"
+ip link show $k0 | grep -q NOARP
+
+# the kernel device owns the same address as the grout interface
+ip netns add $k0
+echo ip netns del $k0 >> $tmp/cleanup
+ip link set $k0 netns $k0
+ip -n $k0 link set $k0 arp off up
+ip -n $k0 addr add 10.99.0.1/24 dev $k0
+
+# udp datagrams with no local listener in grout are punted to the kernel
+timeout 5 ip netns exec $k0 tcpdump -nn -i $k0 -c 3 udp port 5000 &
+pid=$!
+sleep 1
+for i in 1 2 3; do
+	ip netns exec $p0 bash -c 'echo punt > /dev/udp/10.99.0.1/5000'
+done
+wait $pid
+grcli show interface punt $p0 | awk '$1 == "punted:" && $2 >= 3 {ok=1} END {exit !ok}'
+
+# host originated packets are routed by grout
+ip netns exec $k0 ping -i0.01 -c3 -W1 10.99.0.2 || true
+grcli show interface punt $p0 | awk '$1 == "injected:" && $2 >= 3 {ok=1} END {exit !ok}'
+
+grcli set interface punt $p0 off
+grcli show interface punt $p0 | grep -qx "netdev: none"
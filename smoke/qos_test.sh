@@ -0,0 +1,43 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+v1=$p1.43
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add interface port $p1 devargs net_tap1,iface=$p1 mac f0:0d:ac:dc:00:01
+grcli add interface vlan $v1 parent $p1 vlan_id 43
+grcli add ip address 172.16.0.1/24 iface $p0
+grcli add ip address 172.16.1.1/24 iface $v1
+# one pipe per subscriber vlan, 10Mbit/s each
+grcli set port qos $p1 dscp rate 1000000000 pipes 64 pipe-rate 10000000
+
+ip netns add $p0
+echo ip netns del $p0 >> $tmp/cleanup
+ip link set $p0 netns $p0
+ip -n $p0 link set $p0 address ba:d0:ca:ca:00:00
+ip -n $p0 link set $p0 up
+ip -n $p0 addr add 172.16.0.2/24 dev $p0
+ip -n $p0 route add default via 172.16.0.1
+
+ip netns add $p1
+echo ip netns del $p1 >> $tmp/cleanup
+ip link set $p1 netns $p1
+ip -n $p1 link add $v1 link $p1 type vlan id 43
+ip -n $p1 link set $p1 address ba:d0:ca:ca:00:01
+ip -n $p1 link set $p1 up
+ip -n $p1 link set $v1 up
+ip -n $p1 addr add 172.16.1.2/24 dev $v1
+ip -n $p1 route add default via 172.16.1.1
+
+ip netns exec $p0 ping -i0.01 -c3 -n 172.16.1.2
+ip netns exec $p0 ping -i0.01 -c3 -n -Q 0xb8 172.16.1.2
+grcli show port qos $p1
+grcli show port qos $p1 | awk '$1 == "enqueued:" && $2 > 0 {ok=1} END {exit !ok}'
+
+grcli set port qos $p1 off
+ip netns exec $p0 ping -i0.01 -c3 -n 172.16.1.2
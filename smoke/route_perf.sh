@@ -0,0 +1,29 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+. $(dirname $0)/_perf.sh
+
+: ${PERF_ROUTES:="1000 100000 1000000"}
+
+max=0
+for n in $PERF_ROUTES; do
+	[ "$n" -gt "$max" ] && max=$n
+done
+grcli set ip fib vrf 0 type dir24_8 max-routes $((max + 1024))
+
+# /32 host routes from 10.0.0.0, the table grows between each run
+loaded=0
+for n in $PERF_ROUTES; do
+	awk -v from=$loaded -v to=$n 'BEGIN {
+		for (i = from; i < to; i++)
+			printf "add ip route 10.%d.%d.%d/32 via 172.16.1.2\n",
+				int(i / 65536) % 256, int(i / 256) % 256, i % 256
+	}' > $tmp/routes
+	grcli -e -f $tmp/routes
+	loaded=$n
+
+	# every packet has a different destination, spread over all routes
+	perf_run route_$n dst 10.0.0.0 dsts $n
+done
@@ -0,0 +1,51 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00 rxqs 4
+grcli add interface port $p1 devargs net_tap1,iface=$p1 mac f0:0d:ac:dc:00:01
+grcli add ip address 172.16.0.1/24 iface $p0
+grcli add ip address 172.16.1.1/24 iface $p1
+
+grcli add port pin $p0 dst 172.16.1.0/24 rxq 2 count 2
+grcli add port pin $p0 vlan 42 rxq 2 count 2
+grcli add port pin $p0 dst 2001:db8::/32 rxq 1
+grcli show port pin $p0 | grep -q "dst 172.16.1.0/24 *2-3"
+grcli show port pin $p0 | grep -q "vlan 42 *2-3"
+grcli show port pin $p0 | grep -q "dst 2001:db8::/32 *1"
+
+# overlapping tenants, no shared rxq left, duplicate match
+! grcli add port pin $p0 vlan 43 rxq 3
+! grcli add port pin $p0 vlan 43 rxq 0
+! grcli add port pin $p0 vlan 42 rxq 1
+# pinned rxqs cannot receive rss buckets
+! grcli set port rss $p0 reta 0,2
+
+for n in 0 1; do
+	p=$run_id$n
+	ip netns add $p
+	echo ip netns del $p >> $tmp/cleanup
+	ip link set $p netns $p
+	ip -n $p link set $p address ba:d0:ca:ca:00:0$n
+	ip -n $p link set $p up
+	ip -n $p addr add 172.16.$n.2/24 dev $p
+	ip -n $p route add default via 172.16.$n.1
+done
+
+ip netns exec $p0 ping -i0.01 -c3 172.16.1.2
+
+# pins are kept when the port is reconfigured
+grcli set interface port $p0 mtu 1400
+grcli show port pin $p0 | grep -q "vlan 42 *2-3"
+ip netns exec $p0 ping -i0.01 -c3 172.16.1.2
+
+grcli del port pin $p0 vlan 42
+grcli del port pin $p0 dst 172.16.1.0/24
+! grcli del port pin $p0 vlan 42
+! grcli show port pin $p0 | grep -q "vlan 42"
+ip netns exec $p0 ping -i0.01 -c3 172.16.1.2
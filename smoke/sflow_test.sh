@@ -0,0 +1,41 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add interface port $p1 devargs net_tap1,iface=$p1 mac f0:0d:ac:dc:00:01
+grcli add ip address 172.16.0.1/24 iface $p0
+grcli add ip address 172.16.1.1/24 iface $p1
+grcli set sflow collector 127.0.0.1 port 16343 agent 172.16.0.1
+grcli set sflow interface $p0 rate 1
+
+for n in 0 1; do
+	p=$run_id$n
+	ip netns add $p
+	echo ip netns del $p >> $tmp/cleanup
+	ip link set $p netns $p
+	ip -n $p link set $p address ba:d0:ca:ca:00:0$n
+	ip -n $p link set $p up
+	ip -n $p addr add 172.16.$n.2/24 dev $p
+	ip -n $p route add default via 172.16.$n.1
+done
+
+ip netns exec $p0 ping -i0.01 -c10 -n 172.16.1.2
+sleep 0.5
+grcli show sflow
+grcli show sflow | awk '$1 == "datagrams:" && $2 > 0 {ok=1} END {exit !ok}'
+grcli show sflow | awk -v p=$p0 '$1 == p && $3 >= 10 {ok=1} END {exit !ok}'
+
+grcli set sflow collector 127.0.0.1 port 14739 format ipfix domain 42
+ip netns exec $p0 ping -i0.01 -c3 -n 172.16.1.2
+sleep 0.5
+grcli show sflow
+
+grcli del sflow interface $p0
+grcli del sflow collector
+ip netns exec $p0 ping -i0.01 -c3 -n 172.16.1.2
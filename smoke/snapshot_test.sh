@@ -0,0 +1,47 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+if [ "$run_grout" = false ]; then
+	echo "grout must be restarted by this test, skipping"
+	exit 0
+fi
+
+restart_grout() {
+	kill -INT %?grout
+	wait %?grout || true
+	rm -f $GROUT_SOCK_PATH
+	grout -tv -S $tmp/snapshot &
+	socat FILE:/dev/null UNIX-CONNECT:$GROUT_SOCK_PATH,retry=10
+}
+
+restart_grout
+
+grcli add interface port p0 devargs net_null0
+grcli add interface port p1 devargs net_null1
+grcli add interface port p2 devargs net_null2
+grcli del interface p2
+grcli add ip address 10.0.0.1/24 iface p0
+grcli add ip address 10.1.0.1/24 iface p1
+grcli add ip route 0.0.0.0/0 via 10.0.0.2
+grcli add ip route 192.168.0.0/16 via 10.1.0.2
+grcli del ip route 192.168.0.0/16
+grcli add ip6 address 2345::1/24 iface p0
+grcli add ip6 route ::/0 via 2345::2
+
+restart_grout
+
+grcli show interface name p0
+grcli show interface name p1
+if grcli show interface name p2; then
+	echo "deleted interface was restored"
+	exit 1
+fi
+grcli show ip route | grep -q "0.0.0.0/0 *10.0.0.2"
+if grcli show ip route | grep -q "192.168.0.0/16"; then
+	echo "deleted route was restored"
+	exit 1
+fi
+grcli show ip6 route | grep -q "::/0 *2345::2"
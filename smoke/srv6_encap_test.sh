@@ -0,0 +1,53 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+sr=${run_id}sr6
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:01
+grcli add interface port $p1 devargs net_tap1,iface=$p1 mac f0:0d:ac:dc:00:02
+grcli add ip address 10.99.0.1/24 iface $p0
+grcli add ip6 address fd00:ba4:1::1/64 iface $p1
+grcli add ip6 route fd00:ba4:200::/64 via fd00:ba4:1::2
+grcli add interface srv6 $sr src fd00:ba4:1::1 segments fd00:ba4:200::1
+grcli add ip address 10.98.0.1/24 iface $sr
+grcli add srv6 localsid fd00:ba4:100::1 behavior end.dt4 iface $sr
+grcli show srv6 localsid
+
+ip netns add $p0
+echo ip netns del $p0 >> $tmp/cleanup
+ip link set $p0 netns $p0
+ip -n $p0 link set $p0 address ba:d0:ca:ca:00:00
+ip -n $p0 link set $p0 up
+ip -n $p0 addr add 10.99.0.2/24 dev $p0
+ip -n $p0 route add default via 10.99.0.1
+ip -n $p0 addr show
+
+ip netns add $p1
+echo ip netns del $p1 >> $tmp/cleanup
+ip link set $p1 netns $p1
+ip -n $p1 link set $p1 address ba:d0:ca:ca:00:01
+ip -n $p1 link set $p1 up
+ip -n $p1 addr add fd00:ba4:1::2/64 dev $p1
+ip -n $p1 -6 route add fd00:ba4:100::/64 via fd00:ba4:1::1
+ip -n $p1 sr tunsrc set fd00:ba4:1::2
+# End.DT4 decapsulates into a VRF on the linux side
+ip netns exec $p1 sysctl -qw net.vrf.strict_mode=1
+ip -n $p1 link add vrf100 type vrf table 100
+ip -n $p1 link set vrf100 up
+ip -n $p1 link add dummy0 type dummy
+ip -n $p1 link set dummy0 master vrf100
+ip -n $p1 link set dummy0 up
+ip -n $p1 addr add 10.98.0.2/24 dev dummy0
+ip -n $p1 -6 route add fd00:ba4:200::1/128 encap seg6local action End.DT4 vrftable 100 dev vrf100
+ip -n $p1 route add 10.99.0.0/24 vrf vrf100 encap seg6 mode encap segs fd00:ba4:100::1 dev $p1
+ip -n $p1 addr show
+
+sleep 3  # wait for DAD
+
+ip netns exec $p0 ping -i0.01 -c3 10.98.0.2
+ip netns exec $p1 ping -i0.01 -c3 -I vrf100 10.99.0.2
@@ -33,3 +33,7 @@ done
 
 ip netns exec $p0 ping -i0.01 -c3 172.16.1.2
 ip netns exec $p1 ping -i0.01 -c3 172.16.0.2
+
+grcli show interface stats
+# vlan interfaces have their own software counters
+grcli show interface stats name $v0 | awk -v v=$v0 '$1 == v && $2 > 0 && $4 > 0 {ok=1} END {exit !ok}'
@@ -0,0 +1,17 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+. $(dirname $0)/_perf.sh
+
+: ${PERF_VLANS:=1000}
+
+for v in $(seq 1 $PERF_VLANS); do
+	echo "add interface vlan $p0.$v parent $p0 vlan_id $v"
+	echo "add ip address 10.$((v / 256)).$((v % 256)).1/24 iface $p0.$v"
+done > $tmp/vlans
+grcli -e -f $tmp/vlans
+
+# each packet is tagged with the next VLAN ID
+perf_run vlan_$PERF_VLANS vlan 1 vlans $PERF_VLANS
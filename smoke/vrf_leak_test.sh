@@ -0,0 +1,54 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+p1=${run_id}1
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add interface port $p1 devargs net_tap1,iface=$p1 vrf 1 mac f0:0d:ac:dc:01:01
+grcli add ip address 172.16.0.1/24 iface $p0
+grcli add ip address 172.16.1.1/24 iface $p1
+
+for n in 0 1; do
+	p=$run_id$n
+	ip netns add $p
+	echo ip netns del $p >> $tmp/cleanup
+	ip link set $p netns $p
+	ip -n $p link set $p address ba:d0:ca:ca:00:0$n
+	ip -n $p link set $p up
+	ip -n $p addr add 172.16.$n.2/24 dev $p
+	ip -n $p route add default via 172.16.$n.1
+	ip -n $p addr show
+done
+ip -n $p1 addr add 10.0.0.1/32 dev lo
+grcli add ip route 10.0.0.0/24 via 172.16.1.2 vrf 1
+
+if ip netns exec $p0 ping -i0.01 -c3 -n -w1 10.0.0.1; then
+	echo "ping to 10.0.0.1 routed without leaked route" >&2
+	exit 1
+fi
+
+# leak the routes in both directions
+grcli add ip route 10.0.0.0/24 via 172.16.1.2 nh-vrf 1
+grcli add ip route 172.16.0.0/24 via 172.16.0.2 vrf 1 nh-vrf 0
+grcli show ip route
+grcli show ip route vrf 1
+grcli show ip nexthop
+
+ip netns exec $p0 ping -i0.01 -c3 -n 10.0.0.1
+
+# local addresses cannot be leaked
+if grcli add ip route 10.1.0.0/24 via 172.16.0.1 vrf 1 nh-vrf 0; then
+	echo "local address leaked" >&2
+	exit 1
+fi
+
+# leaked routes are removed with the next hop subnet
+grcli del ip address 172.16.1.1/24 iface $p1
+if grcli show ip route | grep -q "^10\.0\.0\.0/24 "; then
+	echo "leaked route not removed with 172.16.1.1/24" >&2
+	exit 1
+fi
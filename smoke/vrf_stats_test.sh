@@ -0,0 +1,34 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2024 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+p0=${run_id}0
+
+grcli add interface port $p0 devargs net_tap0,iface=$p0 mac f0:0d:ac:dc:00:00
+grcli add ip address 172.16.0.1/24 iface $p0
+
+ip netns add $p0
+echo ip netns del $p0 >> $tmp/cleanup
+ip link set $p0 netns $p0
+ip -n $p0 link set $p0 address ba:d0:ca:ca:00:00
+ip -n $p0 link set $p0 up
+ip -n $p0 addr add 172.16.0.2/24 dev $p0
+
+grcli clear stats
+grcli set stats top-prefixes 1 ip4-prefixlen 16
+
+ip netns exec $p0 ping -i0.01 -c10 -n 172.16.0.1
+
+grcli show stats vrf
+grcli show stats vrf 0 | awk '$1 == 0 && $2 == "ip" && $3 >= 10 && $4 >= 840 {ok=1} END {exit !ok}'
+
+grcli show stats top-prefixes
+grcli show stats top-prefixes vrf 0 count 1 \
+	| awk '$1 == 0 && $2 == "172.16.0.0/16" && $3 >= 10 {ok=1} END {exit !ok}'
+
+grcli set stats top-prefixes 0
+grcli clear stats
+grcli show stats vrf | awk '$1 == 0 && $2 == "ip" {exit 1}'
+grcli show stats top-prefixes | awk '$2 ~ /^172\.16\./ {exit 1}'